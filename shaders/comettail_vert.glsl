@@ -0,0 +1,46 @@
+// The tail is a tube along the sun direction, widening away from the
+// nucleus; in_TailCoord holds the index of the section along the tail
+// and the angle around it.
+attribute vec2 in_TailCoord;
+
+uniform vec3 viewDir;
+uniform float fadeFactor;
+
+uniform vec3 tailOrigin;
+uniform vec3 tailAxis;
+uniform vec3 tailU;
+uniform vec3 tailW;
+uniform float tailLength;
+uniform float tailRadius;
+uniform float tailPoints;
+
+varying float shade;
+
+void main(void)
+{
+    float i = in_TailCoord.x;
+    float t = i / tailPoints;
+    vec3 center = tailOrigin + tailAxis * (tailLength * t * t);
+
+    // Tilt the normals by the widening of the tail over the section
+    float w0 = 1.0;
+    float w1 = 0.0;
+    if (i > 0.0)
+    {
+        float sectionLength = tailLength * (2.0 * i - 1.0) / (tailPoints * tailPoints);
+        float tilt = atan(tailRadius / tailPoints / sectionLength);
+        float d = sqrt(1.0 + tilt * tilt);
+        w1 = 1.0 / d;
+        w0 = tilt / d;
+    }
+
+    float s = sin(in_TailCoord.y);
+    float c = cos(in_TailCoord.y);
+    vec3 normal = normalize(tailU * (s * w1) + tailW * (c * w1) + tailAxis * w0);
+    float radius = t * tailRadius;
+    vec3 position = center + (tailU * s + tailW * c) * radius;
+
+    float brightness = 1.0 - i / (tailPoints - 1.0);
+    shade = abs(dot(viewDir, normal) * brightness * fadeFactor);
+    set_vp(vec4(position, 1.0));
+}
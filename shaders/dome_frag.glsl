@@ -0,0 +1,40 @@
+varying vec2 fisheyeCoord;
+varying float intensity;
+
+// The faces of the cube map, tiled three by two: front, right and left in
+// the bottom row, up and down in the top one
+uniform sampler2D tex;
+uniform float tileBorder;
+
+vec2 tileCoord(vec2 ndc, float column, float row)
+{
+    vec2 uv = clamp(ndc * 0.5 + 0.5, tileBorder, 1.0 - tileBorder);
+    return (vec2(column, row) + uv) * vec2(1.0 / 3.0, 0.5);
+}
+
+void main(void)
+{
+    float r = length(fisheyeCoord);
+    if (r > 1.0)
+    {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    float phi = r * 1.5707963;
+    vec2 xy = r > 0.0 ? fisheyeCoord * (sin(phi) / r) : vec2(0.0);
+    vec3 d = vec3(xy, -cos(phi));
+    vec3 a = abs(d);
+
+    vec2 texCoord;
+    if (-d.z >= a.x && -d.z >= a.y)
+        texCoord = tileCoord(d.xy / -d.z, 0.0, 0.0);
+    else if (a.x >= a.y)
+        texCoord = d.x > 0.0 ? tileCoord(vec2(d.z, d.y) / d.x, 1.0, 0.0)
+                             : tileCoord(vec2(-d.z, d.y) / -d.x, 2.0, 0.0);
+    else
+        texCoord = d.y > 0.0 ? tileCoord(vec2(d.x, d.z) / d.y, 0.0, 1.0)
+                             : tileCoord(vec2(d.x, -d.z) / -d.y, 1.0, 1.0);
+
+    gl_FragColor = vec4(texture2D(tex, texCoord).rgb * intensity, 1.0);
+}
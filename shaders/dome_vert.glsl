@@ -0,0 +1,17 @@
+attribute vec2 in_Position;
+attribute vec2 in_TexCoord0;
+attribute float in_Intensity;
+
+// Position in the fisheye view, the rim of the unit circle being 90 degrees
+// from the view direction
+varying vec2 fisheyeCoord;
+varying float intensity;
+
+uniform float screenRatio;
+
+void main(void)
+{
+    gl_Position = vec4(in_Position.x * screenRatio, in_Position.y, 0.0, 1.0);
+    fisheyeCoord = in_TexCoord0 * 2.0 - 1.0;
+    intensity = in_Intensity;
+}
@@ -0,0 +1,53 @@
+varying vec2 texCoord;
+
+uniform sampler2D tex;
+// Size of a texel of the scene, and the coordinates of the texel centers
+// at the corners of the part of it the scene was rendered to
+uniform vec2 texelSize;
+uniform vec2 texCoordMin;
+uniform vec2 texCoordMax;
+
+// Fast approximate antialiasing: pixels at edges in the luma of their
+// neighbours are blurred along the edge, over up to SPAN_MAX texels
+const float SPAN_MAX = 8.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+
+vec3 fetch(vec2 uv)
+{
+    return texture2D(tex, clamp(uv, texCoordMin, texCoordMax)).rgb;
+}
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main(void)
+{
+    vec3 rgbM = fetch(texCoord);
+    float lumaNW = luma(fetch(texCoord + vec2(-1.0, -1.0) * texelSize));
+    float lumaNE = luma(fetch(texCoord + vec2(1.0, -1.0) * texelSize));
+    float lumaSW = luma(fetch(texCoord + vec2(-1.0, 1.0) * texelSize));
+    float lumaSE = luma(fetch(texCoord + vec2(1.0, 1.0) * texelSize));
+    float lumaM = luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // The direction along the edge
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+                    (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * REDUCE_MUL), REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texelSize;
+
+    vec3 rgbA = 0.5 * (fetch(texCoord + dir * (1.0 / 3.0 - 0.5)) +
+                       fetch(texCoord + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (fetch(texCoord - dir * 0.5) +
+                                     fetch(texCoord + dir * 0.5));
+
+    // The wider blur crossed another edge
+    float lumaB = luma(rgbB);
+    gl_FragColor = vec4(lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB, 1.0);
+}
@@ -0,0 +1,14 @@
+attribute vec2 in_Position;
+attribute vec2 in_TexCoord0;
+
+varying vec2 texCoord;
+
+// Part of the texture the scene was rendered to
+uniform vec2 texCoordOffset;
+uniform vec2 texCoordScale;
+
+void main(void)
+{
+    gl_Position = vec4(in_Position.xy, 0.0, 1.0);
+    texCoord = texCoordOffset + in_TexCoord0.st * texCoordScale;
+}
@@ -1,16 +1,12 @@
 
-uniform mat4 m;
 uniform mat3 viewMat;
 
-uniform float size;
-uniform float brightness;
-uniform float minimumFeatureSize;
-
 in Vertex
 {
     vec3  color;
     float size;
     float brightness;
+    float visible;
 } vertex[];
 
 out vec4 v_Color;
@@ -18,10 +14,10 @@ out vec2 v_TexCoord;
 
 void main()
 {
-    float s = size * vertex[0].size;
-    if (s >= minimumFeatureSize)
+    if (vertex[0].visible > 0.5)
     {
-        vec4 p = m * gl_in[0].gl_Position;
+        float s = vertex[0].size;
+        vec4 p = gl_in[0].gl_Position;
         float screenFrac = s / length(p);
         if (screenFrac < 0.1)
         {
@@ -32,7 +28,7 @@ void main()
             vec4 v1 = vec4(viewMat * vec3(-1.0, -1.0, 0.0) * s, 0.0);
             vec4 v2 = vec4(viewMat * vec3( 1.0,  1.0, 0.0) * s, 0.0);
             vec4 v3 = vec4(viewMat * vec3( 1.0, -1.0, 0.0) * s, 0.0);
-            float alpha = (0.1 - screenFrac) * vertex[0].brightness * brightness;
+            float alpha = (0.1 - screenFrac) * vertex[0].brightness;
             vec4 color = vec4(vertex[0].color, alpha);
 
             set_vp(p + v0);
@@ -3,6 +3,11 @@ in float in_Size;
 in float in_ColorIndex;
 in float in_Brightness;
 
+// Per-instance transform of the blobs and size, brightness, minimum
+// feature size and number of blobs drawn
+in mat4 in_Transform;
+in vec4 in_Parameters;
+
 uniform sampler2D colorTex;
 
 out Vertex
@@ -10,12 +15,15 @@ out Vertex
     vec3  color;
     float size;
     float brightness;
+    float visible;
 } vertex;
 
 void main()
 {
-    gl_Position = in_Position;
-    vertex.size = in_Size;
-    vertex.brightness = in_Brightness;
+    gl_Position = in_Transform * in_Position;
+    vertex.size = in_Parameters.x * in_Size;
+    vertex.brightness = in_Brightness * in_Parameters.y;
     vertex.color = texture(colorTex, vec2(in_ColorIndex, 0.0)).rgb;
+    // Instances sharing a draw call have different levels of detail
+    vertex.visible = float(gl_VertexID) < in_Parameters.w && vertex.size >= in_Parameters.z ? 1.0 : 0.0;
 }
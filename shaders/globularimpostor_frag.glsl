@@ -0,0 +1,10 @@
+uniform sampler2D impostorTex;
+
+varying vec2 texCoord;
+varying vec4 color;
+
+void main(void)
+{
+    vec4 impostor = texture2D(impostorTex, texCoord);
+    gl_FragColor = vec4(color.rgb * impostor.rgb, color.a * impostor.a);
+}
@@ -0,0 +1,12 @@
+attribute vec2 in_Position;
+attribute vec3 in_Center;
+attribute float in_Scale;
+attribute vec4 in_Color;
+
+varying vec4 color;
+
+void main(void)
+{
+    gl_Position = MVPMatrix * vec4(in_Center.xy + in_Position * in_Scale, in_Center.z, 1.0);
+    color = in_Color;
+}
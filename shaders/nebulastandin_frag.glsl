@@ -0,0 +1,12 @@
+// Glow drawn in place of a nebula mesh while it's loading, texCoord runs
+// from -1 to 1 across the quad
+
+varying vec2 texCoord;
+varying vec4 color;
+
+void main(void)
+{
+    float r2 = dot(texCoord, texCoord);
+    float glow = exp(-4.0 * r2) * max(0.0, 1.0 - r2);
+    gl_FragColor = vec4(color.rgb, color.a * glow);
+}
@@ -0,0 +1,13 @@
+attribute vec3 in_Position;
+attribute vec2 in_TexCoord0;
+attribute vec4 in_Color;
+
+varying vec2 texCoord;
+varying vec4 color;
+
+void main(void)
+{
+    texCoord = in_TexCoord0;
+    color = in_Color;
+    set_vp(vec4(in_Position, 1.0));
+}
@@ -0,0 +1,13 @@
+uniform vec4 color;
+uniform vec2 timeRange;
+uniform vec2 fade;
+
+varying float t;
+
+void main(void)
+{
+    if (t < timeRange.x || t > timeRange.y)
+        discard;
+
+    gl_FragColor = vec4(color.rgb, color.a * clamp(t * fade.x + fade.y, 0.0, 1.0));
+}
@@ -0,0 +1,10 @@
+attribute vec3 in_Position;
+attribute float in_Intensity;
+
+varying float t;
+
+void main(void)
+{
+    t = in_Intensity;
+    set_vp(vec4(in_Position, 1.0));
+}
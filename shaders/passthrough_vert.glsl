@@ -3,8 +3,11 @@ attribute vec2 in_TexCoord0;
 
 varying vec2 texCoord;
 
+// Fraction of the texture the scene was rendered to
+uniform float texCoordScale;
+
 void main(void)
 {
     gl_Position = vec4(in_Position.xy, 0.0, 1.0);
-    texCoord = in_TexCoord0.st;
+    texCoord = in_TexCoord0.st * texCoordScale;
 }
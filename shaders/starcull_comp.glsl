@@ -0,0 +1,90 @@
+// Cull the stars and compute their sprites like PointStarRenderer::process
+// and Renderer::calculatePointSize
+
+layout(local_size_x = 256) in;
+
+// xyz = position in light years, w = absolute magnitude
+layout(std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) readonly buffer Temperatures { float temperatures[]; };
+// 5 words per vertex: position, size and RGBA color
+layout(std430, binding = 2) writeonly buffer Vertices { uint vertices[]; };
+// DrawArraysIndirectCommands of the stars and of the glare
+layout(std430, binding = 3) buffer Commands { uint commands[8]; };
+
+uniform vec3 obsPosition;
+uniform vec3 viewNormal;
+uniform float cosViewCone;
+uniform float minDistance;
+uniform float distanceLimit;
+uniform float faintestMagNight;
+uniform float faintestMag;
+uniform float saturationMag;
+uniform float brightnessScale;
+uniform float brightnessBias;
+uniform float baseSize;
+uniform int scaledDiscs;
+uniform int starCount;
+// Star color table, looked up like ColorTemperatureTable::lookupColor
+uniform sampler1D colorTable;
+uniform int colorTableSize;
+uniform float temperatureScale;
+
+const float LY_PER_PARSEC = 3.26167;
+const float LOG10_2 = 0.30103;
+const float MaxScaledDiscStarSize = 8.0;
+const float GlareOpacity = 0.65;
+
+void emit(uint index, vec3 position, float size, vec3 color, float alpha)
+{
+    uint base = index * 5u;
+    vertices[base] = floatBitsToUint(position.x);
+    vertices[base + 1u] = floatBitsToUint(position.y);
+    vertices[base + 2u] = floatBitsToUint(position.z);
+    vertices[base + 3u] = floatBitsToUint(size);
+    vertices[base + 4u] = packUnorm4x8(vec4(color, alpha));
+}
+
+void main(void)
+{
+    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+    for (uint i = gl_GlobalInvocationID.x; i < uint(starCount); i += stride)
+    {
+        vec4 star = positions[i];
+        vec3 relPos = star.xyz - obsPosition;
+        float distance = length(relPos);
+        if (distance < minDistance || distance > distanceLimit || dot(relPos, viewNormal) < cosViewCone * distance)
+            continue;
+
+        float appMag = star.w - 5.0 + 5.0 * LOG10_2 * log2(distance / LY_PER_PARSEC);
+        if (appMag >= faintestMagNight)
+            continue;
+
+        float alpha = max(0.0, (faintestMag - appMag) * brightnessScale + brightnessBias);
+        float discSize = baseSize;
+        float glareSize = 0.0;
+        float glareAlpha = 0.0;
+        if (alpha > 1.0)
+        {
+            if (scaledDiscs != 0)
+            {
+                float discScale = min(MaxScaledDiscStarSize, exp2(0.3 * (saturationMag - appMag)));
+                discSize *= max(1.0, discScale);
+                glareAlpha = min(0.5, discScale / 4.0);
+                glareSize = discSize * 3.0;
+            }
+            else
+            {
+                float discScale = min(100.0, saturationMag - appMag + 2.0);
+                glareAlpha = min(GlareOpacity, (discScale - 2.0) / 4.0);
+                glareSize = 2.0 * discScale * baseSize;
+            }
+            alpha = 1.0;
+        }
+
+        int colorIndex = min(int(round(temperatures[i] * temperatureScale)), colorTableSize - 1);
+        vec3 color = texelFetch(colorTable, colorIndex, 0).rgb;
+        emit(atomicAdd(commands[0], 1u), relPos, discSize, color, alpha);
+        if (glareSize != 0.0)
+            emit(commands[6] + atomicAdd(commands[4], 1u), relPos, glareSize, color, glareAlpha);
+    }
+}
@@ -0,0 +1,8 @@
+uniform sampler2D starFieldTex;
+
+varying vec2 texCoord;
+
+void main(void)
+{
+    gl_FragColor = vec4(texture2D(starFieldTex, texCoord).rgb, 1.0);
+}
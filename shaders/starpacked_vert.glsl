@@ -0,0 +1,23 @@
+attribute vec2 in_Position;
+attribute vec4 in_Color;
+varying vec4 color;
+
+// Direction from its octahedral coordinates
+vec3 decodeDirection(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+    {
+        vec2 s = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(v.yx)) * s;
+    }
+    return normalize(v);
+}
+
+void main(void)
+{
+    // The alpha is the logarithm of the size, the color is premultiplied
+    gl_PointSize = exp2(in_Color.a * (255.0 / 16.0) - 4.0);
+    color = vec4(in_Color.rgb, 1.0);
+    set_vp(vec4(decodeDirection(in_Position), 1.0));
+}
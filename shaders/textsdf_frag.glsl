@@ -0,0 +1,13 @@
+varying vec2 texCoord;
+varying vec4 color;
+varying float smoothing;
+
+uniform sampler2D atlasTex;
+
+void main(void)
+{
+    // The outline is at the middle of the range of the distance field
+    float distance = texture2D(atlasTex, texCoord).r;
+    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+    gl_FragColor = vec4(color.rgb, alpha * color.a);
+}
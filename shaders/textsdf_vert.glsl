@@ -0,0 +1,16 @@
+attribute vec3 in_Position;
+attribute vec2 in_TexCoord0;
+attribute vec4 in_Color;
+attribute float in_Intensity;
+
+varying vec2 texCoord;
+varying vec4 color;
+varying float smoothing;
+
+void main(void)
+{
+    gl_Position = MVPMatrix * vec4(in_Position, 1);
+    texCoord = in_TexCoord0.st;
+    color = in_Color;
+    smoothing = in_Intensity;
+}
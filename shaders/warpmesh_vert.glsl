@@ -6,11 +6,13 @@ varying vec2 texCoord;
 varying float intensity;
 
 uniform float screenRatio;
+// Fraction of the texture the scene was rendered to
+uniform float texCoordScale;
 
 void main(void)
 {
     float offset = 0.5 - screenRatio * 0.5;
     gl_Position = vec4(in_Position.x * screenRatio, in_Position.y, 0.0, 1.0);
-    texCoord = vec2(in_TexCoord0.x * screenRatio + offset, in_TexCoord0.y);
+    texCoord = vec2(in_TexCoord0.x * screenRatio + offset, in_TexCoord0.y) * texCoordScale;
     intensity = in_Intensity;
 }
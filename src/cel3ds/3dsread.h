@@ -13,7 +13,25 @@
 #include <memory>
 #include <celcompat/filesystem.h>
 
+class M3DColor;
+class M3DMaterial;
+class M3DModel;
 class M3DScene;
 
+// Receives the contents of a 3DS file in the order they're read, so that
+// they can be converted one model at a time without building the scene.
+class M3DSceneHandler
+{
+public:
+    virtual ~M3DSceneHandler() = default;
+
+    virtual void material(M3DMaterial&&) = 0;
+    virtual void model(M3DModel&&) = 0;
+    virtual void backgroundColor(const M3DColor&) {}
+};
+
+bool Read3DSFile(std::istream& in, M3DSceneHandler& handler);
+bool Read3DSFile(const fs::path& filename, M3DSceneHandler& handler);
+
 std::unique_ptr<M3DScene> Read3DSFile(std::istream& in);
 std::unique_ptr<M3DScene> Read3DSFile(const fs::path& filename);
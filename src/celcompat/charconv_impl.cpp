@@ -12,9 +12,12 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <cfloat>
 #include <clocale>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <type_traits>
 
 #include <config.h>
 
@@ -164,6 +167,106 @@ write_buffer(const char* first, const char* last, chars_format fmt, char* buffer
     return { ptr, std::errc{} };
 }
 
+// Powers of ten which are exact in a double, and in a float up to 1e10
+constexpr double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+template<typename T>
+struct fast_path_limits;
+
+template<>
+struct fast_path_limits<float>
+{
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 24;
+    static constexpr int max_exponent = 10;
+};
+
+template<>
+struct fast_path_limits<double>
+{
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 53;
+    static constexpr int max_exponent = 22;
+};
+
+// Parse decimal numbers whose digits and power of ten are both exact in T
+// without going through strtod and the C locale: the product or quotient of
+// two exact values is correctly rounded (Clinger's fast path). This covers
+// nearly all the numbers in catalogs. Return false for the others, which
+// are left to the slow path, without changing value.
+template<typename T>
+bool
+fast_from_chars(const char* first, const char* last, T& value, chars_format fmt, from_chars_result& result)
+{
+#if FLT_EVAL_METHOD != 0
+    // Intermediate results in extended precision would be rounded twice
+    return false;
+#else
+    if (fmt == chars_format::hex || fmt == chars_format::scientific)
+        return false;
+
+    const char* ptr = first;
+    bool negative = ptr < last && *ptr == '-';
+    if (negative)
+        ++ptr;
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; ptr < last && *ptr >= '0' && *ptr <= '9'; ++ptr, ++digits)
+        mantissa = mantissa * 10 + static_cast<std::uint64_t>(*ptr - '0');
+
+    if (ptr < last && *ptr == '.')
+    {
+        const char* fraction = ++ptr;
+        for (; ptr < last && *ptr >= '0' && *ptr <= '9'; ++ptr, ++digits)
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(*ptr - '0');
+        exponent = -static_cast<int>(ptr - fraction);
+    }
+
+    // 19 digits always fit in the mantissa
+    if (digits == 0 || digits > 19 || mantissa > fast_path_limits<T>::max_mantissa)
+        return false;
+
+    // The exponent is only part of the number if it has digits
+    if (ptr < last && (*ptr == 'e' || *ptr == 'E') && (fmt & chars_format::scientific) == chars_format::scientific)
+    {
+        const char* exp_ptr = ptr + 1;
+        bool negative_exponent = false;
+        if (exp_ptr < last && (*exp_ptr == '+' || *exp_ptr == '-'))
+            negative_exponent = *(exp_ptr++) == '-';
+
+        if (exp_ptr < last && *exp_ptr >= '0' && *exp_ptr <= '9')
+        {
+            int explicit_exponent = 0;
+            for (; exp_ptr < last && *exp_ptr >= '0' && *exp_ptr <= '9'; ++exp_ptr)
+            {
+                if (explicit_exponent > 1000)
+                    return false;
+                explicit_exponent = explicit_exponent * 10 + (*exp_ptr - '0');
+            }
+
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            ptr = exp_ptr;
+        }
+    }
+
+    if (exponent < -fast_path_limits<T>::max_exponent || exponent > fast_path_limits<T>::max_exponent)
+        return false;
+
+    auto parsed = static_cast<T>(mantissa);
+    if (exponent < 0)
+        parsed /= static_cast<T>(exact_powers_of_ten[-exponent]);
+    else
+        parsed *= static_cast<T>(exact_powers_of_ten[exponent]);
+
+    value = negative ? -parsed : parsed;
+    result = { ptr, std::errc{} };
+    return true;
+#endif
+}
+
 inline void
 parse_value(const char* start, char** end, float& value)
 {
@@ -186,9 +289,16 @@ template<typename T>
 from_chars_result
 from_chars_impl(const char* first, const char* last, T& value, chars_format fmt)
 {
+    from_chars_result result;
+    if constexpr (!std::is_same_v<T, long double>)
+    {
+        if (fast_from_chars(first, last, value, fmt, result))
+            return result;
+    }
+
     char buffer[buffer_size];
     bool hex_prefix;
-    from_chars_result result = write_buffer(first, last, fmt, buffer, hex_prefix);
+    result = write_buffer(first, last, fmt, buffer, hex_prefix);
     if (result.ec != std::errc{}) { return result; }
 
     const char* savedLocale = std::setlocale(LC_NUMERIC, nullptr);
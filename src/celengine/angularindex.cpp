@@ -0,0 +1,48 @@
+// angularindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "angularindex.h"
+
+namespace celestia::engine
+{
+
+void
+AngularIndex::build(const std::vector<Eigen::Vector3f>& directions)
+{
+    std::vector<std::uint32_t> cells;
+    cells.reserve(directions.size());
+    for (const Eigen::Vector3f& direction : directions)
+    {
+        int row = getRow(std::asin(std::clamp(direction.z(), -1.0f, 1.0f)));
+        int column = getColumn(std::atan2(direction.y(), direction.x()));
+        cells.push_back(static_cast<std::uint32_t>(row * Columns + column));
+    }
+
+    // Counting sort of the directions by cell
+    offsets.assign(static_cast<std::size_t>(Rows) * Columns + 1, 0);
+    for (std::uint32_t cell : cells)
+        ++offsets[cell + 1];
+    for (std::size_t i = 1; i < offsets.size(); ++i)
+        offsets[i] += offsets[i - 1];
+
+    items.resize(directions.size());
+    std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < cells.size(); ++i)
+        items[cursor[cells[i]]++] = static_cast<std::uint32_t>(i);
+}
+
+
+void
+AngularIndex::clear()
+{
+    offsets.clear();
+    items.clear();
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,114 @@
+// angularindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace celestia::engine
+{
+
+// Index of directions on the sky. The sphere is divided into cells of
+// equal latitude and longitude which list the directions inside them, so
+// the directions close to a ray are found by looking through the few
+// cells that a small cone around it covers.
+class AngularIndex
+{
+public:
+    // Size of the cells in degrees
+    static constexpr int CellsPerDegree = 1;
+    static constexpr int Rows = 180 * CellsPerDegree;
+    static constexpr int Columns = 360 * CellsPerDegree;
+
+    // Replace the contents of the index with the unit vectors in
+    // directions, which are identified by their position in the vector
+    void build(const std::vector<Eigen::Vector3f>& directions);
+    void clear();
+
+    bool empty() const { return items.empty(); }
+    std::size_t size() const { return items.size(); }
+
+    // Call process with the identifiers of the directions within angle
+    // radians of the unit vector direction. Some directions a little
+    // further away may be passed too.
+    template<typename F> void query(const Eigen::Vector3f& direction, float angle, F&& process) const;
+
+private:
+    static int getRow(float latitude);
+    static int getColumn(float longitude);
+
+    // Identifiers of the directions grouped by cell, the directions of
+    // cell i start at items[offsets[i]]
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> items;
+};
+
+
+inline int
+AngularIndex::getRow(float latitude)
+{
+    auto row = static_cast<int>(std::floor((latitude + static_cast<float>(EIGEN_PI / 2.0)) *
+                                           static_cast<float>(Rows / EIGEN_PI)));
+    return std::clamp(row, 0, Rows - 1);
+}
+
+
+inline int
+AngularIndex::getColumn(float longitude)
+{
+    auto column = static_cast<int>(std::floor((longitude + static_cast<float>(EIGEN_PI)) *
+                                              static_cast<float>(Columns / (2.0 * EIGEN_PI))));
+    return ((column % Columns) + Columns) % Columns;
+}
+
+
+template<typename F> void
+AngularIndex::query(const Eigen::Vector3f& direction, float angle, F&& process) const
+{
+    if (items.empty())
+        return;
+
+    constexpr auto halfPi = static_cast<float>(EIGEN_PI / 2.0);
+    float latitude = std::asin(std::clamp(direction.z(), -1.0f, 1.0f));
+    float longitude = std::atan2(direction.y(), direction.x());
+    float minLatitude = latitude - angle;
+    float maxLatitude = latitude + angle;
+
+    // The cone spans all longitudes when it reaches a pole; elsewhere the
+    // longitudes it covers are widest at the latitude furthest from the
+    // equator
+    int firstColumn = 0;
+    int lastColumn = Columns - 1;
+    if (float cosLatitude = std::cos(std::max(std::abs(minLatitude), std::abs(maxLatitude)));
+        angle < halfPi && minLatitude > -halfPi && maxLatitude < halfPi && std::sin(angle) < cosLatitude)
+    {
+        float halfSpan = std::asin(std::sin(angle) / cosLatitude);
+        firstColumn = getColumn(longitude - halfSpan);
+        lastColumn = getColumn(longitude + halfSpan);
+        if (lastColumn < firstColumn)
+            lastColumn += Columns;
+    }
+
+    for (int row = getRow(minLatitude), lastRow = getRow(maxLatitude); row <= lastRow; ++row)
+    {
+        for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+            std::size_t cell = static_cast<std::size_t>(row) * Columns + static_cast<std::size_t>(column % Columns);
+            for (std::uint32_t i = offsets[cell]; i < offsets[cell + 1]; ++i)
+                process(items[i]);
+        }
+    }
+}
+
+} // end namespace celestia::engine
@@ -29,7 +29,7 @@ Asterism::Asterism(std::string_view _name) :
 #endif
 }
 
-std::string Asterism::getName(bool i18n) const
+const std::string& Asterism::getName(bool i18n) const
 {
 #ifdef ENABLE_NLS
     return i18n ? i18nName : name;
@@ -48,8 +48,25 @@ const Asterism::Chain& Asterism::getChain(int index) const
     return chains[index];
 }
 
+const Eigen::Vector3f& Asterism::getLabelPosition() const
+{
+    return labelPosition;
+}
+
 void Asterism::addChain(Asterism::Chain&& chain)
 {
+    // The constellation label is positioned at the average position of
+    // all stars in the first chain.  This usually gives reasonable results.
+    if (chains.empty() && !chain.empty())
+    {
+        Eigen::Vector3f avg = Eigen::Vector3f::Zero();
+        for (const auto& c : chain)
+            avg += c;
+
+        // Draw all constellation labels at the same distance
+        labelPosition = avg.normalized() * 1.0e4f;
+    }
+
     chains.emplace_back(std::move(chain));
 }
 
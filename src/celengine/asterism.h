@@ -35,10 +35,14 @@ class Asterism
 
     using Chain = std::vector<Eigen::Vector3f>;
 
-    std::string getName(bool i18n = false) const;
+    const std::string& getName(bool i18n = false) const;
     int getChainCount() const;
     const Chain& getChain(int) const;
 
+    // Where the name is drawn, in the direction of the average star of the
+    // first chain at the distance of the constellation boundaries
+    const Eigen::Vector3f& getLabelPosition() const;
+
     bool getActive() const;
     void setActive(bool _active);
 
@@ -53,6 +57,7 @@ class Asterism
     std::string name;
     std::string i18nName;
     std::vector<Chain> chains;
+    Eigen::Vector3f labelPosition{ Eigen::Vector3f::Zero() };
     Color color;
 
     bool active             { true };
@@ -10,8 +10,13 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <utility>
 #include <celcompat/numbers.h>
+#include <celephem/threadcache.h>
 #include <celmath/mathlib.h>
 #include <celutil/gettext.h>
 #include <celutil/utf8.h>
@@ -23,6 +28,7 @@
 #include "timeline.h"
 #include "timelinephase.h"
 #include "frametree.h"
+#include "locationindex.h"
 #include "referencemark.h"
 #include "selection.h"
 
@@ -32,8 +38,98 @@ using namespace std;
 namespace astro = celestia::astro;
 namespace math = celestia::math;
 
+namespace
+{
+
+// Enough entries for the bodies of a few solar systems to be evaluated by
+// several passes of a frame without evicting each other
+constexpr std::size_t BodyStateCacheSize = 4096;
+
+// Bumped when a timeline is replaced: a body's state depends on the
+// timelines of the bodies its frames are centered on, so cached states
+// of all bodies are dropped
+std::atomic<std::uint64_t> timelineGeneration{ 0 };
+
+// Bumped when bodies are added to or removed from systems, or change size
+std::atomic<std::uint64_t> systemGeneration{ 0 };
+
+struct BodyStateCacheEntry
+{
+    // Take over the entry for another body, time or set of timelines
+    void reset(std::uint64_t _id, double _time, std::uint64_t _generation)
+    {
+        if (id == _id && time == _time && generation == _generation)
+            return;
+        id = _id;
+        time = _time;
+        generation = _generation;
+        positionValid = false;
+        orientationValid = false;
+        velocityValid = false;
+    }
+
+    bool hasPosition(std::uint64_t _id, double _time, std::uint64_t _generation) const
+    {
+        return id == _id && time == _time && generation == _generation && positionValid;
+    }
+
+    bool hasOrientation(std::uint64_t _id, double _time, std::uint64_t _generation) const
+    {
+        return id == _id && time == _time && generation == _generation && orientationValid;
+    }
+
+    bool hasVelocity(std::uint64_t _id, double _time, std::uint64_t _generation) const
+    {
+        return id == _id && time == _time && generation == _generation && velocityValid;
+    }
+
+    std::uint64_t id{ 0 };
+    double time{ 0.0 };
+    std::uint64_t generation{ 0 };
+    UniversalCoord position;
+    Quaterniond orientation{ Quaterniond::Identity() };
+    Vector3d velocity{ Vector3d::Zero() };
+    bool positionValid{ false };
+    bool orientationValid{ false };
+    bool velocityValid{ false };
+};
+
+BodyStateCacheEntry&
+getStateCacheEntry(std::uint64_t id)
+{
+    return celestia::ephem::detail::GetThreadCacheEntry<BodyStateCacheEntry, BodyStateCacheSize>(id);
+}
+
+bool isDefaultTexture(const MultiResTexture& texture)
+{
+    return std::all_of(std::begin(texture.tex), std::end(texture.tex),
+                       [](ResourceHandle h) { return h == InvalidResource; });
+}
+
+// True if the surface is the one bodies have without a definition, which
+// they share instead of storing it
+bool isDefaultSurface(const Surface& surface)
+{
+    return surface.appearanceFlags == 0 &&
+           surface.color == Color::White &&
+           surface.specularColor == Color(0.0f, 0.0f, 0.0f) &&
+           surface.specularPower == 0.0f &&
+           isDefaultTexture(surface.baseTexture) &&
+           isDefaultTexture(surface.bumpTexture) &&
+           isDefaultTexture(surface.nightTexture) &&
+           isDefaultTexture(surface.specularTexture) &&
+           isDefaultTexture(surface.overlayTexture) &&
+           surface.bumpHeight == 0.0f &&
+           surface.lunarLambert == 0.0f &&
+           surface.heightMap.empty() &&
+           surface.heightScale == 0.0f;
+}
+
+} // end unnamed namespace
+
 Body::Body(PlanetarySystem* _system, const std::string& _name) :
     system(_system),
+    stateCacheId(celestia::ephem::detail::NewThreadCacheId()),
     orbitVisibility(UseClassVisibility)
 {
     setName(_name);
@@ -44,6 +140,15 @@ Body::Body(PlanetarySystem* _system, const std::string& _name) :
 Body::~Body() = default;
 
 
+Body::Extras&
+Body::getExtras()
+{
+    if (extras == nullptr)
+        extras = std::make_unique<Extras>();
+    return *extras;
+}
+
+
 /*! Reset body attributes to their default values. The object hierarchy is left untouched,
  *  i.e. child objects are not removed. Alternate surfaces and locations are not removed
  *  either.
@@ -61,7 +166,7 @@ void Body::setDefaultProperties()
     tempDiscrepancy = 0.0f;
     geometryOrientation = Quaternionf::Identity();
     geometry = InvalidResource;
-    surface = Surface(Color::White);
+    surface.reset();
     atmosphere.reset();
     rings.reset();
     classification = Unknown;
@@ -86,7 +191,7 @@ const vector<string>& Body::getNames() const
 /*! Return the primary name for the body; if i18n, return the
  *  localized name of the body.
  */
-string Body::getName(bool i18n) const
+const string& Body::getName(bool i18n) const
 {
     if (i18n && hasLocalizedName())
         return localizedName;
@@ -174,6 +279,7 @@ const Timeline* Body::getTimeline() const
 void Body::setTimeline(std::unique_ptr<Timeline>&& newTimeline)
 {
     timeline = std::move(newTimeline);
+    timelineGeneration.fetch_add(1, std::memory_order_relaxed);
     markChanged();
 }
 
@@ -445,19 +551,27 @@ bool Body::isEllipsoid() const
 
 const Surface& Body::getSurface() const
 {
-    return surface;
+    static const Surface* const defaultSurface = std::make_unique<Surface>(Color::White).release();
+    return surface == nullptr ? *defaultSurface : *surface;
 }
 
 
 Surface& Body::getSurface()
 {
-    return surface;
+    if (surface == nullptr)
+        surface = std::make_unique<Surface>(Color::White);
+    return *surface;
 }
 
 
 void Body::setSurface(const Surface& surf)
 {
-    surface = surf;
+    if (isDefaultSurface(surf))
+        surface.reset();
+    else if (surface == nullptr)
+        surface = std::make_unique<Surface>(surf);
+    else
+        *surface = surf;
 }
 
 
@@ -543,6 +657,22 @@ void Body::setAtmosphere(std::unique_ptr<Atmosphere>&& _atmosphere)
  *  general getPosition().
  */
 UniversalCoord Body::getPosition(double tdb) const
+{
+    std::uint64_t generation = timelineGeneration.load(std::memory_order_relaxed);
+    if (const auto& entry = getStateCacheEntry(stateCacheId); entry.hasPosition(stateCacheId, tdb, generation))
+        return entry.position;
+
+    UniversalCoord result = computePosition(tdb);
+    // Computing the position may use the cache entry for other bodies
+    auto& entry = getStateCacheEntry(stateCacheId);
+    entry.reset(stateCacheId, tdb, generation);
+    entry.position = result;
+    entry.positionValid = true;
+    return result;
+}
+
+
+UniversalCoord Body::computePosition(double tdb) const
 {
     Vector3d position = Vector3d::Zero();
 
@@ -571,8 +701,17 @@ UniversalCoord Body::getPosition(double tdb) const
  */
 Quaterniond Body::getOrientation(double tdb) const
 {
+    std::uint64_t generation = timelineGeneration.load(std::memory_order_relaxed);
+    if (const auto& entry = getStateCacheEntry(stateCacheId); entry.hasOrientation(stateCacheId, tdb, generation))
+        return entry.orientation;
+
     const TimelinePhase* phase = timeline->findPhase(tdb).get();
-    return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    Quaterniond orientation = phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    auto& entry = getStateCacheEntry(stateCacheId);
+    entry.reset(stateCacheId, tdb, generation);
+    entry.orientation = orientation;
+    entry.orientationValid = true;
+    return orientation;
 }
 
 
@@ -580,6 +719,12 @@ Quaterniond Body::getOrientation(double tdb) const
  */
 Vector3d Body::getVelocity(double tdb) const
 {
+    // Cached as the relative velocities defining two vector frames are
+    // evaluated for each frame using them
+    std::uint64_t generation = timelineGeneration.load(std::memory_order_relaxed);
+    if (const auto& entry = getStateCacheEntry(stateCacheId); entry.hasVelocity(stateCacheId, tdb, generation))
+        return entry.velocity;
+
     const TimelinePhase* phase = timeline->findPhase(tdb).get();
 
     const ReferenceFrame* orbitFrame = phase->orbitFrame().get();
@@ -593,6 +738,10 @@ Vector3d Body::getVelocity(double tdb) const
         v += orbitFrame->getAngularVelocity(tdb).cross(r);
     }
 
+    auto& entry = getStateCacheEntry(stateCacheId);
+    entry.reset(stateCacheId, tdb, generation);
+    entry.velocity = v;
+    entry.velocityValid = true;
     return v;
 }
 
@@ -908,22 +1057,24 @@ int Body::getOrbitClassification() const
 
 const string& Body::getInfoURL() const
 {
-    return infoURL;
+    static const string* const emptyURL = std::make_unique<string>().release();
+    return extras == nullptr ? *emptyURL : extras->infoURL;
 }
 
 void Body::setInfoURL(const string& _infoURL)
 {
-    infoURL = _infoURL;
+    if (extras != nullptr || !_infoURL.empty())
+        getExtras().infoURL = _infoURL;
 }
 
 
 Surface* Body::getAlternateSurface(const string& name) const
 {
-    if (!altSurfaces)
+    if (extras == nullptr)
         return nullptr;
 
-    auto iter = altSurfaces->find(name);
-    if (iter == altSurfaces->end())
+    auto iter = extras->altSurfaces.find(name);
+    if (iter == extras->altSurfaces.end())
         return nullptr;
 
     return iter->second.get();
@@ -932,10 +1083,7 @@ Surface* Body::getAlternateSurface(const string& name) const
 
 void Body::addAlternateSurface(const string& name, std::unique_ptr<Surface>&& altSurface)
 {
-    if (!altSurfaces)
-        altSurfaces = std::make_unique<AltSurfaceTable>();
-
-    (*altSurfaces)[name] = std::move(altSurface);
+    getExtras().altSurfaces[name] = std::move(altSurface);
 }
 
 
@@ -944,26 +1092,42 @@ void Body::addLocation(std::unique_ptr<Location>&& loc)
     if (!loc)
         return;
 
-    if (!locations)
-        locations = std::make_unique<std::vector<std::unique_ptr<Location>>>();
+    Extras& e = getExtras();
     loc->setParentBody(this);
-    locations->push_back(std::move(loc));
+    e.locations.push_back(std::move(loc));
+    e.locationIndex.reset();
+}
+
+
+void Body::removeLocation(const Location* loc)
+{
+    if (extras == nullptr)
+        return;
+
+    auto iter = std::find_if(extras->locations.begin(), extras->locations.end(),
+                             [loc](const auto& l) { return l.get() == loc; });
+    if (iter == extras->locations.end())
+        return;
+
+    extras->locations.erase(iter);
+    extras->locationIndex.reset();
 }
 
 
 Location* Body::findLocation(std::string_view name, bool i18n) const
 {
-    if (!locations)
+    if (extras == nullptr)
         return nullptr;
 
+    const auto& locations = extras->locations;
     auto iter = i18n
-        ? std::find_if(locations->cbegin(), locations->cend(),
+        ? std::find_if(locations.cbegin(), locations.cend(),
                        [&name](const auto& loc) { return UTF8StringCompare(name, loc->getName(false)) == 0 ||
                                                          UTF8StringCompare(name, loc->getName(true)) == 0; })
-        : std::find_if(locations->cbegin(), locations->cend(),
+        : std::find_if(locations.cbegin(), locations.cend(),
                        [&name](const auto& loc) { return UTF8StringCompare(name, loc->getName(false)) == 0; });
 
-    return iter == locations->cend() ? nullptr : iter->get();
+    return iter == locations.cend() ? nullptr : iter->get();
 }
 
 
@@ -974,13 +1138,10 @@ Location* Body::findLocation(std::string_view name, bool i18n) const
 // a user) loading of meshes is preferred.
 void Body::computeLocations()
 {
-    if (locationsComputed)
+    if (extras == nullptr || extras->locationsComputed)
         return;
 
-    locationsComputed = true;
-
-    if (locations == nullptr)
-        return;
+    extras->locationsComputed = true;
 
     // No work to do if there's no mesh, or if the mesh cannot be loaded
     if (geometry == InvalidResource)
@@ -989,11 +1150,14 @@ void Body::computeLocations()
     if (g == nullptr)
         return;
 
+    // The positions change, so the index must be rebuilt
+    extras->locationIndex.reset();
+
     // TODO: Implement separate radius and bounding radius so that this hack is
     // not necessary.
     double boundingRadius = 2.0;
 
-    for (const auto& location : *locations)
+    for (const auto& location : extras->locations)
     {
         Location* loc = location.get();
         Vector3f v = loc->getPosition();
@@ -1015,14 +1179,31 @@ void Body::computeLocations()
 }
 
 
+const celestia::engine::LocationIndex*
+Body::getLocationIndex() const
+{
+    if (!hasLocations())
+        return nullptr;
+
+    // The shape of the body may have changed since the index was built
+    Eigen::Vector3f semiAxes = getSemiAxes();
+    auto& locationIndex = extras->locationIndex;
+    if (locationIndex == nullptr || locationIndex->size() != extras->locations.size() ||
+        locationIndex->getSemiAxes() != semiAxes)
+    {
+        locationIndex = std::make_unique<celestia::engine::LocationIndex>(*getLocations(), semiAxes);
+    }
+
+    return locationIndex.get();
+}
+
+
 /*! Add a new reference mark.
  */
 void
 Body::addReferenceMark(std::unique_ptr<ReferenceMark>&& refMark)
 {
-    if (referenceMarks == nullptr)
-        referenceMarks = std::make_unique<std::list<std::unique_ptr<ReferenceMark>>>();
-    referenceMarks->push_back(std::move(refMark));
+    getExtras().referenceMarks.push_back(std::move(refMark));
     recomputeCullingRadius();
 }
 
@@ -1032,16 +1213,17 @@ Body::addReferenceMark(std::unique_ptr<ReferenceMark>&& refMark)
 void
 Body::removeReferenceMark(const string& tag)
 {
-    if (referenceMarks == nullptr)
+    if (extras == nullptr)
         return;
 
-    auto iter = std::find_if(referenceMarks->begin(),
-                             referenceMarks->end(),
+    auto& referenceMarks = extras->referenceMarks;
+    auto iter = std::find_if(referenceMarks.begin(),
+                             referenceMarks.end(),
                              [&tag](const auto& rm) { return rm->getTag() == tag; });
-    if (iter == referenceMarks->end())
+    if (iter == referenceMarks.end())
         return;
 
-    referenceMarks->erase(iter);
+    referenceMarks.erase(iter);
     recomputeCullingRadius();
 }
 
@@ -1053,13 +1235,14 @@ Body::removeReferenceMark(const string& tag)
 const ReferenceMark*
 Body::findReferenceMark(const string& tag) const
 {
-    if (referenceMarks == nullptr)
+    if (extras == nullptr)
         return nullptr;
 
-    auto iter = std::find_if(referenceMarks->begin(),
-                             referenceMarks->end(),
+    const auto& referenceMarks = extras->referenceMarks;
+    auto iter = std::find_if(referenceMarks.begin(),
+                             referenceMarks.end(),
                              [&tag](const auto& rm) { return rm->getTag() == tag; });
-    return iter == referenceMarks->end()
+    return iter == referenceMarks.end()
         ? nullptr
         : iter->get();
 }
@@ -1151,6 +1334,8 @@ void Body::setSecondaryIlluminator(bool enable)
 
 void Body::recomputeCullingRadius()
 {
+    systemGeneration.fetch_add(1, std::memory_order_relaxed);
+
     float r = getBoundingRadius();
 
     if (atmosphere)
@@ -1159,9 +1344,9 @@ void Body::recomputeCullingRadius()
     if (rings)
         r = max(r, rings->outerRadius);
 
-    if (referenceMarks)
+    if (extras)
     {
-        for (const auto& rm : *referenceMarks)
+        for (const auto& rm : extras->referenceMarks)
         {
             r = max(r, rm->boundingSphereRadius());
         }
@@ -1217,6 +1402,7 @@ Body* PlanetarySystem::addBody(const std::string& name)
 {
     auto body = std::make_unique<Body>(this, name);
     addBodyToNameIndex(body.get());
+    systemGeneration.fetch_add(1, std::memory_order_relaxed);
     return satellites.emplace_back(std::move(body)).get();
 }
 
@@ -1232,6 +1418,15 @@ void PlanetarySystem::removeBody(const Body* body)
 
     removeBodyFromNameIndex(body);
     satellites.erase(iter);
+    systemGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+std::uint64_t PlanetarySystem::getGeneration()
+{
+    // Both counters only grow, so their sum changes whenever either does
+    return systemGeneration.load(std::memory_order_relaxed) +
+           timelineGeneration.load(std::memory_order_relaxed);
 }
 
 
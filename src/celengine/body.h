@@ -20,6 +20,7 @@
 #include <celutil/utf8.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -36,6 +37,11 @@ class FrameTree;
 class ReferenceMark;
 class Atmosphere;
 
+namespace celestia::engine
+{
+class LocationIndex;
+}
+
 class PlanetarySystem
 {
  public:
@@ -52,6 +58,11 @@ class PlanetarySystem
     Body* addBody(const std::string& name);
     void removeBody(const Body* body);
 
+    // Changes whenever a body is added to or removed from any system, or
+    // changes its size or timeline, so that caches of body states can tell
+    // when they are stale
+    static std::uint64_t getGeneration();
+
     enum TraversalResult
     {
         ContinueTraversal   = 0,
@@ -96,6 +107,8 @@ class RingSystem
     Color color;
     MultiResTexture texture;
     std::unique_ptr<RingRenderData> renderData;
+    // The texture of the ring shadows on the planet, built on first use
+    std::unique_ptr<RingRenderData> shadowData;
 
     RingSystem(float inner, float outer) :
         innerRadius(inner), outerRadius(outer),
@@ -192,7 +205,7 @@ class Body
 
     PlanetarySystem* getSystem() const;
     const std::vector<std::string>& getNames() const;
-    std::string getName(bool i18n = false) const;
+    const std::string& getName(bool i18n = false) const;
     std::string getLocalizedName() const;
     bool hasLocalizedName() const;
     void addAlias(const std::string& alias);
@@ -261,6 +274,8 @@ class Body
 
     void setSurface(const Surface&);
     const Surface& getSurface() const;
+    // Unlike the const version, this gives the body its own surface if it
+    // has the default one
     Surface& getSurface();
 
     float getLuminosity(const Star& sun,
@@ -281,6 +296,9 @@ class Body
                                const Eigen::Vector3d& sunPosition,
                                const Eigen::Vector3d& viewerPosition) const;
 
+    // The last position and orientation computed are kept in a per-thread
+    // cache, so that the renderer, the picking, the HUD and the scripts
+    // evaluating a body at the same time compute them once
     UniversalCoord getPosition(double tdb) const;
     Eigen::Quaterniond getOrientation(double tdb) const;
     Eigen::Vector3d getVelocity(double tdb) const;
@@ -310,33 +328,37 @@ class Body
     void addAlternateSurface(const std::string&, std::unique_ptr<Surface>&&);
     auto getAlternateSurfaceNames() const
     {
-        using range_type = decltype(celestia::util::keysView(*altSurfaces));
-        return altSurfaces
-            ? std::make_optional(celestia::util::keysView(*altSurfaces))
+        using range_type = decltype(celestia::util::keysView(extras->altSurfaces));
+        return extras && !extras->altSurfaces.empty()
+            ? std::make_optional(celestia::util::keysView(extras->altSurfaces))
             : std::optional<range_type>();
     }
 
-    bool hasLocations() const { return locations != nullptr && !locations->empty(); }
+    bool hasLocations() const { return extras && !extras->locations.empty(); }
 
     auto getLocations()
     {
-        using range_type = decltype(celestia::util::pointerView(*locations));
-        return locations
-            ? std::make_optional(celestia::util::pointerView(*locations))
+        using range_type = decltype(celestia::util::pointerView(extras->locations));
+        return hasLocations()
+            ? std::make_optional(celestia::util::pointerView(extras->locations))
             : std::optional<range_type>();
     }
 
     auto getLocations() const
     {
-        using range_type = decltype(celestia::util::constPointerView(*locations));
-        return locations
-            ? std::make_optional(celestia::util::constPointerView(*locations))
+        using range_type = decltype(celestia::util::constPointerView(extras->locations));
+        return hasLocations()
+            ? std::make_optional(celestia::util::constPointerView(extras->locations))
             : std::optional<range_type>();
     }
 
     void addLocation(std::unique_ptr<Location>&&);
+    void removeLocation(const Location*);
     Location* findLocation(std::string_view, bool i18n = false) const;
     void computeLocations();
+    // Spatial index of the locations, built on first use; null if the body
+    // has no locations
+    const celestia::engine::LocationIndex* getLocationIndex() const;
 
     bool isVisible() const { return visible; }
     void setVisible(bool _visible);
@@ -376,9 +398,9 @@ class Body
     const ReferenceMark* findReferenceMark(const std::string& tag) const;
     auto getReferenceMarks() const
     {
-        using range_type = decltype(celestia::util::constPointerView(*referenceMarks));
-        return referenceMarks
-            ? std::make_optional(celestia::util::constPointerView(*referenceMarks))
+        using range_type = decltype(celestia::util::constPointerView(extras->referenceMarks));
+        return extras && !extras->referenceMarks.empty()
+            ? std::make_optional(celestia::util::constPointerView(extras->referenceMarks))
             : std::optional<range_type>();
     }
 
@@ -387,7 +409,11 @@ class Body
     void recomputeCullingRadius();
 
  private:
+    struct Extras;
+
     void setName(const std::string& name);
+    UniversalCoord computePosition(double tdb) const;
+    Extras& getExtras();
 
  private:
     std::vector<std::string> names{ 1 };
@@ -399,6 +425,8 @@ class Body
     std::unique_ptr<PlanetarySystem> satellites;
 
     std::unique_ptr<Timeline> timeline;
+    // Key of the position and orientation in the calling thread's cache
+    std::uint64_t stateCacheId;
     // Children in the frame hierarchy
     std::unique_ptr<FrameTree> frameTree;
 
@@ -418,22 +446,28 @@ class Body
 
     ResourceHandle geometry{ InvalidResource };
     float geometryScale{ 1.0f };
-    Surface surface{ Color(1.0f, 1.0f, 1.0f) };
+    // The surface is only allocated when it's set, so that large numbers
+    // of minor bodies rendered as points stay small
+    std::unique_ptr<Surface> surface;
 
     std::unique_ptr<Atmosphere> atmosphere;
     std::unique_ptr<RingSystem> rings;
 
     int classification{ Unknown };
 
-    std::string infoURL;
-
     using AltSurfaceTable = std::map<std::string, std::unique_ptr<Surface>, std::less<>>;
-    std::unique_ptr<AltSurfaceTable> altSurfaces;
-
-    std::unique_ptr<std::vector<std::unique_ptr<Location>>> locations;
-    mutable bool locationsComputed{ false };
 
-    std::unique_ptr<std::list<std::unique_ptr<ReferenceMark>>> referenceMarks;
+    // Attributes few bodies have, allocated when the first of them is set
+    struct Extras
+    {
+        std::string infoURL;
+        AltSurfaceTable altSurfaces;
+        std::vector<std::unique_ptr<Location>> locations;
+        bool locationsComputed{ false };
+        std::unique_ptr<celestia::engine::LocationIndex> locationIndex;
+        std::list<std::unique_ptr<ReferenceMark>> referenceMarks;
+    };
+    std::unique_ptr<Extras> extras;
 
     Color orbitColor;
     Color cometTailColor{ 0.5f, 0.5f, 0.75f };
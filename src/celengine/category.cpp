@@ -1,13 +1,112 @@
 #include "category.h"
 
 #include <algorithm>
-#include <initializer_list>
+#include <bitset>
+#include <cassert>
 #include <utility>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include <celutil/gettext.h>
 #include "hash.h"
 
 
+bool
+CategoryMembers::test(ObjectId id) const
+{
+    std::size_t word = id / WordBits;
+    return word < m_words.size() && ((m_words[word] >> (id % WordBits)) & 1) != 0;
+}
+
+
+void
+CategoryMembers::set(ObjectId id)
+{
+    std::size_t word = id / WordBits;
+    if (word >= m_words.size())
+        m_words.resize(word + 1, 0);
+    m_words[word] |= std::uint64_t(1) << (id % WordBits);
+}
+
+
+void
+CategoryMembers::reset(ObjectId id)
+{
+    if (std::size_t word = id / WordBits; word < m_words.size())
+        m_words[word] &= ~(std::uint64_t(1) << (id % WordBits));
+}
+
+
+std::size_t
+CategoryMembers::count() const
+{
+    std::size_t n = 0;
+    for (std::uint64_t word : m_words)
+        n += std::bitset<WordBits>(word).count();
+    return n;
+}
+
+
+bool
+CategoryMembers::empty() const
+{
+    return std::all_of(m_words.begin(), m_words.end(), [](std::uint64_t word) { return word == 0; });
+}
+
+
+CategoryMembers&
+CategoryMembers::operator|=(const CategoryMembers& other)
+{
+    if (other.m_words.size() > m_words.size())
+        m_words.resize(other.m_words.size(), 0);
+    for (std::size_t i = 0; i < other.m_words.size(); ++i)
+        m_words[i] |= other.m_words[i];
+    return *this;
+}
+
+
+CategoryMembers&
+CategoryMembers::operator&=(const CategoryMembers& other)
+{
+    if (other.m_words.size() < m_words.size())
+        m_words.resize(other.m_words.size());
+    for (std::size_t i = 0; i < m_words.size(); ++i)
+        m_words[i] &= other.m_words[i];
+    return *this;
+}
+
+
+CategoryMembers&
+CategoryMembers::operator-=(const CategoryMembers& other)
+{
+    std::size_t n = std::min(m_words.size(), other.m_words.size());
+    for (std::size_t i = 0; i < n; ++i)
+        m_words[i] &= ~other.m_words[i];
+    return *this;
+}
+
+
+unsigned int
+CategoryMembers::lowestBit(std::uint64_t word)
+{
+    assert(word != 0);
+#if defined(__GNUC__)
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<unsigned int>(index);
+#else
+    unsigned int index = 0;
+    for (; (word & 1) == 0; word >>= 1)
+        ++index;
+    return index;
+#endif
+}
+
+
 UserCategoryManager::UserCategoryManager() = default;
 UserCategoryManager::~UserCategoryManager() = default;
 
@@ -58,20 +157,11 @@ UserCategoryManager::destroy(UserCategoryId category)
         return false;
 
     // remove all members
-    for (const Selection& sel : entry->m_members)
+    entry->m_members.forEach([this, category](CategoryMembers::ObjectId id)
     {
-        auto it = m_objectMap.find(sel);
-        if (it == m_objectMap.end())
-            continue;
-
-        auto& categories = it->second;
-        if (auto item = std::find(categories.begin(), categories.end(), category); item != categories.end())
-        {
-            categories.erase(item);
-            if (categories.empty())
-                m_objectMap.erase(it);
-        }
-    }
+        if (auto it = m_objectMap.find(m_objects[id]); it != m_objectMap.end())
+            removeMembership(it, category);
+    });
 
     m_active.erase(category);
     if (entry->m_parent == UserCategoryId::Invalid)
@@ -135,7 +225,7 @@ UserCategoryManager::createNew(UserCategoryId id,
     std::string i18nName = name;
 #endif
 
-    auto category = std::make_unique<UserCategory>(ConstructorToken{}, name, parent, std::move(i18nName));
+    auto category = std::make_unique<UserCategory>(ConstructorToken{}, this, name, parent, std::move(i18nName));
 
     if (auto idIndex = static_cast<std::size_t>(id); idIndex < m_categories.size())
         m_categories[idIndex] = std::move(category);
@@ -156,16 +246,34 @@ bool
 UserCategoryManager::addObject(Selection selection, UserCategoryId category)
 {
     auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    if (categoryIndex >= m_categories.size() || m_categories[categoryIndex] == nullptr)
         return false;
 
-    if (!m_categories[categoryIndex]->m_members.emplace(selection).second)
+    auto it = m_objectMap.find(selection);
+    if (it == m_objectMap.end())
+    {
+        CategoryMembers::ObjectId id;
+        if (m_availableObjectIds.empty())
+        {
+            id = static_cast<CategoryMembers::ObjectId>(m_objects.size());
+            m_objects.push_back(selection);
+        }
+        else
+        {
+            id = m_availableObjectIds.back();
+            m_availableObjectIds.pop_back();
+            m_objects[id] = selection;
+        }
+
+        it = m_objectMap.try_emplace(selection, ObjectEntry{ id, {} }).first;
+    }
+    else if (m_categories[categoryIndex]->m_members.test(it->second.id))
+    {
         return false;
+    }
 
-    if (auto it = m_objectMap.find(selection); it == m_objectMap.end())
-        m_objectMap.try_emplace(selection, std::initializer_list<UserCategoryId> { category });
-    else
-        it->second.push_back(category);
+    m_categories[categoryIndex]->m_members.set(it->second.id);
+    it->second.categories.push_back(category);
     return true;
 }
 
@@ -174,28 +282,35 @@ bool
 UserCategoryManager::removeObject(Selection selection, UserCategoryId category)
 {
     auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    if (categoryIndex >= m_categories.size() || m_categories[categoryIndex] == nullptr)
         return false;
 
-    if (m_categories[categoryIndex]->m_members.erase(selection) == 0)
+    auto it = m_objectMap.find(selection);
+    if (it == m_objectMap.end() || !m_categories[categoryIndex]->m_members.test(it->second.id))
         return false;
 
-    auto it = m_objectMap.find(selection);
-    if (it == m_objectMap.end())
-    {
-        assert(false);
-        return true;
-    }
+    removeMembership(it, category);
+    return true;
+}
+
 
-    auto& categories = it->second;
+void
+UserCategoryManager::removeMembership(std::unordered_map<Selection, ObjectEntry>::iterator it,
+                                      UserCategoryId category)
+{
+    ObjectEntry& entry = it->second;
+    m_categories[static_cast<std::size_t>(category)]->m_members.reset(entry.id);
+
+    auto& categories = entry.categories;
     if (auto item = std::find(categories.begin(), categories.end(), category); item != categories.end())
-    {
         categories.erase(item);
-        if (categories.empty())
-            m_objectMap.erase(it);
-    }
 
-    return true;
+    if (categories.empty())
+    {
+        m_objects[entry.id] = Selection();
+        m_availableObjectIds.push_back(entry.id);
+        m_objectMap.erase(it);
+    }
 }
 
 
@@ -206,24 +321,27 @@ UserCategoryManager::clearCategories(Selection selection)
     if (iter == m_objectMap.end())
         return;
 
-    for (UserCategoryId category : iter->second)
+    const ObjectEntry& entry = iter->second;
+    for (UserCategoryId category : entry.categories)
     {
-        m_categories[static_cast<std::size_t>(category)]->m_members.erase(selection);
+        m_categories[static_cast<std::size_t>(category)]->m_members.reset(entry.id);
     }
 
-    m_objectMap.erase(selection);
+    m_objects[entry.id] = Selection();
+    m_availableObjectIds.push_back(entry.id);
+    m_objectMap.erase(iter);
 }
 
 
 bool
 UserCategoryManager::isInCategory(Selection selection, UserCategoryId category) const
 {
-    auto categoryIndex = static_cast<std::size_t>(category);
-    if (categoryIndex >= m_categories.size())
+    const CategoryMembers* members = getMembers(category);
+    if (members == nullptr)
         return false;
 
-    const auto& members = m_categories[categoryIndex]->m_members;
-    return members.find(selection) != members.end();
+    auto id = getObjectId(selection);
+    return id.has_value() && members->test(*id);
 }
 
 
@@ -233,14 +351,57 @@ UserCategoryManager::getCategories(Selection selection) const
     auto it = m_objectMap.find(selection);
     return it == m_objectMap.end()
         ? nullptr
-        : &it->second;
+        : &it->second.categories;
+}
+
+
+const CategoryMembers*
+UserCategoryManager::getMembers(UserCategoryId category) const
+{
+    auto categoryIndex = static_cast<std::size_t>(category);
+    if (categoryIndex >= m_categories.size() || m_categories[categoryIndex] == nullptr)
+        return nullptr;
+
+    return &m_categories[categoryIndex]->m_members;
+}
+
+
+CategoryMembers
+UserCategoryManager::getActiveMembers() const
+{
+    CategoryMembers members;
+    for (UserCategoryId category : m_active)
+        members |= m_categories[static_cast<std::size_t>(category)]->m_members;
+    return members;
+}
+
+
+std::vector<Selection>
+UserCategoryManager::getObjects(const CategoryMembers& members) const
+{
+    std::vector<Selection> objects;
+    objects.reserve(members.count());
+    members.forEach([this, &objects](CategoryMembers::ObjectId id) { objects.push_back(m_objects[id]); });
+    return objects;
+}
+
+
+std::optional<CategoryMembers::ObjectId>
+UserCategoryManager::getObjectId(Selection selection) const
+{
+    auto it = m_objectMap.find(selection);
+    if (it == m_objectMap.end())
+        return std::nullopt;
+    return it->second.id;
 }
 
 
 UserCategory::UserCategory(UserCategoryManager::ConstructorToken,
+                           const UserCategoryManager* manager,
                            const std::string& name,
                            UserCategoryId parent,
                            std::string&& i18nName) :
+    m_manager(manager),
     m_parent(parent),
     m_name(name),
     m_i18nName(std::move(i18nName))
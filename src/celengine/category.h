@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -24,6 +25,39 @@ enum class UserCategoryId : std::uint32_t
 };
 
 
+/*! Dense set of the objects in categories, indexed by the compact ids the
+ *  category manager gives to objects the first time they're added to a
+ *  category. Filtering a catalog by categories is a test of a bit, and
+ *  sets of categories combine a word at a time.
+ */
+class CategoryMembers
+{
+public:
+    using ObjectId = std::uint32_t;
+
+    bool test(ObjectId id) const;
+    void set(ObjectId id);
+    void reset(ObjectId id);
+
+    std::size_t count() const;
+    bool empty() const;
+
+    CategoryMembers& operator|=(const CategoryMembers& other);
+    CategoryMembers& operator&=(const CategoryMembers& other);
+    CategoryMembers& operator-=(const CategoryMembers& other);
+
+    // Call f with the id of each member, in increasing order
+    template<typename F> void forEach(F&& f) const;
+
+private:
+    static constexpr std::size_t WordBits = 64;
+
+    static unsigned int lowestBit(std::uint64_t word);
+
+    std::vector<std::uint64_t> m_words;
+};
+
+
 class UserCategory;
 
 class UserCategoryManager
@@ -55,20 +89,39 @@ public:
     bool isInCategory(Selection, UserCategoryId) const;
     const std::vector<UserCategoryId>* getCategories(Selection) const;
 
+    // Members of a category, or nullptr if there's no such category
+    const CategoryMembers* getMembers(UserCategoryId) const;
+    // Objects in any of the active categories
+    CategoryMembers getActiveMembers() const;
+    // Objects of a set built from the members of categories
+    std::vector<Selection> getObjects(const CategoryMembers&) const;
+    // Compact id of an object in a category
+    std::optional<CategoryMembers::ObjectId> getObjectId(Selection) const;
+
 private:
     struct ConstructorToken {};
 
+    struct ObjectEntry
+    {
+        CategoryMembers::ObjectId id;
+        std::vector<UserCategoryId> categories;
+    };
+
     UserCategoryId createNew(UserCategoryId,
                              const std::string&,
                              UserCategoryId,
                              const std::string&);
+    void removeMembership(std::unordered_map<Selection, ObjectEntry>::iterator, UserCategoryId);
 
     std::vector<std::unique_ptr<UserCategory>> m_categories;
     std::vector<UserCategoryId> m_available;
     std::unordered_set<UserCategoryId> m_active;
     std::unordered_set<UserCategoryId> m_roots;
     std::map<std::string, UserCategoryId, std::less<>> m_categoryMap;
-    std::unordered_map<Selection, std::vector<UserCategoryId>> m_objectMap;
+    std::unordered_map<Selection, ObjectEntry> m_objectMap;
+    // Objects by id, ids of objects no longer in categories are reused
+    std::vector<Selection> m_objects;
+    std::vector<CategoryMembers::ObjectId> m_availableObjectIds;
     friend class UserCategory;
 };
 
@@ -77,6 +130,7 @@ class UserCategory
 {
 public:
     UserCategory(UserCategoryManager::ConstructorToken,
+                 const UserCategoryManager* manager,
                  const std::string& name,
                  UserCategoryId parent,
                  std::string&& i18nName);
@@ -85,7 +139,8 @@ public:
     UserCategoryId parent() const { return m_parent; }
     const std::string& getName(bool i18n = false) const;
     celestia::util::array_view<UserCategoryId> children() const { return m_children; }
-    const std::unordered_set<Selection>& members() const { return m_members; }
+    std::vector<Selection> members() const { return m_manager->getObjects(m_members); }
+    const CategoryMembers& memberSet() const { return m_members; }
     bool hasChild(UserCategoryId child) const;
 
     static const std::unordered_set<UserCategoryId>& active();
@@ -112,16 +167,28 @@ public:
 private:
     inline static UserCategoryManager manager{};
 
+    const UserCategoryManager* m_manager;
     UserCategoryId m_parent;
     std::string m_name;
     std::string m_i18nName;
     std::vector<UserCategoryId> m_children{};
-    std::unordered_set<Selection> m_members{};
+    CategoryMembers m_members{};
 
     friend class UserCategoryManager;
 };
 
 
+template<typename F> void
+CategoryMembers::forEach(F&& f) const
+{
+    for (std::size_t i = 0; i < m_words.size(); ++i)
+    {
+        for (std::uint64_t word = m_words[i]; word != 0; word &= word - 1)
+            f(static_cast<ObjectId>(i * WordBits + lowestBit(word)));
+    }
+}
+
+
 inline const std::unordered_set<UserCategoryId>&
 UserCategory::active()
 {
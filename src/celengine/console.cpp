@@ -40,6 +40,7 @@ Console::Console(Renderer& _renderer, int _nRows, int _nColumns) :
 {
     sbuf.setConsole(this);
     text.resize((nColumns + 1) * nRows, u'\0');
+    rowGlyphs.resize(nRows);
 }
 
 
@@ -51,10 +52,13 @@ Console::Console(Renderer& _renderer, int _nRows, int _nColumns) :
  */
 bool Console::setRowCount(int _nRows)
 {
+    std::scoped_lock lock(textMutex);
     if (_nRows == nRows)
         return true;
 
     text.resize((nColumns + 1) * _nRows, u'\0');
+    rowGlyphs.clear();
+    rowGlyphs.resize(_nRows);
     nRows = _nRows;
 
     return true;
@@ -89,16 +93,37 @@ void Console::render(int rowHeight)
 
     font->bind();
     font->setMVPMatrices(projection);
+    std::scoped_lock lock(textMutex);
+    if (font != glyphFont)
+    {
+        for (RowGlyphs& glyphs : rowGlyphs)
+            glyphs.valid = false;
+        glyphFont = font;
+    }
+
     savePos();
     for (int i = 0; i < rowHeight; i++)
     {
         //int r = (nRows - rowHeight + 1 + windowRow + i) % nRows;
         int r = pmod(row + windowRow + i, nRows);
-        std::u16string_view line{text.data() + (r * (nColumns + 1)), static_cast<std::size_t>(nColumns)};
-        if (auto endpos = line.find(u'\0'); endpos != std::u16string_view::npos)
-            line = line.substr(0, endpos);
-
-        font->render(line, global.x, global.y);
+        RowGlyphs& glyphs = rowGlyphs[r];
+        if (glyphs.valid)
+        {
+            font->render(glyphs.quads, global.x - glyphs.origin.first, global.y - glyphs.origin.second);
+        }
+        else
+        {
+            std::u16string_view line{text.data() + (r * (nColumns + 1)), static_cast<std::size_t>(nColumns)};
+            if (auto endpos = line.find(u'\0'); endpos != std::u16string_view::npos)
+                line = line.substr(0, endpos);
+
+            glyphs.quads.clear();
+            glyphs.origin = { global.x, global.y };
+            TextureFont::capture(&glyphs.quads);
+            font->render(line, global.x, global.y);
+            TextureFont::capture(nullptr);
+            glyphs.valid = true;
+        }
 
         // advance to the next line
         restorePos();
@@ -133,6 +158,7 @@ void Console::newline()
     assert(row < nRows);
 
     text[row * (nColumns + 1) + column] = '\0';
+    rowGlyphs[row].valid = false;
     row = (row + 1) % nRows;
     column = 0;
 
@@ -142,6 +168,7 @@ void Console::newline()
 
 void Console::print(char16_t c)
 {
+    std::scoped_lock lock(textMutex);
     switch (c)
     {
     case '\n':
@@ -151,6 +178,7 @@ void Console::print(char16_t c)
         if (column == nColumns)
             newline();
         text[row * (nColumns + 1) + column] = c;
+        rowGlyphs[row].valid = false;
         column++;
         break;
     }
@@ -171,6 +199,7 @@ void Console::setWindowRow(int _row)
 
 void Console::setWindowHeight(int _height)
 {
+    std::scoped_lock lock(textMutex);
     windowHeight = _height;
 }
 
@@ -230,6 +259,7 @@ void Console::restorePos()
 
 void Console::scroll(int lines)
 {
+    std::scoped_lock lock(textMutex);
     int topRow = getWindowRow();
     int height = getHeight();
 
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <streambuf>
 #include <string>
@@ -17,11 +18,11 @@
 
 #include <Eigen/Core>
 
+#include <celttf/truetypefont.h>
 #include <celutil/utf8.h>
 
 class Color;
 class Console;
-class TextureFont;
 
 // Custom streambuf class to support C++ operator style output.  The
 // output is completely unbuffered.
@@ -82,7 +83,20 @@ class Console : public std::ostream
     int getHeight() const;
     int getWidth() const;
 
+    // The glyphs a row was last drawn with, at origin, kept until the row
+    // or the font changes so that the log isn't laid out every frame
+    struct RowGlyphs
+    {
+        std::vector<GlyphQuad> quads;
+        std::pair<float, float> origin{ 0.0f, 0.0f };
+        bool valid{ false };
+    };
+
+    // Log messages are printed by the logger's writer thread, the lock
+    // covers the text and the rows while the console is printed or drawn
+    std::mutex textMutex;
     std::u16string text{ };
+    std::vector<RowGlyphs> rowGlyphs;
     int nRows;
     int nColumns;
     int row{ 0 };
@@ -95,6 +109,8 @@ class Console : public std::ostream
     int xscale{ 1 };
     int yscale{ 1 };
     std::shared_ptr<TextureFont> font{ nullptr };
+    // The font the glyphs of the rows were laid out with
+    std::shared_ptr<TextureFont> glyphFont{ nullptr };
     Renderer& renderer;
 
     ConsoleStreamBuf sbuf;
@@ -29,14 +29,22 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <celrender/linerenderer.h>
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+#include <celutil/array_view.h>
 
 #include "curveplot.h"
+#include "glsupport.h"
 #include "render.h"
 #include "shadermanager.h"
 
+namespace gl = celestia::gl;
 using celestia::render::LineRenderer;
 
 namespace
@@ -45,6 +53,14 @@ constexpr unsigned int VertexBufferCapacity = 4096;
 constexpr unsigned int SubdivisionFactor = 8;
 constexpr double InvSubdivisionFactor = 1.0 / static_cast<double>(SubdivisionFactor);
 constexpr float OrbitThickness = 1.0f;
+// Minimum number of free vertices at each end of a resident buffer
+constexpr unsigned int ResidentSlack = 128;
+// Maximum distance in pixels between a resident plot and the simplified
+// line drawn in its place
+constexpr double MaxPixelError = 0.5;
+// Number of simplification levels of a resident plot, each with half the
+// error of the previous one
+constexpr unsigned int MaxSimplificationLevels = 16;
 
 // Convert a 3-vector to a 4-vector by adding a zero
 inline Eigen::Vector4d
@@ -335,14 +351,302 @@ private:
 
 HighPrec_VertexBuffer vbuf;
 
+
+// Times are passed to the resident path shader relative to the reference
+// time of the buffer; infinite times would be undefined there.
+inline float
+shaderTime(double t)
+{
+    return static_cast<float>(std::clamp(t,
+                                         -static_cast<double>(std::numeric_limits<float>::max()),
+                                         static_cast<double>(std::numeric_limits<float>::max())));
+}
+
 } // end unnamed namespace
 
 
-CurvePlot::CurvePlot(const Renderer &renderer) :
+/** The samples of a resident plot in a GPU buffer. Positions are stored
+  * in single precision relative to an anchor point near the middle of the
+  * plot, and times relative to a reference time. The samples occupy the
+  * middle of the buffer, so that samples can be added or removed at either
+  * end without moving the others; only the vertices added since the last
+  * frame are uploaded. The buffer is rebuilt when an end runs out of room.
+  */
+struct CurvePlot::ResidentPath
+{
+    struct Vertex
+    {
+        Eigen::Vector3f position;
+        float t;
+    };
+
+    Vertex vertex(const CurvePlotSample& sample) const
+    {
+        return { (sample.position - anchor).cast<float>(), static_cast<float>(sample.t - referenceTime) };
+    }
+
+    void extend(const CurvePlotSample& sample, double segmentBoundingRadius)
+    {
+        radius = std::max(radius, (sample.position - anchor).norm());
+        maxSegmentRadius = std::max(maxSegmentRadius, segmentBoundingRadius);
+    }
+
+    void markDirty(unsigned int index)
+    {
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, index + 1);
+    }
+
+    void pushBack(const CurvePlotSample& sample, double segmentBoundingRadius)
+    {
+        if (!valid)
+            return;
+        if (last == vertices.size())
+        {
+            valid = false;
+            return;
+        }
+
+        vertices[last] = vertex(sample);
+        markDirty(last);
+        levelsValid = false;
+        ++last;
+        extend(sample, segmentBoundingRadius);
+    }
+
+    void pushFront(const CurvePlotSample& sample, double segmentBoundingRadius)
+    {
+        if (!valid)
+            return;
+        if (first == 0)
+        {
+            valid = false;
+            return;
+        }
+
+        --first;
+        vertices[first] = vertex(sample);
+        markDirty(first);
+        levelsValid = false;
+        extend(sample, segmentBoundingRadius);
+    }
+
+    // The bounds are not shrunk when samples are removed; they are
+    // recomputed when the buffer is rebuilt.
+    void popFront()
+    {
+        levelsValid = false;
+        if (valid && ++first == last)
+            valid = false;
+    }
+
+    void popBack()
+    {
+        levelsValid = false;
+        if (valid && --last == first)
+            valid = false;
+    }
+
+    void rebuild(const std::deque<CurvePlotSample>& samples)
+    {
+        auto count = static_cast<unsigned int>(samples.size());
+        unsigned int slack = std::max(count, ResidentSlack);
+        if (vertices.size() != count + 2 * slack)
+        {
+            vertices.resize(count + 2 * slack);
+            reallocate = true;
+        }
+
+        const CurvePlotSample& middle = samples[count / 2];
+        anchor = middle.position;
+        referenceTime = middle.t;
+        radius = 0.0;
+        maxSegmentRadius = 0.0;
+
+        first = slack;
+        last = slack + count;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            vertices[first + i] = vertex(samples[i]);
+            extend(samples[i], i > 0 ? samples[i].boundingRadius : 0.0);
+        }
+
+        dirtyBegin = first;
+        dirtyEnd = last;
+        valid = true;
+        levelsValid = false;
+    }
+
+    /** Build the Douglas-Peucker simplifications of the samples. Each sample
+      * is given the distance at which the recursion splits its segment at
+      * it, clamped to that of the split above it, so that the samples of at
+      * least a distance are the ones the algorithm keeps for that error.
+      * Level k keeps the samples of at least radius * 2^-k; levels stop once
+      * they would save less than a quarter of the samples.
+      */
+    void buildLevels(const std::deque<CurvePlotSample>& samples)
+    {
+        auto count = static_cast<unsigned int>(samples.size());
+        std::vector<double> importance(count, std::numeric_limits<double>::infinity());
+
+        struct Span
+        {
+            unsigned int begin;
+            unsigned int end;
+            double importance;
+        };
+        std::vector<Span> spans;
+        spans.push_back({ 0, count - 1, std::numeric_limits<double>::infinity() });
+        while (!spans.empty())
+        {
+            Span span = spans.back();
+            spans.pop_back();
+            if (span.end - span.begin < 2)
+                continue;
+
+            const Eigen::Vector3d& p0 = samples[span.begin].position;
+            Eigen::Vector3d chord = samples[span.end].position - p0;
+            double chordLength2 = chord.squaredNorm();
+            double farthest = -1.0;
+            unsigned int split = span.begin + 1;
+            for (unsigned int i = span.begin + 1; i < span.end; i++)
+            {
+                Eigen::Vector3d v = samples[i].position - p0;
+                double u = chordLength2 > 0.0 ? std::clamp(v.dot(chord) / chordLength2, 0.0, 1.0) : 0.0;
+                double distance = (v - u * chord).norm();
+                if (distance > farthest)
+                {
+                    farthest = distance;
+                    split = i;
+                }
+            }
+
+            importance[split] = std::min(farthest, span.importance);
+            spans.push_back({ span.begin, split, importance[split] });
+            spans.push_back({ split, span.end, importance[split] });
+        }
+
+        levelIndices.clear();
+        levelOffsets.clear();
+        for (unsigned int level = 0; level < MaxSimplificationLevels; level++)
+        {
+            double threshold = std::ldexp(radius, -static_cast<int>(level));
+            auto offset = static_cast<unsigned int>(levelIndices.size());
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (importance[i] >= threshold)
+                    levelIndices.push_back(static_cast<GLuint>(first + i));
+            }
+
+            if ((levelIndices.size() - offset) * 4 > count * 3)
+            {
+                levelIndices.resize(offset);
+                break;
+            }
+            levelOffsets.push_back(offset);
+        }
+        levelOffsets.push_back(static_cast<unsigned int>(levelIndices.size()));
+
+        levelsValid = true;
+        levelsDirty = true;
+    }
+
+    unsigned int levelCount() const
+    {
+        return levelOffsets.empty() ? 0 : static_cast<unsigned int>(levelOffsets.size() - 1);
+    }
+
+    void addAttributes(gl::VertexObject& vertexObject) const
+    {
+        vertexObject.addVertexBuffer(*bo,
+                                     CelestiaGLProgram::VertexCoordAttributeIndex,
+                                     3,
+                                     gl::VertexObject::DataType::Float,
+                                     false,
+                                     sizeof(Vertex),
+                                     offsetof(Vertex, position));
+        vertexObject.addVertexBuffer(*bo,
+                                     CelestiaGLProgram::IntensityAttributeIndex,
+                                     1,
+                                     gl::VertexObject::DataType::Float,
+                                     false,
+                                     sizeof(Vertex),
+                                     offsetof(Vertex, t));
+    }
+
+    void upload()
+    {
+        if (reallocate || bo == nullptr)
+        {
+            bo = std::make_unique<gl::Buffer>();
+            bo->bind().setData(vertices, gl::Buffer::BufferUsage::DynamicDraw);
+
+            vo = std::make_unique<gl::VertexObject>();
+            addAttributes(*vo);
+            levelsDirty = true;
+            reallocate = false;
+        }
+        else if (dirtyBegin < dirtyEnd)
+        {
+            bo->bind().setSubData(dirtyBegin * sizeof(Vertex),
+                                  celestia::util::array_view<const void>(vertices.data() + dirtyBegin,
+                                                                         (dirtyEnd - dirtyBegin) * sizeof(Vertex)));
+        }
+
+        dirtyBegin = std::numeric_limits<unsigned int>::max();
+        dirtyEnd = 0;
+    }
+
+    void uploadLevels()
+    {
+        if (!levelsDirty)
+            return;
+
+        io = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::ElementArray, levelIndices);
+        levelVo = std::make_unique<gl::VertexObject>();
+        addAttributes(*levelVo);
+        levelVo->setIndexBuffer(*io, 0, gl::VertexObject::IndexType::UnsignedInt);
+        levelsDirty = false;
+    }
+
+    std::vector<Vertex> vertices;
+    unsigned int first{ 0 };
+    unsigned int last{ 0 };
+    unsigned int dirtyBegin{ std::numeric_limits<unsigned int>::max() };
+    unsigned int dirtyEnd{ 0 };
+    bool valid{ false };
+    bool reallocate{ true };
+
+    Eigen::Vector3d anchor{ Eigen::Vector3d::Zero() };
+    double referenceTime{ 0.0 };
+    // Maximum distance of a sample from the anchor
+    double radius{ 0.0 };
+    // Maximum bounding radius of a segment
+    double maxSegmentRadius{ 0.0 };
+
+    std::unique_ptr<gl::Buffer> bo;
+    std::unique_ptr<gl::VertexObject> vo;
+
+    // Indices of the samples of each simplification level, coarsest first,
+    // with the offsets of the levels and the end of the last one
+    std::vector<GLuint> levelIndices;
+    std::vector<unsigned int> levelOffsets;
+    bool levelsValid{ false };
+    bool levelsDirty{ false };
+    std::unique_ptr<gl::Buffer> io;
+    std::unique_ptr<gl::VertexObject> levelVo;
+};
+
+
+CurvePlot::CurvePlot(const Renderer &renderer, bool resident) :
     m_renderer(renderer)
 {
+    if (resident)
+        m_resident = std::make_unique<ResidentPath>();
 }
 
+CurvePlot::~CurvePlot() = default;
+
 void
 CurvePlot::deinit()
 {
@@ -407,6 +711,14 @@ CurvePlot::addSample(const CurvePlotSample& sample)
             m_samples[1].boundingRadius = extents.norm();
         }
     }
+
+    if (m_resident != nullptr)
+    {
+        if (addToBack)
+            m_resident->pushBack(m_samples.back(), m_samples.back().boundingRadius);
+        else
+            m_resident->pushFront(m_samples.front(), m_samples.size() > 1 ? m_samples[1].boundingRadius : 0.0);
+    }
 }
 
 
@@ -418,6 +730,8 @@ CurvePlot::removeSamplesBefore(double t)
     while (!m_samples.empty() && m_samples.front().t < t)
     {
         m_samples.pop_front();
+        if (m_resident != nullptr)
+            m_resident->popFront();
     }
 }
 
@@ -430,6 +744,8 @@ CurvePlot::removeSamplesAfter(double t)
     while (!m_samples.empty() && m_samples.back().t > t)
     {
         m_samples.pop_back();
+        if (m_resident != nullptr)
+            m_resident->popBack();
     }
 }
 
@@ -441,6 +757,114 @@ CurvePlot::setDuration(double duration)
 }
 
 
+/** Draw the part of a resident plot between startTime and endTime from its
+  * GPU buffer. This is only possible when the plot is far enough from the
+  * viewer that every segment would be approximated as a straight line, and
+  * the line needs not be drawn as triangles. Distant plots are drawn with
+  * only the samples needed to stay within MaxPixelError of the full plot.
+  * Return false if the plot must be streamed instead.
+  *
+  * @param fadeRate rate at which the opacity increases after fadeStartTime, or zero if the plot isn't faded
+  */
+bool
+CurvePlot::renderResident(const Eigen::Affine3d& modelview,
+                          double farZ,
+                          double subdivisionThreshold,
+                          double startTime,
+                          double endTime,
+                          const Eigen::Vector4f& color,
+                          double fadeStartTime,
+                          double fadeRate) const
+{
+    if (m_resident == nullptr || m_samples.size() < 2)
+        return false;
+
+    float lineWidth = OrbitThickness * m_renderer.getScaleFactor();
+    if ((m_renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0)
+        lineWidth *= 1.5f;
+    if (lineWidth > gl::maxLineWidth)
+        return false;
+
+    ResidentPath& path = *m_resident;
+    if (!path.valid)
+        path.rebuild(m_samples);
+
+    // Bounds of the curve in camera space. The plot may not lie behind the
+    // viewer or beyond the far plane, and no segment may be large enough
+    // to require subdivision.
+    Eigen::Vector3d center = modelview * path.anchor;
+    double curveRadius = path.radius + path.maxSegmentRadius;
+    double minDistance = -(center.z() + path.radius) - path.maxSegmentRadius;
+    if (center.z() + curveRadius >= 0.0 ||
+        center.z() - path.radius < farZ ||
+        path.maxSegmentRadius >= subdivisionThreshold * minDistance)
+    {
+        return false;
+    }
+
+    CelestiaGLProgram* prog = m_renderer.getShaderManager().getShader("orbitpath");
+    if (prog == nullptr)
+        return false;
+
+    path.upload();
+
+    // Draw the segments overlapping the time range. The shader discards
+    // the parts of the first and last segments outside of it.
+    auto firstSample = std::upper_bound(m_samples.begin(), m_samples.end(), startTime,
+                                        [](double t, const CurvePlotSample& sample) { return t < sample.t; });
+    if (firstSample != m_samples.begin())
+        --firstSample;
+    auto lastSample = std::lower_bound(m_samples.begin(), m_samples.end(), endTime,
+                                       [](const CurvePlotSample& sample, double t) { return sample.t < t; });
+    if (lastSample == m_samples.end())
+        --lastSample;
+
+    auto startIndex = static_cast<int>(firstSample - m_samples.begin());
+    auto count = static_cast<int>(lastSample - firstSample) + 1;
+    if (count < 2)
+        return true;
+
+    Eigen::Matrix4f mv = (modelview * Eigen::Translation3d(path.anchor)).matrix().cast<float>();
+    Eigen::Vector2f fade = Eigen::Vector2f(0.0f, 1.0f);
+    if (fadeRate != 0.0)
+        fade = Eigen::Vector2f(static_cast<float>(fadeRate), static_cast<float>((path.referenceTime - fadeStartTime) * fadeRate));
+
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getCurrentProjectionMatrix(), mv);
+    prog->vec4Param("color") = color;
+    prog->vec2Param("timeRange") = Eigen::Vector2f(shaderTime(startTime - path.referenceTime),
+                                                   shaderTime(endTime - path.referenceTime));
+    prog->vec2Param("fade") = fade;
+    glLineWidth(lineWidth);
+
+    // Draw the coarsest simplification within the pixel error of the curve,
+    // from the last of its samples before the range to the first after it.
+    if (!path.levelsValid)
+        path.buildLevels(m_samples);
+    double tolerance = MaxPixelError * static_cast<double>(m_renderer.getPixelSize()) * minDistance;
+    double level = std::max(0.0, std::ceil(std::log2(path.radius / tolerance)));
+    if (level < static_cast<double>(path.levelCount()))
+    {
+        path.uploadLevels();
+        auto levelBegin = path.levelIndices.begin() + path.levelOffsets[static_cast<unsigned int>(level)];
+        auto levelEnd = path.levelIndices.begin() + path.levelOffsets[static_cast<unsigned int>(level) + 1];
+        auto firstIndex = static_cast<GLuint>(path.first + startIndex);
+        auto drawBegin = std::upper_bound(levelBegin, levelEnd, firstIndex) - 1;
+        auto drawEnd = std::lower_bound(drawBegin, levelEnd, firstIndex + static_cast<GLuint>(count - 1)) + 1;
+        path.levelVo->draw(gl::VertexObject::Primitive::LineStrip,
+                           static_cast<int>(drawEnd - drawBegin),
+                           static_cast<int>(drawBegin - path.levelIndices.begin()));
+    }
+    else
+    {
+        path.vo->draw(gl::VertexObject::Primitive::LineStrip, count, static_cast<int>(path.first) + startIndex);
+    }
+    path.bo->unbind();
+
+    return true;
+}
+
+
 // Trajectory consists of segments, each of which is a cubic
 // polynomial.
 
@@ -460,6 +884,14 @@ CurvePlot::render(const Eigen::Affine3d& modelview,
                   double subdivisionThreshold,
                   const Eigen::Vector4f& color) const
 {
+    if (renderResident(modelview, farZ, subdivisionThreshold,
+                       -std::numeric_limits<double>::infinity(),
+                       std::numeric_limits<double>::infinity(),
+                       color, 0.0, 0.0))
+    {
+        return;
+    }
+
     // Flag to indicate whether we need to issue a glBegin()
     bool restartCurve = true;
 
@@ -596,6 +1028,9 @@ CurvePlot::render(const Eigen::Affine3d& modelview,
     if (startSample > 0)
         startSample--;
 
+    if (renderResident(modelview, farZ, subdivisionThreshold, startTime, endTime, color, 0.0, 0.0))
+        return;
+
     const Eigen::Vector3d& p0_ = m_samples[startSample].position;
     const Eigen::Vector3d& v0_ = m_samples[startSample].velocity;
     Eigen::Vector4d p0 = modelview * Eigen::Vector4d(p0_.x(), p0_.y(), p0_.z(), 1.0);
@@ -764,6 +1199,12 @@ CurvePlot::renderFaded(const Eigen::Affine3d& modelview,
     double fadeDuration = fadeEndTime - fadeStartTime;
     double fadeRate = 1.0 / fadeDuration;
 
+    if (renderResident(modelview, farZ, subdivisionThreshold, startTime, endTime,
+                       color, fadeStartTime, fadeRate))
+    {
+        return;
+    }
+
     const Eigen::Vector3d& p0_ = m_samples[startSample].position;
     const Eigen::Vector3d& v0_ = m_samples[startSample].velocity;
     Eigen::Vector4d p0 = modelview * Eigen::Vector4d(p0_.x(), p0_.y(), p0_.z(), 1.0);
@@ -30,6 +30,7 @@
 #pragma once
 
 #include <deque>
+#include <memory>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -52,7 +53,13 @@ public:
 class CurvePlot
 {
  public:
-    explicit CurvePlot(const Renderer &renderer);
+    // A resident plot keeps a copy of its samples in a GPU buffer, so that
+    // distant plots are drawn without streaming their vertices each frame.
+    explicit CurvePlot(const Renderer &renderer, bool resident = false);
+    ~CurvePlot();
+
+    CurvePlot(const CurvePlot&) = delete;
+    CurvePlot& operator=(const CurvePlot&) = delete;
 
     double duration() const { return m_duration; }
     void setDuration(double duration);
@@ -106,8 +113,20 @@ class CurvePlot
     static void deinit();
 
  private:
+    struct ResidentPath;
+
+    bool renderResident(const Eigen::Affine3d& modelview,
+                        double farZ,
+                        double subdivisionThreshold,
+                        double startTime,
+                        double endTime,
+                        const Eigen::Vector4f& color,
+                        double fadeStartTime,
+                        double fadeRate) const;
+
     std::deque<CurvePlotSample>     m_samples;
     const Renderer                 &m_renderer;
+    std::unique_ptr<ResidentPath>   m_resident;
     double                          m_duration      { 0.0 };
     unsigned int                    m_lastUsed      { 0   };
 };
@@ -10,6 +10,9 @@
 // of the License, or (at your option) any later version.
 
 #include "dateformatter.h"
+
+#include <cmath>
+
 #ifdef USE_ICU
 #include <celutil/gettext.h>
 #endif
@@ -19,6 +22,24 @@ namespace astro = celestia::astro;
 namespace celestia::engine
 {
 
+namespace
+{
+
+// Smallest unit of time shown by a format, in seconds
+double
+formatResolution(astro::Date::Format format)
+{
+    if (format != astro::Date::ISO8601)
+        return 1.0;
+#ifdef USE_ICU
+    return 1.0e-3;
+#else
+    return 1.0e-5;
+#endif
+}
+
+} // end unnamed namespace
+
 DateFormatter::~DateFormatter()
 {
 #ifdef USE_ICU
@@ -32,7 +53,24 @@ DateFormatter::~DateFormatter()
 }
 
 
-std::string DateFormatter::formatDate(double tdb, bool local, astro::Date::Format format)
+const std::string& DateFormatter::formatDate(double tdb, bool local, astro::Date::Format format)
+{
+    // Dates are formatted from UTC, so the intervals follow UTC seconds
+    double jdutc = astro::TAItoJDUTC(astro::TTtoTAI(astro::TDBtoTT(tdb)));
+    double interval = std::floor(astro::julianDateToSeconds(jdutc - astro::J2000) / formatResolution(format));
+
+    auto index = static_cast<std::size_t>(format) * 2 + (local ? 1 : 0);
+    CachedDate& cached = cachedDates[index];
+    if (cached.interval != interval)
+    {
+        cached.interval = interval;
+        cached.text = this->format(tdb, local, format);
+    }
+    return cached.text;
+}
+
+
+std::string DateFormatter::format(double tdb, bool local, astro::Date::Format format)
 {
 #ifdef USE_ICU
     auto formatter = getFormatter(local, format);
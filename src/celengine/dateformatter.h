@@ -21,9 +21,13 @@
 #include <unicode/udat.h>
 #include <unicode/ustring.h>
 #endif
-#include <array>
 #endif
 
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <string>
+
 #include <celastro/date.h>
 
 namespace celestia::engine
@@ -39,10 +43,22 @@ public:
     DateFormatter &operator=(const DateFormatter &) = delete;
     DateFormatter &operator=(DateFormatter &&) = delete;
 
-    std::string formatDate(double tdb, bool local, astro::Date::Format format);
+    // The string is kept until the date changes by the smallest unit of
+    // time shown by the format
+    const std::string& formatDate(double tdb, bool local, astro::Date::Format format);
 
-#ifdef USE_ICU
 private:
+    struct CachedDate
+    {
+        double interval{ std::numeric_limits<double>::quiet_NaN() };
+        std::string text;
+    };
+
+    std::string format(double tdb, bool local, astro::Date::Format format);
+
+    std::array<CachedDate, static_cast<std::size_t>(astro::Date::FormatCount) * 2> cachedDates;
+
+#ifdef USE_ICU
     std::array<UDateFormat*, static_cast<size_t>(astro::Date::FormatCount)> localFormatters;
     std::array<UDateFormat*, static_cast<size_t>(astro::Date::FormatCount)> utcFormatters;
 
@@ -11,10 +11,15 @@
 #include "deepskyobj.h"
 
 #include <cmath>
+#include <cstdint>
+#include <istream>
+#include <ostream>
 
 #include <celastro/astro.h>
 #include <celmath/intersect.h>
 #include <celmath/sphere.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include "hash.h"
 
 namespace astro = celestia::astro;
@@ -70,6 +75,23 @@ void DeepSkyObject::setInfoURL(const std::string& s)
     infoURL = s;
 }
 
+// FIXME: infourl class
+void DeepSkyObject::setInfoURL(const std::string& url, const fs::path& resPath)
+{
+    std::string modifiedURL;
+    if (url.find(':') == std::string::npos)
+    {
+        // Relative URL, the base directory is the current one,
+        // not the main installation directory
+        if (resPath.c_str()[1] == ':')
+            // Absolute Windows path, file:/// is required
+            modifiedURL = "file:///" + resPath.string() + "/" + url;
+        else if (!resPath.empty())
+            modifiedURL = resPath.string() + "/" + url;
+    }
+    setInfoURL(modifiedURL.empty() ? url : modifiedURL);
+}
+
 
 bool DeepSkyObject::pick(const Eigen::ParametrizedLine<double, 3>& ray,
                          double& distanceToPicker,
@@ -111,22 +133,8 @@ bool DeepSkyObject::load(const AssociativeArray* params, const fs::path& resPath
     if (auto absMagValue = params->getNumber<float>("AbsMag"); absMagValue.has_value())
         setAbsoluteMagnitude(*absMagValue);
 
-    // FIXME: infourl class
     if (const std::string* infoURLValue = params->getString("InfoURL"); infoURLValue != nullptr)
-    {
-        std::string modifiedURL;
-        if (infoURLValue->find(':') == std::string::npos)
-        {
-            // Relative URL, the base directory is the current one,
-            // not the main installation directory
-            if (resPath.c_str()[1] == ':')
-                // Absolute Windows path, file:/// is required
-                modifiedURL = "file:///" + resPath.string() + "/" + *infoURLValue;
-            else if (!resPath.empty())
-                modifiedURL = resPath.string() + "/" + *infoURLValue;
-        }
-        setInfoURL(modifiedURL.empty() ? *infoURLValue : modifiedURL);
-    }
+        setInfoURL(*infoURLValue, resPath);
 
     if (auto visibleValue = params->getBoolean("Visible"); visibleValue.has_value())
     {
@@ -140,3 +148,83 @@ bool DeepSkyObject::load(const AssociativeArray* params, const fs::path& resPath
 
     return true;
 }
+
+
+// Binary record of the common DSO properties, all values little endian:
+//   3 x f64  position in light years
+//   4 x f32  orientation quaternion (w, x, y, z)
+//   f32      radius in light years
+//   f32      absolute magnitude
+//   u8       flags: 1 = visible, 2 = clickable
+//   string   info URL as given in the catalog
+// Strings are stored as a u16 length followed by the characters.
+namespace
+{
+constexpr std::uint8_t DSOVisibleFlag   = 1;
+constexpr std::uint8_t DSOClickableFlag = 2;
+}
+
+bool DeepSkyObject::saveBinary(std::ostream& out, const AssociativeArray& params) const
+{
+    using celestia::util::writeLE;
+
+    std::uint8_t flags = (visible ? DSOVisibleFlag : 0) | (clickable ? DSOClickableFlag : 0);
+    const std::string* infoURLValue = params.getString("InfoURL");
+
+    return writeLE<double>(out, position.x()) &&
+           writeLE<double>(out, position.y()) &&
+           writeLE<double>(out, position.z()) &&
+           writeLE<float>(out, orientation.w()) &&
+           writeLE<float>(out, orientation.x()) &&
+           writeLE<float>(out, orientation.y()) &&
+           writeLE<float>(out, orientation.z()) &&
+           writeLE<float>(out, radius) &&
+           writeLE<float>(out, absMag) &&
+           writeLE<std::uint8_t>(out, flags) &&
+           writeBinaryString(out, infoURLValue == nullptr ? std::string_view() : *infoURLValue);
+}
+
+bool DeepSkyObject::loadBinary(std::istream& in, const fs::path& resPath)
+{
+    using celestia::util::readLE;
+
+    double x, y, z;
+    float qw, qx, qy, qz;
+    std::uint8_t flags;
+    std::string url;
+    if (!readLE<double>(in, x) || !readLE<double>(in, y) || !readLE<double>(in, z) ||
+        !readLE<float>(in, qw) || !readLE<float>(in, qx) || !readLE<float>(in, qy) || !readLE<float>(in, qz) ||
+        !readLE<float>(in, radius) || !readLE<float>(in, absMag) ||
+        !readLE<std::uint8_t>(in, flags) || !readBinaryString(in, url))
+    {
+        return false;
+    }
+
+    position = Eigen::Vector3d(x, y, z);
+    orientation = Eigen::Quaternionf(qw, qx, qy, qz);
+    visible = (flags & DSOVisibleFlag) != 0;
+    clickable = (flags & DSOClickableFlag) != 0;
+    if (!url.empty())
+        setInfoURL(url, resPath);
+
+    return true;
+}
+
+bool DeepSkyObject::writeBinaryString(std::ostream& out, std::string_view str)
+{
+    if (str.size() > UINT16_MAX)
+        return false;
+
+    return celestia::util::writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(str.size())) &&
+           out.write(str.data(), static_cast<std::streamsize>(str.size())).good();
+}
+
+bool DeepSkyObject::readBinaryString(std::istream& in, std::string& str)
+{
+    std::uint16_t length;
+    if (!celestia::util::readLE<std::uint16_t>(in, length))
+        return false;
+
+    str.resize(length);
+    return in.read(str.data(), length).good();
+}
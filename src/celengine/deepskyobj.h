@@ -11,6 +11,7 @@
 
 #include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <Eigen/Core>
@@ -87,13 +88,25 @@ public:
                       double& cosAngleToBoundCenter) const = 0;
     virtual bool load(const AssociativeArray*, const fs::path& resPath);
 
+    // Binary DSO catalogs: saveBinary writes an object which was loaded from
+    // params, loadBinary reads it back. Paths are stored as they appear in
+    // params and resolved against resPath when loading, like load() does.
+    virtual bool saveBinary(std::ostream&, const AssociativeArray& params) const;
+    virtual bool loadBinary(std::istream&, const fs::path& resPath);
+
     virtual uint64_t getRenderMask() const { return 0; }
     virtual unsigned int getLabelMask() const { return 0; }
 
     AstroCatalog::IndexNumber getIndex() const { return indexNumber; }
     void setIndex(AstroCatalog::IndexNumber idx) { indexNumber = idx; }
 
+    // Strings in binary catalogs: a u16 length followed by the characters
+    static bool writeBinaryString(std::ostream&, std::string_view);
+    static bool readBinaryString(std::istream&, std::string&);
+
 private:
+    void setInfoURL(const std::string&, const fs::path& resPath);
+
     Eigen::Vector3d position{ Eigen::Vector3d::Zero() };
     Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
     float        radius{ 1 };
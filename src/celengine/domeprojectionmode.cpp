@@ -0,0 +1,62 @@
+// domeprojectionmode.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "domeprojectionmode.h"
+#include <cmath>
+#include <celmath/mathlib.h>
+
+namespace celestia::engine
+{
+
+constexpr float faceFOV = math::degToRad(90.0f);
+
+DomeProjectionMode::DomeProjectionMode(float width, float height, int screenDpi) :
+    PerspectiveProjectionMode(width, height, 0, screenDpi)
+{
+}
+
+float DomeProjectionMode::getMinimumFOV() const
+{
+    return faceFOV;
+}
+
+float DomeProjectionMode::getMaximumFOV() const
+{
+    return faceFOV;
+}
+
+float DomeProjectionMode::getFOV(float /*zoom*/) const
+{
+    return faceFOV;
+}
+
+float DomeProjectionMode::getZoom(float /*fov*/) const
+{
+    return 1.0f;
+}
+
+bool DomeProjectionMode::supportsStereo() const
+{
+    return false;
+}
+
+Eigen::Vector3f DomeProjectionMode::getPickRay(float x, float y, float /*zoom*/) const
+{
+    // The same lens as the fisheye projection mode: the rim of a circle
+    // as high as the window is 90 degrees from the view direction
+    float r = std::hypot(x, y);
+    float phi = celestia::numbers::pi_v<float> * r;
+    float sin_phi = std::sin(phi);
+    float theta = std::atan2(y, x);
+    Eigen::Vector3f pickDirection(sin_phi * std::cos(theta), sin_phi * std::sin(theta), -std::cos(phi));
+
+    return pickDirection.normalized();
+}
+
+}
@@ -0,0 +1,42 @@
+// domeprojectionmode.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <celengine/perspectiveprojectionmode.h>
+
+namespace celestia::engine
+{
+
+// Projection of the faces of the cube map which the dome viewport effect
+// warps into a 180 degree fisheye view. Each face is an ordinary square
+// perspective view with a 90 degree field of view, while picking maps the
+// window coordinates through the fisheye lens.
+class DomeProjectionMode : public PerspectiveProjectionMode
+{
+public:
+    DomeProjectionMode(float width, float height, int screenDpi);
+
+    DomeProjectionMode(const DomeProjectionMode &) = default;
+    DomeProjectionMode(DomeProjectionMode &&) = default;
+    DomeProjectionMode &operator=(const DomeProjectionMode &) = default;
+    DomeProjectionMode &operator=(DomeProjectionMode &&) = default;
+    ~DomeProjectionMode() override = default;
+
+    float getMinimumFOV() const override;
+    float getMaximumFOV() const override;
+    float getFOV(float zoom) const override;
+    float getZoom(float fov) const override;
+    // Each face would need the eyes offset along its own horizontal
+    bool supportsStereo() const override;
+
+    Eigen::Vector3f getPickRay(float x, float y, float zoom) const override;
+};
+
+}
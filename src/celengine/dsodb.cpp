@@ -11,12 +11,22 @@
 //
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <string_view>
 #include <utility>
 
 #include <celcompat/numbers.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/stringutils.h>
 #include <celutil/tokenizer.h>
 #include "category.h"
 #include "galaxy.h"
@@ -28,15 +38,126 @@
 #include "opencluster.h"
 #include "value.h"
 
+using celestia::engine::computeFrustumPlanes;
 using celestia::util::GetLogger;
 
 namespace astro = celestia::astro;
 
-constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
-//constexpr const float DSO_EXTRA_ROOM         = 0.01f; // Reserve 1% capacity for extra DSOs
-                                                      // (useful as a complement of binary loaded DSOs)
+namespace
+{
+
+constexpr float DSO_OCTREE_MAGNITUDE   = 8.0f;
+constexpr float DSO_EXTRA_ROOM         = 0.01f; // Reserve 1% capacity for extra DSOs
+                                                // (useful as a complement of binary loaded DSOs)
+
+// Binary deep sky catalog, all values little endian:
+//   8 bytes  "CEL_DSOs"
+//   u16      version
+//   u32      number of records
+// followed by the records:
+//   u8       object type (DeepSkyObjectType)
+//   string   names, separated by ':'
+//   u8       number of categories
+//   string   category names
+//   ...      object properties, see DeepSkyObject::saveBinary and overrides
+// Strings are stored as a u16 length followed by the characters.
+constexpr char FILE_HEADER[]           = "CEL_DSOs";
+constexpr std::uint16_t BINARY_VERSION = 0x0100;
+
+enum class TextEntryResult
+{
+    Ok,
+    End,
+    Error,
+};
+
+TextEntryResult
+readTextEntry(Tokenizer& tokenizer,
+              Parser& parser,
+              std::string& objType,
+              std::string& objName,
+              Value& objParams)
+{
+    if (tokenizer.nextToken() == Tokenizer::TokenEnd)
+        return TextEntryResult::End;
 
-//constexpr char FILE_HEADER[]                 = "CEL_DSOs";
+    if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+    {
+        objType = *tokenValue;
+    }
+    else
+    {
+        GetLogger()->error("Error parsing deep sky catalog file.\n");
+        return TextEntryResult::Error;
+    }
+
+    tokenizer.nextToken();
+    if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+    {
+        objName = *tokenValue;
+    }
+    else
+    {
+        GetLogger()->error("Error parsing deep sky catalog file: bad name.\n");
+        return TextEntryResult::Error;
+    }
+
+    objParams = parser.readValue();
+    if (objParams.getHash() == nullptr)
+    {
+        GetLogger()->error("Error parsing deep sky catalog entry {}\n", objName.c_str());
+        return TextEntryResult::Error;
+    }
+
+    return TextEntryResult::Ok;
+}
+
+DeepSkyObject*
+createDSO(std::string_view objType)
+{
+    if (compareIgnoringCase(objType, "Galaxy") == 0)
+        return new Galaxy();
+    if (compareIgnoringCase(objType, "Globular") == 0)
+        return new Globular();
+    if (compareIgnoringCase(objType, "Nebula") == 0)
+        return new Nebula();
+    if (compareIgnoringCase(objType, "OpenCluster") == 0)
+        return new OpenCluster();
+    return nullptr;
+}
+
+DeepSkyObject*
+createDSO(DeepSkyObjectType objType)
+{
+    switch (objType)
+    {
+    case DeepSkyObjectType::Galaxy:
+        return new Galaxy();
+    case DeepSkyObjectType::Globular:
+        return new Globular();
+    case DeepSkyObjectType::Nebula:
+        return new Nebula();
+    case DeepSkyObjectType::OpenCluster:
+        return new OpenCluster();
+    default:
+        return nullptr;
+    }
+}
+
+// Check for the binary catalog header and rewind the stream
+bool
+hasBinaryHeader(std::istream& in)
+{
+    char header[sizeof(FILE_HEADER) - 1];
+    auto start = in.tellg();
+    bool isBinary = in.read(header, sizeof(header)).good() &&
+                    std::string_view(header, sizeof(header)) == std::string_view(FILE_HEADER, sizeof(header));
+    in.clear();
+    in.seekg(start);
+    return isBinary;
+}
+
+} // end unnamed namespace
 
 
 DSODatabase::~DSODatabase()
@@ -76,11 +197,13 @@ DeepSkyObject* DSODatabase::find(std::string_view name, bool i18n) const
 }
 
 
-void DSODatabase::getCompletion(std::vector<std::string>& completion, std::string_view name) const
+void DSODatabase::getCompletion(std::vector<std::string>& completion,
+                                std::string_view name,
+                                std::size_t limit) const
 {
     // only named DSOs are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        namesDB->getCompletion(completion, name);
+        namesDB->getCompletion(completion, name, limit);
 }
 
 
@@ -90,16 +213,18 @@ std::string DSODatabase::getDSOName(const DeepSkyObject* const & dso, bool i18n)
 
     if (namesDB != nullptr)
     {
-        DSONameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-        if (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber)
+        DSONameDatabase::Names names = namesDB->getNames(catalogNumber);
+        if (!names.empty())
         {
+            std::string_view name = *names.begin();
             if (i18n)
             {
-                const char *local = D_(iter->second.c_str());
-                if (iter->second != local)
+                // The names are NUL terminated
+                const char *local = D_(name.data());
+                if (name != local)
                     return local;
             }
-            return iter->second;
+            return std::string(name);
         }
     }
 
@@ -107,21 +232,26 @@ std::string DSODatabase::getDSOName(const DeepSkyObject* const & dso, bool i18n)
 }
 
 
+std::string_view DSODatabase::getDSOLabel(const DeepSkyObject* dso) const
+{
+    return labelNames.get(dso->getIndex(), [&] { return getDSOName(dso, true); });
+}
+
+
 std::string DSODatabase::getDSONameList(const DeepSkyObject* const & dso, const unsigned int maxNames) const
 {
     std::string dsoNames;
 
     auto catalogNumber = dso->getIndex();
-    auto iter = namesDB->getFirstNameIter(catalogNumber);
-
     unsigned int count = 0;
-    while (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber && count < maxNames)
+    for (std::string_view name : namesDB->getNames(catalogNumber))
     {
+        if (count == maxNames)
+            break;
         if (count != 0)
             dsoNames.append(" / ");
 
-        dsoNames.append(D_(iter->second.c_str()));
-        ++iter;
+        dsoNames.append(D_(name.data()));
         ++count;
     }
 
@@ -136,35 +266,65 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
                                   float aspectRatio,
                                   float limitingMag) const
 {
-    // Compute the bounding planes of an infinite view frustum
-    Eigen::Hyperplane<double, 3> frustumPlanes[5];
-    Eigen::Vector3d planeNormals[5];
-
-    Eigen::Quaterniond obsOrientd = obsOrient.cast<double>();
-    Eigen::Matrix3d rot = obsOrientd.toRotationMatrix().transpose();
-    double h = std::tan(fovY / 2);
-    double w = h * aspectRatio;
-
-    planeNormals[0] = Eigen::Vector3d( 0,  1, -h);
-    planeNormals[1] = Eigen::Vector3d( 0, -1, -h);
-    planeNormals[2] = Eigen::Vector3d( 1,  0, -w);
-    planeNormals[3] = Eigen::Vector3d(-1,  0, -w);
-    planeNormals[4] = Eigen::Vector3d( 0,  0, -1);
-
-    for (int i = 0; i < 5; ++i)
-    {
-        planeNormals[i]    = rot * planeNormals[i].normalized();
-        frustumPlanes[i]   = Eigen::Hyperplane<double, 3>(planeNormals[i], obsPos);
-    }
+    std::array<Eigen::Hyperplane<double, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient.cast<double>(),
+                         static_cast<double>(fovY), static_cast<double>(aspectRatio));
 
     octreeRoot->processVisibleObjects(dsoHandler,
                                       obsPos,
-                                      frustumPlanes,
+                                      frustumPlanes.data(),
                                       limitingMag,
                                       DSO_OCTREE_ROOT_SIZE);
 }
 
 
+std::vector<DSOOctree::Subtree>
+DSODatabase::findVisibleDSOSubtrees(DSOHandler& dsoHandler,
+                                    const Eigen::Vector3d& obsPos,
+                                    const Eigen::Quaternionf& obsOrient,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    std::size_t minSubtrees) const
+{
+    // The catalogs are much smaller than the star catalogs and their
+    // octree is shallower
+    constexpr unsigned int maxSerialLevels = 16;
+
+    std::array<Eigen::Hyperplane<double, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient.cast<double>(),
+                         static_cast<double>(fovY), static_cast<double>(aspectRatio));
+
+    return octreeRoot->processVisibleLevels(dsoHandler,
+                                            obsPos,
+                                            frustumPlanes.data(),
+                                            limitingMag,
+                                            DSO_OCTREE_ROOT_SIZE,
+                                            minSubtrees,
+                                            maxSerialLevels);
+}
+
+
+void DSODatabase::findVisibleDSOsInSubtree(DSOHandler& dsoHandler,
+                                           const DSOOctree::Subtree& subtree,
+                                           const Eigen::Vector3d& obsPos,
+                                           const Eigen::Quaternionf& obsOrient,
+                                           float fovY,
+                                           float aspectRatio,
+                                           float limitingMag) const
+{
+    std::array<Eigen::Hyperplane<double, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient.cast<double>(),
+                         static_cast<double>(fovY), static_cast<double>(aspectRatio));
+
+    octreeRoot->processVisibleSubtree(subtree,
+                                      dsoHandler,
+                                      obsPos,
+                                      frustumPlanes.data(),
+                                      limitingMag);
+}
+
+
 void DSODatabase::findCloseDSOs(DSOHandler& dsoHandler,
                                 const Eigen::Vector3d& obsPos,
                                 float radius) const
@@ -185,135 +345,323 @@ DSONameDatabase* DSODatabase::getNameDatabase() const
 void DSODatabase::setNameDatabase(std::unique_ptr<DSONameDatabase>&& _namesDB)
 {
     namesDB = std::move(_namesDB);
+    labelNames.clear();
 }
 
 
-bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
+DSODatabase::ParsedCatalog DSODatabase::parse(std::istream& in)
 {
+    ParsedCatalog catalog;
+    if (hasBinaryHeader(in))
+    {
+        catalog.isBinary = true;
+        catalog.binaryData.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return catalog;
+    }
+
     Tokenizer tokenizer(&in);
-    Parser    parser(&tokenizer);
+    parseText(tokenizer, catalog);
+    return catalog;
+}
+
+
+DSODatabase::ParsedCatalog DSODatabase::parse(std::string_view text)
+{
+    ParsedCatalog catalog;
+    if (text.substr(0, sizeof(FILE_HEADER) - 1) == std::string_view(FILE_HEADER, sizeof(FILE_HEADER) - 1))
+    {
+        catalog.isBinary = true;
+        catalog.binaryData.assign(text);
+        return catalog;
+    }
+
+    Tokenizer tokenizer(text);
+    parseText(tokenizer, catalog);
+    return catalog;
+}
 
+
+void DSODatabase::parseText(Tokenizer& tokenizer, ParsedCatalog& catalog)
+{
+    Parser parser(&tokenizer);
+
+    for (;;)
+    {
+        ParsedCatalog::Entry entry;
+        if (auto result = readTextEntry(tokenizer, parser, entry.objType, entry.objName, entry.params);
+            result != TextEntryResult::Ok)
+        {
+            catalog.isComplete = result == TextEntryResult::End;
+            return;
+        }
+
+        catalog.entries.push_back(std::move(entry));
+    }
+}
+
+
+bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
+{
+    return load(parse(in), resourcePath);
+}
+
+
+bool DSODatabase::load(ParsedCatalog&& catalog, const fs::path& resourcePath)
+{
 #ifdef ENABLE_NLS
     std::string s = resourcePath.string();
     const char *d = s.c_str();
     bindtextdomain(d, d); // domain name is the same as resource path
 #endif
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    if (catalog.isBinary)
     {
-        std::string objType;
-        if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+        std::istringstream in(catalog.binaryData, std::ios::in | std::ios::binary);
+        return loadBinary(in, resourcePath);
+    }
+
+    reserve(static_cast<std::uint32_t>(catalog.entries.size()));
+
+    for (const auto& entry : catalog.entries)
+    {
+        const Hash* objParams = entry.params.getHash();
+        AstroCatalog::IndexNumber objCatalogNumber = nextAutoCatalogNumber--;
+
+        DeepSkyObject* obj = createDSO(entry.objType);
+        if (obj != nullptr && obj->load(objParams, resourcePath))
         {
-            objType = *tokenValue;
+            UserCategory::loadCategories(obj, *objParams, DataDisposition::Add, resourcePath.string());
+            addDSO(obj, objCatalogNumber, entry.objName);
         }
         else
         {
-            GetLogger()->error("Error parsing deep sky catalog file.\n");
+            delete obj;
+            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
             return false;
         }
+    }
 
-        AstroCatalog::IndexNumber objCatalogNumber = nextAutoCatalogNumber--;
+    return catalog.isComplete;
+}
 
-        tokenizer.nextToken();
-        std::string objName;
-        if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+
+bool DSODatabase::loadBinary(std::istream& in, const fs::path& resourcePath)
+{
+    using celestia::util::readLE;
+
+    char header[sizeof(FILE_HEADER) - 1];
+    std::uint16_t version;
+    std::uint32_t nRecords;
+    if (!in.read(header, sizeof(header)).good() ||
+        std::string_view(header, sizeof(header)) != std::string_view(FILE_HEADER, sizeof(header)) ||
+        !readLE<std::uint16_t>(in, version) ||
+        !readLE<std::uint32_t>(in, nRecords))
+    {
+        GetLogger()->error("Bad header for binary deep sky catalog.\n");
+        return false;
+    }
+
+    if (version != BINARY_VERSION)
+    {
+        GetLogger()->error("Unsupported binary deep sky catalog version {:#06x}.\n", version);
+        return false;
+    }
+
+    reserve(nRecords);
+
+    std::string domain = resourcePath.string();
+    std::string objName;
+    std::vector<std::string> categories;
+    for (std::uint32_t i = 0; i < nRecords; ++i)
+    {
+        std::uint8_t objType;
+        std::uint8_t nCategories;
+        if (!readLE<std::uint8_t>(in, objType) ||
+            !DeepSkyObject::readBinaryString(in, objName) ||
+            !readLE<std::uint8_t>(in, nCategories))
         {
-            objName = *tokenValue;
+            GetLogger()->error("Error reading binary deep sky catalog record {}.\n", i);
+            return false;
         }
-        else
+
+        categories.resize(nCategories);
+        for (auto& category : categories)
         {
-            GetLogger()->error("Error parsing deep sky catalog file: bad name.\n");
-            return false;
+            if (!DeepSkyObject::readBinaryString(in, category))
+            {
+                GetLogger()->error("Error reading binary deep sky catalog record {}.\n", i);
+                return false;
+            }
         }
 
-        const Value objParamsValue = parser.readValue();
-        const Hash* objParams = objParamsValue.getHash();
-        if (objParams == nullptr)
+        DeepSkyObject* obj = createDSO(static_cast<DeepSkyObjectType>(objType));
+        if (obj == nullptr || !obj->loadBinary(in, resourcePath))
         {
-            GetLogger()->error("Error parsing deep sky catalog entry {}\n", objName.c_str());
+            delete obj;
+            GetLogger()->error("Error reading binary deep sky catalog record {}.\n", i);
             return false;
         }
 
-        DeepSkyObject* obj = nullptr;
-        if (compareIgnoringCase(objType, "Galaxy") == 0)
-            obj = new Galaxy();
-        else if (compareIgnoringCase(objType, "Globular") == 0)
-            obj = new Globular();
-        else if (compareIgnoringCase(objType, "Nebula") == 0)
-            obj = new Nebula();
-        else if (compareIgnoringCase(objType, "OpenCluster") == 0)
-            obj = new OpenCluster();
-
-        if (obj != nullptr && obj->load(objParams, resourcePath))
+        for (const auto& category : categories)
         {
-            UserCategory::loadCategories(obj, *objParams, DataDisposition::Add, resourcePath.string());
+            if (!category.empty())
+                UserCategory::addObject(obj, UserCategory::findOrAdd(category, domain));
+        }
 
-            // Ensure that the DSO array is large enough
-            if (nDSOs == capacity)
-            {
-                // Grow the array by 5%--this may be too little, but the
-                // assumption here is that there will be small numbers of
-                // DSOs in text files added to a big collection loaded from
-                // a binary file.
-                capacity = static_cast<int>(capacity * 1.05);
+        addDSO(obj, nextAutoCatalogNumber--, objName);
+    }
+
+    return true;
+}
 
-                // 100 DSOs seems like a reasonable minimum
-                if (capacity < 100)
-                    capacity = 100;
 
-                DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+bool DSODatabase::convertToBinary(std::istream& in, std::ostream& out)
+{
+    using celestia::util::writeLE;
 
-                if (DSOs != nullptr)
-                {
-                    std::copy(DSOs, DSOs + nDSOs, newDSOs);
-                    delete[] DSOs;
-                }
-                DSOs = newDSOs;
-            }
+    Tokenizer tokenizer(&in);
+    Parser    parser(&tokenizer);
 
-            DSOs[nDSOs++] = obj;
+    // The record count is needed for the header, so collect the records first
+    std::ostringstream records(std::ios::out | std::ios::binary);
+    std::uint32_t nRecords = 0;
+    for (;;)
+    {
+        std::string objType;
+        std::string objName;
+        Value objParamsValue;
+        if (auto result = readTextEntry(tokenizer, parser, objType, objName, objParamsValue);
+            result == TextEntryResult::Error)
+        {
+            return false;
+        }
+        else if (result == TextEntryResult::End)
+        {
+            break;
+        }
 
-            obj->setIndex(objCatalogNumber);
+        const Hash* objParams = objParamsValue.getHash();
+        std::unique_ptr<DeepSkyObject> obj(createDSO(objType));
+        if (obj == nullptr || !obj->load(objParams, fs::path()))
+        {
+            GetLogger()->error("Bad deep sky object definition {}\n", objName);
+            return false;
+        }
 
-            if (namesDB != nullptr && !objName.empty())
+        std::vector<std::string_view> categories;
+        if (const Value* categoryValue = objParams->getValue("Category"); categoryValue != nullptr)
+        {
+            if (const std::string* category = categoryValue->getString(); category != nullptr)
+            {
+                categories.emplace_back(*category);
+            }
+            else if (const ValueArray* categoryArray = categoryValue->getArray(); categoryArray != nullptr)
             {
-                // List of names will replace any that already exist for
-                // this DSO.
-                namesDB->erase(objCatalogNumber);
-
-                // Iterate through the string for names delimited
-                // by ':', and insert them into the DSO database.
-                // Note that db->add() will skip empty names.
-                std::string::size_type startPos = 0;
-                while (startPos != std::string::npos)
+                for (const auto& it : *categoryArray)
                 {
-                    std::string::size_type next    = objName.find(':', startPos);
-                    std::string::size_type length  = std::string::npos;
-                    if (next != std::string::npos)
-                    {
-                        length = next - startPos;
-                        ++next;
-                    }
-                    std::string DSOName = objName.substr(startPos, length);
-                    namesDB->add(objCatalogNumber, DSOName);
-                    startPos   = next;
+                    if (const std::string* category = it.getString(); category != nullptr)
+                        categories.emplace_back(*category);
                 }
             }
         }
-        else
+
+        bool ok = categories.size() <= UINT8_MAX &&
+                  writeLE<std::uint8_t>(records, static_cast<std::uint8_t>(obj->getObjType())) &&
+                  DeepSkyObject::writeBinaryString(records, objName) &&
+                  writeLE<std::uint8_t>(records, static_cast<std::uint8_t>(categories.size()));
+        for (auto category : categories)
+            ok = ok && DeepSkyObject::writeBinaryString(records, category);
+
+        if (!ok || !obj->saveBinary(records, *objParams))
         {
-            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
+            GetLogger()->error("Error writing deep sky object {}\n", objName);
             return false;
         }
+
+        ++nRecords;
     }
-    return true;
+
+    std::string data = records.str();
+    return out.write(FILE_HEADER, sizeof(FILE_HEADER) - 1).good() &&
+           writeLE<std::uint16_t>(out, BINARY_VERSION) &&
+           writeLE<std::uint32_t>(out, nRecords) &&
+           out.write(data.data(), static_cast<std::streamsize>(data.size())).good();
 }
 
 
-bool DSODatabase::loadBinary(std::istream&)
+void DSODatabase::reserve(std::uint32_t count)
 {
-    // TODO: define a binary dso file format
-    return true;
+    if (count <= static_cast<std::uint32_t>(capacity - nDSOs))
+        return;
+
+    // Leave some room for DSOs from text files added to the binary catalog
+    capacity = nDSOs + static_cast<int>(static_cast<float>(count) * (1.0f + DSO_EXTRA_ROOM));
+
+    DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+    if (DSOs != nullptr)
+    {
+        std::copy(DSOs, DSOs + nDSOs, newDSOs);
+        delete[] DSOs;
+    }
+    DSOs = newDSOs;
+}
+
+
+void DSODatabase::addDSO(DeepSkyObject* obj,
+                         AstroCatalog::IndexNumber catalogNumber,
+                         const std::string& names)
+{
+    // Ensure that the DSO array is large enough
+    if (nDSOs == capacity)
+    {
+        // Grow the array by 5%--this may be too little, but the
+        // assumption here is that there will be small numbers of
+        // DSOs in text files added to a big collection loaded from
+        // a binary file.
+        capacity = static_cast<int>(capacity * 1.05);
+
+        // 100 DSOs seems like a reasonable minimum
+        if (capacity < 100)
+            capacity = 100;
+
+        DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+
+        if (DSOs != nullptr)
+        {
+            std::copy(DSOs, DSOs + nDSOs, newDSOs);
+            delete[] DSOs;
+        }
+        DSOs = newDSOs;
+    }
+
+    DSOs[nDSOs++] = obj;
+
+    obj->setIndex(catalogNumber);
+
+    if (namesDB != nullptr && !names.empty())
+    {
+        // List of names will replace any that already exist for
+        // this DSO.
+        namesDB->erase(catalogNumber);
+
+        // Iterate through the string for names delimited
+        // by ':', and insert them into the DSO database.
+        // Note that db->add() will skip empty names.
+        std::string::size_type startPos = 0;
+        while (startPos != std::string::npos)
+        {
+            std::string::size_type next    = names.find(':', startPos);
+            std::string::size_type length  = std::string::npos;
+            if (next != std::string::npos)
+            {
+                length = next - startPos;
+                ++next;
+            }
+            std::string DSOName = names.substr(startPos, length);
+            namesDB->add(catalogNumber, DSOName);
+            startPos   = next;
+        }
+    }
 }
 
 
@@ -355,6 +703,7 @@ void DSODatabase::buildOctree()
     // The spatial sorting part is useless for DSOs since we
     // are storing pointers to objects and not the objects themselves:
     root->rebuildAndSort(octreeRoot, firstDSO);
+    octreeRoot->buildObjectArrays();
 
     GetLogger()->debug("{} DSOs total.\nOctree has {} nodes and {} DSOs.\n",
                        static_cast<int>(firstDSO - sortedDSOs),
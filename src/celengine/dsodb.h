@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -25,6 +27,10 @@
 #include <celcompat/filesystem.h>
 #include <celengine/dsooctree.h>
 #include <celengine/dsoname.h>
+#include <celengine/labelnames.h>
+#include <celengine/value.h>
+
+class Tokenizer;
 
 constexpr inline unsigned int MAX_DSO_NAMES = 10;
 
@@ -45,7 +51,9 @@ class DSODatabase
     DeepSkyObject* find(const AstroCatalog::IndexNumber catalogNumber) const;
     DeepSkyObject* find(std::string_view, bool i18n) const;
 
-    void getCompletion(std::vector<std::string>&, std::string_view) const;
+    void getCompletion(std::vector<std::string>&,
+                       std::string_view,
+                       std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
 
     void findVisibleDSOs(DSOHandler& dsoHandler,
                          const Eigen::Vector3d& obsPosition,
@@ -54,25 +62,79 @@ class DSODatabase
                          float aspectRatio,
                          float limitingMag) const;
 
+    // Split findVisibleDSOs into subtrees which may be traversed on
+    // different threads, like StarDatabase::findVisibleStarSubtrees
+    std::vector<DSOOctree::Subtree> findVisibleDSOSubtrees(DSOHandler& dsoHandler,
+                                                           const Eigen::Vector3d& obsPosition,
+                                                           const Eigen::Quaternionf& obsOrientation,
+                                                           float fovY,
+                                                           float aspectRatio,
+                                                           float limitingMag,
+                                                           std::size_t minSubtrees) const;
+
+    void findVisibleDSOsInSubtree(DSOHandler& dsoHandler,
+                                  const DSOOctree::Subtree& subtree,
+                                  const Eigen::Vector3d& obsPosition,
+                                  const Eigen::Quaternionf& obsOrientation,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag) const;
+
     void findCloseDSOs(DSOHandler& dsoHandler,
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
 
     std::string getDSOName    (const DeepSkyObject* const &, bool i18n = false) const;
     std::string getDSONameList(const DeepSkyObject* const &, const unsigned int maxNames = MAX_DSO_NAMES) const;
+    // Localized name of the object shown in its label, valid until the
+    // name database is replaced
+    std::string_view getDSOLabel(const DeepSkyObject*) const;
 
     DSONameDatabase* getNameDatabase() const;
     void setNameDatabase(std::unique_ptr<DSONameDatabase>&&);
 
+    // A deep sky catalog read into memory, with text catalogs parsed into
+    // property lists. Parsing doesn't touch any shared state, so catalogs
+    // can be parsed on worker threads and then loaded in order.
+    struct ParsedCatalog
+    {
+        struct Entry
+        {
+            std::string objType;
+            std::string objName;
+            Value params;
+        };
+
+        std::vector<Entry> entries;
+        // Contents of a binary catalog, these are loaded directly
+        std::string binaryData;
+        bool isBinary{ false };
+        // False if parsing stopped at an error, the entries before it are kept
+        bool isComplete{ true };
+    };
+
+    static ParsedCatalog parse(std::istream&);
+    // Parse a catalog in memory, such as a mapped file
+    static ParsedCatalog parse(std::string_view);
+
+    // Load a text or binary deep sky catalog, the format is detected from
+    // the contents of the stream.
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
-    bool loadBinary(std::istream&);
+    bool load(ParsedCatalog&&, const fs::path& resourcePath = fs::path());
+    bool loadBinary(std::istream&, const fs::path& resourcePath = fs::path());
     void finish();
 
+    // Convert a text deep sky catalog to the binary format
+    static bool convertToBinary(std::istream& in, std::ostream& out);
+
     static DSODatabase* read(std::istream&);
 
     float getAverageAbsoluteMagnitude() const;
 
 private:
+    static void parseText(Tokenizer&, ParsedCatalog&);
+    void reserve(std::uint32_t count);
+    void addDSO(DeepSkyObject* obj, AstroCatalog::IndexNumber catalogNumber, const std::string& names);
     void buildIndexes();
     void buildOctree();
     void calcAvgAbsMag();
@@ -81,6 +143,7 @@ private:
     int              capacity{ 0 };
     DeepSkyObject**  DSOs{ nullptr };
     std::unique_ptr<DSONameDatabase> namesDB{ nullptr };
+    mutable celestia::engine::LabelNames labelNames;
     DeepSkyObject**  catalogNumberIndex{ nullptr };
     DSOOctree*       octreeRoot{ nullptr };
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
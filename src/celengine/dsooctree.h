@@ -12,10 +12,125 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include <celastro/astro.h>
 #include <celengine/deepskyobj.h>
 #include <celengine/octree.h>
 
 
+// The octree node into which a dso is placed is dependent on two properties:
+// its obsPosition and its luminosity--the fainter the dso, the deeper the node
+// in which it will reside.  Each node stores an absolute magnitude; no child
+// of the node is allowed contain a dso brighter than this value, making it
+// possible to determine quickly whether or not to cull subtrees.
+template <> struct OctreeTraits<DeepSkyObject*, double>
+{
+    using PointType = Eigen::Vector3d;
+
+    static constexpr unsigned int SplitThreshold = 10;
+
+    static bool   limitingFactorPredicate(DeepSkyObject* const& dso, float absMag);
+    static bool   straddlingPredicate(const PointType& cellCenterPos, DeepSkyObject* const& dso);
+    static double decayFunction(double excludingFactor);
+
+    // Bound of the error of the single precision positions and radii in the
+    // object arrays, relative to the 1-norm of the positions and the radii
+    static constexpr double RelativePositionError = 1.0e-6;
+
+    static PointType getPosition(DeepSkyObject* const& dso) { return dso->getPosition(); }
+
+    template <class PROCESSOR>
+    static void processVisibleObjects(const OctreeNodeObjects<DeepSkyObject*, double>&      objects,
+                                      PROCESSOR&                                            processor,
+                                      const celestia::engine::OctreeFrustumCuller<double>& culler,
+                                      double                                                dimmest);
+
+    template <class PROCESSOR>
+    static void processCloseObjects(const OctreeNodeObjects<DeepSkyObject*, double>& objects,
+                                    PROCESSOR&                                       processor,
+                                    const PointType&                                 obsPosition,
+                                    double                                           boundingRadius);
+};
+
+
 using DynamicDSOOctree = DynamicOctree<DeepSkyObject*, double>;
 using DSOOctree = StaticOctree<DeepSkyObject*, double>;
 using DSOHandler = OctreeProcessor<DeepSkyObject*, double>;
+
+
+// The object arrays hold the positions relative to the node center in
+// single precision, with the absolute magnitudes and bounding radii, so the
+// objects which can't be visible are rejected without following their
+// pointers. The rejection uses a lower bound of the distance which allows
+// for the rounding of the positions; the objects which pass are tested again
+// with their exact positions, so the same objects are processed as with an
+// exact test.
+template <class PROCESSOR>
+inline void
+OctreeTraits<DeepSkyObject*, double>::processVisibleObjects(const OctreeNodeObjects<DeepSkyObject*, double>&      objects,
+                                                            PROCESSOR&                                            processor,
+                                                            const celestia::engine::OctreeFrustumCuller<double>& culler,
+                                                            double                                                dimmest)
+{
+    assert(objects.x != nullptr || objects.count == 0);
+    const PointType& obsPosition = culler.obsPosition();
+    PointType nodeOffset = obsPosition - *objects.center;
+    auto limitingFactor = static_cast<float>(culler.limitingFactor());
+    for (std::uint32_t i = 0; i < objects.count; ++i)
+    {
+        float absMag = objects.limitingFactor[i];
+        if (!(absMag < dimmest))
+            continue;
+
+        Eigen::Vector3d position(objects.x[i], objects.y[i], objects.z[i]);
+        double minDistance = (nodeOffset - position).norm() - objects.radius[i] * (1.0 + RelativePositionError) -
+                             position.lpNorm<1>() * RelativePositionError;
+        if (minDistance >= 32.6167 &&
+            static_cast<float>(celestia::astro::absToAppMag(static_cast<double>(absMag), minDistance)) >= limitingFactor)
+        {
+            continue;
+        }
+
+        DeepSkyObject* _obj = objects.objects[i];
+        double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+        float appMag = (float) ((distance >= 32.6167) ? celestia::astro::absToAppMag((double) absMag, distance) : absMag);
+
+        if (appMag < limitingFactor)
+            processor.process(_obj, distance, absMag);
+    }
+}
+
+
+template <class PROCESSOR>
+inline void
+OctreeTraits<DeepSkyObject*, double>::processCloseObjects(const OctreeNodeObjects<DeepSkyObject*, double>& objects,
+                                                          PROCESSOR&                                       processor,
+                                                          const PointType&                                 obsPosition,
+                                                          double                                           boundingRadius)
+{
+    assert(objects.x != nullptr || objects.count == 0);
+    PointType nodeOffset = obsPosition - *objects.center;
+
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    double radiusSquared = boundingRadius * boundingRadius;
+    for (std::uint32_t i = 0; i < objects.count; ++i)
+    {
+        Eigen::Vector3d position(objects.x[i], objects.y[i], objects.z[i]);
+        if ((nodeOffset - position).norm() - position.lpNorm<1>() * RelativePositionError >= boundingRadius)
+            continue;
+
+        DeepSkyObject* _obj = objects.objects[i];
+        if ((obsPosition - _obj->getPosition()).squaredNorm() < radiusSquared)
+        {
+            float  absMag      = _obj->getAbsoluteMagnitude();
+            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+
+            processor.process(_obj, distance, absMag);
+        }
+    }
+}
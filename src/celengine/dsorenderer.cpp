@@ -8,8 +8,14 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+
 #include <celengine/dsodb.h>
 #include <celengine/deepskyobj.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+#include <celengine/nebula.h>
+#include <celengine/opencluster.h>
 #include <celrender/galaxyrenderer.h>
 #include <celrender/globularrenderer.h>
 #include <celrender/nebularenderer.h>
@@ -50,11 +56,69 @@ brightness(float avgAbsMag, float absMag, float appMag, float brightnessCorr, fl
 
 } // anonymous namespace
 
+void DSOStaging::clear()
+{
+    galaxies.clear();
+    globulars.clear();
+    nebulae.clear();
+    openClusters.clear();
+    labels.clear();
+}
+
 DSORenderer::DSORenderer() :
     ObjectRenderer<DeepSkyObject*, double>(DSO_OCTREE_ROOT_SIZE)
 {
 }
 
+void DSOStaging::append(const DSOStaging& other)
+{
+    galaxies.insert(galaxies.end(), other.galaxies.begin(), other.galaxies.end());
+    globulars.insert(globulars.end(), other.globulars.begin(), other.globulars.end());
+    nebulae.insert(nebulae.end(), other.nebulae.begin(), other.nebulae.end());
+    openClusters.insert(openClusters.end(), other.openClusters.begin(), other.openClusters.end());
+    labels.insert(labels.end(), other.labels.begin(), other.labels.end());
+}
+
+void DSORenderer::flush(DSOStaging& output)
+{
+    // The sort is stable so that the order within a form doesn't depend
+    // on thread scheduling when the output is appended in subtree order
+    std::stable_sort(output.galaxies.begin(), output.galaxies.end(),
+                     [](const auto& o1, const auto& o2)
+                     {
+                         return static_cast<const Galaxy*>(o1.dso)->getFormId() <
+                                static_cast<const Galaxy*>(o2.dso)->getFormId();
+                     });
+    std::stable_sort(output.globulars.begin(), output.globulars.end(),
+                     [](const auto& o1, const auto& o2)
+                     {
+                         return static_cast<const Globular*>(o1.dso)->getFormId() <
+                                static_cast<const Globular*>(o2.dso)->getFormId();
+                     });
+
+    for (const auto& obj : output.galaxies)
+        galaxyRenderer->add(static_cast<const Galaxy*>(obj.dso), obj.offset, obj.brightness, obj.nearZ, obj.farZ);
+    for (const auto& obj : output.globulars)
+        globularRenderer->add(static_cast<const Globular*>(obj.dso), obj.offset, obj.brightness, obj.nearZ, obj.farZ);
+    // Nebulae are sorted by distance when they are rendered
+    for (const auto& obj : output.nebulae)
+        nebulaRenderer->add(static_cast<const Nebula*>(obj.dso), obj.offset, obj.brightness, obj.nearZ, obj.farZ);
+    for (const auto& obj : output.openClusters)
+        openClusterRenderer->add(static_cast<const OpenCluster*>(obj.dso), obj.offset, obj.brightness, obj.nearZ, obj.farZ);
+
+    for (const auto& label : output.labels)
+    {
+        renderer->addBackgroundAnnotation(label.rep,
+                                          dsoDB->getDSOLabel(label.dso),
+                                          label.color,
+                                          label.position,
+                                          Renderer::LabelHorizontalAlignment::Start,
+                                          Renderer::LabelVerticalAlignment::Center,
+                                          label.symbolSize,
+                                          -label.appMag);
+    }
+}
+
 void DSORenderer::process(DeepSkyObject* const &dso,
                           double distanceToDSO,
                           float absMag)
@@ -106,20 +170,32 @@ void DSORenderer::process(DeepSkyObject* const &dso,
         case DeepSkyObjectType::Galaxy:
             // -19.04f == average over 10937 galaxies in galaxies.dsc.
             b = brightness(-19.04f, absMag, appMag, b, faintestMag);
-            galaxyRenderer->add(reinterpret_cast<Galaxy*>(dso), relPos, b, nearZ, farZ);
+            if (staging != nullptr)
+                staging->galaxies.push_back({ dso, relPos, b, nearZ, farZ });
+            else
+                galaxyRenderer->add(reinterpret_cast<Galaxy*>(dso), relPos, b, nearZ, farZ);
             break;
         case DeepSkyObjectType::Globular:
             // -6.86f == average over 150 globulars in globulars.dsc.
             b = brightness(-6.86f, absMag, appMag, b, faintestMag);
-            globularRenderer->add(reinterpret_cast<Globular*>(dso), relPos, b, nearZ, farZ);
+            if (staging != nullptr)
+                staging->globulars.push_back({ dso, relPos, b, nearZ, farZ });
+            else
+                globularRenderer->add(reinterpret_cast<Globular*>(dso), relPos, b, nearZ, farZ);
             break;
         case DeepSkyObjectType::Nebula:
             b = brightness(avgAbsMag, absMag, appMag, b, faintestMag);
-            nebulaRenderer->add(reinterpret_cast<Nebula*>(dso), relPos, b, nearZ, farZ);
+            if (staging != nullptr)
+                staging->nebulae.push_back({ dso, relPos, b, nearZ, farZ });
+            else
+                nebulaRenderer->add(reinterpret_cast<Nebula*>(dso), relPos, b, nearZ, farZ);
             break;
         case DeepSkyObjectType::OpenCluster:
             b = brightness(avgAbsMag, absMag, appMag, b, faintestMag);
-            openClusterRenderer->add(reinterpret_cast<OpenCluster*>(dso), relPos, b, nearZ, farZ);
+            if (staging != nullptr)
+                staging->openClusters.push_back({ dso, relPos, b, nearZ, farZ });
+            else
+                openClusterRenderer->add(reinterpret_cast<OpenCluster*>(dso), relPos, b, nearZ, farZ);
             break;
         default:
             // Unsupported DSO
@@ -182,13 +258,20 @@ void DSORenderer::process(DeepSkyObject* const &dso,
             float distr = std::min(1.0f, step * (labelThresholdMag - appMagEff) / labelThresholdMag);
             labelColor.alpha(distr * labelColor.alpha());
 
+            if (staging != nullptr)
+            {
+                staging->labels.push_back({ dso, rep, labelColor, relPos, symbolSize, appMagEff });
+                return;
+            }
+
             renderer->addBackgroundAnnotation(rep,
-                                              dsoDB->getDSOName(dso, true),
+                                              dsoDB->getDSOLabel(dso),
                                               labelColor,
                                               relPos,
                                               Renderer::LabelHorizontalAlignment::Start,
                                               Renderer::LabelVerticalAlignment::Center,
-                                              symbolSize);
+                                              symbolSize,
+                                              -appMagEff);
         }
     }     // labels enabled
 }
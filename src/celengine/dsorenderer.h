@@ -12,13 +12,56 @@
 
 #include "objectrenderer.h"
 
+#include <vector>
+
 #include <Eigen/Core>
 #include <celengine/projectionmode.h>
 #include <celmath/frustum.h>
 #include <celrender/rendererfwd.h>
+#include <celutil/color.h>
 
 class DeepSkyObject;
 
+namespace celestia
+{
+class MarkerRepresentation;
+}
+
+// Output of DSORenderer::process for a part of the octree traversal. The
+// type renderers and the annotations aren't thread safe, so the traversal
+// threads stage the objects they find, which are submitted later on the
+// render thread.
+struct DSOStaging
+{
+    struct Object
+    {
+        const DeepSkyObject* dso;
+        Eigen::Vector3f offset;
+        float brightness;
+        float nearZ;
+        float farZ;
+    };
+
+    struct Label
+    {
+        const DeepSkyObject* dso;
+        celestia::MarkerRepresentation* rep;
+        Color color;
+        Eigen::Vector3f position;
+        float symbolSize;
+        float appMag;
+    };
+
+    void clear();
+    void append(const DSOStaging&);
+
+    std::vector<Object> galaxies;
+    std::vector<Object> globulars;
+    std::vector<Object> nebulae;
+    std::vector<Object> openClusters;
+    std::vector<Label> labels;
+};
+
 class DSORenderer : public ObjectRenderer<DeepSkyObject *, double>
 {
 public:
@@ -26,6 +69,10 @@ public:
 
     void process(DeepSkyObject *const &, double, float) override;
 
+    // Pass the staged objects to the type renderers, sorting the galaxies
+    // and globulars by form so that each form's data is bound once
+    void flush(DSOStaging&);
+
     celestia::math::Frustum frustum{ celestia::math::degToRad(celestia::engine::standardFOV),
                                      1.0f,
                                      1.0f };
@@ -41,4 +88,7 @@ public:
     celestia::render::GlobularRenderer    *globularRenderer{ nullptr };
     celestia::render::NebulaRenderer      *nebulaRenderer{ nullptr };
     celestia::render::OpenClusterRenderer *openClusterRenderer{ nullptr };
+
+    // If set, objects and labels are staged here instead of being passed on
+    DSOStaging *staging{ nullptr };
 };
@@ -0,0 +1,102 @@
+// dynamicresolution.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Adjusts the resolution of the 3D scene to hold a target frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "frameprofiler.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Frame times between these fractions of the target keep the scale
+constexpr double LowerBand = 1.0 / 1.15;
+constexpr double UpperBand = 1.05;
+
+// Largest changes of the scale per measured frame: it falls faster than
+// it rises, so that spikes are caught quickly
+constexpr float MaxDecrease = 0.9f;
+constexpr float MaxIncrease = 1.05f;
+
+} // end unnamed namespace
+
+void
+DynamicResolution::setTargetFrameTime(double frameTime)
+{
+    if (frameTime > 0.0)
+        m_targetFrameTime = frameTime;
+}
+
+double
+DynamicResolution::getTargetFrameTime() const
+{
+    return m_targetFrameTime;
+}
+
+void
+DynamicResolution::setMinScale(float scale)
+{
+    m_minScale = std::clamp(scale, 0.1f, 1.0f);
+    m_scale = std::max(m_scale, m_minScale);
+}
+
+float
+DynamicResolution::getMinScale() const
+{
+    return m_minScale;
+}
+
+float
+DynamicResolution::getScale() const
+{
+    return m_scale;
+}
+
+void
+DynamicResolution::update(const FrameProfiler& profiler)
+{
+    const FrameProfiler::FrameTimes& times = profiler.lastFrame();
+    if (times.frame == m_lastFrame)
+        return;
+
+    m_lastFrame = times.frame;
+    auto frame = static_cast<std::size_t>(FrameProfiler::Section::Frame);
+    update(times.hasGpuTimes ? times.gpu[frame] : times.cpu[frame]);
+}
+
+void
+DynamicResolution::update(double frameTime)
+{
+    if (!(frameTime > 0.0))
+        return;
+
+    double fraction = frameTime / m_targetFrameTime;
+    if (fraction > LowerBand && fraction < UpperBand)
+        return;
+
+    auto scale = static_cast<float>(m_scale / std::sqrt(fraction));
+    scale = std::clamp(scale, m_scale * MaxDecrease, m_scale * MaxIncrease);
+    m_scale = std::clamp(scale, m_minScale, 1.0f);
+}
+
+void
+DynamicResolution::reset()
+{
+    m_scale = 1.0f;
+}
+
+} // end namespace celestia::engine
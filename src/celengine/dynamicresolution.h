@@ -0,0 +1,56 @@
+// dynamicresolution.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Adjusts the resolution of the 3D scene to hold a target frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+namespace celestia::engine
+{
+
+class FrameProfiler;
+
+/*! Chooses the fraction of the view width and height the 3D scene is
+ *  rendered at, from the times the frame profiler measured. The cost of a
+ *  frame is taken to be proportional to its pixel count, so the scale is
+ *  moved towards the square root of the ratio of the target to the
+ *  measured time. The measurements lag a few frames behind, so each step
+ *  is limited and small changes are ignored, which keeps the scale from
+ *  oscillating.
+ */
+class DynamicResolution
+{
+public:
+    // Milliseconds
+    void setTargetFrameTime(double);
+    double getTargetFrameTime() const;
+    void setMinScale(float);
+    float getMinScale() const;
+
+    float getScale() const;
+
+    // Update the scale from the last complete frame of the profiler, using
+    // its GPU time when there is one
+    void update(const FrameProfiler&);
+    // Update the scale from the time of a frame rendered at the current
+    // scale
+    void update(double frameTime);
+
+    void reset();
+
+private:
+    double m_targetFrameTime{ 1000.0 / 60.0 };
+    float m_minScale{ 0.5f };
+    float m_scale{ 1.0f };
+    std::uint64_t m_lastFrame{ 0 };
+};
+
+} // end namespace celestia::engine
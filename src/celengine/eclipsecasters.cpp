@@ -0,0 +1,193 @@
+// eclipsecasters.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "eclipsecasters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+#include "body.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Cosine of the largest change of direction of a light, about 2 arcseconds
+constexpr double MinLightDirectionCos = 1.0 - 5.0e-11;
+
+} // end unnamed namespace
+
+
+bool
+EclipseCasterSet::mayShadow(const Eigen::Vector3d& receiverPosition,
+                            double receiverRadius,
+                            const Eigen::Vector3d& lightPosition,
+                            double apparentSize) const
+{
+    if (casters.empty())
+        return false;
+
+    Eigen::Vector3d axis = center - lightPosition;
+    double lightDistance = axis.norm();
+    if (lightDistance <= radius)
+        return true;
+    axis /= lightDistance;
+
+    // Receivers entirely on the light side of the casters can't be shadowed
+    Eigen::Vector3d offset = receiverPosition - center;
+    double along = offset.dot(axis);
+    if (along < -(radius + receiverRadius))
+        return false;
+
+    // The shadow of a caster widens with the apparent size of the light
+    // over the distance to the receiver. Its axis also leans away from
+    // that of the set by up to the angle the set subtends from the light.
+    double reach = offset.norm() + radius;
+    double spread = (apparentSize + radius / lightDistance) * reach;
+    double across = (offset - along * axis).norm();
+    return across < radius + receiverRadius + spread;
+}
+
+
+const EclipseCasterSet&
+EclipseCasterCache::get(const PlanetarySystem& system, double now)
+{
+    std::uint64_t currentGeneration = PlanetarySystem::getGeneration();
+    if (now != time || currentGeneration != generation)
+    {
+        systems.clear();
+        time = now;
+        generation = currentGeneration;
+    }
+
+    auto [it, inserted] = systems.try_emplace(&system);
+    EclipseCasterSet& set = it->second;
+    if (!inserted)
+        return set;
+
+    int count = system.getSystemSize();
+    set.casters.reserve(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i)
+    {
+        const Body* body = system.getBody(i);
+        if (body->extant(now))
+            set.casters.push_back({ body, body->getAstrocentricPosition(now), body->getRadius() });
+    }
+
+    if (set.casters.empty())
+        return set;
+
+    std::sort(set.casters.begin(), set.casters.end(),
+              [](const EclipseCaster& a, const EclipseCaster& b) { return a.radius > b.radius; });
+
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    for (const EclipseCaster& caster : set.casters)
+        sum += caster.position;
+    set.center = sum / static_cast<double>(set.casters.size());
+
+    for (const EclipseCaster& caster : set.casters)
+    {
+        double extent = caster.radius;
+        if (const RingSystem* rings = caster.body->getRings(); rings != nullptr)
+            extent = std::max(extent, static_cast<double>(rings->outerRadius));
+        set.radius = std::max(set.radius, (caster.position - set.center).norm() + extent);
+    }
+
+    return set;
+}
+
+
+
+bool
+EclipseShadowCache::apply(const Body& receiver, double now, std::uint64_t visibilityMask, LightingState& ls)
+{
+    auto it = entries.find(&receiver);
+    if (it == entries.end())
+        return false;
+
+    Entry& entry = it->second;
+    if (std::abs(now - entry.time) > MaxAge ||
+        entry.generation != PlanetarySystem::getGeneration() ||
+        entry.visibilityMask != visibilityMask ||
+        entry.nLights != ls.nLights)
+    {
+        return false;
+    }
+
+    for (unsigned int li = 0; li < ls.nLights; li++)
+    {
+        if (entry.castsShadows[li] != ls.lights[li].castsShadows)
+            return false;
+        if (ls.lights[li].castsShadows &&
+            entry.lightDirections[li].dot(ls.lights[li].position.normalized()) < MinLightDirectionCos)
+        {
+            return false;
+        }
+    }
+
+    for (unsigned int li = 0; li < ls.nLights; li++)
+    {
+        *ls.shadows[li] = entry.shadows[li];
+        if (entry.hasRingShadow[li])
+            ls.ringShadows[li] = entry.ringShadows[li];
+    }
+
+    entry.lastUsed = frame;
+    return true;
+}
+
+
+void
+EclipseShadowCache::store(const Body& receiver,
+                          double now,
+                          std::uint64_t visibilityMask,
+                          const LightingState& ls,
+                          const RingShadow* ringShadows)
+{
+    Entry& entry = entries[&receiver];
+    entry.time = now;
+    entry.generation = PlanetarySystem::getGeneration();
+    entry.visibilityMask = visibilityMask;
+    entry.nLights = ls.nLights;
+    for (unsigned int li = 0; li < ls.nLights; li++)
+    {
+        entry.castsShadows[li] = ls.lights[li].castsShadows;
+        if (ls.lights[li].castsShadows)
+            entry.lightDirections[li] = ls.lights[li].position.normalized();
+        entry.shadows[li] = *ls.shadows[li];
+
+        const RingShadow& before = ringShadows[li];
+        const RingShadow& after = ls.ringShadows[li];
+        // Rings of casters replace those of the receiver itself
+        entry.hasRingShadow[li] = after.ringSystem != before.ringSystem;
+        entry.ringShadows[li] = after;
+    }
+
+    entry.lastUsed = frame;
+}
+
+
+void
+EclipseShadowCache::nextFrame(std::uint32_t maxAge)
+{
+    ++frame;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (frame - it->second.lastUsed > maxAge)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // end namespace celestia::engine
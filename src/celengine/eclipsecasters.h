@@ -0,0 +1,117 @@
+// eclipsecasters.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/lightenv.h>
+
+class Body;
+class PlanetarySystem;
+
+namespace celestia::engine
+{
+
+struct EclipseCaster
+{
+    const Body* body;
+    Eigen::Vector3d position;
+    float radius;
+};
+
+/*! The bodies of a planetary system which may cast eclipse shadows at one
+ *  time, from the largest to the smallest, with a sphere bounding them
+ *  and their rings.
+ */
+struct EclipseCasterSet
+{
+    std::vector<EclipseCaster> casters;
+    Eigen::Vector3d center{ Eigen::Vector3d::Zero() };
+    double radius{ 0.0 };
+
+    // Whether a receiver sphere may be in the shadow of any of the casters
+    // for a light at lightPosition with an apparent radius of
+    // apparentSize as seen from the receiver. Positions are astrocentric.
+    bool mayShadow(const Eigen::Vector3d& receiverPosition,
+                   double receiverRadius,
+                   const Eigen::Vector3d& lightPosition,
+                   double apparentSize) const;
+};
+
+/*! Eclipse casters of each planetary system, kept while the simulation
+ *  time and the systems are unchanged, so that the positions of the
+ *  bodies are found once for all the receivers and lights rather than for
+ *  each pair.
+ */
+class EclipseCasterCache
+{
+public:
+    const EclipseCasterSet& get(const PlanetarySystem& system, double now);
+
+private:
+    std::unordered_map<const PlanetarySystem*, EclipseCasterSet> systems;
+    double time{ 0.0 };
+    std::uint64_t generation{ 0 };
+};
+
+/*! Eclipse shadows found for each receiver, reused in later frames while
+ *  the relative light geometry barely changes: the simulation time stays
+ *  within MaxAge of the time they were found at, and the lights keep
+ *  their order and directions. At the usual slow time rates, the shadows
+ *  of most frames then come from the cache.
+ */
+class EclipseShadowCache
+{
+public:
+    // One second of simulation time, in days, over which shadows move by
+    // at most a few kilometers
+    static constexpr double MaxAge = 1.0 / 86400.0;
+
+    // Copy the cached shadows of receiver into ls, returning false if
+    // there are none valid for the current lights of ls
+    bool apply(const Body& receiver, double now, std::uint64_t visibilityMask, LightingState& ls);
+
+    // Remember the shadows of receiver found for ls; ringShadows are
+    // those of ls before testing the casters, so that only the ring
+    // shadows of casters are kept
+    void store(const Body& receiver,
+               double now,
+               std::uint64_t visibilityMask,
+               const LightingState& ls,
+               const RingShadow* ringShadows);
+
+    // Drop the receivers not used in the last maxAge frames
+    void nextFrame(std::uint32_t maxAge);
+
+private:
+    struct Entry
+    {
+        double time;
+        std::uint64_t generation;
+        std::uint64_t visibilityMask;
+        unsigned int nLights;
+        std::array<bool, MaxLights> castsShadows;
+        std::array<Eigen::Vector3d, MaxLights> lightDirections;
+        std::array<LightingState::EclipseShadowVector, MaxLights> shadows;
+        std::array<RingShadow, MaxLights> ringShadows;
+        std::array<bool, MaxLights> hasRingShadow;
+        std::uint32_t lastUsed;
+    };
+
+    std::unordered_map<const Body*, Entry> entries;
+    std::uint32_t frame{ 0 };
+};
+
+} // end namespace celestia::engine
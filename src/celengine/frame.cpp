@@ -18,6 +18,7 @@
 #include <celengine/deepskyobj.h>
 #include <celengine/location.h>
 #include <celengine/frame.h>
+#include <celephem/threadcache.h>
 
 using namespace Eigen;
 using namespace std;
@@ -28,6 +29,48 @@ namespace astro = celestia::astro;
 // are Julian days.
 static const double ANGULAR_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 
+namespace
+{
+
+struct FrameCacheEntry
+{
+    // Take over the entry for another frame or time
+    void reset(std::uint64_t _id, double _time)
+    {
+        if (id == _id && time == _time)
+            return;
+        id = _id;
+        time = _time;
+        orientationValid = false;
+        angularVelocityValid = false;
+    }
+
+    std::uint64_t id{ 0 };
+    double time{ 0.0 };
+    Quaterniond orientation{ Quaterniond::Identity() };
+    Vector3d angularVelocity{ Vector3d::Zero() };
+    bool orientationValid{ false };
+    bool angularVelocityValid{ false };
+};
+
+// Angular velocity which turns q0 into q1 in ANGULAR_VELOCITY_DIFF_DELTA
+Vector3d
+differentiateOrientation(const Quaterniond& q0, const Quaterniond& q1)
+{
+    Quaterniond dq = q0.conjugate() * q1;
+
+    if (std::abs(dq.w()) > 0.99999999)
+    {
+        return Vector3d::Zero();
+    }
+    else
+    {
+        return dq.vec().normalized() * (2.0 * acos(dq.w()) / ANGULAR_VELOCITY_DIFF_DELTA);
+    }
+}
+
+} // end unnamed namespace
+
 
 /*** ReferenceFrame ***/
 
@@ -450,11 +493,7 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 
 CachingFrame::CachingFrame(Selection _center) :
     ReferenceFrame(_center),
-    lastTime(-1.0e50),
-    lastOrientation(Quaterniond::Identity()),
-    lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheId(celestia::ephem::detail::NewThreadCacheId())
 {
 }
 
@@ -462,39 +501,34 @@ CachingFrame::CachingFrame(Selection _center) :
 Quaterniond
 CachingFrame::getOrientation(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!orientationCacheValid)
-    {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
+    auto& entry = celestia::ephem::detail::GetThreadCacheEntry<FrameCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == tjd && entry.orientationValid)
+        return entry.orientation;
 
-    return lastOrientation;
+    // Computing the orientation may use the cache entry for other frames
+    Quaterniond orientation = computeOrientation(tjd);
+    entry.reset(cacheId, tjd);
+    entry.orientation = orientation;
+    entry.orientationValid = true;
+    return orientation;
 }
 
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    auto& entry = celestia::ephem::detail::GetThreadCacheEntry<FrameCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == tjd && entry.angularVelocityValid)
+        return entry.angularVelocity;
 
-    return lastAngularVelocity;
+    Quaterniond orientation;
+    Vector3d angularVelocity;
+    computeState(tjd, orientation, angularVelocity);
+    entry.reset(cacheId, tjd);
+    entry.orientation = orientation;
+    entry.angularVelocity = angularVelocity;
+    entry.orientationValid = true;
+    entry.angularVelocityValid = true;
+    return angularVelocity;
 }
 
 
@@ -512,16 +546,17 @@ Vector3d CachingFrame::computeAngularVelocity(double tjd) const
     // jd+dt is still in range.
     Quaterniond q1 = computeOrientation(tjd + ANGULAR_VELOCITY_DIFF_DELTA);
 
-    Quaterniond dq = q0.conjugate() * q1;
+    return differentiateOrientation(q0, q1);
+}
 
-    if (std::abs(dq.w()) > 0.99999999)
-    {
-        return Vector3d::Zero();
-    }
-    else
-    {
-        return dq.vec().normalized() * (2.0 * acos(dq.w()) / ANGULAR_VELOCITY_DIFF_DELTA);
-    }
+
+void
+CachingFrame::computeState(double tjd,
+                           Quaterniond& orientation,
+                           Vector3d& angularVelocity) const
+{
+    orientation = getOrientation(tjd);
+    angularVelocity = computeAngularVelocity(tjd);
 }
 
 
@@ -567,9 +602,35 @@ TwoVectorFrame::TwoVectorFrame(Selection center,
 Quaterniond
 TwoVectorFrame::computeOrientation(double tjd) const
 {
-    Vector3d v0 = primaryVector.direction(tjd);
-    Vector3d v1 = secondaryVector.direction(tjd);
+    return orientationFromVectors(primaryVector.direction(tjd),
+                                  secondaryVector.direction(tjd));
+}
+
+
+/*! Compute the orientation, and the angular velocity from the orientation
+ *  ANGULAR_VELOCITY_DIFF_DELTA later. The directions at that time are
+ *  extrapolated where the vectors allow it, so the positions and velocities
+ *  of the objects defining the frame are only evaluated at tjd and are
+ *  shared through their caches with the other users at that time.
+ */
+void
+TwoVectorFrame::computeState(double tjd,
+                             Quaterniond& orientation,
+                             Vector3d& angularVelocity) const
+{
+    Vector3d v0Later;
+    Vector3d v1Later;
+    Vector3d v0 = primaryVector.direction(tjd, ANGULAR_VELOCITY_DIFF_DELTA, v0Later);
+    Vector3d v1 = secondaryVector.direction(tjd, ANGULAR_VELOCITY_DIFF_DELTA, v1Later);
 
+    orientation = orientationFromVectors(v0, v1);
+    angularVelocity = differentiateOrientation(orientation, orientationFromVectors(v0Later, v1Later));
+}
+
+
+Quaterniond
+TwoVectorFrame::orientationFromVectors(Vector3d v0, Vector3d v1) const
+{
     // TODO: verify that v0 and v1 aren't zero length
     v0.normalize();
     v1.normalize();
@@ -773,6 +834,37 @@ FrameVector::direction(double tjd) const
 }
 
 
+Vector3d
+FrameVector::direction(double tjd, double dt, Vector3d& later) const
+{
+    Vector3d v;
+
+    switch (vecType)
+    {
+    case RelativePosition:
+        {
+            // The relative velocity is the rate of change of the vector
+            Vector3d dv = target.getVelocity(tjd) - observer.getVelocity(tjd);
+            v = target.getPosition(tjd).offsetFromKm(observer.getPosition(tjd));
+            later = v + dv * dt;
+        }
+        break;
+
+    case ConstantVector:
+        v = direction(tjd);
+        later = frame == nullptr ? v : Vector3d(frame->getOrientation(tjd + dt).conjugate() * vec);
+        break;
+
+    default:
+        v = direction(tjd);
+        later = direction(tjd + dt);
+        break;
+    }
+
+    return v;
+}
+
+
 unsigned int
 FrameVector::nestingDepth(unsigned int depth,
                           unsigned int maxDepth) const
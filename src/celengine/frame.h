@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include <celengine/selection.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -62,7 +64,8 @@ class ReferenceFrame
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientation. Each thread has its own
+ *  cache, so a frame can be used from several threads at once.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -72,17 +75,25 @@ class CachingFrame : public ReferenceFrame
     CachingFrame(Selection _center);
     virtual ~CachingFrame() = default;
 
+    CachingFrame(const CachingFrame&) = delete;
+    CachingFrame& operator=(const CachingFrame&) = delete;
+
     Eigen::Quaterniond getOrientation(double tjd) const;
     Eigen::Vector3d getAngularVelocity(double tjd) const;
     virtual Eigen::Quaterniond computeOrientation(double tjd) const = 0;
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
+    /*! Compute the orientation and the angular velocity in one pass, both
+     *  cached when the angular velocity is requested. The default just
+     *  calls getOrientation and computeAngularVelocity; frames which can
+     *  share the work between the two override it.
+     */
+    virtual void computeState(double tjd,
+                              Eigen::Quaterniond& orientation,
+                              Eigen::Vector3d& angularVelocity) const;
+
  private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    std::uint64_t cacheId;
 };
 
 
@@ -182,6 +193,13 @@ class FrameVector
 
     Eigen::Vector3d direction(double tjd) const;
 
+    /*! Get the direction at time tjd, and an estimate of the direction
+     *  at tjd + dt in later. When the rate of change of the vector is known
+     *  at tjd, as for relative positions, later is extrapolated from it
+     *  so that no object is evaluated at another time.
+     */
+    Eigen::Vector3d direction(double tjd, double dt, Eigen::Vector3d& later) const;
+
     /*! Frames can be defined in reference to other frames; this method
      *  counts the depth of such nesting, up to some specified maximum
      *  level. This method is used to test for circular references in
@@ -239,6 +257,9 @@ class TwoVectorFrame : public CachingFrame
     virtual ~TwoVectorFrame() = default;
 
     Eigen::Quaterniond computeOrientation(double tjd) const;
+    void computeState(double tjd,
+                      Eigen::Quaterniond& orientation,
+                      Eigen::Vector3d& angularVelocity) const override;
     virtual bool isInertial() const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
@@ -248,6 +269,8 @@ class TwoVectorFrame : public CachingFrame
     static const double Tolerance;
 
  private:
+    Eigen::Quaterniond orientationFromVectors(Eigen::Vector3d v0, Eigen::Vector3d v1) const;
+
     FrameVector primaryVector;
     int primaryAxis;
     FrameVector secondaryVector;
@@ -10,6 +10,8 @@
 
 #include "framebuffer.h"
 
+namespace gl = celestia::gl;
+
 FramebufferObject::FramebufferObject(GLuint width, GLuint height, unsigned int attachments) :
     m_width(width),
     m_height(height),
@@ -78,7 +80,7 @@ FramebufferObject::generateColorTexture()
 {
     // Create and bind the texture
     glGenTextures(1, &m_colorTexId);
-    glBindTexture(GL_TEXTURE_2D, m_colorTexId);
+    gl::bindTexture(GL_TEXTURE_2D, m_colorTexId);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -96,7 +98,7 @@ FramebufferObject::generateColorTexture()
 #endif
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 #ifdef GL_ES
@@ -110,7 +112,7 @@ FramebufferObject::generateDepthTexture()
 {
     // Create and bind the texture
     glGenTextures(1, &m_depthTexId);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexId);
+    gl::bindTexture(GL_TEXTURE_2D, m_depthTexId);
 
 #ifndef GL_ES
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
@@ -128,11 +130,17 @@ FramebufferObject::generateDepthTexture()
 
     // Set the texture dimensions
     // Do we need to set GL_DEPTH_COMPONENT24 here?
-
+#ifndef GL_ES
+    // A floating point depth buffer lets the renderer draw a whole solar
+    // system with a reversed depth range instead of depth partitions
+    if (celestia::gl::ARB_clip_control)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    else
+#endif
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_width, m_height, 0, GL_DEPTH_COMPONENT, CEL_DEPTH_FORMAT, nullptr);
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void
@@ -200,12 +208,12 @@ FramebufferObject::cleanup()
 
     if (m_colorTexId != 0)
     {
-        glDeleteTextures(1, &m_colorTexId);
+        gl::deleteTextures(1, &m_colorTexId);
     }
 
     if (m_depthTexId != 0)
     {
-        glDeleteTextures(1, &m_depthTexId);
+        gl::deleteTextures(1, &m_depthTexId);
     }
 }
 
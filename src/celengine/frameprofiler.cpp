@@ -0,0 +1,324 @@
+// frameprofiler.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "frameprofiler.h"
+
+#include <fmt/format.h>
+
+#include <celutil/logger.h>
+#include "glsupport.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr std::array<std::string_view, FrameProfiler::SectionCount> SectionNames
+{
+    "frame",
+    "stars",
+    "dsos",
+    "renderlists",
+    "solarsystem",
+    "atmospheres",
+    "orbits",
+    "annotations",
+};
+
+
+FrameProfiler::DrawCounts
+currentCounts()
+{
+    return { gl::drawCounters.drawCalls, gl::drawCounters.triangles, gl::drawCounters.uploadedBytes,
+             gl::drawCounters.stateChanges, gl::drawCounters.skippedStateChanges };
+}
+
+} // end unnamed namespace
+
+
+FrameProfiler::Scope::Scope(FrameProfiler& profiler, Section section) :
+    m_profiler(profiler.m_enabled && profiler.m_inFrame ? &profiler : nullptr),
+    m_section(section),
+    m_query(NoQuery)
+{
+    if (m_profiler == nullptr)
+        return;
+
+    m_query = m_profiler->beginQuery();
+    m_startCounts = currentCounts();
+    m_start = std::chrono::steady_clock::now();
+}
+
+
+FrameProfiler::Scope::~Scope()
+{
+    if (m_profiler == nullptr)
+        return;
+
+    m_profiler->addTime(m_section, std::chrono::steady_clock::now() - m_start);
+    m_profiler->addCounts(m_section, m_startCounts);
+    m_profiler->endQuery(m_query, m_section);
+}
+
+
+FrameProfiler::FrameProfiler() = default;
+
+
+FrameProfiler::~FrameProfiler()
+{
+    deleteQueries();
+}
+
+
+void
+FrameProfiler::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled)
+        return;
+
+    if (!enabled)
+    {
+        // Pending results would be mixed up with the frames profiled after
+        // enabling it again
+        for (auto& frame : m_frames)
+            frame.pending = false;
+        m_lastFrame = FrameTimes();
+    }
+
+    m_enabled = enabled;
+    m_inFrame = false;
+}
+
+
+bool
+FrameProfiler::setLogFile(const fs::path& path)
+{
+    m_log.close();
+    m_log.clear();
+    if (path.empty())
+        return true;
+
+    m_log.open(path, std::ios::out | std::ios::trunc);
+    if (!m_log.good())
+    {
+        GetLogger()->error("Could not open frame profile log {}\n", path);
+        return false;
+    }
+
+    m_log << "frame";
+    for (std::string_view name : SectionNames)
+        m_log << ',' << name << "_cpu," << name << "_gpu";
+    for (std::string_view name : SectionNames)
+        m_log << ',' << name << "_draws," << name << "_triangles," << name << "_uploaded,"
+              << name << "_states," << name << "_skipped";
+    m_log << '\n';
+
+    setEnabled(true);
+    return true;
+}
+
+
+void
+FrameProfiler::beginFrame()
+{
+    if (!m_enabled)
+        return;
+
+#ifndef GL_ES
+    m_useQueries = gl::ARB_timer_query;
+#endif
+
+    // Collect the frames finished by the GPU, in the order they were
+    // rendered
+    for (std::size_t i = 1; i <= FramesInFlight; ++i)
+    {
+        PendingFrame& frame = m_frames[(m_current + i) % FramesInFlight];
+        if (!frame.pending)
+            continue;
+        resolve(frame, false);
+        if (frame.pending)
+            break;
+    }
+
+    m_current = (m_current + 1) % FramesInFlight;
+    PendingFrame& frame = m_frames[m_current];
+    if (frame.pending)
+        resolve(frame, true);
+
+    frame.times = FrameTimes();
+    frame.times.frame = m_frameNumber++;
+    frame.querySections.clear();
+    frame.complete = true;
+
+    m_inFrame = true;
+    m_frameQuery = beginQuery();
+    m_frameStartCounts = currentCounts();
+    m_frameStart = std::chrono::steady_clock::now();
+}
+
+
+void
+FrameProfiler::endFrame()
+{
+    if (!m_enabled || !m_inFrame)
+        return;
+
+    addTime(Section::Frame, std::chrono::steady_clock::now() - m_frameStart);
+    addCounts(Section::Frame, m_frameStartCounts);
+    endQuery(m_frameQuery, Section::Frame);
+    m_inFrame = false;
+
+    PendingFrame& frame = m_frames[m_current];
+    if (frame.querySections.empty())
+        finish(frame);
+    else
+        frame.pending = true;
+}
+
+
+std::string_view
+FrameProfiler::sectionName(Section section)
+{
+    return SectionNames[static_cast<std::size_t>(section)];
+}
+
+
+std::size_t
+FrameProfiler::beginQuery()
+{
+    PendingFrame& frame = m_frames[m_current];
+    if (!m_useQueries)
+        return NoQuery;
+
+    std::size_t query = frame.querySections.size() * 2;
+    if (query + 2 > MaxQueriesPerFrame)
+    {
+        frame.complete = false;
+        return NoQuery;
+    }
+
+#ifndef GL_ES
+    if (frame.queries.empty())
+    {
+        frame.queries.resize(MaxQueriesPerFrame);
+        glGenQueries(static_cast<GLsizei>(MaxQueriesPerFrame), frame.queries.data());
+    }
+
+    glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+#endif
+    frame.querySections.push_back(Section::Frame);
+    return query;
+}
+
+
+void
+FrameProfiler::endQuery(std::size_t query, Section section)
+{
+    if (query == NoQuery)
+        return;
+
+    PendingFrame& frame = m_frames[m_current];
+    frame.querySections[query / 2] = section;
+#ifndef GL_ES
+    glQueryCounter(frame.queries[query + 1], GL_TIMESTAMP);
+#endif
+}
+
+
+void
+FrameProfiler::addTime(Section section, std::chrono::steady_clock::duration duration)
+{
+    m_frames[m_current].times.cpu[static_cast<std::size_t>(section)] +=
+        std::chrono::duration<double, std::milli>(duration).count();
+}
+
+
+void
+FrameProfiler::addCounts(Section section, const DrawCounts& start)
+{
+    DrawCounts end = currentCounts();
+    DrawCounts& counts = m_frames[m_current].times.draws[static_cast<std::size_t>(section)];
+    counts.drawCalls += end.drawCalls - start.drawCalls;
+    counts.triangles += end.triangles - start.triangles;
+    counts.uploadedBytes += end.uploadedBytes - start.uploadedBytes;
+    counts.stateChanges += end.stateChanges - start.stateChanges;
+    counts.skippedStateChanges += end.skippedStateChanges - start.skippedStateChanges;
+}
+
+
+void
+FrameProfiler::resolve(PendingFrame& frame, bool wait)
+{
+#ifndef GL_ES
+    // The queries complete in order, so the last one tells whether the
+    // whole frame is done
+    std::size_t nQueries = frame.querySections.size() * 2;
+    if (!wait)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[nQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0)
+            return;
+    }
+
+    for (std::size_t i = 0; i < nQueries; i += 2)
+    {
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.queries[i + 1], GL_QUERY_RESULT, &end);
+        frame.times.gpu[static_cast<std::size_t>(frame.querySections[i / 2])] +=
+            static_cast<double>(end - start) * 1.0e-6;
+    }
+    frame.times.hasGpuTimes = frame.complete;
+#endif
+
+    frame.pending = false;
+    finish(frame);
+}
+
+
+void
+FrameProfiler::finish(PendingFrame& frame)
+{
+    m_lastFrame = frame.times;
+    if (!m_log.is_open())
+        return;
+
+    m_log << frame.times.frame;
+    for (std::size_t i = 0; i < SectionCount; ++i)
+    {
+        m_log << fmt::format(",{:.3f},", frame.times.cpu[i]);
+        if (frame.times.hasGpuTimes)
+            m_log << fmt::format("{:.3f}", frame.times.gpu[i]);
+    }
+    for (const DrawCounts& counts : frame.times.draws)
+        m_log << ',' << counts.drawCalls << ',' << counts.triangles << ',' << counts.uploadedBytes
+              << ',' << counts.stateChanges << ',' << counts.skippedStateChanges;
+    m_log << '\n';
+}
+
+
+void
+FrameProfiler::deleteQueries()
+{
+#ifndef GL_ES
+    for (auto& frame : m_frames)
+    {
+        if (!frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        frame.queries.clear();
+    }
+#endif
+}
+
+}
@@ -0,0 +1,156 @@
+// frameprofiler.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// CPU and GPU time spent in the passes of a rendered frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::engine
+{
+
+/*! Measures the time spent in sections of each frame, and counts the draw
+ *  calls, triangles, uploaded bytes and state changes of the GL calls made
+ *  in them, with the state changes skipped as redundant. CPU
+ *  times are taken from a steady clock. GPU times are measured with GL
+ *  timestamp queries when the driver supports them; they are read a few
+ *  frames later, so a frame's times become available once the GPU has
+ *  finished it.
+ *
+ *  Sections may be entered several times per frame and may be nested, the
+ *  time of a section is the sum over its scopes. The Frame section covers
+ *  the whole frame, SolarSystem includes the Atmospheres, Orbits and some
+ *  of the Annotations. Profiling is disabled by default and costs nothing
+ *  but a branch per scope then.
+ */
+class FrameProfiler
+{
+public:
+    enum class Section : unsigned int
+    {
+        Frame,
+        Stars,
+        DeepSkyObjects,
+        RenderLists,
+        SolarSystem,
+        Atmospheres,
+        Orbits,
+        Annotations,
+    };
+
+    static constexpr std::size_t SectionCount = 8;
+
+    struct DrawCounts
+    {
+        std::uint64_t drawCalls{ 0 };
+        std::uint64_t triangles{ 0 };
+        std::uint64_t uploadedBytes{ 0 };
+        std::uint64_t stateChanges{ 0 };
+        std::uint64_t skippedStateChanges{ 0 };
+    };
+
+    struct FrameTimes
+    {
+        std::uint64_t frame{ 0 };
+        // Milliseconds
+        std::array<double, SectionCount> cpu{ };
+        std::array<double, SectionCount> gpu{ };
+        std::array<DrawCounts, SectionCount> draws{ };
+        // False if GPU times aren't supported or some scopes weren't timed
+        bool hasGpuTimes{ false };
+    };
+
+    // Times a section until the object is destroyed
+    class Scope
+    {
+    public:
+        Scope(FrameProfiler& profiler, Section section);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameProfiler* m_profiler;
+        Section m_section;
+        std::chrono::steady_clock::time_point m_start;
+        DrawCounts m_startCounts;
+        std::size_t m_query;
+    };
+
+    FrameProfiler();
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+
+    // Write the times of each frame as a line of comma separated values,
+    // an empty path closes the file. Enables profiling.
+    bool setLogFile(const fs::path& path);
+
+    void beginFrame();
+    void endFrame();
+
+    // Times of the most recent frame whose results are complete
+    const FrameTimes& lastFrame() const { return m_lastFrame; }
+
+    // The number the next frame will get
+    std::uint64_t nextFrameNumber() const { return m_frameNumber; }
+
+    static std::string_view sectionName(Section section);
+
+private:
+    static constexpr std::size_t FramesInFlight = 4;
+    static constexpr std::size_t MaxQueriesPerFrame = 128;
+    static constexpr std::size_t NoQuery = static_cast<std::size_t>(-1);
+
+    struct PendingFrame
+    {
+        FrameTimes times;
+        std::vector<unsigned int> queries;
+        // Section of each pair of queries
+        std::vector<Section> querySections;
+        bool pending{ false };
+        bool complete{ true };
+    };
+
+    std::size_t beginQuery();
+    void endQuery(std::size_t query, Section section);
+    void addTime(Section section, std::chrono::steady_clock::duration duration);
+    void addCounts(Section section, const DrawCounts& start);
+    void resolve(PendingFrame& frame, bool wait);
+    void finish(PendingFrame& frame);
+    void deleteQueries();
+
+    bool m_enabled{ false };
+    bool m_inFrame{ false };
+    bool m_useQueries{ false };
+    std::uint64_t m_frameNumber{ 0 };
+    std::size_t m_current{ 0 };
+    std::array<PendingFrame, FramesInFlight> m_frames;
+    std::chrono::steady_clock::time_point m_frameStart;
+    DrawCounts m_frameStartCounts;
+    std::size_t m_frameQuery{ NoQuery };
+    FrameTimes m_lastFrame;
+    std::ofstream m_log;
+};
+
+}
@@ -20,6 +20,8 @@
 #include <celengine/star.h>
 #include <celengine/location.h>
 #include <celengine/deepskyobj.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
 
 /* A FrameTree is hierarchy of solar system bodies organized according to
  * the relationship of their reference frames. An object will appear in as
@@ -112,8 +114,8 @@ FrameTree::markUpdated()
 /*! Recompute the bounding sphere for this tree and all subtrees marked
  *  as having changed. The bounding sphere is large enough to accommodate
  *  the orbits (and radii) of all child bodies. This method also recomputes
- *  the maximum child radius, secondary illuminator status, and child
- *  class mask.
+ *  the maximum child radius, secondary illuminator status, thread
+ *  safety, child class mask, and child groups.
  */
 void
 FrameTree::recomputeBoundingSphere()
@@ -123,14 +125,24 @@ FrameTree::recomputeBoundingSphere()
         m_boundingSphereRadius = 0.0;
         m_maxChildRadius = 0.0;
         m_containsSecondaryIlluminators = false;
+        m_threadSafe = true;
         m_childClassMask = 0;
 
+        std::vector<ChildGroup> bounds;
+        bounds.reserve(children.size());
+
         for (const auto &phase : children)
         {
             double bodyRadius = phase->body()->getRadius();
             double r = phase->body()->getCullingRadius() + phase->orbit()->getBoundingRadius();
+            ChildGroup& childBounds = bounds.emplace_back();
+            childBounds.minRadius = phase->orbit()->getMinimumRadius() - phase->body()->getCullingRadius();
+            childBounds.maxChildRadius = phase->body()->getCullingRadius();
+            childBounds.classMask = phase->body()->getClassification() | phase->body()->getOrbitClassification();
+            childBounds.containsSecondaryIlluminators = phase->body()->isSecondaryIlluminator();
             m_maxChildRadius = max(m_maxChildRadius, bodyRadius);
             m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || phase->body()->isSecondaryIlluminator();
+            m_threadSafe = m_threadSafe && phase->orbit()->isThreadSafe() && phase->rotationModel()->isThreadSafe();
             m_childClassMask |= phase->body()->getClassification();
 
             FrameTree* tree = phase->body()->getFrameTree();
@@ -140,11 +152,62 @@ FrameTree::recomputeBoundingSphere()
                 r += tree->m_boundingSphereRadius;
                 m_maxChildRadius = max(m_maxChildRadius, tree->m_maxChildRadius);
                 m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
+                m_threadSafe = m_threadSafe && tree->isThreadSafe();
                 m_childClassMask |= tree->childClassMask();
+
+                childBounds.minRadius -= tree->m_boundingSphereRadius;
+                childBounds.maxChildRadius = max(childBounds.maxChildRadius, tree->m_maxChildRadius);
+                childBounds.classMask |= tree->childClassMask();
+                childBounds.containsSecondaryIlluminators |= tree->containsSecondaryIlluminators();
             }
 
+            childBounds.maxRadius = r;
             m_boundingSphereRadius = max(m_boundingSphereRadius, r);
         }
+
+        computeChildGroups(bounds);
+    }
+}
+
+
+/*! Sort the children by the outer bounds of their orbits and merge the
+ *  bounds of each run of ChildGroupSize children.
+ */
+void
+FrameTree::computeChildGroups(const std::vector<ChildGroup>& bounds)
+{
+    childOrder.resize(children.size());
+    for (unsigned int i = 0; i < childOrder.size(); i++)
+        childOrder[i] = i;
+    stable_sort(childOrder.begin(), childOrder.end(),
+                [&bounds](unsigned int a, unsigned int b) { return bounds[a].maxRadius < bounds[b].maxRadius; });
+
+    childGroups.clear();
+    for (unsigned int i = 0; i < childOrder.size(); i++)
+    {
+        const ChildGroup& child = bounds[childOrder[i]];
+        if (i % ChildGroupSize == 0)
+        {
+            childGroups.push_back(child);
+            childGroups.back().minRadius = max(child.minRadius, 0.0);
+            continue;
+        }
+
+        ChildGroup& group = childGroups.back();
+        group.minRadius = max(min(group.minRadius, child.minRadius), 0.0);
+        group.maxRadius = max(group.maxRadius, child.maxRadius);
+        group.maxChildRadius = max(group.maxChildRadius, child.maxChildRadius);
+        group.classMask |= child.classMask;
+        group.containsSecondaryIlluminators = group.containsSecondaryIlluminators || child.containsSecondaryIlluminators;
+    }
+
+    // The order of the children changed, so the cached offsets are stale
+    childGroupOffsets.clear();
+    childGroupOffsets.resize(childGroups.size());
+    for (std::size_t i = 0; i < childGroups.size(); i++)
+    {
+        std::size_t groupSize = min(static_cast<std::size_t>(ChildGroupSize), childOrder.size() - i * ChildGroupSize);
+        childGroupOffsets[i].offsets.resize(groupSize);
     }
 }
 
@@ -12,9 +12,11 @@
 
 #pragma once
 
+#include <limits>
 #include <memory>
 #include <vector>
 #include <cstddef>
+#include <Eigen/Core>
 #include "frame.h"
 #include "timelinephase.h"
 
@@ -24,6 +26,35 @@ class Body;
 class FrameTree
 {
 public:
+    /*! The children sorted by the size of their orbits are split into
+     *  groups of ChildGroupSize, so that a group too small and faint to be
+     *  seen can be culled at once. The bounds include the subtrees of
+     *  the children.
+     */
+    struct ChildGroup
+    {
+        // Bounds on the distance from the center of the tree
+        double minRadius;
+        double maxRadius;
+        double maxChildRadius;
+        int classMask;
+        bool containsSecondaryIlluminators;
+    };
+
+    static constexpr unsigned int ChildGroupSize = 64;
+
+    /*! The offsets from the center of the tree of the children of a group
+     *  at a time, in the order of the sorted children. They're the same
+     *  for all views drawn at that time, so they're computed by the first
+     *  one which doesn't cull the group and reused by the others. Only the
+     *  offsets of the children active at that time are set.
+     */
+    struct ChildGroupOffsets
+    {
+        double time{ std::numeric_limits<double>::quiet_NaN() };
+        std::vector<Eigen::Vector3d> offsets;
+    };
+
     FrameTree(Star*);
     FrameTree(Body*);
     ~FrameTree() = default;
@@ -43,6 +74,31 @@ public:
     const TimelinePhase* getChild(unsigned int n) const;
     unsigned int childCount() const;
 
+    /*! Return the child at index n of the children sorted by the size of
+     *  their orbits. Only valid once the bounding sphere is computed.
+     */
+    const TimelinePhase* getSortedChild(unsigned int n) const
+    {
+        return children[childOrder[n]].get();
+    }
+
+    /*! Return the group of the sorted children starting at index
+     *  n * ChildGroupSize.
+     */
+    const ChildGroup& getChildGroup(unsigned int n) const
+    {
+        return childGroups[n];
+    }
+
+    /*! Return the offsets of the group of sorted children starting at index
+     *  n * ChildGroupSize. They may be updated while rendering, by one
+     *  thread for each group.
+     */
+    ChildGroupOffsets& getChildGroupOffsets(unsigned int n) const
+    {
+        return childGroupOffsets[n];
+    }
+
     void markChanged();
     void markUpdated();
     void recomputeBoundingSphere();
@@ -80,6 +136,14 @@ public:
         return m_containsSecondaryIlluminators;
     }
 
+    /*! Return whether the orbits and rotation models of all objects in
+     *  the tree may be evaluated on several threads at once.
+     */
+    bool isThreadSafe() const
+    {
+        return m_threadSafe;
+    }
+
     /*! Return a bitmask with the classifications of all children
      *  in this tree.
      */
@@ -89,13 +153,19 @@ public:
     }
 
 private:
+    void computeChildGroups(const std::vector<ChildGroup>& bounds);
+
     Star* starParent;
     Body* bodyParent;
     std::vector<TimelinePhase::SharedConstPtr> children;
+    std::vector<unsigned int> childOrder;
+    std::vector<ChildGroup> childGroups;
+    mutable std::vector<ChildGroupOffsets> childGroupOffsets;
 
     double m_boundingSphereRadius{ 0.0 };
     double m_maxChildRadius{ 0.0 };
     bool m_containsSecondaryIlluminators{ false };
+    bool m_threadSafe{ true };
     bool m_changed{ false };
     int m_childClassMask{ 0 };
 
@@ -9,10 +9,14 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <cstdint>
 #include <fmt/printf.h>
 
 #include <celmath/intersect.h>
 #include <celmath/ray.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include "galaxy.h"
 #include "galaxyform.h"
@@ -210,3 +214,38 @@ std::ostream& operator<<(std::ostream& s, const GalaxyType& sc)
 {
     return s << GalaxyTypeNames[static_cast<std::size_t>(sc)].name;
 }
+
+// Binary record: the common DSO record, then
+//   f32      detail
+//   u8       Hubble type
+//   string   custom template file name as given in the catalog
+bool Galaxy::saveBinary(std::ostream& out, const AssociativeArray& params) const
+{
+    const std::string* customTmpName = params.getString("CustomTemplate"sv);
+    return DeepSkyObject::saveBinary(out, params) &&
+           celestia::util::writeLE<float>(out, detail) &&
+           celestia::util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(type)) &&
+           writeBinaryString(out, customTmpName == nullptr ? std::string_view() : *customTmpName);
+}
+
+bool Galaxy::loadBinary(std::istream& in, const fs::path& resPath)
+{
+    std::uint8_t typeValue;
+    std::string customTmpName;
+    if (!DeepSkyObject::loadBinary(in, resPath) ||
+        !celestia::util::readLE<float>(in, detail) ||
+        !celestia::util::readLE<std::uint8_t>(in, typeValue) ||
+        typeValue > static_cast<std::uint8_t>(GalaxyType::E7) ||
+        !readBinaryString(in, customTmpName))
+    {
+        return false;
+    }
+
+    type = static_cast<GalaxyType>(typeValue);
+    if (customTmpName.empty())
+        setForm({});
+    else
+        setForm(celestia::util::PathExp(customTmpName), resPath);
+
+    return true;
+}
@@ -61,6 +61,8 @@ public:
               double& distanceToPicker,
               double& cosAngleToBoundCenter) const override;
     bool load(const AssociativeArray*, const fs::path&) override;
+    bool saveBinary(std::ostream&, const AssociativeArray&) const override;
+    bool loadBinary(std::istream&, const fs::path&) override;
 
     static void  increaseLightGain();
     static void  decreaseLightGain();
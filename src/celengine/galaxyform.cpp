@@ -8,23 +8,70 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <random>
+#include <string_view>
+#include <system_error>
 
 #include <celimage/image.h>
 #include <celmath/randutils.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/taskscheduler.h>
+#include <celutil/timer.h>
 #include "render.h"
 #include "texture.h"
 #include "galaxy.h"
 #include "galaxyform.h"
 
+using namespace std::string_view_literals;
+using celestia::util::GetLogger;
+
 namespace celestia::engine
 {
 namespace
 {
 constexpr unsigned int kIrrGalaxyPoints = 3500u;
 
+constexpr std::string_view FormCacheMagic = "CELGALFM"sv;
+// Increment when the generated blobs change
+constexpr std::uint16_t FormCacheVersion = 0x0100;
+
+fs::path&
+cacheFilePath()
+{
+    static fs::path path;
+    return path;
+}
+
+// 64-bit FNV-1a hash of the contents of a template, 0 if it can't be read
+std::uint64_t
+hashTemplate(const fs::path& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return 0;
+
+    std::uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    std::for_each(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(),
+                  [&hash](char c)
+                  {
+                      hash ^= static_cast<unsigned char>(c);
+                      hash *= UINT64_C(0x100000001b3);
+                  });
+    return hash;
+}
+
+// Safe to call concurrently: the random number generator is local and
+// seeded identically for every template, so the result only depends
+// on the template.
 std::optional<celestia::engine::GalacticForm>
 buildGalacticForm(const fs::path& filename)
 {
@@ -44,8 +91,7 @@ buildGalacticForm(const fs::path& filename)
     int height = img->getHeight();
     int rgb    = img->getComponents();
 
-    auto& rng = math::getRNG();
-    rng.seed(1312);
+    std::mt19937 rng(1312);
     for (int i = 0; i < width * height; i++)
     {
         std::uint8_t value = img->getPixels()[rgb * i];
@@ -106,7 +152,7 @@ buildGalacticForm(const fs::path& filename)
 
     // reshuffle the galaxy points randomly...except the first kmin+1 in the center!
     // the higher that number the stronger the central "glow"
-    std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(), math::getRNG());
+    std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(), rng);
 
     std::optional<celestia::engine::GalacticForm> galacticForm(std::in_place);
     galacticForm->blobs = std::move(galacticPoints);
@@ -119,9 +165,17 @@ buildGalacticForm(const fs::path& filename)
 
 GalacticFormManager::GalacticFormManager()
 {
+    galacticForms.reserve(GalacticFormsReserve);
+    readCache();
     initializeStandardForms();
 }
 
+void
+GalacticFormManager::setCacheFile(const fs::path& path)
+{
+    cacheFilePath() = path;
+}
+
 const GalacticForm*
 GalacticFormManager::getForm(int form) const
 {
@@ -141,10 +195,178 @@ GalacticFormManager::getCustomForm(const fs::path& path)
 
     auto result = static_cast<int>(galacticForms.size());
     customForms[path] = result;
-    galacticForms.push_back(buildGalacticForm(path));
+    galacticForms.push_back(std::move(loadForms({ path }).front()));
     return result;
 }
 
+/*! Return the forms generated from a list of templates. The blobs are
+ *  taken from the cache when the template is unchanged, the others are
+ *  generated in parallel and added to the cache.
+ */
+std::vector<std::optional<GalacticForm>>
+GalacticFormManager::loadForms(const std::vector<fs::path>& paths)
+{
+    std::vector<std::optional<GalacticForm>> forms(paths.size());
+    std::vector<std::uint64_t> keys(paths.size());
+    std::vector<std::size_t> misses;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        keys[i] = hashTemplate(paths[i]);
+        if (auto iter = cache.find(paths[i]); keys[i] != 0 && iter != cache.end() && iter->second.key == keys[i])
+        {
+            GalacticForm& form = forms[i].emplace();
+            form.blobs = iter->second.blobs;
+            form.scale = Eigen::Vector3f::Ones();
+        }
+        else
+        {
+            misses.push_back(i);
+        }
+    }
+
+    if (misses.empty())
+        return forms;
+
+    Timer timer{};
+
+    celestia::util::ParallelFor(0, misses.size(), 1, [&](std::size_t i)
+    {
+        forms[misses[i]] = buildGalacticForm(paths[misses[i]]);
+    });
+
+    GetLogger()->debug("Generated {} galaxy forms in {} ms\n", misses.size(), timer.getTime());
+
+    bool modified = false;
+    for (std::size_t i : misses)
+    {
+        if (keys[i] != 0 && forms[i].has_value())
+        {
+            cache[paths[i]] = CacheEntry{ keys[i], forms[i]->blobs };
+            modified = true;
+        }
+    }
+
+    if (modified)
+        writeCache();
+
+    return forms;
+}
+
+void
+GalacticFormManager::readCache()
+{
+    using celestia::util::readLE;
+
+    const fs::path& path = cacheFilePath();
+    if (path.empty())
+        return;
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return;
+
+    std::array<char, FormCacheMagic.size()> magic;
+    std::uint16_t version;
+    std::uint32_t nEntries;
+    if (!in.read(magic.data(), magic.size()).good() || /* Flawfinder: ignore */
+        std::string_view(magic.data(), magic.size()) != FormCacheMagic ||
+        !readLE(in, version) || version != FormCacheVersion ||
+        !readLE(in, nEntries))
+    {
+        GetLogger()->verbose("Galaxy form cache {} is out of date\n", path);
+        return;
+    }
+
+    for (std::uint32_t i = 0; i < nEntries; ++i)
+    {
+        std::uint16_t pathLength;
+        std::string formPath;
+        CacheEntry entry;
+        std::uint32_t nBlobs;
+        if (!readLE(in, pathLength))
+            break;
+
+        formPath.resize(pathLength);
+        if (!in.read(formPath.data(), pathLength).good() || /* Flawfinder: ignore */
+            !readLE(in, entry.key) || !readLE(in, nBlobs))
+        {
+            break;
+        }
+
+        entry.blobs.reserve(std::min<std::uint32_t>(nBlobs, UINT32_C(1) << 20));
+        for (std::uint32_t j = 0; j < nBlobs; ++j)
+        {
+            GalacticForm::Blob& blob = entry.blobs.emplace_back();
+            if (!readLE(in, blob.position.x()) ||
+                !readLE(in, blob.position.y()) ||
+                !readLE(in, blob.position.z()) ||
+                !readLE(in, blob.colorIndex) ||
+                !readLE(in, blob.brightness))
+            {
+                GetLogger()->warn(_("Galaxy form cache {} is corrupt\n"), path);
+                return;
+            }
+        }
+
+        cache[fs::path(formPath)] = std::move(entry);
+    }
+}
+
+void
+GalacticFormManager::writeCache() const
+{
+    using celestia::util::writeLE;
+
+    const fs::path& path = cacheFilePath();
+    if (path.empty())
+        return;
+
+    // Write to a temporary file first so that concurrently starting
+    // instances never see a partially written cache.
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+
+    std::error_code ec;
+    if (auto parentPath = path.parent_path(); !parentPath.empty())
+        fs::create_directories(parentPath, ec);
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        bool ok = out.good() &&
+                  out.write(FormCacheMagic.data(), FormCacheMagic.size()).good() &&
+                  writeLE(out, FormCacheVersion) &&
+                  writeLE(out, static_cast<std::uint32_t>(cache.size()));
+
+        for (auto it = cache.cbegin(); ok && it != cache.cend(); ++it)
+        {
+            std::string formPath = it->first.string();
+            ok = writeLE(out, static_cast<std::uint16_t>(formPath.size())) &&
+                 out.write(formPath.data(), formPath.size()).good() &&
+                 writeLE(out, it->second.key) &&
+                 writeLE(out, static_cast<std::uint32_t>(it->second.blobs.size()));
+
+            for (auto blob = it->second.blobs.cbegin(); ok && blob != it->second.blobs.cend(); ++blob)
+            {
+                ok = writeLE(out, blob->position.x()) &&
+                     writeLE(out, blob->position.y()) &&
+                     writeLE(out, blob->position.z()) &&
+                     writeLE(out, blob->colorIndex) &&
+                     writeLE(out, blob->brightness);
+            }
+        }
+
+        if (!ok)
+        {
+            GetLogger()->warn(_("Failed to write galaxy form cache {}\n"), path);
+            return;
+        }
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec)
+        GetLogger()->warn(_("Failed to write galaxy form cache {}\n"), path);
+}
+
 int
 GalacticFormManager::getCount() const
 {
@@ -188,15 +410,23 @@ GalacticFormManager::initializeStandardForms()
     irregularForm->blobs = std::move(irregularPoints);
     irregularForm->scale = Eigen::Vector3f::Constant(0.5f);
 
-    // Spiral Galaxies, 7 classical Hubble types
+    // Spiral Galaxies, 7 classical Hubble types, followed by the E0
+    // template of the elliptical ones
+
+    std::vector<std::optional<GalacticForm>> forms = loadForms({
+        "models/S0.png",
+        "models/Sa.png",
+        "models/Sb.png",
+        "models/Sc.png",
+        "models/SBa.png",
+        "models/SBb.png",
+        "models/SBc.png",
+        "models/E0.png",
+    });
 
-    galacticForms.push_back(buildGalacticForm("models/S0.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sa.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sb.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sc.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBa.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBb.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBc.png"));
+    std::optional<GalacticForm> e0Form = std::move(forms.back());
+    forms.pop_back();
+    std::move(forms.begin(), forms.end(), std::back_inserter(galacticForms));
 
     // Elliptical Galaxies , 8 classical Hubble types, E0..E7,
     //
@@ -209,7 +439,7 @@ GalacticFormManager::initializeStandardForms()
 
         // note the correct x,y-alignment of 'ell' scaling!!
         // build all elliptical templates from rescaling E0
-        auto ellipticalForm = buildGalacticForm("models/E0.png");
+        auto ellipticalForm = e0Form;
         if (ellipticalForm.has_value())
         {
             ellipticalForm->scale = Eigen::Vector3f(ell, ell, 1.0f);
@@ -47,18 +47,36 @@ public:
 
     static GalacticFormManager* get();
 
+    /*! Set the file where the blobs generated from form templates are
+     *  cached between sessions. Must be called before the first call to
+     *  get() to have an effect.
+     */
+    static void setCacheFile(const fs::path& path);
+
     const GalacticForm* getForm(int) const;
     int getCustomForm(const fs::path& path);
 
     int getCount() const;
 
 private:
+    struct CacheEntry
+    {
+        std::uint64_t            key;
+        GalacticForm::BlobVector blobs;
+    };
+
     void initializeStandardForms();
+    std::vector<std::optional<GalacticForm>> loadForms(const std::vector<fs::path>& paths);
+
+    void readCache();
+    void writeCache() const;
 
     static constexpr std::size_t GalacticFormsReserve = 32;
 
     std::vector<std::optional<GalacticForm>> galacticForms{ };
     std::map<fs::path, int> customForms{ };
+    // generated blobs by template path
+    std::map<fs::path, CacheEntry> cache{ };
 };
 
 } // namespace celestia::engine
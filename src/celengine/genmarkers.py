@@ -125,7 +125,7 @@ result = []
 offset = 0
 for m in filledMarkers:
     offsets.append(offset)
-    count = len(m) / 2
+    count = len(m) // 2
     counts.append(count)
     offset += count
     result += m
@@ -188,6 +188,9 @@ print("constexpr int SelPointerOffset = {};".format(offsets[FilledMarkers.SelPoi
 print("constexpr int CrosshairCount   = {};".format(counts[FilledMarkers.Crosshair.value]))
 print("constexpr int CrosshairOffset  = {};".format(offsets[FilledMarkers.Crosshair.value]))
 
+filledOffsets = offsets
+filledCounts = counts
+
 ### Markers drawn with lines
 
 class HollowMarkers(Enum):
@@ -234,7 +237,7 @@ result = []
 offset = 0
 for m in hollowMarkers:
     offsets.append(offset)
-    count = len(m) / 2
+    count = len(m) // 2
     counts.append(count)
     offset += count
     result += m
@@ -285,3 +288,30 @@ print("        break;")
 print("    }")
 print("    lr.finish();")
 print("}")
+
+print("\n// Vertices of a symbol drawn at size in FilledMarkersData or HollowMarkersData")
+print("MarkerShape\nGetMarkerShape(MarkerRepresentation::Symbol symbol, float size)")
+print("{")
+print("    switch (symbol)")
+print("    {")
+for i in FilledMarkers:
+    if not i.name in ['Disk', 'LargeDisk', 'SelPointer', 'Crosshair']:
+        prim = 'TriangleFan' if i.name  == 'FilledSquare' else 'Triangles'
+        print("    case MarkerRepresentation::{}:".format(i.name))
+        print("        return {{ MarkerShape::Filled, gl::VertexObject::Primitive::{}, {}, {} }};".format(prim, filledCounts[i.value], filledOffsets[i.value]))
+print("    case MarkerRepresentation::Disk:")
+print("        if (size <= 40.0f)")
+print("            return {{ MarkerShape::Filled, gl::VertexObject::Primitive::TriangleFan, {}, {} }};".format(filledCounts[FilledMarkers.Disk.value], filledOffsets[FilledMarkers.Disk.value]))
+print("        return {{ MarkerShape::Filled, gl::VertexObject::Primitive::TriangleFan, {}, {} }};".format(filledCounts[FilledMarkers.LargeDisk.value], filledOffsets[FilledMarkers.LargeDisk.value]))
+for i in HollowMarkers:
+    if i.name != 'Circle' and i.name != 'LargeCircle':
+        print("    case MarkerRepresentation::{}:".format(i.name))
+        print("        return {{ MarkerShape::Hollow, gl::VertexObject::Primitive::Lines, {}, {} }};".format(counts[i.value], offsets[i.value]))
+print("    case MarkerRepresentation::Circle:")
+print("        if (size <= 40.0f)")
+print("            return {{ MarkerShape::Hollow, gl::VertexObject::Primitive::Lines, {}, {} }};".format(counts[HollowMarkers.Circle.value], offsets[HollowMarkers.Circle.value]))
+print("        return {{ MarkerShape::Hollow, gl::VertexObject::Primitive::Lines, {}, {} }};".format(counts[HollowMarkers.LargeCircle.value], offsets[HollowMarkers.LargeCircle.value]))
+print("    default:")
+print("        return { MarkerShape::None, gl::VertexObject::Primitive::Triangles, 0, 0 };")
+print("    }")
+print("}")
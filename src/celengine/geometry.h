@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <Eigen/Geometry>
 
 #include <celmodel/material.h>
@@ -51,4 +53,12 @@ public:
     virtual void loadTextures()
     {
     }
+
+    /*! Return the approximate size of the vertex and index data in
+     *  bytes, used for the memory budget of the geometry manager.
+     */
+    virtual std::size_t getMemorySize() const
+    {
+        return 0;
+    }
 };
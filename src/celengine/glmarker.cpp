@@ -8,6 +8,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 
@@ -18,8 +19,11 @@
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celrender/linerenderer.h>
+#include "glmarker.h"
+#include "glsupport.h"
 #include "marker.h"
 #include "render.h"
+#include "shadermanager.h"
 
 
 using namespace celestia;
@@ -29,8 +33,33 @@ namespace
 {
 constexpr float pif = celestia::numbers::pi_v<float>;
 
+struct MarkerShape
+{
+    enum Kind
+    {
+        None,
+        Filled,
+        Hollow,
+    };
+
+    Kind kind;
+    gl::VertexObject::Primitive primitive;
+    int count;
+    int offset;
+};
+
 #include "markers.inc"
 
+[[ nodiscard ]] inline bool
+isInstancingSupported()
+{
+#ifdef GL_ES
+    return gl::checkVersion(gl::GLES_3_0);
+#else
+    return gl::ARB_instanced_arrays;
+#endif
+}
+
 void
 initialize(LineRenderer &lr, gl::VertexObject &vo, gl::Buffer &bo)
 {
@@ -211,3 +240,141 @@ Renderer::renderCrosshair(float selectionSizeInPixels,
         m_markerVO->draw(gl::VertexObject::Primitive::Triangles, CrosshairCount, CrosshairOffset);
     }
 }
+
+
+namespace celestia::engine
+{
+
+struct MarkerBatch::Batch
+{
+    MarkerShape shape;
+    std::vector<Instance> instances;
+};
+
+
+MarkerBatch::MarkerBatch(const Renderer& renderer) :
+    m_renderer(renderer)
+{
+}
+
+
+MarkerBatch::~MarkerBatch() = default;
+
+
+bool
+MarkerBatch::add(MarkerRepresentation::Symbol symbol,
+                 float size,
+                 const Color& color,
+                 const Eigen::Vector3f& position)
+{
+    if (!initialize())
+        return false;
+
+    MarkerShape shape = GetMarkerShape(symbol, size);
+    if (shape.kind == MarkerShape::None)
+        return false;
+
+    // Lines wider than the implementation draws are triangulated by the
+    // line renderer
+    if (shape.kind == MarkerShape::Hollow && lineWidth() > gl::maxLineWidth)
+        return false;
+
+    auto it = std::find_if(m_batches.begin(), m_batches.end(),
+                           [&shape](const Batch& batch)
+                           {
+                               return batch.shape.kind == shape.kind && batch.shape.offset == shape.offset;
+                           });
+    if (it == m_batches.end())
+        it = m_batches.insert(m_batches.end(), Batch{ shape, {} });
+
+    float scale = size / 2.0f * m_renderer.getScaleFactor();
+    it->instances.push_back({ position, scale, color.toVector4() });
+    return true;
+}
+
+
+void
+MarkerBatch::render(const Matrices& m)
+{
+    if (std::all_of(m_batches.begin(), m_batches.end(), [](const Batch& batch) { return batch.instances.empty(); }))
+        return;
+
+    m_prog->use();
+    m_prog->setMVPMatrices(*m.projection, *m.modelview);
+
+    for (Batch& batch : m_batches)
+    {
+        if (batch.instances.empty())
+            continue;
+
+        gl::VertexObject* vo = m_filledVO.get();
+        if (batch.shape.kind == MarkerShape::Hollow)
+        {
+            glLineWidth(lineWidth());
+            vo = m_hollowVO.get();
+        }
+
+        m_instanceBO->bind().setData(batch.instances, gl::Buffer::BufferUsage::StreamDraw);
+        vo->setPrimitive(batch.shape.primitive);
+        vo->drawInstanced(batch.shape.count, static_cast<int>(batch.instances.size()), batch.shape.offset);
+        batch.instances.clear();
+    }
+
+    m_instanceBO->unbind();
+}
+
+
+bool
+MarkerBatch::initialize()
+{
+    if (m_state != State::Uninitialized)
+        return m_state == State::Ready;
+
+    m_state = State::Unsupported;
+    if (!isInstancingSupported())
+        return false;
+
+    m_prog = m_renderer.getShaderManager().getShader("marker");
+    if (m_prog == nullptr)
+        return false;
+
+    int positionLoc = m_prog->attribIndex("in_Center");
+    int scaleLoc = m_prog->attribIndex("in_Scale");
+    if (positionLoc < 0 || scaleLoc < 0)
+        return false;
+
+    m_filledBO = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, FilledMarkersData);
+    m_hollowBO = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, HollowMarkersData);
+    m_instanceBO = std::make_unique<gl::Buffer>();
+
+    auto createVO = [&](const gl::Buffer& shapes)
+    {
+        auto vo = std::make_unique<gl::VertexObject>();
+        vo->addVertexBuffer(shapes, CelestiaGLProgram::VertexCoordAttributeIndex, 2, gl::VertexObject::DataType::Float);
+        vo->addVertexBuffer(*m_instanceBO, positionLoc, 3, gl::VertexObject::DataType::Float,
+                            false, sizeof(Instance), offsetof(Instance, position), 1);
+        vo->addVertexBuffer(*m_instanceBO, scaleLoc, 1, gl::VertexObject::DataType::Float,
+                            false, sizeof(Instance), offsetof(Instance, scale), 1);
+        vo->addVertexBuffer(*m_instanceBO, CelestiaGLProgram::ColorAttributeIndex, 4, gl::VertexObject::DataType::Float,
+                            false, sizeof(Instance), offsetof(Instance, color), 1);
+        return vo;
+    };
+
+    m_filledVO = createVO(*m_filledBO);
+    m_hollowVO = createVO(*m_hollowBO);
+    m_instanceBO->unbind();
+
+    m_state = State::Ready;
+    return true;
+}
+
+
+// Width of the lines of the hollow markers drawn by the line renderer
+float
+MarkerBatch::lineWidth() const
+{
+    float width = (m_renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0 ? 1.5f : 1.0f;
+    return width * m_renderer.getScaleFactor();
+}
+
+} // end namespace celestia::engine
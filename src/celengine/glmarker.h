@@ -0,0 +1,91 @@
+// glmarker.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celutil/color.h>
+#include "marker.h"
+
+class CelestiaGLProgram;
+class Renderer;
+struct Matrices;
+
+namespace celestia::gl
+{
+class Buffer;
+class VertexObject;
+}
+
+namespace celestia::engine
+{
+
+/*! Collects the markers of a set of annotations and draws the markers of
+ *  each shape with a single instanced draw, taking the position, size and
+ *  color of each marker from a per-instance attribute. Scripts mark
+ *  thousands of objects, which would otherwise be a draw call each.
+ *
+ *  The shapes are the ones drawn by Renderer::renderMarker. Symbols which
+ *  can't be batched, and all of them without instanced arrays, are left to
+ *  be drawn on their own.
+ */
+class MarkerBatch
+{
+public:
+    explicit MarkerBatch(const Renderer&);
+    ~MarkerBatch();
+
+    /*! Add a marker of size pixels centered at position, in the coordinates
+     *  of the matrices it will be rendered with. Return false if the marker
+     *  has to be drawn on its own instead.
+     */
+    bool add(MarkerRepresentation::Symbol symbol,
+             float size,
+             const Color& color,
+             const Eigen::Vector3f& position);
+
+    // Draw the markers added since the last call and clear the batch
+    void render(const Matrices&);
+
+private:
+    struct Instance
+    {
+        Eigen::Vector3f position;
+        float scale;
+        Eigen::Vector4f color;
+    };
+
+    struct Batch;
+
+    bool initialize();
+    float lineWidth() const;
+
+    enum class State
+    {
+        Uninitialized,
+        Ready,
+        Unsupported,
+    };
+
+    const Renderer& m_renderer;
+    State m_state{ State::Uninitialized };
+    CelestiaGLProgram* m_prog{ nullptr };
+    std::unique_ptr<gl::Buffer> m_filledBO;
+    std::unique_ptr<gl::Buffer> m_hollowBO;
+    std::unique_ptr<gl::Buffer> m_instanceBO;
+    std::unique_ptr<gl::VertexObject> m_filledVO;
+    std::unique_ptr<gl::VertexObject> m_hollowVO;
+    std::vector<Batch> m_batches;
+};
+
+} // end namespace celestia::engine
@@ -13,6 +13,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <istream>
+#include <ostream>
 
 #include <fmt/printf.h>
 
@@ -22,6 +24,8 @@
 #include <celmath/intersect.h>
 #include <celmath/randutils.h>
 #include <celmath/ray.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/gettext.h>
 #include "globular.h"
 
@@ -151,3 +155,33 @@ void Globular::setDetail(float _detail)
 {
     detail = _detail;
 }
+
+
+// Binary record: the common DSO record, then
+//   f32      detail
+//   f32      core radius
+//   f32      King concentration
+bool Globular::saveBinary(std::ostream& out, const AssociativeArray& params) const
+{
+    return DeepSkyObject::saveBinary(out, params) &&
+           celestia::util::writeLE<float>(out, detail) &&
+           celestia::util::writeLE<float>(out, r_c) &&
+           celestia::util::writeLE<float>(out, c);
+}
+
+
+bool Globular::loadBinary(std::istream& in, const fs::path& resPath)
+{
+    if (!DeepSkyObject::loadBinary(in, resPath) ||
+        !celestia::util::readLE<float>(in, detail) ||
+        !celestia::util::readLE<float>(in, r_c) ||
+        !celestia::util::readLE<float>(in, c))
+    {
+        return false;
+    }
+
+    formIndex = cSlot(c);
+    recomputeTidalRadius();
+
+    return true;
+}
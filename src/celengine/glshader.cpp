@@ -9,9 +9,11 @@
 
 #include <celutil/logger.h>
 #include "glshader.h"
+#include "glsupport.h"
 
 using celestia::util::GetLogger;
 
+namespace gl = celestia::gl;
 
 namespace
 {
@@ -226,7 +228,7 @@ GLProgram::~GLProgram()
 void
 GLProgram::use() const
 {
-    glUseProgram(id);
+    gl::useProgram(id);
 }
 
 
@@ -239,9 +241,34 @@ GLProgram::attach(const GLShader& shader)
 
 GLShaderStatus
 GLProgram::link()
+{
+    startLink();
+    return getLinkStatus();
+}
+
+
+void
+GLProgram::startLink()
 {
     glLinkProgram(id);
+}
+
 
+bool
+GLProgram::isLinkComplete() const
+{
+    if (!celestia::gl::KHR_parallel_shader_compile)
+        return true;
+
+    GLint complete;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+
+GLShaderStatus
+GLProgram::getLinkStatus() const
+{
     GLint linkSuccess;
     glGetProgramiv(id, GL_LINK_STATUS, &linkSuccess);
     if (linkSuccess != GL_TRUE)
@@ -337,6 +364,35 @@ GLShaderLoader::CreateGeometryShader(const std::vector<std::string>& source,
     return GLShaderStatus::OK;
 }
 
+GLShaderStatus
+GLShaderLoader::CreateComputeShader(const std::vector<std::string>& source,
+                                    GLComputeShader** cs)
+{
+#ifdef GL_ES
+    return GLShaderStatus::CompileError;
+#else
+    GLuint csid = glCreateShader(GL_COMPUTE_SHADER);
+
+    auto* shader = new GLComputeShader(csid);
+
+    GLShaderStatus status = shader->compile(source);
+    if (status != GLShaderStatus::OK)
+    {
+        if (g_shaderLogFile != nullptr)
+        {
+            *g_shaderLogFile << "Error compiling compute shader:\n";
+            *g_shaderLogFile << GetInfoLog(shader->getID());
+        }
+        delete shader;
+        return status;
+    }
+
+    *cs = shader;
+
+    return GLShaderStatus::OK;
+#endif
+}
+
 GLShaderStatus
 GLShaderLoader::CreateVertexShader(const std::string& source,
                                    GLVertexShader** vs)
@@ -506,3 +562,73 @@ GLShaderLoader::CreateProgram(const std::string& vsSource,
 
     return CreateProgram(vsSourceVec, gsSourceVec, fsSourceVec, progOut);
 }
+
+
+GLShaderStatus
+GLShaderLoader::CreateComputeProgram(const std::string& csSource,
+                                     GLProgram** progOut)
+{
+    GLComputeShader* cs = nullptr;
+    GLShaderStatus status = CreateComputeShader({ csSource }, &cs);
+    if (status != GLShaderStatus::OK)
+        return status;
+
+    auto* prog = new GLProgram(glCreateProgram());
+    prog->attach(*cs);
+    *progOut = prog;
+
+    // The program doesn't reference the shader once it's attached
+    delete cs;
+
+    return GLShaderStatus::OK;
+}
+
+
+GLShaderStatus
+GLShaderLoader::CreateProgramAsync(const std::string& vsSource,
+                                   const std::string& fsSource,
+                                   GLProgram** progOut)
+{
+    if (vsSource.empty() || fsSource.empty())
+        return GLShaderStatus::EmptyProgram;
+
+    auto* prog = new GLProgram(glCreateProgram());
+    for (const auto& [type, source] : { std::make_pair(GL_VERTEX_SHADER, &vsSource),
+                                        std::make_pair(GL_FRAGMENT_SHADER, &fsSource) })
+    {
+        GLuint shader = glCreateShader(type);
+        const char* sourceString = source->c_str();
+        glShaderSource(shader, 1, &sourceString, nullptr);
+        glCompileShader(shader);
+        glAttachShader(prog->getID(), shader);
+        // Deleted along with the program
+        glDeleteShader(shader);
+    }
+
+    *progOut = prog;
+
+    return GLShaderStatus::OK;
+}
+
+
+GLShaderStatus
+GLShaderLoader::CreateProgramFromBinary(GLenum format,
+                                        const void* binary,
+                                        GLsizei length,
+                                        GLProgram** progOut)
+{
+    GLuint progid = glCreateProgram();
+    glProgramBinary(progid, format, binary, length);
+
+    GLint linkSuccess;
+    glGetProgramiv(progid, GL_LINK_STATUS, &linkSuccess);
+    if (linkSuccess != GL_TRUE)
+    {
+        glDeleteProgram(progid);
+        return GLShaderStatus::LinkError;
+    }
+
+    *progOut = new GLProgram(progid);
+
+    return GLShaderStatus::OK;
+}
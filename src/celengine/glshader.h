@@ -73,6 +73,15 @@ class GLFragmentShader : public GLShader
 };
 
 
+class GLComputeShader : public GLShader
+{
+ private:
+    GLComputeShader(GLuint _id) : GLShader(_id) {};
+
+ friend class GLShaderLoader;
+};
+
+
 class GLProgram
 {
  private:
@@ -85,6 +94,13 @@ class GLProgram
 
     GLShaderStatus link();
 
+    // Link without waiting for the result. With
+    // GL_KHR_parallel_shader_compile the driver links in the background
+    // until isLinkComplete() is true; getLinkStatus() waits for it.
+    void startLink();
+    bool isLinkComplete() const;
+    GLShaderStatus getLinkStatus() const;
+
     void use() const;
     GLuint getID() const { return id; }
 
@@ -196,6 +212,8 @@ class GLShaderLoader
                                                GLGeometryShader**);
     static GLShaderStatus CreateFragmentShader(const std::vector<std::string>&,
                                                GLFragmentShader**);
+    static GLShaderStatus CreateComputeShader(const std::vector<std::string>&,
+                                              GLComputeShader**);
     static GLShaderStatus CreateVertexShader(const std::string&,
                                              GLVertexShader**);
     static GLShaderStatus CreateFragmentShader(const std::string&,
@@ -222,6 +240,21 @@ class GLShaderLoader
                                         const std::string& fsSource,
                                         const std::string& gsSource,
                                         GLProgram**);
+    // Create an unlinked program made of a compute shader; requires
+    // OpenGL 4.3
+    static GLShaderStatus CreateComputeProgram(const std::string& csSource,
+                                               GLProgram**);
+    // Create a program without waiting for the shaders to be compiled;
+    // compile errors are reported when the program is linked
+    static GLShaderStatus CreateProgramAsync(const std::string& vsSource,
+                                             const std::string& fsSource,
+                                             GLProgram**);
+    // Create a linked program from a binary returned by
+    // glGetProgramBinary; LinkError if the driver rejects the binary
+    static GLShaderStatus CreateProgramFromBinary(GLenum format,
+                                                  const void* binary,
+                                                  GLsizei length,
+                                                  GLProgram**);
 };
 
 
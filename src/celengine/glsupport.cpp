@@ -12,15 +12,26 @@ CELAPI bool OES_geometry_shader            = false;
 #else
 CELAPI bool ARB_vertex_array_object        = false;
 CELAPI bool ARB_framebuffer_object         = false;
+CELAPI bool ARB_map_buffer_range           = false;
+CELAPI bool ARB_sync                       = false;
+CELAPI bool ARB_buffer_storage             = false;
+CELAPI bool ARB_timer_query                = false;
+CELAPI bool ARB_get_program_binary         = false;
+CELAPI bool ARB_instanced_arrays           = false;
+CELAPI bool ARB_clip_control               = false;
+CELAPI bool ARB_sparse_texture             = false;
 #endif
 CELAPI bool ARB_shader_texture_lod         = false;
 CELAPI bool EXT_texture_compression_s3tc   = false;
 CELAPI bool EXT_texture_filter_anisotropic = false;
 CELAPI bool MESA_pack_invert               = false;
+CELAPI bool KHR_parallel_shader_compile    = false;
 CELAPI GLint maxPointSize                  = 0;
 CELAPI GLint maxTextureSize                = 0;
 CELAPI GLfloat maxLineWidth                = 0.0f;
 CELAPI GLint maxTextureAnisotropy          = 0;
+CELAPI DrawCounters drawCounters;
+CELAPI StateCache stateCache;
 
 namespace
 {
@@ -71,8 +82,50 @@ void enable_workarounds()
         EnableGeomShaders = false;
 }
 
+void forgetBinding(GLuint& binding, GLsizei n, const GLuint* names) noexcept
+{
+    if (std::find(names, names + n, binding) != names + n)
+        binding = 0;
+}
+
 } // namespace
 
+void deleteTextures(GLsizei n, const GLuint* textures) noexcept
+{
+    for (auto& unit : stateCache.textures)
+    {
+        for (GLuint& binding : unit)
+            forgetBinding(binding, n, textures);
+    }
+    glDeleteTextures(n, textures);
+}
+
+void deleteBuffers(GLsizei n, const GLuint* buffers) noexcept
+{
+    forgetBinding(stateCache.arrayBuffer, n, buffers);
+    forgetBinding(stateCache.elementArrayBuffer, n, buffers);
+    glDeleteBuffers(n, buffers);
+}
+
+void deleteVertexArrays(GLsizei n, const GLuint* vertexArrays) noexcept
+{
+    if (std::find(vertexArrays, vertexArrays + n, stateCache.vertexArray) != vertexArrays + n)
+    {
+        stateCache.vertexArray = 0;
+        stateCache.elementArrayBuffer = StateCache::Unknown;
+    }
+    glDeleteVertexArrays(n, vertexArrays);
+}
+
+void invalidateState() noexcept
+{
+    stateCache = StateCache();
+    for (auto& unit : stateCache.textures)
+        unit.fill(StateCache::Unknown);
+    stateCache.textureUnit = 0;
+    glActiveTexture(GL_TEXTURE0);
+}
+
 bool init(util::array_view<std::string> ignore) noexcept
 {
 #ifdef GL_ES
@@ -82,11 +135,20 @@ bool init(util::array_view<std::string> ignore) noexcept
 #else
     ARB_vertex_array_object        = check_extension(ignore, "GL_ARB_vertex_array_object");
     ARB_framebuffer_object         = check_extension(ignore, "GL_ARB_framebuffer_object") || check_extension(ignore, "GL_EXT_framebuffer_object");
+    ARB_map_buffer_range           = checkVersion(GL_3_0) || check_extension(ignore, "GL_ARB_map_buffer_range");
+    ARB_sync                       = checkVersion(GL_3_2) || check_extension(ignore, "GL_ARB_sync");
+    ARB_buffer_storage             = checkVersion(GL_4_4) || check_extension(ignore, "GL_ARB_buffer_storage");
+    ARB_timer_query                = checkVersion(GL_3_3) || check_extension(ignore, "GL_ARB_timer_query");
+    ARB_get_program_binary         = checkVersion(GL_4_1) || check_extension(ignore, "GL_ARB_get_program_binary");
+    ARB_instanced_arrays           = checkVersion(GL_3_3) || check_extension(ignore, "GL_ARB_instanced_arrays");
+    ARB_clip_control               = checkVersion(GL_4_5) || check_extension(ignore, "GL_ARB_clip_control");
+    ARB_sparse_texture             = check_extension(ignore, "GL_ARB_sparse_texture");
 #endif
     ARB_shader_texture_lod         = check_extension(ignore, "GL_ARB_shader_texture_lod");
     EXT_texture_compression_s3tc   = check_extension(ignore, "GL_EXT_texture_compression_s3tc");
     EXT_texture_filter_anisotropic = check_extension(ignore, "GL_EXT_texture_filter_anisotropic") || check_extension(ignore, "GL_ARB_texture_filter_anisotropic");
     MESA_pack_invert               = check_extension(ignore, "GL_MESA_pack_invert");
+    KHR_parallel_shader_compile    = check_extension(ignore, "GL_KHR_parallel_shader_compile");
 
     GLint pointSizeRange[2];
     GLfloat lineWidthRange[2];
@@ -106,6 +168,7 @@ bool init(util::array_view<std::string> ignore) noexcept
         glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxTextureAnisotropy);
 
     enable_workarounds();
+    invalidateState();
 
     return true;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <celutil/array_view.h>
 
@@ -31,6 +34,10 @@ enum Version
     GL_3_1   = 31,
     GL_3_2   = 32,
     GL_3_3   = 33,
+    GL_4_1   = 41,
+    GL_4_3   = 43,
+    GL_4_4   = 44,
+    GL_4_5   = 45,
     GLES_2   = 20,
     GLES_2_0 = 20,
     GLES_3   = 30,
@@ -43,6 +50,7 @@ extern CELAPI bool ARB_shader_texture_lod; //NOSONAR
 extern CELAPI bool EXT_texture_compression_s3tc; //NOSONAR
 extern CELAPI bool EXT_texture_filter_anisotropic; //NOSONAR
 extern CELAPI bool MESA_pack_invert; //NOSONAR
+extern CELAPI bool KHR_parallel_shader_compile; //NOSONAR
 #ifdef GL_ES
 extern CELAPI bool OES_vertex_array_object; //NOSONAR
 extern CELAPI bool OES_texture_border_clamp; //NOSONAR
@@ -50,12 +58,176 @@ extern CELAPI bool OES_geometry_shader; //NOSONAR
 #else
 extern CELAPI bool ARB_vertex_array_object; //NOSONAR
 extern CELAPI bool ARB_framebuffer_object; //NOSONAR
+extern CELAPI bool ARB_map_buffer_range; //NOSONAR
+extern CELAPI bool ARB_sync; //NOSONAR
+extern CELAPI bool ARB_buffer_storage; //NOSONAR
+extern CELAPI bool ARB_timer_query; //NOSONAR
+extern CELAPI bool ARB_get_program_binary; //NOSONAR
+extern CELAPI bool ARB_instanced_arrays; //NOSONAR
+extern CELAPI bool ARB_clip_control; //NOSONAR
+extern CELAPI bool ARB_sparse_texture; //NOSONAR
 #endif
 extern CELAPI GLint maxPointSize; //NOSONAR
 extern CELAPI GLint maxTextureSize; //NOSONAR
 extern CELAPI GLfloat maxLineWidth; //NOSONAR
 extern CELAPI GLint maxTextureAnisotropy; //NOSONAR
 
+// Totals of the draw calls, triangles and bytes uploaded to buffers and
+// textures, used by the frame profiler. GL is only used from one thread,
+// so they're plain counters.
+struct DrawCounters
+{
+    std::uint64_t drawCalls{ 0 };
+    std::uint64_t triangles{ 0 };
+    std::uint64_t uploadedBytes{ 0 };
+    // Binding and pipeline state changes made, and those skipped because
+    // the state was already set
+    std::uint64_t stateChanges{ 0 };
+    std::uint64_t skippedStateChanges{ 0 };
+};
+
+extern CELAPI DrawCounters drawCounters; //NOSONAR
+
+/*! The program, vertex array, buffers and textures bound to the context,
+ *  so that binding an object which is already bound makes no GL call. The
+ *  engine binds them through the functions below only; code binding them
+ *  directly, as a frontend drawing its own widgets may, has to call
+ *  invalidateState() before the engine draws again. Unknown bindings are
+ *  held as Unknown.
+ */
+struct StateCache
+{
+    static constexpr GLuint Unknown = ~static_cast<GLuint>(0);
+    static constexpr std::size_t TextureUnits = 32;
+    // 2D, cube map, 1D and 3D
+    static constexpr std::size_t TextureTargets = 4;
+
+    GLuint program{ Unknown };
+    GLuint vertexArray{ Unknown };
+    GLuint arrayBuffer{ Unknown };
+    // Part of the vertex array state, unknown after binding another one
+    GLuint elementArrayBuffer{ Unknown };
+    // Index of the active texture unit
+    GLuint textureUnit{ Unknown };
+    std::array<std::array<GLuint, TextureTargets>, TextureUnits> textures{ };
+};
+
+extern CELAPI StateCache stateCache; //NOSONAR
+
+inline void countStateChange(bool changed) noexcept
+{
+    if (changed)
+        drawCounters.stateChanges++;
+    else
+        drawCounters.skippedStateChanges++;
+}
+
+// Update a cached binding, returning whether it changed
+inline bool updateBinding(GLuint& binding, GLuint value) noexcept
+{
+    bool changed = binding != value;
+    binding = value;
+    countStateChange(changed);
+    return changed;
+}
+
+inline void useProgram(GLuint program) noexcept
+{
+    if (updateBinding(stateCache.program, program))
+        glUseProgram(program);
+}
+
+inline void bindVertexArray(GLuint vertexArray) noexcept
+{
+    if (updateBinding(stateCache.vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        stateCache.elementArrayBuffer = StateCache::Unknown;
+    }
+}
+
+inline void bindBuffer(GLenum target, GLuint buffer) noexcept
+{
+    bool changed = true;
+    if (target == GL_ARRAY_BUFFER)
+        changed = updateBinding(stateCache.arrayBuffer, buffer);
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+        changed = updateBinding(stateCache.elementArrayBuffer, buffer);
+    else
+        countStateChange(true);
+
+    if (changed)
+        glBindBuffer(target, buffer);
+}
+
+inline void activeTexture(GLenum unit) noexcept
+{
+    if (updateBinding(stateCache.textureUnit, unit - GL_TEXTURE0))
+        glActiveTexture(unit);
+}
+
+namespace detail
+{
+inline GLuint* cachedTexture(GLenum target) noexcept
+{
+    if (stateCache.textureUnit >= StateCache::TextureUnits)
+        return nullptr;
+
+    auto& textures = stateCache.textures[stateCache.textureUnit];
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return &textures[0];
+    case GL_TEXTURE_CUBE_MAP:
+        return &textures[1];
+    case GL_TEXTURE_1D:
+        return &textures[2];
+    case GL_TEXTURE_3D:
+        return &textures[3];
+    default:
+        return nullptr;
+    }
+}
+} // end namespace detail
+
+inline void bindTexture(GLenum target, GLuint texture) noexcept
+{
+    GLuint* binding = detail::cachedTexture(target);
+    bool changed = true;
+    if (binding == nullptr)
+        countStateChange(true);
+    else
+        changed = updateBinding(*binding, texture);
+
+    if (changed)
+        glBindTexture(target, texture);
+}
+
+// Deleting a bound object resets its bindings to 0, and these keep the
+// cache in step so that a new object reusing the name still gets bound.
+void deleteTextures(GLsizei n, const GLuint* textures) noexcept;
+void deleteBuffers(GLsizei n, const GLuint* buffers) noexcept;
+void deleteVertexArrays(GLsizei n, const GLuint* vertexArrays) noexcept;
+
+// Forget all the cached bindings and select texture unit 0
+void invalidateState() noexcept;
+
+inline void countDraw(GLenum primitive, GLsizei count, GLsizei instances = 1) noexcept
+{
+    drawCounters.drawCalls++;
+    std::uint64_t triangles = 0;
+    if (primitive == GL_TRIANGLES)
+        triangles = static_cast<std::uint64_t>(count / 3);
+    else if ((primitive == GL_TRIANGLE_STRIP || primitive == GL_TRIANGLE_FAN) && count > 2)
+        triangles = static_cast<std::uint64_t>(count - 2);
+    drawCounters.triangles += triangles * static_cast<std::uint64_t>(instances);
+}
+
+inline void countUpload(std::size_t bytes) noexcept
+{
+    drawCounters.uploadedBytes += bytes;
+}
+
 bool init(util::array_view<std::string> = {}) noexcept;
 bool checkVersion(int) noexcept;
 bool hasGeomShader() noexcept;
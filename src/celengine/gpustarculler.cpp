@@ -0,0 +1,205 @@
+// gpustarculler.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "gpustarculler.h"
+
+#include <algorithm>
+#include <array>
+
+#include <celrender/gl/buffer.h>
+#include <celutil/array_view.h>
+#include <celutil/color.h>
+#include "shadermanager.h"
+#include "star.h"
+#include "starcolors.h"
+#include "stardb.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Must match the shader
+constexpr GLuint WorkGroupSize = 256;
+constexpr GLuint MaxWorkGroups = 65535;
+
+// Bytes per vertex, laid out like PointStarVertexBuffer's: position, size
+// and RGBA color
+constexpr std::size_t VertexSize = 5 * sizeof(float);
+
+// Absolute magnitude uploaded for stars the shader must skip
+constexpr float SkippedStarMagnitude = 1000.0f;
+
+enum Binding : GLuint
+{
+    PositionBinding    = 0,
+    TemperatureBinding = 1,
+    VertexBinding      = 2,
+    CommandBinding     = 3,
+};
+
+} // end unnamed namespace
+
+
+bool
+GPUStarCuller::isSupported()
+{
+#ifdef GL_ES
+    return false;
+#else
+    return gl::checkVersion(gl::GL_4_3);
+#endif
+}
+
+
+GPUStarCuller::GPUStarCuller(ShaderManager& shaderManager) :
+    m_shaderManager(shaderManager)
+{
+}
+
+
+GPUStarCuller::~GPUStarCuller()
+{
+    if (m_colorTable != 0)
+        gl::deleteTextures(1, &m_colorTable);
+}
+
+
+void
+GPUStarCuller::setStars(const StarDatabase& starDB, const ColorTemperatureTable& colorTable)
+{
+    auto colorType = static_cast<int>(colorTable.type());
+    if (&starDB == m_starDB && colorType == m_colorType)
+        return;
+
+    // All the buffers are bound as shader storage when culling; they're
+    // created as array buffers so that the vertices can be drawn
+    if (&starDB != m_starDB)
+    {
+        m_starDB = &starDB;
+        m_starCount = starDB.size();
+        m_orbitingStars.clear();
+
+        std::vector<Eigen::Vector4f> positions;
+        std::vector<float> temperatures;
+        positions.reserve(m_starCount);
+        temperatures.reserve(m_starCount);
+        for (std::uint32_t i = 0; i < m_starCount; ++i)
+        {
+            const Star* star = starDB.getStar(i);
+            float absMag = star->getAbsoluteMagnitude();
+            if (star->getOrbit() != nullptr)
+            {
+                m_orbitingStars.push_back(i);
+                absMag = SkippedStarMagnitude;
+            }
+
+            positions.emplace_back(star->getPosition().homogeneous());
+            positions.back().w() = absMag;
+            temperatures.push_back(star->getTemperature());
+        }
+
+        m_positions = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array,
+                                                   util::array_view<const void>(positions.data(), positions.size() * sizeof(Eigen::Vector4f)));
+        m_temperatures = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array,
+                                                      util::array_view<const void>(temperatures.data(), temperatures.size() * sizeof(float)));
+
+        // Room for a star and a glare sprite per star
+        m_vertices = std::make_unique<gl::Buffer>();
+        m_vertices->bind().setData(util::array_view<const void>(nullptr, std::max<std::size_t>(m_starCount, 1) * 2 * VertexSize),
+                                   gl::Buffer::BufferUsage::DynamicDraw);
+
+        m_commands = std::make_unique<gl::Buffer>();
+        gl::Buffer::unbind(gl::Buffer::TargetHint::Array);
+    }
+
+    if (colorType != m_colorType)
+    {
+        // Changing the color table only uploads the new table
+        m_colorType = colorType;
+        const std::vector<Color>& colors = colorTable.getColors();
+        std::vector<std::uint8_t> texels(colors.size() * 4);
+        for (std::size_t i = 0; i < colors.size(); ++i)
+            colors[i].get(texels.data() + i * 4);
+
+        m_colorTableSize = static_cast<int>(colors.size());
+        m_temperatureScale = colorTable.getTemperatureScale();
+
+#ifndef GL_ES
+        if (m_colorTable == 0)
+            glGenTextures(1, &m_colorTable);
+        gl::bindTexture(GL_TEXTURE_1D, m_colorTable);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, m_colorTableSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        gl::bindTexture(GL_TEXTURE_1D, 0);
+#endif
+    }
+}
+
+
+bool
+GPUStarCuller::cull(const Parameters& params)
+{
+#ifdef GL_ES
+    return false;
+#else
+    CelestiaGLProgram* prog = m_shaderManager.getComputeShader("starcull");
+    if (prog == nullptr || m_starDB == nullptr)
+        return false;
+
+    // DrawArraysIndirectCommands of the stars and of the glare, the glare
+    // sprites are written after room for a sprite per star
+    std::array<GLuint, 8> commands{ 0, 1, 0, 0, 0, 1, m_starCount, 0 };
+    m_commands->bind().setData(commands, gl::Buffer::BufferUsage::DynamicDraw);
+
+    prog->use();
+    prog->vec3Param("obsPosition") = params.obsPosition;
+    prog->vec3Param("viewNormal") = params.viewNormal;
+    prog->floatParam("cosViewCone") = params.cosViewCone;
+    prog->floatParam("minDistance") = params.minDistance;
+    prog->floatParam("distanceLimit") = params.distanceLimit;
+    prog->floatParam("faintestMagNight") = params.faintestMagNight;
+    prog->floatParam("faintestMag") = params.faintestMag;
+    prog->floatParam("saturationMag") = params.saturationMag;
+    prog->floatParam("brightnessScale") = params.brightnessScale;
+    prog->floatParam("brightnessBias") = params.brightnessBias;
+    prog->floatParam("baseSize") = params.baseSize;
+    prog->intParam("scaledDiscs") = params.scaledDiscs ? 1 : 0;
+    prog->intParam("starCount") = static_cast<int>(m_starCount);
+    prog->samplerParam("colorTable") = 0;
+    prog->intParam("colorTableSize") = m_colorTableSize;
+    prog->floatParam("temperatureScale") = m_temperatureScale;
+
+    gl::activeTexture(GL_TEXTURE0);
+    gl::bindTexture(GL_TEXTURE_1D, m_colorTable);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PositionBinding, m_positions->id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TemperatureBinding, m_temperatures->id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VertexBinding, m_vertices->id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, m_commands->id());
+
+    // The shader loops over the stars when there are more than the work
+    // groups dispatched can hold
+    GLuint groups = std::clamp((m_starCount + WorkGroupSize - 1) / WorkGroupSize, 1u, MaxWorkGroups);
+    glDispatchCompute(groups, 1, 1);
+
+    for (GLuint binding : { PositionBinding, TemperatureBinding, VertexBinding, CommandBinding })
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    gl::bindTexture(GL_TEXTURE_1D, 0);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    gl::Buffer::unbind(gl::Buffer::TargetHint::Array);
+    return true;
+#endif
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,136 @@
+// gpustarculler.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/glsupport.h>
+
+class ColorTemperatureTable;
+class ShaderManager;
+class StarDatabase;
+
+namespace celestia::gl
+{
+class Buffer;
+}
+
+namespace celestia::engine
+{
+
+/*! Stars culled by a compute shader instead of the octree traversal. The
+ *  positions, absolute magnitudes and temperatures of all the stars are
+ *  kept in shader storage buffers, and the star color table in a 1D
+ *  texture, so changing the table doesn't touch the stars. Each frame the
+ *  shader tests every star against the view cone and the magnitude limit,
+ *  computes its point and glare sprites like PointStarRenderer does, and
+ *  appends them to a vertex buffer drawn with the counts it leaves in an
+ *  indirect draw buffer.
+ *
+ *  Stars closer than NearStarDistance and stars with an orbit are left to
+ *  the CPU: float positions relative to the origin aren't accurate enough
+ *  for the former, and the latter need their positions along their orbits
+ *  and may go into the render list.
+ */
+class GPUStarCuller
+{
+public:
+    // Distance in light years below which stars are rendered on the CPU;
+    // it must be at least the largest SolarSystemMaxDistance
+    static constexpr float NearStarDistance = 10.0f;
+
+    // Offsets in the command buffer of the star and glare draws
+    static constexpr std::ptrdiff_t StarCommandOffset = 0;
+    static constexpr std::ptrdiff_t GlareCommandOffset = 4 * sizeof(GLuint);
+
+    struct Parameters
+    {
+        Eigen::Vector3f obsPosition;
+        Eigen::Vector3f viewNormal;
+        // Cosine of the half angle of the cone containing the view
+        float cosViewCone{ -1.0f };
+        float minDistance{ NearStarDistance };
+        float distanceLimit{ 0.0f };
+        // Faintest apparent magnitude of the stars processed
+        float faintestMagNight{ 0.0f };
+        // Parameters of Renderer::calculatePointSize
+        float faintestMag{ 0.0f };
+        float saturationMag{ 0.0f };
+        float brightnessScale{ 0.0f };
+        float brightnessBias{ 0.0f };
+        float baseSize{ 0.0f };
+        bool scaledDiscs{ false };
+    };
+
+    // True if the OpenGL version has compute shaders and indirect draws
+    static bool isSupported();
+
+    explicit GPUStarCuller(ShaderManager&);
+    ~GPUStarCuller();
+
+    GPUStarCuller(const GPUStarCuller&) = delete;
+    GPUStarCuller& operator=(const GPUStarCuller&) = delete;
+
+    // Upload the stars of the database if they aren't already, and the
+    // color table if it changed
+    void setStars(const StarDatabase&, const ColorTemperatureTable&);
+
+    // Run the culling shader; the vertices and commands may be used for
+    // drawing once it returns true. Return false if the shader couldn't be
+    // built.
+    bool cull(const Parameters&);
+
+    // Indices of the stars with an orbit, which aren't culled on the GPU
+    const std::vector<std::uint32_t>& getOrbitingStars() const;
+
+    const gl::Buffer& getVertices() const;
+    const gl::Buffer& getCommands() const;
+
+private:
+    ShaderManager& m_shaderManager;
+
+    const StarDatabase* m_starDB{ nullptr };
+    int m_colorType{ -1 };
+    GLuint m_starCount{ 0 };
+    std::vector<std::uint32_t> m_orbitingStars;
+
+    std::unique_ptr<gl::Buffer> m_positions;
+    std::unique_ptr<gl::Buffer> m_temperatures;
+    GLuint m_colorTable{ 0 };
+    int m_colorTableSize{ 0 };
+    float m_temperatureScale{ 0.0f };
+    std::unique_ptr<gl::Buffer> m_vertices;
+    std::unique_ptr<gl::Buffer> m_commands;
+};
+
+inline const std::vector<std::uint32_t>&
+GPUStarCuller::getOrbitingStars() const
+{
+    return m_orbitingStars;
+}
+
+inline const gl::Buffer&
+GPUStarCuller::getVertices() const
+{
+    return *m_vertices;
+}
+
+inline const gl::Buffer&
+GPUStarCuller::getCommands() const
+{
+    return *m_commands;
+}
+
+} // end namespace celestia::engine
@@ -8,6 +8,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+
 #include <celastro/units.h>
 #include <celmath/mathlib.h>
 #include <celutil/color.h>
@@ -19,25 +21,79 @@ namespace astro = celestia::astro;
 namespace math = celestia::math;
 namespace util = celestia::util;
 
+namespace
+{
+
+// Most catalog objects have fewer keys than this, so that they're added
+// without growing the vectors
+constexpr std::size_t InitialKeyCapacity = 8;
+constexpr std::size_t InitialKeyTextCapacity = 128;
+
+} // end unnamed namespace
+
 // Define these here: at declaration the vector member contains an incomplete type
+AssociativeArray::AssociativeArray()
+{
+    keyText.reserve(InitialKeyTextCapacity);
+    keys.reserve(InitialKeyCapacity);
+    values.reserve(InitialKeyCapacity);
+}
+
+
 AssociativeArray::~AssociativeArray() = default;
 
 
+std::string_view AssociativeArray::getKey(std::size_t index) const
+{
+    return std::string_view(keyText.data() + keys[index].offset, keys[index].length);
+}
+
+
 const Value* AssociativeArray::getValue(std::string_view key) const
 {
-    auto iter = assoc.find(key);
-    if (iter == assoc.end())
+    if (sortedKeys.empty())
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            if (getKey(i) == key)
+                return &values[i];
+        }
+
+        return nullptr;
+    }
+
+    auto it = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), key,
+                               [this](std::uint32_t index, std::string_view k) { return getKey(index) < k; });
+    if (it == sortedKeys.end() || getKey(*it) != key)
         return nullptr;
 
-    return &values[iter->second];
+    return &values[*it];
 }
 
 
-void AssociativeArray::addValue(std::string&& key, Value&& val)
+void AssociativeArray::addValue(std::string_view key, Value&& val)
 {
-    std::size_t index = values.size();
-    if (assoc.try_emplace(std::move(key), index).second)
-        values.emplace_back(std::move(val));
+    if (getValue(key) != nullptr)
+        return;
+
+    auto index = static_cast<std::uint32_t>(keys.size());
+    keys.push_back(Key{ static_cast<std::uint32_t>(keyText.size()), static_cast<std::uint32_t>(key.size()) });
+    keyText.append(key);
+    keyText.push_back('\0');
+    values.emplace_back(std::move(val));
+
+    auto keyLess = [this](std::uint32_t a, std::uint32_t b) { return getKey(a) < getKey(b); };
+    if (!sortedKeys.empty())
+    {
+        sortedKeys.insert(std::upper_bound(sortedKeys.begin(), sortedKeys.end(), index, keyLess), index);
+    }
+    else if (keys.size() > LinearSearchKeys)
+    {
+        sortedKeys.resize(keys.size());
+        for (std::uint32_t i = 0; i < sortedKeys.size(); ++i)
+            sortedKeys[i] = i;
+        std::sort(sortedKeys.begin(), sortedKeys.end(), keyLess);
+    }
 }
 
 
@@ -12,7 +12,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -29,12 +28,14 @@
 class Color;
 class Value;
 
+// The keys are kept in a single buffer in the order they were added, and
+// looked up by a linear search while there are only a few of them, which
+// is the case for most catalog objects. Larger hashes also keep the keys
+// sorted for a binary search.
 class AssociativeArray
 {
  public:
-    using AssocType = std::map<std::string, std::size_t, std::less<>>;
-
-    AssociativeArray() = default;
+    AssociativeArray();
     ~AssociativeArray();
     AssociativeArray(AssociativeArray&&) = delete;
     AssociativeArray(const AssociativeArray&) = delete;
@@ -42,7 +43,8 @@ class AssociativeArray
     AssociativeArray& operator=(AssociativeArray&) = delete;
 
     const Value* getValue(std::string_view) const;
-    void addValue(std::string&&, Value&&);
+    // Add a value unless the hash already has the key
+    void addValue(std::string_view, Value&&);
 
     template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
     std::optional<T> getNumber(std::string_view key) const
@@ -136,20 +138,37 @@ class AssociativeArray
 
     std::optional<Eigen::Vector3d> getSphericalTuple(std::string_view) const;
 
+    // Call action with each key and value, in the order they were added
     template<typename T>
     void for_all(T action) const
     {
-        for (const auto& [key, value] : assoc)
+        for (std::size_t i = 0; i < keys.size(); ++i)
         {
-            action(key, values[value]);
+            action(getKey(i), values[i]);
         }
     }
 
  private:
-    // At this point, Value is an incomplete type. C++17 allows us to store
-    // this in a vector but not a map, so use the map to store vector indices
+    struct Key
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    // Number of keys above which they're sorted for lookups
+    static constexpr std::size_t LinearSearchKeys = 16;
+
+    std::string_view getKey(std::size_t) const;
+
+    // The text of the keys, each followed by a NUL
+    std::string keyText;
+    std::vector<Key> keys;
+    // At this point, Value is an incomplete type, which C++17 allows us to
+    // store in a vector. The values are in the same order as the keys.
     std::vector<Value> values;
-    AssocType assoc;
+    // Indices of the keys sorted by key, only once there are more than
+    // LinearSearchKeys of them
+    std::vector<std::uint32_t> sortedKeys;
 
     std::optional<double> getNumberImpl(std::string_view) const;
     std::optional<Eigen::Vector3d> getVector3Impl(std::string_view) const;
@@ -0,0 +1,82 @@
+// labelgrid.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "labelgrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace celestia::engine
+{
+
+LabelGrid::LabelGrid(int _cellSize) :
+    cellSize(std::max(_cellSize, 1))
+{
+}
+
+
+void
+LabelGrid::reset(int width, int height)
+{
+    columns = std::max((width + cellSize - 1) / cellSize, 1);
+    rows = std::max((height + cellSize - 1) / cellSize, 1);
+
+    // Keep the storage of the cells, the grid is reset every frame
+    cells.resize(static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows));
+    for (auto& cell : cells)
+        cell.clear();
+    rects.clear();
+}
+
+
+bool
+LabelGrid::reserve(float x0, float y0, float x1, float y1)
+{
+    if (x0 > x1)
+        std::swap(x0, x1);
+    if (y0 > y1)
+        std::swap(y0, y1);
+
+    auto column0 = static_cast<int>(std::floor(x0 / static_cast<float>(cellSize)));
+    auto column1 = static_cast<int>(std::floor(x1 / static_cast<float>(cellSize)));
+    auto row0 = static_cast<int>(std::floor(y0 / static_cast<float>(cellSize)));
+    auto row1 = static_cast<int>(std::floor(y1 / static_cast<float>(cellSize)));
+    if (column1 < 0 || column0 >= columns || row1 < 0 || row0 >= rows)
+        return true;
+
+    column0 = std::max(column0, 0);
+    column1 = std::min(column1, columns - 1);
+    row0 = std::max(row0, 0);
+    row1 = std::min(row1, rows - 1);
+
+    for (int row = row0; row <= row1; ++row)
+    {
+        for (int column = column0; column <= column1; ++column)
+        {
+            for (std::uint32_t index : cells[static_cast<std::size_t>(row * columns + column)])
+            {
+                const Rect& r = rects[index];
+                if (x0 < r.x1 && r.x0 < x1 && y0 < r.y1 && r.y0 < y1)
+                    return false;
+            }
+        }
+    }
+
+    auto index = static_cast<std::uint32_t>(rects.size());
+    rects.push_back({ x0, y0, x1, y1 });
+    for (int row = row0; row <= row1; ++row)
+    {
+        for (int column = column0; column <= column1; ++column)
+            cells[static_cast<std::size_t>(row * columns + column)].push_back(index);
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,55 @@
+// labelgrid.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace celestia::engine
+{
+
+// Screen-space index of the rectangles covered by labels. The window is
+// divided into square cells which list the rectangles overlapping them,
+// so a label is only tested against the labels placed in the few cells
+// it covers.
+class LabelGrid
+{
+public:
+    static constexpr int DefaultCellSize = 32;
+
+    explicit LabelGrid(int cellSize = DefaultCellSize);
+
+    // Remove all rectangles and resize the grid to cover the window
+    void reset(int width, int height);
+
+    // Add the rectangle from (x0, y0) to (x1, y1) in window coordinates
+    // unless it overlaps a rectangle added before, return true if it was
+    // added. Rectangles outside the window are always accepted.
+    bool reserve(float x0, float y0, float x1, float y1);
+
+    std::size_t size() const { return rects.size(); }
+
+private:
+    struct Rect
+    {
+        float x0;
+        float y0;
+        float x1;
+        float y1;
+    };
+
+    int cellSize;
+    int columns{ 0 };
+    int rows{ 0 };
+    std::vector<Rect> rects;
+    std::vector<std::vector<std::uint32_t>> cells;
+};
+
+}
@@ -0,0 +1,52 @@
+// labelnames.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+
+#include <celutil/stringarena.h>
+#include "astroobj.h"
+
+namespace celestia::engine
+{
+
+/*! Names of the objects of a catalog shown in their labels, by catalog
+ *  number. A name is resolved the first time the object is labelled and
+ *  kept, so that labelling it again doesn't translate or format it. The
+ *  names are localized with the locale set when the program starts.
+ */
+class LabelNames
+{
+public:
+    template<typename F>
+    std::string_view get(AstroCatalog::IndexNumber catalogNumber, F&& resolve)
+    {
+        if (auto it = m_names.find(catalogNumber); it != m_names.end())
+            return it->second;
+
+        std::string_view name = m_strings.add(resolve());
+        m_names.try_emplace(catalogNumber, name);
+        return name;
+    }
+
+    // Resolve the names again, when the names of a catalog change
+    void clear()
+    {
+        m_names.clear();
+        m_strings.clear();
+    }
+
+private:
+    std::unordered_map<AstroCatalog::IndexNumber, std::string_view> m_names;
+    util::StringArena m_strings{ 16384 };
+};
+
+} // end namespace celestia::engine
@@ -57,6 +57,9 @@ public:
     Eigen::Vector3f origin;
     Eigen::Vector3f direction;
     float texLod;
+    // Width of the blur of the shadow by the size of the light, as a
+    // fraction of the ring width
+    float blurSize;
 };
 
 class LightingState
@@ -0,0 +1,136 @@
+// locationindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "locationindex.h"
+
+#include <limits>
+
+#include <Eigen/Geometry>
+
+#include "location.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Locations per cell aimed for, and the limit of cells per cube face edge
+constexpr std::size_t LocationsPerCell = 16;
+constexpr int MaxCellsPerEdge = 16;
+
+// Margin on the radii for the offset of the labels above the surface
+constexpr float LabelRadiusMargin = 1.001f;
+
+int
+cubeCell(const Eigen::Vector3f& direction, int cellsPerEdge)
+{
+    Eigen::Index axis;
+    direction.cwiseAbs().maxCoeff(&axis);
+    float major = direction[axis];
+    int face = static_cast<int>(axis) * 2 + (major < 0.0f ? 1 : 0);
+
+    float u = direction[(axis + 1) % 3] / std::abs(major);
+    float v = direction[(axis + 2) % 3] / std::abs(major);
+    auto toCell = [cellsPerEdge](float x)
+    {
+        return std::clamp(static_cast<int>((x + 1.0f) * 0.5f * static_cast<float>(cellsPerEdge)), 0, cellsPerEdge - 1);
+    };
+
+    return (face * cellsPerEdge + toCell(u)) * cellsPerEdge + toCell(v);
+}
+
+} // end unnamed namespace
+
+
+void
+LocationIndex::build(std::vector<const Location*>&& locations)
+{
+    auto cellsPerEdge = static_cast<int>(std::sqrt(static_cast<float>(locations.size() / (6 * LocationsPerCell))));
+    cellsPerEdge = std::clamp(cellsPerEdge, 1, MaxCellsPerEdge);
+
+    struct Item
+    {
+        Entry entry;
+        Eigen::Vector3f direction;
+        float radius;
+        float scaledRadius;
+        int cell;
+    };
+
+    std::vector<Item> items;
+    items.reserve(locations.size());
+    for (const Location* location : locations)
+    {
+        Eigen::Vector3f position = location->getPosition();
+        Eigen::Vector3f scaledPosition = scaled ? Eigen::Vector3f(position.cwiseQuotient(semiAxes)) : position;
+        float scaledRadius = scaledPosition.norm();
+        // Locations at the center can't be hidden by the body
+        Eigen::Vector3f direction = scaledRadius > 0.0f ? Eigen::Vector3f(scaledPosition / scaledRadius)
+                                                        : Eigen::Vector3f::UnitX();
+        if (scaledRadius == 0.0f)
+            scaledRadius = std::numeric_limits<float>::infinity();
+
+        float effectiveSize = location->getImportance();
+        if (effectiveSize < 0.0f)
+            effectiveSize = location->getSize();
+
+        items.push_back({ { location, static_cast<std::uint64_t>(location->getFeatureType()), effectiveSize },
+                          direction,
+                          position.norm() * LabelRadiusMargin,
+                          scaledRadius * LabelRadiusMargin,
+                          cubeCell(direction, cellsPerEdge) });
+    }
+
+    std::sort(items.begin(), items.end(),
+              [](const Item& a, const Item& b)
+              {
+                  return a.cell < b.cell ||
+                         (a.cell == b.cell && a.entry.effectiveSize > b.entry.effectiveSize);
+              });
+
+    entries.clear();
+    entries.reserve(items.size());
+    cells.clear();
+    for (auto first = items.begin(); first != items.end();)
+    {
+        auto last = std::find_if(first, items.end(), [first](const Item& item) { return item.cell != first->cell; });
+
+        Cell cell;
+        cell.first = static_cast<std::uint32_t>(entries.size());
+        cell.count = static_cast<std::uint32_t>(last - first);
+        cell.maxEffectiveSize = first->entry.effectiveSize;
+        cell.maxRadius = 0.0f;
+        cell.maxScaledRadius = 0.0f;
+        cell.featureTypes = 0;
+
+        Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+        for (auto it = first; it != last; ++it)
+        {
+            sum += it->direction;
+            cell.maxRadius = std::max(cell.maxRadius, it->radius);
+            cell.maxScaledRadius = std::max(cell.maxScaledRadius, it->scaledRadius);
+            cell.featureTypes |= it->entry.featureType;
+            entries.push_back(it->entry);
+        }
+
+        // The directions of a cell lie within one cube face, so their sum
+        // can't vanish
+        cell.axis = sum.normalized();
+        float minCos = 1.0f;
+        for (auto it = first; it != last; ++it)
+            minCos = std::min(minCos, cell.axis.dot(it->direction));
+        cell.halfAngle = std::acos(std::clamp(minCos, -1.0f, 1.0f));
+
+        cells.push_back(cell);
+        first = last;
+    }
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,146 @@
+// locationindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+class Location;
+
+namespace celestia::engine
+{
+
+// Index of the surface locations of a body. The locations are grouped by
+// direction into the cells of a cube map, each listing its locations from
+// the largest to the smallest, with a bounding cone of their directions.
+// The directions are those of the positions divided by the semi-axes, so
+// that on an ellipsoidal body the cells on the far side of the horizon can
+// be told apart from the others on the unit sphere.
+class LocationIndex
+{
+public:
+    template<typename Range>
+    LocationIndex(const Range& locations, const Eigen::Vector3f& semiAxes);
+
+    std::size_t size() const { return entries.size(); }
+    const Eigen::Vector3f& getSemiAxes() const { return semiAxes; }
+
+    // Call process with the locations which may be visible from viewer, a
+    // position in the body frame: those of a type in featureMask, and with
+    // a size or importance larger than sizeScale times their distance. If
+    // cullHidden is set, locations beyond the horizon of the ellipsoid are
+    // skipped too. Some locations failing the tests may also be passed.
+    template<typename F> void query(const Eigen::Vector3d& viewer,
+                                    double sizeScale,
+                                    std::uint64_t featureMask,
+                                    bool cullHidden,
+                                    F&& process) const;
+
+private:
+    struct Entry
+    {
+        const Location* location;
+        std::uint64_t featureType;
+        // The importance, or the size if the location has none
+        float effectiveSize;
+    };
+
+    struct Cell
+    {
+        Eigen::Vector3f axis;
+        // Of the cone around axis containing the scaled directions
+        float halfAngle;
+        float maxEffectiveSize;
+        // Largest distance from the center, and from the center of the
+        // unit sphere in scaled space, with a margin for the offset of
+        // the labels above the surface
+        float maxRadius;
+        float maxScaledRadius;
+        std::uint64_t featureTypes;
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    void build(std::vector<const Location*>&&);
+
+    Eigen::Vector3f semiAxes;
+    // Whether the directions are scaled, which needs all the semi-axes to
+    // be positive
+    bool scaled;
+    std::vector<Entry> entries;
+    std::vector<Cell> cells;
+};
+
+
+template<typename Range>
+LocationIndex::LocationIndex(const Range& locations, const Eigen::Vector3f& _semiAxes) :
+    semiAxes(_semiAxes),
+    scaled(_semiAxes.minCoeff() > 0.0f)
+{
+    std::vector<const Location*> items;
+    for (const Location* location : locations)
+        items.push_back(location);
+    build(std::move(items));
+}
+
+
+template<typename F> void
+LocationIndex::query(const Eigen::Vector3d& viewer,
+                     double sizeScale,
+                     std::uint64_t featureMask,
+                     bool cullHidden,
+                     F&& process) const
+{
+    double distance = viewer.norm();
+    Eigen::Vector3d scaledViewer = scaled ? Eigen::Vector3d(viewer.cwiseQuotient(semiAxes.cast<double>())) : viewer;
+    double scaledDistance = scaledViewer.norm();
+
+    // Points above the unit sphere are hidden from the viewer when the
+    // angle between them exceeds the sum of their angles to the horizon
+    cullHidden = cullHidden && scaled && scaledDistance > 1.0;
+    double viewerHorizon = cullHidden ? std::acos(1.0 / scaledDistance) : 0.0;
+    Eigen::Vector3d viewerDirection = cullHidden ? Eigen::Vector3d(scaledViewer / scaledDistance)
+                                                 : Eigen::Vector3d::Zero();
+
+    for (const Cell& cell : cells)
+    {
+        if ((cell.featureTypes & featureMask) == 0)
+            continue;
+
+        // Slightly below the smallest size which can pass the size test,
+        // so that rounding doesn't drop any locations
+        double minSize = sizeScale * std::max(0.0, distance - static_cast<double>(cell.maxRadius)) * 0.999;
+        if (static_cast<double>(cell.maxEffectiveSize) <= minSize)
+            continue;
+
+        if (cullHidden)
+        {
+            double cosAngle = std::clamp(viewerDirection.dot(cell.axis.cast<double>()), -1.0, 1.0);
+            double pointHorizon = std::acos(1.0 / std::max(1.0, static_cast<double>(cell.maxScaledRadius)));
+            if (std::acos(cosAngle) - static_cast<double>(cell.halfAngle) > viewerHorizon + pointHorizon + 1.0e-3)
+                continue;
+        }
+
+        auto first = entries.begin() + cell.first;
+        auto last = first + cell.count;
+        for (auto it = first; it != last && static_cast<double>(it->effectiveSize) > minSize; ++it)
+        {
+            if ((it->featureType & featureMask) != 0)
+                process(it->location);
+        }
+    }
+}
+
+} // end namespace celestia::engine
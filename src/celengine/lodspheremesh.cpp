@@ -18,6 +18,7 @@
 
 #include <celcompat/numbers.h>
 #include <celengine/shadermanager.h>
+#include <celengine/terrain.h>
 #include <celengine/texture.h>
 #include <celmath/frustum.h>
 #include <celmath/mathlib.h>
@@ -25,6 +26,7 @@
 
 #define PTR(p) (reinterpret_cast<const void*>(static_cast<std::uintptr_t>(p)))
 
+namespace gl = celestia::gl;
 namespace math = celestia::math;
 
 namespace
@@ -41,11 +43,18 @@ constexpr int maxVertices   = (maxPhiSteps + 1) * (maxThetaSteps + 1);
 constexpr int nIndices      = maxPhiSteps * 2 * (maxThetaSteps + 2) - 2;
 static_assert(nIndices < std::numeric_limits<unsigned short>::max());
 
-// largest vertex:
+// vertex:
 //     position   - 3 floats, (re-used for normals)
 //     tangent    - 3 floats,
-//     tex coords - 2 floats * MAX_SPHERE_MESH_TEXTURES
-constexpr const int MaxVertexSize = 3 + 3 + LODSphereMesh::MAX_SPHERE_MESH_TEXTURES * 2;
+//     tex coords - 2 floats, shared by all textures
+constexpr const int VertexSize = 3 + 3 + 2;
+constexpr const int TangentOffset = 3;
+constexpr const int TexCoordOffset = 6;
+
+// Patch buffers are released, least recently used first, when they take
+// more memory than this. All patches of a sphere at the highest level of
+// detail take about 16 MB.
+constexpr std::size_t MaxPatchBufferSize = 64 * 1024 * 1024;
 
 
 using ThetaArray = std::array<float, thetaDivisions + 1>;
@@ -240,13 +249,11 @@ struct TextureCoords
 };
 
 
-template<bool HasTangents>
 void
 createVertices(std::vector<float>& vertices,
                int phi0, int phi1,
                int theta0, int theta1,
-               int step,
-               const TextureCoords& tc)
+               int step)
 {
     for (int phi = phi0; phi <= phi1; phi += step)
     {
@@ -262,31 +269,37 @@ createVertices(std::vector<float>& vertices,
             vertices.push_back(sphi);
             vertices.push_back(cphi * stheta);
 
-            if constexpr (HasTangents)
-            {
-                // Compute the tangent--required for bump mapping
-                vertices.push_back(stheta);
-                vertices.push_back(0.0f);
-                vertices.push_back(-ctheta);
-            }
+            // Compute the tangent--required for bump mapping
+            vertices.push_back(stheta);
+            vertices.push_back(0.0f);
+            vertices.push_back(-ctheta);
 
-            if (tc.nTexturesUsed > 0)
-            {
-                vertices.push_back(static_cast<float>(theta));
-                vertices.push_back(static_cast<float>(phi));
-            }
+            // Mapped to the textures by the texture coordinate transforms
+            vertices.push_back(static_cast<float>(theta));
+            vertices.push_back(static_cast<float>(phi));
         }
     }
 }
 
 
+std::uint64_t
+patchKey(int phi0, int theta0, int extent, int step)
+{
+    return static_cast<std::uint64_t>(phi0) |
+           (static_cast<std::uint64_t>(theta0) << 16) |
+           (static_cast<std::uint64_t>(extent) << 32) |
+           (static_cast<std::uint64_t>(step) << 48);
+}
+
+
 } // end unnamed namespace
 
 
 LODSphereMesh::~LODSphereMesh()
 {
-    glDeleteBuffers(vertexBuffers.size(), vertexBuffers.data());
-    glDeleteBuffers(1, &indexBuffer);
+    for (const auto& [key, patch] : patchBuffers)
+        gl::deleteBuffers(1, &patch.buffer);
+    gl::deleteBuffers(1, &indexBuffer);
 }
 
 
@@ -360,20 +373,7 @@ void LODSphereMesh::render(unsigned int attributes,
 
     // If one of the textures is split into subtextures, we may have to
     // use extra patches, since there can be at most one subtexture per patch.
-    int minSplit = 1;
-    for (int i = 0; i < nTextures; i++)
-    {
-        double pixelsPerTexel = pixWidth * 2.0f /
-            (static_cast<float>(tex[i]->getWidth()) / 2.0f);
-        double l = std::log2(pixelsPerTexel);
-
-        // replacing below with std::clamp will fail if l < 0
-        ri.texLOD[i] = std::max(std::min(tex[i]->getLODCount() - 1, static_cast<int>(l)), 0);
-        if (tex[i]->getUTileCount(ri.texLOD[i]) > minSplit)
-            minSplit = tex[i]->getUTileCount(ri.texLOD[i]);
-        if (tex[i]->getVTileCount(ri.texLOD[i]) > minSplit)
-            minSplit = tex[i]->getVTileCount(ri.texLOD[i]);
-    }
+    int minSplit = setTextureLODs(ri, pixWidth, tex, nTextures);
 
     if (split < minSplit)
     {
@@ -384,102 +384,22 @@ void LODSphereMesh::render(unsigned int attributes,
             ri.step /= ri.step / phiExtent;
     }
 
-    // Set the current textures
-    nTexturesUsed = nTextures;
-    for (int i = 0; i < nTextures; i++)
-    {
-        tex[i]->beginUsage();
-        textures[i] = tex[i];
-        subtextures[i] = 0;
-        if (nTextures > 1)
-            glActiveTexture(GL_TEXTURE0 + i);
-    }
+    beginTextures(tex, nTextures);
 
-    if (!vertexBuffersInitialized)
+    if (indexBuffer == 0)
     {
-        // TODO: assumes that the same context is used every time we
-        // render.  Valid now, but not necessarily in the future.  Still,
-        // would only cause problems if we rendered in two different contexts
-        // and only one had vertex buffer objects.
-        while(glGetError() != GL_NO_ERROR);
-        glGenBuffers(vertexBuffers.size(), vertexBuffers.data());
-        if (glGetError() != GL_NO_ERROR)
-            return;
-        vertexBuffersInitialized = true;
-        for (auto vertexBuffer : vertexBuffers)
-        {
-            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-            glBufferData(GL_ARRAY_BUFFER,
-                         maxVertices * MaxVertexSize * sizeof(float),
-                         nullptr,
-                         GL_STREAM_DRAW);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
         glGenBuffers(1, &indexBuffer);
-        if (glGetError() != GL_NO_ERROR)
+        if (indexBuffer == 0)
             return;
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     nIndices * sizeof(unsigned short),
-                     nullptr,
-                     GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
-    currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
-
-    // Set up the mesh vertices
-    int nRings = phiExtent / ri.step;
-    int nSlices = thetaExtent / ri.step;
-
-    indices.clear();
-    int expectedIndices = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
-    indices.reserve(expectedIndices);
-    for (int i = 0; i < nRings; i++)
-    {
-        if (i > 0)
-        {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + 0));
-        }
-        for (int j = 0; j <= nSlices; j++)
-        {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + j));
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + j));
-        }
-        if (i < nRings - 1)
-        {
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + nSlices));
-        }
-    }
-
-    assert(expectedIndices == indices.size());
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(unsigned short),
-                 indices.data(),
-                 GL_DYNAMIC_DRAW);
-
-    // Compute the size of a vertex
-    vertexSize = 3;
-    if ((attributes & Tangents) != 0)
-        vertexSize += 3;
-    if (nTextures > 0)
-        vertexSize += 2;
-
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if ((attributes & Normals) != 0)
-        glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+    ++renderCount;
+    evictPatchBuffers();
 
-    for (int i = 0; i < nTextures; i++)
-    {
-        glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex + i);
-    }
+    // Set up the mesh indices, shared by all sections
+    setIndices(phiExtent / ri.step, thetaExtent / ri.step);
 
-    if ((attributes & Tangents) != 0)
-        glEnableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
+    enableAttributes(attributes, nTextures);
 
     if (split == 1)
     {
@@ -527,6 +447,173 @@ void LODSphereMesh::render(unsigned int attributes,
         }
     }
 
+    disableAttributes(attributes, nTextures);
+    endTextures(tex, nTextures);
+
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+bool
+LODSphereMesh::renderTerrain(celestia::engine::TerrainManager& manager,
+                             celestia::engine::Terrain& terrain,
+                             unsigned int attributes,
+                             const math::Frustum& frustum,
+                             const Eigen::Vector3f& eyePosition,
+                             float pixelSize,
+                             float pixWidth,
+                             Texture** tex,
+                             int nTextures,
+                             CelestiaGLProgram *program)
+{
+    using celestia::engine::TerrainChunk;
+
+    if (tex == nullptr)
+        nTextures = 0;
+
+    RenderInfo ri(minStep, attributes, frustum);
+
+    // There can be at most one subtexture per chunk
+    int minSplit = setTextureLODs(ri, pixWidth, tex, nTextures);
+    celestia::engine::TerrainLODParams params;
+    params.eyePosition = eyePosition;
+    params.pixelSize = pixelSize;
+    params.relief = terrain.getRelief();
+    while ((1 << params.minLevel) < minSplit)
+        ++params.minLevel;
+    params.maxTriangles = manager.getTriangleBudget();
+    if (params.minLevel > TerrainChunk::MaxLevel)
+        return false;
+
+    bool complete = SelectTerrainChunks(params, frustum,
+                                        [&terrain](const TerrainChunk& chunk) { return terrain.isResident(chunk); },
+                                        terrainChunks, terrainRequests);
+    terrain.request(terrainRequests);
+    if (!complete)
+        return false;
+
+    beginTextures(tex, nTextures);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, manager.getIndexBuffer());
+    enableAttributes(attributes, nTextures);
+
+    constexpr auto stride = static_cast<GLsizei>(celestia::engine::TerrainVertexSize * sizeof(float));
+    for (const TerrainChunk& chunk : terrainChunks)
+    {
+        setSectionTextures(chunk.phi0(), chunk.theta0(), chunk.extent(), ri, program);
+
+        gl::bindBuffer(GL_ARRAY_BUFFER, terrain.useChunk(chunk, manager.getFrame()));
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, PTR(0));
+        if ((attributes & Normals) != 0)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                                  3, GL_FLOAT, GL_FALSE,
+                                  stride, PTR(celestia::engine::TerrainNormalOffset * sizeof(float)));
+        }
+
+        for (int i = 0; i < nTextures; i++)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + i,
+                                  2, GL_FLOAT, GL_FALSE,
+                                  stride, PTR(celestia::engine::TerrainTexCoordOffset * sizeof(float)));
+        }
+
+        if ((attributes & Tangents) != 0)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                                  3, GL_FLOAT, GL_FALSE,
+                                  stride, PTR(celestia::engine::TerrainTangentOffset * sizeof(float)));
+        }
+
+        glDrawElements(GL_TRIANGLES,
+                       celestia::engine::TerrainManager::getIndexCount(),
+                       GL_UNSIGNED_SHORT,
+                       nullptr);
+        celestia::gl::countDraw(GL_TRIANGLES, celestia::engine::TerrainManager::getIndexCount());
+    }
+
+    disableAttributes(attributes, nTextures);
+    endTextures(tex, nTextures);
+
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return true;
+}
+
+
+int
+LODSphereMesh::setTextureLODs(RenderInfo& ri, float pixWidth, Texture** tex, int nTextures) const
+{
+    int minSplit = 1;
+    for (int i = 0; i < nTextures; i++)
+    {
+        double pixelsPerTexel = pixWidth * 2.0f /
+            (static_cast<float>(tex[i]->getWidth()) / 2.0f);
+        double l = std::log2(pixelsPerTexel);
+
+        // replacing below with std::clamp will fail if l < 0
+        ri.texLOD[i] = std::max(std::min(tex[i]->getLODCount() - 1, static_cast<int>(l)), 0);
+        if (tex[i]->getUTileCount(ri.texLOD[i]) > minSplit)
+            minSplit = tex[i]->getUTileCount(ri.texLOD[i]);
+        if (tex[i]->getVTileCount(ri.texLOD[i]) > minSplit)
+            minSplit = tex[i]->getVTileCount(ri.texLOD[i]);
+    }
+
+    return minSplit;
+}
+
+
+void
+LODSphereMesh::beginTextures(Texture** tex, int nTextures)
+{
+    // Set the current textures
+    nTexturesUsed = nTextures;
+    for (int i = 0; i < nTextures; i++)
+    {
+        tex[i]->beginUsage();
+        textures[i] = tex[i];
+        subtextures[i] = 0;
+        if (nTextures > 1)
+            gl::activeTexture(GL_TEXTURE0 + i);
+    }
+}
+
+
+void
+LODSphereMesh::endTextures(Texture** tex, int nTextures)
+{
+    for (int i = 0; i < nTextures; i++)
+        tex[i]->endUsage();
+
+    if (nTextures > 1)
+    {
+        gl::activeTexture(GL_TEXTURE0);
+    }
+}
+
+
+void
+LODSphereMesh::enableAttributes(unsigned int attributes, int nTextures)
+{
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    if ((attributes & Normals) != 0)
+        glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+
+    for (int i = 0; i < nTextures; i++)
+    {
+        glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex + i);
+    }
+
+    if ((attributes & Tangents) != 0)
+        glEnableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
+}
+
+
+void
+LODSphereMesh::disableAttributes(unsigned int attributes, int nTextures)
+{
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     if ((attributes & Normals) != 0)
         glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
@@ -536,17 +623,8 @@ void LODSphereMesh::render(unsigned int attributes,
 
     for (int i = 0; i < nTextures; i++)
     {
-        tex[i]->endUsage();
         glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex + i);
     }
-
-    if (nTextures > 1)
-    {
-        glActiveTexture(GL_TEXTURE0);
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 
@@ -636,9 +714,18 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
                              const RenderInfo& ri, CelestiaGLProgram *program)
 
 {
-    auto stride = static_cast<GLsizei>(vertexSize * sizeof(float));
-    int texCoordOffset = ((ri.attributes & Tangents) != 0) ? 6 : 3;
+    // assert(ri.step >= minStep);
+    // assert(phi0 + extent <= maxDivisions);
+    // assert(theta0 + extent / 2 < maxDivisions);
+    // assert(isPow2(extent));
+    int thetaExtent = extent;
+    int phiExtent = extent / 2;
+
+    setSectionTextures(phi0, theta0, extent, ri, program);
+
+    gl::bindBuffer(GL_ARRAY_BUFFER, getPatchBuffer(phi0, theta0, extent, ri.step));
 
+    constexpr auto stride = static_cast<GLsizei>(VertexSize * sizeof(float));
     glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
                           3, GL_FLOAT, GL_FALSE,
                           stride, PTR(0));
@@ -649,28 +736,36 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
                               stride, PTR(0));
     }
 
-    for (int tc = 0; tc < nTexturesUsed; tc++)
+    for (int tex = 0; tex < nTexturesUsed; tex++)
     {
-        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tex,
                               2, GL_FLOAT, GL_FALSE,
-                              stride, PTR(texCoordOffset * sizeof(float)));
+                              stride, PTR(TexCoordOffset * sizeof(float)));
     }
 
     if ((ri.attributes & Tangents) != 0)
     {
         glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
                               3, GL_FLOAT, GL_FALSE,
-                              stride, PTR(3 * sizeof(float))); // 3 == tangentOffset
+                              stride, PTR(TangentOffset * sizeof(float)));
     }
 
-    // assert(ri.step >= minStep);
-    // assert(phi0 + extent <= maxDivisions);
-    // assert(theta0 + extent / 2 < maxDivisions);
-    // assert(isPow2(extent));
+    int nRings = phiExtent / ri.step;
+    int nSlices = thetaExtent / ri.step;
+    glDrawElements(GL_TRIANGLE_STRIP,
+                   nRings * (nSlices + 2) * 2 - 2,
+                   GL_UNSIGNED_SHORT,
+                   nullptr);
+    celestia::gl::countDraw(GL_TRIANGLE_STRIP, nRings * (nSlices + 2) * 2 - 2);
+}
+
+
+void
+LODSphereMesh::setSectionTextures(int phi0, int theta0, int extent,
+                                  const RenderInfo& ri, CelestiaGLProgram *program)
+{
     int thetaExtent = extent;
     int phiExtent = extent / 2;
-    int theta1 = theta0 + thetaExtent;
-    int phi1 = phi0 + phiExtent;
 
     TextureCoords tc{ nTexturesUsed };
 
@@ -708,7 +803,7 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             v /= patchesPerVSubtex;
 
             if (nTexturesUsed > 1)
-                glActiveTexture(GL_TEXTURE0 + tex);
+                gl::activeTexture(GL_TEXTURE0 + tex);
             TextureTile tile = textures[tex]->getTile(ri.texLOD[tex],
                                                       uTexSplit - u - 1,
                                                       vTexSplit - v - 1);
@@ -724,38 +819,90 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             // texture state changes.
             if (tile.texID != subtextures[tex])
             {
-                glBindTexture(GL_TEXTURE_2D, tile.texID);
+                gl::bindTexture(GL_TEXTURE_2D, tile.texID);
                 subtextures[tex] = tile.texID;
             }
         }
     }
+}
+
+
+GLuint
+LODSphereMesh::getPatchBuffer(int phi0, int theta0, int extent, int step)
+{
+    auto [iter, inserted] = patchBuffers.try_emplace(patchKey(phi0, theta0, extent, step));
+    PatchBuffer& patch = iter->second;
+    patch.lastUsed = renderCount;
+    if (!inserted)
+        return patch.buffer;
+
+    int phi1 = phi0 + extent / 2;
+    int theta1 = theta0 + extent;
+    int expectedVertices = ((phi1 - phi0) / step + 1) * ((theta1 - theta0) / step + 1);
+    assert(expectedVertices <= maxVertices);
 
     vertices.clear();
-    int perVertexFloats = (ri.attributes & Tangents) == 0 ? 3 : 6;
-    int expectedVertices = ((phi1 - phi0) / ri.step + 1) *
-                           ((theta1 - theta0) / ri.step + 1) * (perVertexFloats + (nTexturesUsed > 0 ? 2 : 0));
-    assert(expectedVertices <= maxVertices * MaxVertexSize);
-    vertices.reserve(expectedVertices);
-    if ((ri.attributes & Tangents) == 0)
-        createVertices<false>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
-    else
-        createVertices<true>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
+    vertices.reserve(static_cast<std::size_t>(expectedVertices) * VertexSize);
+    createVertices(vertices, phi0, phi1, theta0, theta1, step);
+    assert(vertices.size() == static_cast<std::size_t>(expectedVertices) * VertexSize);
 
-    assert(expectedVertices == vertices.size());
+    patch.size = vertices.size() * sizeof(float);
+    glGenBuffers(1, &patch.buffer);
+    gl::bindBuffer(GL_ARRAY_BUFFER, patch.buffer);
+    glBufferData(GL_ARRAY_BUFFER, patch.size, vertices.data(), GL_STATIC_DRAW);
+    patchBufferSize += patch.size;
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), nullptr, GL_STREAM_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+    return patch.buffer;
+}
 
-    int nRings = phiExtent / ri.step;
-    int nSlices = thetaExtent / ri.step;
-    glDrawElements(GL_TRIANGLE_STRIP,
-                   nRings * (nSlices + 2) * 2 - 2,
-                   GL_UNSIGNED_SHORT,
-                   nullptr);
 
-    // Cycle through the vertex buffers
-    currentVB++;
-    if (currentVB == NUM_SPHERE_VERTEX_BUFFERS)
-        currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
+void
+LODSphereMesh::evictPatchBuffers()
+{
+    while (patchBufferSize > MaxPatchBufferSize)
+    {
+        auto oldest = std::min_element(patchBuffers.begin(), patchBuffers.end(),
+                                       [](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+        gl::deleteBuffers(1, &oldest->second.buffer);
+        patchBufferSize -= oldest->second.size;
+        patchBuffers.erase(oldest);
+    }
+}
+
+
+void
+LODSphereMesh::setIndices(int nRings, int nSlices)
+{
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    if (nRings == indexRings && nSlices == indexSlices)
+        return;
+
+    indices.clear();
+    int expectedIndices = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
+    indices.reserve(expectedIndices);
+    for (int i = 0; i < nRings; i++)
+    {
+        if (i > 0)
+        {
+            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + 0));
+        }
+        for (int j = 0; j <= nSlices; j++)
+        {
+            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + j));
+            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + j));
+        }
+        if (i < nRings - 1)
+        {
+            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + nSlices));
+        }
+    }
+
+    assert(expectedIndices == indices.size());
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 indices.size() * sizeof(unsigned short),
+                 indices.data(),
+                 GL_STATIC_DRAW);
+    indexRings = nRings;
+    indexSlices = nSlices;
 }
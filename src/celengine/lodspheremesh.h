@@ -12,14 +12,23 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
 
 #include <celengine/glsupport.h>
+#include <celengine/terrainquadtree.h>
 
 class Texture;
 
+namespace celestia::engine
+{
+class Terrain;
+class TerrainManager;
+}
+
 namespace celestia::math
 {
 class Frustum;
@@ -31,7 +40,6 @@ class LODSphereMesh
 {
 public:
     static constexpr std::size_t MAX_SPHERE_MESH_TEXTURES = 6;
-    static constexpr std::size_t NUM_SPHERE_VERTEX_BUFFERS = 2;
 
     LODSphereMesh() = default;
     ~LODSphereMesh();
@@ -49,6 +57,20 @@ public:
     void render(const celestia::math::Frustum&, float pixWidth,
                 Texture** tex, int nTextures, CelestiaGLProgram *);
 
+    // Draw the sphere from the chunks of a terrain, which are displaced by
+    // its heights. Return false if the terrain isn't loaded yet, the
+    // sphere should be drawn by render then.
+    bool renderTerrain(celestia::engine::TerrainManager& manager,
+                       celestia::engine::Terrain& terrain,
+                       unsigned int attributes,
+                       const celestia::math::Frustum& frustum,
+                       const Eigen::Vector3f& eyePosition,
+                       float pixelSize,
+                       float pixWidth,
+                       Texture** tex,
+                       int nTextures,
+                       CelestiaGLProgram *program);
+
     enum
     {
         Normals    = 0x01,
@@ -80,18 +102,42 @@ public:
                        CelestiaGLProgram *);
 
     void renderSection(int phi0, int theta0, int extent, const RenderInfo&, CelestiaGLProgram *);
+    void setSectionTextures(int phi0, int theta0, int extent, const RenderInfo&, CelestiaGLProgram *);
+
+    int setTextureLODs(RenderInfo&, float pixWidth, Texture** tex, int nTextures) const;
+    void beginTextures(Texture** tex, int nTextures);
+    void endTextures(Texture** tex, int nTextures);
+    void enableAttributes(unsigned int attributes, int nTextures);
+    void disableAttributes(unsigned int attributes, int nTextures);
 
-    int vertexSize{ 0 };
+    // The vertices of a section only depend on its position and step, so
+    // they are kept in a buffer once created and shared by all spheres
+    struct PatchBuffer
+    {
+        GLuint buffer;
+        std::size_t size;
+        std::uint64_t lastUsed;
+    };
+
+    GLuint getPatchBuffer(int phi0, int theta0, int extent, int step);
+    void evictPatchBuffers();
+    void setIndices(int nRings, int nSlices);
 
     std::vector<float> vertices{};
     std::vector<unsigned short> indices{};
 
+    std::unordered_map<std::uint64_t, PatchBuffer> patchBuffers{};
+    std::size_t patchBufferSize{ 0 };
+    std::uint64_t renderCount{ 0 };
+
     int nTexturesUsed{ 0 };
     std::array<Texture*, MAX_SPHERE_MESH_TEXTURES> textures{};
     std::array<unsigned int, MAX_SPHERE_MESH_TEXTURES> subtextures{};
 
-    bool vertexBuffersInitialized{ false };
-    GLuint currentVB{ 0 };
-    std::array<GLuint, NUM_SPHERE_VERTEX_BUFFERS> vertexBuffers{};
     GLuint indexBuffer{ 0 };
+    int indexRings{ 0 };
+    int indexSlices{ 0 };
+
+    std::vector<celestia::engine::TerrainChunk> terrainChunks{};
+    std::vector<celestia::engine::TerrainChunk> terrainRequests{};
 };
@@ -10,10 +10,14 @@
 
 #include "meshmanager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <ios>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -26,6 +30,7 @@
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
 #include "hash.h"
+#include "modelcache.h"
 #include "modelgeometry.h"
 #include "parser.h"
 #include "spheremesh.h"
@@ -38,6 +43,11 @@ using celestia::util::GetLogger;
 namespace
 {
 
+std::atomic<bool> modelOptimization{ true };
+
+using TextureGetter = celestia::engine::ModelTextureGetter;
+
+
 std::unique_ptr<cmod::Model>
 LoadCelestiaMesh(const fs::path& filename)
 {
@@ -92,9 +102,10 @@ LoadCelestiaMesh(const fs::path& filename)
 }
 
 
-cmod::Mesh
-ConvertTriangleMesh(const M3DTriangleMesh& mesh,
-                    const M3DScene& scene)
+// Convert a 3DS triangle mesh, with the material index of each group
+// returned by getMaterialIndex from the name of its material
+template<typename F> cmod::Mesh
+ConvertTriangleMesh(const M3DTriangleMesh& mesh, F&& getMaterialIndex)
 {
     int nFaces     = mesh.getFaceCount();
     int nVertices  = mesh.getVertexCount();
@@ -275,142 +286,283 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
             indices.push_back(faceIndex * 3 + 2);
         }
 
-        // Lookup the material index
-        std::uint32_t materialIndex = 0;
-        for (std::uint32_t j = 0; j < scene.getMaterialCount(); ++j)
-        {
-            if (matGroup->materialName == scene.getMaterial(j)->getName())
-            {
-                materialIndex = j;
-                break;
-            }
-        }
-
-        newMesh.addGroup(cmod::PrimitiveGroupType::TriList, materialIndex, std::move(indices));
+        newMesh.addGroup(cmod::PrimitiveGroupType::TriList,
+                         getMaterialIndex(matGroup->materialName),
+                         std::move(indices));
     }
 
     return newMesh;
 }
 
 
-std::unique_ptr<cmod::Model>
-Convert3DSModel(const M3DScene& scene, const fs::path& texPath)
+cmod::Material
+Convert3DSMaterial(const M3DMaterial& material, const fs::path& texPath, const TextureGetter& getTexture)
 {
-    auto model = std::make_unique<cmod::Model>();
+    cmod::Material newMaterial;
+
+    M3DColor diffuse = material.getDiffuseColor();
+    newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
+    newMaterial.opacity = material.getOpacity();
 
-    // Convert the materials
-    for (std::uint32_t i = 0; i < scene.getMaterialCount(); i++)
+    M3DColor specular = material.getSpecularColor();
+    newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
+
+    float shininess = material.getShininess();
+
+    // Map the 3DS file's shininess from percentage (0-100) to
+    // range that OpenGL uses for the specular exponent. The
+    // current equation is just a guess at the mapping that
+    // 3DS actually uses.
+    newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
+    if (newMaterial.specularPower > 128.0f)
+        newMaterial.specularPower = 128.0f;
+
+    if (!material.getTextureMap().empty())
     {
-        const M3DMaterial* material = scene.getMaterial(i);
-        cmod::Material newMaterial;
+        ResourceHandle tex = getTexture(material.getTextureMap(), texPath);
+        newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
+    }
 
-        M3DColor diffuse = material->getDiffuseColor();
-        newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
-        newMaterial.opacity = material->getOpacity();
+    return newMaterial;
+}
 
-        M3DColor specular = material->getSpecularColor();
-        newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
 
-        float shininess = material->getShininess();
+// Converts the contents of a 3DS file while it's read, so that only one
+// 3DS model at a time is kept besides the converted meshes. Some confusing
+// terminology: a 3ds 'scene' is the same as a Celestia model, and a 3ds
+// 'model' is the same as a Celestia mesh.
+//
+// Materials may follow the meshes using them, so the groups are first
+// numbered by material name and given the material indices at the end.
+class Model3DSConverter : public M3DSceneHandler
+{
+public:
+    Model3DSConverter(const fs::path& _texPath, const TextureGetter& _getTexture) :
+        texPath(_texPath),
+        getTexture(_getTexture)
+    {
+    }
 
-        // Map the 3DS file's shininess from percentage (0-100) to
-        // range that OpenGL uses for the specular exponent. The
-        // current equation is just a guess at the mapping that
-        // 3DS actually uses.
-        newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
-        if (newMaterial.specularPower > 128.0f)
-            newMaterial.specularPower = 128.0f;
+    void material(M3DMaterial&& material) override
+    {
+        materialNames.push_back(material.getName());
+        result->addMaterial(Convert3DSMaterial(material, texPath, getTexture));
+    }
 
-        if (!material->getTextureMap().empty())
+    void model(M3DModel&& model3ds) override
+    {
+        for (std::uint32_t i = 0; i < model3ds.getTriMeshCount(); i++)
         {
-            ResourceHandle tex = GetTextureManager()->getHandle(TextureInfo(material->getTextureMap(), texPath, TextureInfo::WrapTexture));
-            newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
-        }
+            const M3DTriangleMesh* mesh = model3ds.getTriMesh(i);
+            if (mesh == nullptr)
+                continue;
+
+            cmod::Mesh cmodmesh = ConvertTriangleMesh(*mesh, [this](const std::string& name)
+            {
+                return getNameIndex(name);
+            });
 
-        model->addMaterial(std::move(newMaterial));
+            if (cmodmesh.getGroupCount() > 0)
+                meshes.push_back(std::move(cmodmesh));
+            else
+                GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
+        }
     }
 
-    // Convert all models in the scene. Some confusing terminology: a 3ds 'scene' is the same
-    // as a Celestia model, and a 3ds 'model' is the same as a Celestia mesh.
-    for (std::uint32_t i = 0; i < scene.getModelCount(); i++)
+    std::unique_ptr<cmod::Model> finish()
     {
-        const M3DModel* model3ds = scene.getModel(i);
-        if (model3ds)
+        // Groups with a material missing from the file use the first one
+        std::vector<unsigned int> materialMap(groupNames.size(), 0);
+        for (std::size_t i = 0; i < groupNames.size(); ++i)
         {
-            for (unsigned int j = 0; j < model3ds->getTriMeshCount(); j++)
-            {
-                const M3DTriangleMesh* mesh = model3ds->getTriMesh(j);
-                if (mesh)
-                {
-                    cmod::Mesh cmodmesh = ConvertTriangleMesh(*mesh, scene);
-                    if (cmodmesh.getGroupCount() > 0)
-                        model->addMesh(std::move(cmodmesh));
-                    else
-                        GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
-                }
-            }
+            auto it = std::find(materialNames.begin(), materialNames.end(), groupNames[i]);
+            if (it != materialNames.end())
+                materialMap[i] = static_cast<unsigned int>(it - materialNames.begin());
         }
+
+        for (cmod::Mesh& mesh : meshes)
+        {
+            mesh.remapMaterials(materialMap);
+            result->addMesh(std::move(mesh));
+        }
+
+        meshes.clear();
+        return std::move(result);
     }
 
-    return model;
-}
+private:
+    unsigned int getNameIndex(const std::string& name)
+    {
+        auto it = std::find(groupNames.begin(), groupNames.end(), name);
+        if (it != groupNames.end())
+            return static_cast<unsigned int>(it - groupNames.begin());
+
+        groupNames.push_back(name);
+        return static_cast<unsigned int>(groupNames.size() - 1);
+    }
+
+    const fs::path& texPath;
+    const TextureGetter& getTexture;
+    std::unique_ptr<cmod::Model> result{ std::make_unique<cmod::Model>() };
+    std::vector<std::string> materialNames;
+    std::vector<std::string> groupNames;
+    std::vector<cmod::Mesh> meshes;
+};
 
 
 std::unique_ptr<cmod::Model>
-Load3DSModel(const GeometryInfo::ResourceKey& key, const fs::path& path)
+Convert3DSFile(const fs::path& filename, const fs::path& texPath, const TextureGetter& getTexture)
 {
-    std::unique_ptr<M3DScene> scene = Read3DSFile(key.resolvedPath);
-    if (scene == nullptr)
+    Model3DSConverter converter(texPath, getTexture);
+    if (!Read3DSFile(filename, converter))
         return nullptr;
 
-    std::unique_ptr<cmod::Model> model = Convert3DSModel(*scene, key.resolvedToPath ? path : fs::path());
+    return converter.finish();
+}
 
-    if (key.isNormalized)
-        model->normalize(key.center);
-    else
-        model->transform(key.center, key.scale);
 
-    return model;
+std::unique_ptr<cmod::Model>
+Load3DSModel(const GeometryInfo::ResourceKey& key, const fs::path& path, const TextureGetter& getTexture)
+{
+    return Convert3DSFile(key.resolvedPath, key.resolvedToPath ? path : fs::path(), getTexture);
 }
 
 
 std::unique_ptr<cmod::Model>
-LoadCMODModel(const GeometryInfo::ResourceKey& key, const fs::path& path)
+LoadCMODModel(const GeometryInfo::ResourceKey& key, const fs::path& path, const TextureGetter& getTexture)
 {
     std::ifstream in(key.resolvedPath, std::ios::binary);
     if (!in.good())
         return nullptr;
 
-    std::unique_ptr<cmod::Model> model = cmod::LoadModel(
+    return cmod::LoadModel(
         in,
         [&](const fs::path& name)
         {
-            return GetTextureManager()->getHandle(TextureInfo(name, path, TextureInfo::WrapTexture));
+            return getTexture(name, path);
         });
+}
 
-    if (model == nullptr)
+
+// Texture handles of a model along with the names and directories they
+// were created from, so that the model can be cached with its textures
+class TextureSourceRecorder
+{
+public:
+    explicit TextureSourceRecorder(const TextureGetter& _getTexture) : getTexture(_getTexture) {}
+
+    ResourceHandle operator()(const fs::path& name, const fs::path& texPath)
+    {
+        ResourceHandle handle = getTexture(name, texPath);
+        sources.emplace_back(handle, std::make_pair(name, texPath));
+        return handle;
+    }
+
+    std::pair<fs::path, fs::path> getSource(ResourceHandle handle) const
+    {
+        auto it = std::find_if(sources.begin(), sources.end(),
+                               [handle](const auto& entry) { return entry.first == handle; });
+        return it == sources.end() ? std::pair<fs::path, fs::path>() : it->second;
+    }
+
+private:
+    const TextureGetter& getTexture;
+    std::vector<std::pair<ResourceHandle, std::pair<fs::path, fs::path>>> sources;
+};
+
+
+std::unique_ptr<cmod::Model>
+LoadModelFile(const GeometryInfo::ResourceKey& key, const fs::path& path, const TextureGetter& getTexture)
+{
+    switch (ContentType fileType = DetermineFileType(key.resolvedPath); fileType)
+    {
+    case ContentType::_3DStudio:
+        return Load3DSModel(key, path, getTexture);
+    case ContentType::CelestiaModel:
+        return LoadCMODModel(key, path, getTexture);
+    case ContentType::CelestiaMesh:
+        return LoadCelestiaMesh(key.resolvedPath);
+    default:
+        GetLogger()->error(_("Unknown model format '{}'\n"), key.resolvedPath);
         return nullptr;
+    }
+}
 
+
+void
+TransformModel(cmod::Model& model, const GeometryInfo::ResourceKey& key)
+{
     if (key.isNormalized)
-        model->normalize(key.center);
+        model.normalize(key.center);
     else
-        model->transform(key.center, key.scale);
-
-    return model;
+        model.transform(key.center, key.scale);
 }
 
 
 std::unique_ptr<cmod::Model>
-LoadCMSModel(const GeometryInfo::ResourceKey& key)
+LoadConditionedModel(const GeometryInfo::ResourceKey& key, const fs::path& path, const TextureGetter& getTexture)
 {
-    std::unique_ptr<cmod::Model> model = LoadCelestiaMesh(key.resolvedPath);
+    GetLogger()->info(_("Loading model: {}\n"), key.resolvedPath);
+
+    // The cached models are conditioned but not transformed
+    std::uint64_t cacheKey = celestia::engine::IsModelCacheEnabled()
+        ? celestia::engine::GetModelCacheKey(key.resolvedPath, modelOptimization ? 1 : 0)
+        : 0;
+    if (cacheKey != 0)
+    {
+        if (auto model = celestia::engine::LoadCachedModel(cacheKey, getTexture); model != nullptr)
+        {
+            TransformModel(*model, key);
+            return model;
+        }
+    }
+
+    TextureSourceRecorder textures(getTexture);
+    std::unique_ptr<cmod::Model> model = LoadModelFile(key, path, std::ref(textures));
+
     if (model == nullptr)
+    {
+        GetLogger()->error(_("Error loading model '{}'\n"), key.resolvedPath);
         return nullptr;
+    }
 
-    if (key.isNormalized)
-        model->normalize(key.center);
-    else
-        model->transform(key.center, key.scale);
+    // Condition the model for optimal rendering
+    // Many models tend to have a lot of duplicate materials; eliminate
+    // them, since unnecessarily setting material parameters can adversely
+    // impact rendering performance. Ideally uniquification of materials
+    // would be performed just once when the model was created, but
+    // that's not the case.
+    std::uint32_t originalMaterialCount = model->getMaterialCount();
+    model->uniquifyMaterials();
+
+    // Sort the submeshes roughly by opacity.  This will eliminate a
+    // good number of the errors caused when translucent triangles are
+    // rendered before geometry that they cover.
+    model->sortMeshes(cmod::Model::OpacityComparator());
+
+    // Reorder the triangles for the vertex cache and overdraw, and the
+    // vertices for locality of the vertex fetches
+    if (modelOptimization)
+        model->optimizeMeshes();
+
+    model->determineOpacity();
+
+    if (cacheKey != 0)
+    {
+        celestia::engine::StoreCachedModel(cacheKey, *model, [&textures](ResourceHandle handle)
+        {
+            return textures.getSource(handle);
+        });
+    }
+
+    TransformModel(*model, key);
+
+    // Display some statics for the model
+    GetLogger()->verbose(_("   Model statistics: {} vertices, {} primitives, {} materials ({} unique)\n"),
+                         model->getVertexCount(),
+                         model->getPrimitiveCount(),
+                         originalMaterialCount,
+                         model->getMaterialCount());
 
     return model;
 }
@@ -418,6 +570,13 @@ LoadCMSModel(const GeometryInfo::ResourceKey& key)
 } // end unnamed namespace
 
 
+void
+SetModelOptimizationEnabled(bool enabled)
+{
+    modelOptimization = enabled;
+}
+
+
 GeometryManager*
 GetGeometryManager()
 {
@@ -445,56 +604,74 @@ GeometryInfo::resolve(const fs::path& baseDir) const
 }
 
 
+PreparedGeometry::PreparedGeometry() = default;
+PreparedGeometry::~PreparedGeometry() = default;
+PreparedGeometry::PreparedGeometry(PreparedGeometry&&) noexcept = default;
+PreparedGeometry& PreparedGeometry::operator=(PreparedGeometry&&) noexcept = default;
+
+
 std::unique_ptr<Geometry>
 GeometryInfo::load(const ResourceKey& key) const
 {
-    GetLogger()->info(_("Loading model: {}\n"), key.resolvedPath);
-    std::unique_ptr<cmod::Model> model = nullptr;
-
-    switch (ContentType fileType = DetermineFileType(key.resolvedPath); fileType)
-    {
-    case ContentType::_3DStudio:
-        model = Load3DSModel(key, path);
-        break;
-    case ContentType::CelestiaModel:
-        model = LoadCMODModel(key, path);
-        break;
-    case ContentType::CelestiaMesh:
-        model = LoadCMSModel(key);
-        break;
-    default:
-        GetLogger()->error(_("Unknown model format '{}'\n"), key.resolvedPath);
-        return nullptr;
-    }
+    std::unique_ptr<cmod::Model> model = LoadConditionedModel(
+        key, path,
+        [](const fs::path& name, const fs::path& texPath)
+        {
+            return GetTextureManager()->getHandle(TextureInfo(name, texPath, TextureInfo::WrapTexture));
+        });
 
     if (model == nullptr)
-    {
-        GetLogger()->error(_("Error loading model '{}'\n"), key.resolvedPath);
         return nullptr;
-    }
 
-    // Condition the model for optimal rendering
-    // Many models tend to have a lot of duplicate materials; eliminate
-    // them, since unnecessarily setting material parameters can adversely
-    // impact rendering performance. Ideally uniquification of materials
-    // would be performed just once when the model was created, but
-    // that's not the case.
-    std::uint32_t originalMaterialCount = model->getMaterialCount();
-    model->uniquifyMaterials();
+    return std::make_unique<ModelGeometry>(std::move(model));
+}
 
-    // Sort the submeshes roughly by opacity.  This will eliminate a
-    // good number of the errors caused when translucent triangles are
-    // rendered before geometry that they cover.
-    model->sortMeshes(cmod::Model::OpacityComparator());
 
-    model->determineOpacity();
+PreparedGeometry
+GeometryInfo::prepare(const ResourceKey& key) const
+{
+    // The textures are numbered in the order they're first found; equal
+    // textures get equal numbers so that uniquifying the materials works
+    // as with real handles.
+    PreparedGeometry prepared;
+    prepared.model = LoadConditionedModel(
+        key, path,
+        [&prepared](const fs::path& name, const fs::path& texPath)
+        {
+            auto texture = std::make_pair(name, texPath);
+            auto iter = std::find(prepared.textures.begin(), prepared.textures.end(), texture);
+            if (iter == prepared.textures.end())
+                iter = prepared.textures.insert(iter, std::move(texture));
+            return static_cast<ResourceHandle>(iter - prepared.textures.begin());
+        });
 
-    // Display some statics for the model
-    GetLogger()->verbose(_("   Model statistics: {} vertices, {} primitives, {} materials ({} unique)\n"),
-                         model->getVertexCount(),
-                         model->getPrimitiveCount(),
-                         originalMaterialCount,
-                         model->getMaterialCount());
+    return prepared;
+}
 
-    return std::make_unique<ModelGeometry>(std::move(model));
+
+std::unique_ptr<Geometry>
+GeometryInfo::finish(const ResourceKey&, PreparedGeometry&& prepared) const
+{
+    if (prepared.model == nullptr)
+        return nullptr;
+
+    std::vector<ResourceHandle> handles;
+    handles.reserve(prepared.textures.size());
+    for (const auto& [name, texPath] : prepared.textures)
+        handles.push_back(GetTextureManager()->getHandle(TextureInfo(name, texPath, TextureInfo::WrapTexture)));
+
+    cmod::Model& model = *prepared.model;
+    for (unsigned int i = 0; i < model.getMaterialCount(); ++i)
+    {
+        cmod::Material material = model.getMaterial(i)->clone();
+        for (ResourceHandle& map : material.maps)
+        {
+            if (map != InvalidResource)
+                map = handles[static_cast<std::size_t>(map)];
+        }
+
+        model.setMaterial(i, std::move(material));
+    }
+
+    return std::make_unique<ModelGeometry>(std::move(prepared.model));
 }
@@ -12,6 +12,7 @@
 #include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 
@@ -19,6 +20,26 @@
 #include <celutil/resmanager.h>
 #include "geometry.h"
 
+namespace cmod
+{
+class Model;
+}
+
+// A model loaded on a worker thread. Its material maps hold indices into
+// textures, which are replaced by texture handles on the render thread as
+// the texture manager isn't thread safe.
+struct PreparedGeometry
+{
+    PreparedGeometry();
+    ~PreparedGeometry();
+    PreparedGeometry(PreparedGeometry&&) noexcept;
+    PreparedGeometry& operator=(PreparedGeometry&&) noexcept;
+
+    std::unique_ptr<cmod::Model> model;
+    // Texture names and the directories they're searched in
+    std::vector<std::pair<fs::path, fs::path>> textures;
+};
+
 
 class GeometryInfo
 {
@@ -57,6 +78,8 @@ class GeometryInfo
 
  public:
     using ResourceType = Geometry;
+    static constexpr celestia::util::MemoryTag memoryTag = celestia::util::MemoryTag::Geometry;
+    using PreparedType = PreparedGeometry;
 
     GeometryInfo(const fs::path& _source,
                  const fs::path& _path = "") :
@@ -81,6 +104,11 @@ class GeometryInfo
 
     ResourceKey resolve(const fs::path&) const;
     std::unique_ptr<Geometry> load(const ResourceKey&) const;
+
+    // Asynchronous loading: prepare reads and conditions the model on a
+    // worker thread, finish resolves its textures on the render thread.
+    PreparedGeometry prepare(const ResourceKey&) const;
+    std::unique_ptr<Geometry> finish(const ResourceKey&, PreparedGeometry&&) const;
 };
 
 inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
@@ -100,3 +128,6 @@ inline bool operator<(const GeometryInfo::ResourceKey& k0,
 typedef ResourceManager<GeometryInfo> GeometryManager;
 
 extern GeometryManager* GetGeometryManager();
+
+// Optimize the triangle and vertex order of loaded models, enabled by default
+void SetModelOptimizationEnabled(bool enabled);
@@ -0,0 +1,582 @@
+// modelcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "modelcache.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <fmt/format.h>
+
+#include <celmodel/material.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr std::string_view FileMagic{ "CELMODC\0", 8 };
+
+// Bump when the layout of the files or the conditioning of the models
+// changes
+constexpr std::uint32_t CacheVersion = 1;
+
+// Written in native byte order, files from machines of the other order
+// are ignored
+constexpr std::uint32_t ByteOrderMark = 0x01020304;
+
+// 64 bit FNV-1a
+constexpr std::uint64_t FNVOffsetBasis = UINT64_C(14695981039346656037);
+constexpr std::uint64_t FNVPrime = UINT64_C(1099511628211);
+
+std::uint64_t
+hashBytes(std::uint64_t hash, std::string_view data)
+{
+    for (char c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNVPrime;
+    }
+    return hash;
+}
+
+
+std::mutex directoryMutex;
+fs::path cacheDirectory;
+
+fs::path
+getCacheDirectory()
+{
+    std::scoped_lock lock(directoryMutex);
+    return cacheDirectory;
+}
+
+
+fs::path
+cachePath(const fs::path& directory, std::uint64_t key)
+{
+    return directory / fmt::format("{:016x}.bin", key);
+}
+
+
+// Appends values in native byte order. Arrays are padded to a multiple of
+// 4 bytes, so that the words of all the arrays stay aligned.
+class BlobWriter
+{
+public:
+    template<typename T> void write(T value)
+    {
+        static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Values must keep the words aligned");
+        writeBytes(&value, sizeof(T));
+    }
+
+    template<typename T> void writeArray(const T* values, std::size_t count)
+    {
+        static_assert(sizeof(T) == 4, "Array items must be words");
+        writeBytes(values, count * sizeof(T));
+    }
+
+    void writeString(std::string_view s)
+    {
+        write(static_cast<std::uint32_t>(s.size()));
+        writeBytes(s.data(), s.size());
+        data.append((4 - s.size() % 4) % 4, '\0');
+    }
+
+    void writeBytes(const void* bytes, std::size_t size)
+    {
+        data.append(static_cast<const char*>(bytes), size);
+    }
+
+    std::string data;
+};
+
+
+// Reads the values written by BlobWriter, failing on reads past the end
+class BlobReader
+{
+public:
+    BlobReader(const char* _data, std::size_t _size) : data(_data), size(_size) {}
+
+    template<typename T> bool read(T& value)
+    {
+        return readBytes(&value, sizeof(T));
+    }
+
+    template<typename T> bool readArray(std::vector<T>& values, std::size_t count)
+    {
+        if (count > (size - offset) / sizeof(T))
+            return false;
+        values.resize(count);
+        return readBytes(values.data(), count * sizeof(T));
+    }
+
+    bool readString(std::string& s)
+    {
+        std::uint32_t length;
+        if (!read(length) || length > size - offset)
+            return false;
+        s.assign(data + offset, length);
+        return skip(length + (4 - length % 4) % 4);
+    }
+
+    bool readBytes(void* bytes, std::size_t count)
+    {
+        if (count > size - offset)
+            return false;
+        std::memcpy(bytes, data + offset, count);
+        offset += count;
+        return true;
+    }
+
+    bool skip(std::size_t count)
+    {
+        if (count > size - offset)
+            return false;
+        offset += count;
+        return true;
+    }
+
+private:
+    const char* data;
+    std::size_t size;
+    std::size_t offset{ 0 };
+};
+
+
+void
+writeColor(BlobWriter& writer, const cmod::Color& color)
+{
+    writer.write(color.red());
+    writer.write(color.green());
+    writer.write(color.blue());
+}
+
+
+bool
+readColor(BlobReader& reader, cmod::Color& color)
+{
+    std::array<float, 3> rgb;
+    if (!reader.readBytes(rgb.data(), sizeof(rgb)))
+        return false;
+    color = cmod::Color(rgb[0], rgb[1], rgb[2]);
+    return true;
+}
+
+
+void
+writeVector(BlobWriter& writer, const Eigen::Vector3f& v)
+{
+    writer.writeArray(v.data(), 3);
+}
+
+
+bool
+readVector(BlobReader& reader, Eigen::Vector3f& v)
+{
+    return reader.readBytes(v.data(), 3 * sizeof(float));
+}
+
+
+void
+writeMesh(BlobWriter& writer, const cmod::Mesh& mesh, const std::vector<float>& lodErrors)
+{
+    const cmod::VertexDescription& desc = mesh.getVertexDescription();
+    writer.writeString(mesh.getName());
+    writer.write(static_cast<std::uint32_t>(desc.attributes.size()));
+    for (const cmod::VertexAttribute& attr : desc.attributes)
+    {
+        writer.write(static_cast<std::int32_t>(attr.semantic));
+        writer.write(static_cast<std::int32_t>(attr.format));
+        writer.write(static_cast<std::uint32_t>(attr.offsetWords));
+    }
+
+    writeVector(writer, mesh.getPositionOffset());
+    writeVector(writer, mesh.getPositionScale());
+
+    writer.write(static_cast<std::uint32_t>(lodErrors.size()));
+    writer.writeArray(lodErrors.data(), lodErrors.size());
+
+    std::size_t vertexWords = static_cast<std::size_t>(mesh.getVertexCount()) * mesh.getVertexStrideWords();
+    writer.write(static_cast<std::uint32_t>(mesh.getVertexCount()));
+    writer.write(static_cast<std::uint32_t>(vertexWords));
+    writer.writeArray(mesh.getVertexData(), vertexWords);
+
+    writer.write(static_cast<std::uint32_t>(mesh.getGroupCount()));
+    for (unsigned int i = 0; i < mesh.getGroupCount(); ++i)
+    {
+        const cmod::PrimitiveGroup* group = mesh.getGroup(i);
+        writer.write(static_cast<std::int32_t>(group->prim));
+        writer.write(static_cast<std::uint32_t>(group->materialIndex));
+        writer.write(static_cast<std::uint32_t>(group->lod));
+        writer.write(static_cast<std::uint32_t>(group->indices.size()));
+        writer.writeArray(group->indices.data(), group->indices.size());
+    }
+}
+
+
+std::optional<cmod::Mesh>
+readMesh(BlobReader& reader, std::uint32_t materialCount)
+{
+    cmod::Mesh mesh;
+
+    std::string name;
+    std::uint32_t attributeCount;
+    if (!reader.readString(name) || !reader.read(attributeCount))
+        return std::nullopt;
+    mesh.setName(std::move(name));
+
+    std::vector<cmod::VertexAttribute> attributes;
+    for (std::uint32_t i = 0; i < attributeCount; ++i)
+    {
+        std::int32_t semantic;
+        std::int32_t format;
+        std::uint32_t offsetWords;
+        if (!reader.read(semantic) || !reader.read(format) || !reader.read(offsetWords) ||
+            semantic < 0 || semantic >= static_cast<std::int32_t>(cmod::VertexAttributeSemantic::SemanticMax) ||
+            format < 0 || format >= static_cast<std::int32_t>(cmod::VertexAttributeFormat::FormatMax))
+        {
+            return std::nullopt;
+        }
+        attributes.emplace_back(static_cast<cmod::VertexAttributeSemantic>(semantic),
+                                static_cast<cmod::VertexAttributeFormat>(format),
+                                offsetWords);
+    }
+
+    if (!mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes))))
+        return std::nullopt;
+
+    Eigen::Vector3f positionOffset;
+    Eigen::Vector3f positionScale;
+    if (!readVector(reader, positionOffset) || !readVector(reader, positionScale))
+        return std::nullopt;
+    mesh.setPositionQuantization(positionOffset, positionScale);
+
+    std::uint32_t lodCount;
+    std::vector<float> lodErrors;
+    if (!reader.read(lodCount) || !reader.readArray(lodErrors, lodCount))
+        return std::nullopt;
+    for (float error : lodErrors)
+        mesh.addLod(error);
+
+    std::uint32_t vertexCount;
+    std::uint32_t vertexWords;
+    std::vector<cmod::VWord> vertices;
+    if (!reader.read(vertexCount) || !reader.read(vertexWords) ||
+        static_cast<std::size_t>(vertexCount) * mesh.getVertexStrideWords() != vertexWords ||
+        !reader.readArray(vertices, vertexWords))
+    {
+        return std::nullopt;
+    }
+    mesh.setVertices(vertexCount, std::move(vertices));
+
+    std::uint32_t groupCount;
+    if (!reader.read(groupCount))
+        return std::nullopt;
+    for (std::uint32_t i = 0; i < groupCount; ++i)
+    {
+        std::int32_t prim;
+        std::uint32_t materialIndex;
+        std::uint32_t lod;
+        std::uint32_t indexCount;
+        std::vector<cmod::Index32> indices;
+        if (!reader.read(prim) || !reader.read(materialIndex) || !reader.read(lod) ||
+            !reader.read(indexCount) || !reader.readArray(indices, indexCount) ||
+            prim < 0 || prim >= static_cast<std::int32_t>(cmod::PrimitiveGroupType::PrimitiveTypeMax) ||
+            (materialIndex >= materialCount && materialCount > 0) || lod > lodCount ||
+            std::any_of(indices.begin(), indices.end(), [vertexCount](cmod::Index32 index) { return index >= vertexCount; }))
+        {
+            return std::nullopt;
+        }
+
+        mesh.addGroup(static_cast<cmod::PrimitiveGroupType>(prim), materialIndex, std::move(indices), lod);
+    }
+
+    mesh.rebuildIndexMetadata();
+    return mesh;
+}
+
+} // end unnamed namespace
+
+
+void
+SetModelCacheDirectory(const fs::path& directory)
+{
+    std::scoped_lock lock(directoryMutex);
+    cacheDirectory = directory;
+}
+
+
+bool
+IsModelCacheEnabled()
+{
+    return !getCacheDirectory().empty();
+}
+
+
+std::uint64_t
+GetModelCacheKey(const fs::path& source, std::uint32_t options)
+{
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size(source, ec);
+    if (ec)
+        return 0;
+    fs::file_time_type time = fs::last_write_time(source, ec);
+    if (ec)
+        return 0;
+
+    std::uint64_t hash = FNVOffsetBasis ^ CacheVersion;
+    hash = hashBytes(hash, fmt::format("{}\n{}\n{}\n{}\n",
+                                       source.string(),
+                                       size,
+                                       time.time_since_epoch().count(),
+                                       options));
+    // 0 is reserved for models without a key
+    return hash == 0 ? 1 : hash;
+}
+
+
+std::string
+SerializeModel(const cmod::Model& model, const ModelTextureSource& getSource)
+{
+    BlobWriter writer;
+
+    // The textures are numbered in the order they're first used
+    std::vector<ResourceHandle> textures;
+    std::vector<std::array<std::int32_t, static_cast<std::size_t>(cmod::TextureSemantic::TextureSemanticMax)>> materialMaps;
+    for (unsigned int i = 0; i < model.getMaterialCount(); ++i)
+    {
+        const cmod::Material* material = model.getMaterial(i);
+        auto& maps = materialMaps.emplace_back();
+        for (std::size_t j = 0; j < maps.size(); ++j)
+        {
+            ResourceHandle handle = material->maps[j];
+            if (handle == InvalidResource)
+            {
+                maps[j] = -1;
+                continue;
+            }
+
+            auto it = std::find(textures.begin(), textures.end(), handle);
+            maps[j] = static_cast<std::int32_t>(it - textures.begin());
+            if (it == textures.end())
+                textures.push_back(handle);
+        }
+    }
+
+    writer.writeBytes(FileMagic.data(), FileMagic.size());
+    writer.write(CacheVersion);
+    writer.write(ByteOrderMark);
+    writer.write(static_cast<std::uint32_t>(textures.size()));
+    writer.write(static_cast<std::uint32_t>(model.getMaterialCount()));
+    writer.write(static_cast<std::uint32_t>(model.getMeshCount()));
+
+    for (ResourceHandle handle : textures)
+    {
+        auto [name, directory] = getSource(handle);
+        writer.writeString(name.string());
+        writer.writeString(directory.string());
+    }
+
+    for (unsigned int i = 0; i < model.getMaterialCount(); ++i)
+    {
+        const cmod::Material* material = model.getMaterial(i);
+        writeColor(writer, material->diffuse);
+        writeColor(writer, material->emissive);
+        writeColor(writer, material->specular);
+        writer.write(material->specularPower);
+        writer.write(material->opacity);
+        writer.write(static_cast<std::int32_t>(material->blend));
+        writer.writeArray(materialMaps[i].data(), materialMaps[i].size());
+    }
+
+    for (unsigned int i = 0; i < model.getMeshCount(); ++i)
+    {
+        const cmod::Mesh* mesh = model.getMesh(i);
+        std::vector<float> lodErrors;
+        for (unsigned int level = 1; level < mesh->getLodCount(); ++level)
+            lodErrors.push_back(mesh->getLodError(level));
+        writeMesh(writer, *mesh, lodErrors);
+    }
+
+    return std::move(writer.data);
+}
+
+
+std::unique_ptr<cmod::Model>
+DeserializeModel(const char* data, std::size_t size, const ModelTextureGetter& getTexture)
+{
+    BlobReader reader(data, size);
+
+    std::array<char, FileMagic.size()> magic;
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t textureCount;
+    std::uint32_t materialCount;
+    std::uint32_t meshCount;
+    if (!reader.readBytes(magic.data(), magic.size()) ||
+        std::string_view(magic.data(), magic.size()) != FileMagic ||
+        !reader.read(version) || version != CacheVersion ||
+        !reader.read(byteOrder) || byteOrder != ByteOrderMark ||
+        !reader.read(textureCount) || !reader.read(materialCount) || !reader.read(meshCount))
+    {
+        return nullptr;
+    }
+
+    std::vector<std::pair<std::string, std::string>> textures;
+    for (std::uint32_t i = 0; i < textureCount; ++i)
+    {
+        auto& [name, directory] = textures.emplace_back();
+        if (!reader.readString(name) || !reader.readString(directory))
+            return nullptr;
+    }
+
+    // Resolve the textures only once the whole file has been checked
+    struct CachedMaterial
+    {
+        cmod::Material material;
+        std::array<std::int32_t, static_cast<std::size_t>(cmod::TextureSemantic::TextureSemanticMax)> maps;
+    };
+
+    std::vector<CachedMaterial> materials(materialCount);
+    for (CachedMaterial& cached : materials)
+    {
+        std::int32_t blend;
+        if (!readColor(reader, cached.material.diffuse) ||
+            !readColor(reader, cached.material.emissive) ||
+            !readColor(reader, cached.material.specular) ||
+            !reader.read(cached.material.specularPower) ||
+            !reader.read(cached.material.opacity) ||
+            !reader.read(blend) ||
+            !reader.readBytes(cached.maps.data(), sizeof(cached.maps)) ||
+            blend < 0 || blend >= static_cast<std::int32_t>(cmod::BlendMode::BlendMax))
+        {
+            return nullptr;
+        }
+
+        cached.material.blend = static_cast<cmod::BlendMode>(blend);
+        for (std::int32_t map : cached.maps)
+        {
+            if (map < -1 || map >= static_cast<std::int32_t>(textureCount))
+                return nullptr;
+        }
+    }
+
+    std::vector<cmod::Mesh> meshes;
+    for (std::uint32_t i = 0; i < meshCount; ++i)
+    {
+        std::optional<cmod::Mesh> mesh = readMesh(reader, materialCount);
+        if (!mesh.has_value())
+            return nullptr;
+        meshes.push_back(std::move(*mesh));
+    }
+
+    auto model = std::make_unique<cmod::Model>();
+
+    std::vector<ResourceHandle> handles;
+    handles.reserve(textures.size());
+    for (const auto& [name, directory] : textures)
+        handles.push_back(getTexture(fs::path(name), fs::path(directory)));
+
+    for (CachedMaterial& cached : materials)
+    {
+        for (std::size_t j = 0; j < cached.maps.size(); ++j)
+        {
+            if (cached.maps[j] >= 0)
+                cached.material.maps[j] = handles[static_cast<std::size_t>(cached.maps[j])];
+        }
+        model->addMaterial(std::move(cached.material));
+    }
+
+    for (cmod::Mesh& mesh : meshes)
+        model->addMesh(std::move(mesh));
+
+    model->determineOpacity();
+    return model;
+}
+
+
+std::unique_ptr<cmod::Model>
+LoadCachedModel(std::uint64_t key, const ModelTextureGetter& getTexture)
+{
+    fs::path directory = getCacheDirectory();
+    if (directory.empty() || key == 0)
+        return nullptr;
+
+    fs::path path = cachePath(directory, key);
+    std::error_code ec;
+    if (!fs::exists(path, ec))
+        return nullptr;
+
+    std::optional<util::MappedFile> file = util::MappedFile::open(path);
+    if (!file.has_value())
+        return nullptr;
+
+    file->adviseSequential();
+    std::unique_ptr<cmod::Model> model = DeserializeModel(file->data(), file->size(), getTexture);
+    if (model == nullptr)
+        GetLogger()->warn("Ignoring broken model cache file {}\n", path);
+    return model;
+}
+
+
+// Write to a file private to this thread and move it in place, so that
+// concurrent loads of the same model never see a partial file
+void
+StoreCachedModel(std::uint64_t key, const cmod::Model& model, const ModelTextureSource& getSource)
+{
+    fs::path directory = getCacheDirectory();
+    if (directory.empty() || key == 0)
+        return;
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec)
+    {
+        GetLogger()->debug("Can't create model cache directory {}: {}\n", directory, ec.message());
+        return;
+    }
+
+    std::string data = SerializeModel(model, getSource);
+
+    fs::path path = cachePath(directory, key);
+    fs::path tempPath = path;
+    tempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    bool written;
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+        written = out.write(data.data(), static_cast<std::streamsize>(data.size())).flush().good();
+    }
+
+    if (written)
+        fs::rename(tempPath, path, ec);
+    if (!written || ec)
+    {
+        GetLogger()->debug("Can't add {} to the model cache\n", path);
+        fs::remove(tempPath, ec);
+    }
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,62 @@
+// modelcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <celcompat/filesystem.h>
+#include <celutil/reshandle.h>
+
+namespace cmod
+{
+class Model;
+}
+
+namespace celestia::engine
+{
+
+// Return the handle of a texture from its name and the directory it's
+// searched in
+using ModelTextureGetter = std::function<ResourceHandle(const fs::path&, const fs::path&)>;
+
+// Return the name and directory a texture handle was created from
+using ModelTextureSource = std::function<std::pair<fs::path, fs::path>(ResourceHandle)>;
+
+// The cache stores loaded and conditioned models of any format in a
+// directory, so that later runs copy their vertices and indices from a
+// mapped file instead of parsing the original. A model is found by the
+// key of its source file, which changes with its path, size and
+// modification time. The transform to the size and position of the object
+// isn't part of the cached model, so objects sharing a model share its
+// cached copy. Empty directory disables the cache, which is the default.
+void SetModelCacheDirectory(const fs::path& directory);
+bool IsModelCacheEnabled();
+
+// Key of a model loaded from source, 0 if the file can't be found. Models
+// conditioned with different options, e.g. mesh optimization, must be
+// given different values of options.
+std::uint64_t GetModelCacheKey(const fs::path& source, std::uint32_t options);
+
+// Return nullptr if the model isn't in the cache. Textures are resolved
+// with getTexture. Safe to call from several threads.
+std::unique_ptr<cmod::Model> LoadCachedModel(std::uint64_t key, const ModelTextureGetter& getTexture);
+void StoreCachedModel(std::uint64_t key, const cmod::Model& model, const ModelTextureSource& getSource);
+
+// The cache file contents of a model: the layout matches the mesh data,
+// so that the vertex and index arrays are single copies from the file.
+std::string SerializeModel(const cmod::Model& model, const ModelTextureSource& getSource);
+std::unique_ptr<cmod::Model> DeserializeModel(const char* data, std::size_t size, const ModelTextureGetter& getTexture);
+
+} // end namespace celestia::engine
@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <tuple>
 #include <vector>
 #include <utility>
 #include <celrender/gl/buffer.h>
@@ -33,6 +34,9 @@ constexpr gl::VertexObject::DataType GLComponentTypes[static_cast<std::size_t>(c
      gl::VertexObject::DataType::Float,         // Float3
      gl::VertexObject::DataType::Float,         // Float4,
      gl::VertexObject::DataType::UnsignedByte,  // UByte4
+     gl::VertexObject::DataType::Short,         // Short2
+     gl::VertexObject::DataType::Short,         // Short4
+     gl::VertexObject::DataType::Half,          // Half2
 };
 
 constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -42,6 +46,9 @@ constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFo
      3,  // Float3
      4,  // Float4,
      4,  // UByte4
+     2,  // Short2
+     4,  // Short4
+     2,  // Half2
 };
 
 constexpr bool GLComponentNormalized[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -51,6 +58,9 @@ constexpr bool GLComponentNormalized[static_cast<std::size_t>(cmod::VertexAttrib
      false,  // Float3
      false,  // Float4,
      true,  // UByte4
+     true,  // Short2
+     true,  // Short4
+     false, // Half2
 };
 
 constexpr int
@@ -95,6 +105,117 @@ setVertexArrays(gl::VertexObject &vao, const gl::Buffer &vbo, const cmod::Vertex
     }
 }
 
+struct GroupDraw
+{
+    unsigned int meshIndex;
+    unsigned int groupIndex;
+};
+
+bool
+isOpaqueMaterial(const cmod::Material* material)
+{
+    return material == nullptr ||
+           (!(material->opacity > 0.01f && material->opacity < 1.0f) &&
+            material->blend != cmod::BlendMode::AdditiveBlend);
+}
+
+// Bits of the state selecting the shader of a group: the vertex attributes,
+// the primitive type and the textures of the material
+unsigned int
+shaderKey(const cmod::VertexDescription& desc, cmod::PrimitiveGroupType prim, const cmod::Material* material)
+{
+    unsigned int key = 0;
+    unsigned int bit = 1;
+    for (auto semantic : { cmod::VertexAttributeSemantic::Normal,
+                           cmod::VertexAttributeSemantic::Color0,
+                           cmod::VertexAttributeSemantic::Texture0,
+                           cmod::VertexAttributeSemantic::PointSize })
+    {
+        if (desc.getAttribute(semantic).format != cmod::VertexAttributeFormat::InvalidFormat)
+            key |= bit;
+        bit <<= 1;
+    }
+
+    if (prim == cmod::PrimitiveGroupType::PointList || prim == cmod::PrimitiveGroupType::SpriteList)
+        key |= bit;
+    bit <<= 1;
+
+    if (material != nullptr)
+    {
+        for (std::size_t i = 0; i < static_cast<std::size_t>(cmod::TextureSemantic::TextureSemanticMax); ++i)
+        {
+            if (material->getMap(static_cast<cmod::TextureSemantic>(i)) != InvalidResource)
+                key |= bit;
+            bit <<= 1;
+        }
+    }
+
+    return key;
+}
+
+// Order of the draws of the primitive groups: opaque groups sorted by
+// shader, texture and material, so that the state changes between them are
+// few, then translucent groups in the order of the model.
+std::vector<GroupDraw>
+sortGroupDraws(const cmod::Model& model)
+{
+    auto getMaterial = [&model](unsigned int index)
+    {
+        return index < model.getMaterialCount() ? model.getMaterial(index) : nullptr;
+    };
+
+    std::vector<GroupDraw> draws;
+    for (unsigned int meshIndex = 0; meshIndex < model.getMeshCount(); ++meshIndex)
+    {
+        const cmod::Mesh* mesh = model.getMesh(meshIndex);
+        for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+            draws.push_back(GroupDraw{ meshIndex, groupIndex });
+    }
+
+    auto translucent = std::stable_partition(draws.begin(), draws.end(),
+        [&](const GroupDraw& d)
+        {
+            return isOpaqueMaterial(getMaterial(model.getMesh(d.meshIndex)->getGroup(d.groupIndex)->materialIndex));
+        });
+
+    std::stable_sort(draws.begin(), translucent,
+        [&](const GroupDraw& a, const GroupDraw& b)
+        {
+            const cmod::Mesh* meshA = model.getMesh(a.meshIndex);
+            const cmod::Mesh* meshB = model.getMesh(b.meshIndex);
+            const cmod::PrimitiveGroup* groupA = meshA->getGroup(a.groupIndex);
+            const cmod::PrimitiveGroup* groupB = meshB->getGroup(b.groupIndex);
+            const cmod::Material* materialA = getMaterial(groupA->materialIndex);
+            const cmod::Material* materialB = getMaterial(groupB->materialIndex);
+            unsigned int keyA = shaderKey(meshA->getVertexDescription(), groupA->prim, materialA);
+            unsigned int keyB = shaderKey(meshB->getVertexDescription(), groupB->prim, materialB);
+            ResourceHandle textureA = materialA == nullptr ? InvalidResource : materialA->getMap(cmod::TextureSemantic::DiffuseMap);
+            ResourceHandle textureB = materialB == nullptr ? InvalidResource : materialB->getMap(cmod::TextureSemantic::DiffuseMap);
+            return std::tie(keyA, textureA, groupA->materialIndex, a.meshIndex)
+                 < std::tie(keyB, textureB, groupB->materialIndex, b.meshIndex);
+        });
+
+    return draws;
+}
+
+// Simplified levels whose error is smaller than this on screen, in pixels,
+// are drawn instead of the full detail
+constexpr float MaxLodError = 1.0f;
+
+// The coarsest level of detail of the mesh which looks the same as the
+// full detail at lodScale pixels per model unit
+unsigned int
+selectLod(const cmod::Mesh& mesh, float lodScale)
+{
+    unsigned int level = 0;
+    if (lodScale <= 0.0f)
+        return level;
+
+    while (level + 1 < mesh.getLodCount() && mesh.getLodError(level + 1) * lodScale < MaxLodError)
+        ++level;
+    return level;
+}
+
 } // anonymous namespace
 
 
@@ -104,6 +225,8 @@ public:
     std::vector<gl::Buffer> vbos; // vertex buffer objects
     std::vector<gl::Buffer> vios; // vertex index objects
     std::vector<gl::VertexObject> vaos; // vertex attributes
+    std::vector<GroupDraw> draws; // primitive groups in the order of submission
+    std::vector<unsigned int> lods; // level of detail drawn of each mesh
 };
 
 
@@ -171,39 +294,40 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
             vao.setIndexBuffer(m_glData->vios.back(), 0, gl::VertexObject::IndexType::UnsignedInt);
             m_glData->vaos.emplace_back(std::move(vao));
         }
+
+        m_glData->draws = sortGroupDraws(*m_model);
     }
 
-    unsigned int lastMaterial = ~0u;
     unsigned int materialCount = m_model->getMaterialCount();
 
-    // Iterate over all meshes in the model
-    for (unsigned int meshIndex = 0; meshIndex < m_model->getMeshCount(); ++meshIndex)
+    m_glData->lods.resize(m_model->getMeshCount());
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+        m_glData->lods[i] = selectLod(*m_model->getMesh(i), rc.getLodScale());
+
+    for (const GroupDraw& draw : m_glData->draws)
     {
-        const cmod::Mesh* mesh = m_model->getMesh(meshIndex);
+        const cmod::Mesh* mesh = m_model->getMesh(draw.meshIndex);
 
-        if (meshIndex >= m_glData->vbos.size())
+        if (draw.meshIndex >= m_glData->vbos.size())
         {
-            GetLogger()->error(_("Mesh index {} is higher than VBO count {}!"), meshIndex, m_glData->vbos.size());
+            GetLogger()->error(_("Mesh index {} is higher than VBO count {}!"), draw.meshIndex, m_glData->vbos.size());
             return;
         }
 
-        // Iterate over all primitive groups in the mesh
-        for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
-        {
-            const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
-            rc.updateShader(mesh->getVertexDescription(), group->prim);
+        const cmod::PrimitiveGroup* group = mesh->getGroup(draw.groupIndex);
+        if (group->lod != m_glData->lods[draw.meshIndex])
+            continue;
 
-            // Set up the material
-            const cmod::Material* material = nullptr;
-            unsigned int materialIndex = group->materialIndex;
-            if (materialIndex != lastMaterial && materialIndex < materialCount)
-            {
-                material = m_model->getMaterial(materialIndex);
-            }
+        rc.setPositionQuantization(mesh->getPositionOffset(), mesh->getPositionScale());
+        rc.updateShader(mesh->getVertexDescription(), group->prim);
 
-            rc.setMaterial(material);
-            rc.drawGroup(m_glData->vaos[meshIndex], *group);
-        }
+        // Set up the material; the render context skips unchanged materials
+        const cmod::Material* material = nullptr;
+        if (group->materialIndex < materialCount)
+            material = m_model->getMaterial(group->materialIndex);
+
+        rc.setMaterial(material);
+        rc.drawGroup(m_glData->vaos[draw.meshIndex], *group);
     }
 }
 
@@ -246,3 +370,19 @@ ModelGeometry::loadTextures()
     }
 #endif
 }
+
+
+std::size_t
+ModelGeometry::getMemorySize() const
+{
+    std::size_t size = 0;
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+    {
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        size += static_cast<std::size_t>(mesh->getVertexCount()) * mesh->getVertexStrideWords() * sizeof(cmod::VWord);
+        for (unsigned int j = 0; j < mesh->getGroupCount(); ++j)
+            size += mesh->getGroup(j)->indices.size() * sizeof(cmod::Index32);
+    }
+
+    return size;
+}
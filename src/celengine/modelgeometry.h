@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
 #include <Eigen/Geometry>
@@ -42,6 +43,7 @@ public:
     bool isNormalized() const override;
 
     void loadTextures() override;
+    std::size_t getMemorySize() const override;
 
 private:
     std::unique_ptr<cmod::Model> m_model;
@@ -90,6 +90,14 @@ Texture* MultiResTexture::find(unsigned int resolution)
         break;
     }
 
+    // The preferred texture is still being loaded in the background. Use
+    // another resolution until it's ready, but don't replace it.
+    if (texMan->getState(tex[resolution]) == ResourceState::Loading)
+    {
+        res = texMan->find(tex[secondChoice]);
+        return res != nullptr ? res : texMan->find(tex[lastResort]);
+    }
+
     tex[resolution] = tex[secondChoice];
     res = texMan->find(tex[resolution]);
     if (res != nullptr)
@@ -1,14 +1,117 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
 #ifdef DEBUG
 #include <celutil/logger.h>
 #endif
+#include <celcompat/bit.h>
+#include <celutil/binarywrite.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/stringutils.h>
 #include <celutil/utf8.h>
 #include "name.h"
 
+namespace
+{
+
+constexpr std::uint32_t EmptySlot = std::numeric_limits<std::uint32_t>::max();
+constexpr std::uint32_t EraseMarker = std::numeric_limits<std::uint32_t>::max();
+constexpr std::size_t MinTableSize = 64;
+
+// Hash the names like compareIgnoringCase compares them, with FNV-1a
+std::size_t
+hashIgnoringCase(std::string_view s)
+{
+    std::uint64_t hash = UINT64_C(14695981039346656037);
+    for (char c : s)
+    {
+        hash ^= static_cast<std::uint64_t>(std::toupper(static_cast<unsigned char>(c)));
+        hash *= UINT64_C(1099511628211);
+    }
+
+    return static_cast<std::size_t>(hash);
+}
+
+// Read a little endian 32-bit word from the start of data
+bool
+readWord(std::string_view& data, std::uint32_t& value)
+{
+    if (data.size() < sizeof(value))
+        return false;
+
+    std::memcpy(&value, data.data(), sizeof(value));
+    if constexpr (celestia::compat::endian::native == celestia::compat::endian::big)
+        value = celestia::compat::byteswap(value);
+    data.remove_prefix(sizeof(value));
+    return true;
+}
+
+// Write an array of records made of 32-bit words in little endian order,
+// preceded by their count
+template<typename T>
+bool
+writeWords(std::ostream& out, const std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(std::uint32_t) == 0);
+    if (!celestia::util::writeLE(out, static_cast<std::uint32_t>(values.size())))
+        return false;
+
+    if constexpr (celestia::compat::endian::native == celestia::compat::endian::little)
+        return out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)).good();
+
+    std::array<std::uint32_t, sizeof(T) / sizeof(std::uint32_t)> words;
+    for (const T& value : values)
+    {
+        std::memcpy(words.data(), &value, sizeof(T));
+        for (std::uint32_t word : words)
+        {
+            if (!celestia::util::writeLE(out, word))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Read an array written by writeWords from the start of data
+template<typename T>
+bool
+readWords(std::string_view& data, std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(std::uint32_t) == 0);
+    std::uint32_t count;
+    if (!readWord(data, count) || count > data.size() / sizeof(T))
+        return false;
+
+    values.resize(count);
+    std::memcpy(values.data(), data.data(), count * sizeof(T));
+    data.remove_prefix(count * sizeof(T));
+    if constexpr (celestia::compat::endian::native == celestia::compat::endian::big)
+    {
+        std::array<std::uint32_t, sizeof(T) / sizeof(std::uint32_t)> words;
+        for (T& value : values)
+        {
+            std::memcpy(words.data(), &value, sizeof(T));
+            for (std::uint32_t& word : words)
+                word = celestia::compat::byteswap(word);
+            std::memcpy(&value, words.data(), sizeof(T));
+        }
+    }
+
+    return true;
+}
+
+} // end unnamed namespace
+
 std::uint32_t NameDatabase::getNameCount() const
 {
-    return nameIndex.size();
+    return nameIndex.count;
 }
 
 void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std::string& name, bool /*replaceGreek*/)
@@ -21,32 +124,46 @@ void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std:
             celestia::util::GetLogger()->debug("Duplicated name '{}' on object with catalog numbers: {} and {}\n", name, tmp, catalogNumber);
 #endif
         // Add the new name
-        //nameIndex.insert(NameIndex::value_type(name, catalogNumber));
         std::string fname = ReplaceGreekLetterAbbr(name);
 
-        nameIndex[fname] = catalogNumber;
-        std::string lname = D_(fname.c_str());
-        if (lname != fname)
-            localizedNameIndex[lname] = catalogNumber;
-        numberIndex.insert(NumberIndex::value_type(catalogNumber, fname));
+        // A name already present is given the new number, but the number
+        // still lists it as spelled this time
+        std::uint32_t entry = find(nameIndex, fname);
+        std::uint32_t numberEntry = entry;
+        if (entry == EmptySlot)
+        {
+            entry = numberEntry = addEntry(fname, catalogNumber);
+            insert(nameIndex, entry);
+            completionIndexValid = false;
+        }
+        else
+        {
+            entries[entry].catalogNumber = catalogNumber;
+            if (getString(entry) != fname)
+                numberEntry = addEntry(fname, catalogNumber);
+        }
+
+        addLocalizedName(fname, catalogNumber);
+        numberIndex.push_back({ catalogNumber, numberEntry });
+        updateMemory();
     }
 }
 void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
 {
-    numberIndex.erase(catalogNumber);
+    // Names are erased when the catalog numbers are sorted next, as erase
+    // is called for every object loaded
+    numberIndex.push_back({ catalogNumber, EraseMarker });
 }
 
 AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(std::string_view name, bool i18n) const
 {
-    auto iter = nameIndex.find(name);
-    if (iter != nameIndex.end())
-        return iter->second;
+    if (auto entry = find(nameIndex, name); entry != EmptySlot)
+        return entries[entry].catalogNumber;
 
     if (i18n)
     {
-        iter = localizedNameIndex.find(name);
-        if (iter != localizedNameIndex.end())
-            return iter->second;
+        if (auto entry = find(localizedNameIndex, name); entry != EmptySlot)
+            return entries[entry].catalogNumber;
     }
 
     auto replacedGreek = ReplaceGreekLetterAbbr(name);
@@ -56,63 +173,283 @@ AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(std::string_view
     return AstroCatalog::InvalidIndex;
 }
 
-// Return the first name matching the catalog number or end()
+// Return the first name matching the catalog number or an empty string
 // if there are no matching names.  The first name *should* be the
 // proper name of the OBJ, if one exists. This requires the
 // OBJ name database file to have the proper names listed before
-// other designations.  Also, the STL implementation must
-// preserve this order when inserting the names into the multimap
-// (not certain whether or not this behavior is in the STL spec.
-// but it works on the implementations I've tried so far.)
+// other designations.
 std::string NameDatabase::getNameByCatalogNumber(const AstroCatalog::IndexNumber catalogNumber) const
 {
     if (catalogNumber == AstroCatalog::InvalidIndex)
         return "";
 
-    NumberIndex::const_iterator iter = numberIndex.lower_bound(catalogNumber);
+    Names names = getNames(catalogNumber);
+    if (names.empty())
+        return "";
+
+    return std::string(*names.begin());
+}
 
-    if (iter != numberIndex.end() && iter->first == catalogNumber)
-        return iter->second;
+NameDatabase::Names NameDatabase::getNames(const AstroCatalog::IndexNumber catalogNumber) const
+{
+    sortNumbers();
 
-    return "";
+    auto compare = [](const NumberEntry& e1, const NumberEntry& e2) { return e1.catalogNumber < e2.catalogNumber; };
+    auto [first, last] = std::equal_range(numberIndex.begin(), numberIndex.end(),
+                                          NumberEntry{ catalogNumber, 0 }, compare);
+    return Names(this, numberIndex.data() + (first - numberIndex.begin()),
+                 numberIndex.data() + (last - numberIndex.begin()));
 }
 
+void NameDatabase::getCompletion(std::vector<std::string>& completion,
+                                 std::string_view name,
+                                 std::size_t limit) const
+{
+    if (!completionIndexValid)
+    {
+        completionIndex.clear();
+        completionKeys.clear();
+        completionIndex.reserve(nameIndex.count + localizedNameIndex.count);
+        for (const HashTable* table : { &nameIndex, &localizedNameIndex })
+        {
+            for (std::uint32_t entry : table->slots)
+            {
+                if (entry == EmptySlot)
+                    continue;
 
-// Return the first name matching the catalog number or end()
-// if there are no matching names.  The first name *should* be the
-// proper name of the OBJ, if one exists. This requires the
-// OBJ name database file to have the proper names listed before
-// other designations.  Also, the STL implementation must
-// preserve this order when inserting the names into the multimap
-// (not certain whether or not this behavior is in the STL spec.
-// but it works on the implementations I've tried so far.)
-NameDatabase::NumberIndex::const_iterator NameDatabase::getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const
+                auto keyOffset = static_cast<std::uint32_t>(completionKeys.size());
+                UTF8AppendFoldedKey(getString(entry), completionKeys);
+                completionIndex.push_back({ entry, keyOffset,
+                                            static_cast<std::uint32_t>(completionKeys.size()) - keyOffset });
+            }
+        }
+
+        std::sort(completionIndex.begin(), completionIndex.end(),
+                  [this](const CompletionEntry& e1, const CompletionEntry& e2) { return getKey(e1) < getKey(e2); });
+        completionIndexValid = true;
+        updateMemory();
+    }
+
+    std::string prefix;
+    UTF8AppendFoldedKey(ReplaceGreekLetter(name), prefix);
+    auto iter = std::lower_bound(completionIndex.begin(), completionIndex.end(), prefix,
+                                 [this](const CompletionEntry& e, std::string_view key) { return getKey(e) < key; });
+    for (std::size_t count = 0;
+         count < limit && iter != completionIndex.end() && getKey(*iter).substr(0, prefix.size()) == prefix;
+         ++count, ++iter)
+    {
+        completion.emplace_back(getString(iter->entry));
+    }
+}
+
+bool NameDatabase::writeSnapshot(std::ostream& out) const
+{
+    sortNumbers();
+
+    // Only keep the entries of the names and of the catalog numbers
+    std::vector<std::uint32_t> remap(entries.size(), EmptySlot);
+    std::string snapshotStrings;
+    std::vector<Entry> snapshotEntries;
+    auto addSnapshotEntry = [&](std::uint32_t entry)
+    {
+        if (remap[entry] == EmptySlot)
+        {
+            std::string_view name = getString(entry);
+            remap[entry] = static_cast<std::uint32_t>(snapshotEntries.size());
+            snapshotEntries.push_back({ static_cast<std::uint32_t>(snapshotStrings.size()),
+                                        static_cast<std::uint32_t>(name.size()),
+                                        entries[entry].catalogNumber });
+            snapshotStrings.append(name);
+            snapshotStrings.push_back('\0');
+        }
+        return remap[entry];
+    };
+
+    std::vector<std::uint32_t> slots(nameIndex.slots.size(), EmptySlot);
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+        if (nameIndex.slots[i] != EmptySlot)
+            slots[i] = addSnapshotEntry(nameIndex.slots[i]);
+    }
+
+    std::vector<NumberEntry> numbers(numberIndex);
+    for (NumberEntry& e : numbers)
+        e.entry = addSnapshotEntry(e.entry);
+
+    // Pad the strings so that the arrays after them are aligned
+    snapshotStrings.resize((snapshotStrings.size() + 3) & ~std::size_t(3), '\0');
+    return celestia::util::writeLE(out, static_cast<std::uint32_t>(snapshotStrings.size())) &&
+           out.write(snapshotStrings.data(), snapshotStrings.size()).good() &&
+           writeWords(out, snapshotEntries) &&
+           writeWords(out, slots) &&
+           writeWords(out, numbers);
+}
+
+bool NameDatabase::readSnapshot(std::string_view& data)
 {
-    NumberIndex::const_iterator iter = numberIndex.lower_bound(catalogNumber);
+    std::uint32_t stringsSize;
+    std::vector<Entry> snapshotEntries;
+    std::vector<std::uint32_t> slots;
+    std::vector<NumberEntry> numbers;
+    if (!readWord(data, stringsSize) || stringsSize > data.size())
+        return false;
+
+    std::string_view snapshotStrings = data.substr(0, stringsSize);
+    data.remove_prefix(stringsSize);
+    if (!readWords(data, snapshotEntries) || !readWords(data, slots) || !readWords(data, numbers))
+        return false;
 
-    if (iter == numberIndex.end() || iter->first != catalogNumber)
-        return getFinalNameIter();
+    // Check everything the index relies on, so that a damaged snapshot
+    // can't make lookups read out of bounds
+    auto entryCount = static_cast<std::uint32_t>(snapshotEntries.size());
+    if ((slots.size() & (slots.size() - 1)) != 0 ||
+        std::any_of(snapshotEntries.begin(), snapshotEntries.end(),
+                    [&snapshotStrings](const Entry& e) { return e.offset >= snapshotStrings.size() ||
+                                                                 snapshotStrings.size() - e.offset <= e.length ||
+                                                                 snapshotStrings[e.offset + e.length] != '\0'; }) ||
+        std::any_of(slots.begin(), slots.end(),
+                    [entryCount](std::uint32_t e) { return e != EmptySlot && e >= entryCount; }) ||
+        std::any_of(numbers.begin(), numbers.end(),
+                    [entryCount](const NumberEntry& e) { return e.entry >= entryCount; }) ||
+        !std::is_sorted(numbers.begin(), numbers.end(),
+                        [](const NumberEntry& e1, const NumberEntry& e2) { return e1.catalogNumber < e2.catalogNumber; }))
+    {
+        return false;
+    }
+
+    auto slotCount = static_cast<std::uint32_t>(std::count_if(slots.begin(), slots.end(),
+                                                              [](std::uint32_t e) { return e != EmptySlot; }));
+    // The table must have an empty slot for the probes to end
+    if (!slots.empty() && slotCount * 2 > slots.size())
+        return false;
+
+    strings.assign(snapshotStrings);
+    entries = std::move(snapshotEntries);
+    nameIndex.slots = std::move(slots);
+    nameIndex.count = slotCount;
+    numberIndex = std::move(numbers);
+    sortedNumbers = numberIndex.size();
+
+    localizedNameIndex = {};
+    for (const NumberEntry& e : numberIndex)
+        addLocalizedName(getString(e.entry), e.catalogNumber);
+    completionIndexValid = false;
+    updateMemory();
+    return true;
+}
+
+void NameDatabase::addLocalizedName(std::string_view name, AstroCatalog::IndexNumber catalogNumber)
+{
+    // The names are NUL terminated
+    std::string_view lname = D_(name.data());
+    if (lname == name)
+        return;
+
+    std::uint32_t localized = find(localizedNameIndex, lname);
+    if (localized == EmptySlot)
+    {
+        insert(localizedNameIndex, addEntry(lname, catalogNumber));
+        completionIndexValid = false;
+    }
     else
-        return iter;
+    {
+        entries[localized].catalogNumber = catalogNumber;
+    }
+}
+
+std::string_view NameDatabase::getString(std::uint32_t entry) const
+{
+    const Entry& e = entries[entry];
+    return std::string_view(strings.data() + e.offset, e.length);
+}
+
+std::string_view NameDatabase::getKey(const CompletionEntry& e) const
+{
+    return std::string_view(completionKeys.data() + e.keyOffset, e.keyLength);
 }
 
-NameDatabase::NumberIndex::const_iterator NameDatabase::getFinalNameIter() const
+std::uint32_t NameDatabase::addEntry(std::string_view name, AstroCatalog::IndexNumber catalogNumber)
 {
-    return numberIndex.end();
+    entries.push_back({ static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(name.size()), catalogNumber });
+    strings.append(name);
+    strings.push_back('\0');
+    return static_cast<std::uint32_t>(entries.size() - 1);
 }
 
-void NameDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name) const
+std::uint32_t NameDatabase::find(const HashTable& table, std::string_view name) const
 {
-    std::string name2 = ReplaceGreekLetter(name);
-    for (const auto &[n, _] : nameIndex)
+    if (table.slots.empty())
+        return EmptySlot;
+
+    std::size_t mask = table.slots.size() - 1;
+    for (std::size_t i = hashIgnoringCase(name) & mask;; i = (i + 1) & mask)
     {
-        if (UTF8StartsWith(n, name2, true))
-            completion.push_back(n);
+        std::uint32_t entry = table.slots[i];
+        if (entry == EmptySlot || compareIgnoringCase(getString(entry), name) == 0)
+            return entry;
     }
+}
 
-    for (const auto &[n, _] : localizedNameIndex)
+void NameDatabase::insert(HashTable& table, std::uint32_t entry)
+{
+    // Keep the table at most half full so that probe sequences stay short
+    if ((table.count + 1) * 2 > table.slots.size())
     {
-        if (UTF8StartsWith(n, name2, true))
-            completion.push_back(n);
+        std::vector<std::uint32_t> slots(std::max<std::size_t>(table.slots.size() * 2, MinTableSize), EmptySlot);
+        std::swap(slots, table.slots);
+        table.count = 0;
+        for (std::uint32_t e : slots)
+        {
+            if (e != EmptySlot)
+                insert(table, e);
+        }
     }
+
+    std::size_t mask = table.slots.size() - 1;
+    std::size_t i = hashIgnoringCase(getString(entry)) & mask;
+    while (table.slots[i] != EmptySlot)
+        i = (i + 1) & mask;
+    table.slots[i] = entry;
+    ++table.count;
+}
+
+void NameDatabase::sortNumbers() const
+{
+    if (sortedNumbers == numberIndex.size())
+        return;
+
+    // The stable sort and merge keep the names of a number in the order
+    // they were added in
+    auto compare = [](const NumberEntry& e1, const NumberEntry& e2) { return e1.catalogNumber < e2.catalogNumber; };
+    auto middle = numberIndex.begin() + static_cast<std::ptrdiff_t>(sortedNumbers);
+    std::stable_sort(middle, numberIndex.end(), compare);
+    std::inplace_merge(numberIndex.begin(), middle, numberIndex.end(), compare);
+
+    // Drop the erasures and the names before them
+    auto out = numberIndex.begin();
+    for (auto first = numberIndex.begin(); first != numberIndex.end();)
+    {
+        auto last = std::find_if(first, numberIndex.end(),
+                                 [first](const NumberEntry& e) { return e.catalogNumber != first->catalogNumber; });
+        auto kept = last;
+        while (kept != first && (kept - 1)->entry != EraseMarker)
+            --kept;
+        out = std::copy(kept, last, out);
+        first = last;
+    }
+
+    numberIndex.erase(out, numberIndex.end());
+    sortedNumbers = numberIndex.size();
+    updateMemory();
+}
+
+// Account the capacity of the storage, which only changes when it grows
+void NameDatabase::updateMemory() const
+{
+    memory.set(strings.capacity() +
+               entries.capacity() * sizeof(Entry) +
+               (nameIndex.slots.capacity() + localizedNameIndex.slots.capacity()) * sizeof(std::uint32_t) +
+               numberIndex.capacity() * sizeof(NumberEntry) +
+               completionIndex.capacity() * sizeof(CompletionEntry) +
+               completionKeys.capacity());
 }
@@ -12,24 +12,74 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <map>
+#include <iosfwd>
+#include <iterator>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include <celengine/astroobj.h>
-#include <celutil/stringutils.h>
+#include <celutil/memoryaccounting.h>
 
 // TODO: this can be "detemplatized" by creating e.g. a global-scope enum InvalidCatalogNumber since there
 // lies the one and only need for type genericity.
+//
+// The names are kept in a single string arena. Lookups by name go through
+// open addressing hash tables of the entries, hashed and compared ignoring
+// case, and lookups by catalog number through an array of the names of
+// each number sorted by number.
 class NameDatabase
 {
- public:
-    using NameIndex = std::map<std::string, AstroCatalog::IndexNumber, CompareIgnoringCasePredicate>;
-    using NumberIndex = std::multimap<AstroCatalog::IndexNumber, std::string>;
+    struct NumberEntry;
 
  public:
+    // The names of an object, in the order they were added so that the
+    // proper name comes first if the name database lists it first. The
+    // names are NUL terminated and remain valid until a name is added.
+    class Names
+    {
+     public:
+        class iterator
+        {
+         public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view*;
+            using reference = std::string_view;
+
+            std::string_view operator*() const;
+            iterator& operator++() { ++m_entry; return *this; }
+            bool operator==(const iterator& other) const { return m_entry == other.m_entry; }
+            bool operator!=(const iterator& other) const { return m_entry != other.m_entry; }
+
+         private:
+            iterator(const NameDatabase* db, const NumberEntry* entry) : m_db(db), m_entry(entry) {}
+
+            const NameDatabase* m_db;
+            const NumberEntry* m_entry;
+
+            friend class Names;
+        };
+
+        iterator begin() const { return { m_db, m_first }; }
+        iterator end() const { return { m_db, m_last }; }
+        bool empty() const { return m_first == m_last; }
+
+     private:
+        Names(const NameDatabase* db, const NumberEntry* first, const NumberEntry* last) :
+            m_db(db), m_first(first), m_last(last) {}
+
+        const NameDatabase* m_db;
+        const NumberEntry* m_first;
+        const NumberEntry* m_last;
+
+        friend class NameDatabase;
+    };
+
     NameDatabase() {};
 
 
@@ -43,13 +93,87 @@ class NameDatabase
     AstroCatalog::IndexNumber getCatalogNumberByName(std::string_view, bool i18n) const;
     std::string getNameByCatalogNumber(const AstroCatalog::IndexNumber) const;
 
-    NumberIndex::const_iterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
-    NumberIndex::const_iterator getFinalNameIter() const;
+    Names getNames(const AstroCatalog::IndexNumber catalogNumber) const;
+
+    // Add the names and localized names starting with name, ignoring case,
+    // up to limit of them
+    void getCompletion(std::vector<std::string>& completion,
+                       std::string_view name,
+                       std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
 
-    void getCompletion(std::vector<std::string>& completion, std::string_view name) const;
+    // Write the names in the layout of the index, so that readSnapshot
+    // loads them without parsing or hashing them again. The localized
+    // names aren't written as they depend on the locale.
+    bool writeSnapshot(std::ostream&) const;
 
- protected:
-    NameIndex   nameIndex;
-    NameIndex   localizedNameIndex;
-    NumberIndex numberIndex;
+    // Replace the names with those of a snapshot at the start of data, and
+    // advance data past the snapshot
+    bool readSnapshot(std::string_view& data);
+
+ private:
+    struct Entry
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+        AstroCatalog::IndexNumber catalogNumber;
+    };
+
+    struct NumberEntry
+    {
+        AstroCatalog::IndexNumber catalogNumber;
+        // Index of the name in entries, or EraseMarker for an erase
+        std::uint32_t entry;
+    };
+
+    // A name and the offset of its case folded key in completionKeys
+    struct CompletionEntry
+    {
+        std::uint32_t entry;
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+    };
+
+    // Hash table of indices into entries, with a power of two size
+    struct HashTable
+    {
+        std::vector<std::uint32_t> slots;
+        std::uint32_t count{ 0 };
+    };
+
+    std::string_view getString(std::uint32_t entry) const;
+    std::string_view getKey(const CompletionEntry&) const;
+    std::uint32_t addEntry(std::string_view, AstroCatalog::IndexNumber);
+    std::uint32_t find(const HashTable&, std::string_view) const;
+    void insert(HashTable&, std::uint32_t entry);
+    void sortNumbers() const;
+    void addLocalizedName(std::string_view, AstroCatalog::IndexNumber);
+    void updateMemory() const;
+
+    // The text of all the names, each followed by a NUL
+    std::string strings;
+    std::vector<Entry> entries;
+    HashTable nameIndex;
+    HashTable localizedNameIndex;
+
+    // The names of each catalog number and the erasures, sorted by number
+    // up to sortedNumbers. Within a number they're in the order they were
+    // added in; an erasure drops the names before it when sorting.
+    mutable std::vector<NumberEntry> numberIndex;
+    mutable std::size_t sortedNumbers{ 0 };
+
+    // The names and localized names sorted by their case folded form, so
+    // that the names with a prefix are consecutive. It's built on the first
+    // completion after names are added, with the folded forms as keys which
+    // compare bytewise.
+    mutable std::vector<CompletionEntry> completionIndex;
+    mutable std::string completionKeys;
+    mutable bool completionIndexValid{ false };
+
+    mutable celestia::util::MemoryRecord memory{ celestia::util::MemoryTag::Names };
 };
+
+inline std::string_view
+NameDatabase::Names::iterator::operator*() const
+{
+    return m_db->getString(m_entry->entry);
+}
@@ -11,6 +11,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/vecgl.h>
 #include <celutil/gettext.h>
+#include "hash.h"
 #include "meshmanager.h"
 #include "nebula.h"
 #include "rendcontext.h"
@@ -84,3 +85,28 @@ unsigned int Nebula::getLabelMask() const
 {
     return Renderer::NebulaLabels;
 }
+
+// Binary record: the common DSO record, then
+//   string   mesh file name as given in the catalog
+bool Nebula::saveBinary(std::ostream& out, const AssociativeArray& params) const
+{
+    const std::string* meshName = params.getString("Mesh");
+    return DeepSkyObject::saveBinary(out, params) &&
+           writeBinaryString(out, meshName == nullptr ? std::string_view() : *meshName);
+}
+
+bool Nebula::loadBinary(std::istream& in, const fs::path& resPath)
+{
+    std::string meshName;
+    if (!DeepSkyObject::loadBinary(in, resPath) || !readBinaryString(in, meshName))
+        return false;
+
+    if (!meshName.empty())
+    {
+        ResourceHandle geometryHandle =
+            GetGeometryManager()->getHandle(GeometryInfo(fs::path(meshName), resPath));
+        setGeometry(geometryHandle);
+    }
+
+    return true;
+}
@@ -12,18 +12,32 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
-#include <vector>
+#include <celengine/octreeculling.h>
+#include <celutil/taskscheduler.h>
 
 // The DynamicOctree and StaticOctree template arguments are:
-// OBJ:  object hanging from the node,
-// PREC: floating point precision of the culling operations at node level.
+// OBJ:    object hanging from the node,
+// PREC:   floating point precision of the culling operations at node level,
+// TRAITS: placement and processing of the objects, see OctreeTraits.
 // The hierarchy of octree nodes is built using a single precision value (excludingFactor), which relates to an
 // OBJ's limiting property defined by the octree particular specialization: ie. we use [absolute magnitude] for star octrees, etc.
 // For details, see notes below.
 
+// The traversal methods accept any processor class with a process method of
+// this signature. Passing a class derived from OctreeProcessor, rather than
+// an OctreeProcessor reference, lets the calls be inlined if the class or
+// its process method is final.
 template <class OBJ, class PREC> class OctreeProcessor
 {
  public:
@@ -34,6 +48,54 @@ template <class OBJ, class PREC> class OctreeProcessor
 };
 
 
+// The objects of a static octree node, with their positions and limiting
+// factors when the octree has object arrays; these are nullptr otherwise.
+// The positions are single precision, either absolute or relative to the
+// center of the node, and radius is only set for the octree types whose
+// objects have a size; both are up to buildObjectArrays.
+template <class OBJ, class PREC> struct OctreeNodeObjects
+{
+    const OBJ*                       objects;
+    const float*                     x;
+    const float*                     y;
+    const float*                     z;
+    const float*                     limitingFactor;
+    const float*                     radius;
+    const Eigen::Matrix<PREC, 3, 1>* center;
+    std::uint32_t                    count;
+};
+
+
+// OctreeTraits is specialized for each type of object stored in an octree,
+// and provides the following static members:
+//
+//   SplitThreshold: number of objects a node must contain before its
+//     children are generated.
+//   bool limitingFactorPredicate(const OBJ&, float exclusionFactor): true if
+//     the object must be kept in a node with this exclusion factor.
+//   bool straddlingPredicate(const PointType& cellCenterPos, const OBJ&):
+//     true if the object overlaps several children of the node.
+//   PREC decayFunction(PREC exclusionFactor): the exclusion factor of the
+//     children of a node.
+//   PointType getPosition(const OBJ&)
+//   template <class PROCESSOR>
+//   void processVisibleObjects(const OctreeNodeObjects<OBJ, PREC>&,
+//                              PROCESSOR&,
+//                              const OctreeFrustumCuller<PREC>&,
+//                              PREC dimmest): process the objects of a
+//     visible node which may be brighter than the limiting factor.
+//   template <class PROCESSOR>
+//   void processCloseObjects(const OctreeNodeObjects<OBJ, PREC>&,
+//                            PROCESSOR&,
+//                            const PointType& obsPosition,
+//                            PREC boundingRadius): process the objects of a
+//     node which are within boundingRadius of the observer.
+//
+// The octree calls these directly instead of through function pointers, so
+// that they can be inlined in the traversal of each object type.
+template <class OBJ, class PREC> struct OctreeTraits;
+
+
 
 struct OctreeLevelStatistics
 {
@@ -43,19 +105,12 @@ struct OctreeLevelStatistics
 };
 
 
-template <class OBJ, class PREC> class StaticOctree;
-template <class OBJ, class PREC> class DynamicOctree
+template <class OBJ, class PREC, class TRAITS = OctreeTraits<OBJ, PREC>> class StaticOctree;
+template <class OBJ, class PREC, class TRAITS = OctreeTraits<OBJ, PREC>> class DynamicOctree
 {
 public:
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
-
-private:
-    typedef std::vector<const OBJ*> ObjectList;
-
-
-    typedef bool (LimitingFactorPredicate)     (const OBJ&, const float);
-    typedef bool (StraddlingPredicate)         (const Eigen::Matrix<PREC, 3, 1>&, const OBJ&, const float);
-    typedef PREC (ExclusionFactorDecayFunction)(const PREC);
+    typedef std::vector<const OBJ*>   ObjectList;
 
  public:
     DynamicOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
@@ -63,19 +118,15 @@ private:
     ~DynamicOctree();
 
     void insertObject  (const OBJ&, const PREC);
-    void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
-
- private:
-   static unsigned int SPLIT_THRESHOLD;
-
-   static LimitingFactorPredicate*      limitingFactorPredicate;
-   static StraddlingPredicate*          straddlingPredicate;
-   static ExclusionFactorDecayFunction* decayFunction;
+    void insertObjects (ObjectList&&, const PREC, unsigned int parallelLevels = 0);
+    void rebuildAndSort(StaticOctree<OBJ, PREC, TRAITS>*&, OBJ*&);
 
  private:
     void           add  (const OBJ&);
+    void           createChildren(const PREC);
     void           split(const PREC);
     void           sortIntoChildNodes();
+    static int     getChildIndex(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
     DynamicOctree* getChild(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
 
     DynamicOctree**            _children;
@@ -84,36 +135,63 @@ private:
     ObjectList*                _objects;
 };
 
-// make clang happy
-#ifndef _MSC_VER
-template<> DynamicOctree<Star, float>::ExclusionFactorDecayFunction* DynamicOctree<Star, float>::decayFunction;
-template<> DynamicOctree<Star, float>::LimitingFactorPredicate* DynamicOctree<Star, float>::limitingFactorPredicate;
-template<> DynamicOctree<Star, float>::StraddlingPredicate* DynamicOctree<Star, float>::straddlingPredicate;
-template<> unsigned int DynamicOctree<Star, float>::SPLIT_THRESHOLD;
-
-template<> DynamicOctree<DeepSkyObject*, double>::ExclusionFactorDecayFunction* DynamicOctree<DeepSkyObject*, double>::decayFunction;
-template<> DynamicOctree<DeepSkyObject*, double>::LimitingFactorPredicate* DynamicOctree<DeepSkyObject *, double>::limitingFactorPredicate;
-template<> DynamicOctree<DeepSkyObject*, double>::StraddlingPredicate* DynamicOctree<DeepSkyObject *, double>::straddlingPredicate;
-template<> unsigned int DynamicOctree<DeepSkyObject*, double>::SPLIT_THRESHOLD;
-#endif
-
-template <class OBJ, class PREC> class StaticOctree
+template <class OBJ, class PREC, class TRAITS> class StaticOctree
 {
- friend class DynamicOctree<OBJ, PREC>;
+ friend class DynamicOctree<OBJ, PREC, TRAITS>;
 
  public:
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
 
+    // The nodes of the octree are stored in a single array in breadth-first
+    // order. The eight children of a node are adjacent, so a node only needs
+    // the index of its first child. The objects of a node occupy a
+    // contiguous range of the object array, also in breadth-first order.
+    struct Node
+    {
+        PointType     cellCenterPos;
+        float         exclusionFactor;
+        std::uint32_t firstObject;
+        std::uint32_t nObjects;
+        std::uint32_t firstChild;
+    };
+
+    // The root node is never a child, so index 0 marks a leaf node
+    static constexpr std::uint32_t NoChildren = 0;
+
+    // A node to resume a traversal from, used to split the traversal into
+    // independent parts
+    struct Subtree
+    {
+        std::uint32_t nodeIndex;
+        PREC          scale;
+        PREC          minDistance;
+        PREC          dimmest;
+    };
+
+    // State of a traversal spread over several calls. Nodes are visited
+    // breadth first, which is brightest first as objects are kept in the
+    // highest node whose exclusion factor they don't exceed.
+    struct Traversal
+    {
+        std::vector<Subtree> queue;
+        std::size_t          next{ 0 };
+        bool                 started{ false };
+
+        void reset()
+        {
+            queue.clear();
+            next = 0;
+            started = false;
+        }
+    };
+
  public:
-    StaticOctree(const PointType&    cellCenterPos,
-                 const float         exclusionFactor,
-                 OBJ*                _firstObject,
-                 unsigned int        nObjects);
-    ~StaticOctree();
+    ~StaticOctree() = default;
 
-    // These methods are only declared at the template level; we'll implement them as
-    // full specializations, allowing for different traversal strategies depending on the
-    // object type and nature.
+    // Create an octree from a node array, e.g. one restored from a cache.
+    // Returns nullptr if the nodes don't describe a valid octree for
+    // nObjects objects.
+    static StaticOctree* create(std::vector<Node>&& nodes, OBJ* objects, std::uint32_t nObjects);
 
     // This method searches the octree for objects that are likely to be visible
     // to a viewer with the specified obsPosition and limitingFactor.  The
@@ -122,31 +200,144 @@ template <class OBJ, class PREC> class StaticOctree
     // objects that are outside the view frustum may be.  Frustum tests are performed
     // only at the node level to optimize the octree traversal, so an exact test
     // (if one is required) is the responsibility of the callback method.
-    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+    template <class PROCESSOR>
+    void processVisibleObjects(PROCESSOR&                        processor,
                                const PointType&                  obsPosition,
                                const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
                                float                             limitingFactor,
                                PREC                              scale) const;
 
-    void processCloseObjects(OctreeProcessor<OBJ, PREC>&        processor,
+    template <class PROCESSOR>
+    void processCloseObjects(PROCESSOR&                         processor,
                              const PointType&                   obsPosition,
                              PREC                               boundingRadius,
                              PREC                               scale) const;
 
+    // Process the objects closer than the processor's searchRadius(),
+    // visiting the children of each node nearest first. The radius is read
+    // again before each node, so a k-nearest query can shrink it to the
+    // distance of the kth nearest object found so far and skip the nodes
+    // beyond it.
+    template <class PROCESSOR>
+    void processNearestObjects(PROCESSOR&       processor,
+                               const PointType& obsPosition,
+                               PREC             scale) const;
+
+    // Split processVisibleObjects into independent subtrees: starting from
+    // the root, whole levels of the tree are processed until at least
+    // minSubtrees nodes remain to be visited or maxLevels levels have been
+    // processed. The remaining nodes are returned; passing each of them to
+    // processVisibleSubtree completes the traversal. The subtrees don't
+    // share any objects, so they may be processed concurrently.
+    template <class PROCESSOR>
+    std::vector<Subtree> processVisibleLevels(PROCESSOR&                        processor,
+                                              const PointType&                  obsPosition,
+                                              const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                              float                             limitingFactor,
+                                              PREC                              scale,
+                                              std::size_t                       minSubtrees,
+                                              unsigned int                      maxLevels) const;
+
+    template <class PROCESSOR>
+    void processVisibleSubtree(const Subtree&                    subtree,
+                               PROCESSOR&                        processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor) const;
+
+    // Continue a breadth first traversal of the visible objects until the
+    // deadline has passed, resuming where an earlier call stopped. Return
+    // true once all the visible objects have been processed; the objects
+    // processed by all the calls are those processVisibleObjects would.
+    template <class PROCESSOR>
+    bool processVisibleObjectsUntil(Traversal&                            traversal,
+                                    PROCESSOR&                            processor,
+                                    const PointType&                      obsPosition,
+                                    const Eigen::Hyperplane<PREC, 3>*     frustumPlanes,
+                                    float                                 limitingFactor,
+                                    PREC                                  scale,
+                                    std::chrono::steady_clock::time_point deadline) const;
+
     int countChildren() const;
     int countObjects()  const;
 
-    void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
+    void computeStatistics(std::vector<OctreeLevelStatistics>& stats) const;
+
+    const std::vector<Node>& getNodes() const { return _nodes; }
+
+    // Only implemented for the octree types whose traversal uses the object
+    // arrays; must be called after the octree is created.
+    void buildObjectArrays();
 
  private:
+    // Object positions and limiting factors as a structure of arrays, in
+    // object order. The traversal can test these without touching the
+    // objects themselves, which are much larger or only reachable through
+    // a pointer.
+    struct ObjectArrays
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> limitingFactor;
+        std::vector<float> radius;
+    };
+
     static const PREC SQRT3;
 
+    StaticOctree(std::vector<Node>&& nodes, OBJ* objects);
+
+    using FrustumCuller = celestia::engine::OctreeFrustumCuller<PREC>;
+
+    // The objects of a node, for the object processing methods of TRAITS
+    OctreeNodeObjects<OBJ, PREC> getNodeObjects(const Node& node) const;
+
+    // processVisibleNode is only called for nodes which intersect the view
+    // frustum, with the node's minimum distance from the observer and the
+    // faintest absolute magnitude visible at that distance.
+    // If deferredChildren is not null, the children which need to be
+    // visited are appended to it instead of being processed.
+    template <class PROCESSOR>
+    void processVisibleNode(std::uint32_t                     nodeIndex,
+                            PROCESSOR&                        processor,
+                            const FrustumCuller&              culler,
+                            PREC                              scale,
+                            PREC                              minDistance,
+                            PREC                              dimmest,
+                            std::vector<Subtree>*             deferredChildren = nullptr) const;
+
+    // Cull the children of a node as a batch and process the visible ones
+    template <class PROCESSOR>
+    void processVisibleChildren(const Node&                 node,
+                                PROCESSOR&                  processor,
+                                const FrustumCuller&        culler,
+                                PREC                        scale,
+                                PREC                        dimmest,
+                                std::vector<Subtree>*       deferredChildren) const;
+
+    bool getRootSubtree(const FrustumCuller& culler, PREC scale, Subtree& root) const;
+
+    template <class PROCESSOR>
+    void processCloseNode(std::uint32_t                      nodeIndex,
+                          PROCESSOR&                         processor,
+                          const PointType&                   obsPosition,
+                          PREC                               boundingRadius,
+                          PREC                               scale) const;
+
+    template <class PROCESSOR>
+    void processNearestNode(std::uint32_t    nodeIndex,
+                            PROCESSOR&       processor,
+                            const PointType& obsPosition,
+                            PREC             scale) const;
+
+    void computeStatistics(std::uint32_t nodeIndex,
+                           std::vector<OctreeLevelStatistics>& stats,
+                           unsigned int level) const;
+
  private:
-    StaticOctree** _children;
-    Eigen::Matrix<PREC, 3, 1>   cellCenterPos;
-    float          exclusionFactor;
-    OBJ*           _firstObject;
-    unsigned int   nObjects;
+    std::vector<Node> _nodes;
+    OBJ*              _objects;
+    ObjectArrays      _objectArrays;
 };
 
 
@@ -170,13 +361,13 @@ enum
     ZPos = 4,
 };
 
-// The SPLIT_THRESHOLD is the number of objects a node must contain before its
-// children are generated. Increasing this number will decrease the number of
-// octree nodes in the tree, which will use less memory but make culling less
-// efficient.
-template <class OBJ, class PREC>
-inline DynamicOctree<OBJ, PREC>::DynamicOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
-                                               const float                      exclusionFactor):
+// The SplitThreshold of the traits is the number of objects a node must
+// contain before its children are generated. Increasing this number will
+// decrease the number of octree nodes in the tree, which will use less memory
+// but make culling less efficient.
+template <class OBJ, class PREC, class TRAITS>
+inline DynamicOctree<OBJ, PREC, TRAITS>::DynamicOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
+                                                       const float                      exclusionFactor):
     _children      (nullptr),
     cellCenterPos  (cellCenterPos),
     exclusionFactor(exclusionFactor),
@@ -185,8 +376,8 @@ inline DynamicOctree<OBJ, PREC>::DynamicOctree(const Eigen::Matrix<PREC, 3, 1>&
 }
 
 
-template <class OBJ, class PREC>
-inline DynamicOctree<OBJ, PREC>::~DynamicOctree()
+template <class OBJ, class PREC, class TRAITS>
+inline DynamicOctree<OBJ, PREC, TRAITS>::~DynamicOctree()
 {
     if (_children != nullptr)
     {
@@ -201,17 +392,17 @@ inline DynamicOctree<OBJ, PREC>::~DynamicOctree()
 }
 
 
-template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC scale)
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::insertObject(const OBJ& obj, const PREC scale)
 {
     // If the object can't be placed into this node's children, then put it here:
-    if (limitingFactorPredicate(obj, exclusionFactor) || straddlingPredicate(cellCenterPos, obj, exclusionFactor) )
+    if (TRAITS::limitingFactorPredicate(obj, exclusionFactor) || TRAITS::straddlingPredicate(cellCenterPos, obj))
         add(obj);
     else
     {
         // If we haven't allocated child nodes yet, try to fit
         // the object in this node, even though it could be put
-        // in a child. Only if there are more than SPLIT_THRESHOLD
+        // in a child. Only if there are more than SplitThreshold
         // objects in the node will we attempt to place the
         // object into a child node.  This is done in order
         // to avoid having the octree degenerate into one object
@@ -219,7 +410,7 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
         if (_children == nullptr)
         {
             // Make sure that there's enough room left in this node
-            if (_objects != nullptr && _objects->size() >= DynamicOctree<OBJ, PREC>::SPLIT_THRESHOLD)
+            if (_objects != nullptr && _objects->size() >= TRAITS::SplitThreshold)
                 split(scale * 0.5f);
             add(obj);
         }
@@ -231,8 +422,8 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
 }
 
 
-template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::add(const OBJ& obj)
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::add(const OBJ& obj)
 {
     if (_objects == nullptr)
         _objects = new ObjectList;
@@ -241,8 +432,8 @@ inline void DynamicOctree<OBJ, PREC>::add(const OBJ& obj)
 }
 
 
-template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::split(const PREC scale)
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::createChildren(const PREC scale)
 {
     _children = new DynamicOctree*[8];
 
@@ -254,24 +445,119 @@ inline void DynamicOctree<OBJ, PREC>::split(const PREC scale)
                                                ((i & YPos) != 0) ? scale : -scale,
                                                ((i & ZPos) != 0) ? scale : -scale);
 
-#if 0
-        centerPos.x     += ((i & XPos) != 0) ? scale : -scale;
-        centerPos.y     += ((i & YPos) != 0) ? scale : -scale;
-        centerPos.z     += ((i & ZPos) != 0) ? scale : -scale;
-#endif
-
         _children[i] = new DynamicOctree(centerPos,
-                                         decayFunction(exclusionFactor));
+                                         TRAITS::decayFunction(exclusionFactor));
     }
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::split(const PREC scale)
+{
+    createChildren(scale);
     sortIntoChildNodes();
 }
 
 
+template <class OBJ, class PREC, class TRAITS>
+inline DynamicOctree<OBJ, PREC, TRAITS>* DynamicOctree<OBJ, PREC, TRAITS>::getChild(const OBJ& obj,
+                                                                                    const Eigen::Matrix<PREC, 3, 1>& cellCenterPos)
+{
+    return _children[getChildIndex(obj, cellCenterPos)];
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline int DynamicOctree<OBJ, PREC, TRAITS>::getChildIndex(const OBJ& obj,
+                                                           const Eigen::Matrix<PREC, 3, 1>& cellCenterPos)
+{
+    PointType objPos = TRAITS::getPosition(obj);
+
+    int child = 0;
+    child     |= objPos.x() < cellCenterPos.x() ? 0 : XPos;
+    child     |= objPos.y() < cellCenterPos.y() ? 0 : YPos;
+    child     |= objPos.z() < cellCenterPos.z() ? 0 : ZPos;
+
+    return child;
+}
+
+
+// Insert a list of objects into an empty node. The resulting tree is
+// identical to the one built by calling insertObject for each object in
+// order: serial insertion splits a node as soon as an object which doesn't
+// have to stay in the node arrives while the node already holds
+// SplitThreshold objects; that object itself is still added to the node.
+// After the split, each child receives the other objects
+// belonging to it in their original order, no matter whether they were
+// inserted before or after the split. Hence the children can be built
+// independently of each other; the subtrees of the top parallelLevels
+// levels are built concurrently.
+template <class OBJ, class PREC, class TRAITS>
+void DynamicOctree<OBJ, PREC, TRAITS>::insertObjects(ObjectList&& objects, const PREC scale, unsigned int parallelLevels)
+{
+    assert(_objects == nullptr && _children == nullptr);
+
+    ObjectList keptObjects;
+    std::array<ObjectList, 8> childObjects;
+    bool needsSplit = false;
+    for (std::size_t i = 0; i < objects.size(); ++i)
+    {
+        const OBJ& obj = *objects[i];
+        if (TRAITS::limitingFactorPredicate(obj, exclusionFactor) || TRAITS::straddlingPredicate(cellCenterPos, obj))
+        {
+            keptObjects.push_back(&obj);
+        }
+        else if (!needsSplit && i >= TRAITS::SplitThreshold)
+        {
+            // insertObject keeps the object which triggers the split in
+            // this node
+            needsSplit = true;
+            keptObjects.push_back(&obj);
+        }
+        else
+        {
+            childObjects[getChildIndex(obj, cellCenterPos)].push_back(&obj);
+        }
+    }
+
+    if (!needsSplit)
+    {
+        if (!objects.empty())
+            _objects = new ObjectList(std::move(objects));
+        return;
+    }
+
+    objects = ObjectList();
+    _objects = new ObjectList(std::move(keptObjects));
+    createChildren(scale * (PREC) 0.5);
+
+    if (parallelLevels == 0)
+    {
+        for (int i = 0; i < 8; ++i)
+            _children[i]->insertObjects(std::move(childObjects[i]), scale * (PREC) 0.5);
+        return;
+    }
+
+    celestia::util::TaskGroup group;
+    for (int i = 0; i < 8; ++i)
+    {
+        group.run([this, i, scale, parallelLevels, &childObjects]
+                  {
+                      _children[i]->insertObjects(std::move(childObjects[i]),
+                                                  scale * (PREC) 0.5,
+                                                  parallelLevels - 1);
+                  });
+    }
+
+    group.wait();
+}
+
+
 // Sort this node's objects into objects that can remain here,
 // and objects that should be placed into one of the eight
 // child nodes.
-template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::sortIntoChildNodes()
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::sortIntoChildNodes()
 {
     unsigned int nKeptInParent = 0;
 
@@ -279,8 +565,8 @@ inline void DynamicOctree<OBJ, PREC>::sortIntoChildNodes()
     {
         const OBJ& obj    = *(*_objects)[i];
 
-        if (limitingFactorPredicate(obj, exclusionFactor) ||
-            straddlingPredicate(cellCenterPos, obj, exclusionFactor) )
+        if (TRAITS::limitingFactorPredicate(obj, exclusionFactor) ||
+            TRAITS::straddlingPredicate(cellCenterPos, obj))
         {
             (*_objects)[nKeptInParent++] = (*_objects)[i];
         }
@@ -294,89 +580,399 @@ inline void DynamicOctree<OBJ, PREC>::sortIntoChildNodes()
 }
 
 
-template <class OBJ, class PREC>
-inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _staticNode, OBJ*& _sortedObjects)
+// Convert the tree into a StaticOctree, copying the objects into
+// _sortedObjects in breadth-first order of the nodes.
+template <class OBJ, class PREC, class TRAITS>
+inline void DynamicOctree<OBJ, PREC, TRAITS>::rebuildAndSort(StaticOctree<OBJ, PREC, TRAITS>*& _staticNode, OBJ*& _sortedObjects)
 {
-    OBJ* _firstObject = _sortedObjects;
+    using StaticNode = typename StaticOctree<OBJ, PREC, TRAITS>::Node;
+
+    OBJ* firstObject = _sortedObjects;
+    std::vector<const DynamicOctree*> queue{ this };
+    std::vector<StaticNode> nodes;
+
+    // Children of a node are appended to the queue together, so the queue
+    // index of a node equals its index in the node array.
+    for (std::size_t i = 0; i < queue.size(); ++i)
+    {
+        const DynamicOctree* node = queue[i];
+        StaticNode& staticNode = nodes.emplace_back();
+        staticNode.cellCenterPos   = node->cellCenterPos;
+        staticNode.exclusionFactor = node->exclusionFactor;
+        staticNode.firstObject     = static_cast<std::uint32_t>(_sortedObjects - firstObject);
+        staticNode.firstChild      = StaticOctree<OBJ, PREC, TRAITS>::NoChildren;
+
+        if (node->_objects != nullptr)
+        {
+            for (const OBJ* obj : *node->_objects)
+                *_sortedObjects++ = *obj;
+        }
 
-    if (_objects != nullptr)
-        for (typename ObjectList::const_iterator iter = _objects->begin(); iter != _objects->end(); ++iter)
+        staticNode.nObjects = static_cast<std::uint32_t>(_sortedObjects - firstObject) - staticNode.firstObject;
+
+        if (node->_children != nullptr)
         {
-            *_sortedObjects++ = **iter;
+            staticNode.firstChild = static_cast<std::uint32_t>(queue.size());
+            for (int j = 0; j < 8; ++j)
+                queue.push_back(node->_children[j]);
         }
+    }
 
-    unsigned int nObjects  = (unsigned int) (_sortedObjects - _firstObject);
-    _staticNode            = new StaticOctree<OBJ, PREC>(cellCenterPos, exclusionFactor, _firstObject, nObjects);
+    _staticNode = new StaticOctree<OBJ, PREC, TRAITS>(std::move(nodes), firstObject);
+}
 
-    if (_children != nullptr)
+
+//MS VC++ wants this to be placed here:
+template <class OBJ, class PREC, class TRAITS>
+const PREC StaticOctree<OBJ, PREC, TRAITS>::SQRT3 = (PREC) 1.732050807568877;
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline StaticOctree<OBJ, PREC, TRAITS>::StaticOctree(std::vector<Node>&& nodes, OBJ* objects) :
+    _nodes  (std::move(nodes)),
+    _objects(objects)
+{
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+StaticOctree<OBJ, PREC, TRAITS>* StaticOctree<OBJ, PREC, TRAITS>::create(std::vector<Node>&& nodes,
+                                                                OBJ* objects,
+                                                                std::uint32_t nObjects)
+{
+    // Verify the layout produced by DynamicOctree::rebuildAndSort: node
+    // objects follow each other without gaps, and the child groups follow
+    // each other in the order of their parents.
+    if (nodes.empty())
+        return nullptr;
+
+    std::uint32_t nextObject = 0;
+    std::size_t nextChild = 1;
+    for (std::size_t i = 0; i < nodes.size(); ++i)
     {
-        _staticNode->_children    = new StaticOctree<OBJ, PREC>*[8];
+        const Node& node = nodes[i];
+        if (node.firstObject != nextObject || node.nObjects > nObjects - nextObject)
+            return nullptr;
+        nextObject += node.nObjects;
 
-        for (int i=0; i<8; ++i)
-            _children[i]->rebuildAndSort(_staticNode->_children[i], _sortedObjects);
+        if (node.firstChild != NoChildren)
+        {
+            if (node.firstChild != nextChild || nodes.size() - nextChild < 8)
+                return nullptr;
+            nextChild += 8;
+        }
     }
+
+    if (nextObject != nObjects || nextChild != nodes.size())
+        return nullptr;
+
+    return new StaticOctree(std::move(nodes), objects);
 }
 
 
-//MS VC++ wants this to be placed here:
-template <class OBJ, class PREC>
-const PREC StaticOctree<OBJ, PREC>::SQRT3 = (PREC) 1.732050807568877;
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+inline void StaticOctree<OBJ, PREC, TRAITS>::processVisibleObjects(PROCESSOR&                        processor,
+                                                                   const PointType&                  obsPosition,
+                                                                   const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                                   float                             limitingFactor,
+                                                                   PREC                              scale) const
+{
+    FrustumCuller culler(frustumPlanes, obsPosition, limitingFactor);
+    Subtree root;
+    if (getRootSubtree(culler, scale, root))
+        processVisibleNode(0, processor, culler, root.scale, root.minDistance, root.dimmest);
+}
 
 
-template <class OBJ, class PREC>
-inline StaticOctree<OBJ, PREC>::StaticOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
-                                             const float         exclusionFactor,
-                                             OBJ*                _firstObject,
-                                             unsigned int        nObjects):
-    _children      (nullptr),
-    cellCenterPos  (cellCenterPos),
-    exclusionFactor(exclusionFactor),
-    _firstObject   (_firstObject),
-    nObjects       (nObjects)
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+inline void StaticOctree<OBJ, PREC, TRAITS>::processCloseObjects(PROCESSOR&                         processor,
+                                                                 const PointType&                   obsPosition,
+                                                                 PREC                               boundingRadius,
+                                                                 PREC                               scale) const
 {
+    processCloseNode(0, processor, obsPosition, boundingRadius, scale);
 }
 
 
-template <class OBJ, class PREC>
-inline StaticOctree<OBJ, PREC>::~StaticOctree()
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+std::vector<typename StaticOctree<OBJ, PREC, TRAITS>::Subtree>
+StaticOctree<OBJ, PREC, TRAITS>::processVisibleLevels(PROCESSOR&                        processor,
+                                                      const PointType&                  obsPosition,
+                                                      const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                      float                             limitingFactor,
+                                                      PREC                              scale,
+                                                      std::size_t                       minSubtrees,
+                                                      unsigned int                      maxLevels) const
 {
-    if (_children != nullptr)
+    FrustumCuller culler(frustumPlanes, obsPosition, limitingFactor);
+    std::vector<Subtree> subtrees;
+    Subtree root;
+    if (getRootSubtree(culler, scale, root))
+        subtrees.push_back(root);
+
+    std::vector<Subtree> nextLevel;
+    for (unsigned int level = 0; level < maxLevels && !subtrees.empty() && subtrees.size() < minSubtrees; ++level)
     {
-        for (int i = 0; i < 8; ++i)
-            delete _children[i];
+        nextLevel.clear();
+        for (const Subtree& subtree : subtrees)
+        {
+            processVisibleNode(subtree.nodeIndex, processor, culler, subtree.scale,
+                               subtree.minDistance, subtree.dimmest, &nextLevel);
+        }
 
-        delete[] _children;
+        subtrees.swap(nextLevel);
     }
+
+    return subtrees;
 }
 
 
-template <class OBJ, class PREC>
-inline int StaticOctree<OBJ, PREC>::countChildren() const
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+inline void StaticOctree<OBJ, PREC, TRAITS>::processVisibleSubtree(const Subtree&                    subtree,
+                                                                   PROCESSOR&                        processor,
+                                                                   const PointType&                  obsPosition,
+                                                                   const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                                   float                             limitingFactor) const
 {
-    int count    = 0;
+    FrustumCuller culler(frustumPlanes, obsPosition, limitingFactor);
+    processVisibleNode(subtree.nodeIndex, processor, culler, subtree.scale,
+                       subtree.minDistance, subtree.dimmest);
+}
 
-    for (int i = 0; i < 8; ++i)
-        count    += _children != nullptr ? 1 + _children[i]->countChildren() : 0;
 
-    return count;
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+bool StaticOctree<OBJ, PREC, TRAITS>::processVisibleObjectsUntil(Traversal&                            traversal,
+                                                                 PROCESSOR&                            processor,
+                                                                 const PointType&                      obsPosition,
+                                                                 const Eigen::Hyperplane<PREC, 3>*     frustumPlanes,
+                                                                 float                                 limitingFactor,
+                                                                 PREC                                  scale,
+                                                                 std::chrono::steady_clock::time_point deadline) const
+{
+    // Reading the clock costs about as much as visiting a sparse node
+    constexpr unsigned int nodesPerClockCheck = 32;
+
+    FrustumCuller culler(frustumPlanes, obsPosition, limitingFactor);
+    if (!traversal.started)
+    {
+        traversal.reset();
+        traversal.started = true;
+        Subtree root;
+        if (getRootSubtree(culler, scale, root))
+            traversal.queue.push_back(root);
+    }
+
+    for (unsigned int visited = 1; traversal.next < traversal.queue.size(); ++visited)
+    {
+        if (visited % nodesPerClockCheck == 0 && std::chrono::steady_clock::now() > deadline)
+            return false;
+
+        // The children are appended to the queue, which may reallocate it
+        Subtree subtree = traversal.queue[traversal.next++];
+        processVisibleNode(subtree.nodeIndex, processor, culler, subtree.scale,
+                           subtree.minDistance, subtree.dimmest, &traversal.queue);
+    }
+
+    return true;
 }
 
 
-template <class OBJ, class PREC>
-inline int StaticOctree<OBJ, PREC>::countObjects() const
+template <class OBJ, class PREC, class TRAITS>
+bool StaticOctree<OBJ, PREC, TRAITS>::getRootSubtree(const FrustumCuller& culler, PREC scale, Subtree& root) const
 {
-    int count    = nObjects;
+    const PointType& center = _nodes[0].cellCenterPos;
+    if (!culler.isVisible(center, scale))
+        return false;
+
+    // Compute the distance to node; this is equal to the distance to
+    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
+    PREC minDistance = (culler.obsPosition() - center).norm() - scale * SQRT3;
+    root = Subtree{ 0, scale, minDistance, culler.dimmestVisible(minDistance) };
+    return true;
+}
 
-    if (_children != nullptr)
-        for (int i = 0; i < 8; ++i)
-            count    += _children[i]->countObjects();
 
-    return count;
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+void StaticOctree<OBJ, PREC, TRAITS>::processVisibleChildren(const Node&                 node,
+                                                             PROCESSOR&                  processor,
+                                                             const FrustumCuller&        culler,
+                                                             PREC                        scale,
+                                                             PREC                        dimmest,
+                                                             std::vector<Subtree>*       deferredChildren) const
+{
+    // See if any of the objects in child nodes are potentially included
+    // that we need to recurse deeper. No object in the children is brighter
+    // than the exclusion factor, so this is equivalent to comparing the
+    // apparent magnitude of the exclusion factor against the limit.
+    if (node.firstChild == NoChildren || static_cast<PREC>(node.exclusionFactor) > dimmest)
+        return;
+
+    PREC childScale = scale * (PREC) 0.5;
+    typename FrustumCuller::ChildArray minDistances;
+    unsigned int visible = culler.visibleChildren(node.cellCenterPos, childScale, minDistances);
+    if (visible == 0)
+        return;
+
+    typename FrustumCuller::ChildArray childDimmest = culler.dimmestVisible(minDistances);
+    for (std::uint32_t i = 0; i < 8; ++i)
+    {
+        if ((visible & (1u << i)) == 0)
+            continue;
+
+        if (deferredChildren != nullptr)
+        {
+            deferredChildren->push_back(Subtree{ node.firstChild + i, childScale,
+                                                 minDistances[i], childDimmest[i] });
+        }
+        else
+        {
+            processVisibleNode(node.firstChild + i, processor, culler, childScale,
+                               minDistances[i], childDimmest[i]);
+        }
+    }
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline OctreeNodeObjects<OBJ, PREC> StaticOctree<OBJ, PREC, TRAITS>::getNodeObjects(const Node& node) const
+{
+    OctreeNodeObjects<OBJ, PREC> objects{ _objects + node.firstObject, nullptr, nullptr, nullptr, nullptr, nullptr,
+                                          &node.cellCenterPos, node.nObjects };
+    if (!_objectArrays.x.empty())
+    {
+        objects.x              = _objectArrays.x.data() + node.firstObject;
+        objects.y              = _objectArrays.y.data() + node.firstObject;
+        objects.z              = _objectArrays.z.data() + node.firstObject;
+        objects.limitingFactor = _objectArrays.limitingFactor.data() + node.firstObject;
+        if (!_objectArrays.radius.empty())
+            objects.radius     = _objectArrays.radius.data() + node.firstObject;
+    }
+
+    return objects;
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+inline void StaticOctree<OBJ, PREC, TRAITS>::processVisibleNode(std::uint32_t         nodeIndex,
+                                                                PROCESSOR&            processor,
+                                                                const FrustumCuller&  culler,
+                                                                PREC                  scale,
+                                                                PREC                  /*minDistance*/,
+                                                                PREC                  dimmest,
+                                                                std::vector<Subtree>* deferredChildren) const
+{
+    const Node& node = _nodes[nodeIndex];
+    TRAITS::processVisibleObjects(getNodeObjects(node), processor, culler, dimmest);
+    processVisibleChildren(node, processor, culler, scale, dimmest, deferredChildren);
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+void StaticOctree<OBJ, PREC, TRAITS>::processCloseNode(std::uint32_t    nodeIndex,
+                                                       PROCESSOR&       processor,
+                                                       const PointType& obsPosition,
+                                                       PREC             boundingRadius,
+                                                       PREC             scale) const
+{
+    const Node& node = _nodes[nodeIndex];
+
+    // Compute the distance to node; this is equal to the distance to
+    // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
+    PREC nodeDistance = (obsPosition - node.cellCenterPos).norm() - scale * SQRT3;
+    if (nodeDistance > boundingRadius)
+        return;
+
+    // At this point, we've determined that the cellCenterPos of the node is
+    // close enough that we must check individual objects for proximity.
+    TRAITS::processCloseObjects(getNodeObjects(node), processor, obsPosition, boundingRadius);
+
+    // Recurse into the child nodes
+    if (node.firstChild != NoChildren)
+    {
+        for (std::uint32_t i = 0; i < 8; ++i)
+        {
+            processCloseNode(node.firstChild + i,
+                             processor,
+                             obsPosition,
+                             boundingRadius,
+                             scale * (PREC) 0.5);
+        }
+    }
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+inline void StaticOctree<OBJ, PREC, TRAITS>::processNearestObjects(PROCESSOR&       processor,
+                                                                   const PointType& obsPosition,
+                                                                   PREC             scale) const
+{
+    processNearestNode(0, processor, obsPosition, scale);
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+template <class PROCESSOR>
+void StaticOctree<OBJ, PREC, TRAITS>::processNearestNode(std::uint32_t    nodeIndex,
+                                                         PROCESSOR&       processor,
+                                                         const PointType& obsPosition,
+                                                         PREC             scale) const
+{
+    const Node& node = _nodes[nodeIndex];
+    PREC nodeDistance = (obsPosition - node.cellCenterPos).norm() - scale * SQRT3;
+    if (nodeDistance > processor.searchRadius())
+        return;
+
+    TRAITS::processCloseObjects(getNodeObjects(node), processor, obsPosition, processor.searchRadius());
+    if (node.firstChild == NoChildren)
+        return;
+
+    // The children are the same size, so the nearest centers are the
+    // nearest nodes
+    std::array<std::pair<PREC, std::uint32_t>, 8> children;
+    for (std::uint32_t i = 0; i < 8; ++i)
+        children[i] = { (obsPosition - _nodes[node.firstChild + i].cellCenterPos).squaredNorm(), node.firstChild + i };
+    std::sort(children.begin(), children.end());
+
+    for (const auto& child : children)
+        processNearestNode(child.second, processor, obsPosition, scale * (PREC) 0.5);
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline int StaticOctree<OBJ, PREC, TRAITS>::countChildren() const
+{
+    return static_cast<int>(_nodes.size()) - 1;
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+inline int StaticOctree<OBJ, PREC, TRAITS>::countObjects() const
+{
+    const Node& last = _nodes.back();
+    return static_cast<int>(last.firstObject + last.nObjects);
 }
 
 
-template <class OBJ, class PREC>
-void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level)
+template <class OBJ, class PREC, class TRAITS>
+void StaticOctree<OBJ, PREC, TRAITS>::computeStatistics(std::vector<OctreeLevelStatistics>& stats) const
+{
+    computeStatistics(0, stats, 0);
+}
+
+
+template <class OBJ, class PREC, class TRAITS>
+void StaticOctree<OBJ, PREC, TRAITS>::computeStatistics(std::uint32_t nodeIndex,
+                                                        std::vector<OctreeLevelStatistics>& stats,
+                                                        unsigned int level) const
 {
     if (level >= stats.size())
     {
@@ -390,13 +986,14 @@ void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistic
         }
     }
 
+    const Node& node = _nodes[nodeIndex];
     stats[level].nodeCount++;
-    stats[level].objectCount += nObjects;
+    stats[level].objectCount += node.nObjects;
     stats[level].size = 0.0;
 
-    if (_children != nullptr)
+    if (node.firstChild != NoChildren)
     {
-        for (int i = 0; i < 8; i++)
-            _children[i]->computeStatistics(stats, level + 1);
+        for (std::uint32_t i = 0; i < 8; i++)
+            computeStatistics(node.firstChild + i, stats, level + 1);
     }
 }
@@ -0,0 +1,199 @@
+// octreeculling.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Batched visibility tests for the children of an octree node.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celastro/astro.h>
+
+namespace celestia::engine
+{
+
+/*! Tests octree cells against the five planes of an infinite view frustum
+ *  and against a limiting magnitude.
+ *
+ *  The eight children of a node are tested together: the child centers are
+ *  offsets of the parent center, so the signed distances of all children
+ *  from a plane are the parent's distance plus a per-plane constant scaled
+ *  by the child size. The constants are computed once per traversal, and
+ *  the per-node work is a few 8-wide array operations which Eigen maps to
+ *  the available SIMD instructions.
+ */
+template<typename PREC>
+class OctreeFrustumCuller
+{
+public:
+    using PointType = Eigen::Matrix<PREC, 3, 1>;
+    using ChildArray = Eigen::Array<PREC, 8, 1>;
+
+    OctreeFrustumCuller(const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                        const PointType& obsPosition,
+                        float limitingFactor);
+
+    // Test a single cell with center position and half-size scale
+    bool isVisible(const PointType& center, PREC scale) const;
+
+    // Test the children of the cell centered on center; childScale is the
+    // half-size of the children. Returns a mask of the visible children and
+    // stores the minimum distance from the observer to each child cell.
+    unsigned int visibleChildren(const PointType& center,
+                                 PREC childScale,
+                                 ChildArray& minDistances) const;
+
+    // The faintest absolute magnitude which may be visible from a distance.
+    // A cell can be skipped entirely when its brightest object is fainter.
+    PREC dimmestVisible(PREC minDistance) const;
+
+    // Vectorized version of dimmestVisible for the children of a node
+    ChildArray dimmestVisible(const ChildArray& minDistances) const;
+
+    const PointType& obsPosition() const { return m_obsPosition; }
+    PREC limitingFactor() const { return m_limitingFactor; }
+
+private:
+    // Signs of the child offsets along each axis; bit i of the child index
+    // selects the positive half along axis i, as in DynamicOctree.
+    ChildArray m_signs[3];
+    Eigen::Matrix<PREC, 5, 3> m_normals;
+    Eigen::Array<PREC, 5, 1> m_offsets;
+    // Sum of the absolute values of the plane normals, for the projected
+    // half-extent of a cube
+    Eigen::Array<PREC, 5, 1> m_extents;
+    // Projection of each child's offset onto the plane normal plus the
+    // projected half-extent, per unit of child half-size
+    Eigen::Array<PREC, 8, 5> m_childBounds;
+    PointType m_obsPosition;
+    PREC m_limitingFactor;
+};
+
+
+template<typename PREC>
+OctreeFrustumCuller<PREC>::OctreeFrustumCuller(const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                               const PointType& obsPosition,
+                                               float limitingFactor) :
+    m_obsPosition(obsPosition),
+    m_limitingFactor(static_cast<PREC>(limitingFactor))
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int i = 0; i < 8; ++i)
+            m_signs[axis][i] = (i & (1 << axis)) != 0 ? PREC(1) : PREC(-1);
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        const auto& normal = frustumPlanes[i].normal();
+        m_normals.row(i) = normal.transpose();
+        m_offsets[i] = frustumPlanes[i].offset();
+        m_extents[i] = normal.cwiseAbs().sum();
+        m_childBounds.col(i) = m_signs[0] * normal.x() +
+                               m_signs[1] * normal.y() +
+                               m_signs[2] * normal.z() +
+                               m_extents[i];
+    }
+}
+
+
+template<typename PREC>
+bool
+OctreeFrustumCuller<PREC>::isVisible(const PointType& center, PREC scale) const
+{
+    Eigen::Array<PREC, 5, 1> distances = (m_normals * center).array() + m_offsets;
+    return ((distances + scale * m_extents) >= PREC(0)).all();
+}
+
+
+template<typename PREC>
+unsigned int
+OctreeFrustumCuller<PREC>::visibleChildren(const PointType& center,
+                                           PREC childScale,
+                                           ChildArray& minDistances) const
+{
+    Eigen::Array<PREC, 5, 1> distances = (m_normals * center).array() + m_offsets;
+
+    // A child is outside the frustum if it lies entirely behind any plane
+    ChildArray nearest = m_childBounds.col(0) * childScale + distances[0];
+    for (int i = 1; i < 5; ++i)
+        nearest = nearest.min(m_childBounds.col(i) * childScale + distances[i]);
+
+    unsigned int mask = 0;
+    for (int i = 0; i < 8; ++i)
+        mask |= nearest[i] >= PREC(0) ? (1u << i) : 0u;
+    if (mask == 0)
+        return 0;
+
+    PointType rel = m_obsPosition - center;
+    ChildArray dx = rel.x() - m_signs[0] * childScale;
+    ChildArray dy = rel.y() - m_signs[1] * childScale;
+    ChildArray dz = rel.z() - m_signs[2] * childScale;
+    minDistances = (dx.square() + dy.square() + dz.square()).sqrt() -
+                   childScale * static_cast<PREC>(std::sqrt(3.0));
+
+    return mask;
+}
+
+
+template<typename PREC>
+PREC
+OctreeFrustumCuller<PREC>::dimmestVisible(PREC minDistance) const
+{
+    return minDistance > PREC(0)
+        ? astro::appToAbsMag(m_limitingFactor, minDistance)
+        : PREC(1000);
+}
+
+
+template<typename PREC>
+typename OctreeFrustumCuller<PREC>::ChildArray
+OctreeFrustumCuller<PREC>::dimmestVisible(const ChildArray& minDistances) const
+{
+    // appToAbsMag using the natural logarithm, which is vectorized
+    constexpr PREC scale = PREC(5) / PREC(2.302585092994046);
+    ChildArray safeDistances = minDistances.max(PREC(1.0e-30));
+    ChildArray dimmest = m_limitingFactor + PREC(5) -
+                         scale * (safeDistances / astro::LY_PER_PARSEC<PREC>).log();
+    return (minDistances > PREC(0)).select(dimmest, ChildArray::Constant(PREC(1000)));
+}
+
+
+// Compute the bounding planes of an infinite view frustum
+template<typename PREC>
+void
+computeFrustumPlanes(std::array<Eigen::Hyperplane<PREC, 3>, 5>& frustumPlanes,
+                     const Eigen::Matrix<PREC, 3, 1>& position,
+                     const Eigen::Quaternion<PREC>& orientation,
+                     PREC fovY,
+                     PREC aspectRatio)
+{
+    using PointType = Eigen::Matrix<PREC, 3, 1>;
+
+    PointType planeNormals[5];
+    Eigen::Matrix<PREC, 3, 3> rot = orientation.toRotationMatrix();
+    PREC h = std::tan(fovY / 2);
+    PREC w = h * aspectRatio;
+    planeNormals[0] = PointType(PREC(0), PREC(1), -h);
+    planeNormals[1] = PointType(PREC(0), PREC(-1), -h);
+    planeNormals[2] = PointType(PREC(1), PREC(0), -w);
+    planeNormals[3] = PointType(PREC(-1), PREC(0), -w);
+    planeNormals[4] = PointType(PREC(0), PREC(0), PREC(-1));
+    for (int i = 0; i < 5; i++)
+    {
+        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
+        frustumPlanes[i] = Eigen::Hyperplane<PREC, 3>(planeNormals[i], position);
+    }
+}
+
+} // end namespace celestia::engine
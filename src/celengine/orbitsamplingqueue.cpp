@@ -0,0 +1,143 @@
+// orbitsamplingqueue.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "orbitsamplingqueue.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <celephem/orbit.h>
+#include "orbitsampler.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+struct Request
+{
+    const ephem::Orbit* orbit;
+    double startTime;
+    double endTime;
+};
+
+} // end unnamed namespace
+
+
+struct OrbitSamplingQueue::State
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    // Signaled when a worker has finished sampling an orbit
+    std::condition_variable finished;
+    std::deque<Request> requests;
+    std::deque<Result> results;
+    std::vector<std::thread> workers;
+    unsigned int running{ 0 };
+    bool quit{ false };
+
+    void workerLoop()
+    {
+        std::unique_lock lock(mutex);
+        for (;;)
+        {
+            condition.wait(lock, [this] { return quit || !requests.empty(); });
+            if (quit)
+                return;
+
+            Request request = requests.front();
+            requests.pop_front();
+            ++running;
+
+            lock.unlock();
+            OrbitSampler sampler;
+            request.orbit->sample(request.startTime, request.endTime, sampler);
+            lock.lock();
+
+            results.push_back({ request.orbit, std::move(sampler.samples) });
+            --running;
+            finished.notify_all();
+        }
+    }
+};
+
+
+OrbitSamplingQueue::OrbitSamplingQueue(unsigned int nThreads) :
+    state(std::make_unique<State>())
+{
+    for (unsigned int i = 0; i < nThreads; ++i)
+        state->workers.emplace_back(&State::workerLoop, state.get());
+}
+
+
+OrbitSamplingQueue::~OrbitSamplingQueue()
+{
+    {
+        std::scoped_lock lock(state->mutex);
+        state->quit = true;
+    }
+    state->condition.notify_all();
+    for (auto& worker : state->workers)
+        worker.join();
+}
+
+
+void
+OrbitSamplingQueue::request(const ephem::Orbit* orbit, double startTime, double endTime)
+{
+    if (!pending.insert(orbit).second)
+        return;
+
+    {
+        std::scoped_lock lock(state->mutex);
+        state->requests.push_back({ orbit, startTime, endTime });
+    }
+    state->condition.notify_one();
+}
+
+
+bool
+OrbitSamplingQueue::isPending(const ephem::Orbit* orbit) const
+{
+    return pending.find(orbit) != pending.end();
+}
+
+
+bool
+OrbitSamplingQueue::takeResult(Result& result)
+{
+    {
+        std::scoped_lock lock(state->mutex);
+        if (state->results.empty())
+            return false;
+
+        result = std::move(state->results.front());
+        state->results.pop_front();
+    }
+
+    pending.erase(result.orbit);
+    return true;
+}
+
+
+void
+OrbitSamplingQueue::clear()
+{
+    std::unique_lock lock(state->mutex);
+    state->requests.clear();
+    state->finished.wait(lock, [this] { return state->running == 0; });
+    state->results.clear();
+    pending.clear();
+}
+
+}
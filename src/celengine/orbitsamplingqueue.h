@@ -0,0 +1,65 @@
+// orbitsamplingqueue.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "curveplot.h"
+
+namespace celestia::ephem
+{
+class Orbit;
+}
+
+namespace celestia::engine
+{
+
+// Samples orbit paths on worker threads. Requests and results are handled
+// by the rendering thread, which adds the finished samples to its paths.
+class OrbitSamplingQueue
+{
+public:
+    struct Result
+    {
+        const ephem::Orbit* orbit{ nullptr };
+        std::vector<CurvePlotSample> samples;
+    };
+
+    explicit OrbitSamplingQueue(unsigned int nThreads);
+    ~OrbitSamplingQueue();
+
+    OrbitSamplingQueue(const OrbitSamplingQueue&) = delete;
+    OrbitSamplingQueue& operator=(const OrbitSamplingQueue&) = delete;
+
+    // Sample the orbit between startTime and endTime, unless it is pending
+    // already. The orbit must be thread-safe, and must not be destroyed
+    // before its result has been taken or the queue has been cleared.
+    void request(const ephem::Orbit* orbit, double startTime, double endTime);
+
+    bool isPending(const ephem::Orbit* orbit) const;
+
+    // Take a finished result, return false if there is none
+    bool takeResult(Result& result);
+
+    // Discard the requests and results, waiting for the orbits which are
+    // being sampled
+    void clear();
+
+private:
+    struct State;
+
+    std::unique_ptr<State> state;
+    // Orbits requested but not taken yet
+    std::set<const ephem::Orbit*> pending;
+};
+
+}
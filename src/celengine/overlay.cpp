@@ -8,7 +8,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <string_view>
 #include <Eigen/Core>
 #include <celmath/geomutil.h>
 #include <celutil/color.h>
@@ -22,6 +25,27 @@ using namespace Eigen;
 using namespace celestia::engine;
 namespace math = celestia::math;
 
+namespace
+{
+
+// Codes of the changes of state in the text of a block, which follow a
+// null character
+constexpr char AlignmentCode = 'a';
+constexpr char ColorCode = 'c';
+constexpr char FontCode = 'f';
+
+} // end unnamed namespace
+
+void OverlayTextBlock::clear()
+{
+    text.clear();
+    fonts.clear();
+    laidOutText.clear();
+    laidOutFonts.clear();
+    quads.clear();
+    endFont.reset();
+}
+
 Overlay::Overlay(Renderer& r) :
     layout(make_unique<TextLayout>(r.getScreenDpi())),
     renderer(r)
@@ -56,11 +80,24 @@ void Overlay::setWindowSize(int w, int h)
 
 void Overlay::setFont(const std::shared_ptr<TextureFont>& f)
 {
+    font = f;
     layout->setFont(f);
+
+    if (block != nullptr)
+    {
+        auto it = std::find(block->fonts.begin(), block->fonts.end(), f);
+        auto index = static_cast<char>(it - block->fonts.begin());
+        if (it == block->fonts.end())
+            block->fonts.push_back(f);
+        block->text.push_back('\0');
+        block->text.push_back(FontCode);
+        block->text.push_back(index);
+    }
 }
 
-void Overlay::setTextAlignment(TextLayout::HorizontalAlignment halign)
+void Overlay::setTextAlignment(TextLayout::HorizontalAlignment _halign)
 {
+    halign = _halign;
     layout->setHorizontalAlignment(halign);
 }
 
@@ -70,15 +107,111 @@ void Overlay::beginText()
     layout->begin(projection);
 }
 
+void Overlay::beginText(OverlayTextBlock& _block)
+{
+    savePos();
+    block = &_block;
+    block->text.clear();
+    block->fonts.clear();
+
+    // The text starts with all the state it depends on
+    block->text.push_back('\0');
+    block->text.push_back(AlignmentCode);
+    block->text.push_back(static_cast<char>(halign));
+    setFont(font);
+    recordColor(color);
+}
+
 void Overlay::endText()
 {
-    layout->end();
+    if (block == nullptr)
+    {
+        layout->end();
+        restorePos();
+        return;
+    }
+
+    OverlayTextBlock& b = *block;
+    block = nullptr;
+    if (b.text != b.laidOutText || b.fonts != b.laidOutFonts || !drawText(b))
+        layoutText(b);
     restorePos();
 }
 
+bool Overlay::drawText(const OverlayTextBlock& b)
+{
+    if (b.empty() || b.endFont == nullptr)
+        return false;
+
+    auto [x, y] = layout->getCurrentPosition();
+    b.endFont->bind();
+    b.endFont->setMVPMatrices(projection);
+    b.endFont->render(b.quads, x - b.origin.first, y - b.origin.second);
+    b.endFont->unbind();
+
+    setFont(b.endFont);
+    setColor(b.endColor);
+    return true;
+}
+
+void Overlay::layoutText(OverlayTextBlock& b)
+{
+    b.quads.clear();
+    b.origin = layout->getCurrentPosition();
+    TextureFont::capture(&b.quads);
+
+    bool began = false;
+    std::string_view text = b.text;
+    while (!text.empty())
+    {
+        auto pos = text.find('\0');
+        if (pos != 0)
+        {
+            if (!began)
+            {
+                layout->begin(projection);
+                began = true;
+            }
+            layout->render(text.substr(0, pos));
+            if (pos == std::string_view::npos)
+                break;
+        }
+
+        switch (text[pos + 1])
+        {
+        case AlignmentCode:
+            layout->setHorizontalAlignment(static_cast<TextLayout::HorizontalAlignment>(text[pos + 2]));
+            text = text.substr(pos + 3);
+            break;
+        case ColorCode:
+            layout->setColor(Color(static_cast<std::uint8_t>(text[pos + 2]),
+                                   static_cast<std::uint8_t>(text[pos + 3]),
+                                   static_cast<std::uint8_t>(text[pos + 4]),
+                                   static_cast<std::uint8_t>(text[pos + 5])));
+            text = text.substr(pos + 6);
+            break;
+        default: // FontCode
+            layout->setFont(b.fonts[static_cast<std::size_t>(text[pos + 2])]);
+            text = text.substr(pos + 3);
+            break;
+        }
+    }
+
+    layout->end();
+    TextureFont::capture(nullptr);
+
+    b.laidOutText = b.text;
+    b.laidOutFonts = b.fonts;
+    b.endColor = color;
+    b.endFont = font;
+}
+
 void Overlay::print(std::string_view s)
 {
-    layout->render(s);
+    if (block != nullptr)
+        block->text.append(s);
+    else
+        layout->render(s);
 }
 
 void Overlay::drawRectangle(const celestia::Rect& r)
@@ -88,22 +221,29 @@ void Overlay::drawRectangle(const celestia::Rect& r)
 
 void Overlay::setColor(float r, float g, float b, float a)
 {
-    layout->flush();
-    glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
+    setColor(Color(r, g, b, a));
 }
 
 void Overlay::setColor(const Color& c)
 {
-    layout->flush();
+    color = c;
+    layout->setColor(c);
     glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex,
                      c.red(), c.green(), c.blue(), c.alpha());
+    if (block != nullptr)
+        recordColor(c);
 }
 
 void Overlay::setColor(const Color& c, float a)
 {
-    layout->flush();
-    glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex,
-                     c.red(), c.green(), c.blue(), a);
+    setColor(Color(c, a));
+}
+
+void Overlay::recordColor(const Color& c)
+{
+    block->text.push_back('\0');
+    block->text.push_back(ColorCode);
+    block->text.append(reinterpret_cast<const char*>(c.data()), 4);
 }
 
 void Overlay::moveBy(float dx, float dy)
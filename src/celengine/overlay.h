@@ -10,13 +10,15 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <fmt/printf.h>
 #include <Eigen/Core>
 #include <celengine/textlayout.h>
+#include <celttf/truetypefont.h>
+#include <celutil/color.h>
 
-class Color;
 class Overlay;
 class Renderer;
 
@@ -25,6 +27,34 @@ namespace celestia
 class Rect;
 }
 
+// Text printed by the overlay between beginText and endText, with the
+// glyphs it was laid out into. The text is laid out again only when what is
+// printed changes, and the block can be drawn again without printing it.
+// Only print, setColor and setFont are recorded in the block.
+class OverlayTextBlock
+{
+ public:
+    // Whether the block was ever drawn
+    bool empty() const { return laidOutText.empty(); }
+    void clear();
+
+ private:
+    // The printed text, with the changes of color and font inserted as
+    // codes introduced by a null character
+    std::string text;
+    std::vector<std::shared_ptr<TextureFont>> fonts;
+
+    std::string laidOutText;
+    std::vector<std::shared_ptr<TextureFont>> laidOutFonts;
+    std::vector<GlyphQuad> quads;
+    std::pair<float, float> origin{ 0.0f, 0.0f };
+    // Color and font at the end of the block
+    Color endColor;
+    std::shared_ptr<TextureFont> endFont;
+
+    friend class Overlay;
+};
+
 class Overlay
 {
  public:
@@ -56,8 +86,15 @@ class Overlay
     void drawRectangle(const celestia::Rect&);
 
     void beginText();
+    // Record the text printed until endText into block, drawing the glyphs
+    // of the block when it is unchanged
+    void beginText(OverlayTextBlock& block);
     void endText();
 
+    // Draw a block again at the current position, and leave the color and
+    // font as they were at its end. Returns false if the block is empty.
+    bool drawText(const OverlayTextBlock& block);
+
     void print(std::string_view);
 
     template <typename... T>
@@ -75,11 +112,19 @@ class Overlay
     }
 
  private:
+    void recordColor(const Color&);
+    void layoutText(OverlayTextBlock&);
+
     int windowWidth{ 1 };
     int windowHeight{ 1 };
 
     std::unique_ptr<celestia::engine::TextLayout> layout{ nullptr };
 
+    std::shared_ptr<TextureFont> font;
+    Color color{ Color::White };
+    celestia::engine::TextLayout::HorizontalAlignment halign{ celestia::engine::TextLayout::HorizontalAlignment::Left };
+    OverlayTextBlock* block{ nullptr };
+
     Renderer& renderer;
 
     std::vector<std::pair<float, float>> posStack;
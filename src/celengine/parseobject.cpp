@@ -112,7 +112,7 @@ ParseDate(const Hash* hash, const string& name, double& jd)
 
 
 /*!
- * Create a new Keplerian orbit from an ssc property table:
+ * Read the elements of a Keplerian orbit from an ssc property table:
  *
  * \code EllipticalOrbit
  * {
@@ -145,9 +145,11 @@ ParseDate(const Hash* hash, const string& name, double& jd)
  *     Period is in Julian days
  *     SemiMajorAxis or PericenterDistance is in kilometers.
  */
-static std::unique_ptr<celestia::ephem::Orbit>
-CreateKeplerianOrbit(const Hash* orbitData,
-                     bool usePlanetUnits)
+bool
+ParseKeplerElements(const Hash* orbitData,
+                    bool usePlanetUnits,
+                    astro::KeplerElements& elements,
+                    double& epoch)
 {
 
     // default units for planets are AU and years, otherwise km and days
@@ -156,18 +158,18 @@ CreateKeplerianOrbit(const Hash* orbitData,
     double timeScale;
     GetDefaultUnits(usePlanetUnits, distanceScale, timeScale);
 
-    astro::KeplerElements elements;
+    elements = astro::KeplerElements();
 
     elements.eccentricity = orbitData->getNumber<double>("Eccentricity").value_or(0.0);
     if (elements.eccentricity < 0.0)
     {
         GetLogger()->error("Negative eccentricity is invalid.\n");
-        return nullptr;
+        return false;
     }
     else if (elements.eccentricity == 1.0)
     {
         GetLogger()->error("Parabolic orbits are not supported.\n");
-        return nullptr;
+        return false;
     }
 
     // SemiMajorAxis and Period are absolutely required; everything
@@ -183,7 +185,7 @@ CreateKeplerianOrbit(const Hash* orbitData,
     else
     {
         GetLogger()->error("SemiMajorAxis/PericenterDistance missing from orbit definition.\n");
-        return nullptr;
+        return false;
     }
 
     if (auto periodValue = orbitData->getTime<double>("Period", 1.0, timeScale); periodValue.has_value())
@@ -192,13 +194,13 @@ CreateKeplerianOrbit(const Hash* orbitData,
         if (elements.period == 0.0)
         {
             GetLogger()->error("Period cannot be zero.\n");
-            return nullptr;
+            return false;
         }
     }
     else
     {
         GetLogger()->error("Period must be specified in EllipticalOrbit.\n");
-        return nullptr;
+        return false;
     }
 
     elements.inclination = orbitData->getAngle<double>("Inclination").value_or(0.0);
@@ -214,7 +216,7 @@ CreateKeplerianOrbit(const Hash* orbitData,
         elements.argPericenter = *longPeri - elements.longAscendingNode;
     }
 
-    double epoch = astro::J2000;
+    epoch = astro::J2000;
     ParseDate(orbitData, "Epoch", epoch);
 
     // Accept either the mean anomaly or mean longitude--use mean anomaly
@@ -229,6 +231,19 @@ CreateKeplerianOrbit(const Hash* orbitData,
     elements.argPericenter = celestia::math::degToRad(elements.argPericenter);
     elements.meanAnomaly = celestia::math::degToRad(elements.meanAnomaly);
 
+    return true;
+}
+
+
+static std::unique_ptr<celestia::ephem::Orbit>
+CreateKeplerianOrbit(const Hash* orbitData,
+                     bool usePlanetUnits)
+{
+    astro::KeplerElements elements;
+    double epoch;
+    if (!ParseKeplerElements(orbitData, usePlanetUnits, elements, epoch))
+        return nullptr;
+
     if (elements.eccentricity < 1.0)
     {
         return std::make_unique<celestia::ephem::EllipticalOrbit>(elements, epoch);
@@ -1056,8 +1071,13 @@ CreateRotationModel(const Hash* planetData,
     if (const std::string* sampOrientationFile = planetData->getString("SampledOrientation"); sampOrientationFile != nullptr)
     {
         GetLogger()->verbose("Attempting to load orientation file '{}'\n", *sampOrientationFile);
+        // Packed keyframes take half the memory of quaternions, for long,
+        // high-rate attitude files
+        ephem::OrientationPrecision precision = planetData->getBoolean("CompactOrientation").value_or(false)
+            ? ephem::OrientationPrecision::Compact
+            : ephem::OrientationPrecision::Single;
         ResourceHandle orientationHandle =
-            GetRotationModelManager()->getHandle(RotationModelInfo(*sampOrientationFile, path));
+            GetRotationModelManager()->getHandle(RotationModelInfo(*sampOrientationFile, path, precision));
         if (auto rotationModel = GetRotationModelManager()->find(orientationHandle); rotationModel != nullptr)
         {
             return rotationModel;
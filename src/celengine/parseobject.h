@@ -20,6 +20,11 @@
 #include "frame.h"
 #include "parser.h"
 
+namespace celestia::astro
+{
+struct KeplerElements;
+}
+
 class Body;
 class Star;
 class Universe;
@@ -35,6 +40,13 @@ enum class DataDisposition
 
 bool ParseDate(const Hash* hash, const std::string& name, double& jd);
 
+// Read the elements of an EllipticalOrbit definition, with the distances
+// in km, the period in days and the angles in radians
+bool ParseKeplerElements(const Hash* orbitData,
+                         bool usePlanetUnits,
+                         celestia::astro::KeplerElements& elements,
+                         double& epoch);
+
 celestia::ephem::Orbit* CreateOrbit(const Selection& centralObject,
                                     const Hash* planetData,
                                     const fs::path& path,
@@ -47,41 +47,38 @@ private:
 
 MeasurementUnit parseUnit(std::string_view name)
 {
-    static const std::map<std::string_view, MeasurementUnit>* unitMap = nullptr;
-
-    if (!unitMap)
+    // Initialized once in a thread-safe way, catalogs may be parsed on
+    // worker threads
+    static const std::map<std::string_view, MeasurementUnit>* const unitMap = new std::map<std::string_view, MeasurementUnit>
     {
-        unitMap = new std::map<std::string_view, MeasurementUnit>
-        {
-            { "km"sv, astro::LengthUnit::Kilometer },
-            { "m"sv, astro::LengthUnit::Meter },
-            { "rE"sv, astro::LengthUnit::EarthRadius },
-            { "rJ"sv, astro::LengthUnit::JupiterRadius },
-            { "rS"sv, astro::LengthUnit::SolarRadius },
-            { "AU"sv, astro::LengthUnit::AstronomicalUnit },
-            { "ly"sv, astro::LengthUnit::LightYear },
-            { "pc"sv, astro::LengthUnit::Parsec },
-            { "kpc"sv, astro::LengthUnit::Kiloparsec },
-            { "Mpc"sv, astro::LengthUnit::Megaparsec },
-
-            { "s"sv, astro::TimeUnit::Second },
-            { "min"sv, astro::TimeUnit::Minute },
-            { "h"sv, astro::TimeUnit::Hour },
-            { "d"sv, astro::TimeUnit::Day },
-            { "y"sv, astro::TimeUnit::JulianYear },
-
-            { "mas"sv, astro::AngleUnit::Milliarcsecond },
-            { "arcsec"sv, astro::AngleUnit::Arcsecond },
-            { "arcmin"sv, astro::AngleUnit::Arcminute },
-            { "deg"sv, astro::AngleUnit::Degree },
-            { "hRA"sv, astro::AngleUnit::Hour },
-            { "rad"sv, astro::AngleUnit::Radian },
-
-            { "kg"sv, astro::MassUnit::Kilogram },
-            { "mE"sv, astro::MassUnit::EarthMass },
-            { "mJ"sv, astro::MassUnit::JupiterMass },
-        };
-    }
+        { "km"sv, astro::LengthUnit::Kilometer },
+        { "m"sv, astro::LengthUnit::Meter },
+        { "rE"sv, astro::LengthUnit::EarthRadius },
+        { "rJ"sv, astro::LengthUnit::JupiterRadius },
+        { "rS"sv, astro::LengthUnit::SolarRadius },
+        { "AU"sv, astro::LengthUnit::AstronomicalUnit },
+        { "ly"sv, astro::LengthUnit::LightYear },
+        { "pc"sv, astro::LengthUnit::Parsec },
+        { "kpc"sv, astro::LengthUnit::Kiloparsec },
+        { "Mpc"sv, astro::LengthUnit::Megaparsec },
+
+        { "s"sv, astro::TimeUnit::Second },
+        { "min"sv, astro::TimeUnit::Minute },
+        { "h"sv, astro::TimeUnit::Hour },
+        { "d"sv, astro::TimeUnit::Day },
+        { "y"sv, astro::TimeUnit::JulianYear },
+
+        { "mas"sv, astro::AngleUnit::Milliarcsecond },
+        { "arcsec"sv, astro::AngleUnit::Arcsecond },
+        { "arcmin"sv, astro::AngleUnit::Arcminute },
+        { "deg"sv, astro::AngleUnit::Degree },
+        { "hRA"sv, astro::AngleUnit::Hour },
+        { "rad"sv, astro::AngleUnit::Radian },
+
+        { "kg"sv, astro::MassUnit::Kilogram },
+        { "mE"sv, astro::MassUnit::EarthMass },
+        { "mJ"sv, astro::MassUnit::JupiterMass },
+    };
 
     auto it = unitMap->find(name);
     return it == unitMap->end()
@@ -165,10 +162,11 @@ std::unique_ptr<Hash> Parser::readHash()
 
     auto hash = std::make_unique<Hash>();
 
+    // The hash copies the names, so one string holds each of them in turn
+    std::string name;
     tok = tokenizer->nextToken();
     while (tok != Tokenizer::TokenEndGroup)
     {
-        std::string name;
         if (auto tokenValue = tokenizer->getNameValue(); tokenValue.has_value())
         {
             name = *tokenValue;
@@ -188,7 +186,7 @@ std::unique_ptr<Hash> Parser::readHash()
         }
 
         value.setUnits(units);
-        hash->addValue(std::move(name), std::move(value));
+        hash->addValue(name, std::move(value));
 
         tok = tokenizer->nextToken();
     }
@@ -25,6 +25,32 @@ Eigen::Matrix4f PerspectiveProjectionMode::getProjectionMatrix(float nearZ, floa
     return math::Perspective(math::radToDeg(getFOV(zoom)), width / height, nearZ, farZ);
 }
 
+bool PerspectiveProjectionMode::supportsReversedDepth() const
+{
+    return true;
+}
+
+Eigen::Matrix4f PerspectiveProjectionMode::getReversedDepthProjectionMatrix(float nearZ, float farZ, float zoom) const
+{
+    return math::ReversedPerspective(math::radToDeg(getFOV(zoom)), width / height, nearZ, farZ);
+}
+
+bool PerspectiveProjectionMode::supportsStereo() const
+{
+    return true;
+}
+
+Eigen::Matrix4f PerspectiveProjectionMode::getEyeProjectionMatrix(const Eigen::Matrix4f& projection, float eyeShift, float eyeOffset) const
+{
+    // Move the eye sideways, then shift the frustum so that points at the
+    // screen distance project to the same place for both eyes. The shift
+    // is the same in either depth range.
+    Eigen::Matrix4f eye = projection;
+    eye.col(3) -= projection.col(0) * eyeOffset;
+    eye.row(0) += eye.row(3) * (eyeShift * projection(0, 0));
+    return eye;
+}
+
 float PerspectiveProjectionMode::getMinimumFOV() const
 {
     return math::degToRad(0.001f);
@@ -26,6 +26,10 @@ public:
     ~PerspectiveProjectionMode() override = default;
 
     Eigen::Matrix4f getProjectionMatrix(float nearZ, float farZ, float zoom) const override;
+    bool supportsReversedDepth() const override;
+    Eigen::Matrix4f getReversedDepthProjectionMatrix(float nearZ, float farZ, float zoom) const override;
+    bool supportsStereo() const override;
+    Eigen::Matrix4f getEyeProjectionMatrix(const Eigen::Matrix4f& projection, float eyeShift, float eyeOffset) const override;
     float getMinimumFOV() const override;
     float getMaximumFOV() const override;
     float getFOV(float zoom) const override;
@@ -0,0 +1,131 @@
+// pixelreadback.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reads frames back from the GPU without waiting for them.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pixelreadback.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <celengine/glsupport.h>
+#include <celutil/array_view.h>
+#include "render.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+std::size_t
+rowStride(int width, PixelFormat format)
+{
+    std::size_t bytesPerPixel = format == PixelFormat::RGB
+#ifndef GL_ES
+                                || format == PixelFormat::BGR
+#endif
+                                ? 3 : 4;
+    // The default pack alignment of 4
+    return (static_cast<std::size_t>(width) * bytesPerPixel + 3) & ~std::size_t(3);
+}
+
+} // end unnamed namespace
+
+bool
+PixelReadback::isSupported()
+{
+#ifdef GL_ES
+    return gl::checkVersion(gl::GLES_3_0);
+#else
+    return gl::ARB_map_buffer_range;
+#endif
+}
+
+std::size_t
+PixelReadback::frameSize(int width, int height, PixelFormat format)
+{
+    return rowStride(width, format) * static_cast<std::size_t>(height);
+}
+
+PixelReadback::PixelReadback(const Renderer& renderer, std::size_t slots) :
+    m_renderer(renderer),
+    m_slots(std::max(slots, std::size_t(1)))
+{
+}
+
+bool
+PixelReadback::read(int x, int y, int width, int height, PixelFormat format)
+{
+    if (full())
+        return false;
+
+    Slot& slot = m_slots[(m_first + m_pending) % m_slots.size()];
+    slot.stride = rowStride(width, format);
+    slot.height = height;
+    slot.size = slot.stride * static_cast<std::size_t>(height);
+
+    if (slot.buffer.id() == 0)
+        slot.buffer = gl::Buffer(gl::Buffer::TargetHint::PixelPack);
+    slot.buffer.bind();
+    if (slot.capacity < slot.size)
+    {
+        slot.buffer.setData(util::array_view<const void>(nullptr, slot.size), gl::Buffer::BufferUsage::StreamRead);
+        slot.capacity = slot.size;
+    }
+
+    glReadPixels(x, y, width, height, static_cast<GLenum>(format), GL_UNSIGNED_BYTE, nullptr);
+    slot.buffer.unbind();
+    if (glGetError() != GL_NO_ERROR)
+        return false;
+
+    ++m_pending;
+    return true;
+}
+
+bool
+PixelReadback::take(std::uint8_t* buffer)
+{
+    if (m_pending == 0)
+        return false;
+
+    Slot& slot = m_slots[m_first];
+    m_first = (m_first + 1) % m_slots.size();
+    --m_pending;
+
+    slot.buffer.bind();
+    const auto* pixels = static_cast<const std::uint8_t*>(slot.buffer.mapRange(0, static_cast<GLsizeiptr>(slot.size), GL_MAP_READ_BIT));
+    if (pixels == nullptr)
+    {
+        slot.buffer.unbind();
+        return false;
+    }
+
+    // glReadPixels returns the bottom row first unless the MESA pack
+    // invert extension reversed them
+    if (m_renderer.capturesRowsTopFirst())
+    {
+        std::memcpy(buffer, pixels, slot.size);
+    }
+    else
+    {
+        for (int row = 0; row < slot.height; ++row)
+        {
+            std::memcpy(buffer + static_cast<std::size_t>(row) * slot.stride,
+                        pixels + static_cast<std::size_t>(slot.height - 1 - row) * slot.stride,
+                        slot.stride);
+        }
+    }
+
+    bool ok = slot.buffer.unmap();
+    slot.buffer.unbind();
+    return ok;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,80 @@
+// pixelreadback.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reads frames back from the GPU without waiting for them.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <celimage/pixelformat.h>
+#include <celrender/gl/buffer.h>
+
+class Renderer;
+
+namespace celestia::engine
+{
+
+/*! A ring of pixel pack buffers which frames are read into. glReadPixels
+ *  into a buffer returns without waiting for the GPU to finish the frame;
+ *  the pixels are copied out when the ring is full, by which time the GPU
+ *  is usually done with them. The rows are copied top first, like
+ *  Renderer::captureFrame returns them, each padded to a multiple of 4
+ *  bytes.
+ *
+ *  OpenGL ES 2.0 has no pixel pack buffers, callers fall back to
+ *  Renderer::captureFrame then. All methods require the GL context.
+ */
+class PixelReadback
+{
+public:
+    static constexpr std::size_t DefaultSlots = 3;
+
+    // True if pixel pack buffers can be mapped
+    static bool isSupported();
+
+    // Bytes of a frame read with the given size and format
+    static std::size_t frameSize(int width, int height, PixelFormat format);
+
+    explicit PixelReadback(const Renderer& renderer, std::size_t slots = DefaultSlots);
+    ~PixelReadback() = default;
+
+    PixelReadback(const PixelReadback&) = delete;
+    PixelReadback& operator=(const PixelReadback&) = delete;
+
+    // Start reading a rectangle of the framebuffer into a free slot.
+    // Returns false if all slots hold pending reads or the read failed.
+    bool read(int x, int y, int width, int height, PixelFormat format);
+
+    // Copy the oldest pending read to buffer, which must hold frameSize
+    // bytes, and free its slot
+    bool take(std::uint8_t* buffer);
+
+    std::size_t pending() const { return m_pending; }
+    bool full() const { return m_pending == m_slots.size(); }
+
+private:
+    struct Slot
+    {
+        gl::Buffer buffer{ util::NoCreateT{} };
+        std::size_t capacity{ 0 };
+        std::size_t size{ 0 };
+        std::size_t stride{ 0 };
+        int height{ 0 };
+    };
+
+    const Renderer& m_renderer;
+    std::vector<Slot> m_slots;
+    std::size_t m_first{ 0 };
+    std::size_t m_pending{ 0 };
+};
+
+} // end namespace celestia::engine
@@ -29,6 +29,41 @@ static Vector3d astrocentricPosition(const UniversalCoord& pos,
     return pos.offsetFromKm(star.getPosition(t));
 }
 
+void PointStarStaging::clear()
+{
+    stars.clear();
+    glare.clear();
+    labels.clear();
+    deferred.clear();
+}
+
+bool PointStarProgress::matches(const View& v) const
+{
+    // Staged positions are relative to the observer, the tolerances keep
+    // their errors well below a pixel
+    constexpr double positionTolerance = 1.0e-6;
+    constexpr float orientationTolerance = 1.0e-6f;
+
+    return (v.obsPos - view.obsPos).norm() < positionTolerance &&
+           v.orientation.angularDistance(view.orientation) < orientationTolerance &&
+           v.fov == view.fov &&
+           v.aspectRatio == view.aspectRatio &&
+           v.pixelSize == view.pixelSize &&
+           v.faintestMagNight == view.faintestMagNight &&
+           v.faintestMag == view.faintestMag &&
+           v.saturationMag == view.saturationMag &&
+           v.brightnessScale == view.brightnessScale &&
+           v.starStyle == view.starStyle &&
+           v.labelMode == view.labelMode;
+}
+
+void PointStarProgress::restart()
+{
+    staging.clear();
+    traversal.reset();
+    complete = false;
+}
+
 PointStarRenderer::PointStarRenderer() :
     ObjectRenderer<Star, float>(StarDistanceLimit)
 {
@@ -36,7 +71,7 @@ PointStarRenderer::PointStarRenderer() :
 
 void PointStarRenderer::process(const Star& star, float distance, float appMag)
 {
-    if (distance > distanceLimit)
+    if (distance > distanceLimit || distance < minDistance)
         return;
 
     Vector3f starPos = star.getPosition();
@@ -74,6 +109,13 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
         // and use the most inexpensive test possible . . .
         if (distance < SolarSystemMaxDistance || orbitSizeInPixels > 1.0f)
         {
+            // Orbit evaluation isn't thread safe, leave these for flush()
+            if (staging != nullptr)
+            {
+                staging->deferred.push_back({ &star, distance, appMag });
+                return;
+            }
+
             // Compute the position of the observer relative to the star.
             // This is a much more accurate (and expensive) distance
             // calculation than the previous one which used the observer's
@@ -104,10 +146,20 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                                          glareSize,
                                          glareAlpha);
 
-            if (glareSize != 0.0f)
-                glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
-            if (pointSize != 0.0f)
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            if (staging != nullptr)
+            {
+                if (glareSize != 0.0f)
+                    staging->glare.push_back({ relPos, Color(starColor, glareAlpha), glareSize });
+                if (pointSize != 0.0f)
+                    staging->stars.push_back({ relPos, Color(starColor, alpha), pointSize });
+            }
+            else
+            {
+                if (glareSize != 0.0f)
+                    glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
+                if (pointSize != 0.0f)
+                    starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            }
 
             // Place labels for stars brighter than the specified label threshold brightness
             if (((labelMode & Renderer::StarLabels) != 0) && appMag < labelThresholdMag)
@@ -117,10 +169,17 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 {
                     float distr = min(1.0f, 3.5f * (labelThresholdMag - appMag)/labelThresholdMag);
                     Color color = Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha());
-                    renderer->addBackgroundAnnotation(nullptr,
-                                                      starDB->getStarName(star, true),
-                                                      color,
-                                                      relPos);
+                    if (staging != nullptr)
+                        staging->labels.push_back({ &star, relPos, color, appMag });
+                    else
+                        renderer->addBackgroundAnnotation(nullptr,
+                                                          starDB->getStarLabel(star),
+                                                          color,
+                                                          relPos,
+                                                          Renderer::LabelHorizontalAlignment::Start,
+                                                          Renderer::LabelVerticalAlignment::Bottom,
+                                                          0.0f,
+                                                          -appMag);
                 }
             }
         }
@@ -154,10 +213,35 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 pos = pos * (1.0f - star.getRadius() * 1.01f / pos.norm());
 
                 renderer->addSortedAnnotation(nullptr,
-                                              starDB->getStarName(star, true),
+                                              starDB->getStarLabel(star),
                                               Renderer::StarLabelColor,
-                                              pos);
+                                              pos,
+                                              Renderer::LabelHorizontalAlignment::Start,
+                                              Renderer::LabelVerticalAlignment::Bottom,
+                                              0.0f,
+                                              -appMag);
             }
         }
     }
 }
+
+void PointStarRenderer::flush(const PointStarStaging& output)
+{
+    for (const auto& v : output.glare)
+        glareVertexBuffer->addStar(v.position, v.color, v.size);
+    for (const auto& v : output.stars)
+        starVertexBuffer->addStar(v.position, v.color, v.size);
+    for (const auto& label : output.labels)
+    {
+        renderer->addBackgroundAnnotation(nullptr,
+                                          starDB->getStarLabel(*label.star),
+                                          label.color,
+                                          label.position,
+                                          Renderer::LabelHorizontalAlignment::Start,
+                                          Renderer::LabelVerticalAlignment::Bottom,
+                                          0.0f,
+                                          -label.appMag);
+    }
+    for (const auto& candidate : output.deferred)
+        process(*candidate.star, candidate.distance, candidate.appMag);
+}
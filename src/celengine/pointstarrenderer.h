@@ -11,9 +11,12 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <Eigen/Geometry>
 #include <vector>
+#include <celutil/color.h>
 #include "objectrenderer.h"
 #include "renderlistentry.h"
+#include "staroctree.h"
 
 class ColorTemperatureTable;
 class PointStarVertexBuffer;
@@ -28,6 +31,72 @@ constexpr inline float BaseStarDiscSize      = 5.0f;
 constexpr inline float MaxScaledDiscStarSize = 8.0f;
 constexpr inline float GlareOpacity          = 0.65f;
 
+// Output of a PointStarRenderer running on a worker thread. Vertex buffers,
+// annotations and orbit computations may only be touched from the render
+// thread, so the staged output is later passed to PointStarRenderer::flush.
+struct PointStarStaging
+{
+    struct Vertex
+    {
+        Eigen::Vector3f position;
+        Color color;
+        float size;
+    };
+
+    struct Label
+    {
+        const Star* star;
+        Eigen::Vector3f position;
+        Color color;
+        float appMag;
+    };
+
+    // Stars which need astrocentric positions or go into the render list
+    struct Candidate
+    {
+        const Star* star;
+        float distance;
+        float appMag;
+    };
+
+    void clear();
+
+    std::vector<Vertex> stars;
+    std::vector<Vertex> glare;
+    std::vector<Label> labels;
+    std::vector<Candidate> deferred;
+};
+
+// Star field rendered over several frames when the octree traversal doesn't
+// fit in the frame time. The stars staged so far, brightest first, are
+// drawn every frame while the traversal goes on, until the view changes.
+struct PointStarProgress
+{
+    struct View
+    {
+        Eigen::Vector3d obsPos;
+        Eigen::Quaternionf orientation;
+        float fov;
+        float aspectRatio;
+        float pixelSize;
+        float faintestMagNight;
+        float faintestMag;
+        float saturationMag;
+        float brightnessScale;
+        int starStyle;
+        int labelMode;
+    };
+
+    // Return true if the staged stars are still valid for the view
+    bool matches(const View&) const;
+    void restart();
+
+    View view{ };
+    PointStarStaging staging;
+    StarOctree::Traversal traversal;
+    bool complete{ false };
+};
+
 class PointStarRenderer : public ObjectRenderer<Star, float>
 {
  public:
@@ -41,6 +110,9 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 
     PointStarRenderer();
     void process(const Star &star, float distance, float appMag) override;
+    // Submit the output staged by a worker thread, must be called on the
+    // render thread with staging set to nullptr.
+    void flush(const PointStarStaging&);
 
     Eigen::Vector3d obsPos;
     Eigen::Vector3f viewNormal;
@@ -51,4 +123,8 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     const ColorTemperatureTable* colorTemp      { nullptr };
     float SolarSystemMaxDistance                { 1.0f };
     float cosFOV                                { 1.0f };
+    // Stars closer than this are skipped
+    float minDistance                           { 0.0f };
+    // When set, output goes into staging instead of the vertex buffers
+    PointStarStaging* staging                   { nullptr };
 };
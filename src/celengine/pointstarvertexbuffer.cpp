@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
 #include "glsupport.h"
@@ -31,10 +32,13 @@ PointStarVertexBuffer::PointStarVertexBuffer(const Renderer &renderer,
 {
 }
 
-void PointStarVertexBuffer::startSprites()
+void PointStarVertexBuffer::startSprites(bool packed)
 {
-    m_prog = m_renderer.getShaderManager().getShader("star");
+    m_prog = m_renderer.getShaderManager().getShader(packed ? "starpacked" : "star");
     m_pointSizeFromVertex = true;
+    m_packed = packed;
+    if (packed && m_packedVertices == nullptr)
+        m_packedVertices = std::make_unique<PackedStarVertex[]>(m_capacity);
 }
 
 void PointStarVertexBuffer::startBasicPoints()
@@ -44,6 +48,7 @@ void PointStarVertexBuffer::startBasicPoints()
     shadprop.lightModel = ShaderProperties::UnlitModel;
     m_prog = m_renderer.getShaderManager().getShader(shadprop);
     m_pointSizeFromVertex = false;
+    m_packed = false;
 }
 
 void PointStarVertexBuffer::render()
@@ -55,18 +60,37 @@ void PointStarVertexBuffer::render()
         if (m_texture != nullptr)
             m_texture->bind();
 
-        m_bo->bind().invalidateData().setData(
-            util::array_view(m_vertices.get(), m_nStars),
-            gl::Buffer::BufferUsage::StreamDraw);
+        int first = 0;
+        if (m_packed)
+            first = upload(util::array_view(m_packedVertices.get(), m_nStars));
+        else
+            first = upload(util::array_view(m_vertices.get(), m_nStars));
 
-        if (m_pointSizeFromVertex)
-            m_vo1->draw(gl::VertexObject::Primitive::Points, m_nStars);
+        if (m_packed)
+            m_packedVO->draw(gl::VertexObject::Primitive::Points, m_nStars, first);
+        else if (m_pointSizeFromVertex)
+            m_vo1->draw(gl::VertexObject::Primitive::Points, m_nStars, first);
         else
-            m_vo2->draw(gl::VertexObject::Primitive::Points, m_nStars);
+            m_vo2->draw(gl::VertexObject::Primitive::Points, m_nStars, first);
         m_nStars = 0;
     }
 }
 
+template<typename T> int
+PointStarVertexBuffer::upload(util::array_view<T> vertices)
+{
+    if (gl::StreamBuffer* ring = m_renderer.getStreamBuffer(); ring != nullptr)
+    {
+        int first = ring->write(vertices, sizeof(T));
+        // The ring is reallocated if the vertices don't fit in it
+        setupVertexArrayObject();
+        return first;
+    }
+
+    m_bo->bind().invalidateData().setData(vertices, gl::Buffer::BufferUsage::StreamDraw);
+    return 0;
+}
+
 void PointStarVertexBuffer::makeCurrent()
 {
     if (current == this || m_prog == nullptr)
@@ -93,62 +117,127 @@ void PointStarVertexBuffer::makeCurrent()
 
 void PointStarVertexBuffer::setupVertexArrayObject()
 {
-    if (!m_initialized)
+    // Vertices are appended to the ring buffer of the renderer when it has
+    // one, and the vertex objects follow its reallocations
+    const gl::Buffer* buffer;
+    int generation = -1;
+    if (const gl::StreamBuffer* ring = m_renderer.getStreamBuffer(); ring != nullptr)
     {
-        m_initialized = true;
+        buffer = &ring->buffer();
+        generation = ring->generation();
+    }
+    else
+    {
+        if (m_bo == nullptr)
+            m_bo = std::make_unique<gl::Buffer>();
+        buffer = &m_bo->bind();
+    }
 
-        m_bo = std::make_unique<gl::Buffer>();
+    if (m_vo1 == nullptr || m_generation != generation)
+    {
+        m_generation = generation;
         m_vo1 = std::make_unique<gl::VertexObject>();
         m_vo2 = std::make_unique<gl::VertexObject>();
+        m_packedVO = std::make_unique<gl::VertexObject>();
+        addVertexAttributes(*m_vo1, *buffer, true);
+        addVertexAttributes(*m_vo2, *buffer, false);
+        addPackedVertexAttributes(*m_packedVO, *buffer);
+    }
+}
 
-        m_bo->bind();
+void PointStarVertexBuffer::addVertexAttributes(gl::VertexObject& vo,
+                                                const gl::Buffer& buffer,
+                                                bool pointSize)
+{
+    vo.addVertexBuffer(
+        buffer,
+        CelestiaGLProgram::VertexCoordAttributeIndex,
+        3,
+        gl::VertexObject::DataType::Float,
+        false,
+        sizeof(StarVertex),
+        offsetof(StarVertex, position));
 
-        m_vo1->addVertexBuffer(
-            *m_bo,
-            CelestiaGLProgram::VertexCoordAttributeIndex,
-            3,
-            gl::VertexObject::DataType::Float,
-            false,
-            sizeof(StarVertex),
-            offsetof(StarVertex, position));
-
-        m_vo1->addVertexBuffer(
-            *m_bo,
-            CelestiaGLProgram::ColorAttributeIndex,
-            4,
-            gl::VertexObject::DataType::UnsignedByte,
-            true,
-            sizeof(StarVertex),
-            offsetof(StarVertex, color));
+    vo.addVertexBuffer(
+        buffer,
+        CelestiaGLProgram::ColorAttributeIndex,
+        4,
+        gl::VertexObject::DataType::UnsignedByte,
+        true,
+        sizeof(StarVertex),
+        offsetof(StarVertex, color));
 
-        m_vo1->addVertexBuffer(
-            *m_bo,
+    if (pointSize)
+    {
+        vo.addVertexBuffer(
+            buffer,
             CelestiaGLProgram::PointSizeAttributeIndex,
             1,
             gl::VertexObject::DataType::Float,
             false,
             sizeof(StarVertex),
             offsetof(StarVertex, size));
+    }
+}
 
-        m_vo2->addVertexBuffer(
-            *m_bo,
-            CelestiaGLProgram::VertexCoordAttributeIndex,
-            3,
-            gl::VertexObject::DataType::Float,
-            false,
-            sizeof(StarVertex),
-            offsetof(StarVertex, position));
-
-        m_vo2->addVertexBuffer(
-            *m_bo,
-            CelestiaGLProgram::ColorAttributeIndex,
-            4,
-            gl::VertexObject::DataType::UnsignedByte,
-            true,
-            sizeof(StarVertex),
-            offsetof(StarVertex, color));
+void PointStarVertexBuffer::addPackedVertexAttributes(gl::VertexObject& vo,
+                                                      const gl::Buffer& buffer)
+{
+    vo.addVertexBuffer(
+        buffer,
+        CelestiaGLProgram::VertexCoordAttributeIndex,
+        2,
+        gl::VertexObject::DataType::Short,
+        true,
+        sizeof(PackedStarVertex),
+        offsetof(PackedStarVertex, direction));
+
+    // The size is read as the alpha of the color
+    vo.addVertexBuffer(
+        buffer,
+        CelestiaGLProgram::ColorAttributeIndex,
+        4,
+        gl::VertexObject::DataType::UnsignedByte,
+        true,
+        sizeof(PackedStarVertex),
+        offsetof(PackedStarVertex, color));
+}
+
+#ifndef GL_ES
+void PointStarVertexBuffer::drawIndirect(const gl::Buffer& vertices,
+                                         const gl::Buffer& commands,
+                                         std::ptrdiff_t offset)
+{
+    // Submit the stars added so far first, this makes the buffer current.
+    // The GPU writes unpacked vertices.
+    render();
+    if (m_packed)
+    {
+        finish();
+        startSprites(false);
+    }
+    makeCurrent();
+    if (m_prog == nullptr)
+        return;
+
+    if (m_texture != nullptr)
+        m_texture->bind();
+
+    if (m_indirectVO1 == nullptr || m_indirectBuffer != vertices.id())
+    {
+        m_indirectBuffer = vertices.id();
+        m_indirectVO1 = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Points);
+        m_indirectVO2 = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Points);
+        addVertexAttributes(*m_indirectVO1, vertices, true);
+        addVertexAttributes(*m_indirectVO2, vertices, false);
     }
+
+    if (m_pointSizeFromVertex)
+        m_indirectVO1->drawIndirect(commands, offset);
+    else
+        m_indirectVO2->drawIndirect(commands, offset);
 }
+#endif
 
 void PointStarVertexBuffer::finish()
 {
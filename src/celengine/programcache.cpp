@@ -0,0 +1,235 @@
+// programcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "programcache.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celutil/logger.h>
+#include "glshader.h"
+#include "glsupport.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr std::string_view FileMagic{ "CELPRGB\0", 8 };
+constexpr std::size_t HeaderSize = 8 + sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+
+// Bump when the attribute locations bound by ShaderManager change, they
+// are part of the binary but not of the sources
+constexpr std::uint64_t CacheVersion = 1;
+
+// 64 bit FNV-1a
+constexpr std::uint64_t FNVOffsetBasis = UINT64_C(14695981039346656037);
+constexpr std::uint64_t FNVPrime = UINT64_C(1099511628211);
+
+std::uint64_t
+hashBytes(std::uint64_t hash, std::string_view data)
+{
+    for (char c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNVPrime;
+    }
+    return hash;
+}
+
+
+std::string
+getDriverString()
+{
+    std::string driver;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        if (const auto* s = reinterpret_cast<const char*>(glGetString(name)); s != nullptr)
+            driver += s;
+        driver += '\n';
+    }
+    return driver;
+}
+
+} // end unnamed namespace
+
+
+std::uint64_t
+GetProgramCacheKey(std::string_view driver, util::array_view<std::string_view> sources)
+{
+    std::uint64_t hash = FNVOffsetBasis ^ CacheVersion;
+    hash = hashBytes(hash, driver);
+    for (std::string_view source : sources)
+    {
+        // Separate the sources, so that moving text from one shader to the
+        // next changes the key
+        hash = hashBytes(hash, fmt::format("\n{}\n", source.size()));
+        hash = hashBytes(hash, source);
+    }
+    return hash;
+}
+
+
+ProgramBinaryCache::ProgramBinaryCache(const fs::path& _directory) :
+    directory(_directory),
+    driver(getDriverString())
+{
+}
+
+
+bool
+ProgramBinaryCache::isSupported()
+{
+#ifdef GL_ES
+    // GL_OES_get_program_binary lacks the retrievable hint
+    if (!gl::checkVersion(gl::GLES_3_0))
+        return false;
+#else
+    if (!gl::ARB_get_program_binary)
+        return false;
+#endif
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+
+std::uint64_t
+ProgramBinaryCache::getKey(util::array_view<std::string_view> sources) const
+{
+    return GetProgramCacheKey(driver, sources);
+}
+
+
+fs::path
+ProgramBinaryCache::programPath(std::uint64_t key) const
+{
+    return directory / fmt::format("{:016x}.bin", key);
+}
+
+
+GLProgram*
+ProgramBinaryCache::load(std::uint64_t key) const
+{
+    fs::path path = programPath(key);
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return nullptr;
+
+    std::array<char, HeaderSize> header;
+    if (!in.read(header.data(), header.size()) || std::string_view(header.data(), FileMagic.size()) != FileMagic)
+    {
+        GetLogger()->warn("Ignoring broken shader cache file {}\n", path);
+        return nullptr;
+    }
+
+    std::uint64_t fileKey;
+    std::uint32_t format;
+    std::uint32_t length;
+    const char* ptr = header.data() + FileMagic.size();
+    std::memcpy(&fileKey, ptr, sizeof(fileKey));
+    std::memcpy(&format, ptr + 8, sizeof(format));
+    std::memcpy(&length, ptr + 12, sizeof(length));
+
+    std::vector<char> binary(length);
+    if (fileKey != key || length == 0 || !in.read(binary.data(), binary.size()))
+    {
+        GetLogger()->warn("Ignoring broken shader cache file {}\n", path);
+        return nullptr;
+    }
+
+    GLProgram* prog = nullptr;
+    if (GLShaderLoader::CreateProgramFromBinary(static_cast<GLenum>(format),
+                                                binary.data(),
+                                                static_cast<GLsizei>(length),
+                                                &prog) != GLShaderStatus::OK)
+    {
+        // The driver no longer accepts the binary, it's replaced once the
+        // program has been compiled again
+        GetLogger()->debug("Shader cache file {} rejected by the driver\n", path);
+        std::error_code ec;
+        fs::remove(path, ec);
+        return nullptr;
+    }
+
+    return prog;
+}
+
+
+void
+ProgramBinaryCache::prepare(const GLProgram& prog)
+{
+    glProgramParameteri(prog.getID(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+
+// Write to a temporary file and move it in place, so that an interrupted
+// write never leaves a partial binary behind
+void
+ProgramBinaryCache::store(std::uint64_t key, const GLProgram& prog) const
+{
+    GLint length = 0;
+    glGetProgramiv(prog.getID(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> data(HeaderSize + static_cast<std::size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(prog.getID(), length, &written, &format, data.data() + HeaderSize);
+    if (written <= 0)
+        return;
+
+    auto format32 = static_cast<std::uint32_t>(format);
+    auto length32 = static_cast<std::uint32_t>(written);
+    char* ptr = data.data();
+    std::memcpy(ptr, FileMagic.data(), FileMagic.size());
+    ptr += FileMagic.size();
+    std::memcpy(ptr, &key, sizeof(key));
+    std::memcpy(ptr + 8, &format32, sizeof(format32));
+    std::memcpy(ptr + 12, &length32, sizeof(length32));
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec)
+    {
+        GetLogger()->debug("Can't create shader cache directory {}: {}\n", directory, ec.message());
+        return;
+    }
+
+    fs::path path = programPath(key);
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+        if (!out.write(data.data(), static_cast<std::streamsize>(HeaderSize + length32)))
+        {
+            out.close();
+            fs::remove(tempPath, ec);
+            return;
+        }
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec)
+    {
+        GetLogger()->debug("Can't add {} to the shader cache: {}\n", path, ec.message());
+        fs::remove(tempPath, ec);
+    }
+}
+
+} // end namespace celestia::engine
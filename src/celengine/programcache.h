@@ -0,0 +1,58 @@
+// programcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <celcompat/filesystem.h>
+#include <celutil/array_view.h>
+
+class GLProgram;
+
+namespace celestia::engine
+{
+
+// Key of a program linked from sources by the driver described by
+// driver. Stable across runs, so that it can name files on disk.
+std::uint64_t GetProgramCacheKey(std::string_view driver, util::array_view<std::string_view> sources);
+
+// Keeps the binaries of linked shader programs in a directory, so that
+// programs need not be compiled again on later runs. The binaries are
+// only valid for the driver which created them, the key of a program
+// includes the GL vendor, renderer and version. Drivers may still reject
+// a binary, e.g. after an update which kept the version string, in which
+// case the program has to be compiled from source.
+class ProgramBinaryCache
+{
+public:
+    explicit ProgramBinaryCache(const fs::path& directory);
+
+    // False if the driver doesn't support any program binary format
+    static bool isSupported();
+
+    std::uint64_t getKey(util::array_view<std::string_view> sources) const;
+
+    // Return nullptr if the program isn't cached or its binary is rejected
+    GLProgram* load(std::uint64_t key) const;
+
+    // Must be called before linking a program which will be stored
+    static void prepare(const GLProgram& prog);
+    void store(std::uint64_t key, const GLProgram& prog) const;
+
+private:
+    fs::path programPath(std::uint64_t key) const;
+
+    fs::path directory;
+    std::string driver;
+};
+
+} // end namespace celestia::engine
@@ -16,10 +16,32 @@ ProjectionMode::ProjectionMode(float width, float height, int distanceToScreen,
     width(width),
     height(height),
     distanceToScreen(distanceToScreen),
-    screenDpi(screenDpi)
+    screenDpi(screenDpi),
+    windowWidth(width),
+    windowHeight(height)
 {
 }
 
+bool ProjectionMode::supportsReversedDepth() const
+{
+    return false;
+}
+
+Eigen::Matrix4f ProjectionMode::getReversedDepthProjectionMatrix(float nearZ, float farZ, float zoom) const
+{
+    return getProjectionMatrix(nearZ, farZ, zoom);
+}
+
+bool ProjectionMode::supportsStereo() const
+{
+    return false;
+}
+
+Eigen::Matrix4f ProjectionMode::getEyeProjectionMatrix(const Eigen::Matrix4f& projection, float /*eyeShift*/, float /*eyeOffset*/) const
+{
+    return projection;
+}
+
 void ProjectionMode::setScreenDpi(int dpi)
 {
     screenDpi = dpi;
@@ -32,8 +54,30 @@ void ProjectionMode::setDistanceToScreen(int dts)
 
 void ProjectionMode::setSize(float w, float h)
 {
-    width = w;
-    height = h;
+    windowWidth = w;
+    windowHeight = h;
+    width = w / subView.z();
+    height = h / subView.w();
+}
+
+void ProjectionMode::setSubView(const Eigen::Vector4f& v)
+{
+    subView = v;
+    setSize(windowWidth, windowHeight);
+}
+
+Eigen::Matrix4f ProjectionMode::getSubViewMatrix() const
+{
+    // Scale the part to [-1, 1] around its center
+    float centerX = 2.0f * subView.x() + subView.z() - 1.0f;
+    float centerY = 2.0f * subView.y() + subView.w() - 1.0f;
+
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m(0, 0) = 1.0f / subView.z();
+    m(0, 3) = -centerX / subView.z();
+    m(1, 1) = 1.0f / subView.w();
+    m(1, 3) = -centerY / subView.w();
+    return m;
 }
 
 }
@@ -30,6 +30,16 @@ public:
     virtual ~ProjectionMode() = default;
 
     virtual Eigen::Matrix4f getProjectionMatrix(float nearZ, float farZ, float zoom) const = 0;
+    // Projection matrix for a reversed, 0 to 1 depth range, where the mode
+    // supports it
+    virtual bool supportsReversedDepth() const;
+    virtual Eigen::Matrix4f getReversedDepthProjectionMatrix(float nearZ, float farZ, float zoom) const;
+    // Projection matrix for one eye of a stereo pair, from the projection
+    // matrix of the center of the view. eyeShift is the signed horizontal
+    // offset of the eye divided by the distance which appears at screen
+    // depth, and eyeOffset the offset in the units of the camera space.
+    virtual bool supportsStereo() const;
+    virtual Eigen::Matrix4f getEyeProjectionMatrix(const Eigen::Matrix4f& projection, float eyeShift, float eyeOffset) const;
     virtual float getMinimumFOV() const = 0;
     virtual float getMaximumFOV() const = 0;
     virtual float getFOV(float zoom) const = 0;
@@ -50,13 +60,29 @@ public:
 
     void setScreenDpi(int screenDpi);
     void setDistanceToScreen(int distanceToScreen);
+    // Size of the window, or of the part of the view in it
     void setSize(float width, float height);
 
+    // Only render the part of the view at (x, y) of size (z, w), as
+    // fractions of the view from its lower left corner, so that several
+    // windows, e.g. one per projector of a cluster, show a view larger than
+    // each of them. The FOV and pixel sizes are those of the whole view;
+    // getSubViewMatrix transforms its normalized device coordinates to
+    // those of the part.
+    void setSubView(const Eigen::Vector4f& subView);
+    Eigen::Matrix4f getSubViewMatrix() const;
+
 protected:
+    // Size of the whole view
     float width;
     float height;
     int distanceToScreen;
     int screenDpi;
+
+private:
+    float windowWidth;
+    float windowHeight;
+    Eigen::Vector4f subView{ 0.0f, 0.0f, 1.0f, 1.0f };
 };
 
 }
@@ -18,6 +18,7 @@
 #include "lightenv.h"
 #include "rendcontext.h"
 #include "render.h"
+#include "ringshadowtexture.h"
 #include "shadowmap.h" // GL_ONLY_SHADOWS definition
 #include "texmanager.h"
 #include "texture.h"
@@ -154,7 +155,7 @@ RenderContext::drawGroup(gl::VertexObject &vao, const cmod::PrimitiveGroup& grou
         glEnable(GL_POINT_SPRITE);
         glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
-        glActiveTexture(GL_TEXTURE0);
+        gl::activeTexture(GL_TEXTURE0);
     }
 
     vao.draw(convert(group.prim), group.indicesCount, group.indicesOffset);
@@ -169,6 +170,14 @@ RenderContext::drawGroup(gl::VertexObject &vao, const cmod::PrimitiveGroup& grou
 }
 
 
+void
+RenderContext::setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    positionOffset = offset;
+    positionScale = scale;
+}
+
+
 void
 RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::PrimitiveGroupType primType)
 {
@@ -178,8 +187,12 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     // or disappear in the new set of vertex arrays.
     bool usePointSizeNow = (desc.getAttribute(cmod::VertexAttributeSemantic::PointSize).format
                             == cmod::VertexAttributeFormat::Float1);
-    bool useNormalsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format
-                          == cmod::VertexAttributeFormat::Float3);
+    auto normalFormat = desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format;
+    bool useNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Float3 ||
+                          normalFormat == cmod::VertexAttributeFormat::Short2);
+    bool usePackedNormalsNow = normalFormat == cmod::VertexAttributeFormat::Short2;
+    bool usePackedPositionsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Position).format
+                                  == cmod::VertexAttributeFormat::Short4);
     bool useColorsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Color0).format
                          != cmod::VertexAttributeFormat::InvalidFormat);
     bool useTexCoordsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Texture0).format
@@ -190,19 +203,52 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
         useStaticPointSizeNow   != useStaticPointSize ||
         useNormalsNow           != useNormals         ||
         useColorsNow            != useColors          ||
-        useTexCoordsNow         != useTexCoords)
+        useTexCoordsNow         != useTexCoords       ||
+        usePackedPositionsNow   != usePackedPositions ||
+        usePackedNormalsNow     != usePackedNormals)
     {
         usePointSize = usePointSizeNow;
         useStaticPointSize = useStaticPointSizeNow;
         useNormals = useNormalsNow;
         useColors = useColorsNow;
         useTexCoords = useTexCoordsNow;
+        usePackedPositions = usePackedPositionsNow;
+        usePackedNormals = usePackedNormalsNow;
         if (getMaterial() != nullptr)
             makeCurrent(*getMaterial());
     }
 }
 
 
+/***** Shadow render context ******/
+
+Shadow_RenderContext::Shadow_RenderContext(Renderer *renderer,
+                                           CelestiaGLProgram *_prog,
+                                           const Eigen::Matrix4f& _projectionMatrix,
+                                           const Eigen::Matrix4f& _modelViewMatrix) :
+    RenderContext(renderer),
+    prog(_prog),
+    projectionMatrix(_projectionMatrix),
+    modelViewMatrix(_modelViewMatrix)
+{
+}
+
+
+void
+Shadow_RenderContext::setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    if (offset == positionOffset && scale == positionScale)
+        return;
+
+    RenderContext::setPositionQuantization(offset, scale);
+
+    // The depth shader reads positions as they are; quantized positions
+    // have w = 1, so the offset and scale can be folded into the matrix.
+    Eigen::Affine3f quantization = Eigen::Translation3f(offset) * Eigen::Scaling(scale);
+    prog->setMVPMatrices(projectionMatrix, modelViewMatrix * quantization.matrix());
+}
+
+
 /***** GLSL render context ******/
 
 GLSL_RenderContext::GLSL_RenderContext(Renderer* renderer,
@@ -352,19 +398,23 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         }
     }
 
+    bool isRingShadowBlurred = false;
     if (lightingState.shadowingRingSystem)
     {
-        Texture* ringsTex = lightingState.shadowingRingSystem->texture.find(medres);
+        Texture* ringsTex = celestia::engine::FindRingShadowTexture(lightingState, medres, isRingShadowBlurred);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + nTextures);
+            gl::activeTexture(GL_TEXTURE0 + nTextures);
             ringsTex->bind();
             textures[nTextures++] = ringsTex;
 
+            // The ring shadow texture already clamps to a transparent border
 #ifdef GL_ES
-            if (celestia::gl::OES_texture_border_clamp)
-            {
+            if (!isRingShadowBlurred && celestia::gl::OES_texture_border_clamp)
+#else
+            if (!isRingShadowBlurred)
 #endif
+            {
                 // Tweak the texture--set clamp to border and a border color with
                 // a zero alpha.
                 float bc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
@@ -375,11 +425,8 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
                 glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR_OES, bc);
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
 #endif
-
-#ifdef GL_ES
             }
-#endif
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
 
             shaderProps.texUsage |= ShaderProperties::RingShadowTexture;
             for (unsigned int lightIndex = 0; lightIndex < lightingState.nLights; lightIndex++)
@@ -405,6 +452,11 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
     if (useColors)
         shaderProps.texUsage |= ShaderProperties::VertexColors;
 
+    if (usePackedPositions)
+        shaderProps.texUsage |= ShaderProperties::PackedPositions;
+    if (usePackedNormals && useNormals)
+        shaderProps.texUsage |= ShaderProperties::PackedNormals;
+
     if (atmosphere != nullptr)
     {
         // Only use new atmosphere code in OpenGL 2.0 path when new style parameters are defined.
@@ -414,27 +466,37 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 
     bool hasShadowMap = shadowMap != 0 && shadowMapWidth != 0 && lightMatrix != nullptr;
     if (hasShadowMap)
+    {
         shaderProps.texUsage |= ShaderProperties::ShadowMapTexture;
+        if (cascadeMatrix != nullptr)
+            shaderProps.texUsage |= ShaderProperties::ShadowCascades;
+    }
 
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
+    program = prog;
     if (prog == nullptr)
         return;
 
     prog->use();
     prog->setMVPMatrices(*projectionMatrix, *modelViewMatrix);
+    if (usePackedPositions)
+    {
+        prog->positionOffset = positionOffset;
+        prog->positionScale = positionScale;
+    }
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        gl::activeTexture(GL_TEXTURE0 + i);
         textures[i]->bind();
     }
 
     if (hasShadowMap)
     {
-        glActiveTexture(GL_TEXTURE0 + nTextures);
-        glBindTexture(GL_TEXTURE_2D, shadowMap);
+        gl::activeTexture(GL_TEXTURE0 + nTextures);
+        gl::bindTexture(GL_TEXTURE_2D, shadowMap);
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 #endif
@@ -443,6 +505,11 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         shadowBias.col(3) = Eigen::Vector4f(0.5f, 0.5f, 0.5f, 1.0f);
         prog->ShadowMatrix0 = shadowBias * (*lightMatrix);
         prog->floatParam("shadowMapSize") = static_cast<float>(shadowMapWidth);
+        if (cascadeMatrix != nullptr)
+        {
+            prog->ShadowMatrix1 = shadowBias * (*cascadeMatrix);
+            prog->shadowCascadeRect = cascadeRect;
+        }
     }
 
     // setLightParameters() expects opacity in the alpha channel of the diffuse color
@@ -499,7 +566,7 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         {
             if (shaderProps.hasRingShadowForLight(lightIndex))
             {
-                prog->ringShadowLOD[lightIndex] = lightingState.ringShadows[lightIndex].texLod;
+                prog->ringShadowLOD[lightIndex] = isRingShadowBlurred ? 0.0f : lightingState.ringShadows[lightIndex].texLod;
             }
         }
     }
@@ -543,6 +610,21 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 }
 
 
+void
+GLSL_RenderContext::setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    if (offset == positionOffset && scale == positionScale)
+        return;
+
+    RenderContext::setPositionQuantization(offset, scale);
+    if (program != nullptr && usePackedPositions)
+    {
+        program->positionOffset = offset;
+        program->positionScale = scale;
+    }
+}
+
+
 void
 GLSL_RenderContext::setAtmosphere(const Atmosphere* _atmosphere)
 {
@@ -562,6 +644,14 @@ GLSL_RenderContext::setShadowMap(GLuint _shadowMap, GLuint _width, const Eigen::
     shadowMap      = _shadowMap;
     shadowMapWidth = _width;
     lightMatrix    = _lightMatrix;
+    cascadeMatrix  = nullptr;
+}
+
+void
+GLSL_RenderContext::setShadowCascade(const Eigen::Matrix4f *_cascadeMatrix, const Eigen::Vector4f& rect)
+{
+    cascadeMatrix = _cascadeMatrix;
+    cascadeRect   = rect;
 }
 
 /***** GLSL-Unlit render context ******/
@@ -623,18 +713,29 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
     if (useColors)
         shaderProps.texUsage |= ShaderProperties::VertexColors;
 
+    if (usePackedPositions)
+        shaderProps.texUsage |= ShaderProperties::PackedPositions;
+    if (usePackedNormals && useNormals)
+        shaderProps.texUsage |= ShaderProperties::PackedNormals;
+
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
+    program = prog;
     if (prog == nullptr)
         return;
 
     prog->use();
     prog->setMVPMatrices(*projectionMatrix, *modelViewMatrix);
+    if (usePackedPositions)
+    {
+        prog->positionOffset = positionOffset;
+        prog->positionScale = positionScale;
+    }
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        gl::activeTexture(GL_TEXTURE0 + i);
         textures[i]->bind();
     }
 
@@ -684,3 +785,18 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
         renderer->setPipelineState(ps);
     }
 }
+
+
+void
+GLSLUnlit_RenderContext::setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    if (offset == positionOffset && scale == positionScale)
+        return;
+
+    RenderContext::setPositionQuantization(offset, scale);
+    if (program != nullptr && usePackedPositions)
+    {
+        program->positionOffset = offset;
+        program->positionScale = scale;
+    }
+}
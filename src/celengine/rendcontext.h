@@ -40,6 +40,8 @@ class RenderContext
     virtual void makeCurrent(const cmod::Material&) = 0;
     virtual void updateShader(const cmod::VertexDescription& desc, cmod::PrimitiveGroupType primType);
     virtual void drawGroup(celestia::gl::VertexObject &vao, const cmod::PrimitiveGroup& group);
+    // Offset and scale of the positions of quantized meshes
+    virtual void setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale);
 
     const cmod::Material* getMaterial() const;
     void setMaterial(const cmod::Material*);
@@ -62,6 +64,11 @@ class RenderContext
     void setCameraOrientation(const Eigen::Quaternionf& q);
     Eigen::Quaternionf getCameraOrientation() const;
 
+    // Pixels per model unit on screen, for choosing the levels of detail of
+    // meshes; 0 draws the full detail
+    void setLodScale(float scale) { lodScale = scale; }
+    float getLodScale() const { return lodScale; }
+
  protected:
     Renderer* renderer { nullptr };
     bool usePointSize{ false };
@@ -69,12 +76,17 @@ class RenderContext
     bool useNormals{ true };
     bool useColors{ false };
     bool useTexCoords{ true };
+    bool usePackedPositions{ false };
+    bool usePackedNormals{ false };
+    Eigen::Vector3f positionOffset{ Eigen::Vector3f::Zero() };
+    Eigen::Vector3f positionScale{ Eigen::Vector3f::Ones() };
 
  private:
     const cmod::Material* material{ nullptr };
     bool locked{ false };
     RenderPass renderPass{ PrimaryPass };
     float pointScale{ 1.0f };
+    float lodScale{ 0.0f };
     Eigen::Quaternionf cameraOrientation;  // required for drawing billboards
 };
 
@@ -82,13 +94,19 @@ class RenderContext
 class Shadow_RenderContext : public RenderContext
 {
  public:
-    Shadow_RenderContext(Renderer *r) :
-        RenderContext(r)
-    {
-    }
+    Shadow_RenderContext(Renderer *r,
+                         CelestiaGLProgram *_prog,
+                         const Eigen::Matrix4f& _projectionMatrix,
+                         const Eigen::Matrix4f& _modelViewMatrix);
     void makeCurrent(const cmod::Material&) override
     {
     }
+    void setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale) override;
+
+ private:
+    CelestiaGLProgram *prog;
+    const Eigen::Matrix4f& projectionMatrix;
+    const Eigen::Matrix4f& modelViewMatrix;
 };
 
 
@@ -110,9 +128,12 @@ class GLSL_RenderContext : public RenderContext
     ~GLSL_RenderContext() override;
 
     void makeCurrent(const cmod::Material&) override;
+    void setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale) override;
     void setLunarLambert(float);
     void setAtmosphere(const Atmosphere*);
     void setShadowMap(GLuint, GLuint, const Eigen::Matrix4f*);
+    // Near cascade of the shadow map, used within rect in the texture
+    void setShadowCascade(const Eigen::Matrix4f*, const Eigen::Vector4f& rect);
 
  private:
     void initLightingEnvironment();
@@ -130,11 +151,14 @@ class GLSL_RenderContext : public RenderContext
     float lunarLambert{ 0.0f };
 
     ShaderProperties shaderProps;
+    CelestiaGLProgram *program { nullptr };
     const Eigen::Matrix4f *modelViewMatrix;
     const Eigen::Matrix4f *projectionMatrix;
     const Eigen::Matrix4f *lightMatrix { nullptr };
     GLuint shadowMap { 0 };
     GLuint shadowMapWidth { 0 };
+    const Eigen::Matrix4f *cascadeMatrix { nullptr };
+    Eigen::Vector4f cascadeRect { Eigen::Vector4f::Zero() };
 };
 
 
@@ -148,6 +172,7 @@ class GLSLUnlit_RenderContext : public RenderContext
     ~GLSLUnlit_RenderContext() override;
 
     void makeCurrent(const cmod::Material&) override;
+    void setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale) override;
 
  private:
     void initLightingEnvironment();
@@ -157,6 +182,7 @@ class GLSLUnlit_RenderContext : public RenderContext
     float objRadius;
 
     ShaderProperties shaderProps;
+    CelestiaGLProgram *program { nullptr };
 
     const Eigen::Matrix4f *modelViewMatrix;
     const Eigen::Matrix4f *projectionMatrix;
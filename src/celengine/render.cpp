@@ -19,6 +19,7 @@
 #include "atmosphere.h"
 #include "body.h"
 #include "location.h"
+#include "locationindex.h"
 #include "render.h"
 #include "boundaries.h"
 #include "dsorenderer.h"
@@ -29,6 +30,10 @@
 #include "lodspheremesh.h"
 #include "geometry.h"
 #include "texmanager.h"
+#include "texturecache.h"
+#include "textureresolution.h"
+#include "textureupload.h"
+#include "virtualtex.h"
 #include "meshmanager.h"
 #include "renderinfo.h"
 #include "renderglsl.h"
@@ -36,15 +41,25 @@
 #include "frametree.h"
 #include "timelinephase.h"
 #include "skygrid.h"
+#include "modelcache.h"
 #include "modelgeometry.h"
 #include "curveplot.h"
 #include "shadermanager.h"
+#include "glmarker.h"
+#include "gpustarculler.h"
+#include "scatteringtables.h"
+#include "shadowatlas.h"
+#include "starfieldcache.h"
+#include "terrain.h"
 #include "rectangle.h"
 #include "framebuffer.h"
+#include "frameprofiler.h"
+#include "perspectiveprojectionmode.h"
 #include "planetgrid.h"
 #include "pointstarvertexbuffer.h"
 #include "pointstarrenderer.h"
 #include "orbitsampler.h"
+#include "orbitsamplingqueue.h"
 #include "rendcontext.h"
 #include "textlayout.h"
 #include <celastro/astro.h>
@@ -68,19 +83,25 @@
 #include <celrender/nebularenderer.h>
 #include <celrender/openclusterrenderer.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/arrayvector.h>
 #include <celutil/logger.h>
+#include <celutil/memoryaccounting.h>
 #include <celutil/utf8.h>
+#include <celutil/taskscheduler.h>
 #include <celutil/timer.h>
 #include <celttf/truetypefont.h>
 #include "glsupport.h"
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
 #include <cassert>
 #include <sstream>
 #include <iomanip>
 #include <numeric>
+#include <tuple>
 #ifdef _MSC_VER
 #include <malloc.h>
 #ifndef alloca
@@ -100,6 +121,10 @@ using celestia::util::GetLogger;
 
 static const int REF_DISTANCE_TO_SCREEN  = 400; //[mm]
 
+// Size of a pixel, in radians at the center of the view, above which the
+// directions of packed star vertices are within a sixth of a pixel
+constexpr float MinPackedStarPixelSize = 4.0e-4f;
+
 // Contribution from planetshine beyond this distance (in units of object radius)
 // is considered insignificant.
 static const float PLANETSHINE_DISTANCE_LIMIT_FACTOR = 100.0f;
@@ -121,6 +146,16 @@ static const float MaxFarNearRatio      = 2000000.0f;
 
 static const float MinRelativeOccluderRadius = 0.005f;
 
+// Ellipsoids at least this large on screen are tested as occluders of the
+// other objects in the render list, the largest ones first
+static const float MinOccluderSizeInPixels = 50.0f;
+static const std::size_t MaxOccluders = 4;
+
+// Range of the size of a pixel relative to a texel of the star field cache
+// in which the cache is used
+static const float MinStarFieldTexelsPerPixel = 0.5f;
+static const float MaxStarFieldTexelsPerPixel = 2.0f;
+
 // The minimum apparent size of an objects orbit in pixels before we display
 // a label for it.  This minimizes label clutter.
 static const float MinOrbitSizeForLabel = 20.0f;
@@ -139,6 +174,10 @@ static const float MaxAsterismLinesConstDist   = 600.0f;
 static const float MaxAsterismLabelsDist = 20.0f;
 static const float MaxAsterismLinesDist  = 6.52e4f;
 
+// Half width in pixels of the widest constellation labels, so that labels
+// centered just outside the view are still drawn
+static const float ConstellationLabelMargin = 256.0f;
+
 // Static meshes and textures used by all instances of Simulation
 
 static bool commonDataInitialized = false;
@@ -156,6 +195,18 @@ static const unsigned int OrbitCacheCullThreshold = 200;
 // Age in frames at which unused orbit paths may be eliminated from the cache
 static const uint32_t OrbitCacheRetireAge = 16;
 
+// Number of intervals of the orbit paths drawn until the background
+// sampling of the orbit has finished
+static const int OrbitPlaceholderSamples = 16;
+
+// Minimum number of children of the root of a frame tree traversed together
+// when the render lists are built on several threads
+static const unsigned int RenderListChunkSize = 256;
+
+// Size in bytes of a segment of the ring buffer of streamed vertices; the
+// ring grows when larger data are written
+static const GLsizeiptr StreamBufferSegmentSize = 1024 * 1024;
+
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
 Color Renderer::DwarfPlanetLabelColor   (0.557f, 0.235f, 0.576f);
@@ -249,6 +300,9 @@ Renderer::Renderer() :
     textureResolution(medres),
     frameCount(0),
     lastOrbitCacheFlush(0),
+    frameProfiler(std::make_unique<celestia::engine::FrameProfiler>()),
+    textureResolutionSelector(std::make_unique<celestia::engine::TextureResolutionSelector>()),
+    terrainManager(std::make_unique<celestia::engine::TerrainManager>()),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
     minFeatureSize(MinFeatureSizeForLabel),
@@ -302,6 +356,15 @@ Renderer::DetailOptions::DetailOptions() :
 }
 
 
+const celestia::engine::ScatteringTables*
+Renderer::getScatteringTables(const Atmosphere& atmosphere, float radius) const
+{
+    if (scatteringTableManager == nullptr)
+        return nullptr;
+    return scatteringTableManager->find(atmosphere, radius);
+}
+
+
 #if 0
 // Not used yet.
 
@@ -528,12 +591,72 @@ bool Renderer::OrbitPathListEntry::operator<(const Renderer::OrbitPathListEntry&
 bool Renderer::init(int winWidth, int winHeight, const DetailOptions& _detailOptions)
 {
     detailOptions = _detailOptions;
+    // Both loops run on the shared workers; 0 uses all of them
+    unsigned int concurrency = util::TaskScheduler::get().getConcurrency();
+    if (detailOptions.renderListThreads == 0)
+        detailOptions.renderListThreads = concurrency;
+    if (detailOptions.starRenderThreads == 0)
+        detailOptions.starRenderThreads = concurrency;
+    if (detailOptions.dsoRenderThreads == 0)
+        detailOptions.dsoRenderThreads = concurrency;
+
+    // Textures change resolution as bodies come closer, which mustn't stall
+    // the frames while they load
+    unsigned int textureLoadThreads = detailOptions.textureLoadThreads;
+    if (detailOptions.autoTextureResolution)
+        textureLoadThreads = std::max(textureLoadThreads, 1u);
+    GetTextureManager()->setAsyncLoading(textureLoadThreads);
+    textureResolutionSelector->setTargetFrameTime(detailOptions.targetFrameTime * 1000.0);
+    textureResolutionSelector->reset();
+    VirtualTexture::setLoaderThreads(detailOptions.textureLoadThreads);
+    VirtualTexture::setTileCacheSize(detailOptions.virtualTextureCacheSize);
+    GetTextureManager()->setMemoryBudget(detailOptions.textureMemoryBudget);
+    GetGeometryManager()->setMemoryBudget(detailOptions.geometryMemoryBudget);
+    // Bodies need their models as soon as they're found, only the nebula
+    // meshes are requested in the background
+    GetGeometryManager()->setAsyncLoading(detailOptions.nebulaLoadThreads, false);
+    m_nebulaRenderer->setUnloadTime(detailOptions.nebulaUnloadTime);
+    SetModelOptimizationEnabled(detailOptions.optimizeModels);
+    celestia::engine::SetModelCacheDirectory(detailOptions.modelCacheDirectory);
+    // Cached textures can only be used with hardware DXT support
+    celestia::engine::SetTextureCacheEnabled(detailOptions.textureCache && gl::EXT_texture_compression_s3tc);
+    SetTextureSizeLimit(static_cast<int>(detailOptions.textureSizeLimit));
+    celestia::engine::GetTextureUploader()->setChunkSize(detailOptions.textureUploadChunkSize);
+    shaderManager->setProgramCacheDirectory(detailOptions.shaderCacheDirectory);
+    // The shaders used are listed next to their binaries
+    if (detailOptions.shaderWarmUpTime > 0.0 && !detailOptions.shaderCacheDirectory.empty())
+        shaderManager->setShaderList(detailOptions.shaderCacheDirectory / "shaders.txt");
+    terrainManager->setTriangleBudget(detailOptions.terrainTriangleBudget);
+    terrainManager->setUploadBudget(detailOptions.terrainUploadBudget);
+    terrainManager->setMemoryBudget(detailOptions.terrainMemoryBudget);
+    if (detailOptions.scatteringTables)
+        scatteringTableManager = std::make_unique<celestia::engine::ScatteringTableManager>();
+    streamBuffer = std::make_unique<celestia::gl::StreamBuffer>(StreamBufferSegmentSize);
+    if (detailOptions.starFieldCacheSize > 0 && FramebufferObject::isSupported())
+    {
+        // The faces are laid out three to a row
+        unsigned int faceSize = std::min(detailOptions.starFieldCacheSize, static_cast<unsigned>(gl::maxTextureSize) / 3);
+        m_starFieldCache = std::make_unique<celestia::engine::StarFieldCache>(faceSize);
+        if (!m_starFieldCache->isValid())
+        {
+            GetLogger()->warn("Error creating star field FBO.\n");
+            m_starFieldCache = nullptr;
+        }
+    }
+
+    if (detailOptions.gpuStarCulling && celestia::engine::GPUStarCuller::isSupported())
+        m_gpuStarCuller = std::make_unique<celestia::engine::GPUStarCuller>(*shaderManager);
+
+    orbitSamplingQueue = nullptr;
+    if (detailOptions.orbitSamplingThreads > 0)
+        orbitSamplingQueue = std::make_unique<celestia::engine::OrbitSamplingQueue>(detailOptions.orbitSamplingThreads);
 
     m_atmosphereRenderer->initGL();
     m_cometRenderer->initGL();
 
     m_markerVO = std::make_unique<celestia::gl::VertexObject>();
     m_markerBO = std::make_unique<celestia::gl::Buffer>();
+    m_markerBatch = std::make_unique<celestia::engine::MarkerBatch>(*this);
 
     // Initialize static meshes and textures common to all instances of Renderer
     if (!commonDataInitialized)
@@ -720,10 +843,19 @@ shared_ptr<celestia::engine::ProjectionMode> Renderer::getProjectionMode() const
 void Renderer::setProjectionMode(shared_ptr<celestia::engine::ProjectionMode> _projectionMode)
 {
     projectionMode = _projectionMode;
+    projectionMode->setSubView(subView);
     projectionMode->configureShaderManager(shaderManager);
     markSettingsChanged();
 }
 
+void Renderer::setSubView(const Eigen::Vector4f& _subView)
+{
+    subView = _subView;
+    if (projectionMode != nullptr)
+        projectionMode->setSubView(subView);
+    markSettingsChanged();
+}
+
 int Renderer::getOrbitMask() const
 {
     return orbitMask;
@@ -865,13 +997,14 @@ void Renderer::getLabelAlignmentInfo(const Annotation &annotation, const Texture
 
 void Renderer::addAnnotation(vector<Annotation>& annotations,
                              const celestia::MarkerRepresentation* markerRep,
-                             const string& labelText,
+                             std::string_view labelText,
                              Color color,
                              const Vector3f& pos,
                              LabelHorizontalAlignment halign,
                              LabelVerticalAlignment valign,
                              float size,
-                             bool special)
+                             bool special,
+                             float priority)
 {
     GLint view[4] = { 0, 0, windowWidth, windowHeight };
     Vector3f win;
@@ -891,51 +1024,55 @@ void Renderer::addAnnotation(vector<Annotation>& annotations,
 
         Annotation a;
         if (!special || markerRep == nullptr)
-             a.labelText = labelText;
+             a.labelText = annotationText.add(labelText);
         a.markerRep = markerRep;
         a.color = color;
         a.position = win;
         a.halign = halign;
         a.valign = valign;
         a.size = size;
+        a.priority = priority;
         annotations.push_back(a);
     }
 }
 
 
 void Renderer::addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
 void Renderer::addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
 void Renderer::addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   std::string_view labelText,
                                    Color color,
                                    const Vector3f& pos,
                                    LabelHorizontalAlignment halign,
                                    LabelVerticalAlignment valign,
-                                   float size)
+                                   float size,
+                                   float priority)
 {
-    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true);
+    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true, priority);
 }
 
 
@@ -1005,7 +1142,7 @@ void Renderer::endObjectAnnotations()
 
 
 void Renderer::addObjectAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   std::string_view labelText,
                                    Color color,
                                    const Vector3f& pos,
                                    LabelHorizontalAlignment halign,
@@ -1085,7 +1222,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     OrbitCache::iterator cached = orbitCache.find(orbit);
     if (cached != orbitCache.end())
     {
-        cachedOrbit = cached->second;
+        cachedOrbit = cached->second.get();
         cachedOrbit->setLastUsed(frameCount);
     }
 
@@ -1113,14 +1250,10 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             }
         }
 
-        cachedOrbit = new CurvePlot(*this);
-        cachedOrbit->setLastUsed(frameCount);
-
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
+        auto newOrbit = sampleOrbitPath(orbit, startTime, startTime + orbit->getPeriod());
+        if (newOrbit == nullptr)
+            return;
+        cachedOrbit = newOrbit.get();
 
         // If the orbit cache is full, first try and eliminate some old orbits
         if (orbitCache.size() > OrbitCacheCullThreshold)
@@ -1141,7 +1274,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             }
         }
 
-        orbitCache[orbit] = cachedOrbit;
+        orbitCache[orbit] = std::move(newOrbit);
     }
 
     if (cachedOrbit->empty())
@@ -1185,7 +1318,16 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
         double newWindowStart = startTime - period * WindowSlack;
         double newWindowEnd = endTime + period * WindowSlack;
 
-        if (startTime < currentWindowStart)
+        if (orbitSamplingQueue != nullptr && orbit->isThreadSafe() &&
+            (newWindowEnd <= currentWindowStart || newWindowStart >= currentWindowEnd))
+        {
+            // After a jump in time none of the samples can be reused, so
+            // the whole window is sampled in the background
+            auto newOrbit = sampleOrbitPath(orbit, newWindowStart, newWindowEnd);
+            cachedOrbit = newOrbit.get();
+            orbitCache[orbit] = std::move(newOrbit);
+        }
+        else if (startTime < currentWindowStart)
         {
             // Remove samples at the end of the time window
             cachedOrbit->removeSamplesAfter(newWindowEnd);
@@ -1305,13 +1447,66 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 }
 
 
-// Convert a position in the universal coordinate system to astrocentric
-// coordinates, taking into account possible orbital motion of the star.
-static Vector3d astrocentricPosition(const UniversalCoord& pos,
-                                     const Star& star,
-                                     double t)
+// Create the path of an orbit which isn't in the orbit cache. Thread-safe
+// orbits are sampled on the worker threads, if there are any; the path is
+// drawn from a few samples until they are done. The other orbits are
+// sampled immediately, but when there are worker threads, only as long as
+// the time budget of the frame allows. Return nullptr if the orbit should
+// be sampled in a later frame.
+std::unique_ptr<CurvePlot>
+Renderer::sampleOrbitPath(const celestia::ephem::Orbit* orbit,
+                          double startTime,
+                          double endTime)
+{
+    auto plot = std::make_unique<CurvePlot>(*this, detailOptions.residentOrbitPaths);
+    plot->setLastUsed(frameCount);
+
+    if (orbitSamplingQueue != nullptr && orbit->isThreadSafe())
+    {
+        orbitSamplingQueue->request(orbit, startTime, endTime);
+        for (int i = 0; i <= OrbitPlaceholderSamples; i++)
+        {
+            CurvePlotSample sample;
+            sample.t = startTime + (endTime - startTime) * i / OrbitPlaceholderSamples;
+            sample.position = orbit->positionAtTime(sample.t);
+            sample.velocity = orbit->velocityAtTime(sample.t);
+            plot->addSample(sample);
+        }
+        return plot;
+    }
+
+    if (orbitSamplingQueue != nullptr && std::chrono::steady_clock::now() > orbitSamplingDeadline)
+        return nullptr;
+
+    OrbitSampler sampler;
+    orbit->sample(startTime, endTime, sampler);
+    sampler.insertForward(plot.get());
+    return plot;
+}
+
+
+// Replace the placeholder paths of the orbits sampled in the background, as
+// far as the time budget of the frame allows.
+void Renderer::addSampledOrbitPaths()
 {
-    return pos.offsetFromKm(star.getPosition(t));
+    if (orbitSamplingQueue == nullptr)
+        return;
+
+    celestia::engine::OrbitSamplingQueue::Result result;
+    while (std::chrono::steady_clock::now() < orbitSamplingDeadline &&
+           orbitSamplingQueue->takeResult(result))
+    {
+        // The path may have been retired while the orbit was sampled
+        auto cached = orbitCache.find(result.orbit);
+        if (cached == orbitCache.end() || result.samples.empty())
+            continue;
+
+        auto plot = std::make_unique<CurvePlot>(*this, detailOptions.residentOrbitPaths);
+        plot->setLastUsed(cached->second->lastUsed());
+        for (const auto& sample : result.samples)
+            plot->addSample(sample);
+        cached->second = std::move(plot);
+    }
 }
 
 
@@ -1346,13 +1541,11 @@ static Color legacyTintColor(float temp)
 }
 
 
-// Set up the light sources for rendering a solar system.  The positions of
-// all nearby stars are converted from universal to viewer-centered
-// coordinates.
+// Set up the light sources for rendering a solar system from the nearby
+// stars and their viewer-centered positions.
 static void
 setupLightSources(const vector<const Star*>& nearStars,
-                  const UniversalCoord& observerPos,
-                  double t,
+                  const vector<Vector3d>& starOffsets,
                   vector<LightSource>& lightSources,
                   float tintSaturation,
                   const ColorTemperatureTable* tintColors)
@@ -1365,13 +1558,13 @@ setupLightSources(const vector<const Star*>& nearStars,
 
     lightSources.clear();
 
-    for (const auto star : nearStars)
+    for (std::size_t i = 0; i < nearStars.size(); ++i)
     {
+        const Star* star = nearStars[i];
         if (star->getVisibility())
         {
-            Vector3d v = star->getPosition(t).offsetFromKm(observerPos);
             LightSource ls;
-            ls.position = v;
+            ls.position = starOffsets[i];
             ls.luminosity = star->getLuminosity();
             ls.radius = star->getRadius();
 
@@ -1489,7 +1682,48 @@ void Renderer::render(const Observer& observer,
     realTime = observer.getRealTime();
 
     frameCount++;
+    eclipseShadowCache.nextFrame(OrbitCacheRetireAge);
+    bool starFieldChanged = settingsChanged;
     settingsChanged = false;
+    // Faint stars paged in or out change the star field as well
+    if (auto starTiles = universe.getStarTiles(); starTiles != nullptr)
+        starFieldChanged = starTiles->update() || starFieldChanged;
+    if (starFieldChanged && m_pointStarProgress != nullptr)
+        m_pointStarProgress->restart();
+
+    frameProfiler->beginFrame();
+
+    if (detailOptions.autoTextureResolution)
+    {
+        textureResolutionSelector->update(*frameProfiler,
+                                          GetTextureManager()->getResidentSize(),
+                                          GetTextureManager()->getMemoryBudget());
+    }
+
+    // Create the textures whose images were loaded in the background since
+    // the last frame, as far as the time budget allows
+    auto uploadTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(detailOptions.textureUploadTime));
+    GetTextureManager()->processPending(uploadTime);
+    GetGeometryManager()->processPending(uploadTime);
+    // Continue the uploads of large textures created in earlier frames
+    celestia::engine::GetTextureUploader()->process(uploadTime);
+
+    // Upload the terrain chunks built in the background since the last frame
+    terrainManager->beginFrame();
+    // Shadow maps which weren't used in the last frame are rendered again
+    if (m_shadowAtlas != nullptr)
+        m_shadowAtlas->beginFrame();
+
+    // Build the shaders expected to be used before they're needed
+    shaderManager->processPending(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(detailOptions.shaderWarmUpTime)));
+
+    // Replace the placeholders of orbit paths sampled in the background
+    orbitSamplingDeadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(detailOptions.orbitSamplingTime));
+    addSampledOrbitPaths();
 
     // Compute the size of a pixel
     float zoom = observer.getZoom();
@@ -1525,11 +1759,14 @@ void Renderer::render(const Observer& observer,
     foregroundAnnotations.clear();
     backgroundAnnotations.clear();
     objectAnnotations.clear();
+    annotationText.clear();
+    frameArena.reset();
 
     // Put all solar system bodies into the render list.  Stars close and
     // large enough to have discernible surface detail are also placed in
     // renderList.
     renderList.clear();
+    pointBodyList.clear();
     orbitPathList.clear();
     lightSourceList.clear();
     secondaryIlluminators.clear();
@@ -1549,6 +1786,7 @@ void Renderer::render(const Observer& observer,
     faintestPlanetMag = faintestMag;
     if ((renderFlags & (ShowSolarSystemObjects | ShowOrbits)) != 0)
     {
+        FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::RenderLists);
         buildNearSystemsLists(universe, observer, xfrustum, now);
     }
 
@@ -1584,22 +1822,50 @@ void Renderer::render(const Observer& observer,
 
     ambientColor = Color(ambientLightLevel, ambientLightLevel, ambientLightLevel);
 
+    if (detailOptions.stereoSeparation > 0.0f && projectionMode->supportsStereo())
+        renderStereo(observer, universe, sel, frustum, xfrustum, now, starFieldChanged);
+    else
+        renderEye(Eye::Center, observer, universe, sel, frustum, xfrustum, now, starFieldChanged);
+
+    frameProfiler->endFrame();
+}
+
+
+void Renderer::renderEye(Eye eye,
+                         const Observer& observer,
+                         const Universe& universe,
+                         const Selection& sel,
+                         const math::Frustum& frustum,
+                         const math::Frustum& xfrustum,
+                         double now,
+                         bool starFieldChanged)
+{
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Render sky grids first--these will always be in the background
     renderSkyGrids(observer);
 
+    // Draw the distant stars and deep sky objects around a stationary
+    // observer from the star field cache
+    bool cachedStarField = renderCachedStarField(universe, observer, faintestMag, starFieldChanged);
+
     // Render deep sky objects
-    if ((renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
+    if (!cachedStarField && (renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
     {
-        renderDeepSkyObjects(universe, observer, faintestMag);
+        FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::DeepSkyObjects);
+        renderDeepSkyObjects(universe, observer, faintestMag, observer.getZoom());
     }
 
-    // Render stars
+    // Render stars, only the close ones when the distant ones are cached
     if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != nullptr)
     {
-        renderPointStars(*universe.getStarCatalog(), faintestMag, observer);
+        FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::Stars);
+        if (cachedStarField)
+            renderPointStars(*universe.getStarCatalog(), faintestMag, observer, 0.0f, celestia::engine::StarFieldCache::NearStarDistance);
+        else
+            renderPointStars(*universe.getStarCatalog(), faintestMag, observer, 0.0f,
+                             std::numeric_limits<float>::infinity(), universe.getStarTiles());
     }
 
     // Translate the camera before rendering the asterisms and boundaries
@@ -1613,8 +1879,13 @@ void Renderer::render(const Observer& observer,
     Matrices asterismMVP = { &projection, &modelView };
 
     float dist = observerPosLY.norm() * 1.6e4f;
-    renderAsterisms(universe, dist, asterismMVP);
-    renderBoundaries(universe, dist, asterismMVP);
+    renderAsterisms(universe, dist, asterismMVP, xfrustum, -observerPosLY);
+    renderBoundaries(universe, dist, asterismMVP, xfrustum, -observerPosLY);
+
+    // Hide the text of star, deep sky object and body labels overlapping
+    // more important ones
+    if (detailOptions.declutterLabels)
+        declutterLabels();
 
     // Render star and deep sky object labels
     renderBackgroundAnnotations(FontNormal);
@@ -1622,40 +1893,71 @@ void Renderer::render(const Observer& observer,
     // Render constellations labels
     if ((labelMode & ConstellationLabels) != 0 && universe.getAsterisms() != nullptr)
     {
-        labelConstellations(*universe.getAsterisms(), observer);
+        labelConstellations(*universe.getAsterisms(), observer, xfrustum);
         renderBackgroundAnnotations(FontLarge);
     }
 
-    if ((renderFlags & ShowMarkers) != 0)
+    bool selectionVisible = false;
+    if (eye == Eye::Right)
     {
-        markersToAnnotations(universe.getMarkers(), observer, now);
+        backgroundAnnotations = stereoBackgroundAnnotations;
+        selectionVisible = m_stereoSelectionVisible;
     }
-
-    // Draw the selection cursor
-    bool selectionVisible = false;
-    if (!sel.empty() && (renderFlags & ShowMarkers) != 0)
+    else
     {
-        selectionVisible = selectionToAnnotation(sel, observer, xfrustum, now);
+        if ((renderFlags & ShowMarkers) != 0)
+        {
+            markersToAnnotations(universe.getMarkers(), observer, now);
+        }
+
+        // Draw the selection cursor
+        if (!sel.empty() && (renderFlags & ShowMarkers) != 0)
+        {
+            selectionVisible = selectionToAnnotation(sel, observer, xfrustum, now);
+        }
+
+        if (eye == Eye::Left)
+        {
+            stereoBackgroundAnnotations = backgroundAnnotations;
+            m_stereoSelectionVisible = selectionVisible;
+        }
     }
 
     // Render background markers; rendering of other markers is deferred until
     // solar system objects are rendered.
     renderBackgroundAnnotations(FontNormal);
 
-    removeInvisibleItems(frustum);
-
-    // Sort the annotations
-    sort(depthSortedAnnotations.begin(), depthSortedAnnotations.end());
-
-    // Sort the orbit paths
-    sort(orbitPathList.begin(), orbitPathList.end());
-
 #ifndef GL_ES
     glPolygonMode(GL_FRONT_AND_BACK, (GLenum) renderMode);
 #endif
 
-    int nIntervals = buildDepthPartitions();
-    renderSolarSystemObjects(observer, nIntervals, now);
+    m_reversedDepth = canUseReversedDepth();
+    int nIntervals;
+    if (eye == Eye::Right)
+    {
+        foregroundAnnotations = stereoForegroundAnnotations;
+        nIntervals = m_stereoIntervals;
+    }
+    else
+    {
+        removeInvisibleItems(frustum);
+
+        sortAnnotations();
+
+        // Sort the orbit paths
+        sort(orbitPathList.begin(), orbitPathList.end());
+
+        nIntervals = buildDepthPartitions();
+        if (eye == Eye::Left)
+        {
+            stereoForegroundAnnotations = foregroundAnnotations;
+            m_stereoIntervals = nIntervals;
+        }
+    }
+    {
+        FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::SolarSystem);
+        renderSolarSystemObjects(observer, nIntervals, now);
+    }
 
     renderForegroundAnnotations(FontNormal);
 
@@ -1669,6 +1971,66 @@ void Renderer::render(const Observer& observer,
 #endif
 }
 
+// Render the views of both eyes side by side in the viewport. The render
+// lists and label positions are those of the center of the view, so that
+// labels appear at screen depth; the stars are traversed again but drawn
+// as being at infinity.
+void Renderer::renderStereo(const Observer& observer,
+                            const Universe& universe,
+                            const Selection& sel,
+                            const math::Frustum& frustum,
+                            const math::Frustum& xfrustum,
+                            double now,
+                            bool starFieldChanged)
+{
+    // The nearest object appears at screen depth, with the eyes as far
+    // apart as the separation times its distance
+    float screenDistance = std::numeric_limits<float>::infinity();
+    for (const auto& rle : renderList)
+    {
+        if (rle.distance > rle.radius)
+            screenDistance = std::min(screenDistance, rle.distance - rle.radius);
+    }
+
+    std::array<int, 4> viewport = m_viewport;
+    bool scissor = m_pipelineState.scissor;
+    std::array<GLint, 4> scissorBox;
+    glGetIntegerv(GL_SCISSOR_BOX, scissorBox.data());
+    Matrix4f centerProjMatrix = m_projMatrix;
+    Matrix4f centerMVPMatrix = m_MVPMatrix;
+
+    int leftWidth = viewport[2] / 2;
+    for (Eye eye : { Eye::Left, Eye::Right })
+    {
+        int x = eye == Eye::Left ? viewport[0] : viewport[0] + leftWidth;
+        int width = eye == Eye::Left ? leftWidth : viewport[2] - leftWidth;
+        setViewport(x, viewport[1], width, viewport[3]);
+        // Keep the other eye from being cleared
+        setScissor(x, viewport[1], width, viewport[3]);
+
+        m_eyeShift = detailOptions.stereoSeparation * (eye == Eye::Left ? -0.5f : 0.5f);
+        m_eyeOffset = std::isinf(screenDistance) ? 0.0f : m_eyeShift * screenDistance;
+        // Outside of the solar system the units of the camera space are
+        // light years, where the eyes are at the same place
+        m_projMatrix = projectionMode->getEyeProjectionMatrix(centerProjMatrix, m_eyeShift, 0.0f);
+        m_MVPMatrix = m_projMatrix * m_modelMatrix;
+
+        renderEye(eye, observer, universe, sel, frustum, xfrustum, now, starFieldChanged);
+    }
+
+    m_eyeShift = 0.0f;
+    m_eyeOffset = 0.0f;
+    m_projMatrix = centerProjMatrix;
+    m_MVPMatrix = centerMVPMatrix;
+    setViewport(viewport);
+    if (scissor)
+        setScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+    else
+        removeScissor();
+    stereoBackgroundAnnotations.clear();
+    stereoForegroundAnnotations.clear();
+}
+
 static Eigen::Vector3f
 calculateQuadCenter(const Eigen::Quaternionf &cameraOrientation,
                     const Eigen::Vector3f &position,
@@ -1728,6 +2090,45 @@ Renderer::calculatePointSize(float appMag,
     }
 }
 
+
+// Compute the size and opacity of the sprites of an object drawn as a
+// point. Return false if the object is too large to be drawn as one.
+bool Renderer::calculatePointSprites(float appMag,
+                                     float discSizeInPixels,
+                                     bool emissive,
+                                     float &pointSize,
+                                     float &alpha,
+                                     float &glareSize,
+                                     float &glareAlpha) const
+{
+    const bool useScaledDiscs = starStyle == ScaledDiscStars;
+    float maxDiscSize = useScaledDiscs ? MaxScaledDiscStarSize : 1.0f;
+    float maxBlendDiscSize = maxDiscSize + 3.0f;
+
+    float fade = 1.0f;
+    if (discSizeInPixels > maxDiscSize)
+    {
+        fade = std::min(1.0f, (maxBlendDiscSize - discSizeInPixels) /
+                              (maxBlendDiscSize - maxDiscSize));
+    }
+
+    float scale = static_cast<float>(screenDpi) / 96.0f;
+    calculatePointSize(appMag, BaseStarDiscSize * scale, pointSize, alpha, glareSize, glareAlpha);
+
+    if (useScaledDiscs && discSizeInPixels > MaxScaledDiscStarSize)
+        glareAlpha = std::min(glareAlpha, (MaxScaledDiscStarSize - discSizeInPixels) / MaxScaledDiscStarSize + 1.0f);
+
+    alpha *= fade;
+    if (!emissive)
+        glareAlpha *= fade;
+
+    if (glareSize != 0.0f)
+        glareSize = std::max(glareSize, pointSize * discSizeInPixels / scale * 3.0f);
+
+    return discSizeInPixels < maxBlendDiscSize;
+}
+
+
 // If the an object occupies a pixel or less of screen space, we don't
 // render its mesh at all and just display a starlike point instead.
 // Switching between the particle and mesh renderings of an object is
@@ -1743,33 +2144,9 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
                                    bool emissive,
                                    const Matrices &mvp)
 {
-    const bool useScaledDiscs = starStyle == ScaledDiscStars;
-    float maxDiscSize = useScaledDiscs ? MaxScaledDiscStarSize : 1.0f;
-    float maxBlendDiscSize = maxDiscSize + 3.0f;
-
-    if (discSizeInPixels < maxBlendDiscSize || useHalos)
+    float pointSize, alpha, glareSize, glareAlpha;
+    if (calculatePointSprites(appMag, discSizeInPixels, emissive, pointSize, alpha, glareSize, glareAlpha) || useHalos)
     {
-        float fade = 1.0f;
-        if (discSizeInPixels > maxDiscSize)
-        {
-            fade = std::min(1.0f, (maxBlendDiscSize - discSizeInPixels) /
-                                  (maxBlendDiscSize - maxDiscSize));
-        }
-
-        float scale = static_cast<float>(screenDpi) / 96.0f;
-        float pointSize, alpha, glareSize, glareAlpha;
-        calculatePointSize(appMag, BaseStarDiscSize * scale, pointSize, alpha, glareSize, glareAlpha);
-
-        if (useScaledDiscs && discSizeInPixels > MaxScaledDiscStarSize)
-            glareAlpha = std::min(glareAlpha, (MaxScaledDiscStarSize - discSizeInPixels) / MaxScaledDiscStarSize + 1.0f);
-
-        alpha *= fade;
-        if (!emissive)
-            glareAlpha *= fade;
-
-        if (glareSize != 0.0f)
-            glareSize = std::max(glareSize, pointSize * discSizeInPixels / scale * 3.0f);
-
         Renderer::PipelineState ps;
         ps.blending = true;
         ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
@@ -1803,6 +2180,55 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
 }
 
 
+// Draw the bodies in a depth buffer interval which are only visible as
+// points. They are added to the point sprite buffer with the same state,
+// so that they are drawn with a few draw calls. Bodies don't have halos.
+void Renderer::renderPointBodies(int interval, const Matrices &mvp)
+{
+    std::size_t first = pointBodyIntervals[interval];
+    std::size_t last = pointBodyIntervals[interval + 1];
+    if (first == last)
+        return;
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
+    ps.depthTest = true;
+    setPipelineState(ps);
+
+    if (starStyle != PointStars)
+        gaussianDiscTex->bind();
+
+    if (starStyle == PointStars)
+        pointStarVertexBuffer->startBasicPoints();
+    else
+        pointStarVertexBuffer->startSprites();
+
+    // Index, size and opacity of the points too large for the sprites
+    auto largePoints = makeFrameVector<std::tuple<std::size_t, float, float>>();
+    for (std::size_t i = first; i < last; i++)
+    {
+        const PointBodyEntry& entry = pointBodyList[i];
+        float pointSize, alpha, glareSize, glareAlpha;
+        if (!calculatePointSprites(entry.appMag, entry.discSizeInPixels, false, pointSize, alpha, glareSize, glareAlpha))
+            continue;
+
+        if (pointSize > gl::maxPointSize)
+            largePoints.emplace_back(i, pointSize, alpha);
+        else
+            pointStarVertexBuffer->addStar(entry.position, {entry.color, alpha}, pointSize);
+    }
+
+    // The large points use another shader, so the buffer is flushed first
+    if (largePoints.empty())
+        return;
+
+    pointStarVertexBuffer->finish();
+    for (const auto& [i, pointSize, alpha] : largePoints)
+        m_largeStarRenderer->render(pointBodyList[i].position, {pointBodyList[i].color, alpha}, pointSize, mvp);
+}
+
+
 static void renderSphereUnlit(const RenderInfo& ri,
                               const math::Frustum& frustum,
                               const Matrices &m,
@@ -1885,7 +2311,6 @@ Renderer::locationsToAnnotations(const Body& body,
                                  const Quaterniond& bodyOrientation)
 {
     assert(body.hasLocations());
-    auto locations = body.getLocations();
 
     Vector3f semiAxes = body.getSemiAxes();
 
@@ -1903,11 +2328,11 @@ Renderer::locationsToAnnotations(const Body& body,
 
     Matrix3d bodyMatrix = bodyOrientation.conjugate().toRotationMatrix();
 
-    for (const auto location : *locations)
+    // The index only visits the locations which may pass the size and
+    // visibility tests below, from the largest to the smallest
+    auto process = [&](const Location* location)
     {
         auto featureType = location->getFeatureType();
-        if ((featureType & locationFilter) == 0)
-            continue;
 
         // Get the position of the location with respect to the planet center
         Vector3f ppos = location->getPosition();
@@ -1929,7 +2354,7 @@ Renderer::locationsToAnnotations(const Body& body,
         if (float pixSize = effSize / (float) (labelPos.norm() * pixelSize);
             pixSize <= minFeatureSize || labelPos.dot(viewNormal) <= 0.0)
         {
-            continue;
+            return;
         }
 
         // Labels on non-ellipsoidal bodies need special handling; the
@@ -1956,7 +2381,7 @@ Renderer::locationsToAnnotations(const Body& body,
         if (bool hit = testIntersection(testRay, bodyEllipsoid, t);
             hit && t < 1.0)
         {
-            continue;
+            return;
         }
 
         // Calculate the intersection of the eye-to-label ray with the plane perpendicular to
@@ -1987,7 +2412,13 @@ Renderer::locationsToAnnotations(const Body& body,
                             labelPos.cast<float>(),
                             LabelHorizontalAlignment::Start,
                             LabelVerticalAlignment::Bottom);
-    }
+    };
+
+    body.getLocationIndex()->query(viewRayOrigin,
+                                   static_cast<double>(minFeatureSize) * pixelSize,
+                                   locationFilter,
+                                   body.isEllipsoid(),
+                                   process);
 }
 
 
@@ -2195,6 +2626,14 @@ setupObjectLighting(const vector<LightSource>& suns,
 }
 
 
+unsigned int Renderer::getObjectTextureResolution(float discSizeInPixels) const
+{
+    return detailOptions.autoTextureResolution
+        ? textureResolutionSelector->select(discSizeInPixels)
+        : textureResolution;
+}
+
+
 void Renderer::renderObject(const Vector3f& pos,
                             float distance,
                             const Observer& observer,
@@ -2206,6 +2645,7 @@ void Renderer::renderObject(const Vector3f& pos,
 {
     RenderInfo ri;
     double now = observer.getTime();
+    unsigned int resolution = getObjectTextureResolution(obj.radius / (distance * pixelSize));
 
     float altitude = distance - obj.radius;
     float discSizeInPixels = obj.radius / (max(nearPlaneDistance, altitude) * pixelSize);
@@ -2230,18 +2670,18 @@ void Renderer::renderObject(const Vector3f& pos,
     }
 
     // Get the textures . . .
-    if (obj.surface->baseTexture.tex[textureResolution] != InvalidResource)
-        ri.baseTex = obj.surface->baseTexture.find(textureResolution);
+    if (obj.surface->baseTexture.tex[resolution] != InvalidResource)
+        ri.baseTex = obj.surface->baseTexture.find(resolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyBumpMap) != 0 &&
-        obj.surface->bumpTexture.tex[textureResolution] != InvalidResource)
-        ri.bumpTex = obj.surface->bumpTexture.find(textureResolution);
+        obj.surface->bumpTexture.tex[resolution] != InvalidResource)
+        ri.bumpTex = obj.surface->bumpTexture.find(resolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyNightMap) != 0 &&
         (renderFlags & ShowNightMaps) != 0)
-        ri.nightTex = obj.surface->nightTexture.find(textureResolution);
+        ri.nightTex = obj.surface->nightTexture.find(resolution);
     if ((obj.surface->appearanceFlags & Surface::SeparateSpecularMap) != 0)
-        ri.glossTex = obj.surface->specularTexture.find(textureResolution);
+        ri.glossTex = obj.surface->specularTexture.find(resolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyOverlay) != 0)
-        ri.overlayTex = obj.surface->overlayTexture.find(textureResolution);
+        ri.overlayTex = obj.surface->overlayTexture.find(resolution);
 
     // Scaling will be nonuniform for nonspherical planets. As long as the
     // deviation from spherical isn't too large, the nonuniform scale factor
@@ -2288,6 +2728,17 @@ void Renderer::renderObject(const Vector3f& pos,
     ri.orientation = getCameraOrientationf() * obj.orientation.conjugate();
 
     ri.pixWidth = discSizeInPixels;
+    ri.pixelSize = pixelSize;
+    ri.lodScale = scaleFactors.maxCoeff() / (max(nearPlaneDistance, altitude) * pixelSize);
+
+    // Bodies with height maps are drawn from displaced chunks
+    if (geometry == nullptr &&
+        !obj.surface->heightMap.empty() &&
+        obj.surface->heightScale > 0.0f)
+    {
+        float relief = obj.surface->heightScale / (obj.radius * obj.semiAxes.maxCoeff());
+        ri.terrain = terrainManager->find(obj.surface->heightMap, relief);
+    }
 
     // Set up the colors
     if (ri.baseTex == nullptr ||
@@ -2367,10 +2818,10 @@ void Renderer::renderObject(const Vector3f& pos,
     {
         if ((renderFlags & ShowCloudMaps) != 0)
         {
-            if (atmosphere->cloudTexture.tex[textureResolution] != InvalidResource)
-                cloudTex = atmosphere->cloudTexture.find(textureResolution);
-            if (atmosphere->cloudNormalMap.tex[textureResolution] != InvalidResource)
-                cloudNormalMap = atmosphere->cloudNormalMap.find(textureResolution);
+            if (atmosphere->cloudTexture.tex[resolution] != InvalidResource)
+                cloudTex = atmosphere->cloudTexture.find(resolution);
+            if (atmosphere->cloudNormalMap.tex[resolution] != InvalidResource)
+                cloudNormalMap = atmosphere->cloudNormalMap.find(resolution);
         }
         if (atmosphere->cloudSpeed != 0.0f)
             cloudTexOffset = (float) (-math::pfmod(now * atmosphere->cloudSpeed * 0.5 * celestia::numbers::inv_pi, 1.0));
@@ -2384,7 +2835,7 @@ void Renderer::renderObject(const Vector3f& pos,
             renderEllipsoid_GLSL(ri, ls,
                                  atmosphere, cloudTexOffset,
                                  scaleFactors,
-                                 textureResolution,
+                                 resolution,
                                  renderFlags,
                                  obj.orientation,
                                  viewFrustum,
@@ -2399,7 +2850,7 @@ void Renderer::renderObject(const Vector3f& pos,
     {
         if (geometry != nullptr)
         {
-            ResourceHandle texOverride = obj.surface->baseTexture.tex[textureResolution];
+            ResourceHandle texOverride = obj.surface->baseTexture.tex[resolution];
 
             if (lit)
             {
@@ -2425,7 +2876,7 @@ void Renderer::renderObject(const Vector3f& pos,
                                           astro::daysToSecs(now - astro::J2000),
                                           planetMVP, this);
             }
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
         }
     }
 
@@ -2438,7 +2889,7 @@ void Renderer::renderObject(const Vector3f& pos,
         {
             renderRings_GLSL(*obj.rings, ri, ls,
                              radius, 1.0f - obj.semiAxes.y(),
-                             textureResolution,
+                             resolution,
                              (renderFlags & ShowRingShadows) != 0 && lit,
                              segmentSizeInPixels,
                              ringsMVP, true, this);
@@ -2468,6 +2919,7 @@ void Renderer::renderObject(const Vector3f& pos,
         {
             // Only use new atmosphere code in OpenGL 2.0 path when new style parameters are defined.
             // TODO: convert old style atmopshere parameters
+            FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::Atmospheres);
             if (atmosphere->mieScaleHeight > 0.0f)
             {
                 float atmScale = 1.0f + atmosphere->height / radius;
@@ -2530,7 +2982,7 @@ void Renderer::renderObject(const Vector3f& pos,
                                   cloudNormalMap,
                                   cloudTexOffset,
                                   scaleFactors,
-                                  textureResolution,
+                                  resolution,
                                   renderFlags,
                                   obj.orientation,
                                   viewFrustum,
@@ -2550,7 +3002,7 @@ void Renderer::renderObject(const Vector3f& pos,
     {
         if (lit && (renderFlags & ShowRingShadows) != 0)
         {
-            Texture* ringsTex = obj.rings->texture.find(textureResolution);
+            Texture* ringsTex = obj.rings->texture.find(resolution);
             if (ringsTex != nullptr)
                 ringsTex->bind();
         }
@@ -2559,7 +3011,7 @@ void Renderer::renderObject(const Vector3f& pos,
         {
             renderRings_GLSL(*obj.rings, ri, ls,
                              radius, 1.0f - obj.semiAxes.y(),
-                             textureResolution,
+                             resolution,
                              (renderFlags & ShowRingShadows) != 0 && lit,
                              segmentSizeInPixels,
                              ringsMVP, false, this);
@@ -2569,7 +3021,9 @@ void Renderer::renderObject(const Vector3f& pos,
 
 
 bool Renderer::testEclipse(const Body& receiver,
+                           const Vector3d& posReceiver,
                            const Body& caster,
+                           const Vector3d& posCaster,
                            LightingState& lightingState,
                            unsigned int lightIndex,
                            double now)
@@ -2597,9 +3051,6 @@ bool Renderer::testEclipse(const Body& receiver,
         // less than the distance between the sun and the receiver.  This
         // approximation works everywhere in the solar system, and is likely
         // valid for any orbitally stable pair of objects orbiting a star.
-        Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Vector3d posCaster = caster.getAstrocentricPosition(now);
-
         //const Star* sun = receiver.getSystem()->getStar();
         //assert(sun != nullptr);
         //double distToSun = posReceiver.distanceFromOrigin();
@@ -2812,8 +3263,38 @@ void Renderer::renderPlanet(Body& body,
 
         // Calculate eclipse circumstances
         if ((renderFlags & ShowEclipseShadows) != 0 &&
-            body.getSystem() != nullptr)
+            body.getSystem() != nullptr &&
+            !eclipseShadowCache.apply(body, now, bodyVisibilityMask, lights))
         {
+            // Keep the ring shadows of the body itself apart from those of
+            // the casters in the cache
+            RingShadow ringShadows[MaxLights];
+            std::copy(lights.ringShadows, lights.ringShadows + MaxLights, ringShadows);
+
+            Vector3d posReceiver = body.getAstrocentricPosition(now);
+            float minCasterRadius = body.getRadius() * MinRelativeOccluderRadius;
+
+            // Test the casters of a system, skipping all of them when the
+            // receiver is outside the shadow volume bounding the system
+            auto testCasters = [&](const engine::EclipseCasterSet& casters, unsigned int li)
+            {
+                const DirectionalLight& light = lights.lights[li];
+                if (!casters.mayShadow(posReceiver, body.getRadius(),
+                                       posReceiver + light.position, light.apparentSize))
+                {
+                    return;
+                }
+
+                for (const engine::EclipseCaster& caster : casters.casters)
+                {
+                    // The casters are sorted by decreasing radius
+                    if (caster.radius < minCasterRadius)
+                        break;
+                    if (caster.body != &body)
+                        testEclipse(body, posReceiver, *caster.body, caster.position, lights, li, now);
+                }
+            };
+
             PlanetarySystem* system = body.getSystem();
             if (system->getPrimaryBody() == nullptr)
             {
@@ -2822,21 +3303,17 @@ void Renderer::renderPlanet(Body& body,
                 PlanetarySystem* satellites = body.getSatellites();
                 if (satellites != nullptr)
                 {
-                    int nSatellites = satellites->getSystemSize();
+                    const engine::EclipseCasterSet& casters = eclipseCasters.get(*satellites, now);
                     for (unsigned int li = 0; li < lights.nLights; li++)
                     {
                         if (lights.lights[li].castsShadows)
-                        {
-                            for (int i = 0; i < nSatellites; i++)
-                            {
-                                testEclipse(body, *satellites->getBody(i), lights, li, now);
-                            }
-                        }
+                            testCasters(casters, li);
                     }
                 }
             }
             else
             {
+                const engine::EclipseCasterSet& casters = eclipseCasters.get(*system, now);
                 for (unsigned int li = 0; li < lights.nLights; li++)
                 {
                     if (lights.lights[li].castsShadows)
@@ -2849,24 +3326,20 @@ void Renderer::renderPlanet(Body& body,
                         Body* planet = system->getPrimaryBody();
                         while (planet != nullptr)
                         {
-                            testEclipse(body, *planet, lights, li, now);
+                            testEclipse(body, posReceiver, *planet, planet->getAstrocentricPosition(now),
+                                        lights, li, now);
                             if (planet->getSystem() != nullptr)
                                 planet = planet->getSystem()->getPrimaryBody();
                             else
                                 planet = nullptr;
                         }
 
-                        int nSatellites = system->getSystemSize();
-                        for (int i = 0; i < nSatellites; i++)
-                        {
-                            if (system->getBody(i) != &body)
-                            {
-                                testEclipse(body, *system->getBody(i), lights, li, now);
-                            }
-                        }
+                        testCasters(casters, li);
                     }
                 }
             }
+
+            eclipseShadowCache.store(body, now, bodyVisibilityMask, lights, ringShadows);
         }
 
         // Sort out the ring shadows; only one ring shadow source is supported right now. This means
@@ -2934,6 +3407,7 @@ void Renderer::renderPlanet(Body& body,
                         maxLod -= 1.0f;
                     }
                     lod = min(lod, maxLod);
+                    lights.ringShadows[li].blurSize = exp2(lod) / ringTextureWidth;
 
                     // Not all hardware/drivers support GLSL's textureXDLOD instruction, which lets
                     // us explicitly set the LOD. But, they do all have an optional lodBias parameter
@@ -2946,6 +3420,7 @@ void Renderer::renderPlanet(Body& body,
                 else
                 {
                     lights.ringShadows[li].texLod = 0.0f;
+                    lights.ringShadows[li].blurSize = 0.0f;
                 }
             }
         }
@@ -3101,7 +3576,11 @@ void Renderer::renderReferenceMark(const ReferenceMark& refMark,
 }
 
 
-void Renderer::renderAsterisms(const Universe& universe, float dist, const Matrices& mvp)
+void Renderer::renderAsterisms(const Universe& universe,
+                               float dist,
+                               const Matrices& mvp,
+                               const math::Frustum& xfrustum,
+                               const Vector3f& observerPos)
 {
     auto *asterisms = universe.getAsterisms();
 
@@ -3128,11 +3607,15 @@ void Renderer::renderAsterisms(const Universe& universe, float dist, const Matri
     ps.smoothLines = true;
     setPipelineState(ps);
 
-    m_asterismRenderer->render(Color(ConstellationColor, opacity), mvp);
+    m_asterismRenderer->render(Color(ConstellationColor, opacity), mvp, xfrustum, observerPos);
 }
 
 
-void Renderer::renderBoundaries(const Universe& universe, float dist, const Matrices& mvp)
+void Renderer::renderBoundaries(const Universe& universe,
+                                float dist,
+                                const Matrices& mvp,
+                                const math::Frustum& xfrustum,
+                                const Vector3f& observerPos)
 {
     auto boundaries = universe.getBoundaries();
     if ((renderFlags & ShowBoundaries) == 0 || boundaries == nullptr)
@@ -3160,7 +3643,7 @@ void Renderer::renderBoundaries(const Universe& universe, float dist, const Matr
     ps.smoothLines = true;
     setPipelineState(ps);
 
-    m_boundariesRenderer->render(Color(BoundaryColor, opacity), mvp);
+    m_boundariesRenderer->render(Color(BoundaryColor, opacity), mvp, xfrustum, observerPos);
 }
 
 
@@ -3222,31 +3705,38 @@ static bool isBodyVisible(const Body* body, int bodyVisibilityMask)
 
 void Renderer::addRenderListEntries(RenderListEntry& rle,
                                     Body& body,
-                                    bool isLabeled)
+                                    bool isLabeled,
+                                    const RenderListOutput& output) const
 {
     bool visibleAsPoint = rle.appMag < faintestPlanetMag && body.isVisibleAsPoint();
 
-    if (rle.discSizeInPixels > 1 || visibleAsPoint || isLabeled)
+    // Bodies whose geometry isn't drawn at this distance are drawn as
+    // points in one batch; labeled bodies stay in the render list, which
+    // the labels are built from.
+    float altitude = rle.distance - body.getRadius();
+    float maxDiscSize = (starStyle == ScaledDiscStars) ? MaxScaledDiscStarSize : 1.0f;
+    if (visibleAsPoint && !isLabeled && altitude > 0.0f &&
+        (body.getRadius() < maxDiscSize * altitude * pixelSize || !body.hasVisibleGeometry()))
+    {
+        PointBodyEntry entry;
+        entry.position = rle.position;
+        entry.color = body.getSurface().color;
+        entry.centerZ = rle.centerZ;
+        entry.appMag = rle.appMag;
+        entry.discSizeInPixels = body.getRadius() / (altitude * pixelSize);
+        entry.interval = 0;
+        output.pointBodyList.push_back(entry);
+    }
+    else if (rle.discSizeInPixels > 1 || visibleAsPoint || isLabeled)
     {
         rle.renderableType = RenderListEntry::RenderableBody;
         rle.body = &body;
-
-        if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
-        {
-            Geometry* geometry = GetGeometryManager()->find(body.getGeometry());
-            if (geometry == nullptr)
-                rle.isOpaque = true;
-            else
-                rle.isOpaque = geometry->isOpaque();
-        }
-        else
-        {
-            rle.isOpaque = true;
-        }
+        // See setRenderListOpacity for bodies with geometry
+        rle.isOpaque = true;
         rle.radius = body.getRadius();
         if (body.getRings() != nullptr)
             rle.radius += body.getRings()->outerRadius;
-        renderList.push_back(rle);
+        output.renderList.push_back(rle);
     }
 
     if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0)
@@ -3260,7 +3750,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
             rle.isOpaque = false;
             rle.radius = radius;
             rle.discSizeInPixels = discSize;
-            renderList.push_back(rle);
+            output.renderList.push_back(rle);
         }
     }
 
@@ -3274,7 +3764,27 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
         rle.refMark = rm;
         rle.isOpaque = rm->isOpaque();
         rle.radius = rm->boundingSphereRadius();
-        renderList.push_back(rle);
+        output.renderList.push_back(rle);
+    }
+}
+
+
+// The geometry manager may only be used on the render thread, so the
+// opacity of bodies with geometry is set once the render lists are built.
+void Renderer::setRenderListOpacity(std::size_t first)
+{
+    for (std::size_t i = first; i < renderList.size(); i++)
+    {
+        RenderListEntry& rle = renderList[i];
+        if (rle.renderableType != RenderListEntry::RenderableBody ||
+            rle.body->getGeometry() == InvalidResource ||
+            rle.discSizeInPixels <= 1)
+        {
+            continue;
+        }
+
+        const Geometry* geometry = GetGeometryManager()->find(rle.body->getGeometry());
+        rle.isOpaque = geometry == nullptr || geometry->isOpaque();
     }
 }
 
@@ -3282,56 +3792,235 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
 void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                 const math::Frustum& viewFrustum,
                                 const Vector3d& viewPlaneNormal,
-                                const Vector3d& frameCenter,
                                 const FrameTree* tree,
-                                const Observer& observer,
                                 double now)
 {
-    int labelClassMask = translateLabelModeToClassMask(labelMode);
+    std::size_t first = renderList.size();
+    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
+    if (detailOptions.renderListThreads > 1 && nChildren >= 2 * RenderListChunkSize && tree->isThreadSafe())
+    {
+        buildRenderListsParallel(astrocentricObserverPos, viewFrustum, viewPlaneNormal, tree, now);
+    }
+    else
+    {
+        buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                         Vector3d::Zero(), tree, 0, nChildren, now,
+                         RenderListOutput{ renderList, pointBodyList, secondaryIlluminators });
+    }
 
-    Matrix3f viewMat = getCameraOrientationf().toRotationMatrix();
-    Vector3f viewMatZ = viewMat.row(2);
-    double invCosViewAngle = 1.0 / cosViewConeAngle;
-    double sinViewAngle = sqrt(1.0 - math::square(cosViewConeAngle));
+    setRenderListOpacity(first);
+}
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+
+// Build the render lists of a system with many bodies on several threads.
+// The children of the root of the frame tree are split into chunks, which
+// are traversed along with their subtrees into separate fragments. The
+// fragments are appended in chunk order, so that the lists are the same as
+// those built on a single thread.
+void Renderer::buildRenderListsParallel(const Vector3d& astrocentricObserverPos,
+                                        const math::Frustum& viewFrustum,
+                                        const Vector3d& viewPlaneNormal,
+                                        const FrameTree* tree,
+                                        double now)
+{
+    unsigned int nThreads = detailOptions.renderListThreads;
+    unsigned int nChildren = tree->childCount();
+    unsigned int chunkSize = max(RenderListChunkSize, (nChildren + nThreads * 4 - 1) / (nThreads * 4));
+    // Chunks start at the beginning of a child group
+    chunkSize = (chunkSize + FrameTree::ChildGroupSize - 1) / FrameTree::ChildGroupSize * FrameTree::ChildGroupSize;
+    std::size_t nChunks = (nChildren + chunkSize - 1) / chunkSize;
+    if (renderListFragments.size() < nChunks)
+        renderListFragments.resize(nChunks);
+
+    util::ParallelFor(0, nChunks, 1, [&](std::size_t i)
     {
-        const TimelinePhase* phase = tree->getChild(i);
+        RenderListFragment& fragment = renderListFragments[i];
+        fragment.renderList.clear();
+        fragment.pointBodyList.clear();
+        fragment.secondaryIlluminators.clear();
+
+        auto firstChild = static_cast<unsigned int>(i * chunkSize);
+        unsigned int lastChild = min(firstChild + chunkSize, nChildren);
+        buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                         Vector3d::Zero(), tree, firstChild, lastChild, now,
+                         RenderListOutput{ fragment.renderList,
+                                           fragment.pointBodyList,
+                                           fragment.secondaryIlluminators });
+    }, nThreads);
+
+    for (std::size_t i = 0; i < nChunks; i++)
+    {
+        const RenderListFragment& fragment = renderListFragments[i];
+        renderList.insert(renderList.end(), fragment.renderList.begin(), fragment.renderList.end());
+        pointBodyList.insert(pointBodyList.end(), fragment.pointBodyList.begin(), fragment.pointBodyList.end());
+        secondaryIlluminators.insert(secondaryIlluminators.end(),
+                                     fragment.secondaryIlluminators.begin(),
+                                     fragment.secondaryIlluminators.end());
+    }
+}
 
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
 
-        Body* body = phase->body();
+// Return whether none of the objects in a group of children of a frame tree
+// centered at center_v can be seen: either they're all outside the view
+// frustum, or too small and faint to be seen from the closest they can be.
+// Like the subtree culling in buildRenderLists, this uses the luminosity at
+// opposition of the largest object, at the smallest possible distance from
+// each light source.
+bool Renderer::isChildGroupCulled(const FrameTree::ChildGroup& group,
+                                  const Vector3d& center_v,
+                                  const math::Frustum& viewFrustum,
+                                  int labelClassMask) const
+{
+    double centerDistance = center_v.norm();
+    double minPossibleDistance = max(group.minRadius - centerDistance, centerDistance - group.maxRadius);
 
-        // pos_s: sun-relative position of object
-        // pos_v: viewer-relative position of object
+    // Labeled bodies are listed whatever their size
+    float brightestPossible = -100.0f;
+    float largestPossible = 100.0f;
+    if (minPossibleDistance > 1.0 && (group.classMask & labelClassMask) == 0)
+    {
+        float lum = 0.0f;
+        for (const auto& lightSource : lightSourceList)
+        {
+            double sunDistance = (center_v - lightSource.position).norm();
+            double minSunDistance = max(group.minRadius - sunDistance, sunDistance - group.maxRadius);
+            if (minSunDistance <= 1.0)
+            {
+                lum = std::numeric_limits<float>::max();
+                break;
+            }
 
-        // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        Vector3d pos_s = frameCenter + phase->orbitFrame()->getOrientation(now).conjugate() * p;
+            lum += luminosityAtOpposition(lightSource.luminosity, (float) minSunDistance, (float) group.maxChildRadius);
+        }
+        brightestPossible = astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance));
+        largestPossible = (float) group.maxChildRadius / (float) minPossibleDistance / pixelSize;
+    }
 
-        // We now have the positions of the observer and the planet relative
-        // to the sun.  From these, compute the position of the body
-        // relative to the observer.
-        Vector3d pos_v = pos_s - astrocentricObserverPos;
+    if ((brightestPossible < faintestPlanetMag || largestPossible > 1.0f) &&
+        viewFrustum.testSphere(center_v.cast<float>(), (float) group.maxRadius) != math::Frustum::Outside)
+    {
+        return false;
+    }
 
-        // dist_vn: distance along view normal from the viewer to the
-        // projection of the object's center.
-        double dist_vn = viewPlaneNormal.dot(pos_v);
+    // Objects outside the view may still light objects in it
+    return !group.containsSecondaryIlluminators || largestPossible <= PLANETSHINE_PIXEL_SIZE_LIMIT;
+}
 
-        // Vector from object center to its projection on the view normal.
-        Vector3d toViewNormal = pos_v - dist_vn * viewPlaneNormal;
 
-        float cullingRadius = body->getCullingRadius();
+// Return the offsets of a group of children of tree at time now, computing
+// them unless a view drawn before at the same time did. The Keplerian
+// orbits among the children are solved in a batch.
+static const FrameTree::ChildGroupOffsets&
+updateChildGroupOffsets(const FrameTree* tree, unsigned int group, double now)
+{
+    FrameTree::ChildGroupOffsets& groupOffsets = tree->getChildGroupOffsets(group);
+    if (groupOffsets.time == now)
+        return groupOffsets;
 
-        // The result of the planetshine test can be reused for the view cone
-        // test, but only when the object's light influence sphere is larger
-        // than the geometry. This is not
-        bool viewConeTestFailed = false;
-        if (body->isSecondaryIlluminator())
-        {
+    std::array<const celestia::ephem::Orbit*, FrameTree::ChildGroupSize> orbits;
+    std::array<Vector3d, FrameTree::ChildGroupSize> positions;
+    unsigned int groupStart = group * FrameTree::ChildGroupSize;
+    auto groupSize = static_cast<unsigned int>(groupOffsets.offsets.size());
+
+    std::size_t nOrbits = 0;
+    for (unsigned int j = 0; j < groupSize; j++)
+    {
+        const TimelinePhase* phase = tree->getSortedChild(groupStart + j);
+        if (phase->includes(now))
+            orbits[nOrbits++] = phase->orbit();
+    }
+
+    ephem::PositionsAtTime(util::array_view<const ephem::Orbit*>(orbits.data(), nOrbits),
+                           now, positions.data());
+
+    nOrbits = 0;
+    for (unsigned int j = 0; j < groupSize; j++)
+    {
+        const TimelinePhase* phase = tree->getSortedChild(groupStart + j);
+        if (phase->includes(now))
+            groupOffsets.offsets[j] = phase->orbitFrame()->getOrientation(now).conjugate() * positions[nOrbits++];
+    }
+
+    groupOffsets.time = now;
+    return groupOffsets;
+}
+
+
+// Add the visible children of tree from firstChild up to lastChild, and the
+// visible objects of their subtrees, to the lists in output. The children
+// are visited in the order of FrameTree::getSortedChild. This may run on
+// several threads at once, for ranges of children starting at a group.
+void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
+                                const math::Frustum& viewFrustum,
+                                const Vector3d& viewPlaneNormal,
+                                const Vector3d& frameCenter,
+                                const FrameTree* tree,
+                                unsigned int firstChild,
+                                unsigned int lastChild,
+                                double now,
+                                const RenderListOutput& output) const
+{
+    int labelClassMask = translateLabelModeToClassMask(labelMode);
+
+    Matrix3f viewMat = getCameraOrientationf().toRotationMatrix();
+    Vector3f viewMatZ = viewMat.row(2);
+    double invCosViewAngle = 1.0 / cosViewConeAngle;
+    double sinViewAngle = sqrt(1.0 - math::square(cosViewConeAngle));
+
+    // Offsets from the frame center of the children of the current group
+    const FrameTree::ChildGroupOffsets* groupOffsets = nullptr;
+
+    Vector3d center_v = frameCenter - astrocentricObserverPos;
+    for (unsigned int i = firstChild; i < lastChild; i++)
+    {
+        if (i % FrameTree::ChildGroupSize == 0 || i == firstChild)
+        {
+            // Skip whole groups of children which can't be seen
+            if (i % FrameTree::ChildGroupSize == 0 &&
+                isChildGroupCulled(tree->getChildGroup(i / FrameTree::ChildGroupSize),
+                                   center_v, viewFrustum, labelClassMask))
+            {
+                i += FrameTree::ChildGroupSize - 1;
+                continue;
+            }
+
+            groupOffsets = &updateChildGroupOffsets(tree, i / FrameTree::ChildGroupSize, now);
+        }
+
+        const TimelinePhase* phase = tree->getSortedChild(i);
+
+        // No need to do anything if the phase isn't active now
+        if (!phase->includes(now))
+            continue;
+
+        Body* body = phase->body();
+
+        // pos_s: sun-relative position of object
+        // pos_v: viewer-relative position of object
+
+        // Get the position of the body relative to the sun.
+        Vector3d pos_s = frameCenter + groupOffsets->offsets[i % FrameTree::ChildGroupSize];
+
+        // We now have the positions of the observer and the planet relative
+        // to the sun.  From these, compute the position of the body
+        // relative to the observer.
+        Vector3d pos_v = pos_s - astrocentricObserverPos;
+
+        // dist_vn: distance along view normal from the viewer to the
+        // projection of the object's center.
+        double dist_vn = viewPlaneNormal.dot(pos_v);
+
+        // Vector from object center to its projection on the view normal.
+        Vector3d toViewNormal = pos_v - dist_vn * viewPlaneNormal;
+
+        float cullingRadius = body->getCullingRadius();
+
+        // The result of the planetshine test can be reused for the view cone
+        // test, but only when the object's light influence sphere is larger
+        // than the geometry. This is not
+        bool viewConeTestFailed = false;
+        if (body->isSecondaryIlluminator())
+        {
             float influenceRadius = body->getBoundingRadius() + (body->getRadius() * PLANETSHINE_DISTANCE_LIMIT_FACTOR);
             if (dist_vn > -influenceRadius)
             {
@@ -3350,7 +4039,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                         illum.body = body;
                         illum.position_v = pos_v;
                         illum.radius = body->getRadius();
-                        secondaryIlluminators.push_back(illum);
+                        output.secondaryIlluminators.push_back(illum);
                     }
                 }
                 else
@@ -3413,7 +4102,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                 // defined relative to the SSB.)
                 rle.sun = -pos_s.cast<float>();
 
-                addRenderListEntries(rle, *body, isLabeled);
+                addRenderListEntries(rle, *body, isLabeled, output);
             }
         }
 
@@ -3496,8 +4185,10 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                  viewPlaneNormal,
                                  pos_s,
                                  subtree,
-                                 observer,
-                                 now);
+                                 0,
+                                 subtree->childCount(),
+                                 now,
+                                 output);
             }
         } // end subtree traverse
     }
@@ -3634,6 +4325,31 @@ static Color getBodyLabelColor(int classification)
     }
 }
 
+// Labels of more important classes of bodies are preferred to brighter
+// bodies of other classes, which in turn are preferred to stars and deep
+// sky objects, whose priority is the negated apparent magnitude.
+static float getBodyLabelPriority(int classification, float appMag)
+{
+    float classPriority;
+    switch (classification)
+    {
+    case Body::Planet:
+        classPriority = 500.0f;
+        break;
+    case Body::DwarfPlanet:
+        classPriority = 400.0f;
+        break;
+    case Body::Moon:
+        classPriority = 300.0f;
+        break;
+    default:
+        classPriority = 200.0f;
+        break;
+    }
+
+    return classPriority - std::clamp(appMag, -50.0f, 50.0f);
+}
+
 void Renderer::buildLabelLists(const math::Frustum& viewFrustum,
                                double now)
 {
@@ -3743,7 +4459,9 @@ void Renderer::buildLabelLists(const math::Frustum& viewFrustum,
         Color labelColor = getBodyLabelColor(ri.body->getOrbitClassification());
         float opacity = sizeFade(boundingRadiusSize, minOrbitSize, 2.0f);
         labelColor.alpha(opacity * labelColor.alpha());
-        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos);
+        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos,
+                            LabelHorizontalAlignment::Start, LabelVerticalAlignment::Bottom, 0.0f,
+                            getBodyLabelPriority(ri.body->getOrbitClassification(), ri.appMag));
     } // for each render list entry
 }
 
@@ -3800,7 +4518,10 @@ static float calcMaxFOV(float fovY_degrees, float aspectRatio)
 
 void Renderer::renderPointStars(const StarDatabase& starDB,
                                 float faintestMagNight,
-                                const Observer& observer)
+                                const Observer& observer,
+                                float minDistance,
+                                float maxDistance,
+                                celestia::engine::StarTileDatabase* starTiles)
 {
 #ifndef GL_ES
     // Disable multisample rendering when drawing point stars
@@ -3826,7 +4547,8 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 
     starRenderer.pixelSize         = pixelSize;
     starRenderer.faintestMag       = faintestMag;
-    starRenderer.distanceLimit     = distanceLimit;
+    starRenderer.distanceLimit     = std::min(distanceLimit, maxDistance);
+    starRenderer.minDistance       = minDistance;
     starRenderer.labelMode         = labelMode;
     starRenderer.SolarSystemMaxDistance = SolarSystemMaxDistance;
 
@@ -3842,24 +4564,57 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.glareVertexBuffer->setTexture(gaussianGlareTex);
     starRenderer.glareVertexBuffer->setPointScale(screenDpi / 96.0f);
 
+    // Packed directions are only precise enough when pixels are large
+    bool packed = detailOptions.packedStarVertices && pixelSize > MinPackedStarPixelSize;
     PointStarVertexBuffer::enable();
-    starRenderer.glareVertexBuffer->startSprites();
+    starRenderer.glareVertexBuffer->startSprites(packed);
     if (starStyle == PointStars)
         starRenderer.starVertexBuffer->startBasicPoints();
     else
-        starRenderer.starVertexBuffer->startSprites();
+        starRenderer.starVertexBuffer->startSprites(packed);
 
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
     setPipelineState(ps);
 
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            getCameraOrientationf(),
-                            math::degToRad(fov),
-                            getAspectRatio(),
-                            faintestMagNight);
+    if (maxDistance < StarDistanceLimit)
+    {
+        // Only a few stars are close, don't traverse the whole octree
+        starDB.findCloseStars(starRenderer, obsPos.cast<float>(), maxDistance);
+    }
+    else if (renderPointStarsGPU(starDB, starRenderer, faintestMagNight))
+    {
+        // Culled and drawn by the GPU
+    }
+    else if (detailOptions.starRenderTime > 0.0 && minDistance == 0.0f)
+    {
+        renderPointStarsProgressive(starDB, starRenderer, faintestMagNight);
+    }
+    else if (detailOptions.starRenderThreads > 1)
+    {
+        renderPointStarsParallel(starDB, starRenderer, faintestMagNight);
+    }
+    else
+    {
+        starDB.findVisibleStars(starRenderer,
+                                obsPos.cast<float>(),
+                                getCameraOrientationf(),
+                                math::degToRad(fov),
+                                getAspectRatio(),
+                                faintestMagNight);
+    }
+
+    // The faint stars of the tile catalog are drawn after the catalog stars
+    if (starTiles != nullptr && maxDistance >= StarDistanceLimit)
+    {
+        starTiles->findVisibleStars(starRenderer,
+                                    obsPos.cast<float>(),
+                                    getCameraOrientationf(),
+                                    math::degToRad(fov),
+                                    getAspectRatio(),
+                                    faintestMagNight);
+    }
 
     starRenderer.starVertexBuffer->finish();
     starRenderer.glareVertexBuffer->finish();
@@ -3871,24 +4626,243 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 #endif
 }
 
+// Cull the stars beyond GPUStarCuller::NearStarDistance with a compute
+// shader and draw them from the buffers it writes. The close stars and the
+// stars with an orbit are processed on the CPU. Labels need the names of
+// the stars, so they can't be placed on the GPU.
+bool Renderer::renderPointStarsGPU(const StarDatabase& starDB,
+                                   PointStarRenderer& starRenderer,
+                                   float faintestMagNight)
+{
+#ifdef GL_ES
+    return false;
+#else
+    using celestia::engine::GPUStarCuller;
+
+    if (m_gpuStarCuller == nullptr || (labelMode & StarLabels) != 0)
+        return false;
+
+    m_gpuStarCuller->setStars(starDB, starColors);
+
+    // Cull before processing stars on the CPU: the program used for
+    // culling replaces the one of the current vertex buffer
+    float nearDistance = std::max(starRenderer.minDistance, GPUStarCuller::NearStarDistance);
+    GPUStarCuller::Parameters params;
+    params.obsPosition = starRenderer.obsPos.cast<float>();
+    params.viewNormal = starRenderer.viewNormal;
+    // Widen the view cone so that the sprites of stars just outside of it
+    // aren't cut off
+    float viewConeAngle = std::acos(starRenderer.cosFOV) + 64.0f * pixelSize;
+    params.cosViewCone = viewConeAngle < celestia::numbers::pi_v<float> ? std::cos(viewConeAngle) : -1.0f;
+    params.minDistance = nearDistance;
+    params.distanceLimit = starRenderer.distanceLimit;
+    params.faintestMagNight = faintestMagNight;
+    params.faintestMag = faintestMag;
+    params.saturationMag = satPoint;
+    params.brightnessScale = brightnessScale;
+    params.brightnessBias = brightnessBias;
+    params.baseSize = BaseStarDiscSize * static_cast<float>(screenDpi) / 96.0f;
+    params.scaledDiscs = starStyle == ScaledDiscStars;
+    if (!m_gpuStarCuller->cull(params))
+    {
+        GetLogger()->warn("Star culling shader unavailable, culling stars on the CPU.\n");
+        m_gpuStarCuller = nullptr;
+        return false;
+    }
+
+    if (starRenderer.minDistance < nearDistance)
+        starDB.findCloseStars(starRenderer, params.obsPosition, nearDistance);
+
+    for (std::uint32_t index : m_gpuStarCuller->getOrbitingStars())
+    {
+        const Star& star = *starDB.getStar(index);
+        auto distance = static_cast<float>((star.getPosition().cast<double>() - starRenderer.obsPos).norm());
+        if (distance < nearDistance)
+            continue;
+
+        float appMag = star.getApparentMagnitude(distance);
+        if (appMag < faintestMagNight)
+            starRenderer.process(star, distance, appMag);
+    }
+
+    starRenderer.glareVertexBuffer->drawIndirect(m_gpuStarCuller->getVertices(),
+                                                 m_gpuStarCuller->getCommands(),
+                                                 GPUStarCuller::GlareCommandOffset);
+    starRenderer.starVertexBuffer->drawIndirect(m_gpuStarCuller->getVertices(),
+                                                m_gpuStarCuller->getCommands(),
+                                                GPUStarCuller::StarCommandOffset);
+    return true;
+#endif
+}
+
+// Traverse the star octree for at most the star render time, continuing
+// the traversal of the previous frames while the view stays the same. The
+// octree is traversed breadth first, so the brightest stars are found
+// first and the field fills in with fainter stars over the next frames.
+void Renderer::renderPointStarsProgressive(const StarDatabase& starDB,
+                                           PointStarRenderer& starRenderer,
+                                           float faintestMagNight)
+{
+    if (m_pointStarProgress == nullptr)
+        m_pointStarProgress = std::make_unique<PointStarProgress>();
+    PointStarProgress& progress = *m_pointStarProgress;
+
+    PointStarProgress::View view
+    {
+        starRenderer.obsPos,
+        getCameraOrientationf(),
+        fov,
+        getAspectRatio(),
+        pixelSize,
+        faintestMagNight,
+        faintestMag,
+        satPoint,
+        brightnessScale,
+        static_cast<int>(starStyle),
+        labelMode,
+    };
+    if (!progress.matches(view))
+    {
+        progress.restart();
+        progress.view = view;
+    }
+
+    if (!progress.complete)
+    {
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(detailOptions.starRenderTime));
+        starRenderer.staging = &progress.staging;
+        progress.complete = starDB.findVisibleStarsUntil(starRenderer,
+                                                         progress.traversal,
+                                                         starRenderer.obsPos.cast<float>(),
+                                                         view.orientation,
+                                                         math::degToRad(fov),
+                                                         view.aspectRatio,
+                                                         faintestMagNight,
+                                                         deadline);
+        starRenderer.staging = nullptr;
+    }
+
+    starRenderer.flush(progress.staging);
+}
+
+// Traverse the star octree on several threads. The top of the octree is
+// processed on the render thread until there are enough subtrees to keep the
+// workers busy; each subtree stages its output separately, and the staged
+// output is submitted in subtree order so that the result doesn't depend on
+// thread scheduling.
+void Renderer::renderPointStarsParallel(const StarDatabase& starDB,
+                                        PointStarRenderer& starRenderer,
+                                        float faintestMagNight)
+{
+    unsigned int nThreads = detailOptions.starRenderThreads;
+    Vector3f obsPos = starRenderer.obsPos.cast<float>();
+    Quaternionf orientation = getCameraOrientationf();
+    float fovY = math::degToRad(fov);
+    float aspectRatio = getAspectRatio();
+
+    auto subtrees = starDB.findVisibleStarSubtrees(starRenderer,
+                                                   obsPos,
+                                                   orientation,
+                                                   fovY,
+                                                   aspectRatio,
+                                                   faintestMagNight,
+                                                   nThreads * 4);
+    if (subtrees.empty())
+        return;
+
+    if (starStaging.size() < subtrees.size())
+        starStaging.resize(subtrees.size());
+
+    util::ParallelFor(0, subtrees.size(), 1, [&](std::size_t i)
+    {
+        PointStarStaging& output = starStaging[i];
+        output.clear();
+        PointStarRenderer processor = starRenderer;
+        processor.staging = &output;
+        starDB.findVisibleStarsInSubtree(processor,
+                                         subtrees[i],
+                                         obsPos,
+                                         orientation,
+                                         fovY,
+                                         aspectRatio,
+                                         faintestMagNight);
+    }, nThreads);
+
+    for (std::size_t i = 0; i < subtrees.size(); i++)
+        starRenderer.flush(starStaging[i]);
+}
+
+// Traverse the deep sky object octree on several threads like
+// renderPointStarsParallel. The objects found in each subtree are staged by
+// type and passed to the type renderers in one batch, in subtree order.
+void Renderer::renderDeepSkyObjectsParallel(const DSODatabase& dsoDB,
+                                            DSORenderer& dsoRenderer,
+                                            float faintestMagNight)
+{
+    unsigned int nThreads = detailOptions.dsoRenderThreads;
+    Quaternionf orientation = getCameraOrientationf();
+    float fovY = math::degToRad(fov);
+    float aspectRatio = getAspectRatio();
+
+    // The objects found near the root go to the first staging area
+    if (dsoStaging.empty())
+        dsoStaging.resize(1);
+    dsoStaging.front().clear();
+    dsoRenderer.staging = &dsoStaging.front();
+    auto subtrees = dsoDB.findVisibleDSOSubtrees(dsoRenderer,
+                                                 dsoRenderer.obsPos,
+                                                 orientation,
+                                                 fovY,
+                                                 aspectRatio,
+                                                 faintestMagNight,
+                                                 nThreads * 4);
+    dsoRenderer.staging = nullptr;
+
+    if (dsoStaging.size() < subtrees.size() + 1)
+        dsoStaging.resize(subtrees.size() + 1);
+
+    util::ParallelFor(0, subtrees.size(), 1, [&](std::size_t i)
+    {
+        DSOStaging& output = dsoStaging[i + 1];
+        output.clear();
+        DSORenderer processor = dsoRenderer;
+        processor.staging = &output;
+        dsoDB.findVisibleDSOsInSubtree(processor,
+                                       subtrees[i],
+                                       dsoRenderer.obsPos,
+                                       orientation,
+                                       fovY,
+                                       aspectRatio,
+                                       faintestMagNight);
+    }, nThreads);
+
+    DSOStaging& output = dsoStaging.front();
+    for (std::size_t i = 1; i <= subtrees.size(); i++)
+        output.append(dsoStaging[i]);
+    dsoRenderer.flush(output);
+}
+
 void Renderer::renderDeepSkyObjects(const Universe& universe,
                                     const Observer& observer,
-                                    const float     faintestMagNight)
+                                    const float     faintestMagNight,
+                                    float           zoom)
 {
     DSORenderer dsoRenderer;
 
     auto cameraOrientation = getCameraOrientationf();
 
-    m_galaxyRenderer->update(cameraOrientation, pixelSize, fov, observer.getZoom());
+    m_galaxyRenderer->update(cameraOrientation, pixelSize, fov, zoom);
     dsoRenderer.galaxyRenderer = m_galaxyRenderer.get();
 
-    m_globularRenderer->update(cameraOrientation, pixelSize, fov, observer.getZoom());
+    m_globularRenderer->update(cameraOrientation, pixelSize, fov, zoom);
     dsoRenderer.globularRenderer = m_globularRenderer.get();
 
-    m_nebulaRenderer->update(cameraOrientation, pixelSize, fov, observer.getZoom());
+    m_nebulaRenderer->update(cameraOrientation, pixelSize, fov, zoom);
     dsoRenderer.nebulaRenderer = m_nebulaRenderer.get();
 
-    m_openClusterRenderer->update(cameraOrientation, pixelSize, fov, observer.getZoom());
+    m_openClusterRenderer->update(cameraOrientation, pixelSize, fov, zoom);
     dsoRenderer.openClusterRenderer = m_openClusterRenderer.get();
 
     Vector3d obsPos     = observer.getPosition().toLy();
@@ -3908,7 +4882,7 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     dsoRenderer.renderFlags      = renderFlags;
     dsoRenderer.labelMode        = labelMode;
 
-    dsoRenderer.frustum = projectionMode->getFrustum(MinNearPlaneDistance, std::numeric_limits<float>::infinity(), observer.getZoom());
+    dsoRenderer.frustum = projectionMode->getFrustum(MinNearPlaneDistance, std::numeric_limits<float>::infinity(), zoom);
     // Use pixelSize * screenDpi instead of FoV, to eliminate windowHeight dependence.
     // = 1.0 at startup
     float effDistanceToScreen = mmToInches((float) REF_DISTANCE_TO_SCREEN) * pixelSize * getScreenDpi();
@@ -3921,12 +4895,19 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     openClusterRep = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, OpenClusterLabelColor);
     globularRep    = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, GlobularLabelColor);
 
-    dsoDB->findVisibleDSOs(dsoRenderer,
-                           obsPos,
-                           cameraOrientation,
-                           math::degToRad(fov),
-                           getAspectRatio(),
-                           2 * faintestMagNight);
+    if (detailOptions.dsoRenderThreads > 1)
+    {
+        renderDeepSkyObjectsParallel(*dsoDB, dsoRenderer, 2 * faintestMagNight);
+    }
+    else
+    {
+        dsoDB->findVisibleDSOs(dsoRenderer,
+                               obsPos,
+                               cameraOrientation,
+                               math::degToRad(fov),
+                               getAspectRatio(),
+                               2 * faintestMagNight);
+    }
 
     m_galaxyRenderer->render();
     m_globularRenderer->render();
@@ -3937,6 +4918,124 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
 }
 
 
+bool Renderer::renderCachedStarField(const Universe& universe,
+                                     const Observer& observer,
+                                     float faintestMagNight,
+                                     bool starFieldChanged)
+{
+    using celestia::engine::StarFieldCache;
+
+    if (m_starFieldCache == nullptr)
+        return false;
+
+    if (starFieldChanged)
+        m_starFieldCache->invalidate();
+
+    // Labels are placed while traversing the catalogs, and the fisheye
+    // lens of the shaders can't be turned off to render the faces
+    constexpr int StarFieldLabels = StarLabels | GalaxyLabels | GlobularLabels | NebulaLabels | OpenClusterLabels;
+    if ((labelMode & StarFieldLabels) != 0 ||
+        dynamic_cast<const celestia::engine::PerspectiveProjectionMode*>(projectionMode.get()) == nullptr)
+    {
+        return false;
+    }
+
+    // Objects look blurred or too small when the texels are much larger
+    // or smaller than a pixel
+    float texelsPerPixel = pixelSize * static_cast<float>(m_starFieldCache->getFaceSize()) * 0.5f;
+    if (texelsPerPixel < MinStarFieldTexelsPerPixel || texelsPerPixel > MaxStarFieldTexelsPerPixel)
+        return false;
+
+    StarFieldCache::Settings settings;
+    settings.faintestMag = faintestMag;
+    settings.saturationPoint = satPoint;
+    settings.brightnessScale = brightnessScale;
+    settings.renderFlags = renderFlags & (ShowStars | ShowDeepSpaceObjects);
+    settings.starStyle = static_cast<int>(starStyle);
+    settings.stars = universe.getStarCatalog();
+    settings.dsos = universe.getDSOCatalog();
+    if (settings.renderFlags == 0)
+        return false;
+
+    switch (m_starFieldCache->update(observer.getPosition().toLy(), settings))
+    {
+    case StarFieldCache::Action::Skip:
+        return false;
+    case StarFieldCache::Action::Capture:
+        captureStarField(universe, observer, faintestMagNight);
+        break;
+    case StarFieldCache::Action::Draw:
+        break;
+    }
+
+    m_starFieldCache->render(*this, m_projMatrix, m_modelMatrix);
+    return true;
+}
+
+void Renderer::captureStarField(const Universe& universe,
+                                const Observer& observer,
+                                float faintestMagNight)
+{
+    using celestia::engine::StarFieldCache;
+
+    auto faceSize = static_cast<int>(m_starFieldCache->getFaceSize());
+    auto faceMode = std::make_shared<celestia::engine::PerspectiveProjectionMode>(static_cast<float>(faceSize),
+                                                                                  static_cast<float>(faceSize),
+                                                                                  REF_DISTANCE_TO_SCREEN,
+                                                                                  screenDpi);
+    float faceZoom = faceMode->getZoom(celestia::numbers::pi_v<float> / 2.0f);
+
+    // The objects are rendered as seen by a camera looking at each face
+    auto savedProjectionMode = projectionMode;
+    Quaterniond savedCameraOrientation = m_cameraOrientation;
+    Matrix4f savedProjMatrix = m_projMatrix;
+    Matrix4f savedModelMatrix = m_modelMatrix;
+    Matrix4f savedMVPMatrix = m_MVPMatrix;
+    float savedFov = fov;
+    float savedPixelSize = pixelSize;
+    double savedCosViewConeAngle = cosViewConeAngle;
+    int savedWindowWidth = windowWidth;
+    int savedWindowHeight = windowHeight;
+    std::array<int, 4> savedViewport = m_viewport;
+
+    projectionMode = faceMode;
+    windowWidth = faceSize;
+    windowHeight = faceSize;
+    fov = 90.0f;
+    pixelSize = faceMode->getPixelSize(faceZoom);
+    cosViewConeAngle = faceMode->getViewConeAngleMax(faceZoom);
+    m_projMatrix = faceMode->getProjectionMatrix(NEAR_DIST, FAR_DIST, faceZoom);
+
+    for (int face = 0; face < StarFieldCache::Faces; face++)
+    {
+        GLint oldFboId = m_starFieldCache->bindFace(face);
+        m_cameraOrientation = StarFieldCache::getFaceOrientation(face);
+        m_modelMatrix = Affine3f(getCameraOrientationf()).matrix();
+        m_MVPMatrix = m_projMatrix * m_modelMatrix;
+
+        if ((renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
+            renderDeepSkyObjects(universe, observer, faintestMagNight, faceZoom);
+        if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != nullptr)
+            renderPointStars(*universe.getStarCatalog(), faintestMagNight, observer, StarFieldCache::NearStarDistance,
+                             std::numeric_limits<float>::infinity(), universe.getStarTiles());
+
+        m_starFieldCache->unbind(oldFboId);
+    }
+
+    projectionMode = savedProjectionMode;
+    m_cameraOrientation = savedCameraOrientation;
+    m_projMatrix = savedProjMatrix;
+    m_modelMatrix = savedModelMatrix;
+    m_MVPMatrix = savedMVPMatrix;
+    fov = savedFov;
+    pixelSize = savedPixelSize;
+    cosViewConeAngle = savedCosViewConeAngle;
+    windowWidth = savedWindowWidth;
+    windowHeight = savedWindowHeight;
+    setViewport(savedViewport);
+}
+
+
 static Vector3d toStandardCoords(const Vector3d& v)
 {
     return Vector3d(v.x(), -v.z(), v.y());
@@ -4020,62 +5119,47 @@ void Renderer::renderSkyGrids(const Observer& observer)
 }
 
 void Renderer::labelConstellations(const AsterismList& asterisms,
-                                   const Observer& observer)
+                                   const Observer& observer,
+                                   const math::Frustum& xfrustum)
 {
     Vector3f observerPos = observer.getPosition().toLy().cast<float>();
 
-    for (const auto& ast : asterisms)
+    // We'll linearly fade the labels as a function of the
+    // observer's distance to the origin of coordinates:
+    float opacity = 1.0f;
+    float dist = observerPos.norm();
+    if (dist > MaxAsterismLabelsConstDist)
     {
-        if (ast.getChainCount() > 0 && ast.getActive())
-        {
-            const Asterism::Chain& chain = ast.getChain(0);
-
-            if (!chain.empty())
-            {
-                // The constellation label is positioned at the average
-                // position of all stars in the first chain.  This usually
-                // gives reasonable results.
-                Vector3f avg = Vector3f::Zero();
-                // XXX: std::reduce
-                for (const auto& c : chain)
-                    avg += c;
-
-                avg = avg / (float) chain.size();
+        opacity = std::clamp((MaxAsterismLabelsConstDist - dist)
+                             / (MaxAsterismLabelsDist - MaxAsterismLabelsConstDist) + 1.0f,
+                             0.0f,
+                             1.0f);
+    }
 
-                // Draw all constellation labels at the same distance
-                avg.normalize();
-                avg = avg * 1.0e4f;
+    for (const auto& ast : asterisms)
+    {
+        if (ast.getChainCount() == 0 || ast.getChain(0).empty() || !ast.getActive())
+            continue;
 
-                Vector3f rpos = avg - observerPos;
+        Vector3f rpos = ast.getLabelPosition() - observerPos;
 
-                if ((getCameraOrientationf() * rpos).z() < 0)
-                {
-                    // We'll linearly fade the labels as a function of the
-                    // observer's distance to the origin of coordinates:
-                    float opacity = 1.0f;
-                    float dist = observerPos.norm();
-                    if (dist > MaxAsterismLabelsConstDist)
-                    {
-                        opacity = std::clamp((MaxAsterismLabelsConstDist - dist)
-                                             / (MaxAsterismLabelsDist - MaxAsterismLabelsConstDist) + 1.0f,
-                                             0.0f,
-                                             1.0f);
-                    }
+        // Skip the labels too far outside the view for any of their text
+        // to be visible
+        float margin = rpos.norm() * pixelSize * ConstellationLabelMargin;
+        if (xfrustum.testSphere(rpos, margin) == math::Frustum::Outside)
+            continue;
 
-                    // Use the default label color unless the constellation has an
-                    // override color set.
-                    Color labelColor = ConstellationLabelColor;
-                    if (ast.isColorOverridden())
-                        labelColor = ast.getOverrideColor();
-
-                    addBackgroundAnnotation(nullptr,
-                                            ast.getName((labelMode & I18nConstellationLabels) != 0),
-                                            Color(labelColor, opacity),
-                                            rpos,
-                                            LabelHorizontalAlignment::Center, LabelVerticalAlignment::Center);
-                }
-            }
-        }
+        // Use the default label color unless the constellation has an
+        // override color set.
+        Color labelColor = ConstellationLabelColor;
+        if (ast.isColorOverridden())
+            labelColor = ast.getOverrideColor();
+
+        addBackgroundAnnotation(nullptr,
+                                ast.getName((labelMode & I18nConstellationLabels) != 0),
+                                Color(labelColor, opacity),
+                                rpos,
+                                LabelHorizontalAlignment::Center, LabelVerticalAlignment::Center);
     }
 }
 
@@ -4091,17 +5175,20 @@ Renderer::renderAnnotationMarker(const Annotation &a,
 
     glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
 
-    Matrix4f mv = math::translate(*m.modelview, (float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Vector3f position((float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Matrix4f mv = math::translate(*m.modelview, position);
     Matrices mm = { m.projection, &mv };
 
+    // The batch is drawn when the annotations end, before their labels
     if (markerRep.symbol() == celestia::MarkerRepresentation::Crosshair)
         renderCrosshair(size, realTime, a.color, mm);
-    else
+    else if (!m_markerBatch->add(markerRep.symbol(), size, markerRep.color(), position))
         markerRep.render(*this, size, mm);
 
     if (!markerRep.label().empty())
     {
         layout.setHorizontalAlignment(rtl ? TextLayout::HorizontalAlignment::Left : TextLayout::HorizontalAlignment::Right);
+        layout.setColor(a.color);
         layout.begin(*m.projection, mv);
         float labelOffset = markerRep.size() / 2.0f;
         float x = labelOffset + PixelOffset;
@@ -4110,7 +5197,6 @@ Renderer::renderAnnotationMarker(const Annotation &a,
         float y = -labelOffset - static_cast<float>(layout.getLineHeight()) + PixelOffset;
         layout.moveAbsolute(x, y);
         layout.render(markerRep.label());
-        layout.end();
     }
 }
 
@@ -4122,19 +5208,151 @@ Renderer::renderAnnotationLabel(const Annotation &a,
                                 float depth,
                                 const Matrices &m)
 {
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
-
     Matrix4f mv = math::translate(*m.modelview,
                                      std::trunc(a.position.x()) + hOffset + PixelOffset,
                                      std::trunc(a.position.y()) + vOffset + PixelOffset,
                                      depth);
 
+    // The labels are drawn together when the layout session ends
+    layout.setColor(a.color);
     layout.begin(*m.projection, mv);
     layout.moveAbsolute(0.0f, 0.0f);
     layout.render(a.labelText);
-    layout.end();
 }
 
+// Sort the depth sorted annotations from back to front. Annotations are
+// added in the same order every frame, so while the camera moves smoothly
+// the order of the last frame needs few changes. It is fixed up by an
+// insertion sort, which gives up in favor of a full sort once too many
+// annotations have moved.
+void
+Renderer::sortAnnotations()
+{
+    constexpr std::size_t MaxMovesPerAnnotation = 4;
+
+    auto farther = [this](std::uint32_t a, std::uint32_t b)
+    {
+        return depthSortedAnnotations[a] < depthSortedAnnotations[b];
+    };
+
+    std::size_t nAnnotations = depthSortedAnnotations.size();
+    bool sorted = false;
+    if (annotationOrder.size() == nAnnotations)
+    {
+        std::size_t maxMoves = nAnnotations * MaxMovesPerAnnotation;
+        std::size_t moves = 0;
+        sorted = true;
+        for (std::size_t i = 1; i < nAnnotations && sorted; ++i)
+        {
+            std::uint32_t index = annotationOrder[i];
+            std::size_t j = i;
+            for (; j > 0 && farther(index, annotationOrder[j - 1]); --j)
+                annotationOrder[j] = annotationOrder[j - 1];
+            annotationOrder[j] = index;
+
+            moves += i - j;
+            sorted = moves <= maxMoves;
+        }
+    }
+    else
+    {
+        annotationOrder.resize(nAnnotations);
+        std::iota(annotationOrder.begin(), annotationOrder.end(), std::uint32_t{ 0 });
+    }
+
+    if (!sorted)
+        std::sort(annotationOrder.begin(), annotationOrder.end(), farther);
+
+    sortedAnnotations.clear();
+    for (std::uint32_t index : annotationOrder)
+        sortedAnnotations.push_back(depthSortedAnnotations[index]);
+    depthSortedAnnotations.swap(sortedAnnotations);
+}
+
+
+// If the labels are where they were placed by the last call of
+// declutterLabels, hide the same labels again
+bool
+Renderer::reuseLabelPlacements()
+{
+    if (declutteredLabels.size() != labelPlacements.size())
+        return false;
+
+    for (const Annotation* a : declutteredLabels)
+    {
+        auto it = labelPlacements.find(std::hash<std::string_view>()(a->labelText));
+        if (it == labelPlacements.end())
+            return false;
+
+        Vector2f offset = a->position.head<2>() - it->second.position;
+        if (std::abs(offset.x()) >= 1.0f || std::abs(offset.y()) >= 1.0f)
+            return false;
+    }
+
+    for (Annotation* a : declutteredLabels)
+    {
+        if (!labelPlacements.find(std::hash<std::string_view>()(a->labelText))->second.visible)
+            a->labelText = {};
+    }
+
+    return true;
+}
+
+
+// Clear the text of background and depth sorted labels which overlap a
+// label of higher priority on screen. The placements are kept for the next
+// frames, which reuse them until a label moves or the set of labels
+// changes.
+void
+Renderer::declutterLabels()
+{
+    declutteredLabels.clear();
+    for (auto* annotations : { &backgroundAnnotations, &depthSortedAnnotations })
+    {
+        for (Annotation& a : *annotations)
+        {
+            if (!a.labelText.empty())
+                declutteredLabels.push_back(&a);
+        }
+    }
+
+    if (reuseLabelPlacements())
+        return;
+
+    labelPlacements.clear();
+    auto font = getFont(FontNormal);
+    if (font == nullptr)
+        return;
+
+    std::stable_sort(declutteredLabels.begin(), declutteredLabels.end(),
+                     [](const Annotation* a, const Annotation* b) { return a->priority > b->priority; });
+
+    labelGrid.reset(windowWidth, windowHeight);
+    auto height = static_cast<float>(font->getHeight());
+    for (Annotation* a : declutteredLabels)
+    {
+        TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
+        float hOffset = 0.0f;
+        float vOffset = 0.0f;
+        getLabelAlignmentInfo(*a, font.get(), alignment, hOffset, vOffset);
+
+        auto width = static_cast<float>(TextLayout::getTextWidth(a->labelText, font.get()));
+        float x0 = std::trunc(a->position.x()) + hOffset;
+        if (alignment == TextLayout::HorizontalAlignment::Right)
+            x0 -= width;
+        else if (alignment == TextLayout::HorizontalAlignment::Center)
+            x0 -= width / 2.0f;
+        float y0 = std::trunc(a->position.y()) + vOffset;
+
+        bool visible = labelGrid.reserve(x0, y0, x0 + width, y0 + height) ||
+                       a->priority == MaxLabelPriority;
+        labelPlacements[std::hash<std::string_view>()(a->labelText)] = { a->position.head<2>(), visible };
+        if (!visible)
+            a->labelText = {};
+    }
+}
+
+
 // stars and constellations. DSOs
 void Renderer::renderAnnotations(const vector<Annotation>& annotations,
                                  FontStyle fs)
@@ -4143,6 +5361,7 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
     if (font == nullptr)
         return;
 
+    FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::Annotations);
     TextLayout layout{ screenDpi };
     layout.setFont(font);
 
@@ -4168,6 +5387,9 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
             renderAnnotationLabel(annotations[i], layout, hOffset, vOffset, 0.0f, m);
         }
     }
+
+    m_markerBatch->render(m);
+    layout.end();
 }
 
 
@@ -4232,6 +5454,7 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     if (font == nullptr)
         return endIter;
 
+    FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::Annotations);
     TextLayout layout{ screenDpi };
     layout.setFont(font);
 
@@ -4247,8 +5470,18 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     for (; iter != endIter && iter->position.z() > nearDist; ++iter)
     {
         // Compute normalized device z
-        float z = getProjectionMode()->getNormalizedDeviceZ(nearDist, farDist, iter->position.z());
-        float ndc_z = std::clamp(z, -1.0f, 1.0f);
+        float ndc_z;
+        if (m_reversedDepth)
+        {
+            // Negated, as the orthographic projection negates z
+            float z = -nearDist * (farDist / iter->position.z() - 1.0f) / (farDist - nearDist);
+            ndc_z = std::clamp(z, -1.0f, 0.0f);
+        }
+        else
+        {
+            float z = getProjectionMode()->getNormalizedDeviceZ(nearDist, farDist, iter->position.z());
+            ndc_z = std::clamp(z, -1.0f, 1.0f);
+        }
 
         if (iter->markerRep != nullptr)
         {
@@ -4268,6 +5501,9 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
         }
     }
 
+    m_markerBatch->render(m);
+    layout.end();
+
     return iter;
 }
 
@@ -4280,9 +5516,17 @@ void Renderer::markersToAnnotations(const celestia::MarkerList& markers,
     const Quaterniond& cameraOrientation = getCameraOrientation();
     Vector3d viewVector = cameraOrientation.conjugate() * -Vector3d::UnitZ();
 
+    std::vector<UniversalCoord> positions;
+    positions.reserve(markers.size());
     for (const auto& marker : markers)
+        positions.push_back(marker.position(jd));
+    std::vector<Vector3d> offsets(markers.size());
+    UniversalCoord::OffsetsFromKm(positions, cameraPosition, offsets.data());
+
+    for (std::size_t i = 0; i < markers.size(); ++i)
     {
-        Vector3d offset = marker.position(jd).offsetFromKm(cameraPosition);
+        const auto& marker = markers[i];
+        Vector3d& offset = offsets[i];
 
         double distance = offset.norm();
         // Only render those markers that lie withing the field of view.
@@ -4381,6 +5625,9 @@ void Renderer::loadTextures(Body* body)
 
 void Renderer::invalidateOrbitCache()
 {
+    // The orbits being sampled may be destroyed after this
+    if (orbitSamplingQueue != nullptr)
+        orbitSamplingQueue->clear();
     orbitCache.clear();
 }
 
@@ -4580,6 +5827,15 @@ bool Renderer::captureFrame(int x, int y, int w, int h, PixelFormat format, unsi
     return ok;
 }
 
+bool Renderer::capturesRowsTopFirst() const noexcept
+{
+#ifdef GL_ES
+    return false;
+#else
+    return detailOptions.useMesaPackInvert;
+#endif
+}
+
 static void draw_rectangle_border(const Renderer &renderer,
                                   const celestia::Rect &rect,
                                   int fishEyeOverrideMode,
@@ -4641,7 +5897,7 @@ static void draw_rectangle_solid(const Renderer &renderer,
     if (vbo == 0u)
         glGenBuffers(1, &vbo);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(RectVtx), vertices.data(), GL_STREAM_DRAW);
 
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
@@ -4666,13 +5922,14 @@ static void draw_rectangle_solid(const Renderer &renderer,
     prog->setMVPMatrices(p, m);
 
     glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    gl::countDraw(GL_TRIANGLE_FAN, 4);
 
     glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
     if (r.tex != nullptr)
         glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
     if (r.hasColors)
         glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Renderer::drawRectangle(const celestia::Rect &r, int fishEyeOverrideMode, const Eigen::Matrix4f& p, const Eigen::Matrix4f& m)
@@ -4790,25 +6047,34 @@ bool Renderer::getInfo(map<string, string>& info) const
     if (s != nullptr)
         info["Extensions"] = s;
 
+    // Live bytes of the engine subsystems, e.g. "MemoryStars"
+    if constexpr (celestia::util::MemoryAccountingEnabled)
+    {
+        for (std::size_t i = 0; i < celestia::util::MemoryTagCount; ++i)
+        {
+            auto tag = static_cast<celestia::util::MemoryTag>(i);
+            info[fmt::format("Memory{}", celestia::util::MemoryTagName(tag))] = to_string(celestia::util::LiveMemory(tag));
+        }
+    }
+
     return true;
 }
 
-FramebufferObject*
-Renderer::getShadowFBO(int index) const
+celestia::engine::ShadowAtlas*
+Renderer::getShadowAtlas() const
 {
-    return index == 0 ? m_shadowFBO.get() : nullptr;
+    return m_shadowAtlas.get();
 }
 
 void
-Renderer::createShadowFBO()
+Renderer::createShadowAtlas()
 {
-    m_shadowFBO = std::make_unique<FramebufferObject>(m_shadowMapSize,
-                                                      m_shadowMapSize,
-                                                      FramebufferObject::DepthAttachment);
-    if (!m_shadowFBO->isValid())
+    m_shadowAtlas = std::make_unique<celestia::engine::ShadowAtlas>(m_shadowMapSize,
+                                                                    static_cast<unsigned>(gl::maxTextureSize));
+    if (!m_shadowAtlas->isValid())
     {
         GetLogger()->warn("Error creating shadow FBO.\n");
-        m_shadowFBO = nullptr;
+        m_shadowAtlas = nullptr;
     }
 }
 
@@ -4818,19 +6084,58 @@ Renderer::setShadowMapSize(unsigned size)
     if (!FramebufferObject::isSupported())
         return;
     m_shadowMapSize = std::min(size, static_cast<unsigned>(gl::maxTextureSize));
-    if (m_shadowFBO != nullptr && m_shadowMapSize == m_shadowFBO->width())
+    if (m_shadowAtlas != nullptr && m_shadowMapSize == m_shadowAtlas->getTileSize())
         return;
     if (m_shadowMapSize == 0)
-        m_shadowFBO = nullptr;
+        m_shadowAtlas = nullptr;
     else
-        createShadowFBO();
+        createShadowAtlas();
 }
 
 void
 Renderer::removeInvisibleItems(const math::Frustum &frustum)
 {
     // Remove objects from the render list that lie completely outside the
-    // view frustum.
+    // view frustum or behind one of the largest ellipsoids in view, as seen
+    // from a planet's surface or a low orbit. The ellipsoids are reduced to
+    // their inscribed spheres.
+    struct Occluder
+    {
+        math::Spheref sphere;
+        float discSizeInPixels;
+    };
+
+    auto occluders = makeFrameVector<Occluder>();
+    for (const auto &ri : renderList)
+    {
+        if (ri.renderableType == RenderListEntry::RenderableBody &&
+            ri.discSizeInPixels >= MinOccluderSizeInPixels &&
+            ri.body->isEllipsoid() &&
+            ri.body->hasVisibleGeometry())
+        {
+            occluders.push_back(Occluder{ math::Spheref(ri.position, ri.body->getSemiAxes().minCoeff()),
+                                          ri.discSizeInPixels });
+        }
+    }
+
+    if (occluders.size() > MaxOccluders)
+    {
+        std::partial_sort(occluders.begin(), occluders.begin() + MaxOccluders, occluders.end(),
+                          [](const Occluder &a, const Occluder &b) { return a.discSizeInPixels > b.discSizeInPixels; });
+        occluders.resize(MaxOccluders);
+    }
+
+    // A sphere can't be hidden by an occluder inside it, so occluders
+    // don't remove themselves
+    auto isOccluded = [&occluders](const Vector3f &center, float radius)
+    {
+        return std::any_of(occluders.begin(), occluders.end(),
+                           [sphere = math::Spheref(center, radius)](const Occluder &o)
+                           {
+                               return math::testOcclusion(o.sphere, sphere);
+                           });
+    };
+
     auto notCulled = renderList.begin();
     for (auto &ri : renderList)
     {
@@ -4880,7 +6185,8 @@ Renderer::removeInvisibleItems(const math::Frustum &frustum)
 
         Vector3f center = getCameraOrientationf().toRotationMatrix() * ri.position;
         // Test the object's bounding sphere against the view frustum
-        if (frustum.testSphere(center, cullRadius) != math::Frustum::Outside)
+        if (frustum.testSphere(center, cullRadius) != math::Frustum::Outside &&
+            !isOccluded(ri.position, cullRadius))
         {
             float nearZ = center.norm() - radius;
             float maxSpan = hypot((float) windowWidth, (float) windowHeight);
@@ -4938,6 +6244,38 @@ Renderer::removeInvisibleItems(const math::Frustum &frustum)
 
     renderList.resize(notCulled - renderList.begin());
 
+    // Test the point bodies in one batch, with the frustum rotated into
+    // the frame of their positions rather than each position into the
+    // camera frame
+    math::Frustum pointFrustum = frustum;
+    pointFrustum.transform(getCameraOrientationf().conjugate().toRotationMatrix());
+    pointBodyPositions.clear();
+    for (const PointBodyEntry& entry : pointBodyList)
+        pointBodyPositions.push_back(entry.position);
+    pointBodyVisibility.resize((pointBodyPositions.size() + 31) / 32);
+    pointFrustum.testSpheres(pointBodyPositions.data(), nullptr, pointBodyPositions.size(), pointBodyVisibility.data());
+
+    std::size_t nVisiblePoints = 0;
+    for (std::size_t i = 0; i < pointBodyList.size(); i++)
+    {
+        if ((pointBodyVisibility[i / 32] & (1U << (i % 32))) != 0 &&
+            !isOccluded(pointBodyList[i].position, 0.0f))
+        {
+            pointBodyList[nVisiblePoints++] = pointBodyList[i];
+        }
+    }
+    pointBodyList.resize(nVisiblePoints);
+
+    if (!occluders.empty())
+    {
+        auto hiddenOrbits = std::remove_if(orbitPathList.begin(), orbitPathList.end(),
+                                           [&](const OrbitPathListEntry& path)
+                                           {
+                                               return isOccluded(path.origin.cast<float>(), path.radius);
+                                           });
+        orbitPathList.erase(hiddenOrbits, orbitPathList.end());
+    }
+
     // The calls to buildRenderLists/renderStars filled renderList
     // with visible bodies.  Sort it front to back, then
     // render each entry in reverse order (TODO: convenient, but not
@@ -5052,20 +6390,28 @@ Renderer::buildNearSystemsLists(const Universe &universe,
 
     universe.getNearStars(observerPos, SolarSystemMaxDistance, nearStars);
 
+    // The positions of the stars, taking into account their possible
+    // orbital motion, relative to the observer
+    nearStarPositions.clear();
+    for (const auto star : nearStars)
+        nearStarPositions.push_back(star->getPosition(now));
+    nearStarOffsets.resize(nearStars.size());
+    UniversalCoord::OffsetsFromKm(nearStarPositions, observerPos, nearStarOffsets.data());
+
     // Set up direct light sources (i.e. just stars at the moment)
     // Skip if only star orbits to be shown
     if ((renderFlags & ShowSolarSystemObjects) != 0)
         setupLightSources(nearStars,
-                          observerPos,
-                          now,
+                          nearStarOffsets,
                           lightSourceList,
                           tintSaturation,
                           starColors.type() == ColorTableType::Enhanced ? nullptr : &tintColors);
 
     // Traverse the frame trees of each nearby solar system and
     // build the list of objects to be rendered.
-    for (const auto sun : nearStars)
+    for (std::size_t i = 0; i < nearStars.size(); ++i)
     {
+        const Star* sun = nearStars[i];
         addStarOrbitToRenderList(*sun, observer, now);
         // Skip if only star orbits to be shown
         if ((renderFlags & ShowSolarSystemObjects) == 0)
@@ -5086,13 +6432,13 @@ Renderer::buildNearSystemsLists(const Universe &universe,
             solarSysTree->markUpdated();
         }
 
-        // Compute the position of the observer in astrocentric coordinates
-        Vector3d astrocentricObserverPos = astrocentricPosition(observerPos, *sun, now);
+        // The position of the observer in astrocentric coordinates
+        Vector3d astrocentricObserverPos = -nearStarOffsets[i];
 
         // Build render lists for bodies and orbits paths
         buildRenderLists(astrocentricObserverPos, xfrustum,
                          observerOrient.conjugate() * -Vector3d::UnitZ(),
-                         Vector3d::Zero(), solarSysTree, observer, now);
+                         solarSysTree, now);
         if ((renderFlags & ShowOrbits) != 0)
         {
             buildOrbitLists(astrocentricObserverPos, observerOrient,
@@ -5124,6 +6470,15 @@ Renderer::buildDepthPartitions()
     if (nEntries > 0)
         prevNear = renderList[nEntries - 1].farZ * 1.01f;
 
+    // The bodies drawn as points must lie within the partitions too
+    float nearestPoint = -std::numeric_limits<float>::max();
+    for (const auto& entry : pointBodyList)
+    {
+        nearestPoint = max(nearestPoint, entry.centerZ);
+        if (nEntries > 0)
+            prevNear = min(prevNear, entry.centerZ * 1.01f);
+    }
+
     int i;
 
     // Completely partition the depth buffer. Scan from back to front
@@ -5225,6 +6580,13 @@ Renderer::buildDepthPartitions()
         }
     }
 
+    if (!pointBodyList.empty())
+    {
+        closest = max(closest, nearestPoint * 0.999f);
+        if (closest == 0.0f)
+            closest = nearestPoint * 0.01f;
+    }
+
     DepthBufferPartition partition;
     partition.index = nIntervals;
     partition.nearZ = closest;
@@ -5244,14 +6606,68 @@ Renderer::buildDepthPartitions()
     // We want to avoid overpartitioning the depth buffer. In this stage, we
     // coalesce partitions that have small spans in the depth buffer.
     // TODO: Implement this step!
+
+    // A reversed floating point depth range has the precision for the
+    // whole span in one interval
+    if (m_reversedDepth && nIntervals > 1)
+    {
+        DepthBufferPartition whole;
+        whole.index = 0;
+        whole.nearZ = depthPartitions.back().nearZ;
+        whole.farZ = depthPartitions.front().farZ;
+        depthPartitions.assign(1, whole);
+        nIntervals = 1;
+    }
+
+    assignPointBodiesToIntervals();
+
     return nIntervals;
 }
 
+
+// Sort the bodies drawn as points by the depth buffer interval containing
+// them, and record where the entries of each interval start.
+void
+Renderer::assignPointBodiesToIntervals()
+{
+    auto nIntervals = depthPartitions.size();
+    pointBodyIntervals.assign(nIntervals + 1, 0);
+    if (pointBodyList.empty())
+        return;
+
+    // The nearer planes of the intervals increase from the farthest one
+    for (auto& entry : pointBodyList)
+    {
+        auto partition = std::lower_bound(depthPartitions.begin(), depthPartitions.end(), entry.centerZ,
+                                          [](const DepthBufferPartition& p, float z) { return p.nearZ < z; });
+        entry.interval = static_cast<int>(std::min(static_cast<std::size_t>(partition - depthPartitions.begin()), nIntervals - 1));
+        pointBodyIntervals[entry.interval + 1]++;
+    }
+
+    std::partial_sum(pointBodyIntervals.begin(), pointBodyIntervals.end(), pointBodyIntervals.begin());
+
+    auto sorted = makeFrameVector<PointBodyEntry>();
+    sorted.resize(pointBodyList.size());
+    auto next = makeFrameVector<std::size_t>();
+    next.assign(pointBodyIntervals.begin(), pointBodyIntervals.end() - 1);
+    for (const auto& entry : pointBodyList)
+        sorted[next[entry.interval]++] = entry;
+    std::copy(sorted.begin(), sorted.end(), pointBodyList.begin());
+}
+
 void
 Renderer::renderSolarSystemObjects(const Observer &observer,
                                    int nIntervals,
                                    double now)
 {
+    // The depth values of the background are in the usual range, but lie
+    // behind everything in the solar system
+    if (m_reversedDepth)
+    {
+        setReversedDepthState(true);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
     // Render everything that wasn't culled.
     auto annotation = depthSortedAnnotations.begin();
     float intervalSize = 1.0f / static_cast<float>(max(1, nIntervals));
@@ -5272,7 +6688,13 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         // Set up a perspective projection using the current interval's near and
         // far clip planes.
         Matrix4f proj;
-        buildProjectionMatrix(proj, nearPlaneDistance, farPlaneDistance, observer.getZoom());
+        if (m_reversedDepth)
+            proj = projectionMode->getSubViewMatrix() *
+                   projectionMode->getReversedDepthProjectionMatrix(nearPlaneDistance, farPlaneDistance, observer.getZoom());
+        else
+            buildProjectionMatrix(proj, nearPlaneDistance, farPlaneDistance, observer.getZoom());
+        if (m_eyeShift != 0.0f)
+            proj = projectionMode->getEyeProjectionMatrix(proj, m_eyeShift, m_eyeOffset);
         Matrices m = { &proj, &m_modelMatrix };
 
         setCurrentProjectionMatrix(proj);
@@ -5297,6 +6719,7 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         // Render orbit paths
         if (!orbitPathList.empty())
         {
+            FrameProfiler::Scope scope(*frameProfiler, FrameProfiler::Section::Orbits);
             math::Frustum intervalFrustum = projectionMode->getFrustum(nearPlaneDistance, farPlaneDistance, observer.getZoom());
 
             // Scan through the list of orbits and render any that overlap this interval
@@ -5336,6 +6759,7 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         setPipelineState(ps);
 
         PointStarVertexBuffer::enable();
+        renderPointBodies(interval, m);
         glareVertexBuffer->startSprites();
         glareVertexBuffer->render();
         glareVertexBuffer->finish();
@@ -5358,12 +6782,85 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
     // reset the depth range
     glDepthRange(0, 1);
     setDefaultProjectionMatrix();
+
+    if (m_reversedDepth)
+    {
+        setReversedDepthState(false);
+        m_reversedDepth = false;
+    }
+}
+
+
+/*! Check whether the solar system objects can be drawn in a single depth
+ *  buffer interval: this needs a floating point depth buffer, which the
+ *  default framebuffer rarely has, but the framebuffers of the viewport
+ *  effects do, and a projection whose depth can be reversed.
+ */
+bool
+Renderer::canUseReversedDepth()
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (!detailOptions.reversedDepth || !gl::ARB_clip_control || !projectionMode->supportsReversedDepth())
+        return false;
+
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    if (framebuffer != m_checkedDepthFramebuffer)
+    {
+        GLenum attachment = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+        GLint objectType = GL_NONE;
+        glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                              GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &objectType);
+        GLint componentType = GL_NONE;
+        if (objectType != GL_NONE)
+        {
+            glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, attachment,
+                                                  GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+        }
+
+        m_checkedDepthFramebuffer = framebuffer;
+        m_floatDepthBuffer = componentType == GL_FLOAT;
+    }
+
+    return m_floatDepthBuffer;
+#endif
+}
+
+
+/*! With reversed depth, clip space depth ranges from 0 to 1 instead of -1
+ *  to 1, the depth buffer is cleared to 0, and nearer fragments have the
+ *  larger depth values.
+ */
+void
+Renderer::setReversedDepthState(bool reversed) const
+{
+#ifdef GL_ES
+    (void) reversed;
+#else
+    if (reversed)
+    {
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0.0);
+        glDepthFunc(GL_GEQUAL);
+    }
+    else
+    {
+        glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+        glClearDepth(1.0);
+        // LEQUAL rather than LESS required for multipass rendering
+        glDepthFunc(GL_LEQUAL);
+    }
+#endif
 }
 
 void
 Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
 {
-    if (ps.blending != m_pipelineState.blending)
+    bool blendingChanged = ps.blending != m_pipelineState.blending;
+    gl::countStateChange(blendingChanged);
+    if (blendingChanged)
     {
         if (ps.blending)
             glEnable(GL_BLEND);
@@ -5371,12 +6868,20 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
             glDisable(GL_BLEND);
         m_pipelineState.blending = ps.blending;
     }
-    if (ps.blending && (ps.blendFunc.src != m_pipelineState.blendFunc.src || ps.blendFunc.dst != m_pipelineState.blendFunc.dst))
+    if (ps.blending)
     {
-        glBlendFuncSeparate(ps.blendFunc.src, ps.blendFunc.dst, GL_ZERO, GL_ONE);
-        m_pipelineState.blendFunc = ps.blendFunc;
+        bool blendFuncChanged = ps.blendFunc.src != m_pipelineState.blendFunc.src ||
+                                ps.blendFunc.dst != m_pipelineState.blendFunc.dst;
+        gl::countStateChange(blendFuncChanged);
+        if (blendFuncChanged)
+        {
+            glBlendFuncSeparate(ps.blendFunc.src, ps.blendFunc.dst, GL_ZERO, GL_ONE);
+            m_pipelineState.blendFunc = ps.blendFunc;
+        }
     }
-    if (ps.depthTest != m_pipelineState.depthTest)
+    bool depthTestChanged = ps.depthTest != m_pipelineState.depthTest;
+    gl::countStateChange(depthTestChanged);
+    if (depthTestChanged)
     {
         if (ps.depthTest)
             glEnable(GL_DEPTH_TEST);
@@ -5384,7 +6889,9 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
             glDisable(GL_DEPTH_TEST);
         m_pipelineState.depthTest = ps.depthTest;
     }
-    if (ps.depthMask != m_pipelineState.depthMask)
+    bool depthMaskChanged = ps.depthMask != m_pipelineState.depthMask;
+    gl::countStateChange(depthMaskChanged);
+    if (depthMaskChanged)
     {
         glDepthMask(ps.depthMask ? GL_TRUE : GL_FALSE);
         m_pipelineState.depthMask = ps.depthMask;
@@ -5403,5 +6910,5 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
 
 void Renderer::buildProjectionMatrix(Eigen::Matrix4f &mat, float nearZ, float farZ, float zoom) const
 {
-    mat = projectionMode->getProjectionMatrix(nearZ, farZ, zoom);
+    mat = projectionMode->getSubViewMatrix() * projectionMode->getProjectionMatrix(nearZ, farZ, zoom);
 }
@@ -10,13 +10,22 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
 
+#include <celcompat/filesystem.h>
+#include <celengine/eclipsecasters.h>
+#include <celengine/frametree.h>
+#include <celengine/labelgrid.h>
 #include <celengine/lightenv.h>
 #include <celengine/universe.h>
 #include <celengine/selection.h>
@@ -26,24 +35,46 @@
 #include <celengine/renderlistentry.h>
 #include <celengine/textlayout.h>
 #include <celrender/rendererfwd.h>
+#include <celutil/monotonicarena.h>
+#include <celutil/stringarena.h>
 
 class RendererWatcher;
-class FrameTree;
 class ReferenceMark;
 class CurvePlot;
 class PointStarVertexBuffer;
+class PointStarRenderer;
+class DSODatabase;
+class DSORenderer;
+struct PointStarProgress;
+struct PointStarStaging;
+struct DSOStaging;
 class Observer;
 class Surface;
 class TextureFont;
-class FramebufferObject;
 
 namespace celestia
 {
 class Rect;
 
+namespace engine
+{
+class FrameProfiler;
+class GPUStarCuller;
+class MarkerBatch;
+class OrbitSamplingQueue;
+class ScatteringTableManager;
+class ScatteringTables;
+class ShadowAtlas;
+class StarFieldCache;
+class StarTileDatabase;
+class TerrainManager;
+class TextureResolutionSelector;
+}
+
 namespace gl
 {
 class Buffer;
+class StreamBuffer;
 class VertexObject;
 }
 
@@ -115,6 +146,102 @@ class Renderer
         double orbitWindowEnd{ 0.5 };
         double orbitPeriodsShown{ 1.0 };
         double linearFadeFraction{ 0.0 };
+        // Keep the samples of cached orbit paths in GPU buffers
+        bool residentOrbitPaths{ false };
+        // Number of threads sampling new orbit paths, 0 samples orbits
+        // when they are first drawn
+        unsigned int orbitSamplingThreads{ 0 };
+        // Time per frame spent adding sampled orbit paths and sampling
+        // orbits which can't be sampled in the background
+        double orbitSamplingTime{ 0.004 };
+        // Number of threads used to find the visible solar system bodies,
+        // 0 uses all the shared workers
+        unsigned int renderListThreads{ 1 };
+        // Number of threads used to traverse the star octree, 0 uses all
+        // the shared workers
+        unsigned int starRenderThreads{ 1 };
+        // Number of threads used to traverse the deep sky object octree,
+        // 0 uses all the shared workers
+        unsigned int dsoRenderThreads{ 1 };
+        // Time per frame spent traversing the star octree, the rest of the
+        // stars are added over the next frames while the view stays the
+        // same; 0 = render all the stars every frame
+        double starRenderTime{ 0.0 };
+        // Cull the stars with a compute shader when OpenGL 4.3 is
+        // available
+        bool gpuStarCulling{ false };
+        // Number of threads decoding textures in the background, 0 loads
+        // textures synchronously when they are first used
+        unsigned int textureLoadThreads{ 0 };
+        // Time per frame spent creating textures loaded in the background
+        double textureUploadTime{ 0.004 };
+        // Bytes of tiles kept resident for each virtual texture, 0 = no limit
+        std::size_t virtualTextureCacheSize{ 512 * 1024 * 1024 };
+        // Bytes of textures and models kept loaded, 0 = no limit
+        std::size_t textureMemoryBudget{ 0 };
+        // Choose the texture resolution of each body from the size of
+        // its disc, lowering it under texture memory or frame time
+        // pressure, instead of using the global resolution
+        bool autoTextureResolution{ false };
+        // Frame time above which the automatic texture resolution is
+        // lowered, in seconds
+        double targetFrameTime{ 1.0 / 60.0 };
+        std::size_t geometryMemoryBudget{ 0 };
+        // Number of threads loading nebula meshes in the background, 0
+        // loads them when they are first seen
+        unsigned int nebulaLoadThreads{ 0 };
+        // Seconds after which the mesh of a nebula out of view is released,
+        // 0 = never
+        double nebulaUnloadTime{ 0.0 };
+        // Keep DXT compressed copies of textures on disk
+        bool textureCache{ false };
+        // Largest width or height of loaded textures, 0 = no limit
+        unsigned int textureSizeLimit{ 0 };
+        // Bytes of texture data uploaded at a time, textures larger than
+        // that are uploaded over several frames; 0 = upload at once
+        std::size_t textureUploadChunkSize{ 0 };
+        // Hide the text of labels overlapping more important labels
+        bool declutterLabels{ false };
+        // Directory keeping the binaries of linked shader programs, empty
+        // to compile all shaders at startup
+        fs::path shaderCacheDirectory{ };
+        // Directory keeping the conditioned models loaded in earlier
+        // sessions, empty to load all models from their source files
+        fs::path modelCacheDirectory{ };
+        // Time per frame spent building the shaders used in earlier
+        // sessions ahead of their first use, 0 = build shaders on first use
+        double shaderWarmUpTime{ 0.0 };
+        // Triangles drawn for each body with a height map
+        std::size_t terrainTriangleBudget{ 500000 };
+        // Bytes of terrain vertices uploaded per frame and kept in GPU
+        // memory, 0 = no limit to the memory
+        std::size_t terrainUploadBudget{ 256 * 1024 };
+        std::size_t terrainMemoryBudget{ 64 * 1024 * 1024 };
+        // Draw atmospheres from precomputed scattering tables
+        bool scatteringTables{ false };
+        // Reorder the triangles and vertices of loaded models for the
+        // vertex cache
+        bool optimizeModels{ true };
+        // Size of the faces of the cube on which distant stars and deep sky
+        // objects are kept while the observer stays put, 0 = render them
+        // every frame
+        unsigned int starFieldCacheSize{ 0 };
+        // Stream the star sprites in 8 byte vertices instead of 20 bytes,
+        // in views where their packed directions are precise enough
+        bool packedStarVertices{ false };
+        // Draw solar systems in a single depth buffer interval with a
+        // reversed floating point depth range, when the depth buffer has
+        // floating point values and GL_ARB_clip_control is available
+        bool reversedDepth{ false };
+        // Render side by side views for the left and right eyes, which
+        // share the culling, render lists and labels of the center of the
+        // view. The separation of the eyes is a fraction of the distance
+        // to the nearest object, which appears at screen depth; 0 = no
+        // stereo.
+        float stereoSeparation{ 0.0f };
+        // Draw the glyphs of fonts loaded afterwards from signed distance
+        // fields rendered once per face instead of bitmaps per size
+        bool distanceFieldFonts{ false };
 #ifndef GL_ES
         bool useMesaPackInvert{ true };
 #endif
@@ -242,6 +369,8 @@ class Renderer
     void setLabelMode(int);
     std::shared_ptr<celestia::engine::ProjectionMode> getProjectionMode() const;
     void setProjectionMode(std::shared_ptr<celestia::engine::ProjectionMode>);
+    // Part of the view rendered in the window, kept across projection modes
+    void setSubView(const Eigen::Vector4f&);
     float getAmbientLightLevel() const;
     void setAmbientLightLevel(float);
     float getTintSaturation() const;
@@ -255,6 +384,7 @@ class Renderer
     int getOrbitMask() const;
     void setOrbitMask(int);
     int getScreenDpi() const;
+    bool getDistanceFieldFonts() const { return detailOptions.distanceFieldFonts; }
     void setScreenDpi(int);
     int getWindowWidth() const;
     int getWindowHeight() const;
@@ -262,6 +392,8 @@ class Renderer
     float getScaleFactor() const;
     float getPointWidth() const;
     float getPointHeight() const;
+    // Angular size of a pixel at the center of the view
+    float getPixelSize() const { return pixelSize; }
 
     // GL wrappers
     void getViewport(int* x, int* y, int* w, int* h) const;
@@ -290,6 +422,8 @@ class Renderer
     void setShadowMapSize(unsigned);
 
     bool captureFrame(int, int, int, int, celestia::engine::PixelFormat format, unsigned char*) const;
+    // True if glReadPixels returns the top row first
+    bool capturesRowsTopFirst() const noexcept;
 
     void renderMarker(celestia::MarkerRepresentation::Symbol symbol,
                       float size,
@@ -372,47 +506,64 @@ class Renderer
         Top,
     };
 
+    // Labels with this priority are never hidden by label decluttering
+    static constexpr float MaxLabelPriority = std::numeric_limits<float>::max();
+
     struct Annotation
     {
-        std::string labelText;
+        // Stored in annotationText until the next frame
+        std::string_view labelText;
         const celestia::MarkerRepresentation* markerRep;
         Color color;
         Eigen::Vector3f position;
         LabelHorizontalAlignment halign : 3;
         LabelVerticalAlignment valign : 3;
         float size;
+        // When labels overlap, the text of the ones with lower priority
+        // is hidden
+        float priority;
 
         bool operator<(const Annotation&) const;
     };
 
     void addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = MaxLabelPriority);
     void addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = MaxLabelPriority);
     void addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                             const std::string& labelText,
+                             std::string_view labelText,
                              Color color,
                              const Eigen::Vector3f& position,
                              LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                              LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
-                             float size = 0.0f);
+                             float size = 0.0f,
+                             float priority = MaxLabelPriority);
 
     ShaderManager& getShaderManager() const { return *shaderManager; }
+    celestia::engine::FrameProfiler& getFrameProfiler() const { return *frameProfiler; }
+    celestia::engine::TerrainManager& getTerrainManager() const { return *terrainManager; }
+    // Scattering tables of an atmosphere around a planet with a radius in
+    // km, nullptr if they're disabled or not computed yet
+    const celestia::engine::ScatteringTables* getScatteringTables(const Atmosphere& atmosphere, float radius) const;
+    // Ring buffer shared by the renderers uploading vertices every frame
+    celestia::gl::StreamBuffer* getStreamBuffer() const { return streamBuffer.get(); }
 
     // Callbacks for renderables; these belong in a special renderer interface
     // only visible in object's render methods.
     void beginObjectAnnotations();
-    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, const std::string& labelText, Color, const Eigen::Vector3f&, LabelHorizontalAlignment halign, LabelVerticalAlignment valign);
+    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, std::string_view labelText, Color, const Eigen::Vector3f&, LabelHorizontalAlignment halign, LabelVerticalAlignment valign);
     void endObjectAnnotations();
     Eigen::Quaternionf getCameraOrientationf() const;
     Eigen::Quaterniond getCameraOrientation() const;
@@ -452,7 +603,13 @@ class Renderer
     void removeWatcher(RendererWatcher*);
     void notifyWatchers() const;
 
-    FramebufferObject* getShadowFBO(int) const;
+    celestia::engine::ShadowAtlas* getShadowAtlas() const;
+
+    // Whether the solar system objects are being drawn with a reversed
+    // depth range, and switching the depth state to the reversed or the
+    // usual range, for instance around passes drawing shadow maps
+    bool usesReversedDepth() const { return m_reversedDepth; }
+    void setReversedDepthState(bool reversed) const;
 
  public:
     struct RenderProperties
@@ -475,22 +632,80 @@ class Renderer
         float farZ;
     };
 
+    // A body which is only visible as a point. These are drawn in one batch
+    // per depth buffer interval instead of being added to the render list.
+    struct PointBodyEntry
+    {
+        Eigen::Vector3f position;
+        Color color;
+        float centerZ;
+        float appMag;
+        float discSizeInPixels;
+        int interval;
+    };
+
+    // The lists filled by buildRenderLists, either the renderer's own or
+    // the per-thread fragments of a parallel traversal
+    struct RenderListOutput
+    {
+        std::vector<RenderListEntry>& renderList;
+        std::vector<PointBodyEntry>& pointBodyList;
+        std::vector<SecondaryIlluminator>& secondaryIlluminators;
+    };
+
+    struct RenderListFragment
+    {
+        std::vector<RenderListEntry> renderList;
+        std::vector<PointBodyEntry> pointBodyList;
+        std::vector<SecondaryIlluminator> secondaryIlluminators;
+    };
+
  private:
     void setFieldOfView(float);
+    // Stars between minDistance and maxDistance light years away
     void renderPointStars(const StarDatabase& starDB,
                           float faintestVisible,
-                          const Observer& observer);
+                          const Observer& observer,
+                          float minDistance = 0.0f,
+                          float maxDistance = std::numeric_limits<float>::infinity(),
+                          celestia::engine::StarTileDatabase* starTiles = nullptr);
+    void renderPointStarsParallel(const StarDatabase& starDB,
+                                  PointStarRenderer& starRenderer,
+                                  float faintestVisible);
+    void renderPointStarsProgressive(const StarDatabase& starDB,
+                                     PointStarRenderer& starRenderer,
+                                     float faintestVisible);
+    // Return false if the stars must be culled on the CPU
+    bool renderPointStarsGPU(const StarDatabase& starDB,
+                             PointStarRenderer& starRenderer,
+                             float faintestVisible);
     void renderDeepSkyObjects(const Universe&,
                               const Observer&,
-                              float faintestMagNight);
+                              float faintestMagNight,
+                              float zoom);
+    void renderDeepSkyObjectsParallel(const DSODatabase& dsoDB,
+                                      DSORenderer& dsoRenderer,
+                                      float faintestMagNight);
+    // Draw the distant stars and deep sky objects from the star field
+    // cache, rendering it again first if needed. Return false if they must
+    // be rendered directly.
+    bool renderCachedStarField(const Universe&,
+                               const Observer&,
+                               float faintestMagNight,
+                               bool starFieldChanged);
+    void captureStarField(const Universe&,
+                          const Observer&,
+                          float faintestMagNight);
     void renderSkyGrids(const Observer& observer);
     void renderSelectionPointer(const Observer& observer,
                                 double now,
                                 const celestia::math::Frustum& viewFrustum,
                                 const Selection& sel);
 
-    void renderAsterisms(const Universe&, float, const Matrices&);
-    void renderBoundaries(const Universe&, float, const Matrices&);
+    void renderAsterisms(const Universe&, float, const Matrices&,
+                         const celestia::math::Frustum&, const Eigen::Vector3f&);
+    void renderBoundaries(const Universe&, float, const Matrices&,
+                          const celestia::math::Frustum&, const Eigen::Vector3f&);
     void renderCrosshair(float size, double tsec, const Color &color, const Matrices &m);
 
     void buildNearSystemsLists(const Universe &universe,
@@ -501,10 +716,22 @@ class Renderer
     void buildRenderLists(const Eigen::Vector3d& astrocentricObserverPos,
                           const celestia::math::Frustum& viewFrustum,
                           const Eigen::Vector3d& viewPlaneNormal,
-                          const Eigen::Vector3d& frameCenter,
                           const FrameTree* tree,
-                          const Observer& observer,
                           double now);
+    void buildRenderListsParallel(const Eigen::Vector3d& astrocentricObserverPos,
+                                  const celestia::math::Frustum& viewFrustum,
+                                  const Eigen::Vector3d& viewPlaneNormal,
+                                  const FrameTree* tree,
+                                  double now);
+    void buildRenderLists(const Eigen::Vector3d& astrocentricObserverPos,
+                          const celestia::math::Frustum& viewFrustum,
+                          const Eigen::Vector3d& viewPlaneNormal,
+                          const Eigen::Vector3d& frameCenter,
+                          const FrameTree* tree,
+                          unsigned int firstChild,
+                          unsigned int lastChild,
+                          double now,
+                          const RenderListOutput& output) const;
     void buildOrbitLists(const Eigen::Vector3d& astrocentricObserverPos,
                          const Eigen::Quaterniond& observerOrientation,
                          const celestia::math::Frustum& viewFrustum,
@@ -513,18 +740,30 @@ class Renderer
     void buildLabelLists(const celestia::math::Frustum& viewFrustum,
                          double now);
     int buildDepthPartitions();
+    bool canUseReversedDepth();
+
 
+    bool isChildGroupCulled(const FrameTree::ChildGroup& group,
+                            const Eigen::Vector3d& center_v,
+                            const celestia::math::Frustum& viewFrustum,
+                            int labelClassMask) const;
 
     void addRenderListEntries(RenderListEntry& rle,
                               Body& body,
-                              bool isLabeled);
+                              bool isLabeled,
+                              const RenderListOutput& output) const;
+    void setRenderListOpacity(std::size_t first);
 
     void addStarOrbitToRenderList(const Star& star,
                                   const Observer& observer,
                                   double now);
 
     void removeInvisibleItems(const celestia::math::Frustum &frustum);
+    void assignPointBodiesToIntervals();
 
+    // Texture resolution of a body whose disc has a radius of
+    // discSizeInPixels
+    unsigned int getObjectTextureResolution(float discSizeInPixels) const;
     void renderObject(const Eigen::Vector3f& pos,
                       float distance,
                       const Observer& observer,
@@ -570,6 +809,13 @@ class Renderer
                             float &alpha,
                             float &glareSize,
                             float &glareAlpha) const;
+    bool calculatePointSprites(float appMag,
+                               float discSizeInPixels,
+                               bool emissive,
+                               float &pointSize,
+                               float &alpha,
+                               float &glareSize,
+                               float &glareAlpha) const;
 
     void renderObjectAsPoint(const Eigen::Vector3f& center,
                              float radius,
@@ -579,6 +825,7 @@ class Renderer
                              bool useHalos,
                              bool emissive,
                              const Matrices&);
+    void renderPointBodies(int interval, const Matrices&);
 
     void locationsToAnnotations(const Body& body,
                                 const Eigen::Vector3d& bodyPosition,
@@ -592,25 +839,29 @@ class Renderer
                     const Matrices&);
 
     bool testEclipse(const Body& receiver,
+                     const Eigen::Vector3d& receiverPosition,
                      const Body& caster,
+                     const Eigen::Vector3d& casterPosition,
                      LightingState& lightingState,
                      unsigned int lightIndex,
                      double now);
 
     void labelConstellations(const AsterismList& asterisms,
-                             const Observer& observer);
+                             const Observer& observer,
+                             const celestia::math::Frustum& xfrustum);
 
     void getLabelAlignmentInfo(const Annotation &annotation, const TextureFont *font, celestia::engine::TextLayout::HorizontalAlignment &halign, float &hOffset, float &vOffset) const;
 
     void addAnnotation(std::vector<Annotation>&,
                        const celestia::MarkerRepresentation*,
-                       const std::string& labelText,
+                       std::string_view labelText,
                        Color color,
                        const Eigen::Vector3f& position,
                        LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                        LabelVerticalAlignment = LabelVerticalAlignment::Bottom,
                        float size = 0.0f,
-                       bool special = false);
+                       bool special = false,
+                       float priority = MaxLabelPriority);
     void renderAnnotationMarker(const Annotation &a,
                                 celestia::engine::TextLayout &layout,
                                 float depth,
@@ -621,6 +872,9 @@ class Renderer
                                float vOffset,
                                float depth,
                                const Matrices&);
+    void sortAnnotations();
+    void declutterLabels();
+    bool reuseLabelPlacements();
     void renderAnnotations(const std::vector<Annotation>&,
                            FontStyle fs);
     void renderBackgroundAnnotations(FontStyle fs);
@@ -654,16 +908,56 @@ class Renderer
                      const celestia::math::Frustum& frustum,
                      float nearDist,
                      float farDist);
+    std::unique_ptr<CurvePlot> sampleOrbitPath(const celestia::ephem::Orbit*,
+                                               double startTime,
+                                               double endTime);
+    void addSampledOrbitPaths();
 
     void renderSolarSystemObjects(const Observer &observer,
                                   int nIntervals,
                                   double now);
 
+    enum class Eye
+    {
+        Center,
+        Left,
+        Right,
+    };
+
+    // Draw the scene from the render lists; the right eye reuses the
+    // annotations and depth partitions of the left one
+    void renderEye(Eye eye,
+                   const Observer& observer,
+                   const Universe& universe,
+                   const Selection& sel,
+                   const celestia::math::Frustum& frustum,
+                   const celestia::math::Frustum& xfrustum,
+                   double now,
+                   bool starFieldChanged);
+    void renderStereo(const Observer& observer,
+                      const Universe& universe,
+                      const Selection& sel,
+                      const celestia::math::Frustum& frustum,
+                      const celestia::math::Frustum& xfrustum,
+                      double now,
+                      bool starFieldChanged);
+
     void updateBodyVisibilityMask();
 
-    void createShadowFBO();
+    void createShadowAtlas();
 
  private:
+    // Containers for temporary data of a frame, the memory is taken from
+    // frameArena, which is reset at the beginning of each frame
+    template<typename T>
+    using FrameVector = std::vector<T, celestia::util::ArenaAllocator<T>>;
+
+    template<typename T>
+    FrameVector<T> makeFrameVector()
+    {
+        return FrameVector<T>(celestia::util::ArenaAllocator<T>(frameArena));
+    }
+
     ShaderManager* shaderManager{ nullptr };
 
     int windowWidth;
@@ -677,6 +971,7 @@ class Renderer
     std::vector<std::shared_ptr<TextureFont>> fonts{FontCount, nullptr};
 
     std::shared_ptr<celestia::engine::ProjectionMode> projectionMode{ nullptr };
+    Eigen::Vector4f subView{ 0.0f, 0.0f, 1.0f, 1.0f };
     int renderMode;
     int labelMode;
     bool rtl{ false };
@@ -702,16 +997,56 @@ class Renderer
     Eigen::Matrix3d m_cameraTransform{ Eigen::Matrix3d::Identity() };
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
+    // Per-subtree output of parallel star rendering, kept to reuse allocations
+    std::vector<PointStarStaging> starStaging;
+    // Per-subtree output of parallel deep sky object rendering
+    std::vector<DSOStaging> dsoStaging;
+    // Per-chunk output of parallel render list building
+    std::vector<RenderListFragment> renderListFragments;
     std::vector<RenderListEntry> renderList;
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
+    // Sorted by interval after the depth buffer has been partitioned, with
+    // the entries of interval i starting at pointBodyIntervals[i]
+    std::vector<PointBodyEntry> pointBodyList;
+    std::vector<std::size_t> pointBodyIntervals;
+    // Scratch space for culling the point bodies in one batch
+    std::vector<Eigen::Vector3f> pointBodyPositions;
+    std::vector<std::uint32_t> pointBodyVisibility;
     std::vector<Annotation> backgroundAnnotations;
     std::vector<Annotation> foregroundAnnotations;
     std::vector<Annotation> depthSortedAnnotations;
     std::vector<Annotation> objectAnnotations;
+    // Marker and selection annotations of the left eye, drawn again for
+    // the right one
+    std::vector<Annotation> stereoBackgroundAnnotations;
+    std::vector<Annotation> stereoForegroundAnnotations;
+    celestia::util::MonotonicArena frameArena;
+    celestia::util::StringArena annotationText;
+    // Indices of depthSortedAnnotations in the depth order of the last
+    // frame, and storage for sorting them
+    std::vector<std::uint32_t> annotationOrder;
+    std::vector<Annotation> sortedAnnotations;
+    // Labels considered by label decluttering, and where they were placed
+    // the last time the overlapping labels were found
+    struct LabelPlacement
+    {
+        Eigen::Vector2f position;
+        bool visible;
+    };
+    std::vector<Annotation*> declutteredLabels;
+    // Keyed by the hash of the label text
+    std::unordered_map<std::size_t, LabelPlacement> labelPlacements;
+    celestia::engine::LabelGrid labelGrid;
     std::vector<OrbitPathListEntry> orbitPathList;
     LightingState::EclipseShadowVector eclipseShadows[MaxLights];
+    celestia::engine::EclipseCasterCache eclipseCasters;
+    celestia::engine::EclipseShadowCache eclipseShadowCache;
     std::vector<const Star*> nearStars;
+    // The positions of the near stars relative to the observer, in km,
+    // converted together from the stars' universal coordinates
+    std::vector<UniversalCoord> nearStarPositions;
+    std::vector<Eigen::Vector3d> nearStarOffsets;
 
     std::vector<LightSource> lightSourceList;
 
@@ -729,14 +1064,34 @@ class Renderer
     uint32_t frameCount;
 
     int currentIntervalIndex{ 0 };
+    // Set while the solar system objects are drawn in one interval with a
+    // reversed depth range
+    bool m_reversedDepth{ false };
+    // Offset of the eye being rendered, as a fraction of the screen depth
+    // distance and in kilometers, 0 without stereo
+    float m_eyeShift{ 0.0f };
+    float m_eyeOffset{ 0.0f };
+    int m_stereoIntervals{ 0 };
+    bool m_stereoSelectionVisible{ false };
+    // Framebuffer whose depth format was last checked, and whether it has
+    // floating point depth
+    GLint m_checkedDepthFramebuffer{ -1 };
+    bool m_floatDepthBuffer{ false };
 
     PipelineState m_pipelineState;
 
     std::array<int, 4> m_viewport { 0, 0, 0, 0 };
 
-    typedef std::map<const celestia::ephem::Orbit*, CurvePlot*> OrbitCache;
+    typedef std::map<const celestia::ephem::Orbit*, std::unique_ptr<CurvePlot>> OrbitCache;
     OrbitCache orbitCache;
     uint32_t lastOrbitCacheFlush;
+    std::unique_ptr<celestia::engine::OrbitSamplingQueue> orbitSamplingQueue;
+    std::unique_ptr<celestia::engine::FrameProfiler> frameProfiler;
+    std::unique_ptr<celestia::engine::TextureResolutionSelector> textureResolutionSelector;
+    std::unique_ptr<celestia::engine::TerrainManager> terrainManager;
+    std::unique_ptr<celestia::engine::ScatteringTableManager> scatteringTableManager;
+    std::unique_ptr<celestia::gl::StreamBuffer> streamBuffer;
+    std::chrono::steady_clock::time_point orbitSamplingDeadline;
 
     float minOrbitSize;
     float distanceLimit;
@@ -762,11 +1117,16 @@ class Renderer
 
     // Size of a texture used in shadow mapping
     unsigned m_shadowMapSize { 0 };
-    std::unique_ptr<FramebufferObject> m_shadowFBO;
+    std::unique_ptr<celestia::engine::ShadowAtlas> m_shadowAtlas;
+    std::unique_ptr<celestia::engine::StarFieldCache> m_starFieldCache;
+    std::unique_ptr<PointStarProgress> m_pointStarProgress;
+    std::unique_ptr<celestia::engine::GPUStarCuller> m_gpuStarCuller;
 
     std::unique_ptr<celestia::gl::VertexObject> m_markerVO;
     std::unique_ptr<celestia::gl::Buffer> m_markerBO;
     bool m_markerDataInitialized{ false };
+    // Markers of the annotations being rendered
+    std::unique_ptr<celestia::engine::MarkerBatch> m_markerBatch;
 
     // Saturation magnitude used to calculate a point star size
     float satPoint;
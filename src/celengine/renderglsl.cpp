@@ -27,7 +27,6 @@
 #include <celutil/color.h>
 #include "atmosphere.h"
 #include "body.h"
-#include "framebuffer.h"
 #include "geometry.h"
 #include "glsupport.h"
 #include "lodspheremesh.h"
@@ -35,7 +34,9 @@
 #include "render.h"
 #include "renderglsl.h"
 #include "renderinfo.h"
+#include "ringshadowtexture.h"
 #include "shadermanager.h"
+#include "shadowatlas.h"
 #include "shadowmap.h" // GL_ONLY_SHADOWS definition
 #include "texture.h"
 
@@ -62,39 +63,62 @@ Eigen::Matrix4f directionalLightMatrix(const Eigen::Vector3f& lightDirection)
 }
 
 
-/*! Render a mesh object
+// Light space projection of the part of a model closest to the observer,
+// for the near cascade of its shadow map. The region is snapped to a grid
+// of half its size, so that its shadow map can be cached while the
+// observer moves.
+bool nearCascadeProjection(const Eigen::Vector3f& eyePos,
+                           const Eigen::Matrix4f& lightView,
+                           Eigen::Matrix4f& projection)
+{
+    // Half the size of the cascade relative to the model
+    constexpr float cascadeSize = 0.25f;
+    // The cascade is used when the observer is closer to the model
+    constexpr float maxDistance = 2.0f;
+
+    float distance = eyePos.norm();
+    if (distance > maxDistance)
+        return false;
+
+    Eigen::Vector3f nearPoint = distance > 1.0f ? Eigen::Vector3f(eyePos / distance) : eyePos;
+    Eigen::Vector4f center = lightView * nearPoint.homogeneous();
+    constexpr float grid = cascadeSize * 0.5f;
+    float x = std::round(center.x() / grid) * grid;
+    float y = std::round(center.y() / grid) * grid;
+    projection = math::Ortho(x - cascadeSize, x + cascadeSize, y - cascadeSize, y + cascadeSize, -1.0f, 1.0f);
+    return true;
+}
+
+
+/*! Render the depth of a mesh object into a tile of the shadow atlas
  *  Parameters:
  *    tsec : animation clock time in seconds
  */
 void renderGeometryShadow_GLSL(Geometry* geometry,
-                               FramebufferObject* shadowFbo,
-                               const LightingState& ls,
-                               int lightIndex,
+                               engine::ShadowAtlas& atlas,
+                               int tile,
+                               const Eigen::Matrix4f& projMat,
+                               const Eigen::Matrix4f& modelViewMat,
                                double tsec,
-                               Renderer* renderer,
-                               Eigen::Matrix4f *lightMatrix)
+                               Renderer* renderer)
 {
     auto *prog = renderer->getShaderManager().getShader("depth");
     if (prog == nullptr)
         return;
 
-    GLint oldFboId;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
-    shadowFbo->bind();
-    glViewport(0, 0, shadowFbo->width(), shadowFbo->height());
+    Renderer::PipelineState ps;
+    ps.depthMask = true;
+    ps.depthTest = true;
+    renderer->setPipelineState(ps);
+
+    GLint oldFboId = atlas.bindTile(tile);
 
     // Write only to the depth buffer
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    glClear(GL_DEPTH_BUFFER_BIT);
     // Render backfaces only in order to reduce self-shadowing artifacts
     glCullFace(GL_FRONT);
 
-    Renderer::PipelineState ps;
-    ps.depthMask = true;
-    ps.depthTest = true;
-    renderer->setPipelineState(ps);
-
-    Shadow_RenderContext rc(renderer);
+    Shadow_RenderContext rc(renderer, prog, projMat, modelViewMat);
 
     prog->use();
 
@@ -102,9 +126,6 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(.001f, .001f);
 
-    Eigen::Matrix4f projMat = math::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
-    Eigen::Matrix4f modelViewMat = directionalLightMatrix(ls.lights[lightIndex].direction_obj);
-    *lightMatrix = projMat * modelViewMat;
     prog->setMVPMatrices(projMat, modelViewMat);
     geometry->render(rc, tsec);
 
@@ -112,7 +133,49 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     // Re-enable the color buffer
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     glCullFace(GL_BACK);
-    shadowFbo->unbind(oldFboId);
+    atlas.unbind(oldFboId);
+}
+
+
+// Find the shadow map cascades of a mesh object in the shadow atlas,
+// rendering those which aren't cached. Return the number of cascades, with
+// the matrices from the model to the atlas and the texture coordinates of
+// the near cascade.
+int renderGeometryShadows_GLSL(Geometry* geometry,
+                               const RenderInfo& ri,
+                               const LightingState& ls,
+                               double tsec,
+                               Renderer* renderer,
+                               std::array<Eigen::Matrix4f, engine::ShadowAtlas::MaxCascades>& lightMatrices,
+                               Eigen::Vector4f& cascadeRect)
+{
+    engine::ShadowAtlas* atlas = renderer->getShadowAtlas();
+    if (atlas == nullptr || !atlas->isValid())
+        return 0;
+
+    Eigen::Matrix4f modelViewMat = directionalLightMatrix(ls.lights[0].direction_obj);
+    std::array<Eigen::Matrix4f, engine::ShadowAtlas::MaxCascades> projections;
+    projections[0] = math::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
+    int nCascades = 1;
+    if (atlas->getTileCount() > 1 && nearCascadeProjection(ri.eyePos_obj, modelViewMat, projections[1]))
+        nCascades = 2;
+
+    for (int i = 0; i < nCascades; i++)
+    {
+        Eigen::Matrix4f lightMatrix = projections[i] * modelViewMat;
+        bool cached;
+        int tile = atlas->findTile(geometry, i, lightMatrix, cached);
+        if (!cached)
+        {
+            renderGeometryShadow_GLSL(geometry, *atlas, tile, projections[i], modelViewMat, tsec, renderer);
+        }
+
+        lightMatrices[i] = atlas->getTileMatrix(tile) * lightMatrix;
+        if (i == 1)
+            cascadeRect = atlas->getTileRect(tile);
+    }
+
+    return nCascades;
 }
 
 class GLRingRenderData : public RingRenderData
@@ -225,6 +288,8 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
     shadprop.texUsage = ShaderProperties::TextureCoordTransform;
     shadprop.nLights = std::min(ls.nLights, MaxShaderLights);
 
+    const celestia::engine::ScatteringTables* scatteringTables = nullptr;
+
     // Set up the textures used by this object
     if (ri.baseTex != nullptr)
     {
@@ -277,7 +342,12 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
             // Only use new atmosphere code in OpenGL 2.0 path when new style parameters are defined.
             // ... but don't show atmospheres when there are no light sources.
             if (atmosphere->mieScaleHeight > 0.0f && shadprop.nLights > 0)
+            {
                 shadprop.texUsage |= ShaderProperties::Scattering;
+                scatteringTables = renderer->getScatteringTables(*atmosphere, radius);
+                if (scatteringTables != nullptr)
+                    shadprop.texUsage |= ShaderProperties::ScatteringTables;
+            }
         }
 
         if ((renderFlags & Renderer::ShowCloudMaps) != 0 &&
@@ -310,9 +380,9 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
             {
                 shadprop.texUsage |= ShaderProperties::CloudShadowTexture;
                 textures.try_push_back(cloudTex);
-                glActiveTexture(GL_TEXTURE0 + textures.size());
+                gl::activeTexture(GL_TEXTURE0 + textures.size());
                 cloudTex->bind();
-                glActiveTexture(GL_TEXTURE0);
+                gl::activeTexture(GL_TEXTURE0);
 
                 for (unsigned int lightIndex = 0; lightIndex < ls.nLights; lightIndex++)
                 {
@@ -336,16 +406,20 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         }
     }
 
+    bool isRingShadowBlurred = false;
     if (ls.shadowingRingSystem)
     {
-        Texture* ringsTex = ls.shadowingRingSystem->texture.find(textureRes);
+        Texture* ringsTex = celestia::engine::FindRingShadowTexture(ls, textureRes, isRingShadowBlurred);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + textures.size());
+            gl::activeTexture(GL_TEXTURE0 + textures.size());
             ringsTex->bind();
 
+            // The ring shadow texture already clamps to a transparent border
 #ifdef GL_ES
-            if (gl::OES_texture_border_clamp)
+            if (!isRingShadowBlurred && gl::OES_texture_border_clamp)
+#else
+            if (!isRingShadowBlurred)
 #endif
             {
                 // Tweak the texture--set clamp to border and a border color with
@@ -359,7 +433,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
 #endif
             }
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
 
             shadprop.texUsage |= ShaderProperties::RingShadowTexture;
 
@@ -401,7 +475,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         {
             if (shadprop.hasRingShadowForLight(lightIndex))
             {
-                prog->ringShadowLOD[lightIndex] = ls.ringShadows[lightIndex].texLod;
+                prog->ringShadowLOD[lightIndex] = isRingShadowBlurred ? 0.0f : ls.ringShadows[lightIndex].texLod;
             }
         }
     }
@@ -417,6 +491,8 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         if (shadprop.hasScattering())
         {
             prog->setAtmosphereParameters(*atmosphere, radius, radius);
+            if (scatteringTables != nullptr)
+                prog->setScatteringTables(*scatteringTables);
         }
     }
 
@@ -434,6 +510,17 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
 
     auto endTextures = std::remove(textures.begin(), textures.end(), nullptr);
     textures.erase(endTextures, textures.end());
+
+    // Until the coarsest chunks of the terrain are loaded, the body is
+    // drawn as a sphere
+    if (ri.terrain != nullptr &&
+        g_lodSphere->renderTerrain(renderer->getTerrainManager(), *ri.terrain,
+                                   attributes, frustum, ri.eyePos_obj, ri.pixelSize, ri.pixWidth,
+                                   textures.data(), static_cast<int>(textures.size()), prog))
+    {
+        return;
+    }
+
     g_lodSphere->render(attributes,
                         frustum, ri.pixWidth,
                         textures.data(), static_cast<int>(textures.size()), prog);
@@ -458,10 +545,12 @@ void renderGeometry_GLSL(Geometry* geometry,
                          const Matrices &m,
                          Renderer* renderer)
 {
-    auto *shadowBuffer = renderer->getShadowFBO(0);
-    Eigen::Matrix4f lightMatrix(Eigen::Matrix4f::Identity());
+    auto *shadowAtlas = renderer->getShadowAtlas();
+    std::array<Eigen::Matrix4f, engine::ShadowAtlas::MaxCascades> lightMatrices;
+    Eigen::Vector4f cascadeRect(Eigen::Vector4f::Zero());
+    int nCascades = 0;
 
-    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+    if (shadowAtlas != nullptr && shadowAtlas->isValid())
     {
         std::array<int, 4> viewport;
         renderer->getViewport(viewport);
@@ -469,6 +558,9 @@ void renderGeometry_GLSL(Geometry* geometry,
         float range[2];
         glGetFloatv(GL_DEPTH_RANGE, range);
         glDepthRange(0.0f, 1.0f);
+        // The shadow maps use the usual depth range
+        if (renderer->usesReversedDepth())
+            renderer->setReversedDepthState(false);
 
 #ifdef DEPTH_STATE_DEBUG
         float bias, bits, clear, range[2], scale;
@@ -480,8 +572,8 @@ void renderGeometry_GLSL(Geometry* geometry,
         fmt::printf("bias: %f bits: %f clear: %f range: %f - %f, scale:%f\n", bias, bits, clear, range[0], range[1], scale);
 #endif
 
-        renderGeometryShadow_GLSL(geometry, shadowBuffer, ls, 0,
-                                  tsec, renderer, &lightMatrix);
+        nCascades = renderGeometryShadows_GLSL(geometry, ri, ls, tsec, renderer,
+                                               lightMatrices, cascadeRect);
         renderer->setViewport(viewport);
 #ifdef DEPTH_BUFFER_DEBUG
         glDisable(GL_DEPTH_TEST);
@@ -491,12 +583,12 @@ void renderGeometry_GLSL(Geometry* geometry,
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
         glLoadIdentity();
-        glUseProgram(0);
+        gl::useProgram(0);
         glColor4f(1, 1, 1, 1);
 
-        glActiveTexture(GL_TEXTURE0);
+        gl::activeTexture(GL_TEXTURE0);
         glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+        gl::bindTexture(GL_TEXTURE_2D, shadowAtlas->depthTexture());
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
 #endif
@@ -517,11 +609,13 @@ void renderGeometry_GLSL(Geometry* geometry,
         glPopMatrix();
         glMatrixMode(GL_PROJECTION);
         glPopMatrix();
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl::bindTexture(GL_TEXTURE_2D, 0);
         glDisable(GL_TEXTURE_2D);
         glEnable(GL_DEPTH_TEST);
 #endif
         glDepthRange(range[0], range[1]);
+        if (renderer->usesReversedDepth())
+            renderer->setReversedDepthState(true);
     }
 
     GLSL_RenderContext rc(renderer, ls, geometryScale, planetOrientation, m.modelview, m.projection);
@@ -531,13 +625,16 @@ void renderGeometry_GLSL(Geometry* geometry,
         rc.setAtmosphere(atmosphere);
     }
 
-    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+    if (nCascades > 0)
     {
-        rc.setShadowMap(shadowBuffer->depthTexture(), shadowBuffer->width(), &lightMatrix);
+        rc.setShadowMap(shadowAtlas->depthTexture(), shadowAtlas->size(), &lightMatrices[0]);
+        if (nCascades > 1)
+            rc.setShadowCascade(&lightMatrices[1], cascadeRect);
     }
 
     rc.setCameraOrientation(ri.orientation);
     rc.setPointScale(ri.pointScale);
+    rc.setLodScale(ri.lodScale);
 
     // Handle extended material attributes (per model only, not per submesh)
     rc.setLunarLambert(ri.lunarLambert);
@@ -584,6 +681,7 @@ void renderGeometry_GLSL_Unlit(Geometry* geometry,
 {
     GLSLUnlit_RenderContext rc(renderer, geometryScale, m.modelview, m.projection);
     rc.setPointScale(ri.pointScale);
+    rc.setLodScale(ri.lodScale);
 
     Renderer::PipelineState ps;
     ps.depthMask = true;
@@ -18,6 +18,11 @@
 class LODSphereMesh;
 class Texture;
 
+namespace celestia::engine
+{
+class Terrain;
+}
+
 
 struct RenderInfo
 {
@@ -39,6 +44,11 @@ struct RenderInfo
     Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
     float pixWidth{ 1.0f };
     float pointScale{ 1.0f };
+    // Size of a pixel at unit distance
+    float pixelSize{ 1.0f };
+    // Pixels per model unit at the nearest point of the object
+    float lodScale{ 0.0f };
+    celestia::engine::Terrain* terrain{ nullptr };
 };
 
 extern LODSphereMesh* g_lodSphere;
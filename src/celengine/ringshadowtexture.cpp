@@ -0,0 +1,191 @@
+// ringshadowtexture.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "ringshadowtexture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <celimage/image.h>
+#include <celutil/logger.h>
+#include "lightenv.h"
+#include "multitexture.h"
+#include "texmanager.h"
+#include "texture.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Relative change of the blur width above which the texture is rebuilt
+constexpr float BlurTolerance = 0.1f;
+
+} // end unnamed namespace
+
+
+std::optional<RingShadowProfile>
+RingShadowProfile::fromImage(const Image& image)
+{
+    if (image.isCompressed() || !image.hasAlpha() || image.getWidth() <= 0 || image.getHeight() <= 0)
+        return std::nullopt;
+
+    // Alpha is the last component of all the formats having it
+    int components = image.getComponents();
+    int imageWidth = image.getWidth();
+    int width = std::min(imageWidth, MaxWidth);
+    const std::uint8_t* row = image.getPixels();
+
+    std::vector<float> opacity(static_cast<std::size_t>(width), 0.0f);
+    for (int x = 0; x < imageWidth; ++x)
+    {
+        auto texel = static_cast<std::size_t>(x * width / imageWidth);
+        opacity[texel] += static_cast<float>(row[x * components + components - 1]) / 255.0f;
+    }
+
+    for (int i = 0; i < width; ++i)
+    {
+        int first = (i * imageWidth + width - 1) / width;
+        int last = ((i + 1) * imageWidth + width - 1) / width;
+        opacity[static_cast<std::size_t>(i)] /= static_cast<float>(std::max(1, last - first));
+    }
+
+    return RingShadowProfile(std::move(opacity));
+}
+
+
+void
+RingShadowProfile::blur(float blurWidth, std::vector<std::uint8_t>& result) const
+{
+    int width = getWidth();
+    result.resize(static_cast<std::size_t>(width));
+    if (blurWidth <= 1.0f)
+    {
+        std::transform(opacity.begin(), opacity.end(), result.begin(),
+                       [](float a) { return static_cast<std::uint8_t>(std::lround(a * 255.0f)); });
+        return;
+    }
+
+    // Box filter from a running sum, clipped to the profile
+    std::vector<float> sums(static_cast<std::size_t>(width) + 1, 0.0f);
+    for (int i = 0; i < width; ++i)
+        sums[i + 1] = sums[i] + opacity[i];
+
+    float halfWidth = blurWidth * 0.5f;
+    for (int i = 0; i < width; ++i)
+    {
+        int first = std::clamp(static_cast<int>(std::lround(static_cast<float>(i) + 0.5f - halfWidth)), 0, width);
+        int last = std::clamp(static_cast<int>(std::lround(static_cast<float>(i) + 0.5f + halfWidth)), 0, width);
+        float average = (sums[last] - sums[first]) / blurWidth;
+        result[i] = static_cast<std::uint8_t>(std::lround(std::clamp(average, 0.0f, 1.0f) * 255.0f));
+    }
+}
+
+
+RingShadowTexture::RingShadowTexture(std::optional<RingShadowProfile>&& _profile) :
+    profile(std::move(_profile))
+{
+}
+
+
+RingShadowTexture::~RingShadowTexture() = default;
+
+
+Texture*
+RingShadowTexture::find(float blurSize)
+{
+    if (!profile.has_value())
+        return nullptr;
+
+    float newBlurWidth = std::max(1.0f, blurSize * static_cast<float>(profile->getWidth()));
+    if (texture != nullptr && std::abs(newBlurWidth - blurWidth) <= BlurTolerance * blurWidth)
+        return texture.get();
+
+    blurWidth = newBlurWidth;
+
+    std::vector<std::uint8_t> opacity;
+    profile->blur(blurWidth, opacity);
+
+    // The shader only samples the alpha channel
+    Image image(PixelFormat::RGBA, profile->getWidth(), 1);
+    std::uint8_t* pixels = image.getPixels();
+    for (std::size_t i = 0; i < opacity.size(); ++i)
+    {
+        pixels[i * 4 + 0] = 0;
+        pixels[i * 4 + 1] = 0;
+        pixels[i * 4 + 2] = 0;
+        pixels[i * 4 + 3] = opacity[i];
+    }
+
+    texture = std::make_unique<ImageTexture>(image, Texture::BorderClamp, Texture::NoMipMaps);
+    texture->setBorderColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+    return texture.get();
+}
+
+
+RingShadowTexture&
+GetRingShadowTexture(RingSystem& rings)
+{
+    if (rings.shadowData == nullptr)
+    {
+        // Use the first texture of the rings which has a source image
+        std::optional<RingShadowProfile> profile;
+        for (ResourceHandle handle : { rings.texture.tex[medres], rings.texture.tex[lores], rings.texture.tex[hires] })
+        {
+            if (handle == InvalidResource)
+                continue;
+
+            fs::path path = GetTextureManager()->getResolvedKey(handle);
+            if (path.empty())
+                continue;
+
+            if (std::unique_ptr<Image> image = Image::load(path); image != nullptr)
+            {
+                profile = RingShadowProfile::fromImage(*image);
+                if (!profile.has_value())
+                    GetLogger()->debug("Ring texture {} has no opacity usable for shadows\n", path);
+            }
+            break;
+        }
+
+        rings.shadowData = std::make_unique<RingShadowTexture>(std::move(profile));
+    }
+
+    return static_cast<RingShadowTexture&>(*rings.shadowData);
+}
+
+
+Texture*
+FindRingShadowTexture(const LightingState& ls, unsigned int textureRes, bool& isBlurred)
+{
+    isBlurred = false;
+    RingSystem* rings = ls.shadowingRingSystem;
+    if (rings == nullptr)
+        return nullptr;
+
+    for (unsigned int li = 0; li < ls.nLights; li++)
+    {
+        if (ls.ringShadows[li].ringSystem != rings)
+            continue;
+
+        if (Texture* texture = GetRingShadowTexture(*rings).find(ls.ringShadows[li].blurSize); texture != nullptr)
+        {
+            isBlurred = true;
+            return texture;
+        }
+        break;
+    }
+
+    return rings->texture.find(textureRes);
+}
+
+} // end namespace celestia::engine
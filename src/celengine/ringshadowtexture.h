@@ -0,0 +1,81 @@
+// ringshadowtexture.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <celengine/body.h>
+
+class LightingState;
+class Texture;
+
+namespace celestia::engine
+{
+
+class Image;
+
+/*! The opacity across a ring system, from the inner to the outer edge,
+ *  taken from the alpha of the first row of the ring texture.
+ */
+class RingShadowProfile
+{
+public:
+    static constexpr int MaxWidth = 1024;
+
+    // Only uncompressed images with an alpha channel can be used; wider
+    // images are averaged down to MaxWidth texels
+    static std::optional<RingShadowProfile> fromImage(const Image&);
+
+    int getWidth() const { return static_cast<int>(opacity.size()); }
+
+    // The opacity averaged over a box blurWidth texels wide around each
+    // texel, with transparent texels beyond the edges
+    void blur(float blurWidth, std::vector<std::uint8_t>& result) const;
+
+private:
+    explicit RingShadowProfile(std::vector<float>&& _opacity) : opacity(std::move(_opacity)) {}
+
+    std::vector<float> opacity;
+};
+
+/*! Ring shadow texture per ring system: the opacity profile blurred over
+ *  the penumbra of the light. Planets sample it instead of the full ring
+ *  texture, and it is rebuilt only when the blur changes significantly,
+ *  as the light direction or the distance of the observer change.
+ */
+class RingShadowTexture : public RingRenderData
+{
+public:
+    explicit RingShadowTexture(std::optional<RingShadowProfile>&&);
+    ~RingShadowTexture() override;
+
+    // blurSize is the width of the blur as a fraction of the ring width.
+    // Returns nullptr if the ring texture has no usable profile.
+    Texture* find(float blurSize);
+
+private:
+    std::optional<RingShadowProfile> profile;
+    std::unique_ptr<Texture> texture;
+    float blurWidth{ 0.0f };
+};
+
+// The ring shadow texture of rings, loaded on first use
+RingShadowTexture& GetRingShadowTexture(RingSystem&);
+
+// The texture to sample for the shadows of the shadowing ring system of
+// ls: its ring shadow texture, blurred for the first light it shadows,
+// else the ring texture at textureRes. isBlurred is set for the former,
+// which needs neither the border set up nor a texture LOD.
+Texture* FindRingShadowTexture(const LightingState& ls, unsigned int textureRes, bool& isBlurred);
+
+} // end namespace celestia::engine
@@ -9,9 +9,17 @@
 
 #include "rotationmanager.h"
 
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include <Eigen/Geometry>
 
-#include <celephem/samporient.h>
 #include <celutil/logger.h>
 
 using celestia::util::GetLogger;
@@ -26,24 +34,194 @@ RotationModelManager* GetRotationModelManager()
 }
 
 
-fs::path RotationModelInfo::resolve(const fs::path& baseDir) const
+RotationModelInfo::ResourceKey
+RotationModelInfo::resolve(const fs::path& baseDir) const
 {
     if (!path.empty())
     {
         fs::path filename = path / "data" / source;
         std::ifstream in(filename);
         if (in.good())
-            return filename;
+            return ResourceKey(std::move(filename), precision);
     }
 
-    return baseDir / source;
+    return ResourceKey(baseDir / source, precision);
+}
+
+
+namespace
+{
+
+// As for sampled trajectories, the valid range of an orientation file is
+// stored next to it with the size and modification time of the file, so
+// that attitude files are only parsed once they're used.
+constexpr std::string_view SummaryMagic{ "CELROTS\0", 8 };
+
+struct OrientationSummary
+{
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    double begin;
+    double end;
+};
+
+constexpr std::size_t SummarySize = 8 + sizeof(std::uint64_t) + sizeof(std::int64_t) + 2 * sizeof(double);
+
+fs::path
+summaryPath(const fs::path& path)
+{
+    fs::path result = path;
+    result += ".summary";
+    return result;
+}
+
+
+bool
+getFileStamp(const fs::path& path, std::uint64_t& fileSize, std::int64_t& writeTime)
+{
+    std::error_code ec;
+    fileSize = static_cast<std::uint64_t>(fs::file_size(path, ec));
+    if (ec)
+        return false;
+
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return false;
+
+    writeTime = static_cast<std::int64_t>(time.time_since_epoch().count());
+    return true;
 }
 
 
+std::optional<OrientationSummary>
+readSummary(const fs::path& path)
+{
+    OrientationSummary summary;
+    if (!getFileStamp(path, summary.fileSize, summary.writeTime))
+        return std::nullopt;
+
+    std::array<char, SummarySize> data;
+    std::ifstream in(summaryPath(path), std::ios::in | std::ios::binary);
+    if (!in.read(data.data(), data.size()) || std::string_view(data.data(), SummaryMagic.size()) != SummaryMagic)
+        return std::nullopt;
+
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    const char* ptr = data.data() + SummaryMagic.size();
+    std::memcpy(&fileSize, ptr, sizeof(fileSize));
+    std::memcpy(&writeTime, ptr + 8, sizeof(writeTime));
+    if (fileSize != summary.fileSize || writeTime != summary.writeTime)
+        return std::nullopt;
+
+    std::memcpy(&summary.begin, ptr + 16, sizeof(double));
+    std::memcpy(&summary.end, ptr + 24, sizeof(double));
+    if (!(summary.begin <= summary.end))
+        return std::nullopt;
+
+    return summary;
+}
+
+
+void
+writeSummary(const fs::path& path, const celestia::ephem::RotationModel& rotation)
+{
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    if (!getFileStamp(path, fileSize, writeTime))
+        return;
+
+    double begin;
+    double end;
+    rotation.getValidRange(begin, end);
+
+    std::array<char, SummarySize> data;
+    char* ptr = data.data();
+    std::memcpy(ptr, SummaryMagic.data(), SummaryMagic.size());
+    ptr += SummaryMagic.size();
+    std::memcpy(ptr, &fileSize, sizeof(fileSize));
+    std::memcpy(ptr + 8, &writeTime, sizeof(writeTime));
+    std::memcpy(ptr + 16, &begin, sizeof(double));
+    std::memcpy(ptr + 24, &end, sizeof(double));
+
+    std::ofstream out(summaryPath(path), std::ios::out | std::ios::binary);
+    if (!out.write(data.data(), data.size()))
+        GetLogger()->debug("Could not write orientation summary for {}\n", path);
+}
+
+
+std::unique_ptr<celestia::ephem::RotationModel>
+loadOrientation(const RotationModelInfo::ResourceKey& key)
+{
+    GetLogger()->verbose("Loading rotation model: {}\n", key.resolvedPath);
+
+    return celestia::ephem::LoadSampledOrientation(key.resolvedPath, key.precision);
+}
+
+
+// Stands in for a sampled orientation until its keyframes are needed
+class DeferredOrientation : public celestia::ephem::RotationModel
+{
+public:
+    DeferredOrientation(const RotationModelInfo::ResourceKey& _key, const OrientationSummary& summary) :
+        key(_key),
+        begin(summary.begin),
+        end(summary.end)
+    {
+    }
+
+    Eigen::Quaterniond spin(double tjd) const override
+    {
+        return get().spin(tjd);
+    }
+
+    Eigen::Vector3d angularVelocityAtTime(double tjd) const override
+    {
+        return get().angularVelocityAtTime(tjd);
+    }
+
+    double getPeriod() const override { return end - begin; }
+    bool isPeriodic() const override { return false; }
+
+    void getValidRange(double& _begin, double& _end) const override
+    {
+        _begin = begin;
+        _end = end;
+    }
+
+private:
+    const celestia::ephem::RotationModel& get() const
+    {
+        std::call_once(loaded, [this]
+        {
+            rotation = loadOrientation(key);
+            if (rotation == nullptr)
+            {
+                GetLogger()->error("Could not load rotation model from {}\n", key.resolvedPath);
+                rotation = std::make_unique<celestia::ephem::ConstantOrientation>(Eigen::Quaterniond::Identity());
+            }
+        });
+
+        return *rotation;
+    }
+
+    RotationModelInfo::ResourceKey key;
+    double begin;
+    double end;
+    mutable std::once_flag loaded;
+    mutable std::unique_ptr<celestia::ephem::RotationModel> rotation;
+};
+
+} // end unnamed namespace
+
+
 std::unique_ptr<celestia::ephem::RotationModel>
-RotationModelInfo::load(const fs::path& filename) const
+RotationModelInfo::load(const ResourceKey& key) const
 {
-    GetLogger()->verbose("Loading rotation model: {}\n", filename);
+    if (auto summary = readSummary(key.resolvedPath); summary.has_value())
+        return std::make_unique<DeferredOrientation>(key, *summary);
 
-    return celestia::ephem::LoadSampledOrientation(filename);
+    std::unique_ptr<celestia::ephem::RotationModel> rotation = loadOrientation(key);
+    if (rotation != nullptr)
+        writeSummary(key.resolvedPath, *rotation);
+    return rotation;
 }
@@ -12,36 +12,59 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
 
 #include <celcompat/filesystem.h>
 #include <celephem/rotation.h>
+#include <celephem/samporient.h>
 #include <celutil/resmanager.h>
 
 
 class RotationModelInfo
 {
+ public:
+    // Orientations loaded with different precisions are different objects
+    struct ResourceKey
+    {
+        fs::path resolvedPath;
+        celestia::ephem::OrientationPrecision precision;
+
+        ResourceKey(fs::path&& _resolvedPath,
+                    celestia::ephem::OrientationPrecision _precision) :
+            resolvedPath(std::move(_resolvedPath)),
+            precision(_precision)
+        {}
+    };
+
  private:
     std::string source;
     fs::path path;
+    celestia::ephem::OrientationPrecision precision;
 
     friend bool operator<(const RotationModelInfo&, const RotationModelInfo&);
 
  public:
     using ResourceType = celestia::ephem::RotationModel;
-    using ResourceKey = fs::path;
 
     RotationModelInfo(const std::string& _source,
-                      const fs::path& _path = "") :
-        source(_source), path(_path) {};
+                      const fs::path& _path = "",
+                      celestia::ephem::OrientationPrecision _precision = celestia::ephem::OrientationPrecision::Single) :
+        source(_source), path(_path), precision(_precision) {};
 
-    fs::path resolve(const fs::path&) const;
-    std::unique_ptr<celestia::ephem::RotationModel> load(const fs::path&) const;
+    ResourceKey resolve(const fs::path&) const;
+    std::unique_ptr<celestia::ephem::RotationModel> load(const ResourceKey&) const;
 };
 
 inline bool operator<(const RotationModelInfo& ti0,
                       const RotationModelInfo& ti1)
 {
-    return std::tie(ti0.source, ti0.path) < std::tie(ti1.source, ti1.path);
+    return std::tie(ti0.precision, ti0.source, ti0.path) < std::tie(ti1.precision, ti1.source, ti1.path);
+}
+
+inline bool operator<(const RotationModelInfo::ResourceKey& k0,
+                      const RotationModelInfo::ResourceKey& k1)
+{
+    return std::tie(k0.resolvedPath, k0.precision) < std::tie(k1.resolvedPath, k1.precision);
 }
 
 typedef ResourceManager<RotationModelInfo> RotationModelManager;
@@ -0,0 +1,217 @@
+// scatteringlut.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "scatteringlut.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include <celcompat/numbers.h>
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr int TransmittanceSteps = 64;
+constexpr int InscatterSteps = 32;
+
+// Azimuths of the sun relative to the view direction, with the weights of
+// Simpson's rule over [0, pi]
+constexpr std::array<float, 3> SunAzimuths{ 0.0f, static_cast<float>(celestia::numbers::pi / 2.0), static_cast<float>(celestia::numbers::pi) };
+constexpr std::array<float, 3> SunAzimuthWeights{ 1.0f / 6.0f, 4.0f / 6.0f, 1.0f / 6.0f };
+
+
+// Cosine of the zenith angle of the horizon seen from radius r
+float
+horizonCosine(float r)
+{
+    return -std::sqrt(std::max(0.0f, 1.0f - 1.0f / (r * r)));
+}
+
+
+float
+density(const ScatteringLUTParams& params, float r)
+{
+    return std::exp(-std::max(0.0f, r - 1.0f) / params.scaleHeight);
+}
+
+
+float
+heightFromCoord(const ScatteringLUTParams& params, float u)
+{
+    return 1.0f + u * u * (params.atmosphereRadius - 1.0f);
+}
+
+
+float
+viewFromCoord(float r, float u)
+{
+    float muH = horizonCosine(r);
+    if (u >= 0.5f)
+        return std::min(1.0f, muH + (u - 0.5f) * 2.0f * (1.0f - muH));
+    return std::max(-1.0f, -1.0f + u * 2.0f * (muH + 1.0f));
+}
+
+
+// Bilinear lookup in the transmittance table
+Eigen::Vector3f
+lookupTransmittance(const ScatteringLUTParams& params,
+                    const std::vector<Eigen::Vector3f>& table,
+                    float r,
+                    float mu)
+{
+    float x = ScatteringLUTViewCoord(r, mu) * static_cast<float>(TransmittanceLUTWidth - 1);
+    float y = ScatteringLUTHeightCoord(params, r) * static_cast<float>(TransmittanceLUTHeight - 1);
+    int x0 = std::min(static_cast<int>(x), TransmittanceLUTWidth - 2);
+    int y0 = std::min(static_cast<int>(y), TransmittanceLUTHeight - 2);
+    float fx = x - static_cast<float>(x0);
+    float fy = y - static_cast<float>(y0);
+
+    const Eigen::Vector3f* row0 = table.data() + y0 * TransmittanceLUTWidth;
+    const Eigen::Vector3f* row1 = row0 + TransmittanceLUTWidth;
+    Eigen::Vector3f t0 = row0[x0] * (1.0f - fx) + row0[x0 + 1] * fx;
+    Eigen::Vector3f t1 = row1[x0] * (1.0f - fx) + row1[x0 + 1] * fx;
+    return t0 * (1.0f - fy) + t1 * fy;
+}
+
+} // end unnamed namespace
+
+
+float
+ScatteringLUTHeightCoord(const ScatteringLUTParams& params, float r)
+{
+    float h = (r - 1.0f) / (params.atmosphereRadius - 1.0f);
+    return std::sqrt(std::clamp(h, 0.0f, 1.0f));
+}
+
+
+float
+ScatteringLUTViewCoord(float r, float mu)
+{
+    float muH = horizonCosine(r);
+    float u;
+    if (mu >= muH)
+        u = 0.5f + 0.5f * (mu - muH) / (1.0f - muH);
+    else
+        u = 0.5f * (mu + 1.0f) / (muH + 1.0f);
+    return std::clamp(u, 0.0f, 1.0f);
+}
+
+
+float
+ScatteringLUTSunCoord(float muS)
+{
+    return std::clamp(0.5f * (muS + 1.0f), 0.0f, 1.0f);
+}
+
+
+float
+ScatteringLUTRayLength(const ScatteringLUTParams& params, float r, float mu)
+{
+    float b = r * mu;
+    float c = r * r * (mu * mu - 1.0f);
+    if (mu < horizonCosine(r))
+        return std::max(0.0f, -b - std::sqrt(std::max(0.0f, c + 1.0f)));
+
+    float rt = params.atmosphereRadius;
+    return std::max(0.0f, -b + std::sqrt(std::max(0.0f, c + rt * rt)));
+}
+
+
+std::vector<Eigen::Vector3f>
+ComputeTransmittanceLUT(const ScatteringLUTParams& params)
+{
+    std::vector<Eigen::Vector3f> table;
+    table.reserve(TransmittanceLUTWidth * TransmittanceLUTHeight);
+
+    for (int j = 0; j < TransmittanceLUTHeight; ++j)
+    {
+        float r = heightFromCoord(params, static_cast<float>(j) / static_cast<float>(TransmittanceLUTHeight - 1));
+        for (int i = 0; i < TransmittanceLUTWidth; ++i)
+        {
+            float mu = viewFromCoord(r, static_cast<float>(i) / static_cast<float>(TransmittanceLUTWidth - 1));
+            float dt = ScatteringLUTRayLength(params, r, mu) / static_cast<float>(TransmittanceSteps);
+
+            float opticalDepth = 0.0f;
+            for (int n = 0; n < TransmittanceSteps; ++n)
+            {
+                float t = (static_cast<float>(n) + 0.5f) * dt;
+                float rt = std::sqrt(std::max(0.0f, r * r + 2.0f * r * mu * t + t * t));
+                opticalDepth += density(params, rt) * dt;
+            }
+
+            table.push_back((-params.extinction * opticalDepth).array().exp().matrix());
+        }
+    }
+
+    return table;
+}
+
+
+std::vector<Eigen::Vector3f>
+ComputeInscatterLUT(const ScatteringLUTParams& params,
+                    const std::vector<Eigen::Vector3f>& transmittance)
+{
+    std::vector<Eigen::Vector3f> table(InscatterLUTWidth * InscatterLUTHeight, Eigen::Vector3f::Zero());
+
+    for (int k = 0; k < InscatterLUTHeightSize; ++k)
+    {
+        float r = heightFromCoord(params, static_cast<float>(k) / static_cast<float>(InscatterLUTHeightSize - 1));
+        for (int j = 0; j < InscatterLUTHeight; ++j)
+        {
+            float mu = viewFromCoord(r, static_cast<float>(j) / static_cast<float>(InscatterLUTHeight - 1));
+            float sinMu = std::sqrt(std::max(0.0f, 1.0f - mu * mu));
+            float dt = ScatteringLUTRayLength(params, r, mu) / static_cast<float>(InscatterSteps);
+
+            for (int i = 0; i < InscatterLUTSunSize; ++i)
+            {
+                float muS = 2.0f * static_cast<float>(i) / static_cast<float>(InscatterLUTSunSize - 1) - 1.0f;
+                float sinMuS = std::sqrt(std::max(0.0f, 1.0f - muS * muS));
+
+                Eigen::Vector3f inscatter = Eigen::Vector3f::Zero();
+                float opticalDepth = 0.0f;
+                for (int n = 0; n < InscatterSteps; ++n)
+                {
+                    // Sample point in the plane of the view ray, with the
+                    // zenith along y
+                    float t = (static_cast<float>(n) + 0.5f) * dt;
+                    float x = t * sinMu;
+                    float y = r + t * mu;
+                    float rt = std::sqrt(x * x + y * y);
+                    float rho = density(params, rt);
+
+                    Eigen::Vector3f viewTransmittance = (-params.extinction * (opticalDepth + rho * dt * 0.5f)).array().exp().matrix();
+                    opticalDepth += rho * dt;
+
+                    float muH = horizonCosine(rt);
+                    Eigen::Vector3f sunTransmittance = Eigen::Vector3f::Zero();
+                    for (std::size_t a = 0; a < SunAzimuths.size(); ++a)
+                    {
+                        float muSt = (x * sinMuS * std::cos(SunAzimuths[a]) + y * muS) / rt;
+                        // The planet shadows points where the sun is below the horizon
+                        if (muSt >= muH)
+                            sunTransmittance += SunAzimuthWeights[a] * lookupTransmittance(params, transmittance, rt, muSt);
+                    }
+
+                    inscatter += rho * dt * viewTransmittance.cwiseProduct(sunTransmittance);
+                }
+
+                table[j * InscatterLUTWidth + k * InscatterLUTSunSize + i] = inscatter;
+            }
+        }
+    }
+
+    return table;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,65 @@
+// scatteringlut.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace celestia::engine
+{
+
+// Tables of the single scattering model of the atmosphere shaders, in the
+// spirit of Bruneton and Neyret's precomputed atmospheric scattering. All
+// distances are in planet radii. The density of the atmosphere falls off
+// exponentially with the height above the surface, with the same scale
+// height for Rayleigh and Mie scattering.
+struct ScatteringLUTParams
+{
+    // Radius of the top of the atmosphere
+    float atmosphereRadius{ 1.0f };
+    float scaleHeight{ 1.0f };
+    // Sum of the scattering and absorption coefficients at the surface
+    Eigen::Vector3f extinction{ Eigen::Vector3f::Zero() };
+};
+
+// Transmittance table: the transmittance from a point at radius r along a
+// ray with view zenith cosine mu up to the ground or the top of the
+// atmosphere, whichever it hits first. Rows are radii, columns are mu.
+constexpr int TransmittanceLUTWidth = 128;
+constexpr int TransmittanceLUTHeight = 32;
+
+// Inscatter table: the light scattered towards a point at radius r along
+// a ray with view zenith cosine mu, for a sun of unit intensity with
+// zenith cosine muS, before applying the scattering coefficients and the
+// phase functions. It is averaged over the azimuth of the sun. The table
+// is 3D, with the radius in slices stacked along the columns of a 2D
+// texture: column = radius slice * InscatterLUTSunSize + muS.
+constexpr int InscatterLUTSunSize = 32;
+constexpr int InscatterLUTHeightSize = 32;
+constexpr int InscatterLUTWidth = InscatterLUTSunSize * InscatterLUTHeightSize;
+constexpr int InscatterLUTHeight = 128;
+
+// Mapping of r, mu and muS to texture coordinates between 0 and 1 at the
+// first and last texel centers. The mapping of mu puts the horizon at 0.5
+// so that the tables don't blur the limb of the planet.
+float ScatteringLUTHeightCoord(const ScatteringLUTParams& params, float r);
+float ScatteringLUTViewCoord(float r, float mu);
+float ScatteringLUTSunCoord(float muS);
+
+// Distance from a point at radius r along a ray with zenith cosine mu to
+// the ground or the top of the atmosphere
+float ScatteringLUTRayLength(const ScatteringLUTParams& params, float r, float mu);
+
+std::vector<Eigen::Vector3f> ComputeTransmittanceLUT(const ScatteringLUTParams& params);
+std::vector<Eigen::Vector3f> ComputeInscatterLUT(const ScatteringLUTParams& params,
+                                                 const std::vector<Eigen::Vector3f>& transmittance);
+
+} // end namespace celestia::engine
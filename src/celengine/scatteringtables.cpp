@@ -0,0 +1,153 @@
+// scatteringtables.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "scatteringtables.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include <celutil/taskscheduler.h>
+#include "atmosphere.h"
+#include "scatteringlut.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+#ifdef GL_ES
+// OpenGL ES has no 16-bit normalized formats
+using TexelComponent = std::uint8_t;
+constexpr GLenum TexelInternalFormat = GL_RGB;
+constexpr GLenum TexelType = GL_UNSIGNED_BYTE;
+#else
+using TexelComponent = std::uint16_t;
+constexpr GLenum TexelInternalFormat = GL_RGB16;
+constexpr GLenum TexelType = GL_UNSIGNED_SHORT;
+#endif
+
+constexpr float TexelMax = static_cast<float>(static_cast<TexelComponent>(~0));
+
+
+GLuint
+createTexture(const std::vector<Eigen::Vector3f>& table, int width, int height, float scale)
+{
+    std::vector<TexelComponent> texels;
+    texels.reserve(table.size() * 3);
+    for (const Eigen::Vector3f& value : table)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            float v = std::clamp(value[c] * scale, 0.0f, 1.0f);
+            texels.push_back(static_cast<TexelComponent>(std::lround(v * TexelMax)));
+        }
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    gl::bindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, TexelInternalFormat, width, height, 0,
+                 GL_RGB, TexelType, texels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+
+    return texture;
+}
+
+} // end unnamed namespace
+
+
+ScatteringTables::ScatteringTables(const std::vector<Eigen::Vector3f>& transmittance,
+                                   const std::vector<Eigen::Vector3f>& inscatter)
+{
+    float maxInscatter = 0.0f;
+    for (const Eigen::Vector3f& value : inscatter)
+        maxInscatter = std::max(maxInscatter, value.maxCoeff());
+    if (maxInscatter > 0.0f)
+        inscatterScale = maxInscatter;
+
+    transmittanceTexture = createTexture(transmittance, TransmittanceLUTWidth, TransmittanceLUTHeight, 1.0f);
+    inscatterTexture = createTexture(inscatter, InscatterLUTWidth, InscatterLUTHeight, 1.0f / inscatterScale);
+}
+
+
+ScatteringTables::~ScatteringTables()
+{
+    gl::deleteTextures(1, &transmittanceTexture);
+    gl::deleteTextures(1, &inscatterTexture);
+}
+
+
+void
+ScatteringTables::bind(int unit) const
+{
+    gl::activeTexture(GL_TEXTURE0 + unit);
+    gl::bindTexture(GL_TEXTURE_2D, transmittanceTexture);
+    gl::activeTexture(GL_TEXTURE0 + unit + 1);
+    gl::bindTexture(GL_TEXTURE_2D, inscatterTexture);
+    gl::activeTexture(GL_TEXTURE0);
+}
+
+
+ScatteringTableManager::~ScatteringTableManager()
+{
+    // Tables still being computed only use their own copy of the
+    // parameters and are dropped when they are done
+    entries.clear();
+}
+
+
+const ScatteringTables*
+ScatteringTableManager::find(const Atmosphere& atmosphere, float radius)
+{
+    if (atmosphere.mieScaleHeight <= 0.0f || radius <= 0.0f)
+        return nullptr;
+
+    // Parameters of the tables in planet radii, matching those set by
+    // CelestiaGLProgram::setAtmosphereParameters
+    ScatteringLUTParams params;
+    params.scaleHeight = atmosphere.mieScaleHeight / radius;
+    params.atmosphereRadius = 1.0f - params.scaleHeight * std::log(AtmosphereExtinctionThreshold);
+    params.extinction = (atmosphere.rayleighCoeff.array() + atmosphere.mieCoeff + atmosphere.absorptionCoeff.array()) * radius;
+
+    std::array<float, 5> key{ params.atmosphereRadius, params.scaleHeight,
+                              params.extinction.x(), params.extinction.y(), params.extinction.z() };
+    auto [it, inserted] = entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted)
+    {
+        entry.pending = celestia::util::TaskScheduler::get().async([params]
+        {
+            ComputedTables computed;
+            computed.transmittance = ComputeTransmittanceLUT(params);
+            computed.inscatter = ComputeInscatterLUT(params, computed.transmittance);
+            return computed;
+        });
+        return nullptr;
+    }
+
+    if (entry.tables == nullptr && entry.pending.valid() &&
+        entry.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        ComputedTables computed = entry.pending.get();
+        entry.tables = std::make_unique<ScatteringTables>(computed.transmittance, computed.inscatter);
+    }
+
+    return entry.tables.get();
+}
+
+} // end namespace celestia::engine
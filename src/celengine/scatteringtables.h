@@ -0,0 +1,87 @@
+// scatteringtables.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/glsupport.h>
+
+class Atmosphere;
+
+namespace celestia::engine
+{
+
+/*! Transmittance and inscatter tables of an atmosphere as textures, used
+ *  by the scattering shaders instead of integrating along the view ray.
+ *  See scatteringlut.h for their layout.
+ */
+class ScatteringTables
+{
+public:
+    ScatteringTables(const std::vector<Eigen::Vector3f>& transmittance,
+                     const std::vector<Eigen::Vector3f>& inscatter);
+    ~ScatteringTables();
+
+    ScatteringTables(const ScatteringTables&) = delete;
+    ScatteringTables& operator=(const ScatteringTables&) = delete;
+
+    // Bind the transmittance texture to unit and the inscatter texture to
+    // the unit after it
+    void bind(int unit) const;
+
+    // The inscatter texture is normalized; its values are multiplied by
+    // the scale to get the inscatter in planet radii.
+    float getInscatterScale() const { return inscatterScale; }
+
+private:
+    GLuint transmittanceTexture{ 0 };
+    GLuint inscatterTexture{ 0 };
+    float inscatterScale{ 1.0f };
+};
+
+/*! Computes the tables of atmospheres on background threads when they
+ *  are first drawn; atmospheres with the same parameters share tables.
+ */
+class ScatteringTableManager
+{
+public:
+    ScatteringTableManager() = default;
+    ~ScatteringTableManager();
+
+    ScatteringTableManager(const ScatteringTableManager&) = delete;
+    ScatteringTableManager& operator=(const ScatteringTableManager&) = delete;
+
+    // Tables of an atmosphere around a planet with a radius in km. Return
+    // nullptr while they are computed.
+    const ScatteringTables* find(const Atmosphere& atmosphere, float radius);
+
+private:
+    struct ComputedTables
+    {
+        std::vector<Eigen::Vector3f> transmittance;
+        std::vector<Eigen::Vector3f> inscatter;
+    };
+
+    struct Entry
+    {
+        std::future<ComputedTables> pending;
+        std::unique_ptr<ScatteringTables> tables;
+    };
+
+    std::map<std::array<float, 5>, Entry> entries;
+};
+
+} // end namespace celestia::engine
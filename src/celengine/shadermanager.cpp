@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
@@ -31,8 +32,12 @@
 #include "atmosphere.h"
 #include "glsupport.h"
 #include "lightenv.h"
+#include "programcache.h"
+#include "scatteringlut.h"
+#include "scatteringtables.h"
 
 
+using celestia::engine::ProgramBinaryCache;
 using celestia::util::GetLogger;
 using celestia::util::IntrusivePtr;
 using namespace std::string_view_literals;
@@ -91,6 +96,7 @@ constexpr std::string_view VersionHeader = "#version 120\n"sv;
 constexpr std::string_view VersionHeaderGL3 = "#version 150\n"sv;
 constexpr std::string_view CommonHeader = "\n"sv;
 #endif
+constexpr std::string_view VersionHeaderCompute = "#version 430\n"sv;
 constexpr std::string_view VertexHeader = R"glsl(
 uniform mat4 ModelViewMatrix;
 uniform mat4 ProjectionMatrix;
@@ -160,9 +166,33 @@ VertexPosition(const ShaderProperties& props)
 
 constexpr std::string_view FragmentHeader = ""sv;
 
+constexpr std::string_view PositionAttrib = "attribute vec4 in_Position;\n"sv;
+constexpr std::string_view NormalAttrib = "attribute vec3 in_Normal;\n"sv;
+
+// Packed attributes have names of their own; main() unpacks them into
+// variables with the usual ones
+constexpr std::string_view PackedPositionAttrib = R"glsl(
+attribute vec4 in_PackedPosition;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+vec4 in_Position;
+)glsl"sv;
+
+constexpr std::string_view PackedNormalAttrib = R"glsl(
+attribute vec2 in_PackedNormal;
+vec3 in_Normal;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+)glsl"sv;
+
 constexpr std::string_view CommonAttribs = R"glsl(
-attribute vec4 in_Position;
-attribute vec3 in_Normal;
 attribute vec4 in_TexCoord0;
 attribute vec4 in_TexCoord1;
 attribute vec4 in_TexCoord2;
@@ -170,6 +200,26 @@ attribute vec4 in_TexCoord3;
 attribute vec4 in_Color;
 )glsl"sv;
 
+std::string
+VertexAttributes(const ShaderProperties& props)
+{
+    std::string source(props.hasPackedPositions() ? PackedPositionAttrib : PositionAttrib);
+    source += props.hasPackedNormals() ? PackedNormalAttrib : NormalAttrib;
+    source += CommonAttribs;
+    return source;
+}
+
+std::string
+UnpackVertexAttributes(const ShaderProperties& props)
+{
+    std::string source;
+    if (props.hasPackedPositions())
+        source += "in_Position = vec4(positionOffset + positionScale * in_PackedPosition.xyz, 1.0);\n";
+    if (props.hasPackedNormals())
+        source += "in_Normal = decodeOctahedral(in_PackedNormal);\n";
+    return source;
+}
+
 constexpr std::string_view TextureTransformUniforms = R"glsl(
 uniform vec2 texCoordBase0;
 uniform vec2 texCoordBase1;
@@ -801,6 +851,16 @@ inline void DumpFSSource(std::ostringstream& source)
     DumpFSSource(source.str());
 }
 
+inline void DumpCSSource(const std::string& source)
+{
+    if (g_shaderLogFile != nullptr)
+    {
+        *g_shaderLogFile << "Compute shader source:\n";
+        DumpShaderSource(*g_shaderLogFile, source);
+        *g_shaderLogFile << '\n';
+    }
+}
+
 std::string
 DeclareLights(const ShaderProperties& props)
 {
@@ -1138,9 +1198,49 @@ ScatteringPhaseFunctions(const ShaderProperties& /*unused*/)
 }
 
 
+// Scattering from the precomputed tables; the phase functions and the
+// scattering coefficients are applied here, and the tables hold the rest
+// of the single scattering integral along the view ray.
+std::string
+AtmosphericEffectsFromTables(const ShaderProperties& props)
+{
+    std::string source;
+
+    source += "{\n";
+    source += "    float rq = dot(eyePosition, eyeDir);\n";
+    source += "    float qq = dot(eyePosition, eyePosition) - atmosphereRadius.y;\n";
+    source += "    float d = sqrt(max(rq * rq - qq, 0.0));\n";
+    // Point where the view ray enters the atmosphere, in planet radii
+    source += "    vec3 atmEnter = (eyePosition + min(0.0, (-rq + d)) * eyeDir) / atmosphereRadius.z;\n";
+    source += "    float r = length(atmEnter);\n";
+    source += "    float mu = -dot(atmEnter, eyeDir) / r;\n";
+    source += "    float muS = dot(atmEnter, " + LightProperty(0, "direction") + ") / r;\n";
+    source += "    vec3 inscatter = " + LightProperty(0, "color") + " * scatterInscatter(r, mu, muS) * atmosphereRadius.z;\n";
+    source += "    scatterEx = scatterTransmittance(r, mu);\n";
+
+    if (props.lightModel == ShaderProperties::AtmosphereModel)
+    {
+        source += "    " + ScatteredColor(0) + " = inscatter;\n";
+    }
+    else
+    {
+        source += "    float cosTheta = dot(eyeDir, " + LightProperty(0, "direction") + ");\n";
+        source += ScatteringPhaseFunctions(props);
+        source += "    scatterColor = (phRayleigh * rayleighCoeff + phMie * mieCoeff) * inscatter;\n";
+    }
+
+    source += "}\n";
+
+    return source;
+}
+
+
 std::string
 AtmosphericEffects(const ShaderProperties& props)
 {
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+        return AtmosphericEffectsFromTables(props);
+
     std::string source;
 
     source += "{\n";
@@ -1291,8 +1391,61 @@ AtmosphericEffects(const ShaderProperties& props, unsigned int nSamples)
 #endif
 
 
+// Lookups in the tables computed by ComputeTransmittanceLUT and
+// ComputeInscatterLUT, with the same texture coordinate mappings.
+std::string
+ScatteringTableFunctions()
+{
+    std::string_view code = R"glsl(
+float scatterHorizon(float r)
+{{
+    return -sqrt(max(0.0, 1.0 - 1.0 / (r * r)));
+}}
+
+float scatterHeightCoord(float r)
+{{
+    float rt = atmosphereRadius.x / atmosphereRadius.z;
+    return sqrt(clamp((r - 1.0) / (rt - 1.0), 0.0, 1.0));
+}}
+
+float scatterViewCoord(float r, float mu)
+{{
+    float muH = scatterHorizon(r);
+    float u = mu >= muH ? 0.5 + 0.5 * (mu - muH) / (1.0 - muH) : 0.5 * (mu + 1.0) / (muH + 1.0);
+    return clamp(u, 0.0, 1.0);
+}}
+
+vec3 scatterTransmittance(float r, float mu)
+{{
+    vec2 size = vec2({}.0, {}.0);
+    vec2 uv = vec2(scatterViewCoord(r, mu), scatterHeightCoord(r));
+    return texture2D(transmittanceTex, (0.5 + uv * (size - 1.0)) / size).rgb;
+}}
+
+vec3 scatterInscatter(float r, float mu, float muS)
+{{
+    float sunSize = {}.0;
+    float heightSize = {}.0;
+    float viewSize = {}.0;
+    float k = scatterHeightCoord(r) * (heightSize - 1.0);
+    float k0 = min(floor(k), heightSize - 2.0);
+    float us = (0.5 + clamp(0.5 * (muS + 1.0), 0.0, 1.0) * (sunSize - 1.0)) / sunSize;
+    float v = (0.5 + scatterViewCoord(r, mu) * (viewSize - 1.0)) / viewSize;
+    vec3 a = texture2D(inscatterTex, vec2((k0 + us) / heightSize, v)).rgb;
+    vec3 b = texture2D(inscatterTex, vec2((k0 + 1.0 + us) / heightSize, v)).rgb;
+    return mix(a, b, k - k0) * inscatterScale;
+}}
+)glsl"sv;
+
+    return fmt::format(code,
+                       celestia::engine::TransmittanceLUTWidth, celestia::engine::TransmittanceLUTHeight,
+                       celestia::engine::InscatterLUTSunSize, celestia::engine::InscatterLUTHeightSize,
+                       celestia::engine::InscatterLUTHeight);
+}
+
+
 std::string
-ScatteringConstantDeclarations(const ShaderProperties& /*props*/)
+ScatteringConstantDeclarations(const ShaderProperties& props)
 {
     std::string source;
 
@@ -1306,6 +1459,14 @@ ScatteringConstantDeclarations(const ShaderProperties& /*props*/)
     source += DeclareUniform("invScatterCoeffSum", Shader_Vector3);
     source += DeclareUniform("extinctionCoeff", Shader_Vector3);
 
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+    {
+        source += DeclareUniform("transmittanceTex", Shader_Sampler2D);
+        source += DeclareUniform("inscatterTex", Shader_Sampler2D);
+        source += DeclareUniform("inscatterScale", Shader_Float);
+        source += ScatteringTableFunctions();
+    }
+
     return source;
 }
 
@@ -1399,6 +1560,8 @@ TextureCoordDeclarations(const ShaderProperties& props, ShaderInOut inOut)
     if (props.texUsage & ShaderProperties::ShadowMapTexture)
     {
         source += declare("shadowTexCoord0", Shader_Vector4);
+        if (props.texUsage & ShaderProperties::ShadowCascades)
+            source += declare("shadowTexCoord1", Shader_Vector4);
         source += declare("cosNormalLightDir", Shader_Float);
     }
 
@@ -1446,8 +1609,21 @@ LineDeclaration()
     return source;
 }
 
+// Use the near cascade of the shadow map where the fragment lies within it
+std::string
+ShadowCoord(const ShaderProperties& props)
+{
+    std::string source = "    vec3 shadowCoord = shadowTexCoord0.xyz;\n";
+    if (props.texUsage & ShaderProperties::ShadowCascades)
+    {
+        source += "    if (all(greaterThan(shadowTexCoord1.xy, shadowCascadeRect.xy)) && all(lessThan(shadowTexCoord1.xy, shadowCascadeRect.zw)))\n";
+        source += "        shadowCoord = shadowTexCoord1.xyz;\n";
+    }
+    return source;
+}
+
 std::string
-CalculateShadow()
+CalculateShadow(const ShaderProperties& props)
 {
     std::string source;
 #if GL_ONLY_SHADOWS
@@ -1458,13 +1634,14 @@ float calculateShadow()
     float s = 0.0;
     float bias = max(0.005 * (1.0 - cosNormalLightDir), 0.0005);
 )glsl"sv;
+    source += ShadowCoord(props);
     float boxFilterWidth = (float) ShadowSampleKernelWidth - 1.0f;
     float firstSample = -boxFilterWidth / 2.0f;
     float lastSample = firstSample + boxFilterWidth;
     float sampleWeight = 1.0f / (float) (ShadowSampleKernelWidth * ShadowSampleKernelWidth);
     source += fmt::format("    for (float y = {:f}; y <= {:f}; y += 1.0)\n", firstSample, lastSample);
     source += fmt::format("        for (float x = {:f}; x <= {:f}; x += 1.0)\n", firstSample, lastSample);
-    source += "            s += shadow2D(shadowMapTex0, shadowTexCoord0.xyz + vec3(x * texelSize, y * texelSize, bias)).z;\n";
+    source += "            s += shadow2D(shadowMapTex0, shadowCoord + vec3(x * texelSize, y * texelSize, bias)).z;\n";
     source += fmt::format("    return s * {:f};\n", sampleWeight);
     source += "}\n";
 #else
@@ -1474,12 +1651,14 @@ float calculateShadow()
     float texelSize = 1.0 / shadowMapSize;
     float s = 0.0;
     float bias = max(0.005 * (1.0 - cosNormalLightDir), 0.0005);
-    for(float x = -1.0; x <= 1.0; x += 1.0)
+)glsl"sv;
+    source += ShadowCoord(props);
+    source += R"glsl(    for(float x = -1.0; x <= 1.0; x += 1.0)
     {
         for(float y = -1.0; y <= 1.0; y += 1.0)
         {
-            float pcfDepth = texture2D(shadowMapTex0, shadowTexCoord0.xy + vec2(x * texelSize, y * texelSize)).r;
-            s += shadowTexCoord0.z - bias > pcfDepth ? 1.0 : 0.0;
+            float pcfDepth = texture2D(shadowMapTex0, shadowCoord.xy + vec2(x * texelSize, y * texelSize)).r;
+            s += shadowCoord.z - bias > pcfDepth ? 1.0 : 0.0;
         }
     }
     return 1.0 - s / 9.0;
@@ -1494,6 +1673,8 @@ BindAttribLocations(const GLProgram *prog)
 {
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::VertexCoordAttributeIndex,   "in_Position");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::NormalAttributeIndex,        "in_Normal");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::VertexCoordAttributeIndex,   "in_PackedPosition");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::NormalAttributeIndex,        "in_PackedNormal");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::TextureCoord0AttributeIndex, "in_TexCoord0");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::TextureCoord1AttributeIndex, "in_TexCoord1");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::TextureCoord2AttributeIndex, "in_TexCoord2");
@@ -1738,6 +1919,18 @@ ShaderProperties::hasTextureCoordTransform() const
     return (texUsage & TextureCoordTransform) != 0;
 }
 
+bool
+ShaderProperties::hasPackedPositions() const
+{
+    return (texUsage & PackedPositions) != 0;
+}
+
+bool
+ShaderProperties::hasPackedNormals() const
+{
+    return (texUsage & PackedNormals) != 0;
+}
+
 bool
 ShaderProperties::hasSpecular() const
 {
@@ -1815,6 +2008,9 @@ ShaderManager::~ShaderManager()
         delete shader.second;
 
     staticShaders.clear();
+
+    for (const auto& shader : pendingShaders)
+        delete shader.second.program;
 }
 
 CelestiaGLProgram*
@@ -1826,16 +2022,175 @@ ShaderManager::getShader(const ShaderProperties& props)
         // Shader already exists
         return iter->second;
     }
+
+    if (auto pending = pendingShaders.find(props); pending != pendingShaders.end())
+    {
+        // Wait for a program compiling in the background rather than
+        // compiling it again
+        CelestiaGLProgram* prog = pending->second.program == nullptr
+            ? nullptr
+            : finishProgram(props, pending->second);
+        pendingShaders.erase(pending);
+        if (prog != nullptr)
+        {
+            dynamicShaders[props] = prog;
+            return prog;
+        }
+    }
     else
     {
-        // Create a new shader and add it to the table of created shaders
-        CelestiaGLProgram* prog = buildProgram(props);
-        dynamicShaders[props] = prog;
+        recordShader(props);
+    }
+
+    // Create a new shader and add it to the table of created shaders
+    CelestiaGLProgram* prog = buildProgram(props);
+    dynamicShaders[props] = prog;
 
-        return prog;
+    return prog;
+}
+
+void
+ShaderManager::prepareShader(const ShaderProperties& props)
+{
+    if (dynamicShaders.find(props) == dynamicShaders.end())
+        pendingShaders.try_emplace(props);
+}
+
+void
+ShaderManager::setShaderList(const fs::path& path)
+{
+    shaderListPath = path;
+
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        ShaderProperties props;
+        std::istringstream fields(line);
+        fields >> std::hex >> props.texUsage >> props.nLights >> props.lightModel
+               >> props.effects >> props.shadowCounts >> props.fishEyeOverride;
+        if (fields.fail() ||
+            props.nLights > MaxShaderLights ||
+            props.fishEyeOverride < ShaderProperties::FisheyeOverrideModeNone ||
+            props.fishEyeOverride > ShaderProperties::FisheyeOverrideModeDisabled)
+        {
+            GetLogger()->warn("Ignoring invalid shader list entry: {}\n", line);
+            continue;
+        }
+
+        prepareShader(props);
     }
 }
 
+void
+ShaderManager::recordShader(const ShaderProperties& props) const
+{
+    if (shaderListPath.empty())
+        return;
+
+    std::error_code ec;
+    fs::create_directories(shaderListPath.parent_path(), ec);
+
+    std::ofstream out(shaderListPath, std::ios::out | std::ios::app);
+    out << fmt::format("{:x} {:x} {:x} {:x} {:x} {:x}\n",
+                       props.texUsage, props.nLights, props.lightModel,
+                       props.effects, props.shadowCounts, props.fishEyeOverride);
+    if (!out.good())
+        GetLogger()->debug("Could not add a shader to {}\n", shaderListPath);
+}
+
+void
+ShaderManager::processPending(std::chrono::steady_clock::duration budget)
+{
+    if (pendingShaders.empty())
+        return;
+
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    for (auto iter = pendingShaders.begin(); iter != pendingShaders.end();)
+    {
+        const ShaderProperties& props = iter->first;
+        PendingShader& pending = iter->second;
+        if (pending.program == nullptr)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                ++iter;
+                continue;
+            }
+
+            if (!gl::KHR_parallel_shader_compile)
+            {
+                // No background compilation, build the program as far as
+                // the time allows
+                dynamicShaders[props] = buildProgram(props);
+                iter = pendingShaders.erase(iter);
+                continue;
+            }
+
+            if (!startProgram(props, pending))
+            {
+                // Built by getShader(), which reports the errors
+                iter = pendingShaders.erase(iter);
+                continue;
+            }
+        }
+
+        if (!pending.program->isLinkComplete())
+        {
+            ++iter;
+            continue;
+        }
+
+        if (CelestiaGLProgram* prog = finishProgram(props, pending); prog != nullptr)
+            dynamicShaders[props] = prog;
+        iter = pendingShaders.erase(iter);
+    }
+}
+
+bool
+ShaderManager::startProgram(const ShaderProperties& props, PendingShader& pending)
+{
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
+
+    if (programCache != nullptr)
+    {
+        std::array<std::string_view, 3> sources{ vs, std::string_view{}, fs };
+        pending.key = programCache->getKey(sources);
+        pending.program = programCache->load(pending.key);
+        if (pending.program != nullptr)
+        {
+            pending.cached = true;
+            return true;
+        }
+    }
+
+    if (GLShaderLoader::CreateProgramAsync(vs, fs, &pending.program) != GLShaderStatus::OK)
+        return false;
+
+    BindAttribLocations(pending.program);
+    if (programCache != nullptr)
+        ProgramBinaryCache::prepare(*pending.program);
+    pending.program->startLink();
+    return true;
+}
+
+CelestiaGLProgram*
+ShaderManager::finishProgram(const ShaderProperties& props, const PendingShader& pending)
+{
+    if (pending.program->getLinkStatus() != GLShaderStatus::OK)
+    {
+        delete pending.program;
+        return nullptr;
+    }
+
+    if (programCache != nullptr && !pending.cached)
+        programCache->store(pending.key, *pending.program);
+
+    return new CelestiaGLProgram(*pending.program, props);
+}
+
 CelestiaGLProgram*
 ShaderManager::getShader(std::string_view name, std::string_view vs, std::string_view fs)
 {
@@ -1938,7 +2293,42 @@ ShaderManager::getShaderGL3(std::string_view name, std::string_view vs, std::str
 }
 
 
-GLVertexShader*
+CelestiaGLProgram*
+ShaderManager::getComputeShader(std::string_view name)
+{
+    if (auto iter = staticShaders.find(name); iter != staticShaders.end())
+    {
+        // Shader already exists, or failed to build
+        return iter->second;
+    }
+
+    CelestiaGLProgram* prog = nullptr;
+#ifndef GL_ES
+    auto cs = ReadShaderFile(fs::path("shaders") / fmt::format("{}_comp.glsl", name));
+    if (cs.has_value() && celestia::gl::checkVersion(celestia::gl::GL_4_3))
+    {
+        std::string _cs = fmt::format("{}{}\n", VersionHeaderCompute, *cs);
+        DumpCSSource(_cs);
+
+        // There's no error shader to fall back to, the caller must do
+        // without the program
+        GLProgram* glProg = nullptr;
+        if (GLShaderLoader::CreateComputeProgram(_cs, &glProg) == GLShaderStatus::OK)
+        {
+            if (glProg->link() == GLShaderStatus::OK)
+                prog = new CelestiaGLProgram(*glProg);
+            else
+                delete glProg;
+        }
+    }
+#endif
+
+    staticShaders[name] = prog;
+    return prog;
+}
+
+
+std::string
 ShaderManager::buildVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -1970,7 +2360,7 @@ R"glsl(
     source += "***************************************************/\n";
     source += CommonHeader;
     source += VertexHeader;
-    source += CommonAttribs;
+    source += VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
@@ -2018,7 +2408,11 @@ R"glsl(
     }
 
     if (props.hasShadowMap())
+    {
         source += DeclareUniform("ShadowMatrix0", Shader_Matrix4);
+        if (props.texUsage & ShaderProperties::ShadowCascades)
+            source += DeclareUniform("ShadowMatrix1", Shader_Matrix4);
+    }
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
         source += LineDeclaration();
@@ -2027,6 +2421,7 @@ R"glsl(
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    source += UnpackVertexAttributes(props);
     if (props.lightModel != ShaderProperties::ParticleDiffuseModel)
         source += "normal = in_Normal;\n";
 
@@ -2043,6 +2438,8 @@ R"glsl(
     {
         source += "cosNormalLightDir = dot(in_Normal, " + LightProperty(0, "direction") + ");\n";
         source += "shadowTexCoord0 = ShadowMatrix0 * vec4(in_Position.xyz, 1.0);\n";
+        if (props.texUsage & ShaderProperties::ShadowCascades)
+            source += "shadowTexCoord1 = ShadowMatrix1 * vec4(in_Position.xyz, 1.0);\n";
     }
 
     unsigned int nTexCoords = 0;
@@ -2180,13 +2577,11 @@ R"glsl(
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2283,7 +2678,9 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     if (props.hasShadowMap())
     {
         source += DeclareUniform("shadowMapSize", Shader_Float);
-        source += CalculateShadow();
+        if (props.texUsage & ShaderProperties::ShadowCascades)
+            source += DeclareUniform("shadowCascadeRect", Shader_Vector4);
+        source += CalculateShadow(props);
     }
 
     source += DeclareLights(props);
@@ -2540,20 +2937,18 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
 #if 0
-GLVertexShader*
+std::string
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
     source += CommonHeader;
     source += VertexHeader;
-    source += CommonAttribs;
+    source += VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
@@ -2572,6 +2967,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
     }
 
     source += "\nvoid main(void)\n{\n";
+    source += UnpackVertexAttributes(props);
 
     // Get the normalized direction from the eye to the vertex
     source += "vec3 eyeDir = normalize(eyePosition - in_Position.xyz);\n";
@@ -2600,13 +2996,11 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2682,20 +3076,18 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 #endif
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
     source += CommonHeader;
     source += VertexHeader;
-    source += CommonAttribs;
+    source += VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
@@ -2716,6 +3108,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
     source += VPFunction(props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled);
 
     source += "\nvoid main(void)\n{\n";
+    source += UnpackVertexAttributes(props);
 
     if (props.texUsage & ShaderProperties::DiffuseTexture)
         source += "diffTexCoord = " + TexCoord2D(0, props.hasTextureCoordTransform()) + ";\n";
@@ -2735,13 +3128,11 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2840,20 +3231,18 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
     source += "// buildAtmosphereVertexShader\n";
     source += CommonHeader;
     source += VertexHeader;
-    source += CommonAttribs;
+    source += VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
@@ -2866,6 +3255,7 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    source += UnpackVertexAttributes(props);
     source += "    position = in_Position.xyz;\n";
     source += "    normal = in_Normal;\n";
     source += VertexPosition(props);
@@ -2873,13 +3263,11 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2919,7 +3307,10 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
         source += ScatteringPhaseFunctions(props);
 
         // TODO: Consider premultiplying by invScatterCoeffSum
-        source += "    color += (phRayleigh * rayleighCoeff + phMie * mieCoeff) * invScatterCoeffSum * " + ScatteredColor(i) + ";\n";
+        if (props.texUsage & ShaderProperties::ScatteringTables)
+            source += "    color += (phRayleigh * rayleighCoeff + phMie * mieCoeff) * " + ScatteredColor(i) + ";\n";
+        else
+            source += "    color += (phRayleigh * rayleighCoeff + phMie * mieCoeff) * invScatterCoeffSum * " + ScatteredColor(i) + ";\n";
     }
 
     source += "    gl_FragColor = vec4(color, dot(scatterEx, vec3(0.333)));\n";
@@ -2927,21 +3318,19 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
 // The emissive shader ignores all lighting and uses the diffuse color
 // as the final fragment color.
-GLVertexShader*
+std::string
 ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
     source += CommonHeader;
     source += VertexHeader;
-    source += CommonAttribs;
+    source += VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source += TextureTransformUniforms;
 
@@ -2968,6 +3357,7 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    source += UnpackVertexAttributes(props);
 
     // Optional texture coordinates (generated automatically for point
     // sprites.)
@@ -2993,13 +3383,11 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -3044,21 +3432,19 @@ ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source;
 }
 
 
 // Build the vertex shader used for rendering particle systems.
-GLVertexShader*
+std::string
 ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 {
     std::ostringstream source;
     source << VersionHeader;
     source << CommonHeader;
     source << VertexHeader;
-    source << CommonAttribs;
+    source << VertexAttributes(props);
     if (props.hasTextureCoordTransform())
         source << TextureTransformUniforms;
 
@@ -3084,6 +3470,7 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 
     // Begin main() function
     source << "\nvoid main(void)\n{\n";
+    source << UnpackVertexAttributes(props);
 
 #define PARTICLE_PHASE_PARAMETER 0
 #if PARTICLE_PHASE_PARAMETER
@@ -3120,13 +3507,11 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source.str(), &vs);
-    return status == GLShaderStatus::OK ? vs : nullptr;
+    return source.str();
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 {
     std::ostringstream source;
@@ -3175,20 +3560,47 @@ ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source.str(), &fs);
-    return status == GLShaderStatus::OK ? fs : nullptr;
+    return source.str();
 }
 
-CelestiaGLProgram*
-ShaderManager::buildProgram(const ShaderProperties& props)
+GLProgram*
+ShaderManager::linkProgram(const std::string& vs, const std::string& gs, const std::string& fs)
 {
+    std::uint64_t key = 0;
+    if (programCache != nullptr)
+    {
+        std::array<std::string_view, 3> sources{ vs, gs, fs };
+        key = programCache->getKey(sources);
+        if (GLProgram* prog = programCache->load(key); prog != nullptr)
+            return prog;
+    }
+
     GLProgram* prog = nullptr;
-    GLShaderStatus status;
+    GLShaderStatus status = gs.empty()
+        ? GLShaderLoader::CreateProgram(vs, fs, &prog)
+        : GLShaderLoader::CreateProgram(vs, gs, fs, &prog);
+    if (status != GLShaderStatus::OK)
+        return nullptr;
+
+    BindAttribLocations(prog);
+    if (programCache != nullptr)
+        ProgramBinaryCache::prepare(*prog);
 
-    GLVertexShader* vs = nullptr;
-    GLFragmentShader* fs = nullptr;
+    if (prog->link() != GLShaderStatus::OK)
+    {
+        delete prog;
+        return nullptr;
+    }
+
+    if (programCache != nullptr)
+        programCache->store(key, *prog);
 
+    return prog;
+}
+
+void
+ShaderManager::buildSources(const ShaderProperties& props, std::string& vs, std::string& fs)
+{
     if (props.lightModel == ShaderProperties::RingIllumModel)
     {
         vs = buildRingsVertexShader(props);
@@ -3214,25 +3626,17 @@ ShaderManager::buildProgram(const ShaderProperties& props)
         vs = buildVertexShader(props);
         fs = buildFragmentShader(props);
     }
+}
 
-    if (vs != nullptr && fs != nullptr)
-    {
-        status = GLShaderLoader::CreateProgram(*vs, *fs, &prog);
-        if (status == GLShaderStatus::OK)
-        {
-            BindAttribLocations(prog);
-            status = prog->link();
-        }
-    }
-    else
-    {
-        status = GLShaderStatus::CompileError;
-    }
-
-    delete vs;
-    delete fs;
+CelestiaGLProgram*
+ShaderManager::buildProgram(const ShaderProperties& props)
+{
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
 
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = linkProgram(vs, {}, fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -3246,22 +3650,14 @@ ShaderManager::buildProgram(const ShaderProperties& props)
 CelestiaGLProgram*
 ShaderManager::buildProgram(std::string_view vs, std::string_view fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
     std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled), vs);
     std::string _fs = fmt::format("{}{}{}{}\n", VersionHeader, CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
-
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = linkProgram(_vs, {}, _fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -3275,22 +3671,14 @@ ShaderManager::buildProgram(std::string_view vs, std::string_view fs)
 CelestiaGLProgram*
 ShaderManager::buildProgramGL3(std::string_view vs, std::string_view fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
     std::string _vs = fmt::format("{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, VertexHeader, VPFunction(fisheyeEnabled), vs);
     std::string _fs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
-
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = linkProgram(_vs, {}, _fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -3314,8 +3702,6 @@ ShaderManager::buildProgramGL3(std::string_view vs, std::string_view gs, std::st
         );
     }
 
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
     auto _vs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, VertexHeader, vs);
     auto _gs = fmt::format("{}{}{}{}{}{}\n", VersionHeaderGL3, CommonHeader, layout, GeomHeaderGL3, VPFunction(fisheyeEnabled), gs);
     auto _fs = fmt::format("{}{}{}{}\n", VersionHeaderGL3, CommonHeader, FragmentHeader, fs);
@@ -3324,14 +3710,8 @@ ShaderManager::buildProgramGL3(std::string_view vs, std::string_view gs, std::st
     DumpGSSource(_gs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _gs, _fs, &prog);
-    if (status == GLShaderStatus::OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
-
-    if (status != GLShaderStatus::OK)
+    GLProgram* prog = linkProgram(_vs, _gs, _fs);
+    if (prog == nullptr)
     {
         // If the shader creation failed for some reason, substitute the
         // error shader.
@@ -3347,6 +3727,14 @@ void ShaderManager::setFisheyeEnabled(bool enabled)
     fisheyeEnabled = enabled;
 }
 
+void ShaderManager::setProgramCacheDirectory(const fs::path& directory)
+{
+    if (directory.empty() || !ProgramBinaryCache::isSupported())
+        programCache = nullptr;
+    else
+        programCache = std::make_unique<ProgramBinaryCache>(directory);
+}
+
 CelestiaGLProgram::CelestiaGLProgram(GLProgram& _program,
                                      const ShaderProperties& _props) :
     program(&_program),
@@ -3479,6 +3867,12 @@ CelestiaGLProgram::initParameters()
         }
     }
 
+    if (props.hasPackedPositions())
+    {
+        positionOffset       = vec3Param("positionOffset");
+        positionScale        = vec3Param("positionScale");
+    }
+
     if (props.hasSpecular())
     {
         shininess            = floatParam("shininess");
@@ -3511,6 +3905,11 @@ CelestiaGLProgram::initParameters()
     if (props.texUsage & ShaderProperties::ShadowMapTexture)
     {
         ShadowMatrix0       = mat4Param("ShadowMatrix0");
+        if (props.texUsage & ShaderProperties::ShadowCascades)
+        {
+            ShadowMatrix1       = mat4Param("ShadowMatrix1");
+            shadowCascadeRect   = vec4Param("shadowCascadeRect");
+        }
     }
 
     if (props.hasScattering())
@@ -3526,6 +3925,11 @@ CelestiaGLProgram::initParameters()
         extinctionCoeff      = vec3Param("extinctionCoeff");
     }
 
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+    {
+        inscatterScale       = floatParam("inscatterScale");
+    }
+
     if ((props.lightModel & ShaderProperties::LunarLambertModel) != 0)
     {
         lunarLambert         = floatParam("lunarLambert");
@@ -3613,6 +4017,18 @@ CelestiaGLProgram::initSamplers()
         if (slot != -1)
             glUniform1i(slot, nSamplers++);
     }
+
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+    {
+        scatteringTableUnit = static_cast<int>(nSamplers);
+        int slot = glGetUniformLocation(program->getID(), "transmittanceTex");
+        if (slot != -1)
+            glUniform1i(slot, scatteringTableUnit);
+        slot = glGetUniformLocation(program->getID(), "inscatterTex");
+        if (slot != -1)
+            glUniform1i(slot, scatteringTableUnit + 1);
+        nSamplers += 2;
+    }
 }
 
 
@@ -3770,6 +4186,16 @@ CelestiaGLProgram::setAtmosphereParameters(const Atmosphere& atmosphere,
     extinctionCoeff = tScatterCoeffSum + tAbsorptionCoeff;
 }
 
+void
+CelestiaGLProgram::setScatteringTables(const celestia::engine::ScatteringTables& tables)
+{
+    if (scatteringTableUnit < 0)
+        return;
+
+    tables.bind(scatteringTableUnit);
+    inscatterScale = tables.getInscatterScale();
+}
+
 void
 CelestiaGLProgram::setMVPMatrices(const Eigen::Matrix4f& p, const Eigen::Matrix4f& m)
 {
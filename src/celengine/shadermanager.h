@@ -10,13 +10,16 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celcompat/filesystem.h>
 #include <celutil/color.h>
 #include <celengine/glshader.h>
 
@@ -24,6 +27,12 @@
 class Atmosphere;
 class LightingState;
 
+namespace celestia::engine
+{
+class ProgramBinaryCache;
+class ScatteringTables;
+}
+
 class ShaderProperties
 {
  public:
@@ -50,6 +59,8 @@ class ShaderProperties
     bool hasShadowsForLight(unsigned int) const;
     bool hasSharedTextureCoords() const;
     bool hasTextureCoordTransform() const;
+    bool hasPackedPositions() const;
+    bool hasPackedNormals() const;
     bool hasSpecular() const;
     bool hasScattering() const;
     bool isViewDependent() const;
@@ -75,6 +86,10 @@ class ShaderProperties
      StaticPointSize         = 0x10000,
      LineAsTriangles         = 0x20000,
      TextureCoordTransform   = 0x40000,
+     ScatteringTables        = 0x80000,
+     ShadowCascades          = 0x100000,
+     PackedPositions         = 0x200000,
+     PackedNormals           = 0x400000,
  };
 
  enum
@@ -191,6 +206,9 @@ class CelestiaGLProgram
     void setAtmosphereParameters(const Atmosphere& atmosphere,
                                  float atmPlanetRadius,
                                  float objRadius);
+    // Bind the precomputed scattering tables of the atmosphere; requires
+    // the ScatteringTables flag.
+    void setScatteringTables(const celestia::engine::ScatteringTables& tables);
     void setMVPMatrices(const Eigen::Matrix4f& p, const Eigen::Matrix4f& m = Eigen::Matrix4f::Identity());
 
     enum
@@ -236,6 +254,10 @@ class CelestiaGLProgram
 
     std::array<CelestiaGLProgramTextureTransform, 4> texCoordTransforms;
 
+    // Mapping of packed positions to model coordinates
+    Vec3ShaderParameter positionOffset;
+    Vec3ShaderParameter positionScale;
+
     // Parameters for atmospheric scattering; all distances are normalized for
     // a unit sphere.
     FloatShaderParameter mieCoeff;
@@ -266,6 +288,9 @@ class CelestiaGLProgram
     //    z = 1/radius
     Vec3ShaderParameter atmosphereRadius;
 
+    // Scale of the normalized values of the inscatter table
+    FloatShaderParameter inscatterScale;
+
     // Scale factor for point sprites
     FloatShaderParameter pointScale;
 
@@ -278,6 +303,10 @@ class CelestiaGLProgram
 
     // Matrix used to project to light space
     Mat4ShaderParameter ShadowMatrix0;
+    // Matrix of the near cascade, and its texture coordinates in the
+    // shadow map
+    Mat4ShaderParameter ShadowMatrix1;
+    Vec4ShaderParameter shadowCascadeRect;
 
     CelestiaGLProgramShadow shadows[MaxShaderLights][MaxShaderEclipseShadows];
 
@@ -303,6 +332,9 @@ class CelestiaGLProgram
 
     GLProgram* program;
     const ShaderProperties props;
+    // Texture unit of the transmittance table; the inscatter table uses the
+    // next one
+    int scatteringTableUnit{ -1 };
 };
 
 
@@ -324,32 +356,74 @@ class ShaderManager
     CelestiaGLProgram* getShader(std::string_view, std::string_view, std::string_view);
     CelestiaGLProgram* getShaderGL3(std::string_view, const GeomShaderParams* = nullptr);
     CelestiaGLProgram* getShaderGL3(std::string_view, std::string_view, std::string_view, std::string_view);
+    // Compute shader read from shaders/<name>_comp.glsl, nullptr if it
+    // can't be built; requires OpenGL 4.3
+    CelestiaGLProgram* getComputeShader(std::string_view);
 
     void setFisheyeEnabled(bool enabled);
 
+    // Keep the binaries of linked programs in directory and load them
+    // instead of compiling the programs again; an empty path disables
+    // the cache. Has no effect if the driver can't return binaries.
+    void setProgramCacheDirectory(const fs::path& directory);
+
+    // Build the program for props ahead of its first use, during the
+    // following calls to processPending()
+    void prepareShader(const ShaderProperties&);
+
+    // Prepare the programs listed in the file, and add the programs built
+    // later to it, so that the next session prepares them too
+    void setShaderList(const fs::path& path);
+
+    // Continue building the prepared programs for about the given time.
+    // With GL_KHR_parallel_shader_compile the driver compiles them in the
+    // background, and they are only completed here once it's done.
+    void processPending(std::chrono::steady_clock::duration budget);
+
  private:
+    struct PendingShader
+    {
+        GLProgram* program{ nullptr };
+        std::uint64_t key{ 0 };
+        bool cached{ false };
+    };
+
+    // Compile and link a program, or load it from the program cache;
+    // gs may be empty. Return nullptr if compiling or linking fails.
+    GLProgram* linkProgram(const std::string& vs, const std::string& gs, const std::string& fs);
+
+    void buildSources(const ShaderProperties&, std::string& vs, std::string& fs);
     CelestiaGLProgram* buildProgram(const ShaderProperties&);
     CelestiaGLProgram* buildProgram(std::string_view, std::string_view);
     CelestiaGLProgram* buildProgramGL3(std::string_view, std::string_view);
     CelestiaGLProgram* buildProgramGL3(std::string_view, std::string_view, std::string_view, const GeomShaderParams* = nullptr);
 
-    GLVertexShader* buildVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildFragmentShader(const ShaderProperties&);
+    std::string buildVertexShader(const ShaderProperties&);
+    std::string buildFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildRingsVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildRingsFragmentShader(const ShaderProperties&);
+    std::string buildRingsVertexShader(const ShaderProperties&);
+    std::string buildRingsFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildAtmosphereVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildAtmosphereFragmentShader(const ShaderProperties&);
+    std::string buildAtmosphereVertexShader(const ShaderProperties&);
+    std::string buildAtmosphereFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildEmissiveVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildEmissiveFragmentShader(const ShaderProperties&);
+    std::string buildEmissiveVertexShader(const ShaderProperties&);
+    std::string buildEmissiveFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildParticleVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildParticleFragmentShader(const ShaderProperties&);
+    std::string buildParticleVertexShader(const ShaderProperties&);
+    std::string buildParticleFragmentShader(const ShaderProperties&);
+
+    bool startProgram(const ShaderProperties&, PendingShader&);
+    CelestiaGLProgram* finishProgram(const ShaderProperties&, const PendingShader&);
+    void recordShader(const ShaderProperties&) const;
 
     std::map<ShaderProperties, CelestiaGLProgram*> dynamicShaders;
     std::map<std::string_view, CelestiaGLProgram*> staticShaders;
 
+    std::map<ShaderProperties, PendingShader> pendingShaders;
+    fs::path shaderListPath;
+
+    std::unique_ptr<celestia::engine::ProgramBinaryCache> programCache;
+
     bool fisheyeEnabled { false };
 };
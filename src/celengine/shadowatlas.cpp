@@ -0,0 +1,186 @@
+// shadowatlas.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "shadowatlas.h"
+
+#include <algorithm>
+
+#include "framebuffer.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr int TilesPerSide = 4;
+constexpr unsigned int MaxAtlasSize = 2048;
+
+// Texels around each tile which are left clear, so that filtering the
+// shadow map of a tile doesn't sample its neighbors
+constexpr int TileGutter = 2;
+
+// Largest difference between the elements of the light matrices of a
+// cached tile and of the current frame; well below the size of a texel
+constexpr float MaxLightMatrixError = 1.0e-4f;
+
+} // end unnamed namespace
+
+
+ShadowAtlas::ShadowAtlas(unsigned int _tileSize, unsigned int maxSize) :
+    tileSize(_tileSize)
+{
+    tilesPerSide = std::clamp(static_cast<int>(std::min(maxSize, MaxAtlasSize) / tileSize), 1, TilesPerSide);
+    GLuint atlasSize = tileSize * static_cast<unsigned int>(tilesPerSide);
+    fbo = std::make_unique<FramebufferObject>(atlasSize, atlasSize, FramebufferObject::DepthAttachment);
+    tiles.resize(static_cast<std::size_t>(tilesPerSide * tilesPerSide));
+}
+
+
+ShadowAtlas::~ShadowAtlas() = default;
+
+
+bool
+ShadowAtlas::isValid() const
+{
+    return fbo->isValid();
+}
+
+
+GLuint
+ShadowAtlas::depthTexture() const
+{
+    return fbo->depthTexture();
+}
+
+
+GLuint
+ShadowAtlas::size() const
+{
+    return fbo->width();
+}
+
+
+int
+ShadowAtlas::findTile(const void* caster, int cascade, Eigen::Matrix4f& lightMatrix, bool& cached)
+{
+    cached = false;
+
+    auto it = std::find_if(tiles.begin(), tiles.end(),
+                           [caster, cascade](const Tile& t) { return t.caster == caster && t.cascade == cascade; });
+    if (it == tiles.end())
+    {
+        // Replace the least recently used tile
+        it = std::min_element(tiles.begin(), tiles.end(),
+                              [](const Tile& a, const Tile& b) { return a.lastUsed < b.lastUsed; });
+        it->caster = caster;
+        it->cascade = cascade;
+        it->rendered = false;
+    }
+    else if (it->lastUsed + 1 < frame)
+    {
+        // The caster wasn't drawn in the last frame, so it may have been
+        // unloaded and another one created at the same address
+        it->rendered = false;
+    }
+
+    it->lastUsed = frame;
+    if (it->rendered && (it->lightMatrix - lightMatrix).cwiseAbs().maxCoeff() < MaxLightMatrixError)
+    {
+        lightMatrix = it->lightMatrix;
+        cached = true;
+    }
+    else
+    {
+        it->lightMatrix = lightMatrix;
+        it->rendered = true;
+    }
+
+    return static_cast<int>(it - tiles.begin());
+}
+
+
+void
+ShadowAtlas::getTileViewport(int tile, int& x, int& y, int& width) const
+{
+    x = (tile % tilesPerSide) * static_cast<int>(tileSize) + TileGutter;
+    y = (tile / tilesPerSide) * static_cast<int>(tileSize) + TileGutter;
+    width = static_cast<int>(tileSize) - 2 * TileGutter;
+}
+
+
+GLint
+ShadowAtlas::bindTile(int tile)
+{
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    fbo->bind();
+
+    // Clear the whole tile, including its gutter
+    glEnable(GL_SCISSOR_TEST);
+    glScissor((tile % tilesPerSide) * static_cast<int>(tileSize),
+              (tile / tilesPerSide) * static_cast<int>(tileSize),
+              static_cast<GLsizei>(tileSize), static_cast<GLsizei>(tileSize));
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    int x;
+    int y;
+    int width;
+    getTileViewport(tile, x, y, width);
+    glViewport(x, y, width, width);
+
+    return oldFboId;
+}
+
+
+void
+ShadowAtlas::unbind(GLint oldFboId)
+{
+    fbo->unbind(oldFboId);
+}
+
+
+Eigen::Matrix4f
+ShadowAtlas::getTileMatrix(int tile) const
+{
+    int x;
+    int y;
+    int width;
+    getTileViewport(tile, x, y, width);
+
+    float atlasSize = static_cast<float>(size());
+    float scale = static_cast<float>(width) / atlasSize;
+    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+    m(0, 0) = scale;
+    m(1, 1) = scale;
+    m(0, 3) = (2.0f * static_cast<float>(x) + static_cast<float>(width)) / atlasSize - 1.0f;
+    m(1, 3) = (2.0f * static_cast<float>(y) + static_cast<float>(width)) / atlasSize - 1.0f;
+    return m;
+}
+
+
+Eigen::Vector4f
+ShadowAtlas::getTileRect(int tile) const
+{
+    int x;
+    int y;
+    int width;
+    getTileViewport(tile, x, y, width);
+
+    // Keep the filter kernel within the tile
+    constexpr float margin = 1.5f;
+    float atlasSize = static_cast<float>(size());
+    return Eigen::Vector4f(static_cast<float>(x) + margin,
+                           static_cast<float>(y) + margin,
+                           static_cast<float>(x + width) - margin,
+                           static_cast<float>(y + width) - margin) / atlasSize;
+}
+
+} // end namespace celestia::engine
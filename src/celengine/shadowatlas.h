@@ -0,0 +1,89 @@
+// shadowatlas.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/glsupport.h>
+
+class FramebufferObject;
+
+namespace celestia::engine
+{
+
+/*! A single depth texture split into square tiles, each holding the shadow
+ *  map of one cascade of a caster. Tiles keep their depth between frames,
+ *  so that the shadow map of a caster is only rendered again once the
+ *  light moves relative to it.
+ */
+class ShadowAtlas
+{
+public:
+    // Cascades of a caster: the whole caster, and the part closest to the
+    // observer at a higher resolution
+    static constexpr int MaxCascades = 2;
+
+    // Tiles of tileSize texels, in a texture no larger than maxSize
+    ShadowAtlas(unsigned int tileSize, unsigned int maxSize);
+    ~ShadowAtlas();
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    bool isValid() const;
+    GLuint depthTexture() const;
+    GLuint size() const;
+    unsigned int getTileSize() const { return tileSize; }
+    int getTileCount() const { return static_cast<int>(tiles.size()); }
+
+    void beginFrame() { ++frame; }
+
+    // Tile for a cascade of a caster, with lightMatrix mapping the caster
+    // to the normalized coordinates of the tile. When cached is set, the
+    // tile still holds the depth of the caster rendered with a matrix
+    // close to it, and lightMatrix is replaced by that matrix; otherwise
+    // the depth must be rendered after bindTile.
+    int findTile(const void* caster, int cascade, Eigen::Matrix4f& lightMatrix, bool& cached);
+
+    // Bind the framebuffer and clear the depth of a tile. Return the
+    // framebuffer bound before.
+    GLint bindTile(int tile);
+    void unbind(GLint oldFboId);
+
+    // Matrix from the normalized coordinates of a tile to those of the
+    // whole atlas
+    Eigen::Matrix4f getTileMatrix(int tile) const;
+    // Texture coordinates of a tile, minus a margin for filtering
+    Eigen::Vector4f getTileRect(int tile) const;
+
+private:
+    struct Tile
+    {
+        const void* caster{ nullptr };
+        int cascade{ 0 };
+        Eigen::Matrix4f lightMatrix{ Eigen::Matrix4f::Zero() };
+        std::uint64_t lastUsed{ 0 };
+        bool rendered{ false };
+    };
+
+    void getTileViewport(int tile, int& x, int& y, int& width) const;
+
+    std::unique_ptr<FramebufferObject> fbo;
+    unsigned int tileSize;
+    int tilesPerSide{ 0 };
+    std::vector<Tile> tiles;
+    std::uint64_t frame{ 1 };
+};
+
+} // end namespace celestia::engine
@@ -14,6 +14,8 @@
 #include <cmath>
 #include <cstdlib>
 #include <iterator>
+#include <memory>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -41,6 +43,17 @@ constexpr double MAX_VISIBLE_ARCS = 10.0;
 // Number of line segments used to approximate one arc of the celestial sphere
 constexpr int ARC_SUBDIVISIONS = 100;
 
+// Number of line segments used to approximate a full parallel of a grid
+// kept in a static buffer
+constexpr int STATIC_ARC_SUBDIVISIONS = 360;
+
+// Grids with at most this many parallels and meridians are built once for
+// the whole sphere instead of every frame for the visible part
+constexpr int MAX_STATIC_GRID_ARCS = 256;
+
+// Number of whole sphere grids kept
+constexpr std::size_t MAX_STATIC_GRIDS = 4;
+
 // Size of the cross indicating the north and south poles
 const double POLAR_CROSS_SIZE = 0.01;
 
@@ -180,6 +193,87 @@ static void updateAngleRange(double a, double b, double* maxDiff, double* minAng
 }
 
 
+namespace
+{
+// Whole sphere grid, in grid coordinates so that it can be shared by all
+// grids with the same spacing
+struct StaticGrid
+{
+    int totalLongitudeUnits;
+    int raIncrement;
+    int decIncrement;
+    int vertexCount;
+    std::unique_ptr<LineRenderer> lines;
+};
+
+std::vector<StaticGrid> staticGrids;
+}
+
+
+static void
+addArcSegments(LineRenderer& lines, const Vector3f& center, const Vector3f& axis0, const Vector3f& axis1,
+               double angle0, double angle1, int subdivisions)
+{
+    double step = (angle1 - angle0) / (double) subdivisions;
+    Vector3f p0 = center + axis0 * (float) std::cos(angle0) + axis1 * (float) std::sin(angle0);
+    for (int j = 1; j <= subdivisions; j++)
+    {
+        double a = angle0 + j * step;
+        Vector3f p1 = center + axis0 * (float) std::cos(a) + axis1 * (float) std::sin(a);
+        lines.addSegment(p0, p1);
+        p0 = p1;
+    }
+}
+
+
+// Find or build the whole sphere grid with the specified spacing
+static const StaticGrid&
+getStaticGrid(const Renderer& renderer, int totalLongitudeUnits, int raIncrement, int decIncrement)
+{
+    for (const StaticGrid& grid : staticGrids)
+    {
+        if (grid.totalLongitudeUnits == totalLongitudeUnits &&
+            grid.raIncrement == raIncrement &&
+            grid.decIncrement == decIncrement)
+        {
+            return grid;
+        }
+    }
+
+    if (staticGrids.size() >= MAX_STATIC_GRIDS)
+        staticGrids.erase(staticGrids.begin());
+
+    auto lines = std::make_unique<LineRenderer>(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static);
+
+    // Vectors are converted to Celestia coordinates
+    for (int dec = -DEG_MIN_SEC_TOTAL / 2 + decIncrement; dec < DEG_MIN_SEC_TOTAL / 2; dec += decIncrement)
+    {
+        double phi = celestia::numbers::pi * (double) dec / (double) DEG_MIN_SEC_TOTAL;
+        auto cosPhi = (float) std::cos(phi);
+        addArcSegments(*lines, Vector3f(0.0f, (float) std::sin(phi), 0.0f),
+                       Vector3f(cosPhi, 0.0f, 0.0f), Vector3f(0.0f, 0.0f, -cosPhi),
+                       -celestia::numbers::pi, celestia::numbers::pi, STATIC_ARC_SUBDIVISIONS);
+    }
+
+    double maxMeridianAngle = celestia::numbers::pi / 2.0 * (1.0 - 2.0 * (double) decIncrement / (double) DEG_MIN_SEC_TOTAL);
+    auto meridianSubdivisions = std::max(1, (int) (STATIC_ARC_SUBDIVISIONS * maxMeridianAngle * celestia::numbers::inv_pi));
+    for (int ra = 0; ra < totalLongitudeUnits; ra += raIncrement)
+    {
+        double theta = 2.0 * celestia::numbers::pi * (double) ra / (double) totalLongitudeUnits;
+        addArcSegments(*lines, Vector3f::Zero(),
+                       Vector3f((float) std::cos(theta), 0.0f, -(float) std::sin(theta)), Vector3f::UnitY(),
+                       -maxMeridianAngle, maxMeridianAngle, meridianSubdivisions);
+    }
+
+    int parallels = DEG_MIN_SEC_TOTAL / decIncrement - 1;
+    int meridians = (totalLongitudeUnits + raIncrement - 1) / raIncrement;
+    int vertexCount = (parallels * STATIC_ARC_SUBDIVISIONS + meridians * meridianSubdivisions) * 2;
+
+    staticGrids.push_back({ totalLongitudeUnits, raIncrement, decIncrement, vertexCount, std::move(lines) });
+    return staticGrids.back();
+}
+
+
 // Get the horizontal alignment for the coordinate label along the specified frustum plane
 static Renderer::LabelHorizontalAlignment
 getCoordLabelHAlign(int planeIndex)
@@ -500,6 +594,11 @@ SkyGrid::render(Renderer& renderer,
     double arcStep = (maxTheta - minTheta) / (double) ARC_SUBDIVISIONS;
     double theta0 = minTheta;
 
+    // Coarse grids are drawn from a buffer covering the whole sphere, so
+    // only the labels are computed every frame
+    int arcCount = DEG_MIN_SEC_TOTAL / decIncrement + totalLongitudeUnits / raIncrement;
+    bool useStaticGrid = arcCount <= MAX_STATIC_GRID_ARCS;
+
     int count = 0;
     if (g_gridRenderer == nullptr)
         g_gridRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::LineStrip, LineRenderer::StorageType::Stream);
@@ -512,7 +611,7 @@ SkyGrid::render(Renderer& renderer,
         double cosPhi = cos(phi);
         double sinPhi = sin(phi);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS; j++)
+        for (int j = 0; j <= ARC_SUBDIVISIONS && !useStaticGrid; j++)
         {
             double theta = theta0 + j * arcStep;
             auto x = (float) (cosPhi * std::cos(theta));
@@ -587,7 +686,7 @@ SkyGrid::render(Renderer& renderer,
         double cosTheta = cos(theta);
         double sinTheta = sin(theta);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS; j++)
+        for (int j = 0; j <= ARC_SUBDIVISIONS && !useStaticGrid; j++)
         {
             double phi = phi0 + j * arcStep;
             auto x = (float) (cos(phi) * cosTheta);
@@ -649,10 +748,19 @@ SkyGrid::render(Renderer& renderer,
     ps.smoothLines = true;
     renderer.setPipelineState(ps);
 
-    for (int offset = 0, i = 0; i < count; i++)
+    if (useStaticGrid)
     {
-        g_gridRenderer->render(matrices, m_lineColor, ARC_SUBDIVISIONS + 1, offset);
-        offset += ARC_SUBDIVISIONS + 1;
+        const StaticGrid& grid = getStaticGrid(renderer, totalLongitudeUnits, raIncrement, decIncrement);
+        grid.lines->render(matrices, m_lineColor, grid.vertexCount);
+        grid.lines->finish();
+    }
+    else
+    {
+        for (int offset = 0, i = 0; i < count; i++)
+        {
+            g_gridRenderer->render(matrices, m_lineColor, ARC_SUBDIVISIONS + 1, offset);
+            offset += ARC_SUBDIVISIONS + 1;
+        }
     }
 
     // Draw crosses indicating the north and south poles
@@ -682,4 +790,5 @@ SkyGrid::deinit()
     g_gridRenderer = nullptr;
     delete g_crossRenderer;
     g_crossRenderer = nullptr;
+    staticGrids.clear();
 }
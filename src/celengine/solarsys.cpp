@@ -10,23 +10,39 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
 #include <istream>
+#include <iterator>
 #include <limits>
+#include <map>
 #include <memory>
+#include <ostream>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Geometry>
 #include <fmt/printf.h>
 
+#include <celastro/astro.h>
+#include <celastro/date.h>
+#include <celcompat/bit.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
 #include <celmath/mathlib.h>
+#include <celutil/binarywrite.h>
 #include <celutil/color.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/orderedprefetch.h>
 #include <celutil/stringutils.h>
 #include <celutil/tokenizer.h>
 #include "atmosphere.h"
@@ -39,9 +55,12 @@
 #include "meshmanager.h"
 #include "parseobject.h"
 #include "parser.h"
+#include "selection.h"
 #include "solarsys.h"
 #include "surface.h"
 #include "texmanager.h"
+#include "timeline.h"
+#include "timelinephase.h"
 #include "universe.h"
 #include "value.h"
 
@@ -50,6 +69,8 @@ using std::size_t;
 using std::strncmp;
 
 using celestia::util::GetLogger;
+using celestia::util::OrderedPrefetch;
+namespace astro = celestia::astro;
 namespace math = celestia::math;
 
 namespace
@@ -97,14 +118,22 @@ enum BodyType
   The name and parent name are both mandatory.
 */
 
-void sscError(const Tokenizer& tok,
+void sscError(int lineNumber,
               const std::string& msg)
 {
     GetLogger()->error(_("Error in .ssc file (line {}): {}\n"),
-                      tok.getLineNumber(), msg);
+                      lineNumber, msg);
 }
 
 
+// Part of a catalog text which can be parsed on its own
+struct CatalogChunk
+{
+    std::string_view text;
+    int firstLine;
+};
+
+
 // Object class properties
 const int CLASSES_UNCLICKABLE           = Body::Invisible |
                                           Body::Diffuse;
@@ -182,6 +211,25 @@ inline void SetOrUnset(Dst &dst, Flag flag, bool cond)
 }
 
 
+// Height maps are virtual textures, looked for in the texture directories
+// from the highest resolution down
+fs::path ResolveHeightMap(const std::string& source, const fs::path& path)
+{
+    for (const char* directory : { "hires", "medres", "lores" })
+    {
+        fs::path filename = path.empty()
+            ? fs::path("textures") / directory / source
+            : path / "textures" / directory / source;
+        std::error_code ec;
+        if (fs::is_regular_file(filename, ec))
+            return filename;
+    }
+
+    GetLogger()->warn("Height map {} not found\n", source);
+    return fs::path();
+}
+
+
 void FillinSurface(const Hash* surfaceData,
                    Surface* surface,
                    const fs::path& path)
@@ -239,6 +287,11 @@ void FillinSurface(const Hash* surfaceData,
 
     if (overlayTexture != nullptr)
         surface->overlayTexture.setTexture(*overlayTexture, path, baseFlags);
+
+    if (const std::string* heightMap = surfaceData->getString("HeightMap"); heightMap != nullptr)
+        surface->heightMap = ResolveHeightMap(*heightMap, path);
+    if (auto heightScale = surfaceData->getLength<float>("HeightScale"); heightScale.has_value())
+        surface->heightScale = *heightScale;
 }
 
 
@@ -767,6 +820,36 @@ void ReadRings(Body* body,
 }
 
 
+// Set the classification of a body and the default properties which depend
+// on it. An unknown classification is guessed from the radius.
+void SetClassification(Body* body,
+                       const PlanetarySystem* system,
+                       int classification,
+                       double radius)
+{
+    if (classification == Body::Unknown)
+    {
+        // Try to guess the type
+        if (system->getPrimaryBody() != nullptr)
+            classification = radius > 0.1 ? Body::Moon : Body::Spacecraft;
+        else
+            classification = radius < 1000.0 ? Body::Asteroid : Body::Planet;
+    }
+    body->setClassification(classification);
+
+    if (classification == Body::Invisible)
+        body->setVisible(false);
+
+    // Set default properties for the object based on its classification
+    if (classification & CLASSES_INVISIBLE_AS_POINT)
+        body->setVisibleAsPoint(false);
+    if ((classification & CLASSES_SECONDARY_ILLUMINATOR) == 0)
+        body->setSecondaryIlluminator(false);
+    if (classification & CLASSES_UNCLICKABLE)
+        body->setClickable(false);
+}
+
+
 // Create a body (planet, moon, spacecraft, etc.) using the values from a
 // property list. The usePlanetsUnits flags specifies whether period and
 // semi-major axis are in years and AU rather than days and kilometers.
@@ -877,26 +960,7 @@ Body* CreateBody(const std::string& name,
     if (const std::string* classificationName = planetData->getString("Class"); classificationName != nullptr)
         classification = GetClassificationId(*classificationName);
 
-    if (classification == Body::Unknown)
-    {
-        // Try to guess the type
-        if (system->getPrimaryBody() != nullptr)
-            classification = radius > 0.1 ? Body::Moon : Body::Spacecraft;
-        else
-            classification = radius < 1000.0 ? Body::Asteroid : Body::Planet;
-    }
-    body->setClassification(classification);
-
-    if (classification == Body::Invisible)
-        body->setVisible(false);
-
-    // Set default properties for the object based on its classification
-    if (classification & CLASSES_INVISIBLE_AS_POINT)
-        body->setVisibleAsPoint(false);
-    if ((classification & CLASSES_SECONDARY_ILLUMINATOR) == 0)
-        body->setSecondaryIlluminator(false);
-    if (classification & CLASSES_UNCLICKABLE)
-        body->setClickable(false);
+    SetClassification(body, system, classification, radius);
 
     // FIXME: should be own class
     if (const std::string* infoURL = planetData->getString("InfoURL"); infoURL != nullptr)
@@ -1083,20 +1147,43 @@ Body* CreateReferencePoint(const std::string& name,
 
     return body;
 }
-} // end unnamed namespace
 
-bool LoadSolarSystemObjects(std::istream& in,
-                            Universe& universe,
-                            const fs::path& directory)
+// Split a name list at the ':' delimiters, there's always at least one name
+std::vector<std::string> SplitNames(std::string_view nameList)
 {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    std::vector<std::string> names;
+    // Iterate through the string for names delimited
+    // by ':', and insert them into the name list.
+    if (nameList.empty())
+    {
+        names.emplace_back();
+    }
+    else
+    {
+        std::string_view::size_type startPos   = 0;
+        while (startPos != std::string_view::npos)
+        {
+            std::string_view::size_type next   = nameList.find(':', startPos);
+            std::string_view::size_type length = std::string_view::npos;
+            if (next != std::string_view::npos)
+            {
+                length = next - startPos;
+                ++next;
+            }
+            names.emplace_back(nameList.substr(startPos, length));
+            startPos   = next;
+        }
+    }
 
-#ifdef ENABLE_NLS
-    std::string s = directory.string();
-    const char* d = s.c_str();
-    bindtextdomain(d, d); // domain name is the same as resource path
-#endif
+    return names;
+}
+
+
+void parseSolarSystemObjects(Tokenizer& tokenizer,
+                             int firstLine,
+                             ParsedSolarSystemCatalog& catalog)
+{
+    Parser parser(&tokenizer);
 
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
@@ -1138,8 +1225,9 @@ bool LoadSolarSystemObjects(std::istream& in,
         }
         else
         {
-            sscError(tokenizer, "object name expected");
-            return false;
+            sscError(tokenizer.getLineNumber() + firstLine - 1, "object name expected");
+            catalog.isComplete = false;
+            return;
         }
 
         tokenizer.nextToken();
@@ -1150,136 +1238,766 @@ bool LoadSolarSystemObjects(std::istream& in,
         }
         else
         {
-            sscError(tokenizer, "bad parent object name");
-            return false;
+            sscError(tokenizer.getLineNumber() + firstLine - 1, "bad parent object name");
+            catalog.isComplete = false;
+            return;
         }
 
-        const Value objectDataValue = parser.readValue();
-        const Hash* objectData = objectDataValue.getHash();
-        if (objectData == nullptr)
+        Value objectDataValue = parser.readValue();
+        if (objectDataValue.getHash() == nullptr)
         {
-            sscError(tokenizer, "{ expected");
-            return false;
+            sscError(tokenizer.getLineNumber() + firstLine - 1, "{ expected");
+            catalog.isComplete = false;
+            return;
         }
 
-        Selection parent = universe.findPath(parentName, {});
-        PlanetarySystem* parentSystem = nullptr;
+        catalog.entries.push_back(ParsedSolarSystemCatalog::Entry{ disposition,
+                                                                  std::move(itemType),
+                                                                  std::move(nameList),
+                                                                  std::move(parentName),
+                                                                  std::move(objectDataValue),
+                                                                  tokenizer.getLineNumber() + firstLine - 1 });
+    }
+}
+
 
-        std::vector<std::string> names;
-        // Iterate through the string for names delimited
-        // by ':', and insert them into the name list.
-        if (nameList.empty())
+// The objects added by a catalog being loaded, and the bodies it added
+// when it was loaded before
+struct CatalogTracking
+{
+    SolarSystemCatalogObjects& objects;
+    std::unordered_set<const Body*> previousBodies;
+};
+
+
+void loadSolarSystemObject(const ParsedSolarSystemCatalog::Entry& entry,
+                           Universe& universe,
+                           const fs::path& directory,
+                           CatalogTracking* tracking)
+{
+    DataDisposition disposition = entry.disposition;
+    const std::string& itemType = entry.itemType;
+    const std::string& nameList = entry.nameList;
+    const std::string& parentName = entry.parentName;
+    const Hash* objectData = entry.params.getHash();
+
+    Selection parent = universe.findPath(parentName, {});
+    PlanetarySystem* parentSystem = nullptr;
+
+    std::vector<std::string> names = SplitNames(nameList);
+    std::string primaryName = names.front();
+
+    BodyType bodyType = UnknownBodyType;
+    if (itemType == "Body")
+        bodyType = NormalBody;
+    else if (itemType == "ReferencePoint")
+        bodyType = ReferencePoint;
+    else if (itemType == "SurfaceObject")
+        bodyType = SurfaceObject;
+
+    if (bodyType != UnknownBodyType)
+    {
+        //bool orbitsPlanet = false;
+        if (parent.star() != nullptr)
+        {
+            const SolarSystem* solarSystem = universe.getOrCreateSolarSystem(parent.star());
+            parentSystem = solarSystem->getPlanets();
+        }
+        else if (parent.body() != nullptr)
         {
-            names.push_back("");
+            // Parent is a planet or moon
+            parentSystem = parent.body()->getOrCreateSatellites();
         }
         else
         {
-            std::string::size_type startPos   = 0;
-            while (startPos != std::string::npos)
-            {
-                std::string::size_type next   = nameList.find(':', startPos);
-                std::string::size_type length = std::string::npos;
-                if (next != std::string::npos)
-                {
-                    length = next - startPos;
-                    ++next;
-                }
-                names.push_back(nameList.substr(startPos, length));
-                startPos   = next;
-            }
+            sscError(entry.lineNumber, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
         }
-        std::string primaryName = names.front();
-
-        BodyType bodyType = UnknownBodyType;
-        if (itemType == "Body")
-            bodyType = NormalBody;
-        else if (itemType == "ReferencePoint")
-            bodyType = ReferencePoint;
-        else if (itemType == "SurfaceObject")
-            bodyType = SurfaceObject;
 
-        if (bodyType != UnknownBodyType)
+        if (parentSystem != nullptr)
         {
-            //bool orbitsPlanet = false;
-            if (parent.star() != nullptr)
+            Body* existingBody = parentSystem->find(primaryName);
+
+            // A body which the catalog added before is redefined in place
+            if (existingBody != nullptr && tracking != nullptr &&
+                disposition == DataDisposition::Add &&
+                tracking->previousBodies.erase(existingBody) > 0)
             {
-                const SolarSystem* solarSystem = universe.getOrCreateSolarSystem(parent.star());
-                parentSystem = solarSystem->getPlanets();
+                disposition = DataDisposition::Replace;
             }
-            else if (parent.body() != nullptr)
+
+            if (existingBody)
             {
-                // Parent is a planet or moon
-                parentSystem = parent.body()->getOrCreateSatellites();
+                if (disposition == DataDisposition::Add)
+                    sscError(entry.lineNumber, fmt::sprintf(_("warning duplicate definition of %s %s\n"), parentName, primaryName));
+                else if (disposition == DataDisposition::Replace)
+                    existingBody->setDefaultProperties();
             }
+
+            Body* body;
+            if (bodyType == ReferencePoint)
+                body = CreateReferencePoint(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition);
             else
-            {
-                sscError(tokenizer, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
-            }
+                body = CreateBody(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition, bodyType);
 
-            if (parentSystem != nullptr)
+            if (body != nullptr)
             {
-                Body* existingBody = parentSystem->find(primaryName);
-                if (existingBody)
+                UserCategory::loadCategories(body, *objectData, disposition, directory.string());
+                if (entry.disposition == DataDisposition::Add)
                 {
-                    if (disposition == DataDisposition::Add)
-                        sscError(tokenizer, fmt::sprintf(_("warning duplicate definition of %s %s\n"), parentName, primaryName));
-                    else if (disposition == DataDisposition::Replace)
-                        existingBody->setDefaultProperties();
-                }
-
-                Body* body;
-                if (bodyType == ReferencePoint)
-                    body = CreateReferencePoint(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition);
-                else
-                    body = CreateBody(primaryName, parentSystem, universe, existingBody, objectData, directory, disposition, bodyType);
-
-                if (body != nullptr)
-                {
-                    UserCategory::loadCategories(body, *objectData, disposition, directory.string());
-                    if (disposition == DataDisposition::Add)
-                        for (const auto& name : names)
-                            body->addAlias(name);
+                    for (const auto& name : names)
+                        body->addAlias(name);
+                    if (tracking != nullptr)
+                        tracking->objects.bodies.push_back(body);
                 }
             }
         }
-        else if (itemType == "AltSurface")
+    }
+    else if (itemType == "AltSurface")
+    {
+        auto surface = std::make_unique<Surface>();
+        surface->color = Color(1.0f, 1.0f, 1.0f);
+        FillinSurface(objectData, surface.get(), directory);
+        if (parent.body() != nullptr)
+            parent.body()->addAlternateSurface(primaryName, std::move(surface));
+        else
+            sscError(entry.lineNumber, _("bad alternate surface"));
+    }
+    else if (itemType == "Location")
+    {
+        if (parent.body() != nullptr)
         {
-            auto surface = std::make_unique<Surface>();
-            surface->color = Color(1.0f, 1.0f, 1.0f);
-            FillinSurface(objectData, surface.get(), directory);
-            if (parent.body() != nullptr)
-                parent.body()->addAlternateSurface(primaryName, std::move(surface));
+            std::unique_ptr<Location> location = CreateLocation(objectData, parent.body());
+            if (location != nullptr)
+            {
+                UserCategory::loadCategories(location.get(), *objectData, disposition, directory.string());
+                location->setName(primaryName);
+                if (tracking != nullptr)
+                    tracking->objects.locations.push_back(location.get());
+                parent.body()->addLocation(std::move(location));
+            }
             else
-                sscError(tokenizer, _("bad alternate surface"));
+            {
+                sscError(entry.lineNumber, _("bad location"));
+            }
         }
-        else if (itemType == "Location")
+        else
         {
-            if (parent.body() != nullptr)
+            sscError(entry.lineNumber, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
+        }
+    }
+
+    // Later objects may refer to this one by its path
+    universe.notifyCatalogChanged();
+}
+
+
+// Split a catalog after the end of top level objects into chunks of at
+// least SolarSystemCatalogChunkSize bytes. Strings and comments are
+// skipped so that the braces in them aren't counted.
+std::vector<CatalogChunk> splitCatalog(std::string_view text)
+{
+    std::vector<CatalogChunk> chunks;
+    std::size_t start = 0;
+    int startLine = 1;
+    int line = 1;
+    int depth = 0;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        switch (text[i])
+        {
+        case '\n':
+            ++line;
+            break;
+        case '#':
+            if (std::size_t lineEnd = text.find('\n', i); lineEnd == std::string_view::npos)
+                i = text.size() - 1;
+            else
+                i = lineEnd - 1;
+            break;
+        case '"':
+            for (++i; i < text.size() && text[i] != '"'; ++i)
             {
-                std::unique_ptr<Location> location = CreateLocation(objectData, parent.body());
-                if (location != nullptr)
-                {
-                    UserCategory::loadCategories(location.get(), *objectData, disposition, directory.string());
-                    location->setName(primaryName);
-                    parent.body()->addLocation(std::move(location));
-                }
-                else
-                {
-                    sscError(tokenizer, _("bad location"));
-                }
+                if (text[i] == '\\' && i + 1 < text.size())
+                    ++i;
+                if (text[i] == '\n')
+                    ++line;
             }
-            else
+            break;
+        case '{':
+            ++depth;
+            break;
+        case '}':
+            if (depth > 0 && --depth == 0 && i + 1 - start >= SolarSystemCatalogChunkSize)
+            {
+                chunks.push_back(CatalogChunk{ text.substr(start, i + 1 - start), startLine });
+                start = i + 1;
+                startLine = line;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (start < text.size() || chunks.empty())
+        chunks.push_back(CatalogChunk{ text.substr(start), startLine });
+
+    return chunks;
+}
+
+// Binary minor body catalog, all values little endian:
+//   8 bytes  "CEL_MBCs"
+//   u16      version
+//   u32      number of parents
+//   u32      number of bodies
+// followed by the parents:
+//   string   path of the parent
+//   u8       1 if the parent is a star, 0 if it's a body
+// and the bodies:
+//   u32      index of the parent
+//   string   names, separated by ':'
+//   u32      classification, Body::Unknown to guess it
+//   u8       flags (BinaryBodyFlags)
+//   f32      radius in km, 0 for the default
+//   f32      albedo, 0 for the default
+//   f32      rotation period in days, 0 for the shared fixed orientation
+//   f64      semi-major axis in km
+//   f64      eccentricity
+//   f64      inclination, ascending node, argument of pericenter and mean
+//            anomaly in radians
+//   f64      period in days
+//   f64      epoch
+// Strings are stored as a u16 length followed by the characters.
+constexpr char BINARY_HEADER[]         = "CEL_MBCs";
+constexpr std::uint16_t BINARY_VERSION = 0x0100;
+
+enum BinaryBodyFlags : std::uint8_t
+{
+    // The albedo is the geometric albedo, which also sets the Bond albedo
+    // and reflectivity, rather than the deprecated Albedo
+    GeomAlbedoFlag = 0x01,
+};
+
+
+// Reads little endian values from a binary catalog in memory
+class BinaryCatalogReader
+{
+public:
+    explicit BinaryCatalogReader(std::string_view data) : m_data(data) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (m_data.size() < sizeof(T))
+            return false;
+
+        std::array<char, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), m_data.data(), sizeof(T));
+        if constexpr (celestia::compat::endian::native == celestia::compat::endian::big)
+            std::reverse(bytes.begin(), bytes.end());
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        m_data.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    bool readString(std::string_view& value)
+    {
+        std::uint16_t length;
+        if (!read(length) || m_data.size() < length)
+            return false;
+
+        value = m_data.substr(0, length);
+        m_data.remove_prefix(length);
+        return true;
+    }
+
+private:
+    std::string_view m_data;
+};
+
+
+bool writeBinaryString(std::ostream& out, std::string_view str)
+{
+    using celestia::util::writeLE;
+
+    return str.size() <= UINT16_MAX &&
+           writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(str.size())) &&
+           out.write(str.data(), static_cast<std::streamsize>(str.size())).good();
+}
+
+
+// Parent of the bodies of a binary catalog
+struct BinaryCatalogParent
+{
+    std::string_view path;
+    PlanetarySystem* system{ nullptr };
+    ReferenceFrame::SharedConstPtr frame;
+};
+
+
+BinaryCatalogParent
+findBinaryCatalogParent(Universe& universe, std::string_view path, bool isStar)
+{
+    BinaryCatalogParent parent;
+    parent.path = path;
+    Selection selection = universe.findPath(path, {});
+    if (isStar && selection.star() != nullptr)
+    {
+        const SolarSystem* solarSystem = universe.getOrCreateSolarSystem(selection.star());
+        parent.system = solarSystem->getPlanets();
+        parent.frame = solarSystem->getFrameTree()->getDefaultReferenceFrame();
+    }
+    else if (!isStar && selection.body() != nullptr)
+    {
+        parent.system = selection.body()->getOrCreateSatellites();
+        parent.frame = selection.body()->getOrCreateFrameTree()->getDefaultReferenceFrame();
+    }
+    else
+    {
+        GetLogger()->error("Parent {} of binary solar system catalog bodies not found.\n", path);
+    }
+
+    return parent;
+}
+
+
+bool loadBinaryCatalog(std::string_view data,
+                       Universe& universe,
+                       [[maybe_unused]] const fs::path& directory)
+{
+    BinaryCatalogReader reader(data.substr(sizeof(BINARY_HEADER) - 1));
+    std::uint16_t version;
+    std::uint32_t nParents;
+    std::uint32_t nBodies;
+    if (!reader.read(version) || !reader.read(nParents) || !reader.read(nBodies))
+    {
+        GetLogger()->error("Bad header for binary solar system catalog.\n");
+        return false;
+    }
+
+    if (version != BINARY_VERSION)
+    {
+        GetLogger()->error("Unsupported binary solar system catalog version {:#06x}.\n", version);
+        return false;
+    }
+
+#ifdef ENABLE_NLS
+    std::string s = directory.string();
+    const char* d = s.c_str();
+    bindtextdomain(d, d); // domain name is the same as resource path
+#endif
+
+    std::vector<BinaryCatalogParent> parents;
+    parents.reserve(nParents);
+    for (std::uint32_t i = 0; i < nParents; ++i)
+    {
+        std::string_view path;
+        std::uint8_t isStar;
+        if (!reader.readString(path) || !reader.read(isStar))
+        {
+            GetLogger()->error("Error reading binary solar system catalog parent {}.\n", i);
+            return false;
+        }
+
+        parents.push_back(findBinaryCatalogParent(universe, path, isStar != 0));
+    }
+
+    // Bodies without a rotation period share a fixed orientation. Like the
+    // other rotation models, it lives as long as the bodies.
+    celestia::ephem::RotationModel* fixedRotation = nullptr;
+    for (std::uint32_t i = 0; i < nBodies; ++i)
+    {
+        std::uint32_t parentIndex;
+        std::string_view nameList;
+        std::uint32_t classification;
+        std::uint8_t flags;
+        float radius;
+        float albedo;
+        float rotationPeriod;
+        astro::KeplerElements elements;
+        double epoch;
+        if (!reader.read(parentIndex) ||
+            !reader.readString(nameList) ||
+            !reader.read(classification) ||
+            !reader.read(flags) ||
+            !reader.read(radius) ||
+            !reader.read(albedo) ||
+            !reader.read(rotationPeriod) ||
+            !reader.read(elements.semimajorAxis) ||
+            !reader.read(elements.eccentricity) ||
+            !reader.read(elements.inclination) ||
+            !reader.read(elements.longAscendingNode) ||
+            !reader.read(elements.argPericenter) ||
+            !reader.read(elements.meanAnomaly) ||
+            !reader.read(elements.period) ||
+            !reader.read(epoch) ||
+            parentIndex >= nParents)
+        {
+            GetLogger()->error("Error reading binary solar system catalog body {}.\n", i);
+            universe.notifyCatalogChanged();
+            return false;
+        }
+
+        const BinaryCatalogParent& parent = parents[parentIndex];
+        if (parent.system == nullptr)
+            continue;
+
+        std::vector<std::string> names = SplitNames(nameList);
+        if (parent.system->find(names.front()) != nullptr)
+        {
+            GetLogger()->warn("Duplicate definition of {} {} in binary solar system catalog.\n", parent.path, names.front());
+        }
+
+        Body* body = parent.system->addBody(names.front());
+
+        celestia::ephem::Orbit* orbit;
+        if (elements.eccentricity < 1.0)
+            orbit = std::make_unique<celestia::ephem::EllipticalOrbit>(elements, epoch).release();
+        else
+            orbit = std::make_unique<celestia::ephem::HyperbolicOrbit>(elements, epoch).release();
+
+        celestia::ephem::RotationModel* rotationModel;
+        if (rotationPeriod > 0.0f)
+        {
+            rotationModel = std::make_unique<celestia::ephem::UniformRotationModel>(rotationPeriod,
+                                                                                    0.0f,
+                                                                                    astro::J2000,
+                                                                                    0.0f,
+                                                                                    0.0f).release();
+        }
+        else
+        {
+            if (fixedRotation == nullptr)
+                fixedRotation = CreateDefaultRotationModel(0.0);
+            rotationModel = fixedRotation;
+        }
+
+        auto phase = TimelinePhase::CreateTimelinePhase(universe,
+                                                        body,
+                                                        -std::numeric_limits<double>::infinity(),
+                                                        std::numeric_limits<double>::infinity(),
+                                                        parent.frame,
+                                                        *orbit,
+                                                        parent.frame,
+                                                        *rotationModel);
+        auto timeline = std::make_unique<Timeline>();
+        timeline->appendPhase(phase);
+        body->setTimeline(std::move(timeline));
+
+        if (radius > 0.0f)
+            body->setSemiAxes(Eigen::Vector3f::Constant(radius));
+        SetClassification(body, parent.system, static_cast<int>(classification), body->getRadius());
+
+        if (albedo > 0.0f)
+        {
+            body->setGeomAlbedo(albedo);
+            if ((flags & GeomAlbedoFlag) != 0)
             {
-                sscError(tokenizer, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
+                body->setBondAlbedo(std::min(albedo, 1.0f));
+                body->setReflectivity(std::min(albedo, 1.0f));
             }
         }
+
+        Surface surface;
+        surface.color = Color(1.0f, 1.0f, 1.0f);
+        body->setSurface(surface);
+
+        for (const auto& name : names)
+            body->addAlias(name);
     }
 
-    // TODO: Return some notification if there's an error parsing the file
+    universe.notifyCatalogChanged();
     return true;
 }
 
 
+// Properties of a body that the binary format holds
+bool isBinaryBodyProperty(std::string_view key)
+{
+    return key == "Class" || key == "Radius" || key == "Albedo" || key == "GeomAlbedo" ||
+           key == "RotationPeriod" || key == "EllipticalOrbit";
+}
+
+
+bool writeBinaryBody(std::ostream& out,
+                     const ParsedSolarSystemCatalog::Entry& entry,
+                     std::uint32_t parentIndex,
+                     bool orbitsStar)
+{
+    using celestia::util::writeLE;
+
+    const Hash* bodyData = entry.params.getHash();
+    std::string_view unsupported;
+    bodyData->for_all([&unsupported](std::string_view key, const Value&)
+    {
+        if (unsupported.empty() && !isBinaryBodyProperty(key))
+            unsupported = key;
+    });
+
+    if (!unsupported.empty())
+    {
+        GetLogger()->error("Property {} of {} can't be stored in a binary catalog.\n", unsupported, entry.nameList);
+        return false;
+    }
+
+    const Value* orbitValue = bodyData->getValue("EllipticalOrbit");
+    const Hash* orbitData = orbitValue == nullptr ? nullptr : orbitValue->getHash();
+    astro::KeplerElements elements;
+    double epoch;
+    if (orbitData == nullptr || !ParseKeplerElements(orbitData, orbitsStar, elements, epoch))
+    {
+        GetLogger()->error("Bad elliptical orbit for {}.\n", entry.nameList);
+        return false;
+    }
+
+    int classification = Body::Unknown;
+    if (const std::string* className = bodyData->getString("Class"); className != nullptr)
+        classification = GetClassificationId(*className);
+
+    std::uint8_t flags = 0;
+    float albedo = 0.0f;
+    if (auto geomAlbedo = bodyData->getNumber<float>("GeomAlbedo"); geomAlbedo.has_value())
+    {
+        albedo = *geomAlbedo;
+        flags |= GeomAlbedoFlag;
+    }
+    else
+    {
+        albedo = bodyData->getNumber<float>("Albedo").value_or(0.0f);
+    }
+
+    auto rotationPeriod = bodyData->getNumber<double>("RotationPeriod").value_or(0.0) / astro::HOURS_PER_DAY;
+
+    return writeLE<std::uint32_t>(out, parentIndex) &&
+           writeBinaryString(out, entry.nameList) &&
+           writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(classification)) &&
+           writeLE<std::uint8_t>(out, flags) &&
+           writeLE<float>(out, bodyData->getLength<float>("Radius").value_or(0.0f)) &&
+           writeLE<float>(out, albedo) &&
+           writeLE<float>(out, static_cast<float>(rotationPeriod)) &&
+           writeLE<double>(out, elements.semimajorAxis) &&
+           writeLE<double>(out, elements.eccentricity) &&
+           writeLE<double>(out, elements.inclination) &&
+           writeLE<double>(out, elements.longAscendingNode) &&
+           writeLE<double>(out, elements.argPericenter) &&
+           writeLE<double>(out, elements.meanAnomaly) &&
+           writeLE<double>(out, elements.period) &&
+           writeLE<double>(out, epoch);
+}
+
+
+bool loadParsedCatalog(ParsedSolarSystemCatalog&& catalog,
+                       Universe& universe,
+                       const fs::path& directory,
+                       CatalogTracking* tracking)
+{
+#ifdef ENABLE_NLS
+    std::string s = directory.string();
+    const char* d = s.c_str();
+    bindtextdomain(d, d); // domain name is the same as resource path
+#endif
+
+    for (const auto& entry : catalog.entries)
+        loadSolarSystemObject(entry, universe, directory, tracking);
+
+    // TODO: Return some notification if there's an error in an object
+    return catalog.isComplete;
+}
+
+
+bool loadTextCatalog(std::string_view text,
+                     Universe& universe,
+                     const fs::path& directory,
+                     CatalogTracking* tracking)
+{
+    std::vector<CatalogChunk> chunks = splitCatalog(text);
+    if (chunks.size() == 1)
+        return loadParsedCatalog(ParseSolarSystemObjects(text), universe, directory, tracking);
+
+    // The objects only depend on the earlier ones through their parents,
+    // which are looked up when they're added, so the chunks are parsed
+    // ahead on worker threads and added in order. Like a serial load, the
+    // objects after a parse error are dropped.
+    OrderedPrefetch<ParsedSolarSystemCatalog> prefetch(chunks.size(), [&chunks](std::size_t i)
+    {
+        return ParseSolarSystemObjects(chunks[i].text, chunks[i].firstLine);
+    });
+
+    while (!prefetch.done())
+    {
+        if (!loadParsedCatalog(prefetch.next(), universe, directory, tracking))
+            return false;
+    }
+
+    return true;
+}
+
+} // end unnamed namespace
+
+ParsedSolarSystemCatalog ParseSolarSystemObjects(std::string_view text, int firstLine)
+{
+    ParsedSolarSystemCatalog catalog;
+    Tokenizer tokenizer(text);
+    parseSolarSystemObjects(tokenizer, firstLine, catalog);
+    return catalog;
+}
+
+
+bool LoadSolarSystemObjects(ParsedSolarSystemCatalog&& catalog,
+                            Universe& universe,
+                            const fs::path& directory,
+                            SolarSystemCatalogObjects* objects)
+{
+    if (objects == nullptr)
+        return loadParsedCatalog(std::move(catalog), universe, directory, nullptr);
+
+    CatalogTracking tracking{ *objects, {} };
+    return loadParsedCatalog(std::move(catalog), universe, directory, &tracking);
+}
+
+
+bool LoadSolarSystemObjects(std::istream& in,
+                            Universe& universe,
+                            const fs::path& directory)
+{
+    char header[sizeof(BINARY_HEADER) - 1];
+    auto start = in.tellg();
+    bool isBinary = in.read(header, sizeof(header)).good() &&
+                    IsBinarySolarSystemCatalog(std::string_view(header, sizeof(header)));
+    in.clear();
+    in.seekg(start);
+    if (isBinary)
+    {
+        std::string data(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>{});
+        return loadBinaryCatalog(data, universe, directory);
+    }
+
+    ParsedSolarSystemCatalog catalog;
+    Tokenizer tokenizer(&in);
+    parseSolarSystemObjects(tokenizer, 1, catalog);
+    return LoadSolarSystemObjects(std::move(catalog), universe, directory);
+}
+
+
+bool LoadSolarSystemObjects(std::string_view text,
+                            Universe& universe,
+                            const fs::path& directory,
+                            SolarSystemCatalogObjects* objects)
+{
+    if (IsBinarySolarSystemCatalog(text))
+        return loadBinaryCatalog(text, universe, directory);
+
+    if (objects == nullptr)
+        return loadTextCatalog(text, universe, directory, nullptr);
+
+    CatalogTracking tracking{ *objects, {} };
+    return loadTextCatalog(text, universe, directory, &tracking);
+}
+
+
+bool ReloadSolarSystemObjects(std::string_view text,
+                              Universe& universe,
+                              const fs::path& directory,
+                              SolarSystemCatalogObjects& objects,
+                              const std::function<void(const Selection&)>& removing)
+{
+    if (IsBinarySolarSystemCatalog(text))
+    {
+        GetLogger()->error("Binary solar system catalogs can't be reloaded.\n");
+        return false;
+    }
+
+    // Locations are added again as new objects
+    for (Location* location : objects.locations)
+    {
+        removing(Selection(location));
+        location->getParentBody()->removeLocation(location);
+    }
+
+    universe.notifyCatalogChanged();
+
+    CatalogTracking tracking{ objects, {} };
+    tracking.previousBodies.insert(objects.bodies.begin(), objects.bodies.end());
+    std::vector<Body*> previousBodies = std::move(objects.bodies);
+    objects.bodies.clear();
+    objects.locations.clear();
+
+    bool complete = loadTextCatalog(text, universe, directory, &tracking);
+
+    // Satellites were added after their primaries, so they're removed first
+    for (auto it = previousBodies.rbegin(); it != previousBodies.rend(); ++it)
+    {
+        if (tracking.previousBodies.count(*it) == 0)
+            continue;
+        removing(Selection(*it));
+        (*it)->getSystem()->removeBody(*it);
+    }
+
+    universe.notifyCatalogChanged();
+    return complete;
+}
+
+
+bool IsBinarySolarSystemCatalog(std::string_view data)
+{
+    return data.substr(0, sizeof(BINARY_HEADER) - 1) == std::string_view(BINARY_HEADER, sizeof(BINARY_HEADER) - 1);
+}
+
+
+bool ConvertToBinarySolarSystemCatalog(std::istream& in, std::ostream& out)
+{
+    using celestia::util::writeLE;
+
+    ParsedSolarSystemCatalog catalog;
+    Tokenizer tokenizer(&in);
+    parseSolarSystemObjects(tokenizer, 1, catalog);
+    if (!catalog.isComplete)
+        return false;
+
+    // The parents are only known once all the bodies are read
+    std::vector<std::string_view> parentPaths;
+    std::map<std::string_view, std::uint32_t> parentIndices;
+    std::ostringstream bodies(std::ios::out | std::ios::binary);
+    for (const auto& entry : catalog.entries)
+    {
+        if (entry.disposition != DataDisposition::Add || entry.itemType != "Body")
+        {
+            GetLogger()->error("Only added bodies can be stored in a binary catalog, not {} {}.\n",
+                               entry.itemType, entry.nameList);
+            return false;
+        }
+
+        auto [it, inserted] = parentIndices.try_emplace(entry.parentName, static_cast<std::uint32_t>(parentPaths.size()));
+        if (inserted)
+            parentPaths.push_back(entry.parentName);
+
+        // The parents of bodies orbiting stars are star names, unlike the
+        // paths of bodies, so orbital elements use the units for planets
+        bool orbitsStar = entry.parentName.find('/') == std::string::npos;
+        if (!writeBinaryBody(bodies, entry, it->second, orbitsStar))
+            return false;
+    }
+
+    if (!out.write(BINARY_HEADER, sizeof(BINARY_HEADER) - 1).good() ||
+        !writeLE<std::uint16_t>(out, BINARY_VERSION) ||
+        !writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(parentPaths.size())) ||
+        !writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(catalog.entries.size())))
+    {
+        return false;
+    }
+
+    for (std::string_view path : parentPaths)
+    {
+        bool orbitsStar = path.find('/') == std::string_view::npos;
+        if (!writeBinaryString(out, path) || !writeLE<std::uint8_t>(out, orbitsStar ? 1 : 0))
+            return false;
+    }
+
+    std::string data = bodies.str();
+    return out.write(data.data(), static_cast<std::streamsize>(data.size())).good();
+}
+
+
 SolarSystem::SolarSystem(Star* _star) :
     star(_star)
 {
@@ -9,18 +9,28 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <map>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <celcompat/filesystem.h>
+#include <celengine/value.h>
 
 
+class Body;
+enum class DataDisposition;
 class FrameTree;
+class Location;
 class PlanetarySystem;
+class Selection;
 class Star;
 class Universe;
 
@@ -43,6 +53,71 @@ class SolarSystem
 
 using SolarSystemCatalog = std::map<std::uint32_t, std::unique_ptr<SolarSystem>>;
 
+// The object definitions of a solar system catalog. Parsing them doesn't
+// touch the universe, so that catalogs can be parsed on worker threads;
+// the objects are then added in order, which resolves their parents.
+struct ParsedSolarSystemCatalog
+{
+    struct Entry
+    {
+        DataDisposition disposition;
+        std::string itemType;
+        std::string nameList;
+        std::string parentName;
+        Value params;
+        int lineNumber;
+    };
+
+    std::vector<Entry> entries;
+    // False if parsing stopped at an error, the entries before it are kept
+    bool isComplete{ true };
+};
+
+// Catalogs larger than this are split between objects and the parts
+// parsed in parallel while the earlier ones are added
+constexpr std::size_t SolarSystemCatalogChunkSize = 1 << 20;
+
+// Parse a catalog in memory, firstLine is the line number of its start
+ParsedSolarSystemCatalog ParseSolarSystemObjects(std::string_view text, int firstLine = 1);
+
+// Binary catalogs hold minor bodies with Keplerian orbits and a few
+// physical properties, which are loaded without parsing. They're detected
+// from the contents of a catalog by the loaders.
+bool IsBinarySolarSystemCatalog(std::string_view data);
+
+// Convert a text catalog of bodies to the binary format, failing if one
+// of them has properties which it doesn't hold
+bool ConvertToBinarySolarSystemCatalog(std::istream& in, std::ostream& out);
+
+// The bodies and locations added by a text catalog, which are redefined or
+// removed when it's loaded again. Bodies added by binary catalogs aren't
+// recorded.
+struct SolarSystemCatalogObjects
+{
+    std::vector<Body*> bodies;
+    std::vector<Location*> locations;
+};
+
+bool LoadSolarSystemObjects(ParsedSolarSystemCatalog&& catalog,
+                            Universe& universe,
+                            const fs::path& dir = fs::path(),
+                            SolarSystemCatalogObjects* objects = nullptr);
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
                             const fs::path& dir = fs::path());
+// Load a catalog from text in memory, such as a mapped file
+bool LoadSolarSystemObjects(std::string_view text,
+                            Universe& universe,
+                            const fs::path& dir = fs::path(),
+                            SolarSystemCatalogObjects* objects = nullptr);
+
+// Load a text catalog again after it has changed, given the objects it
+// added before. The bodies it still defines are redefined in place, so
+// that pointers to them stay valid. Its locations and the bodies it no
+// longer defines are removed, together with their satellites; removing
+// is called for each of them first, so that references can be dropped.
+bool ReloadSolarSystemObjects(std::string_view text,
+                              Universe& universe,
+                              const fs::path& dir,
+                              SolarSystemCatalogObjects& objects,
+                              const std::function<void(const Selection&)>& removing);
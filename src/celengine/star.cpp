@@ -1104,6 +1104,13 @@ StarDetails::shared() const
 }
 
 
+void
+StarDetails::setShared()
+{
+    isShared = true;
+}
+
+
 void
 StarDetails::addOrbitingStar(Star* star)
 {
@@ -85,6 +85,9 @@ class StarDetails
     void setInfoURL(std::string_view _infoURL);
 
     bool shared() const;
+    // Share custom details between stars; they are cloned before a star
+    // changes them
+    void setShared();
     inline bool hasCorona() const;
 
     enum
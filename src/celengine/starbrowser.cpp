@@ -9,86 +9,118 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <string>
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
 #include <set>
+#include <string>
+#include <utility>
+#include <celastro/astro.h>
 #include "starbrowser.h"
 
 using namespace Eigen;
 using namespace std;
 
-struct CloserStarPredicate
+namespace
+{
+
+// The largest number of stars listed
+constexpr unsigned int MaxListedStars = 500;
+// Radius of the first search for the nearest or brighter stars, without
+// an earlier search to start from
+constexpr float InitialSearchRadius = 16.0f;
+// Beyond the star octree, so that a search this large finds all the stars
+constexpr float MaxSearchRadius = 1.0e10f;
+
+struct BrightestStarPredicate
 {
-    Vector3f pos;
     bool operator()(const Star* star0, const Star* star1) const
     {
-        return (pos - star0->getPosition()).squaredNorm() < (pos - star1->getPosition()).squaredNorm();
+        return star0->getAbsoluteMagnitude() < star1->getAbsoluteMagnitude();
     }
 };
 
-struct BrighterStarPredicate
+// Keep the nStars stars with the smallest key found by a search, in a heap
+// with the largest key first
+class BestStarsHandler : public StarHandler
 {
-    Vector3f pos;
-    UniversalCoord ucPos;
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        float d0 = (pos - star0->getPosition()).norm();
-        float d1 = (pos - star1->getPosition()).norm();
+public:
+    explicit BestStarsHandler(std::size_t _nStars) : nStars(_nStars) {}
 
-        // If the stars are closer than one light year, use
-        // a more precise distance estimate.
-        if (d0 < 1.0f)
-            d0 = ucPos.offsetFromLy(star0->getPosition()).norm();
-        if (d1 < 1.0f)
-            d1 = ucPos.offsetFromLy(star1->getPosition()).norm();
+    bool full() const { return heap.size() >= nStars; }
+    float worstKey() const { return heap.front().first; }
 
-        return star0->getApparentMagnitude(d0) < star1->getApparentMagnitude(d1);
+    void add(float key, const Star& star)
+    {
+        if (heap.size() < nStars)
+        {
+            heap.emplace_back(key, &star);
+            std::push_heap(heap.begin(), heap.end());
+        }
+        else if (key < heap.front().first)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = { key, &star };
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    std::vector<const Star*>* sorted()
+    {
+        std::sort_heap(heap.begin(), heap.end());
+        auto* stars = new std::vector<const Star*>();
+        stars->reserve(heap.size());
+        for (const auto& entry : heap)
+            stars->push_back(entry.second);
+        return stars;
     }
+
+    std::size_t nStars;
+    std::vector<std::pair<float, const Star*>> heap;
 };
 
-struct BrightestStarPredicate
+class NearestStarsHandler : public BestStarsHandler
 {
-    bool operator()(const Star* star0, const Star* star1) const
+public:
+    using BestStarsHandler::BestStarsHandler;
+
+    void process(const Star& star, float distance, float /*appMag*/) override
     {
-        return star0->getAbsoluteMagnitude() < star1->getAbsoluteMagnitude();
+        add(distance, star);
     }
 };
 
-struct SolarSystemPredicate
+class BrighterStarsHandler : public BestStarsHandler
 {
-    Vector3f pos;
-    SolarSystemCatalog* solarSystems;
-
-    bool operator()(const Star* star0, const Star* star1) const
+public:
+    BrighterStarsHandler(std::size_t _nStars, const UniversalCoord& _ucPos) :
+        BestStarsHandler(_nStars), ucPos(_ucPos)
     {
-        SolarSystemCatalog::iterator iter;
+    }
 
-        iter = solarSystems->find(star0->getIndex());
-        bool hasPlanets0 = (iter != solarSystems->end());
-        iter = solarSystems->find(star1->getIndex());
-        bool hasPlanets1 = (iter != solarSystems->end());
-        if (hasPlanets1 == hasPlanets0)
-        {
-            return ((pos - star0->getPosition()).squaredNorm() < (pos - star1->getPosition()).squaredNorm());
-        }
-        else
-        {
-            return hasPlanets0;
-        }
+    void process(const Star& star, float distance, float appMag) override
+    {
+        // If the star is closer than one light year, use a more precise
+        // distance estimate.
+        if (distance < 1.0f)
+            appMag = star.getApparentMagnitude(static_cast<float>(ucPos.offsetFromLy(star.getPosition()).norm()));
+        add(appMag, star);
     }
-};
 
+    UniversalCoord ucPos;
+};
 
 // Find the nearest/brightest/X-est N stars in a database.  The
 // supplied predicate determines which of two stars is a better match.
-template<class Pred> static std::vector<const Star*>*
+template<class Pred> std::vector<const Star*>*
 findStars(const StarDatabase& stardb, Pred pred, int nStars)
 {
     std::vector<const Star*>* finalStars = new std::vector<const Star*>();
     if (nStars == 0)
         return finalStars;
-    if(nStars > 500)
-        nStars = 500;
+    if (nStars > static_cast<int>(MaxListedStars))
+        nStars = static_cast<int>(MaxListedStars);
 
     typedef std::multiset<const Star*, Pred> StarSet;
     StarSet firstStars(pred);
@@ -126,16 +158,137 @@ findStars(const StarDatabase& stardb, Pred pred, int nStars)
     return finalStars;
 }
 
+// The next radius to search for nStars stars, when the search within
+// radius found fewer of them
+float
+growRadius(float radius, std::size_t found, std::size_t nStars)
+{
+    // Assume the density of stars is uniform, with some margin
+    float factor = found == 0
+        ? 8.0f
+        : std::clamp(std::cbrt(static_cast<float>(nStars) / static_cast<float>(found)) * 1.2f, 1.25f, 8.0f);
+    return radius * factor;
+}
+
+} // end unnamed namespace
+
 
 const Star* StarBrowser::nearestStar()
 {
-    Universe* univ = appSim->getUniverse();
-    CloserStarPredicate closerPred;
-    closerPred.pos = pos;
-    std::vector<const Star*>* stars = findStars(*(univ->getStarCatalog()), closerPred, 1);
-    const Star *star = (*stars)[0];
-    delete stars;
-    return star;
+    const StarDatabase& stardb = *appSim->getUniverse()->getStarCatalog();
+    if (stardb.size() == 0)
+        return nullptr;
+
+    NearestStarsHandler handler(1);
+    float radius = InitialSearchRadius;
+    float maxRadius = pos.norm() + MaxSearchRadius;
+    for (;;)
+    {
+        stardb.findCloseStars(handler, pos, radius);
+        if (handler.full() || radius > maxRadius)
+            break;
+        radius = growRadius(radius, 0, 1);
+    }
+
+    return handler.heap.empty() ? nullptr : handler.heap.front().second;
+}
+
+
+// Search with a growing radius until it holds nStars stars, all of them
+// closer than the stars outside it. The search starts from the radius of
+// the previous one, enlarged by the distance moved since, which usually
+// holds enough stars.
+std::vector<const Star*>*
+StarBrowser::listNearestStars(const StarDatabase& stardb, unsigned int nStars)
+{
+    nStars = std::min({ nStars, MaxListedStars, stardb.size() });
+    NearestStarsHandler handler(nStars);
+    if (nStars == 0)
+        return handler.sorted();
+
+    float radius = InitialSearchRadius;
+    if (lastPredicate == NearestStars && lastCount == nStars)
+        radius = std::max(lastRadius + (pos - lastPos).norm(), 1.0f) * 1.001f;
+
+    float maxRadius = pos.norm() + MaxSearchRadius;
+    for (;;)
+    {
+        handler.heap.clear();
+        stardb.findCloseStars(handler, pos, radius);
+        if (handler.full() || radius > maxRadius)
+            break;
+        radius = growRadius(radius, handler.heap.size(), nStars);
+    }
+
+    lastRadius = handler.full() ? handler.worstKey() : radius;
+    lastPos = pos;
+    lastPredicate = NearestStars;
+    lastCount = nStars;
+    return handler.sorted();
+}
+
+
+// Search with a growing radius until the stars outside it are too far
+// to be brighter than the dimmest of the nStars brightest stars inside it.
+// No star can be brighter than the brightest absolute magnitude of the
+// catalog at its distance, as extinction only dims them.
+std::vector<const Star*>*
+StarBrowser::listBrighterStars(const StarDatabase& stardb, unsigned int nStars)
+{
+    nStars = std::min({ nStars, MaxListedStars, stardb.size() });
+    BrighterStarsHandler handler(nStars, ucPos);
+    listBrightestStars(stardb, 0);
+    if (nStars == 0 || brightestStars.empty())
+        return handler.sorted();
+
+    float brightestAbsMag = brightestStars.front()->getAbsoluteMagnitude();
+    float radius = InitialSearchRadius;
+    if (lastPredicate == BrighterStars && lastCount == nStars)
+        radius = std::max(lastRadius + (pos - lastPos).norm(), InitialSearchRadius);
+
+    float maxRadius = pos.norm() + MaxSearchRadius;
+    for (;;)
+    {
+        handler.heap.clear();
+        stardb.findCloseStars(handler, pos, radius);
+        if (radius > maxRadius)
+            break;
+
+        if (!handler.full())
+        {
+            radius = growRadius(radius, handler.heap.size(), nStars);
+            continue;
+        }
+
+        // The distance at which the brightest star of the catalog would
+        // be as dim as the dimmest star found
+        float limit = celestia::astro::parsecsToLightYears(
+            std::pow(10.0f, (handler.worstKey() - brightestAbsMag + 5.0f) / 5.0f));
+        if (limit <= radius)
+            break;
+        radius = std::min(limit, radius * 8.0f);
+    }
+
+    lastRadius = radius;
+    lastPos = pos;
+    lastPredicate = BrighterStars;
+    lastCount = nStars;
+    return handler.sorted();
+}
+
+
+std::vector<const Star*>*
+StarBrowser::listBrightestStars(const StarDatabase& stardb, unsigned int nStars)
+{
+    if (brightestDB != &stardb)
+    {
+        std::unique_ptr<std::vector<const Star*>> stars(findStars(stardb, BrightestStarPredicate(), MaxListedStars));
+        brightestStars = std::move(*stars);
+        brightestDB = &stardb;
+    }
+
+    auto count = std::min(static_cast<std::size_t>(nStars), brightestStars.size());
+    return new std::vector<const Star*>(brightestStars.begin(), brightestStars.begin() + count);
 }
 
 
@@ -143,48 +296,47 @@ std::vector<const Star*>*
 StarBrowser::listStars(unsigned int nStars)
 {
     Universe* univ = appSim->getUniverse();
+    const StarDatabase& stardb = *univ->getStarCatalog();
     switch(predicate)
     {
     case BrighterStars:
-        {
-            BrighterStarPredicate brighterPred;
-            brighterPred.pos = pos;
-            brighterPred.ucPos = ucPos;
-            return findStars(*(univ->getStarCatalog()), brighterPred, nStars);
-        }
-        break;
+        return listBrighterStars(stardb, nStars);
 
     case BrightestStars:
-        {
-            BrightestStarPredicate brightestPred;
-            return findStars(*(univ->getStarCatalog()), brightestPred, nStars);
-        }
-        break;
+        return listBrightestStars(stardb, nStars);
 
     case StarsWithPlanets:
         {
+            // There are much fewer solar systems than stars, so look up
+            // their stars instead of testing all the stars
             SolarSystemCatalog* solarSystems = univ->getSolarSystemCatalog();
             if (!solarSystems)
                 return nullptr;
-            SolarSystemPredicate solarSysPred;
-            solarSysPred.pos = pos;
-            solarSysPred.solarSystems = solarSystems;
-            return findStars(*(univ->getStarCatalog()), solarSysPred,
-                             min((size_t) nStars, solarSystems->size()));
+
+            std::vector<std::pair<float, const Star*>> found;
+            found.reserve(solarSystems->size());
+            for (const auto& [index, solarSystem] : *solarSystems)
+            {
+                if (const Star* star = stardb.find(index); star != nullptr)
+                    found.emplace_back((pos - star->getPosition()).squaredNorm(), star);
+            }
+
+            auto count = std::min({ static_cast<std::size_t>(nStars),
+                                    static_cast<std::size_t>(MaxListedStars),
+                                    found.size() });
+            std::partial_sort(found.begin(), found.begin() + count, found.end());
+
+            auto* stars = new std::vector<const Star*>();
+            stars->reserve(count);
+            for (std::size_t i = 0; i < count; ++i)
+                stars->push_back(found[i].second);
+            return stars;
         }
-        break;
 
     case NearestStars:
     default:
-        {
-            CloserStarPredicate closerPred;
-            closerPred.pos = pos;
-            return findStars(*(univ->getStarCatalog()), closerPred, nStars);
-        }
-        break;
+        return listNearestStars(stardb, nStars);
     }
-
-    return nullptr;  // keep compiler happy
 }
 
 
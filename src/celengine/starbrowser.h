@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "star.h"
 #include "stardb.h"
 #include "simulation.h"
@@ -42,6 +44,23 @@ class StarBrowser
     UniversalCoord ucPos;
 
  private:
+    std::vector<const Star*>* listNearestStars(const StarDatabase&, unsigned int);
+    std::vector<const Star*>* listBrighterStars(const StarDatabase&, unsigned int);
+    std::vector<const Star*>* listBrightestStars(const StarDatabase&, unsigned int);
+
     Simulation *appSim;
     int predicate;
+
+    // The radius searched by the last query for the nearest or brighter
+    // stars, and where from, so that the next query from a close position
+    // can start from it
+    float lastRadius{ 0.0f };
+    Eigen::Vector3f lastPos{ Eigen::Vector3f::Zero() };
+    int lastPredicate{ -1 };
+    unsigned int lastCount{ 0 };
+
+    // The brightest stars of the catalog don't depend on the position, so
+    // they are only found once
+    const StarDatabase* brightestDB{ nullptr };
+    std::vector<const Star*> brightestStars;
 };
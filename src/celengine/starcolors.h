@@ -55,6 +55,18 @@ class ColorTemperatureTable
         return tableType;
     }
 
+    // The entries of the table, lookupColor(temp) returns the entry with
+    // the index nearest to temp * getTemperatureScale()
+    const std::vector<Color>& getColors() const
+    {
+        return colors;
+    }
+
+    float getTemperatureScale() const
+    {
+        return tempScale;
+    }
+
     bool setType(ColorTableType _type);
 
  private:
@@ -15,7 +15,9 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <fstream>
 #include <istream>
+#include <memory>
 #include <set>
 #include <string_view>
 #include <system_error>
@@ -27,12 +29,16 @@
 #include <celcompat/bit.h>
 #include <celcompat/charconv.h>
 #include <celcompat/numbers.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/gettext.h>
 #include <celutil/intrusiveptr.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include <celutil/timer.h>
 #include <celutil/tokenizer.h>
 #include <celutil/stringutils.h>
+#include <celutil/taskscheduler.h>
 #include "meshmanager.h"
 #include "parser.h"
 #include "value.h"
@@ -44,6 +50,8 @@ using celestia::util::IntrusivePtr;
 namespace astro = celestia::astro;
 namespace math = celestia::math;
 
+using celestia::engine::computeFrustumPlanes;
+
 // Enable the below to switch back to parsing coordinates as float to match
 // legacy behaviour. This shouldn't be necessary since stars.dat stores
 // Cartesian coordinates.
@@ -90,10 +98,25 @@ constexpr inline std::string_view LacailleCatalogPrefix  = "Lacaille "sv;
 constexpr inline float STAR_OCTREE_ROOT_SIZE   = 1000000000.0f;
 
 constexpr inline float STAR_OCTREE_MAGNITUDE   = 6.0f;
+
+// Minimum number of stars for which the octree is built on multiple threads
+constexpr inline unsigned int PARALLEL_OCTREE_MIN_STARS = 100000;
 //constexpr const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for extra stars
 
 constexpr inline std::string_view STARSDAT_MAGIC   = "CELSTARS"sv;
 constexpr inline std::string_view CROSSINDEX_MAGIC = "CELINDEX"sv;
+constexpr inline std::string_view OCTREECACHE_MAGIC = "CELOCTRE"sv;
+
+// Increment whenever the octree build parameters change
+constexpr inline std::uint16_t OctreeCacheVersion = 0x0200;
+
+constexpr inline std::string_view NAMECACHE_MAGIC = "CELNAMES"sv;
+
+// Increment whenever the layout of the name index changes
+constexpr inline std::uint16_t NameCacheVersion = 0x0100;
+
+// Magic, version, padding keeping the arrays aligned and key
+constexpr inline std::size_t NameCacheHeaderSize = 20;
 
 constexpr inline AstroCatalog::IndexNumber TYC3_MULTIPLIER = 1000000000u;
 constexpr inline AstroCatalog::IndexNumber TYC2_MULTIPLIER = 10000u;
@@ -177,6 +200,26 @@ struct StarsDatRecord
 static_assert(std::is_standard_layout_v<StarsDatRecord>);
 
 
+// Verify the stars.dat header and return the number of star records
+std::optional<std::uint32_t>
+parseStarsDatHeader(const char* header)
+{
+    // Verify the magic string
+    if (std::string_view(header + offsetof(StarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
+        return std::nullopt;
+
+    // Verify the version
+    if (auto version = readIntLE<std::uint16_t>(header + offsetof(StarsDatHeader, version));
+        version != StarDBVersion)
+    {
+        return std::nullopt;
+    }
+
+    // Read the star count
+    return readIntLE<std::uint32_t>(header + offsetof(StarsDatHeader, counter));
+}
+
+
 // cross-index header structure
 struct CrossIndexHeader
 {
@@ -201,28 +244,36 @@ static_assert(std::is_standard_layout_v<CrossIndexRecord>);
 #pragma pack(pop)
 
 
+// Return whether only whitespace follows a number ending at ptr in name
+bool
+isNumberEnd(std::string_view name, const char* ptr)
+{
+    return name.find_first_not_of(" \t", static_cast<std::size_t>(ptr - name.data())) == std::string_view::npos;
+}
+
+
+// Parse the catalog number at pos in name, which must not have a suffix
+bool
+parseCatalogNumberAt(std::string_view name,
+                     std::string_view::size_type pos,
+                     AstroCatalog::IndexNumber& catalogNumber)
+{
+    auto [ptr, ec] = celestia::compat::from_chars(name.data() + pos, name.data() + name.size(), catalogNumber);
+    return ec == std::errc{} && isNumberEnd(name, ptr);
+}
+
+
 bool
 parseSimpleCatalogNumber(std::string_view name,
                          std::string_view prefix,
                          AstroCatalog::IndexNumber& catalogNumber)
 {
-    using celestia::compat::from_chars;
     if (compareIgnoringCase(name, prefix, prefix.size()) != 0)
         return false;
 
     // skip additional whitespace
     auto pos = name.find_first_not_of(" \t", prefix.size());
-    if (pos == std::string_view::npos)
-        return false;
-
-    if (auto [ptr, ec] = from_chars(name.data() + pos, name.data() + name.size(), catalogNumber); ec == std::errc{})
-    {
-        // Do not match if suffix is present
-        pos = name.find_first_not_of(" \t", ptr - name.data());
-        return pos == std::string_view::npos;
-    }
-
-    return false;
+    return pos != std::string_view::npos && parseCatalogNumberAt(name, pos, catalogNumber);
 }
 
 
@@ -287,8 +338,7 @@ parseTychoCatalogNumber(std::string_view name,
             || (tycParts[2] == TDSC_TYC3_MAX && tycParts[0] <= TDSC_TYC3_MAX_RANGE_TYC1)))
     {
         // Do not match if suffix is present
-        pos = name.find_first_not_of(" \t", result.ptr - name.data());
-        if (pos != std::string_view::npos)
+        if (!isNumberEnd(name, result.ptr))
             return false;
 
         catalogNumber = tycParts[2] * TYC3_MULTIPLIER
@@ -305,19 +355,7 @@ bool
 parseCelestiaCatalogNumber(std::string_view name,
                            AstroCatalog::IndexNumber& catalogNumber)
 {
-    using celestia::compat::from_chars;
-    if (name.size() == 0 || name[0] != '#')
-        return false;
-
-    if (auto [ptr, ec] = from_chars(name.data() + 1, name.data() + name.size(), catalogNumber);
-        ec == std::errc{})
-    {
-        // Do not match if suffix is present
-        auto pos = name.find_first_not_of(" \t", ptr - name.data());
-        return pos == std::string_view::npos;
-    }
-
-    return false;
+    return !name.empty() && name[0] == '#' && parseCatalogNumberAt(name, 1, catalogNumber);
 }
 
 
@@ -347,6 +385,39 @@ stcError(const Tokenizer& tok, std::string_view msg)
 }
 
 
+template<typename T>
+void
+appendKeyBytes(std::string& key, const T& value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+// Key of the parameters of custom star details without an orbit
+std::string
+makeStarDetailsKey(const StarDetails& details)
+{
+    std::string key;
+    appendKeyBytes(key, details.getRadius());
+    appendKeyBytes(key, details.getTemperature());
+    appendKeyBytes(key, details.getBolometricCorrection());
+    appendKeyBytes(key, details.getKnowledge());
+    appendKeyBytes(key, details.getVisibility());
+    MultiResTexture texture = details.getTexture();
+    appendKeyBytes(key, texture.tex);
+    appendKeyBytes(key, details.getGeometry());
+    appendKeyBytes(key, details.getRotationModel());
+    Eigen::Vector3f semiAxes = details.getEllipsoidSemiAxes();
+    appendKeyBytes(key, semiAxes.x());
+    appendKeyBytes(key, semiAxes.y());
+    appendKeyBytes(key, semiAxes.z());
+    key.append(details.getSpectralType());
+    key.push_back('\0');
+    key.append(details.getInfoURL());
+    return key;
+}
+
+
 void
 modifyStarDetails(Star* star,
                   IntrusivePtr<StarDetails>&& referenceDetails,
@@ -411,6 +482,46 @@ parseCustomStarDetails(const Hash* starData,
     return customDetails;
 }
 
+
+// Keeps the nStars nearest stars found in a max-heap of their distances,
+// and shrinks the search radius to the farthest of them once there are
+// nStars, so that the traversal skips the nodes beyond it.
+class NearestStarsFinder final
+{
+public:
+    NearestStarsFinder(std::size_t _nStars, float maxDistance, const std::function<bool(const Star&)>& _filter) :
+        nStars(_nStars), radius(maxDistance), filter(_filter)
+    {
+        heap.reserve(nStars + 1);
+    }
+
+    float searchRadius() const { return radius; }
+
+    void process(const Star& star, float distance, float /*appMag*/)
+    {
+        if (!(distance < radius) || (filter && !filter(star)))
+            return;
+
+        heap.emplace_back(distance, &star);
+        std::push_heap(heap.begin(), heap.end());
+        if (heap.size() > nStars)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+
+        if (heap.size() == nStars)
+            radius = heap.front().first;
+    }
+
+    std::vector<std::pair<float, const Star*>> heap;
+
+private:
+    std::size_t nStars;
+    float radius;
+    const std::function<bool(const Star&)>& filter;
+};
+
 } // end unnamed namespace
 
 
@@ -418,6 +529,7 @@ parseCustomStarDetails(const Hash* starData,
 StarDatabase::StarDatabase()
 {
     crossIndexes.resize(static_cast<std::size_t>(StarCatalog::MaxCatalog));
+    crossIndexStorage.resize(static_cast<std::size_t>(StarCatalog::MaxCatalog));
 }
 
 
@@ -531,11 +643,13 @@ StarDatabase::searchCrossIndex(StarCatalog catalog, AstroCatalog::IndexNumber nu
 
 
 void
-StarDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name) const
+StarDatabase::getCompletion(std::vector<std::string>& completion,
+                            std::string_view name,
+                            std::size_t limit) const
 {
     // only named stars are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        namesDB->getCompletion(completion, name);
+        namesDB->getCompletion(completion, name, limit);
 }
 
 
@@ -559,16 +673,18 @@ StarDatabase::getStarName(const Star& star, bool i18n) const
 
     if (namesDB != nullptr)
     {
-        StarNameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-        if (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber)
+        StarNameDatabase::Names names = namesDB->getNames(catalogNumber);
+        if (!names.empty())
         {
+            std::string_view name = *names.begin();
             if (i18n)
             {
-                const char * local = D_(iter->second.c_str());
-                if (iter->second != local)
+                // The names are NUL terminated
+                const char * local = D_(name.data());
+                if (name != local)
                     return local;
             }
-            return iter->second;
+            return std::string(name);
         }
     }
 
@@ -582,6 +698,13 @@ StarDatabase::getStarName(const Star& star, bool i18n) const
 }
 
 
+std::string_view
+StarDatabase::getStarLabel(const Star& star) const
+{
+    return labelNames.get(star.getIndex(), [&] { return getStarName(star, true); });
+}
+
+
 std::string
 StarDatabase::getStarNameList(const Star& star, const unsigned int maxNames) const
 {
@@ -605,12 +728,11 @@ StarDatabase::getStarNameList(const Star& star, const unsigned int maxNames) con
 
     if (namesDB != nullptr)
     {
-        StarNameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-
-        while (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber && nameSet.size() < maxNames)
+        for (std::string_view name : namesDB->getNames(catalogNumber))
         {
-            append(D_(iter->second.c_str()));
-            ++iter;
+            if (nameSet.size() >= maxNames)
+                break;
+            append(D_(name.data()));
         }
     }
 
@@ -657,31 +779,95 @@ StarDatabase::findVisibleStars(StarHandler& starHandler,
                                float aspectRatio,
                                float limitingMag) const
 {
-    // Compute the bounding planes of an infinite view frustum
-    Eigen::Hyperplane<float, 3> frustumPlanes[5];
-    Eigen::Vector3f planeNormals[5];
-    Eigen::Matrix3f rot = orientation.toRotationMatrix();
-    float h = (float) tan(fovY / 2);
-    float w = h * aspectRatio;
-    planeNormals[0] = Eigen::Vector3f(0.0f, 1.0f, -h);
-    planeNormals[1] = Eigen::Vector3f(0.0f, -1.0f, -h);
-    planeNormals[2] = Eigen::Vector3f(1.0f, 0.0f, -w);
-    planeNormals[3] = Eigen::Vector3f(-1.0f, 0.0f, -w);
-    planeNormals[4] = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
-    for (int i = 0; i < 5; i++)
-    {
-        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
-        frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
-    }
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
 
     octreeRoot->processVisibleObjects(starHandler,
                                       position,
-                                      frustumPlanes,
+                                      frustumPlanes.data(),
                                       limitingMag,
                                       STAR_OCTREE_ROOT_SIZE);
 }
 
 
+/*! Process the stars near the root of the octree like findVisibleStars, and
+ *  return the subtrees which remain to be traversed. Calling
+ *  findVisibleStarsInSubtree for all of them, possibly on different threads,
+ *  visits the same stars as findVisibleStars.
+ */
+std::vector<StarOctree::Subtree>
+StarDatabase::findVisibleStarSubtrees(StarHandler& starHandler,
+                                      const Eigen::Vector3f& position,
+                                      const Eigen::Quaternionf& orientation,
+                                      float fovY,
+                                      float aspectRatio,
+                                      float limitingMag,
+                                      std::size_t minSubtrees) const
+{
+    // Limit the number of levels processed serially; in sparse regions of
+    // the octree there may never be enough nodes to split the work.
+    constexpr unsigned int maxSerialLevels = 24;
+
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    return octreeRoot->processVisibleLevels(starHandler,
+                                            position,
+                                            frustumPlanes.data(),
+                                            limitingMag,
+                                            STAR_OCTREE_ROOT_SIZE,
+                                            minSubtrees,
+                                            maxSerialLevels);
+}
+
+
+/*! Process the visible stars like findVisibleStars, brightest first, until
+ *  the deadline. The next call with the same traversal continues where this
+ *  one stopped; returns true once all the visible stars have been processed.
+ */
+bool
+StarDatabase::findVisibleStarsUntil(StarHandler& starHandler,
+                                    StarOctree::Traversal& traversal,
+                                    const Eigen::Vector3f& position,
+                                    const Eigen::Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    std::chrono::steady_clock::time_point deadline) const
+{
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    return octreeRoot->processVisibleObjectsUntil(traversal,
+                                                  starHandler,
+                                                  position,
+                                                  frustumPlanes.data(),
+                                                  limitingMag,
+                                                  STAR_OCTREE_ROOT_SIZE,
+                                                  deadline);
+}
+
+
+void
+StarDatabase::findVisibleStarsInSubtree(StarHandler& starHandler,
+                                        const StarOctree::Subtree& subtree,
+                                        const Eigen::Vector3f& position,
+                                        const Eigen::Quaternionf& orientation,
+                                        float fovY,
+                                        float aspectRatio,
+                                        float limitingMag) const
+{
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    octreeRoot->processVisibleSubtree(subtree,
+                                      starHandler,
+                                      position,
+                                      frustumPlanes.data(),
+                                      limitingMag);
+}
+
+
 void
 StarDatabase::findCloseStars(StarHandler& starHandler,
                              const Eigen::Vector3f& position,
@@ -694,6 +880,21 @@ StarDatabase::findCloseStars(StarHandler& starHandler,
 }
 
 
+std::vector<std::pair<float, const Star*>>
+StarDatabase::findNearestStars(const Eigen::Vector3f& position,
+                               float maxDistance,
+                               std::size_t nStars,
+                               const std::function<bool(const Star&)>& filter) const
+{
+    NearestStarsFinder finder(nStars, maxDistance, filter);
+    if (nStars > 0)
+        octreeRoot->processNearestObjects(finder, position, STAR_OCTREE_ROOT_SIZE);
+
+    std::sort_heap(finder.heap.begin(), finder.heap.end());
+    return std::move(finder.heap);
+}
+
+
 StarNameDatabase*
 StarDatabase::getNameDatabase() const
 {
@@ -711,20 +912,10 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
         if (!in.read(header.data(), header.size()).good()) /* Flawfinder: ignore */
             return false;
 
-        // Verify the magic string
-        if (std::string_view(header.data() + offsetof(StarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
-            return false;
-
-        // Verify the version
-
-        if (auto version = readIntLE<std::uint16_t>(header.data() + offsetof(StarsDatHeader, version));
-            version != StarDBVersion)
-        {
+        if (auto count = parseStarsDatHeader(header.data()); count.has_value())
+            nStarsInFile = *count;
+        else
             return false;
-        }
-
-        // Read the star count
-        nStarsInFile = readIntLE<std::uint32_t>(header.data() + offsetof(StarsDatHeader, counter));
     }
 
     constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(StarsDatRecord);
@@ -736,48 +927,125 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
         if (!in.read(buffer.data(), sizeof(StarsDatRecord) * recordsToRead).good()) /* Flawfinder: ignore */
             return false;
 
-        const char* ptr = buffer.data();
-        for (std::uint32_t i = 0; i < recordsToRead; ++i)
+        if (!addBinaryRecords(buffer.data(), recordsToRead))
+            return false;
+
+        nStarsRemaining -= recordsToRead;
+    }
+
+    if (in.bad())
+        return false;
+
+    GetLogger()->debug("StarDatabase::read: nStars = {}, time = {} ms\n", nStarsInFile, timer.getTime());
+    finishBinaryLoad();
+    return true;
+}
+
+
+/*! Load stars.dat from an in-memory image of the file, e.g. one mapped with
+ *  celestia::util::MappedFile. The records are decoded in place without any
+ *  intermediate copies.
+ */
+bool
+StarDatabaseBuilder::loadBinary(const char* data, std::size_t size)
+{
+    Timer timer{};
+    if (size < sizeof(StarsDatHeader))
+        return false;
+
+    auto nStarsInFile = parseStarsDatHeader(data);
+    if (!nStarsInFile.has_value())
+        return false;
+
+    if ((size - sizeof(StarsDatHeader)) / sizeof(StarsDatRecord) < *nStarsInFile)
+    {
+        GetLogger()->error(_("Star database is truncated\n"));
+        return false;
+    }
+
+    if (!addBinaryRecords(data + sizeof(StarsDatHeader), *nStarsInFile))
+        return false;
+
+    GetLogger()->debug("StarDatabase::read: nStars = {}, time = {} ms\n", *nStarsInFile, timer.getTime());
+    finishBinaryLoad();
+    return true;
+}
+
+
+/*! Load stars.dat, memory-mapping the file where possible and falling back to
+ *  stream reading otherwise.
+ */
+bool
+StarDatabaseBuilder::loadBinary(const fs::path& path)
+{
+    if (auto mappedFile = celestia::util::MappedFile::open(path); mappedFile.has_value())
+    {
+        mappedFile->adviseSequential();
+        return loadBinary(mappedFile->data(), mappedFile->size());
+    }
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error(_("Error opening {}\n"), path);
+        return false;
+    }
+
+    return loadBinary(in);
+}
+
+
+bool
+StarDatabaseBuilder::addBinaryRecords(const char* ptr, std::uint32_t nRecords)
+{
+    // The spectral types in stars.dat come from a small set of values, so
+    // avoid the unpack and details lookup for runs of stars sharing one.
+    std::uint16_t lastSpectralType = 0;
+    IntrusivePtr<StarDetails> lastDetails = nullptr;
+
+    for (std::uint32_t i = 0; i < nRecords; ++i, ptr += sizeof(StarsDatRecord))
+    {
+        auto catNo = readIntLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatRecord, catNo));
+        float x = readFloatLE(ptr + offsetof(StarsDatRecord, x));
+        float y = readFloatLE(ptr + offsetof(StarsDatRecord, y));
+        float z = readFloatLE(ptr + offsetof(StarsDatRecord, z));
+        auto absMag = readIntLE<std::int16_t>(ptr + offsetof(StarsDatRecord, absMag));
+        auto spectralType = readIntLE<std::uint16_t>(ptr + offsetof(StarsDatRecord, spectralType));
+
+        if (lastDetails == nullptr || spectralType != lastSpectralType)
         {
-            auto catNo = readIntLE<AstroCatalog::IndexNumber>(ptr + offsetof(StarsDatRecord, catNo));
-            float x = readFloatLE(ptr + offsetof(StarsDatRecord, x));
-            float y = readFloatLE(ptr + offsetof(StarsDatRecord, y));
-            float z = readFloatLE(ptr + offsetof(StarsDatRecord, z));
-            auto absMag = readIntLE<std::int16_t>(ptr + offsetof(StarsDatRecord, absMag));
-            auto spectralType = readIntLE<std::uint16_t>(ptr + offsetof(StarsDatRecord, spectralType));
-
-            Star star;
-            star.setPosition(x, y, z);
-            star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
-
-            IntrusivePtr<StarDetails> details = nullptr;
             StellarClass sc;
-            if (sc.unpackV1(spectralType))
-                details = StarDetails::GetStarDetails(sc);
-
-            if (details == nullptr)
+            lastDetails = sc.unpackV1(spectralType) ? StarDetails::GetStarDetails(sc) : nullptr;
+            if (lastDetails == nullptr)
             {
                 GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), starDB->nStars);
                 return false;
             }
 
-            star.setDetails(std::move(details));
-            star.setIndex(catNo);
-            unsortedStars.add(star);
+            lastSpectralType = spectralType;
+        }
 
-            ptr += sizeof(StarsDatRecord);
-            ++starDB->nStars;
+        Star star;
+        star.setPosition(x, y, z);
+        star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+        star.setDetails(IntrusivePtr<StarDetails>(lastDetails));
+        star.setIndex(catNo);
+        if (unsortedStars.add(std::move(star)) == nullptr)
+        {
+            GetLogger()->error(_("Too many stars in star database\n"));
+            return false;
         }
 
-        nStarsRemaining -= recordsToRead;
+        ++starDB->nStars;
     }
 
-    if (in.bad())
-        return false;
+    return true;
+}
 
-    auto loadTime = timer.getTime();
 
-    GetLogger()->debug("StarDatabase::read: nStars = {}, time = {} ms\n", nStarsInFile, loadTime);
+void
+StarDatabaseBuilder::finishBinaryLoad()
+{
     GetLogger()->info(_("{} stars in binary database\n"), starDB->nStars);
 
     // Create the temporary list of stars sorted by catalog number; this
@@ -786,17 +1054,16 @@ StarDatabaseBuilder::loadBinary(std::istream& in)
     // replaced.
     if (auto binFileStarCount = unsortedStars.size(); binFileStarCount > 0)
     {
-        binFileCatalogNumberIndex.resize(binFileStarCount);
-        for (unsigned int i = 0; i < binFileStarCount; i++)
-        {
-            binFileCatalogNumberIndex[i] = &unsortedStars[i];
-        }
-
-        std::sort(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(),
-                  [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+        binFileCatalogNumberIndex.clear();
+        binFileCatalogNumberIndex.reserve(binFileStarCount);
+        unsortedStars.forEach([this](Star& star) { binFileCatalogNumberIndex.push_back(&star); });
+
+        // stars.dat files produced by makestardb are already in catalog
+        // number order, so the sort can usually be skipped.
+        auto compareIndex = [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); };
+        if (!std::is_sorted(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(), compareIndex))
+            std::sort(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(), compareIndex);
     }
-
-    return true;
 }
 
 
@@ -837,6 +1104,21 @@ bool
 StarDatabaseBuilder::load(std::istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool
+StarDatabaseBuilder::load(std::string_view text, const fs::path& resourcePath)
+{
+    Tokenizer tokenizer(text);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool
+StarDatabaseBuilder::load(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
     Parser parser(&tokenizer);
 
 #ifdef ENABLE_NLS
@@ -998,12 +1280,18 @@ StarDatabaseBuilder::load(std::istream& in, const fs::path& resourcePath)
         {
             if (isNewStar)
             {
-                unsortedStars.add(*star);
-                ++starDB->nStars;
+                Star* added = unsortedStars.add(*star);
                 delete star;
+                if (added == nullptr)
+                {
+                    GetLogger()->error(_("Too many stars, {} not added\n"), catalogNumber);
+                    continue;
+                }
+
+                ++starDB->nStars;
 
                 // Add the new star to the temporary (load time) index.
-                stcFileCatalogNumberIndex[catalogNumber] = &unsortedStars[unsortedStars.size() - 1];
+                stcFileCatalogNumberIndex[catalogNumber] = added;
             }
 
             if (starDB->namesDB != nullptr && !objName.empty())
@@ -1081,7 +1369,8 @@ StarDatabaseBuilder::loadCrossIndex(StarCatalog catalog, std::istream& in)
         }
     }
 
-    StarDatabase::CrossIndex& xindex = starDB->crossIndexes[catalogIndex];
+    starDB->crossIndexes[catalogIndex] = {};
+    std::vector<StarDatabase::CrossIndexEntry>& xindex = starDB->crossIndexStorage[catalogIndex];
     xindex = {};
 
     constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(CrossIndexRecord);
@@ -1127,10 +1416,183 @@ StarDatabaseBuilder::loadCrossIndex(StarCatalog catalog, std::istream& in)
     GetLogger()->debug("Loaded xindex in {} ms\n", timer.getTime());
 
     std::sort(xindex.begin(), xindex.end());
+    starDB->crossIndexes[catalogIndex] = xindex;
+    return true;
+}
+
+
+/*! The cache is keyed by the paths, sizes and modification times of the
+ *  source files, which unlike hashing their contents doesn't require
+ *  reading them.
+ */
+std::uint64_t
+StarDatabaseBuilder::computeNameCacheKey(const NameCacheSources& sources)
+{
+    // 64-bit FNV-1a
+    std::uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    auto addBytes = [&hash](const void* data, std::size_t size)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= UINT64_C(0x100000001b3);
+        }
+    };
+
+    auto addFile = [&addBytes](const fs::path& path)
+    {
+        std::string pathName = path.string();
+        std::uint64_t size = 0;
+        std::int64_t time = 0;
+        if (!path.empty())
+        {
+            std::error_code ec;
+            if (auto fileSize = fs::file_size(path, ec); !ec)
+                size = static_cast<std::uint64_t>(fileSize);
+            if (auto fileTime = fs::last_write_time(path, ec); !ec)
+                time = static_cast<std::int64_t>(fileTime.time_since_epoch().count());
+        }
+
+        addBytes(pathName.data(), pathName.size() + 1);
+        addBytes(&size, sizeof(size));
+        addBytes(&time, sizeof(time));
+    };
+
+    addFile(sources.starNames);
+    for (const fs::path& path : sources.crossIndexes)
+        addFile(path);
+
+    return hash;
+}
+
+
+bool
+StarDatabaseBuilder::loadNameCache(const fs::path& path, const NameCacheSources& sources)
+{
+    using celestia::compat::endian;
+
+    Timer timer{};
+
+    auto file = celestia::util::MappedFile::open(path);
+    if (!file.has_value() || file->size() < NameCacheHeaderSize)
+        return false;
+
+    const char* data = file->data();
+    if (std::string_view(data, NAMECACHE_MAGIC.size()) != NAMECACHE_MAGIC ||
+        readIntLE<std::uint16_t>(data + NAMECACHE_MAGIC.size()) != NameCacheVersion ||
+        readIntLE<std::uint64_t>(data + NAMECACHE_MAGIC.size() + 4) != computeNameCacheKey(sources))
+    {
+        GetLogger()->verbose("Star name cache {} is out of date\n", path);
+        return false;
+    }
+
+    std::string_view contents(data + NameCacheHeaderSize, file->size() - NameCacheHeaderSize);
+    auto namesDB = std::make_unique<StarNameDatabase>();
+    if (!namesDB->readSnapshot(contents))
+    {
+        GetLogger()->warn(_("Star name cache {} is corrupt\n"), path);
+        return false;
+    }
+
+    std::vector<StarDatabase::CrossIndex> crossIndexes(starDB->crossIndexes.size());
+    std::vector<std::vector<StarDatabase::CrossIndexEntry>> crossIndexStorage(crossIndexes.size());
+    for (std::size_t i = 0; i < crossIndexes.size(); ++i)
+    {
+        if (contents.size() < sizeof(std::uint32_t))
+            return false;
+
+        auto count = readIntLE<std::uint32_t>(contents.data());
+        contents.remove_prefix(sizeof(std::uint32_t));
+        if (count > contents.size() / sizeof(CrossIndexRecord))
+        {
+            GetLogger()->warn(_("Star name cache {} is corrupt\n"), path);
+            return false;
+        }
+
+        // The records are aligned in the file, so on little endian systems
+        // the mapped records are searched as they are
+        const char* records = contents.data();
+        if constexpr (endian::native == endian::little && sizeof(CrossIndexRecord) == sizeof(StarDatabase::CrossIndexEntry))
+        {
+            crossIndexes[i] = StarDatabase::CrossIndex(reinterpret_cast<const StarDatabase::CrossIndexEntry*>(records), count);
+        }
+        else
+        {
+            for (std::uint32_t j = 0; j < count; ++j, records += sizeof(CrossIndexRecord))
+            {
+                StarDatabase::CrossIndexEntry& ent = crossIndexStorage[i].emplace_back();
+                ent.catalogNumber = readIntLE<AstroCatalog::IndexNumber>(records + offsetof(CrossIndexRecord, catalogNumber));
+                ent.celCatalogNumber = readIntLE<AstroCatalog::IndexNumber>(records + offsetof(CrossIndexRecord, celCatalogNumber));
+            }
+            crossIndexes[i] = crossIndexStorage[i];
+        }
+
+        if (!std::is_sorted(crossIndexes[i].begin(), crossIndexes[i].end()))
+        {
+            GetLogger()->warn(_("Star name cache {} is corrupt\n"), path);
+            return false;
+        }
+
+        contents.remove_prefix(count * sizeof(CrossIndexRecord));
+    }
+
+    starDB->namesDB = std::move(namesDB);
+    starDB->crossIndexes = std::move(crossIndexes);
+    starDB->crossIndexStorage = std::move(crossIndexStorage);
+    starDB->nameCacheFile = std::move(file);
+
+    GetLogger()->debug("Loaded star names and cross indexes from cache in {} ms\n", timer.getTime());
     return true;
 }
 
 
+void
+StarDatabaseBuilder::writeNameCache(const fs::path& path, const NameCacheSources& sources) const
+{
+    using celestia::util::writeLE;
+
+    if (starDB->namesDB == nullptr)
+        return;
+
+    // Write to a temporary file first so that concurrently starting
+    // instances never see a partially written cache.
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+
+    std::error_code ec;
+    if (auto parentPath = path.parent_path(); !parentPath.empty())
+        fs::create_directories(parentPath, ec);
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        bool ok = out.good() &&
+                  out.write(NAMECACHE_MAGIC.data(), NAMECACHE_MAGIC.size()).good() &&
+                  writeLE(out, NameCacheVersion) &&
+                  writeLE(out, std::uint16_t(0)) &&
+                  writeLE(out, computeNameCacheKey(sources)) &&
+                  starDB->namesDB->writeSnapshot(out);
+
+        for (auto it = starDB->crossIndexes.cbegin(); ok && it != starDB->crossIndexes.cend(); ++it)
+        {
+            ok = writeLE(out, static_cast<std::uint32_t>(it->size()));
+            for (auto ent = it->begin(); ok && ent != it->end(); ++ent)
+                ok = writeLE(out, ent->catalogNumber) && writeLE(out, ent->celCatalogNumber);
+        }
+
+        if (!ok)
+        {
+            GetLogger()->warn(_("Failed to write star name cache {}\n"), path);
+            return;
+        }
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec)
+        GetLogger()->warn(_("Failed to write star name cache {}\n"), path);
+}
+
+
 std::unique_ptr<StarDatabase>
 StarDatabaseBuilder::finish()
 {
@@ -1163,6 +1625,12 @@ StarDatabaseBuilder::finish()
         UserCategory::addObject(star, category);
     }
 
+    std::size_t memorySize = starDB->nStars * sizeof(Star) +
+                             starDB->catalogNumberIndex.capacity() * sizeof(Star*);
+    for (const auto& storage : starDB->crossIndexStorage)
+        memorySize += storage.capacity() * sizeof(StarDatabase::CrossIndexEntry);
+    starDB->memory.set(memorySize);
+
     return std::move(starDB);
 }
 
@@ -1350,8 +1818,7 @@ StarDatabaseBuilder::createOrUpdateStarDetails(Star* star,
         const std::string* spectralType = starData->getString("SpectralType");
         if (spectralType != nullptr)
         {
-            StellarClass sc = StellarClass::parse(*spectralType);
-            referenceDetails = StarDetails::GetStarDetails(sc);
+            referenceDetails = getSpectralTypeDetails(*spectralType);
             if (referenceDetails == nullptr)
             {
                 GetLogger()->error(_("Invalid star: bad spectral type.\n"));
@@ -1374,12 +1841,57 @@ StarDatabaseBuilder::createOrUpdateStarDetails(Star* star,
     else
         star->setDetails(customDetails.hasCustomDetails ? referenceDetails->clone() : referenceDetails);
 
-    return applyCustomStarDetails(star,
-                                  catalogNumber,
-                                  starData,
-                                  path,
-                                  customDetails,
-                                  barycenterPosition);
+    if (!applyCustomStarDetails(star,
+                                catalogNumber,
+                                starData,
+                                path,
+                                customDetails,
+                                barycenterPosition))
+    {
+        return false;
+    }
+
+    if (customDetails.hasCustomDetails)
+        internStarDetails(star);
+    return true;
+}
+
+
+IntrusivePtr<StarDetails>
+StarDatabaseBuilder::getSpectralTypeDetails(const std::string& spectralType)
+{
+    if (auto it = spectralTypeDetails.find(spectralType); it != spectralTypeDetails.end())
+        return it->second;
+
+    // Bad spectral types are remembered as well, as nullptr
+    auto details = StarDetails::GetStarDetails(StellarClass::parse(spectralType));
+    spectralTypeDetails.try_emplace(spectralType, details);
+    return details;
+}
+
+
+/*! Replace the custom details of a star with those of an earlier star which
+ *  has the same parameters. Add-ons define many stars which only set e.g. a
+ *  radius or a texture, and they would otherwise each keep a copy. Details
+ *  with an orbit belong to their star and aren't shared.
+ */
+void
+StarDatabaseBuilder::internStarDetails(Star* star)
+{
+    const StarDetails* details = star->getDetails();
+    if (details->shared() || details->getOrbit() != nullptr || details->getOrbitBarycenter() != nullptr)
+        return;
+
+    std::string key = makeStarDetailsKey(*details);
+    if (auto it = internedDetails.find(key); it != internedDetails.end())
+    {
+        star->setDetails(IntrusivePtr<StarDetails>(it->second));
+        return;
+    }
+
+    IntrusivePtr<StarDetails> shared(star->getDetails());
+    shared->setShared();
+    internedDetails.try_emplace(std::move(key), std::move(shared));
 }
 
 
@@ -1620,20 +2132,38 @@ void StarDatabaseBuilder::buildOctree()
     // This should only be called once for the database
     // ASSERT(octreeRoot == nullptr);
 
+    std::uint64_t cacheKey = 0;
+    if (!octreeCachePath.empty())
+    {
+        cacheKey = computeOctreeCacheKey();
+        if (readOctreeCache(cacheKey))
+        {
+            unsortedStars.clear();
+            return;
+        }
+    }
+
     GetLogger()->debug("Sorting stars into octree . . .\n");
     float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
                                       STAR_OCTREE_ROOT_SIZE * celestia::numbers::sqrt3_v<float>);
     DynamicStarOctree* root = new DynamicStarOctree(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
                                                     absMag);
-    for (unsigned int i = 0; i < unsortedStars.size(); ++i)
-    {
-        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
-    }
+
+    DynamicStarOctree::ObjectList starList;
+    starList.reserve(unsortedStars.size());
+    unsortedStars.forEach([&starList](Star& star) { starList.push_back(&star); });
+
+    // Small catalogs aren't worth the task overhead
+    unsigned int parallelLevels = 0;
+    if (starList.size() >= PARALLEL_OCTREE_MIN_STARS)
+        parallelLevels = celestia::util::TaskScheduler::get().getConcurrency() > 8 ? 2 : 1;
+    root->insertObjects(std::move(starList), STAR_OCTREE_ROOT_SIZE, parallelLevels);
 
     GetLogger()->debug("Spatially sorting stars for improved locality of reference . . .\n");
     Star* sortedStars    = new Star[starDB->nStars];
     Star* firstStar      = sortedStars;
     root->rebuildAndSort(starDB->octreeRoot, firstStar);
+    starDB->octreeRoot->buildObjectArrays();
 
     // ASSERT((int) (firstStar - sortedStars) == nStars);
     GetLogger()->debug("{} stars total\nOctree has {} nodes and {} stars.\n",
@@ -1661,6 +2191,180 @@ void StarDatabaseBuilder::buildOctree()
     delete root;
 
     starDB->stars = sortedStars;
+
+    if (!octreeCachePath.empty())
+        writeOctreeCache(cacheKey);
+}
+
+
+void
+StarDatabaseBuilder::setOctreeCache(const fs::path& path)
+{
+    octreeCachePath = path;
+}
+
+
+/*! The octree layout depends only on the sequence of stars inserted into it,
+ *  so the cache is keyed by a hash of the properties used by the octree
+ *  predicates, taken in load order. Unlike a key made from file names and
+ *  timestamps, this also catches edits made by add-on catalogs.
+ */
+std::uint64_t
+StarDatabaseBuilder::computeOctreeCacheKey() const
+{
+    // 64-bit FNV-1a
+    std::uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    auto addBytes = [&hash](const void* data, std::size_t size)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= UINT64_C(0x100000001b3);
+        }
+    };
+
+    std::uint32_t nStars = unsortedStars.size();
+    addBytes(&nStars, sizeof(nStars));
+    unsortedStars.forEach([&addBytes](const Star& star)
+    {
+        AstroCatalog::IndexNumber catNo = star.getIndex();
+        Eigen::Vector3f position = star.getPosition();
+        std::array<float, 5> values{ position.x(), position.y(), position.z(),
+                                     star.getAbsoluteMagnitude(), star.getOrbitalRadius() };
+        addBytes(&catNo, sizeof(catNo));
+        addBytes(values.data(), sizeof(values));
+    });
+
+    return hash;
+}
+
+
+bool
+StarDatabaseBuilder::readOctreeCache(std::uint64_t key)
+{
+    using celestia::util::readLE;
+
+    std::ifstream in(octreeCachePath, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    Timer timer{};
+
+    std::array<char, OCTREECACHE_MAGIC.size()> magic;
+    std::uint16_t version;
+    std::uint64_t fileKey;
+    std::uint32_t nStars;
+    std::uint32_t nNodes;
+    if (!in.read(magic.data(), magic.size()).good() || /* Flawfinder: ignore */
+        std::string_view(magic.data(), magic.size()) != OCTREECACHE_MAGIC ||
+        !readLE(in, version) || version != OctreeCacheVersion ||
+        !readLE(in, fileKey) || fileKey != key ||
+        !readLE(in, nStars) || nStars != starDB->nStars ||
+        !readLE(in, nNodes))
+    {
+        GetLogger()->verbose("Star octree cache {} is out of date\n", octreeCachePath);
+        return false;
+    }
+
+    std::vector<StarOctree::Node> nodes;
+    nodes.reserve(std::min(nNodes, nStars));
+    std::uint32_t firstObject = 0;
+    for (std::uint32_t i = 0; i < nNodes; ++i)
+    {
+        StarOctree::Node& node = nodes.emplace_back();
+        if (!readLE(in, node.cellCenterPos.x()) ||
+            !readLE(in, node.cellCenterPos.y()) ||
+            !readLE(in, node.cellCenterPos.z()) ||
+            !readLE(in, node.exclusionFactor) ||
+            !readLE(in, node.nObjects) ||
+            !readLE(in, node.firstChild))
+        {
+            return false;
+        }
+
+        node.firstObject = firstObject;
+        firstObject += node.nObjects;
+    }
+
+    auto sortedStars = std::make_unique<Star[]>(nStars);
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        AstroCatalog::IndexNumber catNo;
+        if (!readLE(in, catNo))
+            return false;
+
+        const Star* star = findWhileLoading(catNo);
+        if (star == nullptr)
+            return false;
+
+        sortedStars[i] = *star;
+    }
+
+    StarOctree* root = StarOctree::create(std::move(nodes), sortedStars.get(), nStars);
+    if (root == nullptr)
+    {
+        GetLogger()->warn(_("Star octree cache {} is corrupt\n"), octreeCachePath);
+        return false;
+    }
+
+    root->buildObjectArrays();
+    starDB->octreeRoot = root;
+    starDB->stars = sortedStars.release();
+
+    GetLogger()->debug("Loaded star octree with {} nodes from cache in {} ms\n", nNodes, timer.getTime());
+    return true;
+}
+
+
+void
+StarDatabaseBuilder::writeOctreeCache(std::uint64_t key) const
+{
+    using celestia::util::writeLE;
+
+    const std::vector<StarOctree::Node>& nodes = starDB->octreeRoot->getNodes();
+
+    // Write to a temporary file first so that concurrently starting
+    // instances never see a partially written cache.
+    fs::path tempPath = octreeCachePath;
+    tempPath += ".tmp";
+
+    std::error_code ec;
+    if (auto parentPath = octreeCachePath.parent_path(); !parentPath.empty())
+        fs::create_directories(parentPath, ec);
+
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        bool ok = out.good() &&
+                  out.write(OCTREECACHE_MAGIC.data(), OCTREECACHE_MAGIC.size()).good() &&
+                  writeLE(out, OctreeCacheVersion) &&
+                  writeLE(out, key) &&
+                  writeLE(out, starDB->nStars) &&
+                  writeLE(out, static_cast<std::uint32_t>(nodes.size()));
+
+        for (auto it = nodes.cbegin(); ok && it != nodes.cend(); ++it)
+        {
+            ok = writeLE(out, it->cellCenterPos.x()) &&
+                 writeLE(out, it->cellCenterPos.y()) &&
+                 writeLE(out, it->cellCenterPos.z()) &&
+                 writeLE(out, it->exclusionFactor) &&
+                 writeLE(out, it->nObjects) &&
+                 writeLE(out, it->firstChild);
+        }
+
+        for (std::uint32_t i = 0; ok && i < starDB->nStars; ++i)
+            ok = writeLE(out, starDB->stars[i].getIndex());
+
+        if (!ok)
+        {
+            GetLogger()->warn(_("Failed to write star octree cache {}\n"), octreeCachePath);
+            return;
+        }
+    }
+
+    fs::rename(tempPath, octreeCachePath, ec);
+    if (ec)
+        GetLogger()->warn(_("Failed to write star octree cache {}\n"), octreeCachePath);
 }
 
 
@@ -10,12 +10,19 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
+#include <limits>
 #include <map>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
@@ -24,14 +31,19 @@
 #include <celcompat/filesystem.h>
 #include <celengine/category.h>
 #include <celengine/parseobject.h>
-#include <celutil/blockarray.h>
+#include <celutil/array_view.h>
+#include <celutil/concurrentblockarray.h>
+#include <celutil/mappedfile.h>
+#include <celutil/memoryaccounting.h>
 #include "astroobj.h"
 #include "hash.h"
+#include "labelnames.h"
 #include "staroctree.h"
 #include "starname.h"
 
 
 class StarNameDatabase;
+class Tokenizer;
 class UserCategory;
 
 
@@ -61,7 +73,9 @@ class StarDatabase
     Star* find(std::string_view, bool i18n) const;
     AstroCatalog::IndexNumber findCatalogNumberByName(std::string_view, bool i18n) const;
 
-    void getCompletion(std::vector<std::string>&, std::string_view) const;
+    void getCompletion(std::vector<std::string>&,
+                       std::string_view,
+                       std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
 
     void findVisibleStars(StarHandler& starHandler,
                           const Eigen::Vector3f& obsPosition,
@@ -70,12 +84,48 @@ class StarDatabase
                           float aspectRatio,
                           float limitingMag) const;
 
+    std::vector<StarOctree::Subtree> findVisibleStarSubtrees(StarHandler& starHandler,
+                                                             const Eigen::Vector3f& obsPosition,
+                                                             const Eigen::Quaternionf& obsOrientation,
+                                                             float fovY,
+                                                             float aspectRatio,
+                                                             float limitingMag,
+                                                             std::size_t minSubtrees) const;
+
+    void findVisibleStarsInSubtree(StarHandler& starHandler,
+                                   const StarOctree::Subtree& subtree,
+                                   const Eigen::Vector3f& obsPosition,
+                                   const Eigen::Quaternionf& obsOrientation,
+                                   float fovY,
+                                   float aspectRatio,
+                                   float limitingMag) const;
+
+    bool findVisibleStarsUntil(StarHandler& starHandler,
+                               StarOctree::Traversal& traversal,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag,
+                               std::chrono::steady_clock::time_point deadline) const;
+
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Return the nStars stars nearest to obsPosition and closer than
+    // maxDistance, nearest first, with their distances. Only stars for
+    // which filter returns true are counted, if it's set.
+    std::vector<std::pair<float, const Star*>> findNearestStars(const Eigen::Vector3f& obsPosition,
+                                                                float maxDistance,
+                                                                std::size_t nStars,
+                                                                const std::function<bool(const Star&)>& filter = {}) const;
+
     std::string getStarName(const Star&, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
+    // Localized name of the star shown in its label, valid as long as the
+    // database
+    std::string_view getStarLabel(const Star&) const;
 
     StarNameDatabase* getNameDatabase() const;
 
@@ -89,7 +139,9 @@ class StarDatabase
         AstroCatalog::IndexNumber celCatalogNumber;
     };
 
-    using CrossIndex = std::vector<CrossIndexEntry>;
+    // Cross index entries sorted by catalog number, stored in the database
+    // or in a mapped star name cache
+    using CrossIndex = celestia::util::array_view<CrossIndexEntry>;
 
     AstroCatalog::IndexNumber searchCrossIndexForCatalogNumber(StarCatalog, AstroCatalog::IndexNumber number) const;
     Star* searchCrossIndex(StarCatalog, AstroCatalog::IndexNumber number) const;
@@ -104,6 +156,10 @@ private:
     StarOctree*                       octreeRoot{ nullptr };
 
     std::vector<CrossIndex> crossIndexes;
+    std::vector<std::vector<CrossIndexEntry>> crossIndexStorage;
+    std::optional<celestia::util::MappedFile> nameCacheFile;
+    celestia::util::MemoryRecord memory{ celestia::util::MemoryTag::Stars };
+    mutable celestia::engine::LabelNames labelNames;
 
     friend class StarDatabaseBuilder;
 };
@@ -138,11 +194,35 @@ class StarDatabaseBuilder
     StarDatabaseBuilder& operator=(StarDatabaseBuilder&&) noexcept = delete;
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    // Load a catalog from text in memory, such as a mapped file
+    bool load(std::string_view, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
+    bool loadBinary(const char* data, std::size_t size);
+    bool loadBinary(const fs::path&);
 
     void setNameDatabase(std::unique_ptr<StarNameDatabase>&&);
     bool loadCrossIndex(StarCatalog, std::istream&);
 
+    // Save the finished octree to path and reuse it on the next load if the
+    // star data is unchanged
+    void setOctreeCache(const fs::path& path);
+
+    // Source files of the star name cache
+    struct NameCacheSources
+    {
+        fs::path starNames;
+        std::array<fs::path, static_cast<std::size_t>(StarCatalog::MaxCatalog)> crossIndexes;
+    };
+
+    // Load the star names and the cross indexes from a cache written by
+    // writeNameCache from the same sources. The cross indexes are used from
+    // the mapped cache where possible. Return false if there's no such cache.
+    bool loadNameCache(const fs::path& path, const NameCacheSources& sources);
+
+    // Save the star names and the cross indexes loaded so far to a cache;
+    // it must be called before loading star catalogs which add names.
+    void writeNameCache(const fs::path& path, const NameCacheSources& sources) const;
+
     std::unique_ptr<StarDatabase> finish();
 
     struct CustomStarDetails;
@@ -167,6 +247,8 @@ class StarDatabaseBuilder
                                    const fs::path& path,
                                    const bool isBarycenter,
                                    std::optional<Eigen::Vector3f>& barycenterPosition);
+    celestia::util::IntrusivePtr<StarDetails> getSpectralTypeDetails(const std::string&);
+    void internStarDetails(Star*);
     bool applyCustomStarDetails(const Star*,
                                 AstroCatalog::IndexNumber,
                                 const Hash*,
@@ -186,7 +268,15 @@ class StarDatabaseBuilder
                      const std::string& name,
                      const std::string& domain);
 
+    bool load(Tokenizer&, const fs::path& resourcePath);
+    bool addBinaryRecords(const char* ptr, std::uint32_t nRecords);
+    void finishBinaryLoad();
+
     void buildOctree();
+    std::uint64_t computeOctreeCacheKey() const;
+    static std::uint64_t computeNameCacheKey(const NameCacheSources&);
+    bool readOctreeCache(std::uint64_t key);
+    void writeOctreeCache(std::uint64_t key) const;
     void buildIndexes();
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
 
@@ -194,11 +284,20 @@ class StarDatabaseBuilder
 
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
-    BlockArray<Star> unsortedStars{ };
+    // Large enough for the biggest catalogs, 65 million stars
+    ConcurrentBlockArray<Star> unsortedStars{ 1000, 65536 };
     // List of stars loaded from binary file, sorted by catalog number
     std::vector<Star*> binFileCatalogNumberIndex{ nullptr };
     // Catalog number -> star mapping for stars loaded from stc files
     std::map<AstroCatalog::IndexNumber, Star*> stcFileCatalogNumberIndex{};
     std::vector<BarycenterUsage> barycenters{};
     std::multimap<AstroCatalog::IndexNumber, UserCategoryId> categories{};
+    fs::path octreeCachePath{ };
+
+    // Catalogs use few distinct spectral types, so the details of each one
+    // are only parsed and looked up once
+    std::unordered_map<std::string, celestia::util::IntrusivePtr<StarDetails>> spectralTypeDetails{};
+    // Custom details without an orbit, keyed by their parameters, shared by
+    // all stars which have the same ones
+    std::unordered_map<std::string, celestia::util::IntrusivePtr<StarDetails>> internedDetails{};
 };
@@ -0,0 +1,255 @@
+// starfieldcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starfieldcache.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
+#include <celutil/array_view.h>
+#include "framebuffer.h"
+#include "render.h"
+#include "shadermanager.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr int TilesPerRow = 3;
+constexpr int TileRows = 2;
+
+// Quads along the side of a face; the lens of the fisheye projection is
+// applied per vertex
+constexpr int FaceSubdivisions = 16;
+
+// Largest parallax of a star at NearStarDistance, in texels at the center
+// of a face, before the faces are rendered again
+constexpr double MaxParallaxInTexels = 0.5;
+
+struct FaceVertex
+{
+    Eigen::Vector3f position;
+    Eigen::Vector2f texCoord;
+};
+
+// View direction and up vector of each face
+const Eigen::Vector3d FaceDirections[StarFieldCache::Faces][2] =
+{
+    { Eigen::Vector3d::UnitX(),  Eigen::Vector3d::UnitY() },
+    { -Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitY() },
+    { Eigen::Vector3d::UnitY(),  -Eigen::Vector3d::UnitZ() },
+    { -Eigen::Vector3d::UnitY(), Eigen::Vector3d::UnitZ() },
+    { Eigen::Vector3d::UnitZ(),  Eigen::Vector3d::UnitY() },
+    { -Eigen::Vector3d::UnitZ(), Eigen::Vector3d::UnitY() },
+};
+
+} // end unnamed namespace
+
+
+bool
+StarFieldCache::Settings::operator==(const Settings& other) const
+{
+    return faintestMag == other.faintestMag &&
+           saturationPoint == other.saturationPoint &&
+           brightnessScale == other.brightnessScale &&
+           renderFlags == other.renderFlags &&
+           starStyle == other.starStyle &&
+           stars == other.stars &&
+           dsos == other.dsos;
+}
+
+
+StarFieldCache::StarFieldCache(unsigned int _faceSize) :
+    faceSize(_faceSize)
+{
+    fbo = std::make_unique<FramebufferObject>(faceSize * TilesPerRow, faceSize * TileRows,
+                                              FramebufferObject::ColorAttachment);
+}
+
+
+StarFieldCache::~StarFieldCache() = default;
+
+
+bool
+StarFieldCache::isValid() const
+{
+    return fbo->isValid();
+}
+
+
+double
+StarFieldCache::maxDisplacement() const
+{
+    // A texel at the center of a face spans 2 / faceSize radians
+    return static_cast<double>(NearStarDistance) * MaxParallaxInTexels * 2.0 / static_cast<double>(faceSize);
+}
+
+
+StarFieldCache::Action
+StarFieldCache::update(const Eigen::Vector3d& position, const Settings& settings)
+{
+    bool stable = settings == lastSettings && (position - lastPosition).norm() < maxDisplacement();
+    lastSettings = settings;
+    lastPosition = position;
+
+    if (captured && settings == capturedSettings && (position - capturedPosition).norm() < maxDisplacement())
+        return Action::Draw;
+
+    // Rendering six faces every frame would cost more than it saves
+    if (!stable)
+    {
+        captured = false;
+        return Action::Skip;
+    }
+
+    captured = true;
+    capturedSettings = settings;
+    capturedPosition = position;
+    return Action::Capture;
+}
+
+
+Eigen::Quaterniond
+StarFieldCache::getFaceOrientation(int face)
+{
+    const Eigen::Vector3d& direction = FaceDirections[face][0];
+    const Eigen::Vector3d& up = FaceDirections[face][1];
+
+    // Rows are the axes of the camera, which looks down its -z axis
+    Eigen::Matrix3d m;
+    m.row(0) = direction.cross(up);
+    m.row(1) = up;
+    m.row(2) = -direction;
+    return Eigen::Quaterniond(m);
+}
+
+
+GLint
+StarFieldCache::bindFace(int face)
+{
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    fbo->bind();
+
+    auto size = static_cast<GLsizei>(faceSize);
+    GLint x = (face % TilesPerRow) * size;
+    GLint y = (face / TilesPerRow) * size;
+    glViewport(x, y, size, size);
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, size, size);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    return oldFboId;
+}
+
+
+void
+StarFieldCache::unbind(GLint oldFboId)
+{
+    fbo->unbind(oldFboId);
+}
+
+
+void
+StarFieldCache::createMesh()
+{
+    std::vector<FaceVertex> vertices;
+    vertices.reserve(Faces * FaceSubdivisions * FaceSubdivisions * 6);
+
+    // Keep the texture coordinates half a texel inside the tile of a face
+    // so that filtering doesn't sample the neighboring tiles
+    auto size = static_cast<float>(faceSize);
+    float scale = (size - 1.0f) / size;
+
+    for (int face = 0; face < Faces; face++)
+    {
+        Eigen::Matrix3f toWorld = getFaceOrientation(face).conjugate().toRotationMatrix().cast<float>();
+        Eigen::Vector2f tileOrigin(static_cast<float>(face % TilesPerRow), static_cast<float>(face / TilesPerRow));
+
+        auto vertex = [&](int i, int j)
+        {
+            Eigen::Vector2f p(2.0f * static_cast<float>(i) / static_cast<float>(FaceSubdivisions) - 1.0f,
+                              2.0f * static_cast<float>(j) / static_cast<float>(FaceSubdivisions) - 1.0f);
+            Eigen::Vector2f uv = tileOrigin + Eigen::Vector2f::Constant(0.5f) + p * (0.5f * scale);
+            return FaceVertex
+            {
+                toWorld * Eigen::Vector3f(p.x(), p.y(), -1.0f),
+                uv.cwiseQuotient(Eigen::Vector2f(static_cast<float>(TilesPerRow), static_cast<float>(TileRows))),
+            };
+        };
+
+        for (int j = 0; j < FaceSubdivisions; j++)
+        {
+            for (int i = 0; i < FaceSubdivisions; i++)
+            {
+                FaceVertex v0 = vertex(i, j);
+                FaceVertex v1 = vertex(i + 1, j);
+                FaceVertex v2 = vertex(i + 1, j + 1);
+                FaceVertex v3 = vertex(i, j + 1);
+                vertices.insert(vertices.end(), { v0, v1, v2, v0, v2, v3 });
+            }
+        }
+    }
+
+    vertexCount = static_cast<int>(vertices.size());
+    bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, util::array_view<FaceVertex>(vertices));
+    vo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Triangles);
+    vo->addVertexBuffer(*bo,
+                        CelestiaGLProgram::VertexCoordAttributeIndex,
+                        3,
+                        gl::VertexObject::DataType::Float,
+                        false,
+                        sizeof(FaceVertex),
+                        offsetof(FaceVertex, position));
+    vo->addVertexBuffer(*bo,
+                        CelestiaGLProgram::TextureCoord0AttributeIndex,
+                        2,
+                        gl::VertexObject::DataType::Float,
+                        false,
+                        sizeof(FaceVertex),
+                        offsetof(FaceVertex, texCoord));
+}
+
+
+void
+StarFieldCache::render(Renderer& renderer,
+                       const Eigen::Matrix4f& projection,
+                       const Eigen::Matrix4f& modelView)
+{
+    auto *prog = renderer.getShaderManager().getShader("starfield");
+    if (prog == nullptr)
+        return;
+
+    if (vo == nullptr)
+        createMesh();
+
+    // The faces were rendered with additive blending on black
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_ONE, GL_ONE};
+    renderer.setPipelineState(ps);
+
+    gl::activeTexture(GL_TEXTURE0);
+    gl::bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+
+    prog->use();
+    prog->setMVPMatrices(projection, modelView);
+    prog->samplerParam("starFieldTex") = 0;
+
+    vo->draw(vertexCount);
+}
+
+} // end namespace celestia::engine
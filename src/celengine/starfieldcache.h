@@ -0,0 +1,120 @@
+// starfieldcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/glsupport.h>
+
+class FramebufferObject;
+class Renderer;
+
+namespace celestia::gl
+{
+class Buffer;
+class VertexObject;
+}
+
+namespace celestia::engine
+{
+
+/*! The distant stars and deep sky objects rendered on the six faces of a
+ *  cube around the observer, kept in a single texture of 3x2 tiles. While
+ *  the observer moves less than what would produce a visible parallax of
+ *  the closest cached star, the faces are drawn instead of traversing the
+ *  catalogs. Stars closer than NearStarDistance are left out of the faces
+ *  and rendered every frame.
+ */
+class StarFieldCache
+{
+public:
+    static constexpr int Faces = 6;
+
+    // Distance in light years below which stars aren't cached; it must be
+    // at least the largest SolarSystemMaxDistance
+    static constexpr float NearStarDistance = 10.0f;
+
+    // Settings the appearance of the cached objects depends on
+    struct Settings
+    {
+        float faintestMag{ 0.0f };
+        float saturationPoint{ 0.0f };
+        float brightnessScale{ 0.0f };
+        std::uint64_t renderFlags{ 0 };
+        int starStyle{ 0 };
+        const void* stars{ nullptr };
+        const void* dsos{ nullptr };
+
+        bool operator==(const Settings&) const;
+        bool operator!=(const Settings& other) const { return !(*this == other); }
+    };
+
+    enum class Action
+    {
+        // The faces are up to date and can be drawn
+        Draw,
+        // The faces must be rendered again before they're drawn
+        Capture,
+        // The settings or the position change every frame, the objects
+        // should be rendered directly
+        Skip,
+    };
+
+    explicit StarFieldCache(unsigned int faceSize);
+    ~StarFieldCache();
+
+    StarFieldCache(const StarFieldCache&) = delete;
+    StarFieldCache& operator=(const StarFieldCache&) = delete;
+
+    bool isValid() const;
+    unsigned int getFaceSize() const { return faceSize; }
+
+    // Decide how the field is drawn in this frame for an observer at
+    // position, in light years
+    Action update(const Eigen::Vector3d& position, const Settings& settings);
+    // Render the faces again before they're drawn next
+    void invalidate() { captured = false; }
+
+    // Orientation of a camera looking at the center of a face with a 90
+    // degree field of view
+    static Eigen::Quaterniond getFaceOrientation(int face);
+
+    // Bind the framebuffer, set the viewport to a face and clear it.
+    // Return the framebuffer bound before.
+    GLint bindFace(int face);
+    void unbind(GLint oldFboId);
+
+    // Draw the faces around a camera at the origin of the model view matrix
+    void render(Renderer& renderer,
+                const Eigen::Matrix4f& projection,
+                const Eigen::Matrix4f& modelView);
+
+private:
+    double maxDisplacement() const;
+    void createMesh();
+
+    std::unique_ptr<FramebufferObject> fbo;
+    std::unique_ptr<gl::Buffer> bo;
+    std::unique_ptr<gl::VertexObject> vo;
+    unsigned int faceSize;
+    int vertexCount{ 0 };
+
+    bool captured{ false };
+    Eigen::Vector3d capturedPosition{ Eigen::Vector3d::Zero() };
+    Settings capturedSettings{ };
+    Eigen::Vector3d lastPosition{ Eigen::Vector3d::Zero() };
+    Settings lastSettings{ };
+};
+
+} // end namespace celestia::engine
@@ -12,10 +12,113 @@
 
 #pragma once
 
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Core>
+
 #include <celengine/star.h>
 #include <celengine/octree.h>
 
 
+// The octree node into which a star is placed is dependent on two properties:
+// its obsPosition and its luminosity--the fainter the star, the deeper the node
+// in which it will reside.  Each node stores an absolute magnitude; no child
+// of the node is allowed contain a star brighter than this value, making it
+// possible to determine quickly whether or not to cull subtrees.
+template <> struct OctreeTraits<Star, float>
+{
+    using PointType = Eigen::Vector3f;
+
+    // In testing, changing SplitThreshold from 100 to 50 nearly
+    // doubled the number of nodes in the tree, but provided only between a
+    // 0 to 5 percent frame rate improvement.
+    static constexpr unsigned int SplitThreshold = 75;
+
+    // Maximum permitted orbital radius for stars, in light years. Orbital
+    // radii larger than this value are not guaranteed to give correct
+    // results. The problem case is extremely faint stars (such as brown
+    // dwarfs.) The distance from the viewer to star's barycenter is used
+    // rough estimate of the brightness for the purpose of culling. When the
+    // star is very faint, this estimate may not work when the star is
+    // far from the barycenter. Thus, the star octree traversal will always
+    // render stars with orbits that are closer than MaxStarOrbitRadius.
+    static constexpr float MaxStarOrbitRadius = 1.0f;
+
+    static bool  limitingFactorPredicate(const Star& star, float absMag);
+    static bool  straddlingPredicate(const PointType& cellCenterPos, const Star& star);
+    static float decayFunction(float excludingFactor);
+
+    static PointType getPosition(const Star& star) { return star.getPosition(); }
+
+    template <class PROCESSOR>
+    static void processVisibleObjects(const OctreeNodeObjects<Star, float>&                objects,
+                                      PROCESSOR&                                           processor,
+                                      const celestia::engine::OctreeFrustumCuller<float>& culler,
+                                      float                                                dimmest);
+
+    template <class PROCESSOR>
+    static void processCloseObjects(const OctreeNodeObjects<Star, float>& objects,
+                                    PROCESSOR&                            processor,
+                                    const PointType&                      obsPosition,
+                                    float                                 boundingRadius);
+};
+
+
 typedef DynamicOctree  <Star, float> DynamicStarOctree;
 typedef StaticOctree   <Star, float> StarOctree;
 typedef OctreeProcessor<Star, float> StarHandler;
+
+
+// Most of the objects of a node are usually too faint, so test the
+// magnitudes and positions from the object arrays and only access the stars
+// themselves when they may be visible.
+template <class PROCESSOR>
+inline void
+OctreeTraits<Star, float>::processVisibleObjects(const OctreeNodeObjects<Star, float>&                objects,
+                                                 PROCESSOR&                                           processor,
+                                                 const celestia::engine::OctreeFrustumCuller<float>& culler,
+                                                 float                                                dimmest)
+{
+    assert(objects.x != nullptr || objects.count == 0);
+    const Eigen::Vector3f& obsPosition = culler.obsPosition();
+    float limitingFactor = culler.limitingFactor();
+    for (std::uint32_t i = 0; i < objects.count; ++i)
+    {
+        if (objects.limitingFactor[i] >= dimmest)
+            continue;
+
+        float distance = (obsPosition - Eigen::Vector3f(objects.x[i], objects.y[i], objects.z[i])).norm();
+        const Star& obj = objects.objects[i];
+        float appMag = obj.getApparentMagnitude(distance);
+
+        if (appMag < limitingFactor || (distance < MaxStarOrbitRadius && obj.getOrbit()))
+            processor.process(obj, distance, appMag);
+    }
+}
+
+
+template <class PROCESSOR>
+inline void
+OctreeTraits<Star, float>::processCloseObjects(const OctreeNodeObjects<Star, float>& objects,
+                                               PROCESSOR&                            processor,
+                                               const PointType&                      obsPosition,
+                                               float                                 boundingRadius)
+{
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    float radiusSquared = boundingRadius * boundingRadius;
+    for (std::uint32_t i = 0; i < objects.count; ++i)
+    {
+        float distanceSquared = (obsPosition - Eigen::Vector3f(objects.x[i], objects.y[i], objects.z[i])).squaredNorm();
+        if (distanceSquared < radiusSquared)
+        {
+            const Star& obj   = objects.objects[i];
+            float distance    = std::sqrt(distanceSquared);
+            float appMag      = obj.getApparentMagnitude(distance);
+
+            processor.process(obj, distance, appMag);
+        }
+    }
+}
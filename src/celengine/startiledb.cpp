@@ -0,0 +1,602 @@
+// startiledb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Star catalogs too large for memory, paged in tiles of the star octree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "startiledb.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <celcompat/numbers.h>
+#include <celutil/binaryread.h>
+#include <celutil/bytes.h>
+#include <celutil/gettext.h>
+#include <celutil/intrusiveptr.h>
+#include <celutil/logger.h>
+#include "octreeculling.h"
+#include "stellarclass.h"
+
+using celestia::util::GetLogger;
+using celestia::util::IntrusivePtr;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Read little-endian values from tile data
+template<typename T>
+T decodeLE(const char* src);
+
+template<>
+float
+decodeLE<float>(const char* src)
+{
+    float value;
+    std::memcpy(&value, src, sizeof(float));
+    LE_TO_CPU_FLOAT(value, value);
+    return value;
+}
+
+template<>
+std::uint32_t
+decodeLE<std::uint32_t>(const char* src)
+{
+    std::uint32_t value;
+    std::memcpy(&value, src, sizeof(value));
+    LE_TO_CPU_INT32(value, value);
+    return value;
+}
+
+template<>
+std::uint16_t
+decodeLE<std::uint16_t>(const char* src)
+{
+    std::uint16_t value;
+    std::memcpy(&value, src, sizeof(value));
+    LE_TO_CPU_INT16(value, value);
+    return value;
+}
+
+template<>
+std::int16_t
+decodeLE<std::int16_t>(const char* src)
+{
+    std::int16_t value;
+    std::memcpy(&value, src, sizeof(value));
+    LE_TO_CPU_INT16(value, value);
+    return value;
+}
+
+// Read a varint, advancing ptr; false if it runs past end
+bool
+decodeVarint(const char*& ptr, const char* end, std::uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (ptr == end)
+            return false;
+        auto byte = static_cast<std::uint8_t>(*ptr++);
+        value |= static_cast<std::uint64_t>(byte & 0x7fU) << shift;
+        if ((byte & 0x80U) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+
+std::int32_t
+decodeInt24LE(const char* src)
+{
+    auto value = static_cast<std::uint32_t>(static_cast<std::uint8_t>(src[0])) |
+                 static_cast<std::uint32_t>(static_cast<std::uint8_t>(src[1])) << 8 |
+                 static_cast<std::uint32_t>(static_cast<std::uint8_t>(src[2])) << 16;
+    // Sign extend
+    return static_cast<std::int32_t>(value ^ 0x800000U) - 0x800000;
+}
+
+
+// Look up the details of a spectral type, reusing the last ones for runs of
+// stars of the same type
+bool
+getDetails(std::uint16_t spectralType,
+           std::uint16_t& lastSpectralType,
+           IntrusivePtr<StarDetails>& lastDetails)
+{
+    if (lastDetails != nullptr && spectralType == lastSpectralType)
+        return true;
+
+    StellarClass sc;
+    lastDetails = sc.unpackV1(spectralType) ? StarDetails::GetStarDetails(sc) : nullptr;
+    lastSpectralType = spectralType;
+    return lastDetails != nullptr;
+}
+
+} // end unnamed namespace
+
+
+StarTileDatabase::StarTileDatabase(std::size_t memoryBudget) :
+    m_memoryBudget(memoryBudget)
+{
+}
+
+
+StarTileDatabase::~StarTileDatabase()
+{
+    if (m_loader.joinable())
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_loader.join();
+    }
+}
+
+
+std::unique_ptr<StarTileDatabase>
+StarTileDatabase::open(const fs::path& path, std::size_t memoryBudget)
+{
+    std::unique_ptr<StarTileDatabase> db(new StarTileDatabase(memoryBudget));
+    db->m_file.open(path, std::ios::in | std::ios::binary);
+    if (!db->m_file.good())
+    {
+        GetLogger()->error(_("Error opening star tiles {}\n"), path);
+        return nullptr;
+    }
+
+    if (!db->readDirectory(db->m_file))
+    {
+        GetLogger()->error(_("Bad star tile file {}\n"), path);
+        return nullptr;
+    }
+
+    // The root tile with the brightest stars is always resident
+    Tile& root = db->m_tiles.front();
+    std::vector<char> data(root.size);
+    db->m_file.seekg(static_cast<std::streamoff>(root.offset));
+    if (!db->m_file.read(data.data(), static_cast<std::streamsize>(data.size())).good() || /* Flawfinder: ignore */
+        !db->decode(root, data))
+    {
+        GetLogger()->error(_("Bad star tile file {}\n"), path);
+        return nullptr;
+    }
+
+    db->m_residentBytes = db->tileBytes(root);
+    db->m_residentCount = 1;
+    db->m_loader = std::thread(&StarTileDatabase::loadTiles, db.get());
+
+    GetLogger()->info(_("{} star tiles in {}\n"), db->m_tiles.size(), path);
+    return db;
+}
+
+
+bool
+StarTileDatabase::readDirectory(std::istream& in)
+{
+    using celestia::util::readLE;
+
+    in.seekg(0, std::ios::end);
+    auto fileSize = static_cast<std::uint64_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    std::array<char, Magic.size()> magic;
+    std::uint16_t version;
+    std::uint16_t levelsPerTile;
+    std::uint32_t nTiles;
+    Eigen::Vector3f rootCenter;
+    float rootScale;
+    if (!in.read(magic.data(), magic.size()).good() || /* Flawfinder: ignore */
+        std::string_view(magic.data(), magic.size()) != Magic ||
+        !readLE(in, version) || (version != Version && version != Version1) ||
+        !readLE(in, levelsPerTile) ||
+        !readLE(in, nTiles) || nTiles == 0 ||
+        !readLE(in, rootCenter.x()) || !readLE(in, rootCenter.y()) || !readLE(in, rootCenter.z()) ||
+        !readLE(in, rootScale) ||
+        fileSize < HeaderSize + static_cast<std::uint64_t>(nTiles) * (version == Version ? TileEntrySize : TileEntrySizeV1))
+    {
+        return false;
+    }
+
+    m_version = version;
+
+    m_tiles.resize(nTiles);
+    for (std::uint32_t i = 0; i < nTiles; ++i)
+    {
+        Tile& tile = m_tiles[i];
+        if (!readLE(in, tile.center.x()) || !readLE(in, tile.center.y()) || !readLE(in, tile.center.z()) ||
+            !readLE(in, tile.scale) ||
+            !readLE(in, tile.parentExclusion) ||
+            !readLE(in, tile.firstChild) ||
+            !readLE(in, tile.nChildren) ||
+            !readLE(in, tile.nNodes) ||
+            !readLE(in, tile.nStars) ||
+            !readLE(in, tile.offset) ||
+            (version == Version && !readLE(in, tile.size)))
+        {
+            return false;
+        }
+
+        // Children follow their parent, so the tiles form a tree
+        if (tile.nChildren > 0 && (tile.firstChild <= i || tile.firstChild >= nTiles ||
+                                   tile.nChildren > nTiles - tile.firstChild))
+            return false;
+
+        if (version == Version1)
+        {
+            std::uint64_t size = static_cast<std::uint64_t>(tile.nNodes) * NodeRecordSize +
+                                 static_cast<std::uint64_t>(tile.nStars) * StarRecordSize;
+            if (size > UINT32_MAX)
+                return false;
+            tile.size = static_cast<std::uint32_t>(size);
+        }
+
+        if (tile.offset > fileSize || tile.size > fileSize - tile.offset || (tile.nNodes == 0) != (tile.nStars == 0) ||
+            tile.size < static_cast<std::uint64_t>(tile.nNodes) * NodeRecordSize)
+        {
+            return false;
+        }
+    }
+
+    return m_tiles.front().center == rootCenter && m_tiles.front().scale == rootScale;
+}
+
+
+bool
+StarTileDatabase::decode(Tile& tile, const std::vector<char>& data) const
+{
+    auto resident = std::make_unique<Resident>();
+    if (tile.nNodes == 0)
+    {
+        tile.resident = std::move(resident);
+        return true;
+    }
+
+    if (data.size() != tile.size)
+        return false;
+
+    const char* ptr = data.data();
+    std::vector<StarOctree::Node> nodes(tile.nNodes);
+    std::uint32_t firstObject = 0;
+    for (StarOctree::Node& node : nodes)
+    {
+        node.cellCenterPos = Eigen::Vector3f(decodeLE<float>(ptr), decodeLE<float>(ptr + 4), decodeLE<float>(ptr + 8));
+        node.exclusionFactor = decodeLE<float>(ptr + 12);
+        node.nObjects = decodeLE<std::uint32_t>(ptr + 16);
+        node.firstChild = decodeLE<std::uint32_t>(ptr + 20);
+        node.firstObject = firstObject;
+        if (node.nObjects > tile.nStars - firstObject)
+            return false;
+        firstObject += node.nObjects;
+        ptr += NodeRecordSize;
+    }
+
+    if (firstObject != tile.nStars)
+        return false;
+
+    resident->stars = std::make_unique<Star[]>(tile.nStars);
+    bool decoded = m_version == Version1
+        ? decodeStarsV1(tile, ptr, resident->stars.get())
+        : decodeStars(tile, nodes, ptr, data.data() + data.size(), resident->stars.get());
+    if (!decoded)
+        return false;
+
+    resident->octree.reset(StarOctree::create(std::move(nodes), resident->stars.get(), tile.nStars));
+    if (resident->octree == nullptr)
+        return false;
+
+    resident->octree->buildObjectArrays();
+    tile.resident = std::move(resident);
+    return true;
+}
+
+
+bool
+StarTileDatabase::decodeStars(const Tile& tile,
+                              const std::vector<StarOctree::Node>& nodes,
+                              const char* ptr,
+                              const char* end,
+                              Star* stars) const
+{
+    // The half-sizes of the nodes follow from their depth, as the children
+    // of a node come after it
+    std::vector<float> scales(nodes.size(), 0.0f);
+    scales.front() = tile.scale;
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        std::uint32_t firstChild = nodes[i].firstChild;
+        if (firstChild == StarOctree::NoChildren)
+            continue;
+        if (firstChild <= i || firstChild > nodes.size() - 8)
+            return false;
+        std::fill_n(scales.begin() + firstChild, 8, scales[i] * 0.5f);
+    }
+
+    std::uint32_t catalogNumber = 0;
+    std::uint16_t lastSpectralType = 0;
+    IntrusivePtr<StarDetails> lastDetails = nullptr;
+    for (std::size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+        const StarOctree::Node& node = nodes[nodeIndex];
+        bool quantized = isQuantized(node.cellCenterPos, scales[nodeIndex]);
+        float step = scales[nodeIndex] / static_cast<float>(QuantizationScale);
+        std::size_t positionSize = quantized ? 9 : 12;
+
+        for (std::uint32_t i = node.firstObject; i < node.firstObject + node.nObjects; ++i)
+        {
+            std::uint64_t header;
+            if (!decodeVarint(ptr, end, header))
+                return false;
+
+            std::uint64_t zigzag = header >> 1;
+            auto delta = static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1U);
+            catalogNumber = static_cast<std::uint32_t>(static_cast<std::int64_t>(catalogNumber) + delta);
+
+            std::uint16_t spectralType = lastSpectralType;
+            if ((header & 1U) != 0)
+            {
+                if (end - ptr < 2)
+                    return false;
+                spectralType = decodeLE<std::uint16_t>(ptr);
+                ptr += 2;
+            }
+            else if (lastDetails == nullptr)
+            {
+                return false;
+            }
+
+            if (!getDetails(spectralType, lastSpectralType, lastDetails) ||
+                static_cast<std::size_t>(end - ptr) < positionSize + 2)
+            {
+                return false;
+            }
+
+            Star& star = stars[i];
+            star.setIndex(catalogNumber);
+            if (quantized)
+            {
+                star.setPosition(node.cellCenterPos + step * Eigen::Vector3f(static_cast<float>(decodeInt24LE(ptr)),
+                                                                             static_cast<float>(decodeInt24LE(ptr + 3)),
+                                                                             static_cast<float>(decodeInt24LE(ptr + 6))));
+            }
+            else
+            {
+                star.setPosition(decodeLE<float>(ptr), decodeLE<float>(ptr + 4), decodeLE<float>(ptr + 8));
+            }
+            ptr += positionSize;
+            star.setAbsoluteMagnitude(static_cast<float>(decodeLE<std::int16_t>(ptr)) / 256.0f);
+            ptr += 2;
+            star.setDetails(IntrusivePtr<StarDetails>(lastDetails));
+        }
+    }
+
+    return ptr == end;
+}
+
+
+bool
+StarTileDatabase::decodeStarsV1(const Tile& tile, const char* ptr, Star* stars) const
+{
+    // Runs of stars often share a spectral type, as in stars.dat
+    std::uint16_t lastSpectralType = 0;
+    IntrusivePtr<StarDetails> lastDetails = nullptr;
+    for (std::uint32_t i = 0; i < tile.nStars; ++i, ptr += StarRecordSize)
+    {
+        if (!getDetails(decodeLE<std::uint16_t>(ptr + 18), lastSpectralType, lastDetails))
+            return false;
+
+        Star& star = stars[i];
+        star.setIndex(decodeLE<std::uint32_t>(ptr));
+        star.setPosition(decodeLE<float>(ptr + 4), decodeLE<float>(ptr + 8), decodeLE<float>(ptr + 12));
+        star.setAbsoluteMagnitude(static_cast<float>(decodeLE<std::int16_t>(ptr + 16)) / 256.0f);
+        star.setDetails(IntrusivePtr<StarDetails>(lastDetails));
+    }
+
+    return true;
+}
+
+
+std::size_t
+StarTileDatabase::tileBytes(const Tile& tile) const
+{
+    // The stars, their object arrays and the nodes
+    return static_cast<std::size_t>(tile.nStars) * (sizeof(Star) + 4 * sizeof(float)) +
+           static_cast<std::size_t>(tile.nNodes) * sizeof(StarOctree::Node);
+}
+
+
+bool
+StarTileDatabase::update()
+{
+    ++m_frame;
+
+    std::vector<TileData> loaded;
+    {
+        std::scoped_lock lock(m_mutex);
+        loaded.swap(m_loaded);
+
+        // Forget the requests of tiles which went out of view before the
+        // loader reached them
+        auto stale = std::remove_if(m_requests.begin(), m_requests.end(),
+                                    [this](std::uint32_t index) { return m_tiles[index].lastUsed + 1 < m_frame; });
+        for (auto it = stale; it != m_requests.end(); ++it)
+            m_tiles[*it].requested = false;
+        m_requests.erase(stale, m_requests.end());
+    }
+
+    bool changed = false;
+    for (const TileData& tileData : loaded)
+    {
+        Tile& tile = m_tiles[tileData.tile];
+
+        // Failed tiles stay requested so that they aren't read again
+        if (!decode(tile, tileData.data))
+        {
+            GetLogger()->warn(_("Bad star tile {}\n"), tileData.tile);
+            continue;
+        }
+
+        tile.requested = false;
+        m_residentBytes += tileBytes(tile);
+        ++m_residentCount;
+        changed = true;
+    }
+
+    if (m_memoryBudget > 0 && m_residentBytes > m_memoryBudget)
+        changed = evict() || changed;
+
+    return changed;
+}
+
+
+bool
+StarTileDatabase::evict()
+{
+    // Tiles used in the last frame are kept even above the budget, as they
+    // would be requested again right away
+    std::vector<std::uint32_t> candidates;
+    for (std::uint32_t i = 1; i < m_tiles.size(); ++i)
+    {
+        if (m_tiles[i].resident != nullptr && m_tiles[i].lastUsed + 1 < m_frame)
+            candidates.push_back(i);
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [this](std::uint32_t a, std::uint32_t b) { return m_tiles[a].lastUsed < m_tiles[b].lastUsed; });
+
+    bool evicted = false;
+    for (std::uint32_t index : candidates)
+    {
+        if (m_residentBytes <= m_memoryBudget)
+            break;
+
+        Tile& tile = m_tiles[index];
+        tile.resident.reset();
+        m_residentBytes -= tileBytes(tile);
+        --m_residentCount;
+        evicted = true;
+    }
+
+    return evicted;
+}
+
+
+void
+StarTileDatabase::setMemoryBudget(std::size_t budget)
+{
+    m_memoryBudget = budget;
+}
+
+
+void
+StarTileDatabase::findVisibleStars(StarHandler& starHandler,
+                                   const Eigen::Vector3f& obsPosition,
+                                   const Eigen::Quaternionf& obsOrientation,
+                                   float fovY,
+                                   float aspectRatio,
+                                   float limitingMag)
+{
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+
+    OctreeFrustumCuller<float> culler(frustumPlanes.data(), obsPosition, limitingMag);
+    const Tile& root = m_tiles.front();
+    if (culler.isVisible(root.center, root.scale))
+        processTile(0, starHandler, culler, frustumPlanes.data());
+}
+
+
+void
+StarTileDatabase::processTile(std::uint32_t index,
+                              StarHandler& starHandler,
+                              const OctreeFrustumCuller<float>& culler,
+                              const Eigen::Hyperplane<float, 3>* frustumPlanes)
+{
+    Tile& tile = m_tiles[index];
+    tile.lastUsed = m_frame;
+    if (tile.resident != nullptr)
+    {
+        if (tile.resident->octree != nullptr)
+        {
+            tile.resident->octree->processVisibleObjects(starHandler,
+                                                         culler.obsPosition(),
+                                                         frustumPlanes,
+                                                         culler.limitingFactor(),
+                                                         tile.scale);
+        }
+    }
+    else if (!tile.requested)
+    {
+        tile.requested = true;
+        {
+            std::scoped_lock lock(m_mutex);
+            m_requests.push_back(index);
+        }
+        m_condition.notify_one();
+    }
+
+    // The children are needed even while this tile is loading, so that
+    // their loads overlap
+    for (std::uint32_t i = tile.firstChild; i < tile.firstChild + tile.nChildren; ++i)
+    {
+        const Tile& child = m_tiles[i];
+        if (!culler.isVisible(child.center, child.scale))
+            continue;
+
+        float minDistance = (culler.obsPosition() - child.center).norm() - child.scale * celestia::numbers::sqrt3_v<float>;
+        if (child.parentExclusion > culler.dimmestVisible(minDistance))
+            continue;
+
+        processTile(i, starHandler, culler, frustumPlanes);
+    }
+}
+
+
+void
+StarTileDatabase::loadTiles()
+{
+    for (;;)
+    {
+        std::uint32_t index;
+        std::uint64_t offset;
+        std::size_t size;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_requests.empty(); });
+            if (m_stop)
+                return;
+
+            index = m_requests.front();
+            m_requests.pop_front();
+            const Tile& tile = m_tiles[index];
+            offset = tile.offset;
+            size = tile.size;
+        }
+
+        // Only this thread reads the file after open()
+        TileData tileData{ index, std::vector<char>(size) };
+        m_file.clear();
+        m_file.seekg(static_cast<std::streamoff>(offset));
+        if (!m_file.read(tileData.data.data(), static_cast<std::streamsize>(size)).good()) /* Flawfinder: ignore */
+            tileData.data.clear();
+
+        std::scoped_lock lock(m_mutex);
+        m_loaded.push_back(std::move(tileData));
+    }
+}
+
+} // end namespace celestia::engine
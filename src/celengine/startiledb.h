@@ -0,0 +1,189 @@
+// startiledb.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Star catalogs too large for memory, paged in tiles of the star octree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celcompat/filesystem.h>
+#include "staroctree.h"
+
+namespace celestia::engine
+{
+
+/*! A star catalog stored as a hierarchy of octree tiles, written by the
+ *  makestartiles tool. Each tile holds the stars of one octree cell within
+ *  a band of octree levels as a small octree of its own; its child tiles
+ *  cover the eight sub-cells a few levels deeper, which contain only
+ *  fainter stars. The root tile with the brightest stars stays resident.
+ *  The other tiles are read on a loader thread when a traversal reaches
+ *  them and released, least recently used first, when the memory budget is
+ *  exceeded, so only the stars around the observer need to be in memory.
+ *
+ *  Until a tile is loaded its stars are missing from the traversal. The
+ *  stars of the tiles are only meant for rendering: they may be released
+ *  after any call to update(), so they must not be selected or otherwise
+ *  referred to across frames.
+ *
+ *  File layout, all values little-endian:
+ *      header: "CELTILES", u16 version, u16 levels per tile, u32 tile count,
+ *              f32 root center x, y, z, f32 root half-size
+ *      tiles:  f32 center x, y, z, f32 half-size, f32 parent exclusion,
+ *              u32 first child, u32 child count, u32 node count,
+ *              u32 star count, u64 data offset, u32 data size
+ *      data:   per tile the nodes (f32 center x, y, z, f32 exclusion,
+ *              u32 object count, u32 first child) in the order of
+ *              StarOctree::getNodes, then the stars of the nodes in order
+ *  A tile's children follow each other in the tile list.
+ *
+ *  Each star is a varint holding the zigzag coded difference of its catalog
+ *  number to the previous star's, shifted left by one; the low bit is set
+ *  if a u16 spectral type follows, otherwise the star has the previous
+ *  one's. The position follows as offsets from the center of the star's
+ *  node in 24-bit units of the node's half-size, when isQuantized() holds
+ *  for the node, or as f32 x, y, z, then the absolute magnitude as i16 in
+ *  units of 1/256. The stars of a node are sorted by catalog number.
+ *
+ *  Version 1 files have no data size in the tile entries and store the
+ *  stars as stars.dat records.
+ */
+class StarTileDatabase
+{
+public:
+    static constexpr std::string_view Magic = "CELTILES";
+    static constexpr std::uint16_t Version = 0x0200;
+    static constexpr std::uint16_t Version1 = 0x0100;
+    static constexpr std::size_t HeaderSize = 32;
+    static constexpr std::size_t TileEntrySize = 48;
+    static constexpr std::size_t TileEntrySizeV1 = 44;
+    static constexpr std::size_t NodeRecordSize = 24;
+    static constexpr std::size_t StarRecordSize = 20;
+    static constexpr std::int32_t QuantizationScale = 0x7fffff;
+
+    /*! Whether the positions of the stars of a node with the center and
+     *  half-size are stored quantized. This is the case when the node is
+     *  no larger than its distance from the origin along the major axis,
+     *  so that the quantization error stays within a unit in the last
+     *  place of the coordinates as floats.
+     */
+    static bool isQuantized(const Eigen::Vector3f& center, float halfSize)
+    {
+        return halfSize <= center.cwiseAbs().maxCoeff() - halfSize;
+    }
+
+    // Returns nullptr if the file is missing or invalid. A memoryBudget of
+    // 0 keeps every tile which has been loaded.
+    static std::unique_ptr<StarTileDatabase> open(const fs::path& path, std::size_t memoryBudget);
+
+    ~StarTileDatabase();
+
+    StarTileDatabase(const StarTileDatabase&) = delete;
+    StarTileDatabase& operator=(const StarTileDatabase&) = delete;
+
+    // Take over the tiles read since the last call and release the least
+    // recently used ones above the budget; call once per frame before the
+    // traversals. Returns true if tiles were added or released.
+    bool update();
+
+    // Process the stars of the resident tiles like
+    // StarDatabase::findVisibleStars, and queue the missing tiles which
+    // the view needs for loading
+    void findVisibleStars(StarHandler& starHandler,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf& obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag);
+
+    void setMemoryBudget(std::size_t budget);
+
+    std::size_t getTileCount() const { return m_tiles.size(); }
+    std::size_t getResidentTileCount() const { return m_residentCount; }
+    std::size_t getResidentBytes() const { return m_residentBytes; }
+
+private:
+    // A tile read by the loader thread and not yet decoded
+    struct TileData
+    {
+        std::uint32_t     tile;
+        std::vector<char> data;
+    };
+
+    struct Resident
+    {
+        std::unique_ptr<Star[]>     stars;
+        std::unique_ptr<StarOctree> octree;
+    };
+
+    struct Tile
+    {
+        Eigen::Vector3f           center;
+        float                     scale;
+        float                     parentExclusion;
+        std::uint32_t             firstChild;
+        std::uint32_t             nChildren;
+        std::uint32_t             nNodes;
+        std::uint32_t             nStars;
+        std::uint64_t             offset;
+        std::uint32_t             size;
+        std::unique_ptr<Resident> resident;
+        std::uint64_t             lastUsed{ 0 };
+        bool                      requested{ false };
+    };
+
+    explicit StarTileDatabase(std::size_t memoryBudget);
+
+    bool readDirectory(std::istream& in);
+    bool decode(Tile& tile, const std::vector<char>& data) const;
+    bool decodeStars(const Tile& tile,
+                     const std::vector<StarOctree::Node>& nodes,
+                     const char* ptr,
+                     const char* end,
+                     Star* stars) const;
+    bool decodeStarsV1(const Tile& tile, const char* ptr, Star* stars) const;
+    std::size_t tileBytes(const Tile& tile) const;
+    void processTile(std::uint32_t index,
+                     StarHandler& starHandler,
+                     const OctreeFrustumCuller<float>& culler,
+                     const Eigen::Hyperplane<float, 3>* frustumPlanes);
+    bool evict();
+    void loadTiles();
+
+    std::vector<Tile> m_tiles;
+    std::uint16_t     m_version{ Version };
+    std::size_t       m_memoryBudget;
+    std::size_t       m_residentBytes{ 0 };
+    std::size_t       m_residentCount{ 0 };
+    std::uint64_t     m_frame{ 0 };
+
+    // Shared with the loader thread
+    std::ifstream              m_file;
+    std::mutex                 m_mutex;
+    std::condition_variable    m_condition;
+    std::deque<std::uint32_t>  m_requests;
+    std::vector<TileData>      m_loaded;
+    bool                       m_stop{ false };
+    std::thread                m_loader;
+};
+
+} // end namespace celestia::engine
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <celcompat/filesystem.h>
 #include <celutil/color.h>
 #include <celutil/reshandle.h>
 #include "multitexture.h"
@@ -53,4 +54,6 @@ class Surface
     MultiResTexture overlayTexture; // overlay texture, applied last
     float bumpHeight;               // scale of bump map relief
     float lunarLambert;             // mix between Lambertian and Lommel-Seeliger (lunar-like) photometric functions
+    fs::path heightMap;             // virtual texture of height tiles, displacing the sphere
+    float heightScale{ 0.0f };      // height in km of the highest terrain in the height map
 };
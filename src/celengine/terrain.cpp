@@ -0,0 +1,701 @@
+// terrain.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "terrain.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include <celcompat/numbers.h>
+#include <celengine/parser.h>
+#include <celimage/image.h>
+#include <celutil/logger.h>
+#include <celutil/tokenizer.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+constexpr int MaxResolutionLevels = 13;
+
+// Decoded height tiles kept by the loader for building neighboring chunks
+constexpr std::size_t MaxCachedTiles = 32;
+
+// Chunks queued at a time for each terrain, so that the queue follows the
+// view instead of filling up with chunks which are no longer needed
+constexpr std::size_t MaxPendingChunks = 16;
+
+constexpr int GridColumns = TerrainChunk::ThetaQuads + 1;
+constexpr int GridRows = TerrainChunk::PhiQuads + 1;
+constexpr int GridVertices = GridColumns * GridRows;
+constexpr int SkirtVertices = 2 * GridColumns + 2 * GridRows;
+constexpr std::size_t ChunkFloats = static_cast<std::size_t>(GridVertices + SkirtVertices) * TerrainVertexSize;
+static_assert(GridVertices + SkirtVertices < 65536);
+
+
+constexpr std::uint64_t
+tileKey(unsigned int lod, unsigned int u, unsigned int v)
+{
+    return static_cast<std::uint64_t>(lod) |
+           (static_cast<std::uint64_t>(u) << 8) |
+           (static_cast<std::uint64_t>(v) << 32);
+}
+
+
+constexpr bool
+isPow2(unsigned int x)
+{
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+} // end unnamed namespace
+
+
+namespace detail
+{
+
+struct BuiltChunk
+{
+    TerrainChunk chunk;
+    std::vector<float> vertices;
+};
+
+
+// Shared by a terrain and the loader, which may still be building one of
+// its chunks after the terrain has been destroyed
+struct TerrainState
+{
+    struct TileImage
+    {
+        std::unique_ptr<Image> image;
+        std::uint64_t lastUsed;
+    };
+
+    // Set at creation
+    fs::path directory;
+    std::string prefix;
+    std::string extension;
+    unsigned int baseSplit{ 0 };
+    unsigned int tileSize{ 0 };
+    float relief{ 0.0f };
+
+    // Only used by the loader
+    bool scanned{ false };
+    unsigned int nLevels{ 0 };
+    std::unordered_set<std::uint64_t> tiles;
+    std::unordered_map<std::uint64_t, TileImage> images;
+    std::uint64_t imageUse{ 0 };
+
+    std::mutex mutex;
+    std::deque<BuiltChunk> built;
+
+    void scanTiles();
+    const Image* getImage(unsigned int lod, unsigned int u, unsigned int v);
+    float sampleHeight(double u, double v, unsigned int lod);
+    void buildChunk(const TerrainChunk& chunk, std::vector<float>& vertices);
+};
+
+
+// Find the height tiles in the level directories, as VirtualTexture does
+void
+TerrainState::scanTiles()
+{
+    scanned = true;
+    for (int i = 0; i < MaxResolutionLevels; i++)
+    {
+        fs::path path = directory / fmt::format("level{:d}", i);
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+            continue;
+
+        unsigned int lod = static_cast<unsigned int>(i) + baseSplit;
+        int uLimit = 2 << lod;
+        int vLimit = 1 << lod;
+        for (const auto& d : fs::directory_iterator(path, ec))
+        {
+            if (!fs::is_regular_file(d, ec))
+                continue;
+
+            int u = -1;
+            int v = -1;
+            if (auto filename = d.path().filename().string();
+                filename.size() < prefix.size()
+                || std::string_view{filename.data(), prefix.size()} != prefix
+                || std::sscanf(filename.c_str() + prefix.size(), "%d_%d.", &u, &v) != 2
+                || u < 0 || u >= uLimit
+                || v < 0 || v >= vLimit)
+                continue;
+
+            tiles.insert(tileKey(lod, static_cast<unsigned int>(u), static_cast<unsigned int>(v)));
+            nLevels = std::max(nLevels, lod + 1);
+        }
+    }
+}
+
+
+const Image*
+TerrainState::getImage(unsigned int lod, unsigned int u, unsigned int v)
+{
+    std::uint64_t key = tileKey(lod, u, v);
+    if (auto it = images.find(key); it != images.end())
+    {
+        it->second.lastUsed = ++imageUse;
+        return it->second.image.get();
+    }
+
+    if (images.size() >= MaxCachedTiles)
+    {
+        auto oldest = std::min_element(images.begin(), images.end(),
+                                       [](const auto& a, const auto& b) { return a.second.lastUsed < b.second.lastUsed; });
+        images.erase(oldest);
+    }
+
+    fs::path path = directory /
+                    fmt::format("level{:d}", lod - baseSplit) /
+                    fmt::format("{:s}{:d}_{:d}{:s}", prefix, u, v, extension);
+    auto image = Image::load(path);
+    if (image != nullptr && image->isCompressed())
+    {
+        GetLogger()->warn("Height tile {} can't be compressed\n", path);
+        image = nullptr;
+    }
+
+    // Failed loads are kept as well, so that they aren't retried for
+    // every sample
+    auto& entry = images[key];
+    entry.image = std::move(image);
+    entry.lastUsed = ++imageUse;
+    return entry.image.get();
+}
+
+
+// Height between 0 and 1 from the first channel of the deepest tile at
+// or above lod; u and v are texture coordinates of the sphere
+float
+TerrainState::sampleHeight(double u, double v, unsigned int lod)
+{
+    lod = std::max(std::min(lod, nLevels == 0 ? 0u : nLevels - 1), baseSplit);
+    for (;;)
+    {
+        double x = u * static_cast<double>(2u << lod);
+        double y = std::clamp(v, 0.0, 1.0) * static_cast<double>(1u << lod);
+        double tx = std::floor(x);
+        double ty = std::min(std::floor(y), static_cast<double>((1u << lod) - 1));
+        auto tileU = static_cast<unsigned int>(static_cast<long long>(tx) & ((2ll << lod) - 1));
+        auto tileV = static_cast<unsigned int>(ty);
+
+        const Image* image = nullptr;
+        if (tiles.count(tileKey(lod, tileU, tileV)) != 0)
+            image = getImage(lod, tileU, tileV);
+
+        if (image == nullptr)
+        {
+            if (lod <= baseSplit)
+                return 0.0f;
+            --lod;
+            continue;
+        }
+
+        int width = image->getWidth();
+        int height = image->getHeight();
+        double px = std::clamp((x - tx) * width - 0.5, 0.0, static_cast<double>(width - 1));
+        double py = std::clamp((y - ty) * height - 0.5, 0.0, static_cast<double>(height - 1));
+        int x0 = static_cast<int>(px);
+        int y0 = static_cast<int>(py);
+        int x1 = std::min(x0 + 1, width - 1);
+        int y1 = std::min(y0 + 1, height - 1);
+        auto fx = static_cast<float>(px - x0);
+        auto fy = static_cast<float>(py - y0);
+
+        int components = image->getComponents();
+        const std::uint8_t* row0 = image->getPixels() + static_cast<std::ptrdiff_t>(y0) * image->getPitch();
+        const std::uint8_t* row1 = image->getPixels() + static_cast<std::ptrdiff_t>(y1) * image->getPitch();
+        float h0 = row0[x0 * components] * (1.0f - fx) + row0[x1 * components] * fx;
+        float h1 = row1[x0 * components] * (1.0f - fx) + row1[x1 * components] * fx;
+        return (h0 * (1.0f - fy) + h1 * fy) / 255.0f;
+    }
+}
+
+
+void
+TerrainState::buildChunk(const TerrainChunk& chunk, std::vector<float>& vertices)
+{
+    if (!scanned)
+        scanTiles();
+
+    int step = chunk.step();
+    int theta0 = chunk.theta0();
+    int phi0 = chunk.phi0();
+
+    // Use the tiles with about as many texels as the grid has vertices
+    int log2TileSize = 0;
+    while ((1u << log2TileSize) < tileSize)
+        ++log2TileSize;
+    auto lod = static_cast<unsigned int>(std::max(chunk.level + 4 - log2TileSize, 0));
+
+    // Positions on a grid with an extra row and column on each side, for
+    // computing the normals
+    constexpr int Columns = GridColumns + 2;
+    constexpr int Rows = GridRows + 2;
+    std::array<Eigen::Vector3f, Columns * Rows> positions;
+    for (int i = 0; i < Rows; i++)
+    {
+        int phi = std::clamp(phi0 + (i - 1) * step, 0, TerrainChunk::MaxDivisions / 2);
+        for (int j = 0; j < Columns; j++)
+        {
+            int theta = theta0 + (j - 1) * step;
+            double u = 1.0 - static_cast<double>(theta) / static_cast<double>(TerrainChunk::MaxDivisions);
+            double v = 1.0 - static_cast<double>(phi) / static_cast<double>(TerrainChunk::MaxDivisions / 2);
+            float h = sampleHeight(u - std::floor(u), v, lod);
+            positions[i * Columns + j] = TerrainSpherePoint(theta, phi) * (1.0f + relief * h);
+        }
+    }
+
+    vertices.clear();
+    vertices.reserve(ChunkFloats);
+    auto addVertex = [&vertices](const Eigen::Vector3f& p, const Eigen::Vector3f& n, int theta, int phi)
+    {
+        vertices.insert(vertices.end(), { p.x(), p.y(), p.z(), n.x(), n.y(), n.z() });
+
+        // The tangent of the sphere, matching the normal maps
+        double angle = static_cast<double>(theta) / static_cast<double>(TerrainChunk::MaxDivisions) * 2.0 * celestia::numbers::pi;
+        auto s = static_cast<float>(std::sin(angle));
+        auto c = static_cast<float>(std::cos(angle));
+        vertices.insert(vertices.end(), { s, 0.0f, -c });
+        vertices.push_back(static_cast<float>(theta));
+        vertices.push_back(static_cast<float>(phi));
+    };
+
+    std::array<Eigen::Vector3f, GridVertices> normals;
+    for (int i = 0; i < GridRows; i++)
+    {
+        for (int j = 0; j < GridColumns; j++)
+        {
+            int k = (i + 1) * Columns + j + 1;
+            Eigen::Vector3f dPhi = positions[k + Columns] - positions[k - Columns];
+            Eigen::Vector3f dTheta = positions[k + 1] - positions[k - 1];
+            Eigen::Vector3f n = dTheta.cross(dPhi);
+            Eigen::Vector3f up = positions[k].normalized();
+            // At the poles the grid collapses to a point
+            if (n.squaredNorm() < 1.0e-20f)
+                n = up;
+            else if (n.dot(up) < 0.0f)
+                n = -n.normalized();
+            else
+                n.normalize();
+
+            normals[i * GridColumns + j] = n;
+            addVertex(positions[k], n, theta0 + j * step, phi0 + i * step);
+        }
+    }
+
+    // Skirts hang down from the edges, hiding the cracks to neighboring
+    // chunks of other levels
+    float skirtDepth = 2.0f * TerrainChunkError(chunk, relief);
+    auto addSkirt = [&](int i, int j)
+    {
+        const Eigen::Vector3f& p = positions[(i + 1) * Columns + j + 1];
+        addVertex(p - p.normalized() * skirtDepth, normals[i * GridColumns + j], theta0 + j * step, phi0 + i * step);
+    };
+
+    for (int j = 0; j < GridColumns; j++)
+        addSkirt(0, j);
+    for (int j = 0; j < GridColumns; j++)
+        addSkirt(GridRows - 1, j);
+    for (int i = 0; i < GridRows; i++)
+        addSkirt(i, 0);
+    for (int i = 0; i < GridRows; i++)
+        addSkirt(i, GridColumns - 1);
+
+    assert(vertices.size() == ChunkFloats);
+}
+
+
+// Builds the chunks of all terrains on a background thread
+class TerrainLoader
+{
+public:
+    TerrainLoader();
+    ~TerrainLoader();
+
+    void request(const std::shared_ptr<TerrainState>& state, const TerrainChunk& chunk);
+
+private:
+    struct Request
+    {
+        std::weak_ptr<TerrainState> state;
+        TerrainChunk chunk;
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Request> requests;
+    std::thread worker;
+    bool quit{ false };
+};
+
+
+TerrainLoader::TerrainLoader() :
+    worker(&TerrainLoader::run, this)
+{
+}
+
+
+TerrainLoader::~TerrainLoader()
+{
+    {
+        std::scoped_lock lock(mutex);
+        quit = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+
+void
+TerrainLoader::request(const std::shared_ptr<TerrainState>& state, const TerrainChunk& chunk)
+{
+    {
+        std::scoped_lock lock(mutex);
+        requests.push_back({ state, chunk });
+    }
+    condition.notify_one();
+}
+
+
+void
+TerrainLoader::run()
+{
+    std::vector<float> vertices;
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        condition.wait(lock, [this] { return quit || !requests.empty(); });
+        if (quit)
+            return;
+
+        Request request = std::move(requests.front());
+        requests.pop_front();
+        lock.unlock();
+
+        // Skip the chunks of terrains which have been destroyed
+        if (auto state = request.state.lock(); state != nullptr)
+        {
+            state->buildChunk(request.chunk, vertices);
+            std::scoped_lock stateLock(state->mutex);
+            state->built.push_back({ request.chunk, vertices });
+        }
+
+        lock.lock();
+    }
+}
+
+} // end namespace detail
+
+
+Terrain::Terrain(std::shared_ptr<detail::TerrainState> _state, detail::TerrainLoader& _loader) :
+    state(std::move(_state)),
+    loader(&_loader)
+{
+}
+
+
+Terrain::~Terrain()
+{
+    for (const auto& [key, chunk] : chunks)
+        gl::deleteBuffers(1, &chunk.buffer);
+}
+
+
+bool
+Terrain::isResident(const TerrainChunk& chunk) const
+{
+    return chunks.count(chunk.key()) != 0;
+}
+
+
+GLuint
+Terrain::useChunk(const TerrainChunk& chunk, std::uint64_t frame)
+{
+    auto it = chunks.find(chunk.key());
+    if (it == chunks.end())
+        return 0;
+    it->second.lastUsed = frame;
+    return it->second.buffer;
+}
+
+
+void
+Terrain::request(const std::vector<TerrainChunk>& requested)
+{
+    for (const TerrainChunk& chunk : requested)
+    {
+        if (pending.size() >= MaxPendingChunks)
+            break;
+        if (isResident(chunk) || !pending.insert(chunk.key()).second)
+            continue;
+        loader->request(state, chunk);
+    }
+}
+
+
+float
+Terrain::getRelief() const
+{
+    return state->relief;
+}
+
+
+// Upload built chunks while they fit into budget bytes; with allowOne,
+// the first chunk is uploaded even if it doesn't fit
+std::size_t
+Terrain::upload(std::size_t budget, bool allowOne, std::uint64_t frame)
+{
+    std::size_t uploaded = 0;
+    for (;;)
+    {
+        detail::BuiltChunk built;
+        {
+            std::scoped_lock lock(state->mutex);
+            if (state->built.empty())
+                break;
+            std::size_t size = state->built.front().vertices.size() * sizeof(float);
+            if (uploaded + size > budget && !(allowOne && uploaded == 0))
+                break;
+            built = std::move(state->built.front());
+            state->built.pop_front();
+        }
+
+        pending.erase(built.chunk.key());
+        if (isResident(built.chunk))
+            continue;
+
+        ChunkBuffer chunk{ 0, built.vertices.size() * sizeof(float), frame };
+        glGenBuffers(1, &chunk.buffer);
+        if (chunk.buffer == 0)
+            continue;
+        gl::bindBuffer(GL_ARRAY_BUFFER, chunk.buffer);
+        glBufferData(GL_ARRAY_BUFFER, chunk.size, built.vertices.data(), GL_STATIC_DRAW);
+        chunks.try_emplace(built.chunk.key(), chunk);
+        residentSize += chunk.size;
+        uploaded += chunk.size;
+    }
+
+    return uploaded;
+}
+
+
+// Evict chunks not used since frame, least recently used first, until
+// excess bytes have been released
+std::size_t
+Terrain::evict(std::uint64_t frame, std::size_t excess)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> unused;
+    for (const auto& [key, chunk] : chunks)
+    {
+        if (chunk.lastUsed < frame)
+            unused.emplace_back(chunk.lastUsed, key);
+    }
+    std::sort(unused.begin(), unused.end());
+
+    std::size_t released = 0;
+    for (const auto& [lastUsed, key] : unused)
+    {
+        if (released >= excess)
+            break;
+        auto it = chunks.find(key);
+        gl::deleteBuffers(1, &it->second.buffer);
+        released += it->second.size;
+        residentSize -= it->second.size;
+        chunks.erase(it);
+    }
+
+    return released;
+}
+
+
+TerrainManager::TerrainManager() :
+    loader(std::make_unique<detail::TerrainLoader>())
+{
+}
+
+
+TerrainManager::~TerrainManager()
+{
+    // Stop the loader before the terrains go
+    loader = nullptr;
+    terrains.clear();
+    gl::deleteBuffers(1, &indexBuffer);
+}
+
+
+Terrain*
+TerrainManager::find(const fs::path& filename, float relief)
+{
+    auto [it, inserted] = terrains.try_emplace(std::make_pair(filename, relief));
+    if (!inserted)
+        return it->second.get();
+
+    std::ifstream in(filename, std::ios::in);
+    if (!in.good())
+    {
+        GetLogger()->error("Error opening height map file: {}\n", filename);
+        return nullptr;
+    }
+
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+    tokenizer.nextToken();
+    if (auto tokenValue = tokenizer.getNameValue(); tokenValue != "VirtualTexture")
+    {
+        GetLogger()->error("Height map {} isn't a virtual texture\n", filename);
+        return nullptr;
+    }
+
+    const Value paramsValue = parser.readValue();
+    const Hash* params = paramsValue.getHash();
+    const std::string* imageDirectory = params == nullptr ? nullptr : params->getString("ImageDirectory");
+    std::optional<double> baseSplit = params == nullptr ? std::nullopt : params->getNumber<double>("BaseSplit");
+    std::optional<double> tileSize = params == nullptr ? std::nullopt : params->getNumber<double>("TileSize");
+    if (imageDirectory == nullptr ||
+        !baseSplit.has_value() || *baseSplit < 0.0 || *baseSplit != std::floor(*baseSplit) ||
+        !tileSize.has_value() || *tileSize != std::floor(*tileSize) || !isPow2(static_cast<unsigned int>(*tileSize)))
+    {
+        GetLogger()->error("Bad height map {}\n", filename);
+        return nullptr;
+    }
+
+    auto state = std::make_shared<detail::TerrainState>();
+    state->directory = *imageDirectory;
+    if (state->directory.is_relative())
+        state->directory = filename.parent_path() / state->directory;
+    const std::string* tilePrefix = params->getString("TilePrefix");
+    state->prefix = tilePrefix == nullptr ? "tx_" : *tilePrefix;
+    const std::string* tileType = params->getString("TileType");
+    state->extension = fmt::format(".{:s}", tileType == nullptr ? "png" : *tileType);
+    state->baseSplit = static_cast<unsigned int>(*baseSplit);
+    state->tileSize = static_cast<unsigned int>(*tileSize);
+    state->relief = relief;
+
+    it->second = std::make_unique<Terrain>(std::move(state), *loader);
+    return it->second.get();
+}
+
+
+void
+TerrainManager::beginFrame()
+{
+    ++frame;
+
+    // At least one chunk is uploaded per frame, however small the budget
+    std::size_t uploaded = 0;
+    for (auto& [key, terrain] : terrains)
+    {
+        if (terrain != nullptr)
+            uploaded += terrain->upload(uploadBudget - std::min(uploaded, uploadBudget), uploaded == 0, frame);
+    }
+
+    if (memoryBudget == 0)
+        return;
+
+    std::size_t residentSize = 0;
+    for (const auto& [key, terrain] : terrains)
+    {
+        if (terrain != nullptr)
+            residentSize += terrain->residentSize;
+    }
+
+    // Chunks used in the last frame are kept
+    for (auto& [key, terrain] : terrains)
+    {
+        if (residentSize <= memoryBudget)
+            break;
+        if (terrain != nullptr)
+            residentSize -= terrain->evict(frame - 1, residentSize - memoryBudget);
+    }
+}
+
+
+GLuint
+TerrainManager::getIndexBuffer()
+{
+    if (indexBuffer != 0)
+        return indexBuffer;
+
+    std::vector<unsigned short> indices;
+    indices.reserve(static_cast<std::size_t>(getIndexCount()));
+    auto addQuad = [&indices](int a, int b, int c, int d)
+    {
+        // Same winding as the strips of LODSphereMesh
+        for (int index : { a, b, c, c, b, d })
+            indices.push_back(static_cast<unsigned short>(index));
+    };
+
+    auto grid = [](int i, int j) { return i * GridColumns + j; };
+    for (int i = 0; i < GridRows - 1; i++)
+    {
+        for (int j = 0; j < GridColumns - 1; j++)
+            addQuad(grid(i, j), grid(i + 1, j), grid(i, j + 1), grid(i + 1, j + 1));
+    }
+
+    // The skirts continue the grid by one row or column past its edges
+    int bottom = GridVertices;
+    int top = bottom + GridColumns;
+    int left = top + GridColumns;
+    int right = left + GridRows;
+    for (int j = 0; j < GridColumns - 1; j++)
+    {
+        addQuad(bottom + j, grid(0, j), bottom + j + 1, grid(0, j + 1));
+        addQuad(grid(GridRows - 1, j), top + j, grid(GridRows - 1, j + 1), top + j + 1);
+    }
+    for (int i = 0; i < GridRows - 1; i++)
+    {
+        addQuad(left + i, left + i + 1, grid(i, 0), grid(i + 1, 0));
+        addQuad(grid(i, GridColumns - 1), grid(i + 1, GridColumns - 1), right + i, right + i + 1);
+    }
+
+    assert(indices.size() == static_cast<std::size_t>(getIndexCount()));
+
+    glGenBuffers(1, &indexBuffer);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 indices.size() * sizeof(unsigned short),
+                 indices.data(),
+                 GL_STATIC_DRAW);
+    return indexBuffer;
+}
+
+
+GLsizei
+TerrainManager::getIndexCount()
+{
+    return static_cast<GLsizei>(TerrainChunkTriangles * 3);
+}
+
+} // end namespace celestia::engine
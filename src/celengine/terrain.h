@@ -0,0 +1,132 @@
+// terrain.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/glsupport.h>
+#include "terrainquadtree.h"
+
+namespace celestia::engine
+{
+
+namespace detail
+{
+struct TerrainState;
+class TerrainLoader;
+}
+
+// Vertices of a chunk: position, normal and tangent in unit radii, then
+// the longitude and latitude in divisions, as the texture coordinates of
+// LODSphereMesh
+constexpr int TerrainVertexSize = 3 + 3 + 3 + 2;
+constexpr int TerrainNormalOffset = 3;
+constexpr int TerrainTangentOffset = 6;
+constexpr int TerrainTexCoordOffset = 9;
+
+/*! Displaced meshes of the chunks of a sphere. The heights are read from
+ *  tiles laid out like the tiles of a VirtualTexture, and the meshes of
+ *  the chunks are built from them on a background thread. Built meshes
+ *  are uploaded by TerrainManager::beginFrame.
+ */
+class Terrain
+{
+public:
+    Terrain(std::shared_ptr<detail::TerrainState> state, detail::TerrainLoader& loader);
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    bool isResident(const TerrainChunk& chunk) const;
+    // Buffer holding the vertices of a resident chunk, marking it used
+    GLuint useChunk(const TerrainChunk& chunk, std::uint64_t frame);
+    // Build the meshes of chunks, most important first
+    void request(const std::vector<TerrainChunk>& chunks);
+
+    float getRelief() const;
+
+private:
+    struct ChunkBuffer
+    {
+        GLuint buffer;
+        std::size_t size;
+        std::uint64_t lastUsed;
+    };
+
+    std::size_t upload(std::size_t budget, bool allowOne, std::uint64_t frame);
+    std::size_t evict(std::uint64_t frame, std::size_t excess);
+
+    std::shared_ptr<detail::TerrainState> state;
+    detail::TerrainLoader* loader;
+    std::unordered_map<std::uint64_t, ChunkBuffer> chunks;
+    std::unordered_set<std::uint64_t> pending;
+    std::size_t residentSize{ 0 };
+
+    friend class TerrainManager;
+};
+
+/*! Owns the terrains of all bodies and the thread building their chunks.
+ *  The GPU memory taken by the chunks and the bytes uploaded per frame
+ *  are limited by budgets shared by all terrains.
+ */
+class TerrainManager
+{
+public:
+    TerrainManager();
+    ~TerrainManager();
+
+    TerrainManager(const TerrainManager&) = delete;
+    TerrainManager& operator=(const TerrainManager&) = delete;
+
+    // Terrain from a virtual texture file of height tiles, where a height
+    // of 1 is relief unit radii above the sphere. Return nullptr if the
+    // file can't be read.
+    Terrain* find(const fs::path& filename, float relief);
+
+    // Upload the chunks built since the last frame and evict the least
+    // recently used chunks above the memory budget
+    void beginFrame();
+    std::uint64_t getFrame() const { return frame; }
+
+    // Index buffer shared by all chunks, for GL_TRIANGLES
+    GLuint getIndexBuffer();
+    static GLsizei getIndexCount();
+
+    // Bytes of vertices uploaded per frame; at least one chunk is
+    // uploaded per frame, so that a small budget delays but never stalls
+    // the terrain
+    void setUploadBudget(std::size_t bytes) { uploadBudget = bytes; }
+    // Bytes of vertices kept in GPU memory; 0 = no limit
+    void setMemoryBudget(std::size_t bytes) { memoryBudget = bytes; }
+    // Triangles drawn for each terrain; chunks are refined until they
+    // would exceed it
+    void setTriangleBudget(std::size_t triangles) { triangleBudget = triangles; }
+    std::size_t getTriangleBudget() const { return triangleBudget; }
+
+private:
+    std::unique_ptr<detail::TerrainLoader> loader;
+    std::map<std::pair<fs::path, float>, std::unique_ptr<Terrain>> terrains;
+    std::size_t uploadBudget{ 256 * 1024 };
+    std::size_t memoryBudget{ 64 * 1024 * 1024 };
+    std::size_t triangleBudget{ 500000 };
+    std::uint64_t frame{ 0 };
+    GLuint indexBuffer{ 0 };
+};
+
+} // end namespace celestia::engine
@@ -0,0 +1,195 @@
+// terrainquadtree.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "terrainquadtree.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <queue>
+
+#include <celcompat/numbers.h>
+#include <celmath/frustum.h>
+#include <celmath/mathlib.h>
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+struct Candidate
+{
+    TerrainChunk chunk;
+    float error;
+    Eigen::Vector3f center;
+    float radius;
+
+    bool operator<(const Candidate& other) const { return error < other.error; }
+};
+
+
+Candidate
+makeCandidate(const TerrainChunk& chunk, const TerrainLODParams& params)
+{
+    Candidate c{ chunk, 0.0f, Eigen::Vector3f::Zero(), 0.0f };
+    TerrainChunkBounds(chunk, params.relief, c.center, c.radius);
+    float distance = std::max((params.eyePosition - c.center).norm() - c.radius, 1.0e-6f);
+    c.error = TerrainChunkError(chunk, params.relief) / (distance * params.pixelSize);
+    return c;
+}
+
+} // end unnamed namespace
+
+
+Eigen::Vector3f
+TerrainSpherePoint(int theta, int phi)
+{
+    double t = static_cast<double>(theta) / static_cast<double>(TerrainChunk::MaxDivisions) * 2.0 * celestia::numbers::pi;
+    double p = (static_cast<double>(phi) / static_cast<double>(TerrainChunk::MaxDivisions / 2) - 0.5) * celestia::numbers::pi;
+    double st;
+    double ct;
+    double sp;
+    double cp;
+    math::sincos(t, st, ct);
+    math::sincos(p, sp, cp);
+    return Eigen::Vector3d(cp * ct, sp, cp * st).cast<float>();
+}
+
+
+float
+TerrainChunkError(const TerrainChunk& chunk, float relief)
+{
+    // Angle between neighboring vertices
+    float spacing = static_cast<float>(2.0 * celestia::numbers::pi) *
+                    static_cast<float>(chunk.step()) / static_cast<float>(TerrainChunk::MaxDivisions);
+    return spacing * spacing / 8.0f + relief * spacing;
+}
+
+
+void
+TerrainChunkBounds(const TerrainChunk& chunk, float relief, Eigen::Vector3f& center, float& radius)
+{
+    int theta0 = chunk.theta0();
+    int phi0 = chunk.phi0();
+    int thetaExtent = chunk.extent();
+    int phiExtent = thetaExtent / 2;
+
+    std::array<Eigen::Vector3f, 9> points;
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+            points[i * 3 + j] = TerrainSpherePoint(theta0 + thetaExtent * j / 2, phi0 + phiExtent * i / 2);
+    }
+
+    // The middle point lies on the sphere, as do all points of a chunk
+    center = points[4] * (1.0f + relief * 0.5f);
+    radius = 0.0f;
+    for (const Eigen::Vector3f& p : points)
+    {
+        radius = std::max(radius, (p - center).norm());
+        radius = std::max(radius, (p * (1.0f + relief) - center).norm());
+    }
+}
+
+
+bool
+SelectTerrainChunks(const TerrainLODParams& params,
+                    const math::Frustum& frustum,
+                    const std::function<bool(const TerrainChunk&)>& isResident,
+                    std::vector<TerrainChunk>& selected,
+                    std::vector<TerrainChunk>& requested)
+{
+    selected.clear();
+    requested.clear();
+
+    int minLevel = std::clamp(params.minLevel, 0, TerrainChunk::MaxLevel);
+    int maxLevel = std::clamp(params.maxLevel, minLevel, TerrainChunk::MaxLevel);
+
+    std::priority_queue<Candidate> candidates;
+    bool complete = true;
+    int split = 1 << minLevel;
+    for (int i = 0; i < split; ++i)
+    {
+        for (int j = 0; j < split; ++j)
+        {
+            Candidate c = makeCandidate(TerrainChunk{ minLevel, i, j }, params);
+            if (frustum.testSphere(c.center, c.radius) == math::Frustum::Outside)
+                continue;
+
+            if (isResident(c.chunk))
+            {
+                candidates.push(c);
+            }
+            else
+            {
+                requested.push_back(c.chunk);
+                complete = false;
+            }
+        }
+    }
+
+    if (!complete)
+        return false;
+
+    std::size_t triangles = candidates.size() * TerrainChunkTriangles;
+    while (!candidates.empty())
+    {
+        Candidate c = candidates.top();
+        candidates.pop();
+        if (c.chunk.level >= maxLevel || c.error <= params.maxError)
+        {
+            selected.push_back(c.chunk);
+            continue;
+        }
+
+        std::array<Candidate, 4> children;
+        std::size_t nChildren = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            for (int j = 0; j < 2; ++j)
+            {
+                Candidate child = makeCandidate(c.chunk.child(i, j), params);
+                if (frustum.testSphere(child.center, child.radius) != math::Frustum::Outside)
+                    children[nChildren++] = child;
+            }
+        }
+
+        if (nChildren == 0 ||
+            triangles + (nChildren - 1) * TerrainChunkTriangles > params.maxTriangles)
+        {
+            selected.push_back(c.chunk);
+            continue;
+        }
+
+        bool ready = true;
+        for (std::size_t i = 0; i < nChildren; ++i)
+        {
+            if (!isResident(children[i].chunk))
+            {
+                requested.push_back(children[i].chunk);
+                ready = false;
+            }
+        }
+
+        if (!ready)
+        {
+            selected.push_back(c.chunk);
+            continue;
+        }
+
+        triangles += (nChildren - 1) * TerrainChunkTriangles;
+        for (std::size_t i = 0; i < nChildren; ++i)
+            candidates.push(children[i]);
+    }
+
+    return true;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,107 @@
+// terrainquadtree.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace celestia::math
+{
+class Frustum;
+}
+
+namespace celestia::engine
+{
+
+// A chunk is a section of the unit sphere as drawn by LODSphereMesh. The
+// chunks of a level split the sphere into 2^level sections in longitude
+// and latitude, so that each chunk has four children at the next level.
+// Longitudes and latitudes are measured in the divisions of LODSphereMesh.
+struct TerrainChunk
+{
+    static constexpr int MaxDivisions = 16384;
+    static constexpr int MaxLevel = 9;
+
+    // Grid of quads in a chunk; all chunks share the same grid
+    static constexpr int ThetaQuads = 32;
+    static constexpr int PhiQuads = 16;
+
+    int level;
+    int phiIndex;
+    int thetaIndex;
+
+    int extent() const { return MaxDivisions >> level; }
+    int phi0() const { return phiIndex * extent() / 2; }
+    int theta0() const { return thetaIndex * extent(); }
+    // Distance between grid vertices in divisions
+    int step() const { return extent() / ThetaQuads; }
+
+    TerrainChunk child(int i, int j) const
+    {
+        return { level + 1, phiIndex * 2 + i, thetaIndex * 2 + j };
+    }
+
+    std::uint64_t key() const
+    {
+        return static_cast<std::uint64_t>(level) |
+               (static_cast<std::uint64_t>(phiIndex) << 8) |
+               (static_cast<std::uint64_t>(thetaIndex) << 32);
+    }
+};
+
+// Point on the unit sphere at a longitude and latitude in divisions
+Eigen::Vector3f TerrainSpherePoint(int theta, int phi);
+
+// Largest deviation in unit radii of a chunk's grid from the surface,
+// assuming slopes of no more than relief per radian
+float TerrainChunkError(const TerrainChunk& chunk, float relief);
+
+// Bounding sphere of a chunk with heights between 0 and relief
+void TerrainChunkBounds(const TerrainChunk& chunk, float relief, Eigen::Vector3f& center, float& radius);
+
+struct TerrainLODParams
+{
+    // Observer position in unit radii of the sphere
+    Eigen::Vector3f eyePosition{ Eigen::Vector3f::Zero() };
+    // Size of a pixel at unit distance
+    float pixelSize{ 1.0f };
+    // Largest error in pixels of the drawn chunks
+    float maxError{ 1.0f };
+    // Height of the highest terrain in unit radii
+    float relief{ 0.0f };
+    // Chunks are drawn from minLevel at least, e.g. because textures are
+    // split into tiles, and up to maxLevel
+    int minLevel{ 1 };
+    int maxLevel{ TerrainChunk::MaxLevel };
+    // Chunks are only refined as long as the drawn chunks stay below
+    std::size_t maxTriangles{ 0 };
+};
+
+// Select the chunks to draw, refining the chunks with the largest
+// screen space error first. A chunk is only replaced by its children
+// once isResident returns true for all of its visible children; the
+// missing ones are added to requested, most important first. Chunks
+// outside the frustum are skipped. Return false if a chunk at minLevel
+// isn't resident, so that the sphere can't be drawn from chunks yet.
+bool SelectTerrainChunks(const TerrainLODParams& params,
+                         const math::Frustum& frustum,
+                         const std::function<bool(const TerrainChunk&)>& isResident,
+                         std::vector<TerrainChunk>& selected,
+                         std::vector<TerrainChunk>& requested);
+
+// Number of triangles drawn for each chunk, including its skirts
+constexpr std::size_t TerrainChunkTriangles = 2 * TerrainChunk::ThetaQuads * TerrainChunk::PhiQuads +
+                                              4 * (TerrainChunk::ThetaQuads + TerrainChunk::PhiQuads);
+
+} // end namespace celestia::engine
@@ -15,8 +15,10 @@
 #include <fstream>
 #include <string_view>
 
+#include <celutil/filetype.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include "texturecache.h"
 
 using namespace std::string_view_literals;
 using celestia::util::GetLogger;
@@ -93,27 +95,110 @@ TextureInfo::resolve(const fs::path& baseDir) const
 std::unique_ptr<Texture>
 TextureInfo::load(const fs::path& name) const
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode  mipMode     = Texture::DefaultMipMaps;
-    Texture::Colorspace  colorspace  = Texture::DefaultColorspace;
+    if (useCache(name))
+    {
+        GetLogger()->debug("Loading texture: {}\n", name);
+        auto img = celestia::engine::LoadCachedTextureImage(name, GetTextureSizeLimit());
+        if (img == nullptr)
+            return nullptr;
+        return CreateTextureFromImage(std::move(img), name, addressMode(), mipMode());
+    }
 
-    if (flags & WrapTexture)
-        addressMode = Texture::Wrap;
-    else if (flags & BorderClamp)
-        addressMode = Texture::BorderClamp;
+    if (bumpHeight == 0.0f)
+    {
+        GetLogger()->debug("Loading texture: {}\n", name);
+        return LoadTextureFromFile(name, addressMode(), mipMode(), colorspace());
+    }
 
-    if (flags & NoMipMaps)
-        mipMode = Texture::NoMipMaps;
+    GetLogger()->debug("Loading bump map: {}\n", name);
+    return LoadHeightMapFromFile(name, bumpHeight, addressMode());
+}
 
-    if (flags & LinearColorspace)
-        colorspace = Texture::LinearColorspace;
 
-    if (bumpHeight == 0.0f)
+PreparedTexture
+TextureInfo::prepare(const fs::path& name) const
+{
+    PreparedTexture prepared;
+    if (DetermineFileType(name) == ContentType::CelestiaTexture)
+    {
+        prepared.isVirtual = true;
+    }
+    else if (useCache(name))
     {
         GetLogger()->debug("Loading texture: {}\n", name);
-        return LoadTextureFromFile(name, addressMode, mipMode, colorspace);
+        prepared.image = celestia::engine::LoadCachedTextureImage(name, GetTextureSizeLimit());
     }
+    else if (bumpHeight == 0.0f)
+    {
+        GetLogger()->debug("Loading texture: {}\n", name);
+        prepared.rows = OpenTiledTextureRows(name, colorspace());
+        if (prepared.rows != nullptr)
+            return prepared;
 
-    GetLogger()->debug("Loading bump map: {}\n", name);
-    return LoadHeightMapFromFile(name, bumpHeight, addressMode);
+        prepared.image = LoadTextureImage(name, colorspace());
+        if (mipMode() == Texture::DefaultMipMaps)
+            AddTextureMipmaps(prepared.image, colorspace());
+    }
+    else
+    {
+        GetLogger()->debug("Loading bump map: {}\n", name);
+        prepared.image = LoadHeightMapImage(name, bumpHeight, addressMode());
+        AddTextureMipmaps(prepared.image, Texture::LinearColorspace);
+    }
+
+    return prepared;
+}
+
+
+std::unique_ptr<Texture>
+TextureInfo::finish(const fs::path& name, PreparedTexture&& prepared) const
+{
+    if (prepared.isVirtual)
+        return load(name);
+    if (prepared.rows != nullptr)
+        return CreateTiledTexture(std::move(prepared.rows), mipMode());
+    if (prepared.image == nullptr)
+        return nullptr;
+
+    return CreateTextureFromImage(std::move(prepared.image),
+                                  name,
+                                  addressMode(),
+                                  bumpHeight == 0.0f ? mipMode() : Texture::DefaultMipMaps);
+}
+
+
+// Only color textures are cached, data in linear textures like normal maps
+// doesn't survive DXT compression well
+bool
+TextureInfo::useCache(const fs::path& name) const
+{
+    return celestia::engine::IsTextureCacheEnabled() &&
+           bumpHeight == 0.0f &&
+           colorspace() == Texture::DefaultColorspace &&
+           DetermineFileType(name) != ContentType::CelestiaTexture;
+}
+
+
+Texture::AddressMode
+TextureInfo::addressMode() const
+{
+    if (flags & WrapTexture)
+        return Texture::Wrap;
+    if (flags & BorderClamp)
+        return Texture::BorderClamp;
+    return Texture::EdgeClamp;
+}
+
+
+Texture::MipMapMode
+TextureInfo::mipMode() const
+{
+    return (flags & NoMipMaps) ? Texture::NoMipMaps : Texture::DefaultMipMaps;
+}
+
+
+Texture::Colorspace
+TextureInfo::colorspace() const
+{
+    return (flags & LinearColorspace) ? Texture::LinearColorspace : Texture::DefaultColorspace;
 }
@@ -18,6 +18,16 @@
 #include "multitexture.h"
 #include "texture.h"
 
+// Result of the first step of loading a texture asynchronously
+struct PreparedTexture
+{
+    std::unique_ptr<celestia::engine::Image> image;
+    // Images streamed into a tiled texture are read when it is created
+    std::unique_ptr<celestia::engine::ImageRowReader> rows;
+    // Virtual textures are loaded when the texture is created
+    bool isVirtual{ false };
+};
+
 class TextureInfo
 {
 private:
@@ -32,6 +42,8 @@ private:
 public:
     using ResourceType = Texture;
     using ResourceKey = fs::path;
+    using PreparedType = PreparedTexture;
+    static constexpr celestia::util::MemoryTag memoryTag = celestia::util::MemoryTag::Textures;
 
     enum
     {
@@ -76,6 +88,17 @@ public:
 
     fs::path resolve(const fs::path&) const;
     std::unique_ptr<Texture> load(const fs::path&) const;
+
+    // Asynchronous loading: prepare reads the image on a worker thread,
+    // finish creates the texture on the render thread.
+    PreparedTexture prepare(const fs::path&) const;
+    std::unique_ptr<Texture> finish(const fs::path&, PreparedTexture&&) const;
+
+private:
+    bool useCache(const fs::path&) const;
+    Texture::AddressMode addressMode() const;
+    Texture::MipMapMode mipMode() const;
+    Texture::Colorspace colorspace() const;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
@@ -14,9 +14,8 @@
 #ifdef USE_ICU
 #include <celutil/flag.h>
 #include <celutil/unicode.h>
-#else
-#include <celutil/utf8.h>
 #endif
+#include <celutil/utf8.h>
 
 
 namespace celestia::engine
@@ -64,6 +63,16 @@ void TextLayout::setHorizontalAlignment(HorizontalAlignment value)
     }
 }
 
+void TextLayout::setColor(const Color &value)
+{
+    if (color != value)
+    {
+        if (began)
+            flushInternal(false);
+        color = value;
+    }
+}
+
 void TextLayout::setScreenDpi(int value)
 {
     auto floatValue = static_cast<float>(value);
@@ -117,8 +126,11 @@ void TextLayout::begin(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m)
 {
     if (font == nullptr) return;
 
-    // if already began, do not call bind
-    if (!began)
+    // if already began, do not call bind, but render the pending line
+    // with the previous matrices
+    if (began)
+        flushInternal(false);
+    else
         font->bind();
     font->setMVPMatrices(p, m);
     began = true;
@@ -232,7 +244,11 @@ void TextLayout::renderLine(std::u16string_view line)
     default:
         break;
     }
-    auto [newX, newY] = font->render(line, x, positionY);
+    // Other layouts may have changed the matrices since begin
+    font->setMVPMatrices(projection, modelview);
+    auto [newX, newY] = color.has_value()
+        ? font->render(line, *color, x, positionY)
+        : font->render(line, x, positionY);
     if (layoutDirectionFollowTextAlignment && horizontalAlignment == HorizontalAlignment::Right)
     {
         positionX = x;
@@ -277,6 +293,11 @@ bool TextLayout::processString(std::string_view input, std::vector<std::u16strin
         // For readability, declare `line` outside the if statement
         if (line.empty()) // NOSONAR
             output.emplace_back();
+        else if (UTF8AsciiLength(line) == line.size())
+        {
+            // Nothing to reorder or shape in ASCII text
+            output.emplace_back(line.begin(), line.end());
+        }
         else
         {
             if (!UTF8StringToUnicodeString(line, u16line))
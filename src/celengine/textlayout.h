@@ -10,6 +10,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -17,6 +18,7 @@
 #include <Eigen/Core>
 
 #include <celttf/truetypefont.h>
+#include <celutil/color.h>
 
 namespace celestia::engine
 {
@@ -37,6 +39,9 @@ namespace celestia::engine
  *           3. flush if needed (for example, needed if you change color via glVertexAttrib4f)
  *           4. render text
  *       3. end
+ *
+ *   Text with a color set by setColor is drawn in batches across calls to
+ *   begin and color changes, until the font is flushed.
  */
 class TextLayout
 {
@@ -63,6 +68,10 @@ class TextLayout
     void setHorizontalAlignment(HorizontalAlignment);
     void setScreenDpi(int);
 
+    /// Set the text color; without it, the text color is the value of the
+    /// color attribute when the font is flushed
+    void setColor(const Color&);
+
     /// Sets whether text layout direction follows the specified text alignment, is useful for
     /// distinguishing between (LTR + Right Aligned) vs (RTL)
     /// For example when right aligned with calls render("ABC");render("DEF");render("GHI");
@@ -85,7 +94,7 @@ class TextLayout
     /// @param updateAlignment whether or not to update alignment position to destination
     void moveRelative(float dx, float dy, Unit unit = Unit::PX, bool updateAlignment = true);
 
-    /// Start rendering text
+    /// Start rendering text, or change the matrices of the started session
     /// @param p the projection matrix
     /// @param m the modelview matrix
     void begin(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m = Eigen::Matrix4f::Identity());
@@ -114,6 +123,7 @@ class TextLayout
     std::shared_ptr<TextureFont> font;
 
     HorizontalAlignment horizontalAlignment;
+    std::optional<Color> color;
 
     float positionX{ 0.0f };
     float positionY{ 0.0f };
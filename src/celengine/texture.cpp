@@ -9,24 +9,34 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 #include <Eigen/Core>
 #include "glsupport.h"
 
+#include <celimage/downsample.h>
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/taskscheduler.h>
 #include "framebuffer.h"
 #include "texture.h"
+#include "textureupload.h"
 #include "virtualtex.h"
 
 
 using namespace celestia;
 using celestia::util::GetLogger;
 using celestia::engine::Image;
+using celestia::engine::ImageRowReader;
 using celestia::engine::PixelFormat;
 
 namespace
@@ -262,6 +272,7 @@ LoadMipmapSet(const Image& img, GLenum target)
                          GL_UNSIGNED_BYTE,
                          img.getMipLevel(mip));
         }
+        celestia::gl::countUpload(static_cast<std::size_t>(img.getMipLevelSize(mip)));
     }
 }
 
@@ -292,6 +303,7 @@ LoadMiplessTexture(const Image& img, GLenum target)
                      GL_UNSIGNED_BYTE,
                      img.getMipLevel(0));
     }
+    celestia::gl::countUpload(static_cast<std::size_t>(img.getMipLevelSize(0)));
 }
 
 
@@ -349,6 +361,79 @@ cubeVector(int face, float s, float t)
     return v.normalized();
 }
 
+// Read by the texture loader threads
+std::atomic<int> textureSizeLimit{ 0 };
+
+// Rows handed to a thread at once; textures with fewer rows are evaluated
+// on the calling thread
+constexpr int MinRowsPerThread = 32;
+
+// Evaluate func for the texels of rows [firstRow, lastRow) of a 2D texture,
+// or of a cube map face if face is not negative
+void
+evaluateRows(Image& img, ProceduralTexEval func, int face, int firstRow, int lastRow)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int components = img.getComponents();
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        std::uint8_t* row = img.getPixelRow(y);
+        float v = ((float) y + 0.5f) / (float) height * 2 - 1;
+        for (int x = 0; x < width; x++)
+        {
+            float u = ((float) x + 0.5f) / (float) width * 2 - 1;
+            if (face < 0)
+            {
+                func(u, v, 0, row + x * components);
+            }
+            else
+            {
+                Eigen::Vector3f dir = cubeVector(face, u, v);
+                func(dir.x(), dir.y(), dir.z(), row + x * components);
+            }
+        }
+    }
+}
+
+// Split the image in bands of rows evaluated in parallel by the shared
+// workers and this thread
+std::unique_ptr<Image>
+evaluateProcedural(int width, int height, PixelFormat format, ProceduralTexEval func, int face)
+{
+    auto img = std::make_unique<Image>(format, width, height);
+    celestia::util::ParallelFor(0, static_cast<std::size_t>(height), MinRowsPerThread, [&](std::size_t row)
+    {
+        auto y = static_cast<int>(row);
+        evaluateRows(*img, func, face, y, y + 1);
+    });
+
+    return img;
+}
+
+// Procedural images are kept for the lifetime of the process, so that
+// textures recreated with the same function are only evaluated once
+using ProceduralKey = std::tuple<ProceduralTexEval, int, int, PixelFormat, int>;
+
+std::shared_ptr<const Image>
+getProceduralImage(int width, int height, PixelFormat format, ProceduralTexEval func, int face)
+{
+    static std::mutex cacheMutex;
+    static std::map<ProceduralKey, std::shared_ptr<const Image>> cache;
+
+    ProceduralKey key{ func, width, height, format, face };
+    {
+        std::scoped_lock lock(cacheMutex);
+        if (auto iter = cache.find(key); iter != cache.end())
+            return iter->second;
+    }
+
+    std::shared_ptr<const Image> img = evaluateProcedural(width, height, format, func, face);
+
+    std::scoped_lock lock(cacheMutex);
+    return cache.try_emplace(key, std::move(img)).first->second;
+}
+
 std::unique_ptr<Texture>
 CreateTextureFromImage(const Image& img,
                        Texture::AddressMode addressMode,
@@ -448,11 +533,33 @@ void Texture::setFormatOptions(unsigned int opts)
 ImageTexture::ImageTexture(const Image& img,
                            AddressMode addressMode,
                            MipMapMode mipMapMode) :
+    ImageTexture(img, nullptr, addressMode, mipMapMode)
+{
+}
+
+
+ImageTexture::ImageTexture(std::unique_ptr<Image> img,
+                           AddressMode addressMode,
+                           MipMapMode mipMapMode) :
+    ImageTexture(*img, &img, addressMode, mipMapMode)
+{
+}
+
+
+// If owner isn't null, it holds img and may be taken by the uploader
+ImageTexture::ImageTexture(const Image& img,
+                           std::unique_ptr<Image>* owner,
+                           AddressMode addressMode,
+                           MipMapMode mipMapMode) :
     Texture(img.getWidth(), img.getHeight()),
     glName(0)
 {
+    alpha = img.hasAlpha();
+    compressed = img.isCompressed();
+    memorySize = static_cast<std::size_t>(img.getSize());
+
     glGenTextures(1, &glName);
-    glBindTexture(GL_TEXTURE_2D, glName);
+    gl::bindTexture(GL_TEXTURE_2D, glName);
 
     bool mipmap = mipMapMode != NoMipMaps;
     bool precomputedMipMaps = false;
@@ -494,7 +601,15 @@ ImageTexture::ImageTexture(const Image& img,
     {
         if (precomputedMipMaps)
         {
-            LoadMipmapSet(img, GL_TEXTURE_2D);
+            // img is gone if the uploader has taken it
+            if (owner == nullptr ||
+                !engine::GetTextureUploader()->upload(glName,
+                                                      getInternalFormat(img.getFormat()),
+                                                      getExternalFormat(img.getFormat()),
+                                                      *owner))
+            {
+                LoadMipmapSet(img, GL_TEXTURE_2D);
+            }
         }
         else if (mipMapMode == DefaultMipMaps)
         {
@@ -514,21 +629,25 @@ ImageTexture::ImageTexture(const Image& img,
     if (genMipmaps && FramebufferObject::isSupported())
         glGenerateMipmap(GL_TEXTURE_2D);
 
-    alpha = img.hasAlpha();
-    compressed = img.isCompressed();
+    // A generated mipmap chain adds about a third to the base level
+    if (genMipmaps)
+        memorySize += memorySize / 3;
 }
 
 
 ImageTexture::~ImageTexture()
 {
     if (glName != 0)
-        glDeleteTextures(1, &glName);
+    {
+        engine::GetTextureUploader()->cancel(glName);
+        gl::deleteTextures(1, &glName);
+    }
 }
 
 
 void ImageTexture::bind()
 {
-    glBindTexture(GL_TEXTURE_2D, glName);
+    gl::bindTexture(GL_TEXTURE_2D, glName);
 }
 
 
@@ -605,7 +724,7 @@ TiledTexture::TiledTexture(const Image& img,
         {
             // Create the texture and set up sampling and addressing
             glGenTextures(1, &glNames[v * uSplit + u]);
-            glBindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
+            gl::bindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
@@ -713,6 +832,68 @@ TiledTexture::TiledTexture(const Image& img,
     }
 
     delete tile;
+
+    memorySize = static_cast<std::size_t>(img.getSize());
+    if (mipmap && !precomputedMipMaps)
+        memorySize += memorySize / 3;
+}
+
+
+TiledTexture::TiledTexture(std::unique_ptr<engine::ImageRowReader>&& reader,
+                           int _uSplit, int _vSplit,
+                           MipMapMode mipMapMode) :
+    Texture(reader->getWidth(), reader->getHeight()),
+    uSplit(std::max(1, _uSplit)),
+    vSplit(std::max(1, _vSplit)),
+    glNames(nullptr)
+{
+    glNames = new unsigned int[uSplit * vSplit];
+    for (int i = 0; i < uSplit * vSplit; i++)
+        glNames[i] = 0;
+
+    alpha = reader->hasAlpha();
+    compressed = false;
+
+    // Without framebuffer objects, GL_GENERATE_MIPMAP would rebuild the
+    // mipmaps for every strip of rows
+    bool mipmap = mipMapMode != NoMipMaps && FramebufferObject::isSupported();
+
+    GLenum texAddress = GetGLTexAddressMode(EdgeClamp);
+    GLenum internalFormat = getInternalFormat(reader->getFormat());
+    GLenum format = getExternalFormat(reader->getFormat());
+    int tileWidth = reader->getWidth() / uSplit;
+    int tileHeight = reader->getHeight() / vSplit;
+
+    std::vector<GLuint> tiles(uSplit * vSplit);
+    glGenTextures(uSplit * vSplit, tiles.data());
+    for (int i = 0; i < uSplit * vSplit; i++)
+    {
+        glNames[i] = tiles[i];
+        gl::bindTexture(GL_TEXTURE_2D, glNames[i]);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // The mipmap filter is set when the mipmaps of the tile are built
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        if (gl::EXT_texture_filter_anisotropic && GetTextureCaps().preferredAnisotropy > 1)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, GetTextureCaps().preferredAnisotropy);
+        }
+
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat),
+                     tileWidth, tileHeight, 0,
+                     format, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    memorySize = static_cast<std::size_t>(uSplit * vSplit) *
+                 static_cast<std::size_t>(tileHeight) *
+                 static_cast<std::size_t>((tileWidth * reader->getComponents() + 3) & ~0x3);
+    if (mipmap)
+        memorySize += memorySize / 3;
+
+    engine::GetTextureUploader()->uploadTiles(tiles, uSplit, vSplit, format, mipmap, std::move(reader));
 }
 
 
@@ -720,10 +901,11 @@ TiledTexture::~TiledTexture()
 {
     if (glNames != nullptr)
     {
+        engine::GetTextureUploader()->cancel(glNames[0]);
         for (int i = 0; i < uSplit * vSplit; i++)
         {
             if (glNames[i] != 0)
-                glDeleteTextures(1, &glNames[i]);
+                gl::deleteTextures(1, &glNames[i]);
         }
         delete[] glNames;
     }
@@ -741,7 +923,7 @@ void TiledTexture::setBorderColor(Color borderColor)
     {
         for (int j = 0; j < uSplit; j++)
         {
-            glBindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
+            gl::bindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
             SetBorderColor(borderColor, GL_TEXTURE_2D);
         }
     }
@@ -800,7 +982,7 @@ CubeMap::CubeMap(celestia::util::array_view<const Image*> faces) :
         mipmap = false;
 
     glGenTextures(1, &glName);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    gl::bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -834,19 +1016,23 @@ CubeMap::CubeMap(celestia::util::array_view<const Image*> faces) :
     }
     if (genMipmaps && FramebufferObject::isSupported())
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    memorySize = static_cast<std::size_t>(faces[0]->getSize()) * 6;
+    if (genMipmaps)
+        memorySize += memorySize / 3;
 }
 
 
 CubeMap::~CubeMap()
 {
     if (glName != 0)
-        glDeleteTextures(1, &glName);
+        gl::deleteTextures(1, &glName);
 }
 
 
 void CubeMap::bind()
 {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    gl::bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 }
 
 
@@ -874,18 +1060,7 @@ CreateProceduralTexture(int width, int height,
                         Texture::AddressMode addressMode,
                         Texture::MipMapMode mipMode)
 {
-    auto img = std::make_unique<Image>(format, width, height);
-
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x++)
-        {
-            float u = ((float) x + 0.5f) / (float) width * 2 - 1;
-            float v = ((float) y + 0.5f) / (float) height * 2 - 1;
-            func(u, v, 0, img->getPixelRow(y) + x * img->getComponents());
-        }
-    }
-
+    std::shared_ptr<const Image> img = getProceduralImage(width, height, format, func, -1);
     return std::make_unique<ImageTexture>(*img, addressMode, mipMode);
 }
 
@@ -918,29 +1093,13 @@ CreateProceduralCubeMap(int size,
                         PixelFormat format,
                         ProceduralTexEval func)
 {
-    std::array<std::unique_ptr<Image>, 6> faces{ };
-
+    std::array<std::shared_ptr<const Image>, 6> faces{ };
     for (int i = 0; i < 6; i++)
-    {
-        faces[i] = std::make_unique<Image>(format, size, size);
-
-        Image* face = faces[i].get();
-        for (int y = 0; y < size; y++)
-        {
-            for (int x = 0; x < size; x++)
-            {
-                float s = ((float) x + 0.5f) / (float) size * 2 - 1;
-                float t = ((float) y + 0.5f) / (float) size * 2 - 1;
-                Eigen::Vector3f v = cubeVector(i, s, t);
-                func(v.x(), v.y(), v.z(),
-                     face->getPixelRow(y) + x * face->getComponents());
-            }
-        }
-    }
+        faces[i] = getProceduralImage(size, size, format, func, i);
 
     std::array<const Image*, 6> facePtrs;
     std::transform(faces.begin(), faces.end(), facePtrs.begin(),
-                   [](const std::unique_ptr<Image>& iptr) { return iptr.get(); });
+                   [](const std::shared_ptr<const Image>& iptr) { return iptr.get(); });
 
     return std::make_unique<CubeMap>(facePtrs);
 }
@@ -953,29 +1112,141 @@ LoadTextureFromFile(const fs::path& filename,
                     Texture::Colorspace colorspace)
 {
     // Check for a Celestia texture--these need to be handled specially.
-    ContentType contentType = DetermineFileType(filename);
-
-    if (contentType == ContentType::CelestiaTexture)
+    if (DetermineFileType(filename) == ContentType::CelestiaTexture)
         return LoadVirtualTexture(filename);
 
+    if (auto reader = OpenTiledTextureRows(filename, colorspace); reader != nullptr)
+        return CreateTiledTexture(std::move(reader), mipMode);
+
     // All other texture types are handled by first loading an image, then
     // creating a texture from that image.
-    std::unique_ptr<Image> img = Image::load(filename);
+    std::unique_ptr<Image> img = LoadTextureImage(filename, colorspace);
     if (img == nullptr)
         return nullptr;
 
-    if (colorspace == Texture::LinearColorspace)
+    return CreateTextureFromImage(std::move(img), filename, addressMode, mipMode);
+}
+
+
+// Load a height map texture from a file and convert it to a normal map.
+std::unique_ptr<Texture>
+LoadHeightMapFromFile(const fs::path& filename,
+                      float height,
+                      Texture::AddressMode addressMode)
+{
+    auto normalMap = LoadHeightMapImage(filename, height, addressMode);
+    if (normalMap == nullptr)
+        return nullptr;
+
+    return CreateTextureFromImage(*normalMap, addressMode, Texture::DefaultMipMaps);
+}
+
+
+std::unique_ptr<Image>
+LoadTextureImage(const fs::path& filename, Texture::Colorspace colorspace)
+{
+    std::unique_ptr<Image> img = Image::load(filename, textureSizeLimit);
+    if (img != nullptr && colorspace == Texture::LinearColorspace)
         img->forceLinear();
+    return img;
+}
+
+
+std::unique_ptr<Image>
+LoadHeightMapImage(const fs::path& filename,
+                   float height,
+                   Texture::AddressMode addressMode)
+{
+    auto img = Image::load(filename, textureSizeLimit);
+    if (img == nullptr)
+        return nullptr;
+
+    img->forceLinear();
+
+    return img->computeNormalMap(height, addressMode == Texture::Wrap);
+}
+
+
+std::unique_ptr<ImageRowReader>
+OpenTiledTextureRows(const fs::path& filename, Texture::Colorspace colorspace)
+{
+    const int maxDim = gl::maxTextureSize;
+    std::unique_ptr<ImageRowReader> reader = ImageRowReader::open(filename);
+    if (reader == nullptr ||
+        (reader->getWidth() <= maxDim && reader->getHeight() <= maxDim) ||
+        engine::DownsampleFactor(reader->getWidth(), reader->getHeight(), textureSizeLimit) > 1)
+    {
+        return nullptr;
+    }
+
+    if (colorspace == Texture::LinearColorspace)
+        reader->forceLinear();
+    return reader;
+}
+
+
+std::unique_ptr<Texture>
+CreateTiledTexture(std::unique_ptr<ImageRowReader>&& reader, Texture::MipMapMode mipMode)
+{
+    // Split like the images loaded at once
+    const int maxDim = gl::maxTextureSize;
+    int uSplit = std::max(1, reader->getWidth() / maxDim);
+    int vSplit = std::max(1, reader->getHeight() / maxDim);
+    GetLogger()->info(_("Creating streamed tiled texture. Width={}, max={}\n"),
+                      reader->getWidth(), maxDim);
+    return std::make_unique<TiledTexture>(std::move(reader), uSplit, vSplit, mipMode);
+}
+
+
+void
+SetTextureSizeLimit(int maxSize)
+{
+    textureSizeLimit = std::max(maxSize, 0);
+}
+
+
+int
+GetTextureSizeLimit()
+{
+    return textureSizeLimit;
+}
+
+
+void
+AddTextureMipmaps(std::unique_ptr<Image>& img, Texture::Colorspace colorspace)
+{
+    // Tiled textures don't support uncompressed precomputed mipmaps
+    if (img == nullptr ||
+        img->isCompressed() ||
+        img->getMipLevelCount() > 1 ||
+        img->getWidth() > gl::maxTextureSize ||
+        img->getHeight() > gl::maxTextureSize)
+    {
+        return;
+    }
+
+    // Color textures hold sRGB values, whether or not they are treated as
+    // sRGB on the GPU
+    if (auto mipmapped = img->computeMipmaps(colorspace != Texture::LinearColorspace); mipmapped != nullptr)
+        img = std::move(mipmapped);
+}
 
-    std::unique_ptr<Texture> tex = CreateTextureFromImage(*img, addressMode, mipMode);
 
-    if (contentType == ContentType::DXT5NormalMap)
+std::unique_ptr<Texture>
+CreateTextureFromImage(const Image& img,
+                       const fs::path& filename,
+                       Texture::AddressMode addressMode,
+                       Texture::MipMapMode mipMode)
+{
+    std::unique_ptr<Texture> tex = CreateTextureFromImage(img, addressMode, mipMode);
+
+    if (DetermineFileType(filename) == ContentType::DXT5NormalMap)
     {
         // If the texture came from a .dxt5nm file then mark it as a dxt5
         // compressed normal map. There's no separate OpenGL format for dxt5
         // normal maps, so the file extension is the only thing that
         // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == PixelFormat::DXT5)
+        if (img.getFormat() == PixelFormat::DXT5)
         {
             tex->setFormatOptions(Texture::DXT5NormalMap);
         }
@@ -985,21 +1256,24 @@ LoadTextureFromFile(const fs::path& filename,
 }
 
 
-// Load a height map texture from a file and convert it to a normal map.
 std::unique_ptr<Texture>
-LoadHeightMapFromFile(const fs::path& filename,
-                      float height,
-                      Texture::AddressMode addressMode)
+CreateTextureFromImage(std::unique_ptr<Image>&& img,
+                       const fs::path& filename,
+                       Texture::AddressMode addressMode,
+                       Texture::MipMapMode mipMode)
 {
-    auto img = Image::load(filename);
-    if (img == nullptr)
-        return nullptr;
+    const int maxDim = gl::maxTextureSize;
+    if (img->getWidth() > maxDim || img->getHeight() > maxDim)
+        return CreateTextureFromImage(*img, filename, addressMode, mipMode);
 
-    img->forceLinear();
+    bool dxt5NormalMap = DetermineFileType(filename) == ContentType::DXT5NormalMap &&
+                         img->getFormat() == PixelFormat::DXT5;
 
-    auto normalMap = img->computeNormalMap(height, addressMode == Texture::Wrap);
-    if (normalMap == nullptr)
-        return nullptr;
+    GetLogger()->info(_("Creating ordinary texture: {}x{}\n"),
+                      img->getWidth(), img->getHeight());
+    auto tex = std::make_unique<ImageTexture>(std::move(img), addressMode, mipMode);
+    if (dxt5NormalMap)
+        tex->setFormatOptions(Texture::DXT5NormalMap);
 
-    return CreateTextureFromImage(*normalMap, addressMode, Texture::DefaultMipMaps);
+    return tex;
 }
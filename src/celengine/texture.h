@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -19,6 +20,9 @@
 #include <celutil/array_view.h>
 #include <celutil/color.h>
 
+// Procedural texture functions are evaluated in parallel, and the result is
+// shared by all textures created with the same function, size and format, so
+// they must depend only on their arguments.
 typedef void (*ProceduralTexEval)(float, float, float, std::uint8_t*);
 
 
@@ -76,6 +80,9 @@ class Texture
     bool hasAlpha() const { return alpha; }
     bool isCompressed() const { return compressed; }
 
+    //! Approximate size of the texture in graphics memory, including mipmaps
+    std::size_t getMemorySize() const { return memorySize; }
+
     /*! Identical formats may need to be treated in slightly different
      *  fashions. One (and currently the only) example is the DXT5 compressed
      *  normal map format, which is an ordinary DXT5 texture but requires some
@@ -115,6 +122,7 @@ class Texture
  protected:
     bool alpha{ false };
     bool compressed{ false };
+    std::size_t memorySize{ 0 };
 
  private:
     int width;
@@ -129,6 +137,9 @@ class ImageTexture : public Texture
 {
  public:
     ImageTexture(const celestia::engine::Image& img, AddressMode, MipMapMode);
+    // Large images with a complete set of mipmaps may be kept by the
+    // texture uploader and uploaded over several frames
+    ImageTexture(std::unique_ptr<celestia::engine::Image> img, AddressMode, MipMapMode);
     ~ImageTexture();
 
     TextureTile getTile(int lod, int u, int v) override;
@@ -138,6 +149,11 @@ class ImageTexture : public Texture
     unsigned int getName() const;
 
  private:
+    ImageTexture(const celestia::engine::Image& img,
+                 std::unique_ptr<celestia::engine::Image>* owner,
+                 AddressMode,
+                 MipMapMode);
+
     unsigned int glName;
 };
 
@@ -146,6 +162,10 @@ class TiledTexture : public Texture
 {
  public:
     TiledTexture(const celestia::engine::Image& img, int _uSplit, int _vSplit, MipMapMode);
+    // The tiles are uploaded from rows decoded a few at a time, see
+    // TextureUploader::uploadTiles
+    TiledTexture(std::unique_ptr<celestia::engine::ImageRowReader>&& reader,
+                 int _uSplit, int _vSplit, MipMapMode);
     ~TiledTexture();
 
     TextureTile getTile(int lod, int u, int v) override;
@@ -205,3 +225,58 @@ std::unique_ptr<Texture>
 LoadHeightMapFromFile(const fs::path& filename,
                       float height,
                       Texture::AddressMode addressMode = Texture::EdgeClamp);
+
+// Texture files may also be loaded in two steps: the image is read by
+// LoadTextureImage or LoadHeightMapImage, which don't use OpenGL and may run
+// on any thread, and the texture is then created on the thread owning the
+// GL context. Virtual textures can't be loaded this way.
+std::unique_ptr<celestia::engine::Image>
+LoadTextureImage(const fs::path& filename,
+                 Texture::Colorspace colorspace = Texture::DefaultColorspace);
+
+// The normal map computed from a height map
+std::unique_ptr<celestia::engine::Image>
+LoadHeightMapImage(const fs::path& filename,
+                   float height,
+                   Texture::AddressMode addressMode = Texture::EdgeClamp);
+
+// Images too large for a single texture are split into tiles; those which
+// can be read in rows are streamed into the tiles without decoding them at
+// once. OpenTiledTextureRows returns nullptr for other images, and when
+// the image will be reduced to the texture size limit. Like
+// LoadTextureImage, it may run on any thread.
+std::unique_ptr<celestia::engine::ImageRowReader>
+OpenTiledTextureRows(const fs::path& filename,
+                     Texture::Colorspace colorspace = Texture::DefaultColorspace);
+
+std::unique_ptr<Texture>
+CreateTiledTexture(std::unique_ptr<celestia::engine::ImageRowReader>&& reader,
+                   Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+
+// Largest width or height of the images loaded by LoadTextureImage and
+// LoadHeightMapImage, larger ones are reduced by a power of two while they
+// are decoded; 0 sets no limit
+void SetTextureSizeLimit(int maxSize);
+int GetTextureSizeLimit();
+
+// Build the mipmaps of an image which will be used with DefaultMipMaps, so
+// that they don't have to be generated on the GL thread. Images without
+// mipmaps which won't be split into tiles are replaced; others are left
+// as they are. May run on any thread after the GL context is initialized.
+void AddTextureMipmaps(std::unique_ptr<celestia::engine::Image>& img,
+                       Texture::Colorspace colorspace = Texture::DefaultColorspace);
+
+// filename is the file the image was read from, it's needed to recognize
+// DXT5 compressed normal maps
+std::unique_ptr<Texture>
+CreateTextureFromImage(const celestia::engine::Image& img,
+                       const fs::path& filename,
+                       Texture::AddressMode addressMode = Texture::EdgeClamp,
+                       Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+
+// As above, but the image may be kept to upload it over several frames
+std::unique_ptr<Texture>
+CreateTextureFromImage(std::unique_ptr<celestia::engine::Image>&& img,
+                       const fs::path& filename,
+                       Texture::AddressMode addressMode = Texture::EdgeClamp,
+                       Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
@@ -0,0 +1,147 @@
+// texturecache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "texturecache.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include <celimage/dds_compress.h>
+#include <celimage/image.h>
+#include <celimage/imageformats.h>
+#include <celutil/filetype.h>
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+std::atomic<bool> cacheEnabled{ false };
+
+bool
+isCacheable(const fs::path& filename)
+{
+    switch (DetermineFileType(filename))
+    {
+    case ContentType::JPEG:
+    case ContentType::PNG:
+    case ContentType::BMP:
+#ifdef USE_LIBAVIF
+    case ContentType::AVIF:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Write to a file private to this thread and move it in place, so that
+// concurrent loads of the same texture never see a partial file
+void
+storeCachedImage(const fs::path& cachePath, const Image& image, fs::file_time_type sourceTime)
+{
+    std::error_code ec;
+    fs::create_directories(cachePath.parent_path(), ec);
+    if (ec)
+    {
+        GetLogger()->debug("Can't create texture cache directory {}: {}\n", cachePath.parent_path(), ec.message());
+        return;
+    }
+
+    fs::path tempPath = cachePath;
+    tempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    if (!SaveDDSImage(tempPath, image))
+    {
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    fs::last_write_time(tempPath, sourceTime, ec);
+    if (!ec)
+        fs::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        GetLogger()->debug("Can't add {} to the texture cache: {}\n", cachePath, ec.message());
+        fs::remove(tempPath, ec);
+    }
+}
+
+} // end unnamed namespace
+
+
+void
+SetTextureCacheEnabled(bool enabled)
+{
+    cacheEnabled = enabled;
+}
+
+
+bool
+IsTextureCacheEnabled()
+{
+    return cacheEnabled;
+}
+
+
+fs::path
+GetTextureCachePath(const fs::path& filename, int maxSize)
+{
+    fs::path name = filename.filename();
+    if (maxSize > 0)
+        name += fmt::format(".{}", maxSize);
+    name += ".dds";
+    return filename.parent_path() / ".texcache" / name;
+}
+
+
+std::unique_ptr<Image>
+LoadCachedTextureImage(const fs::path& filename, int maxSize)
+{
+    if (!cacheEnabled || !isCacheable(filename))
+        return Image::load(filename, maxSize);
+
+    std::error_code ec;
+    fs::file_time_type sourceTime = fs::last_write_time(filename, ec);
+    if (ec)
+        return Image::load(filename, maxSize);
+
+    fs::path cachePath = GetTextureCachePath(filename, maxSize);
+    if (auto cacheTime = fs::last_write_time(cachePath, ec); !ec && cacheTime == sourceTime)
+    {
+        if (std::unique_ptr<Image> cached = Image::load(cachePath); cached != nullptr)
+            return cached;
+        GetLogger()->warn("Ignoring broken texture cache file {}\n", cachePath);
+    }
+
+    std::unique_ptr<Image> img = Image::load(filename, maxSize);
+    if (img == nullptr)
+        return nullptr;
+
+    // Keep the level 0 blocks aligned to the image edges
+    if ((img->getWidth() & 3) != 0 || (img->getHeight() & 3) != 0)
+        return img;
+
+    std::unique_ptr<Image> compressed = CompressImageDXT(*img);
+    if (compressed == nullptr)
+        return img;
+
+    storeCachedImage(cachePath, *compressed, sourceTime);
+    return compressed;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,37 @@
+// texturecache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::engine
+{
+
+class Image;
+
+// The cache stores DXT compressed copies of JPEG, PNG, BMP and AVIF
+// textures, with a complete set of mipmaps, as DDS files in a .texcache
+// directory next to the source file. A cached copy is used as long as its
+// modification time matches the one of the source file.
+void SetTextureCacheEnabled(bool enabled);
+bool IsTextureCacheEnabled();
+
+// Load the image from the cache, or load and compress the source image
+// and add it to the cache. Images which can't be compressed are returned
+// as they are. Images are reduced to maxSize as by Image::load; there are
+// separate cached copies for each size. Safe to call from several threads.
+std::unique_ptr<Image> LoadCachedTextureImage(const fs::path& filename, int maxSize = 0);
+
+// Path of the cached copy of a source file
+fs::path GetTextureCachePath(const fs::path& filename, int maxSize = 0);
+
+} // end namespace celestia::engine
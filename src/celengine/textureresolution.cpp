@@ -0,0 +1,146 @@
+// textureresolution.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Chooses the resolution of the textures of each body automatically.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "textureresolution.h"
+
+#include <algorithm>
+
+#include "frameprofiler.h"
+#include "multitexture.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Disc radii in pixels from which the medium and high resolutions are
+// used. The visible half of a body shows about half the width of its
+// texture over the diameter of the disc, so these are where the low and
+// medium resolution textures of the usual sizes start to be magnified.
+constexpr float MedResRadius = 128.0f;
+constexpr float HiResRadius = 512.0f;
+
+// Fractions of the memory budget above which the resolution is lowered
+// and below which it may be raised
+constexpr double MemoryHighWater = 0.9;
+constexpr double MemoryLowWater = 0.6;
+
+// Fractions of the target frame time, the same way
+constexpr double FrameTimeHighWater = 1.25;
+constexpr double FrameTimeLowWater = 0.75;
+
+// Frames to wait after a change before lowering the resolution again,
+// while the lower resolution textures are loaded and the others evicted
+constexpr unsigned int DemotionInterval = 30;
+// Frames without pressure before the resolution is raised
+constexpr unsigned int PromotionFrames = 240;
+
+} // end unnamed namespace
+
+TextureResolutionSelector::TextureResolutionSelector() :
+    m_maxResolution(hires)
+{
+}
+
+void
+TextureResolutionSelector::setTargetFrameTime(double frameTime)
+{
+    if (frameTime > 0.0)
+        m_targetFrameTime = frameTime;
+}
+
+double
+TextureResolutionSelector::getTargetFrameTime() const
+{
+    return m_targetFrameTime;
+}
+
+unsigned int
+TextureResolutionSelector::getMaxResolution() const
+{
+    return m_maxResolution;
+}
+
+unsigned int
+TextureResolutionSelector::select(float discSizeInPixels) const
+{
+    unsigned int resolution = lores;
+    if (discSizeInPixels >= HiResRadius)
+        resolution = hires;
+    else if (discSizeInPixels >= MedResRadius)
+        resolution = medres;
+
+    return std::min(resolution, m_maxResolution);
+}
+
+void
+TextureResolutionSelector::update(const FrameProfiler& profiler, std::size_t residentSize, std::size_t budget)
+{
+    const FrameProfiler::FrameTimes& times = profiler.lastFrame();
+    if (profiler.isEnabled() && times.frame != m_lastFrame)
+    {
+        m_lastFrame = times.frame;
+        auto frame = static_cast<std::size_t>(FrameProfiler::Section::Frame);
+        m_lastFrameTime = times.hasGpuTimes ? times.gpu[frame] : times.cpu[frame];
+    }
+    else if (!profiler.isEnabled())
+    {
+        m_lastFrameTime = 0.0;
+    }
+
+    update(m_lastFrameTime, residentSize, budget);
+}
+
+void
+TextureResolutionSelector::update(double frameTime, std::size_t residentSize, std::size_t budget)
+{
+    auto memory = static_cast<double>(residentSize);
+    bool memoryPressure = budget > 0 && memory > MemoryHighWater * static_cast<double>(budget);
+    bool framePressure = frameTime > FrameTimeHighWater * m_targetFrameTime;
+
+    m_framesSinceChange++;
+    if (memoryPressure || framePressure)
+    {
+        m_calmFrames = 0;
+        if (m_maxResolution > lores && m_framesSinceChange >= DemotionInterval)
+        {
+            m_maxResolution--;
+            m_framesSinceChange = 0;
+        }
+        return;
+    }
+
+    bool memoryCalm = budget == 0 || memory < MemoryLowWater * static_cast<double>(budget);
+    bool frameCalm = frameTime < FrameTimeLowWater * m_targetFrameTime;
+    if (!memoryCalm || !frameCalm)
+    {
+        m_calmFrames = 0;
+        return;
+    }
+
+    if (++m_calmFrames >= PromotionFrames && m_maxResolution < hires)
+    {
+        m_maxResolution++;
+        m_calmFrames = 0;
+        m_framesSinceChange = 0;
+    }
+}
+
+void
+TextureResolutionSelector::reset()
+{
+    m_maxResolution = hires;
+    m_framesSinceChange = 0;
+    m_calmFrames = 0;
+}
+
+} // end namespace celestia::engine
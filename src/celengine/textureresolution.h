@@ -0,0 +1,65 @@
+// textureresolution.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Chooses the resolution of the textures of each body automatically.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace celestia::engine
+{
+
+class FrameProfiler;
+
+/*! Chooses the MultiResTexture resolution of a body from the size of its
+ *  disc on screen, so that only the bodies which cover many pixels use the
+ *  high resolution textures. The highest resolution allowed is lowered by
+ *  one level when the resident textures come close to the memory budget or
+ *  frames take longer than the target time, and raised again after both
+ *  have stayed well below their limits for a while. Each change waits for
+ *  the previous one to take effect, as the textures it requests are loaded
+ *  over the following frames.
+ */
+class TextureResolutionSelector
+{
+public:
+    TextureResolutionSelector();
+
+    // Milliseconds
+    void setTargetFrameTime(double);
+    double getTargetFrameTime() const;
+
+    unsigned int getMaxResolution() const;
+
+    // Resolution for a body whose disc has a radius of discSizeInPixels
+    unsigned int select(float discSizeInPixels) const;
+
+    // Update the highest resolution from the last complete frame of the
+    // profiler, if it is enabled, and the texture memory; called once per
+    // frame. A budget of 0 is no limit.
+    void update(const FrameProfiler&, std::size_t residentSize, std::size_t budget);
+    // Same with the time of the last frame, 0 if it isn't known
+    void update(double frameTime, std::size_t residentSize, std::size_t budget);
+
+    void reset();
+
+private:
+    double m_targetFrameTime{ 1000.0 / 60.0 };
+    double m_lastFrameTime{ 0.0 };
+    std::uint64_t m_lastFrame{ 0 };
+    unsigned int m_maxResolution;
+    // Frames since the highest resolution last changed
+    unsigned int m_framesSinceChange{ 0 };
+    // Frames in a row without any pressure
+    unsigned int m_calmFrames{ 0 };
+};
+
+} // end namespace celestia::engine
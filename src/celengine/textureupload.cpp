@@ -0,0 +1,441 @@
+// textureupload.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "textureupload.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <celimage/image.h>
+#include <celutil/logger.h>
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Rows decoded at a time when the tiles are uploaded at once
+constexpr int SynchronousStripRows = 64;
+
+// Texture rows are padded to 4 bytes, the default unpack alignment
+std::size_t
+padRow(int n)
+{
+    return static_cast<std::size_t>((n + 3) & ~0x3);
+}
+
+} // end unnamed namespace
+
+
+TextureUploader::~TextureUploader()
+{
+    clear();
+}
+
+
+void
+TextureUploader::clear()
+{
+    for (GLsync& fence : fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (mappedRing != nullptr)
+    {
+        buffer.bind();
+        buffer.unmap();
+        buffer.unbind();
+        mappedRing = nullptr;
+    }
+
+    buffer = gl::Buffer(util::NoCreateT{});
+    segment = 0;
+}
+
+
+void
+TextureUploader::setChunkSize(std::size_t _chunkSize)
+{
+    assert(jobs.empty());
+    clear();
+
+#ifdef GL_ES
+    bool supported = gl::checkVersion(gl::GLES_3_0);
+    mapRange = supported;
+    persistent = false;
+#else
+    bool supported = true;
+    mapRange = gl::ARB_map_buffer_range;
+    persistent = gl::ARB_buffer_storage && gl::ARB_sync && mapRange;
+#endif
+
+    chunkSize = supported ? _chunkSize : 0;
+    if (chunkSize == 0)
+        return;
+
+    buffer = gl::Buffer(gl::Buffer::TargetHint::PixelUnpack);
+    buffer.bind();
+#ifndef GL_ES
+    if (persistent)
+    {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        auto ringSize = static_cast<GLsizeiptr>(chunkSize * RingSegments);
+        buffer.setStorage(ringSize, flags);
+        mappedRing = static_cast<std::uint8_t*>(buffer.mapRange(0, ringSize, flags));
+        if (mappedRing == nullptr)
+        {
+            // Immutable storage can't be reallocated
+            persistent = false;
+            buffer = gl::Buffer(gl::Buffer::TargetHint::PixelUnpack);
+            buffer.bind();
+        }
+    }
+#endif
+    if (!persistent)
+        buffer.setData(util::array_view<const void>(nullptr, chunkSize), gl::Buffer::BufferUsage::StreamDraw);
+    buffer.unbind();
+}
+
+
+bool
+TextureUploader::upload(GLuint texture,
+                        GLenum internalFormat,
+                        GLenum format,
+                        std::unique_ptr<Image>& image)
+{
+    if (chunkSize == 0 || image == nullptr || static_cast<std::size_t>(image->getSize()) <= chunkSize)
+        return false;
+
+    // Only the levels uploaded so far are used
+    int levels = image->getMipLevelCount();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    for (int level = 0; level < levels; ++level)
+    {
+        int width = std::max(image->getWidth() >> level, 1);
+        int height = std::max(image->getHeight() >> level, 1);
+        if (image->isCompressed())
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat,
+                                   width, height, 0,
+                                   image->getMipLevelSize(level), nullptr);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internalFormat),
+                         width, height, 0,
+                         format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    jobs.push_back(Job{ texture, internalFormat, format, std::move(image), levels - 1 });
+    return true;
+}
+
+
+void
+TextureUploader::uploadTiles(const std::vector<GLuint>& tiles,
+                             int uSplit,
+                             int vSplit,
+                             GLenum format,
+                             bool mipmaps,
+                             std::unique_ptr<ImageRowReader>&& reader)
+{
+    TileJob job{ tiles, uSplit, vSplit, format, mipmaps, std::move(reader) };
+    if (chunkSize > 0)
+    {
+        tileJobs.push_back(std::move(job));
+        return;
+    }
+
+    while (job.reader != nullptr)
+        processTiles(job);
+}
+
+
+void
+TextureUploader::cancel(GLuint texture)
+{
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                              [texture](const Job& job) { return job.texture == texture; }),
+               jobs.end());
+    tileJobs.erase(std::remove_if(tileJobs.begin(), tileJobs.end(),
+                                  [texture](const TileJob& job) { return job.tiles.front() == texture; }),
+                   tileJobs.end());
+}
+
+
+// Copy a chunk to the pixel buffer, returns false if no part of the buffer
+// can be written without waiting for the GPU
+bool
+TextureUploader::writeChunk(const std::uint8_t* data, std::size_t size, GLintptr& offset)
+{
+    if (persistent)
+    {
+        GLsync& fence = fences[segment];
+        if (fence != nullptr)
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return false;
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        offset = static_cast<GLintptr>(segment * chunkSize);
+        std::memcpy(mappedRing + offset, data, size);
+        gl::countUpload(size);
+        return true;
+    }
+
+    // Orphan the storage, so that the driver doesn't wait for the upload
+    // of the previous chunk
+    buffer.invalidateData();
+    offset = 0;
+    if (mapRange)
+    {
+        if (void* dest = buffer.mapRange(0, static_cast<GLsizeiptr>(size),
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            dest != nullptr)
+        {
+            std::memcpy(dest, data, size);
+            gl::countUpload(size);
+            return buffer.unmap();
+        }
+    }
+
+    buffer.setSubData(0, util::array_view<const void>(data, size));
+    return true;
+}
+
+
+void
+TextureUploader::releaseChunk()
+{
+    if (!persistent)
+        return;
+
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % RingSegments;
+}
+
+
+// Upload the part of the current strip of rows in the next tile, decoding
+// the strip first if needed. The reader is released once all tiles are
+// complete or it fails. Returns false if no part of the pixel buffer can be
+// written without waiting for the GPU.
+bool
+TextureUploader::processTiles(TileJob& job)
+{
+    ImageRowReader& reader = *job.reader;
+    int tileWidth = reader.getWidth() / job.uSplit;
+    int tileHeight = reader.getHeight() / job.vSplit;
+    auto tileRowSize = static_cast<std::size_t>(tileWidth * reader.getComponents());
+    std::size_t tilePitch = padRow(tileWidth * reader.getComponents());
+    auto pitch = static_cast<std::size_t>(reader.getPitch());
+
+    // Strips don't cross the edges of the tiles, and the part of a strip in
+    // a tile fits into a chunk
+    if (job.stripRows == 0)
+    {
+        int chunkRows = chunkSize == 0
+                      ? SynchronousStripRows
+                      : std::max(static_cast<int>(chunkSize / tilePitch), 1);
+        job.stripRows = std::min(chunkRows, tileHeight - job.row % tileHeight);
+        job.strip.resize(static_cast<std::size_t>(job.stripRows) * pitch);
+        job.stripTile = 0;
+        if (!reader.read(job.strip.data(), job.stripRows))
+        {
+            util::GetLogger()->error("Error reading row {} of a tiled texture\n", job.row);
+            job.reader = nullptr;
+            return true;
+        }
+    }
+
+    std::size_t size = static_cast<std::size_t>(job.stripRows) * tilePitch;
+    job.tileRows.resize(size);
+    const std::uint8_t* source = job.strip.data() + static_cast<std::size_t>(job.stripTile) * tileRowSize;
+    for (int y = 0; y < job.stripRows; ++y)
+        std::memcpy(job.tileRows.data() + y * tilePitch, source + y * pitch, tileRowSize);
+
+    // Parts which don't fit into a chunk are uploaded from client memory
+    const void* pixels = job.tileRows.data();
+    bool buffered = chunkSize > 0 && size <= chunkSize;
+    if (buffered)
+    {
+        GLintptr offset;
+        if (!writeChunk(job.tileRows.data(), size, offset))
+            return false;
+        pixels = reinterpret_cast<const void*>(offset);
+    }
+    else if (chunkSize > 0)
+    {
+        buffer.unbind();
+    }
+
+    int v = job.row / tileHeight;
+    gl::bindTexture(GL_TEXTURE_2D, job.tiles[v * job.uSplit + job.stripTile]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.row % tileHeight, tileWidth, job.stripRows,
+                    job.format, GL_UNSIGNED_BYTE, pixels);
+
+    if (buffered)
+    {
+        releaseChunk();
+    }
+    else
+    {
+        gl::countUpload(size);
+        if (chunkSize > 0)
+            buffer.bind();
+    }
+
+    if (++job.stripTile < job.uSplit)
+        return true;
+
+    job.row += job.stripRows;
+    job.stripRows = 0;
+    if (job.row % tileHeight != 0)
+        return true;
+
+    // The tiles of a row are complete
+    if (job.mipmaps)
+    {
+        for (int u = 0; u < job.uSplit; ++u)
+        {
+            gl::bindTexture(GL_TEXTURE_2D, job.tiles[v * job.uSplit + u]);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+    }
+
+    if (v + 1 == job.vSplit)
+        job.reader = nullptr;
+    return true;
+}
+
+
+std::size_t
+TextureUploader::process(std::chrono::steady_clock::duration timeBudget)
+{
+    if (jobs.empty() && tileJobs.empty())
+        return 0;
+
+    auto deadline = std::chrono::steady_clock::now() + timeBudget;
+    std::size_t count = 0;
+    bool waiting = false;
+    buffer.bind();
+    while (!jobs.empty())
+    {
+        Job& job = jobs.front();
+        const Image& image = *job.image;
+        bool compressed = image.isCompressed();
+        int width = std::max(image.getWidth() >> job.level, 1);
+        int height = std::max(image.getHeight() >> job.level, 1);
+
+        // Compressed images are uploaded in rows of 4x4 blocks
+        int rowHeight = compressed ? 4 : 1;
+        int rows = (height + rowHeight - 1) / rowHeight;
+        auto rowSize = static_cast<std::size_t>(image.getMipLevelSize(job.level) / rows);
+        int chunkRows = std::clamp(static_cast<int>(chunkSize / rowSize), 1, rows - job.row);
+        std::size_t size = static_cast<std::size_t>(chunkRows) * rowSize;
+        const std::uint8_t* data = image.getMipLevel(job.level) + job.row * rowSize;
+
+        // Rows which don't fit into a chunk are uploaded from client memory
+        const void* pixels = data;
+        bool buffered = size <= chunkSize;
+        if (buffered)
+        {
+            GLintptr offset;
+            if (!writeChunk(data, size, offset))
+            {
+                waiting = true;
+                break;
+            }
+            pixels = reinterpret_cast<const void*>(offset);
+        }
+        else
+        {
+            buffer.unbind();
+        }
+
+        int y = job.row * rowHeight;
+        int chunkHeight = std::min(chunkRows * rowHeight, height - y);
+        gl::bindTexture(GL_TEXTURE_2D, job.texture);
+        if (compressed)
+        {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, job.level, 0, y, width, chunkHeight,
+                                      job.internalFormat, static_cast<GLsizei>(size), pixels);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, y, width, chunkHeight,
+                            job.format, GL_UNSIGNED_BYTE, pixels);
+        }
+
+        // Chunks copied to the pixel buffer were counted when written
+        if (buffered)
+        {
+            releaseChunk();
+        }
+        else
+        {
+            gl::countUpload(size);
+            buffer.bind();
+        }
+
+        job.row += chunkRows;
+        if (job.row == rows)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+            if (job.level == 0)
+            {
+                jobs.pop_front();
+            }
+            else
+            {
+                --job.level;
+                job.row = 0;
+            }
+        }
+
+        ++count;
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+    }
+
+    while (!waiting && !tileJobs.empty() && std::chrono::steady_clock::now() < deadline)
+    {
+        TileJob& job = tileJobs.front();
+        if (!processTiles(job))
+            break;
+        if (job.reader == nullptr)
+            tileJobs.pop_front();
+        ++count;
+    }
+
+    // Client memory is the source of all other texture uploads
+    buffer.unbind();
+    return count;
+}
+
+
+TextureUploader*
+GetTextureUploader()
+{
+    // Never destroyed, the GL context is gone at exit
+    static TextureUploader* uploader = std::make_unique<TextureUploader>().release();
+    return uploader;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,134 @@
+// textureupload.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <celengine/glsupport.h>
+#include <celrender/gl/buffer.h>
+
+namespace celestia::engine
+{
+
+class Image;
+class ImageRowReader;
+
+// Uploads large textures through pixel buffer objects, in chunks spread
+// over several frames. The mipmap levels are uploaded from the smallest
+// one, and the base level of the texture is lowered as levels complete, so
+// the texture is usable at a lower resolution until it has been uploaded.
+//
+// With OpenGL 4.4 or ARB_buffer_storage the chunks are written to a
+// persistently mapped ring buffer, whose parts are reused once the fence
+// of the previous upload from them has signaled. Otherwise the buffer is
+// orphaned for every chunk. OpenGL ES 2.0 has no pixel buffer objects, and
+// all textures are uploaded at once.
+//
+// Images which are split into tiles are streamed from a row reader instead,
+// a strip of rows at a time, so that only the strip is held in memory.
+class TextureUploader
+{
+public:
+    TextureUploader() = default;
+    ~TextureUploader();
+
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    // Upload textures larger than chunkSize bytes in chunks of that size,
+    // 0 uploads all textures at once. Requires the GL context.
+    void setChunkSize(std::size_t chunkSize);
+
+    // Allocate the levels of the bound texture and queue the upload of the
+    // image, which must have a complete set of mipmaps. The image is taken
+    // and true returned if it is uploaded in chunks.
+    bool upload(GLuint texture,
+                GLenum internalFormat,
+                GLenum format,
+                std::unique_ptr<Image>& image);
+
+    // Queue the upload of an image from reader to the allocated tiles of a
+    // texture split into uSplit x vSplit tiles, tiles[v * uSplit + u]. The
+    // tiles show the rows uploaded so far; with mipmaps, those are generated
+    // once the last row of a tile has been uploaded. Without chunks, the
+    // image is uploaded before returning.
+    void uploadTiles(const std::vector<GLuint>& tiles,
+                     int uSplit,
+                     int vSplit,
+                     GLenum format,
+                     bool mipmaps,
+                     std::unique_ptr<ImageRowReader>&& reader);
+
+    // Drop the queued chunks of a texture which is being deleted, or of all
+    // tiles of a tiled texture given the first one
+    void cancel(GLuint texture);
+
+    // Upload chunks until timeBudget has been used up. Must be called
+    // regularly, e.g. once per frame. Returns the number of chunks uploaded.
+    std::size_t process(std::chrono::steady_clock::duration timeBudget);
+
+private:
+    struct Job
+    {
+        GLuint texture;
+        GLenum internalFormat;
+        GLenum format;
+        std::unique_ptr<Image> image;
+        int level;
+        // Next row of pixels, or of blocks for compressed images
+        int row{ 0 };
+    };
+
+    struct TileJob
+    {
+        std::vector<GLuint> tiles;
+        int uSplit;
+        int vSplit;
+        GLenum format;
+        bool mipmaps;
+        std::unique_ptr<ImageRowReader> reader;
+        // Next row of the image to decode
+        int row{ 0 };
+        // Decoded rows, and the next tile they're uploaded to
+        std::vector<std::uint8_t> strip{ };
+        int stripRows{ 0 };
+        int stripTile{ 0 };
+        // Rows of the strip which belong to a tile
+        std::vector<std::uint8_t> tileRows{ };
+    };
+
+    static constexpr std::size_t RingSegments = 3;
+
+    bool processTiles(TileJob& job);
+
+    bool writeChunk(const std::uint8_t* data, std::size_t size, GLintptr& offset);
+    void releaseChunk();
+    void clear();
+
+    std::size_t chunkSize{ 0 };
+    bool persistent{ false };
+    bool mapRange{ false };
+    gl::Buffer buffer{ util::NoCreateT{} };
+    std::uint8_t* mappedRing{ nullptr };
+    std::array<GLsync, RingSegments> fences{ };
+    std::size_t segment{ 0 };
+    std::deque<Job> jobs;
+    std::deque<TileJob> tileJobs;
+};
+
+TextureUploader* GetTextureUploader();
+
+} // end namespace celestia::engine
@@ -11,6 +11,9 @@
 // of the License, or (at your option) any later version.
 
 #include "celengine/timeline.h"
+
+#include <algorithm>
+
 #include "celengine/timelinephase.h"
 #include "celengine/frametree.h"
 #include "celengine/frame.h"
@@ -45,6 +48,7 @@ Timeline::appendPhase(TimelinePhase::SharedConstPtr &phase)
     }
 
     phases.push_back(phase);
+    endTimes.push_back(phase->endTime());
 
     return true;
 }
@@ -53,24 +57,38 @@ Timeline::appendPhase(TimelinePhase::SharedConstPtr &phase)
 const TimelinePhase::SharedConstPtr&
 Timeline::findPhase(double t) const
 {
-    // Find the phase containing time t. The overwhelming common case is
-    // nPhases = 1, so we special case that. Otherwise, we do a simple linear search,
-    // as the number of phases in a timeline should always be quite small.
-    if (phases.size() == 1)
-    {
+    // Find the phase containing time t: the first one ending after t, or
+    // the final phase if t is past the end of the timeline. The
+    // overwhelming common case is nPhases = 1, so we special case that.
+    std::size_t nPhases = phases.size();
+    if (nPhases == 1)
         return phases[0];
+
+    // Phase i contains t if t is before its end and not before the end of
+    // the previous phase. Try the phase of the last query and the next one
+    // before searching the whole timeline.
+    auto contains = [this, nPhases, t](std::size_t i)
+    {
+        return (i == 0 || t >= endTimes[i - 1]) && (i == nPhases - 1 || t < endTimes[i]);
+    };
+
+    std::size_t hint = lastPhase.load(std::memory_order_relaxed);
+    if (hint < nPhases && contains(hint))
+        return phases[hint];
+
+    std::size_t index;
+    if (hint + 1 < nPhases && contains(hint + 1))
+    {
+        index = hint + 1;
     }
     else
     {
-        for (const auto& phase : phases)
-        {
-            if (t < phase->endTime())
-                return phase;
-        }
-
-        // Time is greater than the end time of the final phase. Just return the final phase.
-        return phases.back();
+        auto it = std::upper_bound(endTimes.begin(), endTimes.end(), t);
+        index = std::min(static_cast<std::size_t>(it - endTimes.begin()), nPhases - 1);
     }
+
+    lastPhase.store(index, std::memory_order_relaxed);
+    return phases[index];
 }
 
 
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <vector>
 #include "timelinephase.h"
@@ -35,4 +37,10 @@ public:
 
 private:
     std::vector<TimelinePhase::SharedConstPtr> phases;
+    // End times of the phases, searched by findPhase
+    std::vector<double> endTimes;
+    // Index of the phase last found, tried first as successive queries
+    // are usually in the same phase or the next one. Shared by the
+    // threads querying the timeline; a stale value only costs a search.
+    mutable std::atomic<std::size_t> lastPhase{ 0 };
 };
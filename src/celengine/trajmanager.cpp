@@ -9,8 +9,15 @@
 
 #include "trajmanager.h"
 
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <system_error>
 
 #include <celutil/filetype.h>
 #include <celutil/logger.h>
@@ -43,8 +50,116 @@ TrajectoryInfo::resolve(const fs::path& baseDir) const
     return ResourceKey(baseDir / source, interpolation, precision);
 }
 
+
+namespace
+{
+
+// The summary of a trajectory file is stored next to it, so that the
+// samples need not be parsed to place the trajectory in the catalog. It
+// records the size and modification time of the trajectory file, and is
+// ignored once they change.
+constexpr std::string_view SummaryMagic{ "CELTRJS\0", 8 };
+
+struct TrajectorySummary
+{
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    double begin;
+    double end;
+    double boundingRadius;
+};
+
+constexpr std::size_t SummarySize = 8 + sizeof(std::uint64_t) + sizeof(std::int64_t) + 3 * sizeof(double);
+
+fs::path
+summaryPath(const fs::path& path)
+{
+    fs::path result = path;
+    result += ".summary";
+    return result;
+}
+
+
+bool
+getFileStamp(const fs::path& path, std::uint64_t& fileSize, std::int64_t& writeTime)
+{
+    std::error_code ec;
+    fileSize = static_cast<std::uint64_t>(fs::file_size(path, ec));
+    if (ec)
+        return false;
+
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return false;
+
+    writeTime = static_cast<std::int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+
+std::optional<TrajectorySummary>
+readSummary(const fs::path& path)
+{
+    TrajectorySummary summary;
+    if (!getFileStamp(path, summary.fileSize, summary.writeTime))
+        return std::nullopt;
+
+    std::array<char, SummarySize> data;
+    std::ifstream in(summaryPath(path), std::ios::in | std::ios::binary);
+    if (!in.read(data.data(), data.size()) || std::string_view(data.data(), SummaryMagic.size()) != SummaryMagic)
+        return std::nullopt;
+
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    const char* ptr = data.data() + SummaryMagic.size();
+    std::memcpy(&fileSize, ptr, sizeof(fileSize));
+    std::memcpy(&writeTime, ptr + 8, sizeof(writeTime));
+    if (fileSize != summary.fileSize || writeTime != summary.writeTime)
+        return std::nullopt;
+
+    std::memcpy(&summary.begin, ptr + 16, sizeof(double));
+    std::memcpy(&summary.end, ptr + 24, sizeof(double));
+    std::memcpy(&summary.boundingRadius, ptr + 32, sizeof(double));
+    if (!(summary.begin <= summary.end))
+        return std::nullopt;
+
+    return summary;
+}
+
+
+// Failing to write the summary, e.g. in a read-only installation, only
+// means that the trajectory is loaded again at the next start.
+void
+writeSummary(const fs::path& path, const celestia::ephem::Orbit& orbit)
+{
+    std::uint64_t fileSize;
+    std::int64_t writeTime;
+    if (!getFileStamp(path, fileSize, writeTime))
+        return;
+
+    double begin;
+    double end;
+    orbit.getValidRange(begin, end);
+    double boundingRadius = orbit.getBoundingRadius();
+
+    std::array<char, SummarySize> data;
+    char* ptr = data.data();
+    std::memcpy(ptr, SummaryMagic.data(), SummaryMagic.size());
+    ptr += SummaryMagic.size();
+    std::memcpy(ptr, &fileSize, sizeof(fileSize));
+    std::memcpy(ptr + 8, &writeTime, sizeof(writeTime));
+    std::memcpy(ptr + 16, &begin, sizeof(double));
+    std::memcpy(ptr + 24, &end, sizeof(double));
+    std::memcpy(ptr + 32, &boundingRadius, sizeof(double));
+
+    std::ofstream out(summaryPath(path), std::ios::out | std::ios::binary);
+    if (!out.write(data.data(), data.size()))
+        GetLogger()->debug("Could not write trajectory summary for {}\n", path);
+}
+
+
 std::unique_ptr<celestia::ephem::Orbit>
-TrajectoryInfo::load(const ResourceKey& key) const
+loadTrajectory(const TrajectoryInfo::ResourceKey& key)
 {
     ContentType filetype = DetermineFileType(key.resolvedPath);
 
@@ -83,15 +198,19 @@ TrajectoryInfo::load(const ResourceKey& key) const
             break;
         }
     }
+    else if (filetype == ContentType::CelestiaXYZVChebyshev)
+    {
+        sampTrajectory = celestia::ephem::LoadXYZVChebyshevTrajectory(key.resolvedPath);
+    }
     else
     {
-        switch (precision)
+        switch (key.precision)
         {
         case TrajectoryPrecision::Single:
-            sampTrajectory = LoadSampledTrajectorySinglePrec(key.resolvedPath, interpolation);
+            sampTrajectory = LoadSampledTrajectorySinglePrec(key.resolvedPath, key.interpolation);
             break;
         case TrajectoryPrecision::Double:
-            sampTrajectory = LoadSampledTrajectoryDoublePrec(key.resolvedPath, interpolation);
+            sampTrajectory = LoadSampledTrajectoryDoublePrec(key.resolvedPath, key.interpolation);
             break;
         default:
             assert(0);
@@ -101,3 +220,93 @@ TrajectoryInfo::load(const ResourceKey& key) const
 
     return sampTrajectory;
 }
+
+
+// Stands in for a sampled trajectory until its samples are needed. The
+// valid range and the bounding radius come from the summary, everything
+// else loads the samples on first use.
+class DeferredTrajectory : public celestia::ephem::Orbit
+{
+public:
+    DeferredTrajectory(const TrajectoryInfo::ResourceKey& _key, const TrajectorySummary& summary) :
+        key(_key),
+        begin(summary.begin),
+        end(summary.end),
+        boundingRadius(summary.boundingRadius)
+    {
+    }
+
+    Eigen::Vector3d positionAtTime(double jd) const override
+    {
+        return get().positionAtTime(jd);
+    }
+
+    Eigen::Vector3d velocityAtTime(double jd) const override
+    {
+        return get().velocityAtTime(jd);
+    }
+
+    void positionsAtTimes(celestia::util::array_view<double> times, Eigen::Vector3d* positions) const override
+    {
+        get().positionsAtTimes(times, positions);
+    }
+
+    void sample(double startTime, double endTime, celestia::ephem::OrbitSampleProc& proc) const override
+    {
+        get().sample(startTime, endTime, proc);
+    }
+
+    double getPeriod() const override { return end - begin; }
+    double getBoundingRadius() const override { return boundingRadius; }
+    bool isPeriodic() const override { return false; }
+
+    void getValidRange(double& _begin, double& _end) const override
+    {
+        _begin = begin;
+        _end = end;
+    }
+
+private:
+    const celestia::ephem::Orbit& get() const
+    {
+        std::call_once(loaded, [this]
+        {
+            orbit = loadTrajectory(key);
+            if (orbit == nullptr)
+            {
+                // The catalog has been loaded already, so keep the object
+                // at the center of its frame
+                GetLogger()->error("Could not load sampled trajectory from {}\n", key.resolvedPath);
+                orbit = std::make_unique<celestia::ephem::FixedOrbit>(Eigen::Vector3d::Zero());
+            }
+        });
+
+        return *orbit;
+    }
+
+    TrajectoryInfo::ResourceKey key;
+    double begin;
+    double end;
+    double boundingRadius;
+    mutable std::once_flag loaded;
+    mutable std::unique_ptr<celestia::ephem::Orbit> orbit;
+};
+
+} // end unnamed namespace
+
+
+std::unique_ptr<celestia::ephem::Orbit>
+TrajectoryInfo::load(const ResourceKey& key) const
+{
+    // Chebyshev trajectories are mapped and read on demand anyway
+    if (DetermineFileType(key.resolvedPath) == ContentType::CelestiaXYZVChebyshev)
+        return loadTrajectory(key);
+
+    if (auto summary = readSummary(key.resolvedPath); summary.has_value())
+        return std::make_unique<DeferredTrajectory>(key, *summary);
+
+    std::unique_ptr<celestia::ephem::Orbit> orbit = loadTrajectory(key);
+    if (orbit != nullptr)
+        writeSummary(key.resolvedPath, *orbit);
+    return orbit;
+}
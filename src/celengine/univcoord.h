@@ -14,10 +14,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <Eigen/Core>
 
 #include <celastro/astro.h>
 #include <celutil/r128.h>
+#include <celutil/array_view.h>
 #include <celutil/r128util.h>
 
 
@@ -71,9 +75,7 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromKm(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z)) * celestia::astro::microLightYearsToKilometers(1.0);
+        return offsetFromUly(uc) * celestia::astro::microLightYearsToKilometers(1.0);
     }
 
     /** Get the offset in light years of this coordinate from a point (also with
@@ -83,9 +85,9 @@ class UniversalCoord
     Eigen::Vector3f offsetFromLy(const Eigen::Vector3f& v) const
     {
         Eigen::Vector3f vUly = v * 1.0e6f;
-        Eigen::Vector3f offsetUly(static_cast<float>(static_cast<double>(x - R128(vUly.x()))),
-                                  static_cast<float>(static_cast<double>(y - R128(vUly.y()))),
-                                  static_cast<float>(static_cast<double>(z - R128(vUly.z()))));
+        Eigen::Vector3f offsetUly(static_cast<float>(difference(x, R128(vUly.x()))),
+                                  static_cast<float>(difference(y, R128(vUly.y()))),
+                                  static_cast<float>(difference(z, R128(vUly.z()))));
         return offsetUly * 1.0e-6f;
     }
 
@@ -99,9 +101,7 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromUly(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z));
+        return Eigen::Vector3d(difference(x, uc.x), difference(y, uc.y), difference(z, uc.z));
     }
 
     /** Get the value of the coordinate in light years. The result is truncated to
@@ -109,9 +109,7 @@ class UniversalCoord
       */
     Eigen::Vector3d toLy() const
     {
-        return Eigen::Vector3d(static_cast<double>(x),
-                               static_cast<double>(y),
-                               static_cast<double>(z)) * 1.0e-6;
+        return Eigen::Vector3d(toDouble(x.hi, x.lo), toDouble(y.hi, y.lo), toDouble(z.hi, z.lo)) * 1.0e-6;
     }
 
     double distanceFromKm(const UniversalCoord& uc)
@@ -158,12 +156,54 @@ class UniversalCoord
         return UniversalCoord(vUly.x(), vUly.y(), vUly.z());
     }
 
+    /** Get the offsets in kilometers of many coordinates from the same origin,
+      * offsets[i] = coords[i].offsetFromKm(origin), rounded to the precision
+      * of T. The offsets array must have room for coords.size() values.
+      */
+    template<typename T>
+    static void OffsetsFromKm(celestia::util::array_view<UniversalCoord> coords,
+                              const UniversalCoord& origin,
+                              Eigen::Matrix<T, 3, 1>* offsets)
+    {
+        const double scale = celestia::astro::microLightYearsToKilometers(1.0);
+        for (std::size_t i = 0; i < coords.size(); ++i)
+            offsets[i] = (coords[i].offsetFromUly(origin) * scale).template cast<T>();
+    }
+
     bool isOutOfBounds() const
     {
         using celestia::util::isOutOfBounds;
         return isOutOfBounds(x) || isOutOfBounds(y) || isOutOfBounds(z);
     }
 
+private:
+    /** Convert a 64.64 fixed point value to double like R128's conversion,
+      * but inline rather than with a call into the R128 implementation.
+      */
+    static double toDouble(std::uint64_t hi, std::uint64_t lo)
+    {
+        bool negative = (hi >> 63) != 0;
+        if (negative)
+        {
+            lo = ~lo + 1;
+            hi = ~hi + (lo == 0 ? 1 : 0);
+        }
+
+        double result = static_cast<double>(hi) + static_cast<double>(lo) * (1.0 / 18446744073709551616.0);
+        return negative ? -result : result;
+    }
+
+    static double difference(const R128& a, const R128& b)
+    {
+#ifdef __SIZEOF_INT128__
+        unsigned __int128 d = ((static_cast<unsigned __int128>(a.hi) << 64) | a.lo) -
+                              ((static_cast<unsigned __int128>(b.hi) << 64) | b.lo);
+        return toDouble(static_cast<std::uint64_t>(d >> 64), static_cast<std::uint64_t>(d));
+#else
+        return toDouble(a.hi - b.hi - (a.lo < b.lo ? 1 : 0), a.lo - b.lo);
+#endif
+    }
+
 public:
     R128 x { 0 };
     R128 y { 0 };
@@ -13,8 +13,12 @@
 #include "universe.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 #include <celcompat/numbers.h>
@@ -23,6 +27,7 @@
 #include <celmath/ray.h>
 #include <celutil/greek.h>
 #include <celutil/utf8.h>
+#include "angularindex.h"
 #include "asterism.h"
 #include "body.h"
 #include "boundaries.h"
@@ -34,50 +39,16 @@
 
 namespace math = celestia::math;
 namespace util = celestia::util;
+using celestia::engine::AngularIndex;
 
 namespace
 {
 
 constexpr double ANGULAR_RES = 3.5e-6;
 
-
-class ClosestStarFinder : public StarHandler
-{
-public:
-    ClosestStarFinder(float _maxDistance, const Universe* _universe);
-    ~ClosestStarFinder() = default;
-    void process(const Star& star, float distance, float appMag) override;
-
-public:
-    float maxDistance;
-    float closestDistance;
-    const Star* closestStar;
-    const Universe* universe;
-    bool withPlanets;
-};
-
-ClosestStarFinder::ClosestStarFinder(float _maxDistance,
-                                     const Universe* _universe) :
-    maxDistance(_maxDistance),
-    closestDistance(_maxDistance),
-    closestStar(nullptr),
-    universe(_universe),
-    withPlanets(false)
-{
-}
-
-void
-ClosestStarFinder::process(const Star& star, float distance, float /*unused*/)
-{
-    if (distance < closestDistance)
-    {
-        if (!withPlanets || universe->getSolarSystem(&star))
-        {
-            closestStar = &star;
-            closestDistance = distance;
-        }
-    }
-}
+// Largest number of star or DSO names offered as completions, short
+// prefixes could otherwise match millions of catalog names
+constexpr std::size_t MaxCatalogCompletions = 1000;
 
 
 class NearStarFinder : public StarHandler
@@ -538,6 +509,55 @@ CloseDSOPicker::process(DeepSkyObject* const & dso,
 }
 
 
+class StarCollector : public StarHandler
+{
+public:
+    explicit StarCollector(std::vector<std::pair<const Star*, float>>& _stars) : stars(_stars) {}
+    void process(const Star& star, float distance, float /*unused*/) override
+    {
+        stars.emplace_back(&star, distance);
+    }
+
+private:
+    std::vector<std::pair<const Star*, float>>& stars;
+};
+
+
+class DSOCollector : public DSOHandler
+{
+public:
+    explicit DSOCollector(std::vector<std::pair<DeepSkyObject*, double>>& _dsos) : dsos(_dsos) {}
+    void process(DeepSkyObject* const & dso, double distance, float /*unused*/) override
+    {
+        dsos.emplace_back(dso, distance);
+    }
+
+private:
+    std::vector<std::pair<DeepSkyObject*, double>>& dsos;
+};
+
+
+// Orientations of the six faces of a cube around the observer, with a
+// field of view slightly wider than a face so that no direction is missed
+constexpr float SkyFaceFov = static_cast<float>(celestia::numbers::pi * 90.5 / 180.0);
+
+std::array<Eigen::Quaternionf, 6>
+getSkyFaceOrientations()
+{
+    std::array<Eigen::Quaternionf, 6> orientations;
+    for (int i = 0; i < 6; ++i)
+    {
+        Eigen::Vector3f axis = Eigen::Vector3f::Zero();
+        axis[i / 2] = (i % 2 == 0) ? 1.0f : -1.0f;
+        Eigen::Quaternionf rotation;
+        rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), axis);
+        orientations[i] = rotation.conjugate();
+    }
+
+    return orientations;
+}
+
+
 void
 getLocationsCompletion(std::vector<std::string>& completion,
                        std::string_view s,
@@ -592,7 +612,247 @@ getLocationsCompletionPath(std::vector<std::string>& completion,
 } // end unnamed namespace
 
 
-// Needs definition of ConstellationBoundaries
+/*! The objects are indexed by their direction from the place the index was
+ *  built, and tested with the pickers like the objects found by the octree
+ *  traversals. Objects closer than MinDistance, stars with orbits and DSOs
+ *  covering more than a cell of the index are tested on every pick
+ *  instead, so that the directions of the indexed ones change by less
+ *  than MaxShift radians while the observer stays within MaxShift light
+ *  years.
+ */
+struct Universe::PickIndex
+{
+    static constexpr double MinDistance = 1.0;
+    static constexpr double MaxShift = 1.0e-4;
+    static constexpr float CellAngle = static_cast<float>(celestia::numbers::pi / (180.0 * AngularIndex::CellsPerDegree));
+
+    void build(const StarDatabase*, const DSODatabase*, const Eigen::Vector3d&, float);
+    bool matches(const Eigen::Vector3d& position) const
+    {
+        return (position - origin).norm() <= MaxShift;
+    }
+
+    // Origin of the last pick, the index is built when the next one is
+    // made from the same place
+    Eigen::Vector3d lastOrigin{ Eigen::Vector3d::Zero() };
+    bool hasLastOrigin{ false };
+
+    bool built{ false };
+    Eigen::Vector3d origin{ Eigen::Vector3d::Zero() };
+    float faintestMag{ 0.0f };
+
+    // Visible stars and DSOs, as found by findVisibleStars and
+    // findVisibleDSOs
+    std::vector<const Star*> stars;
+    AngularIndex starIndex;
+    std::vector<const Star*> otherStars;
+    std::vector<DeepSkyObject*> visibleDSOs;
+    AngularIndex visibleDSOIndex;
+    std::vector<DeepSkyObject*> otherVisibleDSOs;
+
+    // All the DSOs, as found by findCloseDSOs, and their distances
+    std::vector<std::pair<DeepSkyObject*, double>> dsos;
+    AngularIndex dsoIndex;
+    std::vector<std::pair<DeepSkyObject*, double>> otherDSOs;
+};
+
+
+void
+Universe::PickIndex::build(const StarDatabase* starDB,
+                           const DSODatabase* dsoDB,
+                           const Eigen::Vector3d& position,
+                           float limitingMag)
+{
+    built = true;
+    origin = position;
+    faintestMag = limitingMag;
+
+    stars.clear();
+    otherStars.clear();
+    visibleDSOs.clear();
+    otherVisibleDSOs.clear();
+    dsos.clear();
+    otherDSOs.clear();
+
+    const auto faces = getSkyFaceOrientations();
+    std::vector<Eigen::Vector3f> directions;
+
+    if (starDB != nullptr)
+    {
+        Eigen::Vector3f o = origin.cast<float>();
+        std::vector<std::pair<const Star*, float>> found;
+        StarCollector collector(found);
+        for (const Eigen::Quaternionf& orientation : faces)
+            starDB->findVisibleStars(collector, o, orientation, SkyFaceFov, 1.0f, faintestMag);
+
+        for (const auto& [star, distance] : found)
+        {
+            if (star->getOrbitalRadius() != 0.0f || distance < static_cast<float>(MinDistance))
+            {
+                otherStars.push_back(star);
+            }
+            else
+            {
+                stars.push_back(star);
+                directions.push_back((star->getPosition() - o).normalized());
+            }
+        }
+
+        starIndex.build(directions);
+    }
+
+    if (dsoDB == nullptr)
+        return;
+
+    // The DSOs whose picking spheres cover more than a cell aren't indexed
+    auto isLarge = [this](const DeepSkyObject* dso, Eigen::Vector3d& direction)
+    {
+        direction = dso->getPosition() - origin;
+        double distance = direction.norm();
+        double radius = 2.0 * std::max(dso->getRadius(), dso->getBoundingSphereRadius());
+        direction /= distance;
+        return distance - radius < MinDistance || radius > distance * std::sin(static_cast<double>(CellAngle));
+    };
+
+    std::vector<std::pair<DeepSkyObject*, double>> found;
+    DSOCollector collector(found);
+    for (const Eigen::Quaternionf& orientation : faces)
+        dsoDB->findVisibleDSOs(collector, origin, orientation, SkyFaceFov, 1.0f, faintestMag);
+
+    directions.clear();
+    for (const auto& [dso, distance] : found)
+    {
+        if (Eigen::Vector3d direction; isLarge(dso, direction))
+        {
+            otherVisibleDSOs.push_back(dso);
+        }
+        else
+        {
+            visibleDSOs.push_back(dso);
+            directions.push_back(direction.cast<float>());
+        }
+    }
+
+    visibleDSOIndex.build(directions);
+
+    found.clear();
+    dsoDB->findCloseDSOs(collector, origin, 1e9);
+
+    directions.clear();
+    for (const auto& entry : found)
+    {
+        if (Eigen::Vector3d direction; isLarge(entry.first, direction))
+        {
+            otherDSOs.push_back(entry);
+        }
+        else
+        {
+            dsos.push_back(entry);
+            directions.push_back(direction.cast<float>());
+        }
+    }
+
+    dsoIndex.build(directions);
+}
+
+
+/*! A star closer than a distance to a position is closer than some larger
+ *  radius to any position within the difference of the two, so the stars
+ *  found within that radius, filtered by their distance, answer the same
+ *  queries while the observer stays within the difference. The nearest
+ *  star with a solar system likewise stays the nearest until the observer
+ *  has moved half the difference of its distance and that of the second
+ *  nearest one.
+ */
+struct Universe::NearStarCache
+{
+    // getNearestSolarSystem only considers stars within 1 ly, and searches
+    // for the two nearest ones within this distance
+    static constexpr float NearestSystemRange = 1.0f;
+    static constexpr float NearestSearchRadius = 2.0f;
+
+    // getNearStars searches within this many times the distance asked for
+    static constexpr float RegionScale = 2.0f;
+    static constexpr std::size_t MaxRegions = 2;
+
+    // Margin on the distances the observer may move, for the rounding of
+    // the single precision distances
+    static constexpr float RoundingMargin = 0.99f;
+
+    struct Region
+    {
+        Eigen::Vector3f center;
+        float maxDistance;
+        float radius;
+        std::vector<const Star*> stars;
+        std::uint64_t lastUse;
+    };
+
+    void clear()
+    {
+        nearestValid = false;
+        regions.clear();
+    }
+
+    std::mutex mutex;
+
+    bool nearestValid{ false };
+    Eigen::Vector3f nearestCenter{ Eigen::Vector3f::Zero() };
+    float nearestValidRadius{ 0.0f };
+    const Star* nearest{ nullptr };
+
+    std::vector<Region> regions;
+    std::uint64_t uses{ 0 };
+};
+
+
+/*! Scripts, URLs, reference frames and the object browsers resolve the same
+ *  names and paths over and over, each time looking up every level in the
+ *  name databases. The results are kept by the name, the contexts, which
+ *  are identified by their objects, and i18n, until the generation of the
+ *  catalogs changes.
+ */
+struct Universe::FindCache
+{
+    // Any name may be looked up, e.g. while the user types, so the cache is
+    // cleared when it gets this large
+    static constexpr std::size_t MaxEntries = 4096;
+
+    // Key of a lookup: whether it's a path, i18n, the contexts and the name
+    static std::string makeKey(bool path,
+                               std::string_view s,
+                               util::array_view<const Selection> contexts,
+                               bool i18n)
+    {
+        std::string key;
+        key.reserve(2 + contexts.size() * (1 + sizeof(std::size_t)) + s.size());
+        key.push_back(path ? 'p' : 'f');
+        key.push_back(i18n ? '1' : '0');
+        for (const Selection& context : contexts)
+        {
+            // The hash of a selection is that of its object pointer
+            auto object = std::hash<Selection>()(context);
+            key.push_back(static_cast<char>(context.getType()));
+            key.append(reinterpret_cast<const char*>(&object), sizeof(object));
+        }
+
+        key.append(s);
+        return key;
+    }
+
+    std::mutex mutex;
+    std::uint64_t generation{ 0 };
+    std::unordered_map<std::string, Selection> entries;
+};
+
+
+// Need the definitions of ConstellationBoundaries and PickIndex
+Universe::Universe() :
+    nearStarCache(std::make_unique<NearStarCache>()),
+    findCache(std::make_unique<FindCache>())
+{
+}
+
 Universe::~Universe() = default;
 
 
@@ -607,6 +867,25 @@ void
 Universe::setStarCatalog(std::unique_ptr<StarDatabase>&& catalog)
 {
     starCatalog = std::move(catalog);
+    pickIndex = nullptr;
+    notifyCatalogChanged();
+
+    std::scoped_lock lock(nearStarCache->mutex);
+    nearStarCache->clear();
+}
+
+
+celestia::engine::StarTileDatabase*
+Universe::getStarTiles() const
+{
+    return starTiles.get();
+}
+
+
+void
+Universe::setStarTiles(std::unique_ptr<celestia::engine::StarTileDatabase>&& tiles)
+{
+    starTiles = std::move(tiles);
 }
 
 
@@ -620,6 +899,10 @@ void
 Universe::setSolarSystemCatalog(std::unique_ptr<SolarSystemCatalog>&& catalog)
 {
     solarSystemCatalog = std::move(catalog);
+    notifyCatalogChanged();
+
+    std::scoped_lock lock(nearStarCache->mutex);
+    nearStarCache->nearestValid = false;
 }
 
 
@@ -634,6 +917,8 @@ void
 Universe::setDSOCatalog(std::unique_ptr<DSODatabase>&& catalog)
 {
     dsoCatalog = std::move(catalog);
+    pickIndex = nullptr;
+    notifyCatalogChanged();
 }
 
 
@@ -724,6 +1009,11 @@ Universe::getOrCreateSolarSystem(Star* star) const
         return iter->second.get();
 
     iter = solarSystemCatalog->emplace_hint(iter, starNum, std::make_unique<SolarSystem>(star));
+
+    // The new solar system may be nearer than the cached one
+    std::scoped_lock lock(nearStarCache->mutex);
+    nearStarCache->nearestValid = false;
+
     return iter->second.get();
 }
 
@@ -860,7 +1150,8 @@ Universe::pickStar(const UniversalCoord& origin,
                    const Eigen::Vector3f& direction,
                    double when,
                    float faintestMag,
-                   float tolerance) const
+                   float tolerance,
+                   const PickIndex* index) const
 {
     Eigen::Vector3f o = origin.toLy().cast<float>();
 
@@ -875,18 +1166,31 @@ Universe::pickStar(const UniversalCoord& origin,
     if (closePicker.closestStar != nullptr)
         return Selection(const_cast<Star*>(closePicker.closestStar));
 
-    // Find visible stars expects an orientation, but we just have a direction
-    // vector.  Convert the direction vector into an orientation by computing
-    // the rotation required to map -Z to the direction.
-    Eigen::Quaternionf rotation;
-    rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), direction);
-
     StarPicker picker(o, direction, when, tolerance);
-    starCatalog->findVisibleStars(picker,
-                                  o,
-                                  rotation.conjugate(),
-                                  tolerance, 1.0f,
-                                  faintestMag);
+    if (index != nullptr)
+    {
+        // The picker accepts stars up to the tolerance away from the ray
+        float angle = std::max(tolerance, static_cast<float>(2.0 * std::asin(ANGULAR_RES))) +
+                      static_cast<float>(PickIndex::MaxShift);
+        index->starIndex.query(direction, angle,
+                               [&](std::uint32_t i) { picker.process(*index->stars[i], 0.0f, 0.0f); });
+        for (const Star* star : index->otherStars)
+            picker.process(*star, 0.0f, 0.0f);
+    }
+    else
+    {
+        // Find visible stars expects an orientation, but we just have a direction
+        // vector.  Convert the direction vector into an orientation by computing
+        // the rotation required to map -Z to the direction.
+        Eigen::Quaternionf rotation;
+        rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), direction);
+
+        starCatalog->findVisibleStars(picker,
+                                      o,
+                                      rotation.conjugate(),
+                                      tolerance, 1.0f,
+                                      faintestMag);
+    }
     if (picker.pickedStar != nullptr)
         return Selection(const_cast<Star*>(picker.pickedStar));
     else
@@ -899,29 +1203,57 @@ Universe::pickDeepSkyObject(const UniversalCoord& origin,
                             const Eigen::Vector3f& direction,
                             std::uint64_t renderFlags,
                             float faintestMag,
-                            float tolerance) const
+                            float tolerance,
+                            const PickIndex* index) const
 {
     Eigen::Vector3d orig = origin.toLy();
     Eigen::Vector3d dir = direction.cast<double>();
 
+    // The rays hitting an indexed DSO pass within a cell of its center
+    float largeAngle = PickIndex::CellAngle + static_cast<float>(2.0 * PickIndex::MaxShift);
+
     CloseDSOPicker closePicker(orig, dir, renderFlags, 1e9, tolerance);
+    if (index != nullptr)
+    {
+        index->dsoIndex.query(direction, largeAngle,
+                              [&](std::uint32_t i) { closePicker.process(index->dsos[i].first, index->dsos[i].second, 0.0f); });
+        for (const auto& [dso, distance] : index->otherDSOs)
+            closePicker.process(dso, distance, 0.0f);
+    }
+    else
+    {
+        dsoCatalog->findCloseDSOs(closePicker, orig, 1e9);
+    }
 
-    dsoCatalog->findCloseDSOs(closePicker, orig, 1e9);
     if (closePicker.closestDSO != nullptr)
     {
         return Selection(const_cast<DeepSkyObject*>(closePicker.closestDSO));
     }
 
-    Eigen::Quaternionf rotation;
-    rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), direction);
-
     DSOPicker picker(orig, dir, renderFlags, tolerance);
-    dsoCatalog->findVisibleDSOs(picker,
-                                orig,
-                                rotation.conjugate(),
-                                tolerance,
-                                1.0f,
-                                faintestMag);
+    if (index != nullptr)
+    {
+        // The picker also looks at the DSOs whose sphere the ray hits
+        float angle = std::max(std::max(tolerance, static_cast<float>(2.0 * std::asin(ANGULAR_RES))) +
+                               static_cast<float>(PickIndex::MaxShift),
+                               largeAngle);
+        index->visibleDSOIndex.query(direction, angle,
+                                     [&](std::uint32_t i) { picker.process(index->visibleDSOs[i], 0.0, 0.0f); });
+        for (DeepSkyObject* dso : index->otherVisibleDSOs)
+            picker.process(dso, 0.0, 0.0f);
+    }
+    else
+    {
+        Eigen::Quaternionf rotation;
+        rotation.setFromTwoVectors(-Eigen::Vector3f::UnitZ(), direction);
+
+        dsoCatalog->findVisibleDSOs(picker,
+                                    orig,
+                                    rotation.conjugate(),
+                                    tolerance,
+                                    1.0f,
+                                    faintestMag);
+    }
     if (picker.pickedDSO != nullptr)
         return Selection(const_cast<DeepSkyObject*>(picker.pickedDSO));
     else
@@ -929,6 +1261,35 @@ Universe::pickDeepSkyObject(const UniversalCoord& origin,
 }
 
 
+/*! Return the pick index if it can be used from origin, building it if the
+ *  last pick was made from the same place. A single pick from a new place
+ *  traverses the octrees, which is faster than building the index.
+ */
+const Universe::PickIndex*
+Universe::updatePickIndex(const UniversalCoord& origin, float faintestMag)
+{
+    if (pickIndex == nullptr)
+        pickIndex = std::make_unique<PickIndex>();
+
+    Eigen::Vector3d position = origin.toLy();
+    if (pickIndex->built && pickIndex->faintestMag == faintestMag && pickIndex->matches(position))
+        return pickIndex.get();
+
+    bool repeated = pickIndex->hasLastOrigin &&
+                    (position - pickIndex->lastOrigin).norm() <= PickIndex::MaxShift;
+    pickIndex->lastOrigin = position;
+    pickIndex->hasLastOrigin = true;
+    if (!repeated)
+    {
+        pickIndex->built = false;
+        return nullptr;
+    }
+
+    pickIndex->build(starCatalog.get(), dsoCatalog.get(), position, faintestMag);
+    return pickIndex.get();
+}
+
+
 Selection
 Universe::pick(const UniversalCoord& origin,
                const Eigen::Vector3f& direction,
@@ -938,6 +1299,7 @@ Universe::pick(const UniversalCoord& origin,
                float  tolerance)
 {
     Selection sel;
+    const PickIndex* index = updatePickIndex(origin, faintestMag);
 
     if (renderFlags & Renderer::ShowPlanets)
     {
@@ -961,12 +1323,12 @@ Universe::pick(const UniversalCoord& origin,
 
     if (sel.empty() && (renderFlags & Renderer::ShowStars))
     {
-        sel = pickStar(origin, direction, when, faintestMag, tolerance);
+        sel = pickStar(origin, direction, when, faintestMag, tolerance, index);
     }
 
     if (sel.empty())
     {
-        sel = pickDeepSkyObject(origin, direction, renderFlags, faintestMag, tolerance);
+        sel = pickDeepSkyObject(origin, direction, renderFlags, faintestMag, tolerance, index);
     }
 
     return sel;
@@ -1087,6 +1449,28 @@ Selection
 Universe::find(std::string_view s,
                util::array_view<const Selection> contexts,
                bool i18n) const
+{
+    std::string key = FindCache::makeKey(false, s, contexts, i18n);
+    {
+        std::scoped_lock lock(findCache->mutex);
+        if (auto it = findCache->entries.find(key); it != findCache->entries.end())
+            return it->second;
+    }
+
+    Selection sel = findUncached(s, contexts, i18n);
+
+    std::scoped_lock lock(findCache->mutex);
+    if (findCache->entries.size() >= FindCache::MaxEntries)
+        findCache->entries.clear();
+    findCache->entries.try_emplace(std::move(key), sel);
+    return sel;
+}
+
+
+Selection
+Universe::findUncached(std::string_view s,
+                       util::array_view<const Selection> contexts,
+                       bool i18n) const
 {
     if (starCatalog != nullptr)
     {
@@ -1130,15 +1514,37 @@ Universe::findPath(std::string_view s,
                    util::array_view<const Selection> contexts,
                    bool i18n) const
 {
-    std::string_view::size_type pos = s.find('/', 0);
-
     // No delimiter found--just do a normal find.
-    if (pos == std::string_view::npos)
+    if (s.find('/', 0) == std::string_view::npos)
         return find(s, contexts, i18n);
 
+    std::string key = FindCache::makeKey(true, s, contexts, i18n);
+    {
+        std::scoped_lock lock(findCache->mutex);
+        if (auto it = findCache->entries.find(key); it != findCache->entries.end())
+            return it->second;
+    }
+
+    Selection sel = findPathUncached(s, contexts, i18n);
+
+    std::scoped_lock lock(findCache->mutex);
+    if (findCache->entries.size() >= FindCache::MaxEntries)
+        findCache->entries.clear();
+    findCache->entries.try_emplace(std::move(key), sel);
+    return sel;
+}
+
+
+Selection
+Universe::findPathUncached(std::string_view s,
+                           util::array_view<const Selection> contexts,
+                           bool i18n) const
+{
+    std::string_view::size_type pos = s.find('/', 0);
+
     // Find the base object
     auto base = s.substr(0, pos);
-    Selection sel = find(base, contexts, i18n);
+    Selection sel = findUncached(base, contexts, i18n);
 
     while (!sel.empty() && pos != std::string_view::npos)
     {
@@ -1158,6 +1564,24 @@ Universe::findPath(std::string_view s,
 }
 
 
+void
+Universe::notifyCatalogChanged()
+{
+    std::scoped_lock lock(findCache->mutex);
+    findCache->generation++;
+    findCache->entries.clear();
+}
+
+
+std::uint64_t
+Universe::getCatalogGeneration() const
+{
+    std::scoped_lock lock(findCache->mutex);
+    return findCache->generation;
+}
+
+
+
 void
 Universe::getCompletion(std::vector<std::string>& completion,
                         std::string_view s,
@@ -1183,11 +1607,11 @@ Universe::getCompletion(std::vector<std::string>& completion,
 
     // Deep sky objects:
     if (dsoCatalog != nullptr)
-        dsoCatalog->getCompletion(completion, s);
+        dsoCatalog->getCompletion(completion, s, MaxCatalogCompletions);
 
     // and finally stars;
     if (starCatalog != nullptr)
-        starCatalog->getCompletion(completion, s);
+        starCatalog->getCompletion(completion, s, MaxCatalogCompletions);
 }
 
 
@@ -1249,10 +1673,32 @@ SolarSystem*
 Universe::getNearestSolarSystem(const UniversalCoord& position) const
 {
     Eigen::Vector3f pos = position.toLy().cast<float>();
-    ClosestStarFinder closestFinder(1.0f, this);
-    closestFinder.withPlanets = true;
-    starCatalog->findCloseStars(closestFinder, pos, 1.0f);
-    return getSolarSystem(closestFinder.closestStar);
+    NearStarCache& cache = *nearStarCache;
+    std::scoped_lock lock(cache.mutex);
+    if (!cache.nearestValid || !((pos - cache.nearestCenter).norm() <= cache.nearestValidRadius))
+    {
+        auto found = starCatalog->findNearestStars(pos, NearStarCache::NearestSearchRadius, 2,
+                                                   [this](const Star& star) { return getSolarSystem(&star) != nullptr; });
+        if (found.empty())
+        {
+            cache.nearest = nullptr;
+            cache.nearestValidRadius = NearStarCache::NearestSearchRadius - NearStarCache::NearestSystemRange;
+        }
+        else
+        {
+            float second = found.size() > 1 ? found[1].first : NearStarCache::NearestSearchRadius;
+            cache.nearest = found.front().second;
+            cache.nearestValidRadius = 0.5f * (second - found.front().first);
+        }
+
+        cache.nearestValidRadius *= NearStarCache::RoundingMargin;
+        cache.nearestCenter = pos;
+        cache.nearestValid = true;
+    }
+
+    if (cache.nearest == nullptr || !((pos - cache.nearest->getPosition()).norm() < NearStarCache::NearestSystemRange))
+        return nullptr;
+    return getSolarSystem(cache.nearest);
 }
 
 
@@ -1262,6 +1708,46 @@ Universe::getNearStars(const UniversalCoord& position,
                        std::vector<const Star*>& nearStars) const
 {
     Eigen::Vector3f pos = position.toLy().cast<float>();
-    NearStarFinder finder(maxDistance, nearStars);
-    starCatalog->findCloseStars(finder, pos, maxDistance);
+    NearStarCache& cache = *nearStarCache;
+    std::scoped_lock lock(cache.mutex);
+    auto region = std::find_if(cache.regions.begin(), cache.regions.end(),
+                               [&pos, maxDistance](const NearStarCache::Region& r)
+                               {
+                                   return r.maxDistance == maxDistance &&
+                                          (pos - r.center).norm() <= (r.radius - maxDistance) * NearStarCache::RoundingMargin;
+                               });
+    if (region == cache.regions.end())
+    {
+        if (cache.regions.size() < NearStarCache::MaxRegions)
+        {
+            region = cache.regions.emplace(cache.regions.end());
+        }
+        else
+        {
+            region = std::min_element(cache.regions.begin(), cache.regions.end(),
+                                      [](const NearStarCache::Region& r0, const NearStarCache::Region& r1)
+                                      {
+                                          return r0.lastUse < r1.lastUse;
+                                      });
+        }
+
+        region->center = pos;
+        region->maxDistance = maxDistance;
+        region->radius = maxDistance * NearStarCache::RegionScale;
+        region->stars.clear();
+        NearStarFinder finder(region->radius, region->stars);
+        starCatalog->findCloseStars(finder, pos, region->radius);
+    }
+
+    region->lastUse = ++cache.uses;
+
+    // The same tests as findCloseStars and NearStarFinder, so that the
+    // stars and their order are those of a search from pos
+    float radiusSquared = maxDistance * maxDistance;
+    for (const Star* star : region->stars)
+    {
+        float distanceSquared = (pos - star->getPosition()).squaredNorm();
+        if (distanceSquared < radiusSquared && std::sqrt(distanceSquared) < maxDistance)
+            nearStars.push_back(star);
+    }
 }
@@ -19,6 +19,7 @@
 #include <celengine/boundaries.h>
 #include <celengine/univcoord.h>
 #include <celengine/stardb.h>
+#include <celengine/startiledb.h>
 #include <celengine/dsodb.h>
 #include <celengine/solarsys.h>
 #include <celengine/deepskyobj.h>
@@ -31,12 +32,16 @@
 class Universe
 {
  public:
-    Universe() = default;
+    Universe();
     ~Universe();
 
     StarDatabase* getStarCatalog() const;
     void setStarCatalog(std::unique_ptr<StarDatabase>&&);
 
+    // Faint stars which are only drawn, paged from disk
+    celestia::engine::StarTileDatabase* getStarTiles() const;
+    void setStarTiles(std::unique_ptr<celestia::engine::StarTileDatabase>&&);
+
     SolarSystemCatalog* getSolarSystemCatalog() const;
     void setSolarSystemCatalog(std::unique_ptr<SolarSystemCatalog>&&);
 
@@ -57,6 +62,8 @@ class Universe
                    float tolerance = 0.0f);
 
 
+    // The results of find and findPath are cached until the catalogs
+    // change; see notifyCatalogChanged
     Selection find(std::string_view s,
                    celestia::util::array_view<const Selection> contexts,
                    bool i18n = false) const;
@@ -64,6 +71,11 @@ class Universe
                        celestia::util::array_view<const Selection> contexts,
                        bool i18n = false) const;
 
+    // Must be called after objects are added to, removed from or renamed in
+    // the catalogs, other than through the setters of the catalogs
+    void notifyCatalogChanged();
+    std::uint64_t getCatalogGeneration() const;
+
     void getCompletionPath(std::vector<std::string>& completion,
                            std::string_view s,
                            celestia::util::array_view<const Selection> contexts,
@@ -95,6 +107,13 @@ class Universe
                        celestia::util::array_view<const Selection> contexts,
                        bool withLocations = false) const;
 
+    Selection findUncached(std::string_view s,
+                           celestia::util::array_view<const Selection> contexts,
+                           bool i18n) const;
+    Selection findPathUncached(std::string_view s,
+                               celestia::util::array_view<const Selection> contexts,
+                               bool i18n) const;
+
     Selection findChildObject(const Selection& sel,
                               std::string_view name,
                               bool i18n = false) const;
@@ -109,20 +128,37 @@ class Universe
                          float faintestMag,
                          float tolerance) const;
 
+    // Stars and DSOs around the observer indexed by direction, which
+    // replace the octree traversals when picking repeatedly from the same
+    // place, e.g. while hovering
+    struct PickIndex;
+
+    // Results of getNearestSolarSystem and getNearStars, which are made
+    // every frame from nearly the same place
+    struct NearStarCache;
+
+    // Results of find and findPath by name, contexts and i18n
+    struct FindCache;
+
+    const PickIndex* updatePickIndex(const UniversalCoord& origin, float faintestMag);
+
     Selection pickStar(const UniversalCoord& origin,
                        const Eigen::Vector3f& direction,
                        double when,
                        float faintest,
-                       float tolerance = 0.0f) const;
+                       float tolerance = 0.0f,
+                       const PickIndex* index = nullptr) const;
 
     Selection pickDeepSkyObject(const UniversalCoord& origin,
                                 const Eigen::Vector3f& direction,
                                 uint64_t renderFlags,
                                 float faintest,
-                                float tolerance = 0.0f) const;
+                                float tolerance = 0.0f,
+                                const PickIndex* index = nullptr) const;
 
  private:
     std::unique_ptr<StarDatabase> starCatalog{nullptr};
+    std::unique_ptr<celestia::engine::StarTileDatabase> starTiles{nullptr};
     std::unique_ptr<DSODatabase> dsoCatalog{nullptr};
     std::unique_ptr<SolarSystemCatalog> solarSystemCatalog{nullptr};
     std::unique_ptr<AsterismList> asterisms{nullptr};
@@ -130,4 +166,7 @@ class Universe
 
     celestia::MarkerList markers{ };
     std::vector<const Star*> closeStars{ };
+    std::unique_ptr<PickIndex> pickIndex;
+    std::unique_ptr<NearStarCache> nearStarCache;
+    std::unique_ptr<FindCache> findCache;
 };
@@ -13,11 +13,8 @@
 /****** Value method implementations *******/
 
 Value::Value(Value&& other) noexcept
-    : type(other.type),
-      units(other.units),
-      data(other.data)
 {
-    other.type = ValueType::NullType;
+    moveFrom(std::move(other));
 }
 
 
@@ -25,24 +22,8 @@ Value& Value::operator=(Value&& other) noexcept
 {
     if (this != &other)
     {
-        switch (type)
-        {
-        case ValueType::StringType:
-            delete data.s; //NOSONAR
-            break;
-        case ValueType::ArrayType:
-            delete data.a; //NOSONAR
-            break;
-        case ValueType::HashType:
-            delete data.h; //NOSONAR
-            break;
-        default:
-            break;
-        }
-        type = other.type;
-        units = other.units;
-        data = other.data;
-        other.type = ValueType::NullType;
+        destroy();
+        moveFrom(std::move(other));
     }
 
     return *this;
@@ -50,17 +31,50 @@ Value& Value::operator=(Value&& other) noexcept
 
 
 Value::~Value()
+{
+    destroy();
+}
+
+
+void Value::moveFrom(Value&& other) noexcept
+{
+    type = other.type;
+    units = other.units;
+    switch (type)
+    {
+    case ValueType::StringType:
+        new (&data.s) std::string(std::move(other.data.s));
+        other.data.s.~basic_string();
+        break;
+    case ValueType::ArrayType:
+        data.a = other.data.a;
+        break;
+    case ValueType::HashType:
+        data.h = other.data.h;
+        break;
+    case ValueType::NumberType:
+    case ValueType::BooleanType:
+        data.d = other.data.d;
+        break;
+    default:
+        break;
+    }
+    other.type = ValueType::NullType;
+}
+
+
+void Value::destroy() noexcept
 {
     switch (type)
     {
     case ValueType::StringType:
-        delete data.s;
+        data.s.~basic_string();
         break;
     case ValueType::ArrayType:
-        delete data.a;
+        delete data.a; //NOSONAR
         break;
     case ValueType::HashType:
-        delete data.h;
+        delete data.h; //NOSONAR
         break;
     default:
         break;
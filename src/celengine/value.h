@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <new>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -38,9 +39,9 @@ using ValueArray = std::vector<Value>;
 
 // Value acts as a custom variant type which stores the units data in what
 // would otherwise be padding between the discriminant and the union data.
-// Single ownership of the contained value is enforced via the constructors,
-// which either obtain ownership by releasing a unique-ptr, or create a new
-// copied object.
+// Strings are stored in the union, so that short ones don't allocate.
+// Single ownership of an array or hash is enforced via the constructors,
+// which obtain ownership by releasing a unique-ptr.
 // Lines that trigger Sonar rules forbidding manual memory management are
 // marked as NOSONAR, as the use of new/delete is inherent to the functioning
 // of the class.
@@ -69,19 +70,19 @@ class Value //NOSONAR
     }
     explicit Value(const char *s) : type(ValueType::StringType)
     {
-        data.s = new std::string(s); //NOSONAR
+        new (&data.s) std::string(s);
     }
     explicit Value(const std::string_view sv) : type(ValueType::StringType)
     {
-        data.s = new std::string(sv); //NOSONAR
+        new (&data.s) std::string(sv);
     }
     explicit Value(const std::string &s) : type(ValueType::StringType)
     {
-        data.s = new std::string(s); // NOSONAR
+        new (&data.s) std::string(s);
     }
     explicit Value(std::string&& s) : type(ValueType::StringType)
     {
-        data.s = new std::string(std::move(s)); //NOSONAR
+        new (&data.s) std::string(std::move(s));
     }
     explicit Value(std::unique_ptr<ValueArray>&& a) : type(ValueType::ArrayType)
     {
@@ -119,7 +120,7 @@ class Value //NOSONAR
     const std::string* getString() const
     {
         return type == ValueType::StringType
-            ? data.s
+            ? &data.s
             : nullptr;
     }
     const ValueArray* getArray() const
@@ -149,12 +150,18 @@ class Value //NOSONAR
  private:
     union Data
     {
-        const std::string *s;
+        Data() {} //NOSONAR
+        ~Data() {} //NOSONAR
+
+        std::string        s;
         double             d;
         const ValueArray  *a;
         const Hash        *h;
     };
 
+    void moveFrom(Value&&) noexcept;
+    void destroy() noexcept;
+
     ValueType type { ValueType::NullType };
     Units units{ };
     Data data;
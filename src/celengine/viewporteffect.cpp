@@ -8,7 +8,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <Eigen/Geometry>
+#include <celcompat/numbers.h>
 #include "viewporteffect.h"
 #include "framebuffer.h"
 #include "render.h"
@@ -20,6 +24,33 @@ namespace util = celestia::util;
 
 static const Renderer::PipelineState ps;
 
+namespace
+{
+
+// Set up the FXAA shader to sample the part of a width by height texture
+// from offset, of size scale in texture coordinates
+void
+setAntialiasingParams(CelestiaGLProgram* prog,
+                      GLuint width,
+                      GLuint height,
+                      const Eigen::Vector2f& offset,
+                      const Eigen::Vector2f& scale)
+{
+    Eigen::Vector2f texelSize(1.0f / static_cast<float>(width), 1.0f / static_cast<float>(height));
+    prog->samplerParam("tex") = 0;
+    prog->vec2Param("texCoordOffset") = offset;
+    prog->vec2Param("texCoordScale") = scale;
+    prog->vec2Param("texelSize") = texelSize;
+    prog->vec2Param("texCoordMin") = Eigen::Vector2f(offset + 0.5f * texelSize);
+    prog->vec2Param("texCoordMax") = Eigen::Vector2f(offset + scale - 0.5f * texelSize);
+}
+
+} // end unnamed namespace
+
+ViewportEffect::ViewportEffect() = default;
+
+ViewportEffect::~ViewportEffect() = default;
+
 bool ViewportEffect::preprocess(Renderer* renderer, FramebufferObject* fbo)
 {
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
@@ -41,34 +72,67 @@ bool ViewportEffect::distortXY(float &x, float &y)
     return true;
 }
 
-PassthroughViewportEffect::PassthroughViewportEffect() :
-    ViewportEffect()
+GLuint ViewportEffect::getSceneTexture(Renderer* renderer, FramebufferObject* source, int columns, int rows, float scale)
 {
-}
+    if (!antialiasing)
+        return source->colorTexture();
 
-bool PassthroughViewportEffect::render(Renderer* renderer, FramebufferObject* fbo, int width, int height)
-{
-    auto *prog = renderer->getShaderManager().getShader("passthrough");
+    auto *prog = renderer->getShaderManager().getShader("fxaa");
     if (prog == nullptr)
-        return false;
+        return source->colorTexture();
 
-    initialize();
+    if (antialiased == nullptr || antialiased->width() != source->width() || antialiased->height() != source->height())
+    {
+        antialiased = std::make_unique<FramebufferObject>(source->width(), source->height(),
+                                                          FramebufferObject::ColorAttachment);
+        if (!antialiased->isValid())
+        {
+            antialiased = nullptr;
+            return source->colorTexture();
+        }
+    }
 
+    GLint fboId;
+    std::array<GLint, 4> viewport;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fboId);
+    glGetIntegerv(GL_VIEWPORT, viewport.data());
+    if (!antialiased->bind())
+        return source->colorTexture();
+
+    auto& quad = getQuad();
     prog->use();
-    prog->samplerParam("tex") = 0;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    gl::bindTexture(GL_TEXTURE_2D, source->colorTexture());
     renderer->setPipelineState(ps);
-    vo.draw();
-    glBindTexture(GL_TEXTURE_2D, 0);
 
-    return true;
+    auto tileWidth = static_cast<int>(source->width()) / columns;
+    auto tileHeight = static_cast<int>(source->height()) / rows;
+    Eigen::Vector2f tileScale(scale / static_cast<float>(columns), scale / static_cast<float>(rows));
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            glViewport(column * tileWidth, row * tileHeight,
+                       std::max(1, static_cast<int>(static_cast<float>(tileWidth) * scale)),
+                       std::max(1, static_cast<int>(static_cast<float>(tileHeight) * scale)));
+            setAntialiasingParams(prog, source->width(), source->height(),
+                                  Eigen::Vector2f(static_cast<float>(column) / static_cast<float>(columns),
+                                                  static_cast<float>(row) / static_cast<float>(rows)),
+                                  tileScale);
+            quad.draw();
+        }
+    }
+
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+    antialiased->unbind(fboId);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    return antialiased->colorTexture();
 }
 
-void PassthroughViewportEffect::initialize()
+gl::VertexObject& ViewportEffect::getQuad()
 {
-    if (initialized)
-        return;
-    initialized = true;
+    if (quadInitialized)
+        return quadVO;
+    quadInitialized = true;
 
     static std::array quadVertices = {
         // positions   // texCoords
@@ -81,26 +145,59 @@ void PassthroughViewportEffect::initialize()
          1.0f,  1.0f,  1.0f, 1.0f
     };
 
-    vo = gl::VertexObject();
-    bo = gl::Buffer(gl::Buffer::TargetHint::Array, quadVertices, gl::Buffer::BufferUsage::StaticDraw);
+    quadVO = gl::VertexObject();
+    quadBO = gl::Buffer(gl::Buffer::TargetHint::Array, quadVertices, gl::Buffer::BufferUsage::StaticDraw);
 
-    vo.setCount(6);
-    vo.addVertexBuffer(
-        bo,
+    quadVO.setCount(6);
+    quadVO.addVertexBuffer(
+        quadBO,
         CelestiaGLProgram::VertexCoordAttributeIndex,
         2,
         gl::VertexObject::DataType::Float,
         false,
         4 * sizeof(float),
         0);
-    vo.addVertexBuffer(
-        bo,
+    quadVO.addVertexBuffer(
+        quadBO,
         CelestiaGLProgram::TextureCoord0AttributeIndex,
         2,
         gl::VertexObject::DataType::Float,
         false,
         4 * sizeof(float),
         2 * sizeof(float));
+    return quadVO;
+}
+
+PassthroughViewportEffect::PassthroughViewportEffect() :
+    ViewportEffect()
+{
+}
+
+bool PassthroughViewportEffect::render(Renderer* renderer, FramebufferObject* fbo, int width, int height)
+{
+    // The antialiasing pass draws the scene to the screen by itself
+    auto *prog = renderer->getShaderManager().getShader(antialiasing ? "fxaa" : "passthrough");
+    if (prog == nullptr)
+        return false;
+
+    auto& quad = getQuad();
+    prog->use();
+    if (antialiasing)
+    {
+        setAntialiasingParams(prog, fbo->width(), fbo->height(),
+                              Eigen::Vector2f::Zero(), Eigen::Vector2f::Constant(sourceScale));
+    }
+    else
+    {
+        prog->samplerParam("tex") = 0;
+        prog->floatParam("texCoordScale") = sourceScale;
+    }
+    gl::bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    renderer->setPipelineState(ps);
+    quad.draw();
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+
+    return true;
 }
 
 WarpMeshViewportEffect::WarpMeshViewportEffect(WarpMesh *mesh) :
@@ -125,13 +222,15 @@ bool WarpMeshViewportEffect::render(Renderer* renderer, FramebufferObject* fbo,
 
     initialize();
 
+    GLuint texture = getSceneTexture(renderer, fbo, 1, 1, sourceScale);
     prog->use();
     prog->samplerParam("tex") = 0;
     prog->floatParam("screenRatio") = (float)height / width;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    prog->floatParam("texCoordScale") = sourceScale;
+    gl::bindTexture(GL_TEXTURE_2D, texture);
     renderer->setPipelineState(ps);
     vo.draw();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
 
     return true;
 }
@@ -188,3 +287,174 @@ bool WarpMeshViewportEffect::distortXY(float &x, float &y)
     y = v / 2.0f;
     return true;
 }
+
+namespace
+{
+
+// Rotation from the view to the camera looking at a face, in the order
+// of the tiles: front, right, left, up and down
+Eigen::Matrix3d
+getFaceTransform(int face)
+{
+    constexpr double halfPi = celestia::numbers::pi / 2.0;
+    switch (face)
+    {
+    case 1:
+        return Eigen::AngleAxisd(halfPi, Eigen::Vector3d::UnitY()).toRotationMatrix();
+    case 2:
+        return Eigen::AngleAxisd(-halfPi, Eigen::Vector3d::UnitY()).toRotationMatrix();
+    case 3:
+        return Eigen::AngleAxisd(-halfPi, Eigen::Vector3d::UnitX()).toRotationMatrix();
+    case 4:
+        return Eigen::AngleAxisd(halfPi, Eigen::Vector3d::UnitX()).toRotationMatrix();
+    default:
+        return Eigen::Matrix3d::Identity();
+    }
+}
+
+} // end unnamed namespace
+
+DomeViewportEffect::DomeViewportEffect(WarpMesh *mesh) :
+    ViewportEffect(),
+    mesh(mesh)
+{
+}
+
+DomeViewportEffect::~DomeViewportEffect() = default;
+
+bool DomeViewportEffect::preprocess(Renderer* renderer, FramebufferObject* fbo)
+{
+    // Match the resolution of the faces to that of the fisheye view at
+    // its center, where the circle as high as the view spans 180 degrees
+    auto faceSize = std::max(1u, static_cast<GLuint>(std::lround(fbo->height() * 2.0 / celestia::numbers::pi)));
+    if (faces == nullptr || faces->height() != 2 * faceSize)
+    {
+        faces = std::make_unique<FramebufferObject>(3 * faceSize, 2 * faceSize,
+                                                    FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment);
+        if (!faces->isValid())
+        {
+            faces = nullptr;
+            return false;
+        }
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    savedCameraTransform = renderer->getCameraTransform();
+    return faces->bind();
+}
+
+bool DomeViewportEffect::beginPass(Renderer* renderer, int pass)
+{
+    auto faceSize = static_cast<int>(faces->height() / 2);
+    renderer->setRenderRegion((pass % 3) * faceSize, (pass / 3) * faceSize, faceSize, faceSize, true);
+    renderer->setCameraTransform(getFaceTransform(pass) * savedCameraTransform);
+    return true;
+}
+
+bool DomeViewportEffect::prerender(Renderer* renderer, FramebufferObject* /*fbo*/)
+{
+    renderer->setCameraTransform(savedCameraTransform);
+    if (!faces->unbind(oldFboId))
+        return false;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+bool DomeViewportEffect::render(Renderer* renderer, FramebufferObject* /*fbo*/, int width, int height)
+{
+    auto *prog = renderer->getShaderManager().getShader("dome");
+    if (prog == nullptr)
+        return false;
+
+    initialize();
+
+    // The faces are resolved one by one, so that the antialiasing doesn't
+    // blend them at their edges
+    GLuint texture = getSceneTexture(renderer, faces.get(), 3, 2, 1.0f);
+    prog->use();
+    prog->samplerParam("tex") = 0;
+    prog->floatParam("screenRatio") = (float)height / width;
+    // Keep the samples inside the tiles, half a texel from their edges
+    prog->floatParam("tileBorder") = 0.5f / static_cast<float>(faces->height() / 2);
+    gl::bindTexture(GL_TEXTURE_2D, texture);
+    renderer->setPipelineState(ps);
+    vo.draw();
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+
+    return true;
+}
+
+void DomeViewportEffect::initialize()
+{
+    if (initialized)
+        return;
+    initialized = true;
+
+    // Without a warp mesh, the fisheye view fills a square in the middle
+    // of the screen
+    static std::array quadVertices = {
+        // positions   // texCoords  // intensity
+        -1.0f,  1.0f,  0.0f, 1.0f,   1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f,   1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,   1.0f,
+
+        -1.0f,  1.0f,  0.0f, 1.0f,   1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,   1.0f,
+         1.0f,  1.0f,  1.0f, 1.0f,   1.0f
+    };
+
+    vo = gl::VertexObject();
+    if (mesh != nullptr)
+    {
+        bo = gl::Buffer();
+        bo.bind().setData(mesh->scopedDataForRendering(), gl::Buffer::BufferUsage::StaticDraw);
+        vo.setCount(mesh->count());
+    }
+    else
+    {
+        bo = gl::Buffer(gl::Buffer::TargetHint::Array, quadVertices, gl::Buffer::BufferUsage::StaticDraw);
+        vo.setCount(6);
+    }
+
+    vo.addVertexBuffer(
+        bo,
+        CelestiaGLProgram::VertexCoordAttributeIndex,
+        2,
+        gl::VertexObject::DataType::Float,
+        false,
+        5 * sizeof(float),
+        0);
+    vo.addVertexBuffer(
+        bo,
+        CelestiaGLProgram::TextureCoord0AttributeIndex,
+        2,
+        gl::VertexObject::DataType::Float,
+        false,
+        5 * sizeof(float),
+        2 * sizeof(float));
+    vo.addVertexBuffer(
+        bo,
+        CelestiaGLProgram::IntensityAttributeIndex,
+        1,
+        gl::VertexObject::DataType::Float,
+        false,
+        5 * sizeof(float),
+        4 * sizeof(float));
+}
+
+bool DomeViewportEffect::distortXY(float &x, float &y)
+{
+    if (mesh == nullptr)
+        return true;
+
+    float u;
+    float v;
+    if (!mesh->mapVertex(x * 2.0f, y * 2.0f, &u, &v))
+        return false;
+
+    x = u / 2.0f;
+    y = v / 2.0f;
+    return true;
+}
@@ -10,6 +10,10 @@
 
 #pragma once
 
+#include <memory>
+
+#include <Eigen/Core>
+
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
 
@@ -21,15 +25,48 @@ class WarpMesh;
 class ViewportEffect
 {
 public:
-    virtual ~ViewportEffect() = default;
+    ViewportEffect();
+    virtual ~ViewportEffect();
 
     virtual bool preprocess(Renderer*, FramebufferObject*);
+    // The scene is rendered once for each pass, after beginPass has set up
+    // the renderer for it
+    virtual int getPassCount() const { return 1; }
+    virtual bool beginPass(Renderer*, int /*pass*/) { return true; }
     virtual bool prerender(Renderer*, FramebufferObject*);
     virtual bool render(Renderer*, FramebufferObject*, int width, int height) = 0;
     virtual bool distortXY(float& x, float& y);
 
+    // Fraction of the framebuffer width and height, from its lower left
+    // corner, which the scene was rendered to
+    void setSourceScale(float scale) { sourceScale = scale; }
+    float getSourceScale() const { return sourceScale; }
+
+    // Smooth the edges of the scene with a post-process antialiasing pass
+    // (FXAA) before the effect is applied, a cheaper alternative to MSAA
+    // which also works on the framebuffers of the effects
+    void setAntialiasing(bool enable) { antialiasing = enable; }
+    bool getAntialiasing() const { return antialiasing; }
+
+protected:
+    // The texture of the scene in source to apply the effect to, after
+    // the antialiasing pass if it's on. The scene is rendered to a grid of
+    // columns by rows tiles, each resolved on its own, and fills the
+    // fraction scale of each tile from its lower left corner.
+    GLuint getSceneTexture(Renderer*, FramebufferObject* source, int columns, int rows, float scale);
+    // A quad covering the viewport, with texture coordinates from 0 to 1
+    celestia::gl::VertexObject& getQuad();
+
+    float sourceScale{ 1.0f };
+    bool antialiasing{ false };
+
 private:
     GLint oldFboId;
+
+    std::unique_ptr<FramebufferObject> antialiased;
+    celestia::gl::VertexObject quadVO{ celestia::util::NoCreateT{} };
+    celestia::gl::Buffer quadBO{ celestia::util::NoCreateT{} };
+    bool quadInitialized{ false };
 };
 
 class PassthroughViewportEffect : public ViewportEffect
@@ -39,22 +76,44 @@ public:
     ~PassthroughViewportEffect() override = default;
 
     bool render(Renderer*, FramebufferObject*, int width, int height) override;
+};
+
+class WarpMeshViewportEffect : public ViewportEffect
+{
+public:
+    WarpMeshViewportEffect(WarpMesh *mesh);
+    ~WarpMeshViewportEffect() override = default;
+
+    bool prerender(Renderer*, FramebufferObject* fbo) override;
+    bool render(Renderer*, FramebufferObject*, int width, int height) override;
+    bool distortXY(float& x, float& y) override;
 
 private:
     celestia::gl::VertexObject vo{ celestia::util::NoCreateT{} };
     celestia::gl::Buffer bo{ celestia::util::NoCreateT{} };
 
+    WarpMesh *mesh;
+
     void initialize();
 
     bool initialized{ false };
 };
 
-class WarpMeshViewportEffect : public ViewportEffect
+// Renders the scene into the faces of a cube map around the view direction,
+// then warps them into a 180 degree fisheye view, optionally through a warp
+// mesh to calibrate the projectors of a dome. Only the five faces in front
+// of the viewer are rendered.
+class DomeViewportEffect : public ViewportEffect
 {
 public:
-    WarpMeshViewportEffect(WarpMesh *mesh);
-    ~WarpMeshViewportEffect() override = default;
+    static constexpr int FaceCount = 5;
+
+    explicit DomeViewportEffect(WarpMesh *mesh = nullptr);
+    ~DomeViewportEffect() override;
 
+    bool preprocess(Renderer*, FramebufferObject*) override;
+    int getPassCount() const override { return FaceCount; }
+    bool beginPass(Renderer*, int pass) override;
     bool prerender(Renderer*, FramebufferObject* fbo) override;
     bool render(Renderer*, FramebufferObject*, int width, int height) override;
     bool distortXY(float& x, float& y) override;
@@ -64,6 +123,10 @@ private:
     celestia::gl::Buffer bo{ celestia::util::NoCreateT{} };
 
     WarpMesh *mesh;
+    // The faces are tiled three by two
+    std::unique_ptr<FramebufferObject> faces;
+    GLint oldFboId{ 0 };
+    Eigen::Matrix3d savedCameraTransform{ Eigen::Matrix3d::Identity() };
 
     void initialize();
 
@@ -10,29 +10,48 @@
 
 #include "virtualtex.h"
 
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstdio>
+#include <deque>
 #include <fstream>
+#include <mutex>
 #include <optional>
 #include <system_error>
+#include <thread>
 #include <utility>
 
 #include <fmt/format.h>
 
+#include <celengine/glsupport.h>
 #include <celengine/parser.h>
+#include <celimage/image.h>
 #include <celutil/filetype.h>
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
 
 
+namespace gl = celestia::gl;
 using celestia::util::GetLogger;
 using celestia::engine::Image;
+using celestia::engine::PixelFormat;
 
 namespace
 {
 
 constexpr int MaxResolutionLevels = 13;
 
+// Limits for the tiles loaded in the background, per virtual texture
+constexpr std::size_t MaxUploadsPerUsage    = 8;
+constexpr unsigned int MaxPendingPrefetches = 16;
+
+std::size_t tileCacheSize = 512 * 1024 * 1024;
+
+// Width and height of the sparse atlas of a virtual texture. Only the pages
+// holding tiles use memory, so this just limits the number of tiles.
+constexpr GLint MaxSparseAtlasSize = 16384;
+
 
 constexpr bool
 isPow2(int x)
@@ -123,9 +142,389 @@ LoadVirtualTexture(std::istream& in, const fs::path& path)
     return CreateVirtualTexture(texParams, path);
 }
 
+#ifndef GL_ES
+// Sized internal format and external format of a tile in a sparse atlas,
+// GL_NONE if tiles of the format can't be put in one
+std::pair<GLenum, GLenum>
+getSparseFormats(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return { GL_RGB8, static_cast<GLenum>(format) };
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+        return { GL_RGBA8, static_cast<GLenum>(format) };
+    case PixelFormat::sRGB:
+        return { GL_SRGB8, GL_RGB };
+    case PixelFormat::sRGBA:
+        return { GL_SRGB8_ALPHA8, GL_RGBA };
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT1_sRGBA:
+    case PixelFormat::DXT3_sRGBA:
+    case PixelFormat::DXT5_sRGBA:
+        return { static_cast<GLenum>(format), GL_NONE };
+    default:
+        return { GL_NONE, GL_NONE };
+    }
+}
+#endif
+
 } // end unnamed namespace
 
 
+// Sparse texture holding the tiles of a virtual texture above its base
+// level in slots of the tile size. Only the pages of the slots in use are
+// committed, and planets draw all these tiles without changing textures.
+class VirtualTexture::SparseAtlas
+{
+public:
+    // Return nullptr if sparse textures aren't supported for tiles like img
+    static std::unique_ptr<SparseAtlas> create(const Image& img, unsigned int tileSize);
+    ~SparseAtlas();
+
+    bool accepts(const Image& img) const;
+    // Return the slot the image was put in, or -1 if the atlas is full
+    int add(const Image& img);
+    void remove(int slot);
+    TextureTile getTile(int slot, float u, float v, float du, float dv) const;
+
+private:
+    SparseAtlas(GLuint _name,
+                PixelFormat _format,
+                GLenum _externalFormat,
+                unsigned int _tileSize,
+                unsigned int _slotsPerRow);
+
+    GLuint name;
+    PixelFormat format;
+    GLenum externalFormat;
+    unsigned int tileSize;
+    unsigned int slotsPerRow;
+    int nextSlot{ 0 };
+    std::vector<int> freeSlots;
+};
+
+
+VirtualTexture::SparseAtlas::SparseAtlas(GLuint _name,
+                                         PixelFormat _format,
+                                         GLenum _externalFormat,
+                                         unsigned int _tileSize,
+                                         unsigned int _slotsPerRow) :
+    name(_name),
+    format(_format),
+    externalFormat(_externalFormat),
+    tileSize(_tileSize),
+    slotsPerRow(_slotsPerRow)
+{
+}
+
+
+VirtualTexture::SparseAtlas::~SparseAtlas()
+{
+    gl::deleteTextures(1, &name);
+}
+
+
+std::unique_ptr<VirtualTexture::SparseAtlas>
+VirtualTexture::SparseAtlas::create(const Image& img, unsigned int tileSize)
+{
+#ifdef GL_ES
+    return nullptr;
+#else
+    if (!gl::ARB_sparse_texture ||
+        img.getWidth() != static_cast<int>(tileSize) ||
+        img.getHeight() != static_cast<int>(tileSize))
+    {
+        return nullptr;
+    }
+
+    auto [internalFormat, externalFormat] = getSparseFormats(img.getFormat());
+    if (internalFormat == GL_NONE)
+        return nullptr;
+
+    // Slots have to be made of whole pages to be committed on their own
+    GLint nPageSizes = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &nPageSizes);
+    if (nPageSizes <= 0)
+        return nullptr;
+
+    GLint pageWidth = 0;
+    GLint pageHeight = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageWidth);
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageHeight);
+    if (pageWidth <= 0 || pageHeight <= 0 ||
+        tileSize % static_cast<unsigned int>(pageWidth) != 0 ||
+        tileSize % static_cast<unsigned int>(pageHeight) != 0)
+    {
+        return nullptr;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_SPARSE_TEXTURE_SIZE_ARB, &maxSize);
+    unsigned int slotsPerRow = static_cast<unsigned int>(std::min(maxSize, MaxSparseAtlasSize)) / tileSize;
+    if (slotsPerRow < 2)
+        return nullptr;
+
+    GLuint name = 0;
+    glGenTextures(1, &name);
+    gl::bindTexture(GL_TEXTURE_2D, name);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+    glTexParameteri(GL_TEXTURE_2D, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    if (gl::EXT_texture_filter_anisotropic && gl::maxTextureAnisotropy > 1)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(8, gl::maxTextureAnisotropy));
+
+    auto size = static_cast<GLsizei>(slotsPerRow * tileSize);
+    glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, size, size);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        gl::deleteTextures(1, &name);
+        return nullptr;
+    }
+
+    return std::unique_ptr<SparseAtlas>(new SparseAtlas(name, img.getFormat(), externalFormat, tileSize, slotsPerRow));
+#endif
+}
+
+
+bool
+VirtualTexture::SparseAtlas::accepts(const Image& img) const
+{
+    return img.getFormat() == format &&
+           img.getWidth() == static_cast<int>(tileSize) &&
+           img.getHeight() == static_cast<int>(tileSize);
+}
+
+
+int
+VirtualTexture::SparseAtlas::add(const Image& img)
+{
+#ifdef GL_ES
+    return -1;
+#else
+    int slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else if (nextSlot < static_cast<int>(slotsPerRow * slotsPerRow))
+    {
+        slot = nextSlot++;
+    }
+    else
+    {
+        return -1;
+    }
+
+    auto x = static_cast<GLint>((static_cast<unsigned int>(slot) % slotsPerRow) * tileSize);
+    auto y = static_cast<GLint>((static_cast<unsigned int>(slot) / slotsPerRow) * tileSize);
+    auto size = static_cast<GLsizei>(tileSize);
+
+    gl::bindTexture(GL_TEXTURE_2D, name);
+    glTexPageCommitmentARB(GL_TEXTURE_2D, 0, x, y, 0, size, size, 1, GL_TRUE);
+    if (img.isCompressed())
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size,
+                                  static_cast<GLenum>(format),
+                                  img.getMipLevelSize(0),
+                                  img.getMipLevel(0));
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size,
+                        externalFormat, GL_UNSIGNED_BYTE,
+                        img.getMipLevel(0));
+    }
+    gl::countUpload(static_cast<std::size_t>(img.getMipLevelSize(0)));
+
+    return slot;
+#endif
+}
+
+
+void
+VirtualTexture::SparseAtlas::remove(int slot)
+{
+#ifndef GL_ES
+    auto x = static_cast<GLint>((static_cast<unsigned int>(slot) % slotsPerRow) * tileSize);
+    auto y = static_cast<GLint>((static_cast<unsigned int>(slot) / slotsPerRow) * tileSize);
+    auto size = static_cast<GLsizei>(tileSize);
+
+    gl::bindTexture(GL_TEXTURE_2D, name);
+    glTexPageCommitmentARB(GL_TEXTURE_2D, 0, x, y, 0, size, size, 1, GL_FALSE);
+    freeSlots.push_back(slot);
+#endif
+}
+
+
+// Map the subrect of a tile to the atlas, keeping half a texel from the
+// edges of the slot so that its neighbors don't bleed in
+TextureTile
+VirtualTexture::SparseAtlas::getTile(int slot, float u, float v, float du, float dv) const
+{
+    auto slotU = static_cast<float>(static_cast<unsigned int>(slot) % slotsPerRow);
+    auto slotV = static_cast<float>(static_cast<unsigned int>(slot) / slotsPerRow);
+    auto size = static_cast<float>(tileSize);
+    float scale = (size - 1.0f) / (size * static_cast<float>(slotsPerRow));
+
+    return TextureTile(name,
+                       (slotU + 0.5f / size) / static_cast<float>(slotsPerRow) + u * scale,
+                       (slotV + 0.5f / size) / static_cast<float>(slotsPerRow) + v * scale,
+                       du * scale,
+                       dv * scale);
+}
+
+
+// Tiles decoded by the loader threads, waiting to be uploaded by their
+// texture. This is shared with the loader, so that requests may outlive
+// the texture.
+struct VirtualTexture::LoadedTiles
+{
+    struct LoadedTile
+    {
+        TileAddress address;
+        std::unique_ptr<Image> image;
+        bool prefetch;
+        // The loader was stopped before the tile was decoded
+        bool cancelled;
+    };
+
+    std::mutex mutex;
+    std::deque<LoadedTile> tiles;
+    // Only used by the texture
+    unsigned int pendingPrefetches{ 0 };
+};
+
+
+// Worker threads decoding tiles for all virtual textures. Tiles needed for
+// drawing are decoded before prefetched ones.
+class VirtualTexture::TileLoader
+{
+public:
+    static TileLoader& get()
+    {
+        static TileLoader loader;
+        return loader;
+    }
+
+    ~TileLoader() { setThreads(0); }
+
+    void setThreads(unsigned int nThreads);
+    bool isActive() const { return !workers.empty(); }
+
+    void request(const std::shared_ptr<LoadedTiles>& owner,
+                 const TileAddress& address,
+                 fs::path&& path,
+                 bool prefetch);
+
+private:
+    struct Request
+    {
+        std::weak_ptr<LoadedTiles> owner;
+        TileAddress address;
+        fs::path path;
+        bool prefetch;
+    };
+
+    TileLoader() = default;
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Request> requests;
+    std::vector<std::thread> workers;
+    bool quit{ false };
+};
+
+
+void
+VirtualTexture::TileLoader::setThreads(unsigned int nThreads)
+{
+    if (!workers.empty())
+    {
+        {
+            std::scoped_lock lock(mutex);
+            quit = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+        quit = false;
+
+        // Let the textures request the tiles again
+        for (auto& request : requests)
+        {
+            if (auto owner = request.owner.lock(); owner != nullptr)
+            {
+                std::scoped_lock lock(owner->mutex);
+                owner->tiles.push_back({ request.address, nullptr, request.prefetch, true });
+            }
+        }
+        requests.clear();
+    }
+
+    for (unsigned int i = 0; i < nThreads; ++i)
+        workers.emplace_back(&TileLoader::run, this);
+}
+
+
+void
+VirtualTexture::TileLoader::request(const std::shared_ptr<LoadedTiles>& owner,
+                                    const TileAddress& address,
+                                    fs::path&& path,
+                                    bool prefetch)
+{
+    {
+        std::scoped_lock lock(mutex);
+        if (prefetch)
+            requests.push_back({ owner, address, std::move(path), prefetch });
+        else
+            requests.push_front({ owner, address, std::move(path), prefetch });
+    }
+    condition.notify_one();
+}
+
+
+void
+VirtualTexture::TileLoader::run()
+{
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        condition.wait(lock, [this] { return quit || !requests.empty(); });
+        if (quit)
+            return;
+
+        Request request = std::move(requests.front());
+        requests.pop_front();
+        lock.unlock();
+
+        // Skip the tiles of textures which have been destroyed
+        if (request.owner.lock() != nullptr)
+        {
+            auto image = Image::load(request.path);
+            if (auto owner = request.owner.lock(); owner != nullptr)
+            {
+                std::scoped_lock ownerLock(owner->mutex);
+                owner->tiles.push_back({ request.address, std::move(image), request.prefetch, false });
+            }
+        }
+
+        lock.lock();
+    }
+}
+
+
 // Virtual textures are composed of tiles that are loaded from the hard drive
 // as they become visible.  Hidden tiles may be evicted from graphics memory
 // to make room for other tiles when they become visible.
@@ -148,7 +547,8 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
     baseSplit(_baseSplit),
     tileSize(_tileSize),
     ticks(0),
-    nResolutionLevels(0)
+    nResolutionLevels(0),
+    loadedTiles(std::make_shared<LoadedTiles>())
 {
     assert(tileSize != 0 && isPow2(tileSize));
     tileExt = fmt::format(".{:s}", _tileType);
@@ -159,6 +559,9 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
 }
 
 
+VirtualTexture::~VirtualTexture() = default;
+
+
 TextureTile
 VirtualTexture::getTile(int lod, int u, int v)
 {
@@ -176,6 +579,10 @@ VirtualTexture::getTile(int lod, int u, int v)
     const TileQuadtreeNode* node = &tileTree[u >> lod];
     Tile* tile = node->tile.get();
     unsigned int tileLOD = 0;
+    // The deepest tile which is already resident, used while the wanted
+    // tile is loaded in the background
+    Tile* residentTile = tile != nullptr && tile->isResident() ? tile : nullptr;
+    unsigned int residentLOD = 0;
 
     for (int n = 0; n < lod; n++)
     {
@@ -189,6 +596,11 @@ VirtualTexture::getTile(int lod, int u, int v)
         {
             tile = node->tile.get();
             tileLOD = n + 1;
+            if (tile->isResident())
+            {
+                residentTile = tile;
+                residentLOD = tileLOD;
+            }
         }
     }
 
@@ -199,13 +611,31 @@ VirtualTexture::getTile(int lod, int u, int v)
     // Make the tile resident.
     unsigned int tileU = u >> (lod - tileLOD);
     unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    if (TileLoader::get().isActive())
+    {
+        usedTiles.emplace_back(lod, u, v);
+        if (!tile->isResident())
+        {
+            if (!tile->loadFailed && !tile->loadPending)
+                requestTile(tile, tileLOD, tileU, tileV, false);
+            if (residentTile == nullptr)
+                return TextureTile(0);
+
+            tile = residentTile;
+            tileLOD = residentLOD;
+        }
+    }
+    else
+    {
+        makeResident(tile, tileLOD, tileU, tileV);
+    }
+    tile->lastUsed = ticks;
 
     // It's possible that we failed to make the tile resident, either
     // because the texture file was bad, or there was an unresolvable
     // out of memory situation.  In that case there is nothing else to
     // do but return a texture tile with a null texture name.
-    if (!tile->tex)
+    if (!tile->isResident())
         return TextureTile(0);
 
     // Set up the texture subrect to be the entire texture
@@ -221,6 +651,9 @@ VirtualTexture::getTile(int lod, int u, int v)
     texU = (u & ((1 << lodDiff) - 1)) * texDU;
     texV = (v & ((1 << lodDiff) - 1)) * texDV;
 
+    if (tile->atlasSlot >= 0)
+        return sparseAtlas->getTile(tile->atlasSlot, texU, texV, texDU, texDV);
+
     return TextureTile(tile->tex->getName(), texU, texV, texDU, texDV);
 }
 
@@ -259,58 +692,301 @@ VirtualTexture::beginUsage()
 {
     ticks++;
     tilesRequested = 0;
+    uploadLoadedTiles();
 }
 
 
 void
 VirtualTexture::endUsage()
 {
+    prefetchTiles();
+    evictTiles();
+}
+
+
+void
+VirtualTexture::setLoaderThreads(unsigned int nThreads)
+{
+    TileLoader::get().setThreads(nThreads);
+}
+
+
+void
+VirtualTexture::setTileCacheSize(std::size_t bytes)
+{
+    tileCacheSize = bytes;
 }
 
 
-std::unique_ptr<ImageTexture>
-VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+fs::path
+VirtualTexture::tileImagePath(unsigned int lod, unsigned int u, unsigned int v) const
 {
     lod >>= baseSplit;
     assert(lod < (unsigned)MaxResolutionLevels);
 
-    auto path = tilePath /
-                fmt::format("level{:d}", lod) /
-                fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+    return tilePath /
+           fmt::format("level{:d}", lod) /
+           fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+}
 
-    auto img = Image::load(path);
-    if (img == nullptr)
-        return nullptr;
 
-    std::unique_ptr<ImageTexture> tex = nullptr;
+bool
+VirtualTexture::createTileTexture(Tile* tile, const Image& img, unsigned int lod)
+{
+    // TODO: Virtual textures can have tiles in different formats, some
+    // compressed and some not. The compression flag doesn't make much
+    // sense for them.
+    compressed = img.isCompressed();
 
     // Only use mip maps for the LOD 0; for higher LODs, the function of mip
     // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
+    bool mipmapped = (lod >> baseSplit) == 0;
 
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = std::make_unique<ImageTexture>(*img, EdgeClamp, mipMapMode);
+    // Tiles without mip maps go to the sparse atlas when they fit into it,
+    // and get a texture of their own otherwise.
+    if (!mipmapped && !sparseAtlasFailed)
+    {
+        if (sparseAtlas == nullptr)
+        {
+            sparseAtlas = SparseAtlas::create(img, tileSize);
+            sparseAtlasFailed = sparseAtlas == nullptr;
+        }
 
-    // TODO: Virtual textures can have tiles in different formats, some
-    // compressed and some not. The compression flag doesn't make much
-    // sense for them.
-    compressed = img->isCompressed();
+        if (sparseAtlas != nullptr && sparseAtlas->accepts(img))
+        {
+            tile->atlasSlot = sparseAtlas->add(img);
+            if (tile->atlasSlot >= 0)
+                return true;
+        }
+    }
+
+    if (isPow2(img.getWidth()) && isPow2(img.getHeight()))
+        tile->tex = std::make_unique<ImageTexture>(img, EdgeClamp, mipmapped ? DefaultMipMaps : NoMipMaps);
 
-    return tex;
+    return tile->tex != nullptr;
+}
+
+
+void
+VirtualTexture::releaseTileTexture(Tile* tile)
+{
+    if (tile->atlasSlot >= 0)
+    {
+        sparseAtlas->remove(tile->atlasSlot);
+        tile->atlasSlot = -1;
+    }
+    tile->tex = nullptr;
+}
+
+
+VirtualTexture::Tile*
+VirtualTexture::findTile(unsigned int lod, unsigned int u, unsigned int v) const
+{
+    if (lod >= nResolutionLevels || u >= (2u << lod) || v >= (1u << lod))
+        return nullptr;
+
+    const TileQuadtreeNode* node = &tileTree[u >> lod];
+    for (unsigned int i = 0; i < lod; i++)
+    {
+        unsigned int mask = 1 << (lod - i - 1);
+        unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - i - 1);
+        if (!node->children[child])
+            return nullptr;
+        node = node->children[child].get();
+    }
+
+    return node->tile.get();
 }
 
 
 void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    if (!tile->isResident() && !tile->loadFailed)
+    {
+        auto img = Image::load(tileImagePath(lod, u, v));
+        if (img == nullptr || !createTileTexture(tile, *img, lod))
+        {
+            tile->loadFailed = true;
+        }
+        else
+        {
+            tile->size = static_cast<std::size_t>(img->getSize());
+            residentSize += tile->size;
+            residentTiles.emplace_back(tile, TileAddress(lod, u, v));
+        }
+    }
+}
+
+
+void
+VirtualTexture::requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, bool prefetch)
+{
+    tile->loadPending = true;
+    if (prefetch)
+        loadedTiles->pendingPrefetches++;
+    TileLoader::get().request(loadedTiles, TileAddress(lod, u, v), tileImagePath(lod, u, v), prefetch);
+}
+
+
+// Create the textures of the tiles decoded in the background
+void
+VirtualTexture::uploadLoadedTiles()
+{
+    for (std::size_t i = 0; i < MaxUploadsPerUsage; ++i)
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
+        LoadedTiles::LoadedTile loaded;
+        {
+            std::scoped_lock lock(loadedTiles->mutex);
+            if (loadedTiles->tiles.empty())
+                return;
+            loaded = std::move(loadedTiles->tiles.front());
+            loadedTiles->tiles.pop_front();
+        }
+
+        if (loaded.prefetch)
+            loadedTiles->pendingPrefetches--;
+
+        auto [lod, u, v] = loaded.address;
+        Tile* tile = findTile(lod, u, v);
+        if (tile == nullptr)
+            continue;
+
+        tile->loadPending = false;
+        if (loaded.cancelled || tile->isResident())
+            continue;
+
+        if (loaded.image == nullptr || !createTileTexture(tile, *loaded.image, lod))
         {
             tile->loadFailed = true;
+            continue;
+        }
+
+        tile->size = static_cast<std::size_t>(loaded.image->getSize());
+        // Prefetched tiles count as used now, so they aren't evicted
+        // before they're needed
+        tile->lastUsed = ticks;
+        residentSize += tile->size;
+        residentTiles.emplace_back(tile, loaded.address);
+    }
+}
+
+
+// Predict the tiles needed next from the tiles used since beginUsage: when
+// the view moves across the texture, the neighbors of the used tiles in the
+// direction of motion, and when zooming in, the tiles of the next level.
+void
+VirtualTexture::prefetchTiles()
+{
+    if (!TileLoader::get().isActive() || usedTiles.empty())
+    {
+        usedTiles.clear();
+        return;
+    }
+
+    std::sort(usedTiles.begin(), usedTiles.end());
+    usedTiles.erase(std::unique(usedTiles.begin(), usedTiles.end()), usedTiles.end());
+
+    unsigned int maxLOD = std::get<0>(usedTiles.back());
+    double centerU = 0.0;
+    double centerV = 0.0;
+    std::size_t nCenter = 0;
+    for (const auto& [lod, u, v] : usedTiles)
+    {
+        if (lod != maxLOD)
+            continue;
+        centerU += u + 0.5;
+        centerV += v + 0.5;
+        ++nCenter;
+    }
+    centerU /= static_cast<double>(nCenter);
+    centerV /= static_cast<double>(nCenter);
+
+    int du = 0;
+    int dv = 0;
+    if (maxLOD == lastMaxLOD && lastCenterU >= 0.0)
+    {
+        constexpr double MinMotion = 0.05;
+        if (centerU - lastCenterU > MinMotion)
+            du = 1;
+        else if (centerU - lastCenterU < -MinMotion)
+            du = -1;
+        if (centerV - lastCenterV > MinMotion)
+            dv = 1;
+        else if (centerV - lastCenterV < -MinMotion)
+            dv = -1;
+    }
+
+    if (maxLOD > lastMaxLOD)
+        zoomingIn = true;
+    else if (maxLOD < lastMaxLOD)
+        zoomingIn = false;
+
+    auto prefetch = [this](unsigned int lod, unsigned int u, unsigned int v)
+    {
+        if (loadedTiles->pendingPrefetches >= MaxPendingPrefetches)
+            return;
+
+        Tile* tile = findTile(lod, u, v);
+        if (tile != nullptr && !tile->isResident() && !tile->loadFailed && !tile->loadPending)
+            requestTile(tile, lod, u, v, true);
+    };
+
+    for (const auto& [lod, u, v] : usedTiles)
+    {
+        if (lod != maxLOD)
+            continue;
+
+        if (du != 0 || dv != 0)
+        {
+            // The texture wraps around horizontally
+            unsigned int uCount = 2u << lod;
+            prefetch(lod, (u + uCount + du) % uCount, static_cast<unsigned int>(static_cast<int>(v) + dv));
+        }
+
+        if (zoomingIn)
+        {
+            for (unsigned int child = 0; child < 4; ++child)
+                prefetch(lod + 1, u * 2 + (child & 1), v * 2 + (child >> 1));
+        }
+    }
+
+    lastMaxLOD = maxLOD;
+    lastCenterU = centerU;
+    lastCenterV = centerV;
+    usedTiles.clear();
+}
+
+
+// Evict the least recently used tiles until the resident tiles fit into the
+// cache. Tiles of the lowest level are kept, they are the fallback while
+// other tiles are loaded.
+void
+VirtualTexture::evictTiles()
+{
+    if (tileCacheSize == 0 || residentSize <= tileCacheSize)
+        return;
+
+    std::sort(residentTiles.begin(), residentTiles.end(),
+              [](const auto& a, const auto& b) { return a.first->lastUsed < b.first->lastUsed; });
+
+    std::size_t kept = 0;
+    for (auto& entry : residentTiles)
+    {
+        Tile* tile = entry.first;
+        if (residentSize > tileCacheSize &&
+            tile->lastUsed != ticks &&
+            std::get<0>(entry.second) > baseSplit)
+        {
+            residentSize -= tile->size;
+            releaseTileTexture(tile);
+            tile->size = 0;
+        }
+        else
+        {
+            residentTiles[kept++] = entry;
         }
     }
+    residentTiles.resize(kept);
 }
 
 
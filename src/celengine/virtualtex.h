@@ -10,8 +10,11 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include <celengine/texture.h>
@@ -25,7 +28,7 @@ public:
                    unsigned int _tileSize,
                    const std::string& _tilePrefix,
                    const std::string& _tileType);
-    ~VirtualTexture() = default;
+    ~VirtualTexture();
 
     TextureTile getTile(int lod, int u, int v) override;
     void bind() override;
@@ -36,15 +39,35 @@ public:
     void beginUsage() override;
     void endUsage() override;
 
+    // Decode tiles on nThreads worker threads shared by all virtual
+    // textures. With 0 threads tiles are loaded when they are first drawn.
+    static void setLoaderThreads(unsigned int nThreads);
+    // Maximum size in bytes of the resident tiles of each virtual texture;
+    // the least recently used tiles are evicted above it. 0 is unlimited.
+    static void setTileCacheSize(std::size_t bytes);
+
 private:
+    class TileLoader;
+    class SparseAtlas;
+    struct LoadedTiles;
+
     struct Tile
     {
         Tile() = default;
         unsigned int lastUsed{ 0 };
         std::unique_ptr<ImageTexture> tex{ nullptr };
+        std::size_t size{ 0 };
+        // Slot of the tile in the sparse atlas, used instead of tex
+        int atlasSlot{ -1 };
         bool loadFailed{ false };
+        bool loadPending{ false };
+
+        bool isResident() const { return tex != nullptr || atlasSlot >= 0; }
     };
 
+    // Level, u and v of a tile
+    using TileAddress = std::tuple<unsigned int, unsigned int, unsigned int>;
+
     struct TileQuadtreeNode
     {
         TileQuadtreeNode() = default;
@@ -54,8 +77,15 @@ private:
 
     void populateTileTree();
     void addTileToTree(std::unique_ptr<Tile> tile, unsigned int lod, unsigned int u, unsigned int v);
+    Tile* findTile(unsigned int lod, unsigned int u, unsigned int v) const;
     void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    std::unique_ptr<ImageTexture> loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    void requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, bool prefetch);
+    void uploadLoadedTiles();
+    void prefetchTiles();
+    void evictTiles();
+    fs::path tileImagePath(unsigned int lod, unsigned int u, unsigned int v) const;
+    bool createTileTexture(Tile* tile, const celestia::engine::Image& img, unsigned int lod);
+    void releaseTileTexture(Tile* tile);
 
 private:
     fs::path tilePath;
@@ -74,6 +104,21 @@ private:
     };
 
     std::array<TileQuadtreeNode, 2> tileTree{};
+
+    // Bytes used by the resident tiles
+    std::size_t residentSize{ 0 };
+    std::vector<std::pair<Tile*, TileAddress>> residentTiles;
+    // Tiles requested since the last call to beginUsage, for predicting
+    // the tiles needed next
+    std::vector<TileAddress> usedTiles;
+    unsigned int lastMaxLOD{ 0 };
+    bool zoomingIn{ false };
+    double lastCenterU{ -1.0 };
+    double lastCenterV{ -1.0 };
+    std::shared_ptr<LoadedTiles> loadedTiles;
+    // Tiles above the base level, when sparse textures are supported
+    std::unique_ptr<SparseAtlas> sparseAtlas;
+    bool sparseAtlasFailed{ false };
 };
 
 
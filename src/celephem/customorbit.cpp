@@ -14,7 +14,6 @@
 #include <cstddef>
 #include <cstring>
 #include <cmath>
-#include <fstream>
 #include <map>
 #include <memory>
 #include <utility>
@@ -27,6 +26,7 @@
 #include <celutil/logger.h>
 #include "jpleph.h"
 #include "orbit.h"
+#include "tabulatedorbit.h"
 #include "vsop87.h"
 
 using namespace std::string_view_literals;
@@ -57,6 +57,10 @@ constexpr double SaturnRadius = 60330.0;
 // the apocenter distance computed from the mean elements.
 constexpr double BoundingRadiusSlack = 1.2;
 
+// Span in days of the windows of Chebyshev approximations of the
+// analytic theories, 0 if they are evaluated directly
+double tableSpan = 0.0;
+
 using PlanetElements = std::array<double, 9>;
 using StaticElements = std::array<double, 23>;
 
@@ -211,6 +215,15 @@ PlanetOrbitMixin::computePlanetCoords(int p, double map, double da, double dhl,
 }
 
 
+std::unique_ptr<Orbit>
+Tabulate(std::unique_ptr<Orbit>&& orbit)
+{
+    if (tableSpan <= 0.0)
+        return std::move(orbit);
+    return std::make_unique<TabulatedOrbit>(std::move(orbit), tableSpan);
+}
+
+
 // Useful version of trig functions which operate on values in degrees instead
 // of radians.
 double sinD(double theta)
@@ -2713,13 +2726,13 @@ std::unique_ptr<Orbit> CreateUranianSatelliteOrbit(int n)
     assert(n >= 1 && n <= 5);
     --n;
 
-    return std::make_unique<UranianSatelliteOrbit>(uran_a[n], uran_n[n],
-                                                   uran_L0[n], uran_L1[n],
-                                                   uran_L_k[n], uran_L_theta[n],
-                                                   uran_L_phi[n], uran_z_k[n],
-                                                   uran_z_theta[n], uran_z_phi[n],
-                                                   uran_zeta_k[n], uran_zeta_theta[n],
-                                                   uran_zeta_phi[n]);
+    return Tabulate(std::make_unique<UranianSatelliteOrbit>(uran_a[n], uran_n[n],
+                                                            uran_L0[n], uran_L1[n],
+                                                            uran_L_k[n], uran_L_theta[n],
+                                                            uran_L_phi[n], uran_z_k[n],
+                                                            uran_z_theta[n], uran_z_phi[n],
+                                                            uran_zeta_k[n], uran_zeta_theta[n],
+                                                            uran_zeta_phi[n]));
 }
 
 
@@ -3121,9 +3134,7 @@ std::unique_ptr<Orbit> CreateJPLEphOrbit(JPLEphemItem target,
     if (!jplephInitialized)
     {
         jplephInitialized = true;
-        std::ifstream in("data/jpleph.dat", std::ios::in | std::ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        jpleph = JPLEphemeris::load(fs::path("data/jpleph.dat"));
         if (jpleph != nullptr)
         {
             if (unsigned int deNumber = jpleph->getDENumber(); deNumber != 100)
@@ -3159,69 +3170,69 @@ double yearToJD(int year)
 std::unique_ptr<Orbit>
 CreateMercuryOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<MercuryOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<MercuryOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateVenusOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<VenusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<VenusOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateEarthOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<EarthOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<EarthOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateMoonOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<LunarOrbit>(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<LunarOrbit>()), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateMarsOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<MarsOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<MarsOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateJupiterOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<JupiterOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<JupiterOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateSaturnOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<SaturnOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<SaturnOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 std::unique_ptr<Orbit>
 CreateUranusOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<UranusOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<UranusOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreateNeptuneOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<NeptuneOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<NeptuneOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
 std::unique_ptr<Orbit>
 CreatePlutoOrbit()
 {
-    return std::make_unique<MixedOrbit>(std::make_unique<PlutoOrbit>(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+    return std::make_unique<MixedOrbit>(Tabulate(std::make_unique<PlutoOrbit>()), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 }
 
 
@@ -3410,21 +3421,21 @@ CreateJplSunSsbOrbit()
 std::unique_ptr<Orbit>
 CreateHeleneOrbit()
 {
-    return std::make_unique<HTC20Orbit>(24, HeleneTerms.data(), HeleneAmps.data(), HeleneAngles, 2.736915, 380000);
+    return Tabulate(std::make_unique<HTC20Orbit>(24, HeleneTerms.data(), HeleneAmps.data(), HeleneAngles, 2.736915, 380000));
 }
 
 
 std::unique_ptr<Orbit>
 CreateTelestoOrbit()
 {
-    return std::make_unique<HTC20Orbit>(12, TelestoTerms.data(), TelestoAmps.data(), TelestoAngles, 1.887802, 300000);
+    return Tabulate(std::make_unique<HTC20Orbit>(12, TelestoTerms.data(), TelestoAmps.data(), TelestoAngles, 1.887802, 300000));
 }
 
 
 std::unique_ptr<Orbit>
 CreateCalypsoOrbit()
 {
-    return std::make_unique<HTC20Orbit>(24, CalypsoTerms.data(), CalypsoAmps.data(), CalypsoAngles, 1.887803, 300000);
+    return Tabulate(std::make_unique<HTC20Orbit>(24, CalypsoTerms.data(), CalypsoAmps.data(), CalypsoAngles, 1.887803, 300000));
 }
 
 
@@ -3432,105 +3443,105 @@ CreateCalypsoOrbit()
 std::unique_ptr<Orbit>
 CreatePhobosOrbit()
 {
-    return std::make_unique<PhobosOrbit>();
+    return Tabulate(std::make_unique<PhobosOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateDeimosOrbit()
 {
-    return std::make_unique<DeimosOrbit>();
+    return Tabulate(std::make_unique<DeimosOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateIoOrbit()
 {
-    return std::make_unique<IoOrbit>();
+    return Tabulate(std::make_unique<IoOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateEuropaOrbit()
 {
-    return std::make_unique<EuropaOrbit>();
+    return Tabulate(std::make_unique<EuropaOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateGanymedeOrbit()
 {
-    return std::make_unique<GanymedeOrbit>();
+    return Tabulate(std::make_unique<GanymedeOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateCallistoOrbit()
 {
-    return std::make_unique<CallistoOrbit>();
+    return Tabulate(std::make_unique<CallistoOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateMimasOrbit()
 {
-    return std::make_unique<MimasOrbit>();
+    return Tabulate(std::make_unique<MimasOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateEnceladusOrbit()
 {
-    return std::make_unique<EnceladusOrbit>();
+    return Tabulate(std::make_unique<EnceladusOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateTethysOrbit()
 {
-    return std::make_unique<TethysOrbit>();
+    return Tabulate(std::make_unique<TethysOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateDioneOrbit()
 {
-    return std::make_unique<DioneOrbit>();
+    return Tabulate(std::make_unique<DioneOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateRheaOrbit()
 {
-    return std::make_unique<RheaOrbit>();
+    return Tabulate(std::make_unique<RheaOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateTitanOrbit()
 {
-    return std::make_unique<TitanOrbit>();
+    return Tabulate(std::make_unique<TitanOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateHyperionOrbit()
 {
-    return std::make_unique<HyperionOrbit>();
+    return Tabulate(std::make_unique<HyperionOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreateIapetusOrbit()
 {
-    return std::make_unique<IapetusOrbit>();
+    return Tabulate(std::make_unique<IapetusOrbit>());
 }
 
 
 std::unique_ptr<Orbit>
 CreatePhoebeOrbit()
 {
-    return std::make_unique<PhoebeOrbit>();
+    return Tabulate(std::make_unique<PhoebeOrbit>());
 }
 
 
@@ -3572,7 +3583,7 @@ CreateOberonOrbit()
 std::unique_ptr<Orbit>
 CreateTritonOrbit()
 {
-    return std::make_unique<TritonOrbit>();
+    return Tabulate(std::make_unique<TritonOrbit>());
 }
 
 
@@ -3584,6 +3595,12 @@ using CustomOrbitFactory = std::unique_ptr<Orbit> (*)();
 } // end unnamed namespace
 
 
+void SetCustomOrbitTableSpan(double span)
+{
+    tableSpan = span;
+}
+
+
 std::unique_ptr<Orbit> GetCustomOrbit(std::string_view name)
 {
     auto ptr = CustomOrbitMap::getOrbitType(name.data(), name.size());
@@ -19,4 +19,9 @@ class Orbit;
 
 std::unique_ptr<Orbit> GetCustomOrbit(std::string_view name);
 
+// Evaluate the analytic theories of orbits created afterwards from
+// Chebyshev approximations over a window of span days around the current
+// time, or directly if span is 0. See TabulatedOrbit.
+void SetCustomOrbitTableSpan(double span);
+
 }
@@ -152,28 +152,7 @@ public:
         else if (T > P03LP_VALID_CENTURIES)
             T = P03LP_VALID_CENTURIES;
 
-        PrecessionAngles prec = PrecObliquity_P03LP(T);
-        EclipticPole pole = EclipticPrecession_P03LP(T);
-
-        double obliquity = math::degToRad(prec.epsA / 3600);
-        double precession = math::degToRad(prec.pA / 3600);
-
-        // Calculate the angles pi and Pi from the ecliptic pole coordinates
-        // P and Q:
-        //   P = sin(pi)*sin(Pi)
-        //   Q = sin(pi)*cos(Pi)
-        double P = pole.PA * 2.0 * celestia::numbers::pi / 1296000;
-        double Q = pole.QA * 2.0 * celestia::numbers::pi / 1296000;
-        double piA = std::asin(std::sqrt(P * P + Q * Q));
-        double PiA = std::atan2(P, Q);
-
-        // Calculate the rotation from the J2000 ecliptic to the ecliptic
-        // of date.
-        Eigen::Quaterniond RPi = math::ZRotation(PiA);
-        Eigen::Quaterniond rpi = math::XRotation(piA);
-        Eigen::Quaterniond eclRotation = RPi.conjugate() * rpi * RPi;
-
-        Eigen::Quaterniond q = math::XRotation(obliquity) * math::ZRotation(-precession) * eclRotation.conjugate();
+        Eigen::Quaterniond q = TabulatedMeanEquatorOfDate_P03LP(T);
 
         // convert to Celestia's coordinate system
         return math::XRot90<double> * q * math::XRot90Conjugate<double>;
@@ -14,7 +14,9 @@
 #include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <istream>
+#include <utility>
 #include <type_traits>
 
 #include <celcompat/bit.h>
@@ -192,9 +194,21 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
     // recNo is always >= 0:
     auto recNo = (unsigned int) ((tjd - startDate) / daysPerInterval);
     // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
+
+    // The cached record must not be evicted while it is being used
+    std::unique_lock<std::mutex> lock(cacheMutex, std::defer_lock);
+    const JPLEphRecord* rec;
+    if (mappedFile.has_value())
+    {
+        lock.lock();
+        rec = &getMappedRecord(recNo);
+    }
+    else
+    {
+        rec = &records[recNo];
+    }
 
     auto planetIdx = static_cast<std::size_t>(planet);
 
@@ -217,6 +231,9 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
     {
         double daysPerGranule = daysPerInterval / coeffInfo[planetIdx].nGranules;
         auto granule = (int) ((tjd - rec->t0) / daysPerGranule);
+        // tjd == endDate is at the end of the last granule
+        if (granule >= (int) coeffInfo[planetIdx].nGranules)
+            granule = (int) coeffInfo[planetIdx].nGranules - 1;
         double granuleStartDate = rec->t0 + daysPerGranule * (double) granule;
         coeffs = rec->coeffs.data() + coeffInfo[planetIdx].offset +
                  granule * coeffInfo[planetIdx].nCoeffs * 3;
@@ -243,15 +260,50 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
 }
 
 
-JPLEphemeris* JPLEphemeris::load(std::istream& in)
+// Decode a record of a mapped file, replacing the least recently used one
+// if the cache is full. Must be called with cacheMutex locked.
+const JPLEphRecord& JPLEphemeris::getMappedRecord(unsigned int recNo) const
 {
-    std::array<char, sizeof(JPLEFileHeader)> fh;
-    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
-    if (!in.good())
-        return nullptr;
+    ++useCounter;
+    auto lru = recordCache.begin();
+    for (auto it = recordCache.begin(); it != recordCache.end(); ++it)
+    {
+        if (it->recNo == recNo)
+        {
+            it->lastUse = useCounter;
+            return it->record;
+        }
+
+        if (it->lastUse < lru->lastUse)
+            lru = it;
+    }
 
+    if (recordCache.size() < RecordCacheSize)
+    {
+        recordCache.emplace_back();
+        lru = recordCache.end() - 1;
+    }
+
+    lru->recNo = recNo;
+    lru->lastUse = useCounter;
+
+    const char* ptr = mappedFile->data() + firstRecordOffset +
+                      static_cast<std::size_t>(recNo) * recordSize * sizeof(double);
+    JPLEphRecord& record = lru->record;
+    getMaybeSwapDouble(record.t0, ptr, swapBytes);
+    getMaybeSwapDouble(record.t1, ptr + sizeof(double), swapBytes);
+    record.coeffs.resize(recordSize - 2);
+    for (unsigned int j = 0; j < recordSize - 2; j++)
+        getMaybeSwapDouble(record.coeffs[j], ptr + (j + 2) * sizeof(double), swapBytes);
+
+    return record;
+}
+
+
+JPLEphemeris* JPLEphemeris::createFromHeader(const char* fh)
+{
     decltype(JPLEFileHeader::deNum) deNum;
-    std::memcpy(&deNum, fh.data() + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
+    std::memcpy(&deNum, fh + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
     std::uint32_t deNum2 = compat::byteswap(deNum);
 
     bool swapBytes;
@@ -288,18 +340,18 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
     eph->DENum = deNum;
 
     // Read the start time, end time, and time interval
-    getMaybeSwapDouble(eph->startDate,          fh.data() + offsetof(JPLEFileHeader, startDate),          swapBytes);
-    getMaybeSwapDouble(eph->endDate,            fh.data() + offsetof(JPLEFileHeader, endDate),            swapBytes);
-    getMaybeSwapDouble(eph->daysPerInterval,    fh.data() + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
+    getMaybeSwapDouble(eph->startDate,          fh + offsetof(JPLEFileHeader, startDate),          swapBytes);
+    getMaybeSwapDouble(eph->endDate,            fh + offsetof(JPLEFileHeader, endDate),            swapBytes);
+    getMaybeSwapDouble(eph->daysPerInterval,    fh + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
     // kilometers per astronomical unit
-    getMaybeSwapDouble(eph->au,                 fh.data() + offsetof(JPLEFileHeader, au),                 swapBytes);
-    getMaybeSwapDouble(eph->earthMoonMassRatio, fh.data() + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
+    getMaybeSwapDouble(eph->au,                 fh + offsetof(JPLEFileHeader, au),                 swapBytes);
+    getMaybeSwapDouble(eph->earthMoonMassRatio, fh + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
 
     // Read the coefficient information for each item in the ephemeris
     eph->recordSize = 0;
     for (unsigned int i = 0; i < JPLEph_NItems; i++)
     {
-        const char* coeffInfo = fh.data() + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
+        const char* coeffInfo = fh + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
         getMaybeSwapUint32(eph->coeffInfo[i].offset,    coeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nCoeffs,   coeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nGranules, coeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
@@ -309,15 +361,33 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
         eph->recordSize += eph->coeffInfo[i].nCoeffs * eph->coeffInfo[i].nGranules * nRecords;
     }
 
-    const char* librationCoeffInfo = fh.data() + offsetof(JPLEFileHeader, librationCoeffInfo);
+    const char* librationCoeffInfo = fh + offsetof(JPLEFileHeader, librationCoeffInfo);
     getMaybeSwapUint32(eph->librationCoeffInfo.offset,    librationCoeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nCoeffs,   librationCoeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nGranules, librationCoeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
     eph->recordSize += eph->librationCoeffInfo.nCoeffs * eph->librationCoeffInfo.nGranules * 3;
     eph->recordSize += 2;   // record start and end time
 
+    eph->nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
+                        eph->daysPerInterval);
+
+    return eph;
+}
+
+
+JPLEphemeris* JPLEphemeris::load(std::istream& in)
+{
+    std::array<char, sizeof(JPLEFileHeader)> fh;
+    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
+    if (!in.good())
+        return nullptr;
+
+    auto *eph = createFromHeader(fh.data());
+    if (eph == nullptr)
+        return nullptr;
+
     // if INPOP ephemeris, read record size
-    if (deNum == INPOP_DE_COMPATIBLE)
+    if (eph->DENum == INPOP_DE_COMPATIBLE)
     {
        eph->recordSize = readUint(in, eph->swapBytes);
        // Skip past the rest of the record
@@ -337,10 +407,8 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
         return nullptr;
     }
 
-    auto nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
-                        eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (unsigned int i = 0; i < nRecords; i++)
+    eph->records.resize(eph->nRecords);
+    for (unsigned int i = 0; i < eph->nRecords; i++)
     {
         eph->records[i].t0 = readDouble(in, eph->swapBytes);
         eph->records[i].t1 = readDouble(in, eph->swapBytes);
@@ -362,4 +430,47 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
     return eph;
 }
 
+
+JPLEphemeris* JPLEphemeris::map(const fs::path& filename)
+{
+    auto file = util::MappedFile::open(filename);
+    if (!file.has_value() || file->size() < sizeof(JPLEFileHeader) + sizeof(std::uint32_t))
+        return nullptr;
+
+    auto *eph = createFromHeader(file->data());
+    if (eph == nullptr)
+        return nullptr;
+
+    if (eph->DENum == INPOP_DE_COMPATIBLE)
+        getMaybeSwapUint32(eph->recordSize, file->data() + sizeof(JPLEFileHeader), eph->swapBytes);
+
+    // The records follow the header and the constants, which take one
+    // record each
+    eph->firstRecordOffset = std::size_t(2) * eph->recordSize * sizeof(double);
+    std::size_t dataSize = std::size_t(eph->nRecords) * eph->recordSize * sizeof(double);
+    if (eph->recordSize <= 2 || eph->nRecords == 0 ||
+        file->size() < eph->firstRecordOffset ||
+        file->size() - eph->firstRecordOffset < dataSize)
+    {
+        delete eph;
+        return nullptr;
+    }
+
+    eph->mappedFile = std::move(file);
+    eph->recordCache.reserve(RecordCacheSize);
+    return eph;
+}
+
+
+JPLEphemeris* JPLEphemeris::load(const fs::path& filename)
+{
+    if (auto *eph = map(filename); eph != nullptr)
+        return eph;
+
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return nullptr;
+    return load(in);
+}
+
 } // end namespace celestia::ephem
@@ -16,10 +16,15 @@
 #include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 #include <Eigen/Core>
 
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
+
 namespace celestia::ephem
 {
 
@@ -72,7 +77,11 @@ public:
 
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
 
+    // Read all records into memory
     static JPLEphemeris* load(std::istream&);
+    // Map the file and decode records on demand, falling back to reading
+    // it if it can't be mapped
+    static JPLEphemeris* load(const fs::path&);
 
     unsigned int getDENumber() const;
     double getStartDate() const;
@@ -81,6 +90,21 @@ public:
     unsigned int getRecordSize() const;
 
 private:
+    // Number of decoded records kept for mapped files
+    static constexpr std::size_t RecordCacheSize = 8;
+
+    struct CachedRecord
+    {
+        unsigned int recNo;
+        std::uint64_t lastUse;
+        JPLEphRecord record;
+    };
+
+    static JPLEphemeris* createFromHeader(const char* header);
+    static JPLEphemeris* map(const fs::path&);
+
+    const JPLEphRecord& getMappedRecord(unsigned int recNo) const;
+
     std::array<JPLEphCoeffInfo, JPLEph_NItems> coeffInfo;
     JPLEphCoeffInfo librationCoeffInfo;
 
@@ -95,7 +119,15 @@ private:
     unsigned int recordSize;  // number of doubles per record
     bool swapBytes;
 
+    unsigned int nRecords{ 0 };
     std::vector<JPLEphRecord> records;
+
+    // Records of mapped files are decoded into a small LRU cache
+    std::optional<util::MappedFile> mappedFile;
+    std::size_t firstRecordOffset{ 0 };
+    mutable std::mutex cacheMutex;
+    mutable std::vector<CachedRecord> recordCache;
+    mutable std::uint64_t useCounter{ 0 };
 };
 
 } // end namespace celestia::ephem
@@ -11,6 +11,7 @@
 #include "orbit.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <functional>
@@ -21,6 +22,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include <celmath/geomutil.h>
+#include "threadcache.h"
 
 namespace celestia::ephem
 {
@@ -35,6 +37,151 @@ constexpr double ORBITAL_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 // Follow hyperbolic orbit trajectories out to at least 1000 au
 constexpr double HyperbolicMinBoundingRadius = 1000.0 * astro::KM_PER_AU<double>;
 
+// Number of Keplerian orbits solved together by PositionsAtTime
+constexpr std::size_t KeplerBatchSize = 64;
+
+// Newton iterations stop once every correction in a batch is below this
+constexpr double KeplerBatchTolerance = 1.0e-12;
+constexpr int MaxEllipticalIterations = 12;
+constexpr int MaxHyperbolicIterations = 30;
+
+// Elements of a batch of Keplerian orbits of the same kind, as arrays so
+// that the loops over them can be vectorized
+struct KeplerBatch
+{
+    // Add an orbit whose position goes to positions[index]; return true
+    // when the batch is full
+    bool add(std::size_t _index, double _M, double _e, double _a, double _b, const Eigen::Matrix3d& _rotation)
+    {
+        index[count] = _index;
+        M[count] = _M;
+        e[count] = _e;
+        a[count] = _a;
+        b[count] = _b;
+        rotation[count] = &_rotation;
+        return ++count == KeplerBatchSize;
+    }
+
+    std::size_t count{ 0 };
+    std::array<std::size_t, KeplerBatchSize> index;
+    std::array<double, KeplerBatchSize> M;
+    std::array<double, KeplerBatchSize> e;
+    std::array<double, KeplerBatchSize> a;
+    std::array<double, KeplerBatchSize> b;
+    std::array<const Eigen::Matrix3d*, KeplerBatchSize> rotation;
+    // Eccentric anomalies, then the coordinates in the orbit plane
+    std::array<double, KeplerBatchSize> E;
+    std::array<double, KeplerBatchSize> x;
+    std::array<double, KeplerBatchSize> y;
+};
+
+// Rotate the orbit plane coordinates of a batch into positions, and empty it
+void
+storeBatchPositions(KeplerBatch& batch, Eigen::Vector3d* positions)
+{
+    for (std::size_t i = 0; i < batch.count; ++i)
+    {
+        Eigen::Vector3d p = *batch.rotation[i] * Eigen::Vector3d(batch.x[i], batch.y[i], 0.0);
+
+        // Convert to Celestia's internal coordinate system
+        positions[batch.index[i]] = Eigen::Vector3d(p.x(), p.z(), -p.y());
+    }
+
+    batch.count = 0;
+}
+
+// Solve M = E - e sin E for a batch of elliptical orbits. The mean anomalies
+// are reduced to [-pi, pi], from which Newton's method converges for any
+// eccentricity from the starting value of Danby's.
+void
+solveEllipticalBatch(KeplerBatch& batch, Eigen::Vector3d* positions)
+{
+    const std::size_t n = batch.count;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        double M = std::remainder(batch.M[i], 2.0 * celestia::numbers::pi);
+        batch.M[i] = M;
+        batch.E[i] = M + 0.85 * batch.e[i] * std::copysign(1.0, M);
+    }
+
+    for (int iter = 0; iter < MaxEllipticalIterations; ++iter)
+    {
+        double maxCorrection = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double E = batch.E[i];
+            double dE = (E - batch.e[i] * std::sin(E) - batch.M[i]) / (1.0 - batch.e[i] * std::cos(E));
+            batch.E[i] = E - dE;
+            maxCorrection = std::max(maxCorrection, std::abs(dE));
+        }
+
+        if (maxCorrection < KeplerBatchTolerance)
+            break;
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        batch.x[i] = batch.a[i] * (std::cos(batch.E[i]) - batch.e[i]);
+        batch.y[i] = batch.b[i] * std::sin(batch.E[i]);
+    }
+
+    storeBatchPositions(batch, positions);
+}
+
+// Solve M = e sinh H - H for a batch of hyperbolic orbits, from the same
+// starting value as HyperbolicOrbit::eccentricAnomaly
+void
+solveHyperbolicBatch(KeplerBatch& batch, Eigen::Vector3d* positions)
+{
+    const std::size_t n = batch.count;
+    for (std::size_t i = 0; i < n; ++i)
+        batch.E[i] = std::copysign(std::log(2.0 * std::abs(batch.M[i]) / batch.e[i] + 1.85), batch.M[i]);
+
+    for (int iter = 0; iter < MaxHyperbolicIterations; ++iter)
+    {
+        double maxCorrection = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double H = batch.E[i];
+            double dH = (batch.e[i] * std::sinh(H) - H - batch.M[i]) / (batch.e[i] * std::cosh(H) - 1.0);
+            batch.E[i] = H - dH;
+            maxCorrection = std::max(maxCorrection, std::abs(dH) / std::max(1.0, std::abs(H)));
+        }
+
+        if (maxCorrection < KeplerBatchTolerance)
+            break;
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        batch.x[i] = -batch.a[i] * (batch.e[i] - std::cosh(batch.E[i]));
+        batch.y[i] = -batch.b[i] * std::sinh(batch.E[i]);
+    }
+
+    storeBatchPositions(batch, positions);
+}
+
+struct OrbitCacheEntry
+{
+    // Take over the entry for another object or time
+    void reset(std::uint64_t _id, double _time)
+    {
+        if (id == _id && time == _time)
+            return;
+        id = _id;
+        time = _time;
+        positionValid = false;
+        velocityValid = false;
+    }
+
+    std::uint64_t id{ 0 };
+    double time{ 0.0 };
+    Eigen::Vector3d position{ Eigen::Vector3d::Zero() };
+    Eigen::Vector3d velocity{ Eigen::Vector3d::Zero() };
+    bool positionValid{ false };
+    bool velocityValid{ false };
+};
+
 Eigen::Vector3d cubicInterpolate(const Eigen::Vector3d& p0, const Eigen::Vector3d& v0,
                                  const Eigen::Vector3d& p1, const Eigen::Vector3d& v1,
                                  double t)
@@ -268,6 +415,13 @@ Eigen::Vector3d Orbit::velocityAtTime(double tdb) const
 }
 
 
+void Orbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = positionAtTime(t);
+}
+
+
 EllipticalOrbit::EllipticalOrbit(const astro::KeplerElements& _elements, double _epoch) :
     semiMajorAxis(_elements.semimajorAxis),
     eccentricity(_elements.eccentricity),
@@ -281,6 +435,7 @@ EllipticalOrbit::EllipticalOrbit(const astro::KeplerElements& _elements, double
     assert(eccentricity >= 0.0 && eccentricity < 1.0);
     assert(semiMajorAxis >= 0.0);
     assert(period != 0.0);
+    keplerKind = KeplerKind::Elliptical;
     semiMinorAxis = semiMajorAxis * std::sqrt(1.0 - math::square(eccentricity));
 }
 
@@ -369,6 +524,14 @@ Eigen::Vector3d EllipticalOrbit::velocityAtTime(double t) const
 }
 
 
+void EllipticalOrbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    double meanMotion = 2.0 * celestia::numbers::pi / period;
+    for (double t : times)
+        *positions++ = positionAtE(eccentricAnomaly(meanAnomalyAtEpoch + (t - epoch) * meanMotion));
+}
+
+
 double EllipticalOrbit::getPeriod() const
 {
     return period;
@@ -382,6 +545,12 @@ double EllipticalOrbit::getBoundingRadius() const
 }
 
 
+double EllipticalOrbit::getMinimumRadius() const
+{
+    return semiMajorAxis * (1.0 - eccentricity);
+}
+
+
 HyperbolicOrbit::HyperbolicOrbit(const astro::KeplerElements& _elements, double _epoch) :
     semiMajorAxis(_elements.semimajorAxis),
     eccentricity(_elements.eccentricity),
@@ -394,6 +563,7 @@ HyperbolicOrbit::HyperbolicOrbit(const astro::KeplerElements& _elements, double
     assert(eccentricity > 1.0);
     assert(semiMajorAxis <= 0.0);
     assert(_elements.period != 0.0);
+    keplerKind = KeplerKind::Hyperbolic;
     semiMinorAxis = semiMajorAxis * std::sqrt(math::square(eccentricity) - 1.0);
     meanMotion = 2.0 * celestia::numbers::pi / _elements.period;
 
@@ -498,41 +668,46 @@ void HyperbolicOrbit::getValidRange(double& begin, double& end) const
 
 
 
+CachingOrbit::CachingOrbit() :
+    cacheId(detail::NewThreadCacheId())
+{
+}
+
+
 Eigen::Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    }
-    else if (!positionCacheValid)
-    {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
+    auto& entry = detail::GetThreadCacheEntry<OrbitCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == jd && entry.positionValid)
+        return entry.position;
+
+    // Computing the position may use the cache entry for other orbits
+    Eigen::Vector3d position = computePosition(jd);
+    entry.reset(cacheId, jd);
+    entry.position = position;
+    entry.positionValid = true;
+    return position;
+}
 
-    return lastPosition;
+
+void CachingOrbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = computePosition(t);
 }
 
 
 Eigen::Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
-    {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+    auto& entry = detail::GetThreadCacheEntry<OrbitCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == jd && entry.velocityValid)
+        return entry.velocity;
 
-    return lastVelocity;
+    // The default computeVelocity() caches the position at jd
+    Eigen::Vector3d velocity = computeVelocity(jd);
+    entry.reset(cacheId, jd);
+    entry.velocity = velocity;
+    entry.velocityValid = true;
+    return velocity;
 }
 
 
@@ -608,6 +783,35 @@ Eigen::Vector3d MixedOrbit::velocityAtTime(double jd) const
 }
 
 
+void MixedOrbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    // Pass runs of times in the same span to the orbit covering it
+    std::size_t first = 0;
+    while (first < times.size())
+    {
+        const Orbit* o;
+        if (times[first] < begin)
+            o = beforeApprox.get();
+        else if (times[first] < end)
+            o = primary.get();
+        else
+            o = afterApprox.get();
+
+        std::size_t last = first + 1;
+        while (last < times.size() &&
+               (times[last] < begin) == (times[first] < begin) &&
+               (times[last] < end) == (times[first] < end))
+        {
+            ++last;
+        }
+
+        o->positionsAtTimes(util::array_view<double>(times.data() + first, last - first),
+                            positions + first);
+        first = last;
+    }
+}
+
+
 double MixedOrbit::getPeriod() const
 {
     return primary->getPeriod();
@@ -620,6 +824,12 @@ double MixedOrbit::getBoundingRadius() const
 }
 
 
+bool MixedOrbit::isThreadSafe() const
+{
+    return primary->isThreadSafe();
+}
+
+
 void MixedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
     const Orbit* o;
@@ -647,6 +857,13 @@ FixedOrbit::positionAtTime(double /*tjd*/) const
 }
 
 
+void
+FixedOrbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    std::fill_n(positions, times.size(), position);
+}
+
+
 bool
 FixedOrbit::isPeriodic() const
 {
@@ -668,6 +885,13 @@ FixedOrbit::getBoundingRadius() const
 }
 
 
+double
+FixedOrbit::getMinimumRadius() const
+{
+    return position.norm();
+}
+
+
 void
 FixedOrbit::sample(double /* startTime */, double /* endTime */, OrbitSampleProc& /*proc*/) const
 {
@@ -709,4 +933,40 @@ void SynchronousOrbit::sample(double /* startTime */, double /* endTime */, Orbi
     // Empty method--we never want to show a synchronous orbit.
 }
 
+
+void PositionsAtTime(util::array_view<const Orbit*> orbits, double jd, Eigen::Vector3d* positions)
+{
+    KeplerBatch elliptical;
+    KeplerBatch hyperbolic;
+    for (std::size_t i = 0; i < orbits.size(); ++i)
+    {
+        const Orbit* orbit = orbits[i];
+        switch (orbit->keplerKind)
+        {
+        case Orbit::KeplerKind::Elliptical:
+        {
+            const auto* o = static_cast<const EllipticalOrbit*>(orbit);
+            double M = o->meanAnomalyAtEpoch + (jd - o->epoch) * (2.0 * celestia::numbers::pi / o->period);
+            if (elliptical.add(i, M, o->eccentricity, o->semiMajorAxis, o->semiMinorAxis, o->orbitPlaneRotation))
+                solveEllipticalBatch(elliptical, positions);
+            break;
+        }
+        case Orbit::KeplerKind::Hyperbolic:
+        {
+            const auto* o = static_cast<const HyperbolicOrbit*>(orbit);
+            double M = o->meanAnomalyAtEpoch + (jd - o->epoch) * o->meanMotion;
+            if (hyperbolic.add(i, M, o->eccentricity, o->semiMajorAxis, o->semiMinorAxis, o->orbitPlaneRotation))
+                solveHyperbolicBatch(hyperbolic, positions);
+            break;
+        }
+        default:
+            positions[i] = orbit->positionAtTime(jd);
+            break;
+        }
+    }
+
+    solveEllipticalBatch(elliptical, positions);
+    solveHyperbolicBatch(hyperbolic, positions);
+}
+
 } // end namespace celestia::ephem
@@ -9,11 +9,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
 #include <Eigen/Core>
 
 #include <celastro/astro.h>
+#include <celutil/array_view.h>
 
 class Body;
 
@@ -39,13 +41,30 @@ public:
      */
     virtual Eigen::Vector3d velocityAtTime(double) const;
 
+    /*! Compute the positions at several times (TDB) into positions, which
+     * must have room for times.size() elements. Orbits interpolating
+     * between samples are fastest for times in increasing order. The
+     * default implementation calls positionAtTime() for each time.
+     */
+    virtual void positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const;
+
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
+    /*! Return a lower bound for the distance from the origin of the
+     *  orbit's reference frame. The default implementation returns 0.
+     */
+    virtual double getMinimumRadius() const { return 0.0; }
+
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
 
     virtual bool isPeriodic() const { return true; };
 
+    /*! Return false if positions must not be computed from several threads
+     *  at once, e.g. because they are computed by a script.
+     */
+    virtual bool isThreadSafe() const { return true; }
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -64,6 +83,19 @@ protected:
     };
 
     void adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const;
+
+    // Keplerian orbits are recognized by PositionsAtTime without a virtual
+    // call, and solved in batches
+    enum class KeplerKind : std::uint8_t
+    {
+        None,
+        Elliptical,
+        Hyperbolic,
+    };
+
+    KeplerKind keplerKind{ KeplerKind::None };
+
+    friend void PositionsAtTime(util::array_view<const Orbit*>, double, Eigen::Vector3d*);
 };
 
 
@@ -76,8 +108,10 @@ public:
     // Compute the orbit for a specified Julian date
     Eigen::Vector3d positionAtTime(double) const override;
     Eigen::Vector3d velocityAtTime(double) const override;
+    void positionsAtTimes(util::array_view<double>, Eigen::Vector3d*) const override;
     double getPeriod() const override;
     double getBoundingRadius() const override;
+    double getMinimumRadius() const override;
 
 private:
     double eccentricAnomaly(double) const;
@@ -92,6 +126,8 @@ private:
     double epoch;
 
     Eigen::Matrix3d orbitPlaneRotation;
+
+    friend void PositionsAtTime(util::array_view<const Orbit*>, double, Eigen::Vector3d*);
 };
 
 
@@ -124,6 +160,8 @@ private:
     double endEpoch;
 
     Eigen::Matrix3d orbitPlaneRotation;
+
+    friend void PositionsAtTime(util::array_view<const Orbit*>, double, Eigen::Vector3d*);
 };
 
 
@@ -142,26 +180,30 @@ public:
  * Celestia may need require position of a planet more than once per frame; in
  * order to avoid redundant calculation, the CachingOrbit class saves the
  * result of the last calculation and uses it if the time matches the cached
- * time.
+ * time. Each thread has its own cache, computePosition() and
+ * computeVelocity() may be called from several threads at once.
  */
 class CachingOrbit : public Orbit
 {
  public:
-    CachingOrbit() = default;
+    CachingOrbit();
     ~CachingOrbit() override = default;
 
+    CachingOrbit(const CachingOrbit&) = delete;
+    CachingOrbit& operator=(const CachingOrbit&) = delete;
+
     virtual Eigen::Vector3d computePosition(double jd) const = 0;
     virtual Eigen::Vector3d computeVelocity(double jd) const;
 
     Eigen::Vector3d positionAtTime(double jd) const override;
     Eigen::Vector3d velocityAtTime(double jd) const override;
+    // Calls computePosition() directly, without replacing the cached result
+    void positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const override;
 
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    // Key of the cached results in the calling thread's cache, so that
+    // orbits can be evaluated from several threads at once
+    std::uint64_t cacheId;
 };
 
 
@@ -179,9 +221,11 @@ class MixedOrbit : public Orbit
 
     Eigen::Vector3d positionAtTime(double jd) const override;
     Eigen::Vector3d velocityAtTime(double jd) const override;
+    void positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const override;
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isThreadSafe() const override;
 
  private:
     std::unique_ptr<Orbit> primary;
@@ -227,13 +271,23 @@ class FixedOrbit : public Orbit
 
     Eigen::Vector3d positionAtTime(double) const override;
     // Eigen::Vector3d velocityAtTime(double) const override;
+    void positionsAtTimes(util::array_view<double>, Eigen::Vector3d*) const override;
     double getPeriod() const override;
     bool isPeriodic() const override;
     double getBoundingRadius() const override;
+    double getMinimumRadius() const override;
     void sample(double, double, OrbitSampleProc&) const override;
 
  private:
     Eigen::Vector3d position;
 };
 
+
+/*! Compute the positions of several orbits at the same time (TDB) into
+ *  positions, which must have room for orbits.size() elements. Elliptical
+ *  and hyperbolic orbits are gathered into batches, whose Kepler equations
+ *  are solved together by Newton iterations over arrays of elements.
+ */
+void PositionsAtTime(util::array_view<const Orbit*> orbits, double jd, Eigen::Vector3d* positions);
+
 }
@@ -12,9 +12,14 @@
 
 #include "precession.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
 
 #include <celcompat/numbers.h>
+#include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
 
 namespace celestia::ephem
@@ -75,6 +80,55 @@ constexpr std::array PrecessionTerms =
 // DE405 obliquity of the ecliptic
 constexpr double eps0 = 84381.40889;
 
+// The mean equator of date turns by about 1.4 degrees per century, so 12.5
+// year segments of degree 9 are accurate to the limits of double precision
+constexpr std::size_t NCoefficients = 10;
+constexpr std::size_t WindowSegments = 32;
+constexpr double SegmentCenturies = 0.125;
+
+struct EquatorTable
+{
+    double begin;
+    // Coefficients of the w, x, y and z components of each segment
+    std::array<std::array<std::array<double, NCoefficients>, 4>, WindowSegments> coefficients;
+};
+
+
+std::shared_ptr<const EquatorTable>
+buildEquatorTable(double T)
+{
+    auto table = std::make_shared<EquatorTable>();
+    table->begin = std::floor(T / SegmentCenturies - 0.5 * WindowSegments) * SegmentCenturies;
+
+    for (std::size_t i = 0; i < WindowSegments; ++i)
+    {
+        double mid = table->begin + (static_cast<double>(i) + 0.5) * SegmentCenturies;
+        std::array<Eigen::Vector4d, NCoefficients> values;
+        for (std::size_t k = 0; k < NCoefficients; ++k)
+        {
+            double node = std::cos(celestia::numbers::pi * (static_cast<double>(k) + 0.5) / NCoefficients);
+            Eigen::Quaterniond q = MeanEquatorOfDate_P03LP(mid + node * 0.5 * SegmentCenturies);
+            values[k] = Eigen::Vector4d(q.w(), q.x(), q.y(), q.z());
+        }
+
+        for (std::size_t j = 0; j < NCoefficients; ++j)
+        {
+            Eigen::Vector4d sum = Eigen::Vector4d::Zero();
+            for (std::size_t k = 0; k < NCoefficients; ++k)
+                sum += values[k] * std::cos(celestia::numbers::pi * static_cast<double>(j) * (static_cast<double>(k) + 0.5) / NCoefficients);
+            sum *= (j == 0 ? 1.0 : 2.0) / NCoefficients;
+            for (int axis = 0; axis < 4; ++axis)
+                table->coefficients[i][axis][j] = sum[axis];
+        }
+    }
+
+    return table;
+}
+
+
+// Accessed with std::atomic_load and std::atomic_store
+std::shared_ptr<const EquatorTable> equatorTable; //NOSONAR
+
 } // end unnamed namespace
 
 
@@ -287,4 +341,74 @@ PrecObliquity_P03(double T)
     return prec;
 }
 
+/*! Compute the rotation from the J2000 ecliptic to the mean equator and
+ *  equinox of date, from the precession of the ecliptic and the general
+ *  precession and obliquity of the P03LP model.
+ */
+Eigen::Quaterniond
+MeanEquatorOfDate_P03LP(double T)
+{
+    PrecessionAngles prec = PrecObliquity_P03LP(T);
+    EclipticPole pole = EclipticPrecession_P03LP(T);
+
+    double obliquity = math::degToRad(prec.epsA / 3600);
+    double precession = math::degToRad(prec.pA / 3600);
+
+    // Calculate the angles pi and Pi from the ecliptic pole coordinates
+    // P and Q:
+    //   P = sin(pi)*sin(Pi)
+    //   Q = sin(pi)*cos(Pi)
+    double P = pole.PA * 2.0 * celestia::numbers::pi / 1296000;
+    double Q = pole.QA * 2.0 * celestia::numbers::pi / 1296000;
+    double piA = std::asin(std::sqrt(P * P + Q * Q));
+    double PiA = std::atan2(P, Q);
+
+    // Calculate the rotation from the J2000 ecliptic to the ecliptic
+    // of date.
+    Eigen::Quaterniond RPi = math::ZRotation(PiA);
+    Eigen::Quaterniond rpi = math::XRotation(piA);
+    Eigen::Quaterniond eclRotation = RPi.conjugate() * rpi * RPi;
+
+    return math::XRotation(obliquity) * math::ZRotation(-precession) * eclRotation.conjugate();
+}
+
+
+Eigen::Quaterniond
+TabulatedMeanEquatorOfDate_P03LP(double T)
+{
+    std::shared_ptr<const EquatorTable> table = std::atomic_load(&equatorTable);
+    double span = static_cast<double>(WindowSegments) * SegmentCenturies;
+    if (table == nullptr || !(T >= table->begin && T < table->begin + span))
+    {
+        if (!std::isfinite(T))
+            return MeanEquatorOfDate_P03LP(T);
+
+        // Threads leaving the window at once may each build a table, the
+        // last one stored wins
+        table = buildEquatorTable(T);
+        std::atomic_store(&equatorTable, table);
+    }
+
+    double s = (T - table->begin) / SegmentCenturies;
+    auto i = std::min(static_cast<std::size_t>(s), WindowSegments - 1);
+    double u = std::clamp(2.0 * (s - static_cast<double>(i)) - 1.0, -1.0, 1.0);
+
+    std::array<double, 4> values;
+    for (int axis = 0; axis < 4; ++axis)
+    {
+        const auto& c = table->coefficients[i][axis];
+        double b1 = 0.0;
+        double b2 = 0.0;
+        for (std::size_t j = NCoefficients - 1; j > 0; --j)
+        {
+            double b0 = c[j] + 2.0 * u * b1 - b2;
+            b2 = b1;
+            b1 = b0;
+        }
+        values[axis] = c[0] + u * b1 - b2;
+    }
+
+    return Eigen::Quaterniond(values[0], values[1], values[2], values[3]).normalized();
+}
+
 } // end namespace celestia::ephem
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <Eigen/Geometry>
+
 namespace celestia::ephem
 {
 
@@ -66,4 +68,14 @@ extern EclipticAngles EclipticPrecessionAngles_P03(double T);
 extern PrecessionAngles PrecObliquity_P03(double T);
 extern EquatorialPrecessionAngles EquatorialPrecessionAngles_P03(double T);
 
+// Rotation from the J2000 ecliptic to the mean equator and equinox of date
+// of the P03LP model, T in centuries since J2000
+extern Eigen::Quaterniond MeanEquatorOfDate_P03LP(double T);
+
+// The same rotation interpolated from a Chebyshev table over a window of a
+// few centuries around the last epoch queried, rebuilt when T leaves it.
+// Agrees with MeanEquatorOfDate_P03LP within 1e-12 rad, and may be called
+// from several threads at once.
+extern Eigen::Quaterniond TabulatedMeanEquatorOfDate_P03LP(double T);
+
 }
@@ -17,6 +17,7 @@
 
 #include <celcompat/numbers.h>
 #include <celmath/geomutil.h>
+#include "threadcache.h"
 
 namespace celestia::ephem
 {
@@ -36,6 +37,30 @@ double chooseDiffTimeDelta(const RotationModel& rm)
     return ANGULAR_VELOCITY_DIFF_DELTA;
 }
 
+struct RotationCacheEntry
+{
+    // Take over the entry for another object or time
+    void reset(std::uint64_t _id, double _time)
+    {
+        if (id == _id && time == _time)
+            return;
+        id = _id;
+        time = _time;
+        spinValid = false;
+        equatorValid = false;
+        angularVelocityValid = false;
+    }
+
+    std::uint64_t id{ 0 };
+    double time{ 0.0 };
+    Eigen::Quaterniond spin{ Eigen::Quaterniond::Identity() };
+    Eigen::Quaterniond equator{ Eigen::Quaterniond::Identity() };
+    Eigen::Vector3d angularVelocity{ Eigen::Vector3d::Zero() };
+    bool spinValid{ false };
+    bool equatorValid{ false };
+    bool angularVelocityValid{ false };
+};
+
 } // end unnamed namepsace
 
 /***** RotationModel *****/
@@ -61,10 +86,7 @@ RotationModel::angularVelocityAtTime(double tdb) const
 /***** CachingRotationModel *****/
 
 CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheId(detail::NewThreadCacheId())
 {
 }
 
@@ -72,63 +94,46 @@ CachingRotationModel::CachingRotationModel() :
 Eigen::Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
-
-    return lastSpin;
+    auto& entry = detail::GetThreadCacheEntry<RotationCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == tjd && entry.spinValid)
+        return entry.spin;
+
+    // Computing the spin may use the cache entry for other rotation models
+    Eigen::Quaterniond spin = computeSpin(tjd);
+    entry.reset(cacheId, tjd);
+    entry.spin = spin;
+    entry.spinValid = true;
+    return spin;
 }
 
 
 Eigen::Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
-
-    return lastEquator;
+    auto& entry = detail::GetThreadCacheEntry<RotationCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == tjd && entry.equatorValid)
+        return entry.equator;
+
+    Eigen::Quaterniond equator = computeEquatorOrientation(tjd);
+    entry.reset(cacheId, tjd);
+    entry.equator = equator;
+    entry.equatorValid = true;
+    return equator;
 }
 
 
 Eigen::Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
-
-    return lastAngularVelocity;
+    auto& entry = detail::GetThreadCacheEntry<RotationCacheEntry>(cacheId);
+    if (entry.id == cacheId && entry.time == tjd && entry.angularVelocityValid)
+        return entry.angularVelocity;
+
+    Eigen::Vector3d angularVelocity = computeAngularVelocity(tjd);
+    entry.reset(cacheId, tjd);
+    entry.angularVelocity = angularVelocity;
+    entry.angularVelocityValid = true;
+    return angularVelocity;
 }
 
 
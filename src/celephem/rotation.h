@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -60,6 +62,11 @@ class RotationModel
 
     virtual bool isPeriodic() const = 0;
 
+    /*! Return false if orientations must not be computed from several
+     *  threads at once, e.g. because they are computed by a script.
+     */
+    virtual bool isThreadSafe() const { return true; }
+
     // Return the time range over which the orientation model is valid;
     // if the model is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -78,7 +85,8 @@ class RotationModel
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
  *  better means to calculate the angular velocity for a specific rotation
- *  model.
+ *  model. Each thread has its own cache, the compute methods may be called
+ *  from several threads at once.
  */
 class CachingRotationModel : public RotationModel
 {
@@ -86,6 +94,9 @@ class CachingRotationModel : public RotationModel
     CachingRotationModel();
     ~CachingRotationModel() override = default;
 
+    CachingRotationModel(const CachingRotationModel&) = delete;
+    CachingRotationModel& operator=(const CachingRotationModel&) = delete;
+
     Eigen::Quaterniond spin(double tjd) const override;
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
     Eigen::Vector3d angularVelocityAtTime(double tjd) const override;
@@ -97,13 +108,9 @@ class CachingRotationModel : public RotationModel
     bool isPeriodic() const override = 0;
 
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    // Key of the cached results in the calling thread's cache, so that
+    // rotation models can be evaluated from several threads at once
+    std::uint64_t cacheId;
 };
 
 
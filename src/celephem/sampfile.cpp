@@ -116,23 +116,52 @@ bool skipComments(std::istream& in)
 
 } // end namespace celestia::ephem::detail
 
-// Do a binary search to find the samples that define the orientation
-// at the current time. Cache the previous sample used and avoid
-// the search if it covers the requested time.
+SampleTimeIndex::SampleTimeIndex(celestia::util::array_view<double> sampleTimes)
+{
+    if (sampleTimes.size() < 2 || !(sampleTimes.back() > sampleTimes.front()))
+        return;
+
+    // One bucket per sample, plus an entry for the end of the last bucket
+    auto nBuckets = static_cast<std::uint32_t>(sampleTimes.size());
+    startTime = sampleTimes.front();
+    bucketsPerDay = static_cast<double>(nBuckets) / (sampleTimes.back() - startTime);
+
+    buckets.reserve(nBuckets + 1);
+    std::uint32_t n = 0;
+    for (std::uint32_t i = 0; i <= nBuckets; ++i)
+    {
+        double bucketStart = startTime + static_cast<double>(i) / bucketsPerDay;
+        while (n < sampleTimes.size() && sampleTimes[n] < bucketStart)
+            ++n;
+        buckets.push_back(n);
+    }
+}
+
+
 std::uint32_t
-GetSampleIndex(double jd,
-               std::uint32_t& lastSample,
-               celestia::util::array_view<double> sampleTimes)
+SampleTimeIndex::find(double jd, celestia::util::array_view<double> sampleTimes) const
 {
-    std::uint32_t n = lastSample;
-    if (n < 1 || n >= sampleTimes.size() || jd < sampleTimes[n - 1] || jd > sampleTimes[n])
+    if (buckets.empty())
     {
         auto iter = std::lower_bound(sampleTimes.begin(), sampleTimes.end(), jd);
-        n = static_cast<std::uint32_t>(iter - sampleTimes.begin());
-        lastSample = n;
+        return static_cast<std::uint32_t>(iter - sampleTimes.begin());
     }
 
-    return n;
+    // Also true for NaN
+    if (!(jd > sampleTimes.front()))
+        return 0;
+    if (jd > sampleTimes.back())
+        return static_cast<std::uint32_t>(sampleTimes.size());
+
+    // Include the neighboring buckets, so that rounding of the bucket
+    // boundaries can't exclude the result
+    auto nBuckets = static_cast<std::uint32_t>(buckets.size() - 1);
+    auto bucket = std::min(static_cast<std::uint32_t>((jd - startTime) * bucketsPerDay), nBuckets - 1);
+    std::uint32_t first = buckets[bucket == 0 ? 0 : bucket - 1];
+    std::uint32_t last = buckets[std::min(bucket + 2, nBuckets)];
+
+    auto iter = std::lower_bound(sampleTimes.begin() + first, sampleTimes.begin() + last, jd);
+    return static_cast<std::uint32_t>(iter - sampleTimes.begin());
 }
 
 } // end namespace celestia::ephem
@@ -46,9 +46,29 @@ bool skipComments(std::istream& in);
 }
 
 
-std::uint32_t GetSampleIndex(double jd,
-                             std::uint32_t& lastSample,
-                             celestia::util::array_view<double> sampleTimes);
+/*! Index over the sorted sample times of a trajectory or rotation model.
+ *  The span of the samples is divided into buckets of equal length, and
+ *  each bucket records the first sample at or after its start. A lookup
+ *  only searches the samples of one bucket, which is constant time for
+ *  evenly spaced samples. The index has no mutable state, so it can be
+ *  used from several threads at once.
+ */
+class SampleTimeIndex
+{
+public:
+    explicit SampleTimeIndex(celestia::util::array_view<double> sampleTimes);
+
+    /*! Return the index of the first sample at or after jd: 0 if jd is
+     *  before the first sample, the number of samples if jd is after the
+     *  last one. sampleTimes must be the times the index was built from.
+     */
+    std::uint32_t find(double jd, celestia::util::array_view<double> sampleTimes) const;
+
+private:
+    double startTime{ 0.0 };
+    double bucketsPerDay{ 0.0 };
+    std::vector<std::uint32_t> buckets;
+};
 
 
 template<typename T, typename F>
@@ -0,0 +1,277 @@
+// samplecache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Interpolating cache of the values of a function of time which is
+// expensive to evaluate, used by the scripted orbits and rotations.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace celestia::ephem
+{
+
+/*! Cache of samples of a function of time, evaluated lazily on a grid of
+ *  cells of the given interval. The first time a cell is queried, it's
+ *  split in halves until cubic Hermite splines through the samples and
+ *  their derivatives agree with the function within tolerance at the
+ *  middle of each part, or the parts are 2^maxDepth times smaller than
+ *  the cell. Later queries of the cell only interpolate the samples.
+ *
+ *  Values of the function are vectors of N components, and the tolerance
+ *  is on the distance between the interpolated and evaluated vectors. If
+ *  Antipodal is set, v and -v are the same value, as for the components
+ *  of rotation quaternions: samples are flipped to the side of their
+ *  neighbours before they're interpolated.
+ */
+template<int N, bool Antipodal = false>
+class SampleCache
+{
+public:
+    using Value = Eigen::Matrix<double, N, 1>;
+
+    SampleCache(double interval, double tolerance, unsigned int maxDepth = 10);
+
+    // Only sample the function within [begin, end], unless end <= begin
+    void setRange(double begin, double end);
+
+    // Return the interpolated value at t, where evaluate(double t) returns
+    // the value of the function
+    template<typename F> Value get(double t, F&& evaluate);
+
+    void clear();
+    std::size_t sampleCount() const { return samples; }
+
+    // The cache is cleared when it has more cells than this
+    static constexpr std::size_t MaxCells = 4096;
+
+private:
+    struct Sample
+    {
+        double t;
+        Value value;
+        Value derivative;
+    };
+
+    using Cell = std::vector<Sample>;
+
+    template<typename F> Sample sample(double t, double begin, double end, F& evaluate) const;
+    template<typename F> void refine(Cell&, const Sample&, const Sample&, double, double, unsigned int, F&);
+
+    static Value align(const Value& value, const Value& reference);
+    static Value interpolate(const Sample&, const Sample&, double t);
+
+    double interval;
+    double tolerance;
+    unsigned int maxDepth;
+    double rangeBegin{ -std::numeric_limits<double>::infinity() };
+    double rangeEnd{ std::numeric_limits<double>::infinity() };
+    std::unordered_map<std::int64_t, Cell> cells;
+    std::size_t samples{ 0 };
+};
+
+
+template<int N, bool Antipodal>
+SampleCache<N, Antipodal>::SampleCache(double _interval, double _tolerance, unsigned int _maxDepth) :
+    interval(_interval),
+    tolerance(_tolerance),
+    maxDepth(_maxDepth)
+{
+}
+
+
+template<int N, bool Antipodal> void
+SampleCache<N, Antipodal>::setRange(double begin, double end)
+{
+    if (end > begin)
+    {
+        rangeBegin = begin;
+        rangeEnd = end;
+    }
+    else
+    {
+        rangeBegin = -std::numeric_limits<double>::infinity();
+        rangeEnd = std::numeric_limits<double>::infinity();
+    }
+    clear();
+}
+
+
+template<int N, bool Antipodal> void
+SampleCache<N, Antipodal>::clear()
+{
+    cells.clear();
+    samples = 0;
+}
+
+
+template<int N, bool Antipodal>
+template<typename F>
+typename SampleCache<N, Antipodal>::Value
+SampleCache<N, Antipodal>::get(double t, F&& evaluate)
+{
+    // Outside the range, or too far from the origin of the grid for the
+    // index of the cell, the function is evaluated directly
+    auto k = std::floor(t / interval);
+    if (!(t >= rangeBegin && t <= rangeEnd) ||
+        std::abs(k) > static_cast<double>(std::numeric_limits<std::int64_t>::max() / 2))
+    {
+        return evaluate(t);
+    }
+
+    auto key = static_cast<std::int64_t>(k);
+    auto it = cells.find(key);
+    if (it == cells.end())
+    {
+        if (cells.size() >= MaxCells)
+            clear();
+
+        double begin = std::max(k * interval, rangeBegin);
+        double end = std::min((k + 1.0) * interval, rangeEnd);
+
+        Cell cell;
+        Sample first = sample(begin, begin, end, evaluate);
+        Sample last = sample(end, begin, end, evaluate);
+        cell.push_back(first);
+        if (end > begin)
+            refine(cell, first, last, begin, end, 0, evaluate);
+        cell.push_back(last);
+
+        samples += cell.size();
+        it = cells.try_emplace(key, std::move(cell)).first;
+    }
+
+    const Cell& cell = it->second;
+    auto next = std::upper_bound(cell.begin(), cell.end(), t,
+                                 [](double time, const Sample& s) { return time < s.t; });
+    if (next == cell.begin())
+        return cell.front().value;
+    if (next == cell.end())
+        return cell.back().value;
+
+    Value value = interpolate(*(next - 1), *next, t);
+    if constexpr (Antipodal)
+        value.normalize();
+    return value;
+}
+
+
+// Sample the function and its derivative at t, with a central difference
+// within the part of the cell between begin and end
+template<int N, bool Antipodal>
+template<typename F>
+typename SampleCache<N, Antipodal>::Sample
+SampleCache<N, Antipodal>::sample(double t, double begin, double end, F& evaluate) const
+{
+    // Smaller than the smallest parts of a cell
+    double h = interval * std::ldexp(1.0, -static_cast<int>(maxDepth) - 4);
+    double t0 = std::max(t - h, begin);
+    double t1 = std::min(t + h, end);
+
+    Sample s;
+    s.t = t;
+    s.value = evaluate(t);
+    if (t1 > t0)
+    {
+        Value v0 = align(evaluate(t0), s.value);
+        Value v1 = align(evaluate(t1), s.value);
+        s.derivative = (v1 - v0) / (t1 - t0);
+    }
+    else
+    {
+        s.derivative = Value::Zero();
+    }
+    return s;
+}
+
+
+// Append the samples between s0 and s1, excluding them, to cell
+template<int N, bool Antipodal>
+template<typename F>
+void
+SampleCache<N, Antipodal>::refine(Cell& cell,
+                                  const Sample& s0,
+                                  const Sample& s1,
+                                  double begin,
+                                  double end,
+                                  unsigned int depth,
+                                  F& evaluate)
+{
+    double tm = 0.5 * (s0.t + s1.t);
+    Sample middle = sample(tm, begin, end, evaluate);
+    if constexpr (Antipodal)
+    {
+        if (middle.value.dot(s0.value) < 0.0)
+        {
+            middle.value = -middle.value;
+            middle.derivative = -middle.derivative;
+        }
+    }
+
+    Value expected = interpolate(s0, s1, tm);
+    if constexpr (Antipodal)
+        expected.normalize();
+    bool accurate = (expected - middle.value).norm() <= tolerance;
+    if (!accurate && depth + 1 < maxDepth)
+        refine(cell, s0, middle, begin, end, depth + 1, evaluate);
+    cell.push_back(middle);
+    if (!accurate && depth + 1 < maxDepth)
+        refine(cell, middle, s1, begin, end, depth + 1, evaluate);
+}
+
+
+template<int N, bool Antipodal>
+typename SampleCache<N, Antipodal>::Value
+SampleCache<N, Antipodal>::align(const Value& value, const Value& reference)
+{
+    if constexpr (Antipodal)
+    {
+        if (value.dot(reference) < 0.0)
+            return -value;
+    }
+    return value;
+}
+
+
+template<int N, bool Antipodal>
+typename SampleCache<N, Antipodal>::Value
+SampleCache<N, Antipodal>::interpolate(const Sample& s0, const Sample& s1, double t)
+{
+    double dt = s1.t - s0.t;
+    if (dt <= 0.0)
+        return s0.value;
+
+    Value p0 = s0.value;
+    Value v0 = s0.derivative * dt;
+    Value p1 = s1.value;
+    Value v1 = s1.derivative * dt;
+    if constexpr (Antipodal)
+    {
+        if (p1.dot(p0) < 0.0)
+        {
+            p1 = -p1;
+            v1 = -v1;
+        }
+    }
+
+    double u = (t - s0.t) / dt;
+    return p0 + (((2.0 * (p0 - p1) + v1 + v0) * (u * u * u)) +
+                 ((3.0 * (p1 - p0) - 2.0 * v0 - v1) * (u * u)) +
+                 (v0 * u));
+}
+
+} // end namespace celestia::ephem
@@ -15,10 +15,12 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <istream>
+#include <limits>
 #include <string_view>
 #include <type_traits>
 #include <utility>
@@ -31,9 +33,12 @@
 #include <celmath/mathlib.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/memoryaccounting.h>
 #include "orbit.h"
 #include "sampfile.h"
 #include "xyzvbinary.h"
+#include "xyzvcheb.h"
 
 using celestia::util::GetLogger;
 
@@ -103,9 +108,10 @@ private:
     std::vector<double> sampleTimes;
     std::vector<Eigen::Matrix<T, 3, 1>> positions;
     double boundingRadius{ 0.0 };
-    mutable std::uint32_t lastSample{ 0 };
+    SampleTimeIndex timeIndex;
 
     TrajectoryInterpolation interpolation;
+    celestia::util::MemoryRecord memory{ celestia::util::MemoryTag::Orbits };
 
     Eigen::Vector3d computePositionLinear(double, std::uint32_t) const;
     Eigen::Vector3d computePositionCubic(double, std::uint32_t, std::uint32_t) const;
@@ -122,11 +128,13 @@ SampledOrbit<T>::SampledOrbit(TrajectoryInterpolation _interpolation,
                               std::vector<Eigen::Matrix<T, 3, 1>>&& _positions) :
     sampleTimes(std::move(_sampleTimes)),
     positions(std::move(_positions)),
+    timeIndex(sampleTimes),
     interpolation(_interpolation)
 {
     assert(!sampleTimes.empty() && sampleTimes.size() == positions.size());
     sampleTimes.shrink_to_fit();
     positions.shrink_to_fit();
+    memory.set(sampleTimes.capacity() * sizeof(double) + positions.capacity() * sizeof(positions.front()));
 
     // Apply correction for Celestia's coordinate system
     for (Eigen::Matrix<T, 3, 1>& position : positions)
@@ -178,7 +186,7 @@ SampledOrbit<T>::computePosition(double jd) const
     if (sampleTimes.size() == 1)
         return positions.front().template cast<double>();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = timeIndex.find(jd, sampleTimes);
     if (n == 0)
         return positions.front().template cast<double>();
     if (n == sampleTimes.size())
@@ -229,7 +237,7 @@ SampledOrbit<T>::computeVelocity(double jd) const
     if (sampleTimes.size() < 2)
         return Eigen::Vector3d::Zero();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = timeIndex.find(jd, sampleTimes);
     if (n == 0 || n == sampleTimes.size())
         return Eigen::Vector3d::Zero();
 
@@ -371,9 +379,10 @@ private:
     std::vector<double> sampleTimes;
     std::vector<SampleXYZV<T>> samples;
     double boundingRadius{ 0.0 };
-    mutable std::uint32_t lastSample{ 0 };
+    SampleTimeIndex timeIndex;
 
     TrajectoryInterpolation interpolation;
+    celestia::util::MemoryRecord memory{ celestia::util::MemoryTag::Orbits };
 };
 
 
@@ -383,11 +392,13 @@ SampledOrbitXYZV<T>::SampledOrbitXYZV(TrajectoryInterpolation _interpolation,
                                       std::vector<SampleXYZV<T>>&& _samples) :
     sampleTimes(std::move(_sampleTimes)),
     samples(std::move(_samples)),
+    timeIndex(sampleTimes),
     interpolation(_interpolation)
 {
     assert(!sampleTimes.empty() && sampleTimes.size() == samples.size());
     sampleTimes.shrink_to_fit();
     samples.shrink_to_fit();
+    memory.set(sampleTimes.capacity() * sizeof(double) + samples.capacity() * sizeof(samples.front()));
 
     // Apply correction for Celestia's coordinate system
     for (SampleXYZV<T>& sample: samples)
@@ -442,7 +453,7 @@ SampledOrbitXYZV<T>::computePosition(double jd) const
     if (sampleTimes.size() == 1)
         return samples.front().position.template cast<double>();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = timeIndex.find(jd, sampleTimes);
     if (n == 0)
         return samples.front().position.template cast<double>();
     if (n == sampleTimes.size())
@@ -479,7 +490,7 @@ SampledOrbitXYZV<T>::computeVelocity(double jd) const
     if (sampleTimes.size() < 2)
         return Eigen::Vector3d::Zero();
 
-    std::uint32_t n = GetSampleIndex(jd, lastSample, sampleTimes);
+    std::uint32_t n = timeIndex.find(jd, sampleTimes);
     if (n == 0 || n == sampleTimes.size())
         return Eigen::Vector3d::Zero();
 
@@ -727,6 +738,221 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
                                                  std::move(samples));
 }
 
+// Trajectory stored as Chebyshev polynomial coefficients for segments of
+// the time span. The file stays mapped into memory and the coefficients
+// are evaluated in place, so only the pages of the segments in use are
+// ever read from disk.
+class ChebyshevOrbit : public CachingOrbit
+{
+public:
+    ChebyshevOrbit(util::MappedFile&&, std::size_t, std::uint16_t, double);
+    ~ChebyshevOrbit() override = default;
+
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    Eigen::Vector3d computePosition(double jd) const override;
+    Eigen::Vector3d computeVelocity(double jd) const override;
+
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+private:
+    std::size_t findSegment(double jd) const;
+
+    util::MappedFile file;
+    const double* segmentTimes;
+    const double* coefficients;
+    std::size_t nSegments;
+    std::uint16_t nCoefficients;
+    double boundingRadius;
+};
+
+
+ChebyshevOrbit::ChebyshevOrbit(util::MappedFile&& _file,
+                               std::size_t _nSegments,
+                               std::uint16_t _nCoefficients,
+                               double _boundingRadius) :
+    file(std::move(_file)),
+    nSegments(_nSegments),
+    nCoefficients(_nCoefficients),
+    boundingRadius(_boundingRadius)
+{
+    // The sections are aligned to 8 bytes within the page-aligned mapping
+    segmentTimes = reinterpret_cast<const double*>(file.data() + sizeof(XYZVChebyshevHeader)); //NOSONAR
+    coefficients = segmentTimes + nSegments + 1;
+}
+
+
+double
+ChebyshevOrbit::getPeriod() const
+{
+    return segmentTimes[nSegments] - segmentTimes[0];
+}
+
+
+bool
+ChebyshevOrbit::isPeriodic() const
+{
+    return false;
+}
+
+
+void
+ChebyshevOrbit::getValidRange(double& begin, double& end) const
+{
+    begin = segmentTimes[0];
+    end = segmentTimes[nSegments];
+}
+
+
+double
+ChebyshevOrbit::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+std::size_t
+ChebyshevOrbit::findSegment(double jd) const
+{
+    const double* last = segmentTimes + nSegments;
+    const double* it = std::upper_bound(segmentTimes + 1, last, jd);
+    return static_cast<std::size_t>(std::min(it, last) - segmentTimes) - 1;
+}
+
+
+Eigen::Vector3d
+ChebyshevOrbit::computePosition(double jd) const
+{
+    // Times outside the span get the position at its start or end
+    std::size_t segment = findSegment(jd);
+    double t0 = segmentTimes[segment];
+    double t1 = segmentTimes[segment + 1];
+    double u = std::clamp(2.0 * (jd - t0) / (t1 - t0) - 1.0, -1.0, 1.0);
+
+    const double* coeffs = coefficients + segment * 3 * nCoefficients;
+    Eigen::Vector3d p = Eigen::Vector3d::Zero();
+    double tPrev = 1.0;
+    double t = u;
+    for (int i = 0; i < 3; ++i)
+        p[i] = coeffs[i * nCoefficients];
+    for (std::uint16_t j = 1; j < nCoefficients; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+            p[i] += coeffs[i * nCoefficients + j] * t;
+        double tNext = 2.0 * u * t - tPrev;
+        tPrev = t;
+        t = tNext;
+    }
+
+    // Apply correction for Celestia's coordinate system
+    return Eigen::Vector3d(p.x(), p.z(), -p.y());
+}
+
+
+Eigen::Vector3d
+ChebyshevOrbit::computeVelocity(double jd) const
+{
+    if (jd < segmentTimes[0] || jd > segmentTimes[nSegments])
+        return Eigen::Vector3d::Zero();
+
+    std::size_t segment = findSegment(jd);
+    double t0 = segmentTimes[segment];
+    double t1 = segmentTimes[segment + 1];
+    double u = 2.0 * (jd - t0) / (t1 - t0) - 1.0;
+
+    // The derivatives of the Chebyshev polynomials follow the recurrence
+    // T'(n+1) = 2 T(n) + 2u T'(n) - T'(n-1)
+    const double* coeffs = coefficients + segment * 3 * nCoefficients;
+    Eigen::Vector3d v = Eigen::Vector3d::Zero();
+    double tPrev = 1.0;
+    double t = u;
+    double dPrev = 0.0;
+    double d = 1.0;
+    for (std::uint16_t j = 1; j < nCoefficients; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+            v[i] += coeffs[i * nCoefficients + j] * d;
+        double dNext = 2.0 * t + 2.0 * u * d - dPrev;
+        double tNext = 2.0 * u * t - tPrev;
+        dPrev = d;
+        d = dNext;
+        tPrev = t;
+        t = tNext;
+    }
+
+    v *= 2.0 / (t1 - t0);
+    return Eigen::Vector3d(v.x(), v.z(), -v.y());
+}
+
+
+/* Load a Chebyshev trajectory file, see xyzvcheb.h for the layout.
+ */
+std::unique_ptr<ChebyshevOrbit>
+LoadChebyshevOrbit(const fs::path& filename)
+{
+    auto file = util::MappedFile::open(filename);
+    if (!file.has_value())
+    {
+        GetLogger()->error(_("Error opening Chebyshev trajectory file {}.\n"), filename);
+        return nullptr;
+    }
+
+    const char* data = file->data();
+    if (file->size() < sizeof(XYZVChebyshevHeader) ||
+        std::string_view(data + offsetof(XYZVChebyshevHeader, magic), XYZV_CHEBYSHEV_MAGIC.size()) != XYZV_CHEBYSHEV_MAGIC)
+    {
+        GetLogger()->error(_("Bad Chebyshev trajectory file {}.\n"), filename);
+        return nullptr;
+    }
+
+    decltype(XYZVChebyshevHeader::byteOrder) byteOrder;
+    std::memcpy(&byteOrder, data + offsetof(XYZVChebyshevHeader, byteOrder), sizeof(byteOrder));
+    if (byteOrder != static_cast<decltype(byteOrder)>(celestia::compat::endian::native))
+    {
+        GetLogger()->error(_("Unsupported byte order {}, expected {} in {}.\n"),
+                           byteOrder, static_cast<int>(celestia::compat::endian::native), filename);
+        return nullptr;
+    }
+
+    decltype(XYZVChebyshevHeader::digits) digits;
+    std::memcpy(&digits, data + offsetof(XYZVChebyshevHeader, digits), sizeof(digits));
+    if (digits != std::numeric_limits<double>::digits)
+    {
+        GetLogger()->error(_("Unsupported digits number {}, expected {} in {}.\n"),
+                           digits, std::numeric_limits<double>::digits, filename);
+        return nullptr;
+    }
+
+    decltype(XYZVChebyshevHeader::coefficientCount) nCoefficients;
+    decltype(XYZVChebyshevHeader::segmentCount) nSegments;
+    double boundingRadius;
+    std::memcpy(&nCoefficients, data + offsetof(XYZVChebyshevHeader, coefficientCount), sizeof(nCoefficients));
+    std::memcpy(&nSegments, data + offsetof(XYZVChebyshevHeader, segmentCount), sizeof(nSegments));
+    std::memcpy(&boundingRadius, data + offsetof(XYZVChebyshevHeader, boundingRadius), sizeof(boundingRadius));
+
+    if (nCoefficients == 0 || nCoefficients > XYZV_CHEBYSHEV_MAX_COEFFICIENTS)
+    {
+        GetLogger()->error(_("Invalid coefficient count {} in {}.\n"), nCoefficients, filename);
+        return nullptr;
+    }
+
+    // Check the segment count first, so that the expected size can't overflow
+    constexpr std::size_t maxSegments = std::numeric_limits<std::size_t>::max() / (sizeof(double) * 3 * XYZV_CHEBYSHEV_MAX_COEFFICIENTS + 1) - 1;
+    if (nSegments == 0 || nSegments > maxSegments ||
+        file->size() != sizeof(XYZVChebyshevHeader) +
+                        sizeof(double) * (nSegments + 1 + nSegments * 3 * nCoefficients))
+    {
+        GetLogger()->error(_("Segment count {} doesn't match the size of {}.\n"), nSegments, filename);
+        return nullptr;
+    }
+
+    return std::make_unique<ChebyshevOrbit>(*std::move(file),
+                                            static_cast<std::size_t>(nSegments),
+                                            nCoefficients,
+                                            boundingRadius);
+}
+
 } // end unnamed namespace
 
 
@@ -753,6 +979,14 @@ LoadSampledTrajectoryDoublePrec(const fs::path& filename, TrajectoryInterpolatio
 std::unique_ptr<Orbit>
 LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
+    auto chebname = filename;
+    chebname += "cheb";
+    if (fs::exists(chebname))
+    {
+        std::unique_ptr<Orbit> ret = LoadChebyshevOrbit(chebname);
+        if (ret != nullptr) return ret;
+    }
+
     auto binname = filename;
     binname += "bin";
     if (fs::exists(binname))
@@ -770,6 +1004,14 @@ LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation i
 std::unique_ptr<Orbit>
 LoadXYZVTrajectoryDoublePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
+    auto chebname = filename;
+    chebname += "cheb";
+    if (fs::exists(chebname))
+    {
+        std::unique_ptr<Orbit> ret = LoadChebyshevOrbit(chebname);
+        if (ret != nullptr) return ret;
+    }
+
     auto binname = filename;
     binname += "bin";
     if (fs::exists(binname))
@@ -798,4 +1040,14 @@ LoadXYZVBinaryDoublePrec(const fs::path& filename, TrajectoryInterpolation inter
     return LoadSampledOrbitXYZVBinary<double>(filename, interpolation);
 }
 
+
+/*! Load a trajectory file with Chebyshev polynomial coefficients. The
+ *  coefficients are always evaluated in double precision.
+ */
+std::unique_ptr<Orbit>
+LoadXYZVChebyshevTrajectory(const fs::path& filename)
+{
+    return LoadChebyshevOrbit(filename);
+}
+
 } // end namespace celestia::ephem
@@ -36,5 +36,6 @@ std::unique_ptr<Orbit> LoadXYZVTrajectoryDoublePrec(const fs::path& filename, Tr
 std::unique_ptr<Orbit> LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation);
 std::unique_ptr<Orbit> LoadXYZVBinarySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation);
 std::unique_ptr<Orbit> LoadXYZVBinaryDoublePrec(const fs::path& filename, TrajectoryInterpolation interpolation);
+std::unique_ptr<Orbit> LoadXYZVChebyshevTrajectory(const fs::path& filename);
 
 } // end namespace celestia::ephem
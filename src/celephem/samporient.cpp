@@ -13,9 +13,12 @@
 
 #include "samporient.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <istream>
+#include <iterator>
 #include <utility>
 #include <vector>
 
@@ -54,14 +57,40 @@ namespace
  * a single line.
  */
 
+// Bits of each of the three smallest components of a packed quaternion
+constexpr unsigned int PackedBits = 20;
+constexpr std::uint64_t PackedMask = (std::uint64_t(1) << PackedBits) - 1;
+
+// The smallest three components are within [-1/sqrt(2), 1/sqrt(2)]
+constexpr float PackedRange = 0.70710678f;
+
+
+inline const Eigen::Quaternionf&
+unpack(const Eigen::Quaternionf& q)
+{
+    return q;
+}
+
+
+inline Eigen::Quaternionf
+unpack(std::uint64_t packed)
+{
+    return UnpackQuaternion(packed);
+}
+
+
 /*! SampledOrientation is a rotation model that interpolates a sequence
  *  of quaternion keyframes. Typically, an instance of SampledRotation will
- *  be created from a file with LoadSampledOrientation().
+ *  be created from a file with LoadSampledOrientation(). The keyframes are
+ *  stored either as quaternions or packed in 64 bits; the sample times and
+ *  their index are never modified once loaded, so that instances can be
+ *  shared between threads.
  */
+template<typename T>
 class SampledOrientation : public RotationModel
 {
 public:
-    SampledOrientation(std::vector<double>&&, std::vector<Eigen::Quaternionf>&&);
+    SampledOrientation(std::vector<double>&&, std::vector<T>&&);
     ~SampledOrientation() override = default;
 
     /*! The orientation of a sampled rotation model is entirely due
@@ -80,79 +109,120 @@ private:
     // Storing sample times and rotations separately avoids padding due to
     // the 16-byte alignment of Quaternionf
     std::vector<double> sampleTimes;
-    std::vector<Eigen::Quaternionf> rotations;
-    mutable std::uint32_t lastSample{0};
+    std::vector<T> rotations;
+    SampleTimeIndex timeIndex;
 };
 
 
-SampledOrientation::SampledOrientation(std::vector<double>&& _sampleTimes,
-                                       std::vector<Eigen::Quaternionf>&& _rotations) :
+template<typename T>
+SampledOrientation<T>::SampledOrientation(std::vector<double>&& _sampleTimes,
+                                          std::vector<T>&& _rotations) :
     sampleTimes(std::move(_sampleTimes)),
-    rotations(std::move(_rotations))
+    rotations(std::move(_rotations)),
+    timeIndex(sampleTimes)
 {
     assert(!sampleTimes.empty() && sampleTimes.size() == rotations.size());
     sampleTimes.shrink_to_fit();
     rotations.shrink_to_fit();
-
-    // Apply a 90-degree rotation around the x-axis to convert the orientation
-    // to Celestia's coordinate system
-    for (Eigen::Quaternionf& rotation : rotations)
-    {
-        rotation *= math::XRot90<float>;
-    }
 }
 
 
-Eigen::Quaterniond
-SampledOrientation::spin(double tjd) const
+template<typename T> Eigen::Quaterniond
+SampledOrientation<T>::spin(double tjd) const
 {
-    // TODO: cache the last value returned
-    return getOrientation(tjd).cast<double>();
+    return getOrientation(tjd).template cast<double>();
 }
 
 
-double
-SampledOrientation::getPeriod() const
+template<typename T> double
+SampledOrientation<T>::getPeriod() const
 {
     return sampleTimes.back() - sampleTimes.front();
 }
 
 
-bool
-SampledOrientation::isPeriodic() const
+template<typename T> bool
+SampledOrientation<T>::isPeriodic() const
 {
     return false;
 }
 
 
-void
-SampledOrientation::getValidRange(double& begin, double& end) const
+template<typename T> void
+SampledOrientation<T>::getValidRange(double& begin, double& end) const
 {
     begin = sampleTimes.front();
     end = sampleTimes.back();
 }
 
 
-Eigen::Quaternionf
-SampledOrientation::getOrientation(double tjd) const
+template<typename T> Eigen::Quaternionf
+SampledOrientation<T>::getOrientation(double tjd) const
 {
     if (sampleTimes.size() == 1)
-        return rotations.front();
+        return unpack(rotations.front());
 
-    std::uint32_t n = GetSampleIndex(tjd, lastSample, sampleTimes);
+    std::uint32_t n = timeIndex.find(tjd, sampleTimes);
     if (n == 0)
-        return rotations.front();
+        return unpack(rotations.front());
     else if (n == sampleTimes.size())
-        return rotations.back();
+        return unpack(rotations.back());
 
     auto t = static_cast<float>((tjd - sampleTimes[n - 1]) / (sampleTimes[n] - sampleTimes[n - 1]));
-    return rotations[n - 1].slerp(t, rotations[n]);
+    return unpack(rotations[n - 1]).slerp(t, unpack(rotations[n]));
 }
 
 } // end unnamed namespace
 
+std::uint64_t
+PackQuaternion(const Eigen::Quaternionf& q)
+{
+    Eigen::Vector4f v = q.coeffs().normalized();
+    int largest;
+    v.cwiseAbs().maxCoeff(&largest);
+    // q and -q are the same rotation, so the largest component is stored
+    // as positive
+    if (v[largest] < 0.0f)
+        v = -v;
+
+    auto packed = static_cast<std::uint64_t>(largest);
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        float u = std::clamp((v[i] / PackedRange + 1.0f) * 0.5f, 0.0f, 1.0f);
+        packed = (packed << PackedBits) | static_cast<std::uint64_t>(std::lround(u * static_cast<float>(PackedMask)));
+    }
+
+    return packed;
+}
+
+
+Eigen::Quaternionf
+UnpackQuaternion(std::uint64_t packed)
+{
+    auto largest = static_cast<int>((packed >> (3 * PackedBits)) & 3);
+    Eigen::Vector4f v;
+    float sum = 0.0f;
+    for (int i = 3; i >= 0; --i)
+    {
+        if (i == largest)
+            continue;
+
+        float u = static_cast<float>(packed & PackedMask) / static_cast<float>(PackedMask);
+        v[i] = (u * 2.0f - 1.0f) * PackedRange;
+        sum += v[i] * v[i];
+        packed >>= PackedBits;
+    }
+
+    v[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+    return Eigen::Quaternionf(v);
+}
+
+
 std::unique_ptr<RotationModel>
-LoadSampledOrientation(const fs::path& filename)
+LoadSampledOrientation(const fs::path& filename, OrientationPrecision precision)
 {
     std::vector<double> sampleTimes;
     std::vector<Eigen::Quaternionf> samples;
@@ -166,8 +236,24 @@ LoadSampledOrientation(const fs::path& filename)
         return nullptr;
     }
 
-    return std::make_unique<SampledOrientation>(std::move(sampleTimes),
-                                                std::move(samples));
+    // Apply a 90-degree rotation around the x-axis to convert the orientation
+    // to Celestia's coordinate system
+    for (Eigen::Quaternionf& rotation : samples)
+    {
+        rotation *= math::XRot90<float>;
+    }
+
+    if (precision == OrientationPrecision::Compact)
+    {
+        std::vector<std::uint64_t> packed;
+        packed.reserve(samples.size());
+        std::transform(samples.begin(), samples.end(), std::back_inserter(packed), PackQuaternion);
+        return std::make_unique<SampledOrientation<std::uint64_t>>(std::move(sampleTimes),
+                                                                   std::move(packed));
+    }
+
+    return std::make_unique<SampledOrientation<Eigen::Quaternionf>>(std::move(sampleTimes),
+                                                                    std::move(samples));
 }
 
 } // end namespace celestia::ephem
@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
+#include <Eigen/Geometry>
+
 #include <celcompat/filesystem.h>
 
 namespace celestia::ephem
@@ -18,6 +21,20 @@ namespace celestia::ephem
 
 class RotationModel;
 
-std::unique_ptr<RotationModel> LoadSampledOrientation(const fs::path& filename);
+enum class OrientationPrecision
+{
+    Single,
+    // Quaternions packed in 64 bits, with an error below 1e-6 rad
+    Compact,
+};
+
+std::unique_ptr<RotationModel> LoadSampledOrientation(const fs::path& filename,
+                                                      OrientationPrecision precision = OrientationPrecision::Single);
+
+// Smallest-three packing of a unit quaternion: the index of the largest
+// component in the top two bits, and the other three components quantized
+// to 20 bits each. The largest component is restored from the unit norm.
+std::uint64_t PackQuaternion(const Eigen::Quaternionf& q);
+Eigen::Quaternionf UnpackQuaternion(std::uint64_t packed);
 
 }
@@ -55,25 +55,25 @@ private:
 public:
     explicit HashVisitor(lua_State* pState) : state{pState} {}
 
-    void operator()(const std::string& key, const Value& value)
+    void operator()(std::string_view key, const Value& value)
     {
         std::size_t percentPos = key.find('%');
-        if (percentPos == std::string::npos)
+        if (percentPos == std::string_view::npos)
         {
             switch (value.getType())
             {
             case ValueType::NumberType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushnumber(state, *value.getNumber());
                 lua_settable(state, -3);
                 break;
             case ValueType::StringType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushstring(state, value.getString()->c_str());
                 lua_settable(state, -3);
                 break;
             case ValueType::BooleanType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushboolean(state, *value.getBoolean());
                 lua_settable(state, -3);
                 break;
@@ -126,7 +126,7 @@ GetLuaTableEntry(lua_State* state,
                  const std::string& key)
 {
     lua_pushvalue(state, tableIndex);
-    lua_pushstring(state, key.c_str());
+    lua_pushlstring(state, key.data(), key.size());
     lua_gettable(state, -2);
     lua_remove(state, -2);
 }
@@ -11,11 +11,15 @@
 
 #include "scriptorbit.h"
 
+#include <optional>
+
 #include <Eigen/Core>
 #include <lua.hpp>
 
+#include <celengine/hash.h>
 #include <celutil/logger.h>
 #include "orbit.h"
+#include "samplecache.h"
 #include "scriptobject.h"
 
 using celestia::util::GetLogger;
@@ -42,14 +46,23 @@ class ScriptedOrbit : public CachingOrbit
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void getValidRange(double& begin, double& end) const override;
+    // The Lua state can only be used by one thread at a time
+    bool isThreadSafe() const override { return false; }
+
+    void setSampleCache(double interval, double tolerance);
 
  private:
+    Eigen::Vector3d evaluate(double tjd) const;
+
     lua_State* luaState{ nullptr };
     std::string luaOrbitObjectName;
     double boundingRadius{ 1.0 };
     double period{ 0.0 };
     double validRangeBegin{ 0.0 };
     double validRangeEnd{ 0.0 };
+
+    // Positions interpolated from samples of the script, if enabled
+    mutable std::optional<SampleCache<3>> sampleCache;
 };
 
 
@@ -68,9 +81,27 @@ ScriptedOrbit::ScriptedOrbit(lua_State* pLuaState,
 {}
 
 
-// Call the position method of the ScriptedOrbit object
+void
+ScriptedOrbit::setSampleCache(double interval, double tolerance)
+{
+    sampleCache.emplace(interval, tolerance);
+    sampleCache->setRange(validRangeBegin, validRangeEnd);
+}
+
+
 Eigen::Vector3d
 ScriptedOrbit::computePosition(double tjd) const
+{
+    if (sampleCache.has_value())
+        return sampleCache->get(tjd, [this](double t) { return evaluate(t); });
+
+    return evaluate(tjd);
+}
+
+
+// Call the position method of the ScriptedOrbit object
+Eigen::Vector3d
+ScriptedOrbit::evaluate(double tjd) const
 {
     Eigen::Vector3d pos(Eigen::Vector3d::Zero());
     lua_getglobal(luaState, luaOrbitObjectName.c_str());
@@ -171,6 +202,12 @@ ScriptedOrbit::getBoundingRadius() const
  *      position(time) - The position function takes a time value as input
  *         (TDB Julian day) and returns three values which are the x, y, and
  *         z coordinates. Units for the position are kilometers.
+ *
+ *  If the orbit definition has a SampleTolerance, the position function
+ *  is sampled on a grid with a step of SampleInterval, refined until the
+ *  positions interpolated between the samples are within the tolerance.
+ *  SampleInterval defaults to 1/32 of the period, or of the valid range
+ *  for aperiodic orbits, or 1 day without either.
  */
 std::unique_ptr<Orbit> CreateScriptedOrbit(const std::string* moduleName,
                                            const std::string& funcName,
@@ -287,12 +324,26 @@ std::unique_ptr<Orbit> CreateScriptedOrbit(const std::string* moduleName,
         return nullptr;
     }
 
-    return std::make_unique<ScriptedOrbit>(luaState,
-                                           std::move(luaOrbitObjectName),
-                                           boundingRadius,
-                                           period,
-                                           validRangeBegin,
-                                           validRangeEnd);
+    auto orbit = std::make_unique<ScriptedOrbit>(luaState,
+                                                 std::move(luaOrbitObjectName),
+                                                 boundingRadius,
+                                                 period,
+                                                 validRangeBegin,
+                                                 validRangeEnd);
+
+    if (auto tolerance = parameters.getLength<double>("SampleTolerance"); tolerance.has_value())
+    {
+        double interval = parameters.getTime<double>("SampleInterval").value_or(0.0);
+        if (interval <= 0.0)
+            interval = orbit->getPeriod() > 0.0 ? orbit->getPeriod() / 32.0 : 1.0;
+
+        if (*tolerance > 0.0)
+            orbit->setSampleCache(interval, *tolerance);
+        else
+            GetLogger()->warn("Ignoring non-positive SampleTolerance of ScriptedOrbit\n");
+    }
+
+    return orbit;
 }
 
 }
@@ -11,13 +11,17 @@
 
 #include "scriptrotation.h"
 
+#include <optional>
 #include <utility>
 
 #include <Eigen/Geometry>
 #include <lua.hpp>
 
+#include <celengine/hash.h>
+#include <celmath/mathlib.h>
 #include <celutil/logger.h>
 #include "rotation.h"
+#include "samplecache.h"
 #include "scriptobject.h"
 
 using celestia::util::GetLogger;
@@ -43,8 +47,14 @@ class ScriptedRotation : public RotationModel
     bool isPeriodic() const override;
     double getPeriod() const override;
     void getValidRange(double& begin, double& end) const override;
+    // The Lua state can only be used by one thread at a time
+    bool isThreadSafe() const override { return false; }
+
+    void setSampleCache(double interval, double tolerance);
 
  private:
+    Eigen::Quaterniond evaluate(double tjd) const;
+
     lua_State* luaState{ nullptr };
     std::string luaRotationObjectName;
     double period{ 0.0 };
@@ -56,6 +66,10 @@ class ScriptedRotation : public RotationModel
     mutable Eigen::Quaterniond lastOrientation{Eigen::Quaterniond::Identity()};
 
     bool cacheable{ true }; // non-cacheable rotations not yet supported
+
+    // Orientations interpolated from samples of the script, if enabled,
+    // as the coefficients x, y, z, w of the quaternions
+    mutable std::optional<SampleCache<4, true>> sampleCache;
 };
 
 
@@ -72,53 +86,80 @@ ScriptedRotation::ScriptedRotation(lua_State* pLuaState,
 {}
 
 
-// Call the position method of the ScriptedRotation object
+void
+ScriptedRotation::setSampleCache(double interval, double tolerance)
+{
+    sampleCache.emplace(interval, tolerance);
+    sampleCache->setRange(validRangeBegin, validRangeEnd);
+}
+
+
 Eigen::Quaterniond
 ScriptedRotation::spin(double tjd) const
 {
     if (tjd != lastTime || !cacheable)
     {
-        lua_getglobal(luaState, luaRotationObjectName.c_str());
-        if (lua_istable(luaState, -1))
+        if (sampleCache.has_value())
+        {
+            Eigen::Vector4d coeffs = sampleCache->get(tjd, [this](double t) { return evaluate(t).coeffs(); });
+            lastOrientation = Eigen::Quaterniond(coeffs);
+        }
+        else
+        {
+            lastOrientation = evaluate(tjd);
+        }
+        lastTime = tjd;
+    }
+
+    return lastOrientation;
+}
+
+
+// Call the orientation method of the ScriptedRotation object, return the
+// last orientation if it fails
+Eigen::Quaterniond
+ScriptedRotation::evaluate(double tjd) const
+{
+    Eigen::Quaterniond orientation = lastOrientation;
+    lua_getglobal(luaState, luaRotationObjectName.c_str());
+    if (lua_istable(luaState, -1))
+    {
+        lua_pushstring(luaState, "orientation");
+        lua_gettable(luaState, -2);
+        if (lua_isfunction(luaState, -1))
         {
-            lua_pushstring(luaState, "orientation");
-            lua_gettable(luaState, -2);
-            if (lua_isfunction(luaState, -1))
+            lua_pushvalue(luaState, -2); // push 'self' on stack
+            lua_pushnumber(luaState, tjd);
+            if (lua_pcall(luaState, 2, 4, 0) == 0)
             {
-                lua_pushvalue(luaState, -2); // push 'self' on stack
-                lua_pushnumber(luaState, tjd);
-                if (lua_pcall(luaState, 2, 4, 0) == 0)
-                {
-                    lastOrientation = Eigen::Quaterniond(lua_tonumber(luaState, -4),
-                                                         lua_tonumber(luaState, -3),
-                                                         lua_tonumber(luaState, -2),
-                                                         lua_tonumber(luaState, -1));
-                    lua_pop(luaState, 4);
-                    lastTime = tjd;
-                }
-                else
-                {
-                    // Function call failed for some reason
-                    GetLogger()->warn("ScriptedRotation failed: {}\n", lua_tostring(luaState, -1));
-                    lua_pop(luaState, 1);
-                }
+                orientation = Eigen::Quaterniond(lua_tonumber(luaState, -4),
+                                                 lua_tonumber(luaState, -3),
+                                                 lua_tonumber(luaState, -2),
+                                                 lua_tonumber(luaState, -1));
+                lua_pop(luaState, 4);
             }
             else
             {
-                // Bad orientation function
+                // Function call failed for some reason
+                GetLogger()->warn("ScriptedRotation failed: {}\n", lua_tostring(luaState, -1));
                 lua_pop(luaState, 1);
             }
         }
         else
         {
-            // The script rotation object disappeared. OOPS.
+            // Bad orientation function
+            lua_pop(luaState, 1);
         }
-
-        // Pop the script rotation object
-        lua_pop(luaState, 1);
+    }
+    else
+    {
+        // The script rotation object disappeared. OOPS.
     }
 
-    return lastOrientation;
+    // Pop the script rotation object
+    lua_pop(luaState, 1);
+
+    return orientation;
 }
 
 
@@ -170,6 +211,12 @@ ScriptedRotation::getValidRange(double& begin, double& end) const
  *      orientation(time) - The orientation function takes a time value as
  *         input (TDB Julian day) and returns three values which are the the
  *         quaternion (w, x, y, z).
+ *
+ *  If the rotation definition has a SampleTolerance, an angle, the
+ *  orientation function is sampled on a grid with a step of SampleInterval,
+ *  refined until the orientations interpolated between the samples are
+ *  within the tolerance. SampleInterval defaults to 1/32 of the period, or
+ *  of the valid range for aperiodic rotations, or 1 day without either.
  */
 std::unique_ptr<RotationModel>
 CreateScriptedRotation(const std::string* moduleName,
@@ -266,11 +313,27 @@ CreateScriptedRotation(const std::string* moduleName,
         return nullptr;
     }
 
-    return std::make_unique<ScriptedRotation>(luaState,
-                                              std::move(luaRotationObjectName),
-                                              period,
-                                              validRangeBegin,
-                                              validRangeEnd);
+    auto rotation = std::make_unique<ScriptedRotation>(luaState,
+                                                       std::move(luaRotationObjectName),
+                                                       period,
+                                                       validRangeBegin,
+                                                       validRangeEnd);
+
+    if (auto tolerance = parameters.getAngle<double>("SampleTolerance"); tolerance.has_value())
+    {
+        double interval = parameters.getTime<double>("SampleInterval").value_or(0.0);
+        if (interval <= 0.0)
+            interval = rotation->getPeriod() > 0.0 ? rotation->getPeriod() / 32.0 : 1.0;
+
+        // The distance between unit quaternions is about half the angle
+        // between the orientations
+        if (*tolerance > 0.0)
+            rotation->setSampleCache(interval, 0.5 * math::degToRad(*tolerance));
+        else
+            GetLogger()->warn("Ignoring non-positive SampleTolerance of ScriptedRotation\n");
+    }
+
+    return rotation;
 }
 
 } // end namespace celestia::ephem
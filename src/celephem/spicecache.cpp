@@ -0,0 +1,332 @@
+// spicecache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Chebyshev approximations of the functions computed by SPICE orbits and
+// rotations.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "spicecache.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <celcompat/numbers.h>
+#include "spiceinterface.h"
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// SPK and CK segments are themselves Chebyshev or Hermite polynomials of
+// similar degrees, so most segments of the window fit within tolerance
+constexpr std::size_t NCoefficients = 12;
+constexpr std::size_t MaxDimension = 4;
+constexpr std::size_t WindowSegments = 256;
+
+// Number of segments fitted by each step of the background job
+constexpr std::size_t SegmentsPerStep = 8;
+
+// The window is moved once queries are in its outer quarters
+constexpr double RefitMargin = 0.25;
+
+struct Table
+{
+    double begin;
+    double end;
+    double segmentLength;
+    std::size_t nSegments;
+    // Coefficients of each dimension of each segment
+    std::vector<double> coefficients;
+    std::vector<bool> fitted;
+};
+
+} // end unnamed namespace
+
+
+namespace detail
+{
+
+struct SpiceCacheState
+{
+    SpiceCacheState(unsigned int _dimension,
+                    double _segmentLength,
+                    double _tolerance,
+                    bool _antipodal,
+                    SpiceChebyshevCache::Function&& _function) :
+        dimension(_dimension),
+        segmentLength(_segmentLength),
+        tolerance(_tolerance),
+        antipodal(_antipodal),
+        function(std::move(_function))
+    {
+    }
+
+    unsigned int dimension;
+    double segmentLength;
+    double tolerance;
+    bool antipodal;
+    SpiceChebyshevCache::Function function;
+
+    // Accessed with std::atomic_load and std::atomic_store
+    std::shared_ptr<const Table> table;
+    std::atomic<bool> pending{ false };
+};
+
+} // end namespace detail
+
+
+namespace
+{
+
+using detail::SpiceCacheState;
+using Values = std::array<double, MaxDimension>;
+
+void
+align(const SpiceCacheState& state, Values& values, const Values& reference)
+{
+    if (!state.antipodal)
+        return;
+
+    double dot = 0.0;
+    for (unsigned int axis = 0; axis < state.dimension; ++axis)
+        dot += values[axis] * reference[axis];
+    if (dot < 0.0)
+    {
+        for (unsigned int axis = 0; axis < state.dimension; ++axis)
+            values[axis] = -values[axis];
+    }
+}
+
+
+// Clenshaw recurrence for each dimension at u in [-1, 1]
+void
+evaluateSegment(const SpiceCacheState& state, const double* c, double u, double* values)
+{
+    for (unsigned int axis = 0; axis < state.dimension; ++axis)
+    {
+        const double* ca = c + axis * NCoefficients;
+        double b1 = 0.0;
+        double b2 = 0.0;
+        for (std::size_t j = NCoefficients - 1; j > 0; --j)
+        {
+            double b0 = ca[j] + 2.0 * u * b1 - b2;
+            b2 = b1;
+            b1 = b0;
+        }
+        values[axis] = ca[0] + u * b1 - b2;
+    }
+}
+
+
+// Chebyshev interpolation at the Chebyshev nodes of segment i, checked
+// against the function at the ends and the middle of the segment
+void
+fitSegment(const SpiceCacheState& state, Table& table, std::size_t i)
+{
+    double halfLength = 0.5 * table.segmentLength;
+    double mid = table.begin + (static_cast<double>(i) + 0.5) * table.segmentLength;
+
+    std::array<Values, NCoefficients> values;
+    for (std::size_t k = 0; k < NCoefficients; ++k)
+    {
+        double node = std::cos(celestia::numbers::pi * (static_cast<double>(k) + 0.5) / NCoefficients);
+        values[k].fill(0.0);
+        state.function(mid + node * halfLength, values[k].data());
+        if (k > 0)
+            align(state, values[k], values[k - 1]);
+    }
+
+    double* c = table.coefficients.data() + i * state.dimension * NCoefficients;
+    for (std::size_t j = 0; j < NCoefficients; ++j)
+    {
+        Values sum{};
+        for (std::size_t k = 0; k < NCoefficients; ++k)
+        {
+            double weight = std::cos(celestia::numbers::pi * static_cast<double>(j) * (static_cast<double>(k) + 0.5) / NCoefficients);
+            for (unsigned int axis = 0; axis < state.dimension; ++axis)
+                sum[axis] += values[k][axis] * weight;
+        }
+
+        for (unsigned int axis = 0; axis < state.dimension; ++axis)
+            c[axis * NCoefficients + j] = sum[axis] * (j == 0 ? 1.0 : 2.0) / NCoefficients;
+    }
+
+    bool fitted = true;
+    for (double u : { -1.0, 0.0, 1.0 })
+    {
+        Values expected{};
+        state.function(mid + u * halfLength, expected.data());
+        align(state, expected, values[u < 0.0 ? NCoefficients - 1 : 0]);
+
+        Values approximated{};
+        evaluateSegment(state, c, u, approximated.data());
+
+        double error = 0.0;
+        double norm = 0.0;
+        for (unsigned int axis = 0; axis < state.dimension; ++axis)
+        {
+            error += (approximated[axis] - expected[axis]) * (approximated[axis] - expected[axis]);
+            norm += expected[axis] * expected[axis];
+        }
+        if (std::sqrt(error) > state.tolerance * std::max(1.0, std::sqrt(norm)))
+            fitted = false;
+    }
+
+    table.fitted[i] = fitted;
+}
+
+
+void
+requestTable(const std::shared_ptr<SpiceCacheState>& state, double center)
+{
+    if (state->pending.exchange(true))
+        return;
+
+    auto table = std::make_shared<Table>();
+    table->segmentLength = state->segmentLength;
+    table->nSegments = WindowSegments;
+    double span = static_cast<double>(WindowSegments) * state->segmentLength;
+    table->begin = std::floor((center - 0.5 * span) / state->segmentLength) * state->segmentLength;
+    table->end = table->begin + span;
+    table->coefficients.resize(table->nSegments * state->dimension * NCoefficients);
+    table->fitted.resize(table->nSegments);
+
+    PostSpiceJob([state, table, next = std::size_t(0)]() mutable
+    {
+        // Nothing left to fit for once the cache is destroyed
+        if (state.use_count() == 1)
+            return false;
+
+        std::size_t last = std::min(next + SegmentsPerStep, table->nSegments);
+        for (; next < last; ++next)
+            fitSegment(*state, *table, next);
+        if (next < table->nSegments)
+            return true;
+
+        std::atomic_store(&state->table, std::shared_ptr<const Table>(std::move(table)));
+        state->pending = false;
+        return false;
+    });
+}
+
+
+// Return the coefficients of the segment covering jd, requesting a new
+// window if jd is outside or near the edges of the current one
+const double*
+findSegment(const std::shared_ptr<SpiceCacheState>& state,
+            const std::shared_ptr<const Table>& table,
+            double jd,
+            bool moveWindow,
+            double& u)
+{
+    if (table == nullptr || !(jd >= table->begin && jd < table->end))
+    {
+        if (moveWindow && std::isfinite(jd))
+            requestTable(state, jd);
+        return nullptr;
+    }
+
+    double margin = RefitMargin * (table->end - table->begin);
+    if (moveWindow && (jd < table->begin + margin || jd > table->end - margin))
+        requestTable(state, jd);
+
+    auto i = std::min(static_cast<std::size_t>((jd - table->begin) / table->segmentLength), table->nSegments - 1);
+    if (!table->fitted[i])
+        return nullptr;
+
+    double segmentBegin = table->begin + static_cast<double>(i) * table->segmentLength;
+    u = std::clamp(2.0 * (jd - segmentBegin) / table->segmentLength - 1.0, -1.0, 1.0);
+    return table->coefficients.data() + i * state->dimension * NCoefficients;
+}
+
+} // end unnamed namespace
+
+
+SpiceChebyshevCache::SpiceChebyshevCache(unsigned int dimension,
+                                         double segmentLength,
+                                         double tolerance,
+                                         bool antipodal,
+                                         Function&& function)
+{
+    assert(dimension > 0 && dimension <= MaxDimension);
+    assert(segmentLength > 0.0);
+    state = std::make_shared<SpiceCacheState>(dimension, segmentLength, tolerance, antipodal, std::move(function));
+}
+
+
+SpiceChebyshevCache::~SpiceChebyshevCache() = default;
+
+
+bool
+SpiceChebyshevCache::value(double jd, double* values, bool moveWindow) const
+{
+    std::shared_ptr<const Table> table = std::atomic_load(&state->table);
+    double u;
+    const double* c = findSegment(state, table, jd, moveWindow, u);
+    if (c == nullptr)
+        return false;
+
+    evaluateSegment(*state, c, u, values);
+    if (state->antipodal)
+    {
+        double norm = 0.0;
+        for (unsigned int axis = 0; axis < state->dimension; ++axis)
+            norm += values[axis] * values[axis];
+        norm = std::sqrt(norm);
+        for (unsigned int axis = 0; axis < state->dimension; ++axis)
+            values[axis] /= norm;
+    }
+
+    return true;
+}
+
+
+bool
+SpiceChebyshevCache::derivative(double jd, double* values, bool moveWindow) const
+{
+    std::shared_ptr<const Table> table = std::atomic_load(&state->table);
+    double u;
+    const double* c = findSegment(state, table, jd, moveWindow, u);
+    if (c == nullptr)
+        return false;
+
+    // Derivatives of the Chebyshev polynomials, T'(n+1) = 2 T(n) + 2u T'(n) - T'(n-1)
+    std::array<double, NCoefficients> dT;
+    double t0 = 1.0;
+    double t1 = u;
+    dT[0] = 0.0;
+    dT[1] = 1.0;
+    for (std::size_t j = 2; j < NCoefficients; ++j)
+    {
+        dT[j] = 2.0 * t1 + 2.0 * u * dT[j - 1] - dT[j - 2];
+        double t2 = 2.0 * u * t1 - t0;
+        t0 = t1;
+        t1 = t2;
+    }
+
+    for (unsigned int axis = 0; axis < state->dimension; ++axis)
+    {
+        const double* ca = c + axis * NCoefficients;
+        double sum = 0.0;
+        for (std::size_t j = 1; j < NCoefficients; ++j)
+            sum += ca[j] * dT[j];
+        values[axis] = sum * (2.0 / table->segmentLength);
+    }
+
+    return true;
+}
+
+} // end namespace celestia::ephem
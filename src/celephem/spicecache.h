@@ -0,0 +1,69 @@
+// spicecache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Chebyshev approximations of the functions computed by SPICE orbits and
+// rotations.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+namespace celestia::ephem
+{
+
+namespace detail
+{
+struct SpiceCacheState;
+}
+
+/*! Piecewise Chebyshev approximation of a function of time computed with
+ *  CSPICE, e.g. a position or the components of a rotation quaternion,
+ *  over a window of equal segments. The window is fitted in the background
+ *  on the SPICE thread, and moved on once queries approach its edges;
+ *  queries within it are answered without calling CSPICE. Segments where
+ *  the approximation differs from the function by more than the tolerance
+ *  at their ends and middle aren't used.
+ */
+class SpiceChebyshevCache
+{
+public:
+    // Set the dimension values of the function at a time, called on the
+    // SPICE thread
+    using Function = std::function<void(double jd, double* values)>;
+
+    // The tolerance is on the distance between the approximated and the
+    // computed values, scaled by the norm of the values if it's larger than
+    // 1. If antipodal is set, v and -v are the same value, as for rotation
+    // quaternions, and the approximated values are normalized.
+    SpiceChebyshevCache(unsigned int dimension,
+                        double segmentLength,
+                        double tolerance,
+                        bool antipodal,
+                        Function&& function);
+    ~SpiceChebyshevCache();
+
+    SpiceChebyshevCache(const SpiceChebyshevCache&) = delete;
+    SpiceChebyshevCache& operator=(const SpiceChebyshevCache&) = delete;
+
+    // Set values to the approximation at jd, or to its derivative in units
+    // per day, and return true if the window covers jd. Otherwise return
+    // false, and request a window around jd if moveWindow is set, unless
+    // jd is in a segment which failed the tolerance. Queries away from the
+    // current time, e.g. for orbit paths, shouldn't move the window.
+    bool value(double jd, double* values, bool moveWindow = true) const;
+    bool derivative(double jd, double* values, bool moveWindow = true) const;
+
+private:
+    // Shared with the SPICE thread, which may still be fitting a window
+    // after the cache has been destroyed
+    std::shared_ptr<detail::SpiceCacheState> state;
+};
+
+} // end namespace celestia::ephem
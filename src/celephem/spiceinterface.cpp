@@ -11,7 +11,12 @@
 
 #include "spiceinterface.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <utility>
 
 #include <SpiceUsr.h>
 
@@ -36,8 +41,122 @@ ResidentKernelsSet* getResidentKernelsSet()
     return residentKernelsSet;
 }
 
+
+// The thread making all calls to CSPICE. Tasks waited for by other threads
+// run before background jobs, which are called in turn one step at a time.
+class SpiceThread
+{
+public:
+    ~SpiceThread()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stop = true;
+        }
+        condition.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    void call(const std::function<void()>& task)
+    {
+        std::unique_lock lock(mutex);
+        start();
+        if (std::this_thread::get_id() == worker.get_id())
+        {
+            lock.unlock();
+            task();
+            return;
+        }
+
+        bool done = false;
+        tasks.emplace_back(&task, &done);
+        condition.notify_one();
+        completed.wait(lock, [&done] { return done; });
+    }
+
+    void post(std::function<bool()>&& job)
+    {
+        {
+            std::scoped_lock lock(mutex);
+            start();
+            jobs.push_back(std::move(job));
+        }
+        condition.notify_one();
+    }
+
+private:
+    // Called with the mutex locked
+    void start()
+    {
+        if (!worker.joinable())
+            worker = std::thread(&SpiceThread::run, this);
+    }
+
+    void run()
+    {
+        std::unique_lock lock(mutex);
+        for (;;)
+        {
+            condition.wait(lock, [this] { return stop || !tasks.empty() || !jobs.empty(); });
+            if (stop)
+                break;
+
+            if (!tasks.empty())
+            {
+                auto [task, done] = tasks.front();
+                tasks.pop_front();
+                lock.unlock();
+                (*task)();
+                lock.lock();
+                *done = true;
+                completed.notify_all();
+                continue;
+            }
+
+            std::function<bool()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            bool more = job();
+            lock.lock();
+            if (more)
+                jobs.push_back(std::move(job));
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable completed;
+    std::deque<std::pair<const std::function<void()>*, bool*>> tasks;
+    std::deque<std::function<bool()>> jobs;
+    std::thread worker;
+    bool stop{ false };
+};
+
+
+SpiceThread&
+getSpiceThread()
+{
+    static SpiceThread spiceThread;
+    return spiceThread;
+}
+
 } // end unnamed namespace
 
+
+void
+CallSpice(const std::function<void()>& task)
+{
+    getSpiceThread().call(task);
+}
+
+
+void
+PostSpiceJob(std::function<bool()>&& job)
+{
+    getSpiceThread().post(std::move(job));
+}
+
 /*! Perform one-time initialization of SPICE.
  */
 bool
@@ -45,7 +164,7 @@ InitializeSpice()
 {
     // Set the error behavior to the RETURN action, so that
     // Celestia do its own handling of SPICE errors.
-    erract_c("SET", 0, (SpiceChar*)"RETURN");
+    CallSpice([] { erract_c("SET", 0, (SpiceChar*)"RETURN"); });
 
     return true;
 }
@@ -64,7 +183,7 @@ bool GetNaifId(const std::string& name, int* id)
     // an error if we do.
     if (!name.empty())
     {
-        bodn2c_c(name.c_str(), &spiceID, &found);
+        CallSpice([&] { bodn2c_c(name.c_str(), &spiceID, &found); });
         if (found)
         {
             *id = (int) spiceID;
@@ -97,21 +216,28 @@ bool LoadSpiceKernel(const fs::path& filepath)
     if (!getResidentKernelsSet()->insert(filepath).second)
         return true;
 
-    furnsh_c(filepath.string().c_str());
-
-    // If there was an error loading the kernel, dump the error message.
-    if (failed_c())
+    bool loaded = true;
+    CallSpice([&]
     {
-        char errMsg[1024];
-        getmsg_c("long", sizeof(errMsg), errMsg);
-        GetLogger()->error("{}\n", errMsg);
+        furnsh_c(filepath.string().c_str());
+
+        // If there was an error loading the kernel, dump the error message.
+        if (failed_c())
+        {
+            char errMsg[1024];
+            getmsg_c("long", sizeof(errMsg), errMsg);
+            GetLogger()->error("{}\n", errMsg);
 
-        // Reset the SPICE error state so that future calls to
-        // SPICE can still succeed.
-        reset_c();
+            // Reset the SPICE error state so that future calls to
+            // SPICE can still succeed.
+            reset_c();
 
+            loaded = false;
+        }
+    });
+
+    if (!loaded)
         return false;
-    }
 
      GetLogger()->info("Loaded SPK file {}\n", filepath);
      return true;
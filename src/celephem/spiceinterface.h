@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 
 #include <celcompat/filesystem.h>
@@ -25,4 +26,12 @@ bool InitializeSpice();
 bool GetNaifId(const std::string& name, int* id);
 bool LoadSpiceKernel(const fs::path& filepath);
 
+// CSPICE isn't reentrant, so all calls to it are made on one thread.
+// CallSpice runs task on that thread and waits until it's complete, or
+// runs it at once when called from the thread itself. PostSpiceJob runs
+// job in the background between tasks until it returns false; each call
+// should be short, so that the tasks aren't delayed.
+void CallSpice(const std::function<void()>& task);
+void PostSpiceJob(std::function<bool()>&& job);
+
 }
@@ -9,12 +9,14 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <utility>
 
 #include <SpiceUsr.h>
 
 #include <celastro/date.h>
 #include <celutil/logger.h>
+#include "spicecache.h"
 #include "spiceinterface.h"
 #include "spiceorbit.h"
 
@@ -29,6 +31,64 @@ namespace
 
 constexpr double MILLISEC = astro::secsToDays(0.001);
 
+// Length of the segments of the approximations of aperiodic orbits, and
+// fraction of the period for periodic ones
+constexpr double AperiodicSegmentLength = 1.0 / 24.0;
+constexpr double SegmentsPerPeriod = 16.0;
+
+// Relative to the distance from the origin, or in km within 1 km of it
+constexpr double PositionTolerance = 1.0e-10;
+
+// Set while the calling thread samples an orbit path
+thread_local bool samplingPath = false;
+
+class SamplingPathScope
+{
+public:
+    SamplingPathScope() : previous(samplingPath) { samplingPath = true; }
+    ~SamplingPathScope() { samplingPath = previous; }
+
+    SamplingPathScope(const SamplingPathScope&) = delete;
+    SamplingPathScope& operator=(const SamplingPathScope&) = delete;
+
+private:
+    bool previous;
+};
+
+
+// Called on the SPICE thread, with jd within the valid interval
+Eigen::Vector3d
+computeSpicePosition(int targetID, int originID, double jd)
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double position[3];
+    double lt;          // One way light travel time
+
+    spkgps_c(targetID,
+             t,
+             "eclipj2000",
+             originID,
+             position,
+             &lt);
+
+    // This shouldn't happen, since we've already computed the valid
+    // coverage interval.
+    if (failed_c())
+    {
+        // Print the error message
+        char errMsg[1024];
+        getmsg_c("long", sizeof(errMsg), errMsg);
+        GetLogger()->warn("{}\n", errMsg);
+
+        // Reset the error state
+        reset_c();
+    }
+
+    // Transform into Celestia's coordinate system
+    return Eigen::Vector3d(position[0], position[2], -position[1]);
+}
+
 } // end unnamed namespace
 
 /*! Create a new SPICE orbit using with a valid interval specified
@@ -75,6 +135,9 @@ SpiceOrbit::SpiceOrbit(std::string  _targetBodyName,
 }
 
 
+SpiceOrbit::~SpiceOrbit() = default;
+
+
 bool
 SpiceOrbit::isPeriodic() const
 {
@@ -123,116 +186,136 @@ SpiceOrbit::init()
         return false;
     }
 
-    SpiceInt spkCount = 0;
-    ktotal_c("spk", &spkCount);
+    // Everything else runs on the SPICE thread
+    CallSpice([this]
+    {
+        SpiceInt spkCount = 0;
+        ktotal_c("spk", &spkCount);
 
-    // Get coverage window for target and origin object
-    const int MaxIntervals = 10;
-    SPICEDOUBLE_CELL ( targetCoverage, MaxIntervals * 2 );
+        // Get coverage window for target and origin object
+        const int MaxIntervals = 10;
+        SPICEDOUBLE_CELL ( targetCoverage, MaxIntervals * 2 );
 
-    // Clear the coverage window.
-    scard_c(0, &targetCoverage);
+        // Clear the coverage window.
+        scard_c(0, &targetCoverage);
 
-    for (SpiceInt i = 0; i < spkCount; i++)
-    {
-        SpiceChar filename[512];
-        SpiceChar filetype[32];
-        SpiceChar source[256];
-        SpiceInt handle;
-        SpiceBoolean found;
-
-        kdata_c(i, "spk",
-                sizeof(filename), sizeof(filetype), sizeof(source),
-                filename, filetype, source, &handle, &found);
-
-        // First check the coverage window of the target. No interval
-        // is required for ID 0 (the solar system barycenter) which is
-        // always at (0, 0, 0).
-        if (targetID != 0)
+        for (SpiceInt i = 0; i < spkCount; i++)
         {
-            spkcov_c(filename, targetID, &targetCoverage);
+            SpiceChar filename[512];
+            SpiceChar filetype[32];
+            SpiceChar source[256];
+            SpiceInt handle;
+            SpiceBoolean found;
+
+            kdata_c(i, "spk",
+                    sizeof(filename), sizeof(filetype), sizeof(source),
+                    filename, filetype, source, &handle, &found);
+
+            // First check the coverage window of the target. No interval
+            // is required for ID 0 (the solar system barycenter) which is
+            // always at (0, 0, 0).
+            if (targetID != 0)
+            {
+                spkcov_c(filename, targetID, &targetCoverage);
+            }
         }
-    }
 
-    SpiceInt nIntervals = card_c(&targetCoverage) / 2;
-    if (nIntervals <= 0 && targetID != 0)
-    {
-        GetLogger()->error("Couldn't find object {} in SPICE kernel pool.\n", targetBodyName);
-        spiceErr = true;
-        if (failed_c())
+        SpiceInt nIntervals = card_c(&targetCoverage) / 2;
+        if (nIntervals <= 0 && targetID != 0)
         {
-            reset_c();
+            GetLogger()->error("Couldn't find object {} in SPICE kernel pool.\n", targetBodyName);
+            spiceErr = true;
+            if (failed_c())
+            {
+                reset_c();
+            }
+            return;
         }
-        return false;
-    }
-
-    // TODO: need to consider the origin object as well as the target
-    if (useDefaultTimeInterval)
-    {
-        // Set the valid time interval for this orbit to the first interval
-        // in the coverage window for the target.
-        SpiceDouble targetBeginning = -1.0e50;
-        SpiceDouble targetEnding    = +1.0e50;
 
-        if (targetID == 0)
+        // TODO: need to consider the origin object as well as the target
+        if (useDefaultTimeInterval)
         {
-            // Time range for solar system barycenter is infinite
-            validIntervalBegin = targetBeginning;
-            validIntervalEnd = targetEnding;
+            // Set the valid time interval for this orbit to the first interval
+            // in the coverage window for the target.
+            SpiceDouble targetBeginning = -1.0e50;
+            SpiceDouble targetEnding    = +1.0e50;
+
+            if (targetID == 0)
+            {
+                // Time range for solar system barycenter is infinite
+                validIntervalBegin = targetBeginning;
+                validIntervalEnd = targetEnding;
+            }
+            else
+            {
+                wnfetd_c(&targetCoverage, 0, &targetBeginning, &targetEnding);
+
+                // SPICE times are seconds since J2000.0
+                validIntervalBegin = astro::secsToDays(targetBeginning) + astro::J2000;
+                validIntervalEnd = astro::secsToDays(targetEnding) + astro::J2000;
+
+                // Reduce interval by a millisecond at each end; otherwise, rounding error
+                // can cause us to get SPICE errors when computing states right at the edge
+                // of the valid window.
+                validIntervalBegin += MILLISEC;
+                validIntervalEnd -= MILLISEC;
+            }
         }
         else
         {
-            wnfetd_c(&targetCoverage, 0, &targetBeginning, &targetEnding);
-
-            // SPICE times are seconds since J2000.0
-            validIntervalBegin = astro::secsToDays(targetBeginning) + astro::J2000;
-            validIntervalEnd = astro::secsToDays(targetEnding) + astro::J2000;
-
-            // Reduce interval by a millisecond at each end; otherwise, rounding error
-            // can cause us to get SPICE errors when computing states right at the edge
-            // of the valid window.
+            // Reduce valid interval by a millisecond at each end.
             validIntervalBegin += MILLISEC;
             validIntervalEnd -= MILLISEC;
-        }
-    }
-    else
-    {
-        // Reduce valid interval by a millisecond at each end.
-        validIntervalBegin += MILLISEC;
-        validIntervalEnd -= MILLISEC;
 
-        SpiceDouble beginningSecondsJ2000 = astro::daysToSecs(validIntervalBegin - astro::J2000);
-        SpiceDouble endingSecondsJ2000    = astro::daysToSecs(validIntervalEnd - astro::J2000);
+            SpiceDouble beginningSecondsJ2000 = astro::daysToSecs(validIntervalBegin - astro::J2000);
+            SpiceDouble endingSecondsJ2000    = astro::daysToSecs(validIntervalEnd - astro::J2000);
+
+            // A time interval was specified--make sure that it's covered in the SPICE kernel.
+            if (targetID != 0 &&
+                !wnincd_c(beginningSecondsJ2000, endingSecondsJ2000, &targetCoverage))
+            {
+                GetLogger()->error("Specified time interval for target {} not available.\n", targetBodyName);
+                spiceErr = true;
+                return;
+            }
+        }
 
-        // A time interval was specified--make sure that it's covered in the SPICE kernel.
-        if (targetID != 0 &&
-            !wnincd_c(beginningSecondsJ2000, endingSecondsJ2000, &targetCoverage))
+        // Test getting the position of the object to make sure that there's
+        // adequate data in the kernel to compute the position of the target
+        // relative to the origin. Even if both objects are present and have
+        // adequate coverage, it's possible that there might be a missing frame
+        // definition or itermediate object.
+        double beginning = astro::daysToSecs(validIntervalBegin - astro::J2000);
+        double position[3];
+        double lt = 0.0;
+        spkgps_c(targetID, beginning, "eclipj2000", originID,
+                 position, &lt);
+        if (failed_c())
         {
-            GetLogger()->error("Specified time interval for target {} not available.\n", targetBodyName);
-            return false;
+            // Print the error message
+            char errMsg[1024];
+            getmsg_c("long", sizeof(errMsg), errMsg);
+            GetLogger()->error("{}\n", errMsg);
+            spiceErr = true;
+
+            reset_c();
         }
-    }
+    });
 
-    // Test getting the position of the object to make sure that there's
-    // adequate data in the kernel to compute the position of the target
-    // relative to the origin. Even if both objects are present and have
-    // adequate coverage, it's possible that there might be a missing frame
-    // definition or itermediate object.
-    double beginning = astro::daysToSecs(validIntervalBegin - astro::J2000);
-    double position[3];
-    double lt = 0.0;
-    spkgps_c(targetID, beginning, "eclipj2000", originID,
-             position, &lt);
-    if (failed_c())
-    {
-        // Print the error message
-        char errMsg[1024];
-        getmsg_c("long", sizeof(errMsg), errMsg);
-        GetLogger()->error("{}\n", errMsg);
-        spiceErr = true;
+    if (spiceErr)
+        return false;
 
-        reset_c();
-    }
+    double segmentLength = isPeriodic() ? period / SegmentsPerPeriod : AperiodicSegmentLength;
+    cache = std::make_unique<SpiceChebyshevCache>(3, segmentLength, PositionTolerance, false,
+                                                  [targetID = targetID,
+                                                   originID = originID,
+                                                   begin = validIntervalBegin,
+                                                   end = validIntervalEnd](double jd, double* values)
+                                                  {
+                                                      jd = std::max(std::min(jd, end), begin);
+                                                      Eigen::Vector3d::Map(values) =
+                                                          computeSpicePosition(targetID, originID, jd);
+                                                  });
 
     return !spiceErr;
 }
@@ -247,39 +330,13 @@ SpiceOrbit::computePosition(double jd) const
         jd = validIntervalEnd;
 
     if (spiceErr)
-    {
         return Eigen::Vector3d::Zero();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double position[3];
-        double lt;          // One way light travel time
-
-        spkgps_c(targetID,
-                 t,
-                 "eclipj2000",
-                 originID,
-                 position,
-                 &lt);
-
-        // This shouldn't happen, since we've already computed the valid
-        // coverage interval.
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->warn("{}\n", errMsg);
 
-            // Reset the error state
-            reset_c();
-        }
+    Eigen::Vector3d position;
+    if (cache == nullptr || !cache->value(jd, position.data(), !samplingPath))
+        CallSpice([&] { position = computeSpicePosition(targetID, originID, jd); });
 
-        // Transform into Celestia's coordinate system
-        return Eigen::Vector3d(position[0], position[2], -position[1]);
-    }
+    return position;
 }
 
 
@@ -292,16 +349,19 @@ SpiceOrbit::computeVelocity(double jd) const
         jd = validIntervalEnd;
 
     if (spiceErr)
-    {
         return Eigen::Vector3d::Zero();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double state[6];
-        double lt;          // One way light travel time
 
+    Eigen::Vector3d velocity;
+    if (cache != nullptr && cache->derivative(jd, velocity.data(), !samplingPath))
+        return velocity;
+
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double state[6];
+    double lt;          // One way light travel time
+
+    CallSpice([&]
+    {
         spkgeo_c(targetID,
                  t,
                  "eclipj2000",
@@ -321,11 +381,27 @@ SpiceOrbit::computeVelocity(double jd) const
             // Reset the error state
             reset_c();
         }
+    });
 
-        // Transform into Celestia's coordinate system, and from km/s to km/day
-        double d2s = astro::daysToSecs(1.0);
-        return Eigen::Vector3d(state[3] * d2s, state[5] * d2s, -state[4] * d2s);
-    }
+    // Transform into Celestia's coordinate system, and from km/s to km/day
+    double d2s = astro::daysToSecs(1.0);
+    return Eigen::Vector3d(state[3] * d2s, state[5] * d2s, -state[4] * d2s);
+}
+
+
+void
+SpiceOrbit::positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const
+{
+    SamplingPathScope scope;
+    CachingOrbit::positionsAtTimes(times, positions);
+}
+
+
+void
+SpiceOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    SamplingPathScope scope;
+    CachingOrbit::sample(startTime, endTime, proc);
 }
 
 
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <Eigen/Core>
@@ -21,6 +22,8 @@
 namespace celestia::ephem
 {
 
+class SpiceChebyshevCache;
+
 class SpiceOrbit : public CachingOrbit
 {
  public:
@@ -34,7 +37,7 @@ class SpiceOrbit : public CachingOrbit
                std::string  _originName,
                double _period,
                double _boundingRadius);
-    ~SpiceOrbit() override = default;
+    ~SpiceOrbit() override;
 
     template<typename It>
     bool init(const fs::path& path, It begin, It end)
@@ -59,6 +62,10 @@ class SpiceOrbit : public CachingOrbit
     Eigen::Vector3d computePosition(double jd) const override;
     Eigen::Vector3d computeVelocity(double jd) const override;
 
+    // Orbit paths are sampled without moving the window of the cache
+    void positionsAtTimes(util::array_view<double> times, Eigen::Vector3d* positions) const override;
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+
     void getValidRange(double& begin, double& end) const override;
 
  private:
@@ -77,6 +84,10 @@ class SpiceOrbit : public CachingOrbit
 
     bool useDefaultTimeInterval;
 
+    // Positions are approximated from a window fitted on the SPICE thread,
+    // and only computed by SPICE, on its thread too, outside the window
+    std::unique_ptr<SpiceChebyshevCache> cache;
+
     bool init();
     bool loadRequiredKernel(const fs::path&, const std::string&);
 };
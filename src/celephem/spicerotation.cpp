@@ -12,6 +12,7 @@
 
 #include "spicerotation.h"
 
+#include <algorithm>
 #include <limits>
 
 #include <SpiceUsr.h>
@@ -20,6 +21,7 @@
 #include <celcompat/numbers.h>
 #include <celmath/geomutil.h>
 #include <celutil/logger.h>
+#include "spicecache.h"
 #include "spiceinterface.h"
 
 using celestia::util::GetLogger;
@@ -33,6 +35,55 @@ namespace
 
 constexpr double MILLISEC = astro::secsToDays(0.001);
 
+// Length of the segments of the approximations of aperiodic rotations,
+// and fraction of the period for periodic ones
+constexpr double AperiodicSegmentLength = 1.0 / 24.0;
+constexpr double SegmentsPerPeriod = 16.0;
+
+// Of the components of the quaternions, about half the angle in radians
+constexpr double OrientationTolerance = 1.0e-10;
+
+
+// Called on the SPICE thread, with jd within the valid interval
+Eigen::Quaterniond
+computeSpiceSpin(const std::string& frameName, const std::string& baseFrameName, double jd)
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double xform[3][3];
+
+    pxform_c(frameName.c_str(), baseFrameName.c_str(), t, xform);
+
+    if (failed_c())
+    {
+        // Print the error message
+        char errMsg[1024];
+        getmsg_c("long", sizeof(errMsg), errMsg);
+        GetLogger()->error("{}\n", errMsg);
+
+        // Reset the error state
+        reset_c();
+    }
+
+    // Eigen stores matrices in column-major order...
+    double matrixData[9] =
+    {
+        xform[0][0], xform[0][1], xform[0][2],
+        xform[1][0], xform[1][1], xform[1][2],
+        xform[2][0], xform[2][1], xform[2][2]
+    };
+
+    // ...but Celestia's rotations are reversed, thus the extra
+    // call to conjugate()
+    Eigen::Quaterniond q = Eigen::Quaterniond(Eigen::Map<Eigen::Matrix3d>(matrixData)).conjugate();
+
+    // Transform into Celestia's coordinate system
+    return math::YRot180<double> *
+           math::XRot90Conjugate<double> *
+           q.conjugate() *
+           math::XRot90<double>;
+}
+
 } // end unnamed namespace
 
 /*! Create a new rotation model based on a SPICE frame. The
@@ -81,6 +132,9 @@ SpiceRotation::SpiceRotation(const std::string& frameName,
 }
 
 
+SpiceRotation::~SpiceRotation() = default;
+
+
 bool
 SpiceRotation::isPeriodic() const
 {
@@ -121,20 +175,38 @@ SpiceRotation::init()
     // Test getting the frame rotation matrix to make sure that there's
     // adequate data in the kernel.
     double beginning = astro::daysToSecs(m_validIntervalBegin - astro::J2000);
-    double xform[3][3];
-    pxform_c(m_frameName.c_str(), m_frameName.c_str(), beginning, xform);
-    if (failed_c())
+    CallSpice([this, beginning]
     {
-        // Print the error message
-        char errMsg[1024];
-        getmsg_c("long", sizeof(errMsg), errMsg);
-        GetLogger()->error("{}\n", errMsg);
-        m_spiceErr = true;
+        double xform[3][3];
+        pxform_c(m_frameName.c_str(), m_frameName.c_str(), beginning, xform);
+        if (failed_c())
+        {
+            // Print the error message
+            char errMsg[1024];
+            getmsg_c("long", sizeof(errMsg), errMsg);
+            GetLogger()->error("{}\n", errMsg);
+            m_spiceErr = true;
 
-        reset_c();
-    }
+            reset_c();
+        }
+    });
 
-    return !m_spiceErr;
+    if (m_spiceErr)
+        return false;
+
+    double segmentLength = isPeriodic() ? m_period / SegmentsPerPeriod : AperiodicSegmentLength;
+    m_cache = std::make_unique<SpiceChebyshevCache>(4, segmentLength, OrientationTolerance, true,
+                                                    [frameName = m_frameName,
+                                                     baseFrameName = m_baseFrameName,
+                                                     begin = m_validIntervalBegin,
+                                                     end = m_validIntervalEnd](double jd, double* values)
+                                                    {
+                                                        jd = std::max(std::min(jd, end), begin);
+                                                        Eigen::Vector4d::Map(values) =
+                                                            computeSpiceSpin(frameName, baseFrameName, jd).coeffs();
+                                                    });
+
+    return true;
 }
 
 
@@ -147,46 +219,13 @@ SpiceRotation::computeSpin(double jd) const
         jd = m_validIntervalEnd;
 
     if (m_spiceErr)
-    {
         return Eigen::Quaterniond::Identity();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double xform[3][3];
-
-        pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
-
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->error("{}\n", errMsg);
 
-            // Reset the error state
-            reset_c();
-        }
+    Eigen::Quaterniond q;
+    if (m_cache == nullptr || !m_cache->value(jd, q.coeffs().data()))
+        CallSpice([&] { q = computeSpiceSpin(m_frameName, m_baseFrameName, jd); });
 
-        // Eigen stores matrices in column-major order...
-        double matrixData[9] =
-        {
-            xform[0][0], xform[0][1], xform[0][2],
-            xform[1][0], xform[1][1], xform[1][2],
-            xform[2][0], xform[2][1], xform[2][2]
-        };
-
-        // ...but Celestia's rotations are reversed, thus the extra
-        // call to conjugate()
-        Eigen::Quaterniond q = Eigen::Quaterniond(Eigen::Map<Eigen::Matrix3d>(matrixData)).conjugate();
-
-        // Transform into Celestia's coordinate system
-        return math::YRot180<double> *
-               math::XRot90Conjugate<double> *
-               q.conjugate() *
-               math::XRot90<double>;
-    }
+    return q;
 }
 
 } // end namespace celestia::ephem
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <Eigen/Geometry>
@@ -22,6 +23,8 @@
 namespace celestia::ephem
 {
 
+class SpiceChebyshevCache;
+
 class SpiceRotation : public CachingRotationModel
 {
  public:
@@ -33,7 +36,7 @@ class SpiceRotation : public CachingRotationModel
     SpiceRotation(const std::string& frameName,
                   const std::string& baseFrameName,
                   double period);
-    virtual ~SpiceRotation() = default;
+    ~SpiceRotation() override;
 
     template<typename It>
     bool init(const fs::path& path, It begin, It end)
@@ -68,6 +71,10 @@ class SpiceRotation : public CachingRotationModel
     double m_validIntervalEnd;
     bool m_useDefaultTimeInterval;
 
+    // Orientations are approximated from a window fitted on the SPICE
+    // thread, and only computed by SPICE, on its thread too, outside it
+    std::unique_ptr<SpiceChebyshevCache> m_cache;
+
     bool loadRequiredKernel(const fs::path&, const std::string&);
     bool init();
 };
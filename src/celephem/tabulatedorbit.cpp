@@ -0,0 +1,401 @@
+// tabulatedorbit.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "tabulatedorbit.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <celcompat/numbers.h>
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// Each segment of the window covers 1/16 of the orbital period with 10
+// coefficients per coordinate, which approximates the analytic theories
+// well below their own accuracy.
+constexpr std::size_t NCoefficients = 10;
+constexpr double SegmentsPerPeriod = 16.0;
+constexpr std::size_t MaxSegments = 4096;
+
+// The window is rebuilt once the time moves into its outer quarters
+constexpr double RebuildMargin = 0.25;
+
+struct Table
+{
+    double begin;
+    double end;
+    double segmentLength;
+    std::size_t nSegments;
+    // Coefficients of the x, y and z coordinates of each segment
+    std::vector<double> coefficients;
+};
+
+} // end unnamed namespace
+
+
+namespace detail
+{
+
+struct TabulatedOrbitState
+{
+    TabulatedOrbitState(std::unique_ptr<Orbit>&& _orbit, double _span, double _segmentLength) :
+        orbit(std::move(_orbit)), span(_span), segmentLength(_segmentLength)
+    {
+    }
+
+    std::unique_ptr<Orbit> orbit;
+    double span;
+    double segmentLength;
+
+    // Accessed with std::atomic_load and std::atomic_store
+    std::shared_ptr<const Table> table;
+
+    std::atomic<bool> pending{ false };
+    std::mutex mutex;
+    std::condition_variable built;
+    double center{ 0.0 };
+};
+
+} // end namespace detail
+
+
+namespace
+{
+
+using detail::TabulatedOrbitState;
+
+std::shared_ptr<const Table>
+buildTable(const TabulatedOrbitState& state, double center)
+{
+    auto table = std::make_shared<Table>();
+    table->segmentLength = state.segmentLength;
+    table->nSegments = static_cast<std::size_t>(std::ceil(state.span / state.segmentLength));
+    table->begin = std::floor((center - 0.5 * state.span) / state.segmentLength) * state.segmentLength;
+    table->end = table->begin + static_cast<double>(table->nSegments) * state.segmentLength;
+    table->coefficients.resize(table->nSegments * 3 * NCoefficients);
+
+    // Chebyshev interpolation at the Chebyshev nodes of each segment
+    std::array<double, NCoefficients> nodes;
+    for (std::size_t k = 0; k < NCoefficients; ++k)
+        nodes[k] = std::cos(celestia::numbers::pi * (static_cast<double>(k) + 0.5) / NCoefficients);
+
+    std::array<Eigen::Vector3d, NCoefficients> values;
+    double halfLength = 0.5 * state.segmentLength;
+    for (std::size_t i = 0; i < table->nSegments; ++i)
+    {
+        double mid = table->begin + (static_cast<double>(i) + 0.5) * state.segmentLength;
+        for (std::size_t k = 0; k < NCoefficients; ++k)
+            values[k] = state.orbit->positionAtTime(mid + nodes[k] * halfLength);
+
+        double* c = table->coefficients.data() + i * 3 * NCoefficients;
+        for (std::size_t j = 0; j < NCoefficients; ++j)
+        {
+            Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+            for (std::size_t k = 0; k < NCoefficients; ++k)
+                sum += values[k] * std::cos(celestia::numbers::pi * static_cast<double>(j) * (static_cast<double>(k) + 0.5) / NCoefficients);
+
+            sum *= (j == 0 ? 1.0 : 2.0) / NCoefficients;
+            for (int axis = 0; axis < 3; ++axis)
+                c[axis * NCoefficients + j] = sum[axis];
+        }
+    }
+
+    return table;
+}
+
+
+// Builds the windows of all tabulated orbits on one thread, so that the
+// rebuilds don't compete with rendering for more than one core.
+class TableBuilder
+{
+public:
+    ~TableBuilder()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stop = true;
+        }
+        condition.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    void request(std::shared_ptr<TabulatedOrbitState>&& state)
+    {
+        {
+            std::scoped_lock lock(mutex);
+            queue.push_back(std::move(state));
+            if (!worker.joinable())
+                worker = std::thread(&TableBuilder::run, this);
+        }
+        condition.notify_one();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock lock(mutex);
+        for (;;)
+        {
+            condition.wait(lock, [this] { return stop || !queue.empty(); });
+            if (stop)
+                break;
+
+            std::shared_ptr<TabulatedOrbitState> state = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            double center;
+            {
+                std::scoped_lock stateLock(state->mutex);
+                center = state->center;
+            }
+
+            std::atomic_store(&state->table, buildTable(*state, center));
+
+            {
+                std::scoped_lock stateLock(state->mutex);
+                state->pending = false;
+            }
+            state->built.notify_all();
+
+            state.reset();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::shared_ptr<TabulatedOrbitState>> queue;
+    std::thread worker;
+    bool stop{ false };
+};
+
+
+TableBuilder&
+getTableBuilder()
+{
+    static TableBuilder builder;
+    return builder;
+}
+
+
+void
+requestTable(const std::shared_ptr<TabulatedOrbitState>& state, double center)
+{
+    if (state->pending.exchange(true))
+        return;
+
+    {
+        std::scoped_lock lock(state->mutex);
+        state->center = center;
+    }
+    getTableBuilder().request(std::shared_ptr<TabulatedOrbitState>(state));
+}
+
+
+// Returns the table if it covers jd, and requests a new one centered on
+// jd if jd is outside or near the edges of it.
+const Table*
+findTable(const std::shared_ptr<TabulatedOrbitState>& state,
+          const std::shared_ptr<const Table>& table,
+          double jd)
+{
+    if (table == nullptr || !(jd >= table->begin && jd < table->end))
+    {
+        requestTable(state, jd);
+        return nullptr;
+    }
+
+    double margin = RebuildMargin * (table->end - table->begin);
+    if (jd < table->begin + margin || jd > table->end - margin)
+        requestTable(state, jd);
+    return table.get();
+}
+
+
+const double*
+segmentAt(const Table& table, double jd, double& u)
+{
+    auto i = std::min(static_cast<std::size_t>((jd - table.begin) / table.segmentLength), table.nSegments - 1);
+    double segmentBegin = table.begin + static_cast<double>(i) * table.segmentLength;
+    u = std::clamp(2.0 * (jd - segmentBegin) / table.segmentLength - 1.0, -1.0, 1.0);
+    return table.coefficients.data() + i * 3 * NCoefficients;
+}
+
+} // end unnamed namespace
+
+
+TabulatedOrbit::TabulatedOrbit(std::unique_ptr<Orbit> orbit, double span)
+{
+    assert(span > 0.0);
+
+    // Keep at least two periods in the window, so that positions a period
+    // back, e.g. for light time or trails, are still covered
+    double period = orbit->getPeriod();
+    double segmentLength;
+    if (period > 0.0 && std::isfinite(period))
+    {
+        span = std::max(span, 2.0 * period);
+        segmentLength = period / SegmentsPerPeriod;
+    }
+    else
+    {
+        segmentLength = span / 256.0;
+    }
+
+    span = std::min(span, segmentLength * static_cast<double>(MaxSegments));
+    state = std::make_shared<detail::TabulatedOrbitState>(std::move(orbit), span, segmentLength);
+}
+
+
+TabulatedOrbit::~TabulatedOrbit() = default;
+
+
+Eigen::Vector3d
+TabulatedOrbit::positionAtTime(double jd) const
+{
+    std::shared_ptr<const Table> table = std::atomic_load(&state->table);
+    const Table* current = findTable(state, table, jd);
+    if (current == nullptr)
+        return state->orbit->positionAtTime(jd);
+
+    double u;
+    const double* c = segmentAt(*current, jd, u);
+
+    // Clenshaw recurrence for each coordinate
+    Eigen::Vector3d position;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double* ca = c + axis * NCoefficients;
+        double b1 = 0.0;
+        double b2 = 0.0;
+        for (std::size_t j = NCoefficients - 1; j > 0; --j)
+        {
+            double b0 = ca[j] + 2.0 * u * b1 - b2;
+            b2 = b1;
+            b1 = b0;
+        }
+        position[axis] = ca[0] + u * b1 - b2;
+    }
+
+    return position;
+}
+
+
+Eigen::Vector3d
+TabulatedOrbit::velocityAtTime(double jd) const
+{
+    std::shared_ptr<const Table> table = std::atomic_load(&state->table);
+    const Table* current = findTable(state, table, jd);
+    if (current == nullptr)
+        return state->orbit->velocityAtTime(jd);
+
+    double u;
+    const double* c = segmentAt(*current, jd, u);
+
+    // Derivatives of the Chebyshev polynomials, T'(n+1) = 2 T(n) + 2u T'(n) - T'(n-1)
+    std::array<double, NCoefficients> dT;
+    double t0 = 1.0;
+    double t1 = u;
+    dT[0] = 0.0;
+    dT[1] = 1.0;
+    for (std::size_t j = 2; j < NCoefficients; ++j)
+    {
+        dT[j] = 2.0 * t1 + 2.0 * u * dT[j - 1] - dT[j - 2];
+        double t2 = 2.0 * u * t1 - t0;
+        t0 = t1;
+        t1 = t2;
+    }
+
+    Eigen::Vector3d velocity;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double* ca = c + axis * NCoefficients;
+        double sum = 0.0;
+        for (std::size_t j = 1; j < NCoefficients; ++j)
+            sum += ca[j] * dT[j];
+        velocity[axis] = sum;
+    }
+
+    return velocity * (2.0 / current->segmentLength);
+}
+
+
+double
+TabulatedOrbit::getPeriod() const
+{
+    return state->orbit->getPeriod();
+}
+
+
+double
+TabulatedOrbit::getBoundingRadius() const
+{
+    return state->orbit->getBoundingRadius();
+}
+
+
+double
+TabulatedOrbit::getMinimumRadius() const
+{
+    return state->orbit->getMinimumRadius();
+}
+
+
+bool
+TabulatedOrbit::isPeriodic() const
+{
+    return state->orbit->isPeriodic();
+}
+
+
+bool
+TabulatedOrbit::isThreadSafe() const
+{
+    return state->orbit->isThreadSafe();
+}
+
+
+void
+TabulatedOrbit::getValidRange(double& begin, double& end) const
+{
+    state->orbit->getValidRange(begin, end);
+}
+
+
+void
+TabulatedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    state->orbit->sample(startTime, endTime, proc);
+}
+
+
+void
+TabulatedOrbit::waitForTable() const
+{
+    std::unique_lock lock(state->mutex);
+    state->built.wait(lock, [this] { return !state->pending.load(); });
+}
+
+} // end namespace celestia::ephem
@@ -0,0 +1,64 @@
+// tabulatedorbit.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "orbit.h"
+
+namespace celestia::ephem
+{
+
+namespace detail
+{
+struct TabulatedOrbitState;
+}
+
+// Evaluates an orbit from Chebyshev approximations over a window of time.
+// The window is centered on the times the orbit is evaluated at, and
+// is rebuilt on a background thread once they move towards its edges.
+// Positions outside the window are computed by the approximated orbit
+// until the new window is ready.
+class TabulatedOrbit : public Orbit
+{
+public:
+    // Approximate orbit over a window of span days, which must be positive
+    TabulatedOrbit(std::unique_ptr<Orbit> orbit, double span);
+    ~TabulatedOrbit() override;
+
+    TabulatedOrbit(const TabulatedOrbit&) = delete;
+    TabulatedOrbit& operator=(const TabulatedOrbit&) = delete;
+
+    Eigen::Vector3d positionAtTime(double jd) const override;
+    Eigen::Vector3d velocityAtTime(double jd) const override;
+
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    double getMinimumRadius() const override;
+    bool isPeriodic() const override;
+    bool isThreadSafe() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+    // Orbit paths span times away from the window, so they are sampled
+    // from the approximated orbit
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+
+    // Wait until a pending rebuild of the window is complete
+    void waitForTable() const;
+
+private:
+    // Shared with the background thread, which may still be building a
+    // window after the orbit has been destroyed
+    std::shared_ptr<detail::TabulatedOrbitState> state;
+};
+
+}
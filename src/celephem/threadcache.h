@@ -0,0 +1,52 @@
+// threadcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Per-thread caches of the last values computed by orbits, rotation
+// models and bodies.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace celestia::ephem::detail
+{
+
+inline std::atomic<std::uint64_t> nextThreadCacheId{ 1 };
+
+// Ids are never reused, so that entries of destroyed objects can't be
+// mistaken for those of new objects at the same address
+inline std::uint64_t
+NewThreadCacheId()
+{
+    return nextThreadCacheId.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*! Return the entry of the calling thread's cache for the object with the
+ *  given id. The cache is direct mapped: objects share an entry if their
+ *  ids are a multiple of the cache size apart, so callers must check the
+ *  id member of the entry, which is 0 for unused entries. Entry must be
+ *  default constructible with an id member.
+ */
+template<typename Entry, std::size_t CacheSize = 256>
+Entry&
+GetThreadCacheEntry(std::uint64_t id)
+{
+    // Allocated on first use, threads which never evaluate orbits or
+    // rotations don't pay for it. Each entry type and size has its own.
+    thread_local std::unique_ptr<std::array<Entry, CacheSize>> cache;
+    if (cache == nullptr)
+        cache = std::make_unique<std::array<Entry, CacheSize>>();
+    return (*cache)[id % CacheSize];
+}
+
+} // end namespace celestia::ephem::detail
@@ -14,10 +14,13 @@
 
 #include "vsop87.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
 #include <memory>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include <config.h>
@@ -25,6 +28,7 @@
 #include <celastro/astro.h>
 #include <celastro/date.h>
 #include <celcompat/numbers.h>
+#include <celmath/cosinesum.h>
 #include <celmath/mathlib.h>
 #include "orbit.h"
 
@@ -39,25 +43,61 @@ struct VSOPTerm
     double A, B, C;
 };
 
-struct VSOPSeries
+// Term tables with the A, B and C coefficients in separate arrays, so that
+// SumCosines can load several terms at once
+template<std::size_t N>
+struct VSOPTermTable
 {
-    template<typename std::size_t N>
-    explicit constexpr VSOPSeries(const std::array<VSOPTerm, N>& arr)
-        : terms(arr.data()), nTerms(arr.size())
-    {
-    }
+    std::array<double, N> A{ };
+    std::array<double, N> B{ };
+    std::array<double, N> C{ };
+    double maxFrequency{ 0.0 };
+};
 
-#ifndef HAVE_CONSTEXPR_EMPTY_ARRAY
-    explicit constexpr VSOPSeries(const std::array<VSOPTerm, 0>&)
-        : terms(nullptr), nTerms(0)
+template<std::size_t N>
+constexpr VSOPTermTable<N>
+MakeTermTable(const std::array<VSOPTerm, N>& terms)
+{
+    VSOPTermTable<N> table;
+    for (std::size_t i = 0; i < N; i++)
     {
+        table.A[i] = terms[i].A;
+        table.B[i] = terms[i].B;
+        table.C[i] = terms[i].C;
+        table.maxFrequency = std::max(table.maxFrequency, terms[i].C < 0.0 ? -terms[i].C : terms[i].C);
     }
-#endif
 
-    const VSOPTerm* terms;
-    std::size_t nTerms;
+    return table;
+}
+
+template<const auto& Terms>
+constexpr auto termTable = MakeTermTable(Terms);
+
+struct VSOPSeries
+{
+    const double* A{ nullptr };
+    const double* B{ nullptr };
+    const double* C{ nullptr };
+    std::size_t nTerms{ 0 };
+    double maxFrequency{ 0.0 };
 };
 
+template<const auto& Terms>
+constexpr VSOPSeries
+MakeSeries()
+{
+    if constexpr (std::tuple_size_v<std::decay_t<decltype(Terms)>> == 0)
+    {
+        return VSOPSeries{};
+    }
+    else
+    {
+        const auto& table = termTable<Terms>;
+        return VSOPSeries{ table.A.data(), table.B.data(), table.C.data(),
+                           table.A.size(), table.maxFrequency };
+    }
+}
+
 // Terms from the VSOP87 Planetary Theories
 // Bretagnon P., Francou G.
 // Astron. Astrophys. 202, 309 (1988)
@@ -10860,144 +10900,144 @@ constexpr std::array<VSOPTerm, 7> sun_Z2 {
 };
 
 constexpr std::array mercury_L {
-    VSOPSeries(mercury_L0), VSOPSeries(mercury_L1), VSOPSeries(mercury_L2),
-    VSOPSeries(mercury_L3), VSOPSeries(mercury_L4), VSOPSeries(mercury_L5),
+    MakeSeries<mercury_L0>(), MakeSeries<mercury_L1>(), MakeSeries<mercury_L2>(),
+    MakeSeries<mercury_L3>(), MakeSeries<mercury_L4>(), MakeSeries<mercury_L5>(),
 };
 
 constexpr std::array mercury_B {
-    VSOPSeries(mercury_B0), VSOPSeries(mercury_B1), VSOPSeries(mercury_B2),
-    VSOPSeries(mercury_B3), VSOPSeries(mercury_B4), VSOPSeries(mercury_B5),
+    MakeSeries<mercury_B0>(), MakeSeries<mercury_B1>(), MakeSeries<mercury_B2>(),
+    MakeSeries<mercury_B3>(), MakeSeries<mercury_B4>(), MakeSeries<mercury_B5>(),
 };
 
 constexpr std::array mercury_R {
-    VSOPSeries(mercury_R0), VSOPSeries(mercury_R1), VSOPSeries(mercury_R2),
-    VSOPSeries(mercury_R3), VSOPSeries(mercury_R4),
+    MakeSeries<mercury_R0>(), MakeSeries<mercury_R1>(), MakeSeries<mercury_R2>(),
+    MakeSeries<mercury_R3>(), MakeSeries<mercury_R4>(),
 };
 
 
 constexpr std::array venus_L {
-    VSOPSeries(venus_L0), VSOPSeries(venus_L1), VSOPSeries(venus_L2),
-    VSOPSeries(venus_L3), VSOPSeries(venus_L4), VSOPSeries(venus_L5),
+    MakeSeries<venus_L0>(), MakeSeries<venus_L1>(), MakeSeries<venus_L2>(),
+    MakeSeries<venus_L3>(), MakeSeries<venus_L4>(), MakeSeries<venus_L5>(),
 };
 
 constexpr std::array venus_B {
-    VSOPSeries(venus_B0), VSOPSeries(venus_B1), VSOPSeries(venus_B2),
-    VSOPSeries(venus_B3), VSOPSeries(venus_B4), VSOPSeries(venus_B5),
+    MakeSeries<venus_B0>(), MakeSeries<venus_B1>(), MakeSeries<venus_B2>(),
+    MakeSeries<venus_B3>(), MakeSeries<venus_B4>(), MakeSeries<venus_B5>(),
 };
 
 constexpr std::array venus_R {
-    VSOPSeries(venus_R0), VSOPSeries(venus_R1), VSOPSeries(venus_R2),
-    VSOPSeries(venus_R3), VSOPSeries(venus_R4),
+    MakeSeries<venus_R0>(), MakeSeries<venus_R1>(), MakeSeries<venus_R2>(),
+    MakeSeries<venus_R3>(), MakeSeries<venus_R4>(),
 };
 
 
 constexpr std::array earth_L {
-    VSOPSeries(earth_L0), VSOPSeries(earth_L1), VSOPSeries(earth_L2),
-    VSOPSeries(earth_L3), VSOPSeries(earth_L4), VSOPSeries(earth_L5),
+    MakeSeries<earth_L0>(), MakeSeries<earth_L1>(), MakeSeries<earth_L2>(),
+    MakeSeries<earth_L3>(), MakeSeries<earth_L4>(), MakeSeries<earth_L5>(),
 };
 
 constexpr std::array earth_B {
-    VSOPSeries(earth_B0), VSOPSeries(earth_B1), VSOPSeries(earth_B2),
+    MakeSeries<earth_B0>(), MakeSeries<earth_B1>(), MakeSeries<earth_B2>(),
 };
 
 constexpr std::array earth_R {
-    VSOPSeries(earth_R0), VSOPSeries(earth_R1), VSOPSeries(earth_R2),
-    VSOPSeries(earth_R3), VSOPSeries(earth_R4), VSOPSeries(earth_R5),
+    MakeSeries<earth_R0>(), MakeSeries<earth_R1>(), MakeSeries<earth_R2>(),
+    MakeSeries<earth_R3>(), MakeSeries<earth_R4>(), MakeSeries<earth_R5>(),
 };
 
 
 constexpr std::array mars_L {
-    VSOPSeries(mars_L0), VSOPSeries(mars_L1), VSOPSeries(mars_L2),
-    VSOPSeries(mars_L3), VSOPSeries(mars_L4), VSOPSeries(mars_L5),
+    MakeSeries<mars_L0>(), MakeSeries<mars_L1>(), MakeSeries<mars_L2>(),
+    MakeSeries<mars_L3>(), MakeSeries<mars_L4>(), MakeSeries<mars_L5>(),
 };
 
 constexpr std::array mars_B {
-    VSOPSeries(mars_B0), VSOPSeries(mars_B1), VSOPSeries(mars_B2),
-    VSOPSeries(mars_B3), VSOPSeries(mars_B4), VSOPSeries(mars_B5),
+    MakeSeries<mars_B0>(), MakeSeries<mars_B1>(), MakeSeries<mars_B2>(),
+    MakeSeries<mars_B3>(), MakeSeries<mars_B4>(), MakeSeries<mars_B5>(),
 };
 
 constexpr std::array mars_R {
-    VSOPSeries(mars_R0), VSOPSeries(mars_R1), VSOPSeries(mars_R2),
-    VSOPSeries(mars_R3), VSOPSeries(mars_R4), VSOPSeries(mars_R5),
+    MakeSeries<mars_R0>(), MakeSeries<mars_R1>(), MakeSeries<mars_R2>(),
+    MakeSeries<mars_R3>(), MakeSeries<mars_R4>(), MakeSeries<mars_R5>(),
 };
 
 
 constexpr std::array jupiter_L {
-    VSOPSeries(jupiter_L0), VSOPSeries(jupiter_L1), VSOPSeries(jupiter_L2),
-    VSOPSeries(jupiter_L3), VSOPSeries(jupiter_L4), VSOPSeries(jupiter_L5),
+    MakeSeries<jupiter_L0>(), MakeSeries<jupiter_L1>(), MakeSeries<jupiter_L2>(),
+    MakeSeries<jupiter_L3>(), MakeSeries<jupiter_L4>(), MakeSeries<jupiter_L5>(),
 };
 
 constexpr std::array jupiter_B {
-    VSOPSeries(jupiter_B0), VSOPSeries(jupiter_B1), VSOPSeries(jupiter_B2),
-    VSOPSeries(jupiter_B3), VSOPSeries(jupiter_B4), VSOPSeries(jupiter_B5),
+    MakeSeries<jupiter_B0>(), MakeSeries<jupiter_B1>(), MakeSeries<jupiter_B2>(),
+    MakeSeries<jupiter_B3>(), MakeSeries<jupiter_B4>(), MakeSeries<jupiter_B5>(),
 };
 
 constexpr std::array jupiter_R {
-    VSOPSeries(jupiter_R0), VSOPSeries(jupiter_R1), VSOPSeries(jupiter_R2),
-    VSOPSeries(jupiter_R3), VSOPSeries(jupiter_R4), VSOPSeries(jupiter_R5),
+    MakeSeries<jupiter_R0>(), MakeSeries<jupiter_R1>(), MakeSeries<jupiter_R2>(),
+    MakeSeries<jupiter_R3>(), MakeSeries<jupiter_R4>(), MakeSeries<jupiter_R5>(),
 };
 
 
 constexpr std::array saturn_L {
-    VSOPSeries(saturn_L0), VSOPSeries(saturn_L1), VSOPSeries(saturn_L2),
-    VSOPSeries(saturn_L3), VSOPSeries(saturn_L4), VSOPSeries(saturn_L5),
+    MakeSeries<saturn_L0>(), MakeSeries<saturn_L1>(), MakeSeries<saturn_L2>(),
+    MakeSeries<saturn_L3>(), MakeSeries<saturn_L4>(), MakeSeries<saturn_L5>(),
 };
 
 constexpr std::array saturn_B {
-    VSOPSeries(saturn_B0), VSOPSeries(saturn_B1), VSOPSeries(saturn_B2),
-    VSOPSeries(saturn_B3), VSOPSeries(saturn_B4), VSOPSeries(saturn_B5),
+    MakeSeries<saturn_B0>(), MakeSeries<saturn_B1>(), MakeSeries<saturn_B2>(),
+    MakeSeries<saturn_B3>(), MakeSeries<saturn_B4>(), MakeSeries<saturn_B5>(),
 };
 
 constexpr std::array saturn_R {
-    VSOPSeries(saturn_R0), VSOPSeries(saturn_R1), VSOPSeries(saturn_R2),
-    VSOPSeries(saturn_R3), VSOPSeries(saturn_R4), VSOPSeries(saturn_R5),
+    MakeSeries<saturn_R0>(), MakeSeries<saturn_R1>(), MakeSeries<saturn_R2>(),
+    MakeSeries<saturn_R3>(), MakeSeries<saturn_R4>(), MakeSeries<saturn_R5>(),
 };
 
 
 constexpr std::array uranus_L {
-    VSOPSeries(uranus_L0), VSOPSeries(uranus_L1), VSOPSeries(uranus_L2),
-    VSOPSeries(uranus_L3), VSOPSeries(uranus_L4),
+    MakeSeries<uranus_L0>(), MakeSeries<uranus_L1>(), MakeSeries<uranus_L2>(),
+    MakeSeries<uranus_L3>(), MakeSeries<uranus_L4>(),
 };
 
 constexpr std::array uranus_B {
-    VSOPSeries(uranus_B0), VSOPSeries(uranus_B1), VSOPSeries(uranus_B2),
-    VSOPSeries(uranus_B3),
+    MakeSeries<uranus_B0>(), MakeSeries<uranus_B1>(), MakeSeries<uranus_B2>(),
+    MakeSeries<uranus_B3>(),
 };
 
 constexpr std::array uranus_R {
-    VSOPSeries(uranus_R0), VSOPSeries(uranus_R1), VSOPSeries(uranus_R2),
-    VSOPSeries(uranus_R3), VSOPSeries(uranus_R4),
+    MakeSeries<uranus_R0>(), MakeSeries<uranus_R1>(), MakeSeries<uranus_R2>(),
+    MakeSeries<uranus_R3>(), MakeSeries<uranus_R4>(),
 };
 
 
 constexpr std::array neptune_L {
-    VSOPSeries(neptune_L0), VSOPSeries(neptune_L1), VSOPSeries(neptune_L2),
-    VSOPSeries(neptune_L3),
+    MakeSeries<neptune_L0>(), MakeSeries<neptune_L1>(), MakeSeries<neptune_L2>(),
+    MakeSeries<neptune_L3>(),
 };
 
 constexpr std::array neptune_B {
-    VSOPSeries(neptune_B0), VSOPSeries(neptune_B1), VSOPSeries(neptune_B2),
-    VSOPSeries(neptune_B3),
+    MakeSeries<neptune_B0>(), MakeSeries<neptune_B1>(), MakeSeries<neptune_B2>(),
+    MakeSeries<neptune_B3>(),
 };
 
 constexpr std::array neptune_R {
-    VSOPSeries(neptune_R0), VSOPSeries(neptune_R1), VSOPSeries(neptune_R2),
-    VSOPSeries(neptune_R3), VSOPSeries(neptune_R4),
+    MakeSeries<neptune_R0>(), MakeSeries<neptune_R1>(), MakeSeries<neptune_R2>(),
+    MakeSeries<neptune_R3>(), MakeSeries<neptune_R4>(),
 };
 
 
 constexpr std::array sun_X {
-    VSOPSeries(sun_X0), VSOPSeries(sun_X1), VSOPSeries(sun_X2),
-    VSOPSeries(sun_X3), VSOPSeries(sun_X4),
+    MakeSeries<sun_X0>(), MakeSeries<sun_X1>(), MakeSeries<sun_X2>(),
+    MakeSeries<sun_X3>(), MakeSeries<sun_X4>(),
 };
 
 constexpr std::array sun_Y {
-    VSOPSeries(sun_Y0), VSOPSeries(sun_Y1), VSOPSeries(sun_Y2),
-    VSOPSeries(sun_Y3), VSOPSeries(sun_Y4),
+    MakeSeries<sun_Y0>(), MakeSeries<sun_Y1>(), MakeSeries<sun_Y2>(),
+    MakeSeries<sun_Y3>(), MakeSeries<sun_Y4>(),
 };
 
 constexpr std::array sun_Z {
-    VSOPSeries(sun_Z0), VSOPSeries(sun_Z1), VSOPSeries(sun_Z2),
+    MakeSeries<sun_Z0>(), MakeSeries<sun_Z1>(), MakeSeries<sun_Z2>(),
 };
 
 
@@ -11007,10 +11047,13 @@ SumSeries(const VSOPSeries& series, double t)
     if (series.nTerms < 1)
         return 0.0;
 
+    // The phases B are in [0, 2*pi)
+    if (2.0 * celestia::numbers::pi + series.maxFrequency * std::abs(t) <= math::CosineSumMaxArgument)
+        return math::SumCosines(series.A, series.B, series.C, series.nTerms, t);
+
     double x = 0.0;
-    const VSOPTerm* term = &series.terms[0];
-    for (std::size_t i = 0; i < series.nTerms; i++, term++)
-        x += term->A * std::cos(term->B + term->C * t);
+    for (std::size_t i = 0; i < series.nTerms; i++)
+        x += series.A[i] * std::cos(series.B[i] + series.C[i] * t);
 
     return x;
 }
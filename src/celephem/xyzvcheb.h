@@ -0,0 +1,55 @@
+// xyzvcheb.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace celestia::ephem
+{
+
+// Layout of a Chebyshev trajectory file, in native byte order:
+//
+// XYZVChebyshevHeader
+// double segmentTimes[segmentCount + 1]
+// double coefficients[segmentCount][3][coefficientCount]
+//
+// The segment times are TDB Julian dates in increasing order, segment i
+// spans segmentTimes[i] to segmentTimes[i + 1]. The coefficients of each
+// segment are those of the x, y and z coordinates in kilometers, in the
+// same frame as xyzv files, with the time of the segment mapped to [-1, 1].
+// All sections start at a multiple of 8 bytes, so the file can be used in
+// place once it has been mapped into memory.
+
+#pragma pack(push, 1)
+struct XYZVChebyshevHeader
+{
+    XYZVChebyshevHeader() = delete;
+
+    char magic[8];
+    std::uint16_t byteOrder;
+    std::uint16_t digits;
+    std::uint16_t coefficientCount;
+    std::uint16_t reserved;
+    std::uint64_t segmentCount;
+    double boundingRadius;
+};
+#pragma pack(pop)
+
+static_assert(std::is_standard_layout_v<XYZVChebyshevHeader>);
+static_assert(sizeof(XYZVChebyshevHeader) % sizeof(double) == 0);
+
+constexpr inline std::string_view XYZV_CHEBYSHEV_MAGIC{ "CELXYZC\0", 8 };
+static_assert(XYZV_CHEBYSHEV_MAGIC.size() == sizeof(XYZVChebyshevHeader::magic));
+
+constexpr inline std::uint16_t XYZV_CHEBYSHEV_MAX_COEFFICIENTS = 32;
+
+}
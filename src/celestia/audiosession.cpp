@@ -3,12 +3,23 @@
 namespace celestia
 {
 
-AudioSession::AudioSession(const fs::path &path, float volume, float pan, bool loop, bool nopause) : m_volume(volume), m_pan(pan), m_loop(loop), m_nopause(nopause)
+namespace
 {
-    if (path.is_relative())
-        m_path = "sounds" / path;
-    else
-        m_path = path;
+
+fs::path resolvePath(const fs::path &path)
+{
+    return path.is_relative() ? "sounds" / path : path;
+}
+
+}
+
+AudioSession::AudioSession(const fs::path &path, float volume, float pan, bool loop, bool nopause) : m_path(resolvePath(path)), m_volume(volume), m_pan(pan), m_loop(loop), m_nopause(nopause)
+{
+}
+
+bool AudioSession::playsFile(const fs::path &path) const
+{
+    return m_path == resolvePath(path);
 }
 
 void AudioSession::setVolume(float volume)
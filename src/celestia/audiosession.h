@@ -26,6 +26,9 @@ class AudioSession
     AudioSession &operator=(AudioSession&&) = delete;
 
     virtual ~AudioSession() = default;
+    // Open the file and start decoding it in the background, so that a
+    // later call to play doesn't wait for it
+    virtual bool preload() = 0;
     virtual bool play(double startTime = -1.0) = 0;
     virtual bool isPlaying() const = 0;
     virtual void stop() = 0;
@@ -37,6 +40,8 @@ class AudioSession
     void setNoPause(bool nopause);
 
     bool nopause() const { return m_nopause; }
+    // Whether the session plays the file which would be opened for path
+    bool playsFile(const fs::path &path) const;
 
  protected:
     fs::path path() const { return m_path; }
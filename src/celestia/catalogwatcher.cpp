@@ -0,0 +1,178 @@
+// catalogwatcher.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reloads the add-on catalogs which change while Celestia runs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "catalogwatcher.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <celengine/body.h>
+#include <celengine/location.h>
+#include <celengine/selection.h>
+#include <celengine/universe.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+bool
+isWithin(const Body* body, const Body* ancestor)
+{
+    for (; body != nullptr; body = body->getSystem()->getPrimaryBody())
+    {
+        if (body == ancestor)
+            return true;
+    }
+
+    return false;
+}
+
+} // end unnamed namespace
+
+
+void
+CatalogWatcher::addSolarSystemCatalog(const fs::path& path,
+                                      const fs::path& directory,
+                                      SolarSystemCatalogObjects&& objects)
+{
+    files.push_back(WatchedFile{ path, directory, true, getStamp(path), std::nullopt, std::move(objects) });
+}
+
+
+void
+CatalogWatcher::addCatalog(const fs::path& path)
+{
+    files.push_back(WatchedFile{ path, fs::path(), false, getStamp(path), std::nullopt, {} });
+}
+
+
+bool
+CatalogWatcher::update(double time, Universe& universe, const RemovingCallback& removing)
+{
+    if (lastCheck.has_value() && time - *lastCheck < CheckInterval)
+        return false;
+    lastCheck = time;
+
+    bool reloaded = false;
+    for (WatchedFile& file : files)
+    {
+        std::optional<Stamp> stamp = getStamp(file.path);
+        if (!stamp.has_value() || stamp == file.loaded)
+        {
+            file.pending = std::nullopt;
+            continue;
+        }
+
+        // Wait for the next check to see whether the file is still changing
+        if (stamp != file.pending)
+        {
+            file.pending = stamp;
+            continue;
+        }
+
+        file.loaded = stamp;
+        file.pending = std::nullopt;
+        if (!file.isSolarSystem)
+        {
+            GetLogger()->warn(_("Catalog {} has changed, restart to load it again.\n"), file.path);
+            continue;
+        }
+
+        reloaded |= reload(file, universe, removing);
+    }
+
+    return reloaded;
+}
+
+
+bool
+CatalogWatcher::isRemovedWith(const Selection& sel, const Selection& removed)
+{
+    if (removed.location() != nullptr)
+        return sel.location() == removed.location();
+
+    const Body* body = removed.body();
+    if (body == nullptr)
+        return false;
+    if (sel.location() != nullptr)
+        return isWithin(sel.location()->getParentBody(), body);
+    return isWithin(sel.body(), body);
+}
+
+
+std::optional<CatalogWatcher::Stamp>
+CatalogWatcher::getStamp(const fs::path& path)
+{
+    std::error_code ec;
+    Stamp stamp;
+    stamp.size = fs::file_size(path, ec);
+    if (ec)
+        return std::nullopt;
+    stamp.writeTime = fs::last_write_time(path, ec);
+    if (ec)
+        return std::nullopt;
+    return stamp;
+}
+
+
+bool
+CatalogWatcher::reload(WatchedFile& file, Universe& universe, const RemovingCallback& removing)
+{
+    std::ifstream in(file.path, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error(_("Error opening solar system catalog {}.\n"), file.path);
+        return false;
+    }
+
+    std::string text(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>{});
+
+    GetLogger()->info(_("Reloading solar system catalog: {}\n"), file.path);
+    ReloadSolarSystemObjects(text, universe, file.directory, file.objects,
+                             [this, &removing](const Selection& removed)
+                             {
+                                 removing(removed);
+                                 forget(removed);
+                             });
+    return true;
+}
+
+
+// The objects removed with a body may have been added by any catalog,
+// including the one being loaded
+void
+CatalogWatcher::forget(const Selection& removed)
+{
+    for (WatchedFile& file : files)
+    {
+        auto& bodies = file.objects.bodies;
+        bodies.erase(std::remove_if(bodies.begin(), bodies.end(),
+                                    [&removed](Body* body) { return isRemovedWith(Selection(body), removed); }),
+                     bodies.end());
+
+        auto& locations = file.objects.locations;
+        locations.erase(std::remove_if(locations.begin(), locations.end(),
+                                       [&removed](Location* location) { return isRemovedWith(Selection(location), removed); }),
+                        locations.end());
+    }
+}
+
+} // end namespace celestia
@@ -0,0 +1,93 @@
+// catalogwatcher.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reloads the add-on catalogs which change while Celestia runs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/solarsys.h>
+
+class Selection;
+class Universe;
+
+namespace celestia
+{
+
+/*! Watches the catalogs of the add-ons loaded at startup. A solar system
+ *  catalog which changes is loaded again on its own: the bodies it still
+ *  defines are redefined in place and the others are removed, so that the
+ *  rest of the universe is untouched. Star and deep sky catalogs are built
+ *  into databases which can't be changed in place, so their changes are
+ *  only reported.
+ *
+ *  Files are checked at most once per check interval, and a change is only
+ *  loaded once the size and modification time of the file are the same on
+ *  two checks, so that files being written aren't loaded.
+ */
+class CatalogWatcher
+{
+public:
+    // Called before an object is removed, to drop the references to it
+    using RemovingCallback = std::function<void(const Selection&)>;
+
+    static constexpr double CheckInterval = 1.0;
+
+    void addSolarSystemCatalog(const fs::path& path,
+                               const fs::path& directory,
+                               SolarSystemCatalogObjects&& objects);
+    void addCatalog(const fs::path& path);
+
+    // Check the files if the interval has elapsed since the last check at
+    // time, in seconds, and return true if a catalog was loaded again
+    bool update(double time, Universe& universe, const RemovingCallback& removing);
+
+    // True if sel is the removed object or one of its satellites or
+    // locations, which are removed with it
+    static bool isRemovedWith(const Selection& sel, const Selection& removed);
+
+private:
+    struct Stamp
+    {
+        std::uintmax_t size;
+        fs::file_time_type writeTime;
+
+        bool operator==(const Stamp& other) const
+        {
+            return size == other.size && writeTime == other.writeTime;
+        }
+
+        bool operator!=(const Stamp& other) const { return !(*this == other); }
+    };
+
+    struct WatchedFile
+    {
+        fs::path path;
+        fs::path directory;
+        bool isSolarSystem;
+        std::optional<Stamp> loaded;
+        std::optional<Stamp> pending;
+        SolarSystemCatalogObjects objects;
+    };
+
+    static std::optional<Stamp> getStamp(const fs::path& path);
+
+    bool reload(WatchedFile& file, Universe& universe, const RemovingCallback& removing);
+    void forget(const Selection& removed);
+
+    std::vector<WatchedFile> files;
+    std::optional<double> lastCheck;
+};
+
+} // end namespace celestia
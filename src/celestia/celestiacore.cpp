@@ -14,8 +14,12 @@
 // of the License, or (at your option) any later version.
 
 #include "celestiacore.h"
+#include "catalogwatcher.h"
+#include "clusterframe.h"
 #include "favorites.h"
+#include "startupprofile.h"
 #include "textprintposition.h"
+#include "tickthread.h"
 #include "url.h"
 #include "viewmanager.h"
 #include <celastro/astro.h>
@@ -25,6 +29,7 @@
 #include <celengine/body.h>
 #include <celengine/boundaries.h>
 #include <celengine/dsoname.h>
+#include <celengine/galaxyform.h>
 #include <celengine/location.h>
 #include <celengine/overlay.h>
 #include <celengine/console.h>
@@ -33,13 +38,18 @@
 #include <celscript/legacy/execution.h>
 #include <celscript/legacy/cmdparser.h>
 #include <celengine/multitexture.h>
+#include <celephem/customorbit.h>
 #ifdef USE_SPICE
 #include <celephem/spiceinterface.h>
 #endif
 #include <celengine/axisarrow.h>
 #include <celengine/planetgrid.h>
 #include <celengine/visibleregion.h>
+#include <celengine/dynamicresolution.h>
 #include <celengine/framebuffer.h>
+#include <celengine/frameprofiler.h>
+#include <celengine/glsupport.h>
+#include <celengine/domeprojectionmode.h>
 #include <celengine/fisheyeprojectionmode.h>
 #include <celengine/perspectiveprojectionmode.h>
 #include <celmath/geomutil.h>
@@ -47,13 +57,22 @@
 #include <celutil/filetype.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/orderedprefetch.h>
 #include <celutil/gettext.h>
+#include <celutil/stringutils.h>
+#include <celutil/taskscheduler.h>
 #include <celutil/utf8.h>
 #include <celcompat/filesystem.h>
 #include <Eigen/Geometry>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string_view>
 #include <algorithm>
 #include <cstddef>
 #include <cstdlib>
@@ -65,6 +84,8 @@
 #include <set>
 #include <celengine/rectangle.h>
 #include <celengine/mapmanager.h>
+#include <celengine/meshmanager.h>
+#include <celengine/texmanager.h>
 #include <fmt/ostream.h>
 #ifdef USE_MINIAUDIO
 #include "miniaudiosession.h"
@@ -114,6 +135,145 @@ bool is_valid_directory(const fs::path& dir)
     return true;
 }
 
+// Collect the catalog files of one content type in the extras directories,
+// in the order in which they are loaded: directories in the configured order
+// and files sorted by path within each directory.
+std::vector<fs::path> findExtrasCatalogs(const std::vector<fs::path>& extrasDirs,
+                                         ContentType contentType,
+                                         std::string_view typeDesc,
+                                         const std::vector<fs::path>& skip)
+{
+    std::vector<fs::path> catalogs;
+    std::vector<fs::path> entries;
+    for (const auto& dir : extrasDirs)
+    {
+        if (!is_valid_directory(dir))
+            continue;
+
+        entries.clear();
+        std::error_code ec;
+        auto iter = fs::recursive_directory_iterator(dir, ec);
+        for (; iter != end(iter); iter.increment(ec))
+        {
+            if (ec)
+                continue;
+            if (!fs::is_directory(iter->path(), ec))
+                entries.push_back(iter->path());
+        }
+        std::sort(begin(entries), end(entries));
+
+        for (auto& fn : entries)
+        {
+            if (DetermineFileType(fn) != contentType)
+                continue;
+
+            if (find(begin(skip), end(skip), fn) != end(skip))
+            {
+                GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, fn);
+                continue;
+            }
+            catalogs.push_back(std::move(fn));
+        }
+    }
+
+    return catalogs;
+}
+
+// Count the bodies in a planetary system and their satellites
+std::uint64_t countBodies(const PlanetarySystem* system)
+{
+    if (system == nullptr)
+        return 0;
+
+    std::uint64_t count = 0;
+    for (int i = 0; i < system->getSystemSize(); ++i)
+    {
+        ++count;
+        count += countBodies(system->getBody(i)->getSatellites());
+    }
+
+    return count;
+}
+
+// The text of a catalog file, mapped into memory so that the tokenizer
+// works on it in place. Files which can't be mapped, such as empty ones,
+// are read instead.
+class CatalogFile
+{
+ public:
+    static std::optional<CatalogFile> read(const fs::path& path);
+
+    std::string_view getText() const;
+
+ private:
+    std::optional<celestia::util::MappedFile> mappedFile;
+    std::string contents;
+};
+
+// Map a catalog file and start reading it in the background, so that
+// catalogs can be read ahead on worker threads while an earlier one is
+// being loaded.
+std::optional<CatalogFile> CatalogFile::read(const fs::path& path)
+{
+    CatalogFile file;
+    file.mappedFile = celestia::util::MappedFile::open(path);
+    if (file.mappedFile.has_value())
+    {
+        file.mappedFile->adviseWillNeed();
+        return file;
+    }
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return std::nullopt;
+
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    file.contents = contents.str();
+    return file;
+}
+
+std::string_view CatalogFile::getText() const
+{
+    if (mappedFile.has_value())
+        return std::string_view(mappedFile->data(), mappedFile->size());
+    return contents;
+}
+
+// A solar system catalog parsed ahead, or the contents of a binary or
+// large one
+struct SolarSystemCatalogFile
+{
+    void load(Universe& universe, const fs::path& dir, SolarSystemCatalogObjects* objects = nullptr);
+
+    std::optional<CatalogFile> file;
+    ParsedSolarSystemCatalog parsed;
+};
+
+void SolarSystemCatalogFile::load(Universe& universe, const fs::path& dir, SolarSystemCatalogObjects* objects)
+{
+    if (file.has_value())
+        LoadSolarSystemObjects(file->getText(), universe, dir, objects);
+    else
+        LoadSolarSystemObjects(std::move(parsed), universe, dir, objects);
+}
+
+// Solar system catalogs are parsed ahead unless they're binary or large
+// enough to be parsed in parallel chunks while they're loaded
+std::optional<SolarSystemCatalogFile> ReadSolarSystemCatalogFile(const fs::path& path)
+{
+    std::optional<SolarSystemCatalogFile> catalog;
+    if (auto file = CatalogFile::read(path); file.has_value())
+    {
+        catalog.emplace();
+        if (file->getText().size() > SolarSystemCatalogChunkSize || IsBinarySolarSystemCatalog(file->getText()))
+            catalog->file = std::move(file);
+        else
+            catalog->parsed = ParseSolarSystemObjects(file->getText());
+    }
+    return catalog;
+}
+
 bool ReadLeapSecondsFile(const fs::path& path, std::vector<astro::LeapSecondRecord> &leapSeconds)
 {
     std::ifstream file(path);
@@ -151,6 +311,22 @@ bool ReadLeapSecondsFile(const fs::path& path, std::vector<astro::LeapSecondReco
 }
 }
 
+// The add-on solar system catalogs left to load after startup, read and
+// parsed ahead on a worker. One at a time, so as not to hold up the
+// catalogs loaded at startup.
+struct CelestiaCore::PendingCatalogs
+{
+    explicit PendingCatalogs(std::vector<fs::path>&& _files) :
+        files(std::move(_files)),
+        prefetch(files.size(), [this](std::size_t i) { return ReadSolarSystemCatalogFile(files[i]); }, 1)
+    {
+    }
+
+    std::vector<fs::path> files;
+    OrderedPrefetch<std::optional<SolarSystemCatalogFile>> prefetch;
+    std::size_t loaded{ 0 };
+};
+
 // If right dragging to rotate, adjust the rotation rate based on the
 // distance from the reference object.  This makes right drag rotation
 // useful even when the camera is very near the surface of an object.
@@ -196,7 +372,10 @@ CelestiaCore::CelestiaCore() :
     m_tee(std::cout, std::cerr)
 {
 
-    CreateLogger();
+    // Log messages are written on a background thread, so that catalogs
+    // with many warnings don't load slowly, and the warnings repeated most
+    // are limited
+    CreateLogger()->setAsynchronous(true);
 
     for (int i = 0; i < KeyCount; i++)
     {
@@ -213,8 +392,10 @@ CelestiaCore::CelestiaCore() :
 
 CelestiaCore::~CelestiaCore()
 {
-    if (movieCapture != nullptr)
-        recordEnd();
+    // Finish the last tick before the renderer goes away
+    tickThread = nullptr;
+
+    finishMovieCapture();
 
     delete timer;
     delete renderer;
@@ -405,6 +586,7 @@ static bool checkMask(int modifiers, int mask)
 
 void CelestiaCore::mouseButtonDown(float x, float y, int button)
 {
+    framePacer.requestFrame();
     mouseMotion = 0.0f;
 
 #ifdef CELX
@@ -429,6 +611,7 @@ void CelestiaCore::mouseButtonDown(float x, float y, int button)
 
 void CelestiaCore::mouseButtonUp(float x, float y, int button)
 {
+    framePacer.requestFrame();
     // Four pixel tolerance for picking
     float obsPickTolerance = sim->getActiveObserver()->getFOV() / static_cast<float>(metrics.height) * this->pickTolerance;
 
@@ -462,7 +645,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
                                                        pickX, pickY);
             pickX *= aspectRatio;
             if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
+                getActiveViewportEffect()->distortXY(pickX, pickY);
 
             Vector3f pickRay = renderer->getProjectionMode()->getPickRay(pickX, pickY, viewManager->activeView()->getObserver()->getZoom());
 
@@ -482,7 +665,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
                                                        pickX, pickY);
             pickX *= aspectRatio;
             if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
+                getActiveViewportEffect()->distortXY(pickX, pickY);
 
             Vector3f pickRay = renderer->getProjectionMode()->getPickRay(pickX, pickY, viewManager->activeView()->getObserver()->getZoom());
 
@@ -517,6 +700,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
 
 void CelestiaCore::mouseWheel(float motion, int modifiers)
 {
+    framePacer.requestFrame();
     if (config->mouse.reverseWheel) motion = -motion;
     if (motion != 0.0)
     {
@@ -538,6 +722,7 @@ void CelestiaCore::mouseWheel(float motion, int modifiers)
 /// x and y are the pixel coordinates relative to the widget.
 void CelestiaCore::mouseMove(float x, float y)
 {
+    framePacer.requestFrame();
     if (m_scriptHook != nullptr && m_scriptHook->call("mousemove", x, y))
         return;
 
@@ -560,6 +745,7 @@ void CelestiaCore::mouseMove(float x, float y)
 
 void CelestiaCore::mouseMove(float dx, float dy, int modifiers)
 {
+    framePacer.requestFrame();
     if (viewManager->resizeViews(metrics, dx, dy))
     {
         setFOVFromZoom();
@@ -682,6 +868,7 @@ void CelestiaCore::mouseMove(float dx, float dy, int modifiers)
 
 void CelestiaCore::joystickAxis(int axis, float amount)
 {
+    framePacer.requestFrame();
     float deadZone = 0.25f;
 
     if (abs(amount) < deadZone)
@@ -700,6 +887,7 @@ void CelestiaCore::joystickAxis(int axis, float amount)
 
 void CelestiaCore::joystickButton(int button, bool down)
 {
+    framePacer.requestFrame();
     if (button >= 0 && button < JoyButtonCount)
         joyButtonsPressed[button] = down;
 }
@@ -707,6 +895,7 @@ void CelestiaCore::joystickButton(int button, bool down)
 
 void CelestiaCore::keyDown(int key, int modifiers)
 {
+    framePacer.requestFrame();
     if (m_scriptHook != nullptr && m_scriptHook->call("keydown", float(key), float(modifiers)))
         return;
 
@@ -797,6 +986,7 @@ void CelestiaCore::keyDown(int key, int modifiers)
 
 void CelestiaCore::keyUp(int key, int)
 {
+    framePacer.requestFrame();
     KeyAccel = 1.0;
     if (std::islower(key))
         key = std::toupper(key);
@@ -832,6 +1022,7 @@ void CelestiaCore::charEntered(char c, int modifiers)
 
 void CelestiaCore::charEntered(const char *c_p, int modifiers)
 {
+    framePacer.requestFrame();
     Observer* observer = sim->getActiveObserver();
 
     char c = *c_p;
@@ -1914,10 +2105,110 @@ void CelestiaCore::tick(double dt)
 }
 
 
-void CelestiaCore::draw()
+void CelestiaCore::setThreadedTick(bool threaded)
+{
+    if (!threaded)
+        tickThread = nullptr;
+    else if (tickThread == nullptr)
+        tickThread = std::make_unique<TickThread>();
+}
+
+bool CelestiaCore::getThreadedTick() const
+{
+    return tickThread != nullptr;
+}
+
+void CelestiaCore::tickAsync()
 {
-    if (!viewUpdateRequired())
+    double dt = timer->getTime() - sysTime;
+    if (tickThread == nullptr)
+    {
+        tick(dt);
         return;
+    }
+
+    tickThread->finish();
+    tickThread->start([this, dt] { tick(dt); });
+}
+
+// Load the add-on solar system catalogs which are ready, for at most
+// PendingCatalogTime per frame, until all of them are loaded
+void CelestiaCore::loadPendingCatalogs()
+{
+    constexpr double PendingCatalogTime = 0.005;
+
+    double startTime = timer->getTime();
+    auto& prefetch = pendingCatalogs->prefetch;
+    while (prefetch.nextReady() && timer->getTime() - startTime < PendingCatalogTime)
+    {
+        const fs::path& file = pendingCatalogs->files[pendingCatalogs->loaded++];
+        GetLogger()->info(_("Loading solar system catalog: {}\n"), file);
+        auto catalog = prefetch.next();
+        if (catalog.has_value())
+        {
+            SolarSystemCatalogObjects objects;
+            catalog->load(*universe, file.parent_path(), &objects);
+            catalogWatcher->addSolarSystemCatalog(file, file.parent_path(), std::move(objects));
+        }
+    }
+
+    if (prefetch.done())
+    {
+        GetLogger()->info("Loaded {} add-on solar system catalogs after startup\n", pendingCatalogs->files.size());
+        pendingCatalogs = nullptr;
+    }
+
+    // Keep frames coming until the last catalog is loaded
+    framePacer.requestFrame();
+}
+
+void CelestiaCore::finishTick()
+{
+    if (tickThread != nullptr)
+        tickThread->finish();
+}
+
+void CelestiaCore::callOnRenderThread(const std::function<void()>& call) const
+{
+    if (tickThread != nullptr)
+        tickThread->callOnRenderThread(call);
+    else
+        call();
+}
+
+
+void CelestiaCore::draw()
+{
+    finishTick();
+
+    // Catalogs are loaded again between ticks, as they may remove objects
+    if (catalogWatcher != nullptr &&
+        catalogWatcher->update(sysTime, *universe, [this](const Selection& removed) { dropReferences(removed); }))
+    {
+        framePacer.requestFrame();
+    }
+
+    if (pendingCatalogs != nullptr)
+        loadPendingCatalogs();
+
+    if (movieCaptureEnding)
+        finishMovieCapture();
+
+    // The frontend may have used the context since the last frame
+    gl::invalidateState();
+
+    celestia::FramePacer::State frameState = getFrameState();
+    framePacer.frameRendered(frameState, timeInfo.currentTime,
+                             framePacer.evaluate(frameState, timeInfo.currentTime));
+
+    // Unload the least recently used textures and models when over budget.
+    // This is done once for all views so that they don't evict each
+    // other's resources.
+    GetTextureManager()->nextFrame();
+    GetGeometryManager()->nextFrame();
+
+    // Finish the work of background tasks which needs the GL context
+    celestia::util::TaskScheduler::get().runMainThreadTasks(config->renderDetails.textureUploadTime / 1000.0);
 
     // Render each view
     for (const auto view : viewManager->views())
@@ -1945,6 +2236,9 @@ void CelestiaCore::draw()
     if (toggleAA)
         renderer->enableMSAA();
 
+    if (dynamicResolution != nullptr)
+        dynamicResolution->update(renderer->getFrameProfiler());
+
     if (movieCapture != nullptr && recording)
         movieCapture->captureFrame();
 
@@ -1961,6 +2255,7 @@ void CelestiaCore::draw()
 
 void CelestiaCore::resize(GLsizei w, GLsizei h)
 {
+    framePacer.requestFrame();
     if (h == 0)
         h = 1;
 
@@ -1985,34 +2280,65 @@ void CelestiaCore::draw(View* view)
 
     bool viewportEffectUsed = false;
 
+    ViewportEffect* effect = getActiveViewportEffect();
     FramebufferObject *fbo = nullptr;
-    if (viewportEffect != nullptr)
+    if (effect != nullptr)
     {
         // create/update FBO for viewport effect
         view->updateFBO(metrics.width, metrics.height);
         fbo = view->getFBO();
     }
-    bool process = fbo != nullptr && viewportEffect->preprocess(renderer, fbo);
+    bool process = fbo != nullptr && effect->preprocess(renderer, fbo);
 
     auto x = static_cast<int>(view->x * static_cast<float>(metrics.width));
     auto y = static_cast<int>(view->y * static_cast<float>(metrics.height));
     auto viewWidth = static_cast<int>(view->width * static_cast<float>(metrics.width));
     auto viewHeight = static_cast<int>(view->height * static_cast<float>(metrics.height));
+
+    // With dynamic resolution the scene is drawn to a corner of the FBO
+    // and scaled up by the effect. The DPI is scaled with it so that
+    // sizes in pixels stay the same on the screen.
+    float scale = process && dynamicResolution != nullptr ? dynamicResolution->getScale() : 1.0f;
+    effect = process ? effect : nullptr;
+    if (effect != nullptr)
+        effect->setSourceScale(scale);
+    int screenDpi = renderer->getScreenDpi();
+    if (scale != 1.0f)
+    {
+        renderer->setScreenDpi(std::max(1, static_cast<int>(static_cast<float>(screenDpi) * scale + 0.5f)));
+        viewWidth = std::max(1, static_cast<int>(static_cast<float>(viewWidth) * scale));
+        viewHeight = std::max(1, static_cast<int>(static_cast<float>(viewHeight) * scale));
+    }
+
     // If we need to process, we draw to the FBO which starts at point zero
     renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, viewWidth, viewHeight, !view->isRootView());
 
-    if (view->isRootView())
-        sim->render(*renderer);
-    else
-        sim->render(*renderer, *view->observer);
+    int passCount = effect != nullptr ? effect->getPassCount() : 1;
+    for (int pass = 0; pass < passCount; ++pass)
+    {
+        if (effect != nullptr && !effect->beginPass(renderer, pass))
+            continue;
+
+        if (view->isRootView())
+            sim->render(*renderer);
+        else
+            sim->render(*renderer, *view->observer);
+    }
+
+    if (scale != 1.0f)
+    {
+        renderer->setScreenDpi(screenDpi);
+        viewWidth = static_cast<int>(view->width * static_cast<float>(metrics.width));
+        viewHeight = static_cast<int>(view->height * static_cast<float>(metrics.height));
+    }
 
     // Viewport need to be reset to start from (x,y) instead of point zero
-    if (process && (x != 0 || y != 0))
+    if (process && (x != 0 || y != 0 || scale != 1.0f || passCount > 1))
         renderer->setRenderRegion(x, y, viewWidth, viewHeight);
 
-    if (process && viewportEffect->prerender(renderer, fbo))
+    if (process && effect->prerender(renderer, fbo))
     {
-        if (viewportEffect->render(renderer, fbo, viewWidth, viewHeight))
+        if (effect->render(renderer, fbo, viewWidth, viewHeight))
             viewportEffectUsed = true;
         else
             GetLogger()->error("Unable to render viewport effect.\n");
@@ -2020,6 +2346,51 @@ void CelestiaCore::draw(View* view)
     isViewportEffectUsed = viewportEffectUsed;
 }
 
+// The configured viewport effect, or the passthrough effect needed to
+// scale up the scene when dynamic resolution or antialiasing is on
+ViewportEffect* CelestiaCore::getActiveViewportEffect() const
+{
+    if (viewportEffect != nullptr)
+        return viewportEffect.get();
+    if (dynamicResolution != nullptr || config->renderDetails.postProcessAntialiasing)
+        return dynamicResolutionEffect.get();
+    return nullptr;
+}
+
+void CelestiaCore::setDynamicResolution(bool enable)
+{
+    if (enable == (dynamicResolution != nullptr))
+        return;
+
+    if (enable)
+    {
+        dynamicResolution = std::make_unique<celestia::engine::DynamicResolution>();
+        dynamicResolution->setTargetFrameTime(config->renderDetails.targetFrameTime);
+        dynamicResolution->setMinScale(config->renderDetails.minResolutionScale);
+        if (dynamicResolutionEffect == nullptr)
+            dynamicResolutionEffect = std::make_unique<PassthroughViewportEffect>();
+        // The scale follows the times measured by the profiler
+        renderer->getFrameProfiler().setEnabled(true);
+    }
+    else
+    {
+        dynamicResolution = nullptr;
+        if (config->paths.frameProfileFile.empty() && !config->renderDetails.autoTextureResolution)
+            renderer->getFrameProfiler().setEnabled(false);
+    }
+    framePacer.requestFrame();
+}
+
+bool CelestiaCore::getDynamicResolution() const
+{
+    return dynamicResolution != nullptr;
+}
+
+celestia::engine::DynamicResolution* CelestiaCore::getDynamicResolutionControl() const
+{
+    return dynamicResolution.get();
+}
+
 void CelestiaCore::setSafeAreaInsets(int left, int top, int right, int bottom)
 {
     metrics.insetLeft = left;
@@ -2052,44 +2423,62 @@ void CelestiaCore::setDecelerationCoefficient(float coefficient)
 // can skip rendering, keep the GPU idle, and save power.
 bool CelestiaCore::viewUpdateRequired() const
 {
-#if 1
-    // Enable after 1.5.0
-    return true;
-#else
-    bool isPaused = sim->getPauseState() || sim->getTimeScale() == 0.0;
+    return framePacer.evaluate(getFrameState(), timeInfo.currentTime) != celestia::FramePacer::Reason::None;
+}
+
+
+double CelestiaCore::getFrameWaitTime() const
+{
+    return framePacer.waitTime(getFrameState(), timeInfo.currentTime);
+}
+
+
+celestia::FramePacer& CelestiaCore::getFramePacer()
+{
+    return framePacer;
+}
+
+
+celestia::FramePacer::State CelestiaCore::getFrameState() const
+{
+    celestia::FramePacer::State state;
 
     // See if the camera in any of the views is moving
-    bool observersMoving = false;
-    for (const auto v : views)
+    for (const auto v : viewManager->views())
     {
-        if (v->observer->getAngularVelocity().length() > 1.0e-10 ||
-            v->observer->getVelocity().length() > 1.0e-12)
+        const Observer* observer = v->observer;
+        state.views.push_back({ observer->getPosition(), observer->getOrientation(), observer->getFOV() });
+        if (observer->getMode() == Observer::Travelling ||
+            observer->getAngularVelocity().norm() > 1.0e-10 ||
+            observer->getVelocity().norm() > 1.0e-12)
         {
-            observersMoving = true;
-            break;
+            state.moving = true;
         }
     }
 
-    if (viewChanged ||
-        !isPaused ||
-        observersMoving ||
-        dollyMotion != 0.0 ||
+    if (dollyMotion != 0.0 ||
         zoomMotion != 0.0 ||
-        scriptState == ScriptRunning ||
-        renderer->settingsHaveChanged())
-    {
-        return true;
-    }
-    else
+        joystickRotation != Eigen::Vector3f::Zero() ||
+        std::any_of(std::begin(keysPressed), std::end(keysPressed), [](bool b) { return b; }) ||
+        std::any_of(std::begin(joyButtonsPressed), std::end(joyButtonsPressed), [](bool b) { return b; }))
     {
-        return false;
+        state.moving = true;
     }
-#endif
+
+    state.simTime = sim->getTime();
+    state.timeScale = sim->getPauseState() ? 0.0 : sim->getTimeScale();
+    state.settingsChanged = renderer->settingsHaveChanged();
+    state.scriptRunning = scriptState == ScriptRunning;
+    state.recording = movieCapture != nullptr && recording;
+    std::tie(state.overlayChangeStart, state.overlayChangeEnd) = hud->messageFadeInterval();
+
+    return state;
 }
 
 
 void CelestiaCore::splitView(View::Type type, View* av, float splitPos)
 {
+    framePacer.requestFrame();
     switch (viewManager->splitView(sim, type, av, splitPos))
     {
     case ViewSplitResult::Ignored:
@@ -2133,17 +2522,20 @@ void CelestiaCore::setZoomFromFOV()
 
 void CelestiaCore::singleView(const View* av)
 {
+    framePacer.requestFrame();
     viewManager->singleView(sim, av);
     setFOVFromZoom();
 }
 
 void CelestiaCore::setActiveView(const View* v)
 {
+    framePacer.requestFrame();
     viewManager->setActiveView(sim, v);
 }
 
 void CelestiaCore::deleteView(View* v)
 {
+    framePacer.requestFrame();
     if (viewManager->deleteView(sim, v))
         setFOVFromZoom();
 }
@@ -2184,6 +2576,7 @@ void CelestiaCore::showText(std::string_view s,
                             int hoff, int voff,
                             double duration)
 {
+    framePacer.requestFrame();
     auto [emWidth, height] = hud->titleMetrics();
     hud->showText(TextPrintPosition::relative(horig, vorig, hoff, voff, emWidth, height),
                   s, duration, timeInfo.currentTime);
@@ -2191,6 +2584,7 @@ void CelestiaCore::showText(std::string_view s,
 
 void CelestiaCore::showTextAtPixel(std::string_view s, int x, int y, double duration)
 {
+    framePacer.requestFrame();
     hud->showText(TextPrintPosition::absolute(x, y), s, duration, timeInfo.currentTime);
 }
 
@@ -2212,103 +2606,19 @@ void CelestiaCore::renderOverlay()
     if (m_scriptHook != nullptr)
         m_scriptHook->call("renderoverlay");
 
-    hud->renderOverlay(metrics, sim, *viewManager, movieCapture, timeInfo, m_script != nullptr, editMode);
+    hud->renderOverlay(metrics, sim, *viewManager, movieCapture, timeInfo,
+                       &renderer->getFrameProfiler(), m_script != nullptr, editMode);
 }
 
 
-class SolarSystemLoader
-{
-    Universe* universe;
-    ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
-
- public:
-    SolarSystemLoader(Universe* u,
-                      ProgressNotifier* pn,
-                      const vector<fs::path>& skip) :
-        universe(u),
-        notifier(pn),
-        skip(skip)
-    {
-    }
-
-    void process(const fs::path& filepath)
-    {
-        if (DetermineFileType(filepath) != ContentType::CelestiaCatalog)
-            return;
-
-        if (find(begin(skip), end(skip), filepath) != end(skip))
-        {
-            GetLogger()->info(_("Skipping solar system catalog: {}\n"), filepath);
-            return;
-        }
-        GetLogger()->info(_("Loading solar system catalog: {}\n"), filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
-
-        ifstream solarSysFile(filepath, ios::in);
-        if (solarSysFile.good())
-        {
-            LoadSolarSystemObjects(solarSysFile,
-                                   *universe,
-                                   filepath.parent_path());
-        }
-    }
-};
-
-template <class OBJDB> class CatalogLoader
-{
-    OBJDB*      objDB;
-    string      typeDesc;
-    ContentType contentType;
-    ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
-
- public:
-    CatalogLoader(OBJDB* db,
-                  const std::string& typeDesc,
-                  const ContentType& contentType,
-                  ProgressNotifier* pn,
-                  const vector<fs::path>& skip) :
-        objDB      (db),
-        typeDesc   (typeDesc),
-        contentType(contentType),
-        notifier   (pn),
-        skip       (skip)
-    {
-    }
-
-    void process(const fs::path& filepath)
-    {
-        if (DetermineFileType(filepath) != contentType)
-            return;
-
-        if (find(begin(skip), end(skip), filepath) != end(skip))
-        {
-            GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, filepath);
-            return;
-        }
-        GetLogger()->info(_("Loading {} catalog: {}\n"), typeDesc, filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
-
-        ifstream catalogFile(filepath, ios::in);
-        if (catalogFile.good())
-        {
-            if (!objDB->load(catalogFile, filepath.parent_path()))
-                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
-        }
-    }
-};
-
-using StarLoader = CatalogLoader<StarDatabaseBuilder>;
-using DeepSkyLoader = CatalogLoader<DSODatabase>;
-
-
 bool CelestiaCore::initSimulation(const fs::path& configFileName,
                                   const vector<fs::path>& extrasDirs,
                                   ProgressNotifier* progressNotifier)
 {
+    startupProfile = std::make_unique<StartupProfile>();
+    StartupProfile::Phase initPhase(startupProfile.get(), "initSimulation");
+
+    StartupProfile::Phase configPhase(startupProfile.get(), "readConfig");
     config = std::make_unique<CelestiaConfig>();
     bool hasConfig = false;
     if (!configFileName.empty())
@@ -2328,6 +2638,8 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
             hasConfig |= ReadCelestiaConfig(localConfigFile, *config);
     }
 
+    configPhase.end();
+
     if (!hasConfig)
     {
         fatalError(_("Error reading configuration file."), false);
@@ -2338,6 +2650,10 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     if (config->consoleLogRows > 100)
         console->setRowCount(config->consoleLogRows);
 
+    // Before any catalog is read, as the catalogs are read on the workers
+    if (config->workerThreads != 0)
+        celestia::util::TaskScheduler::get().setWorkerCount(config->workerThreads);
+
     if (!config->paths.leapSecondsFile.empty())
         ReadLeapSecondsFile(config->paths.leapSecondsFile, leapSeconds);
 
@@ -2382,7 +2698,58 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     if (favorites == nullptr)
         favorites = new FavoritesList();
 
+    celestia::ephem::SetCustomOrbitTableSpan(config->customOrbitTableSpan);
+
     universe = new Universe();
+    catalogWatcher = std::make_unique<celestia::CatalogWatcher>();
+
+    // The deep sky and solar system catalogs don't depend on the stars, so
+    // start reading them on worker threads while the stars are loaded. Deep
+    // sky catalogs are parsed ahead as well. The results are added to the
+    // databases in the original order, so later catalogs still override
+    // earlier ones.
+    std::vector<fs::path> dsoFiles = config->paths.dsoCatalogFiles;
+    std::size_t nConfigDSOFiles = dsoFiles.size();
+    for (auto& file : findExtrasCatalogs(config->paths.extrasDirs,
+                                         ContentType::CelestiaDeepSkyCatalog,
+                                         "deep sky object",
+                                         config->paths.skipExtras))
+    {
+        dsoFiles.push_back(std::move(file));
+    }
+
+    OrderedPrefetch<std::optional<DSODatabase::ParsedCatalog>> dsoPrefetch(dsoFiles.size(), [&dsoFiles](std::size_t i)
+    {
+        // The catalog may be in the binary format
+        std::optional<DSODatabase::ParsedCatalog> catalog;
+        if (auto dsoFile = CatalogFile::read(dsoFiles[i]); dsoFile.has_value())
+            catalog = DSODatabase::parse(dsoFile->getText());
+        return catalog;
+    });
+
+    std::vector<fs::path> solarSystemFiles = config->paths.solarSystemFiles;
+    std::size_t nConfigSolarSystemFiles = solarSystemFiles.size();
+    for (auto& file : findExtrasCatalogs(config->paths.extrasDirs,
+                                         ContentType::CelestiaCatalog,
+                                         "solar system",
+                                         config->paths.skipExtras))
+    {
+        solarSystemFiles.push_back(std::move(file));
+    }
+
+    // With the progressive startup the add-on solar system catalogs are
+    // loaded between the first frames instead
+    if (config->progressiveStartup && solarSystemFiles.size() > nConfigSolarSystemFiles)
+    {
+        pendingCatalogs = std::make_unique<PendingCatalogs>(
+            std::vector<fs::path>(solarSystemFiles.begin() + nConfigSolarSystemFiles, solarSystemFiles.end()));
+        solarSystemFiles.resize(nConfigSolarSystemFiles);
+    }
+
+    OrderedPrefetch<std::optional<SolarSystemCatalogFile>> solarSystemPrefetch(solarSystemFiles.size(), [&solarSystemFiles](std::size_t i)
+    {
+        return ReadSolarSystemCatalogFile(solarSystemFiles[i]);
+    });
 
 
     /***** Load star catalogs *****/
@@ -2396,103 +2763,99 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load the deep sky catalogs *****/
 
+    if (!config->paths.galaxyFormCacheFile.empty())
+    {
+        fs::path cachePath = config->paths.galaxyFormCacheFile;
+#ifndef PORTABLE_BUILD
+        if (cachePath.is_relative())
+            cachePath = WriteableDataPath() / cachePath;
+#endif
+        GalacticFormManager::setCacheFile(cachePath);
+    }
+
+    StartupProfile::Phase dsoPhase(startupProfile.get(), "loadDSOCatalogs");
     auto dsoDB = std::make_unique<DSODatabase>();
     dsoDB->setNameDatabase(std::make_unique<DSONameDatabase>());
 
-    // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
-
-    for (const auto& file : config->paths.dsoCatalogFiles)
+    // First the dsoCatalogFiles in the data directory (deepsky.dsc,
+    // globulars.dsc,...), then the deep sky files in the extras directories
+    for (std::size_t i = 0; i < dsoFiles.size(); ++i)
     {
-        if (progressNotifier)
-            progressNotifier->update(file.string());
-
-        ifstream dsoFile(file, ios::in);
-        if (!dsoFile.good())
-        {
-            GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
-        }
-        if (!dsoDB->load(dsoFile, ""))
+        const fs::path& file = dsoFiles[i];
+        dsoPhase.addFile(file);
+        if (i < nConfigDSOFiles)
         {
-            GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
+            if (progressNotifier)
+                progressNotifier->update(file.string());
+
+            auto catalog = dsoPrefetch.next();
+            if (!catalog.has_value())
+                GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
+            else if (!dsoDB->load(std::move(*catalog), ""))
+                GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
         }
-    }
-
-    // Next, read all the deep sky files in the extras directories
-    {
-        std::vector<fs::path> entries;
-        DeepSkyLoader loader(dsoDB.get(), "deep sky object",
-                             ContentType::CelestiaDeepSkyCatalog,
-                             progressNotifier,
-                             config->paths.skipExtras);
-        for (const auto& dir : config->paths.extrasDirs)
+        else
         {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
+            GetLogger()->info(_("Loading {} catalog: {}\n"), "deep sky object", file);
+            if (progressNotifier)
+                progressNotifier->update(file.filename().string());
+
+            auto catalog = dsoPrefetch.next();
+            if (catalog.has_value() && !dsoDB->load(std::move(*catalog), file.parent_path()))
+                GetLogger()->error(_("Error reading {} catalog file: {}\n"), "deep sky object", file);
+            catalogWatcher->addCatalog(file);
         }
     }
     dsoDB->finish();
+    dsoPhase.addObjects(dsoDB->size());
     universe->setDSOCatalog(std::move(dsoDB));
+    dsoPhase.end();
 
 
     /***** Load the solar system catalogs *****/
     // First read the solar system files listed individually in the
-    // config file.
+    // config file, then the solar system files in the extras directories
+    StartupProfile::Phase solarSystemPhase(startupProfile.get(), "loadSolarSystemCatalogs");
     universe->setSolarSystemCatalog(std::make_unique<SolarSystemCatalog>());
-    for (const auto& file : config->paths.solarSystemFiles)
+    for (std::size_t i = 0; i < solarSystemFiles.size(); ++i)
     {
-        if (progressNotifier)
-            progressNotifier->update(file.string());
-
-        std::ifstream solarSysFile(file, std::ios::in);
-        if (!solarSysFile.good())
+        const fs::path& file = solarSystemFiles[i];
+        solarSystemPhase.addFile(file);
+        if (i < nConfigSolarSystemFiles)
         {
-            GetLogger()->error(_("Error opening solar system catalog {}.\n"), file);
+            if (progressNotifier)
+                progressNotifier->update(file.string());
+
+            auto catalog = solarSystemPrefetch.next();
+            if (!catalog.has_value())
+            {
+                GetLogger()->error(_("Error opening solar system catalog {}.\n"), file);
+            }
+            else
+            {
+                catalog->load(*universe, fs::path());
+            }
         }
         else
         {
-            LoadSolarSystemObjects(solarSysFile, *universe);
-        }
-    }
-
-    // Next, read all the solar system files in the extras directories
-    {
-        vector<fs::path> entries;
-        SolarSystemLoader loader(universe, progressNotifier, config->paths.skipExtras);
-        for (const auto& dir : config->paths.extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
+            GetLogger()->info(_("Loading solar system catalog: {}\n"), file);
+            if (progressNotifier)
+                progressNotifier->update(file.filename().string());
 
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
+            auto catalog = solarSystemPrefetch.next();
+            if (catalog.has_value())
             {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
+                SolarSystemCatalogObjects objects;
+                catalog->load(*universe, file.parent_path(), &objects);
+                catalogWatcher->addSolarSystemCatalog(file, file.parent_path(), std::move(objects));
             }
-            sort(begin(entries), end(entries));
-            for(const auto& fn : entries)
-                loader.process(fn);
         }
     }
 
+    for (const auto& [starIndex, solarSystem] : *universe->getSolarSystemCatalog())
+        solarSystemPhase.addObjects(countBodies(solarSystem->getPlanets()));
+    solarSystemPhase.end();
+
     // Load asterisms:
     if (!config->paths.asterismsFile.empty())
         loadAsterismsFile(config->paths.asterismsFile);
@@ -2522,8 +2885,19 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         }
     }
 
+    // The dome viewport effect warps the faces of a cube map, each rendered
+    // with an ordinary perspective projection
+    bool domeEffect = config->viewportEffect == "dome";
     std::shared_ptr<ProjectionMode> projectionMode = nullptr;
-    if (compareIgnoringCase(config->projectionMode, "fisheye") == 0)
+    if (domeEffect)
+    {
+        if (!config->projectionMode.empty() && compareIgnoringCase(config->projectionMode, "dome") != 0)
+            GetLogger()->warn("Projection mode {} ignored with the dome viewport effect\n", config->projectionMode);
+        projectionMode = std::make_shared<DomeProjectionMode>(static_cast<float>(metrics.width),
+                                                              static_cast<float>(metrics.height),
+                                                              metrics.screenDpi);
+    }
+    else if (compareIgnoringCase(config->projectionMode, "fisheye") == 0)
     {
         projectionMode = std::make_shared<FisheyeProjectionMode>(static_cast<float>(metrics.width),
                                                                  static_cast<float>(metrics.height),
@@ -2562,12 +2936,35 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
                     GetLogger()->error("Failed to read warp mesh file {}\n", config->paths.warpMeshFile);
             }
         }
+        else if (domeEffect)
+        {
+            // The warp mesh is optional, for the calibration of the projectors
+            WarpMesh *mesh = nullptr;
+            if (!config->paths.warpMeshFile.empty())
+            {
+                WarpMeshManager *manager = GetWarpMeshManager();
+                mesh = manager->find(manager->getHandle(WarpMeshInfo(config->paths.warpMeshFile)));
+                if (mesh == nullptr)
+                    GetLogger()->error("Failed to read warp mesh file {}\n", config->paths.warpMeshFile);
+            }
+            viewportEffect = std::make_unique<DomeViewportEffect>(mesh);
+        }
         else
         {
             GetLogger()->warn("Unknown viewport effect {}\n", config->viewportEffect);
         }
     }
 
+    if (config->renderDetails.postProcessAntialiasing)
+    {
+        // Without an effect the scene is antialiased on its way to the
+        // screen by the passthrough effect
+        if (viewportEffect != nullptr)
+            viewportEffect->setAntialiasing(true);
+        dynamicResolutionEffect = std::make_unique<PassthroughViewportEffect>();
+        dynamicResolutionEffect->setAntialiasing(true);
+    }
+
     if (!config->measurementSystem.empty())
     {
         if (compareIgnoringCase(config->measurementSystem, "imperial") == 0)
@@ -2653,6 +3050,8 @@ LoadFontHelper(const Renderer *renderer, const fs::path &p)
 
 bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
 {
+    StartupProfile::Phase initPhase(startupProfile.get(), "initRenderer");
+
     renderer->setRenderFlags(Renderer::ShowStars |
                              Renderer::ShowPlanets |
                              Renderer::ShowAtmospheres |
@@ -2665,15 +3064,60 @@ bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
     detailOptions.orbitWindowEnd = config->renderDetails.orbitWindowEnd;
     detailOptions.orbitPeriodsShown = config->renderDetails.orbitPeriodsShown;
     detailOptions.linearFadeFraction = config->renderDetails.linearFadeFraction;
+    detailOptions.residentOrbitPaths = config->renderDetails.residentOrbitPaths;
+    detailOptions.orbitSamplingThreads = config->renderDetails.orbitSamplingThreads;
+    // The configuration file uses milliseconds
+    detailOptions.orbitSamplingTime = config->renderDetails.orbitSamplingTime / 1000.0;
+    detailOptions.renderListThreads = config->renderDetails.renderListThreads;
+    detailOptions.starRenderThreads = config->renderDetails.starRenderThreads;
+    detailOptions.dsoRenderThreads = config->renderDetails.dsoRenderThreads;
+    // The configuration file uses milliseconds
+    detailOptions.starRenderTime = config->renderDetails.starRenderTime / 1000.0;
+    detailOptions.gpuStarCulling = config->renderDetails.gpuStarCulling;
+    detailOptions.textureLoadThreads = config->renderDetails.textureLoadThreads;
+    // The configuration file uses milliseconds
+    detailOptions.textureUploadTime = config->renderDetails.textureUploadTime / 1000.0;
+    // Megabytes in the configuration file
+    detailOptions.virtualTextureCacheSize = static_cast<std::size_t>(config->renderDetails.virtualTextureCacheSize) * 1024 * 1024;
+    detailOptions.textureMemoryBudget = static_cast<std::size_t>(config->renderDetails.textureMemoryBudget) * 1024 * 1024;
+    detailOptions.geometryMemoryBudget = static_cast<std::size_t>(config->renderDetails.geometryMemoryBudget) * 1024 * 1024;
+    detailOptions.autoTextureResolution = config->renderDetails.autoTextureResolution;
+    // The configuration file uses milliseconds
+    detailOptions.targetFrameTime = config->renderDetails.targetFrameTime / 1000.0;
+    detailOptions.nebulaLoadThreads = config->renderDetails.nebulaLoadThreads;
+    detailOptions.nebulaUnloadTime = config->renderDetails.nebulaUnloadTime;
+    detailOptions.textureCache = config->renderDetails.textureCache;
+    detailOptions.textureSizeLimit = config->renderDetails.textureSizeLimit;
+    // Kilobytes in the configuration file
+    detailOptions.textureUploadChunkSize = static_cast<std::size_t>(config->renderDetails.textureUploadChunkSize) * 1024;
+    detailOptions.declutterLabels = config->renderDetails.declutterLabels;
+    detailOptions.shaderCacheDirectory = config->paths.shaderCacheDirectory;
+    detailOptions.modelCacheDirectory = config->paths.modelCacheDirectory;
+    detailOptions.shaderWarmUpTime = config->renderDetails.shaderWarmUpTime / 1000.0;
+    detailOptions.terrainTriangleBudget = config->renderDetails.terrainTriangleBudget;
+    // Kilobytes per frame and megabytes in the configuration file
+    detailOptions.terrainUploadBudget = static_cast<std::size_t>(config->renderDetails.terrainUploadBudget) * 1024;
+    detailOptions.terrainMemoryBudget = static_cast<std::size_t>(config->renderDetails.terrainMemoryBudget) * 1024 * 1024;
+    detailOptions.scatteringTables = config->renderDetails.scatteringTables;
+    detailOptions.optimizeModels = config->renderDetails.optimizeModels;
+    detailOptions.starFieldCacheSize = config->renderDetails.starFieldCacheSize;
+    detailOptions.packedStarVertices = config->renderDetails.packedStarVertices;
+    detailOptions.reversedDepth = config->renderDetails.reversedDepth;
+    detailOptions.stereoSeparation = config->renderDetails.stereoSeparation;
+    detailOptions.distanceFieldFonts = config->renderDetails.distanceFieldFonts;
 #ifndef GL_ES
     detailOptions.useMesaPackInvert = useMesaPackInvert;
 #endif
 
     // Prepare the scene for rendering.
-    if (!renderer->init(metrics.width, metrics.height, detailOptions))
     {
-        fatalError(_("Failed to initialize renderer"), false);
-        return false;
+        // This includes building the procedural star and shadow textures
+        StartupProfile::Phase rendererPhase(startupProfile.get(), "rendererInit");
+        if (!renderer->init(metrics.width, metrics.height, detailOptions))
+        {
+            fatalError(_("Failed to initialize renderer"), false);
+            return false;
+        }
     }
 
     if ((renderer->getRenderFlags() & Renderer::ShowAutoMag) != 0)
@@ -2682,6 +3126,22 @@ bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
         setFaintestAutoMag();
     }
 
+    if (!config->paths.frameProfileFile.empty())
+        renderer->getFrameProfiler().setLogFile(config->paths.frameProfileFile);
+
+    const auto& subView = config->renderDetails.subView;
+    renderer->setSubView(Eigen::Vector4f(subView[0], subView[1], subView[2], subView[3]));
+
+    setThreadedTick(config->renderDetails.threadedTick);
+    framePacer.setAdaptive(config->renderDetails.adaptiveFramePacing);
+    framePacer.setReducedFrameRate(config->renderDetails.reducedFrameRate);
+    framePacer.setIdleFrameInterval(config->renderDetails.idleFrameInterval);
+    setDynamicResolution(config->renderDetails.dynamicResolution);
+    // The automatic texture resolution follows the measured frame times
+    if (config->renderDetails.autoTextureResolution)
+        renderer->getFrameProfiler().setEnabled(true);
+
+    StartupProfile::Phase fontPhase(startupProfile.get(), "loadFonts");
     auto mainFont = config->fonts.mainFont.empty()
                 ? LoadFontHelper(renderer, "DejaVuSans.ttf,12")
                 : LoadFontHelper(renderer, config->fonts.mainFont);
@@ -2721,38 +3181,79 @@ bool CelestiaCore::initRenderer([[maybe_unused]] bool useMesaPackInvert)
     }
 
     renderer->setFont(Renderer::FontLarge, hud->titleFont());
+    fontPhase.end();
+
     renderer->setRTL(metrics.layoutDirection == LayoutDirection::RightToLeft);
+
+    // This is the end of startup, recording stops here
+    if (startupProfile != nullptr)
+    {
+        initPhase.end();
+        if (!config->paths.startupReportFile.empty())
+            startupProfile->writeReport(config->paths.startupReportFile);
+        startupProfile = nullptr;
+    }
+
     return true;
 }
 
 
-static void loadCrossIndex(StarDatabaseBuilder& starDBBuilder,
+// Return false if the cross index couldn't be loaded
+static bool loadCrossIndex(StarDatabaseBuilder& starDBBuilder,
                            StarCatalog catalog,
-                           const fs::path& filename)
+                           const fs::path& filename,
+                           StartupProfile* profile)
 {
     if (!filename.empty())
     {
+        StartupProfile::Phase phase(profile, "loadCrossIndex");
+        phase.addFile(filename);
         ifstream xrefFile(filename, ios::in | ios::binary);
-        if (xrefFile.good())
+        if (!xrefFile.good())
+            return false;
+
+        if (!starDBBuilder.loadCrossIndex(catalog, xrefFile))
         {
-            if (!starDBBuilder.loadCrossIndex(catalog, xrefFile))
-                GetLogger()->error(_("Error reading cross index {}\n"), filename);
-            else
-                GetLogger()->info(_("Loaded cross index {}\n"), filename);
+            GetLogger()->error(_("Error reading cross index {}\n"), filename);
+            return false;
         }
+
+        GetLogger()->info(_("Loaded cross index {}\n"), filename);
     }
+
+    return true;
 }
 
 
 bool CelestiaCore::readStars(const CelestiaConfig& cfg,
                              ProgressNotifier* progressNotifier)
 {
+    StartupProfile::Phase starsPhase(startupProfile.get(), "readStars");
     StarDetails::SetStarTextures(cfg.starTextures);
 
+    StarDatabaseBuilder starDBBuilder;
+
+    fs::path nameCachePath = cfg.paths.starNameCacheFile;
+#ifndef PORTABLE_BUILD
+    if (!nameCachePath.empty() && nameCachePath.is_relative())
+        nameCachePath = WriteableDataPath() / nameCachePath;
+#endif
+    StarDatabaseBuilder::NameCacheSources nameCacheSources;
+    nameCacheSources.starNames = cfg.paths.starNamesFile;
+    nameCacheSources.crossIndexes[static_cast<std::size_t>(StarCatalog::HenryDraper)] = cfg.paths.HDCrossIndexFile;
+    nameCacheSources.crossIndexes[static_cast<std::size_t>(StarCatalog::SAO)] = cfg.paths.SAOCrossIndexFile;
+    nameCacheSources.crossIndexes[static_cast<std::size_t>(StarCatalog::Gliese)] = cfg.paths.GlieseCrossIndexFile;
+
+    StartupProfile::Phase namesPhase(startupProfile.get(), "loadStarNames");
+    bool namesCached = !nameCachePath.empty() && starDBBuilder.loadNameCache(nameCachePath, nameCacheSources);
     std::unique_ptr<StarNameDatabase> starNameDB = nullptr;
-    ifstream starNamesFile(cfg.paths.starNamesFile, ios::in);
-    if (starNamesFile.good())
+    if (namesCached)
     {
+        namesPhase.addFile(nameCachePath);
+    }
+    else if (ifstream starNamesFile(cfg.paths.starNamesFile, ios::in); starNamesFile.good())
+    {
+        namesPhase.addFile(cfg.paths.starNamesFile);
         starNameDB = StarNameDatabase::readNames(starNamesFile);
         if (starNameDB == nullptr)
             GetLogger()->error(_("Error reading star names file\n"));
@@ -2761,81 +3262,119 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     {
         GetLogger()->error(_("Error opening {}\n"), cfg.paths.starNamesFile);
     }
+    namesPhase.end();
 
     // First load the binary star database file.  The majority of stars
     // will be defined here.
-    StarDatabaseBuilder starDBBuilder;
     if (!cfg.paths.starDatabaseFile.empty())
     {
         if (progressNotifier)
             progressNotifier->update(cfg.paths.starDatabaseFile.string());
 
-        ifstream starFile(cfg.paths.starDatabaseFile, ios::in | ios::binary);
-        if (!starFile.good())
-        {
-            GetLogger()->error(_("Error opening {}\n"), cfg.paths.starDatabaseFile);
-            return false;
-        }
-
-        if (!starDBBuilder.loadBinary(starFile))
+        StartupProfile::Phase databasePhase(startupProfile.get(), "loadStarDatabase");
+        databasePhase.addFile(cfg.paths.starDatabaseFile);
+        if (!starDBBuilder.loadBinary(cfg.paths.starDatabaseFile))
         {
             GetLogger()->error(_("Error reading stars file\n"));
             return false;
         }
     }
 
-    if (starNameDB == nullptr)
-        starNameDB = std::make_unique<StarNameDatabase>();
-    starDBBuilder.setNameDatabase(std::move(starNameDB));
+    if (!namesCached)
+    {
+        // Only cache complete data, so that errors show up again
+        bool complete = starNameDB != nullptr;
+        if (starNameDB == nullptr)
+            starNameDB = std::make_unique<StarNameDatabase>();
+        starDBBuilder.setNameDatabase(std::move(starNameDB));
+
+        complete &= loadCrossIndex(starDBBuilder, StarCatalog::HenryDraper, cfg.paths.HDCrossIndexFile,     startupProfile.get());
+        complete &= loadCrossIndex(starDBBuilder, StarCatalog::SAO,         cfg.paths.SAOCrossIndexFile,    startupProfile.get());
+        complete &= loadCrossIndex(starDBBuilder, StarCatalog::Gliese,      cfg.paths.GlieseCrossIndexFile, startupProfile.get());
 
-    loadCrossIndex(starDBBuilder, StarCatalog::HenryDraper, cfg.paths.HDCrossIndexFile);
-    loadCrossIndex(starDBBuilder, StarCatalog::SAO,         cfg.paths.SAOCrossIndexFile);
-    loadCrossIndex(starDBBuilder, StarCatalog::Gliese,      cfg.paths.GlieseCrossIndexFile);
+        // The star catalogs add names, so save the cache before them
+        if (complete && !nameCachePath.empty())
+            starDBBuilder.writeNameCache(nameCachePath, nameCacheSources);
+    }
 
     // Next, read any ASCII star catalog files specified in the StarCatalogs
-    // list.
-    for (const auto& file : config->paths.starCatalogFiles)
+    // list, followed by the supplemental star files from the extras
+    // directories. The files are read ahead on worker threads and loaded
+    // in order.
+    StartupProfile::Phase catalogsPhase(startupProfile.get(), "loadStarCatalogs");
+    std::vector<fs::path> starFiles;
+    std::copy_if(cfg.paths.starCatalogFiles.begin(), cfg.paths.starCatalogFiles.end(),
+                 std::back_inserter(starFiles),
+                 [](const fs::path& file) { return !file.empty(); });
+    std::size_t nConfigStarFiles = starFiles.size();
+    for (auto& file : findExtrasCatalogs(cfg.paths.extrasDirs,
+                                         ContentType::CelestiaStarCatalog,
+                                         "star",
+                                         cfg.paths.skipExtras))
     {
-        if (file.empty())
-            continue;
-
-        ifstream starFile(file, ios::in);
-        if (starFile.good())
-            starDBBuilder.load(starFile);
-        else
-            GetLogger()->error(_("Error opening star catalog {}\n"), file);
+        starFiles.push_back(std::move(file));
     }
 
-    // Now, read supplemental star files from the extras directories
+    OrderedPrefetch<std::optional<CatalogFile>> starPrefetch(starFiles.size(), [&starFiles](std::size_t i)
     {
-        vector<fs::path> entries;
-        StarLoader loader(&starDBBuilder,
-                          "star",
-                          ContentType::CelestiaStarCatalog,
-                          progressNotifier,
-                          config->paths.skipExtras);
-        for (const auto& dir : config->paths.extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
+        return CatalogFile::read(starFiles[i]);
+    });
 
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
+    for (std::size_t i = 0; i < starFiles.size(); ++i)
+    {
+        const fs::path& file = starFiles[i];
+        catalogsPhase.addFile(file);
+        if (i < nConfigStarFiles)
+        {
+            auto contents = starPrefetch.next();
+            if (!contents.has_value())
+            {
+                GetLogger()->error(_("Error opening star catalog {}\n"), file);
+            }
+            else
             {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
+                starDBBuilder.load(contents->getText());
             }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
+        }
+        else
+        {
+            GetLogger()->info(_("Loading {} catalog: {}\n"), "star", file);
+            if (progressNotifier)
+                progressNotifier->update(file.filename().string());
+
+            auto contents = starPrefetch.next();
+            if (!contents.has_value())
+                continue;
+
+            if (!starDBBuilder.load(contents->getText(), file.parent_path()))
+                GetLogger()->error(_("Error reading {} catalog file: {}\n"), "star", file);
+            catalogWatcher->addCatalog(file);
         }
     }
+    catalogsPhase.end();
 
+    if (!cfg.paths.starOctreeCacheFile.empty())
+    {
+        fs::path cachePath = cfg.paths.starOctreeCacheFile;
+#ifndef PORTABLE_BUILD
+        if (cachePath.is_relative())
+            cachePath = WriteableDataPath() / cachePath;
+#endif
+        starDBBuilder.setOctreeCache(cachePath);
+    }
+
+    StartupProfile::Phase octreePhase(startupProfile.get(), "buildStarOctree");
     universe->setStarCatalog(starDBBuilder.finish());
+    octreePhase.end();
+
+    starsPhase.addObjects(universe->getStarCatalog()->size());
+
+    if (!cfg.paths.starTilesFile.empty())
+    {
+        auto budget = static_cast<std::size_t>(cfg.renderDetails.starTileMemoryBudget) * 1024 * 1024;
+        universe->setStarTiles(celestia::engine::StarTileDatabase::open(cfg.paths.starTilesFile, budget));
+    }
+
     return true;
 }
 
@@ -3057,6 +3596,8 @@ void CelestiaCore::setOverlayElements(HudElements _overlayElements)
 
 void CelestiaCore::initMovieCapture(MovieCapture* mc)
 {
+    if (movieCaptureEnding)
+        finishMovieCapture();
     if (movieCapture == nullptr)
         movieCapture = mc;
 }
@@ -3076,7 +3617,19 @@ void CelestiaCore::recordPause()
     if (movieCapture != nullptr) movieCapture->recordingStatus(false);
 }
 
+// Reading back the last frames needs the GL context, so the capture ends
+// at the start of the next frame rather than in the key handler
 void CelestiaCore::recordEnd()
+{
+    if (movieCapture != nullptr)
+    {
+        recordPause();
+        movieCaptureEnding = true;
+        framePacer.requestFrame();
+    }
+}
+
+void CelestiaCore::finishMovieCapture()
 {
     if (movieCapture != nullptr)
     {
@@ -3085,11 +3638,12 @@ void CelestiaCore::recordEnd()
         delete movieCapture;
         movieCapture = nullptr;
     }
+    movieCaptureEnding = false;
 }
 
 bool CelestiaCore::isCaptureActive()
 {
-    return movieCapture != nullptr;
+    return movieCapture != nullptr && !movieCaptureEnding;
 }
 
 bool CelestiaCore::isRecording()
@@ -3126,6 +3680,7 @@ void CelestiaCore::removeWatcher(CelestiaWatcher* watcher)
 
 void CelestiaCore::notifyWatchers(int property)
 {
+    framePacer.requestFrame();
     for (const auto watcher : watchers)
     {
         watcher->notifyChange(this, property);
@@ -3135,18 +3690,68 @@ void CelestiaCore::notifyWatchers(int property)
 
 bool CelestiaCore::goToUrl(const string& urlStr)
 {
-    Url url(this);
-    if (!url.parse(urlStr))
+    // Enough for the bookmarks of a session, the cache is emptied when
+    // it's full
+    constexpr std::size_t MaxCompiledUrls = 256;
+
+    auto it = compiledUrls.find(urlStr);
+    if (it == compiledUrls.end())
     {
-        fatalError(_("Invalid URL"));
-        return false;
+        auto url = std::make_unique<Url>(this);
+        if (!url->parse(urlStr))
+        {
+            fatalError(_("Invalid URL"));
+            return false;
+        }
+
+        if (compiledUrls.size() >= MaxCompiledUrls)
+            compiledUrls.clear();
+        it = compiledUrls.emplace(urlStr, std::move(url)).first;
     }
-    url.goTo();
+
+    it->second->goTo();
     notifyWatchers(RenderFlagsChanged | LabelFlagsChanged);
     return true;
 }
 
 
+ClusterFrame CelestiaCore::captureClusterFrame()
+{
+    CelestiaState state(this);
+    state.captureState();
+
+    // The time of the URL is rounded, the exact one is set before the
+    // observer is placed in its frame
+    ClusterFrame frame;
+    frame.number = ++clusterFrameNumber;
+    frame.tdb = sim->getTime();
+    frame.url = Url(state, Url::CurrentVersion, Url::UseSimulationTime).getAsString();
+    frame.faintestVisible = sim->getFaintestVisible();
+    frame.ambientLight = renderer->getAmbientLightLevel();
+    frame.orbitMask = renderer->getOrbitMask();
+    frame.starStyle = static_cast<std::int32_t>(renderer->getStarStyle());
+    return frame;
+}
+
+
+// Unlike goToUrl, the URL isn't kept, as every frame has a new one
+bool CelestiaCore::applyClusterFrame(const ClusterFrame& frame)
+{
+    Url url(this);
+    if (!url.parse(frame.url))
+        return false;
+
+    sim->setTime(frame.tdb);
+    url.goTo();
+    sim->setFaintestVisible(frame.faintestVisible);
+    renderer->setAmbientLightLevel(frame.ambientLight);
+    renderer->setOrbitMask(frame.orbitMask);
+    renderer->setStarStyle(static_cast<Renderer::StarStyle>(frame.starStyle));
+    clusterFrameNumber = frame.number;
+    return true;
+}
+
+
 void CelestiaCore::addToHistory()
 {
     if (!history.empty() && historyCurrent < history.size() - 1)
@@ -3326,6 +3931,35 @@ void CelestiaCore::setTypedText(const char *c_p)
     hud->textInput().appendText(sim, c_p, (renderer->getLabelMode() & Renderer::LocationLabels) != 0);
 }
 
+// Drop the references of the simulation and the observers to an object
+// which is being removed, along with its satellites and locations
+void CelestiaCore::dropReferences(const Selection& removed)
+{
+    auto isRemoved = [&removed](const Selection& sel) { return CatalogWatcher::isRemovedWith(sel, removed); };
+
+    if (isRemoved(sim->getSelection()))
+        sim->setSelection(Selection());
+
+    for (Observer* observer : getObservers())
+    {
+        if (isRemoved(observer->getTrackedObject()))
+            observer->setTrackedObject(Selection());
+
+        const ObserverFrame::SharedConstPtr& frame = observer->getFrame();
+        if (isRemoved(frame->getRefObject()) || isRemoved(frame->getTargetObject()))
+            observer->setFrame(ObserverFrame::Universal, Selection());
+    }
+
+    std::vector<Selection> marked;
+    for (const auto& marker : universe->getMarkers())
+    {
+        if (isRemoved(marker.object()))
+            marked.push_back(marker.object());
+    }
+    for (const Selection& sel : marked)
+        universe->unmarkObject(sel, std::numeric_limits<int>::max());
+}
+
 vector<Observer*> CelestiaCore::getObservers() const
 {
     vector<Observer*> observerList;
@@ -3379,7 +4013,9 @@ bool CelestiaCore::saveScreenShot(const fs::path& filename, ContentType type) co
     PixelFormat format;
     getCaptureInfo(viewport, format);
     Image image(format, viewport[2], viewport[3]);
-    if (!captureImage(image.getPixels(), viewport, format))
+    bool captured = false;
+    callOnRenderThread([&] { captured = captureImage(image.getPixels(), viewport, format); });
+    if (!captured)
         return false;
 
     return image.save(filename, type);
@@ -3398,8 +4034,32 @@ bool CelestiaCore::isPlayingAudio(int channel) const
     return audioSession && audioSession->isPlaying();
 }
 
+// Open a file to be played on the channel later, so that playing it
+// doesn't wait for the file to be opened and decoded
+bool CelestiaCore::preloadAudio(int channel, const fs::path &path)
+{
+    if (auto audioSession = getAudioSession(channel); audioSession && audioSession->playsFile(path))
+        return audioSession->preload();
+
+    stopAudio(channel);
+    auto audioSession = make_shared<MiniAudioSession>(path, defaultAudioVolume, defaultAudioPan, false, false);
+    audioSessions[channel] = audioSession;
+    return audioSession->preload();
+}
+
 bool CelestiaCore::playAudio(int channel, const fs::path &path, double startTime, float volume, float pan, bool loop, bool nopause)
 {
+    // Play the file preloaded on the channel
+    if (auto audioSession = getAudioSession(channel);
+        audioSession && !audioSession->isPlaying() && audioSession->playsFile(path))
+    {
+        audioSession->setVolume(volume);
+        audioSession->setPan(pan);
+        audioSession->setLoop(loop);
+        audioSession->setNoPause(nopause);
+        return audioSession->play(startTime);
+    }
+
     stopAudio(channel);
     auto audioSession = make_shared<MiniAudioSession>(path, volume, pan, loop, nopause);
     audioSessions[channel] = audioSession;
@@ -3533,6 +4193,8 @@ void CelestiaCore::setLogFile(const fs::path &fn)
     m_logfile = std::ofstream(fn);
     if (m_logfile.good())
     {
+        // Messages still queued would be written while the streams change
+        GetLogger()->flush();
         m_tee = teestream(m_logfile, *console);
         clog.rdbuf(m_tee.rdbuf());
         cerr.rdbuf(m_tee.rdbuf());
@@ -15,6 +15,7 @@
 #include <functional>
 #include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <celutil/filetype.h>
 #include <celutil/timer.h>
 #include <celutil/watcher.h>
@@ -30,6 +31,7 @@
 #include <celutil/tee.h>
 #include "configfile.h"
 #include "favorites.h"
+#include "framepacer.h"
 #include "destination.h"
 #include "hud.h"
 #include "moviecapture.h"
@@ -50,11 +52,20 @@ class Console;
 
 namespace celestia
 {
+class CatalogWatcher;
+struct ClusterFrame;
+class StartupProfile;
 class TextPrintPosition;
+class TickThread;
 class ViewManager;
 #ifdef USE_MINIAUDIO
 class AudioSession;
 #endif
+
+namespace engine
+{
+class DynamicResolution;
+}
 }
 
 typedef Watcher<CelestiaCore> CelestiaWatcher;
@@ -201,6 +212,12 @@ public:
     // URLs and history navigation
     void setStartURL(const std::string& url);
     bool goToUrl(const std::string& urlStr);
+
+    // In cluster rendering, the frontend of the master sends the state of
+    // each frame to the render nodes, which apply it before drawing their
+    // part of the view, set by the SubView configuration
+    celestia::ClusterFrame captureClusterFrame();
+    bool applyClusterFrame(const celestia::ClusterFrame&);
     void addToHistory();
     void back();
     void forward();
@@ -228,6 +245,26 @@ public:
     // app provides a presentation time for the next frame to render
     void tick(double dt);
 
+    // In threaded mode tickAsync runs tick on a second thread, so that the
+    // simulation and scripts overlap with the swap of the frame drawn
+    // before. The frontend must call finishTick before it passes input to
+    // the core; draw calls it. Otherwise tickAsync is the same as tick.
+    void setThreadedTick(bool);
+    bool getThreadedTick() const;
+    void tickAsync();
+    void finishTick();
+    // Run call on the thread which draws, to use the OpenGL context from a
+    // tick, waiting for it when it's called from the tick thread
+    void callOnRenderThread(const std::function<void()>& call) const;
+
+    // Dynamic resolution renders the 3D scene at a fraction of the view
+    // size adjusted after each frame to hold the target frame time, and
+    // scales it up before the overlay is drawn at the full resolution.
+    // The control is null while it's off.
+    void setDynamicResolution(bool);
+    bool getDynamicResolution() const;
+    celestia::engine::DynamicResolution* getDynamicResolutionControl() const;
+
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
     void showText(std::string_view s,
@@ -246,7 +283,13 @@ public:
     void addFavoriteFolder(const std::string&, FavoritesList::iterator* iter=nullptr);
     FavoritesList* getFavorites();
 
+    // With adaptive frame pacing, frontends draw only when
+    // viewUpdateRequired is true after the tick, and may wait
+    // getFrameWaitTime seconds for input before the next tick. draw
+    // records why each frame was drawn in the frame pacer.
     bool viewUpdateRequired() const;
+    double getFrameWaitTime() const;
+    celestia::FramePacer& getFramePacer();
 
     const DestinationList* getDestinations();
 
@@ -266,6 +309,8 @@ public:
 
     void runScript(const fs::path& filename, bool i18n = true);
     void cancelScript();
+    // Whether a script is loaded, including one which is paused
+    bool isScriptRunning() const { return m_script != nullptr; }
 
     int getHudDetail();
     void setHudDetail(int);
@@ -374,6 +419,7 @@ public:
 
 #ifdef USE_MINIAUDIO
     bool isPlayingAudio(int channel) const;
+    bool preloadAudio(int channel, const fs::path& path);
     bool playAudio(int channel, const fs::path& path, double startTime, float volume, float pan, bool loop, bool nopause);
     bool resumeAudio(int channel);
     void pauseAudio(int channel);
@@ -404,6 +450,7 @@ private:
     void updateSelectionFromInput();
     bool readStars(const CelestiaConfig&, ProgressNotifier*);
     void renderOverlay();
+    void finishMovieCapture();
 #ifdef CELX
     bool initLuaHook(ProgressNotifier*);
 #endif // CELX
@@ -470,6 +517,7 @@ private:
 
     MovieCapture* movieCapture{ nullptr };
     bool recording{ false };
+    bool movieCaptureEnding{ false };
 
 #ifdef USE_MINIAUDIO
     std::map<int, std::shared_ptr<celestia::AudioSession>> audioSessions;
@@ -486,15 +534,40 @@ private:
     std::vector<Url> history;
     std::vector<Url>::size_type historyCurrent{ 0 };
     std::string startURL;
+    // URLs parsed by goToUrl, so that going back to a bookmark needs no
+    // parsing or object lookups
+    std::unordered_map<std::string, std::unique_ptr<Url>> compiledUrls;
 
     std::unique_ptr<celestia::ViewManager> viewManager;
 
+    // Startup phases, recorded until the end of initRenderer
+    std::unique_ptr<celestia::StartupProfile> startupProfile;
+
+    // Thread running the ticks in threaded mode
+    std::unique_ptr<celestia::TickThread> tickThread;
+
+    std::uint64_t clusterFrameNumber{ 0 };
+
+    // Add-on catalogs, loaded again when they change
+    std::unique_ptr<celestia::CatalogWatcher> catalogWatcher;
+    // Add-on catalogs left to load after startup
+    struct PendingCatalogs;
+    std::unique_ptr<PendingCatalogs> pendingCatalogs;
+    void loadPendingCatalogs();
+    void dropReferences(const Selection& removed);
+
+    celestia::FramePacer framePacer;
+    celestia::FramePacer::State getFrameState() const;
+
     int distanceToScreen{ 400 };
 
     float pickTolerance { 4.0f };
 
     std::unique_ptr<ViewportEffect> viewportEffect { nullptr };
     bool isViewportEffectUsed { false };
+    std::unique_ptr<celestia::engine::DynamicResolution> dynamicResolution;
+    std::unique_ptr<ViewportEffect> dynamicResolutionEffect;
+    ViewportEffect* getActiveViewportEffect() const;
 
     ScriptSystemAccessPolicy scriptSystemAccessPolicy { ScriptSystemAccessPolicy::Ask };
 
@@ -0,0 +1,88 @@
+// clusterframe.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// State of a frame of a cluster master, applied by its render nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "clusterframe.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+
+namespace celestia
+{
+
+namespace
+{
+
+constexpr char ClusterFrameMagic[] = "CELCLSTR";
+constexpr std::size_t ClusterFrameMagicLength = sizeof(ClusterFrameMagic) - 1;
+constexpr std::uint16_t ClusterFrameVersion = 1;
+
+} // end unnamed namespace
+
+
+std::string
+ClusterFrame::encode() const
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    out.write(ClusterFrameMagic, ClusterFrameMagicLength);
+
+    auto urlLength = static_cast<std::uint16_t>(std::min(url.size(), std::size_t(std::numeric_limits<std::uint16_t>::max())));
+    util::writeLE<std::uint16_t>(out, ClusterFrameVersion);
+    util::writeLE<std::uint64_t>(out, number);
+    util::writeLE<double>(out, tdb);
+    util::writeLE<float>(out, faintestVisible);
+    util::writeLE<float>(out, ambientLight);
+    util::writeLE<std::int32_t>(out, orbitMask);
+    util::writeLE<std::int32_t>(out, starStyle);
+    util::writeLE<std::uint16_t>(out, urlLength);
+    out.write(url.data(), urlLength);
+    return out.str();
+}
+
+
+std::optional<ClusterFrame>
+ClusterFrame::decode(std::string_view data)
+{
+    if (data.size() < ClusterFrameMagicLength ||
+        std::memcmp(data.data(), ClusterFrameMagic, ClusterFrameMagicLength) != 0)
+    {
+        return std::nullopt;
+    }
+
+    std::istringstream in(std::string(data.substr(ClusterFrameMagicLength)), std::ios::in | std::ios::binary);
+
+    ClusterFrame frame;
+    std::uint16_t version;
+    std::uint16_t urlLength;
+    if (!util::readLE<std::uint16_t>(in, version) || version != ClusterFrameVersion ||
+        !util::readLE<std::uint64_t>(in, frame.number) ||
+        !util::readLE<double>(in, frame.tdb) ||
+        !util::readLE<float>(in, frame.faintestVisible) ||
+        !util::readLE<float>(in, frame.ambientLight) ||
+        !util::readLE<std::int32_t>(in, frame.orbitMask) ||
+        !util::readLE<std::int32_t>(in, frame.starStyle) ||
+        !util::readLE<std::uint16_t>(in, urlLength))
+    {
+        return std::nullopt;
+    }
+
+    frame.url.resize(urlLength);
+    if (urlLength > 0 && !in.read(frame.url.data(), urlLength).good())
+        return std::nullopt;
+
+    return frame;
+}
+
+} // end namespace celestia
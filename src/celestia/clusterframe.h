@@ -0,0 +1,47 @@
+// clusterframe.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// State of a frame of a cluster master, applied by its render nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace celestia
+{
+
+/*! The state of a frame rendered by the master of a cluster, where each
+ *  render node shows a part of the view, e.g. for one of the projectors
+ *  of a dome. The observer, frame, selection and render flags are held by
+ *  the cel URL of the frame, so that nodes find the objects by their
+ *  names; the exact time and the render settings which scripts change but
+ *  URLs don't hold are added to it.
+ *
+ *  Frames are numbered, so that render nodes can acknowledge them to a
+ *  swap barrier, and their encoding fits in a datagram. Sending them is
+ *  left to the frontends.
+ */
+struct ClusterFrame
+{
+    std::uint64_t number{ 0 };
+    double tdb{ 0.0 };
+    std::string url;
+    float faintestVisible{ 0.0f };
+    float ambientLight{ 0.0f };
+    std::int32_t orbitMask{ 0 };
+    std::int32_t starStyle{ 0 };
+
+    std::string encode() const;
+    static std::optional<ClusterFrame> decode(std::string_view data);
+};
+
+} // end namespace celestia
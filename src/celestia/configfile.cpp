@@ -11,6 +11,8 @@
 
 #include <config.h>
 #include <fstream>
+#include <optional>
+#include <string_view>
 #include <type_traits>
 
 #include <celengine/hash.h>
@@ -19,6 +21,7 @@
 #include <celengine/value.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include <celutil/tokenizer.h>
 
 
@@ -134,6 +137,10 @@ applyPaths(CelestiaConfig::Paths& paths, const Hash& hash)
 {
     applyPath(paths.starDatabaseFile, hash, "StarDatabase"sv);
     applyPath(paths.starNamesFile, hash, "StarNameDatabase"sv);
+    applyPath(paths.starOctreeCacheFile, hash, "StarOctreeCache"sv);
+    applyPath(paths.starTilesFile, hash, "StarTiles"sv);
+    applyPath(paths.starNameCacheFile, hash, "StarNameCache"sv);
+    applyPath(paths.galaxyFormCacheFile, hash, "GalaxyFormCache"sv);
     applyPathArray(paths.solarSystemFiles, hash, "SolarSystemCatalogs"sv);
     applyPathArray(paths.starCatalogFiles, hash, "StarCatalogs"sv);
     applyPathArray(paths.dsoCatalogFiles, hash, "DeepSkyCatalogs"sv);
@@ -150,6 +157,10 @@ applyPaths(CelestiaConfig::Paths& paths, const Hash& hash)
     applyPath(paths.GlieseCrossIndexFile, hash, "GlieseCrossIndex"sv);
     applyPath(paths.warpMeshFile, hash, "WarpMeshFile"sv);
     applyPath(paths.leapSecondsFile, hash, "LeapSecondsFile"sv);
+    applyPath(paths.startupReportFile, hash, "StartupReport"sv);
+    applyPath(paths.frameProfileFile, hash, "FrameProfileLog"sv);
+    applyPath(paths.shaderCacheDirectory, hash, "ShaderCacheDirectory"sv);
+    applyPath(paths.modelCacheDirectory, hash, "ModelCacheDirectory"sv);
 #ifdef CELX
     applyPath(paths.scriptScreenshotDirectory, hash, "ScriptScreenshotDirectory"sv);
     applyPath(paths.luaHook, hash, "LuaHook"sv);
@@ -182,14 +193,61 @@ applyRenderDetails(CelestiaConfig::RenderDetails& renderDetails, const Hash& has
     applyNumber(renderDetails.orbitWindowEnd, hash, "OrbitWindowEnd"sv);
     applyNumber(renderDetails.orbitPeriodsShown, hash, "OrbitPeriodsShown"sv);
     applyNumber(renderDetails.linearFadeFraction, hash, "LinearFadeFraction"sv);
+    applyBoolean(renderDetails.residentOrbitPaths, hash, "ResidentOrbitPaths"sv);
+    applyNumber(renderDetails.orbitSamplingThreads, hash, "OrbitSamplingThreads"sv);
+    applyNumber(renderDetails.orbitSamplingTime, hash, "OrbitSamplingTime"sv);
     applyNumber(renderDetails.faintestVisible, hash, "FaintestVisibleMagnitude"sv);
     applyNumber(renderDetails.shadowTextureSize, hash, "ShadowTextureSize"sv);
     applyNumber(renderDetails.eclipseTextureSize, hash, "EclipseTextureSize"sv);
     applyNumber(renderDetails.orbitPathSamplePoints, hash, "OrbitPathSamplePoints"sv);
     applyNumber(renderDetails.aaSamples, hash, "AntialiasingSamples"sv);
+    applyBoolean(renderDetails.postProcessAntialiasing, hash, "PostProcessAntialiasing"sv);
     applyNumber(renderDetails.SolarSystemMaxDistance, hash, "SolarSystemMaxDistance"sv);
     renderDetails.SolarSystemMaxDistance = std::clamp(renderDetails.SolarSystemMaxDistance, 1.0f, 10.0f);
     applyNumber(renderDetails.ShadowMapSize, hash, "ShadowMapSize"sv);
+    applyNumber(renderDetails.renderListThreads, hash, "RenderListThreads"sv);
+    applyNumber(renderDetails.starRenderThreads, hash, "StarRenderThreads"sv);
+    applyNumber(renderDetails.dsoRenderThreads, hash, "DSORenderThreads"sv);
+    applyNumber(renderDetails.starRenderTime, hash, "StarRenderTime"sv);
+    applyBoolean(renderDetails.gpuStarCulling, hash, "GPUStarCulling"sv);
+    applyNumber(renderDetails.textureLoadThreads, hash, "TextureLoadThreads"sv);
+    applyNumber(renderDetails.textureUploadTime, hash, "TextureUploadTime"sv);
+    applyNumber(renderDetails.virtualTextureCacheSize, hash, "VirtualTextureCacheSize"sv);
+    applyNumber(renderDetails.textureMemoryBudget, hash, "TextureMemoryBudget"sv);
+    applyBoolean(renderDetails.autoTextureResolution, hash, "AutoTextureResolution"sv);
+    applyNumber(renderDetails.geometryMemoryBudget, hash, "GeometryMemoryBudget"sv);
+    applyNumber(renderDetails.starTileMemoryBudget, hash, "StarTileMemoryBudget"sv);
+    applyNumber(renderDetails.nebulaLoadThreads, hash, "NebulaLoadThreads"sv);
+    applyNumber(renderDetails.nebulaUnloadTime, hash, "NebulaUnloadTime"sv);
+    applyBoolean(renderDetails.textureCache, hash, "TextureCache"sv);
+    applyNumber(renderDetails.textureSizeLimit, hash, "TextureSizeLimit"sv);
+    applyNumber(renderDetails.textureUploadChunkSize, hash, "TextureUploadChunkSize"sv);
+    applyBoolean(renderDetails.declutterLabels, hash, "DeclutterLabels"sv);
+    applyNumber(renderDetails.shaderWarmUpTime, hash, "ShaderWarmUpTime"sv);
+    applyNumber(renderDetails.terrainTriangleBudget, hash, "TerrainTriangleBudget"sv);
+    applyNumber(renderDetails.terrainUploadBudget, hash, "TerrainUploadBudget"sv);
+    applyNumber(renderDetails.terrainMemoryBudget, hash, "TerrainMemoryBudget"sv);
+    applyBoolean(renderDetails.scatteringTables, hash, "ScatteringTables"sv);
+    applyBoolean(renderDetails.optimizeModels, hash, "OptimizeModels"sv);
+    applyNumber(renderDetails.starFieldCacheSize, hash, "StarFieldCacheSize"sv);
+    applyBoolean(renderDetails.packedStarVertices, hash, "PackedStarVertices"sv);
+    applyBoolean(renderDetails.reversedDepth, hash, "ReversedDepth"sv);
+    applyNumber(renderDetails.stereoSeparation, hash, "StereoSeparation"sv);
+    applyBoolean(renderDetails.distanceFieldFonts, hash, "DistanceFieldFonts"sv);
+    applyBoolean(renderDetails.threadedTick, hash, "ThreadedTick"sv);
+    applyBoolean(renderDetails.adaptiveFramePacing, hash, "AdaptiveFramePacing"sv);
+    applyNumber(renderDetails.reducedFrameRate, hash, "ReducedFrameRate"sv);
+    applyNumber(renderDetails.idleFrameInterval, hash, "IdleFrameInterval"sv);
+    applyBoolean(renderDetails.dynamicResolution, hash, "DynamicResolution"sv);
+    applyNumber(renderDetails.targetFrameTime, hash, "TargetFrameTime"sv);
+    applyNumber(renderDetails.minResolutionScale, hash, "MinResolutionScale"sv);
+    if (auto subView = hash.getVector4<float>("SubView"sv); subView.has_value())
+    {
+        if (subView->z() > 0.0f && subView->w() > 0.0f)
+            renderDetails.subView = { subView->x(), subView->y(), subView->z(), subView->w() };
+        else
+            GetLogger()->error("Bad SubView in configuration file, the size must be positive.\n");
+    }
     applyStringArray(renderDetails.ignoreGLExtensions, hash, "IgnoreGLExtensions"sv);
 }
 
@@ -239,14 +297,27 @@ applyStarTextures(StarDetails::StarTextureSet& starTextures, const Hash& hash, s
 
 bool ReadCelestiaConfig(const fs::path& filename, CelestiaConfig& config)
 {
-    std::ifstream configFile(filename);
-    if (!configFile.good())
+    // Tokenize the mapped file in place, or read it if it can't be mapped
+    std::optional<celestia::util::MappedFile> mappedFile = celestia::util::MappedFile::open(filename);
+    std::ifstream configFile;
+    std::optional<Tokenizer> fileTokenizer;
+    if (mappedFile.has_value())
     {
-        GetLogger()->error("Error opening config file '{}'.\n", filename);
-        return false;
+        fileTokenizer.emplace(std::string_view(mappedFile->data(), mappedFile->size()));
+    }
+    else
+    {
+        configFile.open(filename);
+        if (!configFile.good())
+        {
+            GetLogger()->error("Error opening config file '{}'.\n", filename);
+            return false;
+        }
+
+        fileTokenizer.emplace(&configFile);
     }
 
-    Tokenizer tokenizer(&configFile);
+    Tokenizer& tokenizer = *fileTokenizer;
     Parser parser(&tokenizer);
 
     tokenizer.nextToken();
@@ -275,12 +346,16 @@ bool ReadCelestiaConfig(const fs::path& filename, CelestiaConfig& config)
     applyString(config.viewportEffect, *configParams, "ViewportEffect"sv);
     applyString(config.x264EncoderOptions, *configParams, "X264EncoderOptions"sv);
     applyString(config.ffvhEncoderOptions, *configParams, "FFVHEncoderOptions"sv);
+    applyBoolean(config.hardwareVideoEncoder, *configParams, "HardwareVideoEncoder"sv);
     applyString(config.measurementSystem, *configParams, "MeasurementSystem"sv);
     applyString(config.temperatureScale, *configParams, "TemperatureScale"sv);
     applyString(config.layoutDirection, *configParams, "LayoutDirection"sv);
     applyString(config.scriptSystemAccessPolicy, *configParams, "ScriptSystemAccessPolicy"sv);
 
     applyNumber(config.consoleLogRows, *configParams, "LogSize"sv);
+    applyNumber(config.workerThreads, *configParams, "WorkerThreads"sv);
+    applyBoolean(config.progressiveStartup, *configParams, "ProgressiveStartup"sv);
+    applyNumber(config.customOrbitTableSpan, *configParams, "CustomOrbitTableSpan"sv);
 
 #ifdef CELX
     // Move the value into the config object to retain ownership of the hash
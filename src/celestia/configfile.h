@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -25,6 +26,10 @@ struct CelestiaConfig
     {
         fs::path starDatabaseFile{ };
         fs::path starNamesFile{ };
+        fs::path starOctreeCacheFile{ };
+        fs::path starTilesFile{ };
+        fs::path starNameCacheFile{ };
+        fs::path galaxyFormCacheFile{ };
         std::vector<fs::path> solarSystemFiles{ };
         std::vector<fs::path> starCatalogFiles{ };
         std::vector<fs::path> dsoCatalogFiles{ };
@@ -41,6 +46,10 @@ struct CelestiaConfig
         fs::path GlieseCrossIndexFile{ };
         fs::path warpMeshFile{ };
         fs::path leapSecondsFile{ };
+        fs::path startupReportFile{ };
+        fs::path frameProfileFile{ };
+        fs::path shaderCacheDirectory{ };
+        fs::path modelCacheDirectory{ };
 #ifdef CELX
         fs::path scriptScreenshotDirectory{ };
         fs::path luaHook{ };
@@ -67,13 +76,56 @@ struct CelestiaConfig
         double orbitWindowEnd{ 0.5 };
         double orbitPeriodsShown{ 1.0 };
         double linearFadeFraction{ 0.0 };
+        bool residentOrbitPaths{ false };
+        unsigned int orbitSamplingThreads{ 0 };
+        double orbitSamplingTime{ 4.0 };
         float faintestVisible{ 6.0f };
         unsigned int shadowTextureSize{ 256 };
         unsigned int eclipseTextureSize{ 128 };
         unsigned int orbitPathSamplePoints{ 100 };
         unsigned int aaSamples{ 1 };
+        bool postProcessAntialiasing{ false };
         float SolarSystemMaxDistance{ 1.0f };
         unsigned int ShadowMapSize{ 0 };
+        unsigned int renderListThreads{ 1 };
+        unsigned int starRenderThreads{ 1 };
+        unsigned int dsoRenderThreads{ 1 };
+        double starRenderTime{ 0.0 };
+        bool gpuStarCulling{ false };
+        unsigned int textureLoadThreads{ 0 };
+        double textureUploadTime{ 4.0 };
+        unsigned int virtualTextureCacheSize{ 512 };
+        unsigned int textureMemoryBudget{ 0 };
+        bool autoTextureResolution{ false };
+        unsigned int geometryMemoryBudget{ 0 };
+        unsigned int starTileMemoryBudget{ 0 };
+        unsigned int nebulaLoadThreads{ 0 };
+        double nebulaUnloadTime{ 0.0 };
+        bool textureCache{ false };
+        unsigned int textureSizeLimit{ 0 };
+        unsigned int textureUploadChunkSize{ 0 };
+        bool declutterLabels{ false };
+        double shaderWarmUpTime{ 0.0 };
+        unsigned int terrainTriangleBudget{ 500000 };
+        unsigned int terrainUploadBudget{ 256 };
+        unsigned int terrainMemoryBudget{ 64 };
+        bool scatteringTables{ false };
+        bool optimizeModels{ true };
+        unsigned int starFieldCacheSize{ 0 };
+        bool packedStarVertices{ false };
+        bool reversedDepth{ false };
+        float stereoSeparation{ 0.0f };
+        bool distanceFieldFonts{ false };
+        bool threadedTick{ false };
+        bool adaptiveFramePacing{ false };
+        double reducedFrameRate{ 10.0 };
+        double idleFrameInterval{ 1.0 };
+        bool dynamicResolution{ false };
+        double targetFrameTime{ 1000.0 / 60.0 };
+        float minResolutionScale{ 0.5f };
+        // Part of the view shown by the window, [ x y width height ] as
+        // fractions of the view, for render nodes of a cluster
+        std::array<float, 4> subView{ 0.0f, 0.0f, 1.0f, 1.0f };
         std::vector<std::string> ignoreGLExtensions{ };
     };
 
@@ -94,6 +146,14 @@ struct CelestiaConfig
 
     unsigned int consoleLogRows{ 200 };
 
+    // Threads of the shared task scheduler, 0 = one less than the cores
+    unsigned int workerThreads{ 0 };
+
+    // Load the add-on solar system catalogs after the first frames
+    bool progressiveStartup{ false };
+
+    double customOrbitTableSpan{ 0.0 };
+
     std::string projectionMode{ };
     std::string viewportEffect{ };
     std::string measurementSystem{ };
@@ -101,6 +161,7 @@ struct CelestiaConfig
 
     std::string x264EncoderOptions{ };
     std::string ffvhEncoderOptions{ };
+    bool hardwareVideoEncoder{ false };
 
     std::string layoutDirection{ };
 
@@ -12,14 +12,26 @@
 
 #include "eclipsefinder.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
 #include <celengine/body.h>
 #include <celengine/star.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
 #include <celmath/distance.h>
+#include <celutil/taskscheduler.h>
 
 
 namespace math = celestia::math;
@@ -27,7 +39,6 @@ namespace math = celestia::math;
 namespace
 {
 
-constexpr double dT = 1.0 / (24.0 * 60.0);
 constexpr int EclipseObjectMask = Body::Planet      |
                                   Body::Moon        |
                                   Body::MinorMoon   |
@@ -37,102 +48,257 @@ constexpr int EclipseObjectMask = Body::Planet      |
 // TODO: share this constant and function with render.cpp
 constexpr float MinRelativeOccluderRadius = 0.005f;
 
+// The time range is searched in steps of one hour. Steps are grouped into
+// intervals of one day for the prefilter, and intervals into chunks of 30
+// days which are searched by the worker threads.
+constexpr double SearchStep = 1.0 / 24.0;
+constexpr long PrefilterSteps = 24;
+constexpr long ChunkSteps = PrefilterSteps * 30;
+
+// Precision of eclipse duration calculation
+constexpr double DurationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+
+// Safety factor for the estimated rate of change of the distance from
+// the shadow, which is computed at the ends of an interval only
+constexpr double PrefilterRateMargin = 1.5;
+
+
+struct SearchPair
+{
+    const Body* receiver;
+    const Body* caster;
+};
+
 
 bool
-testEclipse(const Body& receiver, const Body& caster, double now)
+canCastShadow(const Body& receiver, const Body& caster)
 {
     // Ignore situations where the shadow casting body is much smaller than
     // the receiver, as these shadows aren't likely to be relevant.  Also,
     // ignore eclipses where the caster is not an ellipsoid, since we can't
     // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.isEllipsoid())
+    return caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
+           caster.isEllipsoid();
+}
+
+
+// Radius of the shadow cylinder of the caster on the receiver. All of the
+// eclipse related code assumes that both the caster and receiver are
+// spherical.  Irregular receivers will work more or less correctly, but
+// casters that are sufficiently non-spherical will produce obviously
+// incorrect shadows.  Another assumption we make is that the distance
+// between the caster and receiver is much less than the distance between
+// the sun and the receiver.  This approximation works everywhere in the
+// solar system, and likely works for any orbitally stable pair of objects
+// orbiting a star.
+float
+shadowRadius(const Body& receiver, const Body& caster,
+             const Eigen::Vector3d& posReceiver, const Eigen::Vector3d& posCaster)
+{
+    const Star* sun = receiver.getSystem()->getStar();
+    assert(sun != nullptr);
+    double distToSun = posReceiver.norm();
+    float appSunRadius = (float) (sun->getRadius() / distToSun);
+
+    double distToCaster = (posCaster - posReceiver).norm() - receiver.getRadius();
+    float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
+
+    // The shadow radius is the radius of the occluder plus some additional
+    // amount that depends upon the apparent radius of the sun.  For
+    // a sun that's distant/small and effectively a point, the shadow
+    // radius will be the same as the radius of the occluder.
+    return (1 + appSunRadius / appOccluderRadius) * caster.getRadius();
+}
+
+
+bool
+testEclipse(const Body& receiver, const Body& caster, double now)
+{
+    Eigen::Vector3d posReceiver = receiver.getAstrocentricPosition(now);
+    Eigen::Vector3d posCaster = caster.getAstrocentricPosition(now);
+
+    // Test whether a shadow is cast on the receiver.  We want to know
+    // if the receiver lies within the shadow volume of the caster.  Since
+    // we're assuming that everything is a sphere and the sun is far
+    // away relative to the caster, the shadow volume is a
+    // cylinder capped at one end.  Testing for the intersection of a
+    // singly capped cylinder is as simple as checking the distance
+    // from the center of the receiver to the axis of the shadow cylinder.
+    // If the distance is less than the sum of the caster's and receiver's
+    // radii, then we have an eclipse.
+    float R = receiver.getRadius() + shadowRadius(receiver, caster, posReceiver, posCaster);
+    double dist = math::distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
+    if (dist < R)
     {
-        // All of the eclipse related code assumes that both the caster
-        // and receiver are spherical.  Irregular receivers will work more
-        // or less correctly, but casters that are sufficiently non-spherical
-        // will produce obviously incorrect shadows.  Another assumption we
-        // make is that the distance between the caster and receiver is much
-        // less than the distance between the sun and the receiver.  This
-        // approximation works everywhere in the solar system, and likely
-        // works for any orbitally stable pair of objects orbiting a star.
-        Eigen::Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Eigen::Vector3d posCaster = caster.getAstrocentricPosition(now);
-
-        const Star* sun = receiver.getSystem()->getStar();
-        assert(sun != nullptr);
-        double distToSun = posReceiver.norm();
-        float appSunRadius = (float) (sun->getRadius() / distToSun);
-
-        Eigen::Vector3d dir = posCaster - posReceiver;
-        double distToCaster = dir.norm() - receiver.getRadius();
-        float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
-
-        // The shadow radius is the radius of the occluder plus some additional
-        // amount that depends upon the apparent radius of the sun.  For
-        // a sun that's distant/small and effectively a point, the shadow
-        // radius will be the same as the radius of the occluder.
-        float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
-            caster.getRadius();
-
-        // Test whether a shadow is cast on the receiver.  We want to know
-        // if the receiver lies within the shadow volume of the caster.  Since
-        // we're assuming that everything is a sphere and the sun is far
-        // away relative to the caster, the shadow volume is a
-        // cylinder capped at one end.  Testing for the intersection of a
-        // singly capped cylinder is as simple as checking the distance
-        // from the center of the receiver to the axis of the shadow cylinder.
-        // If the distance is less than the sum of the caster's and receiver's
-        // radii, then we have an eclipse.
-        float R = receiver.getRadius() + shadowRadius;
-        double dist = math::distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
-        if (dist < R)
-        {
-            // Ignore "eclipses" where the caster and receiver have
-            // intersecting bounding spheres.
-            if (distToCaster > caster.getRadius())
-                return true;
-        }
+        // Ignore "eclipses" where the caster and receiver have
+        // intersecting bounding spheres.
+        double distToCaster = (posCaster - posReceiver).norm() - receiver.getRadius();
+        if (distToCaster > caster.getRadius())
+            return true;
     }
 
     return false;
 }
 
 
+// Distance of the receiver's bounding sphere from the shadow cylinder,
+// and an estimate of how fast it can change. The distance to the axis
+// changes at most with the relative velocity of the bodies, plus the
+// rotation of the axis with the caster's motion around the sun.
+struct ShadowClearance
+{
+    double clearance;
+    double rate;
+};
+
+
+ShadowClearance
+shadowClearance(const Body& receiver, const Body& caster, double now)
+{
+    Eigen::Vector3d posReceiver = receiver.getAstrocentricPosition(now);
+    Eigen::Vector3d posCaster = caster.getAstrocentricPosition(now);
+    Eigen::Vector3d velReceiver = receiver.getVelocity(now);
+    Eigen::Vector3d velCaster = caster.getVelocity(now);
+
+    float R = receiver.getRadius() + shadowRadius(receiver, caster, posReceiver, posCaster);
+    double dist = math::distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
+
+    double separation = (posCaster - posReceiver).norm();
+    double rate = (velCaster - velReceiver).norm() +
+                  separation * velCaster.norm() / posCaster.norm();
+    return ShadowClearance{ dist - R, rate };
+}
+
+
+// Refine the time of the start (direction -1) or end (direction 1) of an
+// eclipse which is in progress at time inside.
 double
-findEclipseSpan(const Body& receiver, const Body& caster,
-                double now, double dt)
+findEclipseBoundary(const Body& receiver, const Body& caster,
+                    double inside, double direction, long maxSteps)
+{
+    double outside = inside + direction * SearchStep;
+    for (long i = 0; i < maxSteps && testEclipse(receiver, caster, outside); ++i)
+    {
+        inside = outside;
+        outside += direction * SearchStep;
+    }
+
+    while (std::abs(outside - inside) > DurationPrecision)
+    {
+        double t = 0.5 * (inside + outside);
+        if (testEclipse(receiver, caster, t))
+            inside = t;
+        else
+            outside = t;
+    }
+
+    return 0.5 * (inside + outside);
+}
+
+
+// Position and rotation computations must not run concurrently if any
+// body of the search or the bodies they orbit have scripted or SPICE
+// orbits or rotations.
+bool
+isThreadSafe(const Body* body)
 {
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
+    for (; body != nullptr; body = body->getSystem()->getPrimaryBody())
+    {
+        const Timeline* timeline = body->getTimeline();
+        for (unsigned int i = 0; i < timeline->phaseCount(); ++i)
+        {
+            const TimelinePhase& phase = *timeline->getPhase(i);
+            if (!phase.orbit()->isThreadSafe() || !phase.rotationModel()->isThreadSafe())
+                return false;
+        }
+    }
 
-    return t;
+    return true;
 }
 
 
+class EclipseSearch
+{
+public:
+    EclipseSearch(std::vector<SearchPair>&& _pairs, double _startDate, double _endDate) :
+        pairs(std::move(_pairs)),
+        startDate(_startDate),
+        endDate(_endDate),
+        nSteps(static_cast<long>(std::floor((_endDate - _startDate) / SearchStep)) + 1),
+        nChunks(static_cast<std::size_t>((nSteps + ChunkSteps - 1) / ChunkSteps))
+    {
+    }
+
+    // Work items are ordered by chunk, so that the search progresses
+    // through the time range
+    std::size_t itemCount() const { return nChunks * pairs.size(); }
+    std::size_t chunkOf(std::size_t item) const { return item / pairs.size(); }
+
+    double chunkStart(std::size_t chunk) const
+    {
+        return std::min(timeAt(static_cast<long>(chunk) * ChunkSteps), endDate);
+    }
+
+    void search(std::size_t item, const std::atomic<bool>& abort, std::vector<Eclipse>& found) const;
+
+private:
+    double timeAt(long step) const { return startDate + static_cast<double>(step) * SearchStep; }
+
+    std::vector<SearchPair> pairs;
+    double startDate;
+    double endDate;
+    long nSteps;
+    std::size_t nChunks;
+};
+
+
 void
-addEclipse(const Body& receiver, const Body& occulter,
-           double now,
-           double /*startStep*/, double /*minStep*/,
-           std::vector<Eclipse>& eclipses,
-           std::vector<double>& previousEclipseEndTimes, int i)
+EclipseSearch::search(std::size_t item, const std::atomic<bool>& abort, std::vector<Eclipse>& found) const
 {
-    if (testEclipse(receiver, occulter, now))
+    const Body& receiver = *pairs[item % pairs.size()].receiver;
+    const Body& caster = *pairs[item % pairs.size()].caster;
+    long firstStep = static_cast<long>(chunkOf(item)) * ChunkSteps;
+    long lastStep = std::min(firstStep + ChunkSteps, nSteps);
+
+    double eclipseEnd = startDate - 1.0;
+    ShadowClearance next = shadowClearance(receiver, caster, timeAt(firstStep));
+    for (long intervalStart = firstStep; intervalStart < lastStep; intervalStart += PrefilterSteps)
     {
-        Eclipse eclipse;
-#if 1
-        eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
-        eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
-#else
-        eclipse.startTime = findEclipseStart(receiver, occulter, now, searchStep, minStep);
-        eclipse.endTime = findEclipseEnd(receiver, occulter, now, searchStep, minStep);
-#endif
-        eclipse.receiver = const_cast<Body*>(&receiver);
-        eclipse.occulter = const_cast<Body*>(&occulter);
-        eclipses.emplace_back(eclipse);
-
-        previousEclipseEndTimes[i] = eclipse.endTime;
+        if (abort.load(std::memory_order_relaxed))
+            return;
+
+        // Skip the steps of the interval if the receiver can't get into the
+        // shadow before the end of it
+        ShadowClearance current = next;
+        next = shadowClearance(receiver, caster, timeAt(intervalStart + PrefilterSteps));
+        double reach = PrefilterRateMargin * std::max(current.rate, next.rate) *
+                       (0.5 * static_cast<double>(PrefilterSteps) * SearchStep);
+        if (std::min(current.clearance, next.clearance) > reach)
+            continue;
+
+        long intervalEnd = std::min(intervalStart + PrefilterSteps, lastStep);
+        for (long step = intervalStart; step < intervalEnd; ++step)
+        {
+            // Only test for an eclipse if we're not in the middle of
+            // of previous one.
+            double t = timeAt(step);
+            if (t <= eclipseEnd || !testEclipse(receiver, caster, t))
+                continue;
+
+            eclipseEnd = findEclipseBoundary(receiver, caster, t, 1.0, nSteps);
+
+            // An eclipse in progress at the start of the chunk has been
+            // found by the previous chunk
+            if (step == firstStep && step > 0 && testEclipse(receiver, caster, timeAt(step - 1)))
+                continue;
+
+            Eclipse eclipse;
+            eclipse.startTime = findEclipseBoundary(receiver, caster, t, -1.0, nSteps);
+            eclipse.endTime = eclipseEnd;
+            eclipse.receiver = const_cast<Body*>(&receiver);
+            eclipse.occulter = const_cast<Body*>(&caster);
+            found.push_back(eclipse);
+        }
     }
 }
 
@@ -155,56 +321,143 @@ void EclipseFinder::findEclipses(double startDate,
     PlanetarySystem* satellites = body->getSatellites();
 
     // See if there's anything that could test
-    if (satellites == nullptr)
+    if (satellites == nullptr || endDate < startDate)
         return;
 
-    // For each body, we'll need to store the time when the last eclipse ended
-    std::vector<double> previousEclipseEndTimes;
-
     // Make a list of satellites that we'll actually test for eclipses; ignore
     // spacecraft and very small objects.
-    std::vector<Body*> testBodies;
+    std::vector<SearchPair> pairs;
+    bool threadSafe = isThreadSafe(body);
     for (int i = 0; i < satellites->getSystemSize(); i++)
     {
-        Body* obj = satellites->getBody(i);
-        if ((obj->getClassification() & EclipseObjectMask) != 0 &&
-            obj->getRadius() >= body->getRadius() * MinRelativeOccluderRadius)
+        const Body* obj = satellites->getBody(i);
+        if ((obj->getClassification() & EclipseObjectMask) == 0 ||
+            obj->getRadius() < body->getRadius() * MinRelativeOccluderRadius)
         {
-            testBodies.push_back(obj);
-            previousEclipseEndTimes.push_back(startDate - 1.0);
+            continue;
         }
+
+        std::size_t nPairs = pairs.size();
+        if ((eclipseTypeMask & Eclipse::Solar) != 0 && canCastShadow(*body, *obj))
+            pairs.push_back(SearchPair{ body, obj });
+        if ((eclipseTypeMask & Eclipse::Lunar) != 0 && canCastShadow(*obj, *body))
+            pairs.push_back(SearchPair{ obj, body });
+        if (pairs.size() != nPairs)
+            threadSafe = threadSafe && isThreadSafe(obj);
     }
 
-    if (testBodies.empty())
+    if (pairs.empty())
         return;
 
-    // TODO: Use a fixed step of one hour for now; we should use a binary
-    // search instead.
-    double searchStep = 1.0 / 24.0; // one hour
+    EclipseSearch search(std::move(pairs), startDate, endDate);
+    std::size_t nItems = search.itemCount();
+    std::size_t firstEclipse = eclipses.size();
+    std::atomic<bool> abort{ false };
 
-    // Precision of eclipse duration calculation
-    double durationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
-
-    for (double t = startDate; t <= endDate; t += searchStep)
+    auto deliver = [&](const Eclipse& eclipse)
     {
+        eclipses.push_back(eclipse);
         if (watcher != nullptr)
+            watcher->eclipseFinderEclipseFound(eclipse);
+    };
+
+    auto progress = [&](double t)
+    {
+        return watcher == nullptr ||
+               watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::ContinueOperation;
+    };
+
+    unsigned int nThreads = threadSafe
+        ? static_cast<unsigned int>(std::min<std::size_t>(celestia::util::TaskScheduler::get().getWorkerCount(), nItems))
+        : 1u;
+
+    if (nThreads == 1)
+    {
+        // Search on this thread, other threads may not even use the bodies
+        // while it is running
+        std::vector<Eclipse> found;
+        for (std::size_t item = 0; item < nItems; ++item)
         {
-            if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
+            if (!progress(search.chunkStart(search.chunkOf(item))))
                 return;
-        }
 
-        for (unsigned int i = 0; i < testBodies.size(); i++)
+            search.search(item, abort, found);
+            for (const Eclipse& eclipse : found)
+                deliver(eclipse);
+            found.clear();
+        }
+    }
+    else
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<Eclipse> pending;
+        std::vector<std::size_t> chunkItemsDone(search.chunkOf(nItems - 1) + 1, 0);
+        std::size_t itemsDone = 0;
+        std::atomic<std::size_t> nextItem{ 0 };
+
+        auto worker = [&]
         {
-            // Only test for an eclipse if we're not in the middle of
-            // of previous one.
-            if (t <= previousEclipseEndTimes[i])
-                continue;
+            std::vector<Eclipse> found;
+            for (;;)
+            {
+                std::size_t item = nextItem.fetch_add(1, std::memory_order_relaxed);
+                if (item >= nItems || abort.load(std::memory_order_relaxed))
+                    break;
+
+                search.search(item, abort, found);
+                {
+                    std::scoped_lock lock(mutex);
+                    pending.insert(pending.end(), found.begin(), found.end());
+                    ++chunkItemsDone[search.chunkOf(item)];
+                    ++itemsDone;
+                }
+                condition.notify_one();
+                found.clear();
+            }
+        };
+
+        // The search is a background computation, which leaves workers
+        // free for rendering
+        celestia::util::TaskGroup workers(celestia::util::TaskPriority::Background);
+        for (unsigned int i = 0; i < nThreads; ++i)
+            workers.run(worker);
+
+        // Report results and progress from this thread, so that watchers
+        // need not be thread-safe
+        std::vector<Eclipse> found;
+        std::size_t completeChunks = 0;
+        std::size_t pairsPerChunk = nItems / chunkItemsDone.size();
+        for (bool done = false; !done;)
+        {
+            {
+                std::unique_lock lock(mutex);
+                condition.wait_for(lock, std::chrono::milliseconds(50),
+                                   [&] { return !pending.empty() || itemsDone == nItems; });
+                found.swap(pending);
+                while (completeChunks < chunkItemsDone.size() && chunkItemsDone[completeChunks] == pairsPerChunk)
+                    ++completeChunks;
+                done = itemsDone == nItems;
+            }
+
+            for (const Eclipse& eclipse : found)
+                deliver(eclipse);
+            found.clear();
+
+            double t = completeChunks < chunkItemsDone.size() ? search.chunkStart(completeChunks) : endDate;
+            if (!done && !progress(t))
+            {
+                abort = true;
+                done = true;
+            }
+        }
 
-            if (eclipseTypeMask & Eclipse::Solar)
-                addEclipse(*body, *testBodies[i], t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+        workers.wait();
 
-            if (eclipseTypeMask & Eclipse::Lunar)
-                addEclipse(*testBodies[i], *body, t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
-        }
+        if (abort)
+            return;
     }
+
+    std::stable_sort(eclipses.begin() + static_cast<std::ptrdiff_t>(firstEclipse), eclipses.end(),
+                     [](const Eclipse& e0, const Eclipse& e1) { return e0.startTime < e1.startTime; });
 }
@@ -42,7 +42,15 @@ class EclipseFinderWatcher
         AbortOperation = 1,
     };
 
+    // Called with the time up to which the search is complete; eclipses
+    // starting before it have all been reported.
     virtual Status eclipseFinderProgressUpdate(double t) = 0;
+
+    // Called for each eclipse as soon as it is found. Eclipses are reported
+    // roughly, but not exactly in time order. Like the progress update,
+    // this is called on the thread calling findEclipses.
+    virtual void eclipseFinderEclipseFound(const Eclipse& /* eclipse */) {}
+
     virtual ~EclipseFinderWatcher() = default;
 };
 
@@ -52,6 +60,9 @@ class EclipseFinder
  public:
     EclipseFinder(Body*, EclipseFinderWatcher* = nullptr);
 
+    // Append the eclipses between startDate and endDate to eclipses,
+    // sorted by start time. The search runs on several threads unless an
+    // orbit or rotation model involved must not be used concurrently.
     void findEclipses(double startDate,
                       double endDate,
                       int eclipseTypeMask,
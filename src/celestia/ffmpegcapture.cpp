@@ -7,23 +7,44 @@ extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libavutil/timestamp.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/opt.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 }
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <fmt/format.h>
 
+#include <celengine/pixelreadback.h>
 #include <celengine/render.h>
 #include <celimage/pixelformat.h>
 
 using namespace std;
 using namespace celestia;
 
+namespace
+{
+
+// Frames captured but not yet encoded; capturing waits when the encoder
+// falls this far behind
+constexpr std::size_t MaxQueuedFrames = 4;
+
+} // end unnamed namespace
+
 // a wrapper around a single output AVStream
+//
+// Frames are read back through a ring of pixel buffers when the driver
+// supports them, so that the render thread doesn't wait for the GPU, and
+// converted and encoded on a thread of their own.
 class FFMPEGCapturePrivate
 {
     FFMPEGCapturePrivate() = default;
@@ -31,9 +52,18 @@ class FFMPEGCapturePrivate
 
     bool init(const fs::path& fn);
     bool addStream(int w, int h, float fps);
+    bool configureEncoder(int w, int h);
+    bool openHardwareEncoder();
     bool openVideo();
     bool start();
-    bool writeVideoFrame(bool = false);
+    bool captureFrame();
+    bool queueReadback();
+    std::vector<std::uint8_t> takeBuffer();
+    void queueFrame(std::vector<std::uint8_t>&&);
+    void encodeFrames();
+    void stopEncoder();
+    bool writeVideoFrame(const std::uint8_t* pixels);
+    bool sendFrame(AVFrame*);
     void finish();
     void setVideoCodec(int);
 
@@ -43,7 +73,6 @@ class FFMPEGCapturePrivate
 
     AVStream        *st       { nullptr };
     AVFrame         *frame    { nullptr };
-    AVFrame         *tmpfr    { nullptr };
     AVCodecContext  *enc      { nullptr };
     AVFormatContext *oc       { nullptr };
     const AVCodec   *vc       { nullptr };
@@ -52,8 +81,10 @@ class FFMPEGCapturePrivate
 
     const Renderer  *renderer { nullptr };
 
-    // pts of the next frame that will be generated
+    // pts of the next frame that will be generated, on the encoder thread
     int64_t         nextPts   { 0       };
+    // frames captured, on the render thread
+    int             captured  { 0       };
     // requested bitrate
     int64_t         bit_rate  { 400000  };
 
@@ -62,10 +93,24 @@ class FFMPEGCapturePrivate
     float           fps       { 0       };
     bool            capturing { false   };
     bool            hasAlpha  { false   };
+    bool            hardware  { false   };
 
     fs::path        filename;
     std::string     vc_options;
 
+    std::unique_ptr<engine::PixelReadback> readback;
+    std::size_t     frameSize { 0       };
+    int             stride    { 0       };
+
+    // frames waiting for the encoder and buffers it's done with
+    std::mutex      mutex;
+    std::condition_variable cond;
+    std::deque<std::vector<std::uint8_t>> queue;
+    std::vector<std::vector<std::uint8_t>> spare;
+    bool            stopping  { false   };
+    bool            failed    { false   };
+    std::thread     encoder;
+
  public:
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)) // ffmpeg < 4.0
     static bool     registered;
@@ -229,6 +274,25 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     }
     st->id = oc->nb_streams - 1;
 
+    // timebase: This is the fundamental unit of time (in seconds) in terms
+    // of which frame timestamps are represented. For fixed-fps content,
+    // timebase should be 1/framerate and timestamp increments should be
+    // identical to 1.
+    if (abs(fps - 29.97f) < 1e-5f)
+        st->time_base = { 1001, 30000 };
+    else if (abs(fps - 23.976f) < 1e-5f)
+        st->time_base = { 1001, 24000 };
+    else
+        st->time_base = { 1, (int) fps };
+    st->avg_frame_rate = { st->time_base.den, st->time_base.num };
+
+    return configureEncoder(width, height);
+}
+
+// allocate a context for the encoder vc
+bool FFMPEGCapturePrivate::configureEncoder(int width, int height)
+{
+    avcodec_free_context(&enc);
     enc = avcodec_alloc_context3(vc);
     if (enc == nullptr)
     {
@@ -247,19 +311,9 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     // Resolution must be a multiple of two
     enc->width     = width;
     enc->height    = height;
-    // timebase: This is the fundamental unit of time (in seconds) in terms
-    // of which frame timestamps are represented. For fixed-fps content,
-    // timebase should be 1/framerate and timestamp increments should be
-    // identical to 1.
-    if (abs(fps - 29.97f) < 1e-5f)
-        st->time_base = { 1001, 30000 };
-    else if (abs(fps - 23.976f) < 1e-5f)
-        st->time_base = { 1001, 24000 };
-    else
-        st->time_base = { 1, (int) fps };
 
     enc->time_base = st->time_base;
-    enc->framerate = st->avg_frame_rate = { st->time_base.den, st->time_base.num };
+    enc->framerate = st->avg_frame_rate;
     enc->gop_size  = 12; // emit one intra frame every twelve frames at most
 
     // find a best pixel format to convert to from `format`
@@ -292,6 +346,43 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     return true;
 }
 
+// open the first hardware encoder for the codec which accepts frames in
+// system memory; encoders which need frames uploaded to the device fail
+// to open and are skipped
+bool FFMPEGCapturePrivate::openHardwareEncoder()
+{
+#if (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 10, 100)) // ffmpeg >= 4.0
+    const AVCodec *software = vc;
+    int width = enc->width;
+    int height = enc->height;
+
+    void *it = nullptr;
+    while ((vc = av_codec_iterate(&it)) != nullptr)
+    {
+        if (vc->id != vc_id || !av_codec_is_encoder(vc) ||
+            (vc->capabilities & AV_CODEC_CAP_HARDWARE) == 0)
+        {
+            continue;
+        }
+
+        AVDictionary *opts = nullptr;
+        av_dict_parse_string(&opts, vc_options.c_str(), "=", ",", 0);
+        bool opened = configureEncoder(width, height) && avcodec_open2(enc, vc, &opts) >= 0;
+        av_dict_free(&opts);
+        if (opened)
+        {
+            fmt::print("Using hardware encoder {}\n", vc->name);
+            return true;
+        }
+    }
+
+    vc = software;
+    if (!configureEncoder(width, height))
+        return false;
+#endif
+    return false;
+}
+
 bool FFMPEGCapturePrivate::start()
 {
     // open the output file, if needed
@@ -324,28 +415,34 @@ bool FFMPEGCapturePrivate::start()
 
 bool FFMPEGCapturePrivate::openVideo()
 {
-    AVDictionary *opts = nullptr;
-    const char *str = "";
+    if (!hardware || !openHardwareEncoder())
+    {
+        if (enc == nullptr)
+            return false;
 
-    if (av_dict_parse_string(&opts, vc_options.c_str(), "=", ",", 0) != 0)
-        cout << "Failed to parse error codec parameters\n";
 
-    // open the codec
-    if (avcodec_open2(enc, vc, &opts) < 0)
-    {
-        cout << "Failed to open the codec\n";
-        av_dict_free(&opts);
-        return false;
-    }
+        AVDictionary *opts = nullptr;
 
-    if (av_dict_count(opts) > 0)
-    {
-        cout << "Unrecognized options:\n";
-        AVDictionaryEntry *t = nullptr;
-        while ((t = av_dict_get(opts, "", t, AV_DICT_IGNORE_SUFFIX)) != nullptr)
-            fmt::print("\t{}={}\n", t->key, t->value);
+        if (av_dict_parse_string(&opts, vc_options.c_str(), "=", ",", 0) != 0)
+            cout << "Failed to parse error codec parameters\n";
+
+        // open the codec
+        if (avcodec_open2(enc, vc, &opts) < 0)
+        {
+            cout << "Failed to open the codec\n";
+            av_dict_free(&opts);
+            return false;
+        }
+
+        if (av_dict_count(opts) > 0)
+        {
+            cout << "Unrecognized options:\n";
+            AVDictionaryEntry *t = nullptr;
+            while ((t = av_dict_get(opts, "", t, AV_DICT_IGNORE_SUFFIX)) != nullptr)
+                fmt::print("\t{}={}\n", t->key, t->value);
+        }
+        av_dict_free(&opts);
     }
-    av_dict_free(&opts);
 
     // allocate and init a re-usable frame
     if ((frame = av_frame_alloc()) == nullptr)
@@ -377,82 +474,174 @@ bool FFMPEGCapturePrivate::openVideo()
             cout << "Failed to allocate SWS context\n";
             return false;
         }
+    }
 
-        // allocate and init a temporary frame
-        if((tmpfr = av_frame_alloc()) == nullptr)
-        {
-            cout << "Failed to allocate temp frame\n";
+    engine::PixelFormat captureFormat = renderer->getPreferredCaptureFormat();
+    frameSize = engine::PixelReadback::frameSize(enc->width, enc->height, captureFormat);
+    stride = static_cast<int>(engine::PixelReadback::frameSize(enc->width, 1, captureFormat));
+    if (engine::PixelReadback::isSupported())
+        readback = std::make_unique<engine::PixelReadback>(*renderer);
+
+    // copy the stream parameters to the muxer
+    if (avcodec_parameters_from_context(st->codecpar, enc) < 0)
+    {
+        cout << "Failed to copy the stream parameters to the muxer\n";
+        return false;
+    }
+
+    return true;
+}
+
+// read the centered frame back; the pixels of the oldest pending read are
+// queued for encoding once all the pixel buffers are in use
+bool FFMPEGCapturePrivate::captureFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed)
             return false;
-        }
+    }
 
-        tmpfr->format = format;
-        tmpfr->width  = enc->width;
-        tmpfr->height = enc->height;
+    int x, y, w, h;
+    renderer->getViewport(&x, &y, &w, &h);
 
-        // allocate the buffers for the frame data
-        if (av_frame_get_buffer(tmpfr, 32) < 0)
-        {
-            cout << "Failed to allocate temp frame buffer\n";
+    x += (w - enc->width) / 2;
+    y += (h - enc->height) / 2;
+    engine::PixelFormat captureFormat = renderer->getPreferredCaptureFormat();
+
+    if (readback != nullptr)
+    {
+        if (readback->full() && !queueReadback())
             return false;
+        if (readback->read(x, y, enc->width, enc->height, captureFormat))
+        {
+            ++captured;
+            return true;
         }
+
+        // fall back to synchronous reads for the rest of the recording
+        cout << "Failed to read the frame into a pixel buffer\n";
+        while (readback->pending() > 0)
+        {
+            if (!queueReadback())
+                return false;
+        }
+        readback.reset();
     }
 
-    // copy the stream parameters to the muxer
-    if (avcodec_parameters_from_context(st->codecpar, enc) < 0)
+    std::vector<std::uint8_t> pixels = takeBuffer();
+    if (!renderer->captureFrame(x, y, enc->width, enc->height, captureFormat, pixels.data()))
+        return false;
+
+    queueFrame(std::move(pixels));
+    ++captured;
+    return true;
+}
+
+bool FFMPEGCapturePrivate::queueReadback()
+{
+    std::vector<std::uint8_t> pixels = takeBuffer();
+    if (!readback->take(pixels.data()))
     {
-        cout << "Failed to copy the stream parameters to the muxer\n";
+        cout << "Failed to map the pixel buffer\n";
         return false;
     }
 
+    queueFrame(std::move(pixels));
     return true;
 }
 
-static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+// a buffer for a frame, waiting while the encoder is behind
+std::vector<std::uint8_t> FFMPEGCapturePrivate::takeBuffer()
 {
-    int x, y, w, h;
-    r->getViewport(&x, &y, &w, &h);
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this] { return queue.size() < MaxQueuedFrames || failed; });
 
-    x += (w - width) / 2;
-    y += (h - height) / 2;
-    r->captureFrame(x, y, width, height,
-                    r->getPreferredCaptureFormat(),
-                    pict->data[0]);
+    std::vector<std::uint8_t> pixels;
+    if (!spare.empty())
+    {
+        pixels = std::move(spare.back());
+        spare.pop_back();
+    }
+    pixels.resize(frameSize);
+    return pixels;
 }
 
-// encode one video frame and send it to the muxer
-// return 1 when encoding is finished, 0 otherwise
-bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
+void FFMPEGCapturePrivate::queueFrame(std::vector<std::uint8_t>&& pixels)
 {
-    AVFrame *frame = finalize ? nullptr : this->frame;
-    const int bytesPerPixel = hasAlpha ? 4 : 3;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(pixels));
+    }
+    cond.notify_all();
+}
 
-    // check if we want to generate more frames
-    if (!finalize)
+// the encoder thread
+void FFMPEGCapturePrivate::encodeFrames()
+{
+    for (;;)
     {
-        // when we pass a frame to the encoder, it may keep a reference to it
-        // internally; make sure we do not overwrite it here
-        if (av_frame_make_writable(frame) < 0)
+        std::vector<std::uint8_t> pixels;
         {
-            cout << "Failed to make the frame writable\n";
-            return false;
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return !queue.empty() || stopping; });
+            if (queue.empty())
+                return;
+            pixels = std::move(queue.front());
+            queue.pop_front();
         }
+        cond.notify_all();
+
+        bool ok = writeVideoFrame(pixels.data());
 
-        if (enc->pix_fmt != format)
-        {
-            captureImage(tmpfr, enc->width, enc->height, renderer);
-            // we need to compute the correct line width of our source data
-            const int linesize = bytesPerPixel * enc->width;
-            sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
-                      frame->data, frame->linesize);
-        }
-        else
         {
-            captureImage(frame, enc->width, enc->height, renderer);
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(std::move(pixels));
+            if (!ok)
+            {
+                failed = true;
+                queue.clear();
+            }
         }
+        cond.notify_all();
 
-        frame->pts = nextPts++;
+        if (!ok)
+            return;
+    }
+}
+
+// convert one video frame, encode it and send it to the muxer
+bool FFMPEGCapturePrivate::writeVideoFrame(const std::uint8_t* pixels)
+{
+    // when we pass a frame to the encoder, it may keep a reference to it
+    // internally; make sure we do not overwrite it here
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
+
+    if (enc->pix_fmt != format)
+    {
+        sws_scale(swsc, &pixels, &stride, 0, enc->height,
+                  frame->data, frame->linesize);
     }
+    else
+    {
+        const int bytesPerPixel = hasAlpha ? 4 : 3;
+        av_image_copy_plane(frame->data[0], frame->linesize[0],
+                            pixels, stride,
+                            bytesPerPixel * enc->width, enc->height);
+    }
+
+    frame->pts = nextPts++;
+    return sendFrame(frame);
+}
 
+// encode a frame, or flush the encoder when frame is null, and write the
+// packets it returns
+bool FFMPEGCapturePrivate::sendFrame(AVFrame *frame)
+{
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100))
     av_init_packet(pkt);
 #endif
@@ -487,9 +676,29 @@ bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
     return true;
 }
 
+void FFMPEGCapturePrivate::stopEncoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    if (encoder.joinable())
+        encoder.join();
+}
+
 void FFMPEGCapturePrivate::finish()
 {
-    writeVideoFrame(true);
+    // the frames still in the pixel buffers
+    if (readback != nullptr)
+    {
+        while (readback->pending() > 0 && queueReadback())
+            ;
+        readback.reset();
+    }
+
+    stopEncoder();
+    sendFrame(nullptr);
 
     // Write the trailer, if any. The trailer must be written before you
     // close the CodecContexts open when you wrote the header; otherwise
@@ -503,10 +712,10 @@ void FFMPEGCapturePrivate::finish()
 
 FFMPEGCapturePrivate::~FFMPEGCapturePrivate()
 {
+    stopEncoder();
     avcodec_free_context(&enc);
     av_frame_free(&frame);
-    if (tmpfr != nullptr)
-        av_frame_free(&tmpfr);
+    sws_freeContext(swsc);
     avformat_free_context(oc);
     av_packet_free(&pkt);
 }
@@ -527,7 +736,7 @@ FFMPEGCapture::~FFMPEGCapture()
 
 int FFMPEGCapture::getFrameCount() const
 {
-    return d->nextPts;
+    return d->captured;
 }
 
 int FFMPEGCapture::getWidth() const
@@ -555,6 +764,7 @@ bool FFMPEGCapture::start(const fs::path& filename, int width, int height, float
         return false;
     }
 
+    d->encoder = std::thread(&FFMPEGCapturePrivate::encodeFrames, d);
     d->capturing = true; // XXX
 
     return true;
@@ -574,7 +784,7 @@ bool FFMPEGCapture::end()
 
 bool FFMPEGCapture::captureFrame()
 {
-    return d->capturing && d->writeVideoFrame();
+    return d->capturing && d->captureFrame();
 }
 
 void FFMPEGCapture::setVideoCodec(AVCodecID vc_id)
@@ -591,3 +801,8 @@ void FFMPEGCapture::setEncoderOptions(const std::string &s)
 {
     d->vc_options = s;
 }
+
+void FFMPEGCapture::setHardwareEncoding(bool hardware)
+{
+    d->hardware = hardware;
+}
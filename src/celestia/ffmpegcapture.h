@@ -32,6 +32,7 @@ public:
     void setVideoCodec(AVCodecID);
     void setBitRate(int64_t);
     void setEncoderOptions(const std::string&);
+    void setHardwareEncoding(bool);
 
 protected:
     void recordingStatusUpdated(bool) override { /* no action necessary */ };
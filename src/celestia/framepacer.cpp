@@ -0,0 +1,188 @@
+// framepacer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Decides when frames need to be rendered.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "framepacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std::string_view_literals;
+
+namespace celestia
+{
+
+std::string_view
+FramePacer::reasonName(Reason reason)
+{
+    switch (reason)
+    {
+    case Reason::None:       return "none"sv;
+    case Reason::Continuous: return "continuous"sv;
+    case Reason::Requested:  return "requested"sv;
+    case Reason::Settings:   return "settings"sv;
+    case Reason::Motion:     return "motion"sv;
+    case Reason::Script:     return "script"sv;
+    case Reason::Time:       return "time"sv;
+    case Reason::SlowChange: return "slow change"sv;
+    case Reason::Refresh:    return "refresh"sv;
+    }
+
+    return "none"sv;
+}
+
+void
+FramePacer::setAdaptive(bool adaptive)
+{
+    m_adaptive = adaptive;
+    m_frameRequested = true;
+}
+
+bool
+FramePacer::isAdaptive() const
+{
+    return m_adaptive;
+}
+
+void
+FramePacer::setReducedFrameRate(double rate)
+{
+    if (rate > 0.0)
+        m_reducedInterval = 1.0 / rate;
+}
+
+double
+FramePacer::getReducedFrameRate() const
+{
+    return 1.0 / m_reducedInterval;
+}
+
+void
+FramePacer::setIdleFrameInterval(double interval)
+{
+    if (interval > 0.0)
+        m_idleInterval = interval;
+}
+
+double
+FramePacer::getIdleFrameInterval() const
+{
+    return m_idleInterval;
+}
+
+void
+FramePacer::requestFrame()
+{
+    m_frameRequested = true;
+}
+
+FramePacer::Reason
+FramePacer::classify(const State& state, double now) const
+{
+    if (!m_adaptive || state.recording)
+        return Reason::Continuous;
+    if (m_frameRequested)
+        return Reason::Requested;
+    if (state.settingsChanged)
+        return Reason::Settings;
+    if (state.moving)
+        return Reason::Motion;
+    if (state.scriptRunning)
+        return Reason::Script;
+
+    if (state.timeScale != 0.0)
+    {
+        // With time running the camera follows its frame, so its
+        // universal position isn't compared
+        return std::abs(state.timeScale) > SlowTimeScale ? Reason::Time : Reason::SlowChange;
+    }
+
+    if (state.simTime != m_lastState.simTime)
+        return Reason::Time;
+    if (viewsChanged(state))
+        return Reason::Motion;
+
+    if (now >= state.overlayChangeStart && m_lastFrameTime < state.overlayChangeEnd)
+        return Reason::SlowChange;
+
+    return Reason::None;
+}
+
+bool
+FramePacer::viewsChanged(const State& state) const
+{
+    if (state.views.size() != m_lastState.views.size())
+        return true;
+
+    return !std::equal(state.views.begin(), state.views.end(), m_lastState.views.begin(),
+                       [](const ViewState& a, const ViewState& b)
+                       {
+                           return a.position.x == b.position.x &&
+                                  a.position.y == b.position.y &&
+                                  a.position.z == b.position.z &&
+                                  a.orientation.coeffs() == b.orientation.coeffs() &&
+                                  a.fov == b.fov;
+                       });
+}
+
+FramePacer::Reason
+FramePacer::evaluate(const State& state, double now) const
+{
+    Reason reason = classify(state, now);
+    if (reason == Reason::SlowChange && now - m_lastFrameTime < m_reducedInterval)
+        reason = Reason::None;
+    if (reason == Reason::None && now - m_lastFrameTime >= m_idleInterval)
+        reason = Reason::Refresh;
+
+    return reason;
+}
+
+double
+FramePacer::waitTime(const State& state, double now) const
+{
+    Reason reason = classify(state, now);
+    if (reason != Reason::None && reason != Reason::SlowChange)
+        return 0.0;
+
+    double next = m_lastFrameTime + m_idleInterval;
+    if (reason == Reason::SlowChange)
+        next = std::min(next, m_lastFrameTime + m_reducedInterval);
+    else if (state.overlayChangeStart > now)
+        next = std::min(next, state.overlayChangeStart);
+
+    return std::max(0.0, next - now);
+}
+
+void
+FramePacer::frameRendered(const State& state, double now, Reason reason)
+{
+    if (reason == Reason::None)
+        reason = Reason::Requested;
+
+    m_frameRequested = false;
+    m_lastFrameTime = now;
+    m_lastState = state;
+    m_lastReason = reason;
+    ++m_frameCounts[static_cast<std::size_t>(reason)];
+}
+
+FramePacer::Reason
+FramePacer::lastReason() const
+{
+    return m_lastReason;
+}
+
+std::uint64_t
+FramePacer::frameCount(Reason reason) const
+{
+    return m_frameCounts[static_cast<std::size_t>(reason)];
+}
+
+} // end namespace celestia
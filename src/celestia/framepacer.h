@@ -0,0 +1,128 @@
+// framepacer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Decides when frames need to be rendered.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <celengine/univcoord.h>
+
+namespace celestia
+{
+
+/*! Decides whether a frame has to be rendered, so that frontends can skip
+ *  frames which would be the same as the last one. Frames are rendered at
+ *  the full rate while the camera moves, time runs fast or a script runs,
+ *  at a reduced rate while only slowly changing things like the clock or
+ *  a fading message change, and otherwise only when something requests
+ *  one or the idle interval elapses, so that resources loaded in the
+ *  background still show up.
+ *
+ *  When adaptive pacing is off every frame is rendered, which is the
+ *  default. Times are the wall clock times of the core in seconds.
+ */
+class FramePacer
+{
+public:
+    enum class Reason : int
+    {
+        None       = 0,
+        Continuous = 1, // adaptive pacing is off or a movie is recorded
+        Requested  = 2, // input, resize or a frontend asked for the frame
+        Settings   = 3, // render settings changed
+        Motion     = 4, // the camera moves
+        Script     = 5,
+        Time       = 6, // time runs fast or was changed
+        SlowChange = 7, // time runs slowly or the overlay fades
+        Refresh    = 8, // the idle interval elapsed
+    };
+
+    static constexpr std::size_t ReasonCount = 9;
+
+    // Time rates up to which time running is a slow change
+    static constexpr double SlowTimeScale = 1.0;
+
+    struct ViewState
+    {
+        UniversalCoord position;
+        Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+        float fov{ 0.0f };
+    };
+
+    // What the core renders, sampled after the tick
+    struct State
+    {
+        std::vector<ViewState> views;
+        double simTime{ 0.0 };
+        // Zero when time is paused
+        double timeScale{ 0.0 };
+        bool moving{ false };
+        bool settingsChanged{ false };
+        bool scriptRunning{ false };
+        bool recording{ false };
+        // Interval in which the overlay changes by itself
+        double overlayChangeStart{ -std::numeric_limits<double>::infinity() };
+        double overlayChangeEnd{ -std::numeric_limits<double>::infinity() };
+    };
+
+    static std::string_view reasonName(Reason);
+
+    void setAdaptive(bool);
+    bool isAdaptive() const;
+    // Frames per second while only slow changes happen
+    void setReducedFrameRate(double);
+    double getReducedFrameRate() const;
+    // Longest time without a frame when nothing changes, infinite for none
+    void setIdleFrameInterval(double);
+    double getIdleFrameInterval() const;
+
+    // Render the next frame whatever the state
+    void requestFrame();
+
+    // Why a frame should be rendered now, or Reason::None
+    Reason evaluate(const State&, double now) const;
+    // Seconds a frontend may wait for input before it ticks and evaluates
+    // again, 0 when frames are rendered at the full rate
+    double waitTime(const State&, double now) const;
+    // Record a rendered frame; reason is None for a frame the frontend drew
+    // without asking, like on an expose event
+    void frameRendered(const State&, double now, Reason reason);
+
+    // Reason of the last rendered frame, and the count of frames rendered
+    // for each reason
+    Reason lastReason() const;
+    std::uint64_t frameCount(Reason) const;
+
+private:
+    // The reason of a frame at the full rate, SlowChange or None, ignoring
+    // when the last frame was rendered
+    Reason classify(const State&, double now) const;
+    bool viewsChanged(const State&) const;
+
+    bool m_adaptive{ false };
+    double m_reducedInterval{ 0.1 };
+    double m_idleInterval{ 1.0 };
+
+    bool m_frameRequested{ true };
+    double m_lastFrameTime{ -std::numeric_limits<double>::infinity() };
+    State m_lastState;
+    Reason m_lastReason{ Reason::None };
+    std::array<std::uint64_t, ReasonCount> m_frameCounts{};
+};
+
+} // end namespace celestia
@@ -0,0 +1,740 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// A frontend without a window: renders the frames of a script or the views
+// of a list of URLs into an offscreen EGL surface and writes them as images
+// or a movie, or runs the render benchmark. The simulation advances by a fixed step per frame, so frames
+// are rendered as fast as the GPU allows rather than in real time.
+//
+// As the stepping doesn't depend on the wall clock, a long script can be
+// rendered by a farm of nodes, each running it from the same start time
+// and only drawing its own range of frames into a shared directory.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <epoxy/egl.h>
+#include <fmt/format.h>
+
+#include <celcompat/filesystem.h>
+#include <celengine/glsupport.h>
+#include <celengine/render.h>
+#include <celimage/image.h>
+#include <celutil/filetype.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <celutil/taskscheduler.h>
+#include <celestia/celestiacore.h>
+#include <celestia/renderbenchmark.h>
+#ifdef USE_FFMPEG
+#include <celestia/ffmpegcapture.h>
+#endif
+
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+using celestia::util::GetLogger;
+using celestia::util::TaskPriority;
+using celestia::util::TaskScheduler;
+
+namespace
+{
+
+struct Options
+{
+    int width{ 1920 };
+    int height{ 1080 };
+    int samples{ 0 };
+    double fps{ 30.0 };
+    int maxFrames{ 0 };
+    int firstFrame{ 0 };
+    int settleFrames{ 20 };
+    std::optional<double> startTime;
+    fs::path configFileName;
+    std::vector<fs::path> extrasDirs;
+    fs::path dataDir;
+    std::string startURL;
+    fs::path scriptFileName;
+    fs::path urlListFileName;
+    fs::path outputDirectory;
+    ContentType imageType{ ContentType::PNG };
+    fs::path movieFileName;
+    fs::path benchmarkFileName;
+    celestia::RenderBenchmark::Options benchmark;
+};
+
+
+class HeadlessAlerter : public CelestiaCore::Alerter
+{
+public:
+    void fatalError(const std::string& msg) override
+    {
+        std::cerr << msg << '\n';
+    }
+};
+
+
+// An EGL context rendering into a pbuffer of the output size, which needs
+// neither a window system nor a display on GPU servers
+class OffscreenContext
+{
+public:
+    OffscreenContext() = default;
+    ~OffscreenContext();
+
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    bool create(int width, int height, int samples);
+
+private:
+    EGLDisplay display{ EGL_NO_DISPLAY };
+    EGLSurface surface{ EGL_NO_SURFACE };
+    EGLContext context{ EGL_NO_CONTEXT };
+};
+
+
+OffscreenContext::~OffscreenContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglTerminate(display);
+}
+
+
+bool
+OffscreenContext::create(int width, int height, int samples)
+{
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+#ifdef GL_ES
+    constexpr EGLint renderableType = EGL_OPENGL_ES2_BIT;
+    constexpr EGLenum api = EGL_OPENGL_ES_API;
+#else
+    constexpr EGLint renderableType = EGL_OPENGL_BIT;
+    constexpr EGLenum api = EGL_OPENGL_API;
+#endif
+
+    const std::array<EGLint, 19> configAttribs
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, renderableType,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_SAMPLE_BUFFERS, samples > 0 ? 1 : 0,
+        EGL_SAMPLES, samples,
+        EGL_NONE,
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs.data(), &config, 1, &configCount) || configCount == 0)
+    {
+        GetLogger()->error("No EGL configuration supports {} samples\n", samples);
+        return false;
+    }
+
+    const std::array<EGLint, 5> surfaceAttribs{ EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttribs.data());
+    if (surface == EGL_NO_SURFACE)
+    {
+        EGLint maxWidth = 0;
+        EGLint maxHeight = 0;
+        eglGetConfigAttrib(display, config, EGL_MAX_PBUFFER_WIDTH, &maxWidth);
+        eglGetConfigAttrib(display, config, EGL_MAX_PBUFFER_HEIGHT, &maxHeight);
+        GetLogger()->error("Can't create a {} x {} surface, the maximum is {} x {}\n",
+                           width, height, maxWidth, maxHeight);
+        return false;
+    }
+
+    if (!eglBindAPI(api))
+        return false;
+
+#ifdef GL_ES
+    const std::array<EGLint, 3> contextAttribs{ EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs.data());
+#else
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+#endif
+    if (context == EGL_NO_CONTEXT)
+        return false;
+
+    return eglMakeCurrent(display, surface, surface, context) && celestia::gl::init();
+}
+
+
+/*! Write frames to numbered image files. The pixels are read back on the
+ *  calling thread, which owns the GL context, and encoded by background
+ *  tasks, so that compressing a frame overlaps with rendering the next
+ *  ones. The number of frames waiting to be written is bounded.
+ */
+class FrameWriter
+{
+public:
+    FrameWriter(const CelestiaCore& appCore, fs::path directory, ContentType type);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    bool write(int frame);
+    bool finish();
+
+private:
+    bool waitForOldest();
+
+    const CelestiaCore& appCore;
+    fs::path directory;
+    ContentType type;
+    std::string extension;
+    std::size_t maxPending;
+    std::deque<std::future<bool>> pending;
+    bool ok{ true };
+};
+
+
+FrameWriter::FrameWriter(const CelestiaCore& _appCore, fs::path _directory, ContentType _type) :
+    appCore(_appCore),
+    directory(std::move(_directory)),
+    type(_type),
+    extension(_type == ContentType::JPEG ? "jpg" : "png"),
+    maxPending(TaskScheduler::get().getConcurrency() * 2)
+{
+}
+
+
+FrameWriter::~FrameWriter()
+{
+    finish();
+}
+
+
+bool
+FrameWriter::waitForOldest()
+{
+    ok = pending.front().get() && ok;
+    pending.pop_front();
+    return ok;
+}
+
+
+bool
+FrameWriter::write(int frame)
+{
+    std::array<int, 4> viewport;
+    PixelFormat format;
+    appCore.getCaptureInfo(viewport, format);
+    auto image = std::make_shared<Image>(format, viewport[2], viewport[3]);
+    if (!appCore.captureImage(image->getPixels(), viewport, format))
+    {
+        GetLogger()->error("Can't read back frame {}\n", frame);
+        return false;
+    }
+
+    if (pending.size() >= maxPending && !waitForOldest())
+        return false;
+
+    fs::path filename = directory / fmt::format("{:06d}.{}", frame, extension);
+    pending.push_back(TaskScheduler::get().async([image, filename, type = type]
+    {
+        bool saved = image->save(filename, type);
+        if (!saved)
+            GetLogger()->error("Error writing {}\n", filename);
+        return saved;
+    }, TaskPriority::Background));
+    return true;
+}
+
+
+bool
+FrameWriter::finish()
+{
+    while (!pending.empty())
+        waitForOldest();
+    return ok;
+}
+
+
+void
+Usage()
+{
+    std::cerr << "Usage: celestia-headless [options]\n";
+    std::cerr << "  Output size and timing:\n";
+    std::cerr << "    --width <pixels>, --height <pixels>  (default 1920 x 1080)\n";
+    std::cerr << "    --samples <n>       : multisample anti-aliasing samples (default 0)\n";
+    std::cerr << "    --fps <rate>        : frames per second of simulated time (default 30)\n";
+    std::cerr << "    --frames <n>        : stop a script after n frames, or a URL list after\n";
+    std::cerr << "                          n URLs\n";
+    std::cerr << "    --first-frame <n>   : run a script through its first n frames without\n";
+    std::cerr << "                          drawing them, or skip the first n URLs, so that\n";
+    std::cerr << "                          the nodes of a render farm each render a range\n";
+    std::cerr << "                          of the frames, numbered as in a single run\n";
+    std::cerr << "    --start-time <jd>   : start at this Julian date (TDB) rather than the\n";
+    std::cerr << "                          current time, the same for all the nodes\n";
+    std::cerr << "    --settle <n>        : frames drawn after going to each URL, so that\n";
+    std::cerr << "                          its textures are loaded (default 20)\n";
+    std::cerr << "  What to render:\n";
+    std::cerr << "    --script <file>     : render the frames of a script until it ends\n";
+    std::cerr << "    --urls <file>       : render one image per URL of the file, one per line\n";
+    std::cerr << "    --url <url>         : start at url\n";
+    std::cerr << "    --benchmark <file>  : render the benchmark scenes and write a JSON\n";
+    std::cerr << "                          report of their frame times to file\n";
+    std::cerr << "    --benchmark-frames <n> : measured frames per scene (default 300)\n";
+    std::cerr << "    --scenes <name>     : only the benchmark scenes whose name contains name:\n";
+    std::cerr << "                         ";
+    for (std::string_view scene : celestia::RenderBenchmark::sceneNames())
+        std::cerr << ' ' << scene;
+    std::cerr << '\n';
+    std::cerr << "  Where to write it:\n";
+    std::cerr << "    --output <dir>      : write the frames as numbered images to dir\n";
+    std::cerr << "    --format png|jpeg   : image format (default png)\n";
+#ifdef USE_FFMPEG
+    std::cerr << "    --movie <file>      : encode the frames of a script into a movie, with\n";
+    std::cerr << "                          H.264 if it is an .mp4 file\n";
+#endif
+    std::cerr << "  Data:\n";
+    std::cerr << "    --dir <dir>, --conf <file>, --extrasdir <dir>\n";
+}
+
+
+bool
+ParseInt(const char* text, int minimum, int maximum, int& value)
+{
+    char* end = nullptr;
+    long parsed = std::strtol(text, &end, 10);
+    if (*end != '\0' || parsed < minimum || parsed > maximum)
+        return false;
+
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+
+bool
+ParseCommandLine(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        const char* value = argv[++i];
+        bool ok = true;
+        if (arg == "--width")
+            ok = ParseInt(value, 1, 32768, options.width);
+        else if (arg == "--height")
+            ok = ParseInt(value, 1, 32768, options.height);
+        else if (arg == "--samples")
+            ok = ParseInt(value, 0, 32, options.samples);
+        else if (arg == "--frames")
+            ok = ParseInt(value, 1, 100000000, options.maxFrames);
+        else if (arg == "--first-frame")
+            ok = ParseInt(value, 0, 100000000, options.firstFrame);
+        else if (arg == "--settle")
+            ok = ParseInt(value, 0, 10000, options.settleFrames);
+        else if (arg == "--start-time")
+        {
+            char* end = nullptr;
+            options.startTime = std::strtod(value, &end);
+            ok = *end == '\0' && std::isfinite(*options.startTime);
+        }
+        else if (arg == "--fps")
+        {
+            options.fps = std::strtod(value, nullptr);
+            ok = options.fps > 0.0 && options.fps <= 1000.0;
+        }
+        else if (arg == "--script")
+            options.scriptFileName = value;
+        else if (arg == "--urls")
+            options.urlListFileName = value;
+        else if (arg == "--url")
+            options.startURL = value;
+        else if (arg == "--benchmark")
+            options.benchmarkFileName = value;
+        else if (arg == "--benchmark-frames")
+            ok = ParseInt(value, 1, 100000, options.benchmark.frames);
+        else if (arg == "--scenes")
+            options.benchmark.filter = value;
+        else if (arg == "--output")
+            options.outputDirectory = value;
+        else if (arg == "--format")
+        {
+            std::string_view format = value;
+            options.imageType = format == "jpeg" || format == "jpg" ? ContentType::JPEG : ContentType::PNG;
+            ok = format == "png" || options.imageType == ContentType::JPEG;
+        }
+#ifdef USE_FFMPEG
+        else if (arg == "--movie")
+            options.movieFileName = value;
+#endif
+        else if (arg == "--dir")
+            options.dataDir = value;
+        else if (arg == "--conf")
+            options.configFileName = value;
+        else if (arg == "--extrasdir")
+            options.extrasDirs.emplace_back(value);
+        else
+        {
+            std::cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+
+        if (!ok)
+        {
+            std::cerr << "Bad value for " << arg << ": " << value << '\n';
+            return false;
+        }
+    }
+
+    if (!options.benchmarkFileName.empty())
+    {
+        if (options.scriptFileName.empty() && options.urlListFileName.empty())
+            return true;
+
+        std::cerr << "--benchmark can't be combined with --script or --urls\n";
+        return false;
+    }
+
+    if (options.scriptFileName.empty() == options.urlListFileName.empty())
+    {
+        std::cerr << "Exactly one of --script, --urls and --benchmark is required\n";
+        return false;
+    }
+
+    if (options.outputDirectory.empty() && options.movieFileName.empty())
+    {
+        std::cerr << "No output given\n";
+        return false;
+    }
+
+    if (!options.urlListFileName.empty() && options.outputDirectory.empty())
+    {
+        std::cerr << "URL lists are rendered to images; --output is required\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+// Give the loaders, which run on other threads, time to bring in the
+// textures of the view; the simulation time doesn't advance
+void
+Settle(CelestiaCore& appCore, const Options& options)
+{
+    for (int i = 0; i < options.settleFrames; ++i)
+    {
+        appCore.tick(0.0);
+        appCore.draw();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+
+bool
+StartMovie([[maybe_unused]] CelestiaCore& appCore, [[maybe_unused]] const Options& options)
+{
+#ifdef USE_FFMPEG
+    auto* movieCapture = new FFMPEGCapture(appCore.getRenderer());
+    const CelestiaConfig* config = appCore.getConfig();
+    // MP4 files get H.264, anything else the lossless default codec
+    if (options.movieFileName.extension() == ".mp4")
+    {
+        movieCapture->setVideoCodec(AV_CODEC_ID_H264);
+        movieCapture->setEncoderOptions(config->x264EncoderOptions);
+    }
+    else
+    {
+        movieCapture->setEncoderOptions(config->ffvhEncoderOptions);
+    }
+    movieCapture->setHardwareEncoding(config->hardwareVideoEncoder);
+    if (!movieCapture->start(options.movieFileName, options.width, options.height,
+                             static_cast<float>(options.fps)))
+    {
+        delete movieCapture;
+        return false;
+    }
+
+    appCore.initMovieCapture(movieCapture);
+    appCore.recordBegin();
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool
+RenderScript(CelestiaCore& appCore, const Options& options)
+{
+    std::unique_ptr<FrameWriter> writer;
+    if (!options.outputDirectory.empty())
+        writer = std::make_unique<FrameWriter>(appCore, options.outputDirectory, options.imageType);
+
+    appCore.runScript(options.scriptFileName);
+    if (!appCore.isScriptRunning())
+        return false;
+
+    // The movie capture fixes the time step itself while recording
+    double dt = 1.0 / options.fps;
+    bool ok = true;
+    int frame = 0;
+    int lastFrame = options.maxFrames == 0 ? std::numeric_limits<int>::max() : options.firstFrame + options.maxFrames;
+    auto start = std::chrono::steady_clock::now();
+    for (; ok && appCore.isScriptRunning() && frame < lastFrame; ++frame)
+    {
+        appCore.tick(dt);
+        if (frame < options.firstFrame)
+            continue;
+
+        if (frame == options.firstFrame)
+        {
+            // The frames before were only simulated, so nothing is loaded
+            // yet; the settling frames mustn't be recorded
+            if (frame > 0)
+                Settle(appCore, options);
+            if (!options.movieFileName.empty() && !StartMovie(appCore, options))
+            {
+                GetLogger()->error("Can't start recording {}\n", options.movieFileName);
+                return false;
+            }
+        }
+
+        appCore.draw();
+        if (writer != nullptr)
+            ok = writer->write(frame);
+    }
+
+    if (!options.movieFileName.empty())
+    {
+        // The capture is finished at the start of the next frame
+        appCore.recordEnd();
+        appCore.draw();
+    }
+
+    if (writer != nullptr)
+        ok = writer->finish() && ok;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    int rendered = std::max(frame - options.firstFrame, 0);
+    std::cout << fmt::format("Rendered {} frames in {:.1f} s ({:.1f} frames/s)\n",
+                             rendered, elapsed.count(), rendered / std::max(elapsed.count(), 1.0e-3));
+    return ok;
+}
+
+
+bool
+RenderURLs(CelestiaCore& appCore, const Options& options)
+{
+    std::ifstream in(options.urlListFileName);
+    if (!in.good())
+    {
+        GetLogger()->error("Error opening {}\n", options.urlListFileName);
+        return false;
+    }
+
+    FrameWriter writer(appCore, options.outputDirectory, options.imageType);
+    bool ok = true;
+    int frame = 0;
+    int lastFrame = options.maxFrames == 0 ? std::numeric_limits<int>::max() : options.firstFrame + options.maxFrames;
+    std::string url;
+    while (ok && frame < lastFrame && std::getline(in, url))
+    {
+        if (url.empty() || url.front() == '#')
+            continue;
+
+        if (frame < options.firstFrame)
+        {
+            ++frame;
+            continue;
+        }
+
+        if (!appCore.goToUrl(url))
+        {
+            GetLogger()->error("Bad URL on line {}: {}\n", frame + 1, url);
+            ok = false;
+            break;
+        }
+
+        Settle(appCore, options);
+
+        appCore.tick(0.0);
+        appCore.draw();
+        ok = writer.write(frame);
+        ++frame;
+    }
+
+    return writer.finish() && ok;
+}
+
+
+bool
+RunBenchmark(CelestiaCore& appCore, const Options& options)
+{
+    celestia::RenderBenchmark benchmark(appCore, options.benchmark);
+    if (!benchmark.run())
+    {
+        GetLogger()->error("No benchmark scene could be rendered\n");
+        return false;
+    }
+
+    return benchmark.writeReport(options.benchmarkFileName);
+}
+
+
+int
+HeadlessMain(int argc, char* argv[])
+{
+    std::setlocale(LC_ALL, "");
+    std::setlocale(LC_NUMERIC, "C");
+
+#ifdef ENABLE_NLS
+    bindtextdomain("celestia", LOCALEDIR);
+    bind_textdomain_codeset("celestia", "UTF-8");
+    bindtextdomain("celestia-data", LOCALEDIR);
+    bind_textdomain_codeset("celestia-data", "UTF-8");
+    textdomain("celestia");
+#endif
+
+    Options options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    // Relative paths of the command line refer to the working directory,
+    // which is left for the data directory below
+    std::error_code ec;
+    for (fs::path* path : { &options.scriptFileName, &options.urlListFileName,
+                            &options.outputDirectory, &options.movieFileName,
+                            &options.benchmarkFileName })
+    {
+        if (!path->empty())
+            *path = fs::absolute(*path, ec);
+    }
+
+    if (!options.outputDirectory.empty() && !fs::create_directories(options.outputDirectory, ec) && ec)
+    {
+        std::cerr << "Can't create " << options.outputDirectory << '\n';
+        return 1;
+    }
+
+    if (options.dataDir.empty())
+    {
+        const char* dataDir = std::getenv("CELESTIA_DATA_DIR");
+        options.dataDir = dataDir == nullptr ? CONFIG_DATA_DIR : dataDir;
+    }
+
+    fs::current_path(options.dataDir, ec);
+    if (ec)
+    {
+        std::cerr << "Cannot chdir to " << options.dataDir << ", probably due to improper installation\n";
+        return 1;
+    }
+
+    // The context is destroyed after the core, which frees GL objects
+    OffscreenContext context;
+    auto appCore = std::make_unique<CelestiaCore>();
+    appCore->setAlerter(new HeadlessAlerter());
+    if (!options.startURL.empty())
+        appCore->setStartURL(options.startURL);
+    if (!appCore->initSimulation(options.configFileName, options.extrasDirs))
+    {
+        std::cerr << "Could not initialize Celestia!\n";
+        return 3;
+    }
+
+    if (!context.create(options.width, options.height, options.samples))
+    {
+        std::cerr << "Can't create an offscreen EGL context\n";
+        return 2;
+    }
+
+#ifndef GL_ES
+    if (!celestia::gl::checkVersion(celestia::gl::GL_2_1))
+    {
+        std::cerr << "Celestia requires OpenGL 2.1!\n";
+        return 2;
+    }
+#endif
+
+    if (!appCore->initRenderer())
+    {
+        std::cerr << "Could not initialize the renderer!\n";
+        return 3;
+    }
+
+    Renderer* renderer = appCore->getRenderer();
+    renderer->setRenderFlags(Renderer::DefaultRenderFlags);
+    renderer->setShadowMapSize(appCore->getConfig()->renderDetails.ShadowMapSize);
+    renderer->setSolarSystemMaxDistance(appCore->getConfig()->renderDetails.SolarSystemMaxDistance);
+
+    if (options.startTime.has_value())
+        appCore->start(*options.startTime);
+    else
+        appCore->start();
+    appCore->resize(options.width, options.height);
+
+    // The resolution would depend on the speed of the node
+    appCore->setDynamicResolution(false);
+
+    bool ok;
+    if (!options.benchmarkFileName.empty())
+        ok = RunBenchmark(*appCore, options);
+    else if (!options.scriptFileName.empty())
+        ok = RenderScript(*appCore, options);
+    else
+        ok = RenderURLs(*appCore, options);
+    return ok ? 0 : 4;
+}
+
+} // end unnamed namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    return HeadlessMain(argc, argv);
+}
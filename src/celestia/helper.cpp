@@ -3,6 +3,7 @@
 #include <celengine/render.h>
 #include <celengine/selection.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryaccounting.h>
 #include "helper.h"
 
 using namespace std;
@@ -144,6 +145,13 @@ std::string Helper::getRenderInfo(const Renderer *r)
     if (info.count("MaxAnisotropy") > 0)
         s += fmt::sprintf(_("Max anisotropy filtering: %s\n"), info["MaxAnisotropy"]);
 
+    for (std::size_t i = 0; i < celestia::util::MemoryTagCount; ++i)
+    {
+        std::string_view name = celestia::util::MemoryTagName(static_cast<celestia::util::MemoryTag>(i));
+        if (auto it = info.find(fmt::format("Memory{}", name)); it != info.end())
+            s += fmt::sprintf(_("Memory used by %s: %s bytes\n"), name, it->second);
+    }
+
     s += "\n";
 
     if (info.count("Extensions") > 0)
@@ -13,8 +13,10 @@
 #include "hud.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -24,6 +26,7 @@
 
 #include <celcompat/numbers.h>
 #include <celengine/body.h>
+#include <celengine/frameprofiler.h>
 #include <celengine/location.h>
 #include <celengine/observer.h>
 #include <celengine/overlay.h>
@@ -38,6 +41,7 @@
 #include <celutil/flag.h>
 #include <celutil/formatnum.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryaccounting.h>
 #include <celutil/utf8.h>
 #include "moviecapture.h"
 #include "textprintposition.h"
@@ -55,6 +59,10 @@ namespace
 
 // Ye olde wolde conſtantes for ye olde wolde units
 constexpr double OneMiInKm = 1.609344;
+// Seconds over which text messages fade out
+constexpr double MessageFadeTime = 0.5;
+// Seconds between updates of the fast changing numbers of the HUD
+constexpr double NumericUpdateInterval = 0.25;
 constexpr double OneFtInKm = 0.0003048;
 constexpr double OneLbInKg = 0.45359237;
 constexpr double OneLbPerFt3InKgPerM3 = OneLbInKg / math::cube(OneFtInKm * 1000.0);
@@ -87,9 +95,63 @@ KelvinToStr(const util::NumberFormatter& formatter, float value, int digits, Tem
     }
 }
 
+// The distances formatted last, by the values they show: the distance
+// rounded to its significant figures, and its units. The same distances
+// are shown over many frames, and formatting them isn't cheap.
+class DistanceStrings
+{
+public:
+    const std::string& get(const util::NumberFormatter& formatter, double distance, int digits, const char* units);
+
+private:
+    struct Entry
+    {
+        const util::NumberFormatter* formatter{ nullptr };
+        const char* units{ nullptr };
+        int digits{ 0 };
+        std::int64_t mantissa{ 0 };
+        int exponent{ 0 };
+        std::string text;
+    };
+
+    static constexpr std::size_t Size = 16;
+
+    std::array<Entry, Size> m_entries;
+    std::size_t m_next{ 0 };
+};
+
+const std::string&
+DistanceStrings::get(const util::NumberFormatter& formatter, double distance, int digits, const char* units)
+{
+    std::int64_t mantissa = 0;
+    int exponent = 0;
+    if (distance != 0.0 && std::isfinite(distance))
+    {
+        exponent = static_cast<int>(std::floor(std::log10(std::abs(distance)))) - digits + 1;
+        mantissa = std::llround(distance / std::pow(10.0, exponent));
+    }
+
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.formatter == &formatter && entry.units == units && entry.digits == digits &&
+            entry.mantissa == mantissa && entry.exponent == exponent && std::isfinite(distance))
+        {
+            return entry.text;
+        }
+    }
+
+    Entry& entry = m_entries[m_next];
+    m_next = (m_next + 1) % Size;
+    entry = { &formatter, units, digits, mantissa, exponent,
+              fmt::format("{} {}", formatter.format(distance, digits, SigDigitNum), units) };
+    return entry.text;
+}
+
 std::string
 DistanceLyToStr(const util::NumberFormatter& formatter, double distance, int digits, MeasurementSystem measurement)
 {
+    static DistanceStrings* distanceStrings = new DistanceStrings;
+
     const char* units;
     if (std::abs(distance) >= astro::parsecsToLightYears(1e+6))
     {
@@ -134,7 +196,7 @@ DistanceLyToStr(const util::NumberFormatter& formatter, double distance, int dig
         distance = astro::lightYearsToKilometers(distance) * 1000.0f;
     }
 
-    return fmt::format("{} {}", formatter.format(distance, digits, SigDigitNum), units);
+    return distanceStrings->get(formatter, distance, digits, units);
 }
 
 std::string
@@ -702,6 +764,7 @@ void
 Hud::detail(int value)
 {
     m_hudDetail = value % 3;
+    invalidateText();
 }
 
 astro::Date::Format
@@ -715,6 +778,7 @@ Hud::dateFormat(astro::Date::Format format)
 {
     m_dateFormat = format;
     m_dateStrWidth = 0;
+    invalidateText();
 }
 
 TextInput&
@@ -774,6 +838,7 @@ void
 Hud::font(const std::shared_ptr<TextureFont>& f)
 {
     m_hudFonts.setFont(f);
+    invalidateText();
 }
 
 const std::shared_ptr<TextureFont>&
@@ -786,6 +851,7 @@ void
 Hud::titleFont(const std::shared_ptr<TextureFont>& f)
 {
     m_hudFonts.setTitleFont(f);
+    invalidateText();
 }
 
 std::tuple<int, int>
@@ -800,6 +866,7 @@ Hud::renderOverlay(const WindowMetrics& metrics,
                    const ViewManager& views,
                    const MovieCapture* movieCapture,
                    const TimeInfo& timeInfo,
+                   const engine::FrameProfiler* frameProfiler,
                    bool isScriptRunning,
                    bool editMode)
 {
@@ -825,16 +892,21 @@ Hud::renderOverlay(const WindowMetrics& metrics,
                           metrics.getSafeAreaBottom(m_hudFonts.fontHeight() * 2 + static_cast<int>(static_cast<float>(metrics.screenDpi) / 25.4f * 1.3f)));
         m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
 
-        m_overlay->beginText();
-        m_overlay->print("\n");
-        if (m_hudSettings.showFPSCounter)
-            m_overlay->printf(_("FPS: %.1f\n"), timeInfo.fps);
-        else
+        if (timeInfo.currentTime >= m_speedTextTime + NumericUpdateInterval ||
+            !m_overlay->drawText(m_speedText))
+        {
+            m_speedTextTime = timeInfo.currentTime;
+            m_overlay->beginText(m_speedText);
             m_overlay->print("\n");
+            if (m_hudSettings.showFPSCounter)
+                m_overlay->printf(_("FPS: %.1f\n"), timeInfo.fps);
+            else
+                m_overlay->print("\n");
 
-        displaySpeed(*m_numberFormatter, *m_overlay, static_cast<float>(sim->getObserver().getVelocity().norm()), m_hudSettings.measurementSystem);
+            displaySpeed(*m_numberFormatter, *m_overlay, static_cast<float>(sim->getObserver().getVelocity().norm()), m_hudSettings.measurementSystem);
 
-        m_overlay->endText();
+            m_overlay->endText();
+        }
         m_overlay->restorePos();
     }
 
@@ -845,7 +917,7 @@ Hud::renderOverlay(const WindowMetrics& metrics,
         !sel.empty() && m_hudDetail > 0 && util::is_set(m_hudSettings.overlayElements, HudElements::ShowSelection))
     {
         Eigen::Vector3d v = sel.getPosition(sim->getTime()).offsetFromKm(sim->getObserver().getPosition());
-        renderSelectionInfo(metrics, sim, sel, v);
+        renderSelectionInfo(metrics, sim, sel, v, timeInfo.currentTime);
     }
 
     if (util::is_set(m_textEnterMode, TextEnterMode::AutoComplete))
@@ -857,6 +929,9 @@ Hud::renderOverlay(const WindowMetrics& metrics,
     if (movieCapture != nullptr)
         renderMovieCapture(metrics, *movieCapture);
 
+    if (frameProfiler != nullptr && frameProfiler->isEnabled())
+        renderFrameProfile(metrics, *frameProfiler);
+
     if (editMode)
     {
         m_overlay->savePos();
@@ -888,7 +963,7 @@ Hud::renderTimeInfo(const WindowMetrics& metrics, const Simulation* sim, const T
     }
 
     double tdb = sim->getTime() + lt;
-    auto dateStr = m_dateFormatter->formatDate(tdb, timeInfo.timeZoneBias != 0, m_dateFormat);
+    const std::string& dateStr = m_dateFormatter->formatDate(tdb, timeInfo.timeZoneBias != 0, m_dateFormat);
     m_dateStrWidth = std::max(m_dateStrWidth,
                               (engine::TextLayout::getTextWidth(dateStr, m_hudFonts.font().get()) /
                                (m_hudFonts.emWidth() * 3) + 2) *
@@ -898,7 +973,7 @@ Hud::renderTimeInfo(const WindowMetrics& metrics, const Simulation* sim, const T
     m_overlay->savePos();
     m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
     m_overlay->moveBy(metrics.getSafeAreaEnd(m_dateStrWidth), metrics.getSafeAreaTop(m_hudFonts.fontHeight()));
-    m_overlay->beginText();
+    m_overlay->beginText(m_timeText);
 
     m_overlay->print(dateStr);
 
@@ -948,7 +1023,7 @@ Hud::renderFrameInfo(const WindowMetrics& metrics, const Simulation* sim)
     m_overlay->moveBy(metrics.getSafeAreaEnd(m_hudFonts.emWidth() * 15),
                       metrics.getSafeAreaBottom(m_hudFonts.fontHeight() * 3 +
                           static_cast<int>(static_cast<float>(metrics.screenDpi) / 25.4f * 1.3f)));
-    m_overlay->beginText();
+    m_overlay->beginText(m_frameText);
     m_overlay->setColor(0.6f, 0.6f, 1.0f, 1);
 
     if (sim->getObserverMode() == Observer::Travelling)
@@ -1012,13 +1087,24 @@ void
 Hud::renderSelectionInfo(const WindowMetrics& metrics,
                          const Simulation* sim,
                          Selection sel,
-                         const Eigen::Vector3d& v)
+                         const Eigen::Vector3d& v,
+                         double currentTime)
 {
     m_overlay->savePos();
     m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
     m_overlay->moveBy(metrics.getSafeAreaStart(), metrics.getSafeAreaTop(m_hudFonts.titleFontHeight()));
 
-    m_overlay->beginText();
+    if (sel == m_selectionTextObject &&
+        currentTime < m_selectionTextTime + NumericUpdateInterval &&
+        m_overlay->drawText(m_selectionText))
+    {
+        m_overlay->restorePos();
+        return;
+    }
+
+    m_selectionTextObject = sel;
+    m_selectionTextTime = currentTime;
+    m_overlay->beginText(m_selectionText);
 
     switch (sel.getType())
     {
@@ -1145,11 +1231,11 @@ Hud::renderTextMessages(const WindowMetrics& metrics, double currentTime)
     m_overlay->savePos();
 
     float alpha = 1.0f;
-    if (currentTime > m_messageStart + m_messageDuration - 0.5)
-        alpha = static_cast<float>((m_messageStart + m_messageDuration - currentTime) / 0.5);
+    if (currentTime > m_messageStart + m_messageDuration - MessageFadeTime)
+        alpha = static_cast<float>((m_messageStart + m_messageDuration - currentTime) / MessageFadeTime);
     m_overlay->setColor(m_hudSettings.textColor, alpha);
     m_overlay->moveBy(x, y);
-    m_overlay->beginText();
+    m_overlay->beginText(m_messageBlock);
     m_overlay->print(m_messageText);
     m_overlay->endText();
     m_overlay->restorePos();
@@ -1204,6 +1290,54 @@ Hud::renderMovieCapture(const WindowMetrics& metrics, const MovieCapture& movieC
     m_overlay->restorePos();
 }
 
+// CPU and GPU milliseconds per section of the last profiled frame, and the
+// live memory of the subsystems if it is accounted, below the time and date
+void
+Hud::renderFrameProfile(const WindowMetrics& metrics, const engine::FrameProfiler& frameProfiler)
+{
+    using engine::FrameProfiler;
+
+    const FrameProfiler::FrameTimes& times = frameProfiler.lastFrame();
+    int width = m_hudFonts.emWidth() * 18;
+
+    m_overlay->savePos();
+    m_overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+    m_overlay->moveBy(metrics.getSafeAreaEnd(width), metrics.getSafeAreaTop(m_hudFonts.fontHeight() * 5));
+    m_overlay->beginText();
+
+    m_overlay->print(_("Frame {}  CPU / GPU ms\n"), times.frame);
+    for (std::size_t i = 0; i < FrameProfiler::SectionCount; ++i)
+    {
+        std::string_view name = FrameProfiler::sectionName(static_cast<FrameProfiler::Section>(i));
+        if (times.hasGpuTimes)
+            m_overlay->print("{}  {:.2f} / {:.2f}\n", name, times.cpu[i], times.gpu[i]);
+        else
+            m_overlay->print("{}  {:.2f} / -\n", name, times.cpu[i]);
+    }
+
+    if constexpr (util::MemoryAccountingEnabled)
+    {
+        m_overlay->print(_("\nMemory MiB\n"));
+        for (std::size_t i = 0; i < util::MemoryTagCount; ++i)
+        {
+            auto tag = static_cast<util::MemoryTag>(i);
+            m_overlay->print("{}  {:.1f}\n", util::MemoryTagName(tag),
+                             static_cast<double>(util::LiveMemory(tag)) / (1024.0 * 1024.0));
+        }
+    }
+
+    m_overlay->endText();
+    m_overlay->restorePos();
+}
+
+// Format the rate limited text again in the next frame
+void
+Hud::invalidateText()
+{
+    m_speedTextTime = -std::numeric_limits<double>::infinity();
+    m_selectionTextTime = -std::numeric_limits<double>::infinity();
+}
+
 void
 Hud::showText(const TextPrintPosition& position,
               std::string_view message,
@@ -1220,6 +1354,13 @@ Hud::showText(const TextPrintPosition& position,
     m_messageDuration = duration;
 }
 
+std::tuple<double, double>
+Hud::messageFadeInterval() const
+{
+    double end = m_messageStart + m_messageDuration;
+    return std::make_tuple(end - MessageFadeTime, end);
+}
+
 void
 Hud::setImage(std::unique_ptr<OverlayImage>&& _image, double currentTime)
 {
@@ -24,6 +24,7 @@
 
 #include <celastro/date.h>
 #include <celengine/dateformatter.h>
+#include <celengine/overlay.h>
 #include <celengine/selection.h>
 #include <celestia/textinput.h>
 #include <celestia/textprintposition.h>
@@ -34,7 +35,6 @@
 #include <celutil/formatnum.h>
 
 class MovieCapture;
-class Overlay;
 class OverlayImage;
 class Simulation;
 
@@ -47,6 +47,7 @@ class ViewManager;
 namespace engine
 {
 class DateFormatter;
+class FrameProfiler;
 }
 
 enum class MeasurementSystem
@@ -147,10 +148,13 @@ public:
                        const ViewManager&,
                        const MovieCapture*,
                        const TimeInfo&,
+                       const engine::FrameProfiler*,
                        bool isScriptRunning,
                        bool editMode);
 
     void showText(const TextPrintPosition&, std::string_view, double duration, double currentTime);
+    // Start and end of the fading out of the text message
+    std::tuple<double, double> messageFadeInterval() const;
     void setImage(std::unique_ptr<OverlayImage>&&, double);
 
     HudSettings& hudSettings() noexcept { return m_hudSettings; }
@@ -159,9 +163,11 @@ public:
 private:
     void renderTimeInfo(const WindowMetrics&, const Simulation*, const TimeInfo&);
     void renderFrameInfo(const WindowMetrics&, const Simulation*);
-    void renderSelectionInfo(const WindowMetrics&, const Simulation*, Selection, const Eigen::Vector3d&);
+    void renderSelectionInfo(const WindowMetrics&, const Simulation*, Selection, const Eigen::Vector3d&, double);
     void renderTextMessages(const WindowMetrics&, double);
     void renderMovieCapture(const WindowMetrics&, const MovieCapture&);
+    void renderFrameProfile(const WindowMetrics&, const engine::FrameProfiler&);
+    void invalidateText();
 
     HudSettings m_hudSettings;
     HudFonts m_hudFonts;
@@ -187,6 +193,18 @@ private:
 
     Selection m_lastSelection;
     std::string m_selectionNames;
+
+    // The text of the HUD, laid out again only when it changes. The speed
+    // and the selection info change on every frame while moving, so they
+    // are only formatted a few times per second.
+    OverlayTextBlock m_timeText;
+    OverlayTextBlock m_speedText;
+    OverlayTextBlock m_frameText;
+    OverlayTextBlock m_selectionText;
+    OverlayTextBlock m_messageBlock;
+    double m_speedTextTime{ -std::numeric_limits<double>::infinity() };
+    double m_selectionTextTime{ -std::numeric_limits<double>::infinity() };
+    Selection m_selectionTextObject;
 };
 
 ENUM_CLASS_BITWISE_OPS(Hud::TextEnterMode);
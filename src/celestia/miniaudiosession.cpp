@@ -1,4 +1,6 @@
 #include "miniaudiosession.h"
+#include <cstdint>
+#include <system_error>
 #include <celutil/logger.h>
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -9,6 +11,86 @@ using namespace celestia::util;
 namespace celestia
 {
 
+namespace
+{
+
+// Files larger than this are decoded while they play instead of being
+// decoded into memory first
+constexpr std::uintmax_t StreamingThreshold = 4 * 1024 * 1024;
+
+// Audio device and engine shared by all sessions. It is started when the
+// first session needs it and kept until exit, so that sounds played one
+// after another don't wait for the device to open.
+class MiniAudioEngine
+{
+ public:
+    MiniAudioEngine() = default;
+    ~MiniAudioEngine();
+
+    MiniAudioEngine(const MiniAudioEngine&) = delete;
+    MiniAudioEngine(MiniAudioEngine&&)      = delete;
+    MiniAudioEngine &operator=(const MiniAudioEngine&) = delete;
+    MiniAudioEngine &operator=(MiniAudioEngine&&) = delete;
+
+    static std::shared_ptr<MiniAudioEngine> get();
+
+    ma_context context;
+    ma_engine engine;
+
+ private:
+    bool start();
+
+    bool started        { false };
+};
+
+MiniAudioEngine::~MiniAudioEngine()
+{
+    if (started)
+    {
+        ma_engine_uninit(&engine);
+        ma_context_uninit(&context);
+    }
+}
+
+std::shared_ptr<MiniAudioEngine> MiniAudioEngine::get()
+{
+    static std::shared_ptr<MiniAudioEngine> sharedEngine;
+
+    if (sharedEngine == nullptr)
+    {
+        auto engine = std::make_shared<MiniAudioEngine>();
+        if (engine->start())
+            sharedEngine = std::move(engine);
+    }
+    return sharedEngine;
+}
+
+bool MiniAudioEngine::start()
+{
+    auto config = ma_context_config_init();
+    // on iOS, explicitly set the correct category for correct routing
+    config.coreaudio.sessionCategory = ma_ios_session_category_playback;
+    ma_result result = ma_context_init(nullptr, 0, &config, &context);
+    if (result != MA_SUCCESS)
+    {
+        GetLogger()->error("Failed to init miniaudio context");
+        return false;
+    }
+    auto engineConfig = ma_engine_config_init();
+    engineConfig.pContext = &context;
+    result = ma_engine_init(&engineConfig, &engine);
+    if (result != MA_SUCCESS)
+    {
+        ma_context_uninit(&context);
+        GetLogger()->error("Failed to start miniaudio engine");
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+}
+
 class MiniAudioSessionPrivate
 {
  public:
@@ -28,8 +110,7 @@ class MiniAudioSessionPrivate
     MiniAudioSessionPrivate &operator=(const MiniAudioSessionPrivate&) = delete;
     MiniAudioSessionPrivate &operator=(MiniAudioSessionPrivate&&) = delete;
 
-    ma_context context;
-    ma_engine engine;
+    std::shared_ptr<MiniAudioEngine> engine;
     ma_sound sound;
     State state         { State::NotInitialized };
 };
@@ -44,8 +125,6 @@ MiniAudioSessionPrivate::~MiniAudioSessionPrivate()
     case State::SoundInitialzied:
         ma_sound_uninit(&sound);
     case State::EngineStarted:
-        ma_engine_uninit(&engine);
-        ma_context_uninit(&context);
     case State::NotInitialized:
         break;
     }
@@ -59,29 +138,51 @@ MiniAudioSession::MiniAudioSession(const fs::path &path, float volume, float pan
 
 MiniAudioSession::~MiniAudioSession() = default;
 
+bool MiniAudioSession::preload()
+{
+    if (p->state >= MiniAudioSessionPrivate::State::SoundInitialzied)
+        return true;
+
+    if (p->state == MiniAudioSessionPrivate::State::NotInitialized)
+    {
+        p->engine = MiniAudioEngine::get();
+        if (p->engine == nullptr)
+            return false;
+        p->state = MiniAudioSessionPrivate::State::EngineStarted;
+    }
+
+    // The file is opened and decoded by the resource manager's job thread,
+    // long files a page at a time as they play
+    ma_uint32 flags = MA_SOUND_FLAG_ASYNC;
+    std::error_code ec;
+    auto size = fs::file_size(path(), ec);
+    if (!ec && size > StreamingThreshold)
+        flags |= MA_SOUND_FLAG_STREAM;
+    else
+        flags |= MA_SOUND_FLAG_DECODE;
+
+    ma_result result = ma_sound_init_from_file(&p->engine->engine, path().string().c_str(), flags, nullptr, nullptr, &p->sound);
+    if (result != MA_SUCCESS)
+    {
+        GetLogger()->error("Failed to load sound file {}", path());
+        return false;
+    }
+    ma_sound_set_volume(&p->sound, volume());
+    ma_sound_set_pan(&p->sound, pan());
+    ma_sound_set_looping(&p->sound, loop() ? MA_TRUE : MA_FALSE);
+    p->state = MiniAudioSessionPrivate::State::SoundInitialzied;
+    return true;
+}
+
 bool MiniAudioSession::play(double startTime)
 {
     ma_result result;
     switch (p->state)
     {
     case MiniAudioSessionPrivate::State::NotInitialized:
-        // start the engine
-        if (!startEngine())
-            return false;
-        p->state = MiniAudioSessionPrivate::State::EngineStarted;
-
     case MiniAudioSessionPrivate::State::EngineStarted:
-        // load sound file from disk
-        result = ma_sound_init_from_file(&p->engine, path().string().c_str(), MA_SOUND_FLAG_ASYNC, nullptr, nullptr, &p->sound);
-        if (result != MA_SUCCESS)
-        {
-            GetLogger()->error("Failed to load sound file {}", path());
+        if (!preload())
             return false;
-        }
-        ma_sound_set_volume(&p->sound, volume());
-        ma_sound_set_pan(&p->sound, pan());
-        ma_sound_set_looping(&p->sound, loop() ? MA_TRUE : MA_FALSE);
-        p->state = MiniAudioSessionPrivate::State::SoundInitialzied;
 
     case MiniAudioSessionPrivate::State::SoundInitialzied:
         // start playing, seek if needed
@@ -152,7 +253,7 @@ bool MiniAudioSession::seek(double seconds)
 {
     if (p->state >= MiniAudioSessionPrivate::State::SoundInitialzied)
     {
-        ma_result result = ma_sound_seek_to_pcm_frame(&p->sound, static_cast<ma_uint64>(seconds * ma_engine_get_sample_rate(&p->engine)));
+        ma_result result = ma_sound_seek_to_pcm_frame(&p->sound, static_cast<ma_uint64>(seconds * ma_engine_get_sample_rate(&p->engine->engine)));
         if (result != MA_SUCCESS)
         {
             GetLogger()->error("Failed to seek to {}", seconds);
@@ -180,31 +281,4 @@ void MiniAudioSession::updateLoop()
         ma_sound_set_looping(&p->sound, loop() ? MA_TRUE : MA_FALSE);
 }
 
-bool MiniAudioSession::startEngine()
-{
-    if (p->state >= MiniAudioSessionPrivate::State::EngineStarted)
-        return true;
-
-    auto config = ma_context_config_init();
-    // on iOS, explicitly set the correct category for correct routing
-    config.coreaudio.sessionCategory = ma_ios_session_category_playback;
-    ma_result result = ma_context_init(nullptr, 0, &config, &p->context);
-    if (result != MA_SUCCESS)
-    {
-        GetLogger()->error("Failed to init miniaudio context");
-        return false;
-    }
-    auto engineConfig = ma_engine_config_init();
-    engineConfig.pContext = &p->context;
-    result = ma_engine_init(&engineConfig, &p->engine);
-    if (result != MA_SUCCESS)
-    {
-        ma_context_uninit(&p->context);
-        GetLogger()->error("Failed to start miniaudio engine");
-        return false;
-    }
-    p->state = MiniAudioSessionPrivate::State::EngineStarted;
-    return true;
-}
-
 }
@@ -657,7 +657,8 @@ void
 CelestiaAppWindow::celestia_tick()
 {
     m_appCore->tick();
-    glWidget->update();
+    if (m_appCore->viewUpdateRequired())
+        glWidget->update();
 }
 
 
@@ -773,6 +774,7 @@ CelestiaAppWindow::slotCaptureVideo()
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->x264EncoderOptions);
             else
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->ffvhEncoderOptions);
+            movieCapture->setHardwareEncoding(m_appCore->getConfig()->hardwareVideoEncoder);
 
             bool ok = movieCapture->start(saveAsName.toStdString(),
                                           videoSize.width(), videoSize.height(),
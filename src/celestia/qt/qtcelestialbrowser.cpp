@@ -14,8 +14,11 @@
 
 #include <algorithm>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
@@ -27,12 +30,15 @@
 #include <QCollator>
 #include <QColor>
 #include <QComboBox>
+#include <QCoreApplication>
 #include <QGridLayout>
 #include <QGroupBox>
 #include <QItemSelectionModel>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMetaObject>
 #include <QModelIndex>
+#include <QPointer>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QRegExp>
@@ -55,6 +61,7 @@
 #include <celutil/color.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/taskscheduler.h>
 #include "qtcolorswatchwidget.h"
 #include "qtinfopanel.h"
 
@@ -204,13 +211,93 @@ StarPredicate::operator()(const Star* star0, const Star* star1) const
     }
 }
 
+
+// Find the nStars best stars by pred of those passing the filter. Only
+// reads the star database, so it can run on a worker thread.
+std::vector<Star*>
+findStars(const StarDatabase& stardb,
+          const StarFilterPredicate& filterPred,
+          const StarPredicate& pred,
+          unsigned int nStars)
+{
+    std::vector<Star*> stars;
+
+    // Apply the filter
+    std::vector<Star*> filteredStars;
+    unsigned int totalStars = stardb.size();
+    unsigned int i = 0;
+    filteredStars.reserve(totalStars);
+    for (i = 0; i < totalStars; i++)
+    {
+        Star* star = stardb.getStar(i);
+        if (!filterPred(star))
+            filteredStars.push_back(star);
+    }
+
+    // Don't try and show more stars than remain after the filter
+    if (filteredStars.size() < nStars)
+        nStars = filteredStars.size();
+
+    if (filteredStars.empty())
+        return stars;
+
+    using StarSet = std::multiset<Star*, StarPredicate>;
+    StarSet firstStars(pred);
+
+    // We'll need at least nStars in the set, so first fill
+    // up the list indiscriminately.
+    for (i = 0; i < nStars; i++)
+    {
+        firstStars.insert(filteredStars[i]);
+    }
+
+    // From here on, only add a star to the set if it's
+    // A better match than the worst matching star already
+    // in the set.
+    const Star* lastStar = *--firstStars.end();
+    for (; i < filteredStars.size(); i++)
+    {
+        Star* star = filteredStars[i];
+        if (pred(star, lastStar))
+        {
+            firstStars.insert(star);
+            firstStars.erase(--firstStars.end());
+            lastStar = *--firstStars.end();
+        }
+    }
+
+    // Move the best matching stars into the vector
+    stars.reserve(nStars);
+    std::copy(firstStars.begin(), firstStars.end(), std::back_inserter(stars));
+    return stars;
+}
+
+
+// Run f on the GUI thread, unless model was destroyed in the meantime
+template<typename T, typename F> void
+postToModel(const QPointer<T>& model, F&& f)
+{
+    QCoreApplication* app = QCoreApplication::instance();
+    if (app == nullptr)
+        return;
+
+    QMetaObject::invokeMethod(app,
+                              [model, f = std::forward<F>(f)]() mutable
+                              {
+                                  if (!model.isNull())
+                                      f(*model);
+                              },
+                              Qt::QueuedConnection);
+}
+
 } // end unnamed namespace
 
 
 class CelestialBrowser::StarTableModel : public QAbstractTableModel, public ModelHelper
 {
 public:
-    StarTableModel(const Universe* _universe) : universe(_universe) {};
+    StarTableModel(const Universe* _universe, QObject* parent) :
+        QAbstractTableModel(parent), universe(_universe) {};
     virtual ~StarTableModel() = default;
 
     Selection objectAtIndex(const QModelIndex& index) const;
@@ -242,11 +329,15 @@ public:
         SpectralTypeColumn = 4,
     };
 
+    // Filter the stars and pick the best ones on a worker thread, and
+    // replace the rows with them on the GUI thread, calling done after.
+    // The results of earlier calls which didn't finish are dropped.
     void populate(const UniversalCoord& _observerPos,
                   double _now,
-                  StarFilterPredicate& filterPred,
+                  const StarFilterPredicate& filterPred,
                   StarPredicate::Criterion criterion,
-                  unsigned int nStars);
+                  unsigned int nStars,
+                  std::function<void()> done);
 
     Selection itemAtRow(unsigned int row) const;
 
@@ -255,6 +346,12 @@ private:
     UniversalCoord observerPos{ 0.0, 0.0, 0.0 };
     double now{ astro::J2000 };
     std::vector<Star*> stars;
+
+    // The latest requests run on the workers, and the number of results
+    // of populate shown, so that a sort of replaced stars is dropped
+    unsigned int populateRequest{ 0 };
+    unsigned int sortRequest{ 0 };
+    unsigned int generation{ 0 };
 };
 
 
@@ -416,89 +513,66 @@ CelestialBrowser::StarTableModel::sort(int column, Qt::SortOrder order)
         break;
     }
 
-    StarPredicate pred(criterion, observerPos, universe);
-
-    std::sort(stars.begin(), stars.end(), pred);
+    // Sorting by name compares the names in the locale, which is slow for
+    // many stars, so sort on a worker
+    unsigned int request = ++sortRequest;
+    celestia::util::TaskScheduler::get().submit(
+        [model = QPointer<StarTableModel>(this), sorted = stars, criterion, order,
+         pos = observerPos, u = universe, request, sortedGeneration = generation]() mutable
+        {
+            StarPredicate pred(criterion, pos, u);
+            std::sort(sorted.begin(), sorted.end(), pred);
 
-    if (order == Qt::DescendingOrder)
-        std::reverse(stars.begin(), stars.end());
+            if (order == Qt::DescendingOrder)
+                std::reverse(sorted.begin(), sorted.end());
 
-    dataChanged(index(0, 0), index(stars.size() - 1, 4));
+            postToModel(model, [sorted = std::move(sorted), request, sortedGeneration](StarTableModel& m) mutable
+            {
+                if (request != m.sortRequest || sortedGeneration != m.generation)
+                    return;
+
+                emit m.layoutAboutToBeChanged();
+                m.stars = std::move(sorted);
+                emit m.layoutChanged();
+            });
+        },
+        celestia::util::TaskPriority::Background);
 }
 
 
 void
 CelestialBrowser::StarTableModel::populate(const UniversalCoord& _observerPos,
                                            double _now,
-                                           StarFilterPredicate& filterPred,
+                                           const StarFilterPredicate& filterPred,
                                            StarPredicate::Criterion criterion,
-                                           unsigned int nStars)
+                                           unsigned int nStars,
+                                           std::function<void()> done)
 {
-    const StarDatabase& stardb = *universe->getStarCatalog();
-
-    observerPos = _observerPos;
-    now = _now;
-
-    using StarSet = std::multiset<Star*, StarPredicate>;
-    StarPredicate pred(criterion, observerPos, universe);
-
-    // Apply the filter
-    std::vector<Star*> filteredStars;
-    unsigned int totalStars = stardb.size();
-    unsigned int i = 0;
-    filteredStars.reserve(totalStars);
-    for (i = 0; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (!filterPred(star))
-            filteredStars.push_back(star);
-    }
-
-    // Don't try and show more stars than remain after the filter
-    if (filteredStars.size() < nStars)
-        nStars = filteredStars.size();
-
-    // Clear out the results of the previous populate() call
-    if (stars.size() != 0)
-    {
-        beginResetModel();
-        stars.clear();
-        endResetModel();
-    }
-
-    if (filteredStars.empty())
-        return;
-
-    StarSet firstStars(pred);
-
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    for (i = 0; i < nStars; i++)
-    {
-        firstStars.insert(filteredStars[i]);
-    }
-
-    // From here on, only add a star to the set if it's
-    // A better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < filteredStars.size(); i++)
-    {
-        Star* star = filteredStars[i];
-        if (pred(star, lastStar))
+    unsigned int request = ++populateRequest;
+    celestia::util::TaskScheduler::get().submit(
+        [model = QPointer<StarTableModel>(this), filterPred, criterion, nStars,
+         pos = _observerPos, _now, u = universe, request, done = std::move(done)]() mutable
         {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
+            StarPredicate pred(criterion, pos, u);
+            std::vector<Star*> found = findStars(*u->getStarCatalog(), filterPred, pred, nStars);
 
-    // Move the best matching stars into the vector
-    stars.reserve(nStars);
-    std::copy(firstStars.begin(), firstStars.end(), std::back_inserter(stars));
-
-    beginInsertRows(QModelIndex(), 0, stars.size());
-    endInsertRows();
+            postToModel(model, [found = std::move(found), pos, _now, request, done = std::move(done)](StarTableModel& m) mutable
+            {
+                if (request != m.populateRequest)
+                    return;
+
+                m.beginResetModel();
+                m.observerPos = pos;
+                m.now = _now;
+                m.stars = std::move(found);
+                ++m.generation;
+                m.endResetModel();
+
+                if (done)
+                    done();
+            });
+        },
+        celestia::util::TaskPriority::Background);
 }
 
 
@@ -525,7 +599,7 @@ CelestialBrowser::CelestialBrowser(CelestiaCore* _appCore, QWidget* parent, Info
     treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
     treeView->setSortingEnabled(true);
 
-    starModel = new StarTableModel(appCore->getSimulation()->getUniverse());
+    starModel = new StarTableModel(appCore->getSimulation()->getUniverse(), this);
     treeView->setModel(starModel);
 
     treeView->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -704,13 +778,14 @@ CelestialBrowser::slotRefreshTable()
         filterPred.spectralTypeFilterEnabled = false;
     }
 
-    starModel->populate(observerPos, now, filterPred, criterion, 1000);
-
-    treeView->resizeColumnToContents(StarTableModel::DistanceColumn);
-    treeView->resizeColumnToContents(StarTableModel::AppMagColumn);
-    treeView->resizeColumnToContents(StarTableModel::AbsMagColumn);
+    starModel->populate(observerPos, now, filterPred, criterion, 1000, [this]
+    {
+        treeView->resizeColumnToContents(StarTableModel::DistanceColumn);
+        treeView->resizeColumnToContents(StarTableModel::AppMagColumn);
+        treeView->resizeColumnToContents(StarTableModel::AbsMagColumn);
 
-    searchResultLabel->setText(QString(_("%1 objects found")).arg(starModel->rowCount(QModelIndex())));
+        searchResultLabel->setText(QString(_("%1 objects found")).arg(starModel->rowCount(QModelIndex())));
+    });
 }
 
 
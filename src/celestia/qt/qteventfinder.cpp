@@ -148,6 +148,7 @@ public:
     void sort(int column, Qt::SortOrder order) override;
 
     void setEclipses(const std::vector<Eclipse>& _eclipses);
+    void addEclipse(const Eclipse& eclipse);
 
     const Eclipse* eclipseAtIndex(const QModelIndex& index) const;
 
@@ -281,6 +282,16 @@ EventFinder::EventTableModel::setEclipses(const std::vector<Eclipse>& _eclipses)
 }
 
 
+void
+EventFinder::EventTableModel::addEclipse(const Eclipse& eclipse)
+{
+    int row = (int) eclipses.size();
+    beginInsertRows(QModelIndex(), row, row);
+    eclipses.push_back(eclipse);
+    endInsertRows();
+}
+
+
 const Eclipse*
 EventFinder::EventTableModel::eclipseAtIndex(const QModelIndex& index) const
 {
@@ -396,6 +407,15 @@ EventFinder::eclipseFinderProgressUpdate(double t)
 }
 
 
+void
+EventFinder::eclipseFinderEclipseFound(const Eclipse& eclipse)
+{
+    // Show eclipses as they are found, the table is sorted once the
+    // search is complete
+    model->addEclipse(eclipse);
+}
+
+
 void
 EventFinder::slotFindEclipses()
 {
@@ -440,6 +460,8 @@ EventFinder::slotFindEclipses()
     progress->setWindowModality(Qt::WindowModal);
     progress->show();
 
+    activeEclipse = nullptr;
+    model->setEclipses({});
 
     std::vector<Eclipse> eclipses;
     finder.findEclipses(startTimeTDB, endTimeTDB,
@@ -39,6 +39,7 @@ public:
     ~EventFinder() = default;
 
     EclipseFinderWatcher::Status eclipseFinderProgressUpdate(double t);
+    void eclipseFinderEclipseFound(const Eclipse& eclipse) override;
 
 public slots:
     void slotFindEclipses();
@@ -13,6 +13,7 @@
 #include "qtsolarsystembrowser.h"
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <Qt>
@@ -138,6 +139,9 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     int rowCount(const QModelIndex& index) const override;
     int columnCount(const QModelIndex& index) const override;
+    bool hasChildren(const QModelIndex& parent) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     void sort(int column, Qt::SortOrder order) override;
     QModelIndex sibling(int row, int column, const QModelIndex &index) const override;
 
@@ -153,6 +157,9 @@ public:
     void buildModel(Star* star, bool _groupByClass, int _bodyFilter);
 
 private:
+    // The children of an item are only added when the view asks for them,
+    // usually when the item is expanded, so systems with many small bodies
+    // don't need an item for each of them up front.
     class TreeItem
     {
     public:
@@ -161,26 +168,35 @@ private:
 
         Selection obj;
         TreeItem* parent{nullptr};
-        TreeItem** children{nullptr};
-        int nChildren{0};
+        std::vector<TreeItem*> children;
         int childIndex{0};
         int classification{0};
+        bool populated{false};
+        // The objects of a group, until its children are added
+        std::vector<Body*> groupObjects;
     };
 
-    TreeItem* createTreeItem(Selection sel, TreeItem* parent, int childIndex);
+    TreeItem* createTreeItem(Selection sel, TreeItem* parent, int childIndex) const;
+    void getSystems(const TreeItem* item,
+                    PlanetarySystem*& sys,
+                    const std::vector<Star*>*& orbitingStars) const;
+    std::vector<TreeItem*> createChildren(TreeItem* item) const;
     void addTreeItemChildren(TreeItem* item,
                              PlanetarySystem* sys,
-                             const std::vector<Star*>* orbitingStars);
+                             const std::vector<Star*>* orbitingStars,
+                             std::vector<TreeItem*>& children) const;
     void addTreeItemChildrenFiltered(TreeItem* item,
-                                     PlanetarySystem* sys);
+                                     PlanetarySystem* sys,
+                                     std::vector<TreeItem*>& children) const;
     void addTreeItemChildrenGrouped(TreeItem* item,
                                     PlanetarySystem* sys,
                                     const std::vector<Star*>* orbitingStars,
-                                    Selection parent);
+                                    Selection parent,
+                                    std::vector<TreeItem*>& children) const;
     TreeItem* createGroupTreeItem(int classification,
-                                  const std::vector<Body*>& objects,
+                                  std::vector<Body*>&& objects,
                                   TreeItem* parent,
-                                  int childIndex);
+                                  int childIndex) const;
 
     TreeItem* itemAtIndex(const QModelIndex& index) const;
 
@@ -194,12 +210,8 @@ private:
 
 SolarSystemBrowser::SolarSystemTreeModel::TreeItem::~TreeItem()
 {
-    if (children != nullptr)
-    {
-        for (int i = 0; i < nChildren; i++)
-            delete children[i];
-        delete[] children;
-    }
+    for (TreeItem* child : children)
+        delete child;
 }
 
 
@@ -211,7 +223,7 @@ SolarSystemBrowser::SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _
 }
 
 
-// Call createTreeItem() to build the parallel tree structure
+// Create the root of the tree; the other items are created on demand
 void
 SolarSystemBrowser::SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyFilter)
 {
@@ -224,13 +236,10 @@ SolarSystemBrowser::SolarSystemTreeModel::buildModel(Star* star, bool _groupByCl
 
     rootItem = new TreeItem();
     rootItem->obj = Selection();
+    rootItem->populated = true;
 
     if (star != nullptr)
-    {
-        rootItem->nChildren = 1;
-        rootItem->children = new TreeItem*[1];
-        rootItem->children[0] = createTreeItem(Selection(star), rootItem, 0);
-    }
+        rootItem->children.push_back(createTreeItem(Selection(star), rootItem, 0));
 
     endResetModel();
 }
@@ -247,16 +256,25 @@ SolarSystemBrowser::SolarSystemTreeModel::buildModel(Star* star, bool _groupByCl
 SolarSystemBrowser::SolarSystemTreeModel::TreeItem*
 SolarSystemBrowser::SolarSystemTreeModel::createTreeItem(Selection sel,
                                                          TreeItem* parent,
-                                                         int childIndex)
+                                                         int childIndex) const
 {
     auto* item = new TreeItem();
     item->parent = parent;
     item->obj = sel;
     item->childIndex = childIndex;
+    return item;
+}
 
-    const std::vector<Star*>* orbitingStars = nullptr;
 
-    PlanetarySystem* sys = nullptr;
+void
+SolarSystemBrowser::SolarSystemTreeModel::getSystems(const TreeItem* item,
+                                                     PlanetarySystem*& sys,
+                                                     const std::vector<Star*>*& orbitingStars) const
+{
+    sys = nullptr;
+    orbitingStars = nullptr;
+
+    Selection sel = item->obj;
     if (sel.body() != nullptr)
     {
         sys = sel.body()->getSatellites();
@@ -273,84 +291,71 @@ SolarSystemBrowser::SolarSystemTreeModel::createTreeItem(Selection sel,
 
         orbitingStars = sel.star()->getOrbitingStars();
     }
+}
+
+
+std::vector<SolarSystemBrowser::SolarSystemTreeModel::TreeItem*>
+SolarSystemBrowser::SolarSystemTreeModel::createChildren(TreeItem* item) const
+{
+    std::vector<TreeItem*> children;
+
+    if (item->classification != 0)
+    {
+        children.reserve(item->groupObjects.size());
+        for (Body* body : item->groupObjects)
+            children.push_back(createTreeItem(Selection(body), item, static_cast<int>(children.size())));
+        item->groupObjects = std::vector<Body*>();
+        return children;
+    }
+
+    PlanetarySystem* sys;
+    const std::vector<Star*>* orbitingStars;
+    getSystems(item, sys, orbitingStars);
 
     if (groupByClass && sys != nullptr)
-        addTreeItemChildrenGrouped(item, sys, orbitingStars, sel);
+        addTreeItemChildrenGrouped(item, sys, orbitingStars, item->obj, children);
     else if (bodyFilter != 0 && sys != nullptr)
-        addTreeItemChildrenFiltered(item, sys);
+        addTreeItemChildrenFiltered(item, sys, children);
     else
-        addTreeItemChildren(item, sys, orbitingStars);
+        addTreeItemChildren(item, sys, orbitingStars, children);
 
-    return item;
+    return children;
 }
 
 
 void
 SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildren(TreeItem* item,
                                                               PlanetarySystem* sys,
-                                                              const std::vector<Star*>* orbitingStars)
+                                                              const std::vector<Star*>* orbitingStars,
+                                                              std::vector<TreeItem*>& children) const
 {
-    // Calculate the number of children: the number of orbiting stars plus
-    // the number of orbiting solar system bodies.
-    item->nChildren = 0;
+    // Add the stars
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
-    if (sys != nullptr)
-        item->nChildren += sys->getSystemSize();
-
-    if (item->nChildren != 0)
     {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-
-        // Add the stars
-        if (orbitingStars != nullptr)
-        {
-            for (unsigned int i = 0; i < orbitingStars->size(); i++)
-            {
-                Selection child(orbitingStars->at(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
-        }
+        for (Star* star : *orbitingStars)
+            children.push_back(createTreeItem(Selection(star), item, static_cast<int>(children.size())));
+    }
 
-        // Add the solar system bodies
-        if (sys != nullptr)
-        {
-            for (int i = 0; i < sys->getSystemSize(); i++)
-            {
-                Selection child(sys->getBody(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
-        }
+    // Add the solar system bodies
+    if (sys != nullptr)
+    {
+        for (int i = 0; i < sys->getSystemSize(); i++)
+            children.push_back(createTreeItem(Selection(sys->getBody(i)), item, static_cast<int>(children.size())));
     }
 }
 
 
 void
 SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenFiltered(TreeItem* item,
-                                                                      PlanetarySystem* sys)
+                                                                      PlanetarySystem* sys,
+                                                                      std::vector<TreeItem*>& children) const
 {
-    std::vector<Body*> bodies;
-
     for (int i = 0; i < sys->getSystemSize(); i++)
     {
         Body* body = sys->getBody(i);
         if ((bodyFilter & body->getClassification()) != 0)
-            bodies.push_back(body);
+            children.push_back(createTreeItem(Selection(body), item, static_cast<int>(children.size())));
     }
-
-    // Calculate the total number of children
-    // WARN: max(size_t) > max(int) so in theory it's possible to have a negative value
-    if ((item->nChildren = static_cast<int>(bodies.size())) <= 0)
-        return;
-
-    item->children = new TreeItem*[item->nChildren];
-
-    // Add the direct children
-    for (int i = 0; i < (int) bodies.size(); i++)
-        item->children[i] = createTreeItem(bodies[i], item, i);
 }
 
 
@@ -363,7 +368,8 @@ void
 SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* item,
                                                                      PlanetarySystem* sys,
                                                                      const std::vector<Star*>* orbitingStars,
-                                                                     Selection parent)
+                                                                     Selection parent,
+                                                                     std::vector<TreeItem*>& children) const
 {
     std::vector<Body*> asteroids;
     std::vector<Body*> spacecraft;
@@ -433,96 +439,34 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
         }
     }
 
-    // Calculate the total number of children
-    item->nChildren = 0;
+    // Add the stars
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
-
-    item->nChildren += normal.size();
-    if (!asteroids.empty())
-        item->nChildren++;
-    if (!spacecraft.empty())
-        item->nChildren++;
-    if (!minorMoons.empty())
-        item->nChildren++;
-    if (!surfaceFeatures.empty())
-        item->nChildren++;
-    if (!components.empty())
-        item->nChildren++;
-    if (!other.empty())
-        item->nChildren++;
-
-    if (item->nChildren != 0)
     {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-        {
-            // Add the stars
-            if (orbitingStars != nullptr)
-            {
-                for (unsigned int i = 0; i < orbitingStars->size(); i++)
-                {
-                    Selection child(orbitingStars->at(i));
-                    item->children[childIndex] = createTreeItem(child, item, childIndex);
-                    childIndex++;
-                }
-            }
-
-            // Add the direct children
-            for (int i = 0; i < (int) normal.size(); i++)
-            {
-                item->children[childIndex] = createTreeItem(normal[i], item, childIndex);
-                childIndex++;
-            }
-
-            // Add the groups
-            if (!minorMoons.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::MinorMoon,
-                                                                 minorMoons,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!asteroids.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Asteroid,
-                                                                 asteroids,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!spacecraft.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Spacecraft,
-                                                                 spacecraft,
-                                                                 item, childIndex);
-                childIndex++;
-            }
+        for (Star* star : *orbitingStars)
+            children.push_back(createTreeItem(Selection(star), item, static_cast<int>(children.size())));
+    }
 
-            if (!surfaceFeatures.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::SurfaceFeature,
-                                                                 surfaceFeatures,
-                                                                 item, childIndex);
-                childIndex++;
-            }
+    // Add the direct children
+    for (Body* body : normal)
+        children.push_back(createTreeItem(Selection(body), item, static_cast<int>(children.size())));
 
-            if (!components.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Component,
-                                                                 components,
-                                                                 item, childIndex);
-                childIndex++;
-            }
+    // Add the groups
+    std::pair<int, std::vector<Body*>*> groups[] =
+    {
+        { Body::MinorMoon, &minorMoons },
+        { Body::Asteroid, &asteroids },
+        { Body::Spacecraft, &spacecraft },
+        { Body::SurfaceFeature, &surfaceFeatures },
+        { Body::Component, &components },
+        { Body::Unknown, &other },
+    };
 
-            if (!other.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Unknown,
-                                                                 other,
-                                                                 item, childIndex);
-                childIndex++;
-            }
+    for (auto& [classification, objects] : groups)
+    {
+        if (!objects->empty())
+        {
+            children.push_back(createGroupTreeItem(classification, std::move(*objects),
+                                                   item, static_cast<int>(children.size())));
         }
     }
 }
@@ -530,25 +474,15 @@ SolarSystemBrowser::SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* i
 
 SolarSystemBrowser::SolarSystemTreeModel::TreeItem*
 SolarSystemBrowser::SolarSystemTreeModel::createGroupTreeItem(int classification,
-                                                              const std::vector<Body*>& objects,
+                                                              std::vector<Body*>&& objects,
                                                               TreeItem* parent,
-                                                              int childIndex)
+                                                              int childIndex) const
 {
     auto* item = new TreeItem();
     item->parent = parent;
     item->childIndex = childIndex;
     item->classification = classification;
-
-    if (!objects.empty())
-    {
-        item->nChildren = (int) objects.size();
-        item->children = new TreeItem*[item->nChildren];
-        for (int i = 0; i < item->nChildren; i++)
-        {
-            item->children[i] = createTreeItem(Selection(objects[i]), item, i);
-        }
-    }
-
+    item->groupObjects = std::move(objects);
     return item;
 }
 
@@ -586,7 +520,7 @@ SolarSystemBrowser::SolarSystemTreeModel::index(int row, int column, const QMode
     else
         parentItem = static_cast<TreeItem*>(parent.internalPointer());
 
-    if (row < parentItem->nChildren)
+    if (row < static_cast<int>(parentItem->children.size()))
         return createIndex(row, column, parentItem->children[row]);
     else
         return QModelIndex();
@@ -690,10 +624,56 @@ SolarSystemBrowser::SolarSystemTreeModel::rowCount(const QModelIndex& parent) co
     if (parent.column() > 0)
         return 0;
 
-    if (!parent.isValid())
-        return rootItem->nChildren;
+    return static_cast<int>(itemAtIndex(parent)->children.size());
+}
+
+
+// Override QAbstractDataModel::hasChildren(), telling whether items which
+// weren't populated yet can have children without adding them
+bool
+SolarSystemBrowser::SolarSystemTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    const TreeItem* item = itemAtIndex(parent);
+    if (item->populated)
+        return !item->children.empty();
+    if (item->classification != 0)
+        return !item->groupObjects.empty();
+
+    PlanetarySystem* sys;
+    const std::vector<Star*>* orbitingStars;
+    getSystems(item, sys, orbitingStars);
+    return (sys != nullptr && sys->getSystemSize() > 0) ||
+           (orbitingStars != nullptr && !orbitingStars->empty());
+}
+
+
+// Override QAbstractDataModel::canFetchMore()
+bool
+SolarSystemBrowser::SolarSystemTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !itemAtIndex(parent)->populated;
+}
+
+
+// Override QAbstractDataModel::fetchMore(), adding the children of an item
+void
+SolarSystemBrowser::SolarSystemTreeModel::fetchMore(const QModelIndex& parent)
+{
+    TreeItem* item = itemAtIndex(parent);
+    if (item->populated)
+        return;
+
+    std::vector<TreeItem*> children = createChildren(item);
+    item->populated = true;
+    if (children.empty())
+        return;
 
-    return static_cast<TreeItem*>(parent.internalPointer())->nChildren;
+    beginInsertRows(parent, 0, static_cast<int>(children.size()) - 1);
+    item->children = std::move(children);
+    endInsertRows();
 }
 
 
@@ -912,6 +892,7 @@ SolarSystemBrowser::slotRefreshTree()
     QModelIndex primary = solarSystemModel->index(0, 0, QModelIndex());
     if (primary.isValid() && solarSystemModel->objectAtIndex(primary).star() != nullptr)
     {
+        solarSystemModel->fetchMore(primary);
         treeView->setExpanded(primary, true);
         QModelIndex secondary = solarSystemModel->index(0, 0, primary);
         if (secondary.isValid() && solarSystemModel->objectAtIndex(secondary).star() != nullptr)
@@ -0,0 +1,473 @@
+// renderbenchmark.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Renders fixed scenes along fixed camera paths and reports frame times
+// and draw statistics.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "renderbenchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include <Eigen/Geometry>
+#include <fmt/format.h>
+
+#include <celengine/body.h>
+#include <celengine/glsupport.h>
+#include <celengine/observer.h>
+#include <celengine/render.h>
+#include <celengine/selection.h>
+#include <celengine/simulation.h>
+#include <celengine/univcoord.h>
+#include <celmath/geomutil.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "celestiacore.h"
+
+using celestia::engine::FrameProfiler;
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// 2023 Feb 25 0:00 UTC, a date at which the scenes below look as intended
+constexpr double BenchmarkDate = 2460000.5;
+
+// Frames rendered after each scene so that the profiler results of its last
+// frames come in
+constexpr int DrainFrames = 6;
+
+struct CameraPose
+{
+    // Relative to the target, in units of the target's radius
+    Eigen::Vector3d position;
+    Eigen::Vector3d lookAt;
+};
+
+Eigen::Vector3d
+Spherical(double radius, double longitude, double latitude)
+{
+    return radius * Eigen::Vector3d(std::cos(latitude) * std::cos(longitude),
+                                    std::sin(latitude),
+                                    -std::cos(latitude) * std::sin(longitude));
+}
+
+// The nearest rank percentile of sorted values
+double
+Percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp(rank, std::size_t(1), sorted.size()) - 1];
+}
+
+void
+WriteDistribution(std::FILE* out, std::string_view name, std::vector<double> values, std::string_view indent)
+{
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (double value : values)
+        sum += value;
+    double mean = values.empty() ? 0.0 : sum / static_cast<double>(values.size());
+
+    fmt::print(out,
+               "{}\"{}\": {{ \"mean\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}",
+               indent, name, mean,
+               Percentile(values, 50.0), Percentile(values, 90.0), Percentile(values, 99.0),
+               values.empty() ? 0.0 : values.back());
+}
+
+template<typename F>
+double
+Mean(const std::vector<FrameProfiler::DrawCounts>& counts, F member)
+{
+    if (counts.empty())
+        return 0.0;
+    double sum = 0.0;
+    for (const auto& c : counts)
+        sum += static_cast<double>(member(c));
+    return sum / static_cast<double>(counts.size());
+}
+
+void
+WriteCounts(std::FILE* out, const std::vector<FrameProfiler::DrawCounts>& counts, std::string_view indent)
+{
+    fmt::print(out,
+               "{}\"drawCalls\": {:.1f},\n{}\"triangles\": {:.1f},\n{}\"uploadedBytes\": {:.1f},\n"
+               "{}\"stateChanges\": {:.1f},\n{}\"skippedStateChanges\": {:.1f}",
+               indent, Mean(counts, [](const auto& c) { return c.drawCalls; }),
+               indent, Mean(counts, [](const auto& c) { return c.triangles; }),
+               indent, Mean(counts, [](const auto& c) { return c.uploadedBytes; }),
+               indent, Mean(counts, [](const auto& c) { return c.stateChanges; }),
+               indent, Mean(counts, [](const auto& c) { return c.skippedStateChanges; }));
+}
+
+std::string
+GLString(GLenum name)
+{
+    const auto* s = reinterpret_cast<const char*>(glGetString(name));
+    if (s == nullptr)
+        return {};
+
+    // Escape what JSON requires; driver strings are plain text otherwise
+    std::string result;
+    for (const char* p = s; *p != '\0'; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+            result += '\\';
+        if (static_cast<unsigned char>(*p) >= 0x20)
+            result += *p;
+    }
+    return result;
+}
+
+FrameProfiler::DrawCounts
+CurrentCounts()
+{
+    return { gl::drawCounters.drawCalls, gl::drawCounters.triangles, gl::drawCounters.uploadedBytes,
+             gl::drawCounters.stateChanges, gl::drawCounters.skippedStateChanges };
+}
+
+struct Scene
+{
+    std::string_view name;
+    std::string_view target;
+    std::uint64_t renderFlags;
+    int labelMode;
+    // Whether the path is in the equatorial frame of the target body rather
+    // than the ecliptic frame
+    bool equatorial;
+    // The camera at t in [0, 1]
+    CameraPose (*path)(double t);
+};
+
+constexpr int AllLabels = Renderer::StarLabels | Renderer::PlanetLabels | Renderer::MoonLabels |
+                          Renderer::ConstellationLabels | Renderer::GalaxyLabels |
+                          Renderer::AsteroidLabels | Renderer::SpacecraftLabels |
+                          Renderer::LocationLabels | Renderer::CometLabels |
+                          Renderer::NebulaLabels | Renderer::OpenClusterLabels |
+                          Renderer::DwarfPlanetLabels | Renderer::MinorMoonLabels |
+                          Renderer::GlobularLabels;
+
+const std::array<Scene, 5> Scenes
+{
+    // The inner planets from above the ecliptic, moving in from the orbit
+    // of Saturn to that of Mars, with the orbits shown
+    Scene
+    {
+        "solar-system", "Sol",
+        Renderer::DefaultRenderFlags | Renderer::ShowOrbits,
+        Renderer::PlanetLabels | Renderer::DwarfPlanetLabels,
+        false,
+        [](double t)
+        {
+            double r = 2000.0 * std::pow(300.0 / 2000.0, t);
+            return CameraPose{ Spherical(r, math::degToRad(30.0 + 40.0 * t), math::degToRad(25.0)),
+                               Eigen::Vector3d::Zero() };
+        },
+    },
+    // Past the Andromeda galaxy at a few of its radii, looking at its centre
+    Scene
+    {
+        "galaxy-flyby", "M 31",
+        Renderer::DefaultRenderFlags,
+        Renderer::GalaxyLabels,
+        false,
+        [](double t)
+        {
+            return CameraPose{ Eigen::Vector3d(-3.0 + 6.0 * t, 0.6, 1.5),
+                               Eigen::Vector3d::Zero() };
+        },
+    },
+    // Along the main belt at 2.8 AU, about 600 solar radii, looking ahead
+    // along it
+    Scene
+    {
+        "asteroid-belt", "Sol",
+        Renderer::DefaultRenderFlags | Renderer::ShowOrbits,
+        Renderer::AsteroidLabels,
+        false,
+        [](double t)
+        {
+            double longitude = math::degToRad(20.0 * t);
+            return CameraPose{ Spherical(600.0, longitude, math::degToRad(2.0)),
+                               Spherical(600.0, longitude + math::degToRad(15.0), 0.0) };
+        },
+    },
+    // Around Jupiter with every kind of label, the orbits, markers and
+    // constellation diagrams and boundaries
+    Scene
+    {
+        "labels", "Sol/Jupiter",
+        Renderer::DefaultRenderFlags | Renderer::ShowOrbits | Renderer::ShowMarkers |
+            Renderer::ShowDiagrams | Renderer::ShowBoundaries,
+        AllLabels,
+        false,
+        [](double t)
+        {
+            return CameraPose{ Spherical(60.0, math::degToRad(90.0 * t), math::degToRad(10.0)),
+                               Eigen::Vector3d::Zero() };
+        },
+    },
+    // Saturn's rings close up, moving in just above the ring plane from
+    // outside the A ring to above the B ring
+    Scene
+    {
+        "saturn-rings", "Sol/Saturn",
+        Renderer::DefaultRenderFlags,
+        Renderer::MoonLabels,
+        true,
+        [](double t)
+        {
+            double r = 5.0 - 3.4 * t;
+            return CameraPose{ Spherical(r, math::degToRad(-30.0 * t), math::degToRad(1.5)),
+                               Eigen::Vector3d::Zero() };
+        },
+    },
+};
+
+} // end unnamed namespace
+
+
+RenderBenchmark::RenderBenchmark(CelestiaCore& appCore, const Options& options) :
+    m_appCore(appCore),
+    m_options(options)
+{
+    m_options.frames = std::max(m_options.frames, 1);
+    m_options.warmupFrames = std::max(m_options.warmupFrames, 0);
+}
+
+
+std::vector<std::string_view>
+RenderBenchmark::sceneNames()
+{
+    std::vector<std::string_view> names;
+    for (const Scene& scene : Scenes)
+        names.push_back(scene.name);
+    return names;
+}
+
+
+bool
+RenderBenchmark::run(const std::function<void()>& present)
+{
+    Simulation* sim = m_appCore.getSimulation();
+    Renderer* renderer = m_appCore.getRenderer();
+    FrameProfiler& profiler = renderer->getFrameProfiler();
+
+    // Saved to be restored afterwards
+    double time = sim->getTime();
+    bool paused = sim->getPauseState();
+    UniversalCoord position = sim->getObserver().getPosition();
+    Eigen::Quaternionf orientation = sim->getObserver().getOrientationf();
+    ObserverFrame::SharedConstPtr frame = sim->getFrame();
+    Selection selection = sim->getSelection();
+    std::uint64_t renderFlags = renderer->getRenderFlags();
+    int labelMode = renderer->getLabelMode();
+    int hudDetail = m_appCore.getHudDetail();
+    bool profiling = profiler.isEnabled();
+
+    profiler.setEnabled(true);
+    m_appCore.setHudDetail(0);
+    sim->setSelection(Selection());
+
+    m_results.clear();
+    for (std::size_t i = 0; i < Scenes.size(); ++i)
+    {
+        if (Scenes[i].name.find(m_options.filter) == std::string_view::npos)
+            continue;
+
+        SceneResult result;
+        if (runScene(i, present, result))
+            m_results.push_back(std::move(result));
+    }
+
+    profiler.setEnabled(profiling);
+    m_appCore.setHudDetail(hudDetail);
+    renderer->setRenderFlags(renderFlags);
+    renderer->setLabelMode(labelMode);
+    sim->setFrame(frame->getCoordinateSystem(), frame->getRefObject(), frame->getTargetObject());
+    sim->setObserverPosition(position);
+    sim->setObserverOrientation(orientation);
+    sim->setSelection(selection);
+    sim->setTime(time);
+    sim->setPauseState(paused);
+
+    return !m_results.empty();
+}
+
+
+bool
+RenderBenchmark::runScene(std::size_t index, const std::function<void()>& present, SceneResult& result)
+{
+    const Scene& scene = Scenes[index];
+    Simulation* sim = m_appCore.getSimulation();
+    Renderer* renderer = m_appCore.getRenderer();
+    const FrameProfiler& profiler = renderer->getFrameProfiler();
+
+    Selection target = sim->findObjectFromPath(scene.target);
+    if (target.empty())
+    {
+        GetLogger()->warn("Skipping benchmark scene {}: {} not found\n", scene.name, scene.target);
+        return false;
+    }
+
+    GetLogger()->info("Rendering benchmark scene {}\n", scene.name);
+
+    renderer->setRenderFlags(scene.renderFlags);
+    renderer->setLabelMode(scene.labelMode);
+    sim->cancelMotion();
+    sim->setFrame(ObserverFrame::Universal, Selection());
+    sim->setTime(BenchmarkDate);
+    sim->setPauseState(true);
+
+    const double radius = target.radius();
+    Eigen::Quaterniond toEcliptic = Eigen::Quaterniond::Identity();
+    if (scene.equatorial && target.body() != nullptr)
+        toEcliptic = target.body()->getEclipticToEquatorial(BenchmarkDate).conjugate();
+    UniversalCoord center = target.getPosition(BenchmarkDate);
+    const Eigen::Vector3d up = toEcliptic * Eigen::Vector3d::UnitY();
+
+    const int warmup = m_options.warmupFrames;
+    const int frames = m_options.frames;
+    std::uint64_t firstProfiled = 0;
+    std::uint64_t nextProfiled = 0;
+
+    result.name = scene.name;
+    result.wallTimes.reserve(static_cast<std::size_t>(frames));
+    result.profiles.reserve(static_cast<std::size_t>(frames));
+    result.frameCounts.reserve(static_cast<std::size_t>(frames));
+
+    for (int i = 0; i < warmup + frames + DrainFrames; ++i)
+    {
+        bool measured = i >= warmup && i < warmup + frames;
+        double t = frames > 1 ? static_cast<double>(i - warmup) / static_cast<double>(frames - 1) : 0.0;
+        CameraPose pose = scene.path(std::clamp(t, 0.0, 1.0));
+        Eigen::Vector3d from = toEcliptic * (pose.position * radius);
+        Eigen::Vector3d to = toEcliptic * (pose.lookAt * radius);
+        sim->setObserverPosition(center.offsetKm(from));
+        sim->setObserverOrientation(math::LookAt(from, to, up).cast<float>());
+
+        if (i == warmup)
+        {
+            firstProfiled = profiler.nextFrameNumber();
+            nextProfiled = firstProfiled;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        FrameProfiler::DrawCounts counts = CurrentCounts();
+        m_appCore.tick(0.0);
+        m_appCore.draw();
+        if (present)
+            present();
+        glFinish();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (measured)
+        {
+            FrameProfiler::DrawCounts end = CurrentCounts();
+            result.wallTimes.push_back(elapsed.count());
+            result.frameCounts.push_back({ end.drawCalls - counts.drawCalls,
+                                           end.triangles - counts.triangles,
+                                           end.uploadedBytes - counts.uploadedBytes,
+                                           end.stateChanges - counts.stateChanges,
+                                           end.skippedStateChanges - counts.skippedStateChanges });
+        }
+
+        // Results of the profiler arrive a few frames late
+        if (const auto& times = profiler.lastFrame();
+            i >= warmup && times.frame >= nextProfiled && times.frame < firstProfiled + static_cast<std::uint64_t>(frames))
+        {
+            result.profiles.push_back(times);
+            nextProfiled = times.frame + 1;
+        }
+    }
+
+    if (result.profiles.size() < static_cast<std::size_t>(frames))
+    {
+        GetLogger()->warn("Only {} of {} frames of benchmark scene {} were profiled\n",
+                          result.profiles.size(), frames, scene.name);
+    }
+
+    return true;
+}
+
+
+bool
+RenderBenchmark::writeReport(const fs::path& path) const
+{
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> file(std::fopen(path.string().c_str(), "w"), &std::fclose);
+    if (file == nullptr)
+    {
+        GetLogger()->error("Can't open {} for writing\n", path);
+        return false;
+    }
+
+    std::FILE* out = file.get();
+    const Renderer* renderer = m_appCore.getRenderer();
+    fmt::print(out, "{{\n  \"renderer\": \"{}\",\n  \"version\": \"{}\",\n",
+               GLString(GL_RENDERER), GLString(GL_VERSION));
+    fmt::print(out, "  \"width\": {},\n  \"height\": {},\n  \"frames\": {},\n  \"scenes\": [",
+               renderer->getWindowWidth(), renderer->getWindowHeight(), m_options.frames);
+
+    for (std::size_t i = 0; i < m_results.size(); ++i)
+    {
+        const SceneResult& result = m_results[i];
+        bool hasGpuTimes = !result.profiles.empty() &&
+                           std::all_of(result.profiles.begin(), result.profiles.end(),
+                                       [](const auto& p) { return p.hasGpuTimes; });
+
+        fmt::print(out, "{}\n    {{\n      \"name\": \"{}\",\n", i == 0 ? "" : ",", result.name);
+        WriteDistribution(out, "wall", result.wallTimes, "      ");
+        fmt::print(out, ",\n");
+        WriteCounts(out, result.frameCounts, "      ");
+        fmt::print(out, ",\n      \"sections\": {{");
+
+        for (std::size_t s = 0; s < FrameProfiler::SectionCount; ++s)
+        {
+            std::vector<double> cpu;
+            std::vector<double> gpu;
+            std::vector<FrameProfiler::DrawCounts> counts;
+            for (const auto& p : result.profiles)
+            {
+                cpu.push_back(p.cpu[s]);
+                gpu.push_back(p.gpu[s]);
+                counts.push_back(p.draws[s]);
+            }
+
+            fmt::print(out, "{}\n        \"{}\": {{\n", s == 0 ? "" : ",",
+                       FrameProfiler::sectionName(static_cast<FrameProfiler::Section>(s)));
+            WriteDistribution(out, "cpu", std::move(cpu), "          ");
+            fmt::print(out, ",\n");
+            if (hasGpuTimes)
+            {
+                WriteDistribution(out, "gpu", std::move(gpu), "          ");
+                fmt::print(out, ",\n");
+            }
+            WriteCounts(out, counts, "          ");
+            fmt::print(out, "\n        }}");
+        }
+
+        fmt::print(out, "\n      }}\n    }}");
+    }
+
+    fmt::print(out, "\n  ]\n}}\n");
+    return std::ferror(out) == 0;
+}
+
+} // end namespace celestia
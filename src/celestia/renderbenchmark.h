@@ -0,0 +1,84 @@
+// renderbenchmark.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Renders fixed scenes along fixed camera paths and reports frame times
+// and draw statistics.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/frameprofiler.h>
+
+class CelestiaCore;
+
+namespace celestia
+{
+
+/*! A reproducible benchmark of the renderer. Each scene sets the render
+ *  flags and label mode, stops the simulation time at a fixed date and
+ *  moves the camera along a fixed path while frames are rendered, so that
+ *  runs on different releases or hardware render the same frames.
+ *
+ *  The wall time of each frame is taken after glFinish, so it includes
+ *  the GPU work. The CPU and GPU times, draw calls, triangles and
+ *  uploaded bytes of the passes come from the renderer's frame profiler,
+ *  which is enabled during the run.
+ */
+class RenderBenchmark
+{
+public:
+    struct Options
+    {
+        // Measured frames per scene, rendered after the warm-up frames at
+        // the start of the camera path, which give the textures time to load
+        int frames{ 300 };
+        int warmupFrames{ 60 };
+        // Only run the scenes whose name contains this
+        std::string filter;
+    };
+
+    RenderBenchmark(CelestiaCore& appCore, const Options& options);
+
+    // Render the scenes, calling present after every frame if it's set,
+    // e.g. to swap the buffers of a window. The state of the simulation
+    // and renderer is restored afterwards. Returns false if no scene could
+    // be run.
+    bool run(const std::function<void()>& present = {});
+
+    // Write the results as JSON
+    bool writeReport(const fs::path& path) const;
+
+    static std::vector<std::string_view> sceneNames();
+
+private:
+    struct SceneResult
+    {
+        std::string name;
+        // Milliseconds
+        std::vector<double> wallTimes;
+        std::vector<engine::FrameProfiler::FrameTimes> profiles;
+        // All the work of each frame, including the uploads outside of
+        // the renderer's passes
+        std::vector<engine::FrameProfiler::DrawCounts> frameCounts;
+    };
+
+    bool runScene(std::size_t index, const std::function<void()>& present, SceneResult& result);
+
+    CelestiaCore& m_appCore;
+    Options m_options;
+    std::vector<SceneResult> m_results;
+};
+
+} // end namespace celestia
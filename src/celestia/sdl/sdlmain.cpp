@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cctype>
 #include <cstdio>
 #include <cstring>
@@ -85,6 +86,7 @@ class SDL_Application
 
  private:
     void display();
+    void waitForEvent(double seconds);
 
     // handlers
     void handleTextInputEvent(const SDL_TextInputEvent &event);
@@ -185,6 +187,21 @@ SDL_Application::display()
     SDL_GL_SwapWindow(m_mainWindow);
 }
 
+// Wait until an event arrives or the frame pacer wants a frame. The wait is
+// limited so that the core keeps ticking even with an infinite idle
+// interval. The browser calls the main loop at its own rate, so it doesn't
+// wait there.
+void
+SDL_Application::waitForEvent([[maybe_unused]] double seconds)
+{
+#ifndef __EMSCRIPTEN__
+    constexpr double MaxWait = 1.0;
+    auto timeout = static_cast<int>(std::min(seconds, MaxWait) * 1000.0);
+    if (timeout > 0)
+        SDL_WaitEventTimeout(nullptr, timeout);
+#endif
+}
+
 bool
 SDL_Application::initCelestiaCore()
 {
@@ -287,6 +304,10 @@ SDL_Application::run()
 SDL_Application::RunLoopState
 SDL_Application::update()
 {
+    // In threaded mode the tick started after the last frame was drawn
+    // runs until here
+    m_appCore->finishTick();
+
     bool stop = false;
     while (!stop)
     {
@@ -301,8 +322,32 @@ SDL_Application::update()
             break;
         }
     }
-    m_appCore->tick();
-    display();
+    if (m_appCore->getThreadedTick())
+    {
+        // Draw the frame of the last tick and run the next one while the
+        // frame is swapped
+        if (m_appCore->viewUpdateRequired())
+        {
+            m_appCore->draw();
+            m_appCore->tickAsync();
+            SDL_GL_SwapWindow(m_mainWindow);
+        }
+        else
+        {
+            // The state can't be read while the tick runs
+            double waitTime = m_appCore->getFrameWaitTime();
+            m_appCore->tickAsync();
+            waitForEvent(waitTime);
+        }
+    }
+    else
+    {
+        m_appCore->tick();
+        if (m_appCore->viewUpdateRequired())
+            display();
+        else
+            waitForEvent(m_appCore->getFrameWaitTime());
+    }
     return RunLoopState::Normal;
 }
 
@@ -548,6 +593,9 @@ SDL_Application::handleWindowEvent(const SDL_WindowEvent &event)
         SDL_GL_GetDrawableSize(m_mainWindow, &m_windowWidth, &m_windowHeight);
         m_appCore->resize(m_windowWidth, m_windowHeight);
         break;
+    case SDL_WINDOWEVENT_EXPOSED:
+        m_appCore->getFramePacer().requestFrame();
+        break;
     default:
         break;
     }
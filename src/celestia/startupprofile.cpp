@@ -0,0 +1,188 @@
+// startupprofile.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Wall clock time, bytes read and object counts for the phases of startup.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "startupprofile.h"
+
+#include <fstream>
+#include <ostream>
+#include <system_error>
+
+#include <fmt/ostream.h>
+
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+std::string
+escapeJSON(std::string_view s)
+{
+    std::string result;
+    result.reserve(s.size());
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':  result.append("\\\""); break;
+        case '\\': result.append("\\\\"); break;
+        case '\n': result.append("\\n"); break;
+        case '\t': result.append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                result.append(fmt::format("\\u{:04x}", static_cast<unsigned int>(c)));
+            else
+                result.push_back(c);
+            break;
+        }
+    }
+
+    return result;
+}
+
+} // end unnamed namespace
+
+
+StartupProfile::Phase::Phase(StartupProfile* profile, std::string_view name) :
+    m_profile(profile)
+{
+    if (m_profile != nullptr)
+        m_index = m_profile->beginPhase(name);
+}
+
+
+StartupProfile::Phase::~Phase()
+{
+    end();
+}
+
+
+void
+StartupProfile::Phase::addFile(const fs::path& path)
+{
+    if (m_profile == nullptr)
+        return;
+
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    for (auto i = m_index; i != NoParent; i = m_profile->m_phases[i].parent)
+    {
+        ++m_profile->m_phases[i].files;
+        if (!ec)
+            m_profile->m_phases[i].bytes += size;
+    }
+}
+
+
+void
+StartupProfile::Phase::addBytes(std::uint64_t bytes)
+{
+    if (m_profile == nullptr)
+        return;
+
+    for (auto i = m_index; i != NoParent; i = m_profile->m_phases[i].parent)
+        m_profile->m_phases[i].bytes += bytes;
+}
+
+
+void
+StartupProfile::Phase::addObjects(std::uint64_t objects)
+{
+    if (m_profile == nullptr)
+        return;
+
+    for (auto i = m_index; i != NoParent; i = m_profile->m_phases[i].parent)
+        m_profile->m_phases[i].objects += objects;
+}
+
+
+void
+StartupProfile::Phase::end()
+{
+    if (m_profile == nullptr)
+        return;
+
+    m_profile->endPhase(m_index);
+    m_profile = nullptr;
+}
+
+
+std::size_t
+StartupProfile::beginPhase(std::string_view name)
+{
+    auto& record = m_phases.emplace_back();
+    record.name = name;
+    record.parent = m_current;
+    record.start = m_timer.getTime();
+
+    m_current = m_phases.size() - 1;
+    return m_current;
+}
+
+
+void
+StartupProfile::endPhase(std::size_t index)
+{
+    auto& record = m_phases[index];
+    record.duration = m_timer.getTime() - record.start;
+    m_current = record.parent;
+}
+
+
+void
+StartupProfile::writeReport(std::ostream& out) const
+{
+    fmt::print(out, "{{\n  \"version\": 1,\n  \"phases\": [");
+    for (std::size_t i = 0; i < m_phases.size(); ++i)
+    {
+        const auto& record = m_phases[i];
+        fmt::print(out,
+                   "{}\n    {{ \"name\": \"{}\", \"parent\": {}, \"start\": {:.6f}, \"duration\": {:.6f}, "
+                   "\"bytes\": {}, \"files\": {}, \"objects\": {} }}",
+                   i == 0 ? "" : ",",
+                   escapeJSON(record.name),
+                   record.parent == NoParent ? std::string("null") : std::to_string(record.parent),
+                   record.start,
+                   record.duration,
+                   record.bytes,
+                   record.files,
+                   record.objects);
+    }
+    fmt::print(out, "\n  ]\n}}\n");
+}
+
+
+bool
+StartupProfile::writeReport(const fs::path& path) const
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.good())
+    {
+        GetLogger()->error("Failed to open startup report {}\n", path);
+        return false;
+    }
+
+    writeReport(out);
+    if (!out.good())
+    {
+        GetLogger()->error("Failed to write startup report {}\n", path);
+        return false;
+    }
+
+    GetLogger()->info("Wrote startup report {}\n", path);
+    return true;
+}
+
+} // end namespace celestia
@@ -0,0 +1,90 @@
+// startupprofile.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Wall clock time, bytes read and object counts for the phases of startup.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celutil/timer.h>
+
+namespace celestia
+{
+
+/*! Records the phases of startup. A phase started while another one is
+ *  running becomes its child; the bytes, files and objects counted in a
+ *  phase are included in the totals of its parents. The report is written
+ *  as JSON with one entry per phase in the order the phases were started,
+ *  so that reports can be compared between builds and add-on sets.
+ *
+ *  Phases must be started and ended on one thread.
+ */
+class StartupProfile
+{
+public:
+    static constexpr std::size_t NoParent = static_cast<std::size_t>(-1);
+
+    struct PhaseRecord
+    {
+        std::string name;
+        std::size_t parent{ NoParent };
+        // Seconds since the profile was created
+        double start{ 0.0 };
+        double duration{ 0.0 };
+        std::uint64_t bytes{ 0 };
+        std::uint64_t files{ 0 };
+        std::uint64_t objects{ 0 };
+    };
+
+    // A phase which ends when the object is destroyed. A null profile is
+    // allowed, the phase doesn't record anything then.
+    class Phase
+    {
+    public:
+        Phase(StartupProfile* profile, std::string_view name);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+        // Count a file read in this phase, with its size in bytes
+        void addFile(const fs::path&);
+        void addBytes(std::uint64_t);
+        void addObjects(std::uint64_t);
+        void end();
+
+    private:
+        StartupProfile* m_profile;
+        std::size_t m_index{ NoParent };
+    };
+
+    StartupProfile() = default;
+
+    const std::vector<PhaseRecord>& phases() const { return m_phases; }
+
+    void writeReport(std::ostream&) const;
+    bool writeReport(const fs::path&) const;
+
+private:
+    std::size_t beginPhase(std::string_view name);
+    void endPhase(std::size_t index);
+
+    Timer m_timer;
+    std::vector<PhaseRecord> m_phases;
+    std::size_t m_current{ NoParent };
+};
+
+} // end namespace celestia
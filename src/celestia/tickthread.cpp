@@ -0,0 +1,113 @@
+// tickthread.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Runs the simulation step on its own thread.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "tickthread.h"
+
+#include <utility>
+
+namespace celestia
+{
+
+TickThread::TickThread() :
+    m_thread(&TickThread::run, this)
+{
+}
+
+
+TickThread::~TickThread()
+{
+    finish();
+    {
+        std::scoped_lock lock(m_mutex);
+        m_quit = true;
+    }
+    m_stepChanged.notify_one();
+    m_thread.join();
+}
+
+
+void
+TickThread::start(std::function<void()>&& step)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_step = std::move(step);
+        m_running = true;
+    }
+    m_stepChanged.notify_one();
+}
+
+
+void
+TickThread::finish()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;)
+    {
+        // Run the calls passed back by the step, without holding the lock
+        // so that the step may pass the next one
+        while (!m_calls.empty())
+        {
+            RenderCall* renderCall = m_calls.front();
+            m_calls.pop_front();
+            lock.unlock();
+            (*renderCall->call)();
+            lock.lock();
+            renderCall->done = true;
+            m_callsChanged.notify_all();
+        }
+
+        if (!m_running)
+            return;
+
+        m_stepChanged.wait(lock, [this] { return !m_running || !m_calls.empty(); });
+    }
+}
+
+
+void
+TickThread::callOnRenderThread(const std::function<void()>& call)
+{
+    if (std::this_thread::get_id() != m_thread.get_id())
+    {
+        call();
+        return;
+    }
+
+    RenderCall renderCall{ &call };
+    std::unique_lock lock(m_mutex);
+    m_calls.push_back(&renderCall);
+    m_stepChanged.notify_all();
+    m_callsChanged.wait(lock, [&renderCall] { return renderCall.done; });
+}
+
+
+void
+TickThread::run()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;)
+    {
+        m_stepChanged.wait(lock, [this] { return m_quit || m_step; });
+        if (m_quit)
+            return;
+
+        std::function<void()> step = std::move(m_step);
+        m_step = nullptr;
+        lock.unlock();
+        step();
+        lock.lock();
+        m_running = false;
+        m_stepChanged.notify_all();
+    }
+}
+
+} // end namespace celestia
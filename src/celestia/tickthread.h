@@ -0,0 +1,69 @@
+// tickthread.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Runs the simulation step on its own thread.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace celestia
+{
+
+/*! Runs a step of the simulation on a worker thread while the thread which
+ *  renders does something else, typically waiting for the buffer swap.
+ *  Work which needs the OpenGL context, like loading textures for a script
+ *  or taking a screenshot, is passed back with callOnRenderThread and runs
+ *  in finish.
+ *
+ *  start and finish must be called on the render thread, and one step
+ *  must be finished before the next is started.
+ */
+class TickThread
+{
+public:
+    TickThread();
+    ~TickThread();
+
+    TickThread(const TickThread&) = delete;
+    TickThread& operator=(const TickThread&) = delete;
+
+    void start(std::function<void()>&& step);
+    // Wait for the step, running the calls it passes to the render thread
+    void finish();
+
+    // Run call on the render thread and wait for it. On any thread but the
+    // worker it runs immediately.
+    void callOnRenderThread(const std::function<void()>& call);
+
+private:
+    struct RenderCall
+    {
+        const std::function<void()>* call;
+        bool done{ false };
+    };
+
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_stepChanged;
+    std::condition_variable m_callsChanged;
+    std::function<void()> m_step;
+    bool m_running{ false };
+    bool m_quit{ false };
+    std::deque<RenderCall*> m_calls;
+    // Last, so that it starts once the rest is constructed
+    std::thread m_thread;
+};
+
+} // end namespace celestia
@@ -224,6 +224,9 @@ Url::goTo()
     auto *sim = m_appCore->getSimulation();
     auto *renderer = m_appCore->getRenderer();
 
+    if (!isResolved())
+        resolve();
+
     sim->update(0.0);
     sim->setFrame(m_ref.getCoordinateSystem(), m_ref.getRefObject(), m_ref.getTargetObject());
     sim->getActiveObserver()->setFOV(math::degToRad(m_state.m_fieldOfView));
@@ -231,30 +234,9 @@ Url::goTo()
     sim->setTimeScale(m_state.m_timeScale);
     sim->setPauseState(m_state.m_pauseState);
     m_appCore->setLightDelayActive(m_state.m_lightTimeDelay);
-    if (!m_state.m_selectedBodyName.empty())
-    {
-        auto body = m_state.m_selectedBodyName;
-        std::replace(body.begin(), body.end(), ':', '/');
-        auto sel = sim->findObjectFromPath(body);
-        sim->setSelection(sel);
-    }
-    else
-    {
-        sim->setSelection(Selection());
-    }
-
-    if (!m_state.m_trackedBodyName.empty())
-    {
-        auto body = m_state.m_trackedBodyName;
-        std::replace(body.begin(), body.end(), ':', '/');
-        auto sel = sim->findObjectFromPath(body);
-        sim->setTrackedObject(sel);
-    }
-    else
-    {
-        if (!sim->getTrackedObject().empty())
-            sim->setTrackedObject(Selection());
-    }
+    sim->setSelection(m_selected);
+    if (!m_state.m_trackedBodyName.empty() || !sim->getTrackedObject().empty())
+        sim->setTrackedObject(m_tracked);
 
     renderer->setRenderFlags(m_state.m_renderFlags);
     renderer->setLabelMode(m_state.m_labelMode);
@@ -286,6 +268,47 @@ Url::goTo()
     return true;
 }
 
+// Bodies are only added and removed along with the generation of the
+// planetary systems, and star and deep sky catalogs only change by being
+// replaced
+bool
+Url::isResolved() const
+{
+    const auto *universe = m_appCore->getSimulation()->getUniverse();
+    return m_resolved &&
+           m_resolvedStars == universe->getStarCatalog() &&
+           m_resolvedDSOs == universe->getDSOCatalog() &&
+           m_resolvedSystems == PlanetarySystem::getGeneration();
+}
+
+void
+Url::resolve()
+{
+    auto *sim = m_appCore->getSimulation();
+    const auto *universe = sim->getUniverse();
+    m_resolvedStars = universe->getStarCatalog();
+    m_resolvedDSOs = universe->getDSOCatalog();
+    m_resolvedSystems = PlanetarySystem::getGeneration();
+    m_resolved = true;
+
+    auto findObject = [sim](std::string path)
+    {
+        if (path.empty())
+            return Selection();
+        std::replace(path.begin(), path.end(), ':', '/');
+        return sim->findObjectFromPath(path);
+    };
+
+    // Only parsed URLs have the paths of their frame objects
+    if (m_nBodies == 1 && !m_refPath.empty())
+        m_ref = ObserverFrame(m_state.m_coordSys, findObject(m_refPath));
+    else if (m_nBodies == 2 && !m_refPath.empty())
+        m_ref = ObserverFrame(m_state.m_coordSys, findObject(m_refPath), findObject(m_targetPath));
+
+    m_selected = findObject(m_state.m_selectedBodyName);
+    m_tracked = findObject(m_state.m_trackedBodyName);
+}
+
 std::string
 Url::getAsString() const
 {
@@ -449,7 +472,8 @@ bool Url::parse(std::string_view urlStr)
     auto timepos = nBodies == 0 ? pos : pathStr.rfind('/');
     auto timeStr = pathStr.substr(timepos + 1);
 
-    Selection bodies[2];
+    std::string refPath;
+    std::string targetPath;
     if (nBodies > 0)
     {
         auto bodiesStr = pathStr.substr(pos + 1, timepos - pos - 1);
@@ -463,7 +487,7 @@ bool Url::parse(std::string_view urlStr)
             }
             auto body = Url::decodeString(bodiesStr);
             std::replace(body.begin(), body.end(), ':', '/');
-            bodies[0] = m_appCore->getSimulation()->findObjectFromPath(body);
+            refPath = body;
             state.m_refBodyName = std::move(body);
         }
         else if (nBodies == 2)
@@ -475,32 +499,16 @@ bool Url::parse(std::string_view urlStr)
             }
             auto body = Url::decodeString(bodiesStr.substr(0, pos));
             std::replace(body.begin(), body.end(), ':', '/');
-            bodies[0] = m_appCore->getSimulation()->findObjectFromPath(body);
+            refPath = body;
             state.m_refBodyName = std::move(body);
 
             body = Url::decodeString(bodiesStr.substr(pos + 1));
             std::replace(body.begin(), body.end(), ':', '/');
-            bodies[1] = m_appCore->getSimulation()->findObjectFromPath(body);
+            targetPath = body;
             state.m_targetBodyName = std::move(body);
         }
     }
 
-    ObserverFrame ref;
-    switch (nBodies)
-    {
-    case 0:
-        ref = ObserverFrame();
-        break;
-    case 1:
-        ref = ObserverFrame(state.m_coordSys, bodies[0]);
-        break;
-    case 2:
-        ref = ObserverFrame(state.m_coordSys, bodies[0], bodies[1]);
-        break;
-    default:
-        break;
-    }
-
     auto params = ParseURLParams(paramsStr);
 
     // Version labelling of cel URLs was only added in Celestia 1.5, cel URL
@@ -522,7 +530,11 @@ bool Url::parse(std::string_view urlStr)
         return false;
     }
 
-    m_ref = ref;
+    // The frame and the selection are found by goTo
+    m_ref = ObserverFrame();
+    m_refPath = std::move(refPath);
+    m_targetPath = std::move(targetPath);
+    m_resolved = false;
     m_state = state;
     m_nBodies = nBodies;
     if (version == 4 && !initVersion4(params, timeStr))
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <string_view>
@@ -23,6 +24,8 @@
 #include "celestiastate.h"
 
 class CelestiaCore;
+class DSODatabase;
+class StarDatabase;
 
 class Url
 {
@@ -61,12 +64,17 @@ class Url
     static std::string encodeString(std::string_view);
 
     bool parse(std::string_view);
+    // The objects of the URL are looked up on the first call only, and
+    // again when the catalogs have changed, so that going to a bookmark
+    // many times is cheap
     bool goTo();
     std::string getAsString() const;
 
  private:
     bool initVersion3(std::map<std::string_view, std::string> &params, std::string_view timeStr);
     bool initVersion4(std::map<std::string_view, std::string> &params, std::string_view timeStr);
+    bool isResolved() const;
+    void resolve();
 
     CelestiaState          m_state;
 
@@ -78,6 +86,16 @@ class Url
     Selection              m_selected;
     Selection              m_tracked;
 
+    // Paths of the frame objects of a parsed URL
+    std::string            m_refPath;
+    std::string            m_targetPath;
+
+    // Catalogs the objects were found in by the last resolve()
+    const StarDatabase    *m_resolvedStars { nullptr };
+    const DSODatabase     *m_resolvedDSOs  { nullptr };
+    std::uint64_t          m_resolvedSystems{ 0 };
+    bool                   m_resolved      { false };
+
     int                    m_version       { CurrentVersion };
     TimeSource             m_timeSource    { UseUrlTime };
 
@@ -470,6 +470,7 @@ static bool BeginMovieCapture(const Renderer* renderer,
         movieCapture->setEncoderOptions(appCore->getConfig()->x264EncoderOptions);
     else
         movieCapture->setEncoderOptions(appCore->getConfig()->ffvhEncoderOptions);
+    movieCapture->setHardwareEncoding(appCore->getConfig()->hardwareVideoEncoder);
 
     bool success = movieCapture->start(filename, width, height, framerate);
     if (success)
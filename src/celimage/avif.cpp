@@ -8,6 +8,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include <celimage/downsample.h>
 #include <celimage/image.h>
 #include <celutil/logger.h>
 
@@ -19,7 +24,7 @@ extern "C"
 namespace celestia::engine
 {
 
-Image* LoadAVIFImage(const fs::path& filename)
+Image* LoadAVIFImage(const fs::path& filename, int maxSize)
 {
     avifDecoder* decoder = avifDecoderCreate();
     avifResult result = avifDecoderSetIOFile(decoder, filename.string().c_str());
@@ -45,6 +50,29 @@ Image* LoadAVIFImage(const fs::path& filename)
         return nullptr;
     }
 
+    // AV1 has no reduced resolution decoding, but the YUV planes are
+    // scaled before the conversion so that the full size RGBA image is
+    // never allocated
+    int width = static_cast<int>(decoder->image->width);
+    int height = static_cast<int>(decoder->image->height);
+    int factor = DownsampleFactor(width, height, maxSize);
+#if AVIF_VERSION >= 1000000
+    if (factor > 1)
+    {
+        result = avifImageScale(decoder->image,
+                                static_cast<std::uint32_t>(std::max(width / factor, 1)),
+                                static_cast<std::uint32_t>(std::max(height / factor, 1)),
+                                &decoder->diag);
+        if (result != AVIF_RESULT_OK)
+        {
+            util::GetLogger()->error("Failed to scale image {}: {}\n", filename, avifResultToString(result));
+            avifDecoderDestroy(decoder);
+            return nullptr;
+        }
+        factor = 1;
+    }
+#endif
+
     avifRGBImage rgb;
     rgb.format = AVIF_RGB_FORMAT_RGBA;
     avifRGBImageSetDefaults(&rgb, decoder->image);
@@ -62,6 +90,15 @@ Image* LoadAVIFImage(const fs::path& filename)
     }
 
     avifDecoderDestroy(decoder);
+
+    // Older versions of libavif can't scale images
+    if (factor > 1)
+    {
+        std::unique_ptr<Image> reduced = DownsampleImage(*image, maxSize);
+        delete image;
+        return reduced.release();
+    }
+
     return image;
 }
 
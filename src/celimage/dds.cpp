@@ -13,6 +13,7 @@
 #include <fstream>
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include <celengine/glsupport.h>
 #include <celutil/logger.h>
 #include <celutil/bytes.h>
@@ -74,8 +75,6 @@ struct DDSurfaceDesc
     std::uint32_t textureStage;
 };
 
-constexpr std::size_t DDS_MAX_BLOCK_SIZE = 16;
-
 constexpr std::uint32_t FourCC(const char *s)
 {
     return static_cast<std::uint32_t>(s[3]) << 24 |
@@ -84,13 +83,12 @@ constexpr std::uint32_t FourCC(const char *s)
            static_cast<std::uint32_t>(s[0]);
 }
 
-// decompress a DXTc texture to a RGBA texture, taken from https://github.com/ptitSeb/gl4es
+// decompress the first level of a DXTc texture to a RGBA texture with the
+// width and height rounded up to multiples of 4
 std::unique_ptr<std::uint32_t[]>
-DecompressDXTc(std::uint32_t width, std::uint32_t height, PixelFormat format, bool transparent0, std::ifstream &in)
+DecompressFirstLevel(std::uint32_t width, std::uint32_t height, PixelFormat format, bool transparent0, std::ifstream &in)
 {
-    // TODO: check with the size of the input data stream if the stream is in fact decompressed
-    // alloc memory
-    int blocksize = 0;
+    std::size_t blocksize = 0;
     switch (format)
     {
     case PixelFormat::DXT1:
@@ -104,38 +102,106 @@ DecompressDXTc(std::uint32_t width, std::uint32_t height, PixelFormat format, bo
         assert(0);
         return nullptr;
     }
-    auto pixels = std::make_unique<std::uint32_t[]>(((width + 3) & ~3) * ((height + 3) & ~3));
-    std::array<std::uint8_t, DDS_MAX_BLOCK_SIZE> block; // enough to hold DXT1/3/5 blocks
-    for (std::uint32_t y = 0; y < height; y += 4)
-    {
-        for (std::uint32_t x = 0; x < width; x += 4)
-        {
-            if (!in.good())
-                return nullptr;
 
-            in.read(reinterpret_cast<char*>(block.data()), blocksize); /* Flawfinder: ignore */
-            switch (format)
-            {
-            case PixelFormat::DXT1:
-                DecompressBlockDXT1(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            case PixelFormat::DXT3:
-                DecompressBlockDXT3(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            case PixelFormat::DXT5:
-                DecompressBlockDXT5(x, y, width, block.data(), transparent0, pixels.get());
-                break;
-            default:
-                assert(0);
-                return nullptr;
-            }
-        }
-    }
+    std::uint32_t blocksWide = (width + 3) / 4;
+    std::uint32_t blocksHigh = (height + 3) / 4;
+    std::vector<std::uint8_t> blocks(static_cast<std::size_t>(blocksWide) * blocksHigh * blocksize);
+    if (!in.read(reinterpret_cast<char*>(blocks.data()), blocks.size()).good()) /* Flawfinder: ignore */
+        return nullptr;
+
+    auto pixels = std::make_unique<std::uint32_t[]>(static_cast<std::size_t>(blocksWide) * blocksHigh * 16);
+    if (!DecompressDXTc(format, blocksWide, blocksHigh, blocks.data(), transparent0, pixels.get()))
+        return nullptr;
     return pixels;
 }
 
 } // anonymous namespace
 
+bool SaveDDSImage(const fs::path& filename, const Image& image)
+{
+    std::uint32_t fourCC;
+    switch (image.getFormat())
+    {
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT1_sRGBA:
+        fourCC = FourCC("DXT1");
+        break;
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT3_sRGBA:
+        fourCC = FourCC("DXT3");
+        break;
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT5_sRGBA:
+        fourCC = FourCC("DXT5");
+        break;
+    default:
+        util::GetLogger()->error("Only compressed images can be saved as DDS files.\n");
+        return false;
+    }
+
+    // Flags of the surface description
+    constexpr std::uint32_t DDSD_CAPS        = 0x00000001;
+    constexpr std::uint32_t DDSD_HEIGHT      = 0x00000002;
+    constexpr std::uint32_t DDSD_WIDTH       = 0x00000004;
+    constexpr std::uint32_t DDSD_PIXELFORMAT = 0x00001000;
+    constexpr std::uint32_t DDSD_MIPMAPCOUNT = 0x00020000;
+    constexpr std::uint32_t DDSD_LINEARSIZE  = 0x00080000;
+    constexpr std::uint32_t DDPF_FOURCC      = 0x00000004;
+    constexpr std::uint32_t DDSCAPS_COMPLEX  = 0x00000008;
+    constexpr std::uint32_t DDSCAPS_TEXTURE  = 0x00001000;
+    constexpr std::uint32_t DDSCAPS_MIPMAP   = 0x00400000;
+
+    DDSurfaceDesc ddsd{};
+    ddsd.size = sizeof(ddsd);
+    ddsd.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    ddsd.height = static_cast<std::uint32_t>(image.getHeight());
+    ddsd.width = static_cast<std::uint32_t>(image.getWidth());
+    ddsd.pitch = static_cast<std::uint32_t>(image.getMipLevelSize(0));
+    ddsd.format.size = sizeof(ddsd.format);
+    ddsd.format.flags = DDPF_FOURCC;
+    ddsd.format.fourCC = fourCC;
+    ddsd.caps.caps = DDSCAPS_TEXTURE;
+    if (image.getMipLevelCount() > 1)
+    {
+        ddsd.flags |= DDSD_MIPMAPCOUNT;
+        ddsd.mipMapLevels = static_cast<std::uint32_t>(image.getMipLevelCount());
+        ddsd.caps.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+
+    LE_TO_CPU_INT32(ddsd.size, ddsd.size);
+    LE_TO_CPU_INT32(ddsd.flags, ddsd.flags);
+    LE_TO_CPU_INT32(ddsd.height, ddsd.height);
+    LE_TO_CPU_INT32(ddsd.width, ddsd.width);
+    LE_TO_CPU_INT32(ddsd.pitch, ddsd.pitch);
+    LE_TO_CPU_INT32(ddsd.mipMapLevels, ddsd.mipMapLevels);
+    LE_TO_CPU_INT32(ddsd.format.size, ddsd.format.size);
+    LE_TO_CPU_INT32(ddsd.format.flags, ddsd.format.flags);
+    LE_TO_CPU_INT32(ddsd.format.fourCC, ddsd.format.fourCC);
+    LE_TO_CPU_INT32(ddsd.caps.caps, ddsd.caps.caps);
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good())
+    {
+        util::GetLogger()->error("Error opening DDS texture file {} for writing.\n", filename);
+        return false;
+    }
+
+    out.write("DDS ", 4);
+    out.write(reinterpret_cast<const char*>(&ddsd), sizeof(ddsd));
+    // The mip levels are stored contiguously in the image, without the
+    // padding byte at the end
+    for (int mip = 0; mip < image.getMipLevelCount(); ++mip)
+        out.write(reinterpret_cast<const char*>(image.getMipLevel(mip)), image.getMipLevelSize(mip));
+
+    if (!out.good())
+    {
+        util::GetLogger()->error("Error writing DDS texture file {}.\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
 Image* LoadDDSImage(const fs::path& filename)
 {
     std::ifstream in(filename, std::ios::in | std::ios::binary);
@@ -251,9 +317,8 @@ Image* LoadDDSImage(const fs::path& filename)
             bool transparent0 = format == PixelFormat::DXT1;
             if ((ddsd.width & 3) != 0 || (ddsd.height & 3) != 0)
             {
-                std::uint32_t nw = std::max(ddsd.width, 4u);
-                std::uint32_t nh = std::max(ddsd.height, 4u);
-                auto tmp = DecompressDXTc(nw, nh, format, transparent0, in);
+                std::uint32_t nw = (ddsd.width + 3) & ~3u;
+                auto tmp = DecompressFirstLevel(ddsd.width, ddsd.height, format, transparent0, in);
                 if (tmp != nullptr)
                 {
                     pixels = std::make_unique<std::uint32_t[]>(ddsd.width * ddsd.height);
@@ -266,7 +331,7 @@ Image* LoadDDSImage(const fs::path& filename)
             }
             else
             {
-                pixels = DecompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
+                pixels = DecompressFirstLevel(ddsd.width, ddsd.height, format, transparent0, in);
             }
 
             if (pixels == nullptr)
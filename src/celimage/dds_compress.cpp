@@ -0,0 +1,370 @@
+// dds_compress.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// DXT1/DXT5 texture compression. The endpoints are taken from the bounding
+// box of the block colors, following the principal diagonal and inset to
+// reduce the error of the interpolated colors; see J.M.P. van Waveren,
+// "Real-Time DXT Compression", 2006.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dds_compress.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "image.h"
+
+namespace celestia::engine
+{
+namespace
+{
+
+constexpr int BlockPixels = 16;
+
+constexpr std::uint16_t
+PackRGB565(int r, int g, int b)
+{
+    return static_cast<std::uint16_t>(((r * 31 + 127) / 255) << 11 |
+                                      ((g * 63 + 127) / 255) << 5 |
+                                      ((b * 31 + 127) / 255));
+}
+
+// Expand a 565 color the same way as the decompressor
+std::array<int, 3>
+UnpackRGB565(std::uint16_t color)
+{
+    std::uint32_t r = (color >> 11) * 255 + 16;
+    std::uint32_t g = ((color & 0x07E0) >> 5) * 255 + 32;
+    std::uint32_t b = (color & 0x001F) * 255 + 16;
+    return { static_cast<int>((r / 32 + r) / 32),
+             static_cast<int>((g / 64 + g) / 64),
+             static_cast<int>((b / 32 + b) / 32) };
+}
+
+void
+StoreLE16(std::uint8_t *dest, std::uint16_t value)
+{
+    dest[0] = static_cast<std::uint8_t>(value & 0xff);
+    dest[1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+void
+CompressColorBlock(const std::uint8_t *pixels, std::uint8_t *block)
+{
+    std::array<int, 3> minColor{ 255, 255, 255 };
+    std::array<int, 3> maxColor{ 0, 0, 0 };
+    std::array<int, 3> sum{ 0, 0, 0 };
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            int value = pixels[i * 4 + c];
+            minColor[c] = std::min(minColor[c], value);
+            maxColor[c] = std::max(maxColor[c], value);
+            sum[c] += value;
+        }
+    }
+
+    // Use the diagonal of the bounding box along which red and blue
+    // vary with green
+    int covRG = 0;
+    int covBG = 0;
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        int g = pixels[i * 4 + 1] * BlockPixels - sum[1];
+        covRG += (pixels[i * 4] * BlockPixels - sum[0]) * g;
+        covBG += (pixels[i * 4 + 2] * BlockPixels - sum[2]) * g;
+    }
+    if (covRG < 0)
+        std::swap(minColor[0], maxColor[0]);
+    if (covBG < 0)
+        std::swap(minColor[2], maxColor[2]);
+
+    for (int c = 0; c < 3; ++c)
+    {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        maxColor[c] = std::clamp(maxColor[c] - inset, 0, 255);
+        minColor[c] = std::clamp(minColor[c] + inset, 0, 255);
+    }
+
+    std::uint16_t color0 = PackRGB565(maxColor[0], maxColor[1], maxColor[2]);
+    std::uint16_t color1 = PackRGB565(minColor[0], minColor[1], minColor[2]);
+
+    // color0 > color1 selects the four color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    StoreLE16(block, color0);
+    StoreLE16(block + 2, color1);
+    if (color0 == color1)
+    {
+        std::memset(block + 4, 0, 4);
+        return;
+    }
+
+    std::array<std::array<int, 3>, 4> palette;
+    palette[0] = UnpackRGB565(color0);
+    palette[1] = UnpackRGB565(color1);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    std::uint32_t indices = 0;
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        int best = 0;
+        int bestDistance = -1;
+        for (int j = 0; j < 4; ++j)
+        {
+            int distance = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                int d = pixels[i * 4 + c] - palette[j][c];
+                distance += d * d;
+            }
+            if (bestDistance < 0 || distance < bestDistance)
+            {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+        indices |= static_cast<std::uint32_t>(best) << (2 * i);
+    }
+
+    for (int i = 0; i < 4; ++i)
+        block[4 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+void
+CompressAlphaBlock(const std::uint8_t *pixels, std::uint8_t *block)
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        minAlpha = std::min(minAlpha, static_cast<int>(pixels[i * 4 + 3]));
+        maxAlpha = std::max(maxAlpha, static_cast<int>(pixels[i * 4 + 3]));
+    }
+
+    // alpha0 > alpha1 selects the eight value mode
+    block[0] = static_cast<std::uint8_t>(maxAlpha);
+    block[1] = static_cast<std::uint8_t>(minAlpha);
+    std::memset(block + 2, 0, 6);
+    if (maxAlpha == minAlpha)
+        return;
+
+    std::array<int, 8> palette;
+    palette[0] = maxAlpha;
+    palette[1] = minAlpha;
+    for (int j = 2; j < 8; ++j)
+        palette[j] = ((8 - j) * maxAlpha + (j - 1) * minAlpha) / 7;
+
+    std::uint64_t indices = 0;
+    for (int i = 0; i < BlockPixels; ++i)
+    {
+        int alpha = pixels[i * 4 + 3];
+        int best = 0;
+        for (int j = 1; j < 8; ++j)
+        {
+            if (std::abs(alpha - palette[j]) < std::abs(alpha - palette[best]))
+                best = j;
+        }
+        indices |= static_cast<std::uint64_t>(best) << (3 * i);
+    }
+
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+// Expand the pixels of the image to RGBA
+bool
+ExpandToRGBA(const Image &image, std::vector<std::uint8_t> &rgba)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    rgba.resize(static_cast<std::size_t>(width) * height * 4);
+
+    int r = 0, g = 1, b = 2;
+    int alpha = -1;
+    switch (image.getFormat())
+    {
+    case PixelFormat::RGB:
+    case PixelFormat::sRGB:
+        break;
+    case PixelFormat::RGBA:
+    case PixelFormat::sRGBA:
+        alpha = 3;
+        break;
+    case PixelFormat::BGR:
+        r = 2; b = 0;
+        break;
+    case PixelFormat::BGRA:
+        r = 2; b = 0; alpha = 3;
+        break;
+    case PixelFormat::Luminance:
+    case PixelFormat::sLuminance:
+        g = 0; b = 0;
+        break;
+    case PixelFormat::LumAlpha:
+    case PixelFormat::sLumAlpha:
+        g = 0; b = 0; alpha = 1;
+        break;
+    default:
+        return false;
+    }
+
+    int components = image.getComponents();
+    const std::uint8_t *pixels = image.getPixels();
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t *src = pixels + static_cast<std::size_t>(y) * image.getPitch();
+        std::uint8_t *dest = rgba.data() + static_cast<std::size_t>(y) * width * 4;
+        for (int x = 0; x < width; ++x, src += components, dest += 4)
+        {
+            dest[0] = src[r];
+            dest[1] = src[g];
+            dest[2] = src[b];
+            dest[3] = alpha < 0 ? 255 : src[alpha];
+        }
+    }
+
+    return true;
+}
+
+// Box filter an RGBA level to the next smaller one
+std::vector<std::uint8_t>
+Downsample(const std::vector<std::uint8_t> &src, int width, int height)
+{
+    int newWidth = std::max(width / 2, 1);
+    int newHeight = std::max(height / 2, 1);
+    std::vector<std::uint8_t> dest(static_cast<std::size_t>(newWidth) * newHeight * 4);
+    for (int y = 0; y < newHeight; ++y)
+    {
+        int y0 = std::min(y * 2, height - 1);
+        int y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < newWidth; ++x)
+        {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+            const std::uint8_t *p00 = src.data() + (static_cast<std::size_t>(y0) * width + x0) * 4;
+            const std::uint8_t *p01 = src.data() + (static_cast<std::size_t>(y0) * width + x1) * 4;
+            const std::uint8_t *p10 = src.data() + (static_cast<std::size_t>(y1) * width + x0) * 4;
+            const std::uint8_t *p11 = src.data() + (static_cast<std::size_t>(y1) * width + x1) * 4;
+            std::uint8_t *out = dest.data() + (static_cast<std::size_t>(y) * newWidth + x) * 4;
+            for (int c = 0; c < 4; ++c)
+                out[c] = static_cast<std::uint8_t>((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+        }
+    }
+
+    return dest;
+}
+
+// Compress one level; partial blocks at the edges repeat the last
+// row and column
+void
+CompressLevel(const std::vector<std::uint8_t> &rgba, int width, int height, bool hasAlpha, std::uint8_t *dest)
+{
+    std::array<std::uint8_t, BlockPixels * 4> blockPixels;
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                int y = std::min(by + j, height - 1);
+                for (int i = 0; i < 4; ++i)
+                {
+                    int x = std::min(bx + i, width - 1);
+                    std::memcpy(blockPixels.data() + (j * 4 + i) * 4,
+                                rgba.data() + (static_cast<std::size_t>(y) * width + x) * 4,
+                                4);
+                }
+            }
+
+            if (hasAlpha)
+            {
+                CompressBlockDXT5(blockPixels.data(), dest);
+                dest += 16;
+            }
+            else
+            {
+                CompressBlockDXT1(blockPixels.data(), dest);
+                dest += 8;
+            }
+        }
+    }
+}
+
+int
+FloorLog2(int n)
+{
+    int result = 0;
+    while (n > 1)
+    {
+        n >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+void CompressBlockDXT1(const std::uint8_t *pixels, std::uint8_t *blockStorage)
+{
+    CompressColorBlock(pixels, blockStorage);
+}
+
+void CompressBlockDXT5(const std::uint8_t *pixels, std::uint8_t *blockStorage)
+{
+    CompressAlphaBlock(pixels, blockStorage);
+    CompressColorBlock(pixels, blockStorage + 8);
+}
+
+std::unique_ptr<Image> CompressImageDXT(const Image &image)
+{
+    std::vector<std::uint8_t> rgba;
+    if (image.isCompressed() || !ExpandToRGBA(image, rgba))
+        return nullptr;
+
+    bool hasAlpha = image.hasAlpha();
+    bool isSRGB = image.getFormat() == PixelFormat::sRGB ||
+                  image.getFormat() == PixelFormat::sRGBA ||
+                  image.getFormat() == PixelFormat::sLuminance ||
+                  image.getFormat() == PixelFormat::sLumAlpha;
+    PixelFormat format;
+    if (hasAlpha)
+        format = isSRGB ? PixelFormat::DXT5_sRGBA : PixelFormat::DXT5;
+    else
+        format = isSRGB ? PixelFormat::DXT1_sRGBA : PixelFormat::DXT1;
+
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int mipLevels = std::max(FloorLog2(width), FloorLog2(height)) + 1;
+    auto compressed = std::make_unique<Image>(format, width, height, mipLevels);
+
+    for (int mip = 0; mip < mipLevels; ++mip)
+    {
+        if (mip > 0)
+        {
+            rgba = Downsample(rgba, width, height);
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+        CompressLevel(rgba, width, height, hasAlpha, compressed->getMipLevel(mip));
+    }
+
+    return compressed;
+}
+
+} // namespace celestia::engine
@@ -0,0 +1,45 @@
+// dds_compress.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace celestia::engine
+{
+
+class Image;
+
+/**
+ * @brief Compresses one block of a DXT1 texture.
+ *
+ * @param pixels - 16 RGBA pixels of the block in row order; alpha is ignored.
+ * @param blockStorage - pointer to 8 bytes receiving the compressed block.
+*/
+void CompressBlockDXT1(const std::uint8_t *pixels, std::uint8_t *blockStorage);
+
+/**
+ * @brief Compresses one block of a DXT5 texture.
+ *
+ * @param pixels - 16 RGBA pixels of the block in row order.
+ * @param blockStorage - pointer to 16 bytes receiving the compressed block.
+*/
+void CompressBlockDXT5(const std::uint8_t *pixels, std::uint8_t *blockStorage);
+
+/**
+ * @brief Compresses an image to DXT1, or DXT5 if it has an alpha channel,
+ * with a complete set of mipmaps built with a box filter.
+ *
+ * Only uncompressed 8 bit per channel images are supported; nullptr is
+ * returned for other formats.
+*/
+std::unique_ptr<Image> CompressImageDXT(const Image &image);
+
+} // namespace celestia::engine
@@ -1,5 +1,6 @@
 #include <array>
 
+#include <celutil/taskscheduler.h>
 #include "dds_decompress.h"
 
 /*
@@ -336,4 +337,191 @@ void DecompressBlockDXT3(std::uint32_t x,
                                 alphaValues.data());
 }
 
+namespace
+{
+
+// Table driven block decoders for whole images. They produce the same
+// pixels as the per block functions above, which are kept as the
+// reference, but compute the palette once per block instead of once
+// per pixel.
+
+constexpr std::uint16_t LoadLE16(const std::uint8_t* p)
+{
+    return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+
+constexpr std::uint32_t LoadLE32(const std::uint8_t* p)
+{
+    return static_cast<std::uint32_t>(p[0]) |
+           static_cast<std::uint32_t>(p[1]) << 8 |
+           static_cast<std::uint32_t>(p[2]) << 16 |
+           static_cast<std::uint32_t>(p[3]) << 24;
+}
+
+std::array<std::uint32_t, 3> ExpandRGB565(std::uint16_t color)
+{
+    std::uint32_t r = (color >> 11) * 255 + 16;
+    std::uint32_t g = ((color & 0x07E0) >> 5) * 255 + 32;
+    std::uint32_t b = (color & 0x001F) * 255 + 16;
+    return { (r / 32 + r) / 32, (g / 64 + g) / 64, (b / 32 + b) / 32 };
+}
+
+// Colors of the block without alpha; the three color mode is only used
+// by DXT1 and DXT3
+std::array<std::uint32_t, 4> ColorPalette(const std::uint8_t* block, bool allowThreeColors)
+{
+    std::uint16_t color0 = LoadLE16(block);
+    std::uint16_t color1 = LoadLE16(block + 2);
+    auto c0 = ExpandRGB565(color0);
+    auto c1 = ExpandRGB565(color1);
+
+    std::array<std::uint32_t, 4> palette;
+    palette[0] = PackRGBA(c0[0], c0[1], c0[2], 0);
+    palette[1] = PackRGBA(c1[0], c1[1], c1[2], 0);
+    if (color0 > color1 || !allowThreeColors)
+    {
+        palette[2] = PackRGBA((2 * c0[0] + c1[0]) / 3, (2 * c0[1] + c1[1]) / 3, (2 * c0[2] + c1[2]) / 3, 0);
+        palette[3] = PackRGBA((c0[0] + 2 * c1[0]) / 3, (c0[1] + 2 * c1[1]) / 3, (c0[2] + 2 * c1[2]) / 3, 0);
+    }
+    else
+    {
+        palette[2] = PackRGBA((c0[0] + c1[0]) / 2, (c0[1] + c1[1]) / 2, (c0[2] + c1[2]) / 2, 0);
+        palette[3] = PackRGBA(0, 0, 0, 0);
+    }
+
+    return palette;
+}
+
+void WriteColorBlock(const std::array<std::uint32_t, 4>& palette,
+                     std::uint32_t code,
+                     const std::uint8_t* alphaValues,
+                     bool transparent0,
+                     std::uint32_t* output,
+                     std::uint32_t outputStride)
+{
+    constexpr std::uint32_t opaqueBlack = PackRGBA(0, 0, 0, 0xff);
+    for (int j = 0; j < 4; ++j, output += outputStride)
+    {
+        for (int i = 0; i < 4; ++i, code >>= 2)
+        {
+            std::uint32_t color = palette[code & 0x03] | static_cast<std::uint32_t>(alphaValues[j * 4 + i]) << 24;
+            output[i] = (transparent0 && color == opaqueBlack) ? 0u : color;
+        }
+    }
+}
+
+constexpr std::array<std::uint8_t, 16> OpaqueAlpha =
+{
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+void DecodeBlockDXT1(const std::uint8_t* block, bool transparent0, std::uint32_t* output, std::uint32_t stride)
+{
+    WriteColorBlock(ColorPalette(block, true), LoadLE32(block + 4), OpaqueAlpha.data(), transparent0, output, stride);
+}
+
+void DecodeBlockDXT3(const std::uint8_t* block, bool transparent0, std::uint32_t* output, std::uint32_t stride)
+{
+    std::array<std::uint8_t, 16> alphaValues;
+    for (int i = 0; i < 8; ++i)
+    {
+        alphaValues[i * 2]     = static_cast<std::uint8_t>((block[i] & 0x0f) * 17);
+        alphaValues[i * 2 + 1] = static_cast<std::uint8_t>((block[i] >> 4) * 17);
+    }
+
+    WriteColorBlock(ColorPalette(block + 8, true), LoadLE32(block + 12), alphaValues.data(), transparent0, output, stride);
+}
+
+void DecodeBlockDXT5(const std::uint8_t* block, std::uint32_t* output, std::uint32_t stride)
+{
+    int alpha0 = block[0];
+    int alpha1 = block[1];
+    std::array<std::uint8_t, 8> alphaPalette;
+    alphaPalette[0] = static_cast<std::uint8_t>(alpha0);
+    alphaPalette[1] = static_cast<std::uint8_t>(alpha1);
+    if (alpha0 > alpha1)
+    {
+        for (int code = 2; code < 8; ++code)
+            alphaPalette[code] = static_cast<std::uint8_t>(((8 - code) * alpha0 + (code - 1) * alpha1) / 7);
+    }
+    else
+    {
+        for (int code = 2; code < 6; ++code)
+            alphaPalette[code] = static_cast<std::uint8_t>(((6 - code) * alpha0 + (code - 1) * alpha1) / 5);
+        alphaPalette[6] = 0;
+        alphaPalette[7] = 255;
+    }
+
+    std::uint64_t alphaCodes = 0;
+    for (int i = 0; i < 6; ++i)
+        alphaCodes |= static_cast<std::uint64_t>(block[2 + i]) << (8 * i);
+
+    std::array<std::uint8_t, 16> alphaValues;
+    for (int i = 0; i < 16; ++i, alphaCodes >>= 3)
+        alphaValues[i] = alphaPalette[alphaCodes & 0x07];
+
+    // DXT5 always uses four colors, and has no transparent black
+    WriteColorBlock(ColorPalette(block + 8, false), LoadLE32(block + 12), alphaValues.data(), false, output, stride);
+}
+
+void DecompressBlockRows(PixelFormat format,
+                         std::uint32_t blocksWide,
+                         std::uint32_t firstRow,
+                         std::uint32_t lastRow,
+                         const std::uint8_t* blocks,
+                         bool transparent0,
+                         std::uint32_t* image)
+{
+    std::uint32_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    std::uint32_t stride = blocksWide * 4;
+    for (std::uint32_t by = firstRow; by < lastRow; ++by)
+    {
+        const std::uint8_t* block = blocks + static_cast<std::size_t>(by) * blocksWide * blockSize;
+        std::uint32_t* output = image + static_cast<std::size_t>(by) * 4 * stride;
+        for (std::uint32_t bx = 0; bx < blocksWide; ++bx, block += blockSize, output += 4)
+        {
+            switch (format)
+            {
+            case PixelFormat::DXT1:
+                DecodeBlockDXT1(block, transparent0, output, stride);
+                break;
+            case PixelFormat::DXT3:
+                DecodeBlockDXT3(block, transparent0, output, stride);
+                break;
+            default:
+                DecodeBlockDXT5(block, output, stride);
+                break;
+            }
+        }
+    }
+}
+
+// Rows of blocks handed to a thread at once; images with fewer rows are
+// decompressed on the calling thread
+constexpr std::uint32_t MinRowsPerThread = 64;
+
+} // namespace
+
+bool DecompressDXTc(PixelFormat format,
+                    std::uint32_t blocksWide,
+                    std::uint32_t blocksHigh,
+                    const std::uint8_t* blocks,
+                    bool transparent0,
+                    std::uint32_t* image,
+                    unsigned int maxThreads)
+{
+    if (format != PixelFormat::DXT1 && format != PixelFormat::DXT3 && format != PixelFormat::DXT5)
+        return false;
+
+    // Hand out bands of block rows to the shared workers and this thread
+    celestia::util::ParallelFor(0, blocksHigh, MinRowsPerThread, [&](std::size_t row)
+    {
+        auto y = static_cast<std::uint32_t>(row);
+        DecompressBlockRows(format, blocksWide, y, y + 1, blocks, transparent0, image);
+    }, maxThreads);
+
+    return true;
+}
+
 } // namespace celestia::engine
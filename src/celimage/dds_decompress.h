@@ -3,6 +3,8 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "pixelformat.h"
+
 namespace celestia::engine
 {
 
@@ -48,4 +50,27 @@ void DecompressBlockDXT5(std::uint32_t x, std::uint32_t y, std::uint32_t width,
                          const std::uint8_t *blockStorage, bool transparent0,
                          std::uint32_t *image);
 
+/**
+ * @brief Decompresses a complete DXT1, DXT3 or DXT5 image.
+ * Large images are split in bands of block rows which are decompressed
+ * in parallel. The result is identical to decompressing each block with
+ * the functions above.
+ *
+ * @param format - DXT1, DXT3 or DXT5.
+ * @param blocksWide - width of the image in blocks.
+ * @param blocksHigh - height of the image in blocks.
+ * @param blocks - the compressed blocks, row by row.
+ * @param transparent0 - turn opaque black DXT1 and DXT3 pixels transparent.
+ * @param image - receives (blocksWide * 4) x (blocksHigh * 4) RGBA pixels.
+ * @param maxThreads - limit of threads used, 0 for all the shared workers.
+ * @return false if the format isn't supported.
+*/
+bool DecompressDXTc(PixelFormat format,
+                    std::uint32_t blocksWide,
+                    std::uint32_t blocksHigh,
+                    const std::uint8_t *blocks,
+                    bool transparent0,
+                    std::uint32_t *image,
+                    unsigned int maxThreads = 0);
+
 } // namespace celestia::engine
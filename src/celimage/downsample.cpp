@@ -0,0 +1,140 @@
+// downsample.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "downsample.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "image.h"
+
+namespace celestia::engine
+{
+
+int
+DownsampleFactor(int width, int height, int maxSize)
+{
+    int factor = 1;
+    if (maxSize <= 0)
+        return factor;
+
+    while (std::max(width / factor, 1) > maxSize || std::max(height / factor, 1) > maxSize)
+        factor *= 2;
+    return factor;
+}
+
+
+RowDownsampler::RowDownsampler(Image &_target, int _sourceWidth, int _factor) :
+    target(_target),
+    sourceWidth(_sourceWidth),
+    factor(_factor),
+    components(_target.getComponents()),
+    sums(static_cast<std::size_t>(_target.getWidth() * _target.getComponents()), 0)
+{
+    assert(!target.isCompressed());
+}
+
+
+void
+RowDownsampler::addRow(const std::uint8_t *row)
+{
+    if (targetRow >= target.getHeight())
+        return;
+
+    int targetWidth = target.getWidth();
+    for (int x = 0; x < targetWidth; ++x)
+    {
+        int first = x * factor;
+        int last = std::min(first + factor, sourceWidth);
+        std::uint32_t *sum = &sums[static_cast<std::size_t>(x * components)];
+        for (int i = first; i < last; ++i)
+        {
+            const std::uint8_t *pixel = row + static_cast<std::size_t>(i * components);
+            for (int c = 0; c < components; ++c)
+                sum[c] += pixel[c];
+        }
+    }
+
+    if (++rowsInSum == factor)
+        writeRow();
+}
+
+
+void
+RowDownsampler::finish()
+{
+    if (rowsInSum > 0 && targetRow < target.getHeight())
+        writeRow();
+}
+
+
+void
+RowDownsampler::writeRow()
+{
+    std::uint8_t *out = target.getPixelRow(targetRow);
+    int targetWidth = target.getWidth();
+    for (int x = 0; x < targetWidth; ++x)
+    {
+        int columns = std::min(factor, sourceWidth - x * factor);
+        auto count = static_cast<std::uint32_t>(std::max(columns, 1) * rowsInSum);
+        for (int c = 0; c < components; ++c)
+        {
+            std::uint32_t &sum = sums[static_cast<std::size_t>(x * components + c)];
+            out[x * components + c] = static_cast<std::uint8_t>((sum + count / 2) / count);
+            sum = 0;
+        }
+    }
+
+    rowsInSum = 0;
+    ++targetRow;
+}
+
+
+std::unique_ptr<Image>
+DownsampleImage(const Image &image, int maxSize)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int factor = DownsampleFactor(width, height, maxSize);
+    if (factor == 1)
+        return nullptr;
+
+    int level = 0;
+    while ((1 << level) < factor)
+        ++level;
+
+    // The smaller mip levels are stored right after the larger ones with
+    // the same layout, so they can be copied as a block
+    if (level < image.getMipLevelCount())
+    {
+        auto reduced = std::make_unique<Image>(image.getFormat(),
+                                               std::max(width >> level, 1),
+                                               std::max(height >> level, 1),
+                                               image.getMipLevelCount() - level);
+        std::memcpy(reduced->getPixels(), image.getMipLevel(level), reduced->getSize());
+        return reduced;
+    }
+
+    if (image.isCompressed())
+        return nullptr;
+
+    auto reduced = std::make_unique<Image>(image.getFormat(),
+                                           std::max(width / factor, 1),
+                                           std::max(height / factor, 1));
+    RowDownsampler downsampler(*reduced, width, factor);
+    const std::uint8_t *pixels = image.getPixels();
+    for (int y = 0; y < height; ++y)
+        downsampler.addRow(pixels + static_cast<std::size_t>(y) * image.getPitch());
+    downsampler.finish();
+
+    return reduced;
+}
+
+} // namespace celestia::engine
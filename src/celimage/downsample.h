@@ -0,0 +1,74 @@
+// downsample.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace celestia::engine
+{
+
+class Image;
+
+/**
+ * @brief Returns the smallest power of two by which an image has to be
+ * reduced so that neither of its dimensions exceeds maxSize.
+ *
+ * A maxSize of 0 sets no limit, and 1 is returned.
+*/
+int DownsampleFactor(int width, int height, int maxSize);
+
+/**
+ * @brief Reduces an image with a box filter while it is being decoded.
+ *
+ * Source rows are added one at a time, so that decoders never need to
+ * hold the full size image in memory. The target image has the reduced
+ * size; source pixels beyond the target size times the factor are ignored.
+*/
+class RowDownsampler
+{
+public:
+    /**
+     * @param target - uncompressed image receiving the reduced rows.
+     * @param sourceWidth - number of pixels in the source rows, which have
+     * the format of the target.
+     * @param factor - number of source pixels averaged in each direction.
+    */
+    RowDownsampler(Image &target, int sourceWidth, int factor);
+
+    void addRow(const std::uint8_t *row);
+    // Write the last target row if the source height isn't a multiple of
+    // the factor
+    void finish();
+
+private:
+    void writeRow();
+
+    Image &target;
+    int sourceWidth;
+    int factor;
+    int components;
+    int rowsInSum{ 0 };
+    int targetRow{ 0 };
+    std::vector<std::uint32_t> sums;
+};
+
+/**
+ * @brief Reduces a decoded image so that neither of its dimensions exceeds
+ * maxSize.
+ *
+ * Images with mipmaps, including compressed ones, lose their largest
+ * levels; other compressed images can't be reduced. Returns nullptr if the
+ * image is small enough or can't be reduced.
+*/
+std::unique_ptr<Image> DownsampleImage(const Image &image, int maxSize);
+
+} // namespace celestia::engine
@@ -10,13 +10,16 @@
 #include "image.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <tuple>
 
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include "downsample.h"
 #include "imageformats.h"
 
 namespace celestia::engine
@@ -129,6 +132,57 @@ getLinearFormat(PixelFormat format)
     }
 }
 
+int
+alphaChannel(PixelFormat fmt)
+{
+    switch (fmt)
+    {
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+    case PixelFormat::sRGBA:
+        return 3;
+    case PixelFormat::LumAlpha:
+    case PixelFormat::sLumAlpha:
+        return 1;
+    case PixelFormat::Alpha:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+// Conversion between 8 bit sRGB values and 16 bit linear values. The
+// inverse table has 4096 entries, which keeps the rounding error below
+// one step of the 8 bit values.
+struct SRGBTables
+{
+    std::array<std::uint16_t, 256> toLinear;
+    std::array<std::uint8_t, 4096> fromLinear;
+
+    SRGBTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            double c = i / 255.0;
+            double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            toLinear[i] = static_cast<std::uint16_t>(std::lround(linear * 65535.0));
+        }
+        for (int i = 0; i < 4096; ++i)
+        {
+            double linear = i / 4095.0;
+            double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            fromLinear[i] = static_cast<std::uint8_t>(std::clamp(std::lround(c * 255.0), 0L, 255L));
+        }
+    }
+};
+
+const SRGBTables&
+srgbTables()
+{
+    static const SRGBTables tables;
+    return tables;
+}
+
 inline std::tuple<int, int>
 handleEdge(int i, int size, bool wrap)
 {
@@ -140,6 +194,26 @@ handleEdge(int i, int size, bool wrap)
     return {1, 0};
 }
 
+bool
+formatHasAlpha(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT3_sRGBA:
+    case PixelFormat::DXT5:
+    case PixelFormat::DXT5_sRGBA:
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+    case PixelFormat::LumAlpha:
+    case PixelFormat::sLumAlpha:
+    case PixelFormat::Alpha:
+        return true;
+    default:
+        return false;
+    }
+}
+
 } // anonymous namespace
 
 Image::Image(PixelFormat fmt, int w, int h, int mip) :
@@ -290,21 +364,7 @@ Image::isCompressed() const
 bool
 Image::hasAlpha() const
 {
-    switch (format)
-    {
-    case PixelFormat::DXT3:
-    case PixelFormat::DXT3_sRGBA:
-    case PixelFormat::DXT5:
-    case PixelFormat::DXT5_sRGBA:
-    case PixelFormat::RGBA:
-    case PixelFormat::BGRA:
-    case PixelFormat::LumAlpha:
-    case PixelFormat::sLumAlpha:
-    case PixelFormat::Alpha:
-        return true;
-    default:
-        return false;
-    }
+    return formatHasAlpha(format);
 }
 
 /**
@@ -355,6 +415,63 @@ Image::computeNormalMap(float scale, bool wrap) const
     return normalMap;
 }
 
+std::unique_ptr<Image>
+Image::computeMipmaps(bool gammaCorrect) const
+{
+    if (isCompressed())
+        return nullptr;
+
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        ++levels;
+
+    auto result = std::make_unique<Image>(format, width, height, levels);
+    std::copy_n(getMipLevel(0), getMipLevelSize(0), result->getMipLevel(0));
+
+    const SRGBTables* tables = gammaCorrect ? &srgbTables() : nullptr;
+    int alpha = alphaChannel(format);
+    for (int mip = 1; mip < levels; ++mip)
+    {
+        int srcWidth = std::max(width >> (mip - 1), 1);
+        int srcHeight = std::max(height >> (mip - 1), 1);
+        int mipWidth = std::max(width >> mip, 1);
+        int mipHeight = std::max(height >> mip, 1);
+        // Rows of each level are padded separately
+        int srcPitch = pad(srcWidth * components);
+        int mipPitch = pad(mipWidth * components);
+        const std::uint8_t* src = result->getMipLevel(mip - 1);
+        std::uint8_t* dest = result->getMipLevel(mip);
+        for (int y = 0; y < mipHeight; ++y, dest += mipPitch)
+        {
+            // Average 2x2 texels, or 2x1 when the source is one texel
+            // high or wide
+            const std::uint8_t* row0 = src + std::min(y * 2, srcHeight - 1) * srcPitch;
+            const std::uint8_t* row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcPitch;
+            for (int x = 0; x < mipWidth; ++x)
+            {
+                int x0 = std::min(x * 2, srcWidth - 1) * components;
+                int x1 = std::min(x * 2 + 1, srcWidth - 1) * components;
+                for (int c = 0; c < components; ++c)
+                {
+                    if (tables == nullptr || c == alpha)
+                    {
+                        int total = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                        dest[x * components + c] = static_cast<std::uint8_t>((total + 2) / 4);
+                    }
+                    else
+                    {
+                        std::uint32_t total = tables->toLinear[row0[x0 + c]] + tables->toLinear[row0[x1 + c]] +
+                                              tables->toLinear[row1[x0 + c]] + tables->toLinear[row1[x1 + c]];
+                        dest[x * components + c] = tables->fromLinear[std::min((total / 4 + 8) >> 4, 4095u)];
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 void Image::forceLinear()
 {
     format = getLinearFormat(format);
@@ -378,7 +495,7 @@ bool Image::save(const fs::path &path, ContentType type) const
     }
 }
 
-std::unique_ptr<Image> Image::load(const fs::path& filename)
+std::unique_ptr<Image> Image::load(const fs::path& filename, int maxSize)
 {
     ContentType type = DetermineFileType(filename);
 
@@ -388,17 +505,17 @@ std::unique_ptr<Image> Image::load(const fs::path& filename)
     switch (type)
     {
     case ContentType::JPEG:
-        img = LoadJPEGImage(filename);
+        img = LoadJPEGImage(filename, maxSize);
         break;
     case ContentType::BMP:
         img = LoadBMPImage(filename);
         break;
     case ContentType::PNG:
-        img = LoadPNGImage(filename);
+        img = LoadPNGImage(filename, maxSize);
         break;
 #ifdef USE_LIBAVIF
     case ContentType::AVIF:
-        img = LoadAVIFImage(filename);
+        img = LoadAVIFImage(filename, maxSize);
         break;
 #endif
     case ContentType::DDS:
@@ -410,7 +527,55 @@ std::unique_ptr<Image> Image::load(const fs::path& filename)
         break;
     }
 
-    return std::unique_ptr<Image>(img);
+    // Formats which can't be reduced while decoding
+    std::unique_ptr<Image> result(img);
+    if (result != nullptr && maxSize > 0)
+    {
+        if (auto reduced = DownsampleImage(*result, maxSize); reduced != nullptr)
+            result = std::move(reduced);
+    }
+
+    return result;
+}
+
+ImageRowReader::ImageRowReader(PixelFormat _format, int _width, int _height) :
+    format(_format),
+    width(_width),
+    height(_height)
+{
+}
+
+int ImageRowReader::getPitch() const
+{
+    return pad(width * formatComponents(format));
+}
+
+int ImageRowReader::getComponents() const
+{
+    return formatComponents(format);
+}
+
+bool ImageRowReader::hasAlpha() const
+{
+    return formatHasAlpha(format);
+}
+
+void ImageRowReader::forceLinear()
+{
+    format = getLinearFormat(format);
+}
+
+std::unique_ptr<ImageRowReader> ImageRowReader::open(const fs::path& filename)
+{
+    switch (DetermineFileType(filename))
+    {
+    case ContentType::JPEG:
+        return OpenJPEGRowReader(filename);
+    case ContentType::PNG:
+        return OpenPNGRowReader(filename);
+    default:
+        return nullptr;
+    }
 }
 
 } // namespace celestia::engine
@@ -57,13 +57,20 @@ public:
     bool hasAlpha() const;
 
     std::unique_ptr<Image> computeNormalMap(float scale, bool wrap) const;
+    // Copy of the image with a complete set of mipmaps built with a box
+    // filter. With gammaCorrect, the color channels are averaged after
+    // converting them from sRGB to linear values.
+    std::unique_ptr<Image> computeMipmaps(bool gammaCorrect) const;
 
     void forceLinear();
 
     static bool canSave(ContentType type);
     bool save(const fs::path &path, ContentType type) const;
 
-    static std::unique_ptr<Image> load(const fs::path& filename);
+    // With maxSize > 0, images larger than maxSize in either dimension are
+    // reduced by a power of two. Where the format allows it this is done
+    // while decoding, so the full size image is never held in memory.
+    static std::unique_ptr<Image> load(const fs::path& filename, int maxSize = 0);
 
 private:
     int width;
@@ -76,4 +83,44 @@ private:
     std::unique_ptr<std::uint8_t[]> pixels;
 };
 
+
+/**
+ * Decodes an uncompressed image from a file a few rows at a time, for images
+ * which are too large to be held in memory at once, e.g. surface maps which
+ * are split into several textures anyway. Rows are padded like those of
+ * Image.
+ */
+class ImageRowReader
+{
+public:
+    virtual ~ImageRowReader() = default;
+    ImageRowReader(const ImageRowReader&) = delete;
+    ImageRowReader& operator=(const ImageRowReader&) = delete;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getPitch() const;
+    PixelFormat getFormat() const { return format; }
+    int getComponents() const;
+    bool hasAlpha() const;
+
+    void forceLinear();
+
+    // Decode the next nRows rows into rows, which must hold nRows times the
+    // pitch bytes. Returns false on errors and past the last row.
+    virtual bool read(std::uint8_t* rows, int nRows) = 0;
+
+    // Only JPEG and non-interlaced PNG files can be read in rows, nullptr
+    // is returned for other files
+    static std::unique_ptr<ImageRowReader> open(const fs::path& filename);
+
+protected:
+    ImageRowReader(PixelFormat format, int width, int height);
+
+private:
+    PixelFormat format;
+    int width;
+    int height;
+};
+
 } // namespace celestia::engine
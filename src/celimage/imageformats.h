@@ -10,21 +10,31 @@
 
 #pragma once
 
+#include <memory>
+
 #include <celcompat/filesystem.h>
 #include <celimage/image.h>
 
 namespace celestia::engine
 {
 
-Image* LoadJPEGImage(const fs::path& filename);
+// The JPEG, PNG and AVIF loaders reduce images larger than maxSize by a
+// power of two while decoding them, see DownsampleFactor
+Image* LoadJPEGImage(const fs::path& filename, int maxSize = 0);
 Image* LoadBMPImage(const fs::path& filename);
-Image* LoadPNGImage(const fs::path& filename);
+Image* LoadPNGImage(const fs::path& filename, int maxSize = 0);
 Image* LoadDDSImage(const fs::path& filename);
 #ifdef USE_LIBAVIF
-Image* LoadAVIFImage(const fs::path& filename);
+Image* LoadAVIFImage(const fs::path& filename, int maxSize = 0);
 #endif
 
+// Readers of the rows of images, see ImageRowReader::open
+std::unique_ptr<ImageRowReader> OpenJPEGRowReader(const fs::path& filename);
+std::unique_ptr<ImageRowReader> OpenPNGRowReader(const fs::path& filename);
+
 bool SaveJPEGImage(const fs::path& filename, const Image& image);
 bool SavePNGImage(const fs::path& filename, const Image& image);
+// Only DXT compressed images can be saved
+bool SaveDDSImage(const fs::path& filename, const Image& image);
 
 } // namespace celestia::engine
@@ -8,6 +8,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdio>  // fopen, fclose
 #include <cstring> // memcpy
 #include <memory>
@@ -17,6 +19,7 @@ extern "C"
 #include <jpeglib.h>
 }
 #include <celutil/logger.h>
+#include "downsample.h"
 #include "image.h"
 
 namespace celestia::engine
@@ -117,11 +120,83 @@ bool SaveJPEGImage(const fs::path& filename,
     return true;
 }
 
+// State of a JPEG file being decoded by JPEGRowReader
+struct JPEGDecoder
+{
+    ~JPEGDecoder()
+    {
+        if (created)
+            jpeg_destroy_decompress(&cinfo);
+        if (in != nullptr)
+            fclose(in);
+    }
+
+    struct jpeg_decompress_struct cinfo;
+    struct my_error_mgr jerr;
+    FILE* in{ nullptr };
+    bool created{ false };
+};
+
+// The decoding steps return here on errors, so they must not create any
+// objects with destructors
+bool startJPEGDecoder(JPEGDecoder* decoder)
+{
+    decoder->cinfo.err = jpeg_std_error(&decoder->jerr.pub);
+    decoder->jerr.pub.error_exit = my_error_exit;
+    if (setjmp(decoder->jerr.setjmp_buffer))
+        return false;
+
+    jpeg_create_decompress(&decoder->cinfo);
+    decoder->created = true;
+    jpeg_stdio_src(&decoder->cinfo, decoder->in);
+    (void) jpeg_read_header(&decoder->cinfo, TRUE);
+    (void) jpeg_start_decompress(&decoder->cinfo);
+    return true;
+}
+
+bool readJPEGRows(JPEGDecoder* decoder, std::uint8_t* rows, int pitch, int nRows)
+{
+    if (decoder->cinfo.output_scanline + static_cast<JDIMENSION>(nRows) > decoder->cinfo.output_height)
+        return false;
+    if (setjmp(decoder->jerr.setjmp_buffer))
+        return false;
+
+    for (int i = 0; i < nRows; i++)
+    {
+        JSAMPROW row = rows + static_cast<std::ptrdiff_t>(i) * pitch;
+        if (jpeg_read_scanlines(&decoder->cinfo, &row, 1) != 1)
+            return false;
+    }
+
+    return true;
+}
+
+class JPEGRowReader : public ImageRowReader
+{
+public:
+    JPEGRowReader(PixelFormat format, std::unique_ptr<JPEGDecoder>&& _decoder) :
+        ImageRowReader(format,
+                       static_cast<int>(_decoder->cinfo.output_width),
+                       static_cast<int>(_decoder->cinfo.output_height)),
+        decoder(std::move(_decoder))
+    {
+    }
+
+    bool read(std::uint8_t* rows, int nRows) override
+    {
+        return readJPEGRows(decoder.get(), rows, getPitch(), nRows);
+    }
+
+private:
+    std::unique_ptr<JPEGDecoder> decoder;
+};
+
 } // anonymous namespace
 
-Image* LoadJPEGImage(const fs::path& filename)
+Image* LoadJPEGImage(const fs::path& filename, int maxSize)
 {
     Image* img = nullptr;
+    RowDownsampler* downsampler = nullptr;
 
     // This struct contains the JPEG decompression parameters and pointers to
     // working space (which is allocated as needed by the JPEG library).
@@ -159,6 +234,7 @@ Image* LoadJPEGImage(const fs::path& filename)
         // We need to clean up the JPEG object, close the input file, and return.
         jpeg_destroy_decompress(&cinfo);
         fclose(in);
+        delete downsampler;
         delete img;
 
         return nullptr;
@@ -179,8 +255,14 @@ Image* LoadJPEGImage(const fs::path& filename)
 
     // Step 4: set parameters for decompression
 
-    // In this example, we don't need to change any of the defaults set by
-    // jpeg_read_header(), so we do nothing here.
+    // libjpeg reduces the image by up to 8 while decoding it, any further
+    // reduction is done on the decoded rows
+    int factor = DownsampleFactor(cinfo.image_width, cinfo.image_height, maxSize);
+    if (factor > 1)
+    {
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = std::min(factor, 8);
+    }
 
     // Step 5: Start decompressor
 
@@ -209,7 +291,20 @@ Image* LoadJPEGImage(const fs::path& filename)
     if (cinfo.output_components == 1)
         format = PixelFormat::Luminance;
 
-    img = new Image(format, cinfo.image_width, cinfo.image_height);
+    if (factor == 1)
+    {
+        img = new Image(format, cinfo.image_width, cinfo.image_height);
+    }
+    else
+    {
+        // The scaled output size is rounded up, the extra pixels are dropped
+        img = new Image(format,
+                        std::max(static_cast<int>(cinfo.image_width) / factor, 1),
+                        std::max(static_cast<int>(cinfo.image_height) / factor, 1));
+        downsampler = new RowDownsampler(*img,
+                                         static_cast<int>(cinfo.output_width),
+                                         factor / static_cast<int>(cinfo.scale_denom));
+    }
 
     // cont = cinfo.output_height - 1;
     int cont = 0;
@@ -222,10 +317,20 @@ Image* LoadJPEGImage(const fs::path& filename)
 
         // Assume put_scanline_someplace wants a pointer and sample count.
         // put_scanline_someplace(buffer[0], row_stride);
-        std::memcpy(img->getPixelRow(cont), buffer[0], row_stride);
+        if (downsampler != nullptr)
+            downsampler->addRow(buffer[0]);
+        else
+            std::memcpy(img->getPixelRow(cont), buffer[0], row_stride);
         cont++;
     }
 
+    if (downsampler != nullptr)
+    {
+        downsampler->finish();
+        delete downsampler;
+        downsampler = nullptr;
+    }
+
     // Step 7: Finish decompression
 
     (void) jpeg_finish_decompress(&cinfo);
@@ -250,6 +355,34 @@ Image* LoadJPEGImage(const fs::path& filename)
     return img;
 }
 
+std::unique_ptr<ImageRowReader> OpenJPEGRowReader(const fs::path& filename)
+{
+    auto decoder = std::make_unique<JPEGDecoder>();
+#ifdef _WIN32
+    decoder->in = _wfopen(filename.c_str(), L"rb");
+#else
+    decoder->in = fopen(filename.c_str(), "rb");
+#endif
+    if (decoder->in == nullptr || !startJPEGDecoder(decoder.get()))
+        return nullptr;
+
+    // CMYK images aren't supported
+    PixelFormat format;
+    switch (decoder->cinfo.output_components)
+    {
+    case 1:
+        format = PixelFormat::Luminance;
+        break;
+    case 3:
+        format = PixelFormat::RGB;
+        break;
+    default:
+        return nullptr;
+    }
+
+    return std::make_unique<JPEGRowReader>(format, std::move(decoder));
+}
+
 bool SaveJPEGImage(const fs::path& filename, const Image& image)
 {
     return SaveJPEGImage(filename,
@@ -8,11 +8,14 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <png.h>
 #include <zlib.h>
 #include <celutil/logger.h>
 #include <celutil/gettext.h>
+#include "downsample.h"
 #include "image.h"
 
 namespace celestia::engine
@@ -33,6 +36,128 @@ void PNGWriteData(png_structp png_ptr, png_bytep data, png_size_t length)
     fwrite((void*) data, 1, length, fp);
 }
 
+// Expand all images to 8 bit luminance or RGB channels, with or without
+// alpha
+void setPNGTransforms(png_structp png_ptr, png_infop info_ptr, int bit_depth, int color_type)
+{
+    // TODO: consider using paletted textures if they're available
+    if (color_type == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_palette_to_rgb(png_ptr);
+    }
+
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+    {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+
+    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    {
+        png_set_tRNS_to_alpha(png_ptr);
+    }
+
+    // TODO: consider passing images with < 8 bits/component to
+    // GL without expanding
+    if (bit_depth == 16)
+        png_set_strip_16(png_ptr);
+    else if (bit_depth < 8)
+        png_set_packing(png_ptr);
+}
+
+PixelFormat getPNGFormat(png_structp png_ptr, png_infop info_ptr)
+{
+    switch (png_get_channels(png_ptr, info_ptr))
+    {
+    case 1:
+        return PixelFormat::Luminance;
+    case 2:
+        return PixelFormat::LumAlpha;
+    case 3:
+        return PixelFormat::RGB;
+    case 4:
+        return PixelFormat::RGBA;
+    default:
+        return PixelFormat::Invalid;
+    }
+}
+
+// State of a PNG file being decoded by PNGRowReader
+struct PNGDecoder
+{
+    ~PNGDecoder()
+    {
+        if (png_ptr != nullptr)
+            png_destroy_read_struct(&png_ptr, info_ptr == nullptr ? nullptr : &info_ptr, nullptr);
+        if (fp != nullptr)
+            fclose(fp);
+    }
+
+    png_structp png_ptr{ nullptr };
+    png_infop info_ptr{ nullptr };
+    FILE* fp{ nullptr };
+};
+
+// The decoding steps return here on errors, so they must not create any
+// objects with destructors. Interlaced images can't be read in rows.
+bool startPNGDecoder(PNGDecoder* decoder)
+{
+    png_structp png_ptr = decoder->png_ptr;
+    png_infop info_ptr = decoder->info_ptr;
+    if (setjmp(png_jmpbuf(png_ptr)))
+        return false;
+
+    png_set_read_fn(png_ptr, (void*) decoder->fp, PNGReadData);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    png_uint_32 width, height;
+    int bit_depth, color_type, interlace_type;
+    png_get_IHDR(png_ptr, info_ptr,
+                 &width, &height, &bit_depth,
+                 &color_type, &interlace_type,
+                 nullptr, nullptr);
+    if (interlace_type != PNG_INTERLACE_NONE)
+        return false;
+
+    setPNGTransforms(png_ptr, info_ptr, bit_depth, color_type);
+    png_read_update_info(png_ptr, info_ptr);
+    return true;
+}
+
+bool readPNGRows(PNGDecoder* decoder, std::uint8_t* rows, int pitch, int nRows)
+{
+    if (setjmp(png_jmpbuf(decoder->png_ptr)))
+        return false;
+
+    for (int i = 0; i < nRows; i++)
+        png_read_row(decoder->png_ptr, rows + static_cast<std::ptrdiff_t>(i) * pitch, nullptr);
+    return true;
+}
+
+class PNGRowReader : public ImageRowReader
+{
+public:
+    PNGRowReader(PixelFormat format, std::unique_ptr<PNGDecoder>&& _decoder) :
+        ImageRowReader(format,
+                       static_cast<int>(png_get_image_width(_decoder->png_ptr, _decoder->info_ptr)),
+                       static_cast<int>(png_get_image_height(_decoder->png_ptr, _decoder->info_ptr))),
+        decoder(std::move(_decoder))
+    {
+    }
+
+    bool read(std::uint8_t* rows, int nRows) override
+    {
+        if (nRows > getHeight() - rowsRead)
+            return false;
+        rowsRead += nRows;
+        return readPNGRows(decoder.get(), rows, getPitch(), nRows);
+    }
+
+private:
+    std::unique_ptr<PNGDecoder> decoder;
+    int rowsRead{ 0 };
+};
+
 bool SavePNGImage(const fs::path& filename,
                   int width, int height,
                   int rowStride,
@@ -133,7 +258,7 @@ bool SavePNGImage(const fs::path& filename,
 
 } // anonymous namespace
 
-Image* LoadPNGImage(const fs::path& filename)
+Image* LoadPNGImage(const fs::path& filename, int maxSize)
 {
     char header[8];
     png_structp png_ptr;
@@ -142,6 +267,8 @@ Image* LoadPNGImage(const fs::path& filename)
     int bit_depth, color_type, interlace_type;
     Image* img = nullptr;
     png_bytep* row_pointers = nullptr;
+    png_bytep row = nullptr;
+    RowDownsampler* downsampler = nullptr;
 
 #ifdef _WIN32
     FILE *fp = _wfopen(filename.c_str(), L"rb");
@@ -182,6 +309,9 @@ Image* LoadPNGImage(const fs::path& filename)
     if (setjmp(png_jmpbuf(png_ptr)))
     {
         fclose(fp);
+        delete downsampler;
+        delete[] row;
+        delete[] row_pointers;
         delete img;
         png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) nullptr);
         util::GetLogger()->error(_("Error reading PNG image file {}\n"), filename);
@@ -199,61 +329,68 @@ Image* LoadPNGImage(const fs::path& filename)
                  &color_type, &interlace_type,
                  nullptr, nullptr);
 
-    PixelFormat format = PixelFormat::RGB;
-    switch (color_type)
-    {
-    case PNG_COLOR_TYPE_GRAY:
-        format = PixelFormat::Luminance;
-        break;
-    case PNG_COLOR_TYPE_GRAY_ALPHA:
-        format = PixelFormat::LumAlpha;
-        break;
-    case PNG_COLOR_TYPE_RGB:
-        format = PixelFormat::RGB;
-        break;
-    case PNG_COLOR_TYPE_PALETTE:
-    case PNG_COLOR_TYPE_RGB_ALPHA:
-        format = PixelFormat::RGBA;
-        break;
-    default:
-        // badness
-        break;
-    }
+    setPNGTransforms(png_ptr, info_ptr, bit_depth, color_type);
 
-    img = new Image(format, width, height);
+    // Large images are reduced while their rows are read, except interlaced
+    // ones which need the full image for all passes but the first. The first
+    // pass holds every 8th pixel of every 8th row, so if the image is reduced
+    // by 8 or more only that pass is decoded.
+    int factor = DownsampleFactor(static_cast<int>(width), static_cast<int>(height), maxSize);
+    bool interlaced = interlace_type != PNG_INTERLACE_NONE;
+    bool firstPassOnly = interlaced && factor >= 8;
+    bool streamed = factor > 1 && (!interlaced || firstPassOnly);
+    if (interlaced && !firstPassOnly)
+        png_set_interlace_handling(png_ptr);
 
-    // TODO: consider using paletted textures if they're available
-    if (color_type == PNG_COLOR_TYPE_PALETTE)
-    {
-        png_set_palette_to_rgb(png_ptr);
-    }
+    png_read_update_info(png_ptr, info_ptr);
 
-    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
-    {
-        png_set_expand_gray_1_2_4_to_8(png_ptr);
-    }
+    // The format after the transformations above
+    PixelFormat format = getPNGFormat(png_ptr, info_ptr);
+    if (format == PixelFormat::Invalid)
+        png_error(png_ptr, "unsupported number of channels");
 
-    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+    if (streamed)
     {
-        png_set_tRNS_to_alpha(png_ptr);
+        int sourceWidth = static_cast<int>(firstPassOnly ? (width + 7) / 8 : width);
+        int sourceHeight = static_cast<int>(firstPassOnly ? (height + 7) / 8 : height);
+
+        img = new Image(format,
+                        std::max(static_cast<int>(width) / factor, 1),
+                        std::max(static_cast<int>(height) / factor, 1));
+        downsampler = new RowDownsampler(*img, sourceWidth, firstPassOnly ? factor / 8 : factor);
+        row = new png_byte[png_get_rowbytes(png_ptr, info_ptr)];
+        for (int i = 0; i < sourceHeight; i++)
+        {
+            png_read_row(png_ptr, row, nullptr);
+            downsampler->addRow(row);
+        }
+        downsampler->finish();
+
+        delete downsampler;
+        downsampler = nullptr;
+        delete[] row;
+        row = nullptr;
+
+        // The remaining passes are skipped
+        if (!firstPassOnly)
+            png_read_end(png_ptr, nullptr);
     }
+    else
+    {
+        img = new Image(format, width, height);
 
-    // TODO: consider passing images with < 8 bits/component to
-    // GL without expanding
-    if (bit_depth == 16)
-        png_set_strip_16(png_ptr);
-    else if (bit_depth < 8)
-        png_set_packing(png_ptr);
+        row_pointers = new png_bytep[height];
+        for (unsigned int i = 0; i < height; i++)
+            row_pointers[i] = (png_bytep) img->getPixelRow(i);
 
-    row_pointers = new png_bytep[height];
-    for (unsigned int i = 0; i < height; i++)
-        row_pointers[i] = (png_bytep) img->getPixelRow(i);
+        png_read_image(png_ptr, row_pointers);
 
-    png_read_image(png_ptr, row_pointers);
+        delete[] row_pointers;
+        row_pointers = nullptr;
 
-    delete[] row_pointers;
+        png_read_end(png_ptr, nullptr);
+    }
 
-    png_read_end(png_ptr, nullptr);
     png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
 
     fclose(fp);
@@ -261,6 +398,38 @@ Image* LoadPNGImage(const fs::path& filename)
     return img;
 }
 
+std::unique_ptr<ImageRowReader> OpenPNGRowReader(const fs::path& filename)
+{
+    auto decoder = std::make_unique<PNGDecoder>();
+#ifdef _WIN32
+    decoder->fp = _wfopen(filename.c_str(), L"rb");
+#else
+    decoder->fp = fopen(filename.c_str(), "rb");
+#endif
+    if (decoder->fp == nullptr)
+        return nullptr;
+
+    png_byte header[8];
+    if (fread(header, 1, sizeof(header), decoder->fp) != sizeof(header) ||
+        png_sig_cmp(header, 0, sizeof(header)) != 0)
+    {
+        return nullptr;
+    }
+
+    decoder->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (decoder->png_ptr == nullptr)
+        return nullptr;
+    decoder->info_ptr = png_create_info_struct(decoder->png_ptr);
+    if (decoder->info_ptr == nullptr || !startPNGDecoder(decoder.get()))
+        return nullptr;
+
+    PixelFormat format = getPNGFormat(decoder->png_ptr, decoder->info_ptr);
+    if (format == PixelFormat::Invalid)
+        return nullptr;
+
+    return std::make_unique<PNGRowReader>(format, std::move(decoder));
+}
+
 bool SavePNGImage(const fs::path& filename, const Image& image)
 {
     return SavePNGImage(filename,
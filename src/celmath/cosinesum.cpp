@@ -0,0 +1,90 @@
+// cosinesum.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "cosinesum.h"
+
+#include <array>
+#include <cstdint>
+
+namespace celestia::math
+{
+
+namespace
+{
+
+// Number of terms evaluated together, enough for 256 bit vectors
+constexpr std::size_t Lanes = 4;
+
+constexpr double TwoOverPi = 6.36619772367581382433e-01;
+// pi/2 split so that multiples of the first two parts by quadrant numbers
+// up to 2^20 are exact (Cody-Waite reduction)
+constexpr double PiOver2_1 = 1.57079632673412561417e+00;
+constexpr double PiOver2_2 = 6.07710050630396597660e-11;
+constexpr double PiOver2_3 = 2.02226624879595063154e-21;
+// Adding and subtracting 1.5 * 2^52 rounds to the nearest integer
+constexpr double RoundingConstant = 6755399441055744.0;
+
+// Minimax polynomials for sin and cos on [-pi/4, pi/4] from fdlibm
+constexpr double S1 = -1.66666666666666324348e-01;
+constexpr double S2 =  8.33333333332248946124e-03;
+constexpr double S3 = -1.98412698298579493134e-04;
+constexpr double S4 =  2.75573137070700676789e-06;
+constexpr double S5 = -2.50507602534068634195e-08;
+constexpr double S6 =  1.58969099521155010221e-10;
+
+constexpr double C1 =  4.16666666666666019037e-02;
+constexpr double C2 = -1.38888888888741095749e-03;
+constexpr double C3 =  2.48015872894767294178e-05;
+constexpr double C4 = -2.75573143513906633035e-07;
+constexpr double C5 =  2.08757232129817482790e-09;
+constexpr double C6 = -1.13596475577881948265e-11;
+
+// Branch free cosine, so that loops calling it can be vectorized
+inline double
+cosine(double x)
+{
+    // x = k * pi/2 + r with |r| <= pi/4
+    double k = (x * TwoOverPi + RoundingConstant) - RoundingConstant;
+    double r = ((x - k * PiOver2_1) - k * PiOver2_2) - k * PiOver2_3;
+
+    double z = r * r;
+    double s = r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+    double c = 1.0 - 0.5 * z + z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+
+    // cos(x) is cos(r), -sin(r), -cos(r), sin(r) in the quadrants 0 to 3.
+    // The selection is done with exact arithmetic instead of conditionals,
+    // which would prevent vectorization.
+    auto quadrant = static_cast<std::int32_t>(k);
+    auto odd = static_cast<double>(quadrant & 1);
+    auto sign = static_cast<double>(1 - ((quadrant + 1) & 2));
+    return sign * (odd * s + (1.0 - odd) * c);
+}
+
+} // end unnamed namespace
+
+
+double
+SumCosines(const double* A, const double* B, const double* C, std::size_t n, double t)
+{
+    std::array<double, Lanes> sums{ };
+    std::size_t i = 0;
+    for (; i + Lanes <= n; i += Lanes)
+    {
+        for (std::size_t j = 0; j < Lanes; j++)
+            sums[j] += A[i + j] * cosine(B[i + j] + C[i + j] * t);
+    }
+
+    double sum = 0.0;
+    for (; i < n; i++)
+        sum += A[i] * cosine(B[i] + C[i] * t);
+
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]) + sum;
+}
+
+} // end namespace celestia::math
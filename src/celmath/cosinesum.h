@@ -0,0 +1,33 @@
+// cosinesum.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+
+namespace celestia::math
+{
+
+// Largest argument B + C * t for which SumCosines is accurate
+constexpr double CosineSumMaxArgument = 1.6e6;
+
+/**
+ * @brief Sums the series A[i] * cos(B[i] + C[i] * t) for i in [0, n).
+ *
+ * The terms are evaluated in groups with a polynomial cosine, which the
+ * compiler can vectorize, so the coefficients are passed as separate
+ * arrays. Each cosine differs from std::cos by at most a few units in the
+ * last place, and the terms are added in a different order, so the result
+ * differs from the sum of A[i] * std::cos(B[i] + C[i] * t) by at most
+ * 1e-15 times the sum of |A[i]|. The arguments must not exceed
+ * CosineSumMaxArgument in magnitude.
+ */
+double SumCosines(const double* A, const double* B, const double* C, std::size_t n, double t);
+
+} // end namespace celestia::math
@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
 
 #include <Eigen/LU>
@@ -118,6 +119,59 @@ Frustum::testSphere(const Eigen::Vector3d& center, double radius) const
 }
 
 
+/** Batched version of testSphere(), producing the same results. The
+  * spheres are processed in tiles of 32, with the coordinates copied to
+  * separate arrays so that the loops over each plane can be vectorized
+  * by the compiler.
+  */
+void
+Frustum::testSpheres(const Eigen::Vector3f* centers,
+                     const float* radii,
+                     std::size_t count,
+                     std::uint32_t* visible) const
+{
+    constexpr std::size_t TileSize = 32;
+    unsigned int nPlanes = infinite ? 5 : 6;
+
+    for (std::size_t first = 0; first < count; first += TileSize)
+    {
+        std::size_t n = std::min(TileSize, count - first);
+        // The tail of the last tile is zeroed and ignored below
+        float x[TileSize] = {};
+        float y[TileSize] = {};
+        float z[TileSize] = {};
+        float r[TileSize] = {};
+        for (std::size_t i = 0; i < n; i++)
+        {
+            x[i] = centers[first + i].x();
+            y[i] = centers[first + i].y();
+            z[i] = centers[first + i].z();
+            r[i] = radii == nullptr ? 0.0f : -radii[first + i];
+        }
+
+        std::uint32_t outside[TileSize] = {};
+        for (unsigned int p = 0; p < nPlanes; p++)
+        {
+            const Eigen::Vector3f& normal = planes[p].normal();
+            float nx = normal.x();
+            float ny = normal.y();
+            float nz = normal.z();
+            float offset = planes[p].offset();
+            for (std::size_t i = 0; i < TileSize; i++)
+            {
+                float distanceToPlane = nx * x[i] + ny * y[i] + nz * z[i] + offset;
+                outside[i] |= static_cast<std::uint32_t>(distanceToPlane < r[i]);
+            }
+        }
+
+        std::uint32_t mask = 0;
+        for (std::size_t i = 0; i < n; i++)
+            mask |= (outside[i] ^ 1U) << i;
+        visible[first / TileSize] = mask;
+    }
+}
+
+
 void
 Frustum::transform(const Eigen::Matrix3f& m)
 {
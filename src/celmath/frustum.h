@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -52,6 +55,14 @@ public:
     Aspect testSphere(const Eigen::Vector3f& center, float radius) const;
     Aspect testSphere(const Eigen::Vector3d& center, double radius) const;
 
+    // Test count spheres at once, setting bit i % 32 of visible[i / 32]
+    // if sphere i isn't entirely outside the frustum. radii may be nullptr
+    // to test points. visible must have room for (count + 31) / 32 words.
+    void testSpheres(const Eigen::Vector3f* centers,
+                     const float* radii,
+                     std::size_t count,
+                     std::uint32_t* visible) const;
+
 private:
     void init(float fov, float aspectRatio, float nearDist, float farDist);
     void init(float left, float right, float top, float bottom, float nearDist, float farDist);
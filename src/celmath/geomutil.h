@@ -227,6 +227,24 @@ Perspective(T fovy, T aspect, T nearZ, T farZ)
     return m;
 }
 
+/*! Return a perspective projection matrix mapping the near plane to a
+ *  depth of 1 and the far plane to 0, for a clip space depth range of
+ *  0 to 1. With a floating point depth buffer the precision is then
+ *  nearly uniform in log distance.
+ */
+template<class T> Eigen::Matrix<T, 4, 4>
+ReversedPerspective(T fovy, T aspect, T nearZ, T farZ)
+{
+    Eigen::Matrix<T, 4, 4> m = Perspective(fovy, aspect, nearZ, farZ);
+    if (m(3, 3) != static_cast<T>(0))
+        return m;
+
+    T deltaZ = farZ - nearZ;
+    m(2, 2) = nearZ / deltaZ;
+    m(2, 3) = nearZ * farZ / deltaZ;
+    return m;
+}
+
 /*! Return an orthographic projection matrix
  */
 template<class T> Eigen::Matrix<T, 4, 4>
@@ -11,7 +11,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -132,4 +135,87 @@ template<class T> bool testIntersection(const Eigen::ParametrizedLine<T, 3>& ray
     }
     return false;
 }
+
+
+// Intersect a ray with count ellipsoids at once, writing the distance to
+// each one into distances, or infinity where the ray misses it. The
+// distances are those of the single ellipsoid test, up to rounding.
+// Returns the index of the nearest ellipsoid hit, or count if there is
+// none. The loop has no branches, so that it can be vectorized by the
+// compiler.
+template<class T> std::size_t testIntersections(const Eigen::ParametrizedLine<T, 3>& ray,
+                                                const Ellipsoid<T>* ellipsoids,
+                                                std::size_t count,
+                                                T* distances)
+{
+    using std::sqrt;
+
+    const T ox = ray.origin().x();
+    const T oy = ray.origin().y();
+    const T oz = ray.origin().z();
+    const T dx = ray.direction().x();
+    const T dy = ray.direction().y();
+    const T dz = ray.direction().z();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Ellipsoid<T>& e = ellipsoids[i];
+        T sx = static_cast<T>(1) / square(e.axes.x());
+        T sy = static_cast<T>(1) / square(e.axes.y());
+        T sz = static_cast<T>(1) / square(e.axes.z());
+        T diffx = ox - e.center.x();
+        T diffy = oy - e.center.y();
+        T diffz = oz - e.center.z();
+
+        T a = dx * dx * sx + dy * dy * sy + dz * dz * sz;
+        T b = dx * diffx * sx + dy * diffy * sy + dz * diffz * sz;
+        T c = diffx * diffx * sx + diffy * diffy * sy + diffz * diffz * sz - static_cast<T>(1);
+        T disc = b * b - a * c;
+        T root = sqrt(std::max(disc, static_cast<T>(0)));
+
+        // As a > 0, sol0 is the farther solution
+        T sol0 = (-b + root) / a;
+        T sol1 = (-b - root) / a;
+        T distance = sol1 >= static_cast<T>(0) ? sol1 : sol0;
+        bool hit = disc >= static_cast<T>(0) && sol0 > static_cast<T>(0);
+        distances[i] = hit ? distance : std::numeric_limits<T>::infinity();
+    }
+
+    std::size_t nearest = count;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (distances[i] != std::numeric_limits<T>::infinity() &&
+            (nearest == count || distances[i] < distances[nearest]))
+        {
+            nearest = i;
+        }
+    }
+
+    return nearest;
+}
+
+
+// Return true if a sphere is completely hidden from a viewer at the origin
+// by an opaque occluder sphere: it lies within the cone of rays which hit
+// the occluder, and all its points are farther than the rim of the
+// occluder, the farthest point where those rays can enter it.
+template<class T> bool testOcclusion(const Sphere<T>& occluder,
+                                     const Sphere<T>& sphere)
+{
+    T occluderDistance2 = occluder.center.squaredNorm();
+    T occluderRadius2 = occluder.radius * occluder.radius;
+    T distance = sphere.center.norm();
+    if (occluderDistance2 <= occluderRadius2 || distance <= sphere.radius)
+        return false;
+
+    T rimDistance = std::sqrt(occluderDistance2 - occluderRadius2);
+    if (distance - sphere.radius < rimDistance)
+        return false;
+
+    T occluderDistance = std::sqrt(occluderDistance2);
+    T cosAngle = occluder.center.dot(sphere.center) / (occluderDistance * distance);
+    T angle = std::acos(std::clamp(cosAngle, static_cast<T>(-1), static_cast<T>(1)));
+    return angle + std::asin(sphere.radius / distance) <= std::asin(occluder.radius / occluderDistance);
+}
+
 } // namespace celestia::math
@@ -10,8 +10,11 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <iterator>
+#include <memory>
 #include <tuple>
 #include <utility>
 #include <celutil/logger.h>
@@ -21,6 +24,7 @@
 #endif
 
 #include "mesh.h"
+#include "meshoptimize.h"
 
 using celestia::util::GetLogger;
 
@@ -123,6 +127,7 @@ PrimitiveGroup::clone() const
     PrimitiveGroup newGroup;
     newGroup.prim = prim;
     newGroup.materialIndex = materialIndex;
+    newGroup.lod = lod;
     newGroup.indices = indices;
     newGroup.indicesCount = indicesCount;
     newGroup.indicesOffset = indicesOffset;
@@ -161,9 +166,12 @@ Mesh::clone() const
     newMesh.vertexDesc = vertexDesc.clone();
     newMesh.nVertices = nVertices;
     newMesh.vertices = vertices;
+    newMesh.positionOffset = positionOffset;
+    newMesh.positionScale = positionScale;
     newMesh.groups.reserve(groups.size());
     std::transform(groups.cbegin(), groups.cend(), std::back_inserter(newMesh.groups),
                    [](const PrimitiveGroup& group) { return group.clone(); });
+    newMesh.lodErrors = lodErrors;
     newMesh.name = name;
     return newMesh;
 }
@@ -174,6 +182,7 @@ Mesh::setVertices(unsigned int _nVertices, std::vector<VWord>&& vertexData)
 {
     nVertices = _nVertices;
     vertices = std::move(vertexData);
+    invalidatePickTree();
 }
 
 
@@ -184,6 +193,7 @@ Mesh::setVertexDescription(VertexDescription&& desc)
         return false;
 
     vertexDesc = std::move(desc);
+    invalidatePickTree();
     return true;
 }
 
@@ -194,6 +204,45 @@ const VertexDescription& Mesh::getVertexDescription() const
 }
 
 
+void
+Mesh::setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    positionOffset = offset;
+    positionScale = scale;
+    invalidatePickTree();
+}
+
+
+bool
+Mesh::hasPositions() const
+{
+    const auto& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    return position.semantic == VertexAttributeSemantic::Position &&
+           (position.format == VertexAttributeFormat::Float3 ||
+            position.format == VertexAttributeFormat::Short4);
+}
+
+
+Eigen::Vector3f
+Mesh::getPosition(unsigned int vertex) const
+{
+    const auto& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    const VWord* vdata = vertices.data() + vertex * getVertexStrideWords() + position.offsetWords;
+    if (position.format == VertexAttributeFormat::Short4)
+    {
+        std::array<std::int16_t, 4> packed;
+        std::memcpy(packed.data(), vdata, sizeof(packed));
+        Eigen::Vector3f p(packed[0], packed[1], packed[2]);
+        p = (p / 32767.0f).cwiseMax(-1.0f);
+        return positionOffset + positionScale.cwiseProduct(p);
+    }
+
+    Eigen::Vector3f p;
+    std::memcpy(p.data(), vdata, sizeof(float) * 3);
+    return p;
+}
+
+
 const PrimitiveGroup*
 Mesh::getGroup(unsigned int index) const
 {
@@ -210,6 +259,8 @@ Mesh::getGroup(unsigned int index)
     if (index >= groups.size())
         return nullptr;
 
+    // The group may be changed by the caller
+    invalidatePickTree();
     return &groups[index];
 }
 
@@ -218,6 +269,7 @@ unsigned int
 Mesh::addGroup(PrimitiveGroup&& group)
 {
     groups.push_back(std::move(group));
+    invalidatePickTree();
     return groups.size();
 }
 
@@ -225,12 +277,14 @@ Mesh::addGroup(PrimitiveGroup&& group)
 unsigned int
 Mesh::addGroup(PrimitiveGroupType prim,
                unsigned int materialIndex,
-               std::vector<Index32>&& indices)
+               std::vector<Index32>&& indices,
+               unsigned int lod)
 {
     PrimitiveGroup g;
     g.indices = std::move(indices);
     g.prim = prim;
     g.materialIndex = materialIndex;
+    g.lod = lod;
 
     return addGroup(std::move(g));
 }
@@ -247,6 +301,35 @@ void
 Mesh::clearGroups()
 {
     groups.clear();
+    invalidatePickTree();
+}
+
+
+unsigned int
+Mesh::addLod(float error)
+{
+    lodErrors.push_back(error);
+    return static_cast<unsigned int>(lodErrors.size());
+}
+
+
+float
+Mesh::getLodError(unsigned int level) const
+{
+    if (level == 0 || level > lodErrors.size())
+        return 0.0f;
+    return lodErrors[level - 1];
+}
+
+
+void
+Mesh::clearLods()
+{
+    groups.erase(std::remove_if(groups.begin(), groups.end(),
+                                [](const PrimitiveGroup& g) { return g.lod != 0; }),
+                 groups.end());
+    lodErrors.clear();
+    invalidatePickTree();
 }
 
 
@@ -274,6 +357,8 @@ Mesh::remapIndices(const std::vector<Index32>& indexMap)
             index = indexMap[index];
         }
     }
+
+    invalidatePickTree();
 }
 
 
@@ -291,9 +376,10 @@ Mesh::aggregateByMaterial()
     std::sort(groups.begin(), groups.end(),
               [](const PrimitiveGroup& g0, const PrimitiveGroup& g1)
               {
-                  return g0.materialIndex < g1.materialIndex;
+                  return std::tie(g0.lod, g0.materialIndex) < std::tie(g1.lod, g1.materialIndex);
               });
     mergePrimitiveGroups();
+    invalidatePickTree();
 }
 
 
@@ -337,7 +423,7 @@ Mesh::mergePrimitiveGroups()
         else
         {
             auto &p = newGroups.back();
-            if (p.prim != g.prim || p.materialIndex != g.materialIndex)
+            if (p.prim != g.prim || p.materialIndex != g.materialIndex || p.lod != g.lod)
             {
                 newGroups.push_back(std::move(g));
             }
@@ -355,21 +441,53 @@ Mesh::mergePrimitiveGroups()
 void
 Mesh::optimize()
 {
-#ifdef HAVE_MESHOPTIMIZER
-    if (groups.size() != 1)
-        return;
+    for (const auto& g : groups)
+    {
+        if (std::any_of(g.indices.begin(), g.indices.end(), [this](Index32 i) { return i >= nVertices; }))
+            return;
+    }
 
-    auto &g = groups.front();
+    // Positions are needed to sort the triangles for overdraw
+    std::vector<Eigen::Vector3f> positions;
+    if (hasPositions())
+    {
+        positions.resize(nVertices);
+        for (unsigned int i = 0; i < nVertices; ++i)
+            positions[i] = getPosition(i);
+    }
 
-    if (g.prim != PrimitiveGroupType::TriList)
-        return;
+    for (auto& g : groups)
+    {
+        if (g.prim != PrimitiveGroupType::TriList || g.indices.empty())
+            continue;
 
-    meshopt_optimizeVertexCache(g.indices.data(), g.indices.data(), g.indices.size(), nVertices);
-    meshopt_optimizeOverdraw(g.indices.data(), g.indices.data(), g.indices.size(), reinterpret_cast<float*>(vertices.data()), nVertices, vertexDesc.strideBytes, 1.05f);
-    meshopt_optimizeVertexFetch(vertices.data(), g.indices.data(), g.indices.size(), vertices.data(), nVertices, vertexDesc.strideBytes);
+#ifdef HAVE_MESHOPTIMIZER
+        meshopt_optimizeVertexCache(g.indices.data(), g.indices.data(), g.indices.size(), nVertices);
+        if (!positions.empty())
+            meshopt_optimizeOverdraw(g.indices.data(), g.indices.data(), g.indices.size(), positions[0].data(), nVertices, sizeof(positions[0]), 1.05f);
+#else
+        auto clusters = OptimizeVertexCache(g.indices, nVertices);
+        if (!positions.empty())
+            OptimizeOverdraw(g.indices, clusters, positions);
 #endif
+    }
+
+    // Store the vertices in the order in which they're first drawn
+    std::vector<const std::vector<Index32>*> indexLists;
+    for (const auto& g : groups)
+        indexLists.push_back(&g.indices);
+    std::vector<Index32> remap = ComputeVertexFetchRemap(indexLists, nVertices);
+
+    unsigned int stride = getVertexStrideWords();
+    std::vector<VWord> newVertices(vertices.size());
+    for (unsigned int i = 0; i < nVertices; ++i)
+        std::copy_n(vertices.begin() + i * stride, stride, newVertices.begin() + remap[i] * stride);
+
+    vertices = std::move(newVertices);
+    remapIndices(remap);
 }
 
+
 void
 Mesh::rebuildIndexMetadata()
 {
@@ -383,140 +501,79 @@ Mesh::rebuildIndexMetadata()
     nTotalIndices = offset;
 }
 
+const PickTree&
+Mesh::getPickTree() const
+{
+    if (pickTree != nullptr)
+        return *pickTree;
+
+    std::vector<Eigen::Vector3f> positions(nVertices);
+    for (unsigned int i = 0; i < nVertices; ++i)
+        positions[i] = getPosition(i);
+
+    // Only the triangles of the full detail level; the simplified levels
+    // would only find the same surface
+    std::vector<PickTree::Triangle> triangles;
+    for (std::size_t g = 0; g < groups.size(); ++g)
+    {
+        const PrimitiveGroup& group = groups[g];
+        if (group.lod != 0 || group.indices.size() < 3)
+            continue;
+
+        std::size_t nTriangles;
+        if (group.prim == PrimitiveGroupType::TriList)
+            nTriangles = group.indices.size() / 3;
+        else if (group.prim == PrimitiveGroupType::TriStrip || group.prim == PrimitiveGroupType::TriFan)
+            nTriangles = group.indices.size() - 2;
+        else
+            continue;
+
+        for (std::size_t i = 0; i < nTriangles; ++i)
+        {
+            PickTree::Triangle triangle;
+            if (group.prim == PrimitiveGroupType::TriList)
+                triangle.vertices = { group.indices[i * 3], group.indices[i * 3 + 1], group.indices[i * 3 + 2] };
+            else if (group.prim == PrimitiveGroupType::TriStrip)
+                triangle.vertices = { group.indices[i], group.indices[i + 1], group.indices[i + 2] };
+            else
+                triangle.vertices = { group.indices[0], group.indices[i + 1], group.indices[i + 2] };
+
+            if (std::any_of(triangle.vertices.begin(), triangle.vertices.end(),
+                            [this](Index32 vertex) { return vertex >= nVertices; }))
+                continue;
+
+            triangle.group = static_cast<std::uint32_t>(g);
+            triangle.primitive = static_cast<std::uint32_t>(i);
+            triangles.push_back(triangle);
+        }
+    }
+
+    pickTree = std::make_unique<PickTree>(std::move(positions), std::move(triangles));
+    return *pickTree;
+}
+
+
 bool
 Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
 {
-    double maxDistance = 1.0e30;
-    double closest = maxDistance;
-
     // Pick will automatically fail without vertex positions--no reasonable
     // mesh should lack these.
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
-        vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
-    {
+    if (!hasPositions())
         return false;
-    }
 
-    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
-    unsigned int posOffset = vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-    const VWord* vdata = vertices.data();
+    double distance = 1.0e30;
+    const PickTree::Triangle* triangle = getPickTree().pick(rayOrigin, rayDirection, distance);
+    if (triangle == nullptr)
+        return false;
 
-    // Iterate over all primitive groups in the mesh
-    for (const auto& group : groups)
+    if (result)
     {
-        PrimitiveGroupType primType = group.prim;
-        Index32 nIndices = group.indices.size();
-
-        // Only attempt to compute the intersection of the ray with triangle
-        // groups.
-        if ((primType == PrimitiveGroupType::TriList
-             || primType == PrimitiveGroupType::TriStrip
-             || primType == PrimitiveGroupType::TriFan) &&
-            (nIndices >= 3) &&
-            !(primType == PrimitiveGroupType::TriList && nIndices % 3 != 0))
-        {
-            unsigned int primitiveIndex = 0;
-            Index32 index = 0;
-            Index32 i0 = group.indices[0];
-            Index32 i1 = group.indices[1];
-            Index32 i2 = group.indices[2];
-
-            // Iterate over the triangles in the primitive group
-            do
-            {
-                // Get the triangle vertices v0, v1, and v2
-                float fv[3];
-                std::memcpy(fv, vdata + i0 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v0 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i1 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v1 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i2 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v2 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-
-                // Compute the edge vectors e0 and e1, and the normal n
-                Eigen::Vector3d e0 = v1 - v0;
-                Eigen::Vector3d e1 = v2 - v0;
-                Eigen::Vector3d n = e0.cross(e1);
-
-                // c is the cosine of the angle between the ray and triangle normal
-                double c = n.dot(rayDirection);
-
-                // If the ray is parallel to the triangle, it either misses the
-                // triangle completely, or is contained in the triangle's plane.
-                // If it's contained in the plane, we'll still call it a miss.
-                if (c != 0.0)
-                {
-                    double t = (n.dot(v0 - rayOrigin)) / c;
-                    if (t < closest && t > 0.0)
-                    {
-                        double m00 = e0.dot(e0);
-                        double m01 = e0.dot(e1);
-                        double m10 = e1.dot(e0);
-                        double m11 = e1.dot(e1);
-                        double det = m00 * m11 - m01 * m10;
-                        if (det != 0.0)
-                        {
-                            Eigen::Vector3d p = rayOrigin + rayDirection * t;
-                            Eigen::Vector3d q = p - v0;
-                            double q0 = e0.dot(q);
-                            double q1 = e1.dot(q);
-                            double d = 1.0 / det;
-                            double s0 = (m11 * q0 - m01 * q1) * d;
-                            double s1 = (m00 * q1 - m10 * q0) * d;
-                            if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0)
-                            {
-                                closest = t;
-                                if (result)
-                                {
-                                    result->group = &group;
-                                    result->primitiveIndex = primitiveIndex;
-                                    result->distance = closest;
-                                }
-                            }
-                        }
-                    }
-                }
-
-                // Get the indices for the next triangle
-                if (primType == PrimitiveGroupType::TriList)
-                {
-                    index += 3;
-                    if (index < nIndices)
-                    {
-                        i0 = group.indices[index + 0];
-                        i1 = group.indices[index + 1];
-                        i2 = group.indices[index + 2];
-                    }
-                }
-                else if (primType == PrimitiveGroupType::TriStrip)
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                }
-                else // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        index += 1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                    }
-                }
-
-                primitiveIndex++;
-
-            } while (index < nIndices);
-        }
+        result->group = &groups[triangle->group];
+        result->primitiveIndex = triangle->primitive;
+        result->distance = distance;
     }
 
-    return closest != maxDistance;
+    return true;
 }
 
 
@@ -540,26 +597,21 @@ Mesh::getBoundingBox() const
     Eigen::AlignedBox<float, 3> bbox;
 
     // Return an empty box if there's no position info
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    if (!hasPositions())
         return bbox;
 
-    const VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
     if (vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).format == VertexAttributeFormat::Float1)
     {
         // Handle bounding box calculation for point sprites. Unlike other
         // primitives, point sprite vertices have a non-zero size.
-        int pointSizeOffset = (int) vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).offsetWords -
-            (int) vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
+        const VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).offsetWords;
 
         for (unsigned int i = 0; i < nVertices; i++, vdata += stride)
         {
-            float fv[3];
-            std::memcpy(fv, vdata, sizeof(float) * 3);
-            Eigen::Vector3f center = Eigen::Map<Eigen::Vector3f>(fv);
+            Eigen::Vector3f center = getPosition(i);
             float pointSize;
-            std::memcpy(&pointSize, vdata + pointSizeOffset, sizeof(float));
+            std::memcpy(&pointSize, vdata, sizeof(float));
             Eigen::Vector3f offsetVec = Eigen::Vector3f::Constant(pointSize);
 
             Eigen::AlignedBox<float, 3> pointbox(center - offsetVec, center + offsetVec);
@@ -568,12 +620,8 @@ Mesh::getBoundingBox() const
     }
     else
     {
-        for (unsigned int i = 0; i < nVertices; i++, vdata += stride)
-        {
-            float fv[3];
-            std::memcpy(fv, vdata, sizeof(float) * 3);
-            bbox.extend(Eigen::Map<Eigen::Vector3f>(fv));
-        }
+        for (unsigned int i = 0; i < nVertices; i++)
+            bbox.extend(getPosition(i));
     }
 
     return bbox;
@@ -583,7 +631,7 @@ Mesh::getBoundingBox() const
 void
 Mesh::transform(const Eigen::Vector3f& translation, float scale)
 {
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    if (!hasPositions())
         return;
 
     VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
@@ -591,15 +639,28 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
 
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
 
-    // Scale and translate the vertex positions
-    for (i = 0; i < nVertices; i++, vdata += stride)
+    // Scale and translate the vertex positions; packed positions only
+    // need their quantization changed
+    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format == VertexAttributeFormat::Short4)
     {
-        float fv[3];
-        std::memcpy(fv, vdata, sizeof(float) * 3);
-        const Eigen::Vector3f tv = (Eigen::Map<Eigen::Vector3f>(fv) + translation) * scale;
-        std::memcpy(vdata, tv.data(), sizeof(float) * 3);
+        positionOffset = (positionOffset + translation) * scale;
+        positionScale *= scale;
+    }
+    else
+    {
+        for (i = 0; i < nVertices; i++, vdata += stride)
+        {
+            float fv[3];
+            std::memcpy(fv, vdata, sizeof(float) * 3);
+            const Eigen::Vector3f tv = (Eigen::Map<Eigen::Vector3f>(fv) + translation) * scale;
+            std::memcpy(vdata, tv.data(), sizeof(float) * 3);
+        }
     }
 
+    for (float& error : lodErrors)
+        error *= scale;
+    invalidatePickTree();
+
     // Point sizes need to be scaled as well
     if (vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).format == VertexAttributeFormat::Float1)
     {
@@ -621,7 +682,10 @@ Mesh::getPrimitiveCount() const
     unsigned int count = 0;
 
     for (const auto& group : groups)
-        count += group.getPrimitiveCount();
+    {
+        if (group.lod == 0)
+            count += group.getPrimitiveCount();
+    }
 
     return count;
 }
@@ -629,36 +693,43 @@ Mesh::getPrimitiveCount() const
 void
 Mesh::merge(const Mesh &other)
 {
-    auto &ti = groups.front().indices;
-    const auto &oi = other.groups.front().indices;
-
-    ti.reserve(ti.size() + oi.size());
-    for (auto i : oi)
-        ti.push_back(i + nVertices);
+    // Append the groups of the other mesh, groups sharing a material are
+    // combined by aggregateByMaterial()
+    for (const auto &og : other.groups)
+    {
+        PrimitiveGroup g = og.clone();
+        for (auto &i : g.indices)
+            i += nVertices;
+        groups.push_back(std::move(g));
+    }
 
     vertices.reserve(vertices.size() + other.vertices.size());
     vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
 
     nVertices += other.nVertices;
+    invalidatePickTree();
 }
 
 bool
 Mesh::canMerge(const Mesh &other, const std::vector<Material> &materials) const
 {
-    if (getGroupCount() != 1 || other.getGroupCount() != 1)
+    if (groups.empty() || other.groups.empty())
         return false;
 
-    const auto &tg = groups.front();
-    const auto &og = other.groups.front();
-
-    if (tg.prim != PrimitiveGroupType::TriList)
+    // The levels of detail are chosen per mesh
+    if (!lodErrors.empty() || !other.lodErrors.empty())
         return false;
 
-    if (std::tie(tg.materialIndex, tg.prim, vertexDesc.strideBytes) !=
-        std::tie(og.materialIndex, og.prim, other.vertexDesc.strideBytes))
+    if (vertexDesc.strideBytes != other.vertexDesc.strideBytes)
         return false;
 
-    if (!isOpaqueMaterial(materials[tg.materialIndex]) || !isOpaqueMaterial(materials[og.materialIndex]))
+    // Translucent groups are drawn in the order of the model
+    auto isOpaqueGroup = [&materials](const PrimitiveGroup &g)
+    {
+        return g.materialIndex < materials.size() && isOpaqueMaterial(materials[g.materialIndex]);
+    };
+    if (!std::all_of(groups.begin(), groups.end(), isOpaqueGroup) ||
+        !std::all_of(other.groups.begin(), other.groups.end(), isOpaqueGroup))
         return false;
 
     for (auto i = VertexAttributeSemantic::Position;
@@ -671,6 +742,11 @@ Mesh::canMerge(const Mesh &other, const std::vector<Material> &materials) const
             return false;
     }
 
+    // Packed positions share the quantization of the mesh
+    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format == VertexAttributeFormat::Short4 &&
+        (positionOffset != other.positionOffset || positionScale != other.positionScale))
+        return false;
+
     return true;
 }
 
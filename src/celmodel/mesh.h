@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -20,6 +21,7 @@
 #include <Eigen/Geometry>
 
 #include "material.h"
+#include "picktree.h"
 
 
 namespace cmod
@@ -46,6 +48,10 @@ enum class VertexAttributeSemantic : std::int16_t
 };
 
 
+// The 16-bit formats are packed by QuantizeMesh. Short2 and Short4 hold
+// normalized signed values: Short4 positions are scaled by the position
+// quantization of the mesh, the w component is unused, and Short2 normals
+// are octahedral encoded. Half2 holds half floats.
 enum class VertexAttributeFormat : std::int16_t
 {
     Float1    = 0,
@@ -53,7 +59,10 @@ enum class VertexAttributeFormat : std::int16_t
     Float3    = 2,
     Float4    = 3,
     UByte4    = 4,
-    FormatMax = 5,
+    Short2    = 5,
+    Short4    = 6,
+    Half2     = 7,
+    FormatMax = 8,
     InvalidFormat = -1,
 };
 
@@ -96,8 +105,11 @@ struct VertexAttribute
         {
         case VertexAttributeFormat::Float1:
         case VertexAttributeFormat::UByte4:
+        case VertexAttributeFormat::Short2:
+        case VertexAttributeFormat::Half2:
             return 1;
         case VertexAttributeFormat::Float2:
+        case VertexAttributeFormat::Short4:
             return 2;
         case VertexAttributeFormat::Float3:
             return 3;
@@ -167,6 +179,8 @@ struct PrimitiveGroup
 
     PrimitiveGroupType prim{ PrimitiveGroupType::InvalidPrimitiveGroupType };
     unsigned int materialIndex{ 0 };
+    // Level of detail the group is drawn at, 0 is the full detail
+    unsigned int lod{ 0 };
     int indicesCount{ 0 };
     int indicesOffset{ 0 };
     std::vector<Index32> indices{ };
@@ -205,7 +219,8 @@ class Mesh
     unsigned int addGroup(PrimitiveGroup&& group);
     unsigned int addGroup(PrimitiveGroupType prim,
                           unsigned int materialIndex,
-                          std::vector<Index32>&& indices);
+                          std::vector<Index32>&& indices,
+                          unsigned int lod = 0);
     unsigned int getGroupCount() const;
     void remapIndices(const std::vector<Index32>& indexMap);
     void clearGroups();
@@ -218,32 +233,70 @@ class Mesh
      */
     void aggregateByMaterial();
 
+    /*! Simplified levels of detail are groups with a lod above 0 drawing
+     *  the vertices of the mesh. Each level has the largest distance of its
+     *  surface from the full detail one, in model units, so that a level can
+     *  be chosen by its size on screen. addLod returns the new level.
+     */
+    unsigned int addLod(float error);
+    unsigned int getLodCount() const { return static_cast<unsigned int>(lodErrors.size()) + 1; }
+    float getLodError(unsigned int level) const;
+    // Remove the simplified levels and their groups
+    void clearLods();
+
     const std::string& getName() const;
     void setName(std::string&&);
 
+    /*! Find the nearest triangle of the full detail level hit by a ray.
+     *  The triangles are put in a PickTree on the first pick, which is
+     *  dropped when the mesh changes.
+     */
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
     Eigen::AlignedBox<float, 3> getBoundingBox() const;
     void transform(const Eigen::Vector3f& translation, float scale);
 
+    /*! Short4 positions p are offset + scale * p.xyz. The renderer passes
+     *  these to the vertex shader.
+     */
+    void setPositionQuantization(const Eigen::Vector3f& offset, const Eigen::Vector3f& scale);
+    const Eigen::Vector3f& getPositionOffset() const { return positionOffset; }
+    const Eigen::Vector3f& getPositionScale() const { return positionScale; }
+    Eigen::Vector3f getPosition(unsigned int vertex) const;
+
     const VWord* getVertexData() const { return vertices.data(); }
     unsigned int getVertexCount() const { return nVertices; }
     unsigned int getVertexStrideWords() const { return vertexDesc.strideBytes / sizeof(cmod::VWord); }
+    // Primitives of the full detail level
     unsigned int getPrimitiveCount() const;
 
     unsigned int getIndexCount() const { return nTotalIndices; }
 
+    /*! Append the vertices and primitive groups of another mesh with the
+     *  same vertex layout. Only meshes made of opaque groups can be merged,
+     *  since the groups are reordered by aggregateByMaterial().
+     */
     void merge(const Mesh&);
     bool canMerge(const Mesh&, const std::vector<Material> &materials) const;
+
+    /*! Reorder the triangles of the triangle lists for the vertex cache
+     *  and to reduce overdraw, then the vertices in the order they're
+     *  used.
+     */
     void optimize();
 
     void rebuildIndexMetadata();
 
  private:
     void mergePrimitiveGroups();
+    bool hasPositions() const;
+    const PickTree& getPickTree() const;
+    void invalidatePickTree() { pickTree.reset(); }
 
     VertexDescription vertexDesc{ };
+    Eigen::Vector3f positionOffset{ Eigen::Vector3f::Zero() };
+    Eigen::Vector3f positionScale{ Eigen::Vector3f::Ones() };
 
     unsigned int nVertices{ 0 };
     std::vector<VWord> vertices{ };
@@ -251,8 +304,11 @@ class Mesh
     unsigned int nTotalIndices{ 0 };
 
     std::vector<PrimitiveGroup> groups;
+    std::vector<float> lodErrors;
 
     std::string name;
+
+    mutable std::unique_ptr<PickTree> pickTree;
 };
 
 Mesh GenerateTangents(const Mesh& mesh);
@@ -0,0 +1,312 @@
+// meshoptimize.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshoptimize.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+
+namespace cmod
+{
+
+namespace
+{
+
+constexpr std::size_t NotCached = std::numeric_limits<std::size_t>::max();
+constexpr Index32 Unmapped = std::numeric_limits<Index32>::max();
+constexpr long NoVertex = -1;
+
+
+bool
+isValidTriangleList(const std::vector<Index32>& indices, std::size_t vertexCount)
+{
+    return indices.size() % 3 == 0 &&
+           std::all_of(indices.begin(), indices.end(),
+                       [vertexCount](Index32 i) { return i < vertexCount; });
+}
+
+
+// FIFO vertex cache which can be emptied in constant time
+class VertexCacheSimulator
+{
+public:
+    VertexCacheSimulator(std::size_t vertexCount, unsigned int cacheSize) :
+        stamps(vertexCount, NotCached),
+        cacheSize(cacheSize)
+    {
+    }
+
+    // Return true if the vertex had to be transformed
+    bool access(Index32 vertex)
+    {
+        std::size_t& stamp = stamps[vertex];
+        if (stamp != NotCached && stamp >= base && misses - stamp < cacheSize)
+            return false;
+        stamp = misses++;
+        return true;
+    }
+
+    void reset() { base = misses; }
+    std::size_t getMisses() const { return misses; }
+
+private:
+    std::vector<std::size_t> stamps;
+    std::size_t cacheSize;
+    std::size_t misses{ 0 };
+    std::size_t base{ 0 };
+};
+
+
+struct Cluster
+{
+    std::size_t first;
+    std::size_t last;
+    float sortKey;
+};
+
+} // end unnamed namespace
+
+
+float
+ComputeACMR(const std::vector<Index32>& indices, unsigned int cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    Index32 vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+    VertexCacheSimulator cache(vertexCount, cacheSize);
+    for (Index32 i : indices)
+        cache.access(i);
+
+    return static_cast<float>(cache.getMisses()) / static_cast<float>(indices.size() / 3);
+}
+
+
+std::vector<std::size_t>
+OptimizeVertexCache(std::vector<Index32>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || !isValidTriangleList(indices, vertexCount))
+        return {};
+
+    // Triangles using each vertex, and the number of them not emitted yet
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (Index32 i : indices)
+        ++live[i];
+
+    std::vector<std::size_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+
+    std::vector<std::size_t> adjacency(indices.size());
+    {
+        std::vector<std::size_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); ++i)
+            adjacency[cursor[indices[i]]++] = i / 3;
+    }
+
+    // Time at which each vertex entered the cache
+    std::vector<std::size_t> cacheTime(vertexCount, 0);
+    std::size_t time = cacheSize + 1;
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<Index32> deadEnd;
+    std::vector<Index32> candidates;
+    std::vector<Index32> result;
+    result.reserve(indices.size());
+    std::vector<std::size_t> clusters{ 0 };
+    unsigned int cursor = 0;
+
+    long fanning = indices[0];
+    while (fanning != NoVertex)
+    {
+        // Emit the remaining triangles around the fanning vertex
+        candidates.clear();
+        for (std::size_t k = adjacencyOffsets[fanning]; k < adjacencyOffsets[fanning + 1]; ++k)
+        {
+            std::size_t t = adjacency[k];
+            if (emitted[t])
+                continue;
+
+            for (std::size_t j = 0; j < 3; ++j)
+            {
+                Index32 v = indices[t * 3 + j];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // The next fanning vertex is the one of the last triangles which
+        // will still be cached once its remaining triangles are emitted
+        fanning = NoVertex;
+        long bestPriority = -1;
+        for (Index32 v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+
+            long priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = static_cast<long>(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        if (fanning != NoVertex)
+            continue;
+
+        // Dead end: go back to a recently used vertex, or to the next
+        // vertex with triangles left
+        while (!deadEnd.empty() && fanning == NoVertex)
+        {
+            Index32 v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+
+        for (; cursor < vertexCount && fanning == NoVertex; ++cursor)
+        {
+            if (live[cursor] > 0)
+                fanning = cursor;
+        }
+
+        if (fanning != NoVertex)
+            clusters.push_back(result.size() / 3);
+    }
+
+    indices = std::move(result);
+    return clusters;
+}
+
+
+void
+OptimizeOverdraw(std::vector<Index32>& indices,
+                 const std::vector<std::size_t>& hardClusters,
+                 const std::vector<Eigen::Vector3f>& positions,
+                 float threshold,
+                 unsigned int cacheSize)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || hardClusters.empty() || !isValidTriangleList(indices, positions.size()))
+        return;
+
+    // Split the clusters where the vertex cache efficiency of the part
+    // drawn so far is good enough
+    float maxACMR = ComputeACMR(indices, cacheSize) * threshold;
+    VertexCacheSimulator cache(positions.size(), cacheSize);
+    std::vector<Cluster> clusters;
+    for (std::size_t c = 0; c < hardClusters.size(); ++c)
+    {
+        std::size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+        std::size_t first = hardClusters[c];
+        std::size_t firstMisses = cache.getMisses();
+        cache.reset();
+        for (std::size_t t = first; t < end; ++t)
+        {
+            for (std::size_t j = 0; j < 3; ++j)
+                cache.access(indices[t * 3 + j]);
+
+            auto misses = static_cast<float>(cache.getMisses() - firstMisses);
+            if (t + 1 < end && misses <= maxACMR * static_cast<float>(t + 1 - first))
+            {
+                clusters.push_back(Cluster{ first, t + 1, 0.0f });
+                first = t + 1;
+                firstMisses = cache.getMisses();
+                cache.reset();
+            }
+        }
+        clusters.push_back(Cluster{ first, end, 0.0f });
+    }
+
+    // Sort the clusters by the distance of their centroid to the one of
+    // the mesh along their average normal
+    std::vector<Eigen::Vector3f> centroids;
+    std::vector<Eigen::Vector3f> normals;
+    centroids.reserve(clusters.size());
+    normals.reserve(clusters.size());
+    Eigen::Vector3f meshCentroid = Eigen::Vector3f::Zero();
+    float meshArea = 0.0f;
+    for (const Cluster& cluster : clusters)
+    {
+        Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+        Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+        float area = 0.0f;
+        for (std::size_t t = cluster.first; t < cluster.last; ++t)
+        {
+            const Eigen::Vector3f& p0 = positions[indices[t * 3]];
+            const Eigen::Vector3f& p1 = positions[indices[t * 3 + 1]];
+            const Eigen::Vector3f& p2 = positions[indices[t * 3 + 2]];
+            Eigen::Vector3f n = (p1 - p0).cross(p2 - p0);
+            float a = n.norm();
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids.push_back(area > 0.0f ? Eigen::Vector3f(centroid / area) : centroid);
+        normals.push_back(normal.normalized());
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    for (std::size_t c = 0; c < clusters.size(); ++c)
+        clusters[c].sortKey = (centroids[c] - meshCentroid).dot(normals[c]);
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<Index32> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+
+    indices = std::move(result);
+}
+
+
+std::vector<Index32>
+ComputeVertexFetchRemap(const std::vector<const std::vector<Index32>*>& indexLists, unsigned int vertexCount)
+{
+    std::vector<Index32> remap(vertexCount, Unmapped);
+    Index32 next = 0;
+    for (const std::vector<Index32>* indices : indexLists)
+    {
+        for (Index32 i : *indices)
+        {
+            if (i < vertexCount && remap[i] == Unmapped)
+                remap[i] = next++;
+        }
+    }
+
+    for (Index32& i : remap)
+    {
+        if (i == Unmapped)
+            i = next++;
+    }
+
+    return remap;
+}
+
+} // end namespace cmod
@@ -0,0 +1,63 @@
+// meshoptimize.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+// Size of the post-transform vertex cache assumed by the optimizations
+constexpr unsigned int DefaultVertexCacheSize = 16;
+
+/*! Average number of vertices transformed per triangle of a triangle list
+ *  with a FIFO vertex cache of cacheSize vertices. It ranges from 0.5 for
+ *  an ideal order of a large mesh to 3.
+ */
+float ComputeACMR(const std::vector<Index32>& indices, unsigned int cacheSize = DefaultVertexCacheSize);
+
+/*! Reorder the triangles of a triangle list so that they reuse the vertices
+ *  left in the vertex cache, with the Tipsify algorithm of Sander, Nehab
+ *  and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+ *  Overdraw" (2007). Return the index of the first triangle of each
+ *  cluster of the new order, the places where the algorithm had to jump
+ *  to a vertex it hadn't visited recently.
+ */
+std::vector<std::size_t> OptimizeVertexCache(std::vector<Index32>& indices,
+                                             unsigned int vertexCount,
+                                             unsigned int cacheSize = DefaultVertexCacheSize);
+
+/*! Reorder the clusters of a triangle list returned by OptimizeVertexCache
+ *  so that the clusters facing away from the center of the mesh, which
+ *  are the most likely to occlude others, are drawn first. Clusters are
+ *  split further where it costs less than threshold times the ACMR of the
+ *  list.
+ */
+void OptimizeOverdraw(std::vector<Index32>& indices,
+                      const std::vector<std::size_t>& clusters,
+                      const std::vector<Eigen::Vector3f>& positions,
+                      float threshold = 1.05f,
+                      unsigned int cacheSize = DefaultVertexCacheSize);
+
+/*! Return a map from the old vertex indices to new ones, numbering the
+ *  vertices in the order of their first use by the index lists so that
+ *  they are fetched from contiguous memory. Unused vertices are numbered
+ *  last.
+ */
+std::vector<Index32> ComputeVertexFetchRemap(const std::vector<const std::vector<Index32>*>& indexLists,
+                                             unsigned int vertexCount);
+
+} // end namespace cmod
@@ -0,0 +1,318 @@
+// meshquantize.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshquantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace cmod
+{
+namespace
+{
+
+// Smallest extent of the box positions are scaled to, for flat meshes
+constexpr float MinPositionScale = 1.0e-30f;
+
+std::int16_t
+packSnorm(float value)
+{
+    return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float
+unpackSnorm(std::int16_t value)
+{
+    return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+std::uint16_t
+packHalf(float value)
+{
+    return Eigen::half(value).x;
+}
+
+float
+unpackHalf(std::uint16_t value)
+{
+    return static_cast<float>(Eigen::half(Eigen::half_impl::raw_uint16_to_half(value)));
+}
+
+VertexAttributeFormat
+packedFormat(const VertexAttribute& attr)
+{
+    switch (attr.semantic)
+    {
+    case VertexAttributeSemantic::Position:
+        if (attr.format == VertexAttributeFormat::Float3)
+            return VertexAttributeFormat::Short4;
+        break;
+    case VertexAttributeSemantic::Normal:
+        if (attr.format == VertexAttributeFormat::Float3)
+            return VertexAttributeFormat::Short2;
+        break;
+    case VertexAttributeSemantic::Texture0:
+    case VertexAttributeSemantic::Texture1:
+    case VertexAttributeSemantic::Texture2:
+    case VertexAttributeSemantic::Texture3:
+        if (attr.format == VertexAttributeFormat::Float2)
+            return VertexAttributeFormat::Half2;
+        break;
+    default:
+        break;
+    }
+
+    return attr.format;
+}
+
+VertexAttributeFormat
+unpackedFormat(const VertexAttribute& attr)
+{
+    switch (attr.format)
+    {
+    case VertexAttributeFormat::Short2:
+        return attr.semantic == VertexAttributeSemantic::Normal
+            ? VertexAttributeFormat::Float3
+            : VertexAttributeFormat::Float2;
+    case VertexAttributeFormat::Short4:
+        return attr.semantic == VertexAttributeSemantic::Position
+            ? VertexAttributeFormat::Float3
+            : VertexAttributeFormat::Float4;
+    case VertexAttributeFormat::Half2:
+        return VertexAttributeFormat::Float2;
+    default:
+        return attr.format;
+    }
+}
+
+// Copy the layout of desc with the formats chosen by convert
+template<typename F>
+VertexDescription
+convertDescription(const VertexDescription& desc, F convert)
+{
+    std::vector<VertexAttribute> attributes;
+    attributes.reserve(desc.attributes.size());
+    unsigned int offset = 0;
+    for (const auto& attr : desc.attributes)
+    {
+        attributes.emplace_back(attr.semantic, convert(attr), offset);
+        offset += VertexAttribute::getFormatSizeWords(attributes.back().format);
+    }
+
+    return VertexDescription(std::move(attributes));
+}
+
+void
+packAttribute(const VertexAttribute& from, const VWord* src,
+              const VertexAttribute& to, VWord* dst,
+              const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    src += from.offsetWords;
+    dst += to.offsetWords;
+
+    std::array<float, 4> f;
+    std::memcpy(f.data(), src, VertexAttribute::getFormatSizeWords(from.format) * sizeof(VWord));
+
+    if (to.format == VertexAttributeFormat::Short4)
+    {
+        // w is 1, so shaders which read the position as a vec4 can apply
+        // the quantization with their matrices
+        Eigen::Vector3f p = (Eigen::Map<Eigen::Vector3f>(f.data()) - offset).cwiseQuotient(scale);
+        std::array<std::int16_t, 4> packed{ packSnorm(p.x()), packSnorm(p.y()), packSnorm(p.z()), 32767 };
+        std::memcpy(dst, packed.data(), sizeof(packed));
+    }
+    else if (to.format == VertexAttributeFormat::Short2)
+    {
+        std::array<std::int16_t, 2> packed = EncodeOctahedral(Eigen::Map<Eigen::Vector3f>(f.data()));
+        std::memcpy(dst, packed.data(), sizeof(packed));
+    }
+    else if (to.format == VertexAttributeFormat::Half2)
+    {
+        std::array<std::uint16_t, 2> packed{ packHalf(f[0]), packHalf(f[1]) };
+        std::memcpy(dst, packed.data(), sizeof(packed));
+    }
+    else
+    {
+        std::copy_n(src, VertexAttribute::getFormatSizeWords(from.format), dst);
+    }
+}
+
+void
+unpackAttribute(const VertexAttribute& from, const VWord* src,
+                const VertexAttribute& to, VWord* dst,
+                const Eigen::Vector3f& offset, const Eigen::Vector3f& scale)
+{
+    src += from.offsetWords;
+    dst += to.offsetWords;
+
+    std::array<float, 4> f;
+    std::array<std::int16_t, 4> packed;
+    switch (from.format)
+    {
+    case VertexAttributeFormat::Short4:
+        std::memcpy(packed.data(), src, sizeof(std::int16_t) * 4);
+        if (from.semantic == VertexAttributeSemantic::Position)
+        {
+            Eigen::Vector3f p(unpackSnorm(packed[0]), unpackSnorm(packed[1]), unpackSnorm(packed[2]));
+            Eigen::Map<Eigen::Vector3f>(f.data()) = offset + scale.cwiseProduct(p);
+        }
+        else
+        {
+            std::transform(packed.begin(), packed.end(), f.begin(), unpackSnorm);
+        }
+        break;
+    case VertexAttributeFormat::Short2:
+        std::memcpy(packed.data(), src, sizeof(std::int16_t) * 2);
+        if (from.semantic == VertexAttributeSemantic::Normal)
+        {
+            Eigen::Map<Eigen::Vector3f>(f.data()) = DecodeOctahedral({ packed[0], packed[1] });
+        }
+        else
+        {
+            f[0] = unpackSnorm(packed[0]);
+            f[1] = unpackSnorm(packed[1]);
+        }
+        break;
+    case VertexAttributeFormat::Half2:
+        {
+            std::array<std::uint16_t, 2> halves;
+            std::memcpy(halves.data(), src, sizeof(halves));
+            f[0] = unpackHalf(halves[0]);
+            f[1] = unpackHalf(halves[1]);
+        }
+        break;
+    default:
+        std::copy_n(src, VertexAttribute::getFormatSizeWords(from.format), dst);
+        return;
+    }
+
+    std::memcpy(dst, f.data(), VertexAttribute::getFormatSizeWords(to.format) * sizeof(VWord));
+}
+
+// Copy mesh with the layout of desc, converting the vertices with convert
+template<typename F>
+Mesh
+convertMesh(const Mesh& mesh, VertexDescription&& desc, F convert)
+{
+    const VertexDescription& oldDesc = mesh.getVertexDescription();
+    unsigned int oldStride = mesh.getVertexStrideWords();
+    unsigned int newStride = desc.strideBytes / sizeof(VWord);
+    unsigned int nVertices = mesh.getVertexCount();
+
+    std::vector<VWord> vertices(static_cast<std::size_t>(nVertices) * newStride);
+    const VWord* src = mesh.getVertexData();
+    VWord* dst = vertices.data();
+    for (unsigned int i = 0; i < nVertices; i++, src += oldStride, dst += newStride)
+    {
+        for (std::size_t j = 0; j < oldDesc.attributes.size(); j++)
+            convert(oldDesc.attributes[j], src, desc.attributes[j], dst);
+    }
+
+    Mesh newMesh;
+    newMesh.setVertexDescription(std::move(desc));
+    newMesh.setVertices(nVertices, std::move(vertices));
+    for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+        newMesh.addGroup(mesh.getGroup(i)->clone());
+    for (unsigned int i = 1; i < mesh.getLodCount(); i++)
+        newMesh.addLod(mesh.getLodError(i));
+    newMesh.setName(std::string(mesh.getName()));
+    return newMesh;
+}
+
+} // end unnamed namespace
+
+
+bool
+IsQuantized(const Mesh& mesh)
+{
+    const auto& attributes = mesh.getVertexDescription().attributes;
+    return std::any_of(attributes.begin(), attributes.end(),
+                       [](const VertexAttribute& attr)
+                       {
+                           return attr.format == VertexAttributeFormat::Short2 ||
+                                  attr.format == VertexAttributeFormat::Short4 ||
+                                  attr.format == VertexAttributeFormat::Half2;
+                       });
+}
+
+
+Mesh
+QuantizeMesh(const Mesh& mesh)
+{
+    const VertexDescription& desc = mesh.getVertexDescription();
+    Eigen::Vector3f offset = mesh.getPositionOffset();
+    Eigen::Vector3f scale = mesh.getPositionScale();
+    if (const auto& position = desc.getAttribute(VertexAttributeSemantic::Position);
+        position.format == VertexAttributeFormat::Float3 && mesh.getVertexCount() > 0)
+    {
+        Eigen::AlignedBox<float, 3> bbox;
+        for (unsigned int i = 0; i < mesh.getVertexCount(); i++)
+            bbox.extend(mesh.getPosition(i));
+        offset = bbox.center();
+        scale = (bbox.sizes() * 0.5f).cwiseMax(MinPositionScale);
+    }
+
+    Mesh newMesh = convertMesh(mesh, convertDescription(desc, packedFormat),
+                               [&offset, &scale](const VertexAttribute& from, const VWord* src,
+                                                 const VertexAttribute& to, VWord* dst)
+                               {
+                                   packAttribute(from, src, to, dst, offset, scale);
+                               });
+    newMesh.setPositionQuantization(offset, scale);
+    return newMesh;
+}
+
+
+Mesh
+DequantizeMesh(const Mesh& mesh)
+{
+    const Eigen::Vector3f& offset = mesh.getPositionOffset();
+    const Eigen::Vector3f& scale = mesh.getPositionScale();
+    return convertMesh(mesh, convertDescription(mesh.getVertexDescription(), unpackedFormat),
+                       [&offset, &scale](const VertexAttribute& from, const VWord* src,
+                                         const VertexAttribute& to, VWord* dst)
+                       {
+                           unpackAttribute(from, src, to, dst, offset, scale);
+                       });
+}
+
+
+std::array<std::int16_t, 2>
+EncodeOctahedral(const Eigen::Vector3f& normal)
+{
+    float l1 = normal.cwiseAbs().sum();
+    if (l1 == 0.0f)
+        return { 0, 32767 };
+
+    Eigen::Vector2f p = normal.head<2>() / l1;
+    if (normal.z() < 0.0f)
+    {
+        p = Eigen::Vector2f((1.0f - std::abs(p.y())) * std::copysign(1.0f, p.x()),
+                            (1.0f - std::abs(p.x())) * std::copysign(1.0f, p.y()));
+    }
+
+    return { packSnorm(p.x()), packSnorm(p.y()) };
+}
+
+
+Eigen::Vector3f
+DecodeOctahedral(const std::array<std::int16_t, 2>& packed)
+{
+    Eigen::Vector3f n(unpackSnorm(packed[0]), unpackSnorm(packed[1]), 0.0f);
+    n.z() = 1.0f - std::abs(n.x()) - std::abs(n.y());
+    float t = std::max(-n.z(), 0.0f);
+    n.x() += n.x() >= 0.0f ? -t : t;
+    n.y() += n.y() >= 0.0f ? -t : t;
+    return n.normalized();
+}
+
+} // end namespace cmod
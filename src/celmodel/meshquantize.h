@@ -0,0 +1,43 @@
+// meshquantize.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+// True if the mesh has attributes in one of the 16-bit formats
+bool IsQuantized(const Mesh& mesh);
+
+/*! Return a copy of the mesh with its attributes packed into 16-bit
+ *  formats: Float3 positions into Short4 scaled to the bounding box of
+ *  the mesh, Float3 normals into octahedral Short2 and Float2 texture
+ *  coordinates into Half2. Other attributes are copied unchanged.
+ */
+Mesh QuantizeMesh(const Mesh& mesh);
+
+/*! Return a copy of the mesh with the 16-bit attributes expanded back to
+ *  floats, for code which only handles float attributes.
+ */
+Mesh DequantizeMesh(const Mesh& mesh);
+
+// Octahedral encoding of a unit vector, see Cigolle et al., "A Survey of
+// Efficient Representations for Independent Unit Vectors" (2014)
+std::array<std::int16_t, 2> EncodeOctahedral(const Eigen::Vector3f& normal);
+Eigen::Vector3f DecodeOctahedral(const std::array<std::int16_t, 2>& packed);
+
+} // end namespace cmod
@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <numeric>
 #include <utility>
@@ -338,34 +339,43 @@ Model::sortMeshes(const MeshComparator& comparator)
     // Sort the meshes so that completely opaque ones are first
     std::sort(meshes.begin(), meshes.end(), std::ref(comparator));
 
+    // Opaque meshes with the same vertex layout share their buffers, so
+    // that their groups with the same material can be drawn at once
     std::vector<Mesh> newMeshes;
+    std::vector<bool> merged;
     for (const auto &mesh : meshes)
     {
         if (mesh.getGroupCount() == 0)
             continue;
 
-        if (newMeshes.empty())
+        if (newMeshes.empty() || !newMeshes.back().canMerge(mesh, materials))
         {
             newMeshes.push_back(mesh.clone());
+            merged.push_back(false);
             continue;
         }
 
-        auto &p = newMeshes.back();
-        if (!p.canMerge(mesh, materials))
-        {
-            newMeshes.push_back(mesh.clone());
-            continue;
-        }
-        p.merge(mesh);
+        newMeshes.back().merge(mesh);
+        merged.back() = true;
     }
     GetLogger()->info("Merged similar meshes: {} -> {}.\n", meshes.size(), newMeshes.size());
 
-    for (auto &mesh : newMeshes)
+    for (std::size_t i = 0; i < newMeshes.size(); ++i)
     {
-        mesh.optimize();
+        auto &mesh = newMeshes[i];
+        if (merged[i])
+            mesh.aggregateByMaterial();
         mesh.rebuildIndexMetadata();
     }
     meshes = std::move(newMeshes);
 }
 
+
+void
+Model::optimizeMeshes()
+{
+    for (auto& mesh : meshes)
+        mesh.optimize();
+}
+
 } // end namespace cmod
@@ -130,6 +130,11 @@ class Model
     /*! Sort the model's meshes in place. */
     void sortMeshes(const MeshComparator&);
 
+    /*! Reorder the triangles and vertices of all meshes for the vertex
+     *  cache, see Mesh::optimize()
+     */
+    void optimizeMeshes();
+
     /*! Optimize the model by eliminating all duplicated materials */
     void uniquifyMaterials();
 
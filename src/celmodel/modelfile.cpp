@@ -17,6 +17,7 @@
 #include <ostream>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 
 #include <fmt/format.h>
@@ -27,6 +28,7 @@
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
 #include "mesh.h"
+#include "meshquantize.h"
 #include "model.h"
 #include "modelfile.h"
 
@@ -41,7 +43,12 @@ namespace
 {
 constexpr std::string_view CEL_MODEL_HEADER_ASCII = "#celmodel__ascii"sv;
 constexpr std::string_view CEL_MODEL_HEADER_BINARY = "#celmodel_binary"sv;
+// Version 2 of the binary format adds the 16-bit vertex attribute formats,
+// the position quantization of meshes, 16-bit indices for meshes of at
+// most 65536 vertices, and levels of detail
+constexpr std::string_view CEL_MODEL_HEADER_BINARY_V2 = "#celmodel_bin_v2"sv;
 static_assert(CEL_MODEL_HEADER_ASCII.size() == CEL_MODEL_HEADER_BINARY.size());
+static_assert(CEL_MODEL_HEADER_BINARY_V2.size() == CEL_MODEL_HEADER_BINARY.size());
 constexpr std::size_t CEL_MODEL_HEADER_LENGTH = CEL_MODEL_HEADER_ASCII.size();
 
 // Material default values
@@ -58,6 +65,7 @@ constexpr std::string_view EndMeshToken = "end_mesh"sv;
 constexpr std::string_view VertexDescToken = "vertexdesc"sv;
 constexpr std::string_view EndVertexDescToken = "end_vertexdesc"sv;
 constexpr std::string_view VerticesToken = "vertices"sv;
+constexpr std::string_view LodToken = "lod"sv;
 constexpr std::string_view MaterialToken = "material"sv;
 constexpr std::string_view EndMaterialToken = "end_material"sv;
 
@@ -78,8 +86,16 @@ enum class CmodToken
     Vertices      = 1013,
     Emissive      = 1014,
     Blend         = 1015,
+    PositionQuantization = 1016,
+    LevelOfDetail = 1017,
 };
 
+// Formats which a version 1 binary file can contain
+constexpr auto V1FormatMax = VertexAttributeFormat::Short2;
+
+// Meshes with at most this many vertices store 16-bit indices in version 2
+constexpr std::uint32_t MaxShortIndexVertices = 65536;
+
 enum class CmodType
 {
     Float1         = 1,
@@ -687,12 +703,26 @@ AsciiModelLoader::loadMesh(Mesh& mesh)
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
+    // Groups after a lod line belong to the next level of detail
+    unsigned int lod = 0;
     for (;;)
     {
         tok.nextToken();
         PrimitiveGroupType type;
         if (auto tokenValue = tok.getNameValue();
-            tokenValue.has_value() && *tokenValue != EndMeshToken)
+            tokenValue.has_value() && *tokenValue == LodToken)
+        {
+            tok.nextToken();
+            if (auto error = tok.getNumberValue(); error.has_value() && *error >= 0.0)
+            {
+                lod = mesh.addLod(static_cast<float>(*error));
+                continue;
+            }
+
+            reportError("Bad level of detail error");
+            return false;
+        }
+        else if (tokenValue.has_value() && *tokenValue != EndMeshToken)
         {
             type = parsePrimitiveGroupType(*tokenValue);
             if (type == PrimitiveGroupType::InvalidPrimitiveGroupType)
@@ -762,7 +792,7 @@ AsciiModelLoader::loadMesh(Mesh& mesh)
             indices.push_back(index);
         }
 
-        mesh.addGroup(type, materialIndex, std::move(indices));
+        mesh.addGroup(type, materialIndex, std::move(indices), lod);
     }
 
     return true;
@@ -934,8 +964,14 @@ AsciiModelWriter::writeGroup(const PrimitiveGroup& group)
 
 
 bool
-AsciiModelWriter::writeMesh(const Mesh& mesh)
+AsciiModelWriter::writeMesh(const Mesh& packedMesh)
 {
+    // The ASCII format only has float attributes
+    std::optional<Mesh> unpackedMesh;
+    if (IsQuantized(packedMesh))
+        unpackedMesh = DequantizeMesh(packedMesh);
+    const Mesh& mesh = unpackedMesh.has_value() ? *unpackedMesh : packedMesh;
+
     fmt::print(*out, "mesh\n");
     if (!out->good()) { return false; }
 
@@ -961,11 +997,23 @@ AsciiModelWriter::writeMesh(const Mesh& mesh)
     fmt::print(*out, "\n");
     if (!out->good()) { return false; }
 
-    for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
+    for (unsigned int lod = 0; lod < mesh.getLodCount(); lod++)
     {
-        if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
-        fmt::print(*out, "\n");
-        if (!out->good()) { return false; }
+        if (lod > 0)
+        {
+            fmt::print(*out, "lod {}\n\n", mesh.getLodError(lod));
+            if (!out->good()) { return false; }
+        }
+
+        for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
+        {
+            if (mesh.getGroup(groupIndex)->lod != lod)
+                continue;
+
+            if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
+            fmt::print(*out, "\n");
+            if (!out->good()) { return false; }
+        }
     }
 
     fmt::print(*out, "end_mesh\n");
@@ -1232,6 +1280,35 @@ AsciiModelWriter::writeMaterial(const Material& material)
 
 /***** Binary loader *****/
 
+#ifndef WORDS_BIGENDIAN
+// The file stores the attributes of a vertex in the order of the vertex
+// description, without padding, as little-endian floats and UByte4 words
+// in memory order. When the description lays them out the same way in
+// memory the vertex data can be read unchanged.
+bool
+hasFileLayout(const VertexDescription& desc)
+{
+    unsigned int offset = 0;
+    for (const auto& attr : desc.attributes)
+    {
+        if (attr.offsetWords != offset || attr.format >= VertexAttributeFormat::FormatMax)
+            return false;
+        offset += VertexAttribute::getFormatSizeWords(attr.format);
+    }
+
+    return offset * sizeof(VWord) == desc.strideBytes;
+}
+#endif
+
+// Read count values of a trivially copyable type with a single read
+template<typename T>
+bool
+readBulk(std::istream& in, T* values, std::size_t count)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    return in.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(count * sizeof(T))).good();
+}
+
 bool readToken(std::istream& in, CmodToken& value)
 {
     std::int16_t num;
@@ -1348,9 +1425,10 @@ bool ignoreValue(std::istream& in)
 class BinaryModelLoader : public ModelLoader
 {
 public:
-    BinaryModelLoader(std::istream* _in, HandleGetter&& _handleGetter) :
+    BinaryModelLoader(std::istream* _in, HandleGetter&& _handleGetter, int _version) :
         ModelLoader(std::move(_handleGetter)),
-        in(_in)
+        in(_in),
+        version(_version)
     {}
     ~BinaryModelLoader() override = default;
 
@@ -1367,8 +1445,12 @@ private:
                                     unsigned int& vertexCount);
     bool loadAttribute(const VertexAttribute& attr,
                        cmod::VWord* destination);
+    bool loadIndices(std::vector<Index32>& indices,
+                     std::uint32_t indexCount,
+                     unsigned int vertexCount);
 
     std::istream* in;
+    int version;
 };
 
 
@@ -1435,7 +1517,7 @@ BinaryModelLoader::load()
             util::GetLogger()->info("has tangents: {}\n", hasTangents(mesh));
 
             if (hasNormalMap && !hasTangents(mesh))
-                model->addMesh(GenerateTangents(mesh));
+                model->addMesh(GenerateTangents(IsQuantized(mesh) ? DequantizeMesh(mesh) : std::move(mesh)));
             else
                 model->addMesh(std::move(mesh));
         }
@@ -1596,8 +1678,9 @@ BinaryModelLoader::loadVertexDescription()
         if (tok >= 0 && tok < static_cast<std::int16_t>(VertexAttributeSemantic::SemanticMax))
         {
             std::int16_t vfmt;
+            auto formatMax = version >= 2 ? VertexAttributeFormat::FormatMax : V1FormatMax;
             if (!util::readLE<std::int16_t>(*in, vfmt)
-                || vfmt < 0 || vfmt >= static_cast<std::int16_t>(VertexAttributeFormat::FormatMax))
+                || vfmt < 0 || vfmt >= static_cast<std::int16_t>(formatMax))
             {
                 reportError("Invalid vertex attribute type");
                 return {};
@@ -1639,6 +1722,39 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
     VertexDescription vertexDesc = loadVertexDescription();
     if (vertexDesc.attributes.empty()) { return false; }
 
+    CmodToken tok;
+    if (!readToken(*in, tok))
+    {
+        reportError("Vertex data expected");
+        return false;
+    }
+
+    if (version >= 2 && tok == CmodToken::PositionQuantization)
+    {
+        std::array<float, 6> q;
+        for (float& f : q)
+        {
+            if (!util::readLE<float>(*in, f))
+            {
+                reportError("Failed to read position quantization");
+                return false;
+            }
+        }
+
+        mesh.setPositionQuantization(Eigen::Vector3f(q[0], q[1], q[2]), Eigen::Vector3f(q[3], q[4], q[5]));
+        if (!readToken(*in, tok))
+        {
+            reportError("Vertex data expected");
+            return false;
+        }
+    }
+
+    if (tok != CmodToken::Vertices)
+    {
+        reportError("Vertex data expected");
+        return false;
+    }
+
     unsigned int vertexCount = 0;
     std::vector<VWord> vertexData = loadVertices(vertexDesc, vertexCount);
     if (vertexData.empty()) { return false; }
@@ -1646,6 +1762,8 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
+    // Groups after a level of detail token belong to the next level
+    unsigned int lod = 0;
     for (;;)
     {
         std::int16_t tok;
@@ -1659,6 +1777,18 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
         {
             break;
         }
+        if (version >= 2 && tok == static_cast<std::int16_t>(CmodToken::LevelOfDetail))
+        {
+            float error;
+            if (!util::readLE<float>(*in, error) || !(error >= 0.0f))
+            {
+                reportError("Bad level of detail error");
+                return false;
+            }
+
+            lod = mesh.addLod(error);
+            continue;
+        }
         if (tok < 0 || tok >= static_cast<std::int16_t>(PrimitiveGroupType::PrimitiveTypeMax))
         {
             reportError("Bad primitive group type");
@@ -1675,24 +1805,65 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
         }
 
         std::vector<Index32> indices;
-        indices.reserve(indexCount);
+        if (!loadIndices(indices, indexCount, vertexCount))
+        {
+            reportError("Index out of range");
+            return false;
+        }
 
-        for (unsigned int i = 0; i < indexCount; i++)
+        mesh.addGroup(type, materialIndex, std::move(indices), lod);
+    }
+
+    return true;
+}
+
+
+bool
+BinaryModelLoader::loadIndices(std::vector<Index32>& indices,
+                               std::uint32_t indexCount,
+                               unsigned int vertexCount)
+{
+    auto inRange = [vertexCount](Index32 index) { return index < vertexCount; };
+
+    if (version >= 2 && vertexCount <= MaxShortIndexVertices)
+    {
+        std::vector<std::uint16_t> shortIndices;
+#ifndef WORDS_BIGENDIAN
+        shortIndices.resize(indexCount);
+        if (!readBulk(*in, shortIndices.data(), shortIndices.size()))
+            return false;
+#else
+        shortIndices.reserve(indexCount);
+        for (std::uint32_t i = 0; i < indexCount; i++)
         {
-            std::uint32_t index;
-            if (!util::readLE<std::uint32_t>(*in, index) || index >= vertexCount)
-            {
-                reportError("Index out of range");
+            std::uint16_t index;
+            if (!util::readLE<std::uint16_t>(*in, index))
                 return false;
-            }
-
-            indices.push_back(index);
+            shortIndices.push_back(index);
         }
+#endif
+        indices.assign(shortIndices.begin(), shortIndices.end());
+        return std::all_of(indices.cbegin(), indices.cend(), inRange);
+    }
+
+#ifndef WORDS_BIGENDIAN
+    indices.resize(indexCount);
+    return readBulk(*in, indices.data(), indices.size())
+        && std::all_of(indices.cbegin(), indices.cend(), inRange);
+#else
+    indices.reserve(indexCount);
 
-        mesh.addGroup(type, materialIndex, std::move(indices));
+    for (std::uint32_t i = 0; i < indexCount; i++)
+    {
+        std::uint32_t index;
+        if (!util::readLE<std::uint32_t>(*in, index) || !inRange(index))
+            return false;
+
+        indices.push_back(index);
     }
 
     return true;
+#endif
 }
 
 
@@ -1700,12 +1871,6 @@ std::vector<VWord>
 BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
                                 unsigned int& vertexCount)
 {
-    if (CmodToken tok; !readToken(*in, tok) || tok != CmodToken::Vertices)
-    {
-        reportError("Vertex data expected");
-        return {};
-    }
-
     if (!util::readLE<std::uint32_t>(*in, vertexCount))
     {
         reportError("Vertex count expected");
@@ -1716,6 +1881,20 @@ BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
     unsigned int vertexDataSize = stride * vertexCount;
     std::vector<VWord> vertexData(vertexDataSize);
 
+#ifndef WORDS_BIGENDIAN
+    if (hasFileLayout(vertexDesc))
+    {
+        if (!readBulk(*in, vertexData.data(), vertexData.size()))
+        {
+            reportError("Failed to load vertex attribute");
+            return {};
+        }
+
+        return vertexData;
+    }
+#endif
+
+    // Convert the attributes one by one
     unsigned int offset = 0;
     for (unsigned int i = 0; i < vertexCount; i++, offset += stride)
     {
@@ -1744,6 +1923,22 @@ BinaryModelLoader::loadAttribute(const VertexAttribute& attr,
         return util::readNative<std::uint32_t>(*in, *destination);
     }
 
+    if (attr.format == VertexAttributeFormat::Short2
+        || attr.format == VertexAttributeFormat::Short4
+        || attr.format == VertexAttributeFormat::Half2)
+    {
+        // Pairs of 16-bit values, the halves are read as their bits
+        std::array<std::int16_t, 4> s;
+        std::size_t shortCount = VertexAttribute::getFormatSizeWords(attr.format) * 2;
+        for (std::size_t i = 0; i < shortCount; ++i)
+        {
+            if (!util::readLE<std::int16_t>(*in, s[i])) { return false; }
+        }
+
+        std::memcpy(destination, s.data(), sizeof(std::int16_t) * shortCount);
+        return true;
+    }
+
     std::array<float, 4> f;
     std::size_t readCount;
     switch (attr.format)
@@ -1826,7 +2021,7 @@ public:
 private:
     bool writeMesh(const Mesh& /*mesh*/);
     bool writeMaterial(const Material& /*material*/);
-    bool writeGroup(const PrimitiveGroup& /*group*/);
+    bool writeGroup(const PrimitiveGroup& /*group*/, unsigned int /*vertexCount*/);
     bool writeVertexDescription(const VertexDescription& /*desc*/);
     bool writeVertices(const VWord* vertexData,
                        unsigned int nVertices,
@@ -1834,13 +2029,24 @@ private:
                        const VertexDescription& desc);
 
     std::ostream* out;
+    int version{ 1 };
 };
 
 
 bool
 BinaryModelWriter::write(const Model& model)
 {
-    if (!out->write(CEL_MODEL_HEADER_BINARY.data(), CEL_MODEL_HEADER_BINARY.size()).good())
+    // Only models with packed meshes or levels of detail need version 2
+    version = 1;
+    for (unsigned int meshIndex = 0; model.getMesh(meshIndex) != nullptr; meshIndex++)
+    {
+        const Mesh& mesh = *model.getMesh(meshIndex);
+        if (IsQuantized(mesh) || mesh.getLodCount() > 1)
+            version = 2;
+    }
+
+    std::string_view header = version >= 2 ? CEL_MODEL_HEADER_BINARY_V2 : CEL_MODEL_HEADER_BINARY;
+    if (!out->write(header.data(), header.size()).good())
         return false;
 
     for (unsigned int matIndex = 0; model.getMaterial(matIndex) != nullptr; matIndex++)
@@ -1858,7 +2064,7 @@ BinaryModelWriter::write(const Model& model)
 
 
 bool
-BinaryModelWriter::writeGroup(const PrimitiveGroup& group)
+BinaryModelWriter::writeGroup(const PrimitiveGroup& group, unsigned int vertexCount)
 {
     if (!util::writeLE<std::int16_t>(*out, static_cast<std::int16_t>(group.prim))
         || !util::writeLE<std::uint32_t>(*out, group.materialIndex)
@@ -1867,6 +2073,16 @@ BinaryModelWriter::writeGroup(const PrimitiveGroup& group)
         return false;
     }
 
+    if (version >= 2 && vertexCount <= MaxShortIndexVertices)
+    {
+        for (auto index : group.indices)
+        {
+            if (!util::writeLE<std::uint16_t>(*out, static_cast<std::uint16_t>(index))) { return false; }
+        }
+
+        return true;
+    }
+
     for (auto index : group.indices)
     {
         if (!util::writeLE<std::uint32_t>(*out, index)) { return false; }
@@ -1880,8 +2096,29 @@ bool
 BinaryModelWriter::writeMesh(const Mesh& mesh)
 {
     if (!writeToken(*out, CmodToken::Mesh)
-        || !writeVertexDescription(mesh.getVertexDescription())
-        || !writeVertices(mesh.getVertexData(),
+        || !writeVertexDescription(mesh.getVertexDescription()))
+    {
+        return false;
+    }
+
+    if (mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position).format
+        == VertexAttributeFormat::Short4)
+    {
+        const Eigen::Vector3f& offset = mesh.getPositionOffset();
+        const Eigen::Vector3f& scale = mesh.getPositionScale();
+        if (!writeToken(*out, CmodToken::PositionQuantization)
+            || !util::writeLE<float>(*out, offset.x())
+            || !util::writeLE<float>(*out, offset.y())
+            || !util::writeLE<float>(*out, offset.z())
+            || !util::writeLE<float>(*out, scale.x())
+            || !util::writeLE<float>(*out, scale.y())
+            || !util::writeLE<float>(*out, scale.z()))
+        {
+            return false;
+        }
+    }
+
+    if (!writeVertices(mesh.getVertexData(),
                           mesh.getVertexCount(),
                           mesh.getVertexStrideWords(),
                           mesh.getVertexDescription()))
@@ -1889,9 +2126,20 @@ BinaryModelWriter::writeMesh(const Mesh& mesh)
         return false;
     }
 
-    for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
+    for (unsigned int lod = 0; lod < mesh.getLodCount(); lod++)
     {
-        if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
+        if (lod > 0
+            && (!writeToken(*out, CmodToken::LevelOfDetail)
+                || !util::writeLE<float>(*out, mesh.getLodError(lod))))
+        {
+            return false;
+        }
+
+        for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
+        {
+            const PrimitiveGroup& group = *mesh.getGroup(groupIndex);
+            if (group.lod == lod && !writeGroup(group, mesh.getVertexCount())) { return false; }
+        }
     }
 
     return writeToken(*out, CmodToken::EndMesh);
@@ -1944,6 +2192,18 @@ BinaryModelWriter::writeVertices(const VWord* vertexData,
             case VertexAttributeFormat::UByte4:
                 result = util::writeNative<std::uint32_t>(*out, *cdata);
                 break;
+            case VertexAttributeFormat::Short2:
+            case VertexAttributeFormat::Short4:
+            case VertexAttributeFormat::Half2:
+                {
+                    std::array<std::int16_t, 4> sdata;
+                    std::size_t shortCount = VertexAttribute::getFormatSizeWords(attr.format) * 2;
+                    std::memcpy(sdata.data(), cdata, sizeof(std::int16_t) * shortCount);
+                    result = true;
+                    for (std::size_t j = 0; j < shortCount && result; ++j)
+                        result = util::writeLE<std::int16_t>(*out, sdata[j]);
+                }
+                break;
             default:
                 assert(0);
                 result = false;
@@ -2054,7 +2314,11 @@ openModel(std::istream& in, HandleGetter&& getHandle)
     }
     if (headerType == CEL_MODEL_HEADER_BINARY)
     {
-        return std::make_unique<BinaryModelLoader>(&in, std::move(getHandle));
+        return std::make_unique<BinaryModelLoader>(&in, std::move(getHandle), 1);
+    }
+    if (headerType == CEL_MODEL_HEADER_BINARY_V2)
+    {
+        return std::make_unique<BinaryModelLoader>(&in, std::move(getHandle), 2);
     }
     else
     {
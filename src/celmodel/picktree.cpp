@@ -0,0 +1,281 @@
+// picktree.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "picktree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr unsigned int NBins = 12;
+
+// Leaves are only split while the split saves triangle tests, up to this
+// number of triangles
+constexpr std::uint32_t MaxLeafTriangles = 8;
+
+// Cost of testing a node's box relative to testing a triangle
+constexpr float TraversalCost = 1.0f;
+
+float
+surfaceArea(const Eigen::AlignedBox<float, 3>& box)
+{
+    Eigen::Vector3f d = box.sizes();
+    return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+
+// Distance along the ray at which it enters the box, or infinity if it
+// misses it before maxDistance
+double
+enterBox(const Eigen::Vector3f& lower,
+         const Eigen::Vector3f& upper,
+         const Eigen::Vector3d& origin,
+         const Eigen::Vector3d& inverseDirection,
+         double maxDistance)
+{
+    Eigen::Vector3d t0 = (lower.cast<double>() - origin).cwiseProduct(inverseDirection);
+    Eigen::Vector3d t1 = (upper.cast<double>() - origin).cwiseProduct(inverseDirection);
+    double tEnter = std::max(t0.cwiseMin(t1).maxCoeff(), 0.0);
+    double tExit = std::min(t0.cwiseMax(t1).minCoeff(), maxDistance);
+    return tEnter <= tExit ? tEnter : std::numeric_limits<double>::infinity();
+}
+
+
+// Moller-Trumbore intersection, true if the ray hits the triangle at a
+// distance in (0, distance)
+bool
+hitTriangle(const Eigen::Vector3d& v0,
+            const Eigen::Vector3d& v1,
+            const Eigen::Vector3d& v2,
+            const Eigen::Vector3d& origin,
+            const Eigen::Vector3d& direction,
+            double& distance)
+{
+    Eigen::Vector3d e0 = v1 - v0;
+    Eigen::Vector3d e1 = v2 - v0;
+    Eigen::Vector3d p = direction.cross(e1);
+
+    // A ray in the plane of the triangle is a miss
+    double det = e0.dot(p);
+    if (det == 0.0)
+        return false;
+
+    double invDet = 1.0 / det;
+    Eigen::Vector3d s = origin - v0;
+    double u = s.dot(p) * invDet;
+    if (u < 0.0 || u > 1.0)
+        return false;
+
+    Eigen::Vector3d q = s.cross(e0);
+    double v = direction.dot(q) * invDet;
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+
+    double t = e1.dot(q) * invDet;
+    if (!(t > 0.0 && t < distance))
+        return false;
+
+    distance = t;
+    return true;
+}
+
+} // end unnamed namespace
+
+
+PickTree::PickTree(std::vector<Eigen::Vector3f>&& _positions, std::vector<Triangle>&& _triangles) :
+    positions(std::move(_positions)),
+    triangles(std::move(_triangles))
+{
+    if (triangles.empty())
+        return;
+
+    std::vector<Eigen::Vector3f> centroids;
+    centroids.reserve(triangles.size());
+    for (const Triangle& triangle : triangles)
+    {
+        centroids.push_back((positions[triangle.vertices[0]] +
+                             positions[triangle.vertices[1]] +
+                             positions[triangle.vertices[2]]) / 3.0f);
+    }
+
+    nodes.reserve(2 * triangles.size() / MaxLeafTriangles + 1);
+    build(0, static_cast<std::uint32_t>(triangles.size()), centroids);
+}
+
+
+void
+PickTree::build(std::uint32_t first, std::uint32_t count, std::vector<Eigen::Vector3f>& centroids)
+{
+    auto index = static_cast<std::uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    Eigen::AlignedBox<float, 3> bounds;
+    Eigen::AlignedBox<float, 3> centroidBounds;
+    for (std::uint32_t i = first; i < first + count; ++i)
+    {
+        for (std::uint32_t vertex : triangles[i].vertices)
+            bounds.extend(positions[vertex]);
+        centroidBounds.extend(centroids[i]);
+    }
+
+    nodes[index].lower = bounds.min();
+    nodes[index].upper = bounds.max();
+    nodes[index].offset = first;
+    nodes[index].count = count;
+
+    // Split along the axis where the centroids spread most
+    Eigen::Vector3f::Index axis;
+    float extent = centroidBounds.sizes().maxCoeff(&axis);
+    if (count == 1 || !(extent > 0.0f))
+        return;
+
+    float centroidLower = centroidBounds.min()[axis];
+    auto binOf = [&](const Eigen::Vector3f& centroid)
+    {
+        auto bin = static_cast<unsigned int>((centroid[axis] - centroidLower) * (NBins / extent));
+        return std::min(bin, NBins - 1);
+    };
+
+    std::array<Eigen::AlignedBox<float, 3>, NBins> binBounds;
+    std::array<std::uint32_t, NBins> binCounts{};
+    for (std::uint32_t i = first; i < first + count; ++i)
+    {
+        unsigned int bin = binOf(centroids[i]);
+        for (std::uint32_t vertex : triangles[i].vertices)
+            binBounds[bin].extend(positions[vertex]);
+        ++binCounts[bin];
+    }
+
+    // Areas of the triangles of the bins below each split
+    std::array<float, NBins - 1> lowerCosts;
+    Eigen::AlignedBox<float, 3> lowerBounds;
+    std::uint32_t lowerCount = 0;
+    for (unsigned int split = 0; split < NBins - 1; ++split)
+    {
+        lowerBounds.extend(binBounds[split]);
+        lowerCount += binCounts[split];
+        lowerCosts[split] = lowerCount == 0 ? 0.0f : static_cast<float>(lowerCount) * surfaceArea(lowerBounds);
+    }
+
+    float bestCost = std::numeric_limits<float>::infinity();
+    unsigned int bestSplit = 0;
+    Eigen::AlignedBox<float, 3> upperBounds;
+    std::uint32_t upperCount = 0;
+    for (unsigned int split = NBins - 1; split > 0; --split)
+    {
+        upperBounds.extend(binBounds[split]);
+        upperCount += binCounts[split];
+        if (upperCount == 0 || upperCount == count)
+            continue;
+
+        float cost = lowerCosts[split - 1] + static_cast<float>(upperCount) * surfaceArea(upperBounds);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestSplit = split;
+        }
+    }
+
+    float area = surfaceArea(bounds);
+    bestCost = area > 0.0f ? TraversalCost + bestCost / area : 0.0f;
+    if (bestSplit == 0 || (count <= MaxLeafTriangles && bestCost >= static_cast<float>(count)))
+        return;
+
+    // Move the triangles below the split to the front
+    std::uint32_t middle = first;
+    for (std::uint32_t i = first; i < first + count; ++i)
+    {
+        if (binOf(centroids[i]) < bestSplit)
+        {
+            std::swap(triangles[i], triangles[middle]);
+            std::swap(centroids[i], centroids[middle]);
+            ++middle;
+        }
+    }
+
+    nodes[index].count = 0;
+    build(first, middle - first, centroids);
+    nodes[index].offset = static_cast<std::uint32_t>(nodes.size());
+    build(middle, first + count - middle, centroids);
+}
+
+
+const PickTree::Triangle*
+PickTree::pick(const Eigen::Vector3d& origin,
+               const Eigen::Vector3d& direction,
+               double& distance) const
+{
+    if (nodes.empty())
+        return nullptr;
+
+    Eigen::Vector3d inverseDirection = direction.cwiseInverse();
+    const Triangle* hit = nullptr;
+
+    // Nodes to visit with the distances at which the ray enters them
+    std::vector<std::pair<std::uint32_t, double>> stack;
+    double rootDistance = enterBox(nodes[0].lower, nodes[0].upper, origin, inverseDirection, distance);
+    if (std::isinf(rootDistance))
+        return nullptr;
+    stack.emplace_back(0, rootDistance);
+
+    while (!stack.empty())
+    {
+        auto [index, enterDistance] = stack.back();
+        stack.pop_back();
+
+        // Skip the nodes behind the nearest hit found since they were pushed
+        if (enterDistance > distance)
+            continue;
+
+        const Node& node = nodes[index];
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                const Triangle& triangle = triangles[i];
+                if (hitTriangle(positions[triangle.vertices[0]].cast<double>(),
+                                positions[triangle.vertices[1]].cast<double>(),
+                                positions[triangle.vertices[2]].cast<double>(),
+                                origin, direction, distance))
+                {
+                    hit = &triangle;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        std::uint32_t children[2] = { index + 1, node.offset };
+        double distances[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const Node& child = nodes[children[i]];
+            distances[i] = enterBox(child.lower, child.upper, origin, inverseDirection, distance);
+        }
+
+        int nearer = distances[1] < distances[0] ? 1 : 0;
+        if (!std::isinf(distances[1 - nearer]))
+            stack.emplace_back(children[1 - nearer], distances[1 - nearer]);
+        if (!std::isinf(distances[nearer]))
+            stack.emplace_back(children[nearer], distances[nearer]);
+    }
+
+    return hit;
+}
+
+} // namespace cmod
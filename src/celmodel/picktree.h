@@ -0,0 +1,70 @@
+// picktree.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+
+namespace cmod
+{
+
+/*! Bounding volume hierarchy of the triangles of a mesh, used to find the
+ *  triangle hit by a ray without testing all of them. The tree is built
+ *  once with the surface area heuristic, evaluated over bins of the
+ *  triangle centroids, and stored depth first: the first child of a node
+ *  follows it and the node holds the index of the second one.
+ */
+class PickTree
+{
+ public:
+    struct Triangle
+    {
+        std::array<std::uint32_t, 3> vertices;
+        // Group and index of the primitive in the group it comes from
+        std::uint32_t group;
+        std::uint32_t primitive;
+    };
+
+    PickTree(std::vector<Eigen::Vector3f>&& positions, std::vector<Triangle>&& triangles);
+
+    /*! Return the nearest triangle hit by the ray at a distance in
+     *  (0, distance), in units of the direction, and set distance to the
+     *  distance of the hit. Return nullptr if none is hit.
+     */
+    const Triangle* pick(const Eigen::Vector3d& origin,
+                         const Eigen::Vector3d& direction,
+                         double& distance) const;
+
+    std::size_t getNodeCount() const { return nodes.size(); }
+
+ private:
+    struct Node
+    {
+        Eigen::Vector3f lower;
+        Eigen::Vector3f upper;
+        // First triangle of a leaf, second child of an inner node
+        std::uint32_t offset;
+        // Triangles of a leaf, 0 for inner nodes
+        std::uint32_t count;
+    };
+
+    void build(std::uint32_t first, std::uint32_t count, std::vector<Eigen::Vector3f>& centroids);
+
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+} // namespace cmod
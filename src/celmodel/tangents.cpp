@@ -369,10 +369,14 @@ GenerateTangents(const Mesh& mesh)
 
         newMesh.addGroup(PrimitiveGroupType::TriList,
                          mesh.getGroup(groupIndex)->materialIndex,
-                         std::move(indices));
+                         std::move(indices),
+                         mesh.getGroup(groupIndex)->lod);
         firstIndex += faceCount * 3;
     }
 
+    for (std::uint32_t level = 1; level < mesh.getLodCount(); level++)
+        newMesh.addLod(mesh.getLodError(level));
+
     return newMesh;
 }
 
@@ -9,10 +9,14 @@
 
 #include "asterismrenderer.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 
+#include <Eigen/Geometry>
+
 #include <celengine/glsupport.h>
+#include <celmath/frustum.h>
 #include <celutil/color.h>
 
 namespace celestia::render
@@ -31,7 +35,10 @@ bool AsterismRenderer::sameAsterisms(const AsterismList *asterisms) const
 
 /*! Draw visible asterisms.
  */
-void AsterismRenderer::render(const Color &defaultColor, const Matrices &mvp)
+void AsterismRenderer::render(const Color &defaultColor,
+                              const Matrices &mvp,
+                              const math::Frustum &frustum,
+                              const Eigen::Vector3f &observerPos)
 {
     if (!m_initialized)
     {
@@ -39,16 +46,33 @@ void AsterismRenderer::render(const Color &defaultColor, const Matrices &mvp)
         m_initialized = true;
     }
 
-    m_lineRenderer.render(mvp, defaultColor, m_totalLineCount * 2);
-
     assert(m_asterisms->size() == m_lineCount.size());
 
+    // Draw the lines of consecutive visible asterisms at once, asterisms
+    // with an override color are drawn again over them
     int offset = 0;
+    int first = 0;
+    for (std::size_t size = m_asterisms->size(), i = 0; i < size; i++)
+    {
+        const auto& bounds = m_bounds[i];
+        m_visible[i] = frustum.testSphere(bounds.center - observerPos, bounds.radius) != math::Frustum::Outside;
+        if (!m_visible[i])
+        {
+            if (offset > first)
+                m_lineRenderer.render(mvp, defaultColor, (offset - first) * 2, first * 2);
+            first = offset + m_lineCount[i];
+        }
+        offset += m_lineCount[i];
+    }
+    if (offset > first)
+        m_lineRenderer.render(mvp, defaultColor, (offset - first) * 2, first * 2);
+
+    offset = 0;
     float opacity = defaultColor.alpha();
     for (std::size_t size = m_asterisms->size(), i = 0; i < size; i++)
     {
         const auto& ast = (*m_asterisms)[i];
-        if (!ast.getActive() || !ast.isColorOverridden())
+        if (!m_visible[i] || !ast.getActive() || !ast.isColorOverridden())
         {
             offset += m_lineCount[i];
             continue;
@@ -87,14 +111,32 @@ bool AsterismRenderer::prepare()
 
     m_totalLineCount = vtx_num;
 
+    m_bounds.reserve(m_asterisms->size());
+    m_visible.resize(m_asterisms->size());
     for (const auto& ast : *m_asterisms)
     {
+        Eigen::AlignedBox3f box;
         for (int k = 0; k < ast.getChainCount(); k++)
         {
             const auto& chain = ast.getChain(k);
             for (unsigned i = 1; i < chain.size(); i++)
                 m_lineRenderer.addSegment(chain[i - 1], chain[i]);
+            for (const auto& point : chain)
+                box.extend(point);
+        }
+
+        // The box center is close enough to the smallest sphere around
+        // the few stars of an asterism
+        Eigen::Vector3f center = Eigen::Vector3f::Zero();
+        if (!box.isEmpty())
+            center = box.center();
+        float radius = 0.0f;
+        for (int k = 0; k < ast.getChainCount(); k++)
+        {
+            for (const auto& point : ast.getChain(k))
+                radius = std::max(radius, (point - center).norm());
         }
+        m_bounds.emplace_back(center, radius);
     }
 
     return true;
@@ -11,13 +11,21 @@
 
 #include <vector>
 
+#include <Eigen/Core>
+
 #include <celengine/asterism.h>
+#include <celmath/sphere.h>
 #include <celrender/linerenderer.h>
 
 class Color;
 class Renderer;
 struct Matrices;
 
+namespace celestia::math
+{
+class Frustum;
+}
+
 namespace celestia::render
 {
 
@@ -32,7 +40,12 @@ public:
     AsterismRenderer& operator=(const AsterismRenderer&) = delete;
     AsterismRenderer& operator=(AsterismRenderer&&) = delete;
 
-    void render(const Color &color, const Matrices &mvp);
+    // Draw the asterisms whose bounds intersect frustum, which is in the
+    // orientation of the universe and centered on observerPos.
+    void render(const Color &color,
+                const Matrices &mvp,
+                const math::Frustum &frustum,
+                const Eigen::Vector3f &observerPos);
     bool sameAsterisms(const AsterismList *asterisms) const;
 
 private:
@@ -40,6 +53,9 @@ private:
 
     LineRenderer        m_lineRenderer;
     std::vector<int>    m_lineCount;
+    // Sphere containing the lines of each asterism
+    std::vector<math::Spheref> m_bounds;
+    std::vector<bool>   m_visible;
     const AsterismList *m_asterisms       { nullptr };
     int                 m_totalLineCount  { 0 };
     bool                m_initialized     { false };
@@ -370,6 +370,10 @@ AtmosphereRenderer::render(
     shadprop.texUsage |= ShaderProperties::Scattering;
     shadprop.lightModel = ShaderProperties::AtmosphereModel;
 
+    const auto *scatteringTables = m_renderer.getScatteringTables(atmosphere, radius);
+    if (scatteringTables != nullptr)
+        shadprop.texUsage |= ShaderProperties::ScatteringTables;
+
     // Get a shader for the current rendering configuration
     CelestiaGLProgram* prog = m_renderer.getShaderManager().getShader(shadprop);
     if (prog == nullptr)
@@ -385,6 +389,8 @@ AtmosphereRenderer::render(
 
     prog->eyePosition = ls.eyePos_obj / atmScale;
     prog->setAtmosphereParameters(atmosphere, radius, atmosphereRadius);
+    if (scatteringTables != nullptr)
+        prog->setScatteringTables(*scatteringTables);
 
 #if 0
     // Currently eclipse shadows are ignored when rendering atmospheres
@@ -9,9 +9,14 @@
 
 #include "boundariesrenderer.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <numeric>
 
+#include <Eigen/Geometry>
+
 #include <celengine/boundaries.h>
+#include <celmath/frustum.h>
 
 namespace celestia::render
 {
@@ -27,7 +32,10 @@ bool BoundariesRenderer::sameBoundaries(const ConstellationBoundaries *boundarie
     return m_boundaries == boundaries;
 }
 
-void BoundariesRenderer::render(const Color &color, const Matrices &mvp)
+void BoundariesRenderer::render(const Color &color,
+                                const Matrices &mvp,
+                                const math::Frustum &frustum,
+                                const Eigen::Vector3f &observerPos)
 {
     if (!m_initialized)
     {
@@ -35,7 +43,20 @@ void BoundariesRenderer::render(const Color &color, const Matrices &mvp)
         m_initialized = true;
     }
 
-    m_lineRenderer.render(mvp, color, m_lineCount * 2);
+    // Draw the lines of consecutive visible chains at once
+    int first = 0;
+    for (std::size_t size = m_bounds.size(), i = 0; i < size; i++)
+    {
+        const auto& bounds = m_bounds[i];
+        if (frustum.testSphere(bounds.center - observerPos, bounds.radius) != math::Frustum::Outside)
+            continue;
+
+        if (m_firstLine[i] > first)
+            m_lineRenderer.render(mvp, color, (m_firstLine[i] - first) * 2, first * 2);
+        first = i + 1 < size ? m_firstLine[i + 1] : m_lineCount;
+    }
+    if (m_lineCount > first)
+        m_lineRenderer.render(mvp, color, (m_lineCount - first) * 2, first * 2);
     m_lineRenderer.finish();
 }
 
@@ -51,10 +72,28 @@ bool BoundariesRenderer::prepare()
 
     m_lineCount = lineCount;
 
+    m_bounds.reserve(chains.size());
+    m_firstLine.reserve(chains.size());
+    int firstLine = 0;
     for (const auto& chain : chains)
     {
         for (ConstellationBoundaries::Chain::size_type i = 1; i < chain.size(); i++)
             m_lineRenderer.addSegment(chain[i - 1], chain[i]);
+
+        Eigen::AlignedBox3f box;
+        for (const auto& point : chain)
+            box.extend(point);
+
+        Eigen::Vector3f center = Eigen::Vector3f::Zero();
+        if (!box.isEmpty())
+            center = box.center();
+        float radius = 0.0f;
+        for (const auto& point : chain)
+            radius = std::max(radius, (point - center).norm());
+
+        m_bounds.emplace_back(center, radius);
+        m_firstLine.push_back(firstLine);
+        firstLine += static_cast<int>(chain.size()) - 1;
     }
 
     return true;
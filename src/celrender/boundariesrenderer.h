@@ -9,6 +9,11 @@
 
 #pragma once
 
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celmath/sphere.h>
 #include <celrender/linerenderer.h>
 
 class Color;
@@ -16,6 +21,11 @@ class ConstellationBoundaries;
 class Renderer;
 struct Matrices;
 
+namespace celestia::math
+{
+class Frustum;
+}
+
 namespace celestia::render
 {
 
@@ -30,7 +40,12 @@ public:
     BoundariesRenderer& operator=(const BoundariesRenderer&) = delete;
     BoundariesRenderer& operator=(BoundariesRenderer&&) = delete;
 
-    void render(const Color &color, const Matrices &mvp);
+    // Draw the boundaries whose bounds intersect frustum, which is in the
+    // orientation of the universe and centered on observerPos.
+    void render(const Color &color,
+                const Matrices &mvp,
+                const math::Frustum &frustum,
+                const Eigen::Vector3f &observerPos);
     bool sameBoundaries(const ConstellationBoundaries*) const;
 
 private:
@@ -38,6 +53,9 @@ private:
 
     LineRenderer                   m_lineRenderer;
     const ConstellationBoundaries *m_boundaries      { nullptr };
+    // Sphere containing each chain, and its first line
+    std::vector<math::Spheref>     m_bounds;
+    std::vector<int>               m_firstLine;
     int                            m_lineCount       { 0 };
     bool                           m_initialized     { false };
 };
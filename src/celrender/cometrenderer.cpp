@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include <Eigen/Geometry>
 
@@ -67,6 +68,16 @@ CometRenderer::initGL()
     m_prog = m_renderer.getShaderManager().getShader("comet");
     m_brightnessLoc = m_prog->attribIndex("in_Brightness");
 
+    // Older shader directories don't have the tail shader, and the error
+    // shader used in its place has no tail coordinates
+    m_tailProg = m_renderer.getShaderManager().getShader("comettail");
+    if (m_tailProg != nullptr)
+    {
+        m_tailCoordLoc = m_tailProg->attribIndex("in_TailCoord");
+        if (m_tailCoordLoc < 0)
+            m_tailProg = nullptr;
+    }
+
     m_vo = std::make_unique<gl::VertexObject>();
     m_bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array);
     m_io = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::ElementArray);
@@ -105,64 +116,63 @@ CometRenderer::deinitGL()
     m_vo = nullptr;
     m_bo = nullptr;
     m_io = nullptr;
+    m_tailProg = nullptr;
+    m_tailMeshes = {};
 }
 
-void
-CometRenderer::render(const Body &body,
-                      const Observer &observer,
-                      const Eigen::Vector3f &pos,
-                      float dustTailLength,
-                      float discSizeInPixels,
-                      const Matrices &m)
+const CometRenderer::TailMesh&
+CometRenderer::getTailMesh(int lod)
 {
-    if (m_prog == nullptr)
-        return;
+    TailMesh& mesh = m_tailMeshes[lod];
+    if (mesh.vo != nullptr)
+        return mesh;
 
-    double now = observer.getTime();
+    float lodFactor = static_cast<float>(lod + 1) / static_cast<float>(TailLODCount);
+    mesh.nPoints = static_cast<int>(MaxCometTailPoints * lodFactor);
+    mesh.nSlices = static_cast<int>(MaxCometTailSlices * lodFactor);
 
-    Eigen::Vector3f cometPoints[MaxCometTailPoints];
-#if 0
-    Eigen::Vector3d pos0 = body.getOrbit(now)->positionAtTime(now);
-    Eigen::Vector3d pos1 = body.getOrbit(now)->positionAtTime(now - 0.01);
-    Eigen::Vector3d vd = pos1 - pos0;
-#endif
-
-    // Adjust the amount of triangles used for the comet tail based on
-    // the screen size of the comet.
-    float lod = std::clamp(discSizeInPixels / 1000.0f, 0.2f, 1.0f);
-    auto nTailPoints = static_cast<int>(MaxCometTailPoints * lod);
-    auto nTailSlices = static_cast<int>(MaxCometTailSlices * lod);
-
-    float irradiance_max = 0.0f;
-    // Find the sun with the largest irrradiance of light onto the comet
-    // as function of the comet's position;
-    // irradiance = sun's luminosity / square(distanceFromSun);
-    Eigen::Vector3d sunPos(Eigen::Vector3d::Zero());
-    for (const auto star : m_renderer.getNearStars())
+    std::vector<Eigen::Vector2f> coords;
+    coords.reserve(static_cast<std::size_t>(mesh.nPoints * mesh.nSlices));
+    for (int i = 0; i < mesh.nPoints; i++)
     {
-        if (star->getVisibility())
+        for (int j = 0; j < mesh.nSlices; j++)
         {
-            Eigen::Vector3d p = star->getPosition(now).offsetFromKm(observer.getPosition());
-            float distanceFromSun = static_cast<float>((pos.cast<double>() - p).norm());
-            float irradiance = star->getBolometricLuminosity() / math::square(distanceFromSun);
-
-            if (irradiance > irradiance_max)
-            {
-                irradiance_max = irradiance;
-                sunPos = p;
-            }
+            float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(mesh.nSlices);
+            coords.emplace_back(static_cast<float>(i), theta);
         }
     }
 
-    float fadeDistance = 1.0f / (CometTailAttenDistSol * std::sqrt(irradiance_max));
-
-    // direction to sun with dominant light irradiance:
-    Eigen::Vector3f sunDir = (pos.cast<double>() - sunPos).cast<float>().normalized();
+    std::vector<ushort> indices;
+    BuildIndexList(static_cast<ushort>(mesh.nPoints - 1), static_cast<ushort>(mesh.nSlices), indices);
 
-    float dustTailRadius = dustTailLength * 0.1f;
+    mesh.bo = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, coords);
+    mesh.io = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::ElementArray, indices);
+    mesh.vo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::TriangleStrip);
+    mesh.vo->setCount(static_cast<int>(indices.size()))
+        .addVertexBuffer(
+            *mesh.bo,
+            m_tailCoordLoc,
+            2,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(Eigen::Vector2f),
+            0)
+        .setIndexBuffer(*mesh.io, 0, gl::VertexObject::IndexType::UnsignedShort);
+    mesh.bo->unbind();
+    mesh.io->unbind();
 
-    Eigen::Vector3f origin = -sunDir * (body.getRadius() * 100);
+    return mesh;
+}
 
+void
+CometRenderer::buildTail(int nTailPoints,
+                         int nTailSlices,
+                         const Eigen::Vector3f &origin,
+                         const Eigen::Vector3f &sunDir,
+                         float dustTailLength,
+                         float dustTailRadius)
+{
+    Eigen::Vector3f cometPoints[MaxCometTailPoints];
     for (int i = 0; i < nTailPoints; i++)
     {
         float alpha = static_cast<float>(i) / static_cast<float>(nTailPoints);
@@ -174,7 +184,7 @@ CometRenderer::render(const Body &body,
     // comet. The first axis is the sun-to-comet direction, and the other
     // two are chose orthogonal to each other and the primary axis.
     Eigen::Vector3f v = (cometPoints[1] - cometPoints[0]).normalized();
-    Eigen::Quaternionf q = body.getEclipticToEquatorial(now).cast<float>();
+    Eigen::Quaternionf q;
     Eigen::Vector3f u = v.unitOrthogonal();
     Eigen::Vector3f w = u.cross(v);
 
@@ -236,6 +246,60 @@ CometRenderer::render(const Body &body,
     }
 
     BuildIndexList(static_cast<ushort>(nTailPoints-1), static_cast<ushort>(nTailSlices), m_indices.get());
+}
+
+void
+CometRenderer::render(const Body &body,
+                      const Observer &observer,
+                      const Eigen::Vector3f &pos,
+                      float dustTailLength,
+                      float discSizeInPixels,
+                      const Matrices &m)
+{
+    if (m_prog == nullptr)
+        return;
+
+    double now = observer.getTime();
+
+#if 0
+    Eigen::Vector3d pos0 = body.getOrbit(now)->positionAtTime(now);
+    Eigen::Vector3d pos1 = body.getOrbit(now)->positionAtTime(now - 0.01);
+    Eigen::Vector3d vd = pos1 - pos0;
+#endif
+
+    // Adjust the amount of triangles used for the comet tail based on
+    // the screen size of the comet.
+    float lod = std::clamp(discSizeInPixels / 1000.0f, 0.2f, 1.0f);
+
+    float irradiance_max = 0.0f;
+    // Find the sun with the largest irrradiance of light onto the comet
+    // as function of the comet's position;
+    // irradiance = sun's luminosity / square(distanceFromSun);
+    Eigen::Vector3d sunPos(Eigen::Vector3d::Zero());
+    for (const auto star : m_renderer.getNearStars())
+    {
+        if (star->getVisibility())
+        {
+            Eigen::Vector3d p = star->getPosition(now).offsetFromKm(observer.getPosition());
+            float distanceFromSun = static_cast<float>((pos.cast<double>() - p).norm());
+            float irradiance = star->getBolometricLuminosity() / math::square(distanceFromSun);
+
+            if (irradiance > irradiance_max)
+            {
+                irradiance_max = irradiance;
+                sunPos = p;
+            }
+        }
+    }
+
+    float fadeDistance = 1.0f / (CometTailAttenDistSol * std::sqrt(irradiance_max));
+
+    // direction to sun with dominant light irradiance:
+    Eigen::Vector3f sunDir = (pos.cast<double>() - sunPos).cast<float>().normalized();
+
+    float dustTailRadius = dustTailLength * 0.1f;
+
+    Eigen::Vector3f origin = -sunDir * (body.getRadius() * 100);
 
     // If fadeDistFromSun = x/x0 >= 1.0, comet tail starts fading,
     // i.e. fadeFactor quickly transits from 1 to 0.
@@ -247,23 +311,53 @@ CometRenderer::render(const Body &body,
     ps.depthTest = true;
     m_renderer.setPipelineState(ps);
 
-    m_prog->use();
-    m_prog->setMVPMatrices(*m.projection, (*m.modelview) * math::translate(pos));
-    m_prog->vec3Param("color") = body.getCometTailColor().toVector3();
-    m_prog->vec3Param("viewDir") = pos.normalized();
-    m_prog->floatParam("fadeFactor") = fadeFactor;
-
-    m_bo->bind().invalidateData().setData(
-        util::array_view<CometTailVertex>(m_vertices.get(), MaxVertices),
-        gl::Buffer::BufferUsage::StreamDraw);
-
-    m_io->bind().invalidateData().setData(
-        util::array_view<ushort>(m_indices.get(), MaxIndices),
-        gl::Buffer::BufferUsage::StreamDraw);
-
     glDisable(GL_CULL_FACE);
-    int count = IndexListCapacity(nTailSlices, nTailPoints);
-    m_vo->draw(gl::VertexObject::Primitive::TriangleStrip, count);
+    if (m_tailProg != nullptr)
+    {
+        // The tail is shaped by the vertex shader from a static grid, so
+        // the CPU cost of a comet doesn't depend on the size of its tail
+        int tailLOD = std::clamp(static_cast<int>(std::ceil(lod * TailLODCount)) - 1, 0, TailLODCount - 1);
+        const TailMesh& mesh = getTailMesh(tailLOD);
+        Eigen::Vector3f u = sunDir.unitOrthogonal();
+
+        m_tailProg->use();
+        m_tailProg->setMVPMatrices(*m.projection, (*m.modelview) * math::translate(pos));
+        m_tailProg->vec3Param("color") = body.getCometTailColor().toVector3();
+        m_tailProg->vec3Param("viewDir") = pos.normalized();
+        m_tailProg->floatParam("fadeFactor") = fadeFactor;
+        m_tailProg->vec3Param("tailOrigin") = origin;
+        m_tailProg->vec3Param("tailAxis") = sunDir;
+        m_tailProg->vec3Param("tailU") = u;
+        m_tailProg->vec3Param("tailW") = u.cross(sunDir);
+        m_tailProg->floatParam("tailLength") = dustTailLength;
+        m_tailProg->floatParam("tailRadius") = dustTailRadius;
+        m_tailProg->floatParam("tailPoints") = static_cast<float>(mesh.nPoints);
+
+        mesh.vo->draw();
+    }
+    else
+    {
+        auto nTailPoints = static_cast<int>(MaxCometTailPoints * lod);
+        auto nTailSlices = static_cast<int>(MaxCometTailSlices * lod);
+        buildTail(nTailPoints, nTailSlices, origin, sunDir, dustTailLength, dustTailRadius);
+
+        m_prog->use();
+        m_prog->setMVPMatrices(*m.projection, (*m.modelview) * math::translate(pos));
+        m_prog->vec3Param("color") = body.getCometTailColor().toVector3();
+        m_prog->vec3Param("viewDir") = pos.normalized();
+        m_prog->floatParam("fadeFactor") = fadeFactor;
+
+        m_bo->bind().invalidateData().setData(
+            util::array_view<CometTailVertex>(m_vertices.get(), MaxVertices),
+            gl::Buffer::BufferUsage::StreamDraw);
+
+        m_io->bind().invalidateData().setData(
+            util::array_view<ushort>(m_indices.get(), MaxIndices),
+            gl::Buffer::BufferUsage::StreamDraw);
+
+        int count = IndexListCapacity(nTailSlices, nTailPoints);
+        m_vo->draw(gl::VertexObject::Primitive::TriangleStrip, count);
+    }
     glEnable(GL_CULL_FACE);
 }
 
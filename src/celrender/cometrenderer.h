@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 
 #include <Eigen/Core>
@@ -58,6 +59,26 @@ private:
         float brightness;
     };
 
+    // Static grid of a tail level of detail, shaped by the tail shader
+    struct TailMesh
+    {
+        int nPoints{ 0 };
+        int nSlices{ 0 };
+        std::unique_ptr<gl::Buffer>       bo;
+        std::unique_ptr<gl::Buffer>       io;
+        std::unique_ptr<gl::VertexObject> vo;
+    };
+
+    static constexpr int TailLODCount = 5;
+
+    const TailMesh& getTailMesh(int lod);
+    void buildTail(int nTailPoints,
+                   int nTailSlices,
+                   const Eigen::Vector3f &origin,
+                   const Eigen::Vector3f &sunDir,
+                   float dustTailLength,
+                   float dustTailRadius);
+
     Renderer                          &m_renderer;
     CelestiaGLProgram                 *m_prog{ nullptr };
     int                                m_brightnessLoc{ -1 };
@@ -67,6 +88,11 @@ private:
     std::unique_ptr<gl::Buffer>        m_bo;
     std::unique_ptr<gl::Buffer>        m_io;
     std::unique_ptr<gl::VertexObject>  m_vo;
+    // Tails generated by the vertex shader; null if the shader is not
+    // available, in which case they are built on the CPU
+    CelestiaGLProgram                 *m_tailProg{ nullptr };
+    int                                m_tailCoordLoc{ -1 };
+    std::array<TailMesh, TailLODCount> m_tailMeshes;
 };
 
 } // namespace celestia::render
@@ -8,6 +8,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cmath>
@@ -53,6 +54,24 @@ colorTextureEval(float u, float /*v*/, float /*w*/, std::uint8_t *pixel)
     Color::fromHSV(hue, 0.20f, 1.0f).get(pixel);
 }
 
+[[ nodiscard ]] inline bool
+isInstancingSupported()
+{
+#ifdef GL_ES
+    return gl::checkVersion(gl::GLES_3_0);
+#else
+    return gl::ARB_instanced_arrays;
+#endif
+}
+
+// Per-instance attributes of the GL3 galaxy shader
+struct GalaxyInstance
+{
+    Eigen::Matrix4f transform;
+    // size, brightness, minimum feature size and number of blobs drawn
+    Eigen::Vector4f parameters;
+};
+
 void
 BindTextures()
 {
@@ -67,7 +86,7 @@ BindTextures()
                                             galaxyTextureEval).release();
     }
     assert(galaxyTex != nullptr);
-    glActiveTexture(GL_TEXTURE0);
+    gl::activeTexture(GL_TEXTURE0);
     galaxyTex->bind();
 
     if (colorTex == nullptr)
@@ -78,7 +97,7 @@ BindTextures()
                                            Texture::NoMipMaps).release();
     }
     assert(colorTex != nullptr);
-    glActiveTexture(GL_TEXTURE1);
+    gl::activeTexture(GL_TEXTURE1);
     colorTex->bind();
 }
 
@@ -239,7 +258,7 @@ GalaxyRenderer::renderGL2()
         m_renderDataGL2[obj.galaxy->getFormId()].vo.draw(nPoints * 6);
     }
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::activeTexture(GL_TEXTURE0);
 }
 
 void
@@ -352,13 +371,19 @@ GalaxyRenderer::initializeGL2(const CelestiaGLProgram *prog)
 
 struct GalaxyRenderer::RenderDataGL3
 {
-    RenderDataGL3(gl::Buffer &&bo, gl::VertexObject &&vo) :
+    RenderDataGL3(gl::Buffer &&bo, gl::Buffer &&io, gl::VertexObject &&vo) :
         bo(std::move(bo)),
+        io(std::move(io)),
         vo(std::move(vo))
     {
     }
     gl::Buffer       bo{ util::NoCreateT{} };
+    gl::Buffer       io{ util::NoCreateT{} }; // per-instance attributes
     gl::VertexObject vo{ util::NoCreateT{} };
+
+    // instances drawn with the default projection this frame
+    std::vector<GalaxyInstance> instances;
+    int                         maxPoints{ 0 };
 };
 
 void
@@ -384,6 +409,9 @@ GalaxyRenderer::renderGL3()
     ps.smoothLines = true;
     m_renderer.setPipelineState(ps);
 
+    // Galaxies drawn with the default projection are batched by form and
+    // drawn with one instanced call per form. The few galaxies small enough
+    // to need a projection of their own are drawn one by one.
     for (const auto &obj : m_objects)
     {
         float brightness = 0.0f;
@@ -393,20 +421,59 @@ GalaxyRenderer::renderGL3()
         Eigen::Matrix4f pr;
         int nPoints = 0;
 
-        if (!getRenderInfo(obj, brightness, size, minimumFeatureSize, m, pr, nPoints))
+        if (!getRenderInfo(obj, brightness, size, minimumFeatureSize, m, pr, nPoints) || nPoints == 0)
             continue;
 
+        auto &data = m_renderDataGL3[obj.galaxy->getFormId()];
+        data.instances.push_back({ m, Eigen::Vector4f(size, brightness, minimumFeatureSize, static_cast<float>(nPoints)) });
+
+        if (m_instancing && obj.nearZ == 0.0f && obj.farZ == 0.0f)
+        {
+            data.maxPoints = std::max(data.maxPoints, nPoints);
+            continue;
+        }
+
         prog->setMVPMatrices(pr, m_renderer.getModelViewMatrix());
+        drawGL3(data, nPoints);
+        data.instances.clear();
+    }
 
-        prog->floatParam("size")               = size;
-        prog->floatParam("brightness")         = brightness;
-        prog->floatParam("minimumFeatureSize") = minimumFeatureSize;
-        prog->mat4Param("m")                   = m;
+    if (m_instancing)
+    {
+        prog->setMVPMatrices(m_renderer.getProjectionMatrix(), m_renderer.getModelViewMatrix());
+        for (auto &data : m_renderDataGL3)
+        {
+            if (data.instances.empty())
+                continue;
 
-        m_renderDataGL3[obj.galaxy->getFormId()].vo.draw(nPoints);
+            drawGL3(data, data.maxPoints);
+            data.instances.clear();
+            data.maxPoints = 0;
+        }
     }
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::activeTexture(GL_TEXTURE0);
+}
+
+void
+GalaxyRenderer::drawGL3(RenderDataGL3 &data, int nPoints) const
+{
+    if (m_instancing)
+    {
+        // The blobs of each instance beyond its own point count are
+        // dropped by the shaders
+        data.io.bind().setData(data.instances, gl::Buffer::BufferUsage::StreamDraw);
+        data.vo.drawInstanced(nPoints, static_cast<int>(data.instances.size()));
+        return;
+    }
+
+    // Without instanced arrays the per-instance attributes are constant
+    // vertex attributes
+    const GalaxyInstance &instance = data.instances.front();
+    for (int i = 0; i < 4; ++i)
+        glVertexAttrib4fv(m_transformLoc + i, instance.transform.col(i).data());
+    glVertexAttrib4fv(m_parametersLoc, instance.parameters.data());
+    data.vo.draw(nPoints);
 }
 
 void
@@ -428,6 +495,9 @@ GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog)
     auto sizeLoc = prog->attribIndex("in_Size");
     auto colorLoc = prog->attribIndex("in_ColorIndex");
     auto brightnessLoc = prog->attribIndex("in_Brightness");
+    m_transformLoc = prog->attribIndex("in_Transform");
+    m_parametersLoc = prog->attribIndex("in_Parameters");
+    m_instancing = isInstancingSupported() && m_transformLoc >= 0 && m_parametersLoc >= 0;
 
     const auto *gm = GalacticFormManager::get();
     std::vector<GalaxyVtx> glVertices;
@@ -475,11 +545,27 @@ GalaxyRenderer::initializeGL3(const CelestiaGLProgram *prog)
                 bo, brightnessLoc, 1, gl::VertexObject::DataType::UnsignedByte,
                 true, sizeof(GalaxyVtx), offsetof(GalaxyVtx, brightness));
 
-            m_renderDataGL3.emplace_back(std::move(bo), std::move(vo));
+            gl::Buffer io(util::NoCreateT{});
+            if (m_instancing)
+            {
+                io = gl::Buffer(gl::Buffer::TargetHint::Array);
+                // a mat4 attribute takes four consecutive locations
+                for (int i = 0; i < 4; ++i)
+                {
+                    vo.addVertexBuffer(
+                        io, m_transformLoc + i, 4, gl::VertexObject::DataType::Float,
+                        false, sizeof(GalaxyInstance), offsetof(GalaxyInstance, transform) + i * sizeof(Eigen::Vector4f), 1);
+                }
+                vo.addVertexBuffer(
+                    io, m_parametersLoc, 4, gl::VertexObject::DataType::Float,
+                    false, sizeof(GalaxyInstance), offsetof(GalaxyInstance, parameters), 1);
+            }
+
+            m_renderDataGL3.emplace_back(std::move(bo), std::move(io), std::move(vo));
         }
         else
         {
-            m_renderDataGL3.emplace_back(gl::Buffer(util::NoCreateT{}), gl::VertexObject(util::NoCreateT{}));
+            m_renderDataGL3.emplace_back(gl::Buffer(util::NoCreateT{}), gl::Buffer(util::NoCreateT{}), gl::VertexObject(util::NoCreateT{}));
         }
         glVertices.clear();
     }
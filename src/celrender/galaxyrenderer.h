@@ -52,6 +52,12 @@ private:
     std::vector<RenderDataGL3>  m_renderDataGL3;
     void renderGL3();
     void initializeGL3(const CelestiaGLProgram *prog);
+    void drawGL3(RenderDataGL3 &data, int nPoints) const;
+
+    // per-instance attributes of the GL3 path
+    int                 m_transformLoc{ -1 };
+    int                 m_parametersLoc{ -1 };
+    bool                m_instancing{ false };
 
     // global state
     std::vector<Object>     m_objects;
@@ -71,27 +71,27 @@ void
 Buffer::clear() noexcept
 {
     if (m_id != 0)
-        glDeleteBuffers(1, &m_id);
+        gl::deleteBuffers(1, &m_id);
     m_id = 0;
 }
 
 Buffer&
 Buffer::bind()
 {
-    glBindBuffer(GLENUM(m_targetHint), m_id);
+    gl::bindBuffer(GLENUM(m_targetHint), m_id);
     return *this;
 }
 
 void
 Buffer::unbind() const
 {
-    glBindBuffer(GLENUM(m_targetHint), 0);
+    gl::bindBuffer(GLENUM(m_targetHint), 0);
 }
 
 void
 Buffer::unbind(Buffer::TargetHint target)
 {
-    glBindBuffer(GLENUM(target), 0);
+    gl::bindBuffer(GLENUM(target), 0);
 }
 
 Buffer&
@@ -100,6 +100,8 @@ Buffer::setData(util::array_view<const void> data, Buffer::BufferUsage usage)
     m_bufferSize = data.size();
     m_usage      = usage;
     glBufferData(GLENUM(m_targetHint), m_bufferSize, data.data(), GLENUM(m_usage));
+    if (data.data() != nullptr)
+        countUpload(data.size());
     return *this;
 }
 
@@ -107,6 +109,7 @@ Buffer&
 Buffer::setSubData(GLintptr offset, util::array_view<const void> data)
 {
     glBufferSubData(GLENUM(m_targetHint), offset, data.size(), data.data());
+    countUpload(data.size());
     return *this;
 }
 
@@ -118,6 +121,28 @@ Buffer::invalidateData()
     return *this;
 }
 
+#ifndef GL_ES
+Buffer&
+Buffer::setStorage(GLsizeiptr size, GLbitfield flags)
+{
+    m_bufferSize = size;
+    glBufferStorage(GLENUM(m_targetHint), size, nullptr, flags);
+    return *this;
+}
+#endif
+
+void*
+Buffer::mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    return glMapBufferRange(GLENUM(m_targetHint), offset, length, access);
+}
+
+bool
+Buffer::unmap()
+{
+    return glUnmapBuffer(GLENUM(m_targetHint)) == GL_TRUE;
+}
+
 Buffer&
 Buffer::setTargetHint(Buffer::TargetHint targetHint)
 {
@@ -40,6 +40,8 @@ public:
         DynamicDraw = GL_DYNAMIC_DRAW,
         //! Set data once and use a few times.
         StreamDraw  = GL_STREAM_DRAW,
+        //! Read data from GL once and use a few times.
+        StreamRead  = GL_STREAM_READ,
     };
 
     /**
@@ -55,6 +57,10 @@ public:
         Array        = GL_ARRAY_BUFFER,
         //! Store vertex indices.
         ElementArray = GL_ELEMENT_ARRAY_BUFFER,
+        //! Source of texture image data.
+        PixelUnpack  = GL_PIXEL_UNPACK_BUFFER,
+        //! Destination of pixels read from a framebuffer.
+        PixelPack    = GL_PIXEL_PACK_BUFFER,
     };
 
     /**
@@ -136,6 +142,35 @@ public:
     //! Invalidate buffer data.
     Buffer& invalidateData();
 
+#ifndef GL_ES
+    /**
+     * @brief Allocate immutable storage for the Buffer.
+     *
+     * Requires OpenGL 4.4 or ARB_buffer_storage. The contents are
+     * undefined.
+     *
+     * @param size Size in bytes.
+     * @param flags Storage flags, e.g. GL_MAP_PERSISTENT_BIT.
+     * @return Reference to self.
+     */
+    Buffer& setStorage(GLsizeiptr size, GLbitfield flags);
+#endif
+
+    /**
+     * @brief Map a range of the Buffer to CPU memory.
+     *
+     * Requires OpenGL 3.0, ARB_map_buffer_range or OpenGL ES 3.0.
+     *
+     * @param offset Offset in bytes of the range.
+     * @param length Length in bytes of the range.
+     * @param access Access flags, e.g. GL_MAP_WRITE_BIT.
+     * @return Pointer to the mapped range or nullptr on failure.
+     */
+    void* mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access);
+
+    //! Unmap the Buffer, return false if its contents got corrupted.
+    bool unmap();
+
     //! Set buffer target. @see @ref TargetHint
     Buffer& setTargetHint(TargetHint hint);
 
@@ -0,0 +1,183 @@
+// streambuffer.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Ring buffer for streamed vertex data.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "streambuffer.h"
+
+#include <cstring>
+
+namespace celestia::gl
+{
+
+namespace
+{
+
+// Granularity of the segment size when the buffer grows
+constexpr GLsizeiptr SegmentAlignment = 64 * 1024;
+// Timeout of a wait for a fence in nanoseconds
+constexpr GLuint64 FenceTimeout = 1000000000;
+
+} // end unnamed namespace
+
+StreamBuffer::StreamBuffer(GLsizeiptr segmentSize)
+{
+#ifdef GL_ES
+    m_mapRange = gl::checkVersion(gl::GLES_3_0);
+#else
+    m_mapRange = gl::ARB_map_buffer_range;
+#endif
+    allocate(segmentSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    clear();
+}
+
+void
+StreamBuffer::clear()
+{
+    for (GLsync& fence : m_fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (m_mapped != nullptr)
+    {
+        m_buffer.bind();
+        m_buffer.unmap();
+        m_buffer.unbind();
+        m_mapped = nullptr;
+    }
+
+    m_buffer = Buffer(util::NoCreateT{});
+    m_head = 0;
+    m_segment = 0;
+}
+
+void
+StreamBuffer::allocate(GLsizeiptr segmentSize)
+{
+    clear();
+
+    m_segmentSize = (segmentSize + SegmentAlignment - 1) / SegmentAlignment * SegmentAlignment;
+    auto ringSize = m_segmentSize * Segments;
+
+    m_buffer = Buffer(Buffer::TargetHint::Array);
+    m_buffer.bind();
+#ifdef GL_ES
+    m_persistent = false;
+#else
+    m_persistent = gl::ARB_buffer_storage && gl::ARB_sync && m_mapRange;
+    if (m_persistent)
+    {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        m_buffer.setStorage(ringSize, flags);
+        m_mapped = static_cast<std::uint8_t*>(m_buffer.mapRange(0, ringSize, flags));
+        if (m_mapped == nullptr)
+        {
+            // Immutable storage can't be reallocated
+            m_persistent = false;
+            m_buffer = Buffer(Buffer::TargetHint::Array);
+            m_buffer.bind();
+        }
+    }
+#endif
+    if (!m_persistent)
+        m_buffer.setData(util::array_view<const void>(nullptr, ringSize), Buffer::BufferUsage::StreamDraw);
+
+    ++m_generation;
+}
+
+void
+StreamBuffer::advance()
+{
+    if (m_persistent)
+        m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_segment = (m_segment + 1) % Segments;
+
+    GLsync& fence = m_fences[m_segment];
+    if (fence == nullptr)
+        return;
+
+    // The draws reading the segment were submitted at least a segment
+    // ago, so this rarely waits
+    GLenum status;
+    do
+    {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+    }
+    while (status == GL_TIMEOUT_EXPIRED);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+int
+StreamBuffer::write(util::array_view<const void> data, GLsizeiptr stride)
+{
+    auto size = static_cast<GLsizeiptr>(data.size());
+    if (size > m_segmentSize)
+        allocate(size);
+
+    m_buffer.bind();
+
+    GLintptr offset = (m_head + stride - 1) / stride * stride;
+    if (offset + size > m_segmentSize * Segments)
+    {
+        offset = 0;
+        // Orphan the storage, the draws submitted so far keep reading
+        // the previous one
+        if (!m_persistent)
+            m_buffer.invalidateData();
+    }
+
+    if (size > 0)
+    {
+        // Enter every segment touched by the data
+        auto last = static_cast<int>((offset + size - 1) / m_segmentSize);
+        while (m_segment != last)
+            advance();
+
+        if (m_persistent)
+        {
+            std::memcpy(m_mapped + offset, data.data(), data.size());
+            countUpload(data.size());
+        }
+        else
+        {
+            void* dest = nullptr;
+            if (m_mapRange)
+            {
+                dest = m_buffer.mapRange(offset, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            }
+
+            if (dest != nullptr)
+            {
+                std::memcpy(dest, data.data(), data.size());
+                m_buffer.unmap();
+                countUpload(data.size());
+            }
+            else
+            {
+                m_buffer.setSubData(offset, data);
+            }
+        }
+    }
+
+    m_head = offset + size;
+    return static_cast<int>(offset / stride);
+}
+
+} // namespace celestia::gl
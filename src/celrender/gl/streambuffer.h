@@ -0,0 +1,114 @@
+// streambuffer.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Ring buffer for streamed vertex data.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <celengine/glsupport.h>
+#include <celutil/array_view.h>
+#include "buffer.h"
+
+namespace celestia::gl
+{
+
+/**
+ * @brief Ring buffer for vertex data written every frame.
+ *
+ * Vertices of renderers which upload their geometry every frame are
+ * appended to a single buffer instead of reallocating a buffer of their
+ * own for every draw. The buffer is split into segments. When
+ * ARB_buffer_storage and ARB_sync are available the buffer is mapped
+ * persistently, a fence is placed after the draws reading a segment and
+ * the segment is written again once the fence is signaled. Otherwise the
+ * storage is orphaned each time the ring wraps around, and ranges are
+ * written without synchronization in between.
+ */
+class StreamBuffer
+{
+public:
+    //! Number of segments of the ring.
+    static constexpr int Segments = 4;
+
+    /**
+     * @brief Construct a new StreamBuffer object.
+     *
+     * Create the OpenGL buffer.
+     *
+     * @param segmentSize Size in bytes of a segment.
+     */
+    explicit StreamBuffer(GLsizeiptr segmentSize);
+
+    //! Copying is prohibited.
+    StreamBuffer(const StreamBuffer&) = delete;
+
+    //! Destructor.
+    ~StreamBuffer();
+
+    //! Copying is prohibited.
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    //! Return the buffer, to be attached to vertex objects.
+    const Buffer& buffer() const;
+
+    /**
+     * @brief Return the generation of the buffer.
+     *
+     * The buffer is reallocated when data larger than a segment is
+     * written, vertex objects attached to it must be created again when
+     * the generation changes.
+     */
+    int generation() const;
+
+    /**
+     * @brief Append data to the ring.
+     *
+     * The data are aligned to the stride, so that they can be drawn from
+     * a vertex object with offsets relative to the start of the buffer.
+     * Leaves the buffer bound to GL_ARRAY_BUFFER.
+     *
+     * @param data Data.
+     * @param stride Size in bytes of a vertex.
+     * @return Index of the first vertex of data in the buffer.
+     */
+    int write(util::array_view<const void> data, GLsizeiptr stride);
+
+private:
+    void allocate(GLsizeiptr segmentSize);
+    void clear();
+    // Move the head to the next segment
+    void advance();
+
+    Buffer                         m_buffer{ util::NoCreateT{} };
+    std::array<GLsync, Segments>   m_fences{ };
+    std::uint8_t                  *m_mapped{ nullptr };
+    GLsizeiptr                     m_segmentSize{ 0 };
+    GLintptr                       m_head{ 0 };
+    int                            m_segment{ 0 };
+    int                            m_generation{ 0 };
+    bool                           m_persistent{ false };
+    bool                           m_mapRange{ false };
+};
+
+inline const Buffer&
+StreamBuffer::buffer() const
+{
+    return m_buffer;
+}
+
+inline int
+StreamBuffer::generation() const
+{
+    return m_generation;
+}
+
+} // namespace celestia::gl
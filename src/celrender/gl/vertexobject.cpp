@@ -110,7 +110,7 @@ void
 VertexObject::clear() noexcept
 {
     if (m_id != 0 && isVAOSupported())
-        glDeleteVertexArrays(1, &m_id);
+        gl::deleteVertexArrays(1, &m_id);
     m_id = 0;
 }
 
@@ -123,6 +123,7 @@ struct VertexObject::BufferDesc
         std::int16_t  location,
         std::uint8_t  elemSize,
         std::uint8_t  stride,
+        std::uint8_t  divisor,
         bool          normalized) :
         offset(offset),
         bufferId(bufferId),
@@ -130,6 +131,7 @@ struct VertexObject::BufferDesc
         location(location),
         elemSize(elemSize),
         stride(stride),
+        divisor(divisor),
         normalized(normalized)
     {
     }
@@ -139,11 +141,12 @@ struct VertexObject::BufferDesc
     std::int16_t    location;
     std::uint8_t    elemSize;       // 1, 2, 3, 4
     std::uint8_t    stride;         // WebGL allows only 255 bytes max
+    std::uint8_t    divisor;        // 0 for per-vertex attributes
     bool            normalized;
 };
 
 VertexObject&
-VertexObject::addVertexBuffer(const Buffer &buffer, int location, int elemSize, VertexObject::DataType type, bool normalized, int stride, std::ptrdiff_t offset)
+VertexObject::addVertexBuffer(const Buffer &buffer, int location, int elemSize, VertexObject::DataType type, bool normalized, int stride, std::ptrdiff_t offset, int divisor)
 {
     if (buffer.targetHint() != Buffer::TargetHint::Array)
         return *this;
@@ -155,6 +158,7 @@ VertexObject::addVertexBuffer(const Buffer &buffer, int location, int elemSize,
         static_cast<std::uint16_t>(location),
         static_cast<std::uint8_t>(elemSize),
         static_cast<std::uint8_t>(stride),
+        static_cast<std::uint8_t>(divisor),
         normalized
     );
 
@@ -190,12 +194,55 @@ VertexObject::draw(VertexObject::Primitive primitive, int count, int first)
     {
         glDrawArrays(GLENUM(primitive), first, count);
     }
+    countDraw(GLENUM(primitive), count);
 
     unbind();
 
     return *this;
 }
 
+VertexObject&
+VertexObject::drawInstanced(int count, int instanceCount, int first)
+{
+    if (count == 0 || instanceCount == 0)
+        return *this;
+
+    bind();
+
+    if (isIndexed())
+    {
+        auto offset = static_cast<std::ptrdiff_t>(first * (m_indexType == IndexType::UnsignedShort ? sizeof(GLushort) : sizeof(GLuint)));
+        glDrawElementsInstanced(GLENUM(m_primitive), count, GLENUM(m_indexType), PTR(offset), instanceCount);
+    }
+    else
+    {
+        glDrawArraysInstanced(GLENUM(m_primitive), first, count, instanceCount);
+    }
+    countDraw(GLENUM(m_primitive), count, instanceCount);
+
+    unbind();
+
+    return *this;
+}
+
+#ifndef GL_ES
+VertexObject&
+VertexObject::drawIndirect(const Buffer &commands, std::ptrdiff_t offset)
+{
+    bind();
+
+    gl::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.id());
+    glDrawArraysIndirect(GLENUM(m_primitive), PTR(offset));
+    // The vertex count is only known to the GPU
+    countDraw(GLENUM(m_primitive), 0);
+    gl::bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    unbind();
+
+    return *this;
+}
+#endif
+
 VertexObject&
 VertexObject::setIndexBuffer(const Buffer &buffer, std::ptrdiff_t /*offset*/, VertexObject::IndexType type)
 {
@@ -216,27 +263,33 @@ VertexObject::enableAttribArrays()
     {
         if (m_currBuff != p.bufferId)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, p.bufferId);
+            gl::bindBuffer(GL_ARRAY_BUFFER, p.bufferId);
             m_currBuff = p.bufferId;
         }
         glEnableVertexAttribArray(p.location);
         glVertexAttribPointer(p.location, p.elemSize, p.type, p.normalized ? GL_TRUE : GL_FALSE, p.stride, PTR(p.offset));
+        if (p.divisor != 0)
+            glVertexAttribDivisor(p.location, p.divisor);
     }
 
     if (isIndexed())
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_idxBufferId);
+        gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_idxBufferId);
 }
 
 void
 VertexObject::disableAttribArrays()
 {
     for (const auto& p : m_bufferDesc)
+    {
         glDisableVertexAttribArray(p.location);
+        if (p.divisor != 0)
+            glVertexAttribDivisor(p.location, 0);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 
     if (isIndexed())
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     m_currBuff = 0;
 }
@@ -249,7 +302,7 @@ VertexObject::bind()
         m_initialized = true;
         if (isVAOSupported())
         {
-            glBindVertexArray(m_id);
+            gl::bindVertexArray(m_id);
             enableAttribArrays();
             m_bufferDesc.clear();
         }
@@ -257,7 +310,7 @@ VertexObject::bind()
     else
     {
         if (isVAOSupported())
-            glBindVertexArray(m_id);
+            gl::bindVertexArray(m_id);
         else
             enableAttribArrays();
     }
@@ -267,7 +320,7 @@ void
 VertexObject::unbind()
 {
     if (isVAOSupported())
-        glBindVertexArray(0);
+        gl::bindVertexArray(0);
     else
         disableAttribArrays();
 }
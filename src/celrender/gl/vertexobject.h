@@ -152,6 +152,38 @@ public:
      */
     VertexObject& draw(Primitive primitive, int count, int first = 0);
 
+    /**
+     * @brief Render several instances of the VertexObject.
+     *
+     * Render VertexObject using a default primitive. Attributes added with
+     * a non-zero divisor advance once per divisor instances. Requires
+     * OpenGL 3.3, ARB_instanced_arrays or OpenGL ES 3.0.
+     *
+     * @param count Number of vertices to draw per instance.
+     * @param instanceCount Number of instances to draw.
+     * @param first First vertex to draw.
+     * @return Reference to self.
+     *
+     * @see @ref addVertexBuffer()
+     */
+    VertexObject& drawInstanced(int count, int instanceCount, int first = 0);
+
+#ifndef GL_ES
+    /**
+     * @brief Render the VertexObject with parameters read from a buffer.
+     *
+     * Render a non-indexed VertexObject using a default primitive, with
+     * the vertex count and first vertex of the DrawArraysIndirectCommand
+     * at offset in commands, which may be written by the GPU. Requires
+     * OpenGL 4.0 or ARB_draw_indirect.
+     *
+     * @param commands Buffer holding the draw parameters.
+     * @param offset Offset in bytes of the parameters in commands.
+     * @return Reference to self.
+     */
+    VertexObject& drawIndirect(const Buffer &commands, std::ptrdiff_t offset = 0);
+#endif
+
     /**
      * @brief Set the primitive.
      *
@@ -212,11 +244,13 @@ public:
      * @param stride Offset in bytes between consecutive generic vertex attributes. If stride is 0,
      * the generic vertex attributes are understood to be tightly packed in the array.
      * @param offset Offset of the first component of the first generic vertex attribute in the array.
+     * @param divisor Number of instances drawn per attribute value, 0 for per-vertex attributes.
+     * See documentation for glVertexAttribDivisor OpenGL method for more information.
      * @return Reference to self.
      *
-     * @see @ref DataType
+     * @see @ref DataType @ref drawInstanced()
      */
-    VertexObject& addVertexBuffer(const Buffer &buffer, int location, int elemSize, DataType type, bool normalized = false, int stride = 0, std::ptrdiff_t offset = 0);
+    VertexObject& addVertexBuffer(const Buffer &buffer, int location, int elemSize, DataType type, bool normalized = false, int stride = 0, std::ptrdiff_t offset = 0, int divisor = 0);
 
     /**
      * @brief Add index buffer.
@@ -23,10 +23,12 @@
 #include <celengine/render.h>
 #include <celengine/shadermanager.h>
 #include <celengine/texture.h>
+#include <celimage/image.h>
 #include <celimage/pixelformat.h>
 #include <celmath/geomutil.h>
 #include <celmath/randutils.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 #include <celutil/color.h>
 #include "globularrenderer.h"
@@ -54,6 +56,17 @@ constexpr float P1 = 65.0f, P2 = 0.75f;
 
 constexpr float kSpriteScaleFactor = 1.0f/1.25f;
 
+// Globulars smaller than this on screen are drawn as impostors, billboards
+// with a pre-rendered image of their form. They fade into the full star
+// field up to twice that size.
+constexpr float kImpostorSizeInPixels = 16.0f;
+// Impostors of the 8 forms are tiles of a 4x2 texture atlas
+constexpr int kImpostorTileSize = 64;
+constexpr int kImpostorAtlasColumns = 4;
+constexpr int kImpostorAtlasRows = 2;
+// Number of star sprites drawn at the impostor size, see CalculateSpriteCount
+constexpr unsigned int kImpostorStars = 128u;
+
 float RRatio, XI; // TODO: get rid of these global variables
 
 /// Globular Form
@@ -89,6 +102,7 @@ public:
     Texture* getCenterTex(int);
     Texture* getGlobularTex();
     Texture* getColorTex();
+    Texture* getImpostorTex();
 
     static GlobularFormManager* get();
 
@@ -99,10 +113,11 @@ private:
     std::array<Texture*, Globular::GlobularBuckets> centerTex{ };
     std::unique_ptr<Texture> globularTex{ nullptr };
     std::unique_ptr<Texture> colorTex{ nullptr };
+    std::unique_ptr<Texture> impostorTex{ nullptr };
 };
 
 float
-relStarDensity(float eta)
+relStarDensity(float eta, float rRatioBin)
 {
     constexpr float RRatio_min = 50.11872336272722f; // 10 ** 1.7
 
@@ -120,7 +135,7 @@ relStarDensity(float eta)
      *  taking max(C_ref, CBin). Smaller c gives a shallower distribution!
      */
 
-    float rRatio = std::max(RRatio_min, RRatio);
+    float rRatio = std::max(RRatio_min, rRatioBin);
     float Xi = 1.0f / std::sqrt(1.0f + rRatio * rRatio);
     float XI2 = Xi * Xi;
     float rho2 = 1.0001f + eta * eta * rRatio * rRatio; //add 1e-4 as regulator near rho=0
@@ -128,6 +143,9 @@ relStarDensity(float eta)
     return ((std::log(rho2) + 4.0f * (1.0f - std::sqrt(rho2)) * Xi) / (rho2 - 1.0f) + XI2) / (1.0f - 2.0f * Xi + XI2);
 }
 
+// The texture functions are evaluated in parallel and must not depend on
+// global state, so there is an instance per bin of concentration
+template<int Form>
 void
 centerCloudTexEval(float u, float v, float /*w*/, std::uint8_t *pixel)
 {
@@ -135,8 +153,11 @@ centerCloudTexEval(float u, float v, float /*w*/, std::uint8_t *pixel)
      *  8 bins of King_1962 concentration, c = CBin, XI(CBin), RRatio(CBin).
      */
 
+    static const float rRatio = std::pow(10.0f, Globular::MinC + (static_cast<float>(Form) + 0.5f) * Globular::BinWidth);
+    static const float xi = 1.0f / std::sqrt(1.0f + rRatio * rRatio);
+
     // Skyplane projected King_1962 profile at center (rho = eta = 0):
-    float c2d = 1.0f - XI;
+    float c2d = 1.0f - xi;
 
     // eta^2 = u * u  + v * v = 1 is the biggest circle fitting into the quadratic
     // procedural texture. Hence clipping
@@ -144,7 +165,7 @@ centerCloudTexEval(float u, float v, float /*w*/, std::uint8_t *pixel)
 
     // eta = 1 corresponds to tidalRadius:
 
-    float rho   = eta  * RRatio;
+    float rho   = eta  * rRatio;
     float rho2  = 1.0f + rho * rho;
 
     // Skyplane projected King_1962 profile (Eq.(14)), vanishes for eta = 1:
@@ -153,9 +174,16 @@ centerCloudTexEval(float u, float v, float /*w*/, std::uint8_t *pixel)
     float profile_2d = (1.0f / std::sqrt(rho2) - 1.0f)/c2d + 1.0f;
     profile_2d = profile_2d * profile_2d;
 
-    *pixel = static_cast<std::uint8_t>(relStarDensity(eta) * profile_2d * 255.99f);
+    *pixel = static_cast<std::uint8_t>(relStarDensity(eta, rRatio) * profile_2d * 255.99f);
 }
 
+static_assert(Globular::GlobularBuckets == 8);
+constexpr std::array<ProceduralTexEval, Globular::GlobularBuckets> centerCloudTexEvals
+{
+    centerCloudTexEval<0>, centerCloudTexEval<1>, centerCloudTexEval<2>, centerCloudTexEval<3>,
+    centerCloudTexEval<4>, centerCloudTexEval<5>, centerCloudTexEval<6>, centerCloudTexEval<7>,
+};
+
 void
 colorTextureEval(float u, float /*v*/, float /*w*/, std::uint8_t *pixel)
 {
@@ -248,7 +276,7 @@ initGlobularData(gl::Buffer &bo, gl::VertexObject &vo, const GlobularForm::BlobV
         GlobularVtx vtx;
         vtx.position    = (b.position * 32767.99f).cast<short>();
         vtx.texCoord[0] = static_cast<std::uint8_t>(starSize * 255.99f);
-        vtx.texCoord[1] = static_cast<std::uint8_t>(relStarDensity(b.radius_2d) * 255.99f);
+        vtx.texCoord[1] = static_cast<std::uint8_t>(relStarDensity(b.radius_2d, RRatio) * 255.99f);
 
         /* Colors of normal globular stars are given by color profile.
          * Associate orange "Red Giant" stars with the largest sprite
@@ -389,6 +417,78 @@ globularTextureEval(float u, float v, float /*w*/, std::uint8_t *pixel)
     *pixel = static_cast<std::uint8_t>(lumi * 255.99f);
 }
 
+// Render the image of a globular seen from afar on the CPU: its central
+// cloud with the star sprites drawn at that distance in front, composited
+// as the tidal and globular shaders do at unit brightness.
+void
+renderImpostor(engine::Image &atlas, int form, const GlobularForm::BlobVector &blobs)
+{
+    std::array<std::array<std::uint8_t, 4>, 256> colors;
+    for (int i = 0; i < 256; ++i)
+        colorTextureEval((static_cast<float>(i) + 0.5f) / 128.0f - 1.0f, 0.0f, 0.0f, colors[i].data());
+
+    // Premultiplied colors and alpha
+    std::vector<Eigen::Vector4f> tile(kImpostorTileSize * kImpostorTileSize);
+    auto blend = [&tile](int x, int y, const std::array<std::uint8_t, 4> &color, float alpha)
+    {
+        if (x < 0 || y < 0 || x >= kImpostorTileSize || y >= kImpostorTileSize)
+            return;
+
+        Eigen::Vector4f src(color[0] / 255.0f * alpha, color[1] / 255.0f * alpha, color[2] / 255.0f * alpha, alpha);
+        Eigen::Vector4f &dst = tile[y * kImpostorTileSize + x];
+        dst = src + dst * (1.0f - alpha);
+    };
+
+    // The tidal quad spans [-1, 1] times the tidal size
+    for (int y = 0; y < kImpostorTileSize; ++y)
+    {
+        for (int x = 0; x < kImpostorTileSize; ++x)
+        {
+            float u = (static_cast<float>(x) + 0.5f) * 2.0f / static_cast<float>(kImpostorTileSize) - 1.0f;
+            float v = (static_cast<float>(y) + 0.5f) * 2.0f / static_cast<float>(kImpostorTileSize) - 1.0f;
+            std::uint8_t cloud;
+            centerCloudTexEvals[form](u, v, 0.0f, &cloud);
+            blend(x, y, colors[0], static_cast<float>(cloud) / 255.0f);
+        }
+    }
+
+    // The stars span [-0.5, 0.5] times the tidal size, their sprites are
+    // splatted bilinearly. The largest sprites are red giants.
+    float rRatio = std::pow(10.0f, Globular::MinC + (static_cast<float>(form) + 0.5f) * Globular::BinWidth);
+    auto nStars = std::min<std::size_t>(blobs.size(), kImpostorStars);
+    for (std::size_t i = 0; i < nStars; ++i)
+    {
+        const auto &b = blobs[i];
+        float alpha = std::min(1.0f, 1.0f - relStarDensity(b.radius_2d, rRatio));
+        float x = (b.position.x() * 0.5f + 0.5f) * static_cast<float>(kImpostorTileSize) - 0.5f;
+        float y = (b.position.z() * 0.5f + 0.5f) * static_cast<float>(kImpostorTileSize) - 0.5f;
+        auto x0 = static_cast<int>(std::floor(x));
+        auto y0 = static_cast<int>(std::floor(y));
+        float fx = x - static_cast<float>(x0);
+        float fy = y - static_cast<float>(y0);
+        blend(x0,     y0,     colors[255], alpha * (1.0f - fx) * (1.0f - fy));
+        blend(x0 + 1, y0,     colors[255], alpha * fx * (1.0f - fy));
+        blend(x0,     y0 + 1, colors[255], alpha * (1.0f - fx) * fy);
+        blend(x0 + 1, y0 + 1, colors[255], alpha * fx * fy);
+    }
+
+    int tileX = (form % kImpostorAtlasColumns) * kImpostorTileSize;
+    int tileY = (form / kImpostorAtlasColumns) * kImpostorTileSize;
+    for (int y = 0; y < kImpostorTileSize; ++y)
+    {
+        std::uint8_t *row = atlas.getPixelRow(tileY + y) + tileX * 4;
+        for (int x = 0; x < kImpostorTileSize; ++x, row += 4)
+        {
+            const Eigen::Vector4f &c = tile[y * kImpostorTileSize + x];
+            // Store straight colors for the GL_SRC_ALPHA blending of globulars
+            Eigen::Vector3f rgb = c.w() > 0.0f ? Eigen::Vector3f(c.head<3>() / c.w()) : Eigen::Vector3f::Zero();
+            for (int k = 0; k < 3; ++k)
+                row[k] = static_cast<std::uint8_t>(std::clamp(rgb[k], 0.0f, 1.0f) * 255.99f);
+            row[3] = static_cast<std::uint8_t>(std::clamp(c.w(), 0.0f, 1.0f) * 255.99f);
+        }
+    }
+}
+
 const GlobularForm*
 GlobularFormManager::getForm(int form) const
 {
@@ -404,7 +504,7 @@ GlobularFormManager::getCenterTex(int form)
     {
         centerTex[form] = CreateProceduralTexture(cntrTexWidth, cntrTexHeight,
                                                   engine::PixelFormat::Luminance,
-                                                  centerCloudTexEval).release();
+                                                  centerCloudTexEvals[form]).release();
     }
 
     assert(centerTex[form] != nullptr);
@@ -438,6 +538,26 @@ GlobularFormManager::getColorTex()
     return colorTex.get();
 }
 
+Texture*
+GlobularFormManager::getImpostorTex()
+{
+    if (impostorTex == nullptr)
+    {
+        engine::Image atlas(engine::PixelFormat::RGBA,
+                            kImpostorTileSize * kImpostorAtlasColumns,
+                            kImpostorTileSize * kImpostorAtlasRows);
+        static_assert(kImpostorAtlasColumns * kImpostorAtlasRows == Globular::GlobularBuckets);
+        for (int form = 0; form < static_cast<int>(globularForms.size()); ++form)
+            renderImpostor(atlas, form, globularForms[form].gblobs);
+
+        // The border of the tiles is transparent, so mipmaps don't bleed
+        // between them
+        impostorTex = std::make_unique<ImageTexture>(atlas, Texture::EdgeClamp, Texture::DefaultMipMaps);
+    }
+    assert(impostorTex != nullptr);
+    return impostorTex.get();
+}
+
 void
 GlobularFormManager::initializeForms()
 {
@@ -516,6 +636,13 @@ struct GlobularRenderer::Object
     const Globular *globular;
 };
 
+struct GlobularRenderer::ImpostorVertex
+{
+    Eigen::Vector3f             position;
+    Eigen::Vector2f             texCoord;
+    std::array<std::uint8_t, 4> color;
+};
+
 GlobularRenderer::GlobularRenderer(Renderer &renderer) :
     m_renderer(renderer)
 {
@@ -553,7 +680,7 @@ GlobularRenderer::render()
 
     GlobularFormManager* globularFormManager = GlobularFormManager::get();
 
-    glActiveTexture(GL_TEXTURE0);
+    gl::activeTexture(GL_TEXTURE0);
     globularFormManager->getColorTex()->bind();
 
     Renderer::PipelineState ps;
@@ -575,11 +702,115 @@ GlobularRenderer::render()
     glDisable(GL_POINT_SPRITE);
     glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
-    glActiveTexture(GL_TEXTURE0);
+
+    renderImpostors();
+    gl::activeTexture(GL_TEXTURE0);
+}
+
+void
+GlobularRenderer::addImpostor(const Object &obj, float tidalSize, float opacity)
+{
+    int form = obj.globular->getFormId();
+    Eigen::Vector2f tileOrigin(static_cast<float>(form % kImpostorAtlasColumns) / static_cast<float>(kImpostorAtlasColumns),
+                               static_cast<float>(form / kImpostorAtlasColumns) / static_cast<float>(kImpostorAtlasRows));
+    Eigen::Vector2f tileSize(1.0f / static_cast<float>(kImpostorAtlasColumns),
+                             1.0f / static_cast<float>(kImpostorAtlasRows));
+
+    // Same corners and color as the tidal quad, in the frame of the model
+    // view matrix
+    std::uint8_t alpha = static_cast<std::uint8_t>(std::clamp(2.0f * obj.brightness * opacity, 0.0f, 1.0f) * 255.99f);
+    auto corner = [&](float u, float v)
+    {
+        return ImpostorVertex
+        {
+            obj.offset + m_viewMat * Eigen::Vector3f(u, v, 0.0f) * tidalSize,
+            tileOrigin + tileSize.cwiseProduct(Eigen::Vector2f(u * 0.5f + 0.5f, v * 0.5f + 0.5f)),
+            { 255, 255, 255, alpha },
+        };
+    };
+
+    ImpostorVertex v0 = corner(-1.0f, -1.0f);
+    ImpostorVertex v1 = corner( 1.0f, -1.0f);
+    ImpostorVertex v2 = corner( 1.0f,  1.0f);
+    ImpostorVertex v3 = corner(-1.0f,  1.0f);
+    m_impostors.insert(m_impostors.end(), { v0, v1, v2, v0, v2, v3 });
 }
 
 void
-GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *globProg, const Object &obj) const
+GlobularRenderer::renderImpostors()
+{
+    if (m_impostors.empty())
+        return;
+
+    auto *prog = m_renderer.getShaderManager().getShader("globularimpostor");
+    if (prog == nullptr)
+    {
+        m_impostors.clear();
+        return;
+    }
+
+    // Vertices are appended to the ring buffer of the renderer when it has
+    // one, and the vertex object follows its reallocations
+    util::array_view<ImpostorVertex> vertices(m_impostors);
+    int first = 0;
+    const gl::Buffer *buffer;
+    int generation = -1;
+    if (gl::StreamBuffer *ring = m_renderer.getStreamBuffer(); ring != nullptr)
+    {
+        first = ring->write(vertices, sizeof(ImpostorVertex));
+        buffer = &ring->buffer();
+        generation = ring->generation();
+    }
+    else
+    {
+        if (m_impostorBo == nullptr)
+            m_impostorBo = std::make_unique<gl::Buffer>();
+        buffer = &m_impostorBo->bind().invalidateData().setData(vertices, gl::Buffer::BufferUsage::StreamDraw);
+    }
+
+    if (m_impostorVo == nullptr || m_impostorGeneration != generation)
+    {
+        m_impostorGeneration = generation;
+        m_impostorVo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Triangles);
+        m_impostorVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            3,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(ImpostorVertex),
+            offsetof(ImpostorVertex, position));
+        m_impostorVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::TextureCoord0AttributeIndex,
+            2,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(ImpostorVertex),
+            offsetof(ImpostorVertex, texCoord));
+        m_impostorVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::ColorAttributeIndex,
+            4,
+            gl::VertexObject::DataType::UnsignedByte,
+            true,
+            sizeof(ImpostorVertex),
+            offsetof(ImpostorVertex, color));
+    }
+
+    gl::activeTexture(GL_TEXTURE0);
+    GlobularFormManager::get()->getImpostorTex()->bind();
+
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getProjectionMatrix(), m_renderer.getModelViewMatrix());
+    prog->samplerParam("impostorTex") = 0;
+
+    m_impostorVo->draw(static_cast<int>(m_impostors.size()), first);
+    m_impostors.clear();
+}
+
+void
+GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *globProg, const Object &obj)
 {
     const Globular *globular = obj.globular;
     auto* globularFormManager = GlobularFormManager::get();
@@ -626,6 +857,19 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
 
     float tidalSize = 2.0f * globular->getBoundingSphereRadius();
 
+    /* Small globulars are drawn as impostors, which are batched and drawn
+     * after the other globulars. They cross-fade with the full rendering
+     * between kImpostorSizeInPixels and twice that size.
+     */
+
+    float impostorOpacity = std::clamp(2.0f - diskSizeInPixels / kImpostorSizeInPixels, 0.0f, 1.0f);
+    if (impostorOpacity > 0.0f)
+        addImpostor(obj, tidalSize, impostorOpacity);
+    if (impostorOpacity == 1.0f)
+        return;
+
+    float brightness = obj.brightness * (1.0f - impostorOpacity);
+
     /* Render central cloud sprite (centerTex). It fades away when
      * distance from center or resolution increases sufficiently.
      */
@@ -638,7 +882,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
         form->GLDataInitialized = true;
     }
 
-    glActiveTexture(GL_TEXTURE1);
+    gl::activeTexture(GL_TEXTURE1);
     globularFormManager->getCenterTex(obj.globular->getFormId())->bind();
 
     Eigen::Matrix4f mv = math::translate(m_renderer.getModelViewMatrix(), obj.offset);
@@ -651,7 +895,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
     tidalProg->use();
     tidalProg->setMVPMatrices(pr, mv);
     tidalProg->mat3Param("viewMat")      = m_viewMat;
-    tidalProg->floatParam("brightness")  = obj.brightness;
+    tidalProg->floatParam("brightness")  = brightness;
     tidalProg->floatParam("pixelWeight") = pixelWeight;
     tidalProg->floatParam("tidalSize")   = tidalSize;
     tidalProg->samplerParam("colorTex")  = 0;
@@ -665,7 +909,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
      * This RGBA texture fades away when resolution decreases (e.g. via automag!),
      * or when distance from globular center decreases.
      */
-    glActiveTexture(GL_TEXTURE2);
+    gl::activeTexture(GL_TEXTURE2);
     GlobularFormManager::get()->getGlobularTex()->bind();
 
     Eigen::Matrix3f mx = obj.globular->getOrientation().conjugate().toRotationMatrix() * Eigen::Scaling(tidalSize);
@@ -678,7 +922,7 @@ GlobularRenderer::renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *gl
     globProg->setMVPMatrices(pr, mv);
     globProg->mat3Param("m")            = mx;
     globProg->vec3Param("offset")       = obj.offset;
-    globProg->floatParam("brightness")  = obj.brightness;
+    globProg->floatParam("brightness")  = brightness;
     globProg->floatParam("pixelWeight") = pixelWeight;
     globProg->floatParam("scale")       = size * static_cast<float>(m_renderer.getScreenDpi()) / 96.0f;
     globProg->samplerParam("colorTex")  = 0;
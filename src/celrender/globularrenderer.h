@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <Eigen/Core>
@@ -20,6 +21,12 @@ class Globular;
 class Renderer;
 class Texture;
 
+namespace celestia::gl
+{
+class Buffer;
+class VertexObject;
+} // namespace celestia::gl
+
 namespace celestia::render
 {
 
@@ -37,13 +44,21 @@ public:
 
 private:
     struct Object;
+    struct ImpostorVertex;
 
-    void renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *globProg, const Object &obj) const;
+    void renderForm(CelestiaGLProgram *tidalProg, CelestiaGLProgram *globProg, const Object &obj);
+    void addImpostor(const Object &obj, float tidalSize, float opacity);
+    void renderImpostors();
 
     // global state
     std::vector<Object> m_objects;
     Renderer           &m_renderer;
 
+    std::vector<ImpostorVertex>        m_impostors;
+    std::unique_ptr<gl::Buffer>        m_impostorBo;
+    std::unique_ptr<gl::VertexObject>  m_impostorVo;
+    int                                m_impostorGeneration{ -1 };
+
     // per-frame state
     Eigen::Quaternionf m_viewerOrientation{ Eigen::Quaternionf::Identity() };
     Eigen::Matrix3f    m_viewMat{ Eigen::Matrix3f::Identity() };
@@ -18,6 +18,7 @@
 #include <celengine/render.h>
 #include <celengine/shadermanager.h>
 #include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
 #include <celrender/gl/vertexobject.h>
 
 namespace celestia::render
@@ -62,21 +63,21 @@ LineRenderer::color_type() const
 void
 LineRenderer::draw_triangles(int count, int offset) const
 {
-    m_trVO->draw(gl::VertexObject::Primitive::Triangles, count, offset);
+    m_trVO->draw(gl::VertexObject::Primitive::Triangles, count, m_ringFirst + offset);
 }
 
 //! Draw triangle strips.
 void
 LineRenderer::draw_triangle_strip(int count, int offset) const
 {
-    m_trVO->draw(gl::VertexObject::Primitive::TriangleStrip, count, offset);
+    m_trVO->draw(gl::VertexObject::Primitive::TriangleStrip, count, m_ringFirst + offset);
 }
 
 //! Draw lines defained with segments.
 void
 LineRenderer::draw_lines(int count, int offset) const
 {
-    m_lnVO->draw(static_cast<gl::VertexObject::Primitive>(m_primType), count, offset);
+    m_lnVO->draw(static_cast<gl::VertexObject::Primitive>(m_primType), count, m_ringFirst + offset);
 }
 
 //! Enable GPU shader and set it's uniform values. Set line width.
@@ -110,17 +111,35 @@ LineRenderer::setup_shader()
     }
 }
 
+//! Return the ring buffer shared by renderers updating vertices, nullptr for static lines.
+gl::StreamBuffer*
+LineRenderer::stream_buffer() const
+{
+    return m_storageType == StorageType::Static ? nullptr : m_renderer.getStreamBuffer();
+}
+
 //! Allocate GPU memory for vertices and define its layout.
 void
 LineRenderer::create_vbo_lines()
 {
     m_lnVO = std::make_unique<gl::VertexObject>();
-    m_lnBO = std::make_unique<gl::Buffer>();
 
-    m_lnBO->bind().setData(m_vertices, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+    const gl::Buffer* buffer;
+    if (const gl::StreamBuffer* ring = stream_buffer(); ring != nullptr)
+    {
+        buffer = &ring->buffer();
+        m_lnGeneration = ring->generation();
+    }
+    else
+    {
+        m_lnBO = std::make_unique<gl::Buffer>();
+        m_lnBO->bind().setData(m_vertices, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+        buffer = m_lnBO.get();
+        m_lnGeneration = -1;
+    }
 
     m_lnVO->addVertexBuffer(
-        *m_lnBO,
+        *buffer,
         CelestiaGLProgram::VertexCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
@@ -131,7 +150,7 @@ LineRenderer::create_vbo_lines()
     if (color_count() != 0)
     {
         m_lnVO->addVertexBuffer(
-            *m_lnBO,
+            *buffer,
             CelestiaGLProgram::ColorAttributeIndex,
             color_count(),
             color_type() == VF_UBYTE ? gl::VertexObject::DataType::UnsignedByte : gl::VertexObject::DataType::Float,
@@ -145,7 +164,15 @@ LineRenderer::create_vbo_lines()
 void
 LineRenderer::setup_vbo_lines()
 {
-    if (m_lnVO != nullptr)
+    if (gl::StreamBuffer* ring = stream_buffer(); ring != nullptr)
+    {
+        // Append the vertices to the ring, a reallocation of the ring
+        // requires new vertex objects
+        m_ringFirst = ring->write(m_vertices, sizeof(m_vertices[0]));
+        if (m_lnVO == nullptr || m_lnGeneration != ring->generation())
+            create_vbo_lines();
+    }
+    else if (m_lnVO != nullptr)
     {
         if (m_storageType != StorageType::Static)
         {
@@ -163,8 +190,14 @@ void
 LineRenderer::create_vbo_triangles()
 {
     m_trVO = std::make_unique<gl::VertexObject>();
-    m_trBO = std::make_unique<gl::Buffer>();
-    m_trBO->bind();
+
+    // Data in the ring buffer are written by setup_vbo_triangles()
+    const gl::StreamBuffer* ring = stream_buffer();
+    if (ring == nullptr)
+    {
+        m_trBO = std::make_unique<gl::Buffer>();
+        m_trBO->bind();
+    }
 
     GLsizei                    stride;
     std::array<std::size_t, 4> offset;
@@ -179,8 +212,11 @@ LineRenderer::create_vbo_triangles()
             offsetof(LineSegment, point1) + offsetof(Vertex, color)
         };
 
-        m_trBO->setData(m_segments, static_cast<gl::Buffer::BufferUsage>(m_storageType));
-        m_segments.clear();
+        if (ring == nullptr)
+        {
+            m_trBO->setData(m_segments, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+            m_segments.clear();
+        }
     }
     else
     {
@@ -193,11 +229,18 @@ LineRenderer::create_vbo_triangles()
             offsetof(LineVertex, point) + offsetof(Vertex, color)
         };
 
-        m_trBO->setData(m_verticesTr, static_cast<gl::Buffer::BufferUsage>(m_storageType));
-        m_verticesTr.clear();
+        if (ring == nullptr)
+        {
+            m_trBO->setData(m_verticesTr, static_cast<gl::Buffer::BufferUsage>(m_storageType));
+            m_verticesTr.clear();
+        }
     }
+
+    const gl::Buffer& buffer = ring != nullptr ? ring->buffer() : *m_trBO;
+    m_trGeneration = ring != nullptr ? ring->generation() : -1;
+
     m_trVO->addVertexBuffer(
-        *m_trBO,
+        buffer,
         CelestiaGLProgram::VertexCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
@@ -205,7 +248,7 @@ LineRenderer::create_vbo_triangles()
         stride,
         static_cast<GLsizeiptr>(offset[0]));
     m_trVO->addVertexBuffer(
-        *m_trBO,
+        buffer,
         CelestiaGLProgram::NextVCoordAttributeIndex,
         pos_count(),
         gl::VertexObject::DataType::Float,
@@ -213,7 +256,7 @@ LineRenderer::create_vbo_triangles()
         stride,
         static_cast<GLsizeiptr>(offset[1]));
     m_trVO->addVertexBuffer(
-        *m_trBO,
+        buffer,
         CelestiaGLProgram::ScaleFactorAttributeIndex,
         1,
         gl::VertexObject::DataType::Float,
@@ -223,7 +266,7 @@ LineRenderer::create_vbo_triangles()
     if (color_count() != 0)
     {
         m_trVO->addVertexBuffer(
-            *m_trBO,
+            buffer,
             CelestiaGLProgram::ColorAttributeIndex,
             color_count(),
             color_type() == VF_UBYTE ? gl::VertexObject::DataType::UnsignedByte : gl::VertexObject::DataType::Float,
@@ -237,7 +280,16 @@ LineRenderer::create_vbo_triangles()
 void
 LineRenderer::setup_vbo_triangles()
 {
-    if (m_trVO != nullptr)
+    if (gl::StreamBuffer* ring = stream_buffer(); ring != nullptr)
+    {
+        if (m_primType == PrimType::Lines || (m_hints & PREFER_SIMPLE_TRIANGLES) != 0)
+            m_ringFirst = ring->write(m_segments, sizeof(LineSegment));
+        else
+            m_ringFirst = ring->write(m_verticesTr, sizeof(LineVertex));
+        if (m_trVO == nullptr || m_trGeneration != ring->generation())
+            create_vbo_triangles();
+    }
+    else if (m_trVO != nullptr)
     {
         if (m_storageType != StorageType::Static)
         {
@@ -442,6 +494,8 @@ LineRenderer::finish()
         m_lnBO->unbind();
     if (m_trBO != nullptr)
         m_trBO->unbind();
+    if (stream_buffer() != nullptr)
+        gl::Buffer::unbind(gl::Buffer::TargetHint::Array);
     m_inUse = false;
     m_prog = nullptr;
 }
@@ -25,6 +25,7 @@ struct Matrices;
 namespace celestia::gl
 {
 class Buffer;
+class StreamBuffer;
 class VertexObject;
 }
 
@@ -258,6 +259,7 @@ private:
     void setup_vbo_lines();
     void create_vbo_triangles();
     void setup_vbo_triangles();
+    gl::StreamBuffer* stream_buffer() const;
     void triangulate();
     void triangulate_segments();
     void triangulate_vertices_as_segments();
@@ -280,6 +282,12 @@ private:
     std::unique_ptr<gl::VertexObject>   m_trVO;
     std::unique_ptr<gl::Buffer>         m_lnBO;
     std::unique_ptr<gl::Buffer>         m_trBO;
+    // Generations of the ring buffer the vertex objects read, -1 for the
+    // buffers above
+    int                                 m_lnGeneration{ -1 };
+    int                                 m_trGeneration{ -1 };
+    // First vertex of the data in the ring buffer
+    int                                 m_ringFirst{ 0 };
     const Renderer                     &m_renderer;
     float                               m_width;
     PrimType                            m_primType;
@@ -9,12 +9,21 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <celengine/glsupport.h>
 #include <celengine/meshmanager.h>
 #include <celengine/nebula.h>
 #include <celengine/rendcontext.h>
 #include <celengine/render.h>
+#include <celengine/shadermanager.h>
 #include <celmath/geomutil.h>
 #include <celmath/vecgl.h>
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/streambuffer.h>
+#include <celrender/gl/vertexobject.h>
+#include <celutil/array_view.h>
 #include <celutil/reshandle.h>
 #include "nebularenderer.h"
 
@@ -24,8 +33,9 @@ namespace celestia::render
 
 struct NebulaRenderer::Object
 {
-    Object(const Eigen::Vector3f &offset, float nearZ, float farZ, const Nebula *nebula) :
+    Object(const Eigen::Vector3f &offset, float brightness, float nearZ, float farZ, const Nebula *nebula) :
         offset(offset),
+        brightness(brightness),
         nearZ(nearZ),
         farZ(farZ),
         nebula(nebula)
@@ -33,11 +43,19 @@ struct NebulaRenderer::Object
     }
 
     Eigen::Vector3f offset; // distance to the nebula
+    float           brightness;
     float           nearZ;  // if nearZ != & farZ != then use custom projection matrix
     float           farZ;
     const Nebula   *nebula;
 };
 
+struct NebulaRenderer::StandInVertex
+{
+    Eigen::Vector3f             position;
+    Eigen::Vector2f             texCoord;
+    std::array<std::uint8_t, 4> color;
+};
+
 NebulaRenderer::NebulaRenderer(Renderer &renderer) :
     m_renderer(renderer)
 {
@@ -55,14 +73,23 @@ NebulaRenderer::update(const Eigen::Quaternionf &viewerOrientation, float pixelS
 }
 
 void
-NebulaRenderer::add(const Nebula *nebula, const Eigen::Vector3f &offset, float /*brightness*/, float nearZ, float farZ)
+NebulaRenderer::add(const Nebula *nebula, const Eigen::Vector3f &offset, float brightness, float nearZ, float farZ)
+{
+    m_objects.emplace_back(offset, brightness, nearZ, farZ, nebula);
+}
+
+void
+NebulaRenderer::setUnloadTime(double seconds)
 {
-    m_objects.emplace_back(offset, nearZ, farZ, nebula);
+    m_unloadTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(seconds));
 }
 
 void
 NebulaRenderer::render()
 {
+    m_now = std::chrono::steady_clock::now();
+
     // draw more distant objects first
     std::sort(m_objects.begin(), m_objects.end(),
         [](const auto &o1, const auto &o2){ return o1.offset.squaredNorm() > o2.offset.squaredNorm(); });
@@ -71,16 +98,29 @@ NebulaRenderer::render()
         renderNebula(obj);
 
     m_objects.clear();
+    renderStandIns();
+    unloadUnseen();
 }
 
 void
-NebulaRenderer::renderNebula(const Object &obj) const
+NebulaRenderer::renderNebula(const Object &obj)
 {
-    Geometry *g = nullptr;
-    if (auto geometry = obj.nebula->getGeometry(); geometry != InvalidResource)
-        g = GetGeometryManager()->find(geometry);
+    auto geometry = obj.nebula->getGeometry();
+    if (geometry == InvalidResource)
+        return;
+
+    m_lastSeen.insert_or_assign(geometry, m_now);
+
+    // The mesh is loaded in the background if the geometry manager has
+    // loader threads
+    GeometryManager *geometryManager = GetGeometryManager();
+    Geometry *g = geometryManager->findAsync(geometry);
     if (g == nullptr)
+    {
+        if (geometryManager->getState(geometry) == ResourceState::Loading)
+            addStandIn(obj);
         return;
+    }
 
     Eigen::Matrix4f pr;
     if (obj.nearZ != 0.0f && obj.farZ != 0.0f)
@@ -103,4 +143,125 @@ NebulaRenderer::renderNebula(const Object &obj) const
     g->render(rc);
 }
 
+void
+NebulaRenderer::addStandIn(const Object &obj)
+{
+    float radius = obj.nebula->getRadius();
+    float distance = obj.offset.norm();
+    if (radius < m_pixelSize * distance)
+        return;
+
+    // A glow facing the viewer, about as bright as the mesh in the distance
+    std::uint8_t alpha = static_cast<std::uint8_t>(std::clamp(0.5f * obj.brightness, 0.0f, 1.0f) * 255.99f);
+    Eigen::Matrix3f viewMat = m_viewerOrientation.conjugate().toRotationMatrix();
+    auto corner = [&](float u, float v)
+    {
+        return StandInVertex
+        {
+            obj.offset + viewMat * Eigen::Vector3f(u, v, 0.0f) * radius,
+            Eigen::Vector2f(u, v),
+            { 255, 255, 255, alpha },
+        };
+    };
+
+    StandInVertex v0 = corner(-1.0f, -1.0f);
+    StandInVertex v1 = corner( 1.0f, -1.0f);
+    StandInVertex v2 = corner( 1.0f,  1.0f);
+    StandInVertex v3 = corner(-1.0f,  1.0f);
+    m_standIns.insert(m_standIns.end(), { v0, v1, v2, v0, v2, v3 });
+}
+
+void
+NebulaRenderer::renderStandIns()
+{
+    if (m_standIns.empty())
+        return;
+
+    auto *prog = m_renderer.getShaderManager().getShader("nebulastandin");
+    if (prog == nullptr)
+    {
+        m_standIns.clear();
+        return;
+    }
+
+    // Vertices are appended to the ring buffer of the renderer when it has
+    // one, and the vertex object follows its reallocations
+    util::array_view<StandInVertex> vertices(m_standIns);
+    int first = 0;
+    const gl::Buffer *buffer;
+    int generation = -1;
+    if (gl::StreamBuffer *ring = m_renderer.getStreamBuffer(); ring != nullptr)
+    {
+        first = ring->write(vertices, sizeof(StandInVertex));
+        buffer = &ring->buffer();
+        generation = ring->generation();
+    }
+    else
+    {
+        if (m_standInBo == nullptr)
+            m_standInBo = std::make_unique<gl::Buffer>();
+        buffer = &m_standInBo->bind().invalidateData().setData(vertices, gl::Buffer::BufferUsage::StreamDraw);
+    }
+
+    if (m_standInVo == nullptr || m_standInGeneration != generation)
+    {
+        m_standInGeneration = generation;
+        m_standInVo = std::make_unique<gl::VertexObject>(gl::VertexObject::Primitive::Triangles);
+        m_standInVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            3,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(StandInVertex),
+            offsetof(StandInVertex, position));
+        m_standInVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::TextureCoord0AttributeIndex,
+            2,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(StandInVertex),
+            offsetof(StandInVertex, texCoord));
+        m_standInVo->addVertexBuffer(
+            *buffer,
+            CelestiaGLProgram::ColorAttributeIndex,
+            4,
+            gl::VertexObject::DataType::UnsignedByte,
+            true,
+            sizeof(StandInVertex),
+            offsetof(StandInVertex, color));
+    }
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
+    m_renderer.setPipelineState(ps);
+
+    prog->use();
+    prog->setMVPMatrices(m_renderer.getProjectionMatrix(), m_renderer.getModelViewMatrix());
+
+    m_standInVo->draw(static_cast<int>(m_standIns.size()), first);
+    m_standIns.clear();
+}
+
+void
+NebulaRenderer::unloadUnseen()
+{
+    if (m_unloadTime == std::chrono::steady_clock::duration::zero())
+        return;
+
+    for (auto iter = m_lastSeen.begin(); iter != m_lastSeen.end();)
+    {
+        if (m_now - iter->second < m_unloadTime)
+        {
+            ++iter;
+            continue;
+        }
+
+        GetGeometryManager()->unload(iter->first);
+        iter = m_lastSeen.erase(iter);
+    }
+}
+
 } // namespace celestia::render
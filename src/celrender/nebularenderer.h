@@ -10,13 +10,26 @@
 
 #pragma once
 
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celutil/reshandle.h>
+
 class CelestiaGLProgram;
 class Renderer;
 class Nebula;
 
+namespace celestia::gl
+{
+class Buffer;
+class VertexObject;
+} // namespace celestia::gl
+
 namespace celestia::render
 {
 
@@ -32,15 +45,35 @@ public:
 
     void render();
 
+    // Release the meshes of nebulae which haven't been seen for this many
+    // seconds, 0 to keep them
+    void setUnloadTime(double seconds);
+
 private:
     struct Object;
+    struct StandInVertex;
 
-    void renderNebula(const Object &obj) const;
+    void renderNebula(const Object &obj);
+    void addStandIn(const Object &obj);
+    void renderStandIns();
+    void unloadUnseen();
 
     // global state
     std::vector<Object> m_objects;
     Renderer           &m_renderer;
 
+    // Meshes loaded in the background are replaced by a glow until they're
+    // ready
+    std::vector<StandInVertex>         m_standIns;
+    std::unique_ptr<gl::Buffer>        m_standInBo;
+    std::unique_ptr<gl::VertexObject>  m_standInVo;
+    int                                m_standInGeneration{ -1 };
+
+    // When the mesh of each nebula was last used
+    std::map<ResourceHandle, std::chrono::steady_clock::time_point> m_lastSeen;
+    std::chrono::steady_clock::duration m_unloadTime{ 0 };
+    std::chrono::steady_clock::time_point m_now;
+
     // per-frame state
     Eigen::Quaternionf  m_viewerOrientation{ Eigen::Quaternionf::Identity() };
     float               m_pixelSize{ 1.0f };
@@ -79,6 +79,28 @@ void CommandWait::process(ExecutionEnvironment& /*unused*/, double /*unused*/, d
 }
 
 
+////////////////
+// Object paths
+
+ObjectPath::ObjectPath(std::string _path) : path(std::move(_path))
+{
+}
+
+Selection ObjectPath::resolve(ExecutionEnvironment& env) const
+{
+    const Simulation* sim = env.getSimulation();
+    Selection currentSelection = sim->getSelection();
+    const SolarSystem* nearestSolarSystem = sim->getNearestSolarSystem();
+    if (!resolved.empty() && currentSelection == selection && nearestSolarSystem == solarSystem)
+        return resolved;
+
+    resolved = sim->findObjectFromPath(path);
+    selection = currentSelection;
+    solarSystem = nearestSolarSystem;
+    return resolved;
+}
+
+
 ////////////////
 // Select command: select a body
 
@@ -88,7 +110,7 @@ CommandSelect::CommandSelect(std::string _target) : target(std::move(_target))
 
 void CommandSelect::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     env.getSimulation()->setSelection(sel);
 }
 
@@ -245,10 +267,10 @@ CommandSetFrame::CommandSetFrame(ObserverFrame::CoordinateSystem _coordSys,
 
 void CommandSetFrame::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection ref = env.getSimulation()->findObjectFromPath(refObjectName);
+    Selection ref = refObjectName.resolve(env);
     Selection target;
     if (coordSys == ObserverFrame::PhaseLock)
-        target = env.getSimulation()->findObjectFromPath(targetObjectName);
+        target = targetObjectName.resolve(env);
     env.getSimulation()->setFrame(coordSys, ref, target);
 }
 
@@ -608,7 +630,7 @@ CommandMark::CommandMark(std::string _target,
 
 void CommandMark::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     if (sel.empty())
         return;
 
@@ -631,7 +653,7 @@ CommandUnmark::CommandUnmark(std::string _target) :
 
 void CommandUnmark::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     if (sel.empty())
         return;
 
@@ -661,12 +683,12 @@ CommandPreloadTextures::CommandPreloadTextures(std::string _name) :
 
 void CommandPreloadTextures::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection target = env.getSimulation()->findObjectFromPath(name);
+    Selection target = name.resolve(env);
     if (target.body() == nullptr)
         return;
 
-    if (env.getRenderer() != nullptr)
-        env.getRenderer()->loadTextures(target.body());
+    if (Renderer* renderer = env.getRenderer(); renderer != nullptr)
+        env.getCelestiaCore()->callOnRenderThread([&] { renderer->loadTextures(target.body()); });
 }
 
 
@@ -797,7 +819,7 @@ CommandSetRadius::CommandSetRadius(std::string _object, double _radius) :
 
 void CommandSetRadius::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(object);
+    Selection sel = object.resolve(env);
     if (sel.body() == nullptr)
         return;
 
@@ -1088,7 +1110,7 @@ CommandSetRingsTexture::CommandSetRingsTexture(std::string _object,
 
 void CommandSetRingsTexture::processInstantaneous(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(object);
+    Selection sel = object.resolve(env);
     if (sel.body() != nullptr &&
         sel.body()->getRings() != nullptr &&
         !textureName.empty())
@@ -26,8 +26,11 @@
 #include <celcompat/filesystem.h>
 #include <celengine/marker.h>
 #include <celengine/observer.h>
+#include <celengine/selection.h>
 #include <celutil/color.h>
 
+class SolarSystem;
+
 namespace celestia::scripts
 {
 
@@ -46,6 +49,27 @@ class Command
 using CommandSequence = std::vector<std::unique_ptr<Command>>;
 
 
+// The path of an object named by a command. Paths are resolved relative to
+// the selection and the nearest solar system, so the object found is kept
+// and reused as long as both are the same as when it was found; objects
+// aren't deleted from the universe, so the kept selection stays valid when
+// the sequence is run again. Unresolved paths are looked up every time, as
+// the object may have been added since.
+class ObjectPath
+{
+ public:
+    explicit ObjectPath(std::string _path);
+
+    Selection resolve(ExecutionEnvironment&) const;
+
+ private:
+    std::string path;
+    mutable Selection resolved;
+    mutable Selection selection;
+    mutable const SolarSystem* solarSystem{ nullptr };
+};
+
+
 class InstantaneousCommand : public Command
 {
  public:
@@ -93,7 +117,7 @@ class CommandSelect : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectPath target;
 };
 
 
@@ -225,8 +249,8 @@ class CommandSetFrame : public InstantaneousCommand
 
  private:
     ObserverFrame::CoordinateSystem coordSys;
-    std::string refObjectName;
-    std::string targetObjectName;
+    ObjectPath refObjectName;
+    ObjectPath targetObjectName;
 };
 
 
@@ -559,7 +583,7 @@ class CommandPreloadTextures : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string name;
+    ObjectPath name;
 };
 
 
@@ -572,7 +596,7 @@ class CommandMark : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectPath target;
     celestia::MarkerRepresentation rep;
     bool occludable;
 };
@@ -587,7 +611,7 @@ class CommandUnmark : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectPath target;
 };
 
 
@@ -682,7 +706,7 @@ class CommandSetRadius : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string object;
+    ObjectPath object;
     double radius;
 };
 
@@ -800,7 +824,8 @@ class CommandSetRingsTexture : public InstantaneousCommand
     void processInstantaneous(ExecutionEnvironment&) override;
 
  private:
-    std::string object, textureName, path;
+    ObjectPath object;
+    std::string textureName, path;
 };
 
 } // end namespace celestia::scripts
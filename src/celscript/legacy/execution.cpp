@@ -15,6 +15,13 @@ namespace celestia::scripts
 {
 
 Execution::Execution(CommandSequence&& cmd, ExecutionEnvironment& _env) :
+    commandSequence(std::make_shared<const CommandSequence>(std::move(cmd))),
+    env(_env)
+{
+}
+
+
+Execution::Execution(std::shared_ptr<const CommandSequence> cmd, ExecutionEnvironment& _env) :
     commandSequence(std::move(cmd)),
     env(_env)
 {
@@ -32,9 +39,9 @@ bool Execution::tick(double dt)
         return false;
     }
 
-    while (dt > 0.0 && currentCommand < commandSequence.size())
+    while (dt > 0.0 && currentCommand < commandSequence->size())
     {
-        Command* cmd = commandSequence[currentCommand].get();
+        Command* cmd = (*commandSequence)[currentCommand].get();
 
         double timeLeft = cmd->getDuration() - commandTime;
         if (dt >= timeLeft)
@@ -52,7 +59,7 @@ bool Execution::tick(double dt)
         }
     }
 
-    return currentCommand == commandSequence.size();
+    return currentCommand == commandSequence->size();
 }
 
 }
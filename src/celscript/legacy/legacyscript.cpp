@@ -11,6 +11,8 @@
 
 #include <fstream>
 #include <istream>
+#include <system_error>
+#include <utility>
 
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
@@ -79,10 +81,16 @@ bool LegacyScript::load(std::istream &scriptfile, const fs::path &/*path*/, std:
             errorMsg = errors[0];
         return false;
     }
-    m_runningScript = std::make_unique<Execution>(std::move(script), *m_execEnv);
+    load(std::make_shared<const CommandSequence>(std::move(script)));
     return true;
 }
 
+void LegacyScript::load(std::shared_ptr<const CommandSequence> commands)
+{
+    m_commands = std::move(commands);
+    m_runningScript = std::make_unique<Execution>(m_commands, *m_execEnv);
+}
+
 bool LegacyScript::tick(double dt)
 {
     return m_runningScript->tick(dt);
@@ -95,6 +103,24 @@ bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
 
 std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
 {
+    std::error_code ec;
+    std::uintmax_t fileSize = fs::file_size(path, ec);
+    fs::file_time_type writeTime;
+    if (!ec)
+        writeTime = fs::last_write_time(path, ec);
+    bool haveStamp = !ec;
+
+    if (auto it = m_compiledScripts.find(path); it != m_compiledScripts.end())
+    {
+        if (haveStamp && it->second.fileSize == fileSize && it->second.writeTime == writeTime)
+        {
+            auto script = std::make_unique<LegacyScript>(appCore());
+            script->load(it->second.commands);
+            return script;
+        }
+        m_compiledScripts.erase(it);
+    }
+
     std::ifstream scriptfile(path);
     if (!scriptfile.good())
     {
@@ -111,6 +137,9 @@ std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
         appCore()->fatalError(errorMsg);
         return nullptr;
     }
+
+    if (haveStamp)
+        m_compiledScripts.try_emplace(path, CompiledScript{ fileSize, writeTime, script->m_commands });
     return script;
 }
 
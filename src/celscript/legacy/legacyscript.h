@@ -9,12 +9,15 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 
 #include <celcompat/filesystem.h>
 #include <celscript/common/script.h>
+#include "command.h"
 
 
 class CelestiaCore;
@@ -32,11 +35,14 @@ class LegacyScript : public IScript
     ~LegacyScript() override = default;
 
     bool load(std::istream&, const fs::path&, std::string&);
+    // Run a command sequence parsed earlier
+    void load(std::shared_ptr<const CommandSequence>);
 
     bool tick(double) override;
 
  private:
     CelestiaCore *m_appCore;
+    std::shared_ptr<const CommandSequence> m_commands;
     std::unique_ptr<Execution> m_runningScript;
     std::unique_ptr<ExecutionEnvironment> m_execEnv;
 
@@ -56,6 +62,21 @@ class LegacyScriptPlugin : public IScriptPlugin
 
     bool isOurFile(const fs::path&) const override;
     std::unique_ptr<IScript> loadScript(const fs::path&) override;
+
+ private:
+    // A script parsed earlier, and the size and modification time of its
+    // file when it was parsed
+    struct CompiledScript
+    {
+        std::uintmax_t fileSize;
+        fs::file_time_type writeTime;
+        std::shared_ptr<const CommandSequence> commands;
+    };
+
+    // Scripts run again, like a looping show, reuse their commands unless
+    // the file changed, so they aren't parsed again and the objects the
+    // commands resolved are kept
+    std::map<fs::path, CompiledScript> m_compiledScripts;
 };
 
 } // end namespace celestia::scripts
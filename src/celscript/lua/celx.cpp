@@ -12,8 +12,11 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
 #include <map>
@@ -28,6 +31,7 @@
 #include <celengine/timelinephase.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/memoryaccounting.h>
 #include <celutil/stringutils.h>
 #include <celestia/celestiacore.h>
 #include <celestia/hud.h>
@@ -46,6 +50,7 @@
 #include "celx_celestia.h"
 #include "celx_gl.h"
 #include "celx_category.h"
+#include "celx_worker.h"
 
 
 using namespace Eigen;
@@ -69,12 +74,18 @@ static constexpr std::array CelxClassNames
     "class_texture"sv,
     "class_phase"sv,
     "class_category"sv,
+    "class_worker"sv,
+    "class_vertexarray"sv,
 };
 
 // Maximum timeslice a script may run without
 // returning control to celestia
 static const double MaxTimeslice = 5.0;
 
+// Default time a script runs in a tick before it's suspended until the
+// next one, so that long computations don't stall the frames
+static const double DefaultTickBudget = 0.02;
+
 // names of callback-functions in Lua:
 const char* KbdCallback = "celestia_keyboard_callback";
 const char* CleanupCallback = "celestia_cleanup_callback";
@@ -100,9 +111,9 @@ int lua_isinteger(lua_State *L, int index)
 #endif
 
 
-static void openLuaLibrary(lua_State* l,
-                           const char* name,
-                           lua_CFunction func)
+void openLuaLibrary(lua_State* l,
+                    const char* name,
+                    lua_CFunction func)
 {
 #if LUA_VERSION_NUM >= 502
     luaL_requiref(l, name, func, 1);
@@ -113,17 +124,67 @@ static void openLuaLibrary(lua_State* l,
 #endif
 }
 
+namespace
+{
+
+// The allocator of luaL_newstate, also accounting the memory of the scripts
+void* trackedLuaAlloc(void* /*ud*/, void* ptr, std::size_t osize, std::size_t nsize)
+{
+    using celestia::util::MemoryTag;
+
+    // When ptr is nullptr, osize is the type of the object being created
+    if (ptr != nullptr)
+        celestia::util::RemoveMemory(MemoryTag::Scripts, osize);
+
+    if (nsize == 0)
+    {
+        std::free(ptr); //NOSONAR
+        return nullptr;
+    }
+
+    void* block = std::realloc(ptr, nsize); //NOSONAR
+    if (block != nullptr)
+        celestia::util::AddMemory(MemoryTag::Scripts, nsize);
+    else if (ptr != nullptr)
+        celestia::util::AddMemory(MemoryTag::Scripts, osize);
+    return block;
+}
+
+} // end unnamed namespace
+
+// Account the memory of a new Lua state to the scripts when the memory
+// accounting is compiled in. The memory allocated so far is taken from
+// the garbage collector's count.
+void Celx_TrackMemory(lua_State* l)
+{
+    if constexpr (!celestia::util::MemoryAccountingEnabled)
+        return;
+
+    auto kbytes = static_cast<std::size_t>(lua_gc(l, LUA_GCCOUNT, 0));
+    auto bytes = static_cast<std::size_t>(lua_gc(l, LUA_GCCOUNTB, 0));
+    celestia::util::AddMemory(celestia::util::MemoryTag::Scripts, kbytes * 1024 + bytes);
+    lua_setallocf(l, trackedLuaAlloc, nullptr);
+}
+
 // Push a class name onto the Lua stack
 void PushClass(lua_State* l, int id)
 {
     lua_pushlstring(l, CelxClassNames[id].data(), CelxClassNames[id].size());
 }
 
+// Push the metatable of a class onto the Lua stack. It's looked up by the
+// address of the class name, which unlike the name itself needn't be
+// interned and hashed on every call.
+static void PushClassMetatable(lua_State* l, int id)
+{
+    lua_pushlightuserdata(l, const_cast<std::string_view*>(&CelxClassNames[id]));
+    lua_rawget(l, LUA_REGISTRYINDEX);
+}
+
 // Set the class (metatable) of the object on top of the stack
 void Celx_SetClass(lua_State* l, int id)
 {
-    PushClass(l, id);
-    lua_rawget(l, LUA_REGISTRYINDEX);
+    PushClassMetatable(l, id);
     if (lua_type(l, -1) != LUA_TTABLE)
         cout << "Metatable for " << CelxClassNames[id] << " not found!\n";
     if (lua_setmetatable(l, -2) == 0)
@@ -141,6 +202,9 @@ void Celx_CreateClassMetatable(lua_State* l, int id)
     lua_pushvalue(l, -1);
     PushClass(l, id);
     lua_rawset(l, LUA_REGISTRYINDEX); // registry.metatable = name
+    lua_pushlightuserdata(l, const_cast<std::string_view*>(&CelxClassNames[id]));
+    lua_pushvalue(l, -2);
+    lua_rawset(l, LUA_REGISTRYINDEX); // registry[&name] = metatable
 
     lua_pushliteral(l, "__index");
     lua_pushvalue(l, -2);
@@ -161,21 +225,12 @@ void Celx_RegisterMethod(lua_State* l, const char* name, lua_CFunction fn)
 // specified class
 bool Celx_istype(lua_State* l, int index, int id)
 {
-    // get registry[metatable]
     if (!lua_getmetatable(l, index))
         return false;
-    lua_rawget(l, LUA_REGISTRYINDEX);
 
-    if (lua_type(l, -1) != LUA_TSTRING)
-    {
-        cout << "Celx_istype failed!  Unregistered class.\n";
-        lua_pop(l, 1);
-        return false;
-    }
-
-    const char* classname = lua_tostring(l, -1);
-    bool result = classname != nullptr && CelxClassNames[id] == std::string_view(classname);
-    lua_pop(l, 1);
+    PushClassMetatable(l, id);
+    bool result = lua_rawequal(l, -1, -2) != 0;
+    lua_pop(l, 2);
     return result;
 }
 
@@ -211,9 +266,12 @@ CelestiaCore* getAppCore(lua_State* l, FatalErrors fatalErrors)
 
 
 LuaState::LuaState() :
-    timeout(MaxTimeslice)
+    timeout(MaxTimeslice),
+    tickBudget(DefaultTickBudget)
 {
     state = luaL_newstate();
+    if (state != nullptr)
+        Celx_TrackMemory(state);
     timer = new Timer();
     screenshotCount = 0;
 }
@@ -267,6 +325,17 @@ static void checkTimeslice(lua_State* l, lua_Debug* /*ar*/)
         lua_pushstring(l, errormsg);
         lua_error(l);
     }
+
+#if LUA_VERSION_NUM >= 503
+    // Suspend the script until the next tick when it used up its budget.
+    // It isn't yieldable in a callback or across a pcall, then only the
+    // timeslice applies.
+    if (luastate->tickBudgetExpired() && lua_isyieldable(l))
+    {
+        lua_pop(l, 1);
+        lua_yield(l, 0);
+    }
+#endif
 }
 
 
@@ -353,6 +422,24 @@ bool LuaState::timesliceExpired()
 }
 
 
+void LuaState::setTickBudget(double budget)
+{
+    tickBudget = std::max(budget, 0.0);
+}
+
+
+double LuaState::getTickBudget() const
+{
+    return tickBudget;
+}
+
+
+bool LuaState::tickBudgetExpired() const
+{
+    return tickBudget > 0.0 && yieldTime < getTime();
+}
+
+
 static int resumeLuaThread(lua_State *L, lua_State *co, int narg)
 {
     int status, nres;
@@ -693,6 +780,7 @@ int LuaState::resume()
         return 0;
 
     timeout = getTime() + MaxTimeslice;
+    yieldTime = getTime() + tickBudget;
     int nArgs = resumeLuaThread(state, co, 0);
     if (nArgs < 0)
     {
@@ -1142,6 +1230,8 @@ static void loadLuaLibs(lua_State* state)
     CreateImageMetaTable(state);
     CreateTextureMetaTable(state);
     CreateCategoryMetaTable(state);
+    CreateWorkerMetaTable(state);
+    CreateVertexArrayMetaTable(state);
     ExtendCelestiaMetaTable(state);
     ExtendObjectMetaTable(state);
 
@@ -1212,6 +1302,9 @@ bool LuaState::callLuaHook(void* obj, const char* method)
            handled = lua_toboolean(costate, -1) == 1 ? true : false;
         }
         lua_pop(costate, 1);             // pop the return value
+
+        // Draw what the hook left batched
+        FlushLuaGraphics();
     }
     else
     {
@@ -58,6 +58,13 @@ public:
     bool timesliceExpired();
     void requestIO();
 
+    // Time in seconds the script may run in a tick before it's suspended
+    // until the next tick, or 0 to let it run until it yields. Suspending
+    // needs yieldable hooks, so it does nothing before Lua 5.3.
+    void setTickBudget(double);
+    double getTickBudget() const;
+    bool tickBudgetExpired() const;
+
     bool charEntered(const char*);
     double getTime() const;
     int screenshotCount;
@@ -93,6 +100,8 @@ private:
     bool alive{ false };
     Timer* timer;
     double scriptAwakenTime{ 0.0 };
+    double tickBudget;
+    double yieldTime{ 0.0 };
     IOMode ioMode{ IOMode::NotDetermined };
     bool eventHandlerEnabled{ false };
 };
@@ -9,13 +9,21 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <fmt/format.h>
 
 #include <celcompat/filesystem.h>
 #include <celengine/category.h>
+#include <celengine/frameprofiler.h>
 #include <celengine/texture.h>
 #include <celestia/audiosession.h>
 #include <celestia/hud.h>
@@ -26,6 +34,7 @@
 #include <celttf/truetypefont.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/memoryaccounting.h>
 #include <celutil/stringutils.h>
 #include "celx.h"
 #include "celx_internal.h"
@@ -37,6 +46,7 @@
 #include "celx_position.h"
 #include "celx_rotation.h"
 #include "celx_vector.h"
+#include "celx_worker.h"
 #include "celx_category.h"
 
 using namespace std;
@@ -1519,6 +1529,165 @@ static int celestia_dsos(lua_State* l)
     return 1;
 }
 
+// Columns of numbers for the bulk queries, one table per field, so that
+// scripts get the data of many objects without an object per step.
+struct BulkColumn
+{
+    const char* name;
+    std::vector<lua_Number> values;
+};
+
+static void pushColumns(lua_State* l, const std::vector<BulkColumn>& columns)
+{
+    lua_newtable(l);
+    for (const BulkColumn& column : columns)
+    {
+        lua_pushstring(l, column.name);
+        lua_createtable(l, static_cast<int>(column.values.size()), 0);
+        for (std::size_t i = 0; i < column.values.size(); ++i)
+        {
+            lua_pushnumber(l, column.values[i]);
+            lua_rawseti(l, -2, static_cast<int>(i + 1));
+        }
+        lua_settable(l, -3);
+    }
+}
+
+// Range of database indices from the optional first (0-based) and count
+// arguments at index and index + 1
+static std::pair<std::uint32_t, std::uint32_t> getIndexRange(lua_State* l, int index, std::uint32_t size,
+                                                             const char* errorMessage)
+{
+    double first = Celx_SafeGetNumber(l, index, WrongType, errorMessage, 0.0);
+    double count = Celx_SafeGetNumber(l, index + 1, WrongType, errorMessage, static_cast<double>(size));
+    auto begin = static_cast<std::uint32_t>(std::clamp(first, 0.0, static_cast<double>(size)));
+    auto end = static_cast<std::uint32_t>(std::clamp(first + count, static_cast<double>(begin), static_cast<double>(size)));
+    return { begin, end };
+}
+
+// Return a table with the catalog numbers, positions in light years and
+// absolute magnitudes of the stars from index first (0-based, default 0),
+// count of them (default all), as the arrays catalog, x, y, z and absmag.
+// Stars with an orbit are placed at time t, by default the current time.
+static int celestia_getstardata(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 4, "At most three arguments expected to function celestia:getstardata");
+
+    CelestiaCore* appCore = this_celestia(l);
+    const char* errorMessage = "Arguments to celestia:getstardata must be numbers";
+    const StarDatabase* stars = appCore->getSimulation()->getUniverse()->getStarCatalog();
+    auto [begin, end] = getIndexRange(l, 2, stars->size(), errorMessage);
+    double t = Celx_SafeGetNumber(l, 4, WrongType, errorMessage, appCore->getSimulation()->getTime());
+
+    std::vector<BulkColumn> columns{ { "catalog", {} }, { "x", {} }, { "y", {} }, { "z", {} }, { "absmag", {} } };
+    for (BulkColumn& column : columns)
+        column.values.reserve(end - begin);
+
+    for (std::uint32_t i = begin; i < end; ++i)
+    {
+        const Star* star = stars->getStar(i);
+        Eigen::Vector3d position = star->getOrbit() == nullptr
+            ? star->getPosition().cast<double>()
+            : star->getPosition(t).toLy();
+        columns[0].values.push_back(static_cast<lua_Number>(star->getIndex()));
+        columns[1].values.push_back(position.x());
+        columns[2].values.push_back(position.y());
+        columns[3].values.push_back(position.z());
+        columns[4].values.push_back(star->getAbsoluteMagnitude());
+    }
+
+    pushColumns(l, columns);
+    return 1;
+}
+
+// Return a table with the catalog numbers, positions in light years and
+// absolute magnitudes of the deep sky objects from index first (0-based,
+// default 0), count of them (default all), as the arrays catalog, x, y, z
+// and absmag.
+static int celestia_getdsodata(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 3, "At most two arguments expected to function celestia:getdsodata");
+
+    CelestiaCore* appCore = this_celestia(l);
+    const DSODatabase* dsos = appCore->getSimulation()->getUniverse()->getDSOCatalog();
+    auto [begin, end] = getIndexRange(l, 2, dsos->size(), "Arguments to celestia:getdsodata must be numbers");
+
+    std::vector<BulkColumn> columns{ { "catalog", {} }, { "x", {} }, { "y", {} }, { "z", {} }, { "absmag", {} } };
+    for (BulkColumn& column : columns)
+        column.values.reserve(end - begin);
+
+    for (std::uint32_t i = begin; i < end; ++i)
+    {
+        const DeepSkyObject* dso = dsos->getDSO(i);
+        Eigen::Vector3d position = dso->getPosition();
+        columns[0].values.push_back(static_cast<lua_Number>(dso->getIndex()));
+        columns[1].values.push_back(position.x());
+        columns[2].values.push_back(position.y());
+        columns[3].values.push_back(position.z());
+        columns[4].values.push_back(dso->getAbsoluteMagnitude());
+    }
+
+    pushColumns(l, columns);
+    return 1;
+}
+
+// Return a table with the positions in kilometers of the objects in the
+// array objects at time t (default the current time) relative to the
+// position of origin at that time (default the origin of universal
+// coordinates), as the arrays x, y and z.
+static int celestia_getpositions(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 4, "One to three arguments expected to function celestia:getpositions");
+    if (!lua_istable(l, 2))
+    {
+        Celx_DoError(l, "First argument to celestia:getpositions must be a table of objects");
+        return 0;
+    }
+
+    CelestiaCore* appCore = this_celestia(l);
+    double t = Celx_SafeGetNumber(l, 3, WrongType, "Second argument to celestia:getpositions must be a time",
+                                  appCore->getSimulation()->getTime());
+
+    UniversalCoord origin = UniversalCoord::Zero();
+    if (lua_gettop(l) >= 4)
+    {
+        const Selection* originObject = to_object(l, 4);
+        if (originObject == nullptr)
+        {
+            Celx_DoError(l, "Third argument to celestia:getpositions must be an object");
+            return 0;
+        }
+        origin = originObject->getPosition(t);
+    }
+
+    std::vector<BulkColumn> columns{ { "x", {} }, { "y", {} }, { "z", {} } };
+    for (int i = 1;; ++i)
+    {
+        lua_rawgeti(l, 2, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        const Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            Celx_DoError(l, "First argument to celestia:getpositions must be a table of objects");
+            return 0;
+        }
+
+        Eigen::Vector3d position = sel->getPosition(t).offsetFromKm(origin);
+        columns[0].values.push_back(position.x());
+        columns[1].values.push_back(position.y());
+        columns[2].values.push_back(position.z());
+        lua_pop(l, 1);
+    }
+
+    pushColumns(l, columns);
+    return 1;
+}
+
 static int celestia_setambient(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected in celestia:setambient");
@@ -1703,6 +1872,99 @@ static int celestia_setstarstyle(lua_State* l)
     return 0;
 }
 
+static int celestia_setframeprofiling(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected in celestia:setframeprofiling");
+    if (!lua_isboolean(l, 2))
+    {
+        Celx_DoError(l, "Argument to celestia:setframeprofiling must be a boolean");
+        return 0;
+    }
+
+    bool enable = lua_toboolean(l, 2) != 0;
+    CelestiaCore* appCore = this_celestia(l);
+    Renderer* renderer = appCore->getRenderer();
+    if (renderer == nullptr)
+    {
+        Celx_DoError(l, "Internal Error: renderer is nullptr!");
+        return 0;
+    }
+
+    renderer->getFrameProfiler().setEnabled(enable);
+    return 0;
+}
+
+// Return a table with the CPU and GPU milliseconds of each section of the
+// last profiled frame; gpu is missing if GPU times aren't available
+static int celestia_getframeprofile(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No argument expected in celestia:getframeprofile");
+    CelestiaCore* appCore = this_celestia(l);
+    Renderer* renderer = appCore->getRenderer();
+    if (renderer == nullptr)
+    {
+        Celx_DoError(l, "Internal Error: renderer is nullptr!");
+        return 0;
+    }
+
+    using celestia::engine::FrameProfiler;
+    const FrameProfiler& profiler = renderer->getFrameProfiler();
+    if (!profiler.isEnabled())
+    {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    const FrameProfiler::FrameTimes& times = profiler.lastFrame();
+    lua_newtable(l);
+    lua_pushstring(l, "frameno");
+    lua_pushnumber(l, static_cast<lua_Number>(times.frame));
+    lua_settable(l, -3);
+    for (std::size_t i = 0; i < FrameProfiler::SectionCount; ++i)
+    {
+        std::string_view name = FrameProfiler::sectionName(static_cast<FrameProfiler::Section>(i));
+        lua_pushlstring(l, name.data(), name.size());
+        lua_newtable(l);
+        lua_pushstring(l, "cpu");
+        lua_pushnumber(l, times.cpu[i]);
+        lua_settable(l, -3);
+        if (times.hasGpuTimes)
+        {
+            lua_pushstring(l, "gpu");
+            lua_pushnumber(l, times.gpu[i]);
+            lua_settable(l, -3);
+        }
+        lua_settable(l, -3);
+    }
+
+    return 1;
+}
+
+// Return a table with the live bytes of each subsystem, or nil if the
+// memory accounting isn't compiled in
+static int celestia_getmemoryusage(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No argument expected in celestia:getmemoryusage");
+    if constexpr (!celestia::util::MemoryAccountingEnabled)
+    {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_newtable(l);
+    for (std::size_t i = 0; i < celestia::util::MemoryTagCount; ++i)
+    {
+        auto tag = static_cast<celestia::util::MemoryTag>(i);
+        std::string name(celestia::util::MemoryTagName(tag));
+        name[0] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[0])));
+        lua_pushlstring(l, name.data(), name.size());
+        lua_pushnumber(l, static_cast<lua_Number>(celestia::util::LiveMemory(tag)));
+        lua_settable(l, -3);
+    }
+
+    return 1;
+}
+
 // -----------------------------------------------------------------------------
 // Star Color
 
@@ -1924,6 +2186,56 @@ static int celestia_getscripttime(lua_State* l)
     return 1;
 }
 
+static int celestia_setscriptbudget(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:setscriptbudget");
+    this_celestia(l);
+
+    double budget = Celx_SafeGetNumber(l, 2, AllErrors, "Argument to celestia:setscriptbudget must be a number");
+    getLuaStateObject(l)->setTickBudget(budget);
+    return 0;
+}
+
+static int celestia_getscriptbudget(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getscriptbudget");
+    this_celestia(l);
+
+    lua_pushnumber(l, getLuaStateObject(l)->getTickBudget());
+    return 1;
+}
+
+// Why the last frame was drawn, with the frame counts of each reason
+static int celestia_getframereason(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getframereason");
+    CelestiaCore* appCore = this_celestia(l);
+
+    const celestia::FramePacer& pacer = appCore->getFramePacer();
+    auto name = celestia::FramePacer::reasonName(pacer.lastReason());
+    lua_pushlstring(l, name.data(), name.size());
+
+    lua_newtable(l);
+    for (std::size_t i = 1; i < celestia::FramePacer::ReasonCount; i++)
+    {
+        auto reason = static_cast<celestia::FramePacer::Reason>(i);
+        name = celestia::FramePacer::reasonName(reason);
+        lua_pushlstring(l, name.data(), name.size());
+        lua_pushnumber(l, static_cast<lua_Number>(pacer.frameCount(reason)));
+        lua_settable(l, -3);
+    }
+    return 2;
+}
+
+static int celestia_newworker(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:newworker");
+    this_celestia(l);
+
+    const char* source = Celx_SafeGetString(l, 2, AllErrors, "Argument to celestia:newworker must be a string");
+    return worker_new(l, source);
+}
+
 static int celestia_newframe(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 4, "One to three arguments expected for function celestia:newframe");
@@ -2369,6 +2681,34 @@ static int celestia_playaudio(lua_State* l)
     return 1;
 }
 
+static int celestia_preloadaudio(lua_State* l)
+{
+#ifdef USE_MINIAUDIO
+    Celx_CheckArgs(l, 3, 3, "Function celestia:preloadaudio requires two arguments");
+    auto optionalChannel = celestia_getchannel(l, "preloadaudio");
+    if (!optionalChannel.has_value())
+    {
+        lua_pushboolean(l, false);
+        return 1;
+    }
+    int channel = optionalChannel.value();
+
+    const char* path = Celx_SafeGetString(l, 3, AllErrors, "Second argument to celestia:preloadaudio must be a string");
+    if (path == nullptr)
+    {
+        lua_pushboolean(l, false);
+        return 1;
+    }
+
+    CelestiaCore* appCore = this_celestia(l);
+    lua_pushboolean(l, appCore->preloadAudio(channel, path));
+#else
+    Celx_DoError(l, "Audio playback is not supported");
+    lua_pushboolean(l, false);
+#endif
+    return 1;
+}
+
 static int celestia_resumeaudio(lua_State* l)
 {
 #ifdef USE_MINIAUDIO
@@ -2629,6 +2969,9 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "setstardistancelimit", celestia_setstardistancelimit);
     Celx_RegisterMethod(l, "getstarstyle", celestia_getstarstyle);
     Celx_RegisterMethod(l, "setstarstyle", celestia_setstarstyle);
+    Celx_RegisterMethod(l, "setframeprofiling", celestia_setframeprofiling);
+    Celx_RegisterMethod(l, "getframeprofile", celestia_getframeprofile);
+    Celx_RegisterMethod(l, "getmemoryusage", celestia_getmemoryusage);
 
     // New CELX command for Star Color
     Celx_RegisterMethod(l, "getstarcolor", celestia_getstarcolor);
@@ -2650,6 +2993,10 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "newposition", celestia_newposition);
     Celx_RegisterMethod(l, "newrotation", celestia_newrotation);
     Celx_RegisterMethod(l, "getscripttime", celestia_getscripttime);
+    Celx_RegisterMethod(l, "setscriptbudget", celestia_setscriptbudget);
+    Celx_RegisterMethod(l, "getscriptbudget", celestia_getscriptbudget);
+    Celx_RegisterMethod(l, "newworker", celestia_newworker);
+    Celx_RegisterMethod(l, "getframereason", celestia_getframereason);
     Celx_RegisterMethod(l, "requestkeyboard", celestia_requestkeyboard);
     Celx_RegisterMethod(l, "takescreenshot", celestia_takescreenshot);
     Celx_RegisterMethod(l, "createcelscript", celestia_createcelscript);
@@ -2660,6 +3007,9 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "geteventhandler", celestia_geteventhandler);
     Celx_RegisterMethod(l, "stars", celestia_stars);
     Celx_RegisterMethod(l, "dsos", celestia_dsos);
+    Celx_RegisterMethod(l, "getstardata", celestia_getstardata);
+    Celx_RegisterMethod(l, "getdsodata", celestia_getdsodata);
+    Celx_RegisterMethod(l, "getpositions", celestia_getpositions);
     Celx_RegisterMethod(l, "windowbordersvisible", celestia_windowbordersvisible);
     Celx_RegisterMethod(l, "setwindowbordersvisible", celestia_setwindowbordersvisible);
     Celx_RegisterMethod(l, "seturl", celestia_seturl);
@@ -2673,6 +3023,7 @@ void CreateCelestiaMetaTable(lua_State* l)
     // Audio playback
     Celx_RegisterMethod(l, "isplayingaudio", celestia_isplayingaudio);
     Celx_RegisterMethod(l, "playaudio", celestia_playaudio);
+    Celx_RegisterMethod(l, "preloadaudio", celestia_preloadaudio);
     Celx_RegisterMethod(l, "resumeaudio", celestia_resumeaudio);
     Celx_RegisterMethod(l, "pauseaudio", celestia_pauseaudio);
     Celx_RegisterMethod(l, "stopaudio", celestia_stopaudio);
@@ -2746,7 +3097,11 @@ static int celestia_loadtexture(lua_State* l)
            Celx_DoError(l, "Invalid mipMapMode");
     }
     fs::path base_dir = GetScriptPath(l);
-    Texture* t = LoadTextureFromFile(base_dir / s, addressMode, mipMapMode).release();
+    Texture* t = nullptr;
+    getAppCore(l, AllErrors)->callOnRenderThread([&]
+    {
+        t = LoadTextureFromFile(base_dir / s, addressMode, mipMapMode).release();
+    });
     if (t == nullptr) return 0;
     return celx.pushClass(t);
 }
@@ -2758,7 +3113,8 @@ static int celestia_loadfont(lua_State* l)
     celx.checkArgs(2, 2, "Need one argument for celestia:loadfont()");
     string s = celx.safeGetString(2, AllErrors, "Argument to celestia:loadfont() must be a string");
     CelestiaCore* appCore = getAppCore(l, AllErrors);
-    auto font = LoadTextureFont(appCore->getRenderer(), s);
+    std::shared_ptr<TextureFont> font;
+    appCore->callOnRenderThread([&] { font = LoadTextureFont(appCore->getRenderer(), s); });
     if (font == nullptr) return 0;
     return celx.pushClass(font);
 }
@@ -9,7 +9,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <vector>
+
 #include "celx.h"
+#include "celx_gl.h"
 #include "celx_internal.h"
 #include "celx_object.h"
 #include <celengine/glsupport.h>
@@ -103,6 +106,7 @@ static int gl_TexParameter(lua_State* l)
     float x = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.TexParameter must be a number", 0.0);
     float y = (float)celx.safeGetNumber(2, WrongType, "argument 2 to gl.TexParameter must be a number", 0.0);
     float z = (float)celx.safeGetNumber(3, WrongType, "argument 3 to gl.TexParameter must be a number", 0.0);
+    fpcFlush();
     glTexParameteri((GLint) x, (GLenum) y, (GLenum) z);
     return 0;
 }
@@ -137,6 +141,7 @@ static int gl_LineWidth(lua_State* l)
     CelxLua celx(l);
     celx.checkArgs(1, 1, "One argument expected for gl.LineWidth()");
     float n = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.LineWidth must be a number", 1.0);
+    fpcFlush();
     glLineWidth(n);
     return 0;
 }
@@ -157,6 +162,7 @@ static int gl_BlendFunc(lua_State* l)
     celx.checkArgs(2, 2, "Two arguments expected for gl.BlendFunc()");
     int i = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.BlendFunc must be a number", 0.0);
     int j = (int)celx.safeGetNumber(2, WrongType, "argument 2 to gl.BlendFunc must be a number", 0.0);
+    fpcFlush();
     glBlendFuncSeparate(i,j,GL_ZERO,GL_ONE);
     return 0;
 }
@@ -167,7 +173,7 @@ static int gl_Begin(lua_State* l)
     celx.checkArgs(1, 1, "One argument expected for gl.Begin()");
     int i = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.Begin must be a number", 0.0);
 #ifndef USE_GLES_COMPAT_LAYER
-    glUseProgram(0);
+    celestia::gl::useProgram(0);
 #endif
     glBegin(i);
     return 0;
@@ -232,6 +238,120 @@ static int gl_PushMatrix(lua_State* l)
     return 0;
 }
 
+// Read the numbers of the table at index, returning false if there's
+// anything else in it
+static bool getNumbers(lua_State* l, int index, std::vector<float>& numbers)
+{
+    for (int i = 1;; ++i)
+    {
+        lua_rawgeti(l, index, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            return true;
+        }
+        if (!lua_isnumber(l, -1))
+        {
+            lua_pop(l, 1);
+            return false;
+        }
+        numbers.push_back(static_cast<float>(lua_tonumber(l, -1)));
+        lua_pop(l, 1);
+    }
+}
+
+// gl.NewVertexArray(primitive, positions [, colors [, texcoords]]) uploads
+// vertices once, to be drawn by the returned object. The tables list two
+// coordinates per position, four components per color and two coordinates
+// per texture coordinate.
+static int gl_NewVertexArray(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 4, "Two to four arguments expected for gl.NewVertexArray()");
+    int primitive = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.NewVertexArray must be a number", 0.0);
+
+    std::vector<float> positions;
+    if (!lua_istable(l, 2) || !getNumbers(l, 2, positions))
+    {
+        celx.doError("argument 2 to gl.NewVertexArray must be a table of numbers");
+        return 0;
+    }
+    int count = static_cast<int>(positions.size() / 2);
+
+    std::vector<float> colors;
+    if (!lua_isnoneornil(l, 3) &&
+        (!lua_istable(l, 3) || !getNumbers(l, 3, colors) || colors.size() != 4 * positions.size() / 2))
+    {
+        celx.doError("argument 3 to gl.NewVertexArray must be a table of four numbers per vertex");
+        return 0;
+    }
+
+    std::vector<float> texCoords;
+    if (!lua_isnoneornil(l, 4) &&
+        (!lua_istable(l, 4) || !getNumbers(l, 4, texCoords) || texCoords.size() != 2 * positions.size() / 2))
+    {
+        celx.doError("argument 4 to gl.NewVertexArray must be a table of two numbers per vertex");
+        return 0;
+    }
+
+    FpcVertexArray* array = fpcCreateVertexArray(static_cast<GLenum>(primitive),
+                                                 positions.data(),
+                                                 texCoords.empty() ? nullptr : texCoords.data(),
+                                                 colors.empty() ? nullptr : colors.data(),
+                                                 count);
+    if (array == nullptr)
+    {
+        celx.doError("Unsupported primitive or no vertices for gl.NewVertexArray");
+        return 0;
+    }
+    return celx.pushClass(array);
+}
+
+static int vertexarray_draw(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected for vertexarray:draw()");
+    auto array = celx.getThis<FpcVertexArray*>();
+    if (array != nullptr && *array != nullptr)
+        fpcDrawVertexArray(*array);
+    return 0;
+}
+
+static int vertexarray_tostring(lua_State* l)
+{
+    CelxLua celx(l);
+    return celx.push("[VertexArray]");
+}
+
+static int vertexarray_gc(lua_State* l)
+{
+    CelxLua celx(l);
+    auto array = celx.getThis<FpcVertexArray*>();
+    if (array != nullptr && *array != nullptr)
+    {
+        fpcDeleteVertexArray(*array);
+        *array = nullptr;
+    }
+    return 0;
+}
+
+void CreateVertexArrayMetaTable(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.createClassMetatable(Celx_VertexArray);
+
+    celx.registerMethod("__tostring", vertexarray_tostring);
+    celx.registerMethod("__gc", vertexarray_gc);
+    celx.registerMethod("draw", vertexarray_draw);
+
+    celx.pop(1); // remove metatable from stack
+}
+
+void FlushLuaGraphics()
+{
+    fpcFlush();
+}
+
 void LoadLuaGraphicsLibrary(lua_State* l)
 {
     CelxLua celx(l);
@@ -254,12 +374,17 @@ void LoadLuaGraphicsLibrary(lua_State* l)
     celx.registerMethod("PopMatrix", gl_PopMatrix);
     celx.registerMethod("LoadIdentity", gl_LoadIdentity);
     celx.registerMethod("PushMatrix", gl_PushMatrix);
+    celx.registerMethod("NewVertexArray", gl_NewVertexArray);
 
     celx.registerValue("QUADS", GL_QUADS);
     celx.registerValue("LIGHTING", GL_LIGHTING);
     celx.registerValue("POINTS", GL_POINTS);
     celx.registerValue("LINES", GL_LINES);
     celx.registerValue("LINE_LOOP", GL_LINE_LOOP);
+    celx.registerValue("LINE_STRIP", GL_LINE_STRIP);
+    celx.registerValue("TRIANGLES", GL_TRIANGLES);
+    celx.registerValue("TRIANGLE_STRIP", GL_TRIANGLE_STRIP);
+    celx.registerValue("TRIANGLE_FAN", GL_TRIANGLE_FAN);
     celx.registerValue("LINE_SMOOTH", GL_LINE_SMOOTH);
     celx.registerValue("POLYGON", GL_POLYGON);
     celx.registerValue("PROJECTION", GL_PROJECTION);
@@ -11,6 +11,19 @@
 
 #pragma once
 
+#include "celx_internal.h"
+
 struct lua_State;
+class FpcVertexArray;
 
 extern void LoadLuaGraphicsLibrary(lua_State* l);
+
+// Draw the primitives batched by the gl functions
+extern void FlushLuaGraphics();
+
+inline int celxClassId(FpcVertexArray*)
+{
+    return Celx_VertexArray;
+}
+
+extern void CreateVertexArrayMetaTable(lua_State* l);
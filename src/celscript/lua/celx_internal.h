@@ -42,7 +42,9 @@ enum
     Celx_Image    = 10,
     Celx_Texture  = 11,
     Celx_Phase    = 12,
-    Celx_Category = 13
+    Celx_Category = 13,
+    Celx_Worker   = 14,
+    Celx_VertexArray = 15
 };
 
 template<typename T> int celxClassId(T)
@@ -347,6 +349,8 @@ private:
     lua_State* m_lua;
 };
 
+void openLuaLibrary(lua_State*, const char*, lua_CFunction);
+void Celx_TrackMemory(lua_State*);
 void Celx_SetClass(lua_State*, int);
 void Celx_CreateClassMetatable(lua_State*, int);
 void Celx_RegisterMethod(lua_State*, const char*, lua_CFunction);
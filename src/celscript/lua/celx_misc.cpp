@@ -174,6 +174,7 @@ static int font_bind(lua_State* l)
     celx.checkArgs(1, 1, "No arguments expected for font:bind()");
 
     auto font = *celx.getThis<std::shared_ptr<TextureFont>>();
+    fpcFlush();
     font->bind();
     return 0;
 }
@@ -200,6 +201,7 @@ static int font_render(lua_State* l)
     Eigen::Matrix4f p, m;
     glGetFloatv(GL_PROJECTION_MATRIX, p.data());
     glGetFloatv(GL_MODELVIEW_MATRIX, m.data());
+    fpcFlush();
     TextLayout layout;
     layout.setFont(font);
     layout.begin(p, m);
@@ -358,6 +360,7 @@ static int texture_bind(lua_State* l)
     celx.checkArgs(1, 1, "No arguments expected for texture:bind()");
 
     auto texture = *celx.getThis<Texture*>();
+    fpcFlush();
     texture->bind();
     return 0;
 }
@@ -114,16 +114,78 @@ static celestia::MarkerRepresentation::Symbol parseMarkerSymbol(const string& na
 
 
 // ==================== Object ====================
+// The address of ObjectCacheKey is the registry key of a table of the object
+// userdata by the address of their object. Its values are weak, so it only
+// keeps the objects a script still holds; an accessor called repeatedly in
+// a loop then returns the same userdata instead of allocating a new one.
+static const char ObjectCacheKey = 0;
+
+static const void* selectionAddress(const Selection& sel)
+{
+    switch (sel.getType())
+    {
+    case SelectionType::Star:
+        return sel.star();
+    case SelectionType::Body:
+        return sel.body();
+    case SelectionType::DeepSky:
+        return sel.deepsky();
+    case SelectionType::Location:
+        return sel.location();
+    default:
+        return nullptr;
+    }
+}
+
+static void createObjectCache(lua_State* l)
+{
+    lua_pushlightuserdata(l, const_cast<char*>(&ObjectCacheKey));
+    lua_newtable(l);
+    lua_newtable(l);
+    lua_pushliteral(l, "__mode");
+    lua_pushliteral(l, "v");
+    lua_rawset(l, -3);
+    lua_setmetatable(l, -2);
+    lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
 // star, planet, or deep-sky object
 int object_new(lua_State* l, const Selection& sel)
 {
     CelxLua celx(l);
 
+    const void* address = selectionAddress(sel);
+    if (address == nullptr)
+    {
+        Selection* ud = static_cast<Selection*>(lua_newuserdata(l, sizeof(Selection)));
+        *ud = sel;
+        celx.setClass(Celx_Object);
+        return 1;
+    }
+
+    lua_pushlightuserdata(l, const_cast<char*>(&ObjectCacheKey));
+    lua_rawget(l, LUA_REGISTRYINDEX);
+    lua_pushlightuserdata(l, const_cast<void*>(address));
+    lua_rawget(l, -2);
+    // The address may have been reused by an object of another type since
+    // the cached userdata was created
+    auto* cached = static_cast<Selection*>(lua_touserdata(l, -1));
+    if (cached != nullptr && *cached == sel)
+    {
+        lua_remove(l, -2);
+        return 1;
+    }
+    lua_pop(l, 1);
+
     Selection* ud = static_cast<Selection*>(lua_newuserdata(l, sizeof(Selection)));
     *ud = sel;
-
     celx.setClass(Celx_Object);
 
+    lua_pushlightuserdata(l, const_cast<void*>(address));
+    lua_pushvalue(l, -2);
+    lua_rawset(l, -4);      // cache[address] = userdata
+    lua_remove(l, -2);      // remove the cache from the stack
+
     return 1;
 }
 
@@ -900,7 +962,8 @@ static int object_preloadtexture(lua_State* l)
         // make sure we don't timeout because of texture-loading:
         double timeToTimeout = luastate->timeout - luastate->getTime();
 
-        renderer->loadTextures(sel->body());
+        Body* body = sel->body();
+        appCore->callOnRenderThread([&] { renderer->loadTextures(body); });
 
         // no matter how long it really took, make it look like 0.1s:
         luastate->timeout = luastate->getTime() + timeToTimeout - 0.1;
@@ -1388,6 +1451,7 @@ void CreateObjectMetaTable(lua_State* l)
 {
     CelxLua celx(l);
 
+    createObjectCache(l);
     celx.createClassMetatable(Celx_Object);
 
     celx.registerMethod("__tostring", object_tostring);
@@ -0,0 +1,545 @@
+// celx_worker.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lua script extensions for Celestia: background worker object
+//
+// A worker runs a script on its own Lua state and thread, so it can only
+// compute: it has the base, math, table and string libraries and none of
+// the celx objects. It exchanges copies of values with the script that
+// created it through two message queues.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "celx.h"
+#include "celx_internal.h"
+#include "celx_worker.h"
+
+namespace
+{
+
+constexpr const char WorkerRegistryKey[] = "celestia-worker";
+
+// Nesting depth of the tables which may be sent
+constexpr int MaxMessageDepth = 16;
+
+// Copy of a Lua value passed between the states
+struct WorkerValue
+{
+    enum class Type
+    {
+        Nil,
+        Boolean,
+        Integer,
+        Number,
+        String,
+        Table,
+    };
+
+    Type type{ Type::Nil };
+    bool boolean{ false };
+    lua_Integer integer{ 0 };
+    lua_Number number{ 0.0 };
+    std::string string;
+    // Keys and values of a table, pairwise
+    std::vector<WorkerValue> keys;
+    std::vector<WorkerValue> values;
+};
+
+
+// Copy the value at index; return false with an error message for values
+// which can't leave their state, like functions and userdata
+bool
+toValue(lua_State* l, int index, WorkerValue& value, int depth, std::string& error)
+{
+    if (index < 0)
+        index = lua_gettop(l) + index + 1;
+
+    switch (lua_type(l, index))
+    {
+    case LUA_TNIL:
+        value.type = WorkerValue::Type::Nil;
+        return true;
+    case LUA_TBOOLEAN:
+        value.type = WorkerValue::Type::Boolean;
+        value.boolean = lua_toboolean(l, index) != 0;
+        return true;
+    case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+        if (lua_isinteger(l, index))
+        {
+            value.type = WorkerValue::Type::Integer;
+            value.integer = lua_tointeger(l, index);
+            return true;
+        }
+#endif
+        value.type = WorkerValue::Type::Number;
+        value.number = lua_tonumber(l, index);
+        return true;
+    case LUA_TSTRING:
+        {
+            std::size_t length = 0;
+            const char* s = lua_tolstring(l, index, &length);
+            value.type = WorkerValue::Type::String;
+            value.string.assign(s, length);
+        }
+        return true;
+    case LUA_TTABLE:
+        if (depth >= MaxMessageDepth)
+        {
+            error = "Tables sent to a worker are nested too deeply";
+            return false;
+        }
+        value.type = WorkerValue::Type::Table;
+        lua_checkstack(l, 2);
+        lua_pushnil(l);
+        while (lua_next(l, index) != 0)
+        {
+            value.keys.emplace_back();
+            value.values.emplace_back();
+            if (!toValue(l, -2, value.keys.back(), depth + 1, error)
+                || !toValue(l, -1, value.values.back(), depth + 1, error))
+            {
+                lua_pop(l, 2);
+                return false;
+            }
+            lua_pop(l, 1);
+        }
+        return true;
+    default:
+        error = "Only nil, booleans, numbers, strings and tables can be sent to a worker";
+        return false;
+    }
+}
+
+
+void
+pushValue(lua_State* l, const WorkerValue& value)
+{
+    lua_checkstack(l, 3);
+    switch (value.type)
+    {
+    case WorkerValue::Type::Nil:
+        lua_pushnil(l);
+        break;
+    case WorkerValue::Type::Boolean:
+        lua_pushboolean(l, value.boolean ? 1 : 0);
+        break;
+    case WorkerValue::Type::Integer:
+        lua_pushinteger(l, value.integer);
+        break;
+    case WorkerValue::Type::Number:
+        lua_pushnumber(l, value.number);
+        break;
+    case WorkerValue::Type::String:
+        lua_pushlstring(l, value.string.data(), value.string.size());
+        break;
+    case WorkerValue::Type::Table:
+        lua_createtable(l, 0, static_cast<int>(value.keys.size()));
+        for (std::size_t i = 0; i < value.keys.size(); ++i)
+        {
+            pushValue(l, value.keys[i]);
+            pushValue(l, value.values[i]);
+            lua_settable(l, -3);
+        }
+        break;
+    }
+}
+
+
+class LuaWorker
+{
+public:
+    LuaWorker() = default;
+    ~LuaWorker();
+
+    LuaWorker(const LuaWorker&) = delete;
+    LuaWorker& operator=(const LuaWorker&) = delete;
+
+    // Compile the script, and run it on the worker thread
+    bool load(const char* source, std::string& error);
+    void start();
+    // Ask the script to stop and wait for it
+    void stop();
+
+    void post(WorkerValue&&);
+    bool poll(WorkerValue&);
+    bool isRunning() const;
+    std::string getError() const;
+
+private:
+    void run();
+
+    static LuaWorker* getWorker(lua_State*);
+    static void checkStop(lua_State*, lua_Debug*);
+    static int send(lua_State*);
+    static int receive(lua_State*);
+
+    lua_State* m_state{ nullptr };
+    std::thread m_thread;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_inboxChanged;
+    // Messages to the script, and from the script
+    std::deque<WorkerValue> m_inbox;
+    std::deque<WorkerValue> m_outbox;
+    std::string m_error;
+    std::atomic<bool> m_stopRequested{ false };
+    std::atomic<bool> m_running{ false };
+};
+
+
+LuaWorker::~LuaWorker()
+{
+    stop();
+    if (m_state != nullptr)
+        lua_close(m_state);
+}
+
+
+bool
+LuaWorker::load(const char* source, std::string& error)
+{
+    m_state = luaL_newstate();
+    if (m_state == nullptr)
+    {
+        error = "Can't create the Lua state of the worker";
+        return false;
+    }
+
+    Celx_TrackMemory(m_state);
+
+    openLuaLibrary(m_state, "", luaopen_base);
+    openLuaLibrary(m_state, LUA_MATHLIBNAME, luaopen_math);
+    openLuaLibrary(m_state, LUA_TABLIBNAME, luaopen_table);
+    openLuaLibrary(m_state, LUA_STRLIBNAME, luaopen_string);
+    lua_settop(m_state, 0);
+
+    lua_pushstring(m_state, WorkerRegistryKey);
+    lua_pushlightuserdata(m_state, this);
+    lua_settable(m_state, LUA_REGISTRYINDEX);
+
+    lua_pushcfunction(m_state, send);
+    lua_setglobal(m_state, "send");
+    lua_pushcfunction(m_state, receive);
+    lua_setglobal(m_state, "receive");
+
+    if (luaL_loadbuffer(m_state, source, std::strlen(source), "worker") != 0)
+    {
+        const char* message = lua_tostring(m_state, -1);
+        error = message == nullptr ? "Can't compile the worker script" : message;
+        return false;
+    }
+
+    lua_sethook(m_state, checkStop, LUA_MASKCOUNT, 1000);
+    return true;
+}
+
+
+void
+LuaWorker::start()
+{
+    m_running = true;
+    m_thread = std::thread(&LuaWorker::run, this);
+}
+
+
+void
+LuaWorker::stop()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_inboxChanged.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+
+void
+LuaWorker::post(WorkerValue&& value)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_inbox.push_back(std::move(value));
+    }
+    m_inboxChanged.notify_one();
+}
+
+
+bool
+LuaWorker::poll(WorkerValue& value)
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_outbox.empty())
+        return false;
+
+    value = std::move(m_outbox.front());
+    m_outbox.pop_front();
+    return true;
+}
+
+
+bool
+LuaWorker::isRunning() const
+{
+    return m_running;
+}
+
+
+std::string
+LuaWorker::getError() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_error;
+}
+
+
+void
+LuaWorker::run()
+{
+    if (lua_pcall(m_state, 0, 0, 0) != 0 && !m_stopRequested)
+    {
+        const char* message = lua_tostring(m_state, -1);
+        std::scoped_lock lock(m_mutex);
+        m_error = message == nullptr ? "Unknown worker error" : message;
+    }
+    lua_settop(m_state, 0);
+    m_running = false;
+}
+
+
+LuaWorker*
+LuaWorker::getWorker(lua_State* l)
+{
+    lua_pushstring(l, WorkerRegistryKey);
+    lua_gettable(l, LUA_REGISTRYINDEX);
+    auto* worker = static_cast<LuaWorker*>(lua_touserdata(l, -1));
+    lua_pop(l, 1);
+    return worker;
+}
+
+
+// Terminate the script once it's asked to stop
+void
+LuaWorker::checkStop(lua_State* l, lua_Debug* /*ar*/)
+{
+    LuaWorker* worker = getWorker(l);
+    if (worker != nullptr && worker->m_stopRequested)
+    {
+        lua_pushstring(l, "Worker stopped");
+        lua_error(l);
+    }
+}
+
+
+// send(value): queue a copy of value for the script which created the worker
+int
+LuaWorker::send(lua_State* l)
+{
+    LuaWorker* worker = getWorker(l);
+    WorkerValue value;
+    std::string error;
+    if (worker == nullptr || !toValue(l, 1, value, 0, error))
+    {
+        lua_pushstring(l, error.c_str());
+        lua_error(l);
+        return 0;
+    }
+
+    std::scoped_lock lock(worker->m_mutex);
+    worker->m_outbox.push_back(std::move(value));
+    return 0;
+}
+
+
+// receive(): wait for a value sent to the worker; return nil once the worker
+// is asked to stop
+int
+LuaWorker::receive(lua_State* l)
+{
+    LuaWorker* worker = getWorker(l);
+    if (worker == nullptr)
+        return 0;
+
+    WorkerValue value;
+    {
+        std::unique_lock lock(worker->m_mutex);
+        worker->m_inboxChanged.wait(lock, [worker] { return worker->m_stopRequested || !worker->m_inbox.empty(); });
+        if (worker->m_inbox.empty())
+            return 0;
+
+        value = std::move(worker->m_inbox.front());
+        worker->m_inbox.pop_front();
+    }
+
+    pushValue(l, value);
+    return 1;
+}
+
+
+LuaWorker*
+this_worker(lua_State* l)
+{
+    CelxLua celx(l);
+
+    auto* block = static_cast<LuaWorker**>(celx.checkUserData(1, Celx_Worker));
+    if (block == nullptr || *block == nullptr)
+        celx.doError("Bad worker object!");
+
+    return *block;
+}
+
+
+int
+worker_tostring(lua_State* l)
+{
+    CelxLua celx(l);
+    return celx.push("[Worker]");
+}
+
+
+// Queue a copy of the value for the worker script
+int
+worker_send(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 2, "One argument expected to worker:send");
+
+    LuaWorker* worker = this_worker(l);
+    WorkerValue value;
+    std::string error;
+    if (!toValue(l, 2, value, 0, error))
+        celx.doError(error.c_str());
+
+    worker->post(std::move(value));
+    return 0;
+}
+
+
+// Return the next value sent by the worker script, or nil if there's none
+int
+worker_receive(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected to worker:receive");
+
+    WorkerValue value;
+    if (!this_worker(l)->poll(value))
+        return celx.push();
+
+    pushValue(l, value);
+    return 1;
+}
+
+
+int
+worker_isrunning(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected to worker:isrunning");
+
+    return celx.push(this_worker(l)->isRunning());
+}
+
+
+// Return the error which terminated the worker script, or nil
+int
+worker_geterror(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected to worker:geterror");
+
+    std::string error = this_worker(l)->getError();
+    if (error.empty())
+        return celx.push();
+
+    return celx.push(error.c_str());
+}
+
+
+int
+worker_stop(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "No arguments expected to worker:stop");
+
+    this_worker(l)->stop();
+    return 0;
+}
+
+
+int
+worker_gc(lua_State* l)
+{
+    CelxLua celx(l);
+
+    auto* block = static_cast<LuaWorker**>(celx.checkUserData(1, Celx_Worker));
+    if (block != nullptr)
+    {
+        delete *block;
+        *block = nullptr;
+    }
+
+    return 0;
+}
+
+} // end unnamed namespace
+
+
+int
+worker_new(lua_State* l, const char* source)
+{
+    CelxLua celx(l);
+
+    // Create the userdata first, so that the worker is deleted if the
+    // script can't be compiled
+    auto* block = static_cast<LuaWorker**>(lua_newuserdata(l, sizeof(LuaWorker*)));
+    *block = new LuaWorker();
+    celx.setClass(Celx_Worker);
+
+    std::string error;
+    if (!(*block)->load(source, error))
+    {
+        lua_pop(l, 1);
+        celx.push();
+        celx.push(error.c_str());
+        return 2;
+    }
+
+    (*block)->start();
+    return 1;
+}
+
+
+void
+CreateWorkerMetaTable(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.createClassMetatable(Celx_Worker);
+
+    celx.registerMethod("__tostring", worker_tostring);
+    celx.registerMethod("__gc", worker_gc);
+    celx.registerMethod("send", worker_send);
+    celx.registerMethod("receive", worker_receive);
+    celx.registerMethod("isrunning", worker_isrunning);
+    celx.registerMethod("geterror", worker_geterror);
+    celx.registerMethod("stop", worker_stop);
+
+    lua_pop(l, 1); // remove metatable from stack
+}
@@ -0,0 +1,19 @@
+// celx_worker.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lua script extensions for Celestia: background worker object
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+struct lua_State;
+
+extern void CreateWorkerMetaTable(lua_State* l);
+// Push a worker running the script source, or nil and an error message if
+// the script can't be compiled
+extern int worker_new(lua_State* l, const char* source);
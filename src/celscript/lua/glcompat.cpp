@@ -9,17 +9,24 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>                      // memcpy
 #include <memory>
+#include <vector>
 #include <Eigen/Core>
 #include <fmt/format.h>
 #include <celengine/glsupport.h>
 #include <celengine/shadermanager.h>    // CelestiaGLProgram::*Index
 #include <celmath/vecgl.h>              // math::translate
+#include <celrender/gl/buffer.h>
+#include <celrender/gl/vertexobject.h>
 #include "glcompat.h"
 
+namespace gl = celestia::gl;
 namespace math = celestia::math;
 
 namespace
@@ -93,7 +100,7 @@ const char kVertexShader[] = R"glsl(
 precision highp float;
 #endif
 
-attribute vec2 in_Position;
+attribute vec4 in_Position;
 attribute vec2 in_TexCoord0;
 #if SHADER_COLOR
 attribute vec4 in_Color;
@@ -117,7 +124,7 @@ void main(void)
 #if SHADER_TEXCOORD
     v_texCoord = in_TexCoord0;
 #endif
-    gl_Position = MVPMatrix * vec4(in_Position, 0.0, 1.0);
+    gl_Position = MVPMatrix * in_Position;
 }}
 )glsl";
 
@@ -156,17 +163,32 @@ enum ShaderAttributes
     SHADER_COUNT    = 2
 };
 
-GLenum gPrimitive = GL_NONE;
-GLsizei gVertexCounter = 0;
-GLsizei gTexCoordCounter = 0;
-GLsizei gColorCounter = 0;
-
+// The vertices of the primitives between glBegin and glEnd are transformed
+// by the modelview matrix when they're specified, and appended to a batch
+// of points, lines or triangles drawn with the same program and projection.
+// The batch is drawn when the state changes, or when fpcFlush is called.
 struct Vertex
 {
-    float x, y, u, v, r, g, b, a;
+    float x, y, z, w;
+    float u, v;
+    std::uint8_t color[4];
 };
 
-std::array<Vertex, 16> vertices {};
+GLenum gPrimitive = GL_NONE;
+bool gPrimitiveTextured = false;
+std::vector<Vertex> gPrimitiveVertices;
+std::array<float, 4> gColor{ 1.0f, 1.0f, 1.0f, 1.0f };
+std::array<float, 2> gTexCoord{ 0.0f, 0.0f };
+
+GLenum gBatchPrimitive = GL_NONE;
+bool gBatchTextured = false;
+Eigen::Matrix4f gBatchProjection = Eigen::Matrix4f::Identity();
+std::vector<Vertex> gBatch;
+
+// Objects of the vertex arrays collected by Lua, deleted on the next draw
+// as the collector may run while the context isn't current
+std::vector<std::unique_ptr<gl::VertexObject>> gDeletedVertexObjects;
+std::vector<std::unique_ptr<gl::Buffer>> gDeletedBuffers;
 
 GLProgram* BuildProgram(const std::string &vertex, const std::string &fragment)
 {
@@ -203,93 +225,163 @@ GLSLProgram* FindGLProgram(ShaderAttributes attr)
         if (glprog != nullptr)
             programs[attr] = new GLSLProgram(glprog);
     }
-    return prog;
+    return programs[attr];
 }
 
 
-void Draw()
+std::uint8_t
+ColorComponent(float c)
 {
-    if (gPrimitive == GL_NONE || gVertexCounter == 0)
-        return; // Do nothing
-
-    bool hasTexCoords       = gTexCoordCounter == gVertexCounter;
-    bool hasColors          = gColorCounter == gVertexCounter;
-    ShaderAttributes type   = hasTexCoords ? SHADER_TEXCOORD : SHADER_COLOR;
-
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(
-        CelestiaGLProgram::VertexCoordAttributeIndex,
-        2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].x
-    );
+    return static_cast<std::uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
 
-    if (hasTexCoords)
+Vertex
+MakeVertex(const Eigen::Vector4f& position, const std::array<float, 2>& texCoord, const std::array<float, 4>& color)
+{
+    return Vertex
     {
-        glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::TextureCoord0AttributeIndex,
-            2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].u
-        );
-    }
+        position.x(), position.y(), position.z(), position.w(),
+        texCoord[0], texCoord[1],
+        { ColorComponent(color[0]), ColorComponent(color[1]), ColorComponent(color[2]), ColorComponent(color[3]) },
+    };
+}
 
-    if (hasColors)
+// The primitive of the independent points, lines or triangles which a
+// primitive of glBegin is split into, or GL_NONE if it isn't supported
+GLenum
+ListPrimitive(GLenum primitive)
+{
+    switch (primitive)
     {
-        glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::ColorAttributeIndex,
-            4, GL_FLOAT, false, sizeof(Vertex), &vertices[0].r
-        );
+    case GL_POINTS:
+        return GL_POINTS;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return GL_LINES;
+    case GL_TRIANGLES:
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_QUADS:
+    case GL_QUAD_STRIP:
+    case GL_POLYGON:
+        return GL_TRIANGLES;
+    default:
+        return GL_NONE;
     }
+}
 
-    if (auto *prog = FindGLProgram(type); prog != nullptr)
+// Append the vertices of a primitive as points, lines or triangles
+void
+AppendPrimitive(GLenum primitive, const std::vector<Vertex>& vertices, std::vector<Vertex>& out)
+{
+    auto n = vertices.size();
+    switch (primitive)
     {
-        prog->use();
-        prog->setMVPMatrix(g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition]);
-        glDrawArrays(gPrimitive, 0, gVertexCounter);
+    case GL_POINTS:
+        out.insert(out.end(), vertices.begin(), vertices.end());
+        break;
+    case GL_LINES:
+        out.insert(out.end(), vertices.begin(), vertices.begin() + (n & ~std::size_t(1)));
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (std::size_t i = 1; i < n; ++i)
+        {
+            out.push_back(vertices[i - 1]);
+            out.push_back(vertices[i]);
+        }
+        if (primitive == GL_LINE_LOOP && n > 2)
+        {
+            out.push_back(vertices[n - 1]);
+            out.push_back(vertices[0]);
+        }
+        break;
+    case GL_TRIANGLES:
+        out.insert(out.end(), vertices.begin(), vertices.begin() + (n - n % 3));
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_QUAD_STRIP:
+        // Every other triangle is flipped to keep the winding
+        for (std::size_t i = 2; i < n; ++i)
+        {
+            out.push_back(vertices[(i & 1) != 0 ? i - 1 : i - 2]);
+            out.push_back(vertices[(i & 1) != 0 ? i - 2 : i - 1]);
+            out.push_back(vertices[i]);
+        }
+        break;
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        for (std::size_t i = 2; i < n; ++i)
+        {
+            out.push_back(vertices[0]);
+            out.push_back(vertices[i - 1]);
+            out.push_back(vertices[i]);
+        }
+        break;
+    case GL_QUADS:
+        for (std::size_t i = 3; i < n; i += 4)
+        {
+            for (std::size_t j : { i - 3, i - 2, i - 1, i - 3, i - 1, i })
+                out.push_back(vertices[j]);
+        }
+        break;
+    default:
+        break;
     }
-
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if (hasTexCoords)
-        glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord3AttributeIndex);
-    if (hasColors)
-        glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
-
-    // reset state
-    gVertexCounter = 0;
-    gTexCoordCounter = 0;
-    gColorCounter = 0;
-    gPrimitive = GL_NONE;
 }
 
-void PushVertex(float x, float y)
+void
+AddAttributes(gl::VertexObject& vo, const gl::Buffer& buffer, bool texCoords, bool colors)
 {
-    if (gVertexCounter < static_cast<GLsizei>(vertices.size()))
+    vo.addVertexBuffer(buffer, CelestiaGLProgram::VertexCoordAttributeIndex, 4,
+                       gl::VertexObject::DataType::Float, false, sizeof(Vertex), offsetof(Vertex, x));
+    if (texCoords)
+    {
+        vo.addVertexBuffer(buffer, CelestiaGLProgram::TextureCoord0AttributeIndex, 2,
+                           gl::VertexObject::DataType::Float, false, sizeof(Vertex), offsetof(Vertex, u));
+    }
+    if (colors)
     {
-        vertices[gVertexCounter].x = x;
-        vertices[gVertexCounter].y = y;
-        gVertexCounter++;
+        vo.addVertexBuffer(buffer, CelestiaGLProgram::ColorAttributeIndex, 4,
+                           gl::VertexObject::DataType::UnsignedByte, true, sizeof(Vertex), offsetof(Vertex, color));
     }
 }
 
-void PushTexCoord(float u, float v)
+void
+DeleteCollected()
 {
-    if (gTexCoordCounter < static_cast<GLsizei>(vertices.size()))
-    {
-        vertices[gTexCoordCounter].u = u;
-        vertices[gTexCoordCounter].v = v;
-        gTexCoordCounter++;
-    }
+    gDeletedVertexObjects.clear();
+    gDeletedBuffers.clear();
 }
 
-void PushColor(float r, float g, float b, float a)
+void
+DrawBatch()
 {
-    if (gColorCounter < static_cast<GLsizei>(vertices.size()))
+    if (gBatch.empty())
+        return;
+
+    DeleteCollected();
+
+    // The batch is uploaded to a single buffer which is orphaned each time
+    static gl::Buffer* buffer = nullptr;
+    static gl::VertexObject* vo = nullptr;
+    if (buffer == nullptr)
+    {
+        buffer = new gl::Buffer();
+        vo = new gl::VertexObject();
+        AddAttributes(*vo, *buffer, true, true);
+    }
+    buffer->bind().invalidateData().setData(gBatch, gl::Buffer::BufferUsage::StreamDraw);
+
+    if (auto *prog = FindGLProgram(gBatchTextured ? SHADER_TEXCOORD : SHADER_COLOR); prog != nullptr)
     {
-        vertices[gColorCounter].r = r;
-        vertices[gColorCounter].g = g;
-        vertices[gColorCounter].b = b;
-        vertices[gColorCounter].a = a;
-        gColorCounter++;
+        prog->use();
+        prog->setMVPMatrix(gBatchProjection);
+        vo->draw(static_cast<gl::VertexObject::Primitive>(gBatchPrimitive), static_cast<int>(gBatch.size()));
     }
+
+    gBatch.clear();
 }
 } // namespace
 
@@ -495,6 +587,7 @@ void fpcEnable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
+        DrawBatch();
         orig_glEnable(param);
     default:
         break;
@@ -509,6 +602,7 @@ void fpcDisable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
+        DrawBatch();
         orig_glDisable(param);
     default:
         break;
@@ -517,31 +611,143 @@ void fpcDisable(GLenum param) noexcept
 
 void fpcBegin(GLenum param) noexcept
 {
-    if (gPrimitive == 0)
-        gPrimitive = (param == GL_POLYGON || param == GL_QUADS) ? GL_TRIANGLE_FAN : param;
+    if (gPrimitive == GL_NONE)
+    {
+        gPrimitive = param;
+        gPrimitiveTextured = false;
+        gPrimitiveVertices.clear();
+    }
 }
 
 void fpcEnd() noexcept
 {
-    Draw();
+    GLenum primitive = ListPrimitive(gPrimitive);
+    if (primitive != GL_NONE && !gPrimitiveVertices.empty())
+    {
+        const Eigen::Matrix4f& projection = g_projectionStack[g_projectionPosition];
+        if (primitive != gBatchPrimitive || gPrimitiveTextured != gBatchTextured || projection != gBatchProjection)
+        {
+            DrawBatch();
+            gBatchPrimitive = primitive;
+            gBatchTextured = gPrimitiveTextured;
+            gBatchProjection = projection;
+        }
+        AppendPrimitive(gPrimitive, gPrimitiveVertices, gBatch);
+    }
+
+    gPrimitive = GL_NONE;
+    gPrimitiveVertices.clear();
 }
 
 void fpcColor4f(float r, float g, float b, float a) noexcept
 {
+    gColor = { r, g, b, a };
     if (gPrimitive == GL_NONE)
         glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
-    else
-        PushColor(r, g, b, a);
 }
 
 void fpcVertex2f(float x, float y) noexcept
 {
-    PushVertex(x, y);
+    if (gPrimitive == GL_NONE)
+        return;
+
+    Eigen::Vector4f position = g_modelViewStack[g_modelViewPosition] * Eigen::Vector4f(x, y, 0.0f, 1.0f);
+    gPrimitiveVertices.push_back(MakeVertex(position, gTexCoord, gColor));
 }
 
 void fpcTexCoord2f(float x, float y) noexcept
 {
-    PushTexCoord(x, y);
+    gTexCoord = { x, y };
+    if (gPrimitive != GL_NONE)
+        gPrimitiveTextured = true;
+}
+
+void fpcFlush() noexcept
+{
+    DrawBatch();
+}
+
+class FpcVertexArray
+{
+public:
+    GLenum primitive{ GL_NONE };
+    bool textured{ false };
+    bool colored{ false };
+    // Kept until the first draw, when the context is known to be current
+    std::vector<Vertex> vertices;
+    int count{ 0 };
+    std::unique_ptr<gl::Buffer> buffer;
+    std::unique_ptr<gl::VertexObject> vo;
+};
+
+FpcVertexArray* fpcCreateVertexArray(GLenum primitive,
+                                     const float *positions,
+                                     const float *texCoords,
+                                     const float *colors,
+                                     int count) noexcept
+{
+    GLenum listPrimitive = ListPrimitive(primitive);
+    if (listPrimitive == GL_NONE || count <= 0)
+        return nullptr;
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(static_cast<std::size_t>(count));
+    std::array<float, 2> texCoord{ 0.0f, 0.0f };
+    std::array<float, 4> color{ 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int i = 0; i < count; ++i)
+    {
+        if (texCoords != nullptr)
+            texCoord = { texCoords[2 * i], texCoords[2 * i + 1] };
+        if (colors != nullptr)
+            color = { colors[4 * i], colors[4 * i + 1], colors[4 * i + 2], colors[4 * i + 3] };
+        Eigen::Vector4f position(positions[2 * i], positions[2 * i + 1], 0.0f, 1.0f);
+        vertices.push_back(MakeVertex(position, texCoord, color));
+    }
+
+    auto *array = new FpcVertexArray();
+    array->primitive = listPrimitive;
+    array->textured = texCoords != nullptr;
+    array->colored = colors != nullptr;
+    AppendPrimitive(primitive, vertices, array->vertices);
+    array->count = static_cast<int>(array->vertices.size());
+    return array;
+}
+
+void fpcDrawVertexArray(FpcVertexArray *array) noexcept
+{
+    DrawBatch();
+    DeleteCollected();
+
+    if (array->count == 0)
+        return;
+
+    if (array->vo == nullptr)
+    {
+        array->buffer = std::make_unique<gl::Buffer>(gl::Buffer::TargetHint::Array, array->vertices);
+        array->vo = std::make_unique<gl::VertexObject>();
+        AddAttributes(*array->vo, *array->buffer, array->textured, array->colored);
+        array->vertices = {};
+    }
+
+    auto *prog = FindGLProgram(array->textured ? SHADER_TEXCOORD : SHADER_COLOR);
+    if (prog == nullptr)
+        return;
+
+    prog->use();
+    prog->setMVPMatrix(g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition]);
+    if (!array->colored)
+        glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, gColor[0], gColor[1], gColor[2], gColor[3]);
+    array->vo->draw(static_cast<gl::VertexObject::Primitive>(array->primitive), array->count);
+}
+
+void fpcDeleteVertexArray(FpcVertexArray *array) noexcept
+{
+    if (array->vo != nullptr)
+    {
+        gDeletedVertexObjects.push_back(std::move(array->vo));
+        gDeletedBuffers.push_back(std::move(array->buffer));
+    }
+    delete array;
 }
 
 void fpcLookAt(float ix, float iy, float iz, float cx, float cy, float cz, float ux, float uy, float uz) noexcept
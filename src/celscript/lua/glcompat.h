@@ -27,6 +27,9 @@
 #ifndef GL_QUADS
 #define GL_QUADS 0x0007
 #endif
+#ifndef GL_QUAD_STRIP
+#define GL_QUAD_STRIP 0x0008
+#endif
 #ifndef GL_LIGHTING
 #define GL_LIGHTING 0x0B50
 #endif
@@ -157,3 +160,19 @@ void fpcColor4f(float r, float g, float b, float a) noexcept;
 void fpcVertex2f(float x, float y) noexcept;
 void fpcTexCoord2f(float x, float y) noexcept;
 void fpcLookAt(float ix, float iy, float iz, float cx, float cy, float cz, float ux, float uy, float uz) noexcept;
+
+// Draw the primitives batched since the last flush
+void fpcFlush() noexcept;
+
+// Vertices uploaded once and drawn with the current matrices. Positions
+// have two coordinates per vertex, texture coordinates two and colors four;
+// either may be null. The vertices are uploaded when they are first drawn,
+// and deleted on the next draw after the array.
+class FpcVertexArray;
+FpcVertexArray* fpcCreateVertexArray(GLenum primitive,
+                                     const float *positions,
+                                     const float *texCoords,
+                                     const float *colors,
+                                     int count) noexcept;
+void fpcDrawVertexArray(FpcVertexArray *array) noexcept;
+void fpcDeleteVertexArray(FpcVertexArray *array) noexcept;
@@ -11,8 +11,12 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <optional>
 #include <system_error>
 #include <unordered_map>
 #include <vector>
@@ -24,13 +28,22 @@
 #include <celimage/image.h>
 #include <celrender/gl/buffer.h>
 #include <celrender/gl/vertexobject.h>
+#include <celutil/color.h>
 #include <celutil/logger.h>
 #include <celutil/utf8.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
 
 #define DUMP_TEXTURE 0
 
+// FreeType renders signed distance fields since 2.11
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define HAVE_FT_SDF 1
+#else
+#define HAVE_FT_SDF 0
+#endif
+
 #if DUMP_TEXTURE
 #include <fstream>
 #endif
@@ -48,8 +61,8 @@ struct Glyph
 {
     FT_ULong ch;
 
-    int ax; // advance.x
-    int ay; // advance.y
+    float ax; // advance.x
+    float ay; // advance.y
 
     unsigned int bw; // bitmap.width;
     unsigned int bh; // bitmap.height;
@@ -59,6 +72,8 @@ struct Glyph
 
     float tx; // x offset of glyph in texture coordinates
     float ty; // y offset of glyph in texture coordinates
+
+    std::size_t page; // atlas page holding the glyph
 };
 
 struct UnicodeBlock
@@ -67,126 +82,435 @@ struct UnicodeBlock
     FT_ULong last;
 };
 
-constexpr Glyph g_badGlyph = { 0, 0, 0, 0, 0, 0, 0, 0.0f, 0.0f };
+constexpr Glyph g_badGlyph = { 0, 0.0f, 0.0f, 0, 0, 0, 0, 0.0f, 0.0f, 0 };
 constexpr auto INVALID_POS = static_cast<std::size_t>(-1);
 
-} // end unnamed namespace
+// Distance field glyphs are rendered once at this many pixels per em, with
+// distances up to DistanceFieldSpread pixels from the outline
+constexpr int DistanceFieldSize = 32;
+constexpr int DistanceFieldSpread = 6;
 
-struct TextureFontPrivate
+// The glyphs of all fonts and sizes are packed into shared textures, so
+// that text in several fonts can be drawn together. Each page is filled
+// with shelves, rows of glyphs as high as the first glyph on the row.
+// Glyphs are added when they are first used and never removed.
+class GlyphAtlas
 {
-    struct FontVertex
+public:
+    bool add(const FT_Bitmap &bitmap, Glyph &glyph);
+    void bind(std::size_t page) const;
+    int getPageSize() const { return m_pageSize; }
+
+private:
+    struct Shelf
     {
-        FontVertex(float _x, float _y, float _u, float _v) : x(_x), y(_y), u(_u), v(_v)
+        int y;
+        int height;
+        int width; // used width
+    };
+
+    struct Page
+    {
+        std::unique_ptr<ImageTexture> texture;
+        std::vector<Shelf> shelves;
+        int height{ 0 }; // used height
+    };
+
+    bool place(Page &page, int w, int h, int &x, int &y) const;
+
+    static constexpr int MaxPageSize = 1024;
+    // Empty border between glyphs, so that filtering doesn't bleed them
+    static constexpr int Padding = 1;
+
+    int m_pageSize{ 0 };
+    std::vector<Page> m_pages;
+};
+
+bool
+GlyphAtlas::place(Page &page, int w, int h, int &x, int &y) const
+{
+    // Use the shelf wasting the least height, unless a new shelf would
+    // waste less
+    Shelf *best = nullptr;
+    for (auto &shelf : page.shelves)
+    {
+        if (shelf.height >= h && shelf.width + w + Padding <= m_pageSize &&
+            (best == nullptr || shelf.height < best->height))
         {
+            best = &shelf;
         }
-        float x, y;
-        float u, v;
-    };
+    }
 
-    static_assert(std::is_standard_layout_v<FontVertex>);
+    bool roomForShelf = page.height + h + Padding <= m_pageSize;
+    if (best == nullptr || (best->height - h > h / 2 && roomForShelf))
+    {
+        if (!roomForShelf)
+            return false;
+        best = &page.shelves.emplace_back(Shelf{ page.height, h, 0 });
+        page.height += h + Padding;
+    }
 
-    TextureFontPrivate(const Renderer *renderer);
-    ~TextureFontPrivate();
-    TextureFontPrivate() = delete;
-    TextureFontPrivate(const TextureFontPrivate &) = delete;
-    TextureFontPrivate(TextureFontPrivate &&) = default;
-    TextureFontPrivate &operator=(const TextureFontPrivate &) = delete;
-    TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
+    x = best->width;
+    y = best->y;
+    best->width += w + Padding;
+    return true;
+}
 
-    std::pair<float, float> render(std::u16string_view line, float x, float y);
+bool
+GlyphAtlas::add(const FT_Bitmap &bitmap, Glyph &glyph)
+{
+    if (m_pageSize == 0)
+        m_pageSize = std::min(MaxPageSize, static_cast<int>(celestia::gl::maxTextureSize));
 
-    bool                       buildAtlas();
-    void                       computeTextureSize();
-    bool                       loadGlyphInfo(FT_ULong /*ch*/, Glyph & /*c*/) const;
-    void                       initCommonGlyphs();
-    int                        getCommonGlyphsCount();
-    const Glyph &              getGlyph(std::int32_t /*ch*/, char16_t /*fallback*/);
-    const Glyph &              getGlyph(FT_ULong /* ch */);
-    [[nodiscard]] std::size_t  toPos(FT_ULong /*ch*/) const;
-    void                       optimize();
-    CelestiaGLProgram         *getProgram();
-    void                       flush();
+    auto w = static_cast<int>(bitmap.width);
+    auto h = static_cast<int>(bitmap.rows);
+    if (w + Padding > m_pageSize || h + Padding > m_pageSize)
+        return false;
 
-    const Renderer    *m_renderer;
-    CelestiaGLProgram *m_prog{ nullptr };
+    if (w == 0 || h == 0)
+    {
+        // Nothing to draw
+        glyph.tx = 0.0f;
+        glyph.ty = 0.0f;
+        glyph.page = 0;
+        return true;
+    }
 
-    FT_Face m_face; // font face
+    int x = 0;
+    int y = 0;
+    if (m_pages.empty() || !place(m_pages.back(), w, h, x, y))
+    {
+        // Every page is zeroed, so the padding between glyphs is empty
+        Image img(PixelFormat::Luminance, m_pageSize, m_pageSize);
+        auto &page = m_pages.emplace_back();
+        page.texture = std::make_unique<ImageTexture>(img, Texture::EdgeClamp, Texture::NoMipMaps);
+        place(page, w, h, x, y);
+    }
+    std::size_t pageIndex = m_pages.size() - 1;
 
-    int m_maxAscent{ 0 };
-    int m_maxDescent{ 0 };
-    int m_maxWidth{ 0 };
+    glyph.tx = static_cast<float>(x) / static_cast<float>(m_pageSize);
+    glyph.ty = static_cast<float>(y) / static_cast<float>(m_pageSize);
+    glyph.page = pageIndex;
+
+    // Rows are padded to the default unpack alignment of 4 bytes
+    int pitch = (w + 3) & ~3;
+    std::vector<std::uint8_t> pixels(static_cast<std::size_t>(pitch * h));
+    for (int row = 0; row < h; row++)
+        std::memcpy(pixels.data() + row * pitch, bitmap.buffer + row * bitmap.pitch, w);
+
+    gl::bindTexture(GL_TEXTURE_2D, m_pages[pageIndex].texture->getName());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels.data());
+    return true;
+}
+
+void
+GlyphAtlas::bind(std::size_t page) const
+{
+    m_pages[page].texture->bind();
+}
+
+GlyphAtlas &
+getGlyphAtlas()
+{
+    static GlyphAtlas *atlas = new GlyphAtlas;
+    return *atlas;
+}
+
+// Distance fields are kept apart from bitmaps, as they are drawn with
+// another shader
+GlyphAtlas &
+getDistanceFieldAtlas()
+{
+    static GlyphAtlas *atlas = new GlyphAtlas;
+    return *atlas;
+}
+
+// The glyphs of a face, added to an atlas when first used. Bitmap glyphs
+// belong to one size of a font, distance field glyphs to all of them.
+class GlyphCache
+{
+public:
+    GlyphCache(FT_Face face, bool distanceField);
+    ~GlyphCache();
+    GlyphCache(const GlyphCache &) = delete;
+    GlyphCache &operator=(const GlyphCache &) = delete;
+
+    FT_Face getFace() const { return m_face; }
+    bool isDistanceField() const { return m_distanceField; }
+    GlyphAtlas &getAtlas() const;
 
-    int m_texWidth{ 0 };
-    int m_texHeight{ 0 };
+    void initCommonGlyphs();
+    const Glyph &getGlyph(std::int32_t /*ch*/, char16_t /*fallback*/);
+    const Glyph &getGlyph(FT_ULong /* ch */);
 
-    std::unique_ptr<ImageTexture> m_tex; // texture object
+private:
+    bool                       loadGlyphInfo(FT_ULong /*ch*/, Glyph & /*c*/) const;
+    bool                       addToAtlas(Glyph & /*c*/) const;
+    int                        getCommonGlyphsCount();
+    [[nodiscard]] std::size_t  toPos(FT_ULong /*ch*/) const;
+
+    FT_Face m_face; // font face
+    bool m_distanceField;
 
     std::vector<Glyph> m_glyphs; // character information
 
     std::array<UnicodeBlock, 2> m_unicodeBlocks;
 
     int m_commonGlyphsCount{ 0 };
-    int m_inserted{ 0 };
+};
+
+// Quads of all fonts waiting to be drawn. The modelview matrix is applied
+// to the vertices, so that the labels at different positions and depths
+// are drawn together. The batch is drawn once it is full, when the
+// projection, the atlas page or the source of the text color changes, and
+// when a font is flushed or unbound.
+class TextBatch
+{
+public:
+    TextBatch();
+
+    void setProgram(CelestiaGLProgram *prog) { m_prog = prog; }
+    void setDistanceFieldProgram(CelestiaGLProgram *prog) { m_distanceFieldProg = prog; }
+    void setMatrices(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m);
+    void setCapture(std::vector<GlyphQuad> *quads) { m_capture = quads; }
+    // Add a quad in model coordinates. Without a color, the text color
+    // is the current value of the color attribute when the batch is drawn.
+    // The quad is a distance field glyph if smoothing is not 0.
+    void addQuad(std::size_t page,
+                 float x1, float y1, float x2, float y2,
+                 float tx1, float ty1, float tx2, float ty2,
+                 const std::optional<Color> &color,
+                 float smoothing);
+    void flush();
+
+private:
+    struct Vertex
+    {
+        float x, y, z;
+        float u, v;
+        Color color;
+        float smoothing;
+    };
 
-    Eigen::Matrix4f m_projection;
-    Eigen::Matrix4f m_modelView;
+    static_assert(std::is_standard_layout_v<Vertex>);
 
-    std::vector<FontVertex> m_fontVertices;
+    void addVertex(float x, float y, float u, float v, Color color, float smoothing);
+
+    static constexpr std::size_t MaxVertices = 4096; // MUST be multiply of 4
+    static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
+
+    CelestiaGLProgram *m_prog{ nullptr };
+    CelestiaGLProgram *m_distanceFieldProg{ nullptr };
+
+    Eigen::Matrix4f m_projection{ Eigen::Matrix4f::Identity() };
+    Eigen::Matrix4f m_modelView{ Eigen::Matrix4f::Identity() };
+
+    std::vector<Vertex> m_vertices;
+    std::vector<GlyphQuad> *m_capture{ nullptr };
+    std::size_t m_page{ 0 };
+    bool m_vertexColors{ false };
+    bool m_distanceField{ false };
 
-    gl::VertexObject m_vao;
     gl::Buffer       m_vbo{ gl::Buffer::TargetHint::Array };
     gl::Buffer       m_vio{ gl::Buffer::TargetHint::ElementArray };
+    gl::VertexObject m_vao;
+    gl::VertexObject m_colorVao;
+};
 
-    bool m_shaderInUse{ false };
+TextBatch::TextBatch()
+{
+    m_vertices.reserve(MaxVertices);
 
-    static constexpr std::size_t MaxVertices = 256; // This gives BO size 4kB, MUST be multiply of 4
-    static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
-};
+    std::vector<std::uint16_t> indexes;
+    indexes.reserve(MaxIndices);
+    for (std::uint16_t index = 0; index < static_cast<std::uint16_t>(MaxVertices); index += 4)
+    {
+        indexes.push_back(index + 0);
+        indexes.push_back(index + 1);
+        indexes.push_back(index + 2);
+        indexes.push_back(index + 1);
+        indexes.push_back(index + 3);
+        indexes.push_back(index + 2);
+    }
+    m_vio.bind().setData(indexes, gl::Buffer::BufferUsage::StaticDraw);
+    m_vio.unbind();
 
+    for (auto *vao : { &m_vao, &m_colorVao })
+    {
+        vao->addVertexBuffer(
+            m_vbo,
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            3,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(Vertex),
+            offsetof(Vertex, x));
+        vao->addVertexBuffer(
+            m_vbo,
+            CelestiaGLProgram::TextureCoord0AttributeIndex,
+            2,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(Vertex),
+            offsetof(Vertex, u));
+        vao->addVertexBuffer(
+            m_vbo,
+            CelestiaGLProgram::IntensityAttributeIndex,
+            1,
+            gl::VertexObject::DataType::Float,
+            false,
+            sizeof(Vertex),
+            offsetof(Vertex, smoothing));
+        vao->setIndexBuffer(m_vio, 0, gl::VertexObject::IndexType::UnsignedShort);
+    }
+    m_colorVao.addVertexBuffer(
+        m_vbo,
+        CelestiaGLProgram::ColorAttributeIndex,
+        4,
+        gl::VertexObject::DataType::UnsignedByte,
+        true,
+        sizeof(Vertex),
+        offsetof(Vertex, color));
+}
 
-TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(renderer)
+void
+TextBatch::setMatrices(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m)
+{
+    if (p != m_projection)
+    {
+        flush();
+        m_projection = p;
+    }
+    m_modelView = m;
+}
+
+void
+TextBatch::addVertex(float x, float y, float u, float v, Color color, float smoothing)
+{
+    // The modelview matrices of text are affine
+    Eigen::Vector3f position = m_modelView.topLeftCorner<3, 2>() * Eigen::Vector2f(x, y) +
+                               m_modelView.topRightCorner<3, 1>();
+    m_vertices.push_back({ position.x(), position.y(), position.z(), u, v, color, smoothing });
+}
+
+void
+TextBatch::addQuad(std::size_t page,
+                   float x1, float y1, float x2, float y2,
+                   float tx1, float ty1, float tx2, float ty2,
+                   const std::optional<Color> &color,
+                   float smoothing)
+{
+    if (m_capture != nullptr)
+    {
+        m_capture->push_back({ page, x1, y1, x2, y2, tx1, ty1, tx2, ty2,
+                               color.value_or(Color::White), color.has_value(), smoothing });
+    }
+
+    bool distanceField = smoothing != 0.0f;
+    if (!m_vertices.empty() &&
+        (page != m_page || color.has_value() != m_vertexColors || distanceField != m_distanceField))
+    {
+        flush();
+    }
+    m_page = page;
+    m_vertexColors = color.has_value();
+    m_distanceField = distanceField;
+
+    Color c = color.value_or(Color::White);
+    addVertex(x1, y1, tx1, ty2, c, smoothing);
+    addVertex(x2, y1, tx2, ty2, c, smoothing);
+    addVertex(x1, y2, tx1, ty1, c, smoothing);
+    addVertex(x2, y2, tx2, ty1, c, smoothing);
+
+    if (m_vertices.size() == MaxVertices)
+        flush();
+}
+
+void
+TextBatch::flush()
+{
+    CelestiaGLProgram *prog = m_distanceField ? m_distanceFieldProg : m_prog;
+    if (m_vertices.empty() || prog == nullptr)
+    {
+        m_vertices.clear();
+        return;
+    }
+
+    gl::activeTexture(GL_TEXTURE0);
+    (m_distanceField ? getDistanceFieldAtlas() : getGlyphAtlas()).bind(m_page);
+    prog->use();
+    prog->samplerParam("atlasTex") = 0;
+    prog->setMVPMatrices(m_projection, Eigen::Matrix4f::Identity());
+
+    auto count = static_cast<int>(m_vertices.size() / 4 * 6);
+    m_vbo.bind().invalidateData().setData(m_vertices, gl::Buffer::BufferUsage::StreamDraw);
+    (m_vertexColors ? m_colorVao : m_vao).draw(gl::VertexObject::Primitive::Triangles, count);
+    m_vbo.unbind();
+
+    m_vertices.clear();
+}
+
+TextBatch &
+getTextBatch()
+{
+    static TextBatch *batch = new TextBatch;
+    return *batch;
+}
+
+GlyphCache::GlyphCache(FT_Face face, bool distanceField) :
+    m_face(face),
+    m_distanceField(distanceField)
 {
     m_unicodeBlocks[0] = { 0x0020, 0x007E }; // Basic Latin
     m_unicodeBlocks[1] = { 0x03B1, 0x03CF }; // Lower case Greek
-
-    m_vao.addVertexBuffer(
-        m_vbo,
-        CelestiaGLProgram::VertexCoordAttributeIndex,
-        2,
-        gl::VertexObject::DataType::Float,
-        false,
-        sizeof(FontVertex),
-        offsetof(FontVertex, x));
-    m_vao.addVertexBuffer(
-        m_vbo,
-        CelestiaGLProgram::TextureCoord0AttributeIndex,
-        2,
-        gl::VertexObject::DataType::Float,
-        false,
-        sizeof(FontVertex),
-        offsetof(FontVertex, u));
-    m_vao.setIndexBuffer(m_vio, 0, gl::VertexObject::IndexType::UnsignedShort);
 }
 
-TextureFontPrivate::~TextureFontPrivate()
+GlyphCache::~GlyphCache()
 {
     if (m_face != nullptr)
         FT_Done_Face(m_face);
 }
 
+GlyphAtlas &
+GlyphCache::getAtlas() const
+{
+    return m_distanceField ? getDistanceFieldAtlas() : getGlyphAtlas();
+}
+
 bool
-TextureFontPrivate::loadGlyphInfo(FT_ULong ch, Glyph &c) const
+GlyphCache::loadGlyphInfo(FT_ULong ch, Glyph &c) const
 {
     FT_GlyphSlot g = m_face->glyph;
-    if (FT_Load_Char(m_face, ch, FT_LOAD_RENDER) != 0)
+
+    // Distance fields are scaled to every size, so they are not hinted to
+    // the pixels of one
+    FT_Int32 flags = m_distanceField ? FT_LOAD_NO_HINTING : FT_LOAD_RENDER;
+    if (FT_Load_Char(m_face, ch, flags) != 0)
     {
         c.ch = 0;
         return false;
     }
 
+#if HAVE_FT_SDF
+    if (m_distanceField && g->format == FT_GLYPH_FORMAT_OUTLINE && g->outline.n_points > 0 &&
+        FT_Render_Glyph(g, FT_RENDER_MODE_SDF) != 0)
+    {
+        c.ch = 0;
+        return false;
+    }
+#endif
+
     c.ch = ch;
-    c.ax = g->advance.x >> 6;
-    c.ay = g->advance.y >> 6;
+    if (m_distanceField)
+    {
+        c.ax = static_cast<float>(g->advance.x) / 64.0f;
+        c.ay = static_cast<float>(g->advance.y) / 64.0f;
+    }
+    else
+    {
+        c.ax = static_cast<float>(g->advance.x >> 6);
+        c.ay = static_cast<float>(g->advance.y >> 6);
+    }
     c.bw = g->bitmap.width;
     c.bh = g->bitmap.rows;
     c.bl = g->bitmap_left;
@@ -194,8 +518,20 @@ TextureFontPrivate::loadGlyphInfo(FT_ULong ch, Glyph &c) const
     return true;
 }
 
+// Copy the bitmap of the glyph last loaded by loadGlyphInfo to the atlas
+bool
+GlyphCache::addToAtlas(Glyph &c) const
+{
+    if (getAtlas().add(m_face->glyph->bitmap, c))
+        return true;
+
+    GetLogger()->warn("No room for character {:x} in the glyph atlas!\n", static_cast<unsigned>(c.ch));
+    c.ch = 0;
+    return false;
+}
+
 void
-TextureFontPrivate::initCommonGlyphs()
+GlyphCache::initCommonGlyphs()
 {
     if (!m_glyphs.empty())
         return;
@@ -209,100 +545,15 @@ TextureFontPrivate::initCommonGlyphs()
             Glyph c;
             if (!loadGlyphInfo(ch, c))
                 GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(ch));
+            else
+                addToAtlas(c);
             m_glyphs.push_back(c); // still pushing empty
         }
     }
 }
 
-void
-TextureFontPrivate::computeTextureSize()
-{
-    int roww = 0;
-    int rowh = 0;
-    int w    = 0;
-    int h    = 0;
-
-    // Find minimum size for a texture holding all visible ASCII characters
-    for (const auto &c : m_glyphs)
-    {
-        if (c.ch == 0) continue; // skip bad glyphs
-
-        if (roww + static_cast<int>(c.bw) + 1 >= celestia::gl::maxTextureSize)
-        {
-            w = std::max(w, roww);
-            h += rowh;
-            roww = 0;
-            rowh = 0;
-        }
-        roww += c.bw + 1;
-        rowh = std::max(rowh, static_cast<int>(c.bh));
-    }
-
-    w = std::max(w, roww);
-    h += rowh;
-
-    m_texWidth  = w;
-    m_texHeight = h;
-}
-
-bool
-TextureFontPrivate::buildAtlas()
-{
-    initCommonGlyphs();
-    computeTextureSize();
-
-    // Create an image that will be used to hold all glyphs
-    auto img = std::make_unique<Image>(PixelFormat::Luminance, m_texWidth, m_texHeight);
-
-    // Paste all glyph bitmaps into the texture, remembering the offset
-    int ox = 0;
-    int oy = 0;
-    int rowh = 0;
-
-    FT_GlyphSlot g = m_face->glyph;
-    for (auto &c : m_glyphs)
-    {
-        if (c.ch == 0)
-            continue; // skip bad glyphs
-
-        if (FT_Load_Char(m_face, c.ch, FT_LOAD_RENDER) != 0)
-        {
-            GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(c.ch));
-            c.ch = 0;
-            continue;
-        }
-
-        // compute subimage position
-        if (ox + int(g->bitmap.width) > int(m_texWidth))
-        {
-            oy += rowh;
-            rowh = 0;
-            ox   = 0;
-        }
-
-        // copy glyph image to the destination image
-        auto bitmapRows = static_cast<int>(g->bitmap.rows);
-        for (int y = 0; y < bitmapRows; y++)
-        {
-            std::uint8_t *dst = img->getPixelRow(oy + y) + ox * img->getComponents();
-            const std::uint8_t *src = g->bitmap.buffer + y * g->bitmap.width;
-            memcpy(dst, src, g->bitmap.width);
-        }
-
-        c.tx = static_cast<float>(ox) / static_cast<float>(m_texWidth);
-        c.ty = static_cast<float>(oy) / static_cast<float>(m_texHeight);
-
-        rowh = std::max(rowh, static_cast<int>(g->bitmap.rows));
-        ox += g->bitmap.width + 1;
-    }
-
-    m_tex = std::make_unique<ImageTexture>(*img, Texture::EdgeClamp, Texture::NoMipMaps);
-
-    return true;
-}
-
 int
-TextureFontPrivate::getCommonGlyphsCount()
+GlyphCache::getCommonGlyphsCount()
 {
     if (m_commonGlyphsCount == 0)
     {
@@ -313,7 +564,7 @@ TextureFontPrivate::getCommonGlyphsCount()
 }
 
 std::size_t
-TextureFontPrivate::toPos(FT_ULong ch) const
+GlyphCache::toPos(FT_ULong ch) const
 {
     std::size_t pos = 0;
 
@@ -334,7 +585,7 @@ TextureFontPrivate::toPos(FT_ULong ch) const
 }
 
 const Glyph &
-TextureFontPrivate::getGlyph(std::int32_t ch, char16_t fallback)
+GlyphCache::getGlyph(std::int32_t ch, char16_t fallback)
 {
     if (ch >= 0 && ch < 0x110000)
     {
@@ -348,7 +599,7 @@ TextureFontPrivate::getGlyph(std::int32_t ch, char16_t fallback)
 }
 
 const Glyph &
-TextureFontPrivate::getGlyph(FT_ULong ch)
+GlyphCache::getGlyph(FT_ULong ch)
 {
     if (auto pos = toPos(ch); pos != INVALID_POS)
         return m_glyphs[pos];
@@ -360,23 +611,74 @@ TextureFontPrivate::getGlyph(FT_ULong ch)
     if (it != m_glyphs.end())
         return *it;
 
+    // The new glyph goes to a free part of the atlas, so the pending text
+    // needn't be drawn first
     Glyph c;
-    if (!loadGlyphInfo(ch, c))
+    if (!loadGlyphInfo(ch, c) || !addToAtlas(c))
         return g_badGlyph;
 
-    flush(); // render text to avoid garbled output due to changed texture
-
     m_glyphs.push_back(c);
-    if (++m_inserted == 10) optimize();
-    buildAtlas();
 
     return m_glyphs.back();
 }
 
+} // end unnamed namespace
+
+struct TextureFontPrivate
+{
+    TextureFontPrivate(const Renderer *renderer);
+    ~TextureFontPrivate() = default;
+    TextureFontPrivate() = delete;
+    TextureFontPrivate(const TextureFontPrivate &) = delete;
+    TextureFontPrivate(TextureFontPrivate &&) = default;
+    TextureFontPrivate &operator=(const TextureFontPrivate &) = delete;
+    TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
+
+    std::pair<float, float> render(std::u16string_view line, float x, float y, const std::optional<Color> &color);
+
+    bool                       buildAtlas();
+    void                       setScale(float /*scale*/);
+    CelestiaGLProgram         *getProgram();
+
+    const Renderer    *m_renderer;
+    CelestiaGLProgram *m_prog{ nullptr };
+
+    std::shared_ptr<GlyphCache> m_glyphs;
+
+    // Size of the font relative to the size of its glyphs in the atlas,
+    // and the softness of the edges of distance field glyphs at that size,
+    // or 0 for bitmap glyphs
+    float m_scale{ 1.0f };
+    float m_smoothing{ 0.0f };
+
+    int m_maxAscent{ 0 };
+    int m_maxDescent{ 0 };
+    int m_maxWidth{ 0 };
+};
+
+
+TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(renderer)
+{
+}
+
+bool
+TextureFontPrivate::buildAtlas()
+{
+    m_glyphs->initCommonGlyphs();
+    return true;
+}
+
 void
-TextureFontPrivate::optimize()
+TextureFontPrivate::setScale(float scale)
 {
-    m_inserted = 0;
+    m_scale = scale;
+    if (!m_glyphs->isDistanceField())
+        return;
+
+    // A screen pixel covers 1 / scale texels, and the field changes by
+    // 1 / (2 * spread) per texel. The edge is blurred over a pixel.
+    float smoothing = 1.0f / (4.0f * static_cast<float>(DistanceFieldSpread) * scale);
+    m_smoothing = std::min(smoothing, 0.5f);
 }
 
 /*
@@ -385,13 +687,10 @@ TextureFontPrivate::optimize()
  * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
  */
 std::pair<float, float>
-TextureFontPrivate::render(std::u16string_view line, float x, float y)
+TextureFontPrivate::render(std::u16string_view line, float x, float y, const std::optional<Color> &color)
 {
-    if (m_tex == nullptr)
-        return {0.0f, 0.0f};
-
-    // Use the texture containing the atlas
-    m_tex->bind();
+    TextBatch &batch = getTextBatch();
+    auto pageSize = static_cast<float>(m_glyphs->getAtlas().getPageSize());
 
     std::u16string_view::size_type i = 0;
     while (i < line.size())
@@ -417,34 +716,29 @@ TextureFontPrivate::render(std::u16string_view line, float x, float y)
             ++i;
             continue;
         }
-        auto &g = getGlyph(ch, u'?');
+        auto &g = m_glyphs->getGlyph(ch, u'?');
 
         // Calculate the vertex and texture coordinates
-        const float x1 = x + g.bl;
-        const float y1 = y + g.bt - g.bh;
-        const float w  = g.bw;
-        const float h  = g.bh;
-        const float x2 = x1 + w;
-        const float y2 = y1 + h;
+        const float w  = static_cast<float>(g.bw);
+        const float h  = static_cast<float>(g.bh);
+        const float x1 = x + static_cast<float>(g.bl) * m_scale;
+        const float y1 = y + (static_cast<float>(g.bt) - h) * m_scale;
+        const float x2 = x1 + w * m_scale;
+        const float y2 = y1 + h * m_scale;
 
         // Advance the cursor to the start of the next character
-        x += g.ax;
-        y += g.ay;
+        x += g.ax * m_scale;
+        y += g.ay * m_scale;
 
         // Skip glyphs that have no pixels
         if (g.bw == 0 || g.bh == 0) continue;
 
         const float tx1 = g.tx;
         const float ty1 = g.ty;
-        const float tx2 = tx1 + w / m_texWidth;
-        const float ty2 = ty1 + h / m_texHeight;
-
-        m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-        m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-        m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-        m_fontVertices.emplace_back(x2, y2, tx2, ty1);
+        const float tx2 = tx1 + w / pageSize;
+        const float ty2 = ty1 + h / pageSize;
 
-        if (m_fontVertices.size() == MaxVertices) flush();
+        batch.addQuad(g.page, x1, y1, x2, y2, tx1, ty1, tx2, ty2, color, m_smoothing);
     }
 
     return {x, y};
@@ -454,37 +748,10 @@ CelestiaGLProgram *
 TextureFontPrivate::getProgram()
 {
     if (m_prog == nullptr)
-        m_prog = m_renderer->getShaderManager().getShader("text");
+        m_prog = m_renderer->getShaderManager().getShader(m_glyphs->isDistanceField() ? "textsdf" : "text");
     return m_prog;
 }
 
-void
-TextureFontPrivate::flush()
-{
-    if (m_fontVertices.size() < 4)
-        return;
-
-    std::vector<std::uint16_t> indexes;
-    indexes.reserve(MaxIndices);
-    for (std::uint16_t index = 0; index < static_cast<std::uint16_t>(m_fontVertices.size()); index += 4)
-    {
-        indexes.push_back(index + 0);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 2);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 3);
-        indexes.push_back(index + 2);
-    }
-
-    m_vbo.bind().invalidateData().setData(m_fontVertices, gl::Buffer::BufferUsage::StreamDraw);
-    m_vio.bind().invalidateData().setData(indexes, gl::Buffer::BufferUsage::StreamDraw);
-    m_vao.draw(gl::VertexObject::Primitive::Triangles, static_cast<int>(indexes.size()));
-    m_vbo.unbind();
-    m_vio.unbind();
-
-    m_fontVertices.clear();
-}
-
 TextureFont::TextureFont(const Renderer *renderer) :
     impl(std::make_unique<TextureFontPrivate>(renderer))
 {
@@ -507,7 +774,63 @@ TextureFont::~TextureFont() = default;
 std::pair<float, float>
 TextureFont::render(std::u16string_view line, float xoffset, float yoffset) const
 {
-    return impl->render(line, xoffset, yoffset);
+    return impl->render(line, xoffset, yoffset, std::nullopt);
+}
+
+/**
+ * Render a string with the specified offset and color
+ *
+ * Unlike text rendered without a color, text with different colors can be
+ * drawn at once.
+ *
+ * @param line -- line to render
+ * @param color -- text color
+ * @param xoffset -- horizontal offset
+ * @param yoffset -- vertical offset
+ * @return the start position for the next glyph
+ */
+std::pair<float, float>
+TextureFont::render(std::u16string_view line, const Color &color, float xoffset, float yoffset) const
+{
+    return impl->render(line, xoffset, yoffset, color);
+}
+
+/**
+ * Render glyphs captured with capture()
+ *
+ * They are drawn as they were captured, with the current matrices.
+ *
+ * @param quads -- the captured glyphs
+ * @param dx -- horizontal offset from their captured position
+ * @param dy -- vertical offset from their captured position
+ */
+void
+TextureFont::render(const std::vector<GlyphQuad> &quads, float dx, float dy) const
+{
+    TextBatch &batch = getTextBatch();
+    for (const auto &q : quads)
+    {
+        std::optional<Color> color;
+        if (q.hasColor)
+            color = q.color;
+        batch.addQuad(q.page, q.x1 + dx, q.y1 + dy, q.x2 + dx, q.y2 + dy,
+                      q.tx1, q.ty1, q.tx2, q.ty2, color, q.smoothing);
+    }
+}
+
+/**
+ * Start or stop copying the rendered glyphs
+ *
+ * The glyphs of the text of all fonts rendered while quads is set are
+ * appended to it, so that the text can be drawn again without laying it
+ * out.
+ *
+ * @param quads -- where to append the glyphs, or nullptr to stop
+ */
+void
+TextureFont::capture(std::vector<GlyphQuad> *quads)
+{
+    getTextBatch().setCapture(quads);
 }
 
 /**
@@ -521,14 +844,14 @@ TextureFont::render(std::u16string_view line, float xoffset, float yoffset) cons
 int
 TextureFont::getWidth(std::u16string_view line) const
 {
-    int  width     = 0;
+    float width = 0.0f;
     for (auto ch : line)
     {
-        auto &g = impl->getGlyph(ch, u'?');
+        auto &g = impl->m_glyphs->getGlyph(ch, u'?');
         width += g.ax;
     }
 
-    return width;
+    return static_cast<int>(std::ceil(width * impl->m_scale));
 }
 
 /**
@@ -593,15 +916,13 @@ void
 TextureFont::bind()
 {
     auto *prog = impl->getProgram();
-    if (prog == nullptr || impl->m_tex == nullptr)
+    if (prog == nullptr)
         return;
 
-    glActiveTexture(GL_TEXTURE0);
-    impl->m_tex->bind();
-    prog->use();
-    prog->samplerParam("atlasTex") = 0;
-    prog->setMVPMatrices(impl->m_projection, impl->m_modelView);
-    impl->m_shaderInUse = true;
+    if (impl->m_glyphs->isDistanceField())
+        getTextBatch().setDistanceFieldProgram(prog);
+    else
+        getTextBatch().setProgram(prog);
 }
 
 /**
@@ -610,14 +931,7 @@ TextureFont::bind()
 void
 TextureFont::setMVPMatrices(const Eigen::Matrix4f &p, const Eigen::Matrix4f &m)
 {
-    impl->m_projection = p;
-    impl->m_modelView  = m;
-    auto *prog         = impl->getProgram();
-    if (prog != nullptr && impl->m_shaderInUse)
-    {
-        flush();
-        prog->setMVPMatrices(p, m);
-    }
+    getTextBatch().setMatrices(p, m);
 }
 
 /**
@@ -627,16 +941,17 @@ void
 TextureFont::unbind()
 {
     flush();
-    impl->m_shaderInUse = false;
 }
 
 /**
  * Perform all delayed text rendering operations.
+ *
+ * The text of all fonts is drawn, as it is batched together.
  */
 void
 TextureFont::flush()
 {
-    impl->flush();
+    getTextBatch().flush();
 }
 
 namespace
@@ -670,6 +985,30 @@ LoadFontFace(FT_Library ft, const fs::path &path, int index, int size, int dpi)
     return face;
 }
 
+// Distance field glyphs by face, shared by all the sizes of a font
+using DistanceFieldCache = std::map<std::pair<fs::path, int>, std::weak_ptr<GlyphCache>>;
+
+std::shared_ptr<GlyphCache>
+GetDistanceFieldGlyphs(FT_Library ft, const fs::path &path, int index)
+{
+    static DistanceFieldCache *cache = new DistanceFieldCache;
+
+    std::weak_ptr<GlyphCache> &entry = (*cache)[{ path, index }];
+    std::shared_ptr<GlyphCache> glyphs = entry.lock();
+    if (glyphs == nullptr)
+    {
+        // Sizes in points are sizes in pixels at 72 dpi
+        FT_Face face = LoadFontFace(ft, path, index, DistanceFieldSize, 72);
+        if (face == nullptr)
+            return nullptr;
+
+        glyphs = std::make_shared<GlyphCache>(face, true);
+        glyphs->initCommonGlyphs();
+        entry = glyphs;
+    }
+    return glyphs;
+}
+
 } // namespace
 
 // temporary while no fontconfig support
@@ -721,10 +1060,17 @@ LoadTextureFont(const Renderer *r, const fs::path &filename, int index, int size
 {
     // Init FreeType library
     static FT_Library ftlib = nullptr;
-    if (ftlib == nullptr && FT_Init_FreeType(&ftlib) != 0)
+    if (ftlib == nullptr)
     {
-        GetLogger()->error("Could not init freetype library\n");
-        return nullptr;
+        if (FT_Init_FreeType(&ftlib) != 0)
+        {
+            GetLogger()->error("Could not init freetype library\n");
+            return nullptr;
+        }
+#if HAVE_FT_SDF
+        FT_Int spread = DistanceFieldSpread;
+        FT_Property_Set(ftlib, "sdf", "spread", &spread);
+#endif
     }
 
     // Init FontCache
@@ -742,24 +1088,34 @@ LoadTextureFont(const Renderer *r, const fs::path &filename, int index, int size
         int  psize    = TextureFont::kDefaultSize;
         int  pindex   = 0;
         auto nameonly = ParseFontName(filename, pindex, psize);
-        auto face     = LoadFontFace(ftlib, nameonly,
-                                     index > 0 ? index : pindex,
-                                     size > 0 ? size : psize,
-                                     screenDpi);
-        if (face == nullptr)
-            return nullptr;
+        int  findex   = index > 0 ? index : pindex;
+        int  fsize    = size > 0 ? size : psize;
 
         ret = std::make_shared<TextureFont>(r);
-        ret->impl->m_face = face;
+        if (HAVE_FT_SDF && r->getDistanceFieldFonts())
+        {
+            auto glyphs = GetDistanceFieldGlyphs(ftlib, nameonly, findex);
+            if (glyphs == nullptr)
+                return nullptr;
 
-        if (!ret->impl->buildAtlas())
+            ret->impl->m_glyphs = std::move(glyphs);
+            ret->impl->setScale(static_cast<float>(fsize * screenDpi) / static_cast<float>(72 * DistanceFieldSize));
+        }
+        else
         {
-            FT_Done_Face(face);
-            return nullptr;
+            auto face = LoadFontFace(ftlib, nameonly, findex, fsize, screenDpi);
+            if (face == nullptr)
+                return nullptr;
+
+            ret->impl->m_glyphs = std::make_shared<GlyphCache>(face, false);
+            if (!ret->impl->buildAtlas())
+                return nullptr;
         }
 
-        ret->setMaxAscent(static_cast<int>(face->size->metrics.ascender >> 6));
-        ret->setMaxDescent(static_cast<int>(-face->size->metrics.descender >> 6));
+        const FT_Size_Metrics &metrics = ret->impl->m_glyphs->getFace()->size->metrics;
+        float scale = ret->impl->m_scale;
+        ret->setMaxAscent(static_cast<int>(static_cast<float>(metrics.ascender >> 6) * scale));
+        ret->setMaxDescent(static_cast<int>(static_cast<float>(-metrics.descender >> 6) * scale));
 
         font = ret;
     }
@@ -9,12 +9,15 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string_view>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <celcompat/filesystem.h>
+#include <celutil/color.h>
 
 
 class Renderer;
@@ -26,6 +29,20 @@ LoadTextureFont(const Renderer *, const fs::path &, int index = 0, int size = 0)
 fs::path
 ParseFontName(const fs::path &, int &, int &);
 
+// A glyph of rendered text, in model coordinates. The glyphs of all fonts
+// share the same textures, so glyphs of several fonts can be drawn again
+// with any of them.
+struct GlyphQuad
+{
+    std::size_t page;
+    float x1, y1, x2, y2;
+    float tx1, ty1, tx2, ty2;
+    Color color;
+    bool hasColor;
+    // Softness of the edges of a distance field glyph, 0 for bitmap glyphs
+    float smoothing;
+};
+
 struct TextureFontPrivate;
 class TextureFont
 {
@@ -44,6 +61,14 @@ public:
                         const Eigen::Matrix4f &m = Eigen::Matrix4f::Identity());
 
     std::pair<float, float> render(std::u16string_view line, float xoffset = 0.0f, float yoffset = 0.0f) const;
+    std::pair<float, float> render(std::u16string_view line, const Color &color, float xoffset = 0.0f, float yoffset = 0.0f) const;
+
+    // Render glyphs captured before, moved by (dx, dy)
+    void render(const std::vector<GlyphQuad> &quads, float dx, float dy) const;
+
+    // Append the glyphs of all the text rendered afterwards to quads, until
+    // it is called with nullptr
+    static void capture(std::vector<GlyphQuad> *quads);
 
     int getWidth(std::u16string_view) const;
     int getMaxWidth() const;
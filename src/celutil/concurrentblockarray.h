@@ -0,0 +1,232 @@
+// concurrentblockarray.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/*! ConcurrentBlockArray is a variant of BlockArray which several threads
+ *  can append to at once, e.g. catalog loaders running in parallel.
+ *  Like BlockArray, the elements are stored in fixed-size blocks and their
+ *  addresses don't change until the array is cleared.
+ *
+ *  Each thread appends through its own Appender, which reserves whole
+ *  blocks from the array and fills them without any synchronization; the
+ *  only shared state is the count of reserved blocks, which is advanced
+ *  with a single atomic add, so appending never waits for another thread.
+ *  The block table has a fixed capacity set at construction so that it is
+ *  never reallocated under the appenders.
+ *
+ *  Blocks are kept in the order in which they were reserved. Since a
+ *  block is only filled by the appender which reserved it, the array may
+ *  have gaps at the end of each appender's last block and in reserved
+ *  blocks it never used; forEach skips over them. Reading the array with
+ *  size or forEach while appenders are still adding to it is safe, but
+ *  only sees the elements added so far.
+ */
+template<class T> class ConcurrentBlockArray
+{
+private:
+    struct Block
+    {
+        std::atomic<T*> elements{ nullptr };
+        std::atomic<unsigned int> count{ 0 };
+    };
+
+public:
+    /*! Appends to a ConcurrentBlockArray from a single thread. Blocks are
+     *  reserved reservedBlocks at a time, so an appender created for a
+     *  known number of elements can reserve the blocks for all of them up
+     *  front; appenders created one after the other then keep their
+     *  elements in order of creation.
+     */
+    class Appender
+    {
+    public:
+        explicit Appender(ConcurrentBlockArray& array, unsigned int reservedBlocks = 1) :
+            m_array(&array),
+            m_reservedBlocks(std::max(reservedBlocks, 1U))
+        {
+            if (reservedBlocks > 0)
+                reserve();
+        }
+
+        /*! Append an item, returning its address, or nullptr if the
+         *  array's block table is full.
+         */
+        T* add(const T& element)
+        {
+            T* slot = newElement();
+            if (slot != nullptr)
+            {
+                *slot = element;
+                publish();
+            }
+            return slot;
+        }
+
+        T* add(T&& element)
+        {
+            T* slot = newElement();
+            if (slot != nullptr)
+            {
+                *slot = std::move(element);
+                publish();
+            }
+            return slot;
+        }
+
+    private:
+        void reserve()
+        {
+            unsigned int maxBlocks = m_array->m_maxBlocks;
+            if (m_array->m_reservedCount.load(std::memory_order_relaxed) >= maxBlocks)
+            {
+                m_nextBlock = m_endBlock = maxBlocks;
+                return;
+            }
+
+            unsigned int first = m_array->m_reservedCount.fetch_add(m_reservedBlocks, std::memory_order_relaxed);
+            m_nextBlock = std::min(first, maxBlocks);
+            m_endBlock = maxBlocks - m_nextBlock > m_reservedBlocks ? m_nextBlock + m_reservedBlocks : maxBlocks;
+        }
+
+        T* newElement()
+        {
+            if (m_block == nullptr || m_count == m_array->m_blockSize)
+            {
+                if (m_nextBlock == m_endBlock)
+                    reserve();
+                if (m_nextBlock == m_endBlock)
+                    return nullptr;
+
+                m_block = &m_array->m_blocks[m_nextBlock++];
+                m_elements = std::make_unique<T[]>(m_array->m_blockSize).release();
+                m_block->elements.store(m_elements, std::memory_order_release);
+                m_count = 0;
+            }
+
+            return m_elements + m_count;
+        }
+
+        void publish()
+        {
+            ++m_count;
+            m_block->count.store(m_count, std::memory_order_release);
+        }
+
+        ConcurrentBlockArray* m_array;
+        unsigned int m_reservedBlocks;
+        // Range of reserved blocks which haven't been started
+        unsigned int m_nextBlock{ 0 };
+        unsigned int m_endBlock{ 0 };
+        Block* m_block{ nullptr };
+        T* m_elements{ nullptr };
+        unsigned int m_count{ 0 };
+    };
+
+    explicit ConcurrentBlockArray(unsigned int blockSize = 1000, unsigned int maxBlocks = 16384) :
+        m_blockSize(std::max(blockSize, 1U)),
+        m_maxBlocks(maxBlocks),
+        m_blocks(std::make_unique<Block[]>(maxBlocks))
+    {
+    }
+
+    ~ConcurrentBlockArray()
+    {
+        clear();
+    }
+
+    ConcurrentBlockArray(const ConcurrentBlockArray&) = delete;
+    ConcurrentBlockArray& operator=(const ConcurrentBlockArray&) = delete;
+    ConcurrentBlockArray(ConcurrentBlockArray&&) = delete;
+    ConcurrentBlockArray& operator=(ConcurrentBlockArray&&) = delete;
+
+    unsigned int size() const
+    {
+        unsigned int elementCount = 0;
+        for (unsigned int i = 0; i < reservedBlocks(); ++i)
+            elementCount += m_blocks[i].count.load(std::memory_order_acquire);
+        return elementCount;
+    }
+
+    /*! Append an item from the thread owning the array. This uses an
+     *  appender of the array's own, so it must not be called concurrently
+     *  with itself or with clear.
+     */
+    T* add(const T& element)
+    {
+        return m_appender.add(element);
+    }
+
+    T* add(T&& element)
+    {
+        return m_appender.add(std::move(element));
+    }
+
+    /*! Call f on each element, in the order of the blocks. */
+    template<typename F>
+    void forEach(F&& f)
+    {
+        for (unsigned int i = 0; i < reservedBlocks(); ++i)
+        {
+            const Block& block = m_blocks[i];
+            unsigned int count = block.count.load(std::memory_order_acquire);
+            T* elements = block.elements.load(std::memory_order_acquire);
+            for (unsigned int j = 0; j < count; ++j)
+                f(elements[j]);
+        }
+    }
+
+    template<typename F>
+    void forEach(F&& f) const
+    {
+        for (unsigned int i = 0; i < reservedBlocks(); ++i)
+        {
+            const Block& block = m_blocks[i];
+            unsigned int count = block.count.load(std::memory_order_acquire);
+            const T* elements = block.elements.load(std::memory_order_acquire);
+            for (unsigned int j = 0; j < count; ++j)
+                f(elements[j]);
+        }
+    }
+
+    /*! Remove all the elements. No appender may be in use, and appenders
+     *  created before clearing the array must not be used afterwards.
+     */
+    void clear()
+    {
+        for (unsigned int i = 0; i < reservedBlocks(); ++i)
+        {
+            Block& block = m_blocks[i];
+            // Sonar lint against use of delete is not useful here
+            delete[] block.elements.exchange(nullptr, std::memory_order_relaxed); //NOSONAR
+            block.count.store(0, std::memory_order_relaxed);
+        }
+
+        m_reservedCount.store(0, std::memory_order_relaxed);
+        m_appender = Appender(*this, 0);
+    }
+
+private:
+    unsigned int reservedBlocks() const
+    {
+        return std::min(m_reservedCount.load(std::memory_order_acquire), m_maxBlocks);
+    }
+
+    unsigned int m_blockSize;
+    unsigned int m_maxBlocks;
+    std::unique_ptr<Block[]> m_blocks;
+    // May run past m_maxBlocks when the table is full
+    std::atomic<unsigned int> m_reservedCount{ 0 };
+    Appender m_appender{ *this, 0 };
+};
@@ -44,6 +44,7 @@ constexpr std::string_view CelestiaModelExt = ".cmod"sv;
 constexpr std::string_view CelestiaXYZTrajectoryExt = ".xyz"sv;
 constexpr std::string_view CelestiaXYZVTrajectoryExt = ".xyzv"sv;
 constexpr std::string_view ContentXYZVBinaryExt = ".xyzvbin"sv;
+constexpr std::string_view ContentXYZVChebyshevExt = ".xyzvcheb"sv;
 constexpr std::string_view ContentWarpMeshExt = ".map"sv;
 
 } // end unnamed namespace
@@ -101,5 +102,7 @@ ContentType DetermineFileType(const fs::path& filename, bool isExtension)
         return ContentType::WarpMesh;
     if (compareIgnoringCase(ContentXYZVBinaryExt, ext) == 0)
         return ContentType::CelestiaXYZVBinary;
+    if (compareIgnoringCase(ContentXYZVChebyshevExt, ext) == 0)
+        return ContentType::CelestiaXYZVChebyshev;
     return ContentType::Unknown;
 }
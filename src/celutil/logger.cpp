@@ -9,7 +9,19 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -20,6 +32,354 @@
 namespace celestia::util
 {
 
+namespace
+{
+
+Logger::Stream&
+selectStream(Level level, Logger::Stream& log, Logger::Stream& err)
+{
+    return (level <= Level::Warning || level == Level::Debug) ? err : log;
+}
+
+
+void
+writeMessage(Level level, std::string_view message, Logger::Stream& log, Logger::Stream& err)
+{
+#ifdef _MSC_VER
+    if (level == Level::Debug && IsDebuggerPresent())
+    {
+        OutputDebugStringA(std::string(message).c_str());
+        return;
+    }
+#endif
+
+    selectStream(level, log, err).write(message.data(), static_cast<std::streamsize>(message.size()));
+}
+
+
+void
+flushLogger()
+{
+    if (const Logger* logger = GetLogger(); logger != nullptr)
+        logger->flush();
+}
+
+} // end unnamed namespace
+
+
+namespace detail
+{
+
+/*! The backend of the asynchronous mode. Messages are passed to the
+ *  writer thread through a bounded multiple producer queue, in which each
+ *  slot has a sequence number telling whether it is free or holds a
+ *  message; producers claim a slot by advancing the head position. When
+ *  the queue is full the message is dropped and counted rather than
+ *  making the caller wait.
+ *
+ *  The rate limiter keeps a table of format strings, identified by their
+ *  address, with the number of messages in the current window.
+ */
+class AsyncLogWriter
+{
+public:
+    AsyncLogWriter(Logger::Stream& log, Logger::Stream& err);
+    ~AsyncLogWriter();
+
+    AsyncLogWriter(const AsyncLogWriter&) = delete;
+    AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+    // Return whether a message with this format is within the limit
+    bool allow(const char* format);
+
+    void push(Level level, std::string&& message);
+    void flush();
+
+private:
+    static constexpr std::size_t Capacity = 4096;
+    static constexpr std::size_t RateTableSize = 1024;
+    static constexpr std::size_t MaxProbes = 16;
+    static constexpr std::uint32_t MessagesPerWindow = 10;
+    static constexpr std::int64_t WindowLength = 1000; // milliseconds
+    static constexpr std::size_t SummaryLength = 80;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence{ 0 };
+        Level level{ Level::Info };
+        std::string message;
+    };
+
+    struct RateEntry
+    {
+        std::atomic<const char*> format{ nullptr };
+        std::atomic<std::int64_t> windowStart{ 0 };
+        std::atomic<std::uint32_t> count{ 0 };
+        std::atomic<std::uint32_t> suppressed{ 0 };
+        // The start of the format, copied when the entry is claimed as
+        // the format string might not outlive it
+        char summary[SummaryLength]{};
+    };
+
+    static std::int64_t now();
+
+    bool pop(Level& level, std::string& message);
+    bool empty() const;
+    void run();
+    void reportSuppressed(RateEntry& entry);
+
+    Logger::Stream& m_log;
+    Logger::Stream& m_err;
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<std::size_t> m_head{ 0 };
+    std::size_t m_tail{ 0 };
+    std::atomic<std::size_t> m_dropped{ 0 };
+
+    std::unique_ptr<RateEntry[]> m_rates;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_flushed;
+    std::atomic<bool> m_sleeping{ false };
+    std::size_t m_written{ 0 };
+    std::size_t m_flushRequests{ 0 };
+    bool m_stop{ false };
+    std::thread m_writer;
+};
+
+
+// Marks a rate table entry whose summary is being copied
+const char ClaimingEntry = '\0';
+
+
+AsyncLogWriter::AsyncLogWriter(Logger::Stream& log, Logger::Stream& err) :
+    m_log(log),
+    m_err(err),
+    m_slots(std::make_unique<Slot[]>(Capacity)),
+    m_rates(std::make_unique<RateEntry[]>(RateTableSize))
+{
+    for (std::size_t i = 0; i < Capacity; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    m_writer = std::thread(&AsyncLogWriter::run, this);
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    flush();
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_one();
+    m_writer.join();
+}
+
+
+std::int64_t
+AsyncLogWriter::now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+bool
+AsyncLogWriter::allow(const char* format)
+{
+    std::size_t index = std::hash<const void*>()(format) % RateTableSize;
+    RateEntry* entry = nullptr;
+    for (std::size_t probe = 0; probe < MaxProbes; ++probe, index = (index + 1) % RateTableSize)
+    {
+        RateEntry& candidate = m_rates[index];
+        const char* key = candidate.format.load(std::memory_order_acquire);
+        if (key == nullptr &&
+            candidate.format.compare_exchange_strong(key, &ClaimingEntry, std::memory_order_acquire))
+        {
+            std::size_t length = std::strcspn(format, "\n");
+            length = std::min(length, SummaryLength - 1);
+            std::memcpy(candidate.summary, format, length);
+            candidate.summary[length] = '\0';
+            candidate.windowStart.store(now(), std::memory_order_relaxed);
+            candidate.format.store(format, std::memory_order_release);
+            key = format;
+        }
+
+        if (key == format)
+        {
+            entry = &candidate;
+            break;
+        }
+    }
+
+    // Formats which don't fit in the table aren't limited
+    if (entry == nullptr)
+        return true;
+
+    std::int64_t time = now();
+    std::int64_t start = entry->windowStart.load(std::memory_order_relaxed);
+    if (time - start >= WindowLength &&
+        entry->windowStart.compare_exchange_strong(start, time, std::memory_order_relaxed))
+    {
+        entry->count.store(0, std::memory_order_relaxed);
+        reportSuppressed(*entry);
+    }
+
+    if (entry->count.fetch_add(1, std::memory_order_relaxed) < MessagesPerWindow)
+        return true;
+
+    entry->suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+
+// Queue a note about the messages of the entry suppressed since the last
+// report
+void
+AsyncLogWriter::reportSuppressed(RateEntry& entry)
+{
+    std::uint32_t count = entry.suppressed.exchange(0, std::memory_order_relaxed);
+    if (count > 0)
+    {
+        push(Level::Warning,
+             fmt::format("{} more messages like \"{}\" were suppressed\n", count, entry.summary));
+    }
+}
+
+
+void
+AsyncLogWriter::push(Level level, std::string&& message)
+{
+    std::size_t position = m_head.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;)
+    {
+        slot = &m_slots[position % Capacity];
+        std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+        if (difference == 0)
+        {
+            if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // The writer hasn't freed this slot yet
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->message = std::move(message);
+    slot->sequence.store(position + 1);
+
+    // The writer sets m_sleeping before it checks for messages
+    if (m_sleeping.load())
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+        }
+        m_condition.notify_one();
+    }
+}
+
+
+bool
+AsyncLogWriter::pop(Level& level, std::string& message)
+{
+    Slot& slot = m_slots[m_tail % Capacity];
+    if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1)
+        return false;
+
+    level = slot.level;
+    message.swap(slot.message);
+    slot.message.clear();
+    slot.sequence.store(m_tail + Capacity, std::memory_order_release);
+    ++m_tail;
+    return true;
+}
+
+
+bool
+AsyncLogWriter::empty() const
+{
+    return m_slots[m_tail % Capacity].sequence.load() != m_tail + 1;
+}
+
+
+void
+AsyncLogWriter::run()
+{
+    Level level = Level::Info;
+    std::string message;
+    for (;;)
+    {
+        bool wrote = false;
+        while (pop(level, message))
+        {
+            writeMessage(level, message, m_log, m_err);
+            wrote = true;
+        }
+
+        if (std::size_t dropped = m_dropped.exchange(0, std::memory_order_relaxed); dropped > 0)
+        {
+            fmt::print(m_err, "{} log messages were dropped\n", dropped);
+            wrote = true;
+        }
+
+        // Flush once per batch rather than once per message
+        if (wrote)
+        {
+            m_log.flush();
+            m_err.flush();
+        }
+
+        std::unique_lock lock(m_mutex);
+        m_written = m_tail;
+        m_flushed.notify_all();
+        if (m_stop && empty())
+            break;
+
+        std::size_t flushRequests = m_flushRequests;
+        m_sleeping.store(true);
+        // The timeout covers messages whose slot was claimed but not yet
+        // filled when the writer last looked
+        m_condition.wait_for(lock, std::chrono::milliseconds(100),
+                             [&] { return m_stop || m_flushRequests != flushRequests || !empty(); });
+        m_sleeping.store(false);
+    }
+}
+
+
+void
+AsyncLogWriter::flush()
+{
+    for (std::size_t i = 0; i < RateTableSize; ++i)
+    {
+        if (const char* key = m_rates[i].format.load(std::memory_order_acquire);
+            key != nullptr && key != &ClaimingEntry)
+        {
+            reportSuppressed(m_rates[i]);
+        }
+    }
+
+    std::size_t target = m_head.load();
+    std::unique_lock lock(m_mutex);
+    ++m_flushRequests;
+    m_condition.notify_one();
+    m_flushed.wait(lock, [&] { return m_written >= target; });
+}
+
+} // end namespace detail
+
+
 Logger* Logger::g_logger = nullptr;
 
 Logger* GetLogger()
@@ -42,6 +402,7 @@ Logger* CreateLogger(Level level, Logger::Stream &log, Logger::Stream &err)
 void DestroyLogger()
 {
     delete Logger::g_logger;
+    Logger::g_logger = nullptr;
 }
 
 Logger::Logger() :
@@ -50,18 +411,62 @@ Logger::Logger() :
 {
 }
 
+Logger::Logger(Level level, Stream &log, Stream &err) :
+    m_log(log),
+    m_err(err),
+    m_level(level)
+{
+}
+
+// Destroying the writer writes the queued messages
+Logger::~Logger() = default;
+
+void Logger::setAsynchronous(bool async)
+{
+    if (!async)
+    {
+        m_async = nullptr;
+        return;
+    }
+
+    if (m_async != nullptr)
+        return;
+
+    m_async = std::make_unique<detail::AsyncLogWriter>(m_log, m_err);
+
+    // Write the queued messages of the global logger when the program
+    // exits without destroying it
+    static bool flushRegistered = false;
+    if (!flushRegistered)
+    {
+        std::atexit(flushLogger);
+        flushRegistered = true;
+    }
+}
+
+void Logger::flush() const
+{
+    if (m_async != nullptr)
+    {
+        m_async->flush();
+    }
+    else
+    {
+        m_log.flush();
+        m_err.flush();
+    }
+}
+
 void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) const
 {
-#ifdef _MSC_VER
-    if (level == Level::Debug && IsDebuggerPresent())
+    if (m_async == nullptr)
     {
-        OutputDebugStringA(fmt::vformat(format, args).c_str());
+        writeMessage(level, fmt::vformat(format, args), m_log, m_err);
         return;
     }
-#endif
 
-    auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
-    fmt::vprint(stream, format, args);
+    if (m_async->allow(format.data()))
+        m_async->push(level, fmt::vformat(format, args));
 }
 
 } // end namespace celestia::util
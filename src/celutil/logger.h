@@ -12,6 +12,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
 #include <fmt/format.h>
@@ -31,6 +32,11 @@ struct fmt::formatter<fs::path> : formatter<std::string>
 namespace celestia::util
 {
 
+namespace detail
+{
+class AsyncLogWriter;
+}
+
 enum class Level
 {
     Error,
@@ -46,17 +52,24 @@ class Logger
     using Stream = std::basic_ostream<char>;
 
     Logger();
-    Logger(Level level, Stream &log, Stream &err) :
-        m_log(log),
-        m_err(err),
-        m_level(level)
-    {}
+    Logger(Level level, Stream &log, Stream &err);
+    ~Logger();
 
     void setLevel(Level level)
     {
         m_level = level;
     }
 
+    // In the asynchronous mode messages are formatted by the calling
+    // thread and queued, a background thread writes them to the streams.
+    // Repeated messages, which are those logged with the same format
+    // string, are limited to a few per second; the number suppressed is
+    // reported. Must not be changed while other threads are logging.
+    void setAsynchronous(bool async);
+
+    // Wait until the queued messages have been written
+    void flush() const;
+
     template <typename... Args> inline void
     debug(const char *format, const Args&... args) const;
 
@@ -83,6 +96,7 @@ class Logger
     Stream &m_log;
     Stream &m_err;
     Level   m_level { Level::Info };
+    std::unique_ptr<detail::AsyncLogWriter> m_async;
 };
 
 template <typename... Args> void
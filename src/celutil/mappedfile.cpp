@@ -0,0 +1,184 @@
+// mappedfile.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Read-only memory-mapped file access.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "mappedfile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace celestia::util
+{
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_data(std::exchange(other.m_data, nullptr)),
+    m_size(std::exchange(other.m_size, 0))
+#ifdef _WIN32
+    , m_mapping(std::exchange(other.m_mapping, nullptr))
+#endif
+{
+}
+
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+
+    return *this;
+}
+
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+
+#ifdef _WIN32
+
+std::optional<MappedFile>
+MappedFile::open(const fs::path& path)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return std::nullopt;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping keeps its own reference to the file
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return std::nullopt;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return std::nullopt;
+    }
+
+    MappedFile result;
+    result.m_data = static_cast<const char*>(view);
+    result.m_size = static_cast<std::size_t>(fileSize.QuadPart);
+    result.m_mapping = mapping;
+    return result;
+}
+
+
+void
+MappedFile::adviseSequential() const
+{
+    // FILE_FLAG_SEQUENTIAL_SCAN is already set when opening the file
+}
+
+
+void
+MappedFile::adviseWillNeed() const
+{
+    // Windows reads ahead of sequential page faults already
+}
+
+
+void
+MappedFile::unmap()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+}
+
+#else
+
+std::optional<MappedFile>
+MappedFile::open(const fs::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::nullopt;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return std::nullopt;
+
+    MappedFile result;
+    result.m_data = static_cast<const char*>(addr);
+    result.m_size = size;
+    return result;
+}
+
+
+void
+MappedFile::adviseSequential() const
+{
+    if (m_data != nullptr)
+        madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL); //NOSONAR
+}
+
+
+void
+MappedFile::adviseWillNeed() const
+{
+    if (m_data != nullptr)
+        madvise(const_cast<char*>(m_data), m_size, MADV_WILLNEED); //NOSONAR
+}
+
+
+void
+MappedFile::unmap()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size); //NOSONAR
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+} // end namespace celestia::util
@@ -0,0 +1,60 @@
+// mappedfile.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Read-only memory-mapped file access.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+/*! A read-only view of a file mapped into the address space of the process.
+ *  The mapping is released when the object is destroyed. Empty files can't
+ *  be mapped, MappedFile::open returns std::nullopt for them as well as for
+ *  files which can't be opened.
+ */
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    MappedFile& operator=(MappedFile&&) noexcept;
+
+    static std::optional<MappedFile> open(const fs::path&);
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    // Hint to the OS that the file will be read sequentially from start to end.
+    void adviseSequential() const;
+
+    // Hint to the OS that the whole file will be read soon, so that it
+    // starts reading it in the background.
+    void adviseWillNeed() const;
+
+private:
+    MappedFile() = default;
+    void unmap();
+
+    const char* m_data{ nullptr };
+    std::size_t m_size{ 0 };
+#ifdef _WIN32
+    void* m_mapping{ nullptr };
+#endif
+};
+
+} // end namespace celestia::util
@@ -0,0 +1,90 @@
+// memoryaccounting.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Live memory of the engine subsystems.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "memoryaccounting.h"
+
+#include <array>
+#include <atomic>
+
+using namespace std::string_view_literals;
+
+namespace celestia::util
+{
+
+namespace
+{
+
+constexpr std::array<std::string_view, MemoryTagCount> TagNames
+{
+    "Stars"sv,
+    "Names"sv,
+    "Textures"sv,
+    "Geometry"sv,
+    "Orbits"sv,
+    "Scripts"sv,
+};
+
+#ifdef ENABLE_MEMORY_ACCOUNTING
+// Relaxed atomics are enough as the counts are only read for reporting
+std::array<std::atomic<std::size_t>, MemoryTagCount> liveBytes{};
+#endif
+
+} // end unnamed namespace
+
+std::string_view
+MemoryTagName(MemoryTag tag)
+{
+    return TagNames[static_cast<std::size_t>(tag)];
+}
+
+#ifdef ENABLE_MEMORY_ACCOUNTING
+
+void
+AddMemory(MemoryTag tag, std::size_t bytes)
+{
+    liveBytes[static_cast<std::size_t>(tag)].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void
+RemoveMemory(MemoryTag tag, std::size_t bytes)
+{
+    liveBytes[static_cast<std::size_t>(tag)].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+std::size_t
+LiveMemory(MemoryTag tag)
+{
+    return liveBytes[static_cast<std::size_t>(tag)].load(std::memory_order_relaxed);
+}
+
+#else
+
+void
+AddMemory(MemoryTag, std::size_t)
+{
+    // Not compiled in
+}
+
+void
+RemoveMemory(MemoryTag, std::size_t)
+{
+    // Not compiled in
+}
+
+std::size_t
+LiveMemory(MemoryTag)
+{
+    return 0;
+}
+
+#endif
+
+} // end namespace celestia::util
@@ -0,0 +1,108 @@
+// memoryaccounting.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Live memory of the engine subsystems.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace celestia::util
+{
+
+// The subsystems whose memory is accounted
+enum class MemoryTag
+{
+    Stars,
+    Names,
+    Textures,
+    Geometry,
+    Orbits,
+    Scripts,
+};
+
+constexpr inline std::size_t MemoryTagCount = 6;
+
+#ifdef ENABLE_MEMORY_ACCOUNTING
+constexpr inline bool MemoryAccountingEnabled = true;
+#else
+constexpr inline bool MemoryAccountingEnabled = false;
+#endif
+
+std::string_view MemoryTagName(MemoryTag);
+
+// Record bytes allocated or released by a subsystem. These do nothing
+// unless the accounting is compiled in with ENABLE_MEMORY_ACCOUNTING.
+void AddMemory(MemoryTag, std::size_t bytes);
+void RemoveMemory(MemoryTag, std::size_t bytes);
+
+// The live bytes of a subsystem, always 0 if the accounting isn't compiled in
+std::size_t LiveMemory(MemoryTag);
+
+/*! The bytes held by one object of a subsystem, added to the live bytes
+ *  of its tag for as long as the record exists. Objects keep one as a
+ *  member and update it when their storage changes size; copying the
+ *  object copies the record and accounts the bytes again.
+ */
+class MemoryRecord
+{
+public:
+    explicit MemoryRecord(MemoryTag tag) : m_tag(tag) {}
+    ~MemoryRecord() { set(0); }
+
+    MemoryRecord(const MemoryRecord& other) : m_tag(other.m_tag) { set(other.m_bytes); }
+    MemoryRecord(MemoryRecord&& other) noexcept : m_tag(other.m_tag), m_bytes(other.m_bytes)
+    {
+        other.m_bytes = 0;
+    }
+
+    MemoryRecord& operator=(const MemoryRecord& other)
+    {
+        if (this != &other)
+        {
+            set(0);
+            m_tag = other.m_tag;
+            set(other.m_bytes);
+        }
+        return *this;
+    }
+
+    MemoryRecord& operator=(MemoryRecord&& other) noexcept
+    {
+        if (this != &other)
+        {
+            set(0);
+            m_tag = other.m_tag;
+            m_bytes = other.m_bytes;
+            other.m_bytes = 0;
+        }
+        return *this;
+    }
+
+    void set(std::size_t bytes)
+    {
+        if constexpr (MemoryAccountingEnabled)
+        {
+            if (bytes > m_bytes)
+                AddMemory(m_tag, bytes - m_bytes);
+            else if (bytes < m_bytes)
+                RemoveMemory(m_tag, m_bytes - bytes);
+        }
+        m_bytes = bytes;
+    }
+
+    std::size_t bytes() const { return m_bytes; }
+
+private:
+    MemoryTag m_tag;
+    std::size_t m_bytes{ 0 };
+};
+
+} // end namespace celestia::util
@@ -0,0 +1,79 @@
+// monotonicarena.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "monotonicarena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace celestia::util
+{
+
+MonotonicArena::MonotonicArena(std::size_t blockSize) :
+    m_blockSize(std::max(blockSize, std::size_t{ 64 }))
+{
+}
+
+
+void*
+MonotonicArena::allocate(std::size_t size, std::size_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (!m_blocks.empty())
+    {
+        Block& block = m_blocks.back();
+        auto address = reinterpret_cast<std::uintptr_t>(block.data.get()) + m_used;
+        std::size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        if (padding + size <= block.size - m_used)
+        {
+            std::byte* result = block.data.get() + m_used + padding;
+            m_used += padding + size;
+            return result;
+        }
+    }
+
+    // Blocks come from operator new, which aligns them for any standard type
+    std::size_t blockSize = std::max(m_blockSize, size + alignment);
+    m_blocks.push_back({ std::make_unique<std::byte[]>(blockSize), blockSize });
+
+    Block& block = m_blocks.back();
+    auto address = reinterpret_cast<std::uintptr_t>(block.data.get());
+    std::size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+    m_used = padding + size;
+    return block.data.get() + padding;
+}
+
+
+void
+MonotonicArena::reset()
+{
+    m_used = 0;
+    if (m_blocks.size() <= 1)
+        return;
+
+    // Replace the blocks by one large enough for all of them, so the next
+    // round of allocations fits into a single block
+    std::size_t total = capacity();
+    m_blocks.clear();
+    m_blocks.push_back({ std::make_unique<std::byte[]>(total), total });
+}
+
+
+std::size_t
+MonotonicArena::capacity() const
+{
+    std::size_t total = 0;
+    for (const Block& block : m_blocks)
+        total += block.size;
+    return total;
+}
+
+}
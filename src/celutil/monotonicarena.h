@@ -0,0 +1,103 @@
+// monotonicarena.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Memory for temporary objects which are released all at once.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace celestia::util
+{
+
+/*! MonotonicArena hands out memory from large blocks and never frees
+ *  single allocations; all of them are released at once by reset(). The
+ *  memory is kept for reuse, and blocks added since the last reset are
+ *  merged into one, so an arena reset every frame stops allocating once
+ *  it holds the memory used by the largest frame.
+ */
+class MonotonicArena
+{
+public:
+    explicit MonotonicArena(std::size_t blockSize = 65536);
+    ~MonotonicArena() = default;
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    // Return size bytes aligned to alignment, which must be a power of two
+    void* allocate(std::size_t size, std::size_t alignment);
+
+    // Release all allocations. Memory handed out before must not be used
+    // afterwards.
+    void reset();
+
+    // Total size of the memory held by the arena
+    std::size_t capacity() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::size_t m_blockSize;
+    std::size_t m_used{ 0 };
+    std::vector<Block> m_blocks;
+};
+
+
+/*! Allocator for standard containers which takes memory from an arena.
+ *  Deallocation does nothing, so containers which grow a lot waste the
+ *  memory of their earlier buffers until the arena is reset; reserve
+ *  their size first where it is known.
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MonotonicArena& arena) noexcept : m_arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_arena(other.arena()) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) noexcept
+    {
+        // Released when the arena is reset
+    }
+
+    MonotonicArena* arena() const noexcept { return m_arena; }
+
+private:
+    MonotonicArena* m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept
+{
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept
+{
+    return a.arena() != b.arena();
+}
+
+}
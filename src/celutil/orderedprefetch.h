@@ -0,0 +1,129 @@
+// orderedprefetch.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Run a sequence of tasks ahead on worker threads and collect the results
+// in order.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <utility>
+
+#include <celutil/taskscheduler.h>
+
+namespace celestia::util
+{
+
+/*! Runs task(0) ... task(count - 1) as background tasks of the shared
+ *  scheduler, keeping at most maxInFlight of them pending, and hands out
+ *  the results in index order.
+ *  This is used to read and parse catalog files while an earlier file is
+ *  being merged into a database, which has to happen in order.
+ *
+ *  The task must be safe to call concurrently with itself and with the
+ *  code consuming the results. Pending tasks are waited for when the
+ *  object is destroyed.
+ */
+template<typename T>
+class OrderedPrefetch
+{
+public:
+    using TaskFunction = std::function<T(std::size_t)>;
+
+    // A maxInFlight of 0 uses the concurrency of the scheduler
+    OrderedPrefetch(std::size_t count, TaskFunction task, unsigned int maxInFlight = 0);
+    ~OrderedPrefetch();
+
+    OrderedPrefetch(const OrderedPrefetch&) = delete;
+    OrderedPrefetch& operator=(const OrderedPrefetch&) = delete;
+
+    std::size_t size() const { return m_count; }
+    bool done() const { return m_taken == m_count; }
+
+    // True if the result of the next task is there, so next won't wait
+    bool nextReady() const;
+
+    // Wait for the result of the next task
+    T next();
+
+private:
+    void launch();
+
+    TaskFunction m_task;
+    std::size_t m_count;
+    std::size_t m_launched{ 0 };
+    std::size_t m_taken{ 0 };
+    std::deque<std::future<T>> m_pending;
+};
+
+
+template<typename T>
+OrderedPrefetch<T>::OrderedPrefetch(std::size_t count, TaskFunction task, unsigned int maxInFlight) :
+    m_task(std::move(task)),
+    m_count(count)
+{
+    if (maxInFlight == 0)
+        maxInFlight = TaskScheduler::get().getConcurrency();
+
+    std::size_t initial = std::min(m_count, static_cast<std::size_t>(maxInFlight));
+    for (std::size_t i = 0; i < initial; ++i)
+        launch();
+}
+
+
+template<typename T>
+OrderedPrefetch<T>::~OrderedPrefetch()
+{
+    // The tasks may refer to data owned by the caller
+    for (auto& pending : m_pending)
+        pending.wait();
+}
+
+
+template<typename T>
+bool
+OrderedPrefetch<T>::nextReady() const
+{
+    return !done() && m_pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+
+template<typename T>
+T
+OrderedPrefetch<T>::next()
+{
+    assert(!done());
+
+    std::future<T> result = std::move(m_pending.front());
+    m_pending.pop_front();
+    ++m_taken;
+
+    // Keep the same number of tasks in flight
+    if (m_launched < m_count)
+        launch();
+
+    return result.get();
+}
+
+
+template<typename T>
+void
+OrderedPrefetch<T>::launch()
+{
+    m_pending.push_back(TaskScheduler::get().async([task = m_task, i = m_launched] { return task(i); }));
+    ++m_launched;
+}
+
+} // end namespace celestia::util
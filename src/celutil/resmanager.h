@@ -9,12 +9,23 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <celcompat/filesystem.h>
+#include <celutil/memoryaccounting.h>
 #include <celutil/reshandle.h>
 
 
@@ -22,14 +33,72 @@ enum class ResourceState {
     NotLoaded     = 0,
     Loaded        = 1,
     LoadingFailed = 2,
+    // Queued for asynchronous loading or being loaded
+    Loading       = 3,
 };
 
 
+namespace celestia::util::detail
+{
+
+// Resource types supporting asynchronous loading define PreparedType and
+// the two loading steps:
+//     PreparedType prepare(const ResourceKey&) const;
+//     std::unique_ptr<ResourceType> finish(const ResourceKey&, PreparedType&&) const;
+// prepare is called on a worker thread, finish on the thread calling
+// ResourceManager::processPending.
+template<class T, class = void>
+struct PreparedTypeOf
+{
+    using type = std::nullptr_t;
+    static constexpr bool supportsAsync = false;
+};
+
+template<class T>
+struct PreparedTypeOf<T, std::void_t<typename T::PreparedType>>
+{
+    using type = typename T::PreparedType;
+    static constexpr bool supportsAsync = true;
+};
+
+// Resource types define getMemorySize() to take part in the memory budget
+// of ResourceManager; resources without it are never evicted.
+template<class R, class = void>
+struct MemorySizeOf
+{
+    static std::size_t get(const R&) { return 0; }
+};
+
+template<class R>
+struct MemorySizeOf<R, std::void_t<decltype(std::declval<const R&>().getMemorySize())>>
+{
+    static std::size_t get(const R& resource) { return resource.getMemorySize(); }
+};
+
+// Resource info types define a static memoryTag to account the memory of
+// their loaded resources to that subsystem.
+template<class T, class = void>
+struct MemoryTagOf
+{
+    static constexpr bool accounted = false;
+    static constexpr MemoryTag tag = MemoryTag::Textures;
+};
+
+template<class T>
+struct MemoryTagOf<T, std::void_t<decltype(T::memoryTag)>>
+{
+    static constexpr bool accounted = true;
+    static constexpr MemoryTag tag = T::memoryTag;
+};
+
+} // end namespace celestia::util::detail
+
+
 template<class T> class ResourceManager
 {
  public:
     explicit ResourceManager(const fs::path& _baseDir) : baseDir(_baseDir) {};
-    ~ResourceManager() = default;
+    ~ResourceManager() { setAsyncLoading(0); }
 
     ResourceManager(const ResourceManager&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
@@ -52,6 +121,10 @@ template<class T> class ResourceManager
         }
     }
 
+    // Returns the resource, loading it if necessary. In asynchronous mode
+    // a resource which isn't loaded yet is queued, and nullptr is returned
+    // until processPending has created it. With a memory budget set, the
+    // pointer is only valid until the next call to nextFrame.
     ResourceType* find(ResourceHandle h)
     {
         if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
@@ -59,9 +132,36 @@ template<class T> class ResourceManager
             return nullptr;
         }
 
+        resources[h].lastUsed = frame;
+        if (resources[h].state == ResourceState::NotLoaded)
+        {
+            if (async != nullptr && asyncFind)
+                requestResource(h);
+            else
+                loadResource(resources[h]);
+        }
+
+        return resources[h].state == ResourceState::Loaded
+            ? resources[h].resource.get()
+            : nullptr;
+    }
+
+    // Same as find, but queues the resource whenever there are worker
+    // threads, even if find loads resources synchronously.
+    ResourceType* findAsync(ResourceHandle h)
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+        {
+            return nullptr;
+        }
+
+        resources[h].lastUsed = frame;
         if (resources[h].state == ResourceState::NotLoaded)
         {
-            loadResource(resources[h]);
+            if (async != nullptr)
+                requestResource(h);
+            else
+                loadResource(resources[h]);
         }
 
         return resources[h].state == ResourceState::Loaded
@@ -69,14 +169,72 @@ template<class T> class ResourceManager
             : nullptr;
     }
 
+    // Release a loaded resource; it is loaded again by find when needed.
+    // Returns false if the resource wasn't loaded.
+    bool unload(ResourceHandle h)
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()) ||
+            resources[h].state != ResourceState::Loaded)
+        {
+            return false;
+        }
+
+        unloadResource(resources[h]);
+        return true;
+    }
+
+    ResourceState getState(ResourceHandle h) const
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+            return ResourceState::LoadingFailed;
+        return resources[h].state;
+    }
+
+    // The key a resource is loaded from, for users which need its source
+    // data; a default constructed key if the handle isn't valid
+    typename T::ResourceKey getResolvedKey(ResourceHandle h) const
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+            return typename T::ResourceKey{};
+        return resources[h].info.resolve(baseDir);
+    }
+
+    // Load resources on nThreads worker threads, or synchronously in find
+    // if nThreads is 0. Only for resource types which define PreparedType.
+    // If asyncFind is false, only findAsync uses the worker threads.
+    void setAsyncLoading(unsigned int nThreads, bool asyncFind = true);
+
+    // Create the resources which have been prepared by the worker threads,
+    // stopping when timeBudget has been used up. This must be called
+    // regularly from the thread which uses the resources, e.g. once per
+    // frame. Returns the number of resources created.
+    std::size_t processPending(std::chrono::steady_clock::duration timeBudget);
+
+    // Limit the memory used by the loaded resources, 0 for no limit. The
+    // budget is enforced in nextFrame.
+    void setMemoryBudget(std::size_t bytes) { memoryBudget = bytes; }
+    std::size_t getMemoryBudget() const { return memoryBudget; }
+    std::size_t getResidentSize() const { return residentSize; }
+
+    // Start a new frame. If the loaded resources exceed the memory budget,
+    // the least recently used ones not used in the last frame are unloaded
+    // until the budget is met; they are loaded again by find when needed.
+    // Returns the number of resources unloaded.
+    std::size_t nextFrame();
+
  private:
     using KeyType = typename T::ResourceKey;
+    using PreparedType = typename celestia::util::detail::PreparedTypeOf<T>::type;
 
     struct InfoType
     {
         T info;
         ResourceState state{ ResourceState::NotLoaded };
         std::shared_ptr<ResourceType> resource{ nullptr };
+        // Memory accounted to this entry, 0 for resources shared with
+        // another entry
+        std::size_t size{ 0 };
+        std::uint32_t lastUsed{ 0 };
 
         explicit InfoType(T _info) : info(std::move(_info)) {}
         InfoType(const InfoType&) = delete;
@@ -92,6 +250,18 @@ template<class T> class ResourceManager
         }
     };
 
+    // The requests hold a copy of the info, as the resource table may be
+    // reallocated while a worker is preparing the resource.
+    struct AsyncState
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::tuple<ResourceHandle, T, KeyType>> requests;
+        std::deque<std::tuple<ResourceHandle, KeyType, PreparedType>> results;
+        std::vector<std::thread> workers;
+        bool quit{ false };
+    };
+
     using ResourceTable = std::vector<InfoType>;
     using ResourceHandleMap = std::map<T, ResourceHandle>;
     using NameMap = std::map<KeyType, std::weak_ptr<ResourceType>>;
@@ -100,28 +270,219 @@ template<class T> class ResourceManager
     ResourceTable resources{ };
     ResourceHandleMap handles{ };
     NameMap loadedResources{ };
+    std::unique_ptr<AsyncState> async{ nullptr };
+    bool asyncFind{ true };
+    std::size_t memoryBudget{ 0 };
+    std::size_t residentSize{ 0 };
+    celestia::util::MemoryRecord residentMemory{ celestia::util::detail::MemoryTagOf<T>::tag };
+    std::uint32_t frame{ 0 };
+
+    void updateResidentSize(std::size_t size)
+    {
+        residentSize = size;
+        if constexpr (celestia::util::detail::MemoryTagOf<T>::accounted)
+            residentMemory.set(residentSize);
+    }
+
+    // Share a resource already loaded under the same key
+    bool findLoaded(InfoType& info, const KeyType& resolvedKey)
+    {
+        auto iter = loadedResources.find(resolvedKey);
+        if (iter == loadedResources.end())
+            return false;
+
+        std::shared_ptr<ResourceType> resource = iter->second.lock();
+        if (resource == nullptr)
+            return false;
+
+        info.resource = std::move(resource);
+        info.state = ResourceState::Loaded;
+        return true;
+    }
+
+    void addLoaded(InfoType& info, KeyType&& resolvedKey)
+    {
+        info.state = ResourceState::Loaded;
+        info.size = celestia::util::detail::MemorySizeOf<ResourceType>::get(*info.resource);
+        updateResidentSize(residentSize + info.size);
+        if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), info.resource); !inserted)
+            iter->second = info.resource;
+    }
 
     void loadResource(InfoType& info)
     {
         KeyType resolvedKey = info.resolve(baseDir);
-        std::shared_ptr<ResourceType> resource = nullptr;
-        if (auto iter = loadedResources.find(resolvedKey); iter != loadedResources.end())
-            resource = iter->second.lock();
+        if (findLoaded(info, resolvedKey))
+            return;
 
-        if (resource != nullptr)
-        {
-            info.resource = std::move(resource);
-            info.state = ResourceState::Loaded;
-        }
-        else if (info.load(resolvedKey))
+        if (info.load(resolvedKey))
         {
-            info.state = ResourceState::Loaded;
-            if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), info.resource); !inserted)
-                iter->second = info.resource;
+            addLoaded(info, std::move(resolvedKey));
         }
         else
         {
             info.state = ResourceState::LoadingFailed;
         }
     }
+
+    // The entry in loadedResources expires once entries sharing the
+    // resource have released it too.
+    void unloadResource(InfoType& info)
+    {
+        info.resource = nullptr;
+        info.state = ResourceState::NotLoaded;
+        updateResidentSize(residentSize - info.size);
+        info.size = 0;
+    }
+
+    void requestResource(ResourceHandle h)
+    {
+        InfoType& info = resources[h];
+        KeyType resolvedKey = info.resolve(baseDir);
+        if (findLoaded(info, resolvedKey))
+            return;
+
+        info.state = ResourceState::Loading;
+        {
+            std::scoped_lock lock(async->mutex);
+            async->requests.emplace_back(h, info.info, std::move(resolvedKey));
+        }
+        async->condition.notify_one();
+    }
+
+    static void workerLoop(AsyncState* state)
+    {
+        std::unique_lock lock(state->mutex);
+        for (;;)
+        {
+            state->condition.wait(lock, [state] { return state->quit || !state->requests.empty(); });
+            if (state->quit)
+                return;
+
+            auto [h, info, resolvedKey] = std::move(state->requests.front());
+            state->requests.pop_front();
+
+            lock.unlock();
+            PreparedType prepared = info.prepare(resolvedKey);
+            lock.lock();
+
+            state->results.emplace_back(h, std::move(resolvedKey), std::move(prepared));
+        }
+    }
 };
+
+
+template<class T>
+void
+ResourceManager<T>::setAsyncLoading(unsigned int nThreads, bool _asyncFind)
+{
+    asyncFind = _asyncFind;
+    if (async != nullptr)
+    {
+        {
+            std::scoped_lock lock(async->mutex);
+            async->quit = true;
+        }
+        async->condition.notify_all();
+        for (auto& worker : async->workers)
+            worker.join();
+
+        // Requests which haven't been prepared are loaded again on demand
+        for (const auto& request : async->requests)
+            resources[std::get<0>(request)].state = ResourceState::NotLoaded;
+        for (const auto& result : async->results)
+            resources[std::get<0>(result)].state = ResourceState::NotLoaded;
+        async = nullptr;
+    }
+
+    if constexpr (celestia::util::detail::PreparedTypeOf<T>::supportsAsync)
+    {
+        if (nThreads == 0)
+            return;
+
+        async = std::make_unique<AsyncState>();
+        for (unsigned int i = 0; i < nThreads; ++i)
+            async->workers.emplace_back(&ResourceManager::workerLoop, async.get());
+    }
+}
+
+
+template<class T>
+std::size_t
+ResourceManager<T>::processPending(std::chrono::steady_clock::duration timeBudget)
+{
+    if constexpr (celestia::util::detail::PreparedTypeOf<T>::supportsAsync)
+    {
+        if (async == nullptr)
+            return 0;
+
+        auto deadline = std::chrono::steady_clock::now() + timeBudget;
+        std::size_t count = 0;
+        for (;;)
+        {
+            std::unique_lock lock(async->mutex);
+            if (async->results.empty())
+                break;
+            auto [h, resolvedKey, prepared] = std::move(async->results.front());
+            async->results.pop_front();
+            lock.unlock();
+
+            InfoType& info = resources[h];
+            if (!findLoaded(info, resolvedKey))
+            {
+                info.resource = info.info.finish(resolvedKey, std::move(prepared));
+                if (info.resource != nullptr)
+                {
+                    addLoaded(info, std::move(resolvedKey));
+                }
+                else
+                {
+                    info.state = ResourceState::LoadingFailed;
+                }
+            }
+
+            ++count;
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+
+        return count;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+template<class T>
+std::size_t
+ResourceManager<T>::nextFrame()
+{
+    std::size_t count = 0;
+    if (memoryBudget > 0 && residentSize > memoryBudget)
+    {
+        std::vector<ResourceHandle> candidates;
+        for (std::size_t i = 0; i < resources.size(); ++i)
+        {
+            const InfoType& info = resources[i];
+            if (info.state == ResourceState::Loaded && info.size > 0 && info.lastUsed != frame)
+                candidates.push_back(static_cast<ResourceHandle>(i));
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [this](ResourceHandle a, ResourceHandle b) { return resources[a].lastUsed < resources[b].lastUsed; });
+
+        for (ResourceHandle h : candidates)
+        {
+            if (residentSize <= memoryBudget)
+                break;
+
+            unloadResource(resources[h]);
+            ++count;
+        }
+    }
+
+    ++frame;
+    return count;
+}
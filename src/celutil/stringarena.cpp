@@ -0,0 +1,41 @@
+// stringarena.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "stringarena.h"
+
+#include <cstring>
+
+namespace celestia::util
+{
+
+StringArena::StringArena(std::size_t blockSize) :
+    m_arena(blockSize)
+{
+}
+
+
+std::string_view
+StringArena::add(std::string_view str)
+{
+    if (str.empty())
+        return {};
+
+    auto dest = static_cast<char*>(m_arena.allocate(str.size(), 1));
+    std::memcpy(dest, str.data(), str.size());
+    return { dest, str.size() };
+}
+
+
+void
+StringArena::clear()
+{
+    m_arena.reset();
+}
+
+}
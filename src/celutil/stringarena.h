@@ -0,0 +1,46 @@
+// stringarena.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Storage for short-lived strings.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#include "monotonicarena.h"
+
+namespace celestia::util
+{
+
+/*! StringArena copies strings into a MonotonicArena. The copies remain
+ *  valid until the arena is cleared or destroyed. Clearing the arena keeps
+ *  its memory, so an arena which is cleared and refilled every frame stops
+ *  allocating once it has grown large enough.
+ */
+class StringArena
+{
+public:
+    explicit StringArena(std::size_t blockSize = 65536);
+    ~StringArena() = default;
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // Return a copy of str stored in the arena
+    std::string_view add(std::string_view str);
+
+    // Discard the strings while keeping the memory for reuse
+    void clear();
+
+private:
+    MonotonicArena m_arena;
+};
+
+}
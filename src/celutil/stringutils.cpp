@@ -10,32 +10,54 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 #include "stringutils.h"
 
-int compareIgnoringCase(std::string_view s1, std::string_view s2)
+namespace
 {
-    auto i1 = s1.begin();
-    auto i2 = s2.begin();
 
-    for (;;)
+// The length of the identical bytes at the start of s1 and s2, at most n,
+// compared a word at a time; it stops at the last agreeing word. These
+// bytes compare equal whatever their case.
+std::string_view::size_type commonPrefixLength(std::string_view s1,
+                                               std::string_view s2,
+                                               std::string_view::size_type n)
+{
+    constexpr std::size_t WordSize = sizeof(std::uint64_t);
+    std::size_t limit = std::min({ s1.size(), s2.size(), n });
+    std::size_t pos = 0;
+    for (; pos + WordSize <= limit; pos += WordSize)
     {
-        if (i1 == s1.end()) { return i2 == s2.end() ? 0 : -1; }
-        if (i2 == s2.end()) { return 1; }
-        auto c1 = std::toupper(static_cast<unsigned char>(*i1));
-        auto c2 = std::toupper(static_cast<unsigned char>(*i2));
-        if (c1 != c2) { return c1 < c2 ? -1 : 1; }
-        ++i1;
-        ++i2;
+        std::uint64_t w1;
+        std::uint64_t w2;
+        std::memcpy(&w1, s1.data() + pos, WordSize);
+        std::memcpy(&w2, s2.data() + pos, WordSize);
+        if (w1 != w2)
+            break;
     }
+
+    return pos;
+}
+
+} // end unnamed namespace
+
+int compareIgnoringCase(std::string_view s1, std::string_view s2)
+{
+    return compareIgnoringCase(s1, s2, std::string_view::npos);
 }
 
 int compareIgnoringCase(std::string_view s1,
                         std::string_view s2,
                         std::string_view::size_type n)
 {
-    auto i1 = s1.begin();
-    auto i2 = s2.begin();
+    auto skip = commonPrefixLength(s1, s2, n);
+    auto i1 = s1.begin() + skip;
+    auto i2 = s2.begin() + skip;
+    if (n != std::string_view::npos)
+        n -= skip;
 
     for (;;)
     {
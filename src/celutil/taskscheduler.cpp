@@ -0,0 +1,375 @@
+// taskscheduler.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// A pool of worker threads shared by all the subsystems which run work in
+// parallel.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "taskscheduler.h"
+
+#include <chrono>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+// The scheduler and queue of the worker running on this thread
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local std::size_t currentIndex = 0;
+
+} // end unnamed namespace
+
+
+TaskScheduler::TaskScheduler(unsigned int workerCount)
+{
+    startWorkers(workerCount);
+}
+
+
+TaskScheduler::~TaskScheduler()
+{
+    stopWorkers();
+}
+
+
+TaskScheduler&
+TaskScheduler::get()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+
+void
+TaskScheduler::setWorkerCount(unsigned int workerCount)
+{
+    stopWorkers();
+    startWorkers(workerCount);
+}
+
+
+void
+TaskScheduler::startWorkers(unsigned int workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    m_workerCount = workerCount;
+    // Keep a worker free for frame critical tasks when there are several
+    m_maxBackground = std::max(workerCount - 1, 1u);
+
+    for (unsigned int i = 0; i < workerCount; ++i)
+        m_queues.push_back(std::make_unique<TaskQueue>());
+
+    m_workers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&TaskScheduler::workerLoop, this, static_cast<std::size_t>(i));
+}
+
+
+void
+TaskScheduler::stopWorkers()
+{
+    {
+        std::scoped_lock lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    // The tasks left in the queues of the workers are taken over by the
+    // next ones through the shared queue
+    for (const auto& queue : m_queues)
+    {
+        for (Task& task : queue->tasks)
+            m_shared.tasks.push_back(std::move(task));
+    }
+    m_queues.clear();
+
+    std::scoped_lock lock(m_sleepMutex);
+    m_stop = false;
+}
+
+
+void
+TaskScheduler::submit(Task task, TaskPriority priority)
+{
+    if (priority == TaskPriority::Background)
+    {
+        {
+            std::scoped_lock lock(m_background.mutex);
+            m_background.tasks.push_back(std::move(task));
+        }
+        m_backgroundQueued.fetch_add(1);
+        // Threads waiting for frame critical tasks ignore background tasks,
+        // so waking only one of them might not reach a worker
+        wake(true);
+        return;
+    }
+
+    std::size_t index = currentWorker();
+    TaskQueue& queue = index == NoWorker ? m_shared : *m_queues[index];
+    {
+        std::scoped_lock lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    m_queued.fetch_add(1);
+    wake(false);
+}
+
+
+void
+TaskScheduler::postToMainThread(Task task)
+{
+    std::scoped_lock lock(m_mainMutex);
+    m_mainTasks.push_back(std::move(task));
+}
+
+
+std::size_t
+TaskScheduler::runMainThreadTasks(double maxTime)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::size_t count = 0;
+    for (;;)
+    {
+        Task task;
+        {
+            std::scoped_lock lock(m_mainMutex);
+            if (m_mainTasks.empty())
+                break;
+            task = std::move(m_mainTasks.front());
+            m_mainTasks.pop_front();
+        }
+
+        task();
+        ++count;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (maxTime > 0.0 && elapsed.count() >= maxTime)
+            break;
+    }
+
+    return count;
+}
+
+
+bool
+TaskScheduler::runPendingTask(TaskPriority priority)
+{
+    Task task;
+    bool background = false;
+    if (!findTask(currentWorker(), priority == TaskPriority::Background, false, task, background))
+        return false;
+
+    runTask(task, background);
+    return true;
+}
+
+
+void
+TaskScheduler::workerLoop(std::size_t index)
+{
+    currentScheduler = this;
+    currentIndex = index;
+
+    while (!m_stop.load())
+    {
+        Task task;
+        bool background = false;
+        if (findTask(index, true, true, task, background))
+        {
+            runTask(task, background);
+            continue;
+        }
+
+        std::unique_lock lock(m_sleepMutex);
+        m_sleepers.fetch_add(1);
+        m_wakeCondition.wait(lock, [this] { return m_stop.load() || hasWork(true, true); });
+        m_sleepers.fetch_sub(1);
+    }
+}
+
+
+void
+TaskScheduler::runTask(Task& task, bool background)
+{
+    task();
+    // Release the captures of the task before it counts as finished
+    task = nullptr;
+    if (background)
+        m_backgroundRunning.fetch_sub(1);
+}
+
+
+bool
+TaskScheduler::findTask(std::size_t index,
+                        bool allowBackground,
+                        bool limitBackground,
+                        Task& task,
+                        bool& background)
+{
+    auto take = [&task](TaskQueue& queue, bool fromBack)
+    {
+        std::scoped_lock lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+
+        if (fromBack)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    };
+
+    if (m_queued.load() > 0)
+    {
+        bool found = (index != NoWorker && take(*m_queues[index], true)) || take(m_shared, false);
+        // Steal from the other workers, starting with the next one
+        std::size_t nQueues = m_queues.size();
+        for (std::size_t i = 0; !found && i < nQueues; ++i)
+        {
+            std::size_t victim = index == NoWorker ? i : (index + 1 + i) % nQueues;
+            if (victim != index)
+                found = take(*m_queues[victim], false);
+        }
+
+        if (found)
+        {
+            m_queued.fetch_sub(1);
+            background = false;
+            return true;
+        }
+    }
+
+    if (!allowBackground || m_backgroundQueued.load() == 0)
+        return false;
+
+    // Reserve a slot for a background task before taking one
+    unsigned int running = m_backgroundRunning.load();
+    do
+    {
+        if (limitBackground && running >= m_maxBackground)
+            return false;
+    } while (!m_backgroundRunning.compare_exchange_weak(running, running + 1));
+
+    if (!take(m_background, false))
+    {
+        m_backgroundRunning.fetch_sub(1);
+        return false;
+    }
+
+    m_backgroundQueued.fetch_sub(1);
+    background = true;
+    return true;
+}
+
+
+bool
+TaskScheduler::hasWork(bool allowBackground, bool limitBackground) const
+{
+    if (m_queued.load() > 0)
+        return true;
+
+    return allowBackground &&
+           m_backgroundQueued.load() > 0 &&
+           (!limitBackground || m_backgroundRunning.load() < m_maxBackground);
+}
+
+
+// The sleeper count is raised before a sleeping thread checks for work,
+// and the work is published before it is read here, so that either the
+// sleeper sees the work or the notification reaches it.
+void
+TaskScheduler::wake(bool all)
+{
+    if (m_sleepers.load() == 0)
+        return;
+
+    {
+        std::scoped_lock lock(m_sleepMutex);
+    }
+
+    if (all)
+        m_wakeCondition.notify_all();
+    else
+        m_wakeCondition.notify_one();
+}
+
+
+void
+TaskScheduler::waitUntil(const std::function<bool()>& done, bool allowBackground)
+{
+    std::unique_lock lock(m_sleepMutex);
+    m_sleepers.fetch_add(1);
+    m_wakeCondition.wait(lock, [&] { return done() || m_stop.load() || hasWork(allowBackground, false); });
+    m_sleepers.fetch_sub(1);
+}
+
+
+std::size_t
+TaskScheduler::currentWorker() const
+{
+    return currentScheduler == this ? currentIndex : NoWorker;
+}
+
+
+TaskGroup::TaskGroup(TaskPriority priority, TaskScheduler& scheduler) :
+    m_scheduler(scheduler),
+    m_priority(priority)
+{
+}
+
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+
+void
+TaskGroup::run(TaskScheduler::Task task)
+{
+    m_pending.fetch_add(1);
+    m_scheduler.submit([this, &scheduler = m_scheduler, task = std::move(task)]
+                       {
+                           task();
+                           // The group may be destroyed as soon as the
+                           // count reaches 0
+                           if (m_pending.fetch_sub(1) == 1)
+                               scheduler.wake(true);
+                       },
+                       m_priority);
+}
+
+
+// Run the tasks of this group and any others while waiting, so that the
+// waiting thread isn't idle and nested groups can't run out of workers
+void
+TaskGroup::wait()
+{
+    bool background = m_priority == TaskPriority::Background;
+    while (m_pending.load() != 0)
+    {
+        if (!m_scheduler.runPendingTask(m_priority))
+            m_scheduler.waitUntil([this] { return m_pending.load() == 0; }, background);
+    }
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,238 @@
+// taskscheduler.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// A pool of worker threads shared by all the subsystems which run work in
+// parallel.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace celestia::util
+{
+
+enum class TaskPriority
+{
+    // Work which the current frame waits for, e.g. the parts of a
+    // parallelFor. These tasks are run before any background task.
+    FrameCritical,
+    // Reading files and long computations whose results may arrive a few
+    // frames later. Some workers are always kept free of them.
+    Background,
+};
+
+/*! A work-stealing scheduler. Each worker thread has a queue of its own:
+ *  tasks submitted from a worker are pushed to the back of its queue and
+ *  taken from the back again, so nested tasks are run depth first, while
+ *  idle workers steal from the front of the other queues. Tasks submitted
+ *  from other threads go to a shared queue, and background tasks to a
+ *  separate one which is only served when there is no frame critical work.
+ *
+ *  Tasks which have to run on the main thread, usually because they make
+ *  OpenGL calls, are posted with postToMainThread and run from the
+ *  application's draw loop by runMainThreadTasks.
+ *
+ *  Tasks must not throw. Tasks still queued when the scheduler is
+ *  destroyed are discarded; use a TaskGroup or a future to wait for them.
+ */
+class TaskScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    // A workerCount of 0 uses one worker less than the number of hardware
+    // threads, leaving one for the main thread; there is at least one.
+    explicit TaskScheduler(unsigned int workerCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // The scheduler used by the engine, created on first use
+    static TaskScheduler& get();
+
+    // Replace the workers, which finish their current tasks first. Queued
+    // tasks are kept. Must not be called from a task.
+    void setWorkerCount(unsigned int workerCount);
+    unsigned int getWorkerCount() const { return m_workerCount; }
+
+    // Threads taking part in a parallelFor: the workers and the caller
+    unsigned int getConcurrency() const { return m_workerCount + 1; }
+
+    void submit(Task task, TaskPriority priority = TaskPriority::FrameCritical);
+
+    // Run f on a worker and return a future for its result. Unlike those
+    // of std::async, destroying the future doesn't wait for the task.
+    template<typename F>
+    auto async(F&& f, TaskPriority priority = TaskPriority::Background)
+        -> std::future<std::invoke_result_t<std::decay_t<F>>>;
+
+    // Queue a task to be run on the main thread by runMainThreadTasks
+    void postToMainThread(Task task);
+
+    // Run the tasks posted to the main thread in order, spending at most
+    // maxTime seconds unless it is 0; at least one task is run if any is
+    // queued. Returns the number of tasks run.
+    std::size_t runMainThreadTasks(double maxTime = 0.0);
+
+    // Run one queued task on the calling thread, returning false if there
+    // is none. Background tasks are only taken if priority is Background.
+    // Used by threads which wait for tasks.
+    bool runPendingTask(TaskPriority priority = TaskPriority::FrameCritical);
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static constexpr std::size_t NoWorker = ~static_cast<std::size_t>(0);
+
+    void startWorkers(unsigned int workerCount);
+    void stopWorkers();
+    void workerLoop(std::size_t index);
+    bool findTask(std::size_t index, bool allowBackground, bool limitBackground, Task& task, bool& background);
+    void runTask(Task& task, bool background);
+    bool hasWork(bool allowBackground, bool limitBackground) const;
+    void wake(bool all);
+    void waitUntil(const std::function<bool()>& done, bool allowBackground);
+    std::size_t currentWorker() const;
+
+    unsigned int m_workerCount{ 0 };
+    unsigned int m_maxBackground{ 1 };
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    TaskQueue m_shared;
+    TaskQueue m_background;
+    std::vector<std::thread> m_workers;
+
+    // Queued frame critical and background tasks, and the background tasks
+    // being run. Checked by sleeping threads without taking the queue locks.
+    std::atomic<std::size_t> m_queued{ 0 };
+    std::atomic<std::size_t> m_backgroundQueued{ 0 };
+    std::atomic<unsigned int> m_backgroundRunning{ 0 };
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<unsigned int> m_sleepers{ 0 };
+    std::atomic<bool> m_stop{ false };
+
+    std::mutex m_mainMutex;
+    std::deque<Task> m_mainTasks;
+
+    friend class TaskGroup;
+};
+
+
+/*! A set of tasks which can be waited for together. A thread waiting for
+ *  a group runs other queued tasks in the meantime, so tasks may
+ *  wait for groups of their own without tying up the workers. The group
+ *  must outlive its tasks; the destructor waits for them.
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskPriority priority = TaskPriority::FrameCritical,
+                       TaskScheduler& scheduler = TaskScheduler::get());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(TaskScheduler::Task task);
+    void wait();
+    bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    TaskScheduler& m_scheduler;
+    TaskPriority m_priority;
+    std::atomic<std::size_t> m_pending{ 0 };
+};
+
+
+template<typename F>
+auto
+TaskScheduler::async(F&& f, TaskPriority priority)
+    -> std::future<std::invoke_result_t<std::decay_t<F>>>
+{
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+    std::future<Result> result = task->get_future();
+    submit([task] { (*task)(); }, priority);
+    return result;
+}
+
+
+/*! Call body(i) for each i in [begin, end) on the workers and the calling
+ *  thread. The indices are handed out in chunks of grain, in increasing
+ *  order; body must be safe to call concurrently for different indices.
+ *  At most maxThreads threads take part, or all the workers if it is 0.
+ *  Returns when all the calls have finished.
+ */
+template<typename F>
+void
+ParallelFor(std::size_t begin,
+            std::size_t end,
+            std::size_t grain,
+            F&& body,
+            unsigned int maxThreads = 0,
+            TaskScheduler& scheduler = TaskScheduler::get())
+{
+    if (end <= begin)
+        return;
+
+    grain = std::max(grain, std::size_t(1));
+    std::size_t nChunks = (end - begin + grain - 1) / grain;
+    if (maxThreads == 0)
+        maxThreads = scheduler.getConcurrency();
+    auto nThreads = static_cast<unsigned int>(std::min(static_cast<std::size_t>(maxThreads), nChunks));
+    if (nThreads <= 1)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            body(i);
+        return;
+    }
+
+    std::atomic<std::size_t> nextChunk{ 0 };
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            std::size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= nChunks)
+                break;
+
+            std::size_t first = begin + chunk * grain;
+            std::size_t last = std::min(first + grain, end);
+            for (std::size_t i = first; i < last; ++i)
+                body(i);
+        }
+    };
+
+    TaskGroup group(TaskPriority::FrameCritical, scheduler);
+    for (unsigned int i = 1; i < nThreads; ++i)
+        group.run(worker);
+    worker();
+    group.wait();
+}
+
+} // end namespace celestia::util
@@ -45,6 +45,10 @@ public:
     static constexpr std::size_t DEFAULT_BUFFER_SIZE = 4096;
 
     Tokenizer(std::istream*, std::size_t = DEFAULT_BUFFER_SIZE);
+    // Tokenize text in memory, e.g. a mapped file, without copying it. The
+    // names and strings returned point into the text, which must outlive
+    // the tokenizer.
+    explicit Tokenizer(std::string_view);
     ~Tokenizer();
 
     TokenType nextToken();
@@ -10,7 +10,9 @@
 
 #include "utf8.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <cwctype>
 
 
@@ -325,6 +327,90 @@ inline std::int32_t UTF8Normalize(std::int32_t ch)
     return static_cast<std::int32_t>((*normTable)[index]);
 }
 
+// The strings are scanned eight bytes at a time in a 64-bit word
+constexpr std::size_t WordSize = 8;
+constexpr std::uint64_t HighBits = UINT64_C(0x8080808080808080);
+constexpr std::uint64_t LowBits = UINT64_C(0x0101010101010101);
+
+inline std::uint64_t
+loadWord(const char* p)
+{
+    std::uint64_t word;
+    std::memcpy(&word, p, WordSize);
+    return word;
+}
+
+// Convert the letters of a word of ASCII characters to lower case, which is
+// what both UTF8Normalize and UTF8FoldCase do to ASCII characters. No byte
+// overflows into the next one as they are all below 0x80.
+inline std::uint64_t
+asciiToLower(std::uint64_t word)
+{
+    std::uint64_t aboveA = word + LowBits * (0x80 - 'A');
+    std::uint64_t aboveZ = word + LowBits * (0x80 - 'Z' - 1);
+    std::uint64_t upper = aboveA & ~aboveZ & HighBits;
+    return word | (upper >> 2);
+}
+
+inline bool
+isAscii(char c)
+{
+    return static_cast<unsigned char>(c) < 0x80;
+}
+
+inline char
+asciiToLower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// The number of bytes at the start of s0 and s1 which are ASCII characters
+// equal when converted to lower case, at most limit. Stops at the end of
+// the agreeing words, the rest is left to the callers.
+std::size_t
+asciiFoldedPrefix(std::string_view s0, std::string_view s1, std::size_t limit)
+{
+    std::size_t pos = 0;
+    for (; pos + WordSize <= limit; pos += WordSize)
+    {
+        std::uint64_t w0 = loadWord(s0.data() + pos);
+        std::uint64_t w1 = loadWord(s1.data() + pos);
+        if (((w0 | w1) & HighBits) != 0 || asciiToLower(w0) != asciiToLower(w1))
+            break;
+    }
+
+    return pos;
+}
+
+// Encode a code point bytewise ordered, allowing for the values beyond the
+// Unicode range used for invalid bytes
+void
+appendOrderedCodePoint(std::uint32_t ch, std::string& dest)
+{
+    if (ch < 0x80)
+    {
+        dest.push_back(static_cast<char>(ch));
+    }
+    else if (ch < 0x800)
+    {
+        dest.push_back(static_cast<char>(0xc0 | (ch >> 6)));
+        dest.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+    else if (ch < 0x10000)
+    {
+        dest.push_back(static_cast<char>(0xe0 | (ch >> 12)));
+        dest.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        dest.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+    else
+    {
+        dest.push_back(static_cast<char>(0xf0 | (ch >> 18)));
+        dest.push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3f)));
+        dest.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        dest.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+}
+
 } // namespace
 
 //! Decode the UTF-8 character at the start of the string str. The decoded
@@ -342,8 +428,15 @@ bool UTF8Decode(std::string_view str, std::int32_t& ch)
 //! pos is advanced to the next undecoded byte in the input string.
 bool UTF8Decode(std::string_view str, std::int32_t& pos, std::int32_t& ch)
 {
-    UTF8Validator validator;
     auto length = static_cast<std::int32_t>(str.size());
+    if (pos < length && isAscii(str[pos]))
+    {
+        ch = static_cast<std::int32_t>(str[pos]);
+        ++pos;
+        return true;
+    }
+
+    UTF8Validator validator;
     while (pos < length)
     {
         auto result = validator.check(str[pos]);
@@ -410,12 +503,25 @@ void UTF8Encode(std::uint32_t ch, std::string& dest)
 //! translations are performed.
 int UTF8StringCompare(std::string_view s0, std::string_view s1)
 {
+    std::size_t skip = asciiFoldedPrefix(s0, s1, std::min(s0.size(), s1.size()));
+    s0.remove_prefix(skip);
+    s1.remove_prefix(skip);
+
     auto len0 = static_cast<std::int32_t>(s0.size());
     auto len1 = static_cast<std::int32_t>(s1.size());
     std::int32_t i0 = 0;
     std::int32_t i1 = 0;
     for (;;)
     {
+        if (i0 < len0 && i1 < len1 && isAscii(s0[i0]) && isAscii(s1[i1]))
+        {
+            char c0 = asciiToLower(s0[i0++]);
+            char c1 = asciiToLower(s1[i1++]);
+            if (c0 != c1)
+                return c0 < c1 ? -1 : 1;
+            continue;
+        }
+
         std::int32_t ch0;
         std::int32_t ch1;
         if (i0 >= len0 || !UTF8Decode(s0, i0, ch0))
@@ -435,6 +541,11 @@ int UTF8StringCompare(std::string_view s0, std::string_view s1)
 
 bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCase)
 {
+    // ASCII characters compare the same whether or not case is ignored
+    std::size_t skip = asciiFoldedPrefix(str, prefix, std::min(str.size(), prefix.size()));
+    str.remove_prefix(skip);
+    prefix.remove_prefix(skip);
+
     auto len0 = static_cast<std::int32_t>(str.size());
     auto len1 = static_cast<std::int32_t>(prefix.size());
     std::int32_t i0 = 0;
@@ -445,18 +556,26 @@ bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCa
         std::int32_t ch1;
         if (i1 >= len1)
             return true;
-        if (i0 >= len0 || !UTF8Decode(str, i0, ch0) || !UTF8Decode(prefix, i1, ch1))
+        if (i0 >= len0)
+            return false;
+        if (isAscii(str[i0]) && isAscii(prefix[i1]))
+        {
+            if (asciiToLower(str[i0++]) != asciiToLower(prefix[i1++]))
+                return false;
+            continue;
+        }
+        if (!UTF8Decode(str, i0, ch0) || !UTF8Decode(prefix, i1, ch1))
             return false;
-
-        ch0 = UTF8Normalize(ch0);
-        ch1 = UTF8Normalize(ch1);
 
         if (ignoreCase)
         {
-            if (ch0 >= 0 && ch0 <= WCHAR_MAX)
-                ch0 = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch0)));
-            if (ch1 >= 0 && ch1 <= WCHAR_MAX)
-                ch1 = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch1)));
+            ch0 = UTF8FoldCase(ch0);
+            ch1 = UTF8FoldCase(ch1);
+        }
+        else
+        {
+            ch0 = UTF8Normalize(ch0);
+            ch1 = UTF8Normalize(ch1);
         }
 
         if (ch0 != ch1)
@@ -464,6 +583,74 @@ bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCa
     }
 }
 
+std::int32_t UTF8FoldCase(std::int32_t ch)
+{
+    ch = UTF8Normalize(ch);
+    if (ch >= 0 && ch <= WCHAR_MAX)
+        ch = static_cast<std::int32_t>(std::towlower(static_cast<std::wint_t>(ch)));
+    return ch;
+}
+
+std::size_t UTF8AsciiLength(std::string_view str)
+{
+    std::size_t pos = 0;
+    for (; pos + WordSize <= str.size(); pos += WordSize)
+    {
+        if ((loadWord(str.data() + pos) & HighBits) != 0)
+            break;
+    }
+
+    while (pos < str.size() && isAscii(str[pos]))
+        ++pos;
+    return pos;
+}
+
+bool UTF8IsValid(std::string_view str)
+{
+    UTF8Validator validator;
+    std::size_t pos = 0;
+    for (;;)
+    {
+        pos += UTF8AsciiLength(str.substr(pos));
+        if (pos == str.size())
+            return true;
+
+        // Check the multibyte sequences up to the next ASCII character
+        do
+        {
+            if (validator.check(str[pos]) < UTF8Validator::PartialSequence)
+                return false;
+            ++pos;
+        } while (pos < str.size() && !(validator.isInitial() && isAscii(str[pos])));
+
+        if (!validator.isInitial())
+            return false;
+    }
+}
+
+void UTF8AppendFoldedKey(std::string_view str, std::string& key)
+{
+    key.reserve(key.size() + str.size());
+    auto length = static_cast<std::int32_t>(str.size());
+    std::int32_t pos = 0;
+    while (pos < length)
+    {
+        if (isAscii(str[pos]))
+        {
+            key.push_back(asciiToLower(str[pos]));
+            ++pos;
+            continue;
+        }
+
+        std::int32_t ch;
+        if (UTF8Decode(str, pos, ch))
+            ch = UTF8FoldCase(ch);
+        else
+            ch = 0x110000 + static_cast<unsigned char>(str[static_cast<std::size_t>(pos - 1)]);
+        appendOrderedCodePoint(static_cast<std::uint32_t>(ch), key);
+    }
+}
+
 std::int32_t
 UTF8Validator::check(unsigned char c)
 {
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -24,6 +25,17 @@ bool UTF8Decode(std::string_view str, std::int32_t &pos, std::int32_t &ch);
 void UTF8Encode(std::uint32_t ch, std::string &dest);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1);
 bool UTF8StartsWith(std::string_view str, std::string_view prefix, bool ignoreCase = false);
+// Normalize a code point and convert it to lower case, as UTF8StartsWith
+// does when ignoring case
+std::int32_t UTF8FoldCase(std::int32_t ch);
+// The number of ASCII characters at the start of str
+std::size_t UTF8AsciiLength(std::string_view str);
+bool UTF8IsValid(std::string_view str);
+// Append the case folded form of str to key, as a string which compares
+// bytewise like str compares to other strings with UTF8StartsWith ignoring
+// case, so the key of a prefix is a prefix of the key. Bytes which aren't
+// valid UTF-8 are kept as values beyond the Unicode range.
+void UTF8AppendFoldedKey(std::string_view str, std::string& key);
 
 class UTF8StringOrderingPredicate
 {
@@ -14,7 +14,10 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -47,6 +50,7 @@ static unsigned int IntegrateScatterSteps = 20;
 static unsigned int IntegrateDepthSteps = 20;
 static unsigned int OutputImageWidth = 600;
 static unsigned int OutputImageHeight = 450;
+static unsigned int LUTThreads = 0;
 enum LUTUsageType
 {
     NoLUT,
@@ -383,6 +387,9 @@ void usage()
     cerr << "           set the number of integration steps for depth\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value> (or -t)\n";
+    cerr << "           set the number of threads building the lookup tables\n";
+    cerr << "           (default is one per processor core)\n";
 }
 
 
@@ -1011,6 +1018,33 @@ Vector4d integrateInscatteringFactors(const Scene& scene,
 /**** Lookup table acceleration of scattering ****/
 
 
+// Call computeRow(i) for each row i of a lookup table on LUTThreads
+// threads. Each entry is computed on its own, so the table is the same
+// for any number of threads.
+template<typename F>
+void forEachRow(unsigned int nRows, F computeRow)
+{
+    unsigned int nThreads = LUTThreads != 0 ? LUTThreads : max(thread::hardware_concurrency(), 1u);
+    nThreads = min(nThreads, nRows);
+
+    // Rows are handed out one at a time, as their cost varies with height
+    atomic<unsigned int> nextRow{ 0 };
+    auto worker = [&]()
+    {
+        for (unsigned int i = nextRow++; i < nRows; i = nextRow++)
+            computeRow(i);
+    };
+
+    vector<thread> threads;
+    for (unsigned int n = 1; n < nThreads; n++)
+        threads.emplace_back(worker);
+    worker();
+
+    for (auto& t : threads)
+        t.join();
+}
+
+
 // Pack a signed value in [-1, 1] into [0, 1]
 double packSNorm(double sn)
 {
@@ -1034,7 +1068,7 @@ buildExtinctionLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    forEachRow(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
@@ -1061,7 +1095,7 @@ buildExtinctionLUT(const Scene& scene)
 
             lut->setValue(i, j, ext.cwiseMax(1.0e-18));
         }
-    }
+    });
 
     return lut;
 }
@@ -1094,7 +1128,7 @@ buildOpticalDepthLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    forEachRow(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight;
@@ -1120,7 +1154,7 @@ buildOpticalDepthLUT(const Scene& scene)
 
             lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
         }
-    }
+    });
 
     return lut;
 }
@@ -1311,7 +1345,7 @@ buildScatteringLUT(const Scene& scene)
 
     math::Sphered shell(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ScatteringLUTHeightSteps; i++)
+    forEachRow(ScatteringLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
@@ -1352,7 +1386,7 @@ buildScatteringLUT(const Scene& scene)
                 lut->setValue(i, j, k, inscatter);
             }
         }
-    }
+    });
 
     return lut;
 }
@@ -1858,6 +1892,15 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &LUTThreads) != 1)
+                    return false;
+                i++;
+            }
             else if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--width"))
             {
                 if (i == argc - 1)
@@ -20,6 +20,7 @@
 
 #include <celmath/mathlib.h>
 #include <celmodel/mesh.h>
+#include <celmodel/meshquantize.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 #include <celutil/logger.h>
@@ -39,6 +40,9 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool optimizeCache = false;
+bool quantize = false;
+unsigned int lodLevels = 0;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
 
@@ -54,6 +58,9 @@ void usage()
     std::cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     std::cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     std::cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    std::cerr << "   --cache (or -c)       : reorder triangles and vertices for the vertex cache\n";
+    std::cerr << "   --quantize (or -q)    : pack vertex attributes into 16 bits (implies --binary)\n";
+    std::cerr << "   --lod (or -l) <levels> : add up to <levels> simplified levels of detail\n";
 #ifdef TRISTRIP
     std::cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
@@ -97,6 +104,28 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 mergeMeshes = true;
             }
+            else if (!std::strcmp(argv[i], "-c") || !std::strcmp(argv[i], "--cache"))
+            {
+                optimizeCache = true;
+            }
+            else if (!std::strcmp(argv[i], "-q") || !std::strcmp(argv[i], "--quantize"))
+            {
+                quantize = true;
+                outputBinary = true;
+            }
+            else if (!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--lod"))
+            {
+                if (i == argc - 1)
+                {
+                    return false;
+                }
+                else
+                {
+                    if (std::sscanf(argv[i + 1], " %u", &lodLevels) != 1)
+                        return false;
+                    i++;
+                }
+            }
             else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--optimize"))
             {
                 stripify = true;
@@ -177,6 +206,19 @@ int main(int argc, char* argv[])
     if (model == nullptr)
         return 1;
 
+    // The other operations only handle unpacked vertices, and the levels
+    // of detail of the input wouldn't match their results
+    if (genNormals || genTangents || mergeMeshes || uniquify || optimizeCache || stripify || lodLevels > 0)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+        {
+            cmod::Mesh* mesh = model->getMesh(i);
+            if (cmod::IsQuantized(*mesh))
+                *mesh = cmod::DequantizeMesh(*mesh);
+            mesh->clearLods();
+        }
+    }
+
     if (genNormals || genTangents)
     {
         auto newModel = std::make_unique<cmod::Model>();
@@ -239,6 +281,17 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (lodLevels > 0)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+            cmodtools::GenerateLevelsOfDetail(*model->getMesh(i), lodLevels);
+    }
+
+    if (optimizeCache)
+    {
+        cmodtools::OptimizeModelMeshes(*model);
+    }
+
 #ifdef TRISTRIP
     if (stripify)
     {
@@ -251,6 +304,15 @@ int main(int argc, char* argv[])
     }
 #endif
 
+    if (quantize)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+        {
+            cmod::Mesh* mesh = model->getMesh(i);
+            *mesh = cmod::QuantizeMesh(*mesh);
+        }
+    }
+
     if (outputFilename.empty())
     {
         if (outputBinary)
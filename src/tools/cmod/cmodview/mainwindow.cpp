@@ -42,6 +42,7 @@
 #include <celmath/mathlib.h>
 #include <celmodel/material.h>
 #include <celmodel/mesh.h>
+#include <celmodel/meshquantize.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 
@@ -433,6 +434,16 @@ MainWindow::openModel(const QString& fileName)
                 return;
             }
 
+            // The viewer and the editing operations only handle float
+            // attributes and the full detail level
+            for (unsigned int i = 0; i < model->getMeshCount(); ++i)
+            {
+                cmod::Mesh* mesh = model->getMesh(i);
+                if (cmod::IsQuantized(*mesh))
+                    *mesh = cmod::DequantizeMesh(*mesh);
+                mesh->clearLods();
+            }
+
             setModel(fileName, std::move(model));
         }
         else
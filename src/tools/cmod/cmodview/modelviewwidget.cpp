@@ -36,6 +36,7 @@
 
 #define DEBUG_SHADOWS 0
 
+namespace gl = celestia::gl;
 namespace math = celestia::math;
 using celestia::engine::Image;
 
@@ -722,6 +723,9 @@ ModelViewWidget::initializeGL()
 void
 ModelViewWidget::paintGL()
 {
+    // Qt may have used the context since the last frame
+    gl::invalidateState();
+
     // Generate the shadow buffers for each light source
     if (m_shadowsEnabled && !m_shadowBuffers.empty())
     {
@@ -820,12 +824,12 @@ ModelViewWidget::paintGL()
             glMatrixMode(GL_MODELVIEW);
             glLoadIdentity();
             glDisable(GL_LIGHTING);
-            glUseProgram(0);
+            gl::useProgram(0);
             glColor4f(1, 1, 1, 1);
 
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+            gl::bindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
 
             // Disable texture compare temporarily--we just want to see the
             // stored depth values.
@@ -960,7 +964,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
             GLuint diffuseMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::DiffuseMap)).c_str()));
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, diffuseMapId);
+            gl::bindTexture(GL_TEXTURE_2D, diffuseMapId);
             setSampler(*shader, "diffuseMap", 0);
         }
 
@@ -968,33 +972,33 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
         {
             GLuint normalMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::NormalMap)).c_str()));
-            glActiveTexture(GL_TEXTURE1);
+            gl::activeTexture(GL_TEXTURE1);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, normalMapId);
+            gl::bindTexture(GL_TEXTURE_2D, normalMapId);
             setSampler(*shader, "normalMap", 1);
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
         }
 
         if (shaderKey.hasSpecularMap())
         {
             GLuint specularMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::SpecularMap)).c_str()));
-            glActiveTexture(GL_TEXTURE2);
+            gl::activeTexture(GL_TEXTURE2);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, specularMapId);
+            gl::bindTexture(GL_TEXTURE_2D, specularMapId);
             setSampler(*shader, "specularMap", 2);
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
         }
 
         if (shaderKey.hasEmissiveMap())
         {
             GLuint emissiveMapId = m_materialLibrary->getTexture(
                 toQString(cmodtools::GetPathManager()->getSource(material->getMap(cmod::TextureSemantic::EmissiveMap)).c_str()));
-            glActiveTexture(GL_TEXTURE3);
+            gl::activeTexture(GL_TEXTURE3);
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, emissiveMapId);
+            gl::bindTexture(GL_TEXTURE_2D, emissiveMapId);
             setSampler(*shader, "emissiveMap", 3);
-            glActiveTexture(GL_TEXTURE0);
+            gl::activeTexture(GL_TEXTURE0);
         }
 
         unsigned int lightIndex = 0;
@@ -1043,12 +1047,12 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
                 char samplerName[64];
                 sprintf(samplerName, "shadowTexture%d", i);
 
-                glActiveTexture(GL_TEXTURE4 + i);
+                gl::activeTexture(GL_TEXTURE4 + i);
                 glEnable(GL_TEXTURE_2D);
-                glBindTexture(GL_TEXTURE_2D, m_shadowBuffers[i]->depthTexture());
+                gl::bindTexture(GL_TEXTURE_2D, m_shadowBuffers[i]->depthTexture());
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
                 setSampler(*shader, samplerName, 4 + i);
-                glActiveTexture(GL_TEXTURE0);
+                gl::activeTexture(GL_TEXTURE0);
             }
 
             Eigen::Matrix4f shadowMatrixes[MaxShadows];
@@ -1072,7 +1076,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
     }
     else
     {
-        glUseProgram(0);
+        gl::useProgram(0);
 
         Eigen::Vector4f diffuse(material->diffuse.red(), material->diffuse.green(), material->diffuse.blue(), material->opacity);
         Eigen::Vector4f specular(material->specular.red(), material->specular.green(), material->specular.blue(), 1.0f);
@@ -1095,7 +1099,7 @@ ModelViewWidget::bindMaterial(const cmod::Material* material,
         if (baseTexId != 0)
         {
             glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, baseTexId);
+            gl::bindTexture(GL_TEXTURE_2D, baseTexId);
         }
         else
         {
@@ -1136,10 +1140,10 @@ ModelViewWidget::renderModel(cmod::Model* model)
     // Disable all texture units
     for (unsigned int i = 0; i < 8; ++i)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        gl::activeTexture(GL_TEXTURE0 + i);
         glDisable(GL_TEXTURE_2D);
     }
-    glActiveTexture(GL_TEXTURE0);
+    gl::activeTexture(GL_TEXTURE0);
 
     enum {
         Opaque = 0,
@@ -1558,7 +1562,7 @@ ModelViewWidget::renderShadow(unsigned int lightIndex)
     shadowBuffer->bind();
     glViewport(0, 0, shadowBuffer->width(), shadowBuffer->height());
 
-    glUseProgram(0);
+    gl::useProgram(0);
 
     // Write only to the depth buffer
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -13,10 +13,14 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <queue>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -30,6 +34,14 @@ namespace cmodtools
 
 namespace
 {
+// Smallest number of faces or vertices worth handing to another thread
+constexpr std::size_t MinItemsPerThread = 16384;
+
+// Smallest weld cell size, relative to the extent of the mesh; keeps the
+// cell coordinates within 32 bits
+constexpr double MinCellFraction = 1.0e-9;
+
+
 struct Vertex
 {
     Vertex() :
@@ -67,76 +79,6 @@ struct VertexComparator
 };
 
 
-class FullComparator : public VertexComparator
-{
-public:
-    FullComparator(int _vertexSize) :
-        vertexSize(_vertexSize)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        return std::lexicographical_compare(a.attributes, a.attributes + vertexSize,
-                                            b.attributes, b.attributes + vertexSize);
-    }
-
-private:
-    int vertexSize;
-};
-
-
-class PointOrderingPredicate : public VertexComparator
-{
-public:
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-        return p0 < p1;
-    }
-
-private:
-    int ignore;
-};
-
-
-class PointTexCoordOrderingPredicate : public VertexComparator
-{
-public:
-    PointTexCoordOrderingPredicate(std::uint32_t _posOffset,
-                                   std::uint32_t _texCoordOffset,
-                                   bool _wrap) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset),
-        wrap(_wrap)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return ptc0 < ptc1;
-    }
-
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-    bool wrap;
-};
-
-
 bool approxEqual(float x, float y, float prec)
 {
     return std::abs(x - y) <= prec * std::min(std::abs(x), std::abs(y));
@@ -207,6 +149,64 @@ private:
 };
 
 
+// Integer coordinates of a cell in the weld grid
+struct Cell
+{
+    std::array<std::int32_t, 3> c;
+
+    bool operator==(const Cell& other) const { return c == other.c; }
+};
+
+
+struct CellHash
+{
+    std::size_t operator()(const Cell& cell) const
+    {
+        // Large primes from Teschner et al., Optimized Spatial Hashing for
+        // Collision Detection of Deformable Objects
+        return static_cast<std::size_t>(static_cast<std::uint32_t>(cell.c[0]) * 73856093u ^
+                                        static_cast<std::uint32_t>(cell.c[1]) * 19349663u ^
+                                        static_cast<std::uint32_t>(cell.c[2]) * 83492791u);
+    }
+};
+
+
+// FNV-1a hash of the words of a vertex
+std::size_t
+hashVertex(const cmod::VWord* vertex, unsigned int vertexSize)
+{
+    std::uint64_t h = UINT64_C(14695981039346656037);
+    for (unsigned int i = 0; i < vertexSize; i++)
+    {
+        h ^= vertex[i];
+        h *= UINT64_C(1099511628211);
+    }
+
+    return static_cast<std::size_t>(h);
+}
+
+
+// Call func(begin, end) for consecutive ranges of [0, count) on as many
+// threads as are useful, the last range is processed on this thread.
+template<typename F> void
+parallelFor(std::size_t count, const F& func)
+{
+    std::size_t nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    nThreads = std::clamp(count / MinItemsPerThread, std::size_t(1), nThreads);
+
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+    std::size_t itemsPerThread = (count + nThreads - 1) / nThreads;
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i + 1 < nThreads; ++i, begin += itemsPerThread)
+        workers.emplace_back([&func, begin, itemsPerThread] { func(begin, begin + itemsPerThread); });
+
+    func(begin, count);
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
 bool equal(const Vertex& a, const Vertex& b, std::uint32_t vertexSize)
 {
     return std::equal(a.attributes, a.attributes + vertexSize, b.attributes);
@@ -354,12 +354,16 @@ addGroupWithOffset(cmod::Mesh& mesh,
 }
 
 
-template<typename T, typename U> void
+// Weld the points of the faces: vi is set to the first attribute index
+// with a point that is equivalent to point i. The points are hashed to a
+// grid so that only those in the cells within tolerance (relative to the
+// coordinates, like approxEqual) of each point are compared.
+template<typename T> void
 joinVertices(std::vector<Face>& faces,
              const cmod::VWord* vertexData,
              const cmod::VertexDescription& desc,
-             const T& orderingPredicate,
-             const U& equivalencePredicate)
+             float tolerance,
+             const T& equivalencePredicate)
 {
     // Don't do anything if we're given no data
     if (faces.size() == 0)
@@ -370,51 +374,448 @@ joinVertices(std::vector<Face>& faces,
 
     std::uint32_t posOffset = desc.getAttribute(cmod::VertexAttributeSemantic::Position).offsetWords;
     const cmod::VWord* vertexPoints = vertexData + posOffset;
-    std::uint32_t nVertices = faces.size() * 3;
-
-    // Initialize the array of vertices
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t f;
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    for (f = 0; f < faces.size(); f++)
+
+    // Number of attribute indices used by the faces
+    std::uint32_t nVertices = 0;
+    for (const Face& face : faces)
+        nVertices = std::max({ nVertices, face.i[0] + 1, face.i[1] + 1, face.i[2] + 1 });
+
+    // The cells are at least as large as the tolerance of the largest
+    // coordinate, so each point is compared with those in at most two
+    // cells along each axis
+    double maxCoord = 0.0;
+    for (const Face& face : faces)
     {
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t index : face.i)
+            maxCoord = std::max(maxCoord, static_cast<double>(getVertex(vertexPoints, 0, stride, index).cwiseAbs().maxCoeff()));
+    }
+
+    double cellSize = maxCoord * std::max(static_cast<double>(tolerance), MinCellFraction);
+    if (cellSize == 0.0)
+        cellSize = 1.0;
+
+    auto cellCoord = [cellSize](double x) { return static_cast<std::int32_t>(std::floor(x / cellSize)); };
+
+    // The first point in each cell, the rest are linked through next
+    std::unordered_map<Cell, std::uint32_t, CellHash> cells;
+    cells.reserve(nVertices);
+    std::vector<std::uint32_t> next(nVertices, ~0u);
+    std::vector<std::uint32_t> mergeMap(nVertices, ~0u);
+
+    for (Face& face : faces)
+    {
+        for (std::uint32_t k = 0; k < 3; k++)
+        {
+            std::uint32_t index = face.i[k];
+            if (mergeMap[index] == ~0u)
+            {
+                Vertex v(index, vertexPoints + stride * index);
+                Eigen::Vector3f p = getVertex(vertexPoints, 0, stride, index);
+
+                // Widened slightly to cover the rounding of approxEqual
+                Eigen::Vector3d d = p.cast<double>().cwiseAbs() * (static_cast<double>(tolerance) * (1.0 + 1.0e-6));
+                Cell lo{ { cellCoord(p.x() - d.x()), cellCoord(p.y() - d.y()), cellCoord(p.z() - d.z()) } };
+                Cell hi{ { cellCoord(p.x() + d.x()), cellCoord(p.y() + d.y()), cellCoord(p.z() + d.z()) } };
+
+                Cell cell;
+                for (cell.c[0] = lo.c[0]; cell.c[0] <= hi.c[0] && mergeMap[index] == ~0u; cell.c[0]++)
+                {
+                    for (cell.c[1] = lo.c[1]; cell.c[1] <= hi.c[1] && mergeMap[index] == ~0u; cell.c[1]++)
+                    {
+                        for (cell.c[2] = lo.c[2]; cell.c[2] <= hi.c[2] && mergeMap[index] == ~0u; cell.c[2]++)
+                        {
+                            auto it = cells.find(cell);
+                            if (it == cells.end())
+                                continue;
+
+                            for (std::uint32_t j = it->second; j != ~0u; j = next[j])
+                            {
+                                if (equivalencePredicate(Vertex(j, vertexPoints + stride * j), v))
+                                {
+                                    mergeMap[index] = j;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // No equivalent point: this one is unique
+                if (mergeMap[index] == ~0u)
+                {
+                    mergeMap[index] = index;
+                    Cell own{ { cellCoord(p.x()), cellCoord(p.y()), cellCoord(p.z()) } };
+                    if (auto [it, inserted] = cells.try_emplace(own, index); !inserted)
+                    {
+                        next[index] = it->second;
+                        it->second = index;
+                    }
+                }
+            }
+
+            face.vi[k] = mergeMap[index];
+        }
+    }
+}
+
+
+// Triangles of a primitive group as a triangle list
+std::vector<cmod::Index32>
+triangleIndices(const cmod::PrimitiveGroup& group)
+{
+    std::vector<cmod::Index32> indices;
+    switch (group.prim)
+    {
+    case cmod::PrimitiveGroupType::TriList:
+        indices = group.indices;
+        break;
+    case cmod::PrimitiveGroupType::TriStrip:
+        for (std::size_t i = 2; i < group.indices.size(); i++)
+        {
+            if ((i & 1) == 0)
+                indices.insert(indices.end(), { group.indices[i - 2], group.indices[i - 1], group.indices[i] });
+            else
+                indices.insert(indices.end(), { group.indices[i - 1], group.indices[i - 2], group.indices[i] });
+        }
+        break;
+    case cmod::PrimitiveGroupType::TriFan:
+        for (std::size_t i = 2; i < group.indices.size(); i++)
+            indices.insert(indices.end(), { group.indices[0], group.indices[i - 1], group.indices[i] });
+        break;
+    default:
+        break;
+    }
+
+    return indices;
+}
+
+
+/*! Simplifies the triangles of a mesh by collapsing vertices into one of
+ *  their neighbours, choosing the collapse with the least quadric error
+ *  (Garland and Heckbert, "Surface Simplification Using Quadric Error
+ *  Metrics", 1997) first. Vertices are only moved onto other vertices, so
+ *  the simplified triangles draw the vertices of the mesh. Vertices which
+ *  share their position with others, such as at texture seams, and
+ *  vertices on the border of the surface stay in place.
+ */
+class MeshSimplifier
+{
+public:
+    explicit MeshSimplifier(const cmod::Mesh& mesh);
+
+    // Collapse vertices until at most targetCount triangles remain or no
+    // collapse is possible, and return the largest error of the collapses
+    // so far: the root mean square distance of the new vertices from the
+    // planes of the triangles they replaced
+    float simplify(std::size_t targetCount);
+
+    std::size_t getTriangleCount() const { return liveCount; }
+    std::vector<cmod::Index32> getIndices(unsigned int group) const;
+
+private:
+    struct Triangle
+    {
+        std::array<cmod::Index32, 3> v;
+        unsigned int group;
+        bool removed;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        double error;
+        cmod::Index32 from;
+        cmod::Index32 to;
+        unsigned int version;
+
+        bool operator<(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    bool findCollapse(cmod::Index32 from, Collapse& collapse) const;
+    bool keepsOrientation(cmod::Index32 from, cmod::Index32 to) const;
+    void collapse(const Collapse& collapse);
+
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<cmod::Index32> positionIndex;    // first vertex with the same position
+    std::vector<Eigen::Matrix4d> quadrics;       // per position
+    std::vector<double> areas;                   // of the planes of the quadrics
+    std::vector<bool> locked;
+    std::vector<bool> removed;
+    std::vector<unsigned int> versions;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<std::uint32_t>> vertexTriangles;
+    std::size_t liveCount{ 0 };
+    double maxError{ 0.0 };
+};
+
+
+MeshSimplifier::MeshSimplifier(const cmod::Mesh& mesh)
+{
+    unsigned int nVertices = mesh.getVertexCount();
+    positions.reserve(nVertices);
+    for (unsigned int i = 0; i < nVertices; i++)
+        positions.push_back(mesh.getPosition(i).cast<double>());
+
+    // Find the vertices with the same position
+    std::vector<cmod::Index32> order(nVertices);
+    std::iota(order.begin(), order.end(), 0);
+    auto lessPosition = [this](cmod::Index32 a, cmod::Index32 b)
+    {
+        return std::lexicographical_compare(positions[a].data(), positions[a].data() + 3,
+                                            positions[b].data(), positions[b].data() + 3);
+    };
+    std::stable_sort(order.begin(), order.end(), lessPosition);
+
+    positionIndex.resize(nVertices);
+    locked.assign(nVertices, false);
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        if (i > 0 && positions[order[i]] == positions[order[i - 1]])
+        {
+            positionIndex[order[i]] = positionIndex[order[i - 1]];
+            locked[order[i]] = true;
+            locked[positionIndex[order[i]]] = true;
+        }
+        else
         {
-            std::uint32_t index = faces[f].i[j];
-            vertices[f * 3 + j] = Vertex(index, vertexPoints + stride * index);
+            positionIndex[order[i]] = order[i];
+        }
+    }
+
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); groupIndex++)
+    {
+        const cmod::PrimitiveGroup* group = mesh.getGroup(groupIndex);
+        if (group->lod != 0)
+            continue;
 
+        std::vector<cmod::Index32> indices = triangleIndices(*group);
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Triangle t{ { indices[i], indices[i + 1], indices[i + 2] }, groupIndex, false };
+            if (t.v[0] >= nVertices || t.v[1] >= nVertices || t.v[2] >= nVertices)
+                continue;
+
+            cmod::Index32 p0 = positionIndex[t.v[0]];
+            cmod::Index32 p1 = positionIndex[t.v[1]];
+            cmod::Index32 p2 = positionIndex[t.v[2]];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+                continue;
+            triangles.push_back(t);
         }
     }
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), orderingPredicate);
+    liveCount = triangles.size();
+    vertexTriangles.resize(nVertices);
+    quadrics.assign(nVertices, Eigen::Matrix4d::Zero());
+    areas.assign(nVertices, 0.0);
 
-    // Build the vertex merge map
-    std::vector<std::uint32_t> mergeMap(nVertices);
-    std::uint32_t lastUnique = 0;
-    std::uint32_t uniqueCount = 0;
-    for (std::uint32_t i = 0; i < nVertices; i++)
+    // Edges used by other than two triangles are on the border of the
+    // surface
+    std::vector<std::pair<cmod::Index32, cmod::Index32>> edges;
+    edges.reserve(triangles.size() * 3);
+    for (std::uint32_t i = 0; i < triangles.size(); i++)
     {
-        if (i == 0 || !equivalencePredicate(vertices[i - 1], vertices[i]))
+        const Triangle& t = triangles[i];
+        for (int j = 0; j < 3; j++)
         {
-            lastUnique = i;
-            uniqueCount++;
+            vertexTriangles[t.v[j]].push_back(i);
+            cmod::Index32 a = positionIndex[t.v[j]];
+            cmod::Index32 b = positionIndex[t.v[(j + 1) % 3]];
+            edges.emplace_back(std::min(a, b), std::max(a, b));
         }
 
-        mergeMap[vertices[i].index] = vertices[lastUnique].index;
+        const Eigen::Vector3d& p0 = positions[t.v[0]];
+        Eigen::Vector3d normal = (positions[t.v[1]] - p0).cross(positions[t.v[2]] - p0);
+        double area = normal.norm() * 0.5;
+        if (area == 0.0)
+            continue;
+
+        // Planes weighted by the area of their triangles
+        Eigen::Vector4d plane;
+        plane << normal.normalized(), 0.0;
+        plane.w() = -plane.head<3>().dot(p0);
+        Eigen::Matrix4d q = area * plane * plane.transpose();
+        for (int j = 0; j < 3; j++)
+        {
+            quadrics[positionIndex[t.v[j]]] += q;
+            areas[positionIndex[t.v[j]]] += area;
+        }
     }
 
-    // Remap the vertex indices
-    for (f = 0; f < faces.size(); f++)
+    std::sort(edges.begin(), edges.end());
+    for (std::size_t i = 0; i < edges.size();)
     {
-        for (std::uint32_t k= 0; k < 3; k++)
+        std::size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+            j++;
+        if (j - i != 2)
         {
-            faces[f].vi[k] = mergeMap[faces[f].i[k]];
+            locked[edges[i].first] = true;
+            locked[edges[i].second] = true;
         }
+        i = j;
     }
+
+    removed.assign(nVertices, false);
+    versions.assign(nVertices, 0);
 }
 
 
+bool
+MeshSimplifier::keepsOrientation(cmod::Index32 from, cmod::Index32 to) const
+{
+    for (std::uint32_t ti : vertexTriangles[from])
+    {
+        const Triangle& t = triangles[ti];
+        if (t.removed || std::find(t.v.begin(), t.v.end(), to) != t.v.end())
+            continue;
+
+        std::array<Eigen::Vector3d, 3> p{ positions[t.v[0]], positions[t.v[1]], positions[t.v[2]] };
+        Eigen::Vector3d oldNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        for (int j = 0; j < 3; j++)
+        {
+            if (t.v[j] == from)
+                p[j] = positions[to];
+        }
+        Eigen::Vector3d newNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        if (newNormal.dot(oldNormal) <= 0.0)
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+MeshSimplifier::findCollapse(cmod::Index32 from, Collapse& collapse) const
+{
+    if (locked[from] || removed[from])
+        return false;
+
+    bool found = false;
+    for (std::uint32_t ti : vertexTriangles[from])
+    {
+        const Triangle& t = triangles[ti];
+        if (t.removed)
+            continue;
+
+        for (cmod::Index32 to : t.v)
+        {
+            if (to == from)
+                continue;
+
+            Eigen::Matrix4d q = quadrics[positionIndex[from]] + quadrics[positionIndex[to]];
+            Eigen::Vector4d p;
+            p << positions[to], 1.0;
+            double cost = std::max(p.dot(q * p), 0.0);
+            if ((!found || cost < collapse.cost) && keepsOrientation(from, to))
+            {
+                // The error is the mean distance from the planes
+                double area = areas[positionIndex[from]] + areas[positionIndex[to]];
+                double error = area > 0.0 ? std::sqrt(cost / area) : 0.0;
+                collapse = Collapse{ cost, error, from, to, versions[from] };
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+void
+MeshSimplifier::collapse(const Collapse& c)
+{
+    for (std::uint32_t ti : vertexTriangles[c.from])
+    {
+        Triangle& t = triangles[ti];
+        if (t.removed)
+            continue;
+
+        if (std::find(t.v.begin(), t.v.end(), c.to) != t.v.end())
+        {
+            t.removed = true;
+            --liveCount;
+            continue;
+        }
+
+        std::replace(t.v.begin(), t.v.end(), c.from, c.to);
+        cmod::Index32 p0 = positionIndex[t.v[0]];
+        cmod::Index32 p1 = positionIndex[t.v[1]];
+        cmod::Index32 p2 = positionIndex[t.v[2]];
+        if (p0 == p1 || p1 == p2 || p2 == p0)
+        {
+            t.removed = true;
+            --liveCount;
+            continue;
+        }
+
+        vertexTriangles[c.to].push_back(ti);
+    }
+
+    vertexTriangles[c.from].clear();
+    removed[c.from] = true;
+    quadrics[positionIndex[c.to]] += quadrics[positionIndex[c.from]];
+    areas[positionIndex[c.to]] += areas[positionIndex[c.from]];
+    maxError = std::max(maxError, c.error);
+}
+
+
+float
+MeshSimplifier::simplify(std::size_t targetCount)
+{
+    std::priority_queue<Collapse> queue;
+    for (cmod::Index32 i = 0; i < positions.size(); i++)
+    {
+        if (Collapse c; findCollapse(i, c))
+            queue.push(c);
+    }
+
+    std::vector<cmod::Index32> neighbours;
+    while (liveCount > targetCount && !queue.empty())
+    {
+        Collapse c = queue.top();
+        queue.pop();
+        if (removed[c.from] || removed[c.to] || c.version != versions[c.from])
+            continue;
+
+        collapse(c);
+
+        // The collapses of the vertices around the new triangles change
+        neighbours.clear();
+        for (std::uint32_t ti : vertexTriangles[c.to])
+        {
+            if (!triangles[ti].removed)
+                neighbours.insert(neighbours.end(), triangles[ti].v.begin(), triangles[ti].v.end());
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (cmod::Index32 v : neighbours)
+        {
+            ++versions[v];
+            if (Collapse next; findCollapse(v, next))
+                queue.push(next);
+        }
+    }
+
+    return static_cast<float>(maxError);
+}
+
+
+std::vector<cmod::Index32>
+MeshSimplifier::getIndices(unsigned int group) const
+{
+    std::vector<cmod::Index32> indices;
+    for (const Triangle& t : triangles)
+    {
+        if (!t.removed && t.group == group)
+            indices.insert(indices.end(), t.v.begin(), t.v.end());
+    }
+
+    return indices;
+}
+
 } // end unnamed namespace
 
 
@@ -548,30 +949,28 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
     const cmod::VWord* vertexData = mesh.getVertexData();
 
     // Compute normals for the faces
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::size_t begin, std::size_t end)
     {
-        Face& face = faces[f];
-        Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
-        Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
-        Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
-        face.normal = (p1 - p0).cross(p2 - p1);
-        if (face.normal.squaredNorm() > 0.0f)
+        for (std::size_t f = begin; f < end; f++)
         {
-            face.normal.normalize();
+            Face& face = faces[f];
+            Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
+            Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
+            Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
+            face.normal = (p1 - p0).cross(p2 - p1);
+            if (face.normal.squaredNorm() > 0.0f)
+            {
+                face.normal.normalize();
+            }
         }
-    }
-
-    // For each vertex, create a list of faces that contain it
-    std::vector<std::uint32_t> faceCounts(nVertices, 0);
-    std::vector<std::vector<std::uint32_t>> vertexFaces(nVertices);
+    });
 
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointOrderingPredicate(),
+        joinVertices(faces, vertexData, desc, weldTolerance,
                      PointEquivalencePredicate(0, weldTolerance));
     }
     else
@@ -584,48 +983,47 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         }
     }
 
-    // Count the number of faces in which each vertex appears
+    // For each vertex, create a list of faces that contain it. The lists
+    // are stored one after the other, vertex i's starting at
+    // faceListStart[i].
+    std::vector<std::uint32_t> faceListStart(nVertices + 1, 0);
     for (f = 0; f < nFaces; f++)
     {
         Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
+        faceListStart[face.vi[0] + 1]++;
+        faceListStart[face.vi[1] + 1]++;
+        faceListStart[face.vi[2] + 1]++;
     }
+    std::partial_sum(faceListStart.begin(), faceListStart.end(), faceListStart.begin());
 
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i].resize(faceCounts[i] + 1);
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
+    std::vector<std::uint32_t> vertexFaces(nFaces * 3);
+    std::vector<std::uint32_t> faceListEnd(faceListStart.begin(), faceListStart.end() - 1);
     for (f = 0; f < nFaces; f++)
     {
         Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
+        vertexFaces[faceListEnd[face.vi[0]]++] = f;
+        vertexFaces[faceListEnd[face.vi[1]]++] = f;
+        vertexFaces[faceListEnd[face.vi[2]]++] = f;
     }
 
     // Compute the vertex normals by averaging
     std::vector<Eigen::Vector3f> vertexNormals(nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::size_t begin, std::size_t end)
     {
-        Face& face = faces[f];
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::size_t f = begin; f < end; f++)
         {
-            vertexNormals[f * 3 + j] =
-                averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
-                                   cosSmoothAngle);
+            const Face& face = faces[f];
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                std::uint32_t v = face.vi[j];
+                vertexNormals[f * 3 + j] =
+                    averageFaceVectors(faces, static_cast<std::uint32_t>(f),
+                                       vertexFaces.data() + faceListStart[v],
+                                       faceListStart[v + 1] - faceListStart[v],
+                                       cosSmoothAngle);
+            }
         }
-    }
+    });
 
     // Finally, create a new mesh with normals included
 
@@ -665,21 +1063,24 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
     // new vertex data buffer.
     unsigned int newStride = newDesc.strideBytes / sizeof(cmod::VWord);
     std::vector<cmod::VWord> newVertexData(newStride * nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::size_t begin, std::size_t end)
     {
-        Face& face = faces[f];
-
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::size_t f = begin; f < end; f++)
         {
-            cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
-            copyVertex(newVertex, newDesc,
-                       vertexData, desc,
-                       face.i[j],
-                       fromOffsets);
-            std::memcpy(newVertex + normalOffset, &vertexNormals[f * 3 + j],
-                        cmod::VertexAttribute::getFormatSizeWords(cmod::VertexAttributeFormat::Float3) * sizeof(cmod::VWord));
+            const Face& face = faces[f];
+
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
+                copyVertex(newVertex, newDesc,
+                           vertexData, desc,
+                           face.i[j],
+                           fromOffsets);
+                std::memcpy(newVertex + normalOffset, &vertexNormals[f * 3 + j],
+                            cmod::VertexAttribute::getFormatSizeWords(cmod::VertexAttributeFormat::Float3) * sizeof(cmod::VWord));
+            }
         }
-    }
+    });
 
     // Create the Celestia mesh
     cmod::Mesh newMesh;
@@ -843,8 +1244,7 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointTexCoordOrderingPredicate(posOffset, texCoordOffset, true),
+        joinVertices(faces, vertexData, desc, 1.0e-5f,
                      PointTexCoordEquivalencePredicate(posOffset, texCoordOffset, true, 1.0e-5f));
     }
     else
@@ -1012,47 +1412,58 @@ UniquifyVertices(cmod::Mesh& mesh)
     if (vertexData == nullptr)
         return false;
 
-    // Initialize the array of vertices
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    std::vector<Vertex> vertices(nVertices);
+    std::vector<std::size_t> hashes(nVertices);
+    parallelFor(nVertices, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+            hashes[i] = hashVertex(vertexData + i * stride, stride);
+    });
+
+    // Map each vertex to the first identical one; the unique vertices with
+    // the same hash are linked through next
+    std::unordered_map<std::size_t, std::uint32_t> firstWithHash;
+    firstWithHash.reserve(nVertices);
+    std::vector<std::uint32_t> next(nVertices, ~0u);
+    std::vector<std::uint32_t> vertexMap(nVertices);
+    std::vector<std::uint32_t> uniqueVertices;
     std::uint32_t i;
     for (i = 0; i < nVertices; i++)
     {
-        vertices[i] = Vertex(i, vertexData + i * stride);
-    }
+        Vertex v(i, vertexData + i * stride);
+        auto [it, inserted] = firstWithHash.try_emplace(hashes[i], i);
+        if (!inserted)
+        {
+            std::uint32_t j = it->second;
+            while (j != ~0u && !equal(Vertex(j, vertexData + j * stride), v, stride))
+                j = next[j];
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), FullComparator(stride));
+            if (j != ~0u)
+            {
+                vertexMap[i] = vertexMap[j];
+                continue;
+            }
 
-    // Count the number of unique vertices
-    std::uint32_t uniqueVertexCount = 0;
-    for (i = 0; i < nVertices; i++)
-    {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
-            uniqueVertexCount++;
+            next[i] = it->second;
+            it->second = i;
+        }
+
+        vertexMap[i] = static_cast<std::uint32_t>(uniqueVertices.size());
+        uniqueVertices.push_back(i);
     }
 
     // No work left to do if we couldn't eliminate any vertices
+    std::uint32_t uniqueVertexCount = static_cast<std::uint32_t>(uniqueVertices.size());
     if (uniqueVertexCount == nVertices)
         return true;
 
-    // Build the vertex map and the uniquified vertex data
-    std::vector<std::uint32_t> vertexMap(nVertices);
+    // Build the uniquified vertex data
     std::vector<cmod::VWord> newVertexData(uniqueVertexCount * stride);
-    const cmod::VWord* oldVertexData = mesh.getVertexData();
-    std::uint32_t j = 0;
-    for (i = 0; i < nVertices; i++)
+    for (i = 0; i < uniqueVertexCount; i++)
     {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
-        {
-            if (i != 0)
-                j++;
-            assert(j < uniqueVertexCount);
-            std::memcpy(newVertexData.data() + j * stride,
-                        oldVertexData + vertices[i].index * stride,
-                        desc.strideBytes);
-        }
-        vertexMap[vertices[i].index] = j;
+        std::memcpy(newVertexData.data() + i * stride,
+                    vertexData + uniqueVertices[i] * stride,
+                    desc.strideBytes);
     }
 
     // Replace the vertex data with the compacted data
@@ -1196,6 +1607,70 @@ GenerateModelNormals(const cmod::Model& model, float smoothAngle, bool weldVerti
 }
 
 
+/*! Replace the simplified levels of detail of a mesh with up to levelCount
+ *  new ones, each with about reduction times the triangles of the level
+ *  before it. Fewer levels are added when the mesh can't be simplified
+ *  further, or becomes too small to be worth it. Returns the number of
+ *  levels added.
+ */
+unsigned int
+GenerateLevelsOfDetail(cmod::Mesh& mesh, unsigned int levelCount, float reduction)
+{
+    // Meshes with fewer triangles are left alone, and levels which don't
+    // remove at least a tenth of the triangles are not kept
+    constexpr std::size_t MinTriangles = 64;
+    constexpr float MinReduction = 0.9f;
+
+    mesh.clearLods();
+
+    MeshSimplifier simplifier(mesh);
+    std::size_t triangleCount = simplifier.getTriangleCount();
+    unsigned int groupCount = mesh.getGroupCount();
+    unsigned int level = 0;
+    while (level < levelCount && triangleCount >= MinTriangles)
+    {
+        float error = simplifier.simplify(static_cast<std::size_t>(static_cast<float>(triangleCount) * reduction));
+        std::size_t newCount = simplifier.getTriangleCount();
+        if (static_cast<float>(newCount) > static_cast<float>(triangleCount) * MinReduction)
+            break;
+
+        level = mesh.addLod(error);
+        for (unsigned int groupIndex = 0; groupIndex < groupCount; groupIndex++)
+        {
+            const cmod::PrimitiveGroup* group = mesh.getGroup(groupIndex);
+            switch (group->prim)
+            {
+            case cmod::PrimitiveGroupType::TriList:
+            case cmod::PrimitiveGroupType::TriStrip:
+            case cmod::PrimitiveGroupType::TriFan:
+                if (std::vector<cmod::Index32> indices = simplifier.getIndices(groupIndex); !indices.empty())
+                    mesh.addGroup(cmod::PrimitiveGroupType::TriList, group->materialIndex, std::move(indices), level);
+                break;
+            default:
+                // Lines and points are drawn at every level
+                mesh.addGroup(group->prim, group->materialIndex, std::vector<cmod::Index32>(group->indices), level);
+                break;
+            }
+        }
+
+        triangleCount = newCount;
+    }
+
+    return level;
+}
+
+
+/*! Reorder the triangles of the meshes of a model for the vertex cache and
+ *  to reduce overdraw, and their vertices in the order they're used, as
+ *  Celestia does when it loads a model.
+ */
+void
+OptimizeModelMeshes(cmod::Model& model)
+{
+    model.optimizeMeshes();
+}
+
+
 #ifdef TRISTRIP
 bool
 ConvertToStrips(cmod::Mesh& mesh)
@@ -32,6 +32,7 @@ namespace cmodtools
 extern cmod::Mesh GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weldTolerance = 0.0f);
 extern cmod::Mesh GenerateTangents(const cmod::Mesh& mesh, bool weld);
 extern bool UniquifyVertices(cmod::Mesh& mesh);
+extern unsigned int GenerateLevelsOfDetail(cmod::Mesh& mesh, unsigned int levelCount, float reduction = 0.5f);
 
 // Model operations
 extern std::unique_ptr<cmod::Model> MergeModelMeshes(const cmod::Model& model);
@@ -39,6 +40,7 @@ extern std::unique_ptr<cmod::Model> GenerateModelNormals(const cmod::Model& mode
                                                          float smoothAngle,
                                                          bool weldVertices,
                                                          float weldTolerance);
+extern void OptimizeModelMeshes(cmod::Model& model);
 #ifdef TRISTRIP
 extern bool ConvertToStrips(cmod::Mesh& mesh);
 #endif
@@ -0,0 +1,59 @@
+// makedsodb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a text deep sky catalog (.dsc) to the binary format, which
+// Celestia loads without parsing.
+
+#include <fstream>
+#include <iostream>
+
+#include <celengine/dsodb.h>
+#include <celutil/logger.h>
+
+using celestia::util::CreateLogger;
+using celestia::util::DestroyLogger;
+
+namespace
+{
+
+void Usage()
+{
+    std::cerr << "Usage: makedsodb <input .dsc file> <output file>\n";
+}
+
+} // end unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        Usage();
+        return 1;
+    }
+
+    std::ifstream inputFile(argv[1], std::ios::in | std::ios::binary);
+    if (!inputFile.good())
+    {
+        std::cerr << "Error opening input file " << argv[1] << '\n';
+        return 1;
+    }
+
+    std::ofstream outputFile(argv[2], std::ios::out | std::ios::binary);
+    if (!outputFile.good())
+    {
+        std::cerr << "Error opening output file " << argv[2] << '\n';
+        return 1;
+    }
+
+    CreateLogger();
+    bool success = DSODatabase::convertToBinary(inputFile, outputFile);
+    DestroyLogger();
+
+    return success ? 0 : 1;
+}
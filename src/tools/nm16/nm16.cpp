@@ -1,103 +1,512 @@
-#include <iostream>
+// nm16.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compute a normal map from a raw signed 16-bit height map, as a PPM image
+// or as the tiles of a virtual texture
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#endif
+#include <fcntl.h>
 
-using namespace std;
+#include <fmt/format.h>
 
-int kernelSize = 2;
-int halfKernelSize = 1;
+#include <celutil/logger.h>
+#include "tilepyramid.h"
 
+using celestia::util::CreateLogger;
+using celestia::util::DestroyLogger;
+using vtextools::CheckTileOptions;
+using vtextools::CountLevels;
+using vtextools::ParseTileOption;
+using vtextools::RowResampler;
+using vtextools::TileOptions;
+using vtextools::TileOptionsUsage;
+using vtextools::TilePyramid;
+using vtextools::WriteDescriptor;
 
-float readS16(istream& in)
+namespace
 {
-    unsigned char c[2];
-    cin.read((char*) c, 2);
 
-    return (((short) c[0] << 8) | c[1]) * (1.0f / 65535.0f);
-}
+// Rows of the normal map computed together by the threads
+constexpr int BandRows = 64;
+
+struct Options
+{
+    int width{ 0 };
+    int height{ 0 };
+    float bumpHeight{ 1.0f };
+    std::string inputFilename;
+    unsigned int kernelSize{ 2 };
+    bool littleEndian{ false };
+    bool tiles{ false };
+    TileOptions tileOptions;
+};
 
 
-float* readRowS16(istream& in, int width)
+/*! A window of consecutive height map rows, converted to floats, read from
+ *  the input as the window moves down. Rows outside the map repeat its
+ *  first or last row, and each row is extended by pad samples on both
+ *  sides which wrap around, so the kernels need no special cases at the
+ *  edges.
+ */
+class HeightRows
 {
-    float* row = new float[width];
-    for (int i = 0; i < width; i++)
-        row[i] = readS16(in);
+public:
+    HeightRows(std::FILE* in, const Options& options, int pad, int maxRows) :
+        in(in),
+        width(options.width),
+        height(options.height),
+        pad(pad),
+        stride(options.width + 2 * pad),
+        scale(options.bumpHeight / 65535.0f),
+        littleEndian(options.littleEndian),
+        samples(static_cast<std::size_t>(stride) * maxRows),
+        raw(static_cast<std::size_t>(options.width) * 2 * maxRows)
+    {
+    }
 
-    return row;
-}
+    // Move the window to the rows first to first + count - 1
+    bool moveTo(int first, int count);
 
+    // Sample 0 of row y of the window; samples -pad to width + pad - 1 may
+    // be read
+    const float* row(int y) const
+    {
+        return samples.data() + static_cast<std::size_t>(y - windowStart) * stride + pad;
+    }
 
-int main(int argc, char* argv[])
-{
-    if (argc < 5)
+private:
+    float* slot(int y)
     {
-        cerr << "Usage: nm16 <width> <height> <bumpheight> <filter method>\n";
-        return 1;
+        return samples.data() + static_cast<std::size_t>(y - windowStart) * stride;
     }
 
-    int width = 0;
-    int height = 0;
-    float bumpheight = 1.0f;
-    int method = 0;
+    std::FILE* in;
+    int width;
+    int height;
+    int pad;
+    int stride;
+    float scale;
+    bool littleEndian;
+    std::vector<float> samples;
+    std::vector<std::uint8_t> raw;
+    int windowStart{ 0 };
+    int windowRows{ 0 };
+    int nextInputRow{ 0 };
+};
 
-    if (sscanf(argv[1], " %d", &width) != 1 ||
-        sscanf(argv[2], " %d", &height) != 1)
+
+bool
+HeightRows::moveTo(int first, int count)
+{
+    // Keep the rows which are still in the window
+    int kept = windowRows > 0 ? std::clamp(windowStart + windowRows - first, 0, count) : 0;
+    if (kept > 0)
     {
-        cerr << "Bad image dimensions.\n";
-        return 1;
+        std::copy(samples.begin() + static_cast<std::size_t>(first - windowStart) * stride,
+                  samples.begin() + static_cast<std::size_t>(windowRows) * stride,
+                  samples.begin());
     }
+    windowStart = first;
+    windowRows = count;
 
-    if (sscanf(argv[3], " %f", &bumpheight) != 1)
+    // Read all new rows of the map with one call
+    int readEnd = std::min(first + count, height);
+    int nRead = std::max(readEnd - nextInputRow, 0);
+    if (nRead > 0)
     {
-        cerr << "Invalid bump height.\n";
-        return 1;
+        std::size_t bytes = static_cast<std::size_t>(width) * 2 * nRead;
+        if (std::fread(raw.data(), 1, bytes, in) != bytes)
+            return false;
+
+        int hi = littleEndian ? 1 : 0;
+        for (int i = 0; i < nRead; i++)
+        {
+            const std::uint8_t* src = raw.data() + static_cast<std::size_t>(width) * 2 * i;
+            float* dst = slot(nextInputRow + i) + pad;
+            for (int x = 0; x < width; x++)
+            {
+                auto value = static_cast<std::int16_t>((src[2 * x + hi] << 8) | src[2 * x + 1 - hi]);
+                dst[x] = static_cast<float>(value) * scale;
+            }
+
+            std::copy(dst + width - pad, dst + width, dst - pad);
+            std::copy(dst, dst + pad, dst + width);
+        }
+        nextInputRow += nRead;
     }
 
-    if (sscanf(argv[4], " %d", &method) != 1)
+    // Repeat the edge rows beyond the map
+    for (int y = first + kept; y < first + count; y++)
     {
-        cerr << "Bad filter method.\n";
-        return 1;
+        if (y < 0 || y >= height)
+        {
+            const float* edge = row(std::clamp(y, 0, height - 1)) - pad;
+            std::copy(edge, edge + stride, slot(y));
+        }
     }
 
-    // Binary 8-bit grayscale header
-    // cout << "P5\n";
-    // Binary 8-bit/channel RGB header
-    cout << "P6\n";
-    cout << width << ' ' << height << '\n' << "255\n";
+    return true;
+}
+
+
+/*! Computes the normals of one row from the heights with central
+ *  differences over a kernelSize x kernelSize box, or with differences
+ *  to the previous sample like Image::computeNormalMap for a kernel size of
+ *  2. The loops run over whole rows without branches so that the compiler
+ *  can vectorize them.
+ */
+class NormalKernel
+{
+public:
+    NormalKernel(int width, unsigned int kernelSize) :
+        width(width),
+        kernelSize(kernelSize),
+        radius(static_cast<int>(kernelSize / 2)),
+        sums(static_cast<std::size_t>(width) + kernelSize),
+        differences(static_cast<std::size_t>(width) + kernelSize),
+        dx(width),
+        dy(width)
+    {
+    }
 
-    float** samples = new float*[height];
+    static int padding(unsigned int kernelSize) { return std::max(static_cast<int>(kernelSize / 2), 1); }
 
-    for (int i = 0; i < kernelSize - 1; i++)
-        samples[i] = readRowS16(cin, width);
+    void computeRow(const HeightRows& rows, int y, std::uint8_t* normals);
 
-    for (int y = 0; y < height; y++)
+private:
+    int width;
+    unsigned int kernelSize;
+    int radius;
+    std::vector<float> sums;
+    std::vector<float> differences;
+    std::vector<float> dx;
+    std::vector<float> dy;
+};
+
+
+void
+NormalKernel::computeRow(const HeightRows& rows, int y, std::uint8_t* normals)
+{
+    if (kernelSize == 2)
     {
-        // Out with the old . . .
-        if (y > halfKernelSize)
-            delete[] samples[y - halfKernelSize - 1];
+        // The first row is differenced with the second
+        const float* h0 = rows.row(y == 0 ? 1 : y);
+        const float* h1 = rows.row(y == 0 ? 0 : y - 1);
+        for (int x = 0; x < width; x++)
+        {
+            dx[x] = h0[x - 1] - h0[x];
+            dy[x] = h1[x] - h0[x];
+        }
+    }
+    else
+    {
+        int n = width + 2 * radius;
+        float norm = 1.0f / static_cast<float>(2 * radius * (2 * radius + 1));
 
-        // . . . and in with the new.
-        if (y < height - halfKernelSize)
-            samples[y + halfKernelSize] = readRowS16(cin, width);
+        // Column sums over the kernel rows, and differences of its top and
+        // bottom rows, including the padding
+        const float* top = rows.row(y - radius) - radius;
+        const float* bottom = rows.row(y + radius) - radius;
+        std::fill(sums.begin(), sums.begin() + n, 0.0f);
+        for (int j = -radius; j <= radius; j++)
+        {
+            const float* h = rows.row(y + j) - radius;
+            for (int x = 0; x < n; x++)
+                sums[x] += h[x];
+        }
+        for (int x = 0; x < n; x++)
+            differences[x] = top[x] - bottom[x];
+
+        std::fill(dy.begin(), dy.end(), 0.0f);
+        for (int i = 0; i <= 2 * radius; i++)
+        {
+            const float* d = differences.data() + i;
+            for (int x = 0; x < width; x++)
+                dy[x] += d[x];
+        }
 
+        const float* left = sums.data();
+        const float* right = sums.data() + 2 * radius;
         for (int x = 0; x < width; x++)
         {
-#if 0
-            unsigned char v = (unsigned char) (samples[y][x]  * 255.99f);
-            cout.write((char*) &v, 1);
+            dx[x] = (left[x] - right[x]) * norm;
+            dy[x] *= norm;
+        }
+    }
+
+    for (int x = 0; x < width; x++)
+    {
+        float rmag = 1.0f / std::sqrt(dx[x] * dx[x] + dy[x] * dy[x] + 1.0f);
+        normals[3 * x]     = static_cast<std::uint8_t>(128 + 127 * dx[x] * rmag);
+        normals[3 * x + 1] = static_cast<std::uint8_t>(128 + 127 * dy[x] * rmag);
+        normals[3 * x + 2] = static_cast<std::uint8_t>(128 + 127 * rmag);
+    }
+}
+
+
+// Compute the normals of a band of rows, split among nThreads threads
+void
+computeBand(const HeightRows& rows, const Options& options, unsigned int nThreads,
+            int firstRow, int nRows, std::vector<std::uint8_t>& normals)
+{
+    std::size_t rowBytes = static_cast<std::size_t>(options.width) * 3;
+    auto computeRows = [&](int first, int last)
+    {
+        NormalKernel kernel(options.width, options.kernelSize);
+        for (int y = first; y < last; y++)
+            kernel.computeRow(rows, firstRow + y, normals.data() + y * rowBytes);
+    };
+
+    nThreads = std::min(nThreads, static_cast<unsigned int>(nRows));
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < nThreads; i++)
+        workers.emplace_back(computeRows, nRows * i / nThreads, nRows * (i + 1) / nThreads);
+
+    computeRows(0, nRows / static_cast<int>(nThreads));
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+template<typename Output>
+bool
+computeNormalMap(std::FILE* in, const Options& options, Output output)
+{
+    unsigned int nThreads = options.tileOptions.threads == 0
+        ? std::max(std::thread::hardware_concurrency(), 1u)
+        : options.tileOptions.threads;
+
+    // Kernel size 2 needs the rows above and below for the first row
+    int pad = NormalKernel::padding(options.kernelSize);
+    HeightRows rows(in, options, pad, BandRows + 2 * pad);
+    std::vector<std::uint8_t> normals(static_cast<std::size_t>(options.width) * 3 * BandRows);
+
+    for (int y = 0; y < options.height; y += BandRows)
+    {
+        int nRows = std::min(BandRows, options.height - y);
+        if (!rows.moveTo(y - pad, nRows + 2 * pad))
+        {
+            std::cerr << "Error reading the height map at row " << y << '\n';
+            return false;
+        }
+
+        computeBand(rows, options, nThreads, y, nRows, normals);
+        if (!output(normals.data(), nRows))
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+writePPM(std::FILE* in, const Options& options)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
 #endif
-            float dx;
-            if (x == width - 1)
-                dx = samples[y][0] - samples[y][x];
-            else
-                dx = samples[y][x + 1] - samples[y][x];
 
-            float dy;
-            if (y == height - 1)
-                dy = samples[y][x] - samples[y - 1][x];
-            else
-                dy = samples[y + 1][x] - samples[y][x];
+    // Binary 8-bit/channel RGB header
+    std::string header = fmt::format("P6\n{} {}\n255\n", options.width, options.height);
+    if (std::fwrite(header.data(), 1, header.size(), stdout) != header.size())
+        return false;
+
+    std::size_t rowBytes = static_cast<std::size_t>(options.width) * 3;
+    return computeNormalMap(in, options,
+                            [rowBytes](const std::uint8_t* normals, int nRows)
+                            {
+                                std::size_t bytes = rowBytes * nRows;
+                                return std::fwrite(normals, 1, bytes, stdout) == bytes;
+                            });
+}
+
+
+bool
+writeTiles(std::FILE* in, const Options& options)
+{
+    const TileOptions& tiles = options.tileOptions;
+    unsigned int nLevels = CountLevels(tiles, options.width);
+    if (nLevels == 0)
+        return false;
+
+    TilePyramid pyramid(tiles, 3, nLevels);
+    RowResampler resampler(options.width, options.height,
+                           static_cast<int>(pyramid.getWidth()), static_cast<int>(pyramid.getHeight()), 3,
+                           [&pyramid](const std::uint8_t* row) { return pyramid.addRow(row); });
+
+    std::size_t rowBytes = static_cast<std::size_t>(options.width) * 3;
+    bool ok = computeNormalMap(in, options,
+                               [&resampler, rowBytes](const std::uint8_t* normals, int nRows)
+                               {
+                                   for (int i = 0; i < nRows; i++)
+                                   {
+                                       if (!resampler.addRow(normals + rowBytes * i))
+                                           return false;
+                                   }
+                                   return true;
+                               });
+
+    ok = pyramid.finish() && ok;
+    return ok && WriteDescriptor(tiles, nLevels,
+                                 fmt::format("Normal map made by nm16, bump height {}, kernel size {}",
+                                             options.bumpHeight, options.kernelSize));
+}
+
+
+void
+Usage()
+{
+    std::cerr << "Usage: nm16 [options] <width> <height> <bump height> [<height map>]\n";
+    std::cerr << "  Reads big-endian signed 16-bit heights from the file or standard input and\n";
+    std::cerr << "  writes a PPM image to standard output.\n";
+    std::cerr << "  Options:\n";
+    std::cerr << "    --kernel <n> : kernel size, 2 or an odd number >= 3 (default 2)\n";
+    std::cerr << "    --little-endian : the heights are little-endian\n";
+    std::cerr << "    --tiles <directory> : write virtual texture tiles instead of an image\n";
+    TileOptionsUsage();
+}
+
+
+bool
+parseCommandLine(int argc, char* argv[], Options& options)
+{
+    int argCount = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        bool error = false;
+        if (ParseTileOption(argc, argv, i, options.tileOptions, error))
+            continue;
+        if (error)
+            return false;
+
+        if (arg == "--kernel")
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.kernelSize = static_cast<unsigned int>(std::strtoul(argv[++i], &end, 10));
+            if (end == nullptr || *end != '\0' || options.kernelSize < 2 || options.kernelSize > 63 ||
+                (options.kernelSize > 2 && options.kernelSize % 2 == 0))
+            {
+                std::cerr << "The kernel size must be 2 or an odd number from 3 to 63\n";
+                return false;
+            }
+        }
+        else if (arg == "--little-endian")
+        {
+            options.littleEndian = true;
+        }
+        else if (arg == "--tiles")
+        {
+            if (i + 1 == argc)
+            {
+                std::cerr << "Missing value for " << arg << '\n';
+                return false;
+            }
+            options.tiles = true;
+            options.tileOptions.outputDirectory = argv[++i];
         }
+        else if (arg.size() > 1 && arg.front() == '-')
+        {
+            std::cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+        else if (argCount == 0 || argCount == 1)
+        {
+            int& value = argCount == 0 ? options.width : options.height;
+            if (std::sscanf(argv[i], " %d", &value) != 1 || value <= 0)
+            {
+                std::cerr << "Bad image dimensions.\n";
+                return false;
+            }
+            ++argCount;
+        }
+        else if (argCount == 2)
+        {
+            if (std::sscanf(argv[i], " %f", &options.bumpHeight) != 1)
+            {
+                std::cerr << "Invalid bump height.\n";
+                return false;
+            }
+            ++argCount;
+        }
+        else if (argCount == 3)
+        {
+            options.inputFilename = arg;
+            ++argCount;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options.width < static_cast<int>(options.kernelSize))
+    {
+        std::cerr << "The height map is narrower than the kernel\n";
+        return false;
+    }
+
+    return argCount >= 3 && (!options.tiles || CheckTileOptions(options.tileOptions));
+}
+
+} // end unnamed namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    std::FILE* in = stdin;
+    if (!options.inputFilename.empty())
+    {
+        in = std::fopen(options.inputFilename.c_str(), "rb");
+        if (in == nullptr)
+        {
+            std::cerr << "Error opening " << options.inputFilename << '\n';
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    else
+    {
+        // Enable binary reads for stdin on Windows
+        _setmode(_fileno(stdin), _O_BINARY);
     }
+#endif
+
+    CreateLogger();
+    bool success = options.tiles ? writeTiles(in, options) : writePPM(in, options);
+    DestroyLogger();
+
+    if (in != stdin)
+        std::fclose(in);
 
-    return 0;
+    return success ? 0 : 1;
 }
@@ -12,17 +12,29 @@
 #include "SpiceUsr.h"
 #include <string>
 #include <vector>
+#include <array>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <limits>
 
-#ifndef min
-#define min(a, b) ((a) < (b) ? (a) : (b))
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
 
+#include <celephem/xyzvbinary.h>
+#include <celcompat/bit.h>
+
 using namespace std;
 
 
@@ -338,16 +350,232 @@ void writeCommentHeader(const Configuration& config,
 }
 
 
-bool convertSpkToXyzv(const Configuration& config,
-                      ostream& out)
+// A state sampled at a time ET
+class Record
+{
+public:
+    Record(double _et, const StateVector& _state) : et(_et), state(_state) {}
+
+    double et;
+    StateVector state;
+};
+
+
+void loadLeapSecondKernel()
+{
+#if defined(_WIN32)
+    furnsh_c("naif0012.tls");
+#else
+    furnsh_c(CONFIG_DATA_DIR "/" "naif0012.tls");
+#endif
+}
+
+
+void loadKernels(const Configuration& config)
 {
-    // Load the required SPICE kernels
     for (vector<string>::const_iterator iter = config.kernelList.begin();
          iter != config.kernelList.end(); iter++)
     {
         string pathname = config.kernelDirectory + "/" + *iter;
         furnsh_c(pathname.c_str());
     }
+}
+
+
+// Compute the state at t + dt in s1 and return the distance between the
+// SPICE position at t + dt/2 and the cubic interpolation from s0 at t.
+double stepError(const Configuration& config,
+                 SpiceInt targetID,
+                 SpiceInt observerID,
+                 double t,
+                 double dt,
+                 const StateVector& s0,
+                 StateVector& s1)
+{
+    s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
+
+    Vec3d pTest = getStateVector(targetID, t + dt / 2.0, config.frameName, observerID).position;
+    Vec3d pInterp = cubicInterpolate(s0.position,
+                                     s0.velocity * dt,
+                                     s1.position,
+                                     s1.velocity * dt,
+                                     0.5);
+
+    return (pInterp - pTest).length();
+}
+
+
+// Sample the trajectory from startET to endET. The first record is the
+// state at startET and the last one the state at endET. Each step starts
+// from the size of the previous one: it is shrunk until the interpolation
+// error is within the tolerance, or grown for as long as it stays within.
+void sampleTrajectory(const Configuration& config,
+                      SpiceInt targetID,
+                      SpiceInt observerID,
+                      double startET,
+                      double endET,
+                      vector<Record>& records)
+{
+    const double stepFactor = 1.25;
+
+    StateVector lastState = getStateVector(targetID, startET, config.frameName, observerID);
+    records.push_back(Record(startET, lastState));
+
+    double t = startET;
+    double dt = config.minStepSize * 2.0;
+    while (t < endET)
+    {
+        // Make sure that we don't go past the end of the sample interval
+        double maxStepSize = min(config.maxStepSize, endET - t);
+        dt = min(maxStepSize, max(dt, config.minStepSize));
+
+        StateVector s1 = lastState;
+        double positionError = stepError(config, targetID, observerID, t, dt, lastState, s1);
+
+        if (positionError > config.tolerance)
+        {
+            // Decrease the step until the error is within the tolerance
+            while (positionError > config.tolerance && dt > config.minStepSize)
+            {
+                dt = max(dt / stepFactor, config.minStepSize);
+                positionError = stepError(config, targetID, observerID, t, dt, lastState, s1);
+            }
+        }
+        else
+        {
+            // Increase the step for as long as the error stays within the
+            // tolerance, keeping the last step which passed
+            while (dt < maxStepSize)
+            {
+                double nextStep = min(maxStepSize, dt * stepFactor);
+                StateVector s2 = lastState;
+                if (stepError(config, targetID, observerID, t, nextStep, lastState, s2) > config.tolerance)
+                    break;
+
+                dt = nextStep;
+                s1 = s2;
+            }
+        }
+
+        // Land exactly on the end of the interval
+        t = dt < endET - t ? t + dt : endET;
+        lastState = s1;
+
+        records.push_back(Record(t, lastState));
+    }
+}
+
+
+#ifndef _WIN32
+// SPICE isn't thread-safe, so the time range is split among child
+// processes, each of which loads its own copy of the kernel pool. The
+// children write their records to temporary files which are joined in
+// order, dropping the first record of each range after the first, as it
+// duplicates the last record of the previous one.
+bool sampleInProcesses(const Configuration& config,
+                       SpiceInt targetID,
+                       SpiceInt observerID,
+                       double startET,
+                       double endET,
+                       unsigned int nProcesses,
+                       vector<Record>& records)
+{
+    // Neither the open kernel files nor unwritten output may be shared
+    // with the children
+    kclear_c();
+    cout.flush();
+    cerr.flush();
+    fflush(nullptr);
+
+    vector<FILE*> files;
+    vector<pid_t> children;
+    bool ok = true;
+    for (unsigned int i = 0; i < nProcesses; i++)
+    {
+        double t0 = startET + (endET - startET) * i / nProcesses;
+        double t1 = i + 1 == nProcesses ? endET : startET + (endET - startET) * (i + 1) / nProcesses;
+
+        FILE* file = tmpfile();
+        if (file == nullptr)
+        {
+            cerr << "Error creating temporary file.\n";
+            ok = false;
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            cerr << "Error starting sampling process.\n";
+            fclose(file);
+            ok = false;
+            break;
+        }
+
+        if (pid == 0)
+        {
+            loadLeapSecondKernel();
+            loadKernels(config);
+
+            vector<Record> range;
+            sampleTrajectory(config, targetID, observerID, t0, t1, range);
+
+            bool written = true;
+            for (vector<Record>::const_iterator iter = range.begin(); iter != range.end(); iter++)
+            {
+                const StateVector& s = iter->state;
+                double values[7] = { iter->et,
+                                     s.position.x, s.position.y, s.position.z,
+                                     s.velocity.x, s.velocity.y, s.velocity.z };
+                written = written && fwrite(values, sizeof(values), 1, file) == 1;
+            }
+
+            // Skip the exit handlers, which would flush state copied from
+            // the parent
+            _exit(written && fflush(file) == 0 ? 0 : 1);
+        }
+
+        files.push_back(file);
+        children.push_back(pid);
+    }
+
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        int status = 0;
+        if (waitpid(children[i], &status, 0) != children[i] ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            cerr << "Sampling process " << i << " failed.\n";
+            ok = false;
+        }
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        rewind(files[i]);
+        double values[7];
+        for (bool first = true; fread(values, sizeof(values), 1, files[i]) == 1; first = false)
+        {
+            if (first && i > 0)
+                continue;
+
+            double state[6] = { values[1], values[2], values[3], values[4], values[5], values[6] };
+            records.push_back(Record(values[0], StateVector(state)));
+        }
+        fclose(files[i]);
+    }
+
+    return ok;
+}
+#endif
+
+
+bool convertSpkToXyzv(const Configuration& config,
+                      unsigned int nProcesses,
+                      vector<Record>& records)
+{
+    // Load the required SPICE kernels
+    loadKernels(config);
 
     double startET = 0.0;
     double endET = 0.0;
@@ -369,92 +597,53 @@ bool convertSpkToXyzv(const Configuration& config,
         return false;
     }
 
-    double startStepSize = config.minStepSize; // samplingParams.startStep;
-    double maxStepSize   = config.maxStepSize; // samplingParams.maxStep;
-    double minStepSize   = config.minStepSize; // samplingParams.minStep;
-    double tolerance     = config.tolerance;   // samplingParams.tolerance;
-    double t = startET;
-    const double stepFactor = 1.25;
-
-    StateVector lastState = getStateVector(targetID, startET, config.frameName, observerID);
-    double et = startET;
-
-    printRecord(out, et, lastState);
-
-    int sampCount = 0;
-    int nTests = 0;
-
-    while (t < endET)
-    {
-        // Make sure that we don't go past the end of the sample interval
-        maxStepSize = min(maxStepSize, endET - t);
-        double dt = min(maxStepSize, startStepSize * 2.0);
-
-        StateVector s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
-
-        double tmid = t + dt / 2.0;
-        Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-        Vec3d pInterp = cubicInterpolate(lastState.position,
-                                         lastState.velocity * dt,
-                                         s1.position,
-                                         s1.velocity * dt,
-                                         0.5);
-        nTests++;
-
-        double positionError = (pInterp - pTest).length();
+#ifndef _WIN32
+    if (nProcesses > 1)
+        return sampleInProcesses(config, targetID, observerID, startET, endET, nProcesses, records);
+#endif
 
-        // Error is greater than tolerance; decrease the step until the
-        // error is within the tolerance.
-        if (positionError > tolerance)
-        {
-            while (positionError > tolerance && dt > minStepSize)
-            {
-                dt /= stepFactor;
+    sampleTrajectory(config, targetID, observerID, startET, endET, records);
+    return true;
+}
 
-                s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
 
-                tmid = t + dt / 2.0;
-                Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-                pInterp = cubicInterpolate(lastState.position,
-                                           lastState.velocity * dt,
-                                           s1.position,
-                                           s1.velocity * dt,
-                                           0.5);
-                nTests++;
+bool writeRecords(const vector<Record>& records, ostream& out)
+{
+    for (vector<Record>::const_iterator iter = records.begin(); iter != records.end(); iter++)
+        printRecord(out, iter->et, iter->state);
 
-                positionError = (pInterp - pTest).length();
-            }
-        }
-        else
-        {
-            // Error is less than the tolerance; increase the step size until
-            // the tolerance is just exceeded.
-            while (positionError < tolerance && dt < maxStepSize)
-            {
-                dt *= stepFactor;
-                dt = min(maxStepSize, dt);
+    return out.good();
+}
 
-                s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
 
-                tmid = t + dt / 2.0;
-                Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-                pInterp = cubicInterpolate(lastState.position,
-                                           lastState.velocity * dt,
-                                           s1.position,
-                                           s1.velocity * dt,
-                                           0.5);
+// Write the records in the binary xyzv format read by Celestia, with the
+// time as a TDB Julian date, position in km and velocity in km/s.
+bool writeBinaryRecords(const vector<Record>& records, ostream& out)
+{
+    using celestia::ephem::XYZVBinaryHeader;
+    using celestia::ephem::XYZV_MAGIC;
 
-                nTests++;
+    array<char, sizeof(XYZVBinaryHeader)> header = {};
+    auto byteOrder = static_cast<decltype(XYZVBinaryHeader::byteOrder)>(celestia::compat::endian::native);
+    auto digits =    static_cast<decltype(XYZVBinaryHeader::digits)   >(numeric_limits<double>::digits);
+    auto count =     static_cast<decltype(XYZVBinaryHeader::count)    >(records.size());
 
-                positionError = (pInterp - pTest).length();
-            }
-        }
+    memcpy(header.data() + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.data(), XYZV_MAGIC.size());
+    memcpy(header.data() + offsetof(XYZVBinaryHeader, byteOrder), &byteOrder, sizeof(byteOrder));
+    memcpy(header.data() + offsetof(XYZVBinaryHeader, digits),    &digits,    sizeof(digits));
+    memcpy(header.data() + offsetof(XYZVBinaryHeader, count),     &count,     sizeof(count));
 
-        t = t + dt;
-        lastState = s1;
+    if (!out.write(header.data(), header.size()))
+        return false;
 
-        printRecord(out, t, lastState);
-        sampCount++;
+    for (vector<Record>::const_iterator iter = records.begin(); iter != records.end(); iter++)
+    {
+        const StateVector& s = iter->state;
+        double values[7] = { et2jd(iter->et),
+                             s.position.x, s.position.y, s.position.z,
+                             s.velocity.x, s.velocity.y, s.velocity.z };
+        if (!out.write(reinterpret_cast<const char*>(values), sizeof(values)))
+            return false;
     }
 
     return true;
@@ -532,16 +721,66 @@ bool readConfig(istream& in, Configuration& config)
 }
 
 
+void usage()
+{
+    cerr << "Usage: spice2xyzv [options] <config filename> [output filename]\n";
+    cerr << "   --binary (or -b)            : write a binary xyzv file\n";
+    cerr << "   --processes <n> (or -p <n>) : sample the time range in n processes\n";
+}
+
+
 int main(int argc, char* argv[])
 {
-    if (argc < 2)
+    bool binary = false;
+    unsigned int nProcesses = 1;
+    const char* configFilename = nullptr;
+    const char* outputFilename = nullptr;
+
+    for (int i = 1; i < argc; i++)
     {
-        cerr << "Usage: spice2xyzv <config filename> [output filename]\n";
+        string arg = argv[i];
+        if (arg == "-b" || arg == "--binary")
+        {
+            binary = true;
+        }
+        else if (arg == "-p" || arg == "--processes")
+        {
+            if (i + 1 == argc || (nProcesses = strtoul(argv[++i], nullptr, 10)) == 0)
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (configFilename == nullptr)
+        {
+            configFilename = argv[i];
+        }
+        else if (outputFilename == nullptr)
+        {
+            outputFilename = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (configFilename == nullptr)
+    {
+        usage();
         return 1;
     }
 
+#ifdef _WIN32
+    if (nProcesses > 1)
+    {
+        cerr << "Sampling in several processes is not supported on this platform.\n";
+        nProcesses = 1;
+    }
+#endif
 
-    ifstream configFile(argv[1]);
+    ifstream configFile(configFilename);
     if (!configFile)
     {
         cerr << "Error opening configuration file.\n";
@@ -587,15 +826,42 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    ofstream outputFile;
+    if (outputFilename != nullptr)
+    {
+        outputFile.open(outputFilename, binary ? ios::out | ios::binary : ios::out);
+        if (!outputFile)
+        {
+            cerr << "Error opening output file.\n";
+            return 1;
+        }
+    }
+    else if (binary)
+    {
+        cerr << "An output filename is required for binary output.\n";
+        return 1;
+    }
+
+    ostream& out = outputFilename != nullptr ? static_cast<ostream&>(outputFile) : cout;
+
     // Load the leap second kernel
-#if defined(_WIN32)
-    furnsh_c("naif0012.tls");
-#else
-    furnsh_c(CONFIG_DATA_DIR "/" "naif0012.tls");
-#endif
+    loadLeapSecondKernel();
+
+    // The header has to be written before sampling in several processes,
+    // which unloads the kernels in this one
+    if (!binary)
+        writeCommentHeader(config, out);
 
-    writeCommentHeader(config, cout);
-    convertSpkToXyzv(config, cout);
+    vector<Record> records;
+    if (!convertSpkToXyzv(config, nProcesses, records))
+        return 1;
+
+    bool written = binary ? writeBinaryRecords(records, out) : writeRecords(records, out);
+    if (!written || !out.flush())
+    {
+        cerr << "Error writing output file.\n";
+        return 1;
+    }
 
     return 0;
 }
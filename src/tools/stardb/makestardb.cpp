@@ -14,24 +14,40 @@
 #include <iomanip>
 #include <cctype>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
 #include <celastro/astro.h>
 #include <celutil/bytes.h>
+#include <celutil/logger.h>
 #include <celengine/star.h>
+#include <celengine/stardb.h>
+#include "textchunks.h"
 
 using namespace std;
 
 namespace astro = celestia::astro;
 
+using celestia::util::CreateLogger;
+using celestia::util::DestroyLogger;
+
 static string inputFilename;
 static string outputFilename;
+static string octreeCacheFilename;
 static bool useSphericalCoords = false;
 
+// Offset of the star count in the header
+constexpr streamoff StarCountOffset = 10;
+
 
 void Usage()
 {
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --octree-cache (or -c) <file> : also write the star octree cache for\n";
+    cerr << "        a configuration that loads no other star catalogs\n";
 }
 
 
@@ -48,6 +64,15 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--octree-cache") || !strcmp(argv[i], "-c"))
+            {
+                if (i + 1 == argc)
+                {
+                    cerr << "Missing octree cache filename\n";
+                    return false;
+                }
+                octreeCacheFilename = string(argv[++i]);
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -82,83 +107,98 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(ostream& out, uint32_t n)
+static void appendUint(string& out, uint32_t n)
 {
     LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+    out.append(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
-static void writeFloat(ostream& out, float f)
+static void appendFloat(string& out, float f)
 {
     LE_TO_CPU_FLOAT(f, f);
-    out.write(reinterpret_cast<const char*>(&f), sizeof f);
+    out.append(reinterpret_cast<const char*>(&f), sizeof f);
 }
 
-static void writeUshort(ostream& out, uint16_t n)
+static void appendUshort(string& out, uint16_t n)
 {
     LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+    out.append(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
-static void writeShort(ostream& out, int16_t n)
+static void appendShort(string& out, int16_t n)
 {
     LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+    out.append(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
 
-bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+enum class ParseError
 {
-    unsigned int nStarsInFile = 0;
+    None,
+    CatalogNumber,
+    Position,
+    Magnitude,
+};
+
+// Binary star records converted from a chunk of input lines
+struct StarRecords
+{
+    string data;
+    unsigned int count{ 0 };
+    ParseError error{ ParseError::None };
+    unsigned int catalogNumber{ 0 };
+};
 
-    in >> nStarsInFile;
-    if (!in.good())
-    {
-        cerr << "Error reading star count at beginning of input file.\n";
-        return 1;
-    }
+constexpr size_t StarRecordSize = 20;
 
-    // Write the header
-    out.write("CELSTARS", 8);
 
-    // Write the version
-    writeShort(out, 0x0100);
+// Convert the records of a chunk, one star per line; this runs on worker
+// threads
+static StarRecords ParseStarRecords(string&& chunk, bool sphericalCoords)
+{
+    using stardbtools::NextLine;
+    using stardbtools::NextToken;
+    using stardbtools::ParseNumber;
 
-    writeUint(out, nStarsInFile);
+    StarRecords records;
+    records.data.reserve(chunk.size() / 2);
 
-    for (unsigned int record = 0; record < nStarsInFile; record++)
+    string_view text = chunk;
+    while (!text.empty())
     {
+        string_view line = NextLine(text);
+        string_view token = NextToken(line);
+        if (token.empty())
+            continue;
+
         unsigned int catalogNumber;
         float x, y, z;
         float absMag;
 
-        in >> catalogNumber;
-        if (in.eof())
-            return true;
-
-        if (!in.good())
+        if (!ParseNumber(token, catalogNumber))
         {
-            cerr << "Error parsing catalog number for record #" << record << '\n';
-            return false;
+            records.error = ParseError::CatalogNumber;
+            return records;
         }
 
+        records.catalogNumber = catalogNumber;
         if (sphericalCoords)
         {
             float RA, dec, distance;
             float appMag;
 
-            in >> RA >> dec >> distance;
-            if (!in.good())
+            if (!ParseNumber(NextToken(line), RA) ||
+                !ParseNumber(NextToken(line), dec) ||
+                !ParseNumber(NextToken(line), distance))
             {
-                cerr << "Error parsing position of star " << catalogNumber << '\n';
-                return false;
+                records.error = ParseError::Position;
+                return records;
             }
 
-            in >> appMag;
-            if (!in.good())
+            if (!ParseNumber(NextToken(line), appMag))
             {
-                cerr << "Error parsing magnitude of star " << catalogNumber << '\n';
-                return false;
+                records.error = ParseError::Magnitude;
+                return records;
             }
 
             Eigen::Vector3d pos =
@@ -172,45 +212,116 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         }
         else
         {
-            in >> x >> y >> z;
-            if (!in.good())
+            if (!ParseNumber(NextToken(line), x) ||
+                !ParseNumber(NextToken(line), y) ||
+                !ParseNumber(NextToken(line), z))
             {
-                cerr << "Error parsing position of star " << catalogNumber << '\n';
-                return false;
+                records.error = ParseError::Position;
+                return records;
             }
 
-            in >> absMag;
-            if (!in.good())
+            if (!ParseNumber(NextToken(line), absMag))
             {
-                cerr << "Error parsing magnitude of star " << catalogNumber << '\n';
-                return false;
+                records.error = ParseError::Magnitude;
+                return records;
             }
         }
 
-        string scString;
-        in >> scString;
-        StellarClass sc = StellarClass::parse(scString);
-#if 0
-        StarDetails* details = StarDetails::GetStarDetails(sc);
-        if (details == NULL)
+        StellarClass sc = StellarClass::parse(NextToken(line));
+
+        appendUint(records.data, catalogNumber);
+        appendFloat(records.data, x);
+        appendFloat(records.data, y);
+        appendFloat(records.data, z);
+        appendShort(records.data, (int16_t) (absMag * 256.0f));
+        appendUshort(records.data, sc.packV1());
+        records.count++;
+    }
+
+    return records;
+}
+
+
+bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+{
+    unsigned int nStarsInFile = 0;
+
+    in >> nStarsInFile;
+    if (!in.good())
+    {
+        cerr << "Error reading star count at beginning of input file.\n";
+        return false;
+    }
+
+    // Write the header
+    string header("CELSTARS", 8);
+
+    // Write the version
+    appendShort(header, 0x0100);
+
+    appendUint(header, nStarsInFile);
+    out.write(header.data(), header.size());
+
+    // The records are parsed on worker threads and written in input order
+    unsigned int record = 0;
+    bool ok = stardbtools::ParseTextChunks(in,
+        [sphericalCoords](string&& chunk) { return ParseStarRecords(std::move(chunk), sphericalCoords); },
+        [&](StarRecords&& records)
         {
-            cerr << "Error parsing spectral type of star " << catalogNumber << '\n';
+            unsigned int count = min(records.count, nStarsInFile - record);
+            out.write(records.data.data(), count * StarRecordSize);
+            record += count;
+
+            if (record == nStarsInFile)
+                return false;
+
+            switch (records.error)
+            {
+            case ParseError::None:
+                return out.good();
+            case ParseError::CatalogNumber:
+                cerr << "Error parsing catalog number for record #" << record << '\n';
+                break;
+            case ParseError::Position:
+                cerr << "Error parsing position of star " << records.catalogNumber << '\n';
+                break;
+            case ParseError::Magnitude:
+                cerr << "Error parsing magnitude of star " << records.catalogNumber << '\n';
+                break;
+            }
+
             return false;
-        }
+        });
+
+    if (record == nStarsInFile)
+        return out.good();
 
-        // For spectral type parser debugging . . .
-        cout << scString << ' ' << details->getSpectralType() << '\n';
-#endif
+    if (!ok)
+        return false;
+
+    // The input ended early, fix up the count
+    cerr << "Warning: input file has " << record << " stars, not " << nStarsInFile << '\n';
+    out.seekp(StarCountOffset);
+    header.clear();
+    appendUint(header, record);
+    out.write(header.data(), header.size());
+    return out.good();
+}
 
-        writeUint(out, catalogNumber);
-        writeFloat(out, x);
-        writeFloat(out, y);
-        writeFloat(out, z);
-        writeShort(out, (int16_t) (absMag * 256.0f));
-        writeUshort(out, sc.packV1());
+
+// Sort the stars into an octree like Celestia does on startup and save it
+// to the octree cache
+bool WriteOctreeCache(const string& stardbFilename, const string& cacheFilename)
+{
+    StarDatabaseBuilder builder;
+    if (!builder.loadBinary(fs::path(stardbFilename)))
+    {
+        cerr << "Error reading star database file " << stardbFilename << '\n';
+        return false;
     }
 
-    return true;
+    builder.setOctreeCache(fs::path(cacheFilename));
+    return builder.finish() != nullptr;
 }
 
 
@@ -237,6 +348,14 @@ int main(int argc, char* argv[])
     }
 
     bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    stardbFile.close();
+
+    if (success && !octreeCacheFilename.empty())
+    {
+        CreateLogger();
+        success = WriteOctreeCache(outputFilename, octreeCacheFilename);
+        DestroyLogger();
+    }
 
     return success ? 0 : 1;
 }
@@ -0,0 +1,740 @@
+// makestartiles.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Sort a binary star database into the octree tiles of a StarTiles file
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celastro/astro.h>
+#include <celcompat/numbers.h>
+#include <celengine/star.h>
+#include <celengine/staroctree.h>
+#include <celengine/startiledb.h>
+#include <celengine/stellarclass.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/bytes.h>
+#include <celutil/intrusiveptr.h>
+#include <celutil/logger.h>
+
+namespace astro = celestia::astro;
+
+using celestia::engine::StarTileDatabase;
+using celestia::util::CreateLogger;
+using celestia::util::DestroyLogger;
+using celestia::util::IntrusivePtr;
+using celestia::util::readLE;
+using celestia::util::writeLE;
+
+namespace
+{
+
+// The star octree of StarDatabaseBuilder
+constexpr float RootSize = 1000000000.0f;
+constexpr float RootMagnitude = 6.0f;
+const Eigen::Vector3f RootCenter(1000.0f, 1000.0f, 1000.0f);
+
+constexpr std::string_view StarsMagic = "CELSTARS";
+constexpr std::uint16_t StarsVersion = 0x0100;
+
+// Three bits per octree level are stored in each word of a cell path
+constexpr unsigned int LevelsPerWord = 21;
+constexpr unsigned int MaxLevel = LevelsPerWord * 3;
+
+struct Options
+{
+    std::string inputFilename;
+    std::string outputFilename;
+    unsigned int coreLevels{ 20 };
+    unsigned int tileLevels{ 3 };
+    unsigned int maxLevel{ 36 };
+    unsigned int minTileStars{ 4096 };
+};
+
+// An octree cell, identified by its depth and the child chosen at each
+// level above it. Ordering by depth and then by path lists the cells
+// breadth first with the children of each cell next to each other.
+struct CellKey
+{
+    std::uint32_t depth{ 0 };
+    std::array<std::uint64_t, 3> path{ };
+
+    unsigned int child(unsigned int level) const
+    {
+        return static_cast<unsigned int>(path[level / LevelsPerWord] >> shift(level)) & 7U;
+    }
+
+    void setChild(unsigned int level, unsigned int child)
+    {
+        path[level / LevelsPerWord] |= static_cast<std::uint64_t>(child) << shift(level);
+    }
+
+    CellKey ancestor(unsigned int ancestorDepth) const
+    {
+        CellKey key;
+        key.depth = ancestorDepth;
+        for (unsigned int level = 0; level < ancestorDepth; ++level)
+            key.setChild(level, child(level));
+        return key;
+    }
+
+    bool operator<(const CellKey& other) const
+    {
+        return std::tie(depth, path) < std::tie(other.depth, other.path);
+    }
+
+    bool operator==(const CellKey& other) const
+    {
+        return depth == other.depth && path == other.path;
+    }
+
+private:
+    static unsigned int shift(unsigned int level)
+    {
+        return (LevelsPerWord - 1 - level % LevelsPerWord) * 3;
+    }
+};
+
+struct TileInfo
+{
+    std::uint64_t nStars{ 0 };
+    std::uint64_t subtreeStars{ 0 };
+    bool keep{ false };
+    std::uint32_t index{ 0 };
+};
+
+struct StarEntry
+{
+    CellKey tile;
+    std::uint32_t record;
+};
+
+struct DirectoryEntry
+{
+    Eigen::Vector3f center;
+    float scale;
+    float parentExclusion;
+    std::uint32_t firstChild{ 0 };
+    std::uint32_t nChildren{ 0 };
+    std::uint32_t nNodes{ 0 };
+    std::uint32_t nStars{ 0 };
+    std::uint64_t offset{ 0 };
+    std::uint32_t size{ 0 };
+};
+
+
+void
+Usage()
+{
+    std::cerr << "Usage: makestartiles [options] <input star database> <output star tiles>\n";
+    std::cerr << "  Options:\n";
+    std::cerr << "    --core-levels <n> : octree levels in the resident tile (default 20)\n";
+    std::cerr << "    --tile-levels <n> : octree levels in each other tile (default 3)\n";
+    std::cerr << "    --max-level <n> : deepest octree level of a tile (default 36)\n";
+    std::cerr << "    --min-tile-stars <n> : merge smaller tiles into their parent (default 4096)\n";
+}
+
+
+bool
+parseNumberOption(int argc, char* argv[], int& i, unsigned int& value)
+{
+    if (i + 1 == argc)
+    {
+        std::cerr << "Missing value for " << argv[i] << '\n';
+        return false;
+    }
+
+    char* end;
+    unsigned long number = std::strtoul(argv[++i], &end, 10);
+    if (*end != '\0' || number > MaxLevel * 1000000UL)
+    {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << '\n';
+        return false;
+    }
+
+    value = static_cast<unsigned int>(number);
+    return true;
+}
+
+
+bool
+parseCommandLine(int argc, char* argv[], Options& options)
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg.size() > 1 && arg.front() == '-')
+        {
+            unsigned int* value;
+            if (arg == "--core-levels")
+                value = &options.coreLevels;
+            else if (arg == "--tile-levels")
+                value = &options.tileLevels;
+            else if (arg == "--max-level")
+                value = &options.maxLevel;
+            else if (arg == "--min-tile-stars")
+                value = &options.minTileStars;
+            else
+            {
+                std::cerr << "Unknown command line switch: " << arg << '\n';
+                return false;
+            }
+
+            if (!parseNumberOption(argc, argv, i, *value))
+                return false;
+        }
+        else if (fileCount == 0)
+        {
+            options.inputFilename = arg;
+            ++fileCount;
+        }
+        else if (fileCount == 1)
+        {
+            options.outputFilename = arg;
+            ++fileCount;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options.tileLevels == 0 || options.coreLevels == 0 ||
+        options.maxLevel < options.coreLevels || options.maxLevel >= MaxLevel)
+    {
+        std::cerr << "The levels must satisfy 0 < core-levels <= max-level < " << MaxLevel
+                  << " and tile-levels > 0\n";
+        return false;
+    }
+
+    return fileCount == 2;
+}
+
+
+// The brightest absolute magnitude of stars below each octree level, as
+// computed by DynamicStarOctree
+std::vector<float>
+ExclusionFactors(unsigned int maxLevel)
+{
+    std::vector<float> factors;
+    factors.reserve(maxLevel + 1);
+    factors.push_back(astro::appToAbsMag(RootMagnitude, RootSize * celestia::numbers::sqrt3_v<float>));
+    while (factors.size() <= maxLevel)
+        factors.push_back(astro::lumToAbsMag(astro::absMagToLum(factors.back()) / 4.0f));
+    return factors;
+}
+
+
+// Compute the center and half-size of a cell in the same way as
+// DynamicOctree::createChildren
+void
+CellBounds(const CellKey& key, Eigen::Vector3f& center, float& scale)
+{
+    center = RootCenter;
+    scale = RootSize;
+    for (unsigned int level = 0; level < key.depth; ++level)
+    {
+        scale = scale * 0.5f;
+        unsigned int child = key.child(level);
+        center += Eigen::Vector3f((child & 1U) != 0 ? scale : -scale,
+                                  (child & 2U) != 0 ? scale : -scale,
+                                  (child & 4U) != 0 ? scale : -scale);
+    }
+}
+
+
+CellKey
+StarCell(const Eigen::Vector3f& position, unsigned int depth)
+{
+    CellKey key;
+    key.depth = depth;
+    Eigen::Vector3f center = RootCenter;
+    float scale = RootSize;
+    for (unsigned int level = 0; level < depth; ++level)
+    {
+        unsigned int child = (position.x() < center.x() ? 0U : 1U) |
+                             (position.y() < center.y() ? 0U : 2U) |
+                             (position.z() < center.z() ? 0U : 4U);
+        key.setChild(level, child);
+        scale = scale * 0.5f;
+        center += Eigen::Vector3f((child & 1U) != 0 ? scale : -scale,
+                                  (child & 2U) != 0 ? scale : -scale,
+                                  (child & 4U) != 0 ? scale : -scale);
+    }
+
+    return key;
+}
+
+
+std::uint32_t
+RecordCatalogNumber(const char* record)
+{
+    std::uint32_t value;
+    std::memcpy(&value, record, sizeof(value));
+    LE_TO_CPU_INT32(value, value);
+    return value;
+}
+
+
+float
+RecordFloat(const char* record, std::size_t offset)
+{
+    float value;
+    std::memcpy(&value, record + offset, sizeof(value));
+    LE_TO_CPU_FLOAT(value, value);
+    return value;
+}
+
+
+float
+RecordAbsMag(const char* record)
+{
+    std::int16_t value;
+    std::memcpy(&value, record + 16, sizeof(value));
+    LE_TO_CPU_INT16(value, value);
+    return static_cast<float>(value) / 256.0f;
+}
+
+
+std::uint16_t
+RecordSpectralType(const char* record)
+{
+    std::uint16_t value;
+    std::memcpy(&value, record + 18, sizeof(value));
+    LE_TO_CPU_INT16(value, value);
+    return value;
+}
+
+
+bool
+ReadStars(std::istream& in, std::vector<char>& records)
+{
+    std::array<char, StarsMagic.size()> magic;
+    std::uint16_t version;
+    std::uint32_t nStars;
+    if (!in.read(magic.data(), magic.size()).good() || /* Flawfinder: ignore */
+        std::string_view(magic.data(), magic.size()) != StarsMagic ||
+        !readLE(in, version) || version != StarsVersion ||
+        !readLE(in, nStars))
+    {
+        std::cerr << "Input is not a star database\n";
+        return false;
+    }
+
+    records.resize(static_cast<std::size_t>(nStars) * StarTileDatabase::StarRecordSize);
+    if (!in.read(records.data(), static_cast<std::streamsize>(records.size())).good()) /* Flawfinder: ignore */
+    {
+        std::cerr << "Star database is truncated\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+AppendVarint(std::string& buffer, std::uint64_t value)
+{
+    while (value >= 0x80U)
+    {
+        buffer.push_back(static_cast<char>((value & 0x7fU) | 0x80U));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+
+void
+AppendInt24LE(std::string& buffer, std::int32_t value)
+{
+    auto bits = static_cast<std::uint32_t>(value);
+    buffer.push_back(static_cast<char>(bits & 0xffU));
+    buffer.push_back(static_cast<char>((bits >> 8) & 0xffU));
+    buffer.push_back(static_cast<char>((bits >> 16) & 0xffU));
+}
+
+
+void
+AppendFloatLE(std::string& buffer, float value)
+{
+    LE_TO_CPU_FLOAT(value, value);
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    buffer.append(bytes, sizeof(bytes));
+}
+
+
+// Encode the stars of the nodes of a tile as described for StarTileDatabase
+std::string
+EncodeStars(const std::vector<StarOctree::Node>& nodes,
+            float tileScale,
+            const std::vector<char>& records,
+            const StarEntry* entries,
+            const Star* sortedStars)
+{
+    std::vector<float> scales(nodes.size(), 0.0f);
+    scales.front() = tileScale;
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes[i].firstChild != StarOctree::NoChildren)
+            std::fill_n(scales.begin() + nodes[i].firstChild, 8, scales[i] * 0.5f);
+    }
+
+    std::string buffer;
+    std::uint32_t lastCatalogNumber = 0;
+    std::uint16_t lastSpectralType = 0;
+    bool first = true;
+    std::vector<std::uint32_t> order;
+    for (std::size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+    {
+        const StarOctree::Node& node = nodes[nodeIndex];
+        auto record = [&](std::uint32_t star)
+        {
+            return records.data() + static_cast<std::size_t>(entries[sortedStars[star].getIndex()].record) * StarTileDatabase::StarRecordSize;
+        };
+
+        // Sorting the stars of a node keeps the catalog number differences
+        // small
+        order.resize(node.nObjects);
+        for (std::uint32_t i = 0; i < node.nObjects; ++i)
+            order[i] = node.firstObject + i;
+        std::sort(order.begin(), order.end(),
+                  [&](std::uint32_t a, std::uint32_t b) { return RecordCatalogNumber(record(a)) < RecordCatalogNumber(record(b)); });
+
+        bool quantized = StarTileDatabase::isQuantized(node.cellCenterPos, scales[nodeIndex]);
+        float step = scales[nodeIndex] / static_cast<float>(StarTileDatabase::QuantizationScale);
+        for (std::uint32_t star : order)
+        {
+            const char* starRecord = record(star);
+            std::uint32_t catalogNumber = RecordCatalogNumber(starRecord);
+            std::uint16_t spectralType = RecordSpectralType(starRecord);
+            std::int64_t delta = static_cast<std::int64_t>(catalogNumber) - static_cast<std::int64_t>(lastCatalogNumber);
+            auto zigzag = (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63);
+            bool newSpectralType = first || spectralType != lastSpectralType;
+            AppendVarint(buffer, (zigzag << 1) | (newSpectralType ? 1U : 0U));
+            if (newSpectralType)
+            {
+                buffer.push_back(static_cast<char>(spectralType & 0xffU));
+                buffer.push_back(static_cast<char>(spectralType >> 8));
+            }
+
+            Eigen::Vector3f position = sortedStars[star].getPosition();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (quantized)
+                {
+                    double offset = std::round(static_cast<double>(position[axis] - node.cellCenterPos[axis]) / step);
+                    offset = std::clamp(offset,
+                                        -static_cast<double>(StarTileDatabase::QuantizationScale),
+                                        static_cast<double>(StarTileDatabase::QuantizationScale));
+                    AppendInt24LE(buffer, static_cast<std::int32_t>(offset));
+                }
+                else
+                {
+                    AppendFloatLE(buffer, position[axis]);
+                }
+            }
+
+            // The absolute magnitude is copied as stored
+            buffer.append(starRecord + 16, 2);
+
+            lastCatalogNumber = catalogNumber;
+            lastSpectralType = spectralType;
+            first = false;
+        }
+    }
+
+    return buffer;
+}
+
+
+// Sort the stars of one tile into an octree of its own and write its nodes
+// and stars
+bool
+WriteTile(std::ostream& out,
+          const std::vector<char>& records,
+          const StarEntry* entries,
+          std::uint32_t nStars,
+          float exclusionFactor,
+          DirectoryEntry& tile)
+{
+    tile.nStars = nStars;
+    if (nStars == 0)
+        return true;
+
+    std::vector<Star> stars(nStars);
+    DynamicStarOctree::ObjectList starList;
+    starList.reserve(nStars);
+    std::uint16_t lastSpectralType = 0;
+    IntrusivePtr<StarDetails> lastDetails = nullptr;
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const char* record = records.data() + static_cast<std::size_t>(entries[i].record) * StarTileDatabase::StarRecordSize;
+        std::uint16_t spectralType = RecordSpectralType(record);
+        if (lastDetails == nullptr || spectralType != lastSpectralType)
+        {
+            StellarClass sc;
+            lastDetails = sc.unpackV1(spectralType) ? StarDetails::GetStarDetails(sc) : nullptr;
+            if (lastDetails == nullptr)
+            {
+                std::cerr << "Bad spectral type in star database record " << entries[i].record << '\n';
+                return false;
+            }
+            lastSpectralType = spectralType;
+        }
+
+        Star& star = stars[i];
+        star.setIndex(i);
+        star.setPosition(RecordFloat(record, 4), RecordFloat(record, 8), RecordFloat(record, 12));
+        star.setAbsoluteMagnitude(RecordAbsMag(record));
+        star.setDetails(IntrusivePtr<StarDetails>(lastDetails));
+        starList.push_back(&star);
+    }
+
+    auto root = std::make_unique<DynamicStarOctree>(tile.center, exclusionFactor);
+    root->insertObjects(std::move(starList), tile.scale);
+
+    auto sortedStars = std::make_unique<Star[]>(nStars);
+    Star* firstStar = sortedStars.get();
+    StarOctree* octree = nullptr;
+    root->rebuildAndSort(octree, firstStar);
+    std::unique_ptr<StarOctree> octreeOwner(octree);
+
+    const std::vector<StarOctree::Node>& nodes = octree->getNodes();
+    tile.nNodes = static_cast<std::uint32_t>(nodes.size());
+    bool ok = true;
+    for (auto it = nodes.cbegin(); ok && it != nodes.cend(); ++it)
+    {
+        ok = writeLE(out, it->cellCenterPos.x()) &&
+             writeLE(out, it->cellCenterPos.y()) &&
+             writeLE(out, it->cellCenterPos.z()) &&
+             writeLE(out, it->exclusionFactor) &&
+             writeLE(out, it->nObjects) &&
+             writeLE(out, it->firstChild);
+    }
+
+    std::string starData = EncodeStars(nodes, tile.scale, records, entries, sortedStars.get());
+    tile.size = static_cast<std::uint32_t>(nodes.size() * StarTileDatabase::NodeRecordSize + starData.size());
+    return ok && out.write(starData.data(), static_cast<std::streamsize>(starData.size())).good();
+}
+
+
+bool
+WriteTiles(const std::vector<char>& records, std::ostream& out, const Options& options)
+{
+    const std::vector<float> exclusionFactors = ExclusionFactors(options.maxLevel);
+    auto nStars = static_cast<std::uint32_t>(records.size() / StarTileDatabase::StarRecordSize);
+
+    auto parentDepth = [&options](std::uint32_t depth)
+    {
+        return depth == options.coreLevels ? 0U : depth - options.tileLevels;
+    };
+
+    // Stars stay in the octree level where they are bright enough; the
+    // tile covering that level holds them
+    std::vector<StarEntry> entries;
+    entries.reserve(nStars);
+    std::map<CellKey, TileInfo> tiles;
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const char* record = records.data() + static_cast<std::size_t>(i) * StarTileDatabase::StarRecordSize;
+        float absMag = RecordAbsMag(record);
+        auto level = static_cast<unsigned int>(std::lower_bound(exclusionFactors.begin(), exclusionFactors.end(), absMag)
+                                               - exclusionFactors.begin());
+        level = std::min(level, options.maxLevel);
+
+        unsigned int depth = 0;
+        if (level >= options.coreLevels)
+            depth = options.coreLevels + (level - options.coreLevels) / options.tileLevels * options.tileLevels;
+
+        Eigen::Vector3f position(RecordFloat(record, 4), RecordFloat(record, 8), RecordFloat(record, 12));
+        CellKey key = StarCell(position, depth);
+        ++tiles[key].nStars;
+        entries.push_back({ key, i });
+    }
+
+    // Connect every tile to the core through its ancestors
+    tiles[CellKey()];
+    for (auto it = tiles.rbegin(); it != tiles.rend(); ++it)
+    {
+        for (CellKey key = it->first; key.depth > 0;)
+        {
+            key = key.ancestor(parentDepth(key.depth));
+            if (!tiles.try_emplace(key).second)
+                break;
+        }
+    }
+
+    // Sum up the subtrees from the deepest tiles up, then merge subtrees
+    // with too few stars into their parent tile
+    for (auto it = tiles.rbegin(); it != tiles.rend(); ++it)
+    {
+        it->second.subtreeStars += it->second.nStars;
+        if (it->first.depth > 0)
+            tiles[it->first.ancestor(parentDepth(it->first.depth))].subtreeStars += it->second.subtreeStars;
+    }
+
+    std::vector<CellKey> keptTiles;
+    for (auto& [key, info] : tiles)
+    {
+        info.keep = key.depth == 0 ||
+                    (tiles[key.ancestor(parentDepth(key.depth))].keep && info.subtreeStars >= options.minTileStars);
+        if (info.keep)
+        {
+            info.index = static_cast<std::uint32_t>(keptTiles.size());
+            keptTiles.push_back(key);
+        }
+    }
+
+    for (StarEntry& entry : entries)
+    {
+        while (!tiles[entry.tile].keep)
+            entry.tile = entry.tile.ancestor(parentDepth(entry.tile.depth));
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const StarEntry& a, const StarEntry& b)
+              {
+                  return a.tile < b.tile || (a.tile == b.tile && a.record < b.record);
+              });
+
+    std::vector<DirectoryEntry> directory(keptTiles.size());
+    for (std::size_t i = 0; i < keptTiles.size(); ++i)
+    {
+        const CellKey& key = keptTiles[i];
+        DirectoryEntry& tile = directory[i];
+        CellBounds(key, tile.center, tile.scale);
+        if (key.depth == 0)
+        {
+            tile.parentExclusion = std::numeric_limits<float>::lowest();
+            continue;
+        }
+
+        // Stars below the parent cell are fainter than its exclusion factor
+        tile.parentExclusion = exclusionFactors[key.depth - 1];
+        DirectoryEntry& parent = directory[tiles[key.ancestor(parentDepth(key.depth))].index];
+        if (parent.nChildren == 0)
+            parent.firstChild = static_cast<std::uint32_t>(i);
+        ++parent.nChildren;
+    }
+
+    // The directory is written after the tile data, when the offsets are
+    // known
+    std::uint64_t offset = StarTileDatabase::HeaderSize + directory.size() * StarTileDatabase::TileEntrySize;
+    out.seekp(static_cast<std::streamoff>(offset));
+
+    auto entry = entries.cbegin();
+    for (std::size_t i = 0; i < keptTiles.size(); ++i)
+    {
+        auto tileEnd = std::find_if(entry, entries.cend(),
+                                    [&key = keptTiles[i]](const StarEntry& e) { return !(e.tile == key); });
+        DirectoryEntry& tile = directory[i];
+        tile.offset = offset;
+        if (!WriteTile(out, records, &*entry, static_cast<std::uint32_t>(tileEnd - entry),
+                       exclusionFactors[std::min(keptTiles[i].depth, options.maxLevel)], tile))
+        {
+            std::cerr << "Error writing star tiles\n";
+            return false;
+        }
+
+        offset += tile.size;
+        entry = tileEnd;
+    }
+
+    out.seekp(0);
+    bool ok = out.write(StarTileDatabase::Magic.data(), StarTileDatabase::Magic.size()).good() &&
+              writeLE(out, StarTileDatabase::Version) &&
+              writeLE(out, static_cast<std::uint16_t>(options.tileLevels)) &&
+              writeLE(out, static_cast<std::uint32_t>(directory.size())) &&
+              writeLE(out, RootCenter.x()) && writeLE(out, RootCenter.y()) && writeLE(out, RootCenter.z()) &&
+              writeLE(out, RootSize);
+    for (auto it = directory.cbegin(); ok && it != directory.cend(); ++it)
+    {
+        ok = writeLE(out, it->center.x()) && writeLE(out, it->center.y()) && writeLE(out, it->center.z()) &&
+             writeLE(out, it->scale) &&
+             writeLE(out, it->parentExclusion) &&
+             writeLE(out, it->firstChild) &&
+             writeLE(out, it->nChildren) &&
+             writeLE(out, it->nNodes) &&
+             writeLE(out, it->nStars) &&
+             writeLE(out, it->offset) &&
+             writeLE(out, it->size);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Error writing star tiles\n";
+        return false;
+    }
+
+    std::uint64_t dataSize = 0;
+    for (const DirectoryEntry& tile : directory)
+        dataSize += tile.size;
+
+    std::cerr << nStars << " stars in " << directory.size() << " tiles, "
+              << directory.front().nStars << " in the resident tile, "
+              << dataSize << " bytes of tile data\n";
+    return true;
+}
+
+} // end unnamed namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    std::ifstream inputFile(options.inputFilename, std::ios::in | std::ios::binary);
+    if (!inputFile.good())
+    {
+        std::cerr << "Error opening input file " << options.inputFilename << '\n';
+        return 1;
+    }
+
+    std::vector<char> records;
+    if (!ReadStars(inputFile, records))
+        return 1;
+    inputFile.close();
+
+    std::ofstream outputFile(options.outputFilename, std::ios::out | std::ios::binary);
+    if (!outputFile.good())
+    {
+        std::cerr << "Error opening output file " << options.outputFilename << '\n';
+        return 1;
+    }
+
+    CreateLogger();
+    bool success = WriteTiles(records, outputFile, options);
+    DestroyLogger();
+
+    return success ? 0 : 1;
+}
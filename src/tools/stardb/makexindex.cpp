@@ -14,8 +14,11 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include <celutil/bytes.h>
+#include "textchunks.h"
 
 
 static std::string inputFilename;
@@ -67,52 +70,90 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(std::ostream& out, std::uint32_t n)
+static void appendUint(std::string& out, std::uint32_t n)
 {
     LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+    out.append(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
 
-static void writeShort(std::ostream& out, std::int16_t n)
+static void appendShort(std::string& out, std::int16_t n)
 {
     LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
+    out.append(reinterpret_cast<const char*>(&n), sizeof n);
 }
 
 
-bool WriteCrossIndex(std::istream& in, std::ostream& out)
+// Binary cross index entries converted from a chunk of input lines
+struct IndexRecords
 {
-    // Write the header
-    out.write("CELINDEX", 8);
+    std::string data;
+    unsigned int count{ 0 };
+    bool error{ false };
+};
 
-    // Write the version
-    writeShort(out, 0x0100);
 
-    unsigned int record = 0;
-    while (!in.eof())
+// Convert the pairs of catalog numbers of a chunk, one pair per line; this
+// runs on worker threads
+static IndexRecords ParseIndexRecords(std::string&& chunk)
+{
+    using stardbtools::NextLine;
+    using stardbtools::NextToken;
+    using stardbtools::ParseNumber;
+
+    IndexRecords records;
+    records.data.reserve(chunk.size() / 2);
+
+    std::string_view text = chunk;
+    while (!text.empty())
     {
+        std::string_view line = NextLine(text);
+        std::string_view token = NextToken(line);
+        if (token.empty())
+            continue;
+
         std::uint32_t catalogNumber;
         std::uint32_t celCatalogNumber;
-
-        in >> catalogNumber;
-        if (in.eof())
-            return true;
-
-        in >> celCatalogNumber;
-        if (!in.good())
+        if (!ParseNumber(token, catalogNumber) ||
+            !ParseNumber(NextToken(line), celCatalogNumber))
         {
-            std::cerr << "Error parsing record #" << record << '\n';
-            return false;
+            records.error = true;
+            return records;
         }
 
-        writeUint(out, catalogNumber);
-        writeUint(out, celCatalogNumber);
-
-        record++;
+        appendUint(records.data, catalogNumber);
+        appendUint(records.data, celCatalogNumber);
+        records.count++;
     }
 
-    return true;
+    return records;
+}
+
+
+bool WriteCrossIndex(std::istream& in, std::ostream& out)
+{
+    // Write the header
+    std::string header("CELINDEX", 8);
+
+    // Write the version
+    appendShort(header, 0x0100);
+    out.write(header.data(), header.size());
+
+    // The records are parsed on worker threads and written in input order
+    unsigned int record = 0;
+    return stardbtools::ParseTextChunks(in, ParseIndexRecords,
+        [&](IndexRecords&& records)
+        {
+            out.write(records.data.data(), records.data.size());
+            record += records.count;
+            if (records.error)
+            {
+                std::cerr << "Error parsing record #" << record << '\n';
+                return false;
+            }
+
+            return out.good();
+        });
 }
 
 
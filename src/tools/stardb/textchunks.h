@@ -0,0 +1,148 @@
+// textchunks.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Parse large text catalogs in chunks of lines on worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <celcompat/charconv.h>
+
+namespace stardbtools
+{
+
+// Size of the blocks read from the input; chunks are cut at the last line
+// break in each block
+constexpr std::size_t TextChunkSize = 4 << 20;
+
+/*! Reads in in chunks of whole lines, calls parse(chunk) for each of them
+ *  on worker threads and consume(result) on this thread with the results
+ *  in input order. At most twice the number of hardware threads chunks
+ *  are held in memory, so inputs of any size can be converted. Parsing
+ *  stops when consume returns false; the function returns false then or
+ *  if reading failed.
+ */
+template<typename Parse, typename Consume>
+bool
+ParseTextChunks(std::istream& in, Parse parse, Consume consume)
+{
+    using Result = std::invoke_result_t<Parse, std::string&&>;
+
+    const std::size_t maxInFlight = static_cast<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u)) * 2;
+    std::deque<std::future<Result>> pending;
+    bool ok = true;
+
+    auto takeOne = [&]
+    {
+        Result result = pending.front().get();
+        pending.pop_front();
+        if (ok)
+            ok = consume(std::move(result));
+    };
+
+    std::string carry;
+    while (ok && in.good())
+    {
+        std::string chunk = std::move(carry);
+        std::size_t start = chunk.size();
+        chunk.resize(start + TextChunkSize);
+        in.read(chunk.data() + start, TextChunkSize); /* Flawfinder: ignore */
+        chunk.resize(start + static_cast<std::size_t>(in.gcount()));
+
+        // Keep the partial last line for the next chunk, unless this is
+        // the end of the input
+        carry.clear();
+        if (in.good())
+        {
+            std::size_t lastBreak = chunk.rfind('\n');
+            if (lastBreak == std::string::npos)
+            {
+                carry = std::move(chunk);
+                continue;
+            }
+
+            carry.assign(chunk, lastBreak + 1);
+            chunk.resize(lastBreak + 1);
+        }
+
+        if (chunk.empty())
+            continue;
+
+        if (pending.size() == maxInFlight)
+            takeOne();
+        pending.push_back(std::async(std::launch::async, parse, std::move(chunk)));
+    }
+
+    if (in.bad())
+        ok = false;
+
+    while (!pending.empty())
+        takeOne();
+
+    return ok;
+}
+
+
+// Split the next whitespace-separated token off the front of line
+inline std::string_view
+NextToken(std::string_view& line)
+{
+    constexpr std::string_view whitespace = " \t\r\v\f";
+
+    std::size_t start = line.find_first_not_of(whitespace);
+    if (start == std::string_view::npos)
+    {
+        line = {};
+        return {};
+    }
+
+    std::size_t end = std::min(line.find_first_of(whitespace, start), line.size());
+    std::string_view token = line.substr(start, end - start);
+    line.remove_prefix(end);
+    return token;
+}
+
+
+// Split the next line off the front of text
+inline std::string_view
+NextLine(std::string_view& text)
+{
+    std::size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+
+// Parse a whole token as a number, accepting a leading + like operator>>
+template<typename T>
+bool
+ParseNumber(std::string_view token, T& value)
+{
+    if (!token.empty() && token.front() == '+')
+        token.remove_prefix(1);
+
+    const char* end = token.data() + token.size();
+    auto [ptr, ec] = celestia::compat::from_chars(token.data(), end, value);
+    return ec == std::errc{} && ptr == end;
+}
+
+} // end namespace stardbtools
@@ -0,0 +1,421 @@
+// makevirtualtex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Cut a large image into the tile pyramid of a Celestia virtual texture
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <setjmp.h>
+#include <png.h>
+extern "C"
+{
+#include <jpeglib.h>
+}
+
+#include <fmt/format.h>
+
+#include <celcompat/filesystem.h>
+#include <celutil/filetype.h>
+#include <celutil/logger.h>
+#include "tilepyramid.h"
+
+using celestia::util::CreateLogger;
+using celestia::util::DestroyLogger;
+using vtextools::CheckTileOptions;
+using vtextools::CountLevels;
+using vtextools::ParseTileOption;
+using vtextools::RowResampler;
+using vtextools::TileOptions;
+using vtextools::TileOptionsUsage;
+using vtextools::TilePyramid;
+using vtextools::WriteDescriptor;
+
+namespace
+{
+
+struct Options
+{
+    std::string inputFilename;
+    TileOptions tiles;
+};
+
+
+// A source image which is decoded one row at a time, so that it never has
+// to be held in memory. Rows have 3 or 4 eight bit components.
+class SourceImage
+{
+public:
+    virtual ~SourceImage() = default;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getComponents() const { return components; }
+
+    virtual bool readRow(std::uint8_t* row) = 0;
+
+    static std::unique_ptr<SourceImage> open(const fs::path& filename);
+
+protected:
+    int width{ 0 };
+    int height{ 0 };
+    int components{ 0 };
+};
+
+
+class PNGSource : public SourceImage
+{
+public:
+    ~PNGSource() override;
+
+    bool readRow(std::uint8_t* row) override;
+
+    static std::unique_ptr<SourceImage> open(const fs::path& filename);
+
+private:
+    static void readData(png_structp png, png_bytep data, png_size_t length);
+    bool readHeader();
+
+    std::FILE* fp{ nullptr };
+    png_structp png{ nullptr };
+    png_infop info{ nullptr };
+};
+
+
+PNGSource::~PNGSource()
+{
+    if (png != nullptr)
+        png_destroy_read_struct(&png, info == nullptr ? nullptr : &info, nullptr);
+    if (fp != nullptr)
+        std::fclose(fp);
+}
+
+
+void
+PNGSource::readData(png_structp png, png_bytep data, png_size_t length)
+{
+    auto* fp = static_cast<std::FILE*>(png_get_io_ptr(png));
+    if (std::fread(data, 1, length, fp) != length)
+        png_error(png, "Error reading PNG data");
+}
+
+
+std::unique_ptr<SourceImage>
+PNGSource::open(const fs::path& filename)
+{
+    auto source = std::make_unique<PNGSource>();
+#ifdef _WIN32
+    source->fp = _wfopen(filename.c_str(), L"rb");
+#else
+    source->fp = std::fopen(filename.c_str(), "rb");
+#endif
+    if (source->fp == nullptr)
+        return nullptr;
+
+    png_byte header[8];
+    if (std::fread(header, 1, sizeof(header), source->fp) != sizeof(header) ||
+        png_sig_cmp(header, 0, sizeof(header)) != 0)
+    {
+        std::cerr << "Error: " << filename << " is not a PNG file\n";
+        return nullptr;
+    }
+
+    source->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (source->png == nullptr)
+        return nullptr;
+    source->info = png_create_info_struct(source->png);
+    if (source->info == nullptr || !source->readHeader())
+        return nullptr;
+
+    return source;
+}
+
+
+bool
+PNGSource::readHeader()
+{
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_set_read_fn(png, fp, readData);
+    png_set_sig_bytes(png, 8);
+    png_read_info(png, info);
+
+    png_uint_32 w;
+    png_uint_32 h;
+    int bitDepth;
+    int colorType;
+    int interlaceType;
+    png_get_IHDR(png, info, &w, &h, &bitDepth, &colorType, &interlaceType, nullptr, nullptr);
+
+    // All passes of an interlaced image would have to be kept in memory
+    if (interlaceType != PNG_INTERLACE_NONE)
+    {
+        std::cerr << "Interlaced PNG images can't be read row by row\n";
+        return false;
+    }
+
+    if (colorType == PNG_COLOR_TYPE_PALETTE)
+        png_set_palette_to_rgb(png);
+    if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+        png_set_gray_to_rgb(png);
+    if (png_get_valid(png, info, PNG_INFO_tRNS))
+        png_set_tRNS_to_alpha(png);
+    if (bitDepth == 16)
+        png_set_strip_16(png);
+    else if (bitDepth < 8)
+        png_set_packing(png);
+
+    png_read_update_info(png, info);
+
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    components = png_get_channels(png, info);
+    return components == 3 || components == 4;
+}
+
+
+bool
+PNGSource::readRow(std::uint8_t* row)
+{
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_read_row(png, row, nullptr);
+    return true;
+}
+
+
+class JPEGSource : public SourceImage
+{
+public:
+    ~JPEGSource() override;
+
+    bool readRow(std::uint8_t* row) override;
+
+    static std::unique_ptr<SourceImage> open(const fs::path& filename);
+
+private:
+    struct ErrorManager
+    {
+        jpeg_error_mgr pub;
+        jmp_buf        setjmpBuffer;
+    };
+
+    static void errorExit(j_common_ptr cinfo);
+
+    bool readHeader();
+
+    std::FILE* fp{ nullptr };
+    jpeg_decompress_struct cinfo{};
+    ErrorManager errorManager{};
+    bool created{ false };
+};
+
+
+JPEGSource::~JPEGSource()
+{
+    if (created)
+        jpeg_destroy_decompress(&cinfo);
+    if (fp != nullptr)
+        std::fclose(fp);
+}
+
+
+void
+JPEGSource::errorExit(j_common_ptr cinfo)
+{
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->setjmpBuffer, 1);
+}
+
+
+std::unique_ptr<SourceImage>
+JPEGSource::open(const fs::path& filename)
+{
+    auto source = std::make_unique<JPEGSource>();
+#ifdef _WIN32
+    source->fp = _wfopen(filename.c_str(), L"rb");
+#else
+    source->fp = std::fopen(filename.c_str(), "rb");
+#endif
+    if (source->fp == nullptr || !source->readHeader())
+        return nullptr;
+
+    return source;
+}
+
+
+bool
+JPEGSource::readHeader()
+{
+    cinfo.err = jpeg_std_error(&errorManager.pub);
+    errorManager.pub.error_exit = errorExit;
+    if (setjmp(errorManager.setjmpBuffer))
+        return false;
+
+    jpeg_create_decompress(&cinfo);
+    created = true;
+    jpeg_stdio_src(&cinfo, fp);
+    (void) jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    (void) jpeg_start_decompress(&cinfo);
+
+    width = static_cast<int>(cinfo.output_width);
+    height = static_cast<int>(cinfo.output_height);
+    components = cinfo.output_components;
+    return components == 3;
+}
+
+
+bool
+JPEGSource::readRow(std::uint8_t* row)
+{
+    if (setjmp(errorManager.setjmpBuffer))
+        return false;
+
+    JSAMPROW rows[1] = { row };
+    return jpeg_read_scanlines(&cinfo, rows, 1) == 1;
+}
+
+
+std::unique_ptr<SourceImage>
+SourceImage::open(const fs::path& filename)
+{
+    switch (DetermineFileType(filename))
+    {
+    case ContentType::PNG:
+        return PNGSource::open(filename);
+    case ContentType::JPEG:
+        return JPEGSource::open(filename);
+    default:
+        std::cerr << "Only PNG and JPEG source images are supported\n";
+        return nullptr;
+    }
+}
+
+
+bool
+BuildVirtualTexture(const Options& options)
+{
+    std::unique_ptr<SourceImage> source = SourceImage::open(options.inputFilename);
+    if (source == nullptr)
+    {
+        std::cerr << "Error reading source image " << options.inputFilename << '\n';
+        return false;
+    }
+
+    const TileOptions& tiles = options.tiles;
+    unsigned int nLevels = CountLevels(tiles, source->getWidth());
+    if (nLevels == 0)
+        return false;
+
+    TilePyramid pyramid(tiles, source->getComponents(), nLevels);
+    auto width = static_cast<int>(pyramid.getWidth());
+    auto height = static_cast<int>(pyramid.getHeight());
+    std::cout << fmt::format("Building {:d} levels from {:d} x {:d} to {:d} x {:d} pixels\n",
+                             nLevels,
+                             tiles.tileSize << (tiles.baseSplit + 1), tiles.tileSize << tiles.baseSplit,
+                             width, height);
+
+    RowResampler resampler(source->getWidth(), source->getHeight(), width, height, source->getComponents(),
+                           [&pyramid](const std::uint8_t* row) { return pyramid.addRow(row); });
+
+    std::vector<std::uint8_t> row(static_cast<std::size_t>(source->getWidth()) * source->getComponents());
+    bool ok = true;
+    for (int y = 0; ok && y < source->getHeight(); y++)
+    {
+        if (!source->readRow(row.data()))
+        {
+            std::cerr << "Error reading row " << y << " of the source image\n";
+            ok = false;
+        }
+        else
+        {
+            ok = resampler.addRow(row.data());
+        }
+    }
+
+    ok = pyramid.finish() && ok;
+    return ok && WriteDescriptor(tiles, nLevels,
+                                 fmt::format("Virtual texture made by makevirtualtex from {}",
+                                             fs::path(options.inputFilename).filename().string()));
+}
+
+
+void
+Usage()
+{
+    std::cerr << "Usage: makevirtualtex [options] <source image> <output directory>\n";
+    std::cerr << "  Options:\n";
+    TileOptionsUsage();
+}
+
+
+bool
+parseCommandLine(int argc, char* argv[], Options& options)
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        bool error = false;
+        if (ParseTileOption(argc, argv, i, options.tiles, error))
+            continue;
+        if (error)
+            return false;
+
+        if (arg.size() > 1 && arg.front() == '-')
+        {
+            std::cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+        else if (fileCount == 0)
+        {
+            options.inputFilename = arg;
+            ++fileCount;
+        }
+        else if (fileCount == 1)
+        {
+            options.tiles.outputDirectory = arg;
+            ++fileCount;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount == 2 && CheckTileOptions(options.tiles);
+}
+
+} // end unnamed namespace
+
+
+int
+main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    CreateLogger();
+    bool success = BuildVirtualTexture(options);
+    DestroyLogger();
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+// tilepyramid.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "tilepyramid.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include <celimage/dds_compress.h>
+#include <celimage/image.h>
+#include <celimage/imageformats.h>
+
+using celestia::engine::CompressImageDXT;
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+using celestia::engine::SaveDDSImage;
+using celestia::engine::SaveJPEGImage;
+using celestia::engine::SavePNGImage;
+
+namespace vtextools
+{
+
+namespace
+{
+
+// Finest level dimensions must fit into an int
+constexpr unsigned int MaxLevels = 16;
+constexpr std::uint64_t MaxLevelWidth = 1U << 30;
+
+bool
+parseNumberOption(int argc, char* argv[], int& i, unsigned int& value)
+{
+    if (i + 1 == argc)
+    {
+        std::cerr << "Missing value for " << argv[i] << '\n';
+        return false;
+    }
+
+    char* end;
+    unsigned long number = std::strtoul(argv[++i], &end, 10);
+    if (*end != '\0' || number > 0xffff)
+    {
+        std::cerr << "Bad value for " << argv[i - 1] << ": " << argv[i] << '\n';
+        return false;
+    }
+
+    value = static_cast<unsigned int>(number);
+    return true;
+}
+
+} // end unnamed namespace
+
+
+bool
+ParseTileOption(int argc, char* argv[], int& i, TileOptions& options, bool& error)
+{
+    std::string_view arg = argv[i];
+    if (arg == "--tile-type" || arg == "--tile-prefix")
+    {
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for " << arg << '\n';
+            error = true;
+            return false;
+        }
+        (arg == "--tile-type" ? options.tileType : options.tilePrefix) = argv[++i];
+        return true;
+    }
+
+    unsigned int* value;
+    if (arg == "--tile-size")
+        value = &options.tileSize;
+    else if (arg == "--base-split")
+        value = &options.baseSplit;
+    else if (arg == "--levels")
+        value = &options.levels;
+    else if (arg == "--threads")
+        value = &options.threads;
+    else
+        return false;
+
+    error = !parseNumberOption(argc, argv, i, *value);
+    return !error;
+}
+
+
+bool
+CheckTileOptions(const TileOptions& options)
+{
+    if (options.tileSize < 64 || (options.tileSize & (options.tileSize - 1)) != 0)
+    {
+        std::cerr << "The tile size must be a power of two >= 64\n";
+        return false;
+    }
+
+    if (options.baseSplit + options.levels > MaxLevels)
+    {
+        std::cerr << "The base split and number of levels are too large\n";
+        return false;
+    }
+
+    if (options.tileType != "dds" && options.tileType != "png" && options.tileType != "jpg")
+    {
+        std::cerr << "The tile type must be dds, png or jpg\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+TileOptionsUsage()
+{
+    std::cerr << "    --tile-size <n> : width and height of the tiles, a power of two >= 64 (default 512)\n";
+    std::cerr << "    --base-split <n> : log2 of the number of tile rows in level 0 (default 0)\n";
+    std::cerr << "    --levels <n> : number of levels (default: up to the source resolution)\n";
+    std::cerr << "    --tile-type <dds|png|jpg> : tile file format (default dds)\n";
+    std::cerr << "    --tile-prefix <prefix> : tile file name prefix (default tx_)\n";
+    std::cerr << "    --threads <n> : number of threads (default: all cores)\n";
+}
+
+
+unsigned int
+CountLevels(const TileOptions& options, int sourceWidth)
+{
+    // By default the finest level has at most the resolution of the source
+    unsigned int nLevels = 1;
+    if (options.levels > 0)
+    {
+        nLevels = options.levels;
+    }
+    else
+    {
+        while (nLevels + options.baseSplit < MaxLevels &&
+               (static_cast<std::uint64_t>(options.tileSize) << (nLevels + options.baseSplit + 1))
+                   <= static_cast<std::uint64_t>(sourceWidth))
+        {
+            nLevels++;
+        }
+    }
+
+    if ((static_cast<std::uint64_t>(options.tileSize) << (nLevels + options.baseSplit)) > MaxLevelWidth)
+    {
+        std::cerr << "The finest level would be too large\n";
+        return 0;
+    }
+
+    return nLevels;
+}
+
+
+std::vector<Span>
+computeSpans(int sourceSize, int targetSize)
+{
+    double scale = static_cast<double>(sourceSize) / static_cast<double>(targetSize);
+    std::vector<Span> spans(targetSize);
+    for (int i = 0; i < targetSize; i++)
+    {
+        double start = i * scale;
+        double end = std::min((i + 1) * scale, static_cast<double>(sourceSize));
+        Span& span = spans[i];
+        span.first = std::min(static_cast<int>(start), sourceSize - 1);
+        for (int j = span.first; j < end; j++)
+        {
+            double coverage = std::min(end, j + 1.0) - std::max(start, static_cast<double>(j));
+            span.weights.push_back(static_cast<float>(coverage / (end - start)));
+        }
+    }
+
+    return spans;
+}
+
+
+
+TilePyramid::TilePyramid(const TileOptions& options, int components, unsigned int nLevels) :
+    options(options),
+    components(components),
+    tileType(DetermineFileType(fmt::format("tile.{}", options.tileType))),
+    levels(nLevels)
+{
+    for (unsigned int i = 0; i < nLevels; i++)
+    {
+        Level& level = levels[i];
+        level.width = options.tileSize << (i + options.baseSplit + 1);
+        level.strip.resize(static_cast<std::size_t>(level.width) * options.tileSize * components);
+        if (i > 0)
+            level.pairRow.resize(static_cast<std::size_t>(level.width) * components);
+    }
+
+    maxPending = options.threads == 0
+        ? static_cast<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u))
+        : options.threads;
+}
+
+
+fs::path
+TilePyramid::tilePath(unsigned int level, unsigned int u, unsigned int v) const
+{
+    return fs::path(options.outputDirectory) /
+           fmt::format("level{:d}", level) /
+           fmt::format("{:s}{:d}_{:d}.{:s}", options.tilePrefix, u, v, options.tileType);
+}
+
+
+bool
+TilePyramid::addRow(std::size_t index, const std::uint8_t* row)
+{
+    Level& level = levels[index];
+    std::size_t rowBytes = static_cast<std::size_t>(level.width) * components;
+    std::memcpy(level.strip.data() + level.rows * rowBytes, row, rowBytes);
+    if (++level.rows == options.tileSize && !writeStrip(index))
+        return false;
+
+    if (index == 0)
+        return true;
+
+    if (!level.hasPairRow)
+    {
+        std::memcpy(level.pairRow.data(), row, rowBytes);
+        level.hasPairRow = true;
+        return true;
+    }
+
+    // Box filter the pair of rows into one of the coarser level
+    std::vector<std::uint8_t> reduced(rowBytes / 2);
+    const std::uint8_t* row0 = level.pairRow.data();
+    for (unsigned int x = 0; x < level.width / 2; x++)
+    {
+        for (int c = 0; c < components; c++)
+        {
+            std::size_t i = static_cast<std::size_t>(x) * 2 * components + c;
+            unsigned int sum = row0[i] + row0[i + components] + row[i] + row[i + components];
+            reduced[static_cast<std::size_t>(x) * components + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+        }
+    }
+    level.hasPairRow = false;
+
+    return addRow(index - 1, reduced.data());
+}
+
+
+bool
+TilePyramid::writeStrip(std::size_t index)
+{
+    Level& level = levels[index];
+    PixelFormat format = components == 4 ? PixelFormat::RGBA : PixelFormat::RGB;
+    std::size_t rowBytes = static_cast<std::size_t>(level.width) * components;
+    std::size_t tileRowBytes = static_cast<std::size_t>(options.tileSize) * components;
+
+    fs::path directory = tilePath(index, 0, 0).parent_path();
+    std::error_code ec;
+    if (level.v == 0 && !fs::create_directories(directory, ec) && ec)
+    {
+        std::cerr << "Error creating directory " << directory << '\n';
+        return false;
+    }
+
+    for (unsigned int u = 0; u < level.width / options.tileSize; u++)
+    {
+        Image tile(format, options.tileSize, options.tileSize);
+        for (unsigned int y = 0; y < options.tileSize; y++)
+        {
+            std::memcpy(tile.getPixelRow(y),
+                        level.strip.data() + y * rowBytes + u * tileRowBytes,
+                        tileRowBytes);
+        }
+
+        if (pending.size() == maxPending && !takeResult())
+            return false;
+        pending.push_back(std::async(std::launch::async,
+                                     [this, path = tilePath(index, u, level.v)](Image&& image)
+                                     {
+                                         return writeTile(std::move(image), path);
+                                     },
+                                     std::move(tile)));
+    }
+
+    level.rows = 0;
+    level.v++;
+    return true;
+}
+
+
+bool
+TilePyramid::writeTile(Image&& image, const fs::path& path) const
+{
+    switch (tileType)
+    {
+    case ContentType::DDS:
+        if (auto compressed = CompressImageDXT(image); compressed != nullptr)
+            return SaveDDSImage(path, *compressed);
+        return false;
+    case ContentType::PNG:
+        return SavePNGImage(path, image);
+    case ContentType::JPEG:
+        return SaveJPEGImage(path, image);
+    default:
+        return false;
+    }
+}
+
+
+bool
+TilePyramid::takeResult()
+{
+    bool written = pending.front().get();
+    pending.pop_front();
+    if (!written)
+    {
+        std::cerr << "Error writing tile\n";
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+bool
+TilePyramid::finish()
+{
+    while (!pending.empty())
+        takeResult();
+
+    return ok;
+}
+
+
+
+bool
+WriteDescriptor(const TileOptions& options, unsigned int nLevels, std::string_view description)
+{
+    fs::path directory = fs::absolute(options.outputDirectory).lexically_normal();
+    if (directory.filename().empty())
+        directory = directory.parent_path();
+    fs::path ctxPath = directory;
+    ctxPath += ".ctx";
+
+    std::ofstream out(ctxPath, std::ios::out);
+    if (!out.good())
+    {
+        std::cerr << "Error opening " << ctxPath << '\n';
+        return false;
+    }
+
+    out << fmt::format("# {}\n", description);
+    for (unsigned int i = 0; i < nLevels; i++)
+    {
+        unsigned int lod = i + options.baseSplit;
+        out << fmt::format("# level{:d}: {:d} x {:d} tiles, {:d} x {:d} pixels\n",
+                           i, 2u << lod, 1u << lod,
+                           options.tileSize << (lod + 1), options.tileSize << lod);
+    }
+
+    out << "VirtualTexture\n";
+    out << "{\n";
+    out << fmt::format("        ImageDirectory \"{}\"\n", directory.filename().string());
+    out << fmt::format("        BaseSplit {:d}\n", options.baseSplit);
+    out << fmt::format("        TileSize {:d}\n", options.tileSize);
+    out << fmt::format("        TileType \"{}\"\n", options.tileType);
+    if (options.tilePrefix != "tx_")
+        out << fmt::format("        TilePrefix \"{}\"\n", options.tilePrefix);
+    out << "}\n";
+
+    return out.good();
+}
+
+
+} // end namespace vtextools
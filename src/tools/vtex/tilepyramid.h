@@ -0,0 +1,209 @@
+// tilepyramid.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Write images as the tile pyramid of a Celestia virtual texture.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celutil/filetype.h>
+
+namespace celestia::engine
+{
+class Image;
+}
+
+namespace vtextools
+{
+
+struct TileOptions
+{
+    std::string outputDirectory;
+    std::string tileType{ "dds" };
+    std::string tilePrefix{ "tx_" };
+    unsigned int tileSize{ 512 };
+    unsigned int baseSplit{ 0 };
+    // 0 makes as many levels as the source width allows
+    unsigned int levels{ 0 };
+    // 0 uses all cores
+    unsigned int threads{ 0 };
+};
+
+// Parse the tile option at argv[i], if it is one, and advance i past its
+// value. Returns false if argv[i] isn't a tile option or has a bad value;
+// error is set in the latter case.
+bool ParseTileOption(int argc, char* argv[], int& i, TileOptions& options, bool& error);
+bool CheckTileOptions(const TileOptions& options);
+void TileOptionsUsage();
+
+// The number of levels for a source of sourceWidth pixels, or 0 if the
+// finest level would be too large
+unsigned int CountLevels(const TileOptions& options, int sourceWidth);
+
+// The source pixels covered by a target pixel, with their coverage
+struct Span
+{
+    int first;
+    std::vector<float> weights;
+};
+
+
+std::vector<Span> computeSpans(int sourceSize, int targetSize);
+
+
+/*! Resamples the source rows to another size, averaging
+ *  the source pixels covered by each target pixel. Each target row is
+ *  passed to the output as soon as all its source rows have been added.
+ */
+template<typename Output>
+class RowResampler
+{
+public:
+    RowResampler(int sourceWidth, int sourceHeight, int targetWidth, int targetHeight,
+              int components, Output output) :
+        components(components),
+        columns(computeSpans(sourceWidth, targetWidth)),
+        rows(computeSpans(sourceHeight, targetHeight)),
+        rowSums(static_cast<std::size_t>(targetWidth) * components * (targetHeight / sourceHeight + 2)),
+        targetRow(static_cast<std::size_t>(targetWidth) * components),
+        output(std::move(output))
+    {
+    }
+
+    bool addRow(const std::uint8_t* row)
+    {
+        std::vector<float> resampled(targetRow.size());
+        for (std::size_t x = 0; x < columns.size(); x++)
+        {
+            const std::uint8_t* src = row + static_cast<std::size_t>(columns[x].first) * components;
+            for (float weight : columns[x].weights)
+            {
+                for (int c = 0; c < components; c++)
+                    resampled[x * components + c] += weight * static_cast<float>(*src++);
+            }
+        }
+
+        // A source row contributes to every target row whose span
+        // includes it
+        for (std::size_t y = nextRow; y < rows.size() && rows[y].first <= sourceRow; y++)
+        {
+            auto iRow = static_cast<std::size_t>(sourceRow - rows[y].first);
+            if (iRow >= rows[y].weights.size())
+                continue;
+
+            if (iRow == 0)
+                std::fill(sumsFor(y), sumsFor(y) + targetRow.size(), 0.0f);
+
+            float weight = rows[y].weights[iRow];
+            float* sums = sumsFor(y);
+            for (std::size_t i = 0; i < resampled.size(); i++)
+                sums[i] += weight * resampled[i];
+        }
+        sourceRow++;
+
+        while (nextRow < rows.size() &&
+               rows[nextRow].first + static_cast<int>(rows[nextRow].weights.size()) <= sourceRow)
+        {
+            const float* sums = sumsFor(nextRow);
+            for (std::size_t i = 0; i < targetRow.size(); i++)
+                targetRow[i] = static_cast<std::uint8_t>(std::clamp(std::lround(sums[i]), 0L, 255L));
+            nextRow++;
+            if (!output(targetRow.data()))
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    // The target rows which are being summed up at the same time are
+    // consecutive, so they take turns in a few rows of sums
+    float* sumsFor(std::size_t y)
+    {
+        std::size_t slots = rowSums.size() / targetRow.size();
+        return rowSums.data() + (y % slots) * targetRow.size();
+    }
+
+    int components;
+    std::vector<Span> columns;
+    std::vector<Span> rows;
+    std::vector<float> rowSums;
+    std::vector<std::uint8_t> targetRow;
+    int sourceRow{ 0 };
+    std::size_t nextRow{ 0 };
+    Output output;
+};
+
+
+
+/*! Builds the tile levels from the rows of the finest one. Every level
+ *  collects a strip of tileSize rows, which is cut into tiles and written
+ *  on worker threads while the next rows are read; each pair of rows is
+ *  reduced to one row of the next coarser level. Only one strip per level
+ *  is in memory.
+ */
+class TilePyramid
+{
+public:
+    // options must outlive the pyramid
+    TilePyramid(const TileOptions& options, int components, unsigned int nLevels);
+
+    bool addRow(const std::uint8_t* row) { return addRow(levels.size() - 1, row); }
+    bool finish();
+
+    unsigned int getWidth() const { return levels.back().width; }
+    unsigned int getHeight() const { return levels.back().width / 2; }
+
+    fs::path tilePath(unsigned int level, unsigned int u, unsigned int v) const;
+
+private:
+    struct Level
+    {
+        unsigned int width;
+        std::vector<std::uint8_t> strip;
+        unsigned int rows{ 0 };
+        unsigned int v{ 0 };
+        std::vector<std::uint8_t> pairRow;
+        bool hasPairRow{ false };
+    };
+
+    bool addRow(std::size_t level, const std::uint8_t* row);
+    bool writeStrip(std::size_t level);
+    bool writeTile(celestia::engine::Image&& image, const fs::path& path) const;
+    bool takeResult();
+
+    const TileOptions& options;
+    int components;
+    ContentType tileType;
+    std::vector<Level> levels;
+    std::deque<std::future<bool>> pending;
+    std::size_t maxPending;
+    bool ok{ true };
+};
+
+
+
+// Write the descriptor which Celestia loads the virtual texture with next
+// to the tile directory, with description as a comment. The tiles
+// themselves are found by scanning the level directories, the comments
+// only describe the pyramid.
+bool WriteDescriptor(const TileOptions& options, unsigned int nLevels, std::string_view description);
+
+} // end namespace vtextools
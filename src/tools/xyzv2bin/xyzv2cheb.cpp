@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celcompat/bit.h>
+#include <celcompat/numbers.h>
+#include <celephem/xyzvbinary.h>
+#include <celephem/xyzvcheb.h>
+
+namespace
+{
+
+using celestia::ephem::XYZVBinaryData;
+using celestia::ephem::XYZVBinaryHeader;
+using celestia::ephem::XYZVChebyshevHeader;
+using celestia::ephem::XYZV_CHEBYSHEV_MAGIC;
+using celestia::ephem::XYZV_CHEBYSHEV_MAX_COEFFICIENTS;
+using celestia::ephem::XYZV_MAGIC;
+
+constexpr double SecondsPerDay = 86400.0;
+
+struct Sample
+{
+    double tdb;
+    std::array<double, 3> position;
+    // Kilometers per day
+    std::array<double, 3> velocity;
+};
+
+using Coefficients = std::vector<double>;
+
+// Scan past comments. A comment begins with the # character and ends
+// with a newline. Return true if the stream state is good. The stream
+// position will be at the first non-comment, non-whitespace character.
+bool SkipComments(std::istream& in)
+{
+    bool inComment = false;
+    bool done = false;
+
+    int c = in.get();
+    while (!done)
+    {
+        if (in.eof())
+        {
+            done = true;
+        }
+        else
+        {
+            if (inComment)
+            {
+                if (c == '\n')
+                    inComment = false;
+            }
+            else
+            {
+                if (c == '#')
+                {
+                    inComment = true;
+                }
+                else if (std::isspace(static_cast<unsigned char>(c)) == 0)
+                {
+                    in.unget();
+                    done = true;
+                }
+            }
+        }
+
+        if (!done)
+            c = in.get();
+    }
+
+    return in.good();
+}
+
+// Read the samples of a text xyzv file, or of a binary one with the
+// xyzvbin magic. Samples which are not in increasing time order are
+// dropped, as Celestia does when loading them.
+bool ReadSamples(const std::string& filename, std::vector<Sample>& samples)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.good())
+        return false;
+
+    std::array<char, sizeof(XYZVBinaryHeader)> header;
+    bool binary = in.read(header.data(), header.size()) &&
+                  std::string_view(header.data() + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.size()) == XYZV_MAGIC;
+    if (binary)
+    {
+        decltype(XYZVBinaryHeader::byteOrder) byteOrder;
+        std::memcpy(&byteOrder, header.data() + offsetof(XYZVBinaryHeader, byteOrder), sizeof(byteOrder));
+        if (byteOrder != static_cast<decltype(byteOrder)>(celestia::compat::endian::native))
+        {
+            fmt::print(stderr, "Unsupported byte order in {}\n", filename);
+            return false;
+        }
+    }
+    else
+    {
+        in.clear();
+        in.seekg(0);
+        if (!SkipComments(in))
+            return false;
+    }
+
+    double lastTime = -std::numeric_limits<double>::infinity();
+    for (std::size_t line = 1;; ++line)
+    {
+        std::array<double, 7> values;
+        if (binary)
+        {
+            static_assert(sizeof(XYZVBinaryData) == sizeof(values));
+            if (!in.read(reinterpret_cast<char*>(values.data()), sizeof(values)))
+                break;
+        }
+        else
+        {
+            for (double& value : values)
+                in >> value;
+            if (!in.good())
+            {
+                if (!in.eof())
+                    fmt::print(stderr, "Error reading input file, line {}\n", line);
+                break;
+            }
+        }
+
+        if (values[0] <= lastTime)
+        {
+            fmt::print(stderr, "Skipping out of order sample at {}\n", values[0]);
+            continue;
+        }
+
+        lastTime = values[0];
+        samples.push_back(Sample{ values[0],
+                                  { values[1], values[2], values[3] },
+                                  { values[4] * SecondsPerDay, values[5] * SecondsPerDay, values[6] * SecondsPerDay } });
+    }
+
+    return samples.size() >= 2;
+}
+
+// Cubic Hermite interpolation between the samples, as Celestia uses for
+// xyzv trajectories.
+double Interpolate(const Sample& s0, const Sample& s1, int axis, double tdb)
+{
+    double h = s1.tdb - s0.tdb;
+    double t = (tdb - s0.tdb) / h;
+    double p0 = s0.position[axis];
+    double p1 = s1.position[axis];
+    double v0 = s0.velocity[axis] * h;
+    double v1 = s1.velocity[axis] * h;
+    double a = 2.0 * (p0 - p1) + v1 + v0;
+    double b = 3.0 * (p1 - p0) - 2.0 * v0 - v1;
+    return p0 + t * (v0 + t * (b + t * a));
+}
+
+double Evaluate(const double* coeffs, std::size_t nCoeffs, double u)
+{
+    double sum = coeffs[0] + coeffs[1] * u;
+    double tPrev = 1.0;
+    double t = u;
+    for (std::size_t j = 2; j < nCoeffs; ++j)
+    {
+        double tNext = 2.0 * u * t - tPrev;
+        tPrev = t;
+        t = tNext;
+        sum += coeffs[j] * t;
+    }
+
+    return sum;
+}
+
+// Values of the Chebyshev polynomials at the Chebyshev nodes, with the
+// polynomials of each node stored consecutively.
+std::vector<double> NodeValues(std::size_t nCoeffs)
+{
+    using celestia::numbers::pi;
+
+    std::vector<double> values(nCoeffs * nCoeffs);
+    for (std::size_t k = 0; k < nCoeffs; ++k)
+    {
+        double theta = pi * (static_cast<double>(k) + 0.5) / static_cast<double>(nCoeffs);
+        for (std::size_t j = 0; j < nCoeffs; ++j)
+            values[k * nCoeffs + j] = std::cos(static_cast<double>(j) * theta);
+    }
+
+    return values;
+}
+
+// Fit the interpolated trajectory between samples first and last by
+// Chebyshev interpolation at the Chebyshev nodes. Returns false if the fit
+// deviates by more than tolerance at the samples or halfway between them.
+bool FitSegment(const std::vector<Sample>& samples,
+                std::size_t first,
+                std::size_t last,
+                std::size_t nCoeffs,
+                const std::vector<double>& nodeValues,
+                double tolerance,
+                Coefficients& coeffs)
+{
+    double t0 = samples[first].tdb;
+    double t1 = samples[last].tdb;
+    auto begin = samples.begin() + static_cast<std::ptrdiff_t>(first);
+    auto end = samples.begin() + static_cast<std::ptrdiff_t>(last) + 1;
+
+    coeffs.assign(3 * nCoeffs, 0.0);
+    for (std::size_t k = 0; k < nCoeffs; ++k)
+    {
+        // T1 is the node itself
+        double x = nodeValues[k * nCoeffs + 1];
+        double tdb = t0 + (x + 1.0) * 0.5 * (t1 - t0);
+        auto it = std::upper_bound(begin + 1, end - 1, tdb,
+                                   [](double t, const Sample& s) { return t < s.tdb; });
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double f = Interpolate(*(it - 1), *it, axis, tdb);
+            for (std::size_t j = 0; j < nCoeffs; ++j)
+                coeffs[axis * nCoeffs + j] += f * nodeValues[k * nCoeffs + j];
+        }
+    }
+
+    for (std::size_t j = 0; j < 3 * nCoeffs; ++j)
+        coeffs[j] *= (j % nCoeffs == 0 ? 1.0 : 2.0) / static_cast<double>(nCoeffs);
+
+    auto error = [&](double tdb, const Sample& s0, const Sample& s1)
+    {
+        double u = 2.0 * (tdb - t0) / (t1 - t0) - 1.0;
+        double sum = 0.0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double d = Evaluate(coeffs.data() + axis * nCoeffs, nCoeffs, u) - Interpolate(s0, s1, axis, tdb);
+            sum += d * d;
+        }
+        return std::sqrt(sum);
+    };
+
+    for (std::size_t i = first; i < last; ++i)
+    {
+        const Sample& s0 = samples[i];
+        const Sample& s1 = samples[i + 1];
+        if (error(s0.tdb, s0, s1) > tolerance || error(0.5 * (s0.tdb + s1.tdb), s0, s1) > tolerance)
+            return false;
+    }
+
+    return error(t1, samples[last - 1], samples[last]) <= tolerance;
+}
+
+// Convert an xyzv file to a Chebyshev trajectory file. The segments are
+// made as long as possible while the fit stays within tolerance.
+bool xyzvToChebyshev(const std::string& inFilename,
+                     const std::string& outFilename,
+                     std::size_t nCoeffs,
+                     double tolerance)
+{
+    std::vector<Sample> samples;
+    if (!ReadSamples(inFilename, samples))
+        return false;
+
+    std::vector<double> nodeValues = NodeValues(nCoeffs);
+    std::vector<double> segmentTimes{ samples.front().tdb };
+    std::vector<double> coefficients;
+    Coefficients coeffs;
+    Coefficients bestCoeffs;
+    std::size_t lastSample = samples.size() - 1;
+    for (std::size_t first = 0; first < lastSample;)
+    {
+        // A cubic fits a single span exactly
+        std::size_t good = first + 1;
+        FitSegment(samples, first, good, nCoeffs, nodeValues, tolerance, bestCoeffs);
+
+        // Grow the segment exponentially, then bisect between the longest
+        // fitting and the shortest failing end sample
+        std::size_t bad = lastSample + 1;
+        while (good < lastSample)
+        {
+            std::size_t next = std::min(first + 2 * (good - first), lastSample);
+            if (!FitSegment(samples, first, next, nCoeffs, nodeValues, tolerance, coeffs))
+            {
+                bad = next;
+                break;
+            }
+
+            good = next;
+            bestCoeffs.swap(coeffs);
+        }
+
+        while (bad - good > 1)
+        {
+            std::size_t mid = good + (bad - good) / 2;
+            if (FitSegment(samples, first, mid, nCoeffs, nodeValues, tolerance, coeffs))
+            {
+                good = mid;
+                bestCoeffs.swap(coeffs);
+            }
+            else
+            {
+                bad = mid;
+            }
+        }
+
+        segmentTimes.push_back(samples[good].tdb);
+        coefficients.insert(coefficients.end(), bestCoeffs.begin(), bestCoeffs.end());
+        first = good;
+    }
+
+    double boundingRadius = 0.0;
+    for (const Sample& s : samples)
+        boundingRadius = std::max(boundingRadius, std::hypot(s.position[0], s.position[1], s.position[2]));
+
+    std::array<char, sizeof(XYZVChebyshevHeader)> header = {};
+    {
+        auto byteOrder = static_cast<decltype(XYZVChebyshevHeader::byteOrder)>(celestia::compat::endian::native);
+        auto digits = static_cast<decltype(XYZVChebyshevHeader::digits)>(std::numeric_limits<double>::digits);
+        auto coefficientCount = static_cast<decltype(XYZVChebyshevHeader::coefficientCount)>(nCoeffs);
+        auto segmentCount = static_cast<decltype(XYZVChebyshevHeader::segmentCount)>(segmentTimes.size() - 1);
+
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, magic), XYZV_CHEBYSHEV_MAGIC.data(), XYZV_CHEBYSHEV_MAGIC.size());
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, byteOrder), &byteOrder, sizeof(byteOrder));
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, digits), &digits, sizeof(digits));
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, coefficientCount), &coefficientCount, sizeof(coefficientCount));
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, segmentCount), &segmentCount, sizeof(segmentCount));
+        std::memcpy(header.data() + offsetof(XYZVChebyshevHeader, boundingRadius), &boundingRadius, sizeof(boundingRadius));
+    }
+
+    std::ofstream out(outFilename, std::ios::binary);
+    if (!out.write(header.data(), header.size()) ||
+        !out.write(reinterpret_cast<const char*>(segmentTimes.data()), segmentTimes.size() * sizeof(double)) ||
+        !out.write(reinterpret_cast<const char*>(coefficients.data()), coefficients.size() * sizeof(double)))
+    {
+        fmt::print(stderr, "Error writing output file\n");
+        return false;
+    }
+
+    std::size_t inSize = samples.size() * sizeof(XYZVBinaryData);
+    std::size_t outSize = header.size() + (segmentTimes.size() + coefficients.size()) * sizeof(double);
+    fmt::print(stderr, "Fitted {} samples with {} segments, {} bytes ({:.1f}% of binary xyzv).\n",
+               samples.size(), segmentTimes.size() - 1, outSize,
+               100.0 * static_cast<double>(outSize) / static_cast<double>(inSize));
+    return true;
+}
+
+void usage(const char* name)
+{
+    fmt::print(stderr,
+               "Usage: {} [-c coefficients] [-t tolerance] infile.xyzv outfile.xyzvcheb\n"
+               "  -c  number of coefficients per coordinate, 4 to {} (default 12)\n"
+               "  -t  maximum deviation from the samples in kilometers (default 0.01)\n",
+               name, XYZV_CHEBYSHEV_MAX_COEFFICIENTS);
+}
+
+} // end unnamed namespace
+
+int main(int argc, char* argv[])
+{
+    std::size_t nCoeffs = 12;
+    double tolerance = 0.01;
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        if (std::strcmp(argv[i], "-c") == 0)
+        {
+            nCoeffs = static_cast<std::size_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "-t") == 0)
+        {
+            tolerance = std::strtod(argv[i + 1], nullptr);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - i != 2 || nCoeffs < 4 || nCoeffs > XYZV_CHEBYSHEV_MAX_COEFFICIENTS || !(tolerance > 0.0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!xyzvToChebyshev(argv[i], argv[i + 1], nCoeffs, tolerance))
+    {
+        fmt::print(stderr, "Error converting {} to {}.\n", argv[i], argv[i + 1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+// core_benchmark.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Micro-benchmarks of the core data structures and parsers: tokenizing a
+// catalog, UTF-8 decoding, name lookups, star octree traversal through the
+// StarHandler interface and with an inlined handler, universal
+// coordinate arithmetic, orbit evaluation and timeline phase lookups.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <fmt/format.h>
+
+#include <celastro/astro.h>
+#include <celcompat/numbers.h>
+#include <celengine/body.h>
+#include <celengine/frame.h>
+#include <celengine/name.h>
+#include <celengine/octreeculling.h>
+#include <celengine/selection.h>
+#include <celengine/star.h>
+#include <celengine/staroctree.h>
+#include <celengine/stellarclass.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celengine/univcoord.h>
+#include <celengine/universe.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include <celutil/logger.h>
+#include <celutil/tokenizer.h>
+#include <celutil/utf8.h>
+#include "harness.h"
+
+using celestia::benchmark::Harness;
+namespace astro = celestia::astro;
+namespace ephem = celestia::ephem;
+
+namespace
+{
+
+constexpr float OctreeRootSize = 1000000000.0f;
+constexpr float OctreeMagnitude = 6.0f;
+
+
+// A star catalog like the .stc files of custom stars
+std::string
+makeStarCatalog(int stars)
+{
+    std::mt19937_64 generator(12345);
+    std::uniform_real_distribution<double> angle(0.0, 360.0);
+    std::uniform_real_distribution<double> distance(1.0, 5000.0);
+    std::uniform_real_distribution<double> magnitude(-5.0, 15.0);
+    std::string text;
+    for (int i = 0; i < stars; ++i)
+    {
+        text += fmt::format("{} \"Star {}\"\n{{\n", 3000000 + i, i);
+        text += fmt::format("    RA {:.6f}\n    Dec {:.6f}\n    Distance {:.3f}\n", angle(generator),
+                            angle(generator) * 0.5 - 90.0, distance(generator));
+        text += fmt::format("    SpectralType \"G2V\"\n    AppMag {:.2f}\n}}\n\n", magnitude(generator));
+    }
+
+    return text;
+}
+
+
+// One operation is one token
+void
+benchmarkTokenizer(Harness& harness)
+{
+    std::string catalog = makeStarCatalog(1000);
+    harness.run("tokenizer-stc", [&catalog](std::size_t operations)
+    {
+        double sink = 0.0;
+        std::size_t tokens = 0;
+        while (tokens < operations)
+        {
+            Tokenizer tokenizer(catalog);
+            for (; tokens < operations; ++tokens)
+            {
+                Tokenizer::TokenType type = tokenizer.nextToken();
+                if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+                    break;
+                if (type == Tokenizer::TokenNumber)
+                    sink += *tokenizer.getNumberValue();
+            }
+        }
+        return sink;
+    });
+}
+
+
+// One operation is one decoded character
+void
+benchmarkUTF8(Harness& harness)
+{
+    // Star and constellation names in the scripts of the translations
+    const std::string_view samples[] =
+    {
+        "Alpha Centauri, Betelgeuse, Sirius, Vega, ",
+        "Альфа Центавра, Бетельгейзе, Сириус, ",
+        "アルファ・ケンタウリ、ベテルギウス、シリウス、",
+        "半人马座α、参宿四、天狼星、织女星、",
+        "Άλφα του Κενταύρου, Σείριος, ",
+        "α Cen, β Ori, ε Eri, ",
+    };
+
+    std::string text;
+    while (text.size() < 65536)
+    {
+        for (std::string_view sample : samples)
+            text += sample;
+    }
+
+    harness.run("utf8-decode", [&text](std::size_t operations)
+    {
+        auto length = static_cast<std::int32_t>(text.size());
+        std::int32_t pos = 0;
+        std::int32_t sink = 0;
+        for (std::size_t i = 0; i < operations; ++i)
+        {
+            if (pos >= length)
+                pos = 0;
+            std::int32_t ch = 0;
+            UTF8Decode(text, pos, ch);
+            sink += ch;
+        }
+        return static_cast<double>(sink);
+    });
+}
+
+
+// One operation is one lookup or one completion
+void
+benchmarkNameDatabase(Harness& harness)
+{
+    constexpr AstroCatalog::IndexNumber nNames = 100000;
+    const std::string_view letters[] = { "ALF", "BET", "GAM", "DEL", "EPS", "ZET" };
+    const std::string_view constellations[] = { "Ori", "Cen", "UMa", "Cyg", "Sco", "Tau", "Lyr", "Aql" };
+
+    NameDatabase database;
+    std::vector<std::string> names;
+    names.reserve(nNames);
+    for (AstroCatalog::IndexNumber i = 0; i < nNames; ++i)
+    {
+        if (i % 4 == 0)
+        {
+            names.push_back(fmt::format("{} {} {}", letters[i % 6], i / 48 + 1, constellations[i / 6 % 8]));
+            database.add(i, names.back(), true);
+        }
+        else
+        {
+            names.push_back(fmt::format("Star {}", i));
+            database.add(i, names.back(), false);
+        }
+    }
+
+    // Visit the names out of order, like searches spread over the catalog
+    std::vector<std::string> queries;
+    std::mt19937 generator(12345);
+    for (int i = 0; i < 4096; ++i)
+        queries.push_back(names[generator() % nNames]);
+
+    harness.run("namedb-lookup", [&database, &queries](std::size_t operations)
+    {
+        double sink = 0.0;
+        for (std::size_t i = 0; i < operations; ++i)
+            sink += database.getCatalogNumberByName(queries[i % queries.size()], false);
+        return sink;
+    });
+
+    harness.run("namedb-completion", [&database](std::size_t operations)
+    {
+        std::vector<std::string> completion;
+        double sink = 0.0;
+        for (std::size_t i = 0; i < operations; ++i)
+        {
+            completion.clear();
+            database.getCompletion(completion, fmt::format("Star {}", i % 1000), 20);
+            sink += static_cast<double>(completion.size());
+        }
+        return sink;
+    });
+}
+
+
+// Final, so traversals given the concrete type inline process()
+class CountingStarHandler final : public StarHandler
+{
+public:
+    void process(const Star& star, float distance, float appMag) override
+    {
+        ++m_count;
+        m_sum += distance + appMag + static_cast<float>(star.getIndex() & 1);
+    }
+
+    double result() const { return m_sum + static_cast<double>(m_count); }
+
+private:
+    std::size_t m_count{ 0 };
+    double m_sum{ 0.0 };
+};
+
+
+// One operation is a traversal of the whole view frustum
+void
+benchmarkStarOctree(Harness& harness)
+{
+    constexpr std::uint32_t nStars = 200000;
+
+    // Stars spread over a disk of 10000 light years
+    std::mt19937 generator(12345);
+    std::normal_distribution<float> radial(0.0f, 4000.0f);
+    std::normal_distribution<float> vertical(0.0f, 300.0f);
+    std::normal_distribution<float> magnitude(4.0f, 2.5f);
+    StellarClass stellarClass(StellarClass::NormalStar, StellarClass::Spectral_G, 2, StellarClass::Lum_V);
+    auto details = StarDetails::GetStarDetails(stellarClass);
+
+    std::vector<Star> stars(nStars);
+    DynamicStarOctree::ObjectList starList;
+    starList.reserve(nStars);
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        Star& star = stars[i];
+        star.setIndex(i);
+        star.setPosition(radial(generator), vertical(generator), radial(generator));
+        star.setAbsoluteMagnitude(magnitude(generator));
+        star.setDetails(celestia::util::IntrusivePtr<StarDetails>(details));
+        starList.push_back(&star);
+    }
+
+    float absMag = astro::appToAbsMag(OctreeMagnitude, OctreeRootSize * celestia::numbers::sqrt3_v<float>);
+    auto root = std::make_unique<DynamicStarOctree>(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f), absMag);
+    root->insertObjects(std::move(starList), OctreeRootSize);
+
+    auto sortedStars = std::make_unique<Star[]>(nStars);
+    Star* firstStar = sortedStars.get();
+    StarOctree* octree = nullptr;
+    root->rebuildAndSort(octree, firstStar);
+    octree->buildObjectArrays();
+    std::unique_ptr<StarOctree> octreeOwner(octree);
+
+    Eigen::Vector3f position(8.0f, 20.0f, -30.0f);
+    Eigen::Quaternionf orientation(Eigen::AngleAxisf(0.7f, Eigen::Vector3f::UnitY()));
+    std::array<Eigen::Hyperplane<float, 3>, 5> frustumPlanes;
+    celestia::engine::computeFrustumPlanes(frustumPlanes, position, orientation,
+                                           0.8f, 16.0f / 9.0f);
+
+    for (float limitingMag : { 6.0f, 12.0f })
+    {
+        // Through the StarHandler interface, as StarDatabase does
+        harness.run(fmt::format("octree-visible-stars-mag{}", limitingMag),
+                    [&, limitingMag](std::size_t operations)
+                    {
+                        CountingStarHandler handler;
+                        StarHandler& starHandler = handler;
+                        for (std::size_t i = 0; i < operations; ++i)
+                        {
+                            octree->processVisibleObjects(starHandler, position, frustumPlanes.data(),
+                                                          limitingMag, OctreeRootSize);
+                        }
+                        return handler.result();
+                    });
+
+        harness.run(fmt::format("octree-visible-stars-inlined-mag{}", limitingMag),
+                    [&, limitingMag](std::size_t operations)
+                    {
+                        CountingStarHandler handler;
+                        for (std::size_t i = 0; i < operations; ++i)
+                        {
+                            octree->processVisibleObjects(handler, position, frustumPlanes.data(),
+                                                          limitingMag, OctreeRootSize);
+                        }
+                        return handler.result();
+                    });
+    }
+}
+
+
+// One operation is an addition, a subtraction and an offset
+void
+benchmarkUniversalCoord(Harness& harness)
+{
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> ly(-10000.0, 10000.0);
+    std::uniform_real_distribution<double> km(-1.0e9, 1.0e9);
+    std::vector<UniversalCoord> coords;
+    std::vector<UniversalCoord> offsets;
+    for (int i = 0; i < 1024; ++i)
+    {
+        coords.push_back(UniversalCoord::CreateLy(Eigen::Vector3d(ly(generator), ly(generator), ly(generator))));
+        offsets.push_back(UniversalCoord::CreateKm(Eigen::Vector3d(km(generator), km(generator), km(generator))));
+    }
+
+    harness.run("univcoord-arithmetic", [&coords, &offsets](std::size_t operations)
+    {
+        double sink = 0.0;
+        for (std::size_t i = 0; i < operations; ++i)
+        {
+            const UniversalCoord& origin = coords[i % 1024];
+            UniversalCoord target = origin + offsets[(i + 1) % 1024];
+            UniversalCoord back = target - offsets[(i + 2) % 1024];
+            sink += back.offsetFromKm(origin).x();
+        }
+        return sink;
+    });
+}
+
+
+// One operation is one position; ephemeris_benchmark covers the other
+// orbit types
+void
+benchmarkOrbit(Harness& harness)
+{
+    astro::KeplerElements elements;
+    elements.semimajorAxis = astro::AUtoKilometers(2.7);
+    elements.eccentricity = 0.3;
+    elements.inclination = 0.2;
+    elements.longAscendingNode = 1.3;
+    elements.argPericenter = 0.4;
+    elements.meanAnomaly = 0.0;
+    elements.period = 1600.0;
+    ephem::EllipticalOrbit orbit(elements);
+
+    harness.run("orbit-elliptical", [&orbit](std::size_t operations)
+    {
+        double sink = 0.0;
+        for (std::size_t i = 0; i < operations; ++i)
+            sink += orbit.positionAtTime(2451545.0 + static_cast<double>(i) * 0.37).x();
+        return sink;
+    });
+}
+
+
+// One operation is one phase lookup, with the time advancing by a small
+// step or jumping at random. The cost per lookup should stay about the
+// same as the number of phases grows.
+void
+benchmarkTimeline(Harness& harness)
+{
+    constexpr double StartTime = 2451545.0;
+    constexpr double PhaseLength = 1.0;
+
+    Universe universe;
+    Star star;
+    PlanetarySystem system(&star);
+    Body* center = system.addBody("center");
+    Body* spacecraft = system.addBody("spacecraft");
+    auto frame = std::make_shared<J2000EclipticFrame>(Selection(center));
+    ephem::FixedOrbit orbit(Eigen::Vector3d::Zero());
+    ephem::ConstantOrientation rotation(Eigen::Quaterniond::Identity());
+
+    for (unsigned int nPhases : { 1u, 10u, 100u, 1000u, 10000u })
+    {
+        Timeline timeline;
+        for (unsigned int i = 0; i < nPhases; ++i)
+        {
+            double start = StartTime + static_cast<double>(i) * PhaseLength;
+            auto phase = TimelinePhase::CreateTimelinePhase(universe, spacecraft,
+                                                            start, start + PhaseLength,
+                                                            frame, orbit, frame, rotation);
+            timeline.appendPhase(phase);
+        }
+
+        double span = static_cast<double>(nPhases) * PhaseLength;
+        std::mt19937 generator(12345);
+        std::uniform_real_distribution<double> times(StartTime, StartTime + span);
+        std::vector<double> randomTimes(4096);
+        for (double& t : randomTimes)
+            t = times(generator);
+
+        harness.run(fmt::format("timeline-findphase-monotone-{}", nPhases),
+                    [&timeline, span](std::size_t operations)
+                    {
+                        double sink = 0.0;
+                        double step = span / 100000.0;
+                        for (std::size_t i = 0; i < operations; ++i)
+                        {
+                            double t = StartTime + std::fmod(static_cast<double>(i) * step, span);
+                            sink += timeline.findPhase(t)->startTime();
+                        }
+                        return sink;
+                    });
+
+        harness.run(fmt::format("timeline-findphase-random-{}", nPhases),
+                    [&timeline, &randomTimes](std::size_t operations)
+                    {
+                        double sink = 0.0;
+                        for (std::size_t i = 0; i < operations; ++i)
+                            sink += timeline.findPhase(randomTimes[i % randomTimes.size()])->startTime();
+                        return sink;
+                    });
+    }
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    Harness harness("core_benchmark");
+    if (!harness.parseCommandLine(argc, argv))
+        return 1;
+
+    celestia::util::CreateLogger(celestia::util::Level::Warning);
+
+    benchmarkTokenizer(harness);
+    benchmarkUTF8(harness);
+    benchmarkNameDatabase(harness);
+    benchmarkStarOctree(harness);
+    benchmarkUniversalCoord(harness);
+    benchmarkOrbit(harness);
+    benchmarkTimeline(harness);
+
+    bool ok = harness.writeResults();
+    celestia::util::DestroyLogger();
+    return ok ? 0 : 1;
+}
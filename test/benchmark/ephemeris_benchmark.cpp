@@ -0,0 +1,496 @@
+// ephemeris_benchmark.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measures the time per call of Orbit::positionAtTime and
+// RotationModel::spin for each orbit and rotation model implementation,
+// and writes the results as JSON.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <fmt/format.h>
+
+#ifdef CELX
+#include <lua.hpp>
+#endif
+
+#include <celastro/astro.h>
+#include <celcompat/filesystem.h>
+#include <celengine/hash.h>
+#include <celengine/value.h>
+#include <celephem/customorbit.h>
+#include <celephem/customrotation.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include <celephem/samporbit.h>
+#include <celephem/samporient.h>
+#include <celephem/tabulatedorbit.h>
+#include <celephem/vsop87.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+
+#ifdef CELX
+#include <celephem/scriptobject.h>
+#include <celephem/scriptorbit.h>
+#include <celephem/scriptrotation.h>
+#endif
+
+#ifdef USE_SPICE
+#include <celephem/spiceinterface.h>
+#include <celephem/spiceorbit.h>
+#include <celephem/spicerotation.h>
+#endif
+
+namespace astro = celestia::astro;
+namespace ephem = celestia::ephem;
+namespace math = celestia::math;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+constexpr double J2000 = 2451545.0;
+
+// Monotone calls advance by one minute, like a time lapse at a high frame
+// rate. Random calls are spread over ten years, or the valid range of
+// models which have one.
+constexpr double MonotoneStep = 1.0 / 1440.0;
+constexpr double RandomSpan = 3652.5;
+
+// Span and step of the synthesized sampled trajectories and orientations
+constexpr double SampleSpan = 2000.0;
+constexpr double SampleStep = 0.1;
+
+struct Result
+{
+    std::string kind;
+    std::string name;
+    std::string pattern;
+    double nsPerCall;
+};
+
+int calls = 200000;
+fs::path outputFilename;
+#ifdef USE_SPICE
+std::vector<fs::path> spiceKernels;
+std::string spiceTarget;
+std::string spiceOrigin;
+std::string spiceFrame;
+std::string spiceBaseFrame{ "eclipj2000" };
+#endif
+
+
+void usage()
+{
+    std::cerr << "Usage: ephemeris_benchmark [options]\n";
+    std::cerr << "   --calls (or -n) <count>     : calls per model and access pattern (default 200000)\n";
+    std::cerr << "   --output (or -o) <file>     : write the JSON results to file instead of stdout\n";
+#ifdef USE_SPICE
+    std::cerr << "   --spice-kernel <file>       : load a SPICE kernel, may be repeated\n";
+    std::cerr << "   --spice-target <name>       : target of the SPICE orbit\n";
+    std::cerr << "   --spice-origin <name>       : origin of the SPICE orbit\n";
+    std::cerr << "   --spice-frame <name>        : frame of the SPICE rotation\n";
+    std::cerr << "   --spice-base-frame <name>   : base frame of the SPICE rotation (default eclipj2000)\n";
+#endif
+    std::cerr << "JPL ephemeris orbits are benchmarked when data/jpleph.dat is found in\n";
+    std::cerr << "the current directory.\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--calls"))
+        {
+            if (i + 1 == argc)
+                return false;
+            char* end = nullptr;
+            long parsed = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || parsed < 1 || parsed > 100000000)
+                return false;
+            calls = static_cast<int>(parsed);
+        }
+        else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output"))
+        {
+            if (i + 1 == argc)
+                return false;
+            outputFilename = argv[++i];
+        }
+#ifdef USE_SPICE
+        else if (!std::strcmp(argv[i], "--spice-kernel") && i + 1 < argc)
+        {
+            spiceKernels.emplace_back(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--spice-target") && i + 1 < argc)
+        {
+            spiceTarget = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--spice-origin") && i + 1 < argc)
+        {
+            spiceOrigin = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--spice-frame") && i + 1 < argc)
+        {
+            spiceFrame = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--spice-base-frame") && i + 1 < argc)
+        {
+            spiceBaseFrame = argv[++i];
+        }
+#endif
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+astro::KeplerElements
+testElements(double eccentricity)
+{
+    astro::KeplerElements elements;
+    elements.semimajorAxis = eccentricity < 1.0 ? 421800.0 : -421800.0;
+    elements.eccentricity = eccentricity;
+    elements.inclination = math::degToRad(20.0);
+    elements.longAscendingNode = math::degToRad(40.0);
+    elements.argPericenter = math::degToRad(75.0);
+    elements.meanAnomaly = math::degToRad(10.0);
+    elements.period = 1.769;
+    return elements;
+}
+
+
+// The times of each access pattern, around J2000 within the valid range
+std::vector<double>
+makeTimes(std::string_view pattern, double begin, double end)
+{
+    double center = J2000;
+    double span = RandomSpan;
+    if (begin < end)
+    {
+        span = std::min(span, end - begin);
+        center = std::clamp(center, begin + 0.5 * span, end - 0.5 * span);
+    }
+
+    std::vector<double> times(static_cast<std::size_t>(calls));
+    if (pattern == "monotone")
+    {
+        double step = std::min(MonotoneStep, span / static_cast<double>(calls));
+        for (std::size_t i = 0; i < times.size(); ++i)
+            times[i] = center - 0.5 * step * static_cast<double>(calls) + step * static_cast<double>(i);
+    }
+    else
+    {
+        std::mt19937_64 generator(12345);
+        std::uniform_real_distribution<double> distribution(center - 0.5 * span, center + 0.5 * span);
+        for (double& t : times)
+            t = distribution(generator);
+    }
+
+    return times;
+}
+
+
+template<typename F>
+double
+measure(const std::vector<double>& times, F&& f)
+{
+    // Keep the results alive, so that the calls can't be optimized away
+    double sink = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (double t : times)
+        sink += f(t);
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    if (sink == 0.125)
+        std::fputc(' ', stderr);
+    return elapsed / static_cast<double>(times.size());
+}
+
+
+void
+benchmarkOrbit(std::vector<Result>& results, std::string_view name, const ephem::Orbit& orbit)
+{
+    double begin;
+    double end;
+    orbit.getValidRange(begin, end);
+    for (std::string_view pattern : { "monotone", "random" })
+    {
+        std::vector<double> times = makeTimes(pattern, begin, end);
+        double ns = measure(times, [&orbit](double t) { return orbit.positionAtTime(t).x(); });
+        results.push_back(Result{ "orbit", std::string(name), std::string(pattern), ns });
+    }
+}
+
+
+void
+benchmarkRotation(std::vector<Result>& results, std::string_view name, const ephem::RotationModel& rotation)
+{
+    double begin;
+    double end;
+    rotation.getValidRange(begin, end);
+    for (std::string_view pattern : { "monotone", "random" })
+    {
+        std::vector<double> times = makeTimes(pattern, begin, end);
+        double ns = measure(times, [&rotation](double t) { return rotation.spin(t).w(); });
+        results.push_back(Result{ "rotation", std::string(name), std::string(pattern), ns });
+    }
+}
+
+
+// Write a trajectory sampled from an elliptical orbit, and an orientation
+// sampled from a uniform rotation, to temporary files
+bool
+writeSampledFiles(const fs::path& trajectoryPath, const fs::path& orientationPath)
+{
+    ephem::EllipticalOrbit orbit(testElements(0.05));
+    ephem::UniformRotationModel rotation(0.4, 0.0f, J2000, 0.1f, 0.3f);
+
+    std::ofstream trajectory(trajectoryPath);
+    std::ofstream orientation(orientationPath);
+    for (double t = J2000 - 0.5 * SampleSpan; t <= J2000 + 0.5 * SampleSpan; t += SampleStep)
+    {
+        Eigen::Vector3d p = orbit.positionAtTime(t);
+        // Sampled trajectories are stored in the ecliptic frame of the files
+        trajectory << fmt::format("{:.10f} {:.6f} {:.6f} {:.6f}\n", t, p.x(), -p.z(), p.y());
+        Eigen::Quaterniond q = rotation.orientationAtTime(t);
+        orientation << fmt::format("{:.10f} {:.12f} {:.12f} {:.12f} {:.12f}\n", t, q.w(), q.x(), q.y(), q.z());
+    }
+
+    return trajectory.good() && orientation.good();
+}
+
+
+#ifdef CELX
+constexpr std::string_view LuaScript = R"(
+function benchmark_orbit(t)
+    local a = 421800
+    local n = 2 * math.pi / 1.769
+    return {
+        boundingRadius = a * 1.1,
+        period = 1.769,
+        position = function(self, jd)
+            local m = n * (jd - 2451545)
+            return a * math.cos(m), 0, -a * math.sin(m)
+        end
+    }
+end
+
+function benchmark_rotation(t)
+    local n = math.pi / 0.4
+    return {
+        period = 0.4,
+        orientation = function(self, jd)
+            local m = n * (jd - 2451545)
+            return math.cos(m), 0, math.sin(m), 0
+        end
+    }
+end
+)";
+#endif
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+    celestia::util::CreateLogger(celestia::util::Level::Warning);
+
+    std::vector<Result> results;
+    std::vector<std::string> skipped;
+    auto addOrbit = [&](std::string_view name, const std::unique_ptr<ephem::Orbit>& orbit)
+    {
+        if (orbit == nullptr)
+            skipped.emplace_back(name);
+        else
+            benchmarkOrbit(results, name, *orbit);
+    };
+
+    auto addRotation = [&](std::string_view name, const ephem::RotationModel* rotation)
+    {
+        if (rotation == nullptr)
+            skipped.emplace_back(name);
+        else
+            benchmarkRotation(results, name, *rotation);
+    };
+
+    // Orbits
+    addOrbit("elliptical", std::make_unique<ephem::EllipticalOrbit>(testElements(0.05)));
+    addOrbit("hyperbolic", std::make_unique<ephem::HyperbolicOrbit>(testElements(1.5)));
+    addOrbit("vsop87-earth", ephem::CreateVSOP87EarthOrbit());
+    addOrbit("vsop87-jupiter", ephem::CreateVSOP87JupiterOrbit());
+    for (const char* name : { "jpl-earth-sun", "jpl-moon-earth" })
+        addOrbit(name, ephem::GetCustomOrbit(name));
+    for (const char* name : { "moon", "pluto", "phobos", "io", "callisto", "mimas", "titan", "hyperion",
+                              "iapetus", "htc20-helene", "miranda", "oberon", "triton" })
+    {
+        addOrbit(name, ephem::GetCustomOrbit(name));
+    }
+
+    if (auto io = ephem::GetCustomOrbit("io"); io != nullptr)
+    {
+        // The window is built ahead, as if the simulation had been running
+        auto tabulated = std::make_unique<ephem::TabulatedOrbit>(std::move(io), 30.0);
+        tabulated->positionAtTime(J2000);
+        tabulated->waitForTable();
+        addOrbit("io-tabulated", std::unique_ptr<ephem::Orbit>(std::move(tabulated)));
+    }
+
+    std::error_code ec;
+    fs::path trajectoryPath = fs::temp_directory_path(ec) / "celestia_ephemeris_benchmark.xyz";
+    fs::path orientationPath = fs::temp_directory_path(ec) / "celestia_ephemeris_benchmark.q";
+    bool haveSampled = !ec && writeSampledFiles(trajectoryPath, orientationPath);
+    if (haveSampled)
+    {
+        addOrbit("sampled-linear", ephem::LoadSampledTrajectoryDoublePrec(trajectoryPath, ephem::TrajectoryInterpolation::Linear));
+        addOrbit("sampled-cubic", ephem::LoadSampledTrajectoryDoublePrec(trajectoryPath, ephem::TrajectoryInterpolation::Cubic));
+    }
+    else
+    {
+        skipped.emplace_back("sampled-linear");
+        skipped.emplace_back("sampled-cubic");
+    }
+
+    // Rotation models
+    ephem::ConstantOrientation constant(Eigen::Quaterniond(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitX())));
+    ephem::UniformRotationModel uniform(0.4, 0.0f, J2000, 0.1f, 0.3f);
+    ephem::PrecessingRotationModel precessing(0.4, 0.0f, J2000, 0.1f, 0.3f, 25800.0 * 365.25);
+    addRotation("constant", &constant);
+    addRotation("uniform", &uniform);
+    addRotation("precessing", &precessing);
+    for (const char* name : { "iau-earth", "earth-p03lp", "iau-moon", "iau-mars", "iau-jupiter", "iau-io",
+                              "iau-titan", "iau-miranda" })
+    {
+        addRotation(name, ephem::GetCustomRotationModel(name));
+    }
+
+    std::unique_ptr<ephem::RotationModel> sampledRotation;
+    if (haveSampled)
+        sampledRotation = ephem::LoadSampledOrientation(orientationPath);
+    addRotation("sampled-orientation", sampledRotation.get());
+
+    fs::remove(trajectoryPath, ec);
+    fs::remove(orientationPath, ec);
+
+#ifdef CELX
+    lua_State* luaState = luaL_newstate();
+    luaL_openlibs(luaState);
+    if (luaL_dostring(luaState, std::string(LuaScript).c_str()) == 0)
+    {
+        ephem::SetScriptedObjectContext(luaState);
+        AssociativeArray parameters;
+        addOrbit("scripted", ephem::CreateScriptedOrbit(nullptr, "benchmark_orbit", parameters, fs::path()));
+        auto scriptedRotation = ephem::CreateScriptedRotation(nullptr, "benchmark_rotation", parameters, fs::path());
+        addRotation("scripted", scriptedRotation.get());
+
+        // The same scripts interpolated from cached samples
+        AssociativeArray sampledParameters;
+        sampledParameters.addValue("SampleTolerance", Value(1.0e-3));
+        addOrbit("scripted-sampled", ephem::CreateScriptedOrbit(nullptr, "benchmark_orbit", sampledParameters, fs::path()));
+        auto sampledScriptedRotation = ephem::CreateScriptedRotation(nullptr, "benchmark_rotation", sampledParameters, fs::path());
+        addRotation("scripted-sampled", sampledScriptedRotation.get());
+    }
+    else
+    {
+        skipped.emplace_back("scripted");
+        skipped.emplace_back("scripted-sampled");
+    }
+#else
+    skipped.emplace_back("scripted");
+    skipped.emplace_back("scripted-sampled");
+#endif
+
+#ifdef USE_SPICE
+    bool spiceLoaded = !spiceKernels.empty() && ephem::InitializeSpice();
+    for (const fs::path& kernel : spiceKernels)
+        spiceLoaded = spiceLoaded && ephem::LoadSpiceKernel(kernel);
+
+    const std::vector<std::string> noKernels;
+    std::unique_ptr<ephem::Orbit> spiceOrbit;
+    if (spiceLoaded && !spiceTarget.empty() && !spiceOrigin.empty())
+    {
+        auto orbit = std::make_unique<ephem::SpiceOrbit>(spiceTarget, spiceOrigin, 0.0, 1.0e9);
+        if (orbit->init(fs::path(), noKernels.begin(), noKernels.end()))
+            spiceOrbit = std::move(orbit);
+    }
+    addOrbit("spice", spiceOrbit);
+
+    std::unique_ptr<ephem::RotationModel> spiceRotation;
+    if (spiceLoaded && !spiceFrame.empty())
+    {
+        auto rotation = std::make_unique<ephem::SpiceRotation>(spiceFrame, spiceBaseFrame, 0.0);
+        if (rotation->init(fs::path(), noKernels.begin(), noKernels.end()))
+            spiceRotation = std::move(rotation);
+    }
+    addRotation("spice", spiceRotation.get());
+#else
+    skipped.emplace_back("spice");
+#endif
+
+    std::FILE* out = stdout;
+    if (!outputFilename.empty())
+    {
+        out = std::fopen(outputFilename.string().c_str(), "w");
+        if (out == nullptr)
+        {
+            GetLogger()->error("Can't open {} for writing\n", outputFilename);
+            return 1;
+        }
+    }
+
+    fmt::print(out, "{{\n");
+    fmt::print(out, "  \"calls\": {},\n", calls);
+    fmt::print(out, "  \"results\": [");
+    const char* separator = "\n";
+    for (const Result& result : results)
+    {
+        fmt::print(out, "{}    {{ \"kind\": \"{}\", \"name\": \"{}\", \"pattern\": \"{}\", \"nsPerCall\": {:.2f} }}",
+                   separator, result.kind, result.name, result.pattern, result.nsPerCall);
+        separator = ",\n";
+    }
+    fmt::print(out, "\n  ],\n");
+    fmt::print(out, "  \"skipped\": [");
+    for (std::size_t i = 0; i < skipped.size(); ++i)
+        fmt::print(out, "{}\"{}\"", i == 0 ? "" : ", ", skipped[i]);
+    fmt::print(out, "]\n}}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+
+#ifdef CELX
+    ephem::SetScriptedObjectContext(nullptr);
+    lua_close(luaState);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,233 @@
+// harness.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// A small harness for micro-benchmarks: calibration, warm-up, repeated
+// measurements, statistics and JSON output.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+#include <fmt/format.h>
+
+namespace celestia::benchmark
+{
+
+namespace
+{
+
+// Upper limit of the calibrated number of operations per call
+constexpr std::size_t MaxOperations = std::size_t(1) << 30;
+
+
+double
+measure(const Harness::Body& body, std::size_t operations, double& sink)
+{
+    auto start = std::chrono::steady_clock::now();
+    sink += body(operations);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+Harness::Statistics
+computeStatistics(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    std::size_t n = samples.size();
+
+    Harness::Statistics stats;
+    stats.min = samples.front();
+    stats.median = n % 2 == 1 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(n);
+    double variance = 0.0;
+    for (double sample : samples)
+        variance += (sample - stats.mean) * (sample - stats.mean);
+    stats.stddev = n > 1 ? std::sqrt(variance / static_cast<double>(n - 1)) : 0.0;
+    return stats;
+}
+
+
+bool
+parseNumber(const char* text, double minimum, double maximum, double& value)
+{
+    char* end = nullptr;
+    double parsed = std::strtod(text, &end);
+    if (*end != '\0' || !(parsed >= minimum && parsed <= maximum))
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+} // end unnamed namespace
+
+
+Harness::Harness(std::string_view program) :
+    m_program(program)
+{
+}
+
+
+void
+Harness::usage() const
+{
+    std::cerr << "Usage: " << m_program << " [options]\n";
+    std::cerr << "   --repetitions (or -r) <n>   : measured calls per benchmark (default 10)\n";
+    std::cerr << "   --warmup (or -w) <n>        : calls before measuring (default 2)\n";
+    std::cerr << "   --min-time <seconds>        : minimum duration of a call (default 0.05)\n";
+    std::cerr << "   --filter (or -f) <text>     : only run benchmarks whose name contains text\n";
+    std::cerr << "   --list                      : list the benchmarks instead of running them\n";
+    std::cerr << "   --output (or -o) <file>     : write the JSON results to file instead of stdout\n";
+}
+
+
+bool
+Harness::parseCommandLine(int argc, char* argv[])
+{
+    bool ok = true;
+    for (int i = 1; ok && i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        double value = 0.0;
+        if (!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--repetitions"))
+        {
+            ok = hasValue && parseNumber(argv[++i], 1.0, 10000.0, value);
+            m_repetitions = static_cast<int>(value);
+        }
+        else if (!std::strcmp(argv[i], "-w") || !std::strcmp(argv[i], "--warmup"))
+        {
+            ok = hasValue && parseNumber(argv[++i], 0.0, 10000.0, value);
+            m_warmup = static_cast<int>(value);
+        }
+        else if (!std::strcmp(argv[i], "--min-time"))
+        {
+            ok = hasValue && parseNumber(argv[++i], 0.0, 60.0, m_minTime);
+        }
+        else if (!std::strcmp(argv[i], "-f") || !std::strcmp(argv[i], "--filter"))
+        {
+            ok = hasValue;
+            if (ok)
+                m_filter = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--list"))
+        {
+            m_list = true;
+        }
+        else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output"))
+        {
+            ok = hasValue;
+            if (ok)
+                m_outputFilename = argv[++i];
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    if (!ok)
+        usage();
+    return ok;
+}
+
+
+void
+Harness::run(std::string_view name, const Body& body)
+{
+    if (!m_filter.empty() && name.find(m_filter) == std::string_view::npos)
+        return;
+
+    if (m_list)
+    {
+        std::cout << name << '\n';
+        return;
+    }
+
+    // The first call may build caches or fault in memory, so it would
+    // spoil the calibration
+    measure(body, 1, m_sink);
+
+    // Scale the operation count from the duration of the last call, at
+    // most tenfold at a time as the first calls are the least reliable
+    std::size_t operations = 1;
+    for (;;)
+    {
+        double time = measure(body, operations, m_sink);
+        if (time >= m_minTime || operations >= MaxOperations)
+            break;
+
+        double factor = time > 0.0 ? 1.2 * m_minTime / time : 10.0;
+        factor = std::clamp(factor, 2.0, 10.0);
+        operations = std::min(MaxOperations, static_cast<std::size_t>(static_cast<double>(operations) * factor));
+    }
+
+    for (int i = 0; i < m_warmup; ++i)
+        measure(body, operations, m_sink);
+
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(m_repetitions));
+    for (int i = 0; i < m_repetitions; ++i)
+        samples.push_back(measure(body, operations, m_sink) * 1.0e9 / static_cast<double>(operations));
+
+    m_results.push_back(Result{ std::string(name), operations, computeStatistics(std::move(samples)) });
+    std::cerr << fmt::format("{:<32} {:>12.2f} ns\n", name, m_results.back().nsPerOperation.median);
+}
+
+
+bool
+Harness::writeResults() const
+{
+    if (m_list)
+        return true;
+
+    std::FILE* out = stdout;
+    if (!m_outputFilename.empty())
+    {
+        out = std::fopen(m_outputFilename.string().c_str(), "w");
+        if (out == nullptr)
+        {
+            std::cerr << "Can't open " << m_outputFilename << " for writing\n";
+            return false;
+        }
+    }
+
+    fmt::print(out, "{{\n");
+    fmt::print(out, "  \"benchmark\": \"{}\",\n", m_program);
+    fmt::print(out, "  \"warmup\": {},\n", m_warmup);
+    fmt::print(out, "  \"repetitions\": {},\n", m_repetitions);
+    fmt::print(out, "  \"results\": [");
+    const char* separator = "\n";
+    for (const Result& result : m_results)
+    {
+        const Statistics& ns = result.nsPerOperation;
+        fmt::print(out, "{}    {{ \"name\": \"{}\", \"operations\": {}, \"nsPerOperation\": "
+                        "{{ \"min\": {:.3f}, \"median\": {:.3f}, \"mean\": {:.3f}, \"stddev\": {:.3f} }} }}",
+                   separator, result.name, result.operations, ns.min, ns.median, ns.mean, ns.stddev);
+        separator = ",\n";
+    }
+    fmt::print(out, "\n  ]\n}}\n");
+
+    // The sink is never this value, but the compiler can't know
+    if (m_sink == 0.125)
+        std::fputc(' ', out);
+
+    if (out != stdout)
+        std::fclose(out);
+
+    return true;
+}
+
+} // end namespace celestia::benchmark
@@ -0,0 +1,78 @@
+// harness.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// A small harness for micro-benchmarks: calibration, warm-up, repeated
+// measurements, statistics and JSON output.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::benchmark
+{
+
+/*! Runs named benchmarks and collects the time per operation. Each
+ *  benchmark is a function performing a given number of operations; it
+ *  returns a value which depends on their results, so that the compiler
+ *  can't drop them. The number of operations is first raised until a call
+ *  takes at least the minimum time, then the function is called for the
+ *  warm-up and the measured repetitions with that number.
+ */
+class Harness
+{
+public:
+    using Body = std::function<double(std::size_t operations)>;
+
+    struct Statistics
+    {
+        double min;
+        double median;
+        double mean;
+        double stddev;
+    };
+
+    explicit Harness(std::string_view program);
+
+    // Parse the common options; returns false and prints the usage if
+    // they are invalid
+    bool parseCommandLine(int argc, char* argv[]);
+
+    void run(std::string_view name, const Body& body);
+
+    // Write the results as JSON to the output file or stdout
+    bool writeResults() const;
+
+private:
+    struct Result
+    {
+        std::string name;
+        std::size_t operations;
+        Statistics nsPerOperation;
+    };
+
+    void usage() const;
+
+    std::string m_program;
+    int m_warmup{ 2 };
+    int m_repetitions{ 10 };
+    double m_minTime{ 0.05 };
+    std::string m_filter;
+    bool m_list{ false };
+    fs::path m_outputFilename;
+    std::vector<Result> m_results;
+    double m_sink{ 0.0 };
+};
+
+} // end namespace celestia::benchmark
@@ -0,0 +1,244 @@
+// number_benchmark.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measures the time per number of from_chars for the number formats found
+// in catalogs, and of tokenizing a synthesized star catalog, and writes the
+// results as JSON.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celcompat/charconv.h>
+#include <celcompat/filesystem.h>
+#include <celutil/logger.h>
+#include <celutil/tokenizer.h>
+
+using celestia::util::GetLogger;
+
+namespace
+{
+
+struct Result
+{
+    std::string name;
+    double nsPerNumber;
+};
+
+int count = 1000000;
+fs::path outputFilename;
+
+
+void usage()
+{
+    std::cerr << "Usage: number_benchmark [options]\n";
+    std::cerr << "   --count (or -n) <count>     : numbers per format (default 1000000)\n";
+    std::cerr << "   --output (or -o) <file>     : write the JSON results to file instead of stdout\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--count"))
+        {
+            if (i + 1 == argc)
+                return false;
+            char* end = nullptr;
+            long parsed = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || parsed < 1 || parsed > 100000000)
+                return false;
+            count = static_cast<int>(parsed);
+        }
+        else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output"))
+        {
+            if (i + 1 == argc)
+                return false;
+            outputFilename = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Numbers separated by spaces, each formatted by format
+template<typename F>
+std::string
+makeNumbers(F&& format)
+{
+    std::mt19937_64 generator(12345);
+    std::string text;
+    for (int i = 0; i < count; ++i)
+    {
+        text += format(generator);
+        text += ' ';
+    }
+
+    return text;
+}
+
+
+// A star catalog like the .stc files of custom stars; each star holds
+// seven numbers besides its catalog number
+std::string
+makeStarCatalog(int& numbers)
+{
+    std::mt19937_64 generator(12345);
+    std::uniform_real_distribution<double> angle(0.0, 360.0);
+    std::uniform_real_distribution<double> distance(1.0, 5000.0);
+    std::uniform_real_distribution<double> magnitude(-5.0, 15.0);
+    std::string text;
+    int stars = count / 8;
+    for (int i = 0; i < stars; ++i)
+    {
+        text += fmt::format("{} \"Star {}\"\n{{\n", 3000000 + i, i);
+        text += fmt::format("    RA {:.6f}\n    Dec {:.6f}\n    Distance {:.3f}\n", angle(generator),
+                            angle(generator) * 0.5 - 90.0, distance(generator));
+        text += fmt::format("    SpectralType \"G2V\"\n    AppMag {:.2f}\n", magnitude(generator));
+        text += fmt::format("    Radius {:.1f}\n    RotationPeriod {:.4f}\n    Temperature {}\n}}\n\n",
+                            distance(generator) * 100.0, magnitude(generator) + 20.0, 3000 + i % 7000);
+    }
+
+    numbers = stars * 8;
+    return text;
+}
+
+
+template<typename T, typename... Args>
+double
+measureFromChars(std::string_view text, Args... args)
+{
+    // Keep the results alive, so that the calls can't be optimized away
+    T sink{};
+    const char* ptr = text.data();
+    const char* end = text.data() + text.size();
+    auto start = std::chrono::steady_clock::now();
+    while (ptr < end)
+    {
+        T value;
+        auto result = celestia::compat::from_chars(ptr, end, value, args...);
+        if (result.ec != std::errc{})
+            break;
+        sink += value;
+        ptr = result.ptr + 1;
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    if (sink == T(0.125))
+        std::fputc(' ', stderr);
+    return elapsed / static_cast<double>(count);
+}
+
+
+double
+measureTokenizer(std::string_view text, int numbers)
+{
+    double sink = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    Tokenizer tokenizer(text);
+    for (;;)
+    {
+        Tokenizer::TokenType type = tokenizer.nextToken();
+        if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+            break;
+        if (type == Tokenizer::TokenNumber)
+            sink += *tokenizer.getNumberValue();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    if (sink == 0.125)
+        std::fputc(' ', stderr);
+    return elapsed / static_cast<double>(numbers);
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+    celestia::util::CreateLogger(celestia::util::Level::Warning);
+
+    std::string integers = makeNumbers([](std::mt19937_64& g)
+    {
+        return fmt::format("{}", g() % 1000000000);
+    });
+    std::string decimals = makeNumbers([](std::mt19937_64& g)
+    {
+        return fmt::format("{:.6f}", std::uniform_real_distribution<double>(-360.0, 360.0)(g));
+    });
+    std::string exponents = makeNumbers([](std::mt19937_64& g)
+    {
+        return fmt::format("{:.8e}", std::uniform_real_distribution<double>(1.0e-10, 1.0e10)(g));
+    });
+    std::string longDecimals = makeNumbers([](std::mt19937_64& g)
+    {
+        return fmt::format("{:.17g}", std::uniform_real_distribution<double>(0.0, 1.0)(g));
+    });
+
+    std::vector<Result> results;
+    results.push_back(Result{ "integer", measureFromChars<std::uint32_t>(integers) });
+    results.push_back(Result{ "decimal-float", measureFromChars<float>(decimals) });
+    results.push_back(Result{ "decimal-double", measureFromChars<double>(decimals) });
+    results.push_back(Result{ "exponent-double", measureFromChars<double>(exponents) });
+    results.push_back(Result{ "17-digit-double", measureFromChars<double>(longDecimals) });
+
+    int numbers = 0;
+    std::string catalog = makeStarCatalog(numbers);
+    results.push_back(Result{ "tokenizer-stc", measureTokenizer(catalog, numbers) });
+
+    std::FILE* out = stdout;
+    if (!outputFilename.empty())
+    {
+        out = std::fopen(outputFilename.string().c_str(), "w");
+        if (out == nullptr)
+        {
+            GetLogger()->error("Can't open {} for writing\n", outputFilename);
+            return 1;
+        }
+    }
+
+    fmt::print(out, "{{\n");
+    fmt::print(out, "  \"count\": {},\n", count);
+    fmt::print(out, "  \"results\": [");
+    const char* separator = "\n";
+    for (const Result& result : results)
+    {
+        fmt::print(out, "{}    {{ \"name\": \"{}\", \"nsPerNumber\": {:.2f} }}",
+                   separator, result.name, result.nsPerNumber);
+        separator = ",\n";
+    }
+    fmt::print(out, "\n  ]\n}}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+
+    return 0;
+}
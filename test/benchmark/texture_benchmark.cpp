@@ -0,0 +1,498 @@
+// texture_benchmark.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measures how fast textures of each image format are decoded, prepared
+// for upload and uploaded, and writes the results as JSON.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/format.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef CELESTIA_BENCHMARK_EGL
+#include <epoxy/egl.h>
+#endif
+
+#include <celcompat/filesystem.h>
+#include <celengine/glsupport.h>
+#include <celengine/texmanager.h>
+#include <celengine/texture.h>
+#include <celimage/image.h>
+#include <celutil/filetype.h>
+#include <celutil/logger.h>
+
+using celestia::engine::Image;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+enum class Format
+{
+    JPEG,
+    PNG,
+    AVIF,
+    DDS,
+    VirtualTile,
+    Count,
+};
+
+constexpr std::array<std::string_view, static_cast<std::size_t>(Format::Count)> formatNames
+{
+    "jpeg", "png", "avif", "dds", "vt-tile",
+};
+
+struct CorpusFile
+{
+    fs::path path;
+    Format format;
+    std::uintmax_t size;
+};
+
+struct FormatResult
+{
+    int files{ 0 };
+    int failures{ 0 };
+    std::uintmax_t fileBytes{ 0 };
+    std::uintmax_t decodedBytes{ 0 };
+    double decodeSeconds{ 0.0 };
+    double prepareSeconds{ 0.0 };
+    std::optional<double> uploadSeconds;
+    std::uintmax_t peakRss{ 0 };
+};
+
+std::vector<fs::path> inputPaths;
+fs::path outputFilename;
+int iterations = 1;
+int sizeLimit = 0;
+bool measureUpload = false;
+
+
+void usage()
+{
+    std::cerr << "Usage: texture_benchmark [options] <directory or image file>...\n";
+    std::cerr << "   --iterations (or -n) <count> : number of times each file is loaded (default 1)\n";
+    std::cerr << "   --size-limit (or -s) <size>  : reduce textures larger than size while decoding\n";
+    std::cerr << "   --output (or -o) <file>      : write the JSON results to file instead of stdout\n";
+#ifdef CELESTIA_BENCHMARK_EGL
+    std::cerr << "   --upload (or -u)             : measure uploads in a headless EGL context\n";
+#endif
+    std::cerr << "Directories are searched recursively. Tiles of virtual textures are the\n";
+    std::cerr << "images in level<N> directories whose names start with tx_.\n";
+}
+
+
+bool parseInt(const char* arg, int& value, int minimum)
+{
+    char* end = nullptr;
+    long parsed = std::strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || parsed < minimum || parsed > INT32_MAX)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-')
+        {
+            inputPaths.emplace_back(argv[i]);
+        }
+        else if (!std::strcmp(argv[i], "-n") || !std::strcmp(argv[i], "--iterations"))
+        {
+            if (i + 1 == argc || !parseInt(argv[++i], iterations, 1))
+                return false;
+        }
+        else if (!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--size-limit"))
+        {
+            if (i + 1 == argc || !parseInt(argv[++i], sizeLimit, 0))
+                return false;
+        }
+        else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output"))
+        {
+            if (i + 1 == argc)
+                return false;
+            outputFilename = argv[++i];
+        }
+#ifdef CELESTIA_BENCHMARK_EGL
+        else if (!std::strcmp(argv[i], "-u") || !std::strcmp(argv[i], "--upload"))
+        {
+            measureUpload = true;
+        }
+#endif
+        else
+        {
+            return false;
+        }
+    }
+
+    return !inputPaths.empty();
+}
+
+
+bool isVirtualTile(const fs::path& path)
+{
+    return path.filename().string().compare(0, 3, "tx_") == 0 &&
+           path.parent_path().filename().string().compare(0, 5, "level") == 0;
+}
+
+
+std::optional<Format> classify(const fs::path& path)
+{
+    std::optional<Format> format;
+    switch (DetermineFileType(path))
+    {
+    case ContentType::JPEG:
+        format = Format::JPEG;
+        break;
+    case ContentType::PNG:
+        format = Format::PNG;
+        break;
+#ifdef USE_LIBAVIF
+    case ContentType::AVIF:
+        format = Format::AVIF;
+        break;
+#endif
+    case ContentType::DDS:
+    case ContentType::DXT5NormalMap:
+        format = Format::DDS;
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    return isVirtualTile(path) ? Format::VirtualTile : format;
+}
+
+
+void addFile(std::vector<CorpusFile>& corpus, const fs::path& path)
+{
+    auto format = classify(path);
+    if (!format.has_value())
+        return;
+
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec)
+    {
+        GetLogger()->error("Can't get size of {}: {}\n", path, ec.message());
+        return;
+    }
+
+    corpus.push_back(CorpusFile{ path, *format, size });
+}
+
+
+std::vector<CorpusFile> collectCorpus()
+{
+    std::vector<CorpusFile> corpus;
+    for (const fs::path& input : inputPaths)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(input, ec))
+        {
+            addFile(corpus, input);
+            continue;
+        }
+
+        for (auto iter = fs::recursive_directory_iterator(input, ec); iter != end(iter); iter.increment(ec))
+        {
+            if (ec)
+                break;
+            if (iter->is_regular_file(ec))
+                addFile(corpus, iter->path());
+        }
+
+        if (ec)
+            GetLogger()->error("Can't read directory {}: {}\n", input, ec.message());
+    }
+
+    return corpus;
+}
+
+
+// High water mark of the resident set size of the process in bytes
+std::uintmax_t peakRss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<std::uintmax_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::uintmax_t>(usage.ru_maxrss) * 1024U;
+#endif
+#endif
+}
+
+
+double elapsedSeconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+#ifdef CELESTIA_BENCHMARK_EGL
+// Creates a context with a small pbuffer surface, no window system is needed
+bool createGLContext()
+{
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        return false;
+
+#ifdef GL_ES
+    constexpr EGLint renderableType = EGL_OPENGL_ES2_BIT;
+    constexpr EGLenum api = EGL_OPENGL_ES_API;
+#else
+    constexpr EGLint renderableType = EGL_OPENGL_BIT;
+    constexpr EGLenum api = EGL_OPENGL_API;
+#endif
+
+    const std::array<EGLint, 13> configAttribs
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, renderableType,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE,
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs.data(), &config, 1, &configCount) || configCount == 0)
+        return false;
+
+    const std::array<EGLint, 5> surfaceAttribs{ EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs.data());
+    if (surface == EGL_NO_SURFACE || !eglBindAPI(api))
+        return false;
+
+#ifdef GL_ES
+    const std::array<EGLint, 3> contextAttribs{ EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs.data());
+#else
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+#endif
+    if (context == EGL_NO_CONTEXT)
+        return false;
+
+    return eglMakeCurrent(display, surface, surface, context) && celestia::gl::init();
+}
+#endif
+
+
+void benchmarkFile(const CorpusFile& file, FormatResult& result)
+{
+    TextureInfo info(file.path, TextureInfo::WrapTexture);
+    for (int i = 0; i < iterations; ++i)
+    {
+        // Decoding only
+        auto start = std::chrono::steady_clock::now();
+        auto image = Image::load(file.path, sizeLimit);
+        result.decodeSeconds += elapsedSeconds(start);
+        if (image == nullptr)
+        {
+            ++result.failures;
+            return;
+        }
+
+        result.fileBytes += file.size;
+        result.decodedBytes += static_cast<std::uintmax_t>(image->getSize());
+        image.reset();
+
+        // Decoding and the work done on the loader threads: mipmap
+        // generation and the texture cache
+        start = std::chrono::steady_clock::now();
+        PreparedTexture prepared = info.prepare(file.path);
+        result.prepareSeconds += elapsedSeconds(start);
+
+        if (!measureUpload)
+            continue;
+
+        start = std::chrono::steady_clock::now();
+        auto texture = info.finish(file.path, std::move(prepared));
+        glFinish();
+        result.uploadSeconds = result.uploadSeconds.value_or(0.0) + elapsedSeconds(start);
+    }
+}
+
+
+std::string
+escapeJSON(std::string_view s)
+{
+    std::string result;
+    result.reserve(s.size());
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':  result.append("\\\""); break;
+        case '\\': result.append("\\\\"); break;
+        case '\n': result.append("\\n"); break;
+        case '\t': result.append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                result.append(fmt::format("\\u{:04x}", static_cast<unsigned int>(c)));
+            else
+                result.push_back(c);
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+std::string formatRate(std::uintmax_t bytes, std::optional<double> seconds)
+{
+    if (!seconds.has_value() || *seconds <= 0.0)
+        return "null";
+    return fmt::format("{:.3f}", static_cast<double>(bytes) / 1.0e6 / *seconds);
+}
+
+
+std::string formatSeconds(std::optional<double> seconds)
+{
+    return seconds.has_value() ? fmt::format("{:.6f}", *seconds) : std::string("null");
+}
+
+
+void writeResults(std::FILE* out, const std::vector<FormatResult>& results)
+{
+    fmt::print(out, "{{\n");
+    fmt::print(out, "  \"iterations\": {},\n", iterations);
+    fmt::print(out, "  \"sizeLimit\": {},\n", sizeLimit);
+    fmt::print(out, "  \"inputs\": [");
+    for (std::size_t i = 0; i < inputPaths.size(); ++i)
+        fmt::print(out, "{}\"{}\"", i == 0 ? "" : ", ", escapeJSON(inputPaths[i].string()));
+    fmt::print(out, "],\n");
+    fmt::print(out, "  \"formats\": [");
+
+    const char* separator = "\n";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const FormatResult& result = results[i];
+        if (result.files == 0)
+            continue;
+
+        fmt::print(out, "{}    {{\n", separator);
+        fmt::print(out, "      \"format\": \"{}\",\n", formatNames[i]);
+        fmt::print(out, "      \"files\": {},\n", result.files);
+        fmt::print(out, "      \"failures\": {},\n", result.failures);
+        fmt::print(out, "      \"fileBytes\": {},\n", result.fileBytes);
+        fmt::print(out, "      \"decodedBytes\": {},\n", result.decodedBytes);
+        fmt::print(out, "      \"decodeSeconds\": {},\n", formatSeconds(result.decodeSeconds));
+        // Throughput in MB of input files per second
+        fmt::print(out, "      \"decodeMBps\": {},\n", formatRate(result.fileBytes, result.decodeSeconds));
+        fmt::print(out, "      \"prepareSeconds\": {},\n", formatSeconds(result.prepareSeconds));
+        fmt::print(out, "      \"prepareMBps\": {},\n", formatRate(result.fileBytes, result.prepareSeconds));
+        fmt::print(out, "      \"uploadSeconds\": {},\n", formatSeconds(result.uploadSeconds));
+        fmt::print(out, "      \"uploadMBps\": {},\n", formatRate(result.decodedBytes, result.uploadSeconds));
+        fmt::print(out, "      \"peakRssBytes\": {}\n", result.peakRss);
+        fmt::print(out, "    }}");
+        separator = ",\n";
+    }
+
+    fmt::print(out, "\n  ]\n}}\n");
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+    celestia::util::CreateLogger(celestia::util::Level::Warning);
+
+#ifdef CELESTIA_BENCHMARK_EGL
+    if (measureUpload && !createGLContext())
+    {
+        GetLogger()->error("Can't create an EGL context\n");
+        return 1;
+    }
+#endif
+
+    std::vector<CorpusFile> corpus = collectCorpus();
+    if (corpus.empty())
+    {
+        GetLogger()->error("No images found\n");
+        return 1;
+    }
+
+    SetTextureSizeLimit(sizeLimit);
+
+    // Formats are benchmarked one after another. The peak RSS of a format
+    // is the high water mark after its files, so it includes the formats
+    // benchmarked before it.
+    std::vector<FormatResult> results(static_cast<std::size_t>(Format::Count));
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        FormatResult& result = results[i];
+        for (const CorpusFile& file : corpus)
+        {
+            if (static_cast<std::size_t>(file.format) != i)
+                continue;
+            ++result.files;
+            benchmarkFile(file, result);
+        }
+
+        result.peakRss = peakRss();
+    }
+
+    std::FILE* out = stdout;
+    if (!outputFilename.empty())
+    {
+        out = std::fopen(outputFilename.string().c_str(), "w");
+        if (out == nullptr)
+        {
+            GetLogger()->error("Can't open {} for writing\n", outputFilename);
+            return 1;
+        }
+    }
+
+    writeResults(out, results);
+    if (out != stdout)
+        std::fclose(out);
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <cstdint>
 #include <memory>
+#include <utility>
 
 #include <doctest.h>
 
@@ -38,4 +39,28 @@ TEST_CASE("Load a 3DS file")
     REQUIRE(vertexCount == 3263);
 }
 
+TEST_CASE("Stream a 3DS file")
+{
+    struct Counter : M3DSceneHandler
+    {
+        void material(M3DMaterial&&) override { ++materialCount; }
+        void model(M3DModel&& model) override
+        {
+            for (std::uint32_t i = 0; i < model.getTriMeshCount(); ++i)
+                faceCount += static_cast<std::uint32_t>(model.getTriMesh(i)->getFaceCount());
+            ++modelCount;
+        }
+
+        std::uint32_t materialCount{ 0 };
+        std::uint32_t modelCount{ 0 };
+        std::uint32_t faceCount{ 0 };
+    };
+
+    Counter counter;
+    REQUIRE(Read3DSFile("huygens.3ds", counter));
+    REQUIRE(counter.materialCount == 4);
+    REQUIRE(counter.modelCount == 8);
+    REQUIRE(counter.faceCount == 6098);
+}
+
 TEST_SUITE_END();
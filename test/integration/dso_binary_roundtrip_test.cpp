@@ -0,0 +1,97 @@
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <doctest.h>
+
+#include <celengine/dsodb.h>
+#include <celengine/dsoname.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+
+namespace
+{
+
+constexpr const char* textCatalog = R"(
+Galaxy "M 31:NGC 224:Andromeda Galaxy"
+{
+    Type "Sb"
+    RA 0.7123
+    Dec 41.2689
+    Distance 2.5e6
+    Radius 1.1e5
+    Axis [ -0.3 0.9 0.2 ]
+    Angle 120.0
+    AbsMag -21.5
+    InfoURL "https://example.org/m31"
+}
+
+Globular "M 13:NGC 6205"
+{
+    RA 16.6949
+    Dec 36.4613
+    Distance 22200
+    Radius 84
+    CoreRadius 0.62
+    KingConcentration 1.53
+    AbsMag -8.55
+}
+
+OpenCluster "M 45:Pleiades"
+{
+    RA 3.7833
+    Dec 24.1167
+    Distance 444
+    Radius 8.6
+    Visible false
+}
+)";
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("DSO integration");
+
+TEST_CASE("DSO text to binary roundtrip")
+{
+    DSODatabase textDB;
+    textDB.setNameDatabase(std::make_unique<DSONameDatabase>());
+    std::istringstream textData(textCatalog);
+    REQUIRE(textDB.load(textData));
+    REQUIRE(textDB.size() == 3);
+
+    std::istringstream converterInput(textCatalog);
+    std::stringstream binaryData(std::ios::in | std::ios::out | std::ios::binary);
+    REQUIRE(DSODatabase::convertToBinary(converterInput, binaryData));
+
+    DSODatabase binaryDB;
+    binaryDB.setNameDatabase(std::make_unique<DSONameDatabase>());
+    REQUIRE(binaryDB.load(binaryData));
+    REQUIRE(binaryDB.size() == textDB.size());
+
+    for (std::uint32_t i = 0; i < textDB.size(); ++i)
+    {
+        const DeepSkyObject* expected = textDB.getDSO(i);
+        const DeepSkyObject* actual = binaryDB.getDSO(i);
+        REQUIRE(actual->getObjType() == expected->getObjType());
+        REQUIRE(actual->getIndex() == expected->getIndex());
+        REQUIRE(actual->getPosition() == expected->getPosition());
+        REQUIRE(actual->getOrientation().coeffs() == expected->getOrientation().coeffs());
+        REQUIRE(actual->getRadius() == expected->getRadius());
+        REQUIRE(actual->getBoundingSphereRadius() == expected->getBoundingSphereRadius());
+        REQUIRE(actual->getAbsoluteMagnitude() == expected->getAbsoluteMagnitude());
+        REQUIRE(actual->getInfoURL() == expected->getInfoURL());
+        REQUIRE(actual->isVisible() == expected->isVisible());
+        REQUIRE(actual->isClickable() == expected->isClickable());
+        REQUIRE(binaryDB.getDSONameList(actual) == textDB.getDSONameList(expected));
+    }
+
+    const auto* galaxy = static_cast<const Galaxy*>(binaryDB.getDSO(0));
+    REQUIRE(galaxy->getGalaxyType() == GalaxyType::Sb);
+    REQUIRE(galaxy->getFormId() == static_cast<const Galaxy*>(textDB.getDSO(0))->getFormId());
+
+    const auto* globular = static_cast<const Globular*>(binaryDB.getDSO(1));
+    REQUIRE(globular->getFormId() == static_cast<const Globular*>(textDB.getDSO(1))->getFormId());
+    REQUIRE(globular->getHalfMassRadius() == static_cast<const Globular*>(textDB.getDSO(1))->getHalfMassRadius());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/angularindex.h>
+
+#include <doctest.h>
+
+using celestia::engine::AngularIndex;
+
+TEST_SUITE_BEGIN("AngularIndex");
+
+TEST_CASE("AngularIndex finds the directions within the angle")
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<float> normal;
+    auto randomDirection = [&]() { return Eigen::Vector3f(normal(rng), normal(rng), normal(rng)).normalized(); };
+
+    std::vector<Eigen::Vector3f> directions;
+    for (int i = 0; i < 20000; ++i)
+        directions.push_back(randomDirection());
+    // Directions at the poles and on the longitude seam
+    directions.emplace_back(0.0f, 0.0f, 1.0f);
+    directions.emplace_back(0.0f, 0.0f, -1.0f);
+    directions.emplace_back(-1.0f, 0.0f, 0.0f);
+
+    AngularIndex index;
+    index.build(directions);
+    REQUIRE(index.size() == directions.size());
+
+    std::vector<Eigen::Vector3f> queries{ Eigen::Vector3f(0.0f, 0.001f, 0.99999f).normalized(),
+                                          Eigen::Vector3f(-1.0f, -0.001f, 0.0f).normalized() };
+    for (int i = 0; i < 200; ++i)
+        queries.push_back(randomDirection());
+
+    for (float angle : { 0.001f, 0.02f, 0.1f })
+    {
+        for (const Eigen::Vector3f& query : queries)
+        {
+            std::vector<bool> found(directions.size(), false);
+            index.query(query, angle, [&](std::uint32_t i) { found[i] = true; });
+            for (std::size_t i = 0; i < directions.size(); ++i)
+            {
+                if (std::acos(std::clamp(directions[i].dot(query), -1.0f, 1.0f)) < angle * 0.999f)
+                    REQUIRE(found[i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("AngularIndex looks through few cells for small angles")
+{
+    std::vector<Eigen::Vector3f> directions{ Eigen::Vector3f::UnitX(), -Eigen::Vector3f::UnitX() };
+    AngularIndex index;
+    index.build(directions);
+
+    std::vector<std::uint32_t> found;
+    index.query(Eigen::Vector3f::UnitX(), 0.001f, [&](std::uint32_t i) { found.push_back(i); });
+    REQUIRE(found == std::vector<std::uint32_t>{ 0 });
+
+    index.clear();
+    REQUIRE(index.empty());
+}
+
+TEST_SUITE_END();
@@ -1,3 +1,6 @@
+#include <cstddef>
+#include <vector>
+
 #include <doctest.h>
 
 #include <celengine/category.h>
@@ -224,4 +227,67 @@ TEST_CASE("Objects in categories")
     }
 }
 
+TEST_CASE("Category member sets")
+{
+    UserCategoryManager manager;
+    auto fooId = manager.create("foo", UserCategoryId::Invalid, {});
+    auto barId = manager.create("bar", UserCategoryId::Invalid, {});
+
+    std::vector<Star> stars(200);
+    for (std::size_t i = 0; i < stars.size(); ++i)
+    {
+        if (i % 2 == 0)
+            REQUIRE(manager.addObject(Selection(&stars[i]), fooId));
+        if (i % 3 == 0)
+            REQUIRE(manager.addObject(Selection(&stars[i]), barId));
+    }
+
+    const CategoryMembers* foo = manager.getMembers(fooId);
+    const CategoryMembers* bar = manager.getMembers(barId);
+    REQUIRE(foo != nullptr);
+    REQUIRE(bar != nullptr);
+    REQUIRE(foo->count() == 100);
+    REQUIRE(bar->count() == 67);
+
+    SUBCASE("Intersection")
+    {
+        CategoryMembers both = *foo;
+        both &= *bar;
+        auto objects = manager.getObjects(both);
+        REQUIRE(objects.size() == 34);
+        for (const Selection& sel : objects)
+            REQUIRE((sel.star() - stars.data()) % 6 == 0);
+    }
+
+    SUBCASE("Difference")
+    {
+        CategoryMembers fooOnly = *foo;
+        fooOnly -= *bar;
+        REQUIRE(fooOnly.count() == 66);
+        REQUIRE(!fooOnly.test(*manager.getObjectId(Selection(&stars[6]))));
+        REQUIRE(fooOnly.test(*manager.getObjectId(Selection(&stars[4]))));
+    }
+
+    SUBCASE("Active categories")
+    {
+        REQUIRE(manager.getActiveMembers().count() == 133);
+    }
+
+    SUBCASE("Ids of removed objects are reused")
+    {
+        auto id = manager.getObjectId(Selection(&stars[0]));
+        REQUIRE(id.has_value());
+        manager.clearCategories(Selection(&stars[0]));
+        REQUIRE(!manager.getObjectId(Selection(&stars[0])).has_value());
+        REQUIRE(!foo->test(*id));
+        REQUIRE(!bar->test(*id));
+
+        Star star;
+        REQUIRE(manager.addObject(Selection(&star), barId));
+        REQUIRE(manager.getObjectId(Selection(&star)) == id);
+        REQUIRE(manager.isInCategory(Selection(&star), barId));
+        REQUIRE(!manager.isInCategory(Selection(&star), fooId));
+    }
+}
+
 TEST_SUITE_END();
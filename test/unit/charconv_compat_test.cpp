@@ -1,9 +1,13 @@
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <string>
 #include <system_error>
+#include <type_traits>
 
 #include <celcompat/charconv.h>
 
@@ -88,6 +92,56 @@ TEST_CASE_TEMPLATE("Floating point general format: successful", TestType, float,
     }
 }
 
+TEST_CASE_TEMPLATE("Floating point general format: correctly rounded", TestType, float, double)
+{
+    // Numbers on either side of the limits of exact parsing without strtod
+    const char* examples[] = {
+        "0.1", "0.3", "4.35", "-2.675", "3.14159265358979", "0.000123456",
+        "16777216", "16777217", "16777219", "9007199254740992", "9007199254740993",
+        "123456789012345678", "1234567890123456789012", "1e10", "1e11", "1e22", "1e23",
+        "1.5e-10", "1.5e-11", "7e-22", "7e-23", "6.02214076e23", "1.602176634e-19",
+        "0.00000000000000000000000000001", "3.4e38", "1.2e-37",
+    };
+
+    for (const char* example : examples)
+    {
+        TestType actual;
+        auto result = compat::from_chars(example, example + std::strlen(example), actual, compat::chars_format::general);
+        REQUIRE(result.ec == std::errc{});
+        REQUIRE(result.ptr == example + std::strlen(example));
+
+        char* end;
+        TestType expected;
+        if constexpr (std::is_same_v<TestType, float>)
+            expected = std::strtof(example, &end);
+        else
+            expected = std::strtod(example, &end);
+        REQUIRE(actual == expected);
+    }
+
+    // Catalog-like values with various numbers of digits
+    std::uint32_t state = 1;
+    for (int i = 0; i < 10000; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        std::string text = std::to_string(state % 2000000u) + "." + std::to_string(state / 2000000u % 1000u);
+        if (i % 3 == 0)
+            text += "e" + std::to_string(static_cast<int>(state % 41u) - 20);
+
+        TestType actual;
+        auto result = compat::from_chars(text.data(), text.data() + text.size(), actual, compat::chars_format::general);
+        REQUIRE(result.ec == std::errc{});
+
+        char* end;
+        TestType expected;
+        if constexpr (std::is_same_v<TestType, float>)
+            expected = std::strtof(text.c_str(), &end);
+        else
+            expected = std::strtod(text.c_str(), &end);
+        REQUIRE(actual == expected);
+    }
+}
+
 TEST_CASE_TEMPLATE("Floating point general format: negative zero", TestType, float, double, long double)
 {
     TestCase<TestType> examples[] = {
@@ -0,0 +1,37 @@
+#include <string>
+
+#include <celestia/clusterframe.h>
+
+#include <doctest.h>
+
+using celestia::ClusterFrame;
+
+TEST_SUITE_BEGIN("ClusterFrame");
+
+TEST_CASE("Cluster frames are decoded as they were encoded")
+{
+    ClusterFrame frame;
+    frame.number = 12345;
+    frame.tdb = 2451545.123456789;
+    frame.url = "cel://Follow/Sol:Earth/2000-01-01T14:57:46.87813?x=AAAA&y=AAAA&z=AAAA";
+    frame.faintestVisible = 6.5f;
+    frame.ambientLight = 0.1f;
+    frame.orbitMask = 0x8ff;
+    frame.starStyle = 2;
+
+    std::string data = frame.encode();
+    auto decoded = ClusterFrame::decode(data);
+    REQUIRE(decoded.has_value());
+    REQUIRE(decoded->number == frame.number);
+    REQUIRE(decoded->tdb == frame.tdb);
+    REQUIRE(decoded->url == frame.url);
+    REQUIRE(decoded->faintestVisible == frame.faintestVisible);
+    REQUIRE(decoded->ambientLight == frame.ambientLight);
+    REQUIRE(decoded->orbitMask == frame.orbitMask);
+    REQUIRE(decoded->starStyle == frame.starStyle);
+
+    REQUIRE_FALSE(ClusterFrame::decode(data.substr(0, data.size() - 1)).has_value());
+    REQUIRE_FALSE(ClusterFrame::decode("CELCLSTX").has_value());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <celutil/concurrentblockarray.h>
+
+#include <doctest.h>
+
+TEST_SUITE_BEGIN("ConcurrentBlockArray");
+
+TEST_CASE("Elements keep their order and address")
+{
+    ConcurrentBlockArray<int> array(4);
+    std::vector<int*> addresses;
+    for (int i = 0; i < 10; ++i)
+        addresses.push_back(array.add(i));
+
+    REQUIRE(array.size() == 10);
+    for (int i = 0; i < 10; ++i)
+        REQUIRE(*addresses[i] == i);
+
+    std::vector<int> values;
+    array.forEach([&](int value) { values.push_back(value); });
+    REQUIRE(values == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+
+    array.clear();
+    REQUIRE(array.size() == 0);
+    REQUIRE(*array.add(42) == 42);
+    REQUIRE(array.size() == 1);
+}
+
+TEST_CASE("Appenders reserving up front keep the order of creation")
+{
+    ConcurrentBlockArray<int> array(4);
+    ConcurrentBlockArray<int>::Appender first(array, 3);
+    ConcurrentBlockArray<int>::Appender second(array, 3);
+    for (int i = 0; i < 5; ++i)
+        second.add(100 + i);
+    for (int i = 0; i < 10; ++i)
+        first.add(i);
+
+    std::vector<int> values;
+    array.forEach([&](int value) { values.push_back(value); });
+    REQUIRE(values == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 100, 101, 102, 103, 104 });
+}
+
+TEST_CASE("Adding fails when the block table is full")
+{
+    ConcurrentBlockArray<int> array(2, 2);
+    ConcurrentBlockArray<int>::Appender appender(array);
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(appender.add(i) != nullptr);
+    REQUIRE(appender.add(4) == nullptr);
+    REQUIRE(array.add(5) == nullptr);
+    REQUIRE(array.size() == 4);
+}
+
+TEST_CASE("Threads append concurrently")
+{
+    constexpr int ThreadCount = 4;
+    constexpr int PerThread = 10000;
+    ConcurrentBlockArray<int> array(100);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadCount; ++t)
+    {
+        threads.emplace_back([&array, t]
+        {
+            ConcurrentBlockArray<int>::Appender appender(array);
+            for (int i = 0; i < PerThread; ++i)
+                appender.add(t * PerThread + i);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(array.size() == ThreadCount * PerThread);
+    std::vector<int> values;
+    array.forEach([&](int value) { values.push_back(value); });
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i < ThreadCount * PerThread; ++i)
+        REQUIRE(values[i] == i);
+}
+
+TEST_SUITE_END();
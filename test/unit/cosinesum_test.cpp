@@ -0,0 +1,63 @@
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <celmath/cosinesum.h>
+
+#include <doctest.h>
+
+using celestia::math::CosineSumMaxArgument;
+using celestia::math::SumCosines;
+
+TEST_SUITE_BEGIN("SumCosines");
+
+TEST_CASE("SumCosines evaluates single terms")
+{
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<double> dist(-CosineSumMaxArgument, CosineSumMaxArgument);
+    for (int i = 0; i < 10000; ++i)
+    {
+        double x = dist(rng);
+        if (i % 2 == 0)
+            x *= 1.0e-5;
+        double a = 1.0;
+        double c = 0.0;
+        REQUIRE(std::abs(SumCosines(&a, &x, &c, 1, 0.0) - std::cos(x)) <= 1.0e-15);
+    }
+}
+
+TEST_CASE("SumCosines matches the scalar series")
+{
+    std::mt19937 rng(87);
+    std::uniform_real_distribution<double> amplitude(-1.0, 1.0);
+    std::uniform_real_distribution<double> phase(0.0, 6.28);
+    std::uniform_real_distribution<double> frequency(0.0, 200000.0);
+
+    // Cover the remainder of each group of terms
+    for (std::size_t n = 0; n < 40; ++n)
+    {
+        std::vector<double> A(n);
+        std::vector<double> B(n);
+        std::vector<double> C(n);
+        double scale = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            A[i] = amplitude(rng);
+            B[i] = phase(rng);
+            C[i] = frequency(rng);
+            scale += std::abs(A[i]);
+        }
+
+        for (double t : { 0.0, 0.0137, -1.5, 6.0 })
+        {
+            double expected = 0.0;
+            for (std::size_t i = 0; i < n; ++i)
+                expected += A[i] * std::cos(B[i] + C[i] * t);
+
+            REQUIRE(std::abs(SumCosines(A.data(), B.data(), C.data(), n, t) - expected) <= 1.0e-15 * scale);
+        }
+    }
+}
+
+TEST_SUITE_END();
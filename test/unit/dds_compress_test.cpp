@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+
+#include <celimage/dds_compress.h>
+#include <celimage/dds_decompress.h>
+#include <celimage/image.h>
+
+#include <doctest.h>
+
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+
+namespace
+{
+
+int
+maxError(const std::array<std::uint8_t, 64>& pixels, const std::array<std::uint32_t, 16>& decoded, int channels)
+{
+    int error = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            int value = static_cast<int>((decoded[i] >> (8 * c)) & 0xff);
+            error = std::max(error, std::abs(value - pixels[i * 4 + c]));
+        }
+    }
+    return error;
+}
+
+std::array<std::uint8_t, 64>
+gradientBlock()
+{
+    std::array<std::uint8_t, 64> pixels;
+    for (int i = 0; i < 16; ++i)
+    {
+        pixels[i * 4]     = static_cast<std::uint8_t>(40 + i * 8);
+        pixels[i * 4 + 1] = static_cast<std::uint8_t>(200 - i * 4);
+        pixels[i * 4 + 2] = static_cast<std::uint8_t>(100 + i * 2);
+        pixels[i * 4 + 3] = static_cast<std::uint8_t>(255 - i * 15);
+    }
+    return pixels;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("DDS compression");
+
+TEST_CASE("DXT1 block roundtrip")
+{
+    auto pixels = gradientBlock();
+    std::array<std::uint8_t, 8> block;
+    celestia::engine::CompressBlockDXT1(pixels.data(), block.data());
+
+    std::array<std::uint32_t, 16> decoded;
+    celestia::engine::DecompressBlockDXT1(0, 0, 4, block.data(), false, decoded.data());
+    REQUIRE(maxError(pixels, decoded, 3) <= 24);
+}
+
+TEST_CASE("DXT5 block roundtrip")
+{
+    auto pixels = gradientBlock();
+    std::array<std::uint8_t, 16> block;
+    celestia::engine::CompressBlockDXT5(pixels.data(), block.data());
+
+    std::array<std::uint32_t, 16> decoded;
+    celestia::engine::DecompressBlockDXT5(0, 0, 4, block.data(), false, decoded.data());
+    REQUIRE(maxError(pixels, decoded, 4) <= 24);
+}
+
+TEST_CASE("Uniform block is exact")
+{
+    std::array<std::uint8_t, 64> pixels;
+    for (int i = 0; i < 16; ++i)
+    {
+        pixels[i * 4]     = 255;
+        pixels[i * 4 + 1] = 0;
+        pixels[i * 4 + 2] = 255;
+        pixels[i * 4 + 3] = 128;
+    }
+
+    std::array<std::uint8_t, 16> block;
+    celestia::engine::CompressBlockDXT5(pixels.data(), block.data());
+    std::array<std::uint32_t, 16> decoded;
+    celestia::engine::DecompressBlockDXT5(0, 0, 4, block.data(), false, decoded.data());
+    REQUIRE(maxError(pixels, decoded, 4) == 0);
+}
+
+TEST_CASE("Image compression")
+{
+    Image rgb(PixelFormat::RGB, 16, 8);
+    std::fill_n(rgb.getPixels(), rgb.getSize(), std::uint8_t(0x80));
+    auto dxt1 = celestia::engine::CompressImageDXT(rgb);
+    REQUIRE(dxt1 != nullptr);
+    REQUIRE(dxt1->getFormat() == PixelFormat::DXT1);
+    REQUIRE(dxt1->getWidth() == 16);
+    REQUIRE(dxt1->getHeight() == 8);
+    REQUIRE(dxt1->getMipLevelCount() == 5);
+
+    Image rgba(PixelFormat::RGBA, 8, 8);
+    REQUIRE(celestia::engine::CompressImageDXT(rgba)->getFormat() == PixelFormat::DXT5);
+
+    Image alpha(PixelFormat::Alpha, 8, 8);
+    REQUIRE(celestia::engine::CompressImageDXT(alpha) == nullptr);
+}
+
+TEST_SUITE_END();
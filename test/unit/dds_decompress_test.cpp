@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <celimage/dds_decompress.h>
+
+#include <doctest.h>
+
+using celestia::engine::PixelFormat;
+
+namespace
+{
+
+// Decompress block by block with the reference functions
+std::vector<std::uint32_t>
+referenceDecompress(PixelFormat format, std::uint32_t blocksWide, std::uint32_t blocksHigh,
+                    const std::vector<std::uint8_t>& blocks, bool transparent0)
+{
+    std::size_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    std::uint32_t width = blocksWide * 4;
+    std::vector<std::uint32_t> image(static_cast<std::size_t>(width) * blocksHigh * 4);
+    const std::uint8_t* block = blocks.data();
+    for (std::uint32_t y = 0; y < blocksHigh * 4; y += 4)
+    {
+        for (std::uint32_t x = 0; x < width; x += 4, block += blockSize)
+        {
+            switch (format)
+            {
+            case PixelFormat::DXT1:
+                celestia::engine::DecompressBlockDXT1(x, y, width, block, transparent0, image.data());
+                break;
+            case PixelFormat::DXT3:
+                celestia::engine::DecompressBlockDXT3(x, y, width, block, transparent0, image.data());
+                break;
+            default:
+                celestia::engine::DecompressBlockDXT5(x, y, width, block, transparent0, image.data());
+                break;
+            }
+        }
+    }
+    return image;
+}
+
+void
+checkFormat(PixelFormat format, std::uint32_t blocksWide, std::uint32_t blocksHigh, unsigned int maxThreads)
+{
+    std::size_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    std::vector<std::uint8_t> blocks(blocksWide * blocksHigh * blockSize);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (auto& b : blocks)
+        b = static_cast<std::uint8_t>(byte(rng));
+
+    // Include blocks with equal endpoints and opaque black pixels
+    for (std::size_t i = 0; i < blockSize; ++i)
+        blocks[i] = 0;
+
+    for (bool transparent0 : { false, true })
+    {
+        auto expected = referenceDecompress(format, blocksWide, blocksHigh, blocks, transparent0);
+        std::vector<std::uint32_t> actual(expected.size());
+        REQUIRE(celestia::engine::DecompressDXTc(format, blocksWide, blocksHigh, blocks.data(),
+                                                 transparent0, actual.data(), maxThreads));
+        REQUIRE(actual == expected);
+    }
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("DDS decompression");
+
+TEST_CASE("DXTc image decompression matches the block decoders")
+{
+    for (auto format : { PixelFormat::DXT1, PixelFormat::DXT3, PixelFormat::DXT5 })
+    {
+        checkFormat(format, 8, 4, 1);
+        // Enough rows of blocks to split the image between threads
+        checkFormat(format, 4, 300, 4);
+    }
+}
+
+TEST_CASE("Unsupported formats are rejected")
+{
+    std::uint8_t block[16] = {};
+    std::uint32_t image[16];
+    REQUIRE_FALSE(celestia::engine::DecompressDXTc(PixelFormat::RGBA, 1, 1, block, false, image));
+}
+
+TEST_SUITE_END();
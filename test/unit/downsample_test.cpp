@@ -0,0 +1,67 @@
+#include <cstdint>
+#include <cstring>
+
+#include <celimage/downsample.h>
+#include <celimage/image.h>
+
+#include <doctest.h>
+
+using celestia::engine::DownsampleFactor;
+using celestia::engine::DownsampleImage;
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+
+TEST_SUITE_BEGIN("Downsample");
+
+TEST_CASE("Downsample factor")
+{
+    REQUIRE(DownsampleFactor(4096, 2048, 0) == 1);
+    REQUIRE(DownsampleFactor(4096, 2048, 4096) == 1);
+    REQUIRE(DownsampleFactor(4096, 2048, 1024) == 4);
+    REQUIRE(DownsampleFactor(4097, 2048, 1024) == 4);
+    REQUIRE(DownsampleFactor(2048, 4100, 1000) == 8);
+}
+
+TEST_CASE("Downsample image")
+{
+    // Columns of 0, 40, 80 and 120 with odd rows twice as bright
+    Image img(PixelFormat::Luminance, 5, 3);
+    for (int y = 0; y < 3; ++y)
+    {
+        std::uint8_t* row = img.getPixelRow(y);
+        for (int x = 0; x < 5; ++x)
+            row[x] = static_cast<std::uint8_t>((x < 4 ? x * 40 : 125) * ((y & 1) + 1));
+    }
+
+    REQUIRE(DownsampleImage(img, 5) == nullptr);
+
+    // The last row and column are dropped
+    auto reduced = DownsampleImage(img, 2);
+    REQUIRE(reduced != nullptr);
+    REQUIRE(reduced->getWidth() == 2);
+    REQUIRE(reduced->getHeight() == 1);
+    REQUIRE(reduced->getMipLevelCount() == 1);
+    REQUIRE(reduced->getPixelRow(0)[0] == 30);
+    REQUIRE(reduced->getPixelRow(0)[1] == 150);
+}
+
+TEST_CASE("Downsample image with mipmaps")
+{
+    Image img(PixelFormat::DXT1, 16, 8, 5);
+    std::memset(img.getPixels(), 0, img.getSize());
+    img.getMipLevel(2)[0] = 42;
+
+    auto reduced = DownsampleImage(img, 4);
+    REQUIRE(reduced != nullptr);
+    REQUIRE(reduced->getFormat() == PixelFormat::DXT1);
+    REQUIRE(reduced->getWidth() == 4);
+    REQUIRE(reduced->getHeight() == 2);
+    REQUIRE(reduced->getMipLevelCount() == 3);
+    REQUIRE(reduced->getPixels()[0] == 42);
+
+    // Compressed images without enough mipmaps can't be reduced
+    REQUIRE(DownsampleImage(img, 0) == nullptr);
+    REQUIRE(DownsampleImage(Image(PixelFormat::DXT1, 16, 8), 4) == nullptr);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,57 @@
+#include <celengine/dynamicresolution.h>
+
+#include <doctest.h>
+
+using celestia::engine::DynamicResolution;
+
+TEST_SUITE_BEGIN("DynamicResolution");
+
+TEST_CASE("Frame times near the target keep the scale")
+{
+    DynamicResolution resolution;
+    resolution.setTargetFrameTime(16.0);
+    resolution.update(15.0);
+    REQUIRE(resolution.getScale() == 1.0f);
+    resolution.update(16.5);
+    REQUIRE(resolution.getScale() == 1.0f);
+}
+
+TEST_CASE("The scale falls in limited steps down to the minimum")
+{
+    DynamicResolution resolution;
+    resolution.setTargetFrameTime(16.0);
+    resolution.setMinScale(0.5f);
+
+    resolution.update(64.0);
+    REQUIRE(resolution.getScale() == doctest::Approx(0.9f));
+
+    for (int i = 0; i < 20; ++i)
+        resolution.update(64.0);
+    REQUIRE(resolution.getScale() == 0.5f);
+
+    // Halving the scale quarters the pixels, which holds 64 ms to 16 ms
+    DynamicResolution small;
+    small.setTargetFrameTime(16.0);
+    small.setMinScale(0.1f);
+    for (int i = 0; i < 20; ++i)
+        small.update(64.0 * small.getScale() * small.getScale());
+    REQUIRE(small.getScale() == doctest::Approx(0.5f).epsilon(0.05));
+}
+
+TEST_CASE("The scale rises back to full resolution")
+{
+    DynamicResolution resolution;
+    resolution.setTargetFrameTime(16.0);
+    for (int i = 0; i < 5; ++i)
+        resolution.update(32.0);
+    float low = resolution.getScale();
+    REQUIRE(low < 1.0f);
+
+    resolution.update(4.0);
+    REQUIRE(resolution.getScale() == doctest::Approx(low * 1.05f));
+    for (int i = 0; i < 50; ++i)
+        resolution.update(4.0);
+    REQUIRE(resolution.getScale() == 1.0f);
+}
+
+TEST_SUITE_END();
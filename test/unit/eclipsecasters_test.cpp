@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <random>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/eclipsecasters.h>
+
+#include <doctest.h>
+
+using celestia::engine::EclipseCaster;
+using celestia::engine::EclipseCasterSet;
+
+TEST_SUITE_BEGIN("EclipseCasters");
+
+TEST_CASE("Shadowed receivers are not culled by the set bound")
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> offset(-1.0e6, 1.0e6);
+    std::uniform_real_distribution<double> size(100.0, 3000.0);
+
+    const Eigen::Vector3d primary(7.8e8, 0.0, 0.0);
+    const Eigen::Vector3d light(0.0, 0.0, 0.0);
+    const double sunRadius = 7.0e5;
+
+    EclipseCasterSet set;
+    for (int i = 0; i < 50; ++i)
+    {
+        Eigen::Vector3d position = primary + Eigen::Vector3d(offset(rng), offset(rng), offset(rng) * 0.01);
+        set.casters.push_back({ nullptr, position, static_cast<float>(size(rng)) });
+    }
+
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    for (const EclipseCaster& caster : set.casters)
+        sum += caster.position;
+    set.center = sum / static_cast<double>(set.casters.size());
+    for (const EclipseCaster& caster : set.casters)
+        set.radius = std::max(set.radius, (caster.position - set.center).norm() + caster.radius);
+
+    int shadowed = 0;
+    int culled = 0;
+    for (int i = 0; i < 2000; ++i)
+    {
+        // Receivers spread over a larger region than the casters, including
+        // some placed right behind a caster
+        Eigen::Vector3d receiver = primary + Eigen::Vector3d(offset(rng), offset(rng), offset(rng)) * 3.0;
+        if (i % 4 == 0)
+        {
+            const EclipseCaster& caster = set.casters[i % set.casters.size()];
+            receiver = caster.position + (caster.position - light).normalized() * offset(rng) * 2.0;
+        }
+
+        double receiverRadius = size(rng);
+        double apparentSize = sunRadius / (receiver - light).norm();
+
+        bool inShadow = false;
+        for (const EclipseCaster& caster : set.casters)
+        {
+            // The test of Renderer::testEclipse
+            Eigen::Vector3d dir = caster.position - receiver;
+            double appOccluderRadius = caster.radius / (dir.norm() - receiverRadius);
+            double shadowRadius = (1.0 + apparentSize / appOccluderRadius) * caster.radius;
+            Eigen::Vector3d lightToCaster = caster.position - light;
+            double dist = Eigen::ParametrizedLine<double, 3>(caster.position, lightToCaster.normalized()).distance(receiver);
+            if (dist < receiverRadius + shadowRadius && lightToCaster.dot(receiver - caster.position) > 0.0)
+                inShadow = true;
+        }
+
+        bool mayShadow = set.mayShadow(receiver, receiverRadius, light, apparentSize);
+        if (inShadow)
+        {
+            ++shadowed;
+            REQUIRE(mayShadow);
+        }
+        if (!mayShadow)
+            ++culled;
+    }
+
+    REQUIRE(shadowed > 0);
+    REQUIRE(culled > 0);
+}
+
+TEST_CASE("Empty sets cast no shadows")
+{
+    EclipseCasterSet set;
+    REQUIRE_FALSE(set.mayShadow(Eigen::Vector3d::Zero(), 1.0, Eigen::Vector3d(1.0e8, 0.0, 0.0), 0.01));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,107 @@
+#include <cmath>
+
+#include <celestia/framepacer.h>
+
+#include <doctest.h>
+
+using celestia::FramePacer;
+using Reason = FramePacer::Reason;
+
+namespace
+{
+
+FramePacer::State
+stillState()
+{
+    FramePacer::State state;
+    state.views.push_back({ UniversalCoord(1.0, 2.0, 3.0), Eigen::Quaterniond::Identity(), 0.7f });
+    state.simTime = 2451545.0;
+    return state;
+}
+
+FramePacer
+adaptivePacer(const FramePacer::State& state)
+{
+    FramePacer pacer;
+    pacer.setAdaptive(true);
+    pacer.setReducedFrameRate(10.0);
+    pacer.setIdleFrameInterval(1.0);
+    pacer.frameRendered(state, 0.0, pacer.evaluate(state, 0.0));
+    return pacer;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("FramePacer");
+
+TEST_CASE("Every frame is drawn without adaptive pacing")
+{
+    FramePacer pacer;
+    FramePacer::State state = stillState();
+    pacer.frameRendered(state, 0.0, pacer.evaluate(state, 0.0));
+    REQUIRE(pacer.evaluate(state, 0.01) == Reason::Continuous);
+    REQUIRE(pacer.waitTime(state, 0.01) == 0.0);
+}
+
+TEST_CASE("Still views are drawn on request and after the idle interval")
+{
+    FramePacer::State state = stillState();
+    FramePacer pacer = adaptivePacer(state);
+    REQUIRE(pacer.lastReason() == Reason::Requested);
+
+    REQUIRE(pacer.evaluate(state, 0.5) == Reason::None);
+    REQUIRE(pacer.waitTime(state, 0.5) == doctest::Approx(0.5));
+    REQUIRE(pacer.evaluate(state, 1.0) == Reason::Refresh);
+
+    pacer.requestFrame();
+    REQUIRE(pacer.evaluate(state, 0.5) == Reason::Requested);
+    pacer.frameRendered(state, 0.5, Reason::None);
+    REQUIRE(pacer.lastReason() == Reason::Requested);
+    REQUIRE(pacer.frameCount(Reason::Requested) == 2);
+}
+
+TEST_CASE("Camera changes are drawn at the full rate")
+{
+    FramePacer::State state = stillState();
+    FramePacer pacer = adaptivePacer(state);
+
+    state.views[0].fov = 0.5f;
+    REQUIRE(pacer.evaluate(state, 0.01) == Reason::Motion);
+
+    state = stillState();
+    state.moving = true;
+    REQUIRE(pacer.evaluate(state, 0.01) == Reason::Motion);
+    REQUIRE(pacer.waitTime(state, 0.01) == 0.0);
+
+    state = stillState();
+    state.simTime += 1.0;
+    REQUIRE(pacer.evaluate(state, 0.01) == Reason::Time);
+}
+
+TEST_CASE("Slow changes are drawn at the reduced rate")
+{
+    FramePacer::State state = stillState();
+    FramePacer pacer = adaptivePacer(state);
+
+    state.timeScale = 1.0;
+    REQUIRE(pacer.evaluate(state, 0.05) == Reason::None);
+    REQUIRE(pacer.waitTime(state, 0.05) == doctest::Approx(0.05));
+    REQUIRE(pacer.evaluate(state, 0.1) == Reason::SlowChange);
+
+    state.timeScale = -100.0;
+    REQUIRE(pacer.evaluate(state, 0.05) == Reason::Time);
+
+    state = stillState();
+    state.overlayChangeStart = 0.5;
+    state.overlayChangeEnd = 1.0;
+    REQUIRE(pacer.evaluate(state, 0.2) == Reason::None);
+    REQUIRE(pacer.waitTime(state, 0.2) == doctest::Approx(0.3));
+    REQUIRE(pacer.evaluate(state, 0.6) == Reason::SlowChange);
+    pacer.frameRendered(state, 0.95, Reason::SlowChange);
+    // One more frame after the end, to clear the message
+    REQUIRE(pacer.evaluate(state, 1.05) == Reason::SlowChange);
+    pacer.frameRendered(state, 1.05, Reason::SlowChange);
+    REQUIRE(pacer.evaluate(state, 1.5) == Reason::None);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,113 @@
+#include <fstream>
+#include <string>
+
+#include <celcompat/filesystem.h>
+#include <celengine/frameprofiler.h>
+#include <celengine/glsupport.h>
+
+#include <doctest.h>
+
+using celestia::engine::FrameProfiler;
+
+TEST_SUITE_BEGIN("FrameProfiler");
+
+TEST_CASE("Disabled profiler records nothing")
+{
+    FrameProfiler profiler;
+    profiler.beginFrame();
+    {
+        FrameProfiler::Scope scope(profiler, FrameProfiler::Section::Stars);
+    }
+    profiler.endFrame();
+
+    REQUIRE(profiler.lastFrame().frame == 0);
+    REQUIRE(profiler.lastFrame().cpu[0] == 0.0);
+}
+
+TEST_CASE("CPU times are recorded per frame")
+{
+    FrameProfiler profiler;
+    profiler.setEnabled(true);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        profiler.beginFrame();
+        {
+            FrameProfiler::Scope scope(profiler, FrameProfiler::Section::Stars);
+            volatile double sum = 0.0;
+            for (int j = 0; j < 10000; ++j)
+                sum = sum + static_cast<double>(j);
+        }
+        profiler.endFrame();
+    }
+
+    const auto& times = profiler.lastFrame();
+    REQUIRE(times.frame == 2);
+    REQUIRE(!times.hasGpuTimes);
+    REQUIRE(times.cpu[static_cast<std::size_t>(FrameProfiler::Section::Stars)] > 0.0);
+    REQUIRE(times.cpu[static_cast<std::size_t>(FrameProfiler::Section::Frame)] >=
+            times.cpu[static_cast<std::size_t>(FrameProfiler::Section::Stars)]);
+    REQUIRE(times.cpu[static_cast<std::size_t>(FrameProfiler::Section::Orbits)] == 0.0);
+}
+
+TEST_CASE("Draw calls are counted per section")
+{
+    FrameProfiler profiler;
+    profiler.setEnabled(true);
+
+    profiler.beginFrame();
+    {
+        FrameProfiler::Scope scope(profiler, FrameProfiler::Section::Orbits);
+        celestia::gl::countDraw(GL_TRIANGLES, 30);
+        celestia::gl::countDraw(GL_TRIANGLE_STRIP, 6, 2);
+        celestia::gl::countDraw(GL_LINES, 8);
+        celestia::gl::countUpload(1024);
+        celestia::gl::countStateChange(true);
+        celestia::gl::countStateChange(false);
+        celestia::gl::countStateChange(false);
+    }
+    celestia::gl::countDraw(GL_TRIANGLE_FAN, 4);
+    profiler.endFrame();
+
+    const auto& times = profiler.lastFrame();
+    const auto& orbits = times.draws[static_cast<std::size_t>(FrameProfiler::Section::Orbits)];
+    REQUIRE(orbits.drawCalls == 3);
+    REQUIRE(orbits.triangles == 18);
+    REQUIRE(orbits.uploadedBytes == 1024);
+    REQUIRE(orbits.stateChanges == 1);
+    REQUIRE(orbits.skippedStateChanges == 2);
+
+    const auto& frame = times.draws[static_cast<std::size_t>(FrameProfiler::Section::Frame)];
+    REQUIRE(frame.drawCalls == 4);
+    REQUIRE(frame.triangles == 20);
+    REQUIRE(times.draws[static_cast<std::size_t>(FrameProfiler::Section::Stars)].drawCalls == 0);
+}
+
+TEST_CASE("Frames are written to the log")
+{
+    fs::path path = fs::temp_directory_path() / "celestia-frameprofile-test.csv";
+    {
+        FrameProfiler profiler;
+        REQUIRE(profiler.setLogFile(path));
+        REQUIRE(profiler.isEnabled());
+        for (int i = 0; i < 2; ++i)
+        {
+            profiler.beginFrame();
+            profiler.endFrame();
+        }
+    }
+
+    std::ifstream in(path);
+    std::string line;
+    REQUIRE(std::getline(in, line));
+    REQUIRE(line.rfind("frame,frame_cpu,frame_gpu,stars_cpu", 0) == 0);
+    REQUIRE(std::getline(in, line));
+    REQUIRE(line.rfind("0,", 0) == 0);
+    REQUIRE(std::getline(in, line));
+    REQUIRE(line.rfind("1,", 0) == 0);
+    REQUIRE(!std::getline(in, line));
+    in.close();
+    fs::remove(path);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celmath/frustum.h>
+#include <celmath/mathlib.h>
+
+#include <doctest.h>
+
+using celestia::math::Frustum;
+
+TEST_SUITE_BEGIN("Frustum");
+
+TEST_CASE("Batched sphere tests match single tests")
+{
+    Frustum frustum(celestia::math::degToRad(45.0f), 1.5f, 1.0f, 1000.0f);
+    frustum.transform(Eigen::AngleAxisf(0.3f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()).toRotationMatrix());
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> coordinate(-1200.0f, 1200.0f);
+    std::uniform_real_distribution<float> size(0.0f, 100.0f);
+    std::vector<Eigen::Vector3f> centers;
+    std::vector<float> radii;
+    for (int i = 0; i < 1000; ++i)
+    {
+        centers.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+        radii.push_back(size(rng));
+    }
+
+    std::vector<std::uint32_t> visible((centers.size() + 31) / 32);
+    frustum.testSpheres(centers.data(), radii.data(), centers.size(), visible.data());
+    std::vector<std::uint32_t> pointsVisible((centers.size() + 31) / 32);
+    frustum.testSpheres(centers.data(), nullptr, centers.size(), pointsVisible.data());
+
+    int nVisible = 0;
+    for (std::size_t i = 0; i < centers.size(); ++i)
+    {
+        bool sphereVisible = frustum.testSphere(centers[i], radii[i]) != Frustum::Outside;
+        REQUIRE(((visible[i / 32] >> (i % 32)) & 1U) == (sphereVisible ? 1U : 0U));
+        bool pointVisible = frustum.test(centers[i]) != Frustum::Outside;
+        REQUIRE(((pointsVisible[i / 32] >> (i % 32)) & 1U) == (pointVisible ? 1U : 0U));
+        nVisible += sphereVisible ? 1 : 0;
+    }
+
+    REQUIRE(nVisible > 0);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,49 @@
+#include <Eigen/Core>
+
+#include <celmath/geomutil.h>
+
+#include <doctest.h>
+
+namespace math = celestia::math;
+
+namespace
+{
+
+float
+windowDepth(const Eigen::Matrix4d& projection, double z)
+{
+    Eigen::Vector4d clip = projection * Eigen::Vector4d(0.0, 0.0, z, 1.0);
+    return static_cast<float>(clip.z() / clip.w());
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("geomutil");
+
+TEST_CASE("Reversed perspective maps the near plane to 1 and the far plane to 0")
+{
+    Eigen::Matrix4d projection = math::ReversedPerspective(45.0, 1.5, 0.001, 1.0e12);
+    REQUIRE(windowDepth(projection, -0.001) == doctest::Approx(1.0f));
+    REQUIRE(windowDepth(projection, -1.0e12) == doctest::Approx(0.0f));
+
+    // Depth decreases with distance and stays distinct in float precision
+    // across the range
+    float previous = 1.0f;
+    for (double z = 0.01; z < 1.0e12; z *= 10.0)
+    {
+        float depth = windowDepth(projection, -z);
+        REQUIRE(depth < previous);
+        previous = depth;
+    }
+}
+
+TEST_CASE("Reversed perspective keeps the x and y of the usual one")
+{
+    Eigen::Matrix4f usual = math::Perspective(60.0f, 1.25f, 0.5f, 100.0f);
+    Eigen::Matrix4f reversed = math::ReversedPerspective(60.0f, 1.25f, 0.5f, 100.0f);
+    REQUIRE(reversed.row(0).isApprox(usual.row(0)));
+    REQUIRE(reversed.row(1).isApprox(usual.row(1)));
+    REQUIRE(reversed.row(3).isApprox(usual.row(3)));
+}
+
+TEST_SUITE_END();
@@ -1,5 +1,10 @@
 #include <memory>
+#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
+
+#include <fmt/format.h>
 
 #include <celengine/hash.h>
 #include <celengine/value.h>
@@ -101,6 +106,30 @@ TEST_CASE("AssociativeArray")
             REQUIRE(c->alpha() == doctest::Approx(0x78 / 255.).epsilon(EPSILON));
         }
     }
+
+    SUBCASE("Keys")
+    {
+        AssociativeArray h;
+        for (int i = 0; i < 40; ++i)
+        {
+            h.addValue(fmt::format("Key{}", 39 - i), Value(static_cast<double>(i)));
+        }
+        h.addValue("Key0", Value(100.0));
+        h.addValue("Name", Value("a string too long to be stored without allocating"));
+
+        REQUIRE(h.getNumber<double>("Key0") == 39.0);
+        REQUIRE(h.getNumber<double>("Key39") == 0.0);
+        REQUIRE(h.getNumber<double>("Key17") == 22.0);
+        REQUIRE(h.getValue("Key40") == nullptr);
+        REQUIRE(h.getValue("key1") == nullptr);
+        REQUIRE(*h.getString("Name") == "a string too long to be stored without allocating");
+
+        std::vector<std::string> keys;
+        h.for_all([&keys](std::string_view key, const Value&) { keys.emplace_back(key); });
+        REQUIRE(keys.size() == 41);
+        REQUIRE(keys.front() == "Key39");
+        REQUIRE(keys.back() == "Name");
+    }
 }
 
 TEST_SUITE_END();
@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celimage/image.h>
+
+#include <doctest.h>
+
+using celestia::engine::Image;
+using celestia::engine::ImageRowReader;
+using celestia::engine::PixelFormat;
+
+TEST_SUITE_BEGIN("Image");
+
+TEST_CASE("Mipmap generation")
+{
+    // Alternating black and white columns with a constant alpha
+    Image img(PixelFormat::LumAlpha, 4, 2);
+    for (int y = 0; y < 2; ++y)
+    {
+        std::uint8_t* row = img.getPixelRow(y);
+        for (int x = 0; x < 4; ++x)
+        {
+            row[x * 2] = (x & 1) ? 255 : 0;
+            row[x * 2 + 1] = 100;
+        }
+    }
+
+    SUBCASE("Linear")
+    {
+        auto mipmapped = img.computeMipmaps(false);
+        REQUIRE(mipmapped->getMipLevelCount() == 3);
+        REQUIRE(mipmapped->getFormat() == PixelFormat::LumAlpha);
+        const std::uint8_t* level1 = mipmapped->getMipLevel(1);
+        REQUIRE(level1[0] == 128);
+        REQUIRE(level1[1] == 100);
+        REQUIRE(mipmapped->getMipLevel(2)[0] == 128);
+    }
+
+    SUBCASE("Gamma correct")
+    {
+        auto mipmapped = img.computeMipmaps(true);
+        const std::uint8_t* level1 = mipmapped->getMipLevel(1);
+        // Half of the linear intensity of white in sRGB
+        REQUIRE(level1[0] == 188);
+        REQUIRE(level1[2] == 188);
+        REQUIRE(level1[1] == 100);
+        REQUIRE(mipmapped->getMipLevel(2)[0] == 188);
+    }
+
+    // The base level is copied unchanged
+    REQUIRE(img.computeMipmaps(true)->getPixelRow(1)[2] == 255);
+}
+
+TEST_CASE("Compressed images have no mipmaps computed")
+{
+    Image img(PixelFormat::DXT1, 8, 8);
+    REQUIRE(img.computeMipmaps(false) == nullptr);
+}
+
+TEST_CASE("Images are read in rows")
+{
+    Image img(PixelFormat::RGB, 5, 7);
+    for (int y = 0; y < 7; ++y)
+    {
+        std::uint8_t* row = img.getPixelRow(y);
+        for (int x = 0; x < 15; ++x)
+            row[x] = static_cast<std::uint8_t>(y * 15 + x);
+    }
+
+    fs::path path = fs::temp_directory_path() / "celestia-image-rows-test.png";
+    REQUIRE(img.save(path, ContentType::PNG));
+
+    auto reader = ImageRowReader::open(path);
+    REQUIRE(reader != nullptr);
+    REQUIRE(reader->getWidth() == 5);
+    REQUIRE(reader->getHeight() == 7);
+    REQUIRE(reader->getFormat() == PixelFormat::RGB);
+    REQUIRE(reader->getPitch() == img.getPitch());
+
+    // A strip of 4 rows, then the remaining 3
+    std::vector<std::uint8_t> rows(static_cast<std::size_t>(reader->getPitch()) * 4);
+    REQUIRE(reader->read(rows.data(), 4));
+    REQUIRE(rows[reader->getPitch() * 3 + 14] == img.getPixelRow(3)[14]);
+    REQUIRE(reader->read(rows.data(), 3));
+    REQUIRE(rows[0] == img.getPixelRow(4)[0]);
+    REQUIRE(rows[reader->getPitch() * 2 + 14] == img.getPixelRow(6)[14]);
+    REQUIRE(!reader->read(rows.data(), 1));
+
+    reader = nullptr;
+    std::error_code ec;
+    fs::remove(path, ec);
+}
+
+TEST_SUITE_END();
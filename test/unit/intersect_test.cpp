@@ -0,0 +1,76 @@
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celmath/ellipsoid.h>
+
+#include <celmath/intersect.h>
+#include <celmath/sphere.h>
+
+#include <doctest.h>
+
+using celestia::math::Ellipsoidf;
+using celestia::math::Spheref;
+using celestia::math::testIntersection;
+using celestia::math::testIntersections;
+using celestia::math::testOcclusion;
+
+TEST_SUITE_BEGIN("Intersect");
+
+TEST_CASE("Occlusion by a sphere")
+{
+    Spheref planet(Eigen::Vector3f(0.0f, 0.0f, -100.0f), 50.0f);
+
+    // Directly behind the planet
+    REQUIRE(testOcclusion(planet, Spheref(Eigen::Vector3f(0.0f, 0.0f, -1000.0f), 10.0f)));
+    // Behind the planet but large enough to stick out of its disc
+    REQUIRE(!testOcclusion(planet, Spheref(Eigen::Vector3f(0.0f, 0.0f, -1000.0f), 600.0f)));
+    // Past the limb
+    REQUIRE(!testOcclusion(planet, Spheref(Eigen::Vector3f(700.0f, 0.0f, -1000.0f), 10.0f)));
+    // In front of the planet
+    REQUIRE(!testOcclusion(planet, Spheref(Eigen::Vector3f(0.0f, 0.0f, -20.0f), 5.0f)));
+    // The planet doesn't hide itself, nor spheres containing the viewer
+    REQUIRE(!testOcclusion(planet, planet));
+    REQUIRE(!testOcclusion(planet, Spheref(Eigen::Vector3f(0.0f, 0.0f, -1000.0f), 2000.0f)));
+    // Nothing is hidden from a viewer inside the occluder
+    REQUIRE(!testOcclusion(Spheref(Eigen::Vector3f::Zero(), 50.0f),
+                           Spheref(Eigen::Vector3f(0.0f, 0.0f, -1000.0f), 10.0f)));
+}
+
+TEST_CASE("Ray intersection with several ellipsoids")
+{
+    Eigen::ParametrizedLine<float, 3> ray(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.0f, 0.0f, -1.0f));
+    std::vector<Ellipsoidf> ellipsoids
+    {
+        Ellipsoidf(Eigen::Vector3f(0.0f, 0.0f, -100.0f), Eigen::Vector3f(10.0f, 20.0f, 5.0f)),
+        // Missed
+        Ellipsoidf(Eigen::Vector3f(50.0f, 0.0f, -50.0f), Eigen::Vector3f(10.0f, 10.0f, 10.0f)),
+        Ellipsoidf(Eigen::Vector3f(1.0f, 2.0f, -40.0f), Eigen::Vector3f(3.0f, 4.0f, 6.0f)),
+        // Containing the origin of the ray
+        Ellipsoidf(Eigen::Vector3f(0.0f, 0.0f, -1.0f), Eigen::Vector3f(2.0f, 2.0f, 30.0f)),
+        // Behind the ray
+        Ellipsoidf(Eigen::Vector3f(0.0f, 0.0f, 100.0f), Eigen::Vector3f(10.0f, 10.0f, 10.0f)),
+    };
+
+    std::vector<float> distances(ellipsoids.size());
+    std::size_t nearest = testIntersections(ray, ellipsoids.data(), ellipsoids.size(), distances.data());
+
+    for (std::size_t i = 0; i < ellipsoids.size(); ++i)
+    {
+        float distance = 0.0f;
+        if (testIntersection(ray, ellipsoids[i], distance))
+            REQUIRE(distances[i] == doctest::Approx(distance));
+        else
+            REQUIRE(distances[i] == std::numeric_limits<float>::infinity());
+    }
+
+    REQUIRE(distances[0] == doctest::Approx(95.0f));
+    REQUIRE(distances[3] == doctest::Approx(31.0f));
+    REQUIRE(nearest == 3);
+    REQUIRE(testIntersections(ray, ellipsoids.data() + 4, 1, distances.data()) == 1);
+}
+
+TEST_SUITE_END();
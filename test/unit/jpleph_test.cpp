@@ -0,0 +1,128 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celephem/jpleph.h>
+
+#include <doctest.h>
+
+using celestia::ephem::JPLEphemeris;
+using celestia::ephem::JPLEphemItem;
+
+namespace
+{
+
+constexpr std::size_t HeaderSize = 2856;
+constexpr std::size_t StartDateOffset = 2652;
+constexpr std::size_t CoeffInfoOffset = 2696;
+constexpr std::size_t DENumOffset = 2840;
+constexpr std::size_t LibrationOffset = 2844;
+
+constexpr std::uint32_t NCoeffs = 10;
+// 11 items with 3 components, nutations with 2 and librations with 2
+// coefficients, plus the record start and end time
+constexpr std::uint32_t RecordSize = 11 * 3 * NCoeffs + 2 * NCoeffs + 3 * 2 + 2;
+constexpr std::uint32_t NRecords = 20;
+constexpr double StartDate = 2451536.5;
+constexpr double DaysPerInterval = 32.0;
+
+template<typename T>
+void put(std::vector<char>& data, std::size_t offset, T value)
+{
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+// A DE405 style file with random coefficients
+std::vector<char> makeEphemeris()
+{
+    std::vector<char> data(std::size_t(RecordSize) * sizeof(double) * (NRecords + 2), '\0');
+    put(data, StartDateOffset, StartDate);
+    put(data, StartDateOffset + 8, StartDate + DaysPerInterval * NRecords);
+    put(data, StartDateOffset + 16, DaysPerInterval);
+    put(data, StartDateOffset + 28, 149597870.691);
+    put(data, StartDateOffset + 36, 81.30056);
+    for (std::uint32_t i = 0; i < 12; ++i)
+    {
+        put(data, CoeffInfoOffset + i * 12, 3 + i * 3 * NCoeffs);
+        put(data, CoeffInfoOffset + i * 12 + 4, NCoeffs);
+        put(data, CoeffInfoOffset + i * 12 + 8, std::uint32_t(1));
+    }
+    put(data, DENumOffset, std::uint32_t(405));
+    put(data, LibrationOffset, 3 + 11 * 3 * NCoeffs + 2 * NCoeffs);
+    put(data, LibrationOffset + 4, std::uint32_t(2));
+    put(data, LibrationOffset + 8, std::uint32_t(1));
+
+    std::mt19937 rng(405);
+    std::uniform_real_distribution<double> dist(-1.0e8, 1.0e8);
+    for (std::uint32_t rec = 0; rec < NRecords; ++rec)
+    {
+        std::size_t offset = std::size_t(rec + 2) * RecordSize * sizeof(double);
+        put(data, offset, StartDate + rec * DaysPerInterval);
+        put(data, offset + 8, StartDate + (rec + 1) * DaysPerInterval);
+        for (std::uint32_t j = 2; j < RecordSize; ++j)
+            put(data, offset + j * sizeof(double), dist(rng));
+    }
+
+    return data;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("JPL ephemeris");
+
+TEST_CASE("Mapped ephemerides match ephemerides in memory")
+{
+    std::vector<char> data = makeEphemeris();
+    fs::path path = fs::temp_directory_path() / "celestia_jpleph_test.dat";
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        REQUIRE(out.good());
+    }
+
+    std::unique_ptr<JPLEphemeris> loaded;
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        loaded.reset(JPLEphemeris::load(in));
+    }
+    std::unique_ptr<JPLEphemeris> mapped(JPLEphemeris::load(path));
+    REQUIRE(loaded != nullptr);
+    REQUIRE(mapped != nullptr);
+    REQUIRE(mapped->getDENumber() == 405);
+    REQUIRE(mapped->getRecordSize() == RecordSize);
+
+    // Random times evict records from the cache
+    std::mt19937 rng(441);
+    std::uniform_real_distribution<double> dist(StartDate - 10.0, StartDate + DaysPerInterval * NRecords + 10.0);
+    for (int i = 0; i < 500; ++i)
+    {
+        double tjd = dist(rng);
+        for (auto item : { JPLEphemItem::Mercury, JPLEphemItem::Earth, JPLEphemItem::Moon, JPLEphemItem::Sun })
+            REQUIRE(mapped->getPlanetPosition(item, tjd) == loaded->getPlanetPosition(item, tjd));
+    }
+
+    mapped.reset();
+    fs::remove(path);
+}
+
+TEST_CASE("Truncated ephemerides are rejected")
+{
+    std::vector<char> data = makeEphemeris();
+    data.resize(data.size() - 8);
+    fs::path path = fs::temp_directory_path() / "celestia_jpleph_truncated.dat";
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    std::unique_ptr<JPLEphemeris> eph(JPLEphemeris::load(path));
+    REQUIRE(eph == nullptr);
+    fs::remove(path);
+}
+
+TEST_SUITE_END();
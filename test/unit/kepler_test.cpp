@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include <celastro/astro.h>
 #include <celcompat/numbers.h>
@@ -136,4 +141,132 @@ TEST_CASE("Hyperbolic orbits")
     }
 }
 
+TEST_CASE("Batched positions match single positions")
+{
+    astro::KeplerElements elements;
+    elements.period = 365.25;
+    elements.semimajorAxis = astro::KM_PER_AU<double>;
+    elements.eccentricity = 0.2;
+    elements.inclination = math::degToRad(10.0);
+    elements.longAscendingNode = math::degToRad(40.0);
+    elements.argPericenter = math::degToRad(90.0);
+    elements.meanAnomaly = 0.0;
+
+    constexpr std::array times{ -500.0, -20.0, 0.0, 0.0, 37.5, 100.0, 1000.0 };
+    std::array<Eigen::Vector3d, times.size()> positions;
+
+    auto elliptical = celestia::ephem::EllipticalOrbit(elements, 0.0);
+    elliptical.positionsAtTimes(times, positions.data());
+    for (std::size_t i = 0; i < times.size(); ++i)
+        REQUIRE(positions[i] == elliptical.positionAtTime(times[i]));
+
+    auto fixed = celestia::ephem::FixedOrbit(Eigen::Vector3d(1.0, 2.0, 3.0));
+    fixed.positionsAtTimes(times, positions.data());
+    for (const auto& position : positions)
+        REQUIRE(position == Eigen::Vector3d(1.0, 2.0, 3.0));
+
+    // Times before, in and after the span of the primary orbit
+    auto mixed = celestia::ephem::MixedOrbit(std::make_unique<celestia::ephem::EllipticalOrbit>(elements, 0.0),
+                                             -10.0, 50.0, astro::SolarMass);
+    mixed.positionsAtTimes(times, positions.data());
+    for (std::size_t i = 0; i < times.size(); ++i)
+        REQUIRE(positions[i] == mixed.positionAtTime(times[i]));
+
+    std::array<const celestia::ephem::Orbit*, 3> orbits{ &elliptical, &fixed, &mixed };
+    celestia::ephem::PositionsAtTime(orbits, 37.5, positions.data());
+    for (std::size_t i = 0; i < orbits.size(); ++i)
+        REQUIRE(positions[i] == orbits[i]->positionAtTime(37.5));
+}
+
+TEST_CASE("Batched Kepler solutions match single orbits")
+{
+    constexpr std::array testEccentricities{ 0.0, 0.1, 0.5, 0.85, 0.97, 0.999, 1.2, 3.0 };
+    constexpr std::array testTimes{ -20000.0, -300.0, -1.0, 0.0, 0.5, 77.0, 4000.0 };
+
+    // More orbits than fit in a batch, mixed with orbits of other kinds
+    std::vector<std::unique_ptr<celestia::ephem::Orbit>> orbits;
+    for (double eccentricity : testEccentricities)
+    for (double meanAnomalyDeg : testAngles)
+    for (double pericenterDeg : { 0.0, 40.0, 150.0 })
+    {
+        astro::KeplerElements elements;
+        elements.period = 800.0;
+        elements.semimajorAxis = std::cbrt(GMsun * math::square(elements.period) / fourpi2);
+        elements.eccentricity = eccentricity;
+        elements.inclination = math::degToRad(30.0);
+        elements.longAscendingNode = math::degToRad(40.0);
+        elements.argPericenter = math::degToRad(pericenterDeg);
+        elements.meanAnomaly = math::degToRad(meanAnomalyDeg);
+        if (eccentricity < 1.0)
+        {
+            orbits.push_back(std::make_unique<celestia::ephem::EllipticalOrbit>(elements, 10.0));
+        }
+        else
+        {
+            elements.semimajorAxis = -elements.semimajorAxis;
+            orbits.push_back(std::make_unique<celestia::ephem::HyperbolicOrbit>(elements, 10.0));
+        }
+
+        if (orbits.size() % 50 == 0)
+            orbits.push_back(std::make_unique<celestia::ephem::FixedOrbit>(Eigen::Vector3d(1.0, 2.0, 3.0)));
+    }
+
+    std::vector<const celestia::ephem::Orbit*> orbitPointers;
+    for (const auto& orbit : orbits)
+        orbitPointers.push_back(orbit.get());
+
+    // The batches are solved to convergence, while the fixed iterations used
+    // for low eccentricities by positionAtTime() are only accurate to e^6
+    std::vector<Eigen::Vector3d> positions(orbits.size());
+    for (double t : testTimes)
+    {
+        celestia::ephem::PositionsAtTime(orbitPointers, t, positions.data());
+        for (std::size_t i = 0; i < orbits.size(); ++i)
+        {
+            Eigen::Vector3d expected = orbits[i]->positionAtTime(t);
+            REQUIRE((positions[i] - expected).norm() <= 1.0e-6 * expected.norm());
+        }
+    }
+}
+
+TEST_CASE("Cached positions are consistent across threads")
+{
+    astro::KeplerElements elements;
+    elements.period = 365.25;
+    elements.semimajorAxis = astro::KM_PER_AU<double>;
+    elements.eccentricity = 0.1;
+
+    // Mixed orbits are caching orbits, so they use the per-thread caches
+    auto inner = celestia::ephem::MixedOrbit(std::make_unique<celestia::ephem::EllipticalOrbit>(elements, 0.0),
+                                             -1000.0, 1000.0, astro::SolarMass);
+    elements.period = 4332.6;
+    elements.semimajorAxis = 5.2 * astro::KM_PER_AU<double>;
+    auto outer = celestia::ephem::MixedOrbit(std::make_unique<celestia::ephem::EllipticalOrbit>(elements, 0.0),
+                                             -1000.0, 1000.0, astro::SolarMass);
+
+    constexpr int nThreads = 4;
+    constexpr int nSteps = 1000;
+    std::vector<int> mismatches(nThreads, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; ++i)
+    {
+        threads.emplace_back([&, i] {
+            for (int step = 0; step < nSteps; ++step)
+            {
+                double jd = static_cast<double>(step * nThreads + i) * 0.25;
+                Eigen::Vector3d p = inner.positionAtTime(jd);
+                Eigen::Vector3d q = outer.positionAtTime(jd);
+                if (p != inner.positionAtTime(jd) || q != outer.positionAtTime(jd) || p == q)
+                    ++mismatches[i];
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (int count : mismatches)
+        REQUIRE(count == 0);
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,47 @@
+#include <celengine/labelgrid.h>
+
+#include <doctest.h>
+
+using celestia::engine::LabelGrid;
+
+TEST_SUITE_BEGIN("LabelGrid");
+
+TEST_CASE("LabelGrid rejects overlapping rectangles")
+{
+    LabelGrid grid(32);
+    grid.reset(640, 480);
+
+    REQUIRE(grid.reserve(10.0f, 10.0f, 100.0f, 24.0f));
+    REQUIRE(!grid.reserve(90.0f, 20.0f, 150.0f, 34.0f));
+    REQUIRE(grid.reserve(100.0f, 10.0f, 150.0f, 24.0f));
+    REQUIRE(grid.reserve(10.0f, 24.0f, 100.0f, 38.0f));
+    REQUIRE(!grid.reserve(40.0f, 12.0f, 41.0f, 13.0f));
+    REQUIRE(grid.size() == 3);
+}
+
+TEST_CASE("LabelGrid accepts rectangles outside the window")
+{
+    LabelGrid grid(32);
+    grid.reset(640, 480);
+
+    REQUIRE(grid.reserve(-100.0f, 10.0f, -20.0f, 24.0f));
+    REQUIRE(grid.reserve(-100.0f, 10.0f, -20.0f, 24.0f));
+    REQUIRE(grid.size() == 0);
+
+    // Partly visible rectangles are still tested
+    REQUIRE(grid.reserve(600.0f, 470.0f, 700.0f, 490.0f));
+    REQUIRE(!grid.reserve(630.0f, 475.0f, 660.0f, 485.0f));
+}
+
+TEST_CASE("LabelGrid reset removes the rectangles")
+{
+    LabelGrid grid(32);
+    grid.reset(640, 480);
+    REQUIRE(grid.reserve(10.0f, 10.0f, 100.0f, 24.0f));
+
+    grid.reset(320, 240);
+    REQUIRE(grid.size() == 0);
+    REQUIRE(grid.reserve(10.0f, 10.0f, 100.0f, 24.0f));
+}
+
+TEST_SUITE_END();
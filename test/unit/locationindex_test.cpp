@@ -0,0 +1,138 @@
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/location.h>
+#include <celengine/locationindex.h>
+#include <celmath/ellipsoid.h>
+#include <celmath/intersect.h>
+
+#include <doctest.h>
+
+using celestia::engine::LocationIndex;
+
+namespace
+{
+
+std::vector<std::unique_ptr<Location>>
+makeLocations(const Eigen::Vector3f& semiAxes, int count)
+{
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> size(1.0f, 1000.0f);
+
+    std::vector<std::unique_ptr<Location>> locations;
+    for (int i = 0; i < count; ++i)
+    {
+        Eigen::Vector3f direction(normal(rng), normal(rng), normal(rng));
+        direction.normalize();
+        float scale = 1.0f / direction.cwiseQuotient(semiAxes).norm();
+
+        auto location = std::make_unique<Location>();
+        location->setPosition(direction * scale);
+        location->setSize(size(rng));
+        location->setFeatureType(i % 2 == 0 ? Location::Crater : Location::City);
+        locations.push_back(std::move(location));
+    }
+
+    return locations;
+}
+
+// The size and horizon tests of the renderer
+bool
+isVisible(const Location& location,
+          const Eigen::Vector3d& viewer,
+          const celestia::math::Ellipsoidd& ellipsoid,
+          double sizeScale)
+{
+    Eigen::Vector3d position = location.getPosition().cast<double>();
+    if (location.getSize() <= sizeScale * (position - viewer).norm())
+        return false;
+
+    Eigen::ParametrizedLine<double, 3> ray(viewer, position * 1.0001 - viewer);
+    double t = 0.0;
+    return !celestia::math::testIntersection(ray, ellipsoid, t) || t >= 1.0;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("LocationIndex");
+
+TEST_CASE("Queries find all visible locations")
+{
+    Eigen::Vector3f semiAxes(3400.0f, 3400.0f, 3350.0f);
+    auto locations = makeLocations(semiAxes, 5000);
+    std::vector<const Location*> pointers;
+    for (const auto& location : locations)
+        pointers.push_back(location.get());
+
+    LocationIndex index(pointers, semiAxes);
+    REQUIRE(index.size() == locations.size());
+
+    celestia::math::Ellipsoidd ellipsoid(semiAxes.cast<double>());
+    const Eigen::Vector3d viewers[] =
+    {
+        { 0.0, 0.0, 3500.0 },
+        { 10000.0, -5000.0, 2000.0 },
+        { -1.0e6, 0.0, 0.0 },
+    };
+
+    for (const Eigen::Vector3d& viewer : viewers)
+    {
+        for (double sizeScale : { 0.0, 1.0e-3, 0.05 })
+        {
+            std::set<const Location*> found;
+            index.query(viewer, sizeScale, Location::Crater, true,
+                        [&](const Location* location) { found.insert(location); });
+
+            std::size_t visible = 0;
+            for (const auto& location : locations)
+            {
+                if (location->getFeatureType() != Location::Crater ||
+                    !isVisible(*location, viewer, ellipsoid, sizeScale))
+                {
+                    continue;
+                }
+
+                ++visible;
+                REQUIRE(found.count(location.get()) == 1);
+            }
+
+            for (const Location* location : found)
+                REQUIRE(location->getFeatureType() == Location::Crater);
+
+            // Most of the far side and the small locations are skipped
+            if (sizeScale > 0.0 || viewer.norm() < 4000.0)
+                REQUIRE(found.size() < locations.size() / 2);
+            REQUIRE(found.size() >= visible);
+        }
+    }
+}
+
+TEST_CASE("Locations are visited from the largest within a cell")
+{
+    Eigen::Vector3f semiAxes(1.0f, 1.0f, 1.0f);
+    auto locations = makeLocations(semiAxes, 3);
+    for (auto& location : locations)
+        location->setPosition(Eigen::Vector3f::UnitZ());
+    locations[0]->setSize(10.0f);
+    locations[1]->setSize(30.0f);
+    locations[2]->setSize(20.0f);
+    locations[2]->setImportance(40.0f);
+
+    std::vector<const Location*> pointers;
+    for (const auto& location : locations)
+        pointers.push_back(location.get());
+
+    LocationIndex index(pointers, semiAxes);
+    std::vector<const Location*> found;
+    index.query(Eigen::Vector3d(0.0, 0.0, 10.0), 0.0, ~UINT64_C(0), true,
+                [&](const Location* location) { found.push_back(location); });
+    REQUIRE(found == std::vector<const Location*>{ pointers[2], pointers[1], pointers[0] });
+}
+
+TEST_SUITE_END();
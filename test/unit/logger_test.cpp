@@ -159,4 +159,35 @@ TEST_CASE("logger")
     }
 }
 
+TEST_CASE("asynchronous logger")
+{
+    std::ostringstream err, log;
+    Logger logger(Level::Info, log, err);
+    logger.setAsynchronous(true);
+
+    SUBCASE("Messages are written in order after a flush")
+    {
+        logger.error("number={}\n", 123);
+        logger.info("hello world\n");
+        logger.warn("string={}\n", "foobar");
+        logger.debug("s={} e={}\n", 1, 'a');
+        logger.flush();
+        REQUIRE(err.str() == "number=123\nstring=foobar\n");
+        REQUIRE(log.str() == "hello world\n");
+    }
+
+    SUBCASE("Repeated messages are suppressed")
+    {
+        for (int i = 0; i < 100; ++i)
+            logger.warn("repeated {}\n", i);
+        logger.flush();
+
+        std::string expected;
+        for (int i = 0; i < 10; ++i)
+            expected += fmt::format("repeated {}\n", i);
+        expected += "90 more messages like \"repeated {}\" were suppressed\n";
+        REQUIRE(err.str() == expected);
+    }
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,42 @@
+#include <utility>
+
+#include <celutil/memoryaccounting.h>
+
+#include <doctest.h>
+
+using celestia::util::LiveMemory;
+using celestia::util::MemoryAccountingEnabled;
+using celestia::util::MemoryRecord;
+using celestia::util::MemoryTag;
+
+TEST_SUITE_BEGIN("MemoryAccounting");
+
+TEST_CASE("Records account their bytes while they exist")
+{
+    std::size_t before = LiveMemory(MemoryTag::Orbits);
+    std::size_t texturesBefore = LiveMemory(MemoryTag::Textures);
+    auto expected = [before](std::size_t bytes) { return MemoryAccountingEnabled ? before + bytes : 0; };
+    {
+        MemoryRecord record(MemoryTag::Orbits);
+        record.set(1000);
+        REQUIRE(record.bytes() == 1000);
+        REQUIRE(LiveMemory(MemoryTag::Orbits) == expected(1000));
+
+        record.set(400);
+        REQUIRE(LiveMemory(MemoryTag::Orbits) == expected(400));
+
+        MemoryRecord copy = record;
+        REQUIRE(LiveMemory(MemoryTag::Orbits) == expected(800));
+
+        MemoryRecord moved = std::move(copy);
+        REQUIRE(moved.bytes() == 400);
+        REQUIRE(LiveMemory(MemoryTag::Orbits) == expected(800));
+
+        // Other tags are unaffected
+        REQUIRE(LiveMemory(MemoryTag::Textures) == texturesBefore);
+    }
+
+    REQUIRE(LiveMemory(MemoryTag::Orbits) == expected(0));
+}
+
+TEST_SUITE_END();
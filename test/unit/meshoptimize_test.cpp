@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celmodel/meshoptimize.h>
+
+#include <doctest.h>
+
+using cmod::Index32;
+
+namespace
+{
+
+constexpr unsigned int GridSize = 32;
+constexpr unsigned int GridVertices = (GridSize + 1) * (GridSize + 1);
+
+// Triangles of a square grid in a random order
+std::vector<Index32>
+makeShuffledGrid()
+{
+    std::vector<std::array<Index32, 3>> triangles;
+    for (unsigned int y = 0; y < GridSize; ++y)
+    {
+        for (unsigned int x = 0; x < GridSize; ++x)
+        {
+            Index32 i = y * (GridSize + 1) + x;
+            triangles.push_back({ i, i + 1, i + GridSize + 1 });
+            triangles.push_back({ i + 1, i + GridSize + 2, i + GridSize + 1 });
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::shuffle(triangles.begin(), triangles.end(), rng);
+
+    std::vector<Index32> indices;
+    for (const auto& t : triangles)
+        indices.insert(indices.end(), t.begin(), t.end());
+    return indices;
+}
+
+// Triangles as sorted vertex triples, sorted, to compare the sets of
+// triangles of two lists
+std::vector<std::array<Index32, 3>>
+triangleSet(const std::vector<Index32>& indices)
+{
+    std::vector<std::array<Index32, 3>> triangles;
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        std::array<Index32, 3> t{ indices[i], indices[i + 1], indices[i + 2] };
+        // Rotate the lowest index first to keep the winding
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("MeshOptimize");
+
+TEST_CASE("Vertex cache optimization keeps the triangles and reduces the ACMR")
+{
+    std::vector<Index32> indices = makeShuffledGrid();
+    std::vector<Index32> original = indices;
+    float shuffledACMR = cmod::ComputeACMR(indices);
+
+    std::vector<std::size_t> clusters = cmod::OptimizeVertexCache(indices, GridVertices);
+    REQUIRE(!clusters.empty());
+    REQUIRE(clusters.front() == 0);
+    REQUIRE(std::is_sorted(clusters.begin(), clusters.end()));
+    REQUIRE(triangleSet(indices) == triangleSet(original));
+    REQUIRE(cmod::ComputeACMR(indices) < 0.8f);
+    REQUIRE(cmod::ComputeACMR(indices) < shuffledACMR * 0.5f);
+
+    SUBCASE("Overdraw ordering keeps the triangles and most of the cache efficiency")
+    {
+        std::vector<Eigen::Vector3f> positions;
+        for (unsigned int y = 0; y <= GridSize; ++y)
+        {
+            for (unsigned int x = 0; x <= GridSize; ++x)
+                positions.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.0f);
+        }
+
+        float acmr = cmod::ComputeACMR(indices);
+        cmod::OptimizeOverdraw(indices, clusters, positions);
+        REQUIRE(triangleSet(indices) == triangleSet(original));
+        REQUIRE(cmod::ComputeACMR(indices) <= acmr * 1.1f);
+    }
+}
+
+TEST_CASE("Invalid triangle lists are left unchanged")
+{
+    std::vector<Index32> indices{ 0, 1, 5 };
+    REQUIRE(cmod::OptimizeVertexCache(indices, 3).empty());
+    REQUIRE(indices == std::vector<Index32>{ 0, 1, 5 });
+}
+
+TEST_CASE("Vertices are numbered in the order of their first use")
+{
+    std::vector<Index32> first{ 3, 1, 3 };
+    std::vector<Index32> second{ 0, 1 };
+    std::vector<Index32> remap = cmod::ComputeVertexFetchRemap({ &first, &second }, 5);
+    REQUIRE(remap == std::vector<Index32>{ 2, 1, 3, 0, 4 });
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,156 @@
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celmodel/material.h>
+#include <celmodel/mesh.h>
+#include <celmodel/meshquantize.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+
+#include <doctest.h>
+
+namespace
+{
+
+constexpr unsigned int VertexCount = 100;
+
+// Points on a spiral around a sphere, offset from the origin, with their
+// normals and texture coordinates
+cmod::Mesh
+makeMesh()
+{
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Float3, 3);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Float2, 6);
+
+    std::vector<float> vertices;
+    for (unsigned int i = 0; i < VertexCount; ++i)
+    {
+        float z = 2.0f * (static_cast<float>(i) + 0.5f) / VertexCount - 1.0f;
+        float r = std::sqrt(1.0f - z * z);
+        float phi = static_cast<float>(i) * 2.4f;
+        Eigen::Vector3f n(r * std::cos(phi), r * std::sin(phi), z);
+        Eigen::Vector3f p = Eigen::Vector3f(10.0f, -5.0f, 2.0f) + 3.0f * n;
+        vertices.insert(vertices.end(), { p.x(), p.y(), p.z(), n.x(), n.y(), n.z() });
+        vertices.insert(vertices.end(), { (z + 1.0f) * 0.5f, phi / 240.0f });
+    }
+
+    std::vector<cmod::Index32> indices;
+    for (cmod::Index32 i = 0; i + 2 < VertexCount; ++i)
+        indices.insert(indices.end(), { i, i + 1, i + 2 });
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(VertexCount, std::vector<cmod::VWord>(reinterpret_cast<const cmod::VWord*>(vertices.data()),
+                                                           reinterpret_cast<const cmod::VWord*>(vertices.data() + vertices.size())));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+Eigen::Vector3f
+attribute3(const cmod::Mesh& mesh, cmod::VertexAttributeSemantic semantic, unsigned int i)
+{
+    const auto& attr = mesh.getVertexDescription().getAttribute(semantic);
+    const cmod::VWord* v = mesh.getVertexData() + i * mesh.getVertexStrideWords() + attr.offsetWords;
+    return Eigen::Map<const Eigen::Vector3f>(reinterpret_cast<const float*>(v));
+}
+
+Eigen::Vector2f
+attribute2(const cmod::Mesh& mesh, cmod::VertexAttributeSemantic semantic, unsigned int i)
+{
+    const auto& attr = mesh.getVertexDescription().getAttribute(semantic);
+    const cmod::VWord* v = mesh.getVertexData() + i * mesh.getVertexStrideWords() + attr.offsetWords;
+    return Eigen::Map<const Eigen::Vector2f>(reinterpret_cast<const float*>(v));
+}
+
+// Compare the dequantized mesh to the original within the 16-bit precision
+void
+checkRoundtrip(const cmod::Mesh& original, const cmod::Mesh& unpacked)
+{
+    REQUIRE(unpacked.getVertexDescription() == original.getVertexDescription());
+    REQUIRE(unpacked.getVertexCount() == original.getVertexCount());
+    for (unsigned int i = 0; i < original.getVertexCount(); ++i)
+    {
+        REQUIRE((attribute3(unpacked, cmod::VertexAttributeSemantic::Position, i)
+                 - attribute3(original, cmod::VertexAttributeSemantic::Position, i)).norm() < 1.0e-3f);
+        REQUIRE(attribute3(unpacked, cmod::VertexAttributeSemantic::Normal, i)
+                .dot(attribute3(original, cmod::VertexAttributeSemantic::Normal, i)) > 0.99999f);
+        REQUIRE((attribute2(unpacked, cmod::VertexAttributeSemantic::Texture0, i)
+                 - attribute2(original, cmod::VertexAttributeSemantic::Texture0, i)).norm() < 1.0e-3f);
+    }
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("MeshQuantize");
+
+TEST_CASE("Octahedral encoding roundtrips unit vectors")
+{
+    const std::array<Eigen::Vector3f, 7> normals
+    {
+        Eigen::Vector3f::UnitX(),
+        -Eigen::Vector3f::UnitY(),
+        Eigen::Vector3f::UnitZ(),
+        -Eigen::Vector3f::UnitZ(),
+        Eigen::Vector3f(1.0f, 1.0f, 1.0f).normalized(),
+        Eigen::Vector3f(-0.3f, 0.2f, -0.9f).normalized(),
+        Eigen::Vector3f(0.5f, -0.7f, -0.1f).normalized(),
+    };
+
+    for (const auto& n : normals)
+        REQUIRE(cmod::DecodeOctahedral(cmod::EncodeOctahedral(n)).dot(n) > 0.99999f);
+}
+
+TEST_CASE("Quantized meshes are smaller and keep their bounds and positions")
+{
+    cmod::Mesh mesh = makeMesh();
+    cmod::Mesh packed = cmod::QuantizeMesh(mesh);
+
+    REQUIRE(!cmod::IsQuantized(mesh));
+    REQUIRE(cmod::IsQuantized(packed));
+    REQUIRE(packed.getVertexDescription().strideBytes == 16);
+    REQUIRE(packed.getVertexDescription().getAttribute(cmod::VertexAttributeSemantic::Position).format
+            == cmod::VertexAttributeFormat::Short4);
+
+    Eigen::AlignedBox<float, 3> bounds = mesh.getBoundingBox();
+    Eigen::AlignedBox<float, 3> packedBounds = packed.getBoundingBox();
+    REQUIRE((packedBounds.min() - bounds.min()).norm() < 1.0e-3f);
+    REQUIRE((packedBounds.max() - bounds.max()).norm() < 1.0e-3f);
+    for (unsigned int i = 0; i < VertexCount; ++i)
+        REQUIRE((packed.getPosition(i) - mesh.getPosition(i)).norm() < 1.0e-3f);
+
+    checkRoundtrip(mesh, cmod::DequantizeMesh(packed));
+}
+
+TEST_CASE("Quantized meshes roundtrip through binary CMOD files")
+{
+    cmod::Model model;
+    model.addMaterial(cmod::Material());
+    model.addMesh(cmod::QuantizeMesh(makeMesh()));
+
+    std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+    REQUIRE(cmod::SaveModelBinary(&model, stream, [](ResourceHandle) { return fs::path(); }));
+    REQUIRE(stream.str().compare(0, 16, "#celmodel_bin_v2") == 0);
+
+    std::unique_ptr<cmod::Model> loaded = cmod::LoadModel(stream, [](const fs::path&) { return InvalidResource; });
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->getMeshCount() == 1);
+
+    const cmod::Mesh* mesh = loaded->getMesh(0);
+    REQUIRE(mesh->getVertexDescription() == model.getMesh(0)->getVertexDescription());
+    REQUIRE(mesh->getPositionOffset() == model.getMesh(0)->getPositionOffset());
+    REQUIRE(mesh->getPositionScale() == model.getMesh(0)->getPositionScale());
+    REQUIRE(mesh->getGroup(0)->indices == model.getMesh(0)->getGroup(0)->indices);
+    checkRoundtrip(makeMesh(), cmod::DequantizeMesh(*mesh));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,137 @@
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <celmodel/material.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+
+#include <doctest.h>
+
+namespace
+{
+
+// Mesh of a triangle for each material, with positions only
+cmod::Mesh
+makeMesh(const std::vector<unsigned int>& materials)
+{
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(3, std::vector<cmod::VWord>(9, 0));
+    for (unsigned int material : materials)
+        mesh.addGroup(cmod::PrimitiveGroupType::TriList, material, std::vector<cmod::Index32>{ 0, 1, 2 });
+    return mesh;
+}
+
+cmod::Material
+makeMaterial(float opacity, float red)
+{
+    cmod::Material material;
+    material.opacity = opacity;
+    material.diffuse = cmod::Color(red, 1.0f, 1.0f);
+    return material;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Model");
+
+TEST_CASE("Opaque meshes are merged with their groups aggregated by material")
+{
+    cmod::Model model;
+    model.addMaterial(makeMaterial(1.0f, 0.0f));
+    model.addMaterial(makeMaterial(1.0f, 0.5f));
+    model.addMesh(makeMesh({ 0, 1 }));
+    model.addMesh(makeMesh({ 1, 0 }));
+
+    model.uniquifyMaterials();
+    model.sortMeshes(cmod::Model::OpacityComparator());
+
+    REQUIRE(model.getMeshCount() == 1);
+    const cmod::Mesh* mesh = model.getMesh(0);
+    REQUIRE(mesh->getVertexCount() == 6);
+    REQUIRE(mesh->getGroupCount() == 2);
+    REQUIRE(mesh->getGroup(0)->materialIndex != mesh->getGroup(1)->materialIndex);
+    REQUIRE(mesh->getGroup(0)->indices.size() == 6);
+    REQUIRE(mesh->getGroup(1)->indicesOffset == 6);
+    REQUIRE(mesh->getIndexCount() == 12);
+}
+
+TEST_CASE("Translucent meshes are not merged")
+{
+    cmod::Model model;
+    model.addMaterial(makeMaterial(1.0f, 0.0f));
+    model.addMaterial(makeMaterial(0.5f, 0.0f));
+    model.addMesh(makeMesh({ 0 }));
+    model.addMesh(makeMesh({ 0, 1 }));
+
+    model.uniquifyMaterials();
+    model.sortMeshes(cmod::Model::OpacityComparator());
+
+    REQUIRE(model.getMeshCount() == 2);
+}
+
+TEST_CASE("Meshes with levels of detail are not merged")
+{
+    cmod::Model model;
+    model.addMaterial(makeMaterial(1.0f, 0.0f));
+    cmod::Mesh mesh = makeMesh({ 0 });
+    unsigned int lod = mesh.addLod(0.5f);
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::vector<cmod::Index32>{ 0, 2, 1 }, lod);
+    model.addMesh(std::move(mesh));
+    model.addMesh(makeMesh({ 0 }));
+
+    model.sortMeshes(cmod::Model::OpacityComparator());
+
+    REQUIRE(model.getMeshCount() == 2);
+}
+
+TEST_CASE("Levels of detail are kept by CMOD files and scaled with the mesh")
+{
+    cmod::Model model;
+    model.addMaterial(makeMaterial(1.0f, 0.0f));
+    cmod::Mesh mesh = makeMesh({ 0 });
+    REQUIRE(mesh.addLod(0.25f) == 1);
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::vector<cmod::Index32>{ 0, 2, 1 }, 1);
+    REQUIRE(mesh.addLod(0.5f) == 2);
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::vector<cmod::Index32>{ 1, 2, 0 }, 2);
+    model.addMesh(std::move(mesh));
+
+    auto checkLods = [](const cmod::Mesh& m, float scale)
+    {
+        REQUIRE(m.getLodCount() == 3);
+        REQUIRE(m.getLodError(0) == 0.0f);
+        REQUIRE(m.getLodError(1) == 0.25f * scale);
+        REQUIRE(m.getLodError(2) == 0.5f * scale);
+        REQUIRE(m.getGroupCount() == 3);
+        REQUIRE(m.getGroup(1)->lod == 1);
+        REQUIRE(m.getGroup(2)->lod == 2);
+        REQUIRE(m.getGroup(2)->indices == std::vector<cmod::Index32>{ 1, 2, 0 });
+        REQUIRE(m.getPrimitiveCount() == 1);
+    };
+
+    auto getSource = [](ResourceHandle) { return fs::path(); };
+    auto getHandle = [](const fs::path&) { return InvalidResource; };
+
+    std::stringstream ascii;
+    REQUIRE(cmod::SaveModelAscii(&model, ascii, getSource));
+    std::unique_ptr<cmod::Model> fromAscii = cmod::LoadModel(ascii, getHandle);
+    REQUIRE(fromAscii != nullptr);
+    checkLods(*fromAscii->getMesh(0), 1.0f);
+
+    std::stringstream binary(std::ios::in | std::ios::out | std::ios::binary);
+    REQUIRE(cmod::SaveModelBinary(fromAscii.get(), binary, getSource));
+    std::unique_ptr<cmod::Model> fromBinary = cmod::LoadModel(binary, getHandle);
+    REQUIRE(fromBinary != nullptr);
+    checkLods(*fromBinary->getMesh(0), 1.0f);
+
+    fromBinary->getMesh(0)->transform(Eigen::Vector3f::Zero(), 2.0f);
+    checkLods(*fromBinary->getMesh(0), 2.0f);
+}
+
+TEST_SUITE_END();
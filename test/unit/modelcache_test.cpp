@@ -0,0 +1,132 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <celengine/modelcache.h>
+#include <celmodel/material.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+
+#include <doctest.h>
+
+using celestia::engine::DeserializeModel;
+using celestia::engine::SerializeModel;
+
+namespace
+{
+
+std::unique_ptr<cmod::Model>
+makeModel()
+{
+    auto model = std::make_unique<cmod::Model>();
+
+    cmod::Material material;
+    material.diffuse = cmod::Color(0.5f, 0.25f, 1.0f);
+    material.opacity = 0.5f;
+    material.blend = cmod::BlendMode::AdditiveBlend;
+    material.setMap(cmod::TextureSemantic::DiffuseMap, 7);
+    material.setMap(cmod::TextureSemantic::NormalMap, 9);
+    model->addMaterial(std::move(material));
+    model->addMaterial(cmod::Material());
+
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Float2, 3);
+
+    cmod::Mesh mesh;
+    mesh.setName("hull");
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    std::vector<cmod::VWord> vertices(4 * 5);
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+        vertices[i] = static_cast<cmod::VWord>(i * 31);
+    mesh.setVertices(4, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::vector<cmod::Index32>{ 0, 1, 2, 2, 1, 3 });
+    unsigned int lod = mesh.addLod(0.25f);
+    mesh.addGroup(cmod::PrimitiveGroupType::TriStrip, 1, std::vector<cmod::Index32>{ 0, 1, 3 }, lod);
+    mesh.rebuildIndexMetadata();
+    model->addMesh(std::move(mesh));
+
+    model->determineOpacity();
+    return model;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("ModelCache");
+
+TEST_CASE("Cached models keep their meshes and materials")
+{
+    auto model = makeModel();
+    std::string data = SerializeModel(*model, [](ResourceHandle handle)
+    {
+        return std::make_pair(fs::path(handle == 7 ? "hull.png" : "hull-normal.png"), fs::path("addons/ship"));
+    });
+
+    std::vector<std::pair<fs::path, fs::path>> textures;
+    auto loaded = DeserializeModel(data.data(), data.size(), [&textures](const fs::path& name, const fs::path& dir)
+    {
+        textures.emplace_back(name, dir);
+        return static_cast<ResourceHandle>(textures.size() + 100);
+    });
+
+    REQUIRE(loaded != nullptr);
+    REQUIRE(textures.size() == 2);
+    REQUIRE(textures[0].first == fs::path("hull.png"));
+    REQUIRE(textures[1].first == fs::path("hull-normal.png"));
+    REQUIRE(textures[1].second == fs::path("addons/ship"));
+
+    REQUIRE(loaded->getMaterialCount() == 2);
+    const cmod::Material* material = loaded->getMaterial(0);
+    REQUIRE(material->diffuse == cmod::Color(0.5f, 0.25f, 1.0f));
+    REQUIRE(material->opacity == 0.5f);
+    REQUIRE(material->blend == cmod::BlendMode::AdditiveBlend);
+    REQUIRE(material->getMap(cmod::TextureSemantic::DiffuseMap) == 101);
+    REQUIRE(material->getMap(cmod::TextureSemantic::NormalMap) == 102);
+    REQUIRE(material->getMap(cmod::TextureSemantic::SpecularMap) == InvalidResource);
+    REQUIRE(loaded->isOpaque() == model->isOpaque());
+
+    REQUIRE(loaded->getMeshCount() == 1);
+    const cmod::Mesh* mesh = loaded->getMesh(0);
+    const cmod::Mesh* original = model->getMesh(0);
+    REQUIRE(mesh->getName() == "hull");
+    REQUIRE(mesh->getVertexDescription() == original->getVertexDescription());
+    REQUIRE(mesh->getVertexCount() == 4);
+    REQUIRE(std::equal(mesh->getVertexData(), mesh->getVertexData() + 20, original->getVertexData()));
+    REQUIRE(mesh->getLodCount() == 2);
+    REQUIRE(mesh->getLodError(1) == 0.25f);
+    REQUIRE(mesh->getIndexCount() == 9);
+    REQUIRE(mesh->getGroupCount() == 2);
+    REQUIRE(mesh->getGroup(0)->indices == original->getGroup(0)->indices);
+    REQUIRE(mesh->getGroup(1)->prim == cmod::PrimitiveGroupType::TriStrip);
+    REQUIRE(mesh->getGroup(1)->materialIndex == 1);
+    REQUIRE(mesh->getGroup(1)->lod == 1);
+}
+
+TEST_CASE("Broken cache files are rejected")
+{
+    auto model = makeModel();
+    std::string data = SerializeModel(*model, [](ResourceHandle)
+    {
+        return std::make_pair(fs::path("hull.png"), fs::path());
+    });
+
+    int textureCount = 0;
+    auto getTexture = [&textureCount](const fs::path&, const fs::path&)
+    {
+        ++textureCount;
+        return ResourceHandle(0);
+    };
+
+    for (std::size_t size = 0; size < data.size(); size += 3)
+        REQUIRE(DeserializeModel(data.data(), size, getTexture) == nullptr);
+
+    // An index past the last vertex
+    std::string changed = data;
+    changed[changed.size() - 4] = 4;
+    REQUIRE(DeserializeModel(changed.data(), changed.size(), getTexture) == nullptr);
+
+    REQUIRE(textureCount == 0);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <vector>
+
+#include <celutil/monotonicarena.h>
+
+#include <doctest.h>
+
+using celestia::util::ArenaAllocator;
+using celestia::util::MonotonicArena;
+
+TEST_SUITE_BEGIN("MonotonicArena");
+
+TEST_CASE("Allocations are aligned and do not overlap")
+{
+    MonotonicArena arena(256);
+    auto* a = static_cast<std::byte*>(arena.allocate(3, 1));
+    auto* b = static_cast<std::byte*>(arena.allocate(8, 8));
+    auto* c = static_cast<std::byte*>(arena.allocate(1000, 16));
+
+    REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 8 == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(c) % 16 == 0);
+    REQUIRE(b >= a + 3);
+    REQUIRE((c >= b + 8 || c + 1000 <= a));
+}
+
+TEST_CASE("Reset merges the blocks")
+{
+    MonotonicArena arena(256);
+    for (int i = 0; i < 10; ++i)
+        arena.allocate(200, 8);
+
+    std::size_t capacity = arena.capacity();
+    REQUIRE(capacity >= 2000);
+
+    arena.reset();
+    REQUIRE(arena.capacity() == capacity);
+
+    // The same allocations fit into the merged block
+    for (int i = 0; i < 10; ++i)
+        arena.allocate(200, 8);
+    REQUIRE(arena.capacity() == capacity);
+}
+
+TEST_CASE("Containers can use the arena")
+{
+    MonotonicArena arena(1024);
+    std::vector<int, ArenaAllocator<int>> values{ ArenaAllocator<int>(arena) };
+    for (int i = 0; i < 1000; ++i)
+        values.push_back(i);
+
+    REQUIRE(values.size() == 1000);
+    REQUIRE(values[999] == 999);
+}
+
+TEST_SUITE_END();
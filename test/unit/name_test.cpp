@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celengine/name.h>
+
+#include <doctest.h>
+
+TEST_SUITE_BEGIN("NameDatabase");
+
+TEST_CASE("NameDatabase completes names ignoring case")
+{
+    NameDatabase db;
+    db.add(1, "Sirius");
+    db.add(2, "Sif");
+    db.add(3, "Sun");
+    db.add(4, "sigma");
+    db.add(5, "Épsilon");
+    db.add(6, "Si");
+
+    std::vector<std::string> completion;
+    db.getCompletion(completion, "si");
+    std::sort(completion.begin(), completion.end());
+    REQUIRE(completion == std::vector<std::string>{ "Si", "Sif", "Sirius", "sigma" });
+
+    completion.clear();
+    db.getCompletion(completion, "é");
+    REQUIRE(completion == std::vector<std::string>{ "Épsilon" });
+
+    completion.clear();
+    db.getCompletion(completion, "X");
+    REQUIRE(completion.empty());
+
+    // Names added after a completion are found too
+    db.add(7, "Sirrah");
+    completion.clear();
+    db.getCompletion(completion, "SIR");
+    std::sort(completion.begin(), completion.end());
+    REQUIRE(completion == std::vector<std::string>{ "Sirius", "Sirrah" });
+}
+
+TEST_CASE("NameDatabase limits the completions")
+{
+    NameDatabase db;
+    for (int i = 0; i < 100; ++i)
+        db.add(static_cast<AstroCatalog::IndexNumber>(i), "HD " + std::to_string(i));
+
+    std::vector<std::string> completion;
+    db.getCompletion(completion, "hd", 10);
+    REQUIRE(completion.size() == 10);
+
+    completion.clear();
+    db.getCompletion(completion, "HD 5");
+    REQUIRE(completion.size() == 11);
+}
+
+TEST_CASE("NameDatabase looks up names ignoring case")
+{
+    NameDatabase db;
+    for (int i = 0; i < 1000; ++i)
+        db.add(static_cast<AstroCatalog::IndexNumber>(i), "HD " + std::to_string(i));
+    db.add(2000, "Sirius");
+
+    REQUIRE(db.getNameCount() == 1001);
+    REQUIRE(db.getCatalogNumberByName("hd 517", false) == 517);
+    REQUIRE(db.getCatalogNumberByName("SIRIUS", false) == 2000);
+    REQUIRE(db.getCatalogNumberByName("HD 1000", false) == AstroCatalog::InvalidIndex);
+
+    // Adding a name again gives it the new number
+    db.add(2001, "sirius");
+    REQUIRE(db.getNameCount() == 1001);
+    REQUIRE(db.getCatalogNumberByName("Sirius", false) == 2001);
+    REQUIRE(db.getNameByCatalogNumber(2001) == "sirius");
+}
+
+TEST_CASE("NameDatabase lists the names of a number in order")
+{
+    NameDatabase db;
+    db.add(5, "Vega");
+    db.add(3, "Altair");
+    db.add(5, "HD 172167");
+    db.add(5, "HIP 91262");
+
+    std::vector<std::string> names;
+    for (std::string_view name : db.getNames(5))
+        names.emplace_back(name);
+    REQUIRE(names == std::vector<std::string>{ "Vega", "HD 172167", "HIP 91262" });
+    REQUIRE(db.getNameByCatalogNumber(3) == "Altair");
+    REQUIRE(db.getNames(4).empty());
+
+    // Erasing the names of a number keeps them for lookups by name
+    db.erase(5);
+    db.add(5, "Wega");
+    names.clear();
+    for (std::string_view name : db.getNames(5))
+        names.emplace_back(name);
+    REQUIRE(names == std::vector<std::string>{ "Wega" });
+    REQUIRE(db.getCatalogNumberByName("Vega", false) == 5);
+    REQUIRE(db.getNameByCatalogNumber(3) == "Altair");
+}
+
+TEST_CASE("NameDatabase snapshots keep the names")
+{
+    NameDatabase db;
+    for (int i = 0; i < 100; ++i)
+        db.add(static_cast<AstroCatalog::IndexNumber>(i), "HD " + std::to_string(i));
+    db.add(7, "Sirius");
+    db.erase(8);
+    db.add(8, "Vega");
+
+    std::ostringstream out;
+    REQUIRE(db.writeSnapshot(out));
+    // Trailing data is left for the caller
+    std::string snapshot = out.str() + "rest";
+
+    NameDatabase db2;
+    db2.add(1, "Canopus");
+    std::string_view data = snapshot;
+    REQUIRE(db2.readSnapshot(data));
+    REQUIRE(data == "rest");
+
+    REQUIRE(db2.getNameCount() == db.getNameCount());
+    REQUIRE(db2.getCatalogNumberByName("sirius", false) == 7);
+    REQUIRE(db2.getCatalogNumberByName("Canopus", false) == AstroCatalog::InvalidIndex);
+    REQUIRE(db2.getNameByCatalogNumber(7) == "HD 7");
+    REQUIRE(db2.getNameByCatalogNumber(8) == "Vega");
+
+    // Names can still be added after loading a snapshot
+    db2.add(200, "Rigel");
+    REQUIRE(db2.getCatalogNumberByName("Rigel", false) == 200);
+    REQUIRE(db2.getCatalogNumberByName("HD 99", false) == 99);
+
+    std::string truncated = out.str().substr(0, out.str().size() - 1);
+    data = truncated;
+    NameDatabase db3;
+    REQUIRE(!db3.readSnapshot(data));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,114 @@
+#include <array>
+#include <cmath>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celastro/astro.h>
+#include <celengine/octreeculling.h>
+
+#include <doctest.h>
+
+namespace astro = celestia::astro;
+
+using celestia::engine::OctreeFrustumCuller;
+
+namespace
+{
+
+// Frustum looking down the negative z axis with a 90 degree field of view
+std::array<Eigen::Hyperplane<float, 3>, 5>
+makeFrustum(const Eigen::Vector3f& position)
+{
+    std::array<Eigen::Hyperplane<float, 3>, 5> planes;
+    const Eigen::Vector3f normals[5] = {
+        Eigen::Vector3f(0.0f, 1.0f, -1.0f).normalized(),
+        Eigen::Vector3f(0.0f, -1.0f, -1.0f).normalized(),
+        Eigen::Vector3f(1.0f, 0.0f, -1.0f).normalized(),
+        Eigen::Vector3f(-1.0f, 0.0f, -1.0f).normalized(),
+        Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+    };
+
+    for (int i = 0; i < 5; ++i)
+        planes[i] = Eigen::Hyperplane<float, 3>(normals[i], position);
+    return planes;
+}
+
+bool
+scalarIsVisible(const std::array<Eigen::Hyperplane<float, 3>, 5>& planes,
+                const Eigen::Vector3f& center,
+                float scale)
+{
+    for (const auto& plane : planes)
+    {
+        float r = scale * plane.normal().cwiseAbs().sum();
+        if (plane.signedDistance(center) < -r)
+            return false;
+    }
+
+    return true;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("OctreeFrustumCuller");
+
+TEST_CASE("Batched child test matches single cell tests")
+{
+    Eigen::Vector3f obsPosition(0.5f, -0.25f, 2.0f);
+    auto planes = makeFrustum(obsPosition);
+    OctreeFrustumCuller<float> culler(planes.data(), obsPosition, 6.0f);
+
+    const Eigen::Vector3f centers[] = {
+        Eigen::Vector3f(0.0f, 0.0f, 0.0f),
+        Eigen::Vector3f(10.0f, 3.0f, -4.0f),
+        Eigen::Vector3f(-20.0f, 0.0f, 1.0f),
+        Eigen::Vector3f(0.0f, 0.0f, 50.0f),
+    };
+
+    for (const auto& center : centers)
+    {
+        for (float childScale : { 0.25f, 2.0f, 16.0f })
+        {
+            OctreeFrustumCuller<float>::ChildArray minDistances;
+            unsigned int mask = culler.visibleChildren(center, childScale, minDistances);
+            for (int i = 0; i < 8; ++i)
+            {
+                Eigen::Vector3f childCenter = center + childScale * Eigen::Vector3f(
+                    (i & 1) != 0 ? 1.0f : -1.0f,
+                    (i & 2) != 0 ? 1.0f : -1.0f,
+                    (i & 4) != 0 ? 1.0f : -1.0f);
+
+                bool visible = scalarIsVisible(planes, childCenter, childScale);
+                REQUIRE(((mask >> i) & 1u) == (visible ? 1u : 0u));
+                REQUIRE(culler.isVisible(childCenter, childScale) == visible);
+                if (mask != 0)
+                {
+                    float expected = (obsPosition - childCenter).norm() - childScale * std::sqrt(3.0f);
+                    REQUIRE(minDistances[i] == doctest::Approx(expected).epsilon(1e-5));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Batched magnitude limit matches appToAbsMag")
+{
+    Eigen::Vector3f obsPosition = Eigen::Vector3f::Zero();
+    auto planes = makeFrustum(obsPosition);
+    OctreeFrustumCuller<float> culler(planes.data(), obsPosition, 6.5f);
+
+    OctreeFrustumCuller<float>::ChildArray distances;
+    distances << -1.0f, 0.0f, 0.01f, 1.0f, 10.0f, 32.6167f, 1000.0f, 1.0e6f;
+    OctreeFrustumCuller<float>::ChildArray dimmest = culler.dimmestVisible(distances);
+    for (int i = 0; i < 8; ++i)
+    {
+        REQUIRE(dimmest[i] == doctest::Approx(culler.dimmestVisible(distances[i])).epsilon(1e-5));
+        if (distances[i] > 0.0f)
+            REQUIRE(dimmest[i] == doctest::Approx(astro::appToAbsMag(6.5f, distances[i])).epsilon(1e-5));
+        else
+            REQUIRE(dimmest[i] == 1000.0f);
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <thread>
+
+#include <Eigen/Core>
+
+#include <celastro/astro.h>
+#include <celastro/date.h>
+#include <celengine/orbitsampler.h>
+#include <celengine/orbitsamplingqueue.h>
+#include <celephem/orbit.h>
+#include <celmath/mathlib.h>
+
+#include <doctest.h>
+
+namespace astro = celestia::astro;
+namespace math = celestia::math;
+using celestia::engine::OrbitSamplingQueue;
+
+namespace
+{
+
+celestia::ephem::EllipticalOrbit
+testOrbit()
+{
+    astro::KeplerElements elements;
+    elements.semimajorAxis = 1.5e8;
+    elements.eccentricity = 0.2;
+    elements.inclination = math::degToRad(5.0);
+    elements.longAscendingNode = math::degToRad(30.0);
+    elements.argPericenter = math::degToRad(60.0);
+    elements.meanAnomaly = 0.0;
+    elements.period = 365.25;
+    return celestia::ephem::EllipticalOrbit(elements);
+}
+
+bool
+waitForResult(OrbitSamplingQueue& queue, OrbitSamplingQueue::Result& result)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!queue.takeResult(result))
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Orbit sampling queue");
+
+TEST_CASE("Sampled orbits match the orbits sampled in the frame")
+{
+    auto orbit = testOrbit();
+    OrbitSampler reference;
+    orbit.sample(astro::J2000, astro::J2000 + orbit.getPeriod(), reference);
+
+    OrbitSamplingQueue queue(2);
+    queue.request(&orbit, astro::J2000, astro::J2000 + orbit.getPeriod());
+    REQUIRE(queue.isPending(&orbit));
+
+    OrbitSamplingQueue::Result result;
+    REQUIRE(waitForResult(queue, result));
+    REQUIRE(result.orbit == &orbit);
+    REQUIRE(!queue.isPending(&orbit));
+    REQUIRE(result.samples.size() == reference.samples.size());
+    for (std::size_t i = 0; i < result.samples.size(); ++i)
+    {
+        REQUIRE(result.samples[i].t == reference.samples[i].t);
+        REQUIRE(result.samples[i].position == reference.samples[i].position);
+    }
+}
+
+TEST_CASE("Pending orbits are sampled once")
+{
+    auto orbit = testOrbit();
+    OrbitSamplingQueue queue(1);
+    queue.request(&orbit, astro::J2000, astro::J2000 + orbit.getPeriod());
+    queue.request(&orbit, astro::J2000, astro::J2000 + orbit.getPeriod());
+
+    OrbitSamplingQueue::Result result;
+    REQUIRE(waitForResult(queue, result));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(!queue.takeResult(result));
+}
+
+TEST_CASE("Cleared requests are discarded")
+{
+    auto orbit = testOrbit();
+    OrbitSamplingQueue queue(1);
+    queue.request(&orbit, astro::J2000, astro::J2000 + orbit.getPeriod());
+    queue.clear();
+    REQUIRE(!queue.isPending(&orbit));
+
+    OrbitSamplingQueue::Result result;
+    REQUIRE(!queue.takeResult(result));
+}
+
+TEST_SUITE_END();
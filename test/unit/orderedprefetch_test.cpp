@@ -0,0 +1,57 @@
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <celutil/orderedprefetch.h>
+
+#include <doctest.h>
+
+using celestia::util::OrderedPrefetch;
+
+TEST_SUITE_BEGIN("OrderedPrefetch");
+
+TEST_CASE("Results are returned in order")
+{
+    std::atomic<unsigned int> inFlight{ 0 };
+    std::atomic<unsigned int> maxInFlight{ 0 };
+    OrderedPrefetch<std::size_t> prefetch(100, [&](std::size_t i)
+    {
+        unsigned int current = ++inFlight;
+        unsigned int seen = maxInFlight.load();
+        while (current > seen && !maxInFlight.compare_exchange_weak(seen, current)) {}
+        --inFlight;
+        return i * i;
+    }, 4);
+
+    REQUIRE(prefetch.size() == 100);
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        REQUIRE(!prefetch.done());
+        REQUIRE(prefetch.next() == i * i);
+    }
+
+    REQUIRE(prefetch.done());
+    REQUIRE(maxInFlight.load() <= 4);
+}
+
+TEST_CASE("Results can be polled for")
+{
+    OrderedPrefetch<int> prefetch(3, [](std::size_t i) { return static_cast<int>(i) + 1; }, 1);
+    for (int i = 1; i <= 3; ++i)
+    {
+        while (!prefetch.nextReady())
+            std::this_thread::yield();
+        REQUIRE(prefetch.next() == i);
+    }
+
+    REQUIRE(!prefetch.nextReady());
+}
+
+TEST_CASE("Empty task list")
+{
+    OrderedPrefetch<int> prefetch(0, [](std::size_t) { return 1; });
+    REQUIRE(prefetch.done());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celmodel/mesh.h>
+#include <celmodel/picktree.h>
+
+#include <doctest.h>
+
+namespace
+{
+
+// Mesh of a triangle list of random triangles in the unit cube
+cmod::Mesh
+makeMesh(unsigned int nTriangles, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+
+    std::vector<cmod::VWord> vertices;
+    std::vector<cmod::Index32> indices;
+    for (unsigned int i = 0; i < nTriangles; ++i)
+    {
+        Eigen::Vector3f center(coordinate(rng), coordinate(rng), coordinate(rng));
+        for (int j = 0; j < 3; ++j)
+        {
+            Eigen::Vector3f p = center + Eigen::Vector3f(offset(rng), offset(rng), offset(rng));
+            cmod::VWord words[3];
+            std::memcpy(words, p.data(), sizeof(words));
+            vertices.insert(vertices.end(), words, words + 3);
+            indices.push_back(static_cast<cmod::Index32>(indices.size()));
+        }
+    }
+
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(nTriangles * 3, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("PickTree");
+
+TEST_CASE("Picking finds the nearest triangle hit by the ray")
+{
+    std::mt19937 rng(11);
+    cmod::Mesh mesh = makeMesh(2000, rng);
+    const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+
+    std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+    int hits = 0;
+    for (int ray = 0; ray < 200; ++ray)
+    {
+        Eigen::Vector3d origin(coordinate(rng), coordinate(rng), 3.0);
+        Eigen::Vector3d direction = (Eigen::Vector3d(coordinate(rng), coordinate(rng), -1.0) - origin).normalized();
+
+        // Test every triangle on its own
+        double nearest = 1.0e30;
+        unsigned int nearestIndex = 0;
+        for (unsigned int i = 0; i < mesh.getPrimitiveCount(); ++i)
+        {
+            std::vector<Eigen::Vector3f> positions;
+            for (int j = 0; j < 3; ++j)
+                positions.push_back(mesh.getPosition(group->indices[i * 3 + j]));
+            cmod::PickTree triangle(std::move(positions), { cmod::PickTree::Triangle{ { 0, 1, 2 }, 0, i } });
+            double distance = nearest;
+            if (triangle.pick(origin, direction, distance) != nullptr)
+            {
+                nearest = distance;
+                nearestIndex = i;
+            }
+        }
+
+        cmod::Mesh::PickResult result;
+        bool hit = mesh.pick(origin, direction, &result);
+        REQUIRE(hit == (nearest < 1.0e30));
+        if (hit)
+        {
+            REQUIRE(result.primitiveIndex == nearestIndex);
+            REQUIRE(result.distance == doctest::Approx(nearest));
+            ++hits;
+        }
+    }
+
+    REQUIRE(hits > 0);
+}
+
+TEST_CASE("Picking sees the mesh after it is transformed")
+{
+    std::mt19937 rng(5);
+    cmod::Mesh mesh = makeMesh(100, rng);
+
+    Eigen::Vector3d direction(0.0, 0.0, -1.0);
+    double distance;
+    bool hit = false;
+    Eigen::Vector3d origin;
+    for (int i = 0; i < 100 && !hit; ++i)
+    {
+        origin = Eigen::Vector3d(i * 0.02 - 1.0, 0.1, 3.0);
+        hit = mesh.pick(origin, direction, distance);
+    }
+    REQUIRE(hit);
+
+    mesh.transform(Eigen::Vector3f(0.0f, 0.0f, -1.0f), 1.0f);
+    double movedDistance;
+    REQUIRE(mesh.pick(origin, direction, movedDistance));
+    REQUIRE(movedDistance == doctest::Approx(distance + 1.0));
+}
+
+TEST_SUITE_END();
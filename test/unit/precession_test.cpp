@@ -0,0 +1,35 @@
+#include <random>
+
+#include <Eigen/Geometry>
+
+#include <celephem/precession.h>
+
+#include <doctest.h>
+
+namespace ephem = celestia::ephem;
+
+TEST_SUITE_BEGIN("Precession");
+
+TEST_CASE("Tabulated mean equator of date matches the P03LP model")
+{
+    SUBCASE("Sequential epochs")
+    {
+        for (double T = -3.0; T < 3.0; T += 0.0013)
+        {
+            REQUIRE(ephem::TabulatedMeanEquatorOfDate_P03LP(T).angularDistance(ephem::MeanEquatorOfDate_P03LP(T)) < 1e-12);
+        }
+    }
+
+    SUBCASE("Random epochs")
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> dist(-5000.0, 5000.0);
+        for (int i = 0; i < 200; ++i)
+        {
+            double T = dist(rng);
+            REQUIRE(ephem::TabulatedMeanEquatorOfDate_P03LP(T).angularDistance(ephem::MeanEquatorOfDate_P03LP(T)) < 1e-12);
+        }
+    }
+}
+
+TEST_SUITE_END();
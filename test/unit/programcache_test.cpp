@@ -0,0 +1,35 @@
+#include <array>
+#include <string_view>
+
+#include <celengine/programcache.h>
+
+#include <doctest.h>
+
+using namespace std::string_view_literals;
+using celestia::engine::GetProgramCacheKey;
+
+TEST_SUITE_BEGIN("ProgramBinaryCache");
+
+TEST_CASE("Program cache keys are stable")
+{
+    std::array sources{ "void main() {}"sv, ""sv, "void main() { gl_FragColor = vec4(1.0); }"sv };
+    REQUIRE(GetProgramCacheKey("Mesa\nllvmpipe\n4.5\n"sv, sources) ==
+            GetProgramCacheKey("Mesa\nllvmpipe\n4.5\n"sv, sources));
+}
+
+TEST_CASE("Program cache keys depend on the driver and the sources")
+{
+    std::array sources{ "abc"sv, ""sv, "def"sv };
+    std::uint64_t key = GetProgramCacheKey("Mesa\nllvmpipe\n4.5\n"sv, sources);
+
+    REQUIRE(key != GetProgramCacheKey("Mesa\nllvmpipe\n4.6\n"sv, sources));
+
+    std::array changed{ "abc"sv, ""sv, "deg"sv };
+    REQUIRE(key != GetProgramCacheKey("Mesa\nllvmpipe\n4.5\n"sv, changed));
+
+    // Moving text between stages makes a different program
+    std::array moved{ "ab"sv, "c"sv, "def"sv };
+    REQUIRE(key != GetProgramCacheKey("Mesa\nllvmpipe\n4.5\n"sv, moved));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,67 @@
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/perspectiveprojectionmode.h>
+
+#include <doctest.h>
+
+using celestia::engine::PerspectiveProjectionMode;
+
+namespace
+{
+
+float
+projectX(const Eigen::Matrix4f& projection, const Eigen::Vector3f& position)
+{
+    Eigen::Vector4f clip = projection * position.homogeneous();
+    return clip.x() / clip.w();
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("ProjectionMode");
+
+TEST_CASE("Eyes see points at the screen distance at the same place")
+{
+    PerspectiveProjectionMode mode(800.0f, 600.0f, 400, 96);
+    Eigen::Matrix4f projection = mode.getProjectionMatrix(1.0f, 1000.0f, 1.0f);
+
+    constexpr float shift = 0.02f;
+    constexpr float screenDistance = 50.0f;
+    Eigen::Matrix4f left = mode.getEyeProjectionMatrix(projection, -shift, -shift * screenDistance);
+    Eigen::Matrix4f right = mode.getEyeProjectionMatrix(projection, shift, shift * screenDistance);
+
+    Eigen::Vector3f onScreen(3.0f, 2.0f, -screenDistance);
+    REQUIRE(projectX(left, onScreen) == doctest::Approx(projectX(projection, onScreen)).epsilon(1.0e-5));
+    REQUIRE(projectX(right, onScreen) == doctest::Approx(projectX(projection, onScreen)).epsilon(1.0e-5));
+
+    // Farther points are seen to the right by the right eye
+    Eigen::Vector3f behind(3.0f, 2.0f, -500.0f);
+    REQUIRE(projectX(right, behind) > projectX(left, behind));
+
+    // Without any offset, distant points are shifted by the same amount
+    Eigen::Matrix4f distant = mode.getEyeProjectionMatrix(projection, shift, 0.0f);
+    float disparity = projectX(distant, Eigen::Vector3f(0.0f, 0.0f, -100.0f)) - projectX(projection, Eigen::Vector3f(0.0f, 0.0f, -100.0f));
+    REQUIRE(disparity == doctest::Approx(projectX(distant, behind) - projectX(projection, behind)));
+    REQUIRE(disparity > 0.0f);
+}
+
+TEST_CASE("Sub-views tile the view")
+{
+    PerspectiveProjectionMode full(800.0f, 600.0f, 400, 96);
+    Eigen::Matrix4f projection = full.getProjectionMatrix(1.0f, 1000.0f, 1.0f);
+
+    // The right half of the view, in a window of half the width
+    PerspectiveProjectionMode right(400.0f, 600.0f, 400, 96);
+    right.setSubView(Eigen::Vector4f(0.5f, 0.0f, 0.5f, 1.0f));
+    REQUIRE(right.getFOV(1.0f) == doctest::Approx(full.getFOV(1.0f)));
+    REQUIRE(right.getPixelSize(1.0f) == doctest::Approx(full.getPixelSize(1.0f)));
+
+    Eigen::Matrix4f tile = right.getSubViewMatrix() * right.getProjectionMatrix(1.0f, 1000.0f, 1.0f);
+    Eigen::Vector3f center(0.0f, 0.0f, -10.0f);
+    Eigen::Vector3f point(2.0f, 1.0f, -10.0f);
+    REQUIRE(projectX(tile, center) == doctest::Approx(-1.0f));
+    REQUIRE(projectX(tile, point) == doctest::Approx(2.0f * projectX(projection, point) - 1.0f));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,162 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <celutil/resmanager.h>
+
+#include <doctest.h>
+
+namespace
+{
+
+struct Resource
+{
+    int value;
+
+    std::size_t getMemorySize() const { return static_cast<std::size_t>(value); }
+};
+
+class SyncInfo
+{
+public:
+    using ResourceType = Resource;
+    using ResourceKey = int;
+
+    explicit SyncInfo(int _value) : value(_value) {}
+
+    int resolve(const fs::path&) const { return value; }
+    std::unique_ptr<Resource> load(int key) const
+    {
+        return key < 0 ? nullptr : std::make_unique<Resource>(Resource{ key });
+    }
+
+    friend bool operator<(const SyncInfo& a, const SyncInfo& b) { return a.value < b.value; }
+
+private:
+    int value;
+};
+
+class AsyncInfo : public SyncInfo
+{
+public:
+    using PreparedType = int;
+
+    using SyncInfo::SyncInfo;
+
+    int prepare(int key) const { return key * 2; }
+    std::unique_ptr<Resource> finish(int, int prepared) const
+    {
+        return prepared < 0 ? nullptr : std::make_unique<Resource>(Resource{ prepared });
+    }
+};
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("ResourceManager");
+
+TEST_CASE("Synchronous loading")
+{
+    ResourceManager<SyncInfo> manager("");
+    ResourceHandle h = manager.getHandle(SyncInfo(3));
+    REQUIRE(manager.getHandle(SyncInfo(3)) == h);
+    REQUIRE(manager.getState(h) == ResourceState::NotLoaded);
+    REQUIRE(manager.find(h)->value == 3);
+    REQUIRE(manager.getState(h) == ResourceState::Loaded);
+
+    ResourceHandle bad = manager.getHandle(SyncInfo(-1));
+    REQUIRE(manager.find(bad) == nullptr);
+    REQUIRE(manager.getState(bad) == ResourceState::LoadingFailed);
+}
+
+TEST_CASE("Asynchronous loading")
+{
+    ResourceManager<AsyncInfo> manager("");
+    manager.setAsyncLoading(2);
+
+    ResourceHandle h = manager.getHandle(AsyncInfo(5));
+    ResourceHandle bad = manager.getHandle(AsyncInfo(-1));
+    REQUIRE(manager.find(h) == nullptr);
+    REQUIRE(manager.find(bad) == nullptr);
+    REQUIRE(manager.getState(h) == ResourceState::Loading);
+
+    std::size_t finished = 0;
+    for (int i = 0; i < 1000 && finished < 2; ++i)
+    {
+        finished += manager.processPending(std::chrono::milliseconds(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(finished == 2);
+    REQUIRE(manager.getState(h) == ResourceState::Loaded);
+    REQUIRE(manager.find(h)->value == 10);
+    REQUIRE(manager.getState(bad) == ResourceState::LoadingFailed);
+
+    // Switching back to synchronous loading
+    manager.setAsyncLoading(0);
+    ResourceHandle h2 = manager.getHandle(AsyncInfo(7));
+    REQUIRE(manager.find(h2)->value == 7);
+}
+
+TEST_CASE("Asynchronous loading on request only")
+{
+    ResourceManager<AsyncInfo> manager("");
+    manager.setAsyncLoading(1, false);
+
+    // find still loads synchronously, through load
+    ResourceHandle a = manager.getHandle(AsyncInfo(3));
+    REQUIRE(manager.find(a)->value == 3);
+
+    ResourceHandle b = manager.getHandle(AsyncInfo(4));
+    REQUIRE(manager.findAsync(b) == nullptr);
+    REQUIRE(manager.getState(b) == ResourceState::Loading);
+
+    std::size_t finished = 0;
+    for (int i = 0; i < 1000 && finished < 1; ++i)
+    {
+        finished += manager.processPending(std::chrono::milliseconds(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(finished == 1);
+    REQUIRE(manager.findAsync(b)->value == 8);
+    REQUIRE(manager.getResidentSize() == 11);
+
+    REQUIRE(manager.unload(b));
+    REQUIRE(!manager.unload(b));
+    REQUIRE(manager.getState(b) == ResourceState::NotLoaded);
+    REQUIRE(manager.getResidentSize() == 3);
+}
+
+TEST_CASE("Memory budget")
+{
+    ResourceManager<SyncInfo> manager("");
+    manager.setMemoryBudget(450);
+    ResourceHandle a = manager.getHandle(SyncInfo(100));
+    ResourceHandle b = manager.getHandle(SyncInfo(200));
+    ResourceHandle c = manager.getHandle(SyncInfo(300));
+
+    // Resources used in the last frame are kept even over the budget
+    manager.find(a);
+    manager.find(b);
+    manager.find(c);
+    REQUIRE(manager.getResidentSize() == 600);
+    REQUIRE(manager.nextFrame() == 0);
+
+    manager.find(b);
+    manager.find(c);
+    REQUIRE(manager.nextFrame() == 1);
+    REQUIRE(manager.getState(a) == ResourceState::NotLoaded);
+    REQUIRE(manager.getResidentSize() == 500);
+
+    manager.find(c);
+    REQUIRE(manager.nextFrame() == 1);
+    REQUIRE(manager.getState(b) == ResourceState::NotLoaded);
+    REQUIRE(manager.getResidentSize() == 300);
+
+    // Evicted resources are loaded again on demand
+    REQUIRE(manager.find(a)->value == 100);
+    REQUIRE(manager.getResidentSize() == 400);
+    REQUIRE(manager.nextFrame() == 0);
+}
+
+TEST_SUITE_END();
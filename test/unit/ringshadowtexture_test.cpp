@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <vector>
+
+#include <celengine/ringshadowtexture.h>
+#include <celimage/image.h>
+
+#include <doctest.h>
+
+using celestia::engine::Image;
+using celestia::engine::PixelFormat;
+using celestia::engine::RingShadowProfile;
+
+TEST_SUITE_BEGIN("RingShadowTexture");
+
+TEST_CASE("Profiles are taken from the alpha of the first row")
+{
+    Image image(PixelFormat::LumAlpha, 4, 2);
+    const std::uint8_t pixels[] = { 10, 0, 20, 255, 30, 51, 40, 102,
+                                    0, 255, 0, 255, 0, 255, 0, 255 };
+    std::copy(std::begin(pixels), std::end(pixels), image.getPixels());
+
+    auto profile = RingShadowProfile::fromImage(image);
+    REQUIRE(profile.has_value());
+    REQUIRE(profile->getWidth() == 4);
+
+    std::vector<std::uint8_t> opacity;
+    profile->blur(0.0f, opacity);
+    REQUIRE(opacity == std::vector<std::uint8_t>{ 0, 255, 51, 102 });
+}
+
+TEST_CASE("Wide profiles are averaged down")
+{
+    constexpr int Width = RingShadowProfile::MaxWidth * 2;
+    Image image(PixelFormat::Alpha, Width, 1);
+    for (int x = 0; x < Width; ++x)
+        image.getPixels()[x] = x % 2 == 0 ? 0 : 200;
+
+    auto profile = RingShadowProfile::fromImage(image);
+    REQUIRE(profile.has_value());
+    REQUIRE(profile->getWidth() == RingShadowProfile::MaxWidth);
+
+    std::vector<std::uint8_t> opacity;
+    profile->blur(1.0f, opacity);
+    for (std::uint8_t a : opacity)
+        REQUIRE(a == 100);
+}
+
+TEST_CASE("Blurring spreads opacity and fades at the edges")
+{
+    Image image(PixelFormat::Alpha, 9, 1);
+    for (int x = 0; x < 9; ++x)
+        image.getPixels()[x] = x == 4 ? 255 : 0;
+
+    auto profile = RingShadowProfile::fromImage(image);
+    REQUIRE(profile.has_value());
+
+    std::vector<std::uint8_t> opacity;
+    profile->blur(3.0f, opacity);
+    REQUIRE(opacity == std::vector<std::uint8_t>{ 0, 0, 0, 85, 85, 85, 0, 0, 0 });
+
+    Image edge(PixelFormat::Alpha, 4, 1);
+    std::fill_n(edge.getPixels(), 4, 255);
+    profile = RingShadowProfile::fromImage(edge);
+    profile->blur(3.0f, opacity);
+    REQUIRE(opacity == std::vector<std::uint8_t>{ 170, 255, 255, 170 });
+}
+
+TEST_CASE("Images without alpha or compressed can't be used")
+{
+    REQUIRE_FALSE(RingShadowProfile::fromImage(Image(PixelFormat::RGB, 4, 1)).has_value());
+    REQUIRE_FALSE(RingShadowProfile::fromImage(Image(PixelFormat::DXT5, 4, 4)).has_value());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <celephem/sampfile.h>
+
+#include <doctest.h>
+
+using celestia::ephem::SampleTimeIndex;
+
+namespace
+{
+
+std::uint32_t
+lowerBound(const std::vector<double>& times, double jd)
+{
+    return static_cast<std::uint32_t>(std::lower_bound(times.begin(), times.end(), jd) - times.begin());
+}
+
+void checkIndex(const std::vector<double>& times, std::mt19937& rng)
+{
+    SampleTimeIndex index(times);
+    std::uniform_real_distribution<double> dist(times.front() - 10.0, times.back() + 10.0);
+    for (int i = 0; i < 2000; ++i)
+    {
+        double jd = dist(rng);
+        REQUIRE(index.find(jd, times) == lowerBound(times, jd));
+    }
+
+    for (double jd : times)
+        REQUIRE(index.find(jd, times) == lowerBound(times, jd));
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Sample files");
+
+TEST_CASE("SampleTimeIndex finds evenly spaced samples")
+{
+    std::mt19937 rng(1);
+    std::vector<double> times;
+    for (int i = 0; i < 1000; ++i)
+        times.push_back(2451545.0 + i * 0.1);
+    checkIndex(times, rng);
+}
+
+TEST_CASE("SampleTimeIndex finds clustered samples")
+{
+    std::mt19937 rng(2);
+    std::exponential_distribution<double> gaps(0.5);
+    std::vector<double> times{ 0.0 };
+    for (int i = 0; i < 1000; ++i)
+    {
+        // Dense runs separated by long gaps
+        double gap = i % 100 == 0 ? 1000.0 : gaps(rng) * 1.0e-3;
+        times.push_back(times.back() + gap + 1.0e-6);
+    }
+    checkIndex(times, rng);
+}
+
+TEST_CASE("SampleTimeIndex handles single samples")
+{
+    std::vector<double> times{ 10.0 };
+    SampleTimeIndex index(times);
+    REQUIRE(index.find(5.0, times) == 0);
+    REQUIRE(index.find(10.0, times) == 0);
+    REQUIRE(index.find(15.0, times) == 1);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstddef>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celephem/samplecache.h>
+
+#include <doctest.h>
+
+using celestia::ephem::SampleCache;
+
+TEST_SUITE_BEGIN("Sample cache");
+
+TEST_CASE("Sample cache interpolates within tolerance")
+{
+    int calls = 0;
+    auto circle = [&calls](double t)
+    {
+        ++calls;
+        return Eigen::Vector3d(1000.0 * std::cos(t), 1000.0 * std::sin(t), 0.0);
+    };
+
+    SampleCache<3> cache(0.5, 1.0e-3);
+    double maxError = 0.0;
+    for (int i = 0; i < 10000; ++i)
+    {
+        double t = 2451545.0 + i * 0.001;
+        Eigen::Vector3d p = cache.get(t, circle);
+        maxError = std::max(maxError, (p - Eigen::Vector3d(1000.0 * std::cos(t), 1000.0 * std::sin(t), 0.0)).norm());
+    }
+
+    // Tolerance is only checked at the middle of the parts
+    REQUIRE(maxError < 4.0e-3);
+    REQUIRE(calls < 10000 / 2);
+    REQUIRE(cache.sampleCount() > 0);
+}
+
+TEST_CASE("Sample cache evaluates outside its range")
+{
+    int calls = 0;
+    auto line = [&calls](double t)
+    {
+        ++calls;
+        return Eigen::Matrix<double, 1, 1>(t);
+    };
+
+    SampleCache<1> cache(10.0, 1.0e-6);
+    cache.setRange(0.0, 5.0);
+    REQUIRE(cache.get(2.5, line)(0) == doctest::Approx(2.5));
+    int inRangeCalls = calls;
+    REQUIRE(cache.get(3.5, line)(0) == doctest::Approx(3.5));
+    REQUIRE(calls == inRangeCalls);
+    REQUIRE(cache.get(7.0, line)(0) == 7.0);
+    REQUIRE(calls == inRangeCalls + 1);
+}
+
+TEST_CASE("Sample cache interpolates quaternions of either sign")
+{
+    // The function flips the sign of the quaternion every few samples
+    int calls = 0;
+    auto spin = [&calls](double t)
+    {
+        Eigen::Quaterniond q(Eigen::AngleAxisd(t * 2.0 * 3.141592653589793, Eigen::Vector3d::UnitZ()));
+        Eigen::Vector4d v = q.coeffs();
+        return (++calls % 3 == 0) ? Eigen::Vector4d(-v) : v;
+    };
+
+    SampleCache<4, true> cache(1.0 / 16.0, 1.0e-6);
+    for (int i = 0; i < 1000; ++i)
+    {
+        double t = i * 0.00123;
+        Eigen::Quaterniond expected(Eigen::AngleAxisd(t * 2.0 * 3.141592653589793, Eigen::Vector3d::UnitZ()));
+        Eigen::Vector4d v = cache.get(t, spin);
+        REQUIRE(v.norm() == doctest::Approx(1.0));
+        REQUIRE(std::abs(v.dot(expected.coeffs())) == doctest::Approx(1.0).epsilon(1.0e-9));
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,72 @@
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+
+#include <Eigen/Geometry>
+
+#include <celcompat/filesystem.h>
+#include <celephem/rotation.h>
+#include <celephem/samporient.h>
+
+#include <doctest.h>
+
+namespace ephem = celestia::ephem;
+
+TEST_SUITE_BEGIN("Sampled orientation");
+
+TEST_CASE("Packed quaternions round trip")
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<float> dist;
+    for (int i = 0; i < 1000; ++i)
+    {
+        Eigen::Quaternionf q(dist(rng), dist(rng), dist(rng), dist(rng));
+        q.normalize();
+        Eigen::Quaternionf unpacked = ephem::UnpackQuaternion(ephem::PackQuaternion(q));
+        REQUIRE(unpacked.norm() == doctest::Approx(1.0f).epsilon(1e-5));
+        REQUIRE(q.angularDistance(unpacked) < 1e-5f);
+    }
+}
+
+TEST_CASE("Packed quaternions keep axis rotations")
+{
+    for (const Eigen::Quaternionf& q : { Eigen::Quaternionf::Identity(),
+                                         Eigen::Quaternionf(0.0f, 1.0f, 0.0f, 0.0f),
+                                         Eigen::Quaternionf(0.0f, 0.0f, 0.0f, -1.0f) })
+    {
+        REQUIRE(q.angularDistance(ephem::UnpackQuaternion(ephem::PackQuaternion(q))) < 1e-5f);
+    }
+}
+
+TEST_CASE("Compact sampled orientation matches single precision")
+{
+    fs::path path = fs::temp_directory_path() / "samporient_test.q";
+    {
+        std::ofstream out(path);
+        out.precision(17);
+        for (int i = 0; i <= 100; ++i)
+        {
+            Eigen::Quaterniond q(Eigen::AngleAxisd(0.1 * i, Eigen::Vector3d(1.0, 2.0, 3.0).normalized()));
+            out << 2451545.0 + i << ' ' << q.w() << ' ' << q.x() << ' ' << q.y() << ' ' << q.z() << '\n';
+        }
+    }
+
+    auto single = ephem::LoadSampledOrientation(path);
+    auto compact = ephem::LoadSampledOrientation(path, ephem::OrientationPrecision::Compact);
+    fs::remove(path);
+    REQUIRE(single != nullptr);
+    REQUIRE(compact != nullptr);
+
+    double begin;
+    double end;
+    compact->getValidRange(begin, end);
+    REQUIRE(begin == 2451545.0);
+    REQUIRE(end == 2451645.0);
+
+    for (double jd = 2451540.0; jd < 2451650.0; jd += 0.37)
+        REQUIRE(single->spin(jd).angularDistance(compact->spin(jd)) < 1e-5);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <celengine/scatteringlut.h>
+
+#include <doctest.h>
+
+using namespace celestia::engine;
+
+namespace
+{
+
+// An Earth-like atmosphere in planet radii
+ScatteringLUTParams
+makeParams()
+{
+    ScatteringLUTParams params;
+    params.scaleHeight = 12.0f / 6378.0f;
+    params.atmosphereRadius = 1.0f - params.scaleHeight * std::log(0.05f);
+    params.extinction = Eigen::Vector3f(0.03f, 0.05f, 0.1f) * 6378.0f / 12.0f;
+    return params;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("ScatteringLUT");
+
+TEST_CASE("The horizon is at the middle of the view coordinate")
+{
+    float muH = -std::sqrt(1.0f - 1.0f / (1.01f * 1.01f));
+    REQUIRE(ScatteringLUTViewCoord(1.01f, muH) == doctest::Approx(0.5f));
+    REQUIRE(ScatteringLUTViewCoord(1.01f, 1.0f) == doctest::Approx(1.0f));
+    REQUIRE(ScatteringLUTViewCoord(1.01f, -1.0f) == doctest::Approx(0.0f));
+
+    ScatteringLUTParams params = makeParams();
+    REQUIRE(ScatteringLUTHeightCoord(params, 1.0f) == 0.0f);
+    REQUIRE(ScatteringLUTHeightCoord(params, params.atmosphereRadius) == doctest::Approx(1.0f));
+}
+
+TEST_CASE("Vertical transmittance matches the exponential atmosphere")
+{
+    ScatteringLUTParams params = makeParams();
+    std::vector<Eigen::Vector3f> transmittance = ComputeTransmittanceLUT(params);
+    REQUIRE(transmittance.size() == TransmittanceLUTWidth * TransmittanceLUTHeight);
+
+    // From the ground to the zenith; the column density is H * (1 - 0.05)
+    Eigen::Vector3f zenith = transmittance[TransmittanceLUTWidth - 1];
+    for (int c = 0; c < 3; ++c)
+    {
+        float expected = std::exp(-params.extinction[c] * params.scaleHeight * 0.95f);
+        REQUIRE(zenith[c] == doctest::Approx(expected).epsilon(0.01));
+    }
+
+    // Looking up from the top of the atmosphere, nothing is in the way
+    Eigen::Vector3f top = transmittance.back();
+    REQUIRE(top.minCoeff() == doctest::Approx(1.0f));
+
+    REQUIRE(std::all_of(transmittance.begin(), transmittance.end(),
+                        [](const Eigen::Vector3f& t) { return t.minCoeff() >= 0.0f && t.maxCoeff() <= 1.0f; }));
+}
+
+TEST_CASE("The night side of the planet scatters no light")
+{
+    ScatteringLUTParams params = makeParams();
+    std::vector<Eigen::Vector3f> inscatter = ComputeInscatterLUT(params, ComputeTransmittanceLUT(params));
+    REQUIRE(inscatter.size() == InscatterLUTWidth * InscatterLUTHeight);
+
+    // Looking at the zenith from the ground
+    const Eigen::Vector3f* row = inscatter.data() + (InscatterLUTHeight - 1) * InscatterLUTWidth;
+    REQUIRE(row[0].maxCoeff() == 0.0f);
+    REQUIRE(row[InscatterLUTSunSize - 1].minCoeff() > 0.0f);
+    // Before applying the scattering coefficients, the more strongly
+    // extinguished blue light reaches the eye less than red light
+    REQUIRE(row[InscatterLUTSunSize - 1].z() < row[InscatterLUTSunSize - 1].x());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,63 @@
+#include <sstream>
+#include <string>
+
+#include <celestia/startupprofile.h>
+
+#include <doctest.h>
+
+using celestia::StartupProfile;
+
+TEST_SUITE_BEGIN("StartupProfile");
+
+TEST_CASE("Nested phases")
+{
+    StartupProfile profile;
+    {
+        StartupProfile::Phase outer(&profile, "outer");
+        outer.addObjects(1);
+        {
+            StartupProfile::Phase inner(&profile, "inner");
+            inner.addBytes(100);
+            inner.addObjects(5);
+        }
+        StartupProfile::Phase second(&profile, "second \"quoted\"");
+        second.addBytes(20);
+        second.end();
+        second.addBytes(1000);
+    }
+
+    const auto& phases = profile.phases();
+    REQUIRE(phases.size() == 3);
+
+    REQUIRE(phases[0].name == "outer");
+    REQUIRE(phases[0].parent == StartupProfile::NoParent);
+    REQUIRE(phases[0].bytes == 120);
+    REQUIRE(phases[0].objects == 6);
+
+    REQUIRE(phases[1].name == "inner");
+    REQUIRE(phases[1].parent == 0);
+    REQUIRE(phases[1].bytes == 100);
+    REQUIRE(phases[1].objects == 5);
+
+    REQUIRE(phases[2].parent == 0);
+    REQUIRE(phases[2].bytes == 20);
+    REQUIRE(phases[2].start >= phases[1].start);
+    REQUIRE(phases[0].duration >= phases[1].duration);
+
+    std::ostringstream report;
+    profile.writeReport(report);
+    std::string json = report.str();
+    REQUIRE(json.find("\"name\": \"inner\", \"parent\": 0") != std::string::npos);
+    REQUIRE(json.find("\"name\": \"outer\", \"parent\": null") != std::string::npos);
+    REQUIRE(json.find("second \\\"quoted\\\"") != std::string::npos);
+}
+
+TEST_CASE("Phase without a profile")
+{
+    StartupProfile::Phase phase(nullptr, "unused");
+    phase.addBytes(1);
+    phase.addObjects(1);
+    phase.end();
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,45 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celutil/stringarena.h>
+
+#include <doctest.h>
+
+using namespace std::string_view_literals;
+using celestia::util::StringArena;
+
+TEST_SUITE_BEGIN("StringArena");
+
+TEST_CASE("Strings remain valid while the arena grows")
+{
+    StringArena arena(16);
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 100; ++i)
+        views.push_back(arena.add(std::to_string(i * 1000)));
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(views[i] == std::to_string(i * 1000));
+}
+
+TEST_CASE("Strings longer than a block are stored")
+{
+    StringArena arena(4);
+    auto shortView = arena.add("abc"sv);
+    auto longView = arena.add("Alpha Centauri"sv);
+    REQUIRE(shortView == "abc"sv);
+    REQUIRE(longView == "Alpha Centauri"sv);
+    REQUIRE(arena.add(""sv).empty());
+}
+
+TEST_CASE("Cleared arenas reuse their memory")
+{
+    StringArena arena(64);
+    auto first = arena.add("Sirius"sv);
+    arena.clear();
+    auto second = arena.add("Vega"sv);
+    REQUIRE(second == "Vega"sv);
+    REQUIRE(second.data() == first.data());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,61 @@
+#include <memory>
+
+#include <Eigen/Core>
+
+#include <celastro/astro.h>
+#include <celmath/mathlib.h>
+#include <celephem/orbit.h>
+#include <celephem/tabulatedorbit.h>
+
+#include <doctest.h>
+
+namespace astro = celestia::astro;
+namespace math = celestia::math;
+
+namespace
+{
+
+astro::KeplerElements
+testElements()
+{
+    astro::KeplerElements elements;
+    elements.semimajorAxis = 421800.0;
+    elements.eccentricity = 0.05;
+    elements.inclination = math::degToRad(20.0);
+    elements.longAscendingNode = math::degToRad(40.0);
+    elements.argPericenter = math::degToRad(75.0);
+    elements.meanAnomaly = math::degToRad(10.0);
+    elements.period = 1.769;
+    return elements;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Tabulated orbits");
+
+TEST_CASE("Tabulated orbits match the approximated orbit")
+{
+    celestia::ephem::EllipticalOrbit reference(testElements());
+    celestia::ephem::TabulatedOrbit orbit(std::make_unique<celestia::ephem::EllipticalOrbit>(testElements()), 10.0);
+    REQUIRE(orbit.getPeriod() == reference.getPeriod());
+    REQUIRE(orbit.getBoundingRadius() == reference.getBoundingRadius());
+
+    // The first evaluation requests the window, the following ones use it
+    constexpr double center = 2451545.0;
+    REQUIRE(orbit.positionAtTime(center) == reference.positionAtTime(center));
+    orbit.waitForTable();
+
+    for (double jd = center - 2.5; jd <= center + 2.5; jd += 0.0137)
+    {
+        REQUIRE((orbit.positionAtTime(jd) - reference.positionAtTime(jd)).norm() < 1.0e-2);
+        REQUIRE((orbit.velocityAtTime(jd) - reference.velocityAtTime(jd)).norm() < 1.0e-6 * reference.velocityAtTime(jd).norm());
+    }
+
+    // Moving away from the window rebuilds it around the new time
+    constexpr double later = center + 400.0;
+    REQUIRE(orbit.positionAtTime(later) == reference.positionAtTime(later));
+    orbit.waitForTable();
+    REQUIRE((orbit.positionAtTime(later + 1.0) - reference.positionAtTime(later + 1.0)).norm() < 1.0e-2);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <celutil/taskscheduler.h>
+
+#include <doctest.h>
+
+using celestia::util::ParallelFor;
+using celestia::util::TaskGroup;
+using celestia::util::TaskPriority;
+using celestia::util::TaskScheduler;
+
+TEST_SUITE_BEGIN("TaskScheduler");
+
+TEST_CASE("ParallelFor visits each index once")
+{
+    TaskScheduler scheduler(3);
+    std::vector<std::atomic<int>> visits(1000);
+    ParallelFor(0, visits.size(), 7, [&](std::size_t i) { ++visits[i]; }, 0, scheduler);
+
+    for (const auto& count : visits)
+        REQUIRE(count.load() == 1);
+}
+
+TEST_CASE("Nested task groups")
+{
+    TaskScheduler scheduler(2);
+    std::atomic<int> leaves{ 0 };
+    {
+        TaskGroup outer(TaskPriority::FrameCritical, scheduler);
+        for (int i = 0; i < 8; ++i)
+        {
+            outer.run([&]
+            {
+                TaskGroup inner(TaskPriority::FrameCritical, scheduler);
+                for (int j = 0; j < 8; ++j)
+                    inner.run([&] { ++leaves; });
+                inner.wait();
+            });
+        }
+        outer.wait();
+        REQUIRE(outer.done());
+    }
+
+    REQUIRE(leaves.load() == 64);
+}
+
+TEST_CASE("Background tasks")
+{
+    TaskScheduler scheduler(1);
+    auto result = scheduler.async([] { return 42; });
+    REQUIRE(result.get() == 42);
+
+    std::atomic<int> count{ 0 };
+    TaskGroup group(TaskPriority::Background, scheduler);
+    for (int i = 0; i < 16; ++i)
+    {
+        group.run([&]
+        {
+            // A background task waiting for other background tasks
+            TaskGroup inner(TaskPriority::Background, scheduler);
+            inner.run([&] { ++count; });
+        });
+    }
+    group.wait();
+    REQUIRE(count.load() == 16);
+}
+
+TEST_CASE("Main thread tasks")
+{
+    TaskScheduler scheduler(2);
+    auto mainThread = std::this_thread::get_id();
+    std::atomic<int> ranOnMain{ 0 };
+    {
+        TaskGroup group(TaskPriority::FrameCritical, scheduler);
+        for (int i = 0; i < 4; ++i)
+        {
+            group.run([&]
+            {
+                scheduler.postToMainThread([&]
+                {
+                    if (std::this_thread::get_id() == mainThread)
+                        ++ranOnMain;
+                });
+            });
+        }
+    }
+
+    REQUIRE(scheduler.runMainThreadTasks() == 4);
+    REQUIRE(ranOnMain.load() == 4);
+    REQUIRE(scheduler.runMainThreadTasks() == 0);
+}
+
+TEST_CASE("Changing the worker count")
+{
+    TaskScheduler scheduler(1);
+    scheduler.setWorkerCount(4);
+    REQUIRE(scheduler.getWorkerCount() == 4);
+    REQUIRE(scheduler.getConcurrency() == 5);
+
+    std::atomic<std::size_t> sum{ 0 };
+    ParallelFor(0, 100, 1, [&](std::size_t i) { sum += i; }, 0, scheduler);
+    REQUIRE(sum.load() == 4950);
+}
+
+TEST_SUITE_END();
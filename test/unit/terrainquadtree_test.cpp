@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+#include <celengine/terrainquadtree.h>
+#include <celmath/frustum.h>
+
+#include <doctest.h>
+
+using celestia::engine::TerrainChunk;
+using celestia::engine::TerrainLODParams;
+using celestia::engine::SelectTerrainChunks;
+using celestia::engine::TerrainChunkTriangles;
+using celestia::math::Frustum;
+
+namespace
+{
+
+constexpr float FieldOfView = static_cast<float>(celestia::numbers::pi / 2.0);
+
+// Frustum looking down the negative z axis from a point on the positive
+// z axis, in coordinates of the unit sphere
+Frustum
+makeFrustum(float distance)
+{
+    Frustum frustum(FieldOfView, 1.0f, 1.0e-4f, 100.0f);
+    Eigen::Matrix4f invView = Eigen::Affine3f(Eigen::Translation3f(0.0f, 0.0f, distance)).matrix();
+    frustum.transform(invView);
+    return frustum;
+}
+
+
+TerrainLODParams
+makeParams(float distance)
+{
+    TerrainLODParams params;
+    params.eyePosition = Eigen::Vector3f(0.0f, 0.0f, distance);
+    params.pixelSize = 2.0f / 1000.0f;
+    params.maxTriangles = 1000000;
+    return params;
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("TerrainQuadtree");
+
+TEST_CASE("Terrain chunks cover the sections of LODSphereMesh")
+{
+    TerrainChunk chunk{ 2, 1, 3 };
+    REQUIRE(chunk.extent() == 4096);
+    REQUIRE(chunk.theta0() == 3 * 4096);
+    REQUIRE(chunk.phi0() == 2048);
+    REQUIRE(chunk.step() == 128);
+
+    TerrainChunk child = chunk.child(1, 0);
+    REQUIRE(child.level == 3);
+    REQUIRE(child.theta0() == chunk.theta0());
+    REQUIRE(child.phi0() == chunk.phi0() + child.extent() / 2);
+    REQUIRE(child.key() != chunk.key());
+
+    REQUIRE(TerrainChunk{ TerrainChunk::MaxLevel, 0, 0 }.step() == 1);
+}
+
+TEST_CASE("Distant spheres are drawn from the coarsest chunks")
+{
+    std::vector<TerrainChunk> selected;
+    std::vector<TerrainChunk> requested;
+    REQUIRE(SelectTerrainChunks(makeParams(50.0f), makeFrustum(50.0f),
+                                [](const TerrainChunk&) { return true; },
+                                selected, requested));
+    REQUIRE(selected.size() == 4);
+    REQUIRE(requested.empty());
+    REQUIRE(std::all_of(selected.begin(), selected.end(),
+                        [](const TerrainChunk& c) { return c.level == 1; }));
+}
+
+TEST_CASE("Spheres aren't drawn from chunks until the coarsest are resident")
+{
+    std::vector<TerrainChunk> selected;
+    std::vector<TerrainChunk> requested;
+    REQUIRE(!SelectTerrainChunks(makeParams(50.0f), makeFrustum(50.0f),
+                                 [](const TerrainChunk& c) { return c.thetaIndex != 1; },
+                                 selected, requested));
+    REQUIRE(selected.empty());
+    REQUIRE(requested.size() == 2);
+}
+
+TEST_CASE("Chunks are refined close to the observer")
+{
+    std::vector<TerrainChunk> selected;
+    std::vector<TerrainChunk> requested;
+    TerrainLODParams params = makeParams(1.05f);
+    REQUIRE(SelectTerrainChunks(params, makeFrustum(1.05f),
+                                [](const TerrainChunk&) { return true; },
+                                selected, requested));
+    REQUIRE(requested.empty());
+    REQUIRE(std::any_of(selected.begin(), selected.end(),
+                        [](const TerrainChunk& c) { return c.level > 3; }));
+
+    SUBCASE("Refinement stops at the triangle budget")
+    {
+        params.maxTriangles = 20 * TerrainChunkTriangles;
+        REQUIRE(SelectTerrainChunks(params, makeFrustum(1.05f),
+                                    [](const TerrainChunk&) { return true; },
+                                    selected, requested));
+        REQUIRE(selected.size() > 4);
+        REQUIRE(selected.size() <= 20);
+    }
+
+    SUBCASE("Missing children are requested")
+    {
+        REQUIRE(SelectTerrainChunks(params, makeFrustum(1.05f),
+                                    [](const TerrainChunk& c) { return c.level <= 2; },
+                                    selected, requested));
+        REQUIRE(!requested.empty());
+        REQUIRE(std::all_of(selected.begin(), selected.end(),
+                            [](const TerrainChunk& c) { return c.level <= 2; }));
+        REQUIRE(std::all_of(requested.begin(), requested.end(),
+                            [](const TerrainChunk& c) { return c.level == 3; }));
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,54 @@
+#include <celengine/multitexture.h>
+#include <celengine/textureresolution.h>
+
+#include <doctest.h>
+
+using celestia::engine::TextureResolutionSelector;
+
+TEST_SUITE_BEGIN("TextureResolutionSelector");
+
+TEST_CASE("Larger discs use higher resolutions")
+{
+    TextureResolutionSelector selector;
+    REQUIRE(selector.select(10.0f) == lores);
+    REQUIRE(selector.select(200.0f) == medres);
+    REQUIRE(selector.select(1000.0f) == hires);
+}
+
+TEST_CASE("Memory pressure lowers the resolution one step at a time")
+{
+    TextureResolutionSelector selector;
+    selector.setTargetFrameTime(16.0);
+
+    // Changes wait for the previous one to take effect
+    for (int i = 0; i < 30; ++i)
+        selector.update(10.0, 95, 100);
+    REQUIRE(selector.getMaxResolution() == medres);
+    REQUIRE(selector.select(1000.0f) == medres);
+    selector.update(10.0, 95, 100);
+    REQUIRE(selector.getMaxResolution() == medres);
+
+    for (int i = 0; i < 100; ++i)
+        selector.update(10.0, 95, 100);
+    REQUIRE(selector.getMaxResolution() == lores);
+}
+
+TEST_CASE("Slow frames lower the resolution and it rises once they are fast")
+{
+    TextureResolutionSelector selector;
+    selector.setTargetFrameTime(16.0);
+    for (int i = 0; i < 30; ++i)
+        selector.update(40.0, 0, 0);
+    REQUIRE(selector.getMaxResolution() == medres);
+
+    // Frames near the target neither lower nor raise it
+    for (int i = 0; i < 1000; ++i)
+        selector.update(16.0, 0, 0);
+    REQUIRE(selector.getMaxResolution() == medres);
+
+    for (int i = 0; i < 240; ++i)
+        selector.update(5.0, 0, 0);
+    REQUIRE(selector.getMaxResolution() == hires);
+}
+
+TEST_SUITE_END();
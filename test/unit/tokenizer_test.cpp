@@ -3,6 +3,7 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 #include <celutil/tokenizer.h>
@@ -10,6 +11,8 @@
 
 #include <doctest.h>
 
+using namespace std::string_view_literals;
+
 TEST_SUITE_BEGIN("Tokenizer");
 
 TEST_CASE("Tokenizer parses names")
@@ -518,4 +521,46 @@ TEST_CASE("Tokenizer skips comments")
     }
 }
 
+TEST_CASE("Tokenizer parses text in memory")
+{
+    std::string_view text = "\357\273\277Body \"Name\" # comment\n"
+                            "{ Radius 6378.14 Mass -3 Info \"a\\\"b\" }\n"
+                            "Trailing";
+    Tokenizer tok(text);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    auto name = tok.getNameValue();
+    REQUIRE(name == "Body");
+    // Names and unescaped strings point into the text
+    REQUIRE(name->data() == text.data() + 3);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+    auto str = tok.getStringValue();
+    REQUIRE(str == "Name");
+    REQUIRE(str->data() == text.data() + 9);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenBeginGroup);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getNumberValue() == 6378.14);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getIntegerValue() == -3);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+    REQUIRE(tok.getStringValue() == "a\"b");
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEndGroup);
+
+    // The last token ends at the end of the text
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.getNameValue() == "Trailing");
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
+
+    Tokenizer unterminated("\"abc"sv);
+    REQUIRE(unterminated.nextToken() == Tokenizer::TokenError);
+
+    Tokenizer empty(std::string_view{});
+    REQUIRE(empty.nextToken() == Tokenizer::TokenEnd);
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,53 @@
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/univcoord.h>
+
+#include <doctest.h>
+
+TEST_SUITE_BEGIN("UniversalCoord");
+
+TEST_CASE("Offsets match the R128 conversion")
+{
+    std::vector<UniversalCoord> coords
+    {
+        UniversalCoord(1.0e12, -3.5e11, 42.0),
+        UniversalCoord(-1.0e12, 2.0e-3, -7.25e9),
+        UniversalCoord(0.0, 0.0, 0.0),
+    };
+    UniversalCoord origin(-1.0e12 + 5.0e-4, 1.0, -7.25e9 - 1.0e-6);
+
+    for (const auto& uc : coords)
+    {
+        Eigen::Vector3d offset = uc.offsetFromUly(origin);
+        REQUIRE(offset.x() == static_cast<double>(uc.x - origin.x));
+        REQUIRE(offset.y() == static_cast<double>(uc.y - origin.y));
+        REQUIRE(offset.z() == static_cast<double>(uc.z - origin.z));
+
+        Eigen::Vector3d ly = uc.toLy();
+        REQUIRE(ly.x() == static_cast<double>(uc.x) * 1.0e-6);
+        REQUIRE(ly.z() == static_cast<double>(uc.z) * 1.0e-6);
+    }
+}
+
+TEST_CASE("Batch offsets")
+{
+    std::vector<UniversalCoord> coords;
+    for (int i = 0; i < 5; ++i)
+        coords.push_back(UniversalCoord::CreateKm(Eigen::Vector3d(1.0e8 * i, -2.0e5 * i, 3.0)));
+    UniversalCoord origin = UniversalCoord::CreateKm(Eigen::Vector3d(5.0e7, 1.0, -1.0));
+
+    std::vector<Eigen::Vector3d> offsets(coords.size());
+    UniversalCoord::OffsetsFromKm(coords, origin, offsets.data());
+    std::vector<Eigen::Vector3f> offsetsf(coords.size());
+    UniversalCoord::OffsetsFromKm(coords, origin, offsetsf.data());
+
+    for (std::size_t i = 0; i < coords.size(); ++i)
+    {
+        REQUIRE(offsets[i] == coords[i].offsetFromKm(origin));
+        REQUIRE(offsetsf[i] == coords[i].offsetFromKm(origin).cast<float>());
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,93 @@
+#include <string>
+#include <string_view>
+
+#include <doctest.h>
+
+#include <celutil/utf8.h>
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+std::string
+foldedKey(std::string_view s)
+{
+    std::string key;
+    UTF8AppendFoldedKey(s, key);
+    return key;
+}
+
+} // end unnamed namespace
+
+
+TEST_SUITE_BEGIN("UTF-8");
+
+TEST_CASE("ASCII runs are measured across words")
+{
+    REQUIRE(UTF8AsciiLength(""sv) == 0);
+    REQUIRE(UTF8AsciiLength("Alpha Centauri"sv) == 14);
+    REQUIRE(UTF8AsciiLength("Alpha Centauri \303\251"sv) == 15);
+    REQUIRE(UTF8AsciiLength("Alpha\303\251"sv) == 5);
+    REQUIRE(UTF8AsciiLength("\316\261 Cen"sv) == 0);
+}
+
+TEST_CASE("Validation")
+{
+    REQUIRE(UTF8IsValid(""sv));
+    REQUIRE(UTF8IsValid("Proxima Centauri"sv));
+    REQUIRE(UTF8IsValid("R\303\251gulus and \316\261 Leonis, \342\200\224 \360\237\214\237"sv));
+    REQUIRE(!UTF8IsValid("Regulus \303"sv));
+    REQUIRE(!UTF8IsValid("Regulus \303 Leonis"sv));
+    REQUIRE(!UTF8IsValid("Regulus \200 Leonis"sv));
+    REQUIRE(!UTF8IsValid("\355\240\200 surrogate"sv));
+    REQUIRE(!UTF8IsValid("overlong \300\257"sv));
+}
+
+TEST_CASE("Decoding ASCII and multibyte characters")
+{
+    std::string_view s = "a\303\251\342\202\254"sv;
+    std::int32_t pos = 0;
+    std::int32_t ch = 0;
+    REQUIRE(UTF8Decode(s, pos, ch));
+    REQUIRE(ch == 'a');
+    REQUIRE(UTF8Decode(s, pos, ch));
+    REQUIRE(ch == 0xe9);
+    REQUIRE(UTF8Decode(s, pos, ch));
+    REQUIRE(ch == 0x20ac);
+    REQUIRE(pos == 6);
+    REQUIRE(!UTF8Decode(s, pos, ch));
+}
+
+TEST_CASE("Comparisons ignore case beyond the first word")
+{
+    REQUIRE(UTF8StringCompare("Alpha Centauri A"sv, "ALPHA CENTAURI a"sv) == 0);
+    REQUIRE(UTF8StringCompare("Alpha Centauri A"sv, "alpha centauri b"sv) == -1);
+    REQUIRE(UTF8StringCompare("Alpha Centauri"sv, "alpha centauri a"sv) == -1);
+    REQUIRE(UTF8StringCompare("Alpha Centauri \303\211"sv, "alpha centauri e"sv) == 0);
+    REQUIRE(UTF8StringCompare("[bracket"sv, "Zeta"sv) == -1);
+
+    REQUIRE(UTF8StartsWith("Alpha Centauri A"sv, "alpha CENTAURI"sv));
+    REQUIRE(UTF8StartsWith("Alpha Centauri A"sv, "alpha CENTAURI"sv, true));
+    REQUIRE(!UTF8StartsWith("Alpha Centauri"sv, "alpha centauri a"sv));
+    REQUIRE(!UTF8StartsWith("Alpha Centauri A"sv, "alpha centaurx"sv));
+    REQUIRE(UTF8StartsWith("Alpha Centauri \303\211toile"sv, "ALPHA CENTAURI \303\251T"sv, true));
+}
+
+TEST_CASE("Folded keys")
+{
+    REQUIRE(foldedKey("Alpha Centauri"sv) == "alpha centauri");
+    REQUIRE(foldedKey("\303\211toile"sv) == "etoile");
+    REQUIRE(foldedKey("\316\221\316\273\317\206\316\261"sv) == "\316\261\316\273\317\206\316\261");
+
+    // Keys order like the folded characters, and prefixes stay prefixes
+    REQUIRE(foldedKey("Ab"sv) < foldedKey("a\303\237"sv));
+    REQUIRE(foldedKey("a\303\237"sv) < foldedKey("a\342\202\254"sv));
+    REQUIRE(foldedKey("Sirius B"sv).rfind(foldedKey("SIR"sv), 0) == 0);
+
+    // Invalid bytes sort after all the characters
+    REQUIRE(foldedKey("a\377"sv) > foldedKey("a\360\237\214\237"sv));
+    REQUIRE(foldedKey("a\377"sv).size() == 5);
+}
+
+TEST_SUITE_END();
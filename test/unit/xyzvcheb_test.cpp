@@ -0,0 +1,139 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celcompat/bit.h>
+#include <celcompat/filesystem.h>
+#include <celephem/orbit.h>
+#include <celephem/samporbit.h>
+#include <celephem/xyzvcheb.h>
+
+#include <doctest.h>
+
+using celestia::ephem::XYZVChebyshevHeader;
+
+namespace
+{
+
+constexpr std::uint16_t NCoefficients = 4;
+constexpr std::array<double, 3> SegmentTimes{ 2451545.0, 2451555.0, 2451575.0 };
+
+// Coefficients of the x, y and z coordinates of both segments
+constexpr std::array<double, 2 * 3 * NCoefficients> Coefficients{
+    1000.0, 200.0, 30.0, 4.0,
+    -500.0, 100.0, 0.0, -2.0,
+    20.0, 0.0, 10.0, 0.0,
+
+    1234.0, 300.0, -30.0, 1.0,
+    -404.0, 50.0, 20.0, 0.0,
+    40.0, 20.0, 0.0, 0.0,
+};
+
+template<typename T>
+void put(std::vector<char>& data, std::size_t offset, T value)
+{
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+std::vector<char> makeTrajectory()
+{
+    std::vector<char> data(sizeof(XYZVChebyshevHeader) +
+                           sizeof(double) * (SegmentTimes.size() + Coefficients.size()));
+    std::memcpy(data.data(), celestia::ephem::XYZV_CHEBYSHEV_MAGIC.data(), celestia::ephem::XYZV_CHEBYSHEV_MAGIC.size());
+    put(data, offsetof(XYZVChebyshevHeader, byteOrder), static_cast<std::uint16_t>(celestia::compat::endian::native));
+    put(data, offsetof(XYZVChebyshevHeader, digits), static_cast<std::uint16_t>(std::numeric_limits<double>::digits));
+    put(data, offsetof(XYZVChebyshevHeader, coefficientCount), NCoefficients);
+    put(data, offsetof(XYZVChebyshevHeader, segmentCount), static_cast<std::uint64_t>(SegmentTimes.size() - 1));
+    put(data, offsetof(XYZVChebyshevHeader, boundingRadius), 2000.0);
+    std::memcpy(data.data() + sizeof(XYZVChebyshevHeader), SegmentTimes.data(), sizeof(SegmentTimes));
+    std::memcpy(data.data() + sizeof(XYZVChebyshevHeader) + sizeof(SegmentTimes), Coefficients.data(), sizeof(Coefficients));
+    return data;
+}
+
+fs::path writeFile(const std::vector<char>& data, const char* name)
+{
+    fs::path path = fs::temp_directory_path() / name;
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return path;
+}
+
+// Expected positions in the frame of the file, velocities in km/day
+Eigen::Vector3d expectedPosition(std::size_t segment, double u)
+{
+    std::array<double, NCoefficients> t{ 1.0, u, 2.0 * u * u - 1.0, 4.0 * u * u * u - 3.0 * u };
+    Eigen::Vector3d p = Eigen::Vector3d::Zero();
+    for (int i = 0; i < 3; ++i)
+        for (std::size_t j = 0; j < NCoefficients; ++j)
+            p[i] += Coefficients[(segment * 3 + i) * NCoefficients + j] * t[j];
+    return p;
+}
+
+Eigen::Vector3d expectedVelocity(std::size_t segment, double u)
+{
+    std::array<double, NCoefficients> d{ 0.0, 1.0, 4.0 * u, 12.0 * u * u - 3.0 };
+    Eigen::Vector3d v = Eigen::Vector3d::Zero();
+    for (int i = 0; i < 3; ++i)
+        for (std::size_t j = 0; j < NCoefficients; ++j)
+            v[i] += Coefficients[(segment * 3 + i) * NCoefficients + j] * d[j];
+    return v * 2.0 / (SegmentTimes[segment + 1] - SegmentTimes[segment]);
+}
+
+Eigen::Vector3d toCelestia(const Eigen::Vector3d& v)
+{
+    return Eigen::Vector3d(v.x(), v.z(), -v.y());
+}
+
+} // end unnamed namespace
+
+TEST_SUITE_BEGIN("Chebyshev trajectories");
+
+TEST_CASE("Chebyshev trajectories evaluate the coefficients")
+{
+    fs::path path = writeFile(makeTrajectory(), "celestia_xyzvcheb_test.xyzvcheb");
+    std::unique_ptr<celestia::ephem::Orbit> orbit = celestia::ephem::LoadXYZVChebyshevTrajectory(path);
+    REQUIRE(orbit != nullptr);
+
+    double begin;
+    double end;
+    orbit->getValidRange(begin, end);
+    REQUIRE(begin == SegmentTimes.front());
+    REQUIRE(end == SegmentTimes.back());
+    REQUIRE(orbit->getBoundingRadius() == 2000.0);
+
+    for (std::size_t segment = 0; segment < 2; ++segment)
+    {
+        for (double u : { -1.0, -0.3, 0.0, 0.5, 0.9 })
+        {
+            double jd = SegmentTimes[segment] + (u + 1.0) * 0.5 * (SegmentTimes[segment + 1] - SegmentTimes[segment]);
+            REQUIRE((orbit->positionAtTime(jd) - toCelestia(expectedPosition(segment, u))).norm() < 1.0e-9);
+            REQUIRE((orbit->velocityAtTime(jd) - toCelestia(expectedVelocity(segment, u))).norm() < 1.0e-9);
+        }
+    }
+
+    // Times outside the span are clamped to it
+    REQUIRE((orbit->positionAtTime(SegmentTimes.front() - 5.0) - toCelestia(expectedPosition(0, -1.0))).norm() < 1.0e-9);
+    REQUIRE((orbit->positionAtTime(SegmentTimes.back() + 5.0) - toCelestia(expectedPosition(1, 1.0))).norm() < 1.0e-9);
+    REQUIRE(orbit->velocityAtTime(SegmentTimes.back() + 5.0) == Eigen::Vector3d::Zero());
+
+    orbit.reset();
+    fs::remove(path);
+}
+
+TEST_CASE("Truncated Chebyshev trajectories are rejected")
+{
+    std::vector<char> data = makeTrajectory();
+    data.resize(data.size() - 8);
+    fs::path path = writeFile(data, "celestia_xyzvcheb_truncated.xyzvcheb");
+    REQUIRE(celestia::ephem::LoadXYZVChebyshevTrajectory(path) == nullptr);
+    fs::remove(path);
+}
+
+TEST_SUITE_END();